@@ -0,0 +1,41 @@
+#############################################################################
+# Copyright (c) 2024 One Identity LLC.
+#
+# This library is free software; you can redistribute it and/or
+# modify it under the terms of the GNU Lesser General Public
+# License as published by the Free Software Foundation; either
+# version 2.1 of the License, or (at your option) any later version.
+#
+# This library is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+# Lesser General Public License for more details.
+#
+# You should have received a copy of the GNU Lesser General Public
+# License along with this library; if not, write to the Free Software
+# Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+#
+# As an additional exemption you are allowed to compile & link against the
+# OpenSSL libraries as published by the OpenSSL project. See the file
+# COPYING for details.
+#
+#############################################################################
+
+include(LibFindMacros)
+include(FindPackageHandleStandardArgs)
+
+find_package(PkgConfig)
+
+pkg_check_modules(PC_LIBURING liburing>=2.0 QUIET)
+find_path(LIBURING_INCLUDE_DIR NAMES liburing.h HINTS ${PC_LIBURING_INCLUDE_DIRS})
+find_library(LIBURING_LIBRARY  NAMES uring            HINTS ${PC_LIBURING_LIBRARY_DIRS})
+
+add_library(liburing INTERFACE)
+
+if (NOT PC_LIBURING_FOUND)
+ return()
+endif()
+
+target_include_directories(liburing INTERFACE ${LIBURING_INCLUDE_DIR})
+target_link_libraries(liburing INTERFACE ${LIBURING_LIBRARY})
+
@@ -0,0 +1,41 @@
+#############################################################################
+# Copyright (c) 2024 One Identity LLC.
+#
+# This library is free software; you can redistribute it and/or
+# modify it under the terms of the GNU Lesser General Public
+# License as published by the Free Software Foundation; either
+# version 2.1 of the License, or (at your option) any later version.
+#
+# This library is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+# Lesser General Public License for more details.
+#
+# You should have received a copy of the GNU Lesser General Public
+# License along with this library; if not, write to the Free Software
+# Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+#
+# As an additional exemption you are allowed to compile & link against the
+# OpenSSL libraries as published by the OpenSSL project. See the file
+# COPYING for details.
+#
+#############################################################################
+
+include(LibFindMacros)
+include(FindPackageHandleStandardArgs)
+
+find_package(PkgConfig)
+
+pkg_check_modules(PC_LIBZSTD libzstd>=1.4.0 QUIET)
+find_path(LIBZSTD_INCLUDE_DIR NAMES zstd.h HINTS ${PC_LIBZSTD_INCLUDE_DIRS})
+find_library(LIBZSTD_LIBRARY  NAMES zstd             HINTS ${PC_LIBZSTD_LIBRARY_DIRS})
+
+add_library(libzstd INTERFACE)
+
+if (NOT PC_LIBZSTD_FOUND)
+ return()
+endif()
+
+target_include_directories(libzstd INTERFACE ${LIBZSTD_INCLUDE_DIR})
+target_link_libraries(libzstd INTERFACE ${LIBZSTD_LIBRARY})
+
@@ -53,6 +53,15 @@ bookmark_save(Bookmark *self)
     }
 }
 
+/* persist_state is set by the AckTracker the destination was requested from */
+static inline void
+bookmark_copy(Bookmark *dst, const Bookmark *src)
+{
+  dst->save = src->save;
+  dst->destroy = src->destroy;
+  dst->container = src->container;
+}
+
 static inline void
 bookmark_destroy(Bookmark *self)
 {
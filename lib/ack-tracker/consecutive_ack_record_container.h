@@ -40,6 +40,7 @@ struct _ConsecutiveAckRecordContainer
   gboolean (*is_empty)(const ConsecutiveAckRecordContainer *s);
   ConsecutiveAckRecord *(*request_pending)(ConsecutiveAckRecordContainer *s);
   void (*store_pending)(ConsecutiveAckRecordContainer *s);
+  void (*ack)(ConsecutiveAckRecordContainer *s, ConsecutiveAckRecord *rec);
   void (*drop)(ConsecutiveAckRecordContainer *s, gsize n);
   ConsecutiveAckRecord *(*at)(const ConsecutiveAckRecordContainer *s, gsize idx);
   void (*free_fn)(ConsecutiveAckRecordContainer *s);
@@ -55,6 +56,7 @@ consecutive_ack_record_destroy(ConsecutiveAckRecord *self)
 
 ConsecutiveAckRecordContainer *consecutive_ack_record_container_static_new(gsize size);
 ConsecutiveAckRecordContainer *consecutive_ack_record_container_dynamic_new(void);
+ConsecutiveAckRecordContainer *consecutive_ack_record_container_compact_new(gsize size);
 
 static inline gboolean
 consecutive_ack_record_container_is_empty(ConsecutiveAckRecordContainer *s)
@@ -80,6 +82,12 @@ consecutive_ack_record_container_size(const ConsecutiveAckRecordContainer *s)
   return s->size(s);
 }
 
+static inline void
+consecutive_ack_record_container_ack(ConsecutiveAckRecordContainer *s, ConsecutiveAckRecord *rec)
+{
+  s->ack(s, rec);
+}
+
 static inline void
 consecutive_ack_record_container_drop(ConsecutiveAckRecordContainer *s, gsize n)
 {
@@ -0,0 +1,211 @@
+/*
+ * Copyright (c) 2024 One Identity LLC.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+
+#include "consecutive_ack_record_container.h"
+#include "ringbuffer.h"
+
+/*
+ * Fixed capacity container for the consecutive ack tracker.  Records live
+ * in the slots of a preallocated ring buffer, the acked state of the slots
+ * is kept in a separate bitmap indexed by the physical slot position, so
+ * finding the acked range at the head of the window does not have to touch
+ * the records themselves and can be done a word at a time.
+ */
+
+#define ACKED_WORD_BITS (sizeof(gulong) * 8)
+
+typedef struct _CompactConsecutiveAckRecordContainer
+{
+  ConsecutiveAckRecordContainer super;
+  RingBuffer ack_records;
+  ConsecutiveAckRecord *pending;
+  gulong *acked;
+} CompactConsecutiveAckRecordContainer;
+
+static inline guint32
+_slot_of(const CompactConsecutiveAckRecordContainer *self, const ConsecutiveAckRecord *ack_rec)
+{
+  return ((const guint8 *) ack_rec - (const guint8 *) self->ack_records.buffer) / self->ack_records.element_size;
+}
+
+static void
+_clear_acked_range(CompactConsecutiveAckRecordContainer *self, guint32 start, guint32 n)
+{
+  while (n > 0)
+    {
+      guint32 bit = start % ACKED_WORD_BITS;
+      guint32 len = MIN(ACKED_WORD_BITS - bit, n);
+      gulong mask = (len == ACKED_WORD_BITS) ? ~0UL : ((1UL << len) - 1) << bit;
+
+      self->acked[start / ACKED_WORD_BITS] &= ~mask;
+      start += len;
+      n -= len;
+    }
+}
+
+/* number of consecutive acked slots from physical position start, at most n, without wrapping */
+static guint32
+_count_acked_run(const CompactConsecutiveAckRecordContainer *self, guint32 start, guint32 n)
+{
+  guint32 run = 0;
+
+  while (run < n)
+    {
+      guint32 pos = start + run;
+      guint32 bit = pos % ACKED_WORD_BITS;
+      guint32 len = MIN(ACKED_WORD_BITS - bit, n - run);
+      gulong unacked = ~(self->acked[pos / ACKED_WORD_BITS] >> bit);
+      gint first_unacked = g_bit_nth_lsf(unacked, -1);
+
+      if (first_unacked >= 0 && first_unacked < len)
+        return run + first_unacked;
+      run += len;
+    }
+
+  return run;
+}
+
+static gboolean
+_is_empty(const ConsecutiveAckRecordContainer *s)
+{
+  CompactConsecutiveAckRecordContainer *self = (CompactConsecutiveAckRecordContainer *)s;
+
+  return ring_buffer_is_empty(&self->ack_records);
+}
+
+static ConsecutiveAckRecord *
+_request_pending(ConsecutiveAckRecordContainer *s)
+{
+  CompactConsecutiveAckRecordContainer *self = (CompactConsecutiveAckRecordContainer *)s;
+
+  if (self->pending)
+    return self->pending;
+
+  self->pending = ring_buffer_tail(&self->ack_records);
+
+  return self->pending;
+}
+
+static void
+_store_pending(ConsecutiveAckRecordContainer *s)
+{
+  CompactConsecutiveAckRecordContainer *self = (CompactConsecutiveAckRecordContainer *)s;
+  g_assert(ring_buffer_push(&self->ack_records) == self->pending);
+  self->pending = NULL;
+}
+
+static void
+_ack(ConsecutiveAckRecordContainer *s, ConsecutiveAckRecord *ack_rec)
+{
+  CompactConsecutiveAckRecordContainer *self = (CompactConsecutiveAckRecordContainer *)s;
+  guint32 slot = _slot_of(self, ack_rec);
+
+  self->acked[slot / ACKED_WORD_BITS] |= 1UL << (slot % ACKED_WORD_BITS);
+}
+
+static void
+_drop(ConsecutiveAckRecordContainer *s, gsize n)
+{
+  CompactConsecutiveAckRecordContainer *self = (CompactConsecutiveAckRecordContainer *)s;
+  guint32 head = self->ack_records.head;
+  guint32 first = MIN(n, self->ack_records.capacity - head);
+
+  for (gsize i = 0; i < n; i++)
+    {
+      ConsecutiveAckRecord *ack_rec = (ConsecutiveAckRecord *)ring_buffer_element_at(&self->ack_records, i);
+
+      consecutive_ack_record_destroy(ack_rec);
+
+      ack_rec->super.bookmark.save = NULL;
+      ack_rec->super.bookmark.destroy = NULL;
+    }
+
+  _clear_acked_range(self, head, first);
+  _clear_acked_range(self, 0, n - first);
+  ring_buffer_drop(&self->ack_records, n);
+}
+
+static ConsecutiveAckRecord *
+_at(const ConsecutiveAckRecordContainer *s, gsize idx)
+{
+  CompactConsecutiveAckRecordContainer *self = (CompactConsecutiveAckRecordContainer *)s;
+
+  return ring_buffer_element_at(&self->ack_records, idx);
+}
+
+static void
+_free(ConsecutiveAckRecordContainer *s)
+{
+  CompactConsecutiveAckRecordContainer *self = (CompactConsecutiveAckRecordContainer *)s;
+
+  _drop(s, ring_buffer_count(&self->ack_records));
+  ring_buffer_free(&self->ack_records);
+  g_free(self->acked);
+
+  g_free(self);
+}
+
+static gsize
+_size(const ConsecutiveAckRecordContainer *s)
+{
+  CompactConsecutiveAckRecordContainer *self = (CompactConsecutiveAckRecordContainer *)s;
+
+  return ring_buffer_count(&self->ack_records);
+}
+
+static gsize
+_get_continual_range_length(const ConsecutiveAckRecordContainer *s)
+{
+  CompactConsecutiveAckRecordContainer *self = (CompactConsecutiveAckRecordContainer *)s;
+  guint32 head = self->ack_records.head;
+  guint32 count = self->ack_records.count;
+  guint32 first = MIN(count, self->ack_records.capacity - head);
+
+  guint32 run = _count_acked_run(self, head, first);
+  if (run < first)
+    return run;
+
+  return run + _count_acked_run(self, 0, count - first);
+}
+
+ConsecutiveAckRecordContainer *
+consecutive_ack_record_container_compact_new(gsize size)
+{
+  CompactConsecutiveAckRecordContainer *self = g_new0(CompactConsecutiveAckRecordContainer, 1);
+
+  self->super.is_empty = _is_empty;
+  self->super.request_pending = _request_pending;
+  self->super.store_pending = _store_pending;
+  self->super.ack = _ack;
+  self->super.drop = _drop;
+  self->super.at = _at;
+  self->super.free_fn = _free;
+  self->super.size = _size;
+  self->super.get_continual_range_length = _get_continual_range_length;
+
+  ring_buffer_alloc(&self->ack_records, sizeof(ConsecutiveAckRecord), size);
+  self->acked = g_new0(gulong, (size + ACKED_WORD_BITS - 1) / ACKED_WORD_BITS);
+
+  return &self->super;
+}
@@ -81,6 +81,12 @@ _free_and_destroy_ack_record(gpointer data)
   g_free(rec);
 }
 
+static void
+_ack(ConsecutiveAckRecordContainer *s, ConsecutiveAckRecord *ack_rec)
+{
+  ack_rec->acked = TRUE;
+}
+
 static void
 _drop(ConsecutiveAckRecordContainer *s, gsize n)
 {
@@ -171,6 +177,7 @@ consecutive_ack_record_container_dynamic_new(void)
   self->super.is_empty = _is_empty;
   self->super.request_pending = _request_pending;
   self->super.store_pending = _store_pending;
+  self->super.ack = _ack;
   self->super.drop = _drop;
   self->super.at = _at;
   self->super.free_fn = _free;
@@ -61,6 +61,12 @@ _store_pending(ConsecutiveAckRecordContainer *s)
   self->pending = NULL;
 }
 
+static void
+_ack(ConsecutiveAckRecordContainer *s, ConsecutiveAckRecord *ack_rec)
+{
+  ack_rec->acked = TRUE;
+}
+
 static void
 _drop(ConsecutiveAckRecordContainer *s, gsize n)
 {
@@ -133,6 +139,7 @@ consecutive_ack_record_container_static_new(gsize size)
   self->super.is_empty = _is_empty;
   self->super.request_pending = _request_pending;
   self->super.store_pending = _store_pending;
+  self->super.ack = _ack;
   self->super.drop = _drop;
   self->super.at = _at;
   self->super.free_fn = _free;
@@ -26,6 +26,15 @@
 #include "consecutive_ack_record_container.h"
 #include "bookmark.h"
 #include "syslog-ng.h"
+#include "timeutils/cache.h"
+
+/*
+ * Bookmarks of acked ranges are written to persist-state at most once per
+ * this many seconds.  The bookmark of the last acked range in between is
+ * held back by the tracker and is saved when the interval elapses or when
+ * the tracker runs empty.
+ */
+#define CONSECUTIVE_ACK_TRACKER_BOOKMARK_SAVE_INTERVAL 1
 
 typedef struct _ConsecutiveAckTracker
 {
@@ -35,6 +44,9 @@ typedef struct _ConsecutiveAckTracker
   GMutex mutex;
   AckTrackerOnAllAcked on_all_acked;
   gboolean bookmark_saving_disabled;
+  Bookmark unsaved_bookmark;
+  gboolean has_unsaved_bookmark;
+  time_t last_bookmark_save;
 } ConsecutiveAckTracker;
 
 void
@@ -113,11 +125,41 @@ _is_bookmark_saving_enabled(ConsecutiveAckTracker *self)
 }
 
 static void
-_ack_record_save_bookmark(ConsecutiveAckRecord *ack_record)
+_discard_unsaved_bookmark(ConsecutiveAckTracker *self)
+{
+  if (!self->has_unsaved_bookmark)
+    return;
+
+  bookmark_destroy(&self->unsaved_bookmark);
+  self->has_unsaved_bookmark = FALSE;
+}
+
+static void
+_flush_unsaved_bookmark(ConsecutiveAckTracker *self, time_t now)
+{
+  if (!self->has_unsaved_bookmark)
+    return;
+
+  bookmark_save(&self->unsaved_bookmark);
+  _discard_unsaved_bookmark(self);
+  self->last_bookmark_save = now;
+}
+
+/* takes over the bookmark of the record, the record itself is dropped right after this */
+static void
+_ack_record_save_bookmark(ConsecutiveAckTracker *self, ConsecutiveAckRecord *ack_record)
 {
   Bookmark *bookmark = &(ack_record->super.bookmark);
 
-  bookmark_save(bookmark);
+  _discard_unsaved_bookmark(self);
+  self->unsaved_bookmark = *bookmark;
+  self->has_unsaved_bookmark = TRUE;
+  bookmark->save = NULL;
+  bookmark->destroy = NULL;
+
+  time_t now = cached_g_current_time_sec();
+  if (now - self->last_bookmark_save >= CONSECUTIVE_ACK_TRACKER_BOOKMARK_SAVE_INTERVAL)
+    _flush_unsaved_bookmark(self, now);
 }
 
 static guint32
@@ -128,9 +170,12 @@ _ack_records_untrack_msg(ConsecutiveAckTracker *self, LogMessage *msg, AckType a
     {
       if (ack_type != AT_ABORTED && _is_bookmark_saving_enabled(self))
         {
-          _ack_record_save_bookmark(consecutive_ack_record_container_at(self->ack_records, ack_range_length - 1));
+          _ack_record_save_bookmark(self, consecutive_ack_record_container_at(self->ack_records, ack_range_length - 1));
         }
       consecutive_ack_record_container_drop(self->ack_records, ack_range_length);
+
+      if (consecutive_ack_record_container_is_empty(self->ack_records))
+        _flush_unsaved_bookmark(self, cached_g_current_time_sec());
     }
 
   return ack_range_length;
@@ -141,13 +186,13 @@ consecutive_ack_tracker_manage_msg_ack(AckTracker *s, LogMessage *msg, AckType a
 {
   ConsecutiveAckTracker *self = (ConsecutiveAckTracker *)s;
   ConsecutiveAckRecord *ack_rec = (ConsecutiveAckRecord *)msg->ack_record;
-  ack_rec->acked = TRUE;
 
   if (ack_type == AT_SUSPENDED)
     log_source_flow_control_suspend(self->super.source);
 
   consecutive_ack_tracker_lock(s);
   {
+    consecutive_ack_record_container_ack(self->ack_records, ack_rec);
     guint32 ack_range_length = _ack_records_untrack_msg(self, msg, ack_type);
     if (ack_range_length > 0)
       {
@@ -156,7 +201,8 @@ consecutive_ack_tracker_manage_msg_ack(AckTracker *s, LogMessage *msg, AckType a
         else
           log_source_flow_control_adjust(self->super.source, ack_range_length);
 
-        if (consecutive_ack_tracker_is_empty(s))
+        /* just like bookmarks, aborted messages do not count as delivered */
+        if (ack_type != AT_ABORTED && consecutive_ack_tracker_is_empty(s))
           consecutive_ack_tracker_on_all_acked_call(s);
       }
   }
@@ -211,6 +257,7 @@ consecutive_ack_tracker_free(AckTracker *s)
 
   g_mutex_clear(&self->mutex);
 
+  _discard_unsaved_bookmark(self);
   consecutive_ack_record_container_free(self->ack_records);
 
   g_free(self);
@@ -224,6 +271,7 @@ consecutive_ack_tracker_disable_bookmark_saving(AckTracker *s)
   consecutive_ack_tracker_lock(s);
   {
     self->bookmark_saving_disabled = TRUE;
+    _discard_unsaved_bookmark(self);
   }
   consecutive_ack_tracker_unlock(s);
 }
@@ -255,7 +303,7 @@ _create_ack_record_container(LogSource *source)
   if (log_source_is_dynamic_window_enabled(source))
     return consecutive_ack_record_container_dynamic_new();
 
-  return consecutive_ack_record_container_static_new(log_source_get_init_window_size(source));
+  return consecutive_ack_record_container_compact_new(log_source_get_init_window_size(source));
 }
 
 AckTracker *
@@ -66,6 +66,13 @@ _set_ack_range(ConsecutiveAckRecordContainer *ack_records, gsize start, gsize n)
     }
 }
 
+static void
+_ack_range(ConsecutiveAckRecordContainer *ack_records, gsize start, gsize n)
+{
+  for (gsize i = start; i < start + n; i++)
+    consecutive_ack_record_container_ack(ack_records, consecutive_ack_record_container_at(ack_records, i));
+}
+
 static void
 _assert_ack_range(ConsecutiveAckRecordContainer *ack_records, gsize start, gsize n, gboolean expected_acked)
 {
@@ -302,3 +309,73 @@ Test(consecutive_ack_record_container_dynamic, store_pending_after_drop_all)
   consecutive_ack_record_container_free(ack_records);
 }
 
+
+Test(consecutive_ack_record_container_compact, is_empty)
+{
+  static const gsize capacity = 32;
+  ConsecutiveAckRecordContainer *ack_records = consecutive_ack_record_container_compact_new(capacity);
+  {
+    cr_expect(consecutive_ack_record_container_is_empty(ack_records));
+    _fill_container(ack_records, capacity, 0);
+    cr_expect_not(consecutive_ack_record_container_is_empty(ack_records));
+    cr_expect_eq(consecutive_ack_record_container_size(ack_records), capacity);
+    cr_expect_null(consecutive_ack_record_container_request_pending(ack_records));
+  }
+  consecutive_ack_record_container_free(ack_records);
+}
+
+Test(consecutive_ack_record_container_compact, get_continual_range_length)
+{
+  static const gsize capacity = 32;
+  ConsecutiveAckRecordContainer *ack_records = consecutive_ack_record_container_compact_new(capacity);
+  {
+    _fill_container(ack_records, capacity, 0);
+    _ack_range(ack_records, 1, 15);
+    cr_expect_eq(consecutive_ack_record_container_get_continual_range_length(ack_records), 0);
+    consecutive_ack_record_container_drop(ack_records, 1); // drop unacked...
+    cr_expect_eq(consecutive_ack_record_container_get_continual_range_length(ack_records), 15);
+  }
+  consecutive_ack_record_container_free(ack_records);
+}
+
+Test(consecutive_ack_record_container_compact, get_continual_range_length_across_words_and_wraparound)
+{
+  static const gsize capacity = 200;
+  ConsecutiveAckRecordContainer *ack_records = consecutive_ack_record_container_compact_new(capacity);
+  {
+    _fill_container(ack_records, capacity, 0);
+    _ack_range(ack_records, 0, 150);
+    cr_expect_eq(consecutive_ack_record_container_get_continual_range_length(ack_records), 150);
+    consecutive_ack_record_container_drop(ack_records, 150);
+
+    _fill_container(ack_records, 150, 200);
+    _assert_indexes(ack_records, capacity, 150);
+    cr_expect_eq(consecutive_ack_record_container_get_continual_range_length(ack_records), 0);
+
+    _ack_range(ack_records, 0, 120);
+    cr_expect_eq(consecutive_ack_record_container_get_continual_range_length(ack_records), 120);
+    _ack_range(ack_records, 121, 79);
+    cr_expect_eq(consecutive_ack_record_container_get_continual_range_length(ack_records), 120);
+    _ack_range(ack_records, 120, 1);
+    cr_expect_eq(consecutive_ack_record_container_get_continual_range_length(ack_records), capacity);
+  }
+  consecutive_ack_record_container_free(ack_records);
+}
+
+Test(consecutive_ack_record_container_compact, reused_slots_start_unacked)
+{
+  static const gsize capacity = 70;
+  ConsecutiveAckRecordContainer *ack_records = consecutive_ack_record_container_compact_new(capacity);
+  {
+    _fill_container(ack_records, capacity, 0);
+    _ack_range(ack_records, 0, capacity);
+    consecutive_ack_record_container_drop(ack_records, capacity);
+    cr_expect(consecutive_ack_record_container_is_empty(ack_records));
+
+    _fill_container(ack_records, capacity, 0);
+    cr_expect_eq(consecutive_ack_record_container_get_continual_range_length(ack_records), 0);
+    _ack_range(ack_records, 0, 65);
+    cr_expect_eq(consecutive_ack_record_container_get_continual_range_length(ack_records), 65);
+  }
+  consecutive_ack_record_container_free(ack_records);
+}
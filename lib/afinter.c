@@ -599,6 +599,7 @@ static void
 afinter_register_posted_hook(gint hook_type, gpointer user_data)
 {
   msg_set_post_func(afinter_message_posted);
+  msg_set_coalesce_repeated_messages(TRUE);
 }
 
 void
@@ -26,14 +26,23 @@
 #include "messages.h"
 #include "children.h"
 #include "dnscache.h"
+#include "host-resolve.h"
 #include "alarms.h"
 #include "stats/stats-registry.h"
 #include "healthcheck/healthcheck-stats.h"
 #include "logmsg/logmsg.h"
+#include "logmsg/logmsg-pool.h"
+#include "logproto/logproto-buffer-pool.h"
 #include "logsource.h"
 #include "logwriter.h"
 #include "afinter.h"
 #include "template/globals.h"
+#include "template/eval-cache.h"
+#include "logwriter-format-cache.h"
+#include "logmatcher.h"
+#include "logmatcher-multi.h"
+#include "rule-profiler.h"
+#include "stack-sampler.h"
 #include "hostname.h"
 #include "mainloop-call.h"
 #include "service-management.h"
@@ -48,6 +57,7 @@
 #include "msg-stats.h"
 #include "timeutils/cache.h"
 #include "multi-line/multi-line-factory.h"
+#include "plugin.h"
 
 #include <iv.h>
 #include <iv_work.h>
@@ -220,7 +230,6 @@ app_startup(void)
   crypto_init();
   hostname_global_init();
   dns_caching_global_init();
-  dns_caching_thread_init();
   afinter_global_init();
   child_manager_init();
   alarm_init();
@@ -232,13 +241,20 @@ app_startup(void)
   log_tags_global_init();
   log_source_global_init();
   log_template_global_init();
+  log_template_eval_cache_global_init();
+  log_writer_format_cache_global_init();
+  log_matcher_global_init();
+  rule_profiler_global_init();
   value_pairs_global_init();
   service_management_init();
   scratch_buffers_allocator_init();
+  log_msg_pool_thread_init();
   nondumpable_setlogger(nondumpable_allocator_msg_debug, nondumpable_allocator_msg_fatal);
   secret_storage_init();
   transport_factory_id_global_init();
   scratch_buffers_global_init();
+  log_msg_pool_global_init();
+  log_proto_buffer_pool_global_init();
   msg_stats_init();
   timeutils_global_init();
   multi_line_global_init();
@@ -274,19 +290,30 @@ app_shutdown(void)
   secret_storage_deinit();
   scratch_buffers_allocator_deinit();
   scratch_buffers_global_deinit();
+  log_msg_pool_thread_deinit();
+  log_proto_buffer_pool_global_deinit();
+  log_msg_pool_global_deinit();
   value_pairs_global_deinit();
+  stack_sampler_global_deinit();
+  rule_profiler_global_deinit();
+  log_multi_matcher_global_deinit();
+  log_matcher_global_deinit();
+  log_writer_format_cache_global_deinit();
+  log_template_eval_cache_global_deinit();
   log_template_global_deinit();
   log_tags_global_deinit();
   log_msg_global_deinit();
+  log_source_global_deinit();
 
   afinter_global_deinit();
+  plugin_global_deinit();
   stats_destroy();
   child_manager_deinit();
   g_list_foreach(application_hooks, (GFunc) g_free, NULL);
   g_list_free(application_hooks);
   g_list_free_full(application_thread_init_hooks, g_free);
   g_list_free_full(application_thread_deinit_hooks, g_free);
-  dns_caching_thread_deinit();
+  host_resolve_global_deinit();
   dns_caching_global_deinit();
   hostname_global_deinit();
   crypto_deinit();
@@ -341,7 +368,7 @@ void
 app_thread_start(void)
 {
   scratch_buffers_allocator_init();
-  dns_caching_thread_init();
+  log_msg_pool_thread_init();
   main_loop_call_thread_init();
   run_application_thread_init_hooks();
 }
@@ -351,7 +378,9 @@ app_thread_stop(void)
 {
   run_application_thread_deinit_hooks();
   main_loop_call_thread_deinit();
-  dns_caching_thread_deinit();
+  log_msg_pool_thread_deinit();
   scratch_buffers_allocator_deinit();
   timeutils_cache_deinit();
+  log_matcher_thread_deinit();
+  log_multi_matcher_thread_deinit();
 }
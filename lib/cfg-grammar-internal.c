@@ -47,6 +47,7 @@ StatsOptions *last_stats_options;
 HealthCheckStatsOptions *last_healthcheck_options;
 DNSCacheOptions *last_dns_cache_options;
 LogRewrite *last_rewrite;
+LogQueuePriorityLaneOptions *last_priority_lane_options;
 CfgArgs *last_block_args;
 DNSCacheOptions *last_dns_cache_options;
 MultiLineOptions *last_multi_line_options;
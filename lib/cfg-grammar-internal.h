@@ -87,6 +87,7 @@ extern LogRewrite *last_rewrite;
 extern CfgArgs *last_block_args;
 extern DNSCacheOptions *last_dns_cache_options;
 extern MultiLineOptions *last_multi_line_options;
+extern LogQueuePriorityLaneOptions *last_priority_lane_options;
 
 
 #endif
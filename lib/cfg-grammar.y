@@ -196,6 +196,15 @@
 %token KW_SYSLOG_STATS                10405
 %token KW_HEALTHCHECK_FREQ            10406
 %token KW_WORKER_PARTITION_KEY        10407
+%token KW_WORK_STEALING               10408
+%token KW_MAX_INFLIGHT_BATCHES        10409
+%token KW_BATCH_BYTES                 10412
+%token KW_ADAPTIVE_BATCHING           10413
+%token KW_HOT_KEY_THRESHOLD           10414
+%token KW_HOT_KEY_SPREAD              10415
+%token KW_HISTOGRAM_BUCKETS           10416
+%token KW_LATENCY_TRACE_SAMPLING      10417
+%token KW_LAZY_REGISTRATION           10418
 
 %token KW_CHAIN_HOSTNAMES             10090
 %token KW_NORMALIZE_HOSTNAMES         10091
@@ -203,6 +212,7 @@
 %token KW_CHECK_HOSTNAME              10093
 %token KW_BAD_HOSTNAME                10094
 %token KW_LOG_LEVEL                   10095
+%token KW_SKIP_UNCHANGED_RELOAD       10096
 
 %token KW_KEEP_TIMESTAMP              10100
 
@@ -220,20 +230,27 @@
 %token KW_PERSIST_ONLY                10140
 %token KW_USE_RCPTID                  10141
 %token KW_USE_UNIQID                  10142
+%token KW_ASYNC                       10143
 
 %token KW_TZ_CONVERT                  10150
 %token KW_TS_FORMAT                   10151
 %token KW_FRAC_DIGITS                 10152
 
 %token KW_LOG_FIFO_SIZE               10160
+%token KW_MEMORY_QUEUE_TYPE           10161
 %token KW_LOG_FETCH_LIMIT             10162
 %token KW_LOG_IW_SIZE                 10163
 %token KW_LOG_PREFIX                  10164
 %token KW_PROGRAM_OVERRIDE            10165
 %token KW_HOST_OVERRIDE               10166
+%token KW_QUEUE_MEMORY_BUDGET         10167
+%token KW_PRIORITY_LANE               10168
+%token KW_PRIORITY_LANE_KEY           10169
 
 %token KW_THROTTLE                    10170
 %token KW_THREADED                    10171
+%token KW_WEIGHT                      10172
+%token KW_LOG_IW_SIZE_BYTES           10173
 
 %token KW_PASS_UNIX_CREDENTIALS       10180
 %token KW_PERSIST_NAME                10181
@@ -267,6 +284,9 @@
 %token KW_PARTITIONS                  10213
 %token KW_PARTITION_KEY               10214
 %token KW_PARALLELIZE                 10215
+%token KW_PARTITION_THREADS           10216
+%token KW_PRESERVE_ORDER              10217
+%token KW_RESEQUENCE                  10218
 
 /* destination options */
 %token KW_TMPL_ESCAPE                 10220
@@ -276,6 +296,7 @@
 
 /* file related options */
 %token KW_CREATE_DIRS                 10240
+%token KW_IO_URING                    10241
 
 %token KW_OWNER                       10250
 %token KW_GROUP                       10251
@@ -288,6 +309,7 @@
 %token KW_TEMPLATE                    10270
 %token KW_TEMPLATE_ESCAPE             10271
 %token KW_TEMPLATE_FUNCTION           10272
+%token KW_TEMPLATE_CACHE              10273
 
 %token KW_DEFAULT_FACILITY            10300
 %token KW_DEFAULT_SEVERITY            10301
@@ -712,6 +734,10 @@ log_scheduler
             $<ptr>$ = scheduler_pipe;
           }
           log_scheduler_options ')'             { $$ = log_expr_node_new_pipe($<ptr>3, &@$); }
+        | KW_RESEQUENCE '(' ')'
+          {
+            $$ = log_expr_node_new_pipe(log_resequence_pipe_new(configuration), &@$);
+          }
         ;
 
 log_scheduler_options
@@ -728,6 +754,14 @@ log_scheduler_option
           {
             log_scheduler_options_set_partition_key_ref(last_scheduler_options, $3);
           }
+        | KW_PARTITION_THREADS '(' yesno ')'
+          {
+            last_scheduler_options->partition_threads = $3;
+          }
+        | KW_PRESERVE_ORDER '(' yesno ')'
+          {
+            last_scheduler_options->preserve_order = $3;
+          }
         ;
 
 
@@ -880,6 +914,7 @@ template_items
 template_item
 	: KW_TEMPLATE '(' { $<ptr>$ = $<ptr>0; } template_content_inner ')'
 	| KW_TEMPLATE_ESCAPE '(' yesno ')'	{ log_template_set_escape($<ptr>0, $3); }
+	| KW_TEMPLATE_CACHE '(' yesno ')'	{ log_template_set_cache_results($<ptr>0, $3); }
 	;
 
 /* START_RULES */
@@ -1009,18 +1044,21 @@ options_item
 	| KW_USE_RCPTID '(' yesno ')'		{ cfg_set_use_uniqid($3); }
 	| KW_USE_UNIQID '(' yesno ')'		{ cfg_set_use_uniqid($3); }
 	| KW_LOG_FIFO_SIZE '(' positive_integer ')'	{ configuration->log_fifo_size = $3; }
+	| KW_QUEUE_MEMORY_BUDGET '(' nonnegative_integer64 ')'	{ configuration->queue_memory_budget = $3; }
 	| KW_LOG_IW_SIZE '(' positive_integer ')'	{ msg_warning("WARNING: Support for the global log-iw-size() option was removed, please use a per-source log-iw-size()", cfg_lexer_format_location_tag(lexer, &@1)); }
 	| KW_LOG_FETCH_LIMIT '(' positive_integer ')'	{ msg_warning("WARNING: Support for the global log-fetch-limit() option was removed, please use a per-source log-fetch-limit()", cfg_lexer_format_location_tag(lexer, &@1)); }
 	| KW_LOG_MSG_SIZE '(' positive_integer ')'	{ configuration->log_msg_size = $3; }
 	| KW_TRIM_LARGE_MESSAGES '(' yesno ')'	{ configuration->trim_large_messages = $3; }
 	| KW_KEEP_TIMESTAMP '(' yesno ')'	{ configuration->keep_timestamp = $3; }
 	| KW_CREATE_DIRS '(' yesno ')'		{ configuration->create_dirs = $3; }
+	| KW_IO_URING '(' yesno ')'		{ cfg_set_use_io_uring(configuration, $3); }
 	| KW_CUSTOM_DOMAIN '(' string ')'	{ configuration->custom_domain = g_strdup($3); free($3); }
 	| KW_FILE_TEMPLATE '(' string ')'	{ configuration->file_template_name = g_strdup($3); free($3); }
 	| KW_PROTO_TEMPLATE '(' string ')'	{ configuration->proto_template_name = g_strdup($3); free($3); }
 	| KW_RECV_TIME_ZONE '(' string ')'	{ configuration->recv_time_zone = g_strdup($3); free($3); }
 	| KW_MIN_IW_SIZE_PER_READER '(' positive_integer ')' { configuration->min_iw_size_per_reader = $3; }
 	| KW_LOG_LEVEL '(' string ')'		{ CHECK_ERROR(cfg_set_log_level(configuration, $3), @3, "Unknown log-level() option"); free($3); }
+	| KW_SKIP_UNCHANGED_RELOAD '(' yesno ')' { configuration->skip_unchanged_reload = $3; }
 	| { last_template_options = &configuration->template_options; } template_option
 	| { last_host_resolve_options = &configuration->host_resolve_options; } host_resolve_option
 	| { last_stats_options = &configuration->stats_options; last_healthcheck_options = &configuration->healthcheck_options; } stat_option
@@ -1059,6 +1097,22 @@ stats_group_option
 	| KW_MAX_DYNAMIC '(' nonnegative_integer ')'   { last_stats_options->max_dynamic = $3; }
 	| KW_SYSLOG_STATS '(' yesnoauto ')'     { last_stats_options->syslog_stats = $3; }
 	| KW_HEALTHCHECK_FREQ '(' nonnegative_integer ')' { last_healthcheck_options->freq = $3; }
+	| KW_HISTOGRAM_BUCKETS '(' { last_stats_options->num_histogram_buckets = 0; } stats_histogram_buckets ')'
+	| KW_LATENCY_TRACE_SAMPLING '(' nonnegative_integer ')' { last_stats_options->latency_trace_sampling = $3; }
+	| KW_LAZY_REGISTRATION '(' yesno ')'	{ last_stats_options->lazy_registration = $3; }
+	;
+
+stats_histogram_buckets
+	: stats_histogram_bucket stats_histogram_buckets
+	| stats_histogram_bucket
+	;
+
+stats_histogram_bucket
+	: positive_float
+	  {
+	    CHECK_ERROR(stats_options_add_histogram_bucket(last_stats_options, $1), @1,
+	                "histogram-buckets() must be increasing and at most %d buckets are allowed", STATS_HISTOGRAM_MAX_BUCKETS);
+	  }
 	;
 
 dns_cache_option
@@ -1096,7 +1150,8 @@ yesnoauto
 
 dnsmode
 	: yesno					{ $$ = $1; }
-	| KW_PERSIST_ONLY                       { $$ = 2; }
+	| KW_PERSIST_ONLY                       { $$ = HOST_RESOLVE_USE_DNS_PERSIST_ONLY; }
+	| KW_ASYNC                              { $$ = HOST_RESOLVE_USE_DNS_ASYNC; }
 	;
 
 nonnegative_integer64
@@ -1296,18 +1351,47 @@ dest_driver_option
 
 	: KW_LOG_FIFO_SIZE '(' positive_integer ')'	{ ((LogDestDriver *) last_driver)->log_fifo_size = $3; }
 	| KW_THROTTLE '(' nonnegative_integer ')'         { ((LogDestDriver *) last_driver)->throttle = $3; }
+	| KW_MEMORY_QUEUE_TYPE '(' string ')'
+          {
+            CHECK_ERROR(log_dest_driver_set_memory_queue_type(last_driver, $3), @3, "Unknown memory-queue-type() %s, expected fifo, ring or priority", $3);
+            free($3);
+          }
+	| KW_PRIORITY_LANE_KEY '(' template_content ')'	{ log_dest_driver_set_priority_lane_key_ref(last_driver, $3); }
+	| KW_PRIORITY_LANE
+          {
+            last_priority_lane_options = log_queue_priority_lane_options_new();
+            log_dest_driver_add_priority_lane(last_driver, last_priority_lane_options);
+          }
+          '(' priority_lane_options ')'
         | inner_dest
         | driver_option
         ;
 
+priority_lane_options
+	: priority_lane_option priority_lane_options
+	|
+	;
+
+priority_lane_option
+	: KW_WEIGHT '(' positive_integer ')'	{ last_priority_lane_options->weight = $3; }
+	| KW_LOG_FIFO_SIZE '(' positive_integer ')'	{ last_priority_lane_options->log_fifo_size = $3; }
+	;
+
 threaded_dest_driver_batch_option
         : KW_BATCH_LINES '(' nonnegative_integer ')' { log_threaded_dest_driver_set_batch_lines(last_driver, $3); }
         | KW_BATCH_TIMEOUT '(' positive_integer ')' { log_threaded_dest_driver_set_batch_timeout(last_driver, $3); }
+        | KW_MAX_INFLIGHT_BATCHES '(' positive_integer ')' { log_threaded_dest_driver_set_max_inflight_batches(last_driver, $3); }
+        | KW_BATCH_BYTES '(' nonnegative_integer ')' { log_threaded_dest_driver_set_batch_bytes(last_driver, $3); }
+        | KW_ADAPTIVE_BATCHING '(' yesno ')' { log_threaded_dest_driver_set_adaptive_batching(last_driver, $3); }
         ;
 
 threaded_dest_driver_workers_option
         : KW_WORKERS '(' positive_integer ')'  { log_threaded_dest_driver_set_num_workers(last_driver, $3); }
+        | KW_WORKERS '(' positive_integer positive_integer ')'  { log_threaded_dest_driver_set_num_workers_range(last_driver, $3, $4); }
         | KW_WORKER_PARTITION_KEY '(' template_content ')' { log_threaded_dest_driver_set_worker_partition_key_ref(last_driver, $3); }
+        | KW_WORK_STEALING '(' yesno ')' { log_threaded_dest_driver_set_work_stealing(last_driver, $3); }
+        | KW_HOT_KEY_THRESHOLD '(' nonnegative_integer ')' { log_threaded_dest_driver_set_hot_key_threshold(last_driver, $3); }
+        | KW_HOT_KEY_SPREAD '(' yesno ')' { log_threaded_dest_driver_set_hot_key_spread(last_driver, $3); }
         ;
 
 /* implies dest_driver_option */
@@ -1347,6 +1431,7 @@ threaded_source_driver_option_flags
 source_option
         /* NOTE: plugins need to set "last_source_options" in order to incorporate this rule in their grammar */
 	: KW_LOG_IW_SIZE '(' positive_integer ')'	{ last_source_options->init_window_size = $3; }
+	| KW_LOG_IW_SIZE_BYTES '(' positive_integer ')'	{ last_source_options->init_window_bytes = $3; }
 	| KW_CHAIN_HOSTNAMES '(' yesno ')'	{ last_source_options->chain_hostnames = $3; }
 	| KW_KEEP_HOSTNAME '(' yesno ')'	{ last_source_options->keep_hostname = $3; }
 	| KW_PROGRAM_OVERRIDE '(' string ')'	{ last_source_options->program_override = g_strdup($3); free($3); }
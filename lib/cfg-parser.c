@@ -102,7 +102,11 @@ static CfgLexerKeyword main_keywords[] =
   { "max_dynamics",       KW_MAX_DYNAMIC },
   { "syslog_stats",       KW_SYSLOG_STATS },
   { "healthcheck_freq",   KW_HEALTHCHECK_FREQ},
+  { "histogram_buckets",  KW_HISTOGRAM_BUCKETS },
+  { "latency_trace_sampling", KW_LATENCY_TRACE_SAMPLING },
+  { "lazy_registration",  KW_LAZY_REGISTRATION },
   { "min_iw_size_per_reader", KW_MIN_IW_SIZE_PER_READER },
+  { "skip_unchanged_reload", KW_SKIP_UNCHANGED_RELOAD },
   { "flush_lines",        KW_FLUSH_LINES },
   { "flush_timeout",      KW_FLUSH_TIMEOUT, KWS_OBSOLETE, "Some drivers support batch-timeout() instead that you can specify at the destination level." },
   { "suppress",           KW_SUPPRESS },
@@ -143,8 +147,14 @@ static CfgLexerKeyword main_keywords[] =
   { "log_level",          KW_LOG_LEVEL },
 
   { "log_fifo_size",      KW_LOG_FIFO_SIZE },
+  { "memory_queue_type",  KW_MEMORY_QUEUE_TYPE },
+  { "queue_memory_budget", KW_QUEUE_MEMORY_BUDGET },
+  { "priority_lane",      KW_PRIORITY_LANE },
+  { "priority_lane_key",  KW_PRIORITY_LANE_KEY },
+  { "weight",             KW_WEIGHT },
   { "log_fetch_limit",    KW_LOG_FETCH_LIMIT },
   { "log_iw_size",        KW_LOG_IW_SIZE },
+  { "log_iw_size_bytes",  KW_LOG_IW_SIZE_BYTES },
   { "log_msg_size",       KW_LOG_MSG_SIZE },
   { "trim_large_messages", KW_TRIM_LARGE_MESSAGES },
   { "log_prefix",         KW_LOG_PREFIX, KWS_OBSOLETE, "program_override" },
@@ -153,6 +163,7 @@ static CfgLexerKeyword main_keywords[] =
   { "throttle",           KW_THROTTLE },
 
   { "create_dirs",        KW_CREATE_DIRS },
+  { "io_uring",           KW_IO_URING },
   { "optional",           KW_OPTIONAL },
 
   { "owner",              KW_OWNER },
@@ -164,8 +175,10 @@ static CfgLexerKeyword main_keywords[] =
   { "template",           KW_TEMPLATE },
   { "template_escape",    KW_TEMPLATE_ESCAPE },
   { "template_function",  KW_TEMPLATE_FUNCTION },
+  { "template_cache",     KW_TEMPLATE_CACHE },
   { "on_error",           KW_ON_ERROR },
   { "persist_only",       KW_PERSIST_ONLY },
+  { "async",              KW_ASYNC },
   { "dns_cache_hosts",    KW_DNS_CACHE_HOSTS },
   { "dns_cache",          KW_DNS_CACHE },
   { "dns_cache_size",     KW_DNS_CACHE_SIZE },
@@ -182,8 +195,14 @@ static CfgLexerKeyword main_keywords[] =
   { "retries",            KW_RETRIES },
   { "workers",            KW_WORKERS },
   { "worker_partition_key", KW_WORKER_PARTITION_KEY },
+  { "work_stealing",      KW_WORK_STEALING },
+  { "hot_key_threshold",  KW_HOT_KEY_THRESHOLD },
+  { "hot_key_spread",     KW_HOT_KEY_SPREAD },
   { "batch_lines",        KW_BATCH_LINES },
   { "batch_timeout",      KW_BATCH_TIMEOUT },
+  { "max_inflight_batches", KW_MAX_INFLIGHT_BATCHES },
+  { "batch_bytes",        KW_BATCH_BYTES },
+  { "adaptive_batching",  KW_ADAPTIVE_BATCHING },
 
   { "read_old_records",   KW_READ_OLD_RECORDS},
   { "use_syslogng_pid",   KW_USE_SYSLOGNG_PID },
@@ -197,6 +216,9 @@ static CfgLexerKeyword main_keywords[] =
   { "parallelize",        KW_PARALLELIZE },
   { "partitions",         KW_PARTITIONS },
   { "partition_key",      KW_PARTITION_KEY },
+  { "partition_threads",  KW_PARTITION_THREADS },
+  { "preserve_order",     KW_PRESERVE_ORDER },
+  { "resequence",         KW_RESEQUENCE },
 
   /* filter items */
   { "type",               KW_TYPE },
@@ -24,6 +24,8 @@
 
 #include "cfg-tree.h"
 #include "logmpx.h"
+#include "logdispatch.h"
+#include "filter/filter-pipe.h"
 #include "logpipe.h"
 #include "metrics-pipe.h"
 
@@ -731,6 +733,28 @@ cfg_tree_get_child_id(CfgTree *self, gint content, LogExprNode *node)
   return res;
 }
 
+/*
+ * Assigns a slot in LogMessage->filter_results to the filter rule named
+ * @rule_name.  All the clones of a rule (e.g. the ones created for each
+ * log path referencing it) get the same slot.  Returns -1 if all slots
+ * are taken.
+ */
+gint
+cfg_tree_allocate_filter_result_slot(CfgTree *self, const gchar *rule_name)
+{
+  gpointer slot;
+
+  if (g_hash_table_lookup_extended(self->filter_result_slots, rule_name, NULL, &slot))
+    return GPOINTER_TO_INT(slot);
+
+  gint new_slot = g_hash_table_size(self->filter_result_slots);
+  if (new_slot >= LOGMSG_FILTER_RESULT_SLOTS)
+    return -1;
+
+  g_hash_table_insert(self->filter_result_slots, g_strdup(rule_name), GINT_TO_POINTER(new_slot));
+  return new_slot;
+}
+
 /* hash foreach function to add all source objects to catch-all rules */
 static void
 cfg_tree_add_all_sources(gpointer key, gpointer value, gpointer user_data)
@@ -1272,6 +1296,260 @@ error:
   return FALSE;
 }
 
+/* if/elif chains with at least this many conditions that compare the same
+ * name-value pair with constant strings (or match it against patterns the
+ * multi-pattern engine can compile) are compiled into a LogDispatcher */
+#define CFG_TREE_DISPATCH_MIN_BRANCHES 4
+
+/* returns the conditional of an elif, which is the only element of the false branch */
+static LogExprNode *
+_get_elif_conditional(LogExprNode *conditional)
+{
+  LogExprNode *false_branch = conditional->children->next;
+  LogExprNode *child = false_branch->children;
+
+  if (false_branch->layout != ENL_SEQUENCE || !child || child->next || child->layout != ENL_CONDITIONAL)
+    return NULL;
+  return child;
+}
+
+/* returns the pipe of the condition, if it consists of a single filter */
+static LogPipe *
+_get_conditional_filter_pipe(LogExprNode *conditional)
+{
+  LogExprNode *filter_expr = conditional->children->next->next;
+
+  if (!filter_expr || filter_expr->layout != ENL_SEQUENCE)
+    return NULL;
+
+  LogExprNode *filter_node = filter_expr->children;
+  if (!filter_node || filter_node->next || filter_node->layout != ENL_SINGLE)
+    return NULL;
+
+  return (LogPipe *) filter_node->object;
+}
+
+static gboolean
+_get_conditional_equality_keys(LogExprNode *conditional, NVHandle *handle, GPtrArray *keys)
+{
+  LogPipe *filter_pipe = _get_conditional_filter_pipe(conditional);
+
+  return filter_pipe && log_filter_pipe_get_equality_keys(filter_pipe, handle, keys);
+}
+
+static gboolean
+_get_conditional_value_matchers(LogExprNode *conditional, NVHandle *handle, GPtrArray *matchers)
+{
+  LogPipe *filter_pipe = _get_conditional_filter_pipe(conditional);
+
+  return filter_pipe && log_filter_pipe_get_value_matchers(filter_pipe, handle, matchers);
+}
+
+/*
+ * Collects the conditionals of the if/elif chain starting at @node, as long
+ * as their conditions are equality tests on the same name-value pair, e.g.
+ *
+ *   if (program("sshd" type("string"))) { ... }
+ *   elif (program("^sudo$")) { ... }
+ *   elif (program("cron" type("string")) or program("crond" type("string"))) { ... }
+ *
+ * The strings selecting the individual conditionals are stored in @branch_keys.
+ */
+static void
+_collect_dispatchable_conditionals(LogExprNode *node, NVHandle *handle,
+                                   GPtrArray *conditionals, GPtrArray *branch_keys)
+{
+  *handle = LM_V_NONE;
+  for (LogExprNode *conditional = node; conditional; conditional = _get_elif_conditional(conditional))
+    {
+      GPtrArray *keys = g_ptr_array_new_with_free_func(g_free);
+
+      if (!_get_conditional_equality_keys(conditional, handle, keys))
+        {
+          g_ptr_array_unref(keys);
+          break;
+        }
+      g_ptr_array_add(conditionals, conditional);
+      g_ptr_array_add(branch_keys, keys);
+    }
+}
+
+/*
+ * Collects the conditionals of the if/elif chain starting at @node, as long
+ * as their conditions match the same name-value pair against patterns, e.g.
+ *
+ *   if (message("Failed password for .* from")) { ... }
+ *   elif (message("session opened for user")) { ... }
+ *   elif (message("^Accepted (password|publickey)") or message("pam_unix")) { ... }
+ *
+ * The matchers of the conditions are added to @matcher, identified by the
+ * index of their conditional.
+ */
+static void
+_collect_matchable_conditionals(LogExprNode *node, NVHandle *handle,
+                                GPtrArray *conditionals, LogMultiMatcher *matcher)
+{
+  *handle = LM_V_NONE;
+  for (LogExprNode *conditional = node; conditional; conditional = _get_elif_conditional(conditional))
+    {
+      GPtrArray *matchers = g_ptr_array_new();
+
+      if (!_get_conditional_value_matchers(conditional, handle, matchers))
+        {
+          g_ptr_array_unref(matchers);
+          break;
+        }
+      for (guint i = 0; i < matchers->len; i++)
+        log_multi_matcher_add(matcher, g_ptr_array_index(matchers, i), conditionals->len);
+      g_ptr_array_add(conditionals, conditional);
+      g_ptr_array_unref(matchers);
+    }
+}
+
+/*
+ * Compiles an if/elif chain into @dispatcher, which looks up (or matches)
+ * the branch to take based on the value instead of evaluating the
+ * conditions one by one.  The branches are the same as with the chain of
+ * multiplexers: the filter (which is known to match at this point, but
+ * maintains its statistics and stores the matches) and the contents of the
+ * true branch, separated by a conditional-midpoint.  The false branch of
+ * the last conditional is the default branch.  @branch_keys is NULL if the
+ * dispatcher selects the branches with a matcher.
+ *
+ * The nodes are compiled in the same order as cfg_tree_compile_conditional()
+ * would, so that anonymous rules get the same names.
+ */
+static gboolean
+cfg_tree_compile_dispatcher(CfgTree *self, LogExprNode *node, LogDispatcher *dispatcher,
+                            GPtrArray *conditionals, GPtrArray *branch_keys,
+                            LogPipe **outer_pipe_head, LogPipe **outer_pipe_tail)
+{
+  LogPipe *join_pipe;
+  LogPipe **true_pipe_heads = g_new0(LogPipe *, conditionals->len);
+  LogPipe *true_pipe_tail;
+  LogPipe *false_pipe_head, *false_pipe_tail;
+  gboolean success = FALSE;
+
+  msg_debug("Compiling if/elif chain into a dispatcher",
+            evt_tag_int("branches", conditionals->len),
+            evt_tag_str("method", branch_keys ? "lookup" : "multi-pattern"),
+            log_expr_node_location_tag(node));
+
+  cfg_tree_assoc_pipe(self, node, &dispatcher->super, "dispatcher(conditional)");
+  join_pipe = cfg_tree_new_pipe(self, node, "conditional-end");
+  join_pipe->flags |= PIF_JUNCTION_END;
+
+  for (guint i = 0; i < conditionals->len; i++)
+    {
+      LogExprNode *conditional = g_ptr_array_index(conditionals, i);
+
+      if (!cfg_tree_compile_node(self, conditional->children, &true_pipe_heads[i], &true_pipe_tail))
+        goto exit;
+      log_pipe_append(true_pipe_tail, join_pipe);
+    }
+
+  LogExprNode *last_conditional = g_ptr_array_index(conditionals, conditionals->len - 1);
+  if (!cfg_tree_compile_node(self, last_conditional->children->next, &false_pipe_head, &false_pipe_tail))
+    goto exit;
+  log_pipe_append(false_pipe_tail, join_pipe);
+
+  for (gint i = conditionals->len - 1; i >= 0; i--)
+    {
+      LogExprNode *conditional = g_ptr_array_index(conditionals, i);
+      LogPipe *filter_pipe_head, *filter_pipe_tail;
+
+      if (!cfg_tree_compile_node(self, conditional->children->next->next, &filter_pipe_head, &filter_pipe_tail))
+        goto exit;
+
+      LogPipe *midpoint_pipe = cfg_tree_new_pipe(self, conditional, "conditional-midpoint");
+      midpoint_pipe->flags |= PIF_CONDITIONAL_MIDPOINT;
+
+      log_pipe_append(filter_pipe_tail, midpoint_pipe);
+      log_pipe_append(midpoint_pipe, true_pipe_heads[i]);
+      true_pipe_heads[i] = filter_pipe_head;
+    }
+
+  for (guint i = 0; i < conditionals->len; i++)
+    log_dispatcher_add_branch(dispatcher, true_pipe_heads[i], branch_keys ? g_ptr_array_index(branch_keys, i) : NULL);
+  log_dispatcher_set_default_branch(dispatcher, false_pipe_head);
+
+  if (outer_pipe_head)
+    *outer_pipe_head = &dispatcher->super;
+  if (outer_pipe_tail)
+    *outer_pipe_tail = join_pipe;
+  success = TRUE;
+
+exit:
+  g_free(true_pipe_heads);
+  return success;
+}
+
+static gboolean
+cfg_tree_try_compile_lookup_dispatcher(CfgTree *self, LogExprNode *node,
+                                       LogPipe **outer_pipe_head, LogPipe **outer_pipe_tail, gboolean *success)
+{
+  GPtrArray *conditionals = g_ptr_array_new();
+  GPtrArray *branch_keys = g_ptr_array_new_with_free_func((GDestroyNotify) g_ptr_array_unref);
+  NVHandle handle;
+  gboolean dispatched = FALSE;
+
+  _collect_dispatchable_conditionals(node, &handle, conditionals, branch_keys);
+  if (conditionals->len >= CFG_TREE_DISPATCH_MIN_BRANCHES)
+    {
+      *success = cfg_tree_compile_dispatcher(self, node, log_dispatcher_new(self->cfg, handle),
+                                             conditionals, branch_keys,
+                                             outer_pipe_head, outer_pipe_tail);
+      dispatched = TRUE;
+    }
+
+  g_ptr_array_unref(branch_keys);
+  g_ptr_array_unref(conditionals);
+  return dispatched;
+}
+
+/*
+ * Chains of pattern matches are only worth dispatching if the
+ * multi-pattern engine takes over enough of the patterns, the rest are
+ * matched one by one by the dispatcher, just like the chain would.
+ */
+static gboolean
+cfg_tree_try_compile_matcher_dispatcher(CfgTree *self, LogExprNode *node,
+                                        LogPipe **outer_pipe_head, LogPipe **outer_pipe_tail, gboolean *success)
+{
+  GPtrArray *conditionals = g_ptr_array_new();
+  LogMultiMatcher *matcher = log_multi_matcher_new();
+  NVHandle handle;
+  gboolean dispatched = FALSE;
+
+  _collect_matchable_conditionals(node, &handle, conditionals, matcher);
+  if (conditionals->len >= CFG_TREE_DISPATCH_MIN_BRANCHES)
+    log_multi_matcher_compile(matcher);
+
+  if (log_multi_matcher_get_compiled_count(matcher) >= CFG_TREE_DISPATCH_MIN_BRANCHES)
+    {
+      LogDispatcher *dispatcher = log_dispatcher_new(self->cfg, handle);
+
+      log_dispatcher_set_matcher(dispatcher, matcher);
+      matcher = NULL;
+      *success = cfg_tree_compile_dispatcher(self, node, dispatcher, conditionals, NULL,
+                                             outer_pipe_head, outer_pipe_tail);
+      dispatched = TRUE;
+    }
+
+  if (matcher)
+    log_multi_matcher_free(matcher);
+  g_ptr_array_unref(conditionals);
+  return dispatched;
+}
+
+static gboolean
+cfg_tree_try_compile_dispatcher(CfgTree *self, LogExprNode *node,
+                                LogPipe **outer_pipe_head, LogPipe **outer_pipe_tail, gboolean *success)
+{
+  return cfg_tree_try_compile_lookup_dispatcher(self, node, outer_pipe_head, outer_pipe_tail, success) ||
+         cfg_tree_try_compile_matcher_dispatcher(self, node, outer_pipe_head, outer_pipe_tail, success);
+}
+
 /**
  * cfg_tree_compile_conditional():
  **/
@@ -1283,10 +1561,14 @@ cfg_tree_compile_conditional(CfgTree *self,
   LogPipe *join_pipe = NULL;    /* the pipe where parallel branches are joined in a junction */
   LogPipe *midpoint_pipe = NULL;
   LogMultiplexer *fork_mpx = NULL;
+  gboolean success;
 
   /* LC_XXX flags are currently only implemented for sequences, ensure that the grammar enforces this. */
   g_assert(node->flags == 0);
 
+  if (cfg_tree_try_compile_dispatcher(self, node, outer_pipe_head, outer_pipe_tail, &success))
+    return success;
+
   LogExprNode *true_branch = node->children;
   LogExprNode *false_branch = node->children->next;
   LogExprNode *filter_expr = node->children->next->next;
@@ -1663,6 +1945,7 @@ cfg_tree_init_instance(CfgTree *self, GlobalConfig *cfg)
                                         (GDestroyNotify) log_expr_node_unref);
   self->templates = g_hash_table_new_full(g_str_hash, g_str_equal, NULL, (GDestroyNotify) log_template_unref);
   self->log_path_names = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+  self->filter_result_slots = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
   self->rules = g_ptr_array_new();
   self->cfg = cfg;
 }
@@ -1679,6 +1962,7 @@ cfg_tree_free_instance(CfgTree *self)
   g_hash_table_destroy(self->objects);
   g_hash_table_destroy(self->templates);
   g_hash_table_destroy(self->log_path_names);
+  g_hash_table_destroy(self->filter_result_slots);
 
   self->cfg = NULL;
 }
@@ -173,6 +173,8 @@ typedef struct _CfgTree
   GHashTable *templates;
   gboolean compiled;
   GHashTable *log_path_names;
+  /* filter rule name -> slot in LogMessage->filter_results */
+  GHashTable *filter_result_slots;
 } CfgTree;
 
 gboolean cfg_tree_add_object(CfgTree *self, LogExprNode *rule);
@@ -185,6 +187,7 @@ LogTemplate *cfg_tree_check_inline_template(CfgTree *self, const gchar *template
 
 gchar *cfg_tree_get_rule_name(CfgTree *self, gint content, LogExprNode *node);
 gchar *cfg_tree_get_child_id(CfgTree *self, gint content, LogExprNode *node);
+gint cfg_tree_allocate_filter_result_slot(CfgTree *self, const gchar *rule_name);
 
 gboolean cfg_tree_compile(CfgTree *self);
 gboolean cfg_tree_start(CfgTree *self);
@@ -36,6 +36,7 @@
 #include "plugin.h"
 #include "cfg-parser.h"
 #include "stats/stats-registry.h"
+#include "logqueue.h"
 #include "logproto/logproto-builtins.h"
 #include "reloc.h"
 #include "hostname.h"
@@ -83,6 +84,17 @@ cfg_bad_hostname_set(GlobalConfig *self, gchar *bad_hostname_re)
   self->bad_hostname_re = g_strdup(bad_hostname_re);
 }
 
+void
+cfg_set_use_io_uring(GlobalConfig *self, gboolean use_io_uring)
+{
+#if !SYSLOG_NG_ENABLE_IO_URING
+  if (use_io_uring)
+    msg_warning("WARNING: io-uring() was requested, but syslog-ng was compiled without io_uring support, "
+                "using plain file writes");
+#endif
+  self->use_io_uring = use_io_uring;
+}
+
 gint
 cfg_lookup_mark_mode(const gchar *mark_mode)
 {
@@ -318,6 +330,7 @@ cfg_init(GlobalConfig *cfg)
     return FALSE;
 
   stats_reinit(&cfg->stats_options);
+  log_queue_set_global_memory_budget(cfg->queue_memory_budget);
 
   dns_caching_update_options(&cfg->dns_cache_options);
   hostname_reinit(cfg->custom_domain);
@@ -657,6 +670,12 @@ cfg_format_id(GlobalConfig *self, GString *id)
     g_string_assign(id, _format_config_hash(self, buf, sizeof(buf)));
 }
 
+gboolean
+cfg_is_config_hash_equal(GlobalConfig *self, GlobalConfig *other)
+{
+  return memcmp(self->config_hash, other->config_hash, CONFIG_HASH_LENGTH) == 0;
+}
+
 static void
 cfg_hash_config(GlobalConfig *self)
 {
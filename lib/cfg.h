@@ -94,11 +94,13 @@ struct _GlobalConfig
   gint type_cast_strictness;
 
   gint log_fifo_size;
+  gint64 queue_memory_budget;
   gint log_msg_size;
   gboolean trim_large_messages;
   gint log_level;
 
   gboolean create_dirs;
+  gboolean use_io_uring;
   FilePermOptions file_perm_options;
   GList *source_mangle_callback_list;
   gboolean use_uniqid;
@@ -117,6 +119,9 @@ struct _GlobalConfig
 
   guint min_iw_size_per_reader;
 
+  /* reloading a configuration identical to the running one is a no-op */
+  gboolean skip_unchanged_reload;
+
   PersistConfig *persist;
   PersistState *state;
   GHashTable *module_config;
@@ -140,6 +145,7 @@ gpointer cfg_parse_plugin(GlobalConfig *cfg, Plugin *plugin, CFG_LTYPE *yylloc,
 gboolean cfg_allow_config_dups(GlobalConfig *self);
 
 void cfg_bad_hostname_set(GlobalConfig *self, gchar *bad_hostname_re);
+void cfg_set_use_io_uring(GlobalConfig *self, gboolean use_io_uring);
 gint cfg_lookup_mark_mode(const gchar *mark_mode);
 void cfg_set_mark_mode(GlobalConfig *self, const gchar *mark_mode);
 gboolean cfg_set_log_level(GlobalConfig *self, const gchar *log_level);
@@ -153,6 +159,7 @@ gboolean cfg_set_current_version(GlobalConfig *self);
 void cfg_set_user_config_id(GlobalConfig *self, const gchar *id);
 
 void cfg_format_id(GlobalConfig *self, GString *id);
+gboolean cfg_is_config_hash_equal(GlobalConfig *self, GlobalConfig *other);
 
 void cfg_set_global_paths(GlobalConfig *self);
 
@@ -23,6 +23,7 @@
  */
 
 #include <criterion/criterion.h>
+#include <unistd.h>
 
 #include "messages.h"
 #include "control/control.h"
@@ -34,13 +35,18 @@
 #include "control/control-server.h"
 #include "stats/stats-cluster.h"
 #include "stats/stats-registry.h"
+#include "stats/stats-cluster-single.h"
 #include "apphook.h"
 #include "cfg-path.h"
+#include "cfg.h"
+#include "versioning.h"
+#include "resolved-configurable-paths.h"
 
 
 ControlServer *control_server;
 ControlConnection *control_connection;
 MainLoop *main_loop;
+const gchar *saved_cfgfilename;
 
 void
 setup(void)
@@ -55,11 +61,13 @@ setup(void)
   control_server = control_server_dummy_new();
   control_connection = control_connection_dummy_new(control_server);
   control_connection_start_watches(control_connection);
+  saved_cfgfilename = resolved_configurable_paths.cfgfilename;
 }
 
 void
 teardown(void)
 {
+  resolved_configurable_paths.cfgfilename = saved_cfgfilename;
   control_server_connection_closed(control_server, control_connection);
   control_server_free(control_server);
   main_loop_deinit(main_loop);
@@ -235,6 +243,74 @@ Test(control_cmds, test_reset_stats)
                    "Bad reply");
 }
 
+#define RELOAD_CONFIG_FILENAME "test_control_cmds_reload.conf"
+
+static void
+_read_config(GlobalConfig *cfg, const gchar *config)
+{
+  cr_assert(g_file_set_contents(RELOAD_CONFIG_FILENAME, config, -1, NULL));
+  cr_assert(cfg_read_config(cfg, RELOAD_CONFIG_FILENAME, NULL));
+}
+
+Test(control_cmds, test_reload_of_an_unchanged_config_is_skipped)
+{
+  const gchar *config = "@version: " VERSION_STR_CURRENT "\noptions { skip-unchanged-reload(yes); };\n";
+  const gchar *response;
+  GlobalConfig *running = main_loop_get_current_config(main_loop);
+
+  _read_config(running, config);
+  cr_assert(running->skip_unchanged_reload);
+  resolved_configurable_paths.cfgfilename = RELOAD_CONFIG_FILENAME;
+
+  _run_command("RELOAD", &response);
+  cr_assert(first_line_eq(response, "OK Configuration unchanged, reload skipped"), "Bad reply: %s", response);
+
+  /* the hash covers the preprocessed config, so any change makes it a real reload */
+  GlobalConfig *changed = cfg_new(0);
+  _read_config(changed, "@version: " VERSION_STR_CURRENT "\n"
+               "options { skip-unchanged-reload(yes); log-fifo-size(1000); };\n");
+  cr_assert_not(cfg_is_config_hash_equal(changed, running));
+  cfg_free(changed);
+
+  unlink(RELOAD_CONFIG_FILENAME);
+}
+
+static StatsCounterItem *
+_register_single_counter(const gchar *name, const gchar *id)
+{
+  StatsCounterItem *counter = NULL;
+  StatsClusterLabel labels[] = { stats_cluster_label("id", id) };
+  StatsClusterKey sc_key;
+
+  stats_lock();
+  stats_cluster_single_key_set(&sc_key, name, labels, G_N_ELEMENTS(labels));
+  stats_register_counter(0, &sc_key, SC_TYPE_SINGLE_VALUE, &counter);
+  stats_unlock();
+  return counter;
+}
+
+Test(control_cmds, test_stats_top_sends_only_the_saturation_metrics)
+{
+  StatsCounterItem *counter = NULL;
+  const gchar *response;
+
+  stats_counter_set(_register_single_counter("output_unreachable_workers", "d_test"), 2);
+  _register_single_counter("output_unrelated_total", "d_test");
+
+  stats_lock();
+  StatsClusterKey sc_key;
+  stats_cluster_logpipe_key_legacy_set(&sc_key, SCS_CENTER, "id", "received" );
+  stats_register_counter(0, &sc_key, SC_TYPE_PROCESSED, &counter);
+  stats_unlock();
+
+  _run_command("STATS TOP", &response);
+  cr_assert(strstr(response, "syslogng_output_unreachable_workers{id=\"d_test\"} 2\n"), "Bad reply: %s", response);
+  cr_assert_not(strstr(response, "output_unrelated_total"), "unrelated metric in reply: %s", response);
+
+  /* only the windows of the sources are picked from the legacy counters */
+  cr_assert_not(strstr(response, "received"), "legacy metric in reply: %s", response);
+}
+
 static void
 _original_replace(ControlConnection *cc, GString *result, gpointer user_data, gboolean *cancelled)
 {
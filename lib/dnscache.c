@@ -74,6 +74,8 @@ struct _DNSCache
   gint persistent_count;
   time_t hosts_mtime;
   time_t hosts_checktime;
+  /* the options->cache_size limit is shared by this many instances */
+  gint size_divisor;
 };
 
 
@@ -143,6 +145,12 @@ dns_cache_fill_key(DNSCacheKey *key, gint family, void *addr)
     }
 }
 
+static inline gint
+_get_max_dynamic_entries(DNSCache *self)
+{
+  return MAX(self->options->cache_size / self->size_divisor, 1);
+}
+
 static void
 dns_cache_store(DNSCache *self, gboolean persistent, gint family, void *addr, const gchar *hostname, gboolean positive)
 {
@@ -173,7 +181,7 @@ dns_cache_store(DNSCache *self, gboolean persistent, gint family, void *addr, co
     self->persistent_count++;
 
   /* persistent elements are not counted */
-  if ((gint) (g_hash_table_size(self->cache) - self->persistent_count) > self->options->cache_size)
+  if ((gint) (g_hash_table_size(self->cache) - self->persistent_count) > _get_max_dynamic_entries(self))
     {
       DNSCacheEntry *entry_to_remove = iv_list_entry(self->cache_list.next, DNSCacheEntry, list);
 
@@ -339,6 +347,7 @@ dns_cache_new(const DNSCacheOptions *options)
   self->hosts_mtime = -1;
   self->hosts_checktime = 0;
   self->persistent_count = 0;
+  self->size_divisor = 1;
   self->options = options;
   return self;
 }
@@ -371,65 +380,165 @@ dns_cache_options_destroy(DNSCacheOptions *options)
  * not be aware of underlying data structures and locking, they can simply
  * call these functions to lookup/query the DNS cache.
  *
- * I would prefer these to be moved into a higher level implementation
- * detail.
+ * The cache is shared by all threads, so that an address is resolved once
+ * per process instead of once per thread.  It is split into shards by the
+ * address, each protected by its own lock.  Every shard also tracks the
+ * addresses being resolved in the background, so that a slow lookup is
+ * only started once.
  **************************************************************************/
 
+#define DNS_CACHE_SHARDS 16
+
+/* positive entries are refreshed in the background when only this fraction
+ * of their lifetime is left */
+#define DNS_CACHE_PREFETCH_RATIO 10
+
+typedef struct _DNSCacheShard
+{
+  GMutex lock;
+  DNSCache *cache;
+  GHashTable *pending;
+} DNSCacheShard;
+
 TLS_BLOCK_START
 {
-  DNSCache *dns_cache;
+  gchar dns_cache_hostname[256];
 }
 TLS_BLOCK_END;
 
-#define dns_cache __tls_deref(dns_cache)
+#define dns_cache_hostname __tls_deref(dns_cache_hostname)
 
 /* DNS cache related options are global, independent of the configuration
  * (e.g.  GlobalConfig instance), and they are stored in the
  * "effective_dns_cache_options" variable below.
  *
- * The reasons for using the global variable are as explained below.
- *
- * Some notes:
- *   1) DNS cache contents are better retained between configuration reloads
- *   2) There are multiple DNSCache instances as they are per-thread data structs.
- *
- * The usual pattern would be:
- *    DNSCache->options -> DNSCacheOptions
- *
- * And options would be a reference and would point inside a DNSCacheOptions
- * instance contained within the GlobalConfig.
- *
- * The problem with this approach is that we don't want to recreate DNSCache
- * instances when reloading the configuration (as we want to keep their
- * config), and this would mean that we'd have to update the "options"
- * pointers in each of the existing instances.  And those instances are
- * per-thread variables, making it a bit more difficult to track them.
- *
- * For this reason, it was a lot simpler to use a global variable to hold
- * configuration options, one that can be updated as the configuration is
- * reloaded.  Then DNSCache instances transparently take the options changes
- * into account as they continue to resolve names.
- *
- * I could come up with even better solutions to this problem (like using a
- * layer above GlobalConfig, a state that encapsulates per-execution state
- * of syslog-ng), however, right now that would be an overkill and I want to
- * get the DNSCache refactors into the master tree.
+ * DNS cache contents are better retained between configuration reloads,
+ * so the shards are not recreated when the configuration is reloaded.
+ * Instead, they point to this global variable, which is updated as the
+ * configuration is reloaded.  Then DNSCache instances transparently take
+ * the options changes into account as they continue to resolve names.
  */
 
 static DNSCacheOptions effective_dns_cache_options;
-G_LOCK_DEFINE_STATIC(unused_dns_caches);
-static GList *unused_dns_caches;
+static DNSCacheShard dns_cache_shards[DNS_CACHE_SHARDS];
+
+static DNSCacheShard *
+_get_shard(DNSCacheKey *key)
+{
+  guint32 hash = dns_cache_key_hash(key);
+
+  /* the hash table inside the shard uses the same hash, pick the shard by
+   * the high bits of a multiplicative hash */
+  return &dns_cache_shards[(hash * 2654435761U) >> 28];
+}
+
+static gboolean
+_is_due_for_prefetch(DNSCacheEntry *entry, time_t now, gint expire)
+{
+  if (!entry->resolved || !entry->positive)
+    return FALSE;
+
+  return entry->resolved + expire - now <= expire / DNS_CACHE_PREFETCH_RATIO;
+}
+
+static gboolean
+_mark_pending(DNSCacheShard *shard, DNSCacheKey *key)
+{
+  if (g_hash_table_contains(shard->pending, key))
+    return FALSE;
+
+  DNSCacheKey *pending_key = g_new(DNSCacheKey, 1);
+  *pending_key = *key;
+  g_hash_table_add(shard->pending, pending_key);
+  return TRUE;
+}
+
+/*
+ * The returned hostname is copied to a per-thread buffer, as the entry may
+ * be replaced by other threads as soon as the shard is unlocked.
+ *
+ * @refresh_needed, if not NULL, is set if the entry is about to expire and
+ * the caller is expected to resolve the address again in the background.
+ */
+gboolean
+dns_caching_lookup(gint family, void *addr, const gchar **hostname, gsize *hostname_len, gboolean *positive,
+                   gboolean *refresh_needed)
+{
+  DNSCacheKey key;
+  const gchar *cached_hostname;
+  gboolean found;
+
+  dns_cache_fill_key(&key, family, addr);
+  DNSCacheShard *shard = _get_shard(&key);
+
+  if (refresh_needed)
+    *refresh_needed = FALSE;
+  g_mutex_lock(&shard->lock);
+  found = dns_cache_lookup(shard->cache, family, addr, &cached_hostname, hostname_len, positive);
+  if (found)
+    {
+      *hostname_len = MIN(*hostname_len, sizeof(dns_cache_hostname) - 1);
+      memcpy(dns_cache_hostname, cached_hostname, *hostname_len);
+      dns_cache_hostname[*hostname_len] = 0;
+      *hostname = dns_cache_hostname;
+
+      DNSCacheEntry *entry = g_hash_table_lookup(shard->cache->cache, &key);
+      if (refresh_needed && _is_due_for_prefetch(entry, cached_g_current_time_sec(), shard->cache->options->expire))
+        *refresh_needed = _mark_pending(shard, &key);
+    }
+  else
+    {
+      *hostname = NULL;
+    }
+  g_mutex_unlock(&shard->lock);
 
+  return found;
+}
+
+/* returns TRUE if the caller should start resolving the address, FALSE if
+ * it is already being resolved */
 gboolean
-dns_caching_lookup(gint family, void *addr, const gchar **hostname, gsize *hostname_len, gboolean *positive)
+dns_caching_begin_resolve(gint family, void *addr)
 {
-  return dns_cache_lookup(dns_cache, family, addr, hostname, hostname_len, positive);
+  DNSCacheKey key;
+  gboolean result;
+
+  dns_cache_fill_key(&key, family, addr);
+  DNSCacheShard *shard = _get_shard(&key);
+
+  g_mutex_lock(&shard->lock);
+  result = _mark_pending(shard, &key);
+  g_mutex_unlock(&shard->lock);
+
+  return result;
 }
 
 void
 dns_caching_store(gint family, void *addr, const gchar *hostname, gboolean positive)
 {
-  dns_cache_store_dynamic(dns_cache, family, addr, hostname, positive);
+  DNSCacheKey key;
+
+  dns_cache_fill_key(&key, family, addr);
+  DNSCacheShard *shard = _get_shard(&key);
+
+  g_mutex_lock(&shard->lock);
+  dns_cache_store_dynamic(shard->cache, family, addr, hostname, positive);
+  g_hash_table_remove(shard->pending, &key);
+  g_mutex_unlock(&shard->lock);
+}
+
+static void
+_lock_all_shards(void)
+{
+  for (gint i = 0; i < DNS_CACHE_SHARDS; i++)
+    g_mutex_lock(&dns_cache_shards[i].lock);
+}
+
+static void
+_unlock_all_shards(void)
+{
+  for (gint i = DNS_CACHE_SHARDS - 1; i >= 0; i--)
+    g_mutex_unlock(&dns_cache_shards[i].lock);
 }
 
 void
@@ -437,6 +546,7 @@ dns_caching_update_options(const DNSCacheOptions *new_options)
 {
   DNSCacheOptions *options = &effective_dns_cache_options;
 
+  _lock_all_shards();
   if (options->hosts)
     g_free(options->hosts);
 
@@ -444,49 +554,40 @@ dns_caching_update_options(const DNSCacheOptions *new_options)
   options->expire = new_options->expire;
   options->expire_failed = new_options->expire_failed;
   options->hosts = g_strdup(new_options->hosts);
-}
-
-void
-dns_caching_thread_init(void)
-{
-  g_assert(dns_cache == NULL);
-
-  G_LOCK(unused_dns_caches);
-  if (unused_dns_caches)
-    {
-      dns_cache = unused_dns_caches->data;
-      unused_dns_caches = g_list_delete_link(unused_dns_caches, unused_dns_caches);
-    }
-  G_UNLOCK(unused_dns_caches);
-
-  if (!dns_cache)
-    dns_cache = dns_cache_new(&effective_dns_cache_options);
-}
 
-void
-dns_caching_thread_deinit(void)
-{
-  g_assert(dns_cache != NULL);
-
-  G_LOCK(unused_dns_caches);
-  unused_dns_caches = g_list_prepend(unused_dns_caches, dns_cache);
-  G_UNLOCK(unused_dns_caches);
-  dns_cache = NULL;
+  /* reread the hosts file on the next lookup */
+  for (gint i = 0; i < DNS_CACHE_SHARDS; i++)
+    dns_cache_shards[i].cache->hosts_mtime = -1;
+  _unlock_all_shards();
 }
 
 void
 dns_caching_global_init(void)
 {
   dns_cache_options_defaults(&effective_dns_cache_options);
+
+  for (gint i = 0; i < DNS_CACHE_SHARDS; i++)
+    {
+      DNSCacheShard *shard = &dns_cache_shards[i];
+
+      g_mutex_init(&shard->lock);
+      shard->cache = dns_cache_new(&effective_dns_cache_options);
+      shard->cache->size_divisor = DNS_CACHE_SHARDS;
+      shard->pending = g_hash_table_new_full((GHashFunc) dns_cache_key_hash, (GEqualFunc) dns_cache_key_equal,
+                                             g_free, NULL);
+    }
 }
 
 void
 dns_caching_global_deinit(void)
 {
-  G_LOCK(unused_dns_caches);
-  g_list_foreach(unused_dns_caches, (GFunc) dns_cache_free, NULL);
-  g_list_free(unused_dns_caches);
-  unused_dns_caches = NULL;
-  G_UNLOCK(unused_dns_caches);
+  for (gint i = 0; i < DNS_CACHE_SHARDS; i++)
+    {
+      DNSCacheShard *shard = &dns_cache_shards[i];
+
+      g_hash_table_destroy(shard->pending);
+      dns_cache_free(shard->cache);
+      g_mutex_clear(&shard->lock);
+    }
   dns_cache_options_destroy(&effective_dns_cache_options);
 }
@@ -24,6 +24,8 @@
 
 #include "driver.h"
 #include "logqueue-fifo.h"
+#include "logqueue-ring.h"
+#include "logqueue-priority.h"
 #include "afinter.h"
 #include "cfg-tree.h"
 #include "messages.h"
@@ -265,6 +267,13 @@ _create_memory_queue(LogDestDriver *self, const gchar *persist_name, gint stats_
 
   gint log_fifo_size = self->log_fifo_size < 0 ? cfg->log_fifo_size : self->log_fifo_size;
 
+  if (g_strcmp0(self->memory_queue_type, log_queue_ring_get_type()) == 0)
+    return log_queue_ring_new(log_fifo_size, persist_name, stats_level, driver_sck_builder, queue_sck_builder);
+
+  if (g_strcmp0(self->memory_queue_type, log_queue_priority_get_type()) == 0)
+    return log_queue_priority_new(self->priority_lane_key, self->priority_lanes, log_fifo_size, persist_name,
+                                  stats_level, driver_sck_builder, queue_sck_builder);
+
   if (cfg_is_config_version_older(cfg, VERSION_VALUE_3_22))
     {
       msg_warning_once("WARNING: log-fifo-size() works differently starting with " VERSION_3_22 " to avoid dropping "
@@ -291,7 +300,7 @@ log_dest_driver_acquire_memory_queue(LogDestDriver *self, const gchar *persist_n
   if (persist_name)
     queue = cfg_persist_config_fetch(cfg, persist_name);
 
-  if (queue && !log_queue_has_type(queue, log_queue_fifo_get_type()))
+  if (queue && !log_queue_has_type(queue, self->memory_queue_type))
     {
       log_queue_unref(queue);
       queue = NULL;
@@ -413,6 +422,39 @@ log_dest_driver_deinit_method(LogPipe *s)
   return TRUE;
 }
 
+gboolean
+log_dest_driver_set_memory_queue_type(LogDriver *s, const gchar *type)
+{
+  LogDestDriver *self = (LogDestDriver *) s;
+
+  if (strcmp(type, "fifo") == 0)
+    self->memory_queue_type = log_queue_fifo_get_type();
+  else if (strcmp(type, "ring") == 0)
+    self->memory_queue_type = log_queue_ring_get_type();
+  else if (strcmp(type, "priority") == 0)
+    self->memory_queue_type = log_queue_priority_get_type();
+  else
+    return FALSE;
+  return TRUE;
+}
+
+void
+log_dest_driver_set_priority_lane_key_ref(LogDriver *s, LogTemplate *lane_key)
+{
+  LogDestDriver *self = (LogDestDriver *) s;
+
+  log_template_unref(self->priority_lane_key);
+  self->priority_lane_key = lane_key;
+}
+
+void
+log_dest_driver_add_priority_lane(LogDriver *s, LogQueuePriorityLaneOptions *lane)
+{
+  LogDestDriver *self = (LogDestDriver *) s;
+
+  self->priority_lanes = g_list_append(self->priority_lanes, lane);
+}
+
 void
 log_dest_driver_init_instance(LogDestDriver *self, GlobalConfig *cfg)
 {
@@ -425,6 +467,7 @@ log_dest_driver_init_instance(LogDestDriver *self, GlobalConfig *cfg)
   self->release_queue = log_dest_driver_release_queue_method;
   self->log_fifo_size = -1;
   self->throttle = 0;
+  self->memory_queue_type = log_queue_fifo_get_type();
 }
 
 void
@@ -438,5 +481,7 @@ log_dest_driver_free(LogPipe *s)
       log_queue_unref((LogQueue *) l->data);
     }
   g_list_free(self->queues);
+  g_list_free_full(self->priority_lanes, (GDestroyNotify) log_queue_priority_lane_options_free);
+  log_template_unref(self->priority_lane_key);
   log_driver_free(s);
 }
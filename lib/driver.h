@@ -28,6 +28,7 @@
 #include "syslog-ng.h"
 #include "logpipe.h"
 #include "logqueue.h"
+#include "logqueue-priority.h"
 #include "cfg.h"
 
 /*
@@ -169,6 +170,9 @@ struct _LogDestDriver
 
   gint log_fifo_size;
   gint throttle;
+  QueueType memory_queue_type;
+  LogTemplate *priority_lane_key;
+  GList *priority_lanes;
   StatsCounterItem *queued_global_messages;
 };
 
@@ -207,6 +211,10 @@ gboolean log_dest_driver_init_method(LogPipe *s);
 gboolean log_dest_driver_deinit_method(LogPipe *s);
 void log_dest_driver_queue_method(LogPipe *s, LogMessage *msg, const LogPathOptions *path_options);
 
+gboolean log_dest_driver_set_memory_queue_type(LogDriver *s, const gchar *type);
+void log_dest_driver_set_priority_lane_key_ref(LogDriver *s, LogTemplate *lane_key);
+void log_dest_driver_add_priority_lane(LogDriver *s, LogQueuePriorityLaneOptions *lane);
+
 void log_dest_driver_init_instance(LogDestDriver *self, GlobalConfig *cfg);
 void log_dest_driver_free(LogPipe *s);
 
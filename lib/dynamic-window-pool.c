@@ -63,6 +63,22 @@ void dynamic_window_pool_unref(DynamicWindowPool *self)
     }
 }
 
+void
+dynamic_window_pool_set_connection_limits(DynamicWindowPool *self, gsize min_window, gsize max_window)
+{
+  self->min_window = min_window;
+  self->max_window = max_window;
+}
+
+gsize
+dynamic_window_pool_clamp(DynamicWindowPool *self, gsize window)
+{
+  gsize max_window = self->max_window ? MIN(self->max_window, self->pool_size) : self->pool_size;
+  gsize min_window = MIN(self->min_window, max_window);
+
+  return CLAMP(window, min_window, max_window);
+}
+
 gsize
 dynamic_window_pool_request(DynamicWindowPool *self, gsize requested_size)
 {
@@ -37,12 +37,19 @@ struct _DynamicWindowPool
   gsize pool_size;
   gsize free_window;
   gsize balanced_window;
+
+  /* bounds of the dynamic window of a single connection, max_window == 0
+   * means that a connection may take the whole pool */
+  gsize min_window;
+  gsize max_window;
 };
 
 DynamicWindowPool *dynamic_window_pool_new(gsize iw_size);
 void dynamic_window_pool_init(DynamicWindowPool *self);
 DynamicWindowPool *dynamic_window_pool_ref(DynamicWindowPool *self);
 void dynamic_window_pool_unref(DynamicWindowPool *self);
+void dynamic_window_pool_set_connection_limits(DynamicWindowPool *self, gsize min_window, gsize max_window);
+gsize dynamic_window_pool_clamp(DynamicWindowPool *self, gsize window);
 
 gsize dynamic_window_pool_request(DynamicWindowPool *self, gsize requested_size);
 void dynamic_window_pool_release(DynamicWindowPool *self, gsize release_size);
@@ -66,6 +66,9 @@ dynamic_window_set_pool(DynamicWindow *self, DynamicWindowPool *pool)
 {
   self->pool = pool;
   dynamic_window_stat_reset(&self->stat);
+  dynamic_window_reset_demand(self);
+  self->starving = FALSE;
+  self->last_sample_time = 0;
 }
 
 gboolean
@@ -74,6 +77,21 @@ dynamic_window_is_enabled(DynamicWindow *self)
   return !!self->pool;
 }
 
+/* the size of the dynamic window this connection should converge to */
+gsize
+dynamic_window_get_target(DynamicWindow *self)
+{
+  gssize target = (gssize) self->pool->balanced_window + self->demand_offset;
+
+  return dynamic_window_pool_clamp(self->pool, MAX(target, 0));
+}
+
+void
+dynamic_window_reset_demand(DynamicWindow *self)
+{
+  self->demand_offset = 0;
+}
+
 gsize
 dynamic_window_request(DynamicWindow *self, gsize size)
 {
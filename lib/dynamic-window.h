@@ -48,10 +48,17 @@ struct _DynamicWindow
 {
   DynamicWindowPool *pool;
   DynamicWindowStat stat;
+
+  /* demand-driven deviation from the balanced window of the pool */
+  gssize demand_offset;
+  gboolean starving;
+  gint64 last_sample_time;
 };
 
 void dynamic_window_set_pool(DynamicWindow *self, DynamicWindowPool *pool);
 gboolean dynamic_window_is_enabled(DynamicWindow *self);
+gsize dynamic_window_get_target(DynamicWindow *self);
+void dynamic_window_reset_demand(DynamicWindow *self);
 gsize dynamic_window_request(DynamicWindow *self, gsize size);
 void dynamic_window_release(DynamicWindow *self, gsize size);
 
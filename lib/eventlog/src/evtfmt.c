@@ -46,15 +46,10 @@
 #include <stdlib.h>
 #include <string.h>
 
-static char *
-evtrec_format_plain(EVTREC *e)
+static void
+evtrec_format_plain_append(EVTREC *e, EVTSTR *es)
 {
-  EVTSTR *es;
   EVTTAG *et;
-  char *res;
-
-  if (!(es = evt_str_init(128)))
-    return NULL;
 
   evt_str_append_escape_bs(es, e->ev_desc, strlen(e->ev_desc), ';');
   evt_str_append(es, ";");
@@ -70,6 +65,18 @@ evtrec_format_plain(EVTREC *e)
       else
         evt_str_append(es, "'");
     }
+}
+
+static char *
+evtrec_format_plain(EVTREC *e)
+{
+  EVTSTR *es;
+  char *res;
+
+  if (!(es = evt_str_init(128)))
+    return NULL;
+
+  evtrec_format_plain_append(e, es);
   res = evt_str_get_str(es);
   evt_str_free(es, 0);
   return res;
@@ -106,3 +113,28 @@ evt_format(EVTREC *e)
     }
   return (*ctx->ec_formatter_fn)(e);
 }
+
+ssize_t
+evt_format_into(EVTREC *e, char **buf, size_t *buf_size)
+{
+  EVTSTR es =
+  {
+    .es_allocated = *buf_size,
+    .es_length = 0,
+    .es_buf = *buf,
+  };
+
+  if (!es.es_buf || es.es_allocated == 0)
+    {
+      es.es_allocated = 128 + 1; /* room for 128 characters and the trailing zero, like evt_str_init() */
+      if (!(es.es_buf = malloc(es.es_allocated)))
+        return -1;
+    }
+  es.es_buf[0] = 0;
+
+  evtrec_format_plain_append(e, &es);
+
+  *buf = es.es_buf;
+  *buf_size = es.es_allocated;
+  return es.es_length;
+}
@@ -159,6 +159,20 @@ EVTTAG *evt_tag_inaddr6(const char *tag, const struct in6_addr *addr);
  **/
 char *evt_format(EVTREC *e);
 
+/**
+ * evt_format_into:
+ * @e: event record
+ * @buf: buffer allocated by malloc() or NULL, reallocated as needed
+ * @buf_size: number of bytes allocated in *buf, updated if it grows
+ *
+ * Formats the given event using the plain format into a caller owned
+ * buffer, so that callers formatting many events can reuse the same
+ * buffer instead of allocating a new string for each of them.
+ *
+ * Return value: the length of the formatted string, -1 on failure
+ **/
+ssize_t evt_format_into(EVTREC *e, char **buf, size_t *buf_size);
+
 /**
  * evt_log:
  * @e: event record
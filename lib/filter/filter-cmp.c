@@ -40,7 +40,7 @@ typedef struct _FilterCmp
 } FilterCmp;
 
 static gint
-fop_compare_numeric(const GString *left, const GString *right)
+fop_compare_numeric(const LogTemplateTypedValue *left, const LogTemplateTypedValue *right)
 {
   gint l = atoi(left->str);
   gint r = atoi(right->str);
@@ -53,16 +53,16 @@ fop_compare_numeric(const GString *left, const GString *right)
 }
 
 static gint
-fop_compare_bytes(const GString *left, const GString *right)
+fop_compare_bytes(const LogTemplateTypedValue *left, const LogTemplateTypedValue *right)
 {
-  gint cmp = memcmp(left->str, right->str, MIN(left->len, right->len));
+  gint cmp = memcmp(left->str, right->str, MIN(left->str_len, right->str_len));
   if (cmp != 0)
     return cmp;
 
-  if (left->len == right->len)
+  if (left->str_len == right->str_len)
     return 0;
 
-  return left->len < right->len ? -1 : 1;
+  return left->str_len < right->str_len ? -1 : 1;
 }
 
 static inline gboolean
@@ -115,16 +115,19 @@ _evaluate_comparison(FilterCmp *self, gint cmp)
  *
  */
 static void
-_convert_to_number(const GString *value, LogMessageValueType type, GenericNumber *number)
+_convert_to_number(const LogTemplateTypedValue *value, GenericNumber *number)
 {
-  switch (type)
+  switch (value->type)
     {
     case LM_VT_STRING:
-    case LM_VT_INTEGER:
-    case LM_VT_DOUBLE:
       if (!parse_generic_number(value->str, number))
         gn_set_nan(number);
       break;
+    case LM_VT_INTEGER:
+    case LM_VT_DOUBLE:
+      /* already parsed by log_template_eval_typed() */
+      *number = value->as.number;
+      break;
     case LM_VT_JSON:
     case LM_VT_LIST:
     case LM_VT_BYTES:
@@ -135,15 +138,8 @@ _convert_to_number(const GString *value, LogMessageValueType type, GenericNumber
       gn_set_int64(number, 0);
       break;
     case LM_VT_BOOLEAN:
-    {
-      gboolean b;
-
-      if (type_cast_to_boolean(value->str, &b, NULL))
-        gn_set_int64(number, b);
-      else
-        gn_set_int64(number, 0);
+      gn_set_int64(number, value->as.boolean);
       break;
-    }
     case LM_VT_DATETIME:
     {
       gint64 msec;
@@ -186,10 +182,10 @@ _convert_to_number(const GString *value, LogMessageValueType type, GenericNumber
  *
  */
 static gboolean
-_evaluate_typed(FilterCmp *self,
-                const GString *left, LogMessageValueType left_type,
-                const GString *right, LogMessageValueType right_type)
+_evaluate_typed(FilterCmp *self, const LogTemplateTypedValue *left, const LogTemplateTypedValue *right)
 {
+  LogMessageValueType left_type = left->type;
+  LogMessageValueType right_type = right->type;
   GenericNumber l, r;
 
   /* Type aware comparison:
@@ -215,8 +211,8 @@ _evaluate_typed(FilterCmp *self,
 
   /* ok, we need to convert to numbers and compare that way */
 
-  _convert_to_number(left, left_type, &l);
-  _convert_to_number(right, right_type, &r);
+  _convert_to_number(left, &l);
+  _convert_to_number(right, &r);
 
   if (gn_is_nan(&l) || gn_is_nan(&r))
     {
@@ -237,24 +233,23 @@ _evaluate_typed(FilterCmp *self,
 
 static gboolean
 _evaluate_type_and_value_comparison(FilterCmp *self,
-                                    const GString *left, LogMessageValueType left_type,
-                                    const GString *right, LogMessageValueType right_type)
+                                    const LogTemplateTypedValue *left, const LogTemplateTypedValue *right)
 {
   if ((self->compare_mode & FCMP_OP_MASK) == FCMP_EQ)
     {
       /* === */
-      if (left_type != right_type)
+      if (left->type != right->type)
         return FALSE;
     }
   else if ((self->compare_mode & FCMP_OP_MASK) == (FCMP_LT + FCMP_GT))
     {
       /* !== */
-      if (left_type != right_type)
+      if (left->type != right->type)
         return TRUE;
     }
   else
     g_assert_not_reached();
-  return _evaluate_typed(self, left, left_type, right, right_type);
+  return _evaluate_typed(self, left, right);
 }
 
 
@@ -274,34 +269,34 @@ static gboolean
 fop_cmp_eval(FilterExprNode *s, LogMessage **msgs, gint num_msg, LogTemplateEvalOptions *options)
 {
   FilterCmp *self = (FilterCmp *) s;
-  LogMessageValueType left_type, right_type;
+  LogTemplateTypedValue left, right;
 
   ScratchBuffersMarker marker;
   GString *left_buf = scratch_buffers_alloc_and_mark(&marker);
   GString *right_buf = scratch_buffers_alloc();
 
-  log_template_append_format_value_and_type_with_context(self->left, msgs, num_msg, options, left_buf, &left_type);
-  log_template_append_format_value_and_type_with_context(self->right, msgs, num_msg, options, right_buf, &right_type);
+  log_template_eval_typed_with_context(self->left, msgs, num_msg, options, left_buf, &left);
+  log_template_eval_typed_with_context(self->right, msgs, num_msg, options, right_buf, &right);
 
   gboolean result;
   if (self->compare_mode & FCMP_TYPE_AWARE)
-    result = _evaluate_typed(self, left_buf, left_type, right_buf, right_type);
+    result = _evaluate_typed(self, &left, &right);
   else if (self->compare_mode & FCMP_STRING_BASED)
-    result = _evaluate_comparison(self, fop_compare_bytes(left_buf, right_buf));
+    result = _evaluate_comparison(self, fop_compare_bytes(&left, &right));
   else if (self->compare_mode & FCMP_NUM_BASED)
-    result = _evaluate_comparison(self, fop_compare_numeric(left_buf, right_buf));
+    result = _evaluate_comparison(self, fop_compare_numeric(&left, &right));
   else if (self->compare_mode & FCMP_TYPE_AND_VALUE_BASED)
-    result = _evaluate_type_and_value_comparison(self, left_buf, left_type, right_buf, right_type);
+    result = _evaluate_type_and_value_comparison(self, &left, &right);
   else
     g_assert_not_reached();
 
   msg_trace("cmp() evaluation result",
-            evt_tag_str("left", left_buf->str),
+            evt_tag_str("left", left.str),
             evt_tag_str("operator", self->super.type),
-            evt_tag_str("right", right_buf->str),
+            evt_tag_str("right", right.str),
             evt_tag_str("compare_mode", _compare_mode_to_string(self->compare_mode)),
-            evt_tag_str("left_type", log_msg_value_type_to_str(left_type)),
-            evt_tag_str("right_type", log_msg_value_type_to_str(right_type)),
+            evt_tag_str("left_type", log_msg_value_type_to_str(left.type)),
+            evt_tag_str("right_type", log_msg_value_type_to_str(right.type)),
             evt_tag_int("result", result),
             evt_tag_msg_reference(msgs[num_msg - 1]));
 
@@ -348,6 +343,7 @@ fop_cmp_new(LogTemplate *left, LogTemplate *right, const gchar *type, gint compa
   self->super.eval = fop_cmp_eval;
   self->super.free_fn = fop_cmp_free;
   self->super.clone = fop_cmp_clone;
+  self->super.cost = FILTER_COST_TEMPLATE;
   self->compare_mode = compare_mode;
   self->left = left;
   self->right = right;
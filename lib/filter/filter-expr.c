@@ -58,6 +58,44 @@ filter_expr_eval(FilterExprNode *self, LogMessage *msg)
   return filter_expr_eval_with_context(self, &msg, 1, &DEFAULT_TEMPLATE_EVAL_OPTIONS);
 }
 
+/*
+ * Evaluates the filter for a batch of independent messages (as opposed to
+ * the context of a single message in filter_expr_eval_with_context()).
+ * Nodes implementing eval_batch() process the whole batch in one go, e.g.
+ * and/or only evaluate their second operand for the messages where the
+ * first one did not decide the result, others are evaluated one message at
+ * a time.  Just like with filter_expr_eval_with_context(), the messages
+ * have to be writable if the filter modifies them.
+ */
+FilterExprBatchMask
+filter_expr_eval_batch_masked(FilterExprNode *self, LogMessage **msgs, gint num_msg,
+                              FilterExprBatchMask active, LogTemplateEvalOptions *options)
+{
+  if (!active)
+    return 0;
+
+  if (self->eval_batch)
+    return self->eval_batch(self, msgs, num_msg, active, options);
+
+  FilterExprBatchMask result = 0;
+  for (gint i = 0; i < num_msg; i++)
+    {
+      FilterExprBatchMask bit = FILTER_EXPR_BATCH_BIT(i);
+
+      if ((active & bit) && self->eval(self, &msgs[i], 1, options))
+        result |= bit;
+    }
+  return result;
+}
+
+FilterExprBatchMask
+filter_expr_eval_batch(FilterExprNode *self, LogMessage **msgs, gint num_msg, LogTemplateEvalOptions *options)
+{
+  g_assert(num_msg > 0 && num_msg <= FILTER_EXPR_BATCH_MAX);
+
+  return filter_expr_eval_batch_masked(self, msgs, num_msg, FILTER_EXPR_BATCH_ALL(num_msg), options);
+}
+
 gboolean
 filter_expr_eval_root_with_context(FilterExprNode *self, LogMessage **msg, gint num_msg,
                                    LogTemplateEvalOptions *options,
@@ -71,6 +109,40 @@ filter_expr_eval_root_with_context(FilterExprNode *self, LogMessage **msg, gint
   return filter_expr_eval_with_context(self, msg, num_msg, options);
 }
 
+/*
+ * Checks if the expression is TRUE exactly when the value of a single
+ * name-value pair is equal to one of a set of strings, e.g. program("foo"
+ * type("string")) or host("^bar$").  The name-value pair is returned in
+ * @handle (which must be LM_V_NONE or the same handle in the case of
+ * subsequent calls) and the strings are appended to @keys as newly
+ * allocated strings.  The caller can then use a hash lookup instead of
+ * evaluating the expression itself.
+ */
+gboolean
+filter_expr_get_equality_keys(FilterExprNode *self, NVHandle *handle, GPtrArray *keys)
+{
+  if (self->comp || !self->get_equality_keys)
+    return FALSE;
+
+  return self->get_equality_keys(self, handle, keys);
+}
+
+/*
+ * Checks if the expression is TRUE exactly when one of a set of
+ * LogMatchers matches the value of a single name-value pair, e.g.
+ * message("foo") or match("bar" value("HOST")).  Works like
+ * filter_expr_get_equality_keys(), except that the matchers are appended
+ * to @matchers, without taking a reference.
+ */
+gboolean
+filter_expr_get_value_matchers(FilterExprNode *self, NVHandle *handle, GPtrArray *matchers)
+{
+  if (self->comp || !self->get_value_matchers)
+    return FALSE;
+
+  return self->get_value_matchers(self, handle, matchers);
+}
+
 gboolean
 filter_expr_eval_root(FilterExprNode *self, LogMessage **msg, const LogPathOptions *path_options)
 {
@@ -105,5 +177,6 @@ filter_expr_clone(FilterExprNode *self)
 
   FilterExprNode *cloned = self->clone(self);
   cloned->comp = self->comp;
+  cloned->cost = self->cost;
   return cloned;
 }
@@ -33,14 +33,47 @@
 struct _GlobalConfig;
 typedef struct _FilterExprNode FilterExprNode;
 
+/* Relative evaluation costs of filter expressions, the operands of and/or
+ * are reordered based on these, see filter-op.c.  Nodes that have side
+ * effects (e.g. they update counters) or were not classified stay at
+ * FILTER_COST_UNKNOWN and are never moved. */
+enum
+{
+  FILTER_COST_UNKNOWN = 0,
+  FILTER_COST_PRI = 1,
+  FILTER_COST_TAGS = 2,
+  FILTER_COST_NETMASK = 2,
+  FILTER_COST_STRING = 4,
+  FILTER_COST_TEMPLATE = 8,
+  FILTER_COST_GLOB = 8,
+  FILTER_COST_REGEXP = 16,
+};
+
+/* filter_expr_eval_batch() returns the results as a bitmask, bit i is set
+ * if the i-th message of the batch matched */
+typedef guint64 FilterExprBatchMask;
+
+#define FILTER_EXPR_BATCH_MAX 64
+#define FILTER_EXPR_BATCH_BIT(i) (((FilterExprBatchMask) 1) << (i))
+#define FILTER_EXPR_BATCH_ALL(n) \
+  ((n) >= FILTER_EXPR_BATCH_MAX ? ~((FilterExprBatchMask) 0) : FILTER_EXPR_BATCH_BIT(n) - 1)
+
 struct _FilterExprNode
 {
   guint32 ref_cnt;
   guint32 comp:1,   /* this not is negated */
           modify:1; /* this filter changes the log message */
+  guint32 cost;     /* FILTER_COST_* */
   const gchar *type;
   gboolean (*init)(FilterExprNode *self, GlobalConfig *cfg);
   gboolean (*eval)(FilterExprNode *self, LogMessage **msg, gint num_msg, LogTemplateEvalOptions *options);
+  /* optional, evaluates the messages in @active, see filter_expr_eval_batch() */
+  FilterExprBatchMask (*eval_batch)(FilterExprNode *self, LogMessage **msgs, gint num_msg,
+                                    FilterExprBatchMask active, LogTemplateEvalOptions *options);
+  /* optional, see filter_expr_get_equality_keys() */
+  gboolean (*get_equality_keys)(FilterExprNode *self, NVHandle *handle, GPtrArray *keys);
+  /* optional, see filter_expr_get_value_matchers() */
+  gboolean (*get_value_matchers)(FilterExprNode *self, NVHandle *handle, GPtrArray *matchers);
   FilterExprNode *(*clone)(FilterExprNode *self);
   void (*free_fn)(FilterExprNode *self);
   StatsCounterItem *matched;
@@ -59,6 +92,12 @@ filter_expr_init(FilterExprNode *self, GlobalConfig *cfg)
 gboolean filter_expr_eval(FilterExprNode *self, LogMessage *msg);
 gboolean filter_expr_eval_with_context(FilterExprNode *self, LogMessage **msgs, gint num_msg,
                                        LogTemplateEvalOptions *options);
+FilterExprBatchMask filter_expr_eval_batch(FilterExprNode *self, LogMessage **msgs, gint num_msg,
+                                           LogTemplateEvalOptions *options);
+FilterExprBatchMask filter_expr_eval_batch_masked(FilterExprNode *self, LogMessage **msgs, gint num_msg,
+                                                  FilterExprBatchMask active, LogTemplateEvalOptions *options);
+gboolean filter_expr_get_equality_keys(FilterExprNode *self, NVHandle *handle, GPtrArray *keys);
+gboolean filter_expr_get_value_matchers(FilterExprNode *self, NVHandle *handle, GPtrArray *matchers);
 gboolean filter_expr_eval_root(FilterExprNode *self, LogMessage **msg, const LogPathOptions *path_options);
 gboolean filter_expr_eval_root_with_context(FilterExprNode *self, LogMessage **msgs, gint num_msg,
                                             LogTemplateEvalOptions *options,
@@ -25,19 +25,230 @@
 #include "filter-in-list.h"
 #include "logmsg/logmsg.h"
 #include "str-utils.h"
+#include "compat/string.h"
 
 #include <errno.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
 
+/*
+ * The lines of the list file are stored in a single buffer, indexed by an
+ * immutable open addressing hash table (exact matches), or compiled into
+ * an Aho-Corasick automaton (FILTER_IN_LIST_SUBSTRING), which finds any
+ * of the lines in the value in a single pass.
+ */
+
+typedef struct _InListLine
+{
+  guint32 offset;
+  guint32 len;
+} InListLine;
+
+typedef struct _InListSlot
+{
+  guint32 hash;
+  /* lines are never empty, len == 0 marks an unused slot */
+  InListLine line;
+} InListSlot;
+
+typedef struct _InListNode
+{
+  guint32 first_child;
+  guint32 next_sibling;
+  guint32 fail;
+  guint8 byte;
+  guint8 match;
+} InListNode;
+
 typedef struct _FilterInList
 {
   FilterExprNode super;
   NVHandle value_handle;
-  GTree *tree;
+  guint32 flags;
+  GString *lines;
+
+  /* exact matches */
+  InListSlot *slots;
+  guint32 slot_mask;
+
+  /* substring matches, node 0 is the root of the trie */
+  GArray *nodes;
+  guint32 root_children[256];
 } FilterInList;
 
+static inline guint32
+_hash_line(const gchar *value, gsize len)
+{
+  /* FNV-1a */
+  guint32 hash = 2166136261U;
+
+  for (gsize i = 0; i < len; i++)
+    hash = (hash ^ (guint8) value[i]) * 16777619U;
+  return hash;
+}
+
+static gboolean
+_slot_matches(FilterInList *self, InListSlot *slot, guint32 hash, const gchar *value, gsize len)
+{
+  return slot->hash == hash && slot->line.len == len && memcmp(self->lines->str + slot->line.offset, value, len) == 0;
+}
+
+static gboolean
+_lookup_exact(FilterInList *self, const gchar *value, gsize len)
+{
+  if (len == 0)
+    return FALSE;
+
+  guint32 hash = _hash_line(value, len);
+  for (guint32 i = hash & self->slot_mask; self->slots[i].line.len; i = (i + 1) & self->slot_mask)
+    {
+      if (_slot_matches(self, &self->slots[i], hash, value, len))
+        return TRUE;
+    }
+  return FALSE;
+}
+
+static void
+_build_hash_table(FilterInList *self, GArray *lines)
+{
+  guint32 num_slots = 16;
+
+  /* keep the load factor at or below 50% */
+  while (num_slots < lines->len * 2)
+    num_slots <<= 1;
+
+  self->slots = g_new0(InListSlot, num_slots);
+  self->slot_mask = num_slots - 1;
+
+  for (guint32 n = 0; n < lines->len; n++)
+    {
+      InListLine *line = &g_array_index(lines, InListLine, n);
+      const gchar *value = self->lines->str + line->offset;
+      guint32 hash = _hash_line(value, line->len);
+      guint32 i;
+
+      for (i = hash & self->slot_mask; self->slots[i].line.len; i = (i + 1) & self->slot_mask)
+        {
+          if (_slot_matches(self, &self->slots[i], hash, value, line->len))
+            break;
+        }
+      self->slots[i].hash = hash;
+      self->slots[i].line = *line;
+    }
+}
+
+static inline InListNode *
+_node(FilterInList *self, guint32 ndx)
+{
+  return &g_array_index(self->nodes, InListNode, ndx);
+}
+
+static inline guint32
+_goto(FilterInList *self, guint32 state, guint8 c)
+{
+  if (state == 0)
+    return self->root_children[c];
+
+  for (guint32 child = _node(self, state)->first_child; child; child = _node(self, child)->next_sibling)
+    {
+      if (_node(self, child)->byte == c)
+        return child;
+    }
+  return 0;
+}
+
+static void
+_insert_pattern(FilterInList *self, const gchar *pattern, gsize len)
+{
+  guint32 state = 0;
+
+  for (gsize i = 0; i < len; i++)
+    {
+      guint8 c = pattern[i];
+      guint32 next = _goto(self, state, c);
+
+      if (!next)
+        {
+          InListNode node = { .next_sibling = _node(self, state)->first_child, .byte = c };
+
+          next = self->nodes->len;
+          g_array_append_val(self->nodes, node);
+          _node(self, state)->first_child = next;
+          if (state == 0)
+            self->root_children[c] = next;
+        }
+      state = next;
+    }
+  _node(self, state)->match = TRUE;
+}
+
+/* computes the failure links in breadth first order */
+static void
+_link_automaton(FilterInList *self)
+{
+  GArray *queue = g_array_new(FALSE, FALSE, sizeof(guint32));
+
+  for (guint32 child = _node(self, 0)->first_child; child; child = _node(self, child)->next_sibling)
+    g_array_append_val(queue, child);
+
+  for (guint32 head = 0; head < queue->len; head++)
+    {
+      guint32 state = g_array_index(queue, guint32, head);
+
+      for (guint32 child = _node(self, state)->first_child; child; child = _node(self, child)->next_sibling)
+        {
+          guint8 c = _node(self, child)->byte;
+          guint32 fail = _node(self, state)->fail;
+          guint32 next;
+
+          while (!(next = _goto(self, fail, c)) && fail != 0)
+            fail = _node(self, fail)->fail;
+
+          _node(self, child)->fail = next;
+          _node(self, child)->match |= _node(self, next)->match;
+          g_array_append_val(queue, child);
+        }
+    }
+  g_array_free(queue, TRUE);
+}
+
+static void
+_build_automaton(FilterInList *self, GArray *lines)
+{
+  InListNode root = { 0 };
+
+  self->nodes = g_array_new(FALSE, FALSE, sizeof(InListNode));
+  g_array_append_val(self->nodes, root);
+
+  for (guint32 n = 0; n < lines->len; n++)
+    {
+      InListLine *line = &g_array_index(lines, InListLine, n);
+      _insert_pattern(self, self->lines->str + line->offset, line->len);
+    }
+  _link_automaton(self);
+}
+
+static gboolean
+_lookup_substring(FilterInList *self, const gchar *value, gsize len)
+{
+  guint32 state = 0;
+
+  for (gsize i = 0; i < len; i++)
+    {
+      guint8 c = value[i];
+      guint32 next;
+
+      while (!(next = _goto(self, state, c)) && state != 0)
+        state = _node(self, state)->fail;
+
+      state = next;
+      if (_node(self, state)->match)
+        return TRUE;
+    }
+  return FALSE;
+}
+
 static gboolean
 filter_in_list_eval(FilterExprNode *s, LogMessage **msgs, gint num_msg, LogTemplateEvalOptions *options)
 {
@@ -45,13 +256,17 @@ filter_in_list_eval(FilterExprNode *s, LogMessage **msgs, gint num_msg, LogTempl
   LogMessage *msg = msgs[num_msg - 1];
   const gchar *value;
   gssize len = 0;
+  gboolean result;
 
   value = log_msg_get_value(msg, self->value_handle, &len);
-  APPEND_ZERO(value, value, len);
 
-  gboolean result = (g_tree_lookup(self->tree, value) != NULL);
+  if (self->flags & FILTER_IN_LIST_SUBSTRING)
+    result = _lookup_substring(self, value, len);
+  else
+    result = _lookup_exact(self, value, len);
+
   msg_trace("in-list() evaluation started",
-            evt_tag_str("value", value),
+            evt_tag_mem("value", value, len),
             evt_tag_msg_reference(msg));
 
   return result ^ s->comp;
@@ -62,15 +277,49 @@ filter_in_list_free(FilterExprNode *s)
 {
   FilterInList *self = (FilterInList *)s;
 
-  g_tree_destroy(self->tree);
+  g_free(self->slots);
+  if (self->nodes)
+    g_array_free(self->nodes, TRUE);
+  g_string_free(self->lines, TRUE);
+}
+
+static GArray *
+_load_lines(FilterInList *self, FILE *stream)
+{
+  GArray *lines = g_array_new(FALSE, FALSE, sizeof(InListLine));
+  gchar *buf = NULL;
+  size_t buf_size = 0;
+  gssize len;
+
+  while ((len = getline(&buf, &buf_size, stream)) > 0)
+    {
+      if (buf[len - 1] == '\n')
+        len--;
+      if (len == 0)
+        continue;
+
+      InListLine line = { .offset = self->lines->len, .len = len };
+
+      g_string_append_len(self->lines, buf, len);
+      g_array_append_val(lines, line);
+    }
+  free(buf);
+  return lines;
+}
+
+guint32
+filter_in_list_lookup_flag(const gchar *flag)
+{
+  if (strcmp(flag, "substring") == 0)
+    return FILTER_IN_LIST_SUBSTRING;
+  return 0;
 }
 
 FilterExprNode *
-filter_in_list_new(const gchar *list_file, const gchar *property)
+filter_in_list_new_with_flags(const gchar *list_file, const gchar *property, guint32 flags)
 {
   FilterInList *self;
   FILE *stream;
-  gchar line[16384];
 
   stream = fopen(list_file, "r");
   if (!stream)
@@ -84,17 +333,26 @@ filter_in_list_new(const gchar *list_file, const gchar *property)
   self = g_new0(FilterInList, 1);
   filter_expr_node_init_instance(&self->super);
   self->value_handle = log_msg_get_value_handle(property);
-  self->tree = g_tree_new_full((GCompareDataFunc)strcmp, NULL, g_free, NULL);
+  self->flags = flags;
+  self->lines = g_string_new("");
 
-  while (fgets(line, sizeof(line), stream) != NULL)
-    {
-      line[strlen(line) - 1] = '\0';
-      if (line[0])
-        g_tree_insert(self->tree, g_strdup(line), GINT_TO_POINTER(1));
-    }
+  GArray *lines = _load_lines(self, stream);
   fclose(stream);
 
+  if (flags & FILTER_IN_LIST_SUBSTRING)
+    _build_automaton(self, lines);
+  else
+    _build_hash_table(self, lines);
+  g_array_free(lines, TRUE);
+
   self->super.eval = filter_in_list_eval;
   self->super.free_fn = filter_in_list_free;
+  self->super.cost = FILTER_COST_STRING;
   return &self->super;
 }
+
+FilterExprNode *
+filter_in_list_new(const gchar *list_file, const gchar *property)
+{
+  return filter_in_list_new_with_flags(list_file, property, 0);
+}
@@ -27,7 +27,14 @@
 
 #include "filter-expr.h"
 
+/* match lines of the list anywhere in the value */
+#define FILTER_IN_LIST_SUBSTRING 0x0001
+
 FilterExprNode *filter_in_list_new(const gchar *list_file,
                                    const gchar *property);
+FilterExprNode *filter_in_list_new_with_flags(const gchar *list_file,
+                                              const gchar *property,
+                                              guint32 flags);
+guint32 filter_in_list_lookup_flag(const gchar *flag);
 
 #endif
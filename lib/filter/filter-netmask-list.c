@@ -0,0 +1,352 @@
+/*
+ * Copyright (c) 2024 One Identity LLC.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#include "filter-netmask-list.h"
+#include "gsocket.h"
+#include "logmsg/logmsg.h"
+#include "compat/string.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+
+/*
+ * netmask-list("file") matches the source address of the message against
+ * the networks listed in a file, one per line:
+ *
+ *    # comment
+ *    10.0.0.0/8
+ *    192.168.1.0/255.255.255.0
+ *    172.16.1.1
+ *    2001:db8::/32
+ *
+ * The networks are stored in path compressed binary tries (one for IPv4,
+ * one for IPv6), so a lookup walks at most as many nodes as the address
+ * has bits, independently of the size of the list.
+ */
+
+#define NETMASK_LIST_MAX_ADDRESS_LEN 16
+
+typedef struct _NetmaskTrieNode NetmaskTrieNode;
+struct _NetmaskTrieNode
+{
+  guint8 address[NETMASK_LIST_MAX_ADDRESS_LEN];
+  guint8 prefix_len;
+  /* a listed network ends here, everything below it matches too */
+  gboolean terminal;
+  NetmaskTrieNode *child[2];
+};
+
+typedef struct _FilterNetmaskList
+{
+  FilterExprNode super;
+  NetmaskTrieNode *ipv4;
+  NetmaskTrieNode *ipv6;
+} FilterNetmaskList;
+
+static inline guint
+_get_bit(const guint8 *address, guint bit)
+{
+  return (address[bit >> 3] >> (7 - (bit & 7))) & 1;
+}
+
+static guint
+_common_prefix_len(const guint8 *a, const guint8 *b, guint max_bits)
+{
+  guint bit = 0;
+
+  while (bit < max_bits)
+    {
+      if ((bit & 7) == 0 && bit + 8 <= max_bits && a[bit >> 3] == b[bit >> 3])
+        {
+          bit += 8;
+          continue;
+        }
+      if (_get_bit(a, bit) != _get_bit(b, bit))
+        break;
+      bit++;
+    }
+  return bit;
+}
+
+static NetmaskTrieNode *
+_trie_node_new(const guint8 *address, guint prefix_len, gboolean terminal)
+{
+  NetmaskTrieNode *node = g_new0(NetmaskTrieNode, 1);
+
+  /* only keep the network part */
+  memcpy(node->address, address, (prefix_len + 7) / 8);
+  if (prefix_len & 7)
+    node->address[prefix_len >> 3] &= 0xFF << (8 - (prefix_len & 7));
+  node->prefix_len = prefix_len;
+  node->terminal = terminal;
+  return node;
+}
+
+static void
+_trie_free(NetmaskTrieNode *node)
+{
+  if (!node)
+    return;
+
+  _trie_free(node->child[0]);
+  _trie_free(node->child[1]);
+  g_free(node);
+}
+
+static void
+_trie_insert(NetmaskTrieNode **root, const guint8 *address, guint prefix_len)
+{
+  NetmaskTrieNode **ref = root;
+
+  while (*ref)
+    {
+      NetmaskTrieNode *node = *ref;
+      guint common = _common_prefix_len(node->address, address, MIN(node->prefix_len, prefix_len));
+
+      if (common == node->prefix_len)
+        {
+          if (common == prefix_len)
+            {
+              node->terminal = TRUE;
+              return;
+            }
+          ref = &node->child[_get_bit(address, common)];
+          continue;
+        }
+
+      /* the new network diverges from, or contains the network of node */
+      NetmaskTrieNode *parent = _trie_node_new(address, common, common == prefix_len);
+
+      parent->child[_get_bit(node->address, common)] = node;
+      if (common < prefix_len)
+        parent->child[_get_bit(address, common)] = _trie_node_new(address, prefix_len, TRUE);
+      *ref = parent;
+      return;
+    }
+  *ref = _trie_node_new(address, prefix_len, TRUE);
+}
+
+static gboolean
+_trie_lookup(NetmaskTrieNode *node, const guint8 *address, guint address_bits)
+{
+  while (node)
+    {
+      if (_common_prefix_len(node->address, address, node->prefix_len) != node->prefix_len)
+        return FALSE;
+      if (node->terminal)
+        return TRUE;
+      if (node->prefix_len >= address_bits)
+        return FALSE;
+      node = node->child[_get_bit(address, node->prefix_len)];
+    }
+  return FALSE;
+}
+
+static gboolean
+_lookup_ipv4(FilterNetmaskList *self, const struct in_addr *address)
+{
+  return _trie_lookup(self->ipv4, (const guint8 *) &address->s_addr, 32);
+}
+
+static gboolean
+filter_netmask_list_eval(FilterExprNode *s, LogMessage **msgs, gint num_msg, LogTemplateEvalOptions *options)
+{
+  FilterNetmaskList *self = (FilterNetmaskList *) s;
+  LogMessage *msg = msgs[num_msg - 1];
+  gboolean res = FALSE;
+
+  if (!msg->saddr || msg->saddr->sa.sa_family == AF_UNIX)
+    {
+      struct in_addr loopback = { .s_addr = htonl(INADDR_LOOPBACK) };
+      res = _lookup_ipv4(self, &loopback);
+    }
+  else if (g_sockaddr_inet_check(msg->saddr))
+    {
+      res = _lookup_ipv4(self, &((struct sockaddr_in *) &msg->saddr->sa)->sin_addr);
+    }
+#if SYSLOG_NG_ENABLE_IPV6
+  else if (g_sockaddr_inet6_check(msg->saddr))
+    {
+      const struct in6_addr *address = &((struct sockaddr_in6 *) &msg->saddr->sa)->sin6_addr;
+
+      if (IN6_IS_ADDR_V4MAPPED(address))
+        res = _lookup_ipv4(self, (const struct in_addr *) &address->s6_addr[12]);
+      else
+        res = _trie_lookup(self->ipv6, address->s6_addr, 128);
+    }
+#endif
+
+  msg_trace("netmask-list() evaluation started",
+            evt_tag_msg_reference(msg));
+  return res ^ s->comp;
+}
+
+static gboolean
+_parse_ipv4_netmask(const gchar *netmask, guint *prefix_len)
+{
+  struct in_addr mask;
+
+  if (inet_pton(AF_INET, netmask, &mask) != 1)
+    return FALSE;
+
+  guint32 bits = ntohl(mask.s_addr);
+  guint len = 0;
+
+  while (len < 32 && (bits & (0x80000000U >> len)))
+    len++;
+
+  /* the netmask must be contiguous */
+  if (len < 32 && (bits << len) != 0)
+    return FALSE;
+
+  *prefix_len = len;
+  return TRUE;
+}
+
+static gboolean
+_parse_prefix_len(const gchar *prefix, guint max_len, guint *prefix_len)
+{
+  gchar *end;
+
+  errno = 0;
+  glong len = strtol(prefix, &end, 10);
+  if (errno || end == prefix || *end || len < 0 || len > max_len)
+    return FALSE;
+
+  *prefix_len = len;
+  return TRUE;
+}
+
+static gboolean
+_add_network(FilterNetmaskList *self, gchar *cidr)
+{
+  gchar *slash = strchr(cidr, '/');
+  guint8 address[NETMASK_LIST_MAX_ADDRESS_LEN];
+  guint prefix_len;
+
+  if (slash)
+    *slash = 0;
+
+  if (inet_pton(AF_INET, cidr, address) == 1)
+    {
+      if (!slash)
+        prefix_len = 32;
+      else if (strchr(slash + 1, '.'))
+        {
+          if (!_parse_ipv4_netmask(slash + 1, &prefix_len))
+            return FALSE;
+        }
+      else if (!_parse_prefix_len(slash + 1, 32, &prefix_len))
+        return FALSE;
+
+      _trie_insert(&self->ipv4, address, prefix_len);
+      return TRUE;
+    }
+
+  if (inet_pton(AF_INET6, cidr, address) == 1)
+    {
+      if (!slash)
+        prefix_len = 128;
+      else if (!_parse_prefix_len(slash + 1, 128, &prefix_len))
+        return FALSE;
+
+      _trie_insert(&self->ipv6, address, prefix_len);
+      return TRUE;
+    }
+  return FALSE;
+}
+
+static gboolean
+_load_networks(FilterNetmaskList *self, const gchar *list_file, FILE *stream)
+{
+  gchar *line = NULL;
+  size_t line_size = 0;
+  gint lineno = 0;
+  gboolean success = TRUE;
+
+  while (getline(&line, &line_size, stream) > 0)
+    {
+      lineno++;
+      g_strstrip(line);
+      if (line[0] == 0 || line[0] == '#')
+        continue;
+
+      if (!_add_network(self, line))
+        {
+          msg_error("Invalid network in netmask-list() file",
+                    evt_tag_str("file", list_file),
+                    evt_tag_int("line", lineno));
+          success = FALSE;
+          break;
+        }
+    }
+  free(line);
+  return success;
+}
+
+static void
+filter_netmask_list_free(FilterExprNode *s)
+{
+  FilterNetmaskList *self = (FilterNetmaskList *) s;
+
+  _trie_free(self->ipv4);
+  _trie_free(self->ipv6);
+}
+
+FilterExprNode *
+filter_netmask_list_new(const gchar *list_file)
+{
+  FilterNetmaskList *self;
+  FILE *stream;
+
+  stream = fopen(list_file, "r");
+  if (!stream)
+    {
+      msg_error("Error opening netmask-list() file",
+                evt_tag_str("file", list_file),
+                evt_tag_error("errno"));
+      return NULL;
+    }
+
+  self = g_new0(FilterNetmaskList, 1);
+  filter_expr_node_init_instance(&self->super);
+  self->super.eval = filter_netmask_list_eval;
+  self->super.free_fn = filter_netmask_list_free;
+  self->super.type = "netmask-list";
+  self->super.cost = FILTER_COST_NETMASK;
+
+  gboolean success = _load_networks(self, list_file, stream);
+  fclose(stream);
+
+  if (!success)
+    {
+      filter_expr_unref(&self->super);
+      return NULL;
+    }
+  return &self->super;
+}
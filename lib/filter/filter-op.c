@@ -22,6 +22,7 @@
  *
  */
 #include "filter-op.h"
+#include "filter-pri.h"
 
 typedef struct _FilterOp
 {
@@ -29,6 +30,39 @@ typedef struct _FilterOp
   FilterExprNode *left, *right;
 } FilterOp;
 
+/*
+ * Both and/or are commutative as long as the operands don't have side
+ * effects, so the cheaper operand is evaluated first, which is what
+ * decides the result most of the time, e.g. in
+ *
+ *   message("failed password") and program("sshd")
+ *
+ * program() is only a string comparison and saves the regexp for all
+ * non-sshd messages.  Operands that modify the message (e.g. store
+ * matches used by the other operand) or have unknown costs keep the
+ * order of the configuration.
+ */
+static void
+fop_reorder_operands(FilterOp *self)
+{
+  FilterExprNode *left = self->left;
+  FilterExprNode *right = self->right;
+
+  if (left->cost == FILTER_COST_UNKNOWN || right->cost == FILTER_COST_UNKNOWN ||
+      left->modify || right->modify)
+    {
+      self->super.cost = FILTER_COST_UNKNOWN;
+      return;
+    }
+
+  if (right->cost < left->cost)
+    {
+      self->left = right;
+      self->right = left;
+    }
+  self->super.cost = left->cost + right->cost;
+}
+
 static gboolean
 fop_init(FilterExprNode *s, GlobalConfig *cfg)
 {
@@ -44,6 +78,7 @@ fop_init(FilterExprNode *s, GlobalConfig *cfg)
     return FALSE;
 
   self->super.modify = self->left->modify || self->right->modify;
+  fop_reorder_operands(self);
 
   return TRUE;
 }
@@ -69,6 +104,9 @@ fop_clone(FilterExprNode *s)
   cloned_self->super.free_fn = fop_free;
   cloned_self->super.clone = fop_clone;
   cloned_self->super.eval = self->super.eval;
+  cloned_self->super.eval_batch = self->super.eval_batch;
+  cloned_self->super.get_equality_keys = self->super.get_equality_keys;
+  cloned_self->super.get_value_matchers = self->super.get_value_matchers;
   cloned_self->left = filter_expr_clone(self->left);
   cloned_self->right = filter_expr_clone(self->right);
   cloned_self->super.type = g_strdup(self->super.type);
@@ -93,13 +131,51 @@ fop_or_eval(FilterExprNode *s, LogMessage **msgs, gint num_msg, LogTemplateEvalO
           || filter_expr_eval_with_context(self->right, msgs, num_msg, options)) ^ s->comp;
 }
 
+static FilterExprBatchMask
+fop_or_eval_batch(FilterExprNode *s, LogMessage **msgs, gint num_msg, FilterExprBatchMask active,
+                  LogTemplateEvalOptions *options)
+{
+  FilterOp *self = (FilterOp *) s;
+  FilterExprBatchMask result;
+
+  result = filter_expr_eval_batch_masked(self->left, msgs, num_msg, active, options);
+  result |= filter_expr_eval_batch_masked(self->right, msgs, num_msg, active & ~result, options);
+
+  return s->comp ? (active & ~result) : result;
+}
+
+static gboolean
+fop_or_get_equality_keys(FilterExprNode *s, NVHandle *handle, GPtrArray *keys)
+{
+  FilterOp *self = (FilterOp *) s;
+
+  return filter_expr_get_equality_keys(self->left, handle, keys) &&
+         filter_expr_get_equality_keys(self->right, handle, keys);
+}
+
+static gboolean
+fop_or_get_value_matchers(FilterExprNode *s, NVHandle *handle, GPtrArray *matchers)
+{
+  FilterOp *self = (FilterOp *) s;
+
+  return filter_expr_get_value_matchers(self->left, handle, matchers) &&
+         filter_expr_get_value_matchers(self->right, handle, matchers);
+}
+
 FilterExprNode *
 fop_or_new(FilterExprNode *e1, FilterExprNode *e2)
 {
+  FilterExprNode *combined = filter_pri_combine(e1, e2, FALSE);
+  if (combined)
+    return combined;
+
   FilterOp *self = g_new0(FilterOp, 1);
 
   fop_init_instance(self);
   self->super.eval = fop_or_eval;
+  self->super.eval_batch = fop_or_eval_batch;
+  self->super.get_equality_keys = fop_or_get_equality_keys;
+  self->super.get_value_matchers = fop_or_get_value_matchers;
   self->left = e1;
   self->right = e2;
   self->super.type = g_strdup("OR");
@@ -115,13 +191,31 @@ fop_and_eval(FilterExprNode *s, LogMessage **msgs, gint num_msg, LogTemplateEval
           && filter_expr_eval_with_context(self->right, msgs, num_msg, options)) ^ s->comp;
 }
 
+static FilterExprBatchMask
+fop_and_eval_batch(FilterExprNode *s, LogMessage **msgs, gint num_msg, FilterExprBatchMask active,
+                   LogTemplateEvalOptions *options)
+{
+  FilterOp *self = (FilterOp *) s;
+  FilterExprBatchMask result;
+
+  result = filter_expr_eval_batch_masked(self->left, msgs, num_msg, active, options);
+  result = filter_expr_eval_batch_masked(self->right, msgs, num_msg, result, options);
+
+  return s->comp ? (active & ~result) : result;
+}
+
 FilterExprNode *
 fop_and_new(FilterExprNode *e1, FilterExprNode *e2)
 {
+  FilterExprNode *combined = filter_pri_combine(e1, e2, TRUE);
+  if (combined)
+    return combined;
+
   FilterOp *self = g_new0(FilterOp, 1);
 
   fop_init_instance(self);
   self->super.eval = fop_and_eval;
+  self->super.eval_batch = fop_and_eval_batch;
   self->left = e1;
   self->right = e2;
   self->super.type = g_strdup("AND");
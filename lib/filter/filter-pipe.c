@@ -24,6 +24,7 @@
 
 #include "filter/filter-pipe.h"
 #include "stats/stats-registry.h"
+#include "logmsg/logmsg-trace.h"
 
 /*******************************************************************
  * LogFilterPipe
@@ -41,6 +42,13 @@ log_filter_pipe_init(LogPipe *s)
   if (!self->name)
     self->name = cfg_tree_get_rule_name(&cfg->tree, ENC_FILTER, s->expr_node);
 
+  self->result_slot = -1;
+  if (!self->expr->modify && self->expr->cost != FILTER_COST_UNKNOWN)
+    self->result_slot = cfg_tree_allocate_filter_result_slot(&cfg->tree, self->name);
+
+  rule_profile_unref(self->profile);
+  self->profile = rule_profile_get("filter", self->name, s);
+
   stats_lock();
   StatsClusterKey sc_key;
   StatsClusterLabel labels[] = { stats_cluster_label("id", self->name) };
@@ -53,6 +61,42 @@ log_filter_pipe_init(LogPipe *s)
   return TRUE;
 }
 
+/*
+ * Large configurations often reference the same filter rule from many log
+ * paths, using a clone of the rule in each.  Write protected messages
+ * can't change anymore, so the result of a rule without side effects (see
+ * FILTER_COST_UNKNOWN) is remembered in the message and reused by the
+ * other clones instead of evaluating the expression again.
+ */
+static gboolean
+_lookup_memoized_result(LogFilterPipe *self, LogMessage *msg, gboolean *result)
+{
+  if (self->result_slot < 0 || !log_msg_is_write_protected(msg))
+    return FALSE;
+
+  gsize evaluated = ((gsize) 1) << (2 * self->result_slot);
+  gsize results = (gsize) g_atomic_pointer_get(&msg->filter_results);
+
+  if (!(results & evaluated))
+    return FALSE;
+
+  *result = !!(results & (evaluated << 1));
+  return TRUE;
+}
+
+static void
+_memoize_result(LogFilterPipe *self, LogMessage *msg, gboolean result)
+{
+  if (self->result_slot < 0 || !log_msg_is_write_protected(msg))
+    return;
+
+  gsize bits = ((gsize) 1) << (2 * self->result_slot);
+  if (result)
+    bits |= bits << 1;
+
+  g_atomic_pointer_or(&msg->filter_results, bits);
+}
+
 static void
 log_filter_pipe_queue(LogPipe *s, LogMessage *msg, const LogPathOptions *path_options)
 {
@@ -65,11 +109,20 @@ log_filter_pipe_queue(LogPipe *s, LogMessage *msg, const LogPathOptions *path_op
             log_pipe_location_tag(s),
             evt_tag_msg_reference(msg));
 
-  res = filter_expr_eval_root(self->expr, &msg, path_options);
+  if (!_lookup_memoized_result(self, msg, &res))
+    {
+      RuleProfileSample sample;
+
+      rule_profile_begin(self->profile, &sample);
+      res = filter_expr_eval_root(self->expr, &msg, path_options);
+      rule_profile_end(self->profile, &sample, res);
+      _memoize_result(self, msg, res);
+    }
 
   if (res)
     {
       filter_result = "MATCH - Forwarding message to the next LogPipe";
+      log_msg_trace_stamp(msg, LM_TRACE_PROCESSED);
       log_pipe_forward_msg(s, msg, path_options);
       stats_counter_inc(self->matched);
     }
@@ -113,11 +166,38 @@ log_filter_pipe_free(LogPipe *s)
   stats_unregister_counter(&sc_key, SC_TYPE_NOT_MATCHED, &self->not_matched);
   stats_unlock();
 
+  rule_profile_unref(self->profile);
   g_free(self->name);
   filter_expr_unref(self->expr);
   log_pipe_free_method(s);
 }
 
+/*
+ * The filter rule of @s as a set of strings, see
+ * filter_expr_get_equality_keys().  Returns FALSE if @s is not a filter
+ * pipe or its rule cannot be expressed this way.
+ */
+gboolean
+log_filter_pipe_get_equality_keys(LogPipe *s, NVHandle *handle, GPtrArray *keys)
+{
+  LogFilterPipe *self = (LogFilterPipe *) s;
+
+  if (s->queue != log_filter_pipe_queue)
+    return FALSE;
+  return filter_expr_get_equality_keys(self->expr, handle, keys);
+}
+
+/* see filter_expr_get_value_matchers() */
+gboolean
+log_filter_pipe_get_value_matchers(LogPipe *s, NVHandle *handle, GPtrArray *matchers)
+{
+  LogFilterPipe *self = (LogFilterPipe *) s;
+
+  if (s->queue != log_filter_pipe_queue)
+    return FALSE;
+  return filter_expr_get_value_matchers(self->expr, handle, matchers);
+}
+
 LogPipe *
 log_filter_pipe_new(FilterExprNode *expr, GlobalConfig *cfg)
 {
@@ -27,6 +27,7 @@
 
 #include "filter/filter-expr.h"
 #include "logpipe.h"
+#include "rule-profiler.h"
 
 /* convert a filter expression into a drop/accept LogPipe */
 
@@ -39,10 +40,15 @@ typedef struct _LogFilterPipe
   LogPipe super;
   FilterExprNode *expr;
   gchar *name;
+  /* see cfg_tree_allocate_filter_result_slot(), -1 if the results are not memoized */
+  gint result_slot;
+  RuleProfile *profile;
   StatsCounterItem *matched;
   StatsCounterItem *not_matched;
 } LogFilterPipe;
 
+gboolean log_filter_pipe_get_equality_keys(LogPipe *s, NVHandle *handle, GPtrArray *keys);
+gboolean log_filter_pipe_get_value_matchers(LogPipe *s, NVHandle *handle, GPtrArray *matchers);
 LogPipe *log_filter_pipe_new(FilterExprNode *expr, GlobalConfig *cfg);
 
 #endif
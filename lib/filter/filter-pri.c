@@ -57,6 +57,29 @@ filter_facility_eval(FilterExprNode *s, LogMessage **msgs, gint num_msg, LogTemp
   return res ^ s->comp;
 }
 
+static FilterExprBatchMask
+filter_facility_eval_batch(FilterExprNode *s, LogMessage **msgs, gint num_msg, FilterExprBatchMask active,
+                           LogTemplateEvalOptions *options)
+{
+  FilterPri *self = (FilterPri *) s;
+  FilterExprBatchMask result = 0;
+
+  for (gint i = 0; i < num_msg; i++)
+    {
+      guint32 fac_num = (msgs[i]->pri & SYSLOG_FACMASK) >> 3;
+      guint32 match;
+
+      if (G_UNLIKELY(self->valid & 0x80000000))
+        match = ((self->valid & ~0x80000000) == fac_num);
+      else
+        match = (self->valid >> fac_num) & 1;
+      result |= ((FilterExprBatchMask) match) << i;
+    }
+  result &= active;
+
+  return s->comp ? (active & ~result) : result;
+}
+
 FilterExprNode *
 filter_facility_new(guint32 facilities)
 {
@@ -64,8 +87,10 @@ filter_facility_new(guint32 facilities)
 
   filter_expr_node_init_instance(&self->super);
   self->super.eval = filter_facility_eval;
+  self->super.eval_batch = filter_facility_eval_batch;
   self->valid = facilities;
   self->super.type = "facility";
+  self->super.cost = FILTER_COST_PRI;
   return &self->super;
 }
 
@@ -87,6 +112,24 @@ filter_severity_eval(FilterExprNode *s, LogMessage **msgs, gint num_msg, LogTemp
   return res ^ s->comp;
 }
 
+static FilterExprBatchMask
+filter_severity_eval_batch(FilterExprNode *s, LogMessage **msgs, gint num_msg, FilterExprBatchMask active,
+                           LogTemplateEvalOptions *options)
+{
+  FilterPri *self = (FilterPri *) s;
+  FilterExprBatchMask result = 0;
+
+  for (gint i = 0; i < num_msg; i++)
+    {
+      guint32 pri = msgs[i]->pri & SYSLOG_PRIMASK;
+
+      result |= ((FilterExprBatchMask) ((self->valid >> pri) & 1)) << i;
+    }
+  result &= active;
+
+  return s->comp ? (active & ~result) : result;
+}
+
 FilterExprNode *
 filter_severity_new(guint32 levels)
 {
@@ -94,7 +137,48 @@ filter_severity_new(guint32 levels)
 
   filter_expr_node_init_instance(&self->super);
   self->super.eval = filter_severity_eval;
+  self->super.eval_batch = filter_severity_eval_batch;
   self->valid = levels;
   self->super.type = "severity";
+  self->super.cost = FILTER_COST_PRI;
   return &self->super;
 }
+
+static gboolean
+_is_combinable(FilterExprNode *s)
+{
+  FilterPri *self = (FilterPri *) s;
+
+  if (s->comp)
+    return FALSE;
+  if (s->eval == filter_severity_eval)
+    return TRUE;
+  return s->eval == filter_facility_eval && !(self->valid & 0x80000000);
+}
+
+/*
+ * Turns "facility(a) or facility(b)" into "facility(a, b)" and "level(a)
+ * and level(b)" into a single level() with the common levels, so these are
+ * evaluated with a single bitmask test.  Returns NULL if e1 and e2 can't
+ * be combined, otherwise both are consumed.
+ */
+FilterExprNode *
+filter_pri_combine(FilterExprNode *e1, FilterExprNode *e2, gboolean conjunction)
+{
+  if (e1->eval != e2->eval || !_is_combinable(e1) || !_is_combinable(e2))
+    return NULL;
+
+  guint32 valid1 = ((FilterPri *) e1)->valid;
+  guint32 valid2 = ((FilterPri *) e2)->valid;
+  guint32 valid = conjunction ? (valid1 & valid2) : (valid1 | valid2);
+  FilterExprNode *combined;
+
+  if (e1->eval == filter_facility_eval)
+    combined = filter_facility_new(valid);
+  else
+    combined = filter_severity_new(valid);
+
+  filter_expr_unref(e1);
+  filter_expr_unref(e2);
+  return combined;
+}
@@ -29,5 +29,6 @@
 
 FilterExprNode *filter_facility_new(guint32 facilities);
 FilterExprNode *filter_severity_new(guint32 levels);
+FilterExprNode *filter_pri_combine(FilterExprNode *e1, FilterExprNode *e2, gboolean conjunction);
 
 #endif
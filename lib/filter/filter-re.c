@@ -61,6 +61,18 @@ filter_re_free(FilterExprNode *s)
   log_matcher_options_destroy(&self->matcher_options);
 }
 
+static guint32
+_get_matcher_cost(FilterRE *self)
+{
+  const gchar *type = self->matcher_options.type;
+
+  if (g_strcmp0(type, "string") == 0)
+    return FILTER_COST_STRING;
+  if (g_strcmp0(type, "glob") == 0)
+    return FILTER_COST_GLOB;
+  return FILTER_COST_REGEXP;
+}
+
 static gboolean
 filter_re_init(FilterExprNode *s, GlobalConfig *cfg)
 {
@@ -69,6 +81,46 @@ filter_re_init(FilterExprNode *s, GlobalConfig *cfg)
   if (self->matcher_options.flags & LMF_STORE_MATCHES)
     self->super.modify = TRUE;
 
+  self->super.cost = _get_matcher_cost(self);
+  return TRUE;
+}
+
+static gboolean
+filter_re_get_equality_keys(FilterExprNode *s, NVHandle *handle, GPtrArray *keys)
+{
+  FilterRE *self = (FilterRE *) s;
+  gboolean trailing_newline;
+  const gchar *literal;
+
+  if (self->value_handle == LM_V_NONE || (self->matcher->flags & LMF_STORE_MATCHES))
+    return FALSE;
+  if (*handle != LM_V_NONE && *handle != self->value_handle)
+    return FALSE;
+
+  literal = log_matcher_get_equality_literal(self->matcher, &trailing_newline);
+  if (!literal)
+    return FALSE;
+
+  *handle = self->value_handle;
+  g_ptr_array_add(keys, g_strdup(literal));
+  if (trailing_newline)
+    g_ptr_array_add(keys, g_strconcat(literal, "\n", NULL));
+  return TRUE;
+}
+
+static gboolean
+filter_re_get_value_matchers(FilterExprNode *s, NVHandle *handle, GPtrArray *matchers)
+{
+  FilterRE *self = (FilterRE *) s;
+
+  /* storing the matches needs a writable message, only the filter itself has one */
+  if (self->value_handle == LM_V_NONE || (self->matcher->flags & LMF_STORE_MATCHES))
+    return FALSE;
+  if (*handle != LM_V_NONE && *handle != self->value_handle)
+    return FALSE;
+
+  *handle = self->value_handle;
+  g_ptr_array_add(matchers, self->matcher);
   return TRUE;
 }
 
@@ -97,6 +149,8 @@ filter_re_init_instance(FilterRE *self, NVHandle value_handle)
   self->value_handle = value_handle;
   self->super.init = filter_re_init;
   self->super.eval = filter_re_eval;
+  self->super.get_equality_keys = filter_re_get_equality_keys;
+  self->super.get_value_matchers = filter_re_get_value_matchers;
   self->super.free_fn = filter_re_free;
   self->super.type = "regexp";
   log_matcher_options_defaults(&self->matcher_options);
@@ -225,6 +279,10 @@ filter_match_init(FilterExprNode *s, GlobalConfig *cfg)
 
   filter_match_determine_eval_function(self);
 
+  /* the input is formatted first, unless it is a single name-value pair */
+  if (!self->super.value_handle)
+    s->cost = _get_matcher_cost(&self->super) + FILTER_COST_TEMPLATE;
+
   return TRUE;
 }
 
@@ -26,10 +26,19 @@
 #include "filter-tags.h"
 #include "logmsg/logmsg.h"
 
+#include <string.h>
+
+/*
+ * The list of tags is compiled into a bit array with the same layout as
+ * LogMessage stores its tags, so a message can be matched against all of
+ * them with a couple of word-wide operations, regardless of the number of
+ * tags in the filter.
+ */
 typedef struct _FilterTags
 {
   FilterExprNode super;
-  GArray *tags;
+  gulong *mask;
+  gint mask_len;
 } FilterTags;
 
 static gboolean
@@ -37,20 +46,16 @@ filter_tags_eval(FilterExprNode *s, LogMessage **msgs, gint num_msg, LogTemplate
 {
   FilterTags *self = (FilterTags *)s;
   LogMessage *msg = msgs[num_msg - 1];
+  LogTagId tag_id;
   gboolean res;
-  gint i;
 
-  for (i = 0; i < self->tags->len; i++)
+  if (log_msg_is_any_tag_set_by_mask(msg, self->mask, self->mask_len, &tag_id))
     {
-      LogTagId tag_id = g_array_index(self->tags, LogTagId, i);
-      if (log_msg_is_tag_by_id(msg, tag_id))
-        {
-          res = TRUE;
-          msg_trace("tags() evaluation started",
-                    evt_tag_str("tag", log_tags_get_by_id(tag_id)),
-                    evt_tag_msg_reference(msg));
-          return res ^ s->comp;
-        }
+      res = TRUE;
+      msg_trace("tags() evaluation started",
+                evt_tag_str("tag", log_tags_get_by_id(tag_id)),
+                evt_tag_msg_reference(msg));
+      return res ^ s->comp;
     }
 
   res = FALSE;
@@ -59,6 +64,23 @@ filter_tags_eval(FilterExprNode *s, LogMessage **msgs, gint num_msg, LogTemplate
   return res ^ s->comp;
 }
 
+static void
+_add_tag_to_mask(FilterTags *self, LogTagId id)
+{
+  gint ndx = id >> LOGMSG_TAGS_NDX_SHIFT;
+
+  if (id == LOG_TAGS_UNDEF)
+    return;
+
+  if (ndx >= self->mask_len)
+    {
+      self->mask = g_renew(gulong, self->mask, ndx + 1);
+      memset(&self->mask[self->mask_len], 0, (ndx + 1 - self->mask_len) * sizeof(self->mask[0]));
+      self->mask_len = ndx + 1;
+    }
+  self->mask[ndx] |= (gulong) (1UL << (id & LOGMSG_TAGS_NDX_MASK));
+}
+
 void
 filter_tags_add(FilterExprNode *s, GList *tags)
 {
@@ -70,7 +92,7 @@ filter_tags_add(FilterExprNode *s, GList *tags)
       id = log_tags_get_by_name((gchar *) tags->data);
       g_free(tags->data);
       tags = g_list_delete_link(tags, tags);
-      g_array_append_val(self->tags, id);
+      _add_tag_to_mask(self, id);
     }
 }
 
@@ -79,7 +101,7 @@ filter_tags_free(FilterExprNode *s)
 {
   FilterTags *self = (FilterTags *)s;
 
-  g_array_free(self->tags, TRUE);
+  g_free(self->mask);
 }
 
 FilterExprNode *
@@ -88,12 +110,12 @@ filter_tags_new(GList *tags)
   FilterTags *self = g_new0(FilterTags, 1);
 
   filter_expr_node_init_instance(&self->super);
-  self->tags = g_array_new(FALSE, FALSE, sizeof(LogTagId));
 
   filter_tags_add(&self->super, tags);
 
   self->super.eval = filter_tags_eval;
   self->super.free_fn = filter_tags_free;
   self->super.type = "tags";
+  self->super.cost = FILTER_COST_TAGS;
   return &self->super;
 }
@@ -104,4 +104,107 @@ Test(filter_op, cloned_filter_with_negation_should_behave_the_same)
   testcase(msg, cloned_filter, TRUE);
 }
 
+Test(filter_op, adjacent_pri_filters_are_combined)
+{
+  const gchar *msg = "<16> openvpn[2499]: PTHREAD support initialized";
+  FilterExprNode *filter;
+
+  filter = _compile_standalone_filter("facility(2) or facility(3)");
+  cr_assert_str_eq(filter->type, "facility");
+  testcase(msg, filter, TRUE);
+
+  filter = _compile_standalone_filter("facility(3) or facility(4)");
+  cr_assert_str_eq(filter->type, "facility");
+  testcase(msg, filter, FALSE);
+
+  filter = _compile_standalone_filter("level(emerg..err) and level(emerg)");
+  cr_assert_str_eq(filter->type, "severity");
+  testcase(msg, filter, TRUE);
+
+  filter = _compile_standalone_filter("level(emerg..err) and level(warning)");
+  cr_assert_str_eq(filter->type, "severity");
+  testcase(msg, filter, FALSE);
+
+  /* negated and mixed operands are left alone */
+  filter = _compile_standalone_filter("(not facility(2)) or facility(3)");
+  cr_assert_str_eq(filter->type, "OR");
+  testcase(msg, filter, FALSE);
+
+  filter = _compile_standalone_filter("facility(2) and level(emerg)");
+  cr_assert_str_eq(filter->type, "AND");
+  testcase(msg, filter, TRUE);
+}
+
+Test(filter_op, reordering_keeps_operands_that_modify_the_message_in_place)
+{
+  const gchar *msg = "<16> openvpn[2499]: PTHREAD support initialized";
+
+  /* the cheaper string match depends on the match stored by the regexp */
+  testcase(msg, _compile_standalone_filter("message('(PTHREAD)' flags(store-matches)) and "
+                                           "match('PTHREAD' value('1') type('string'))"), TRUE);
+  testcase(msg, _compile_standalone_filter("message('^nomatch') or program('openvpn' type('string'))"), TRUE);
+  testcase(msg, _compile_standalone_filter("message('^nomatch') and program('openvpn' type('string'))"), FALSE);
+}
+
+static void
+_assert_batch_evaluation_matches_single_evaluation(gchar *config_snippet, gint num_msg)
+{
+  const gchar *programs[] = { "openvpn", "sshd", "cron" };
+  LogMessage *msgs[FILTER_EXPR_BATCH_MAX];
+  FilterExprNode *filter = _compile_standalone_filter(config_snippet);
+
+  cr_assert(filter_expr_init(filter, configuration));
+  for (gint i = 0; i < num_msg; i++)
+    {
+      msgs[i] = log_msg_new_empty();
+      msgs[i]->pri = i * 3;
+      log_msg_set_value(msgs[i], LM_V_PROGRAM, programs[i % 3], -1);
+    }
+
+  FilterExprBatchMask result = filter_expr_eval_batch(filter, msgs, num_msg, &DEFAULT_TEMPLATE_EVAL_OPTIONS);
+  cr_assert_eq(result & ~FILTER_EXPR_BATCH_ALL(num_msg), 0);
+
+  for (gint i = 0; i < num_msg; i++)
+    {
+      cr_assert_eq(!!(result & FILTER_EXPR_BATCH_BIT(i)), filter_expr_eval(filter, msgs[i]),
+                   "batch evaluation differs; filter=%s, pri=%d", config_snippet, msgs[i]->pri);
+      log_msg_unref(msgs[i]);
+    }
+  filter_expr_unref(filter);
+}
+
+Test(filter_op, batch_evaluation_gives_the_same_results_as_evaluating_messages_one_by_one)
+{
+  gchar *filters[] =
+  {
+    "facility(user) or program('sshd')",
+    "level(err..emerg) and not program('cron')",
+    "not (facility(2) and level(debug))",
+    "facility(3) or (program('openvpn') and level(info..debug))",
+    "not (facility(local0..local7) or program('^ss' type('pcre')))",
+    "facility(5)",
+  };
+
+  for (gint i = 0; i < G_N_ELEMENTS(filters); i++)
+    {
+      _assert_batch_evaluation_matches_single_evaluation(filters[i], FILTER_EXPR_BATCH_MAX);
+      _assert_batch_evaluation_matches_single_evaluation(filters[i], 5);
+    }
+}
+
+Test(filter_op, reinitializing_a_filter_keeps_its_cost)
+{
+  FilterExprNode *filter = _compile_standalone_filter("match('PTHREAD' type('string'))");
+  GlobalConfig *cfg = cfg_new_snippet();
+
+  cr_assert(filter_expr_init(filter, cfg));
+  cr_assert_eq(filter->cost, FILTER_COST_STRING + FILTER_COST_TEMPLATE);
+
+  cr_assert(filter_expr_init(filter, cfg));
+  cr_assert_eq(filter->cost, FILTER_COST_STRING + FILTER_COST_TEMPLATE);
+
+  filter_expr_unref(filter);
+  cfg_free(cfg);
+}
+
 TestSuite(filter_op, .init = setup, .fini = teardown);
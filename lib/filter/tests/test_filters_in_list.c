@@ -129,6 +129,19 @@ Test(template_filters, test_filter_with_long_line)
   g_free(list_file_with_long_line);
 }
 
+Test(template_filters, test_substring_flag_matches_lines_anywhere_in_the_value)
+{
+  gchar *list_file = g_strdup_printf(LIST_FILE_DIR "substrings.list", top_srcdir);
+
+  cr_assert(evaluate_testcase(MSG_1, filter_in_list_new_with_flags(list_file, "MESSAGE", FILTER_IN_LIST_SUBSTRING)),
+            "in-list filter does not match");
+  cr_assert_not(evaluate_testcase(MSG_1, filter_in_list_new_with_flags(list_file, "PROGRAM", FILTER_IN_LIST_SUBSTRING)),
+                "in-list filter matches");
+  cr_assert_not(evaluate_testcase(MSG_1, filter_in_list_new(list_file, "MESSAGE")),
+                "in-list filter without the substring flag matches");
+  g_free(list_file);
+}
+
 static void
 setup(void)
 {
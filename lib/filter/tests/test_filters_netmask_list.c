@@ -0,0 +1,113 @@
+/*
+ * Copyright (c) 2024 One Identity LLC.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#include <criterion/criterion.h>
+#include "test_filters_common.h"
+
+#include "filter/filter-netmask-list.h"
+
+#include <glib/gstdio.h>
+#include <unistd.h>
+
+#define MSG "<15>Oct 15 16:19:01 host openvpn[2499]: PTHREAD support initialized"
+
+static const gchar *list_file_content =
+  "# blocked networks\n"
+  "10.10.0.0/16\n"
+  "  192.168.1.0/255.255.255.0  \n"
+  "\n"
+  "172.16.1.1\n"
+  "10.20.30.0/24\n"
+  "2001:db8::/32\n"
+  "2001:db8:1::/48";
+
+static gchar *
+_create_list_file(const gchar *content)
+{
+  gchar *filename = NULL;
+  gint fd = g_file_open_tmp("netmask-list-XXXXXX", &filename, NULL);
+
+  cr_assert(fd >= 0);
+  cr_assert(write(fd, content, strlen(content)) == strlen(content));
+  close(fd);
+  return filename;
+}
+
+static FilterExprNode *
+_create_filter(const gchar *content)
+{
+  gchar *filename = _create_list_file(content);
+  FilterExprNode *filter = filter_netmask_list_new(filename);
+
+  g_unlink(filename);
+  g_free(filename);
+  return filter;
+}
+
+Test(filter_netmask_list, test_ipv4_addresses_are_matched_against_all_listed_networks)
+{
+  testcase_with_socket(MSG, "10.10.0.1", _create_filter(list_file_content), TRUE);
+  testcase_with_socket(MSG, "10.10.255.255", _create_filter(list_file_content), TRUE);
+  testcase_with_socket(MSG, "10.11.0.1", _create_filter(list_file_content), FALSE);
+  testcase_with_socket(MSG, "10.20.30.40", _create_filter(list_file_content), TRUE);
+  testcase_with_socket(MSG, "10.20.31.40", _create_filter(list_file_content), FALSE);
+  testcase_with_socket(MSG, "192.168.1.254", _create_filter(list_file_content), TRUE);
+  testcase_with_socket(MSG, "192.168.2.1", _create_filter(list_file_content), FALSE);
+  testcase_with_socket(MSG, "172.16.1.1", _create_filter(list_file_content), TRUE);
+  testcase_with_socket(MSG, "172.16.1.2", _create_filter(list_file_content), FALSE);
+}
+
+Test(filter_netmask_list, test_messages_without_address_are_matched_as_loopback)
+{
+  testcase(MSG, _create_filter(list_file_content), FALSE);
+  testcase(MSG, _create_filter("127.0.0.0/8\n"), TRUE);
+}
+
+Test(filter_netmask_list, test_nested_and_default_networks)
+{
+  testcase_with_socket(MSG, "10.1.2.3", _create_filter("10.1.2.0/24\n10.0.0.0/8\n"), TRUE);
+  testcase_with_socket(MSG, "10.200.2.3", _create_filter("10.1.2.0/24\n10.0.0.0/8\n"), TRUE);
+  testcase_with_socket(MSG, "11.1.2.3", _create_filter("10.1.2.0/24\n10.0.0.0/8\n"), FALSE);
+  testcase_with_socket(MSG, "11.1.2.3", _create_filter("0.0.0.0/0\n"), TRUE);
+}
+
+#if SYSLOG_NG_ENABLE_IPV6
+Test(filter_netmask_list, test_ipv6_addresses_are_matched_against_all_listed_networks)
+{
+  testcase_with_socket(MSG, "2001:db8:ffff::1", _create_filter(list_file_content), TRUE);
+  testcase_with_socket(MSG, "2001:db9::1", _create_filter(list_file_content), FALSE);
+  testcase_with_socket(MSG, "::ffff:10.10.0.1", _create_filter(list_file_content), TRUE);
+  testcase_with_socket(MSG, "::ffff:10.11.0.1", _create_filter(list_file_content), FALSE);
+}
+#endif
+
+Test(filter_netmask_list, test_invalid_list_files_are_rejected)
+{
+  cr_assert_null(filter_netmask_list_new("/nonexistent/netmask.list"));
+  cr_assert_null(_create_filter("10.0.0.0/33\n"));
+  cr_assert_null(_create_filter("10.0.0.0/255.0.255.0\n"));
+  cr_assert_null(_create_filter("not-an-address\n"));
+  cr_assert_null(_create_filter("2001:db8::/129\n"));
+}
+
+TestSuite(filter_netmask_list, .init = setup, .fini = teardown);
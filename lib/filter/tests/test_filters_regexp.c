@@ -382,3 +382,103 @@ Test(filter, test_match_with_template_non_trivial)
   filter_match_set_template_ref(filter, compile_template("$PID $PROGRAM"));
   testcase("<15>Oct 15 16:17:01 host openvpn[2499]: PTHREAD support initialized", filter, TRUE);
 }
+
+static void
+_assert_equality_keys(FilterExprNode *filter, NVHandle expected_handle, const gchar *expected_keys)
+{
+  NVHandle handle = LM_V_NONE;
+  GPtrArray *keys = g_ptr_array_new_with_free_func(g_free);
+
+  if (!expected_keys)
+    {
+      cr_assert_not(filter_expr_get_equality_keys(filter, &handle, keys));
+    }
+  else
+    {
+      cr_assert(filter_expr_get_equality_keys(filter, &handle, keys));
+      cr_assert_eq(handle, expected_handle);
+
+      g_ptr_array_add(keys, NULL);
+      gchar *joined_keys = g_strjoinv(",", (gchar **) keys->pdata);
+      cr_assert_str_eq(joined_keys, expected_keys);
+      g_free(joined_keys);
+    }
+
+  g_ptr_array_unref(keys);
+  filter_expr_unref(filter);
+}
+
+Test(filter, test_equality_keys_of_filters_comparing_with_constant_strings)
+{
+  _assert_equality_keys(compile_pattern(filter_re_new(LM_V_PROGRAM), "sshd", "string", 0), LM_V_PROGRAM, "sshd");
+  _assert_equality_keys(create_pcre_regexp_filter(LM_V_HOST, "^web\\.example$", 0), LM_V_HOST,
+                        "web.example,web.example\n");
+  _assert_equality_keys(fop_or_new(compile_pattern(filter_re_new(LM_V_PROGRAM), "cron", "string", 0),
+                                   create_pcre_regexp_filter(LM_V_PROGRAM, "^crond$", 0)),
+                        LM_V_PROGRAM, "cron,crond,crond\n");
+
+  _assert_equality_keys(create_pcre_regexp_filter(LM_V_PROGRAM, "sshd", 0), 0, NULL);
+  _assert_equality_keys(create_pcre_regexp_filter(LM_V_PROGRAM, "^ssh.$", 0), 0, NULL);
+  _assert_equality_keys(create_pcre_regexp_filter(LM_V_PROGRAM, "^sshd$", LMF_ICASE), 0, NULL);
+  _assert_equality_keys(compile_pattern(filter_re_new(LM_V_PROGRAM), "ssh", "string", LMF_PREFIX), 0, NULL);
+  _assert_equality_keys(fop_or_new(compile_pattern(filter_re_new(LM_V_PROGRAM), "cron", "string", 0),
+                                   compile_pattern(filter_re_new(LM_V_HOST), "cron", "string", 0)),
+                        0, NULL);
+  _assert_equality_keys(fop_and_new(compile_pattern(filter_re_new(LM_V_PROGRAM), "cron", "string", 0),
+                                    compile_pattern(filter_re_new(LM_V_PROGRAM), "crond", "string", 0)),
+                        0, NULL);
+
+  FilterExprNode *negated = compile_pattern(filter_re_new(LM_V_PROGRAM), "sshd", "string", 0);
+  negated->comp = TRUE;
+  _assert_equality_keys(negated, 0, NULL);
+}
+
+static void
+_assert_value_matchers(FilterExprNode *filter, NVHandle expected_handle, const gchar *expected_patterns)
+{
+  NVHandle handle = LM_V_NONE;
+  GPtrArray *matchers = g_ptr_array_new();
+
+  if (!expected_patterns)
+    {
+      cr_assert_not(filter_expr_get_value_matchers(filter, &handle, matchers));
+    }
+  else
+    {
+      cr_assert(filter_expr_get_value_matchers(filter, &handle, matchers));
+      cr_assert_eq(handle, expected_handle);
+
+      GString *patterns = g_string_new("");
+      for (guint i = 0; i < matchers->len; i++)
+        {
+          LogMatcher *matcher = g_ptr_array_index(matchers, i);
+          g_string_append_printf(patterns, "%s%s", i ? "," : "", matcher->pattern);
+        }
+      cr_assert_str_eq(patterns->str, expected_patterns);
+      g_string_free(patterns, TRUE);
+    }
+
+  g_ptr_array_unref(matchers);
+  filter_expr_unref(filter);
+}
+
+Test(filter, test_value_matchers_of_filters_matching_a_single_value)
+{
+  _assert_value_matchers(create_pcre_regexp_filter(LM_V_MESSAGE, "Failed password for .* from", 0), LM_V_MESSAGE,
+                         "Failed password for .* from");
+  _assert_value_matchers(fop_or_new(create_pcre_regexp_filter(LM_V_MESSAGE, "^session", 0),
+                                    compile_pattern(filter_re_new(LM_V_MESSAGE), "*cron*", "glob", 0)),
+                         LM_V_MESSAGE, "^session,*cron*");
+
+  _assert_value_matchers(create_pcre_regexp_filter(LM_V_MESSAGE, "(sshd)", LMF_STORE_MATCHES), 0, NULL);
+  _assert_value_matchers(fop_or_new(create_pcre_regexp_filter(LM_V_MESSAGE, "sshd", 0),
+                                    create_pcre_regexp_filter(LM_V_HOST, "sshd", 0)),
+                         0, NULL);
+  _assert_value_matchers(fop_and_new(create_pcre_regexp_filter(LM_V_MESSAGE, "ssh", 0),
+                                     create_pcre_regexp_filter(LM_V_MESSAGE, "sshd", 0)),
+                         0, NULL);
+
+  FilterExprNode *negated = create_pcre_regexp_filter(LM_V_MESSAGE, "sshd", 0);
+  negated->comp = TRUE;
+  _assert_value_matchers(negated, 0, NULL);
+}
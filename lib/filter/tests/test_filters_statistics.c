@@ -97,3 +97,70 @@ Test(test_filters_statistics, filter_stastistics)
   log_pipe_deinit(&p->super);
   log_pipe_unref(&p->super);
 }
+
+typedef struct _CountingFilter
+{
+  FilterExprNode super;
+  gint num_evals;
+} CountingFilter;
+
+static gboolean
+_counting_filter_eval(FilterExprNode *s, LogMessage **msgs, gint num_msg, LogTemplateEvalOptions *options)
+{
+  CountingFilter *self = (CountingFilter *) s;
+
+  self->num_evals++;
+  return TRUE ^ s->comp;
+}
+
+static CountingFilter *
+_counting_filter_new(void)
+{
+  CountingFilter *self = g_new0(CountingFilter, 1);
+
+  filter_expr_node_init_instance(&self->super);
+  self->super.eval = _counting_filter_eval;
+  self->super.type = "counting";
+  self->super.cost = FILTER_COST_PRI;
+  return self;
+}
+
+static void
+_queue_msg(LogPipe *p, LogMessage *msg)
+{
+  LogPathOptions path_options = LOG_PATH_OPTIONS_INIT;
+
+  p->queue(p, log_msg_ref(msg), &path_options);
+}
+
+Test(test_filters_statistics, filter_results_are_reused_by_clones_of_the_same_rule)
+{
+  CountingFilter *filter = _counting_filter_new();
+  LogFilterPipe *p1 = (LogFilterPipe *) log_filter_pipe_new(&filter->super, configuration);
+
+  p1->name = g_strdup("f_shared");
+  LogFilterPipe *p2 = (LogFilterPipe *) log_pipe_clone(&p1->super);
+  cr_assert(log_pipe_init(&p1->super));
+  cr_assert(log_pipe_init(&p2->super));
+  cr_assert_eq(p1->result_slot, p2->result_slot);
+  cr_assert_geq(p1->result_slot, 0);
+
+  LogMessage *msg = log_msg_new_empty();
+  log_msg_write_protect(msg);
+  _queue_msg(&p1->super, msg);
+  _queue_msg(&p2->super, msg);
+  cr_assert_eq(filter->num_evals, 1);
+  log_msg_unref(msg);
+
+  /* writable messages may change between the evaluations */
+  msg = log_msg_new_empty();
+  _queue_msg(&p1->super, msg);
+  _queue_msg(&p2->super, msg);
+  cr_assert_eq(filter->num_evals, 3);
+  log_msg_unref(msg);
+
+  log_pipe_deinit(&p1->super);
+  log_pipe_deinit(&p2->super);
+  log_pipe_unref(&p1->super);
+  log_pipe_unref(&p2->super);
+}
@@ -24,70 +24,262 @@
 #include "find-crlf.h"
 
 #include <string.h>
-/**
- * This is an optimized version of finding either a CR or LF or NUL
- * character in a buffer.  It is used to find these line terminators in
- * syslog traffic.
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#define FIND_CRLF_SSE2 1
+#define FIND_CRLF_AVX2 1
+#include <immintrin.h>
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#define FIND_CRLF_NEON 1
+#include <arm_neon.h>
+#endif
+
+/*
+ * Delimiter search used to split incoming data to lines.
  *
- * It uses an algorithm very similar to what there's in libc memchr/strchr.
- **/
-gchar *
-find_cr_or_lf_or_nul(gchar *s, gsize n)
+ * All implementations look for the first occurrence of any of
+ * FIND_CRLF_SET_SIZE characters.  Sets with fewer characters are padded by
+ * repeating their first character, so the inner loops never need to branch
+ * on the size of the set.
+ *
+ * SSE2 and NEON are part of the baseline instruction set of x86-64 and
+ * aarch64 respectively, AVX2 is only used if the CPU we are running on
+ * supports it.  The implementation is selected upon first use.
+ */
+
+#define FIND_CRLF_SET_SIZE 4
+
+typedef const gchar *(*FindCharSetFunc)(const gchar *s, gsize n, const guchar *set);
+
+typedef struct _FindCrlfImplementation
+{
+  const gchar *name;
+  FindCharSetFunc find;
+  gboolean (*is_supported)(void);
+} FindCrlfImplementation;
+
+static inline gboolean
+_is_in_set(guchar c, const guchar *set)
 {
-  gchar *char_ptr;
-  gulong *longword_ptr;
-  gulong longword, magic_bits, cr_charmask, lf_charmask;
-  const char CR = '\r';
-  const char LF = '\n';
+  return c == set[0] || c == set[1] || c == set[2] || c == set[3];
+}
 
-  /* align input to long boundary */
-  for (char_ptr = s; n > 0 && ((gulong) char_ptr & (sizeof(longword) - 1)) != 0; ++char_ptr, n--)
+static const gchar *
+_find_char_set_scalar(const gchar *s, gsize n, const guchar *set)
+{
+  for (gsize i = 0; i < n; i++)
     {
-      if (*char_ptr == CR || *char_ptr == LF || *char_ptr == 0)
-        return char_ptr;
+      if (_is_in_set((guchar) s[i], set))
+        return s + i;
     }
+  return NULL;
+}
+
+static gboolean
+_always_supported(void)
+{
+  return TRUE;
+}
+
+#if FIND_CRLF_SSE2
 
-  longword_ptr = (gulong *) char_ptr;
+static const gchar *
+_find_char_set_sse2(const gchar *s, gsize n, const guchar *set)
+{
+  const __m128i c0 = _mm_set1_epi8(set[0]);
+  const __m128i c1 = _mm_set1_epi8(set[1]);
+  const __m128i c2 = _mm_set1_epi8(set[2]);
+  const __m128i c3 = _mm_set1_epi8(set[3]);
+  gsize i = 0;
+
+  for (; i + 16 <= n; i += 16)
+    {
+      __m128i v = _mm_loadu_si128((const __m128i *) (s + i));
+      __m128i match = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, c0), _mm_cmpeq_epi8(v, c1)),
+                                   _mm_or_si128(_mm_cmpeq_epi8(v, c2), _mm_cmpeq_epi8(v, c3)));
+      guint mask = _mm_movemask_epi8(match);
+
+      if (mask)
+        return s + i + __builtin_ctz(mask);
+    }
+  return _find_char_set_scalar(s + i, n - i, set);
+}
 
-#if GLIB_SIZEOF_LONG == 8
-  magic_bits = 0x7efefefefefefeffL;
-#elif GLIB_SIZEOF_LONG == 4
-  magic_bits = 0x7efefeffL;
-#else
-#error "unknown architecture"
 #endif
-  memset(&cr_charmask, CR, sizeof(cr_charmask));
-  memset(&lf_charmask, LF, sizeof(lf_charmask));
 
-  while (n > sizeof(longword))
+#if FIND_CRLF_AVX2
+
+__attribute__((target("avx2")))
+static const gchar *
+_find_char_set_avx2(const gchar *s, gsize n, const guchar *set)
+{
+  const __m256i c0 = _mm256_set1_epi8(set[0]);
+  const __m256i c1 = _mm256_set1_epi8(set[1]);
+  const __m256i c2 = _mm256_set1_epi8(set[2]);
+  const __m256i c3 = _mm256_set1_epi8(set[3]);
+  gsize i = 0;
+
+  for (; i + 32 <= n; i += 32)
     {
-      longword = *longword_ptr++;
-      if ((((longword + magic_bits) ^ ~longword) & ~magic_bits) != 0 ||
-          ((((longword ^ cr_charmask) + magic_bits) ^ ~(longword ^ cr_charmask)) & ~magic_bits) != 0 ||
-          ((((longword ^ lf_charmask) + magic_bits) ^ ~(longword ^ lf_charmask)) & ~magic_bits) != 0)
-        {
-          gint i;
+      __m256i v = _mm256_loadu_si256((const __m256i *) (s + i));
+      __m256i match = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(v, c0), _mm256_cmpeq_epi8(v, c1)),
+                                      _mm256_or_si256(_mm256_cmpeq_epi8(v, c2), _mm256_cmpeq_epi8(v, c3)));
+      guint mask = _mm256_movemask_epi8(match);
+
+      if (mask)
+        return s + i + __builtin_ctz(mask);
+    }
+  return _find_char_set_sse2(s + i, n - i, set);
+}
+
+static gboolean
+_avx2_supported(void)
+{
+  __builtin_cpu_init();
+  return __builtin_cpu_supports("avx2");
+}
+
+#endif
+
+#if FIND_CRLF_NEON
+
+static const gchar *
+_find_char_set_neon(const gchar *s, gsize n, const guchar *set)
+{
+  const uint8x16_t c0 = vdupq_n_u8(set[0]);
+  const uint8x16_t c1 = vdupq_n_u8(set[1]);
+  const uint8x16_t c2 = vdupq_n_u8(set[2]);
+  const uint8x16_t c3 = vdupq_n_u8(set[3]);
+  gsize i = 0;
+
+  for (; i + 16 <= n; i += 16)
+    {
+      uint8x16_t v = vld1q_u8((const guint8 *) (s + i));
+      uint8x16_t match = vorrq_u8(vorrq_u8(vceqq_u8(v, c0), vceqq_u8(v, c1)),
+                                  vorrq_u8(vceqq_u8(v, c2), vceqq_u8(v, c3)));
+
+      /* narrow each byte of the comparison result to 4 bits */
+      guint64 mask = vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(match), 4)), 0);
 
-          char_ptr = (gchar *) (longword_ptr - 1);
+      if (mask)
+        return s + i + (__builtin_ctzll(mask) >> 2);
+    }
+  return _find_char_set_scalar(s + i, n - i, set);
+}
+
+#endif
+
+static const FindCrlfImplementation implementations[] =
+{
+#if FIND_CRLF_AVX2
+  { "avx2", _find_char_set_avx2, _avx2_supported },
+#endif
+#if FIND_CRLF_SSE2
+  { "sse2", _find_char_set_sse2, _always_supported },
+#endif
+#if FIND_CRLF_NEON
+  { "neon", _find_char_set_neon, _always_supported },
+#endif
+  { "scalar", _find_char_set_scalar, _always_supported },
+};
+
+static const FindCrlfImplementation *current_implementation;
+
+static const FindCrlfImplementation *
+_select_implementation(void)
+{
+  for (gint i = 0; i < G_N_ELEMENTS(implementations); i++)
+    {
+      if (implementations[i].is_supported())
+        return &implementations[i];
+    }
+  g_assert_not_reached();
+}
+
+static inline FindCharSetFunc
+_get_find_char_set(void)
+{
+  const FindCrlfImplementation *impl = g_atomic_pointer_get(&current_implementation);
+
+  if (G_UNLIKELY(!impl))
+    {
+      impl = _select_implementation();
+      g_atomic_pointer_set(&current_implementation, impl);
+    }
+  return impl->find;
+}
+
+const gchar *
+find_crlf_get_implementation(void)
+{
+  _get_find_char_set();
+  return current_implementation->name;
+}
 
-          for (i = 0; i < sizeof(longword); i++)
-            {
-              if (*char_ptr == CR || *char_ptr == LF || *char_ptr == 0)
-                return char_ptr;
-              char_ptr++;
-            }
+/* used by the unit tests and benchmarks to exercise all implementations */
+gboolean
+find_crlf_set_implementation(const gchar *name)
+{
+  for (gint i = 0; i < G_N_ELEMENTS(implementations); i++)
+    {
+      if (strcmp(implementations[i].name, name) == 0)
+        {
+          if (!implementations[i].is_supported())
+            return FALSE;
+          g_atomic_pointer_set(&current_implementation, &implementations[i]);
+          return TRUE;
         }
-      n -= sizeof(longword);
     }
+  return FALSE;
+}
+
+/**
+ * Find either a CR or LF or NUL character in a buffer.  It is used to find
+ * these line terminators in syslog traffic.
+ **/
+gchar *
+find_cr_or_lf_or_nul(gchar *s, gsize n)
+{
+  static const guchar set[FIND_CRLF_SET_SIZE] = { '\r', '\n', '\0', '\0' };
 
-  char_ptr = (gchar *) longword_ptr;
+  return (gchar *) _get_find_char_set()(s, n, set);
+}
 
-  while (n-- > 0)
+const guchar *
+find_lf_or_nul(const guchar *s, gsize n)
+{
+  static const guchar set[FIND_CRLF_SET_SIZE] = { '\n', '\0', '\0', '\0' };
+
+  return (const guchar *) _get_find_char_set()((const gchar *) s, n, set);
+}
+
+/**
+ * Find the first occurrence of any of the characters in @chars.  Sets of
+ * up to FIND_CRLF_SET_SIZE characters are searched for using the vectorized
+ * implementations, larger ones fall back to a lookup table.
+ **/
+const gchar *
+find_first_of(const gchar *s, gsize n, const gchar *chars, gsize chars_len)
+{
+  g_assert(chars_len > 0);
+
+  if (chars_len <= FIND_CRLF_SET_SIZE)
     {
-      if (*char_ptr == CR || *char_ptr == LF || *char_ptr == 0)
-        return char_ptr;
-      ++char_ptr;
+      guchar set[FIND_CRLF_SET_SIZE];
+
+      for (gint i = 0; i < FIND_CRLF_SET_SIZE; i++)
+        set[i] = chars[i < chars_len ? i : 0];
+      return _get_find_char_set()(s, n, set);
     }
 
+  gboolean table[256] = { 0 };
+  for (gsize i = 0; i < chars_len; i++)
+    table[(guchar) chars[i]] = TRUE;
+
+  for (gsize i = 0; i < n; i++)
+    {
+      if (table[(guchar) s[i]])
+        return s + i;
+    }
   return NULL;
 }
@@ -27,5 +27,10 @@
 #include "syslog-ng.h"
 
 gchar *find_cr_or_lf_or_nul(gchar *s, gsize n);
+const guchar *find_lf_or_nul(const guchar *s, gsize n);
+const gchar *find_first_of(const gchar *s, gsize n, const gchar *chars, gsize chars_len);
+
+const gchar *find_crlf_get_implementation(void);
+gboolean find_crlf_set_implementation(const gchar *name);
 
 #endif
@@ -340,6 +340,76 @@ sockaddr_to_dnscache_key(GSockAddr *saddr)
     }
 }
 
+static const gchar *
+resolve_address(GSockAddr *saddr, gchar *buf, gsize buf_len)
+{
+#ifdef SYSLOG_NG_HAVE_GETNAMEINFO
+  return resolve_address_using_getnameinfo(saddr, buf, buf_len);
+#else
+  return resolve_address_using_gethostbyaddr(saddr, buf, buf_len);
+#endif
+}
+
+/****************************************************************************
+ * Background resolution, use-dns(async)
+ *
+ * With use-dns(async), an address missing from the DNS cache is resolved
+ * by a small pool of resolver threads, and the messages received until the
+ * name is known carry the IP address in $HOST.  Positive entries are also
+ * refreshed in the background shortly before they expire, so a busy
+ * address is never resolved on the reader thread.
+ ****************************************************************************/
+
+#define HOST_RESOLVE_ASYNC_THREADS 4
+
+G_LOCK_DEFINE_STATIC(resolver_pool);
+static GThreadPool *resolver_pool;
+
+static void
+_resolve_in_background(gpointer data, gpointer user_data)
+{
+  GSockAddr *saddr = (GSockAddr *) data;
+  gchar buf[256];
+  const gchar *hname;
+  gboolean positive;
+
+  hname = resolve_address(saddr, buf, sizeof(buf));
+  positive = (hname != NULL);
+  if (!hname)
+    hname = g_sockaddr_format(saddr, buf, sizeof(buf), GSA_ADDRESS_ONLY);
+
+  dns_caching_store(saddr->sa.sa_family, sockaddr_to_dnscache_key(saddr), hname, positive);
+  g_sockaddr_unref(saddr);
+}
+
+static gboolean
+_submit_background_resolve(GSockAddr *saddr)
+{
+  GError *error = NULL;
+
+  G_LOCK(resolver_pool);
+  if (!resolver_pool)
+    resolver_pool = g_thread_pool_new(_resolve_in_background, NULL, HOST_RESOLVE_ASYNC_THREADS, FALSE, &error);
+  if (resolver_pool)
+    g_thread_pool_push(resolver_pool, g_sockaddr_ref(saddr), NULL);
+  G_UNLOCK(resolver_pool);
+
+  if (error)
+    {
+      msg_error("Error starting background DNS resolver threads, resolving names synchronously",
+                evt_tag_str("error", error->message));
+      g_clear_error(&error);
+    }
+  return resolver_pool != NULL;
+}
+
+static inline gboolean
+_is_async_resolve_possible(const HostResolveOptions *host_resolve_options)
+{
+  /* the result is delivered through the DNS cache */
+  return host_resolve_options->use_dns == HOST_RESOLVE_USE_DNS_ASYNC && host_resolve_options->use_dns_cache;
+}
+
 static const gchar *
 resolve_sockaddr_to_inet_or_inet6_hostname(gsize *result_len, GSockAddr *saddr,
                                            const HostResolveOptions *host_resolve_options)
@@ -347,6 +417,8 @@ resolve_sockaddr_to_inet_or_inet6_hostname(gsize *result_len, GSockAddr *saddr,
   const gchar *hname;
   gsize hname_len;
   gboolean positive;
+  gboolean refresh_needed = FALSE;
+  gboolean async_resolve = _is_async_resolve_possible(host_resolve_options);
   void *dnscache_key;
 
   dnscache_key = sockaddr_to_dnscache_key(saddr);
@@ -356,17 +428,27 @@ resolve_sockaddr_to_inet_or_inet6_hostname(gsize *result_len, GSockAddr *saddr,
 
   if (host_resolve_options->use_dns_cache)
     {
-      if (dns_caching_lookup(saddr->sa.sa_family, dnscache_key, (const gchar **) &hname, &hname_len, &positive))
-        return hostname_apply_options_fqdn(hname_len, result_len, hname, positive, host_resolve_options);
+      if (dns_caching_lookup(saddr->sa.sa_family, dnscache_key, (const gchar **) &hname, &hname_len, &positive,
+                             async_resolve ? &refresh_needed : NULL))
+        {
+          if (refresh_needed)
+            _submit_background_resolve(saddr);
+          return hostname_apply_options_fqdn(hname_len, result_len, hname, positive, host_resolve_options);
+        }
     }
 
-  if (!hname && host_resolve_options->use_dns && host_resolve_options->use_dns != 2)
+  if (!hname && async_resolve)
     {
-#ifdef SYSLOG_NG_HAVE_GETNAMEINFO
-      hname = resolve_address_using_getnameinfo(saddr, hostname_buffer, sizeof(hostname_buffer));
-#else
-      hname = resolve_address_using_gethostbyaddr(saddr, hostname_buffer, sizeof(hostname_buffer));
-#endif
+      if (!dns_caching_begin_resolve(saddr->sa.sa_family, dnscache_key) || _submit_background_resolve(saddr))
+        {
+          hname = g_sockaddr_format(saddr, hostname_buffer, sizeof(hostname_buffer), GSA_ADDRESS_ONLY);
+          return hostname_apply_options_fqdn(-1, result_len, hname, FALSE, host_resolve_options);
+        }
+    }
+
+  if (!hname && host_resolve_options->use_dns && host_resolve_options->use_dns != HOST_RESOLVE_USE_DNS_PERSIST_ONLY)
+    {
+      hname = resolve_address(saddr, hostname_buffer, sizeof(hostname_buffer));
       positive = (hname != NULL);
     }
 
@@ -484,3 +566,13 @@ host_resolve_global_init(void)
 {
   register_application_hook(AH_CONFIG_STOPPED, _reinit_resolver, NULL, AHM_RUN_REPEAT);
 }
+
+void
+host_resolve_global_deinit(void)
+{
+  G_LOCK(resolver_pool);
+  if (resolver_pool)
+    g_thread_pool_free(resolver_pool, TRUE, TRUE);
+  resolver_pool = NULL;
+  G_UNLOCK(resolver_pool);
+}
@@ -26,6 +26,10 @@
 #include "syslog-ng.h"
 #include "gsockaddr.h"
 
+/* use_dns values besides TRUE and FALSE */
+#define HOST_RESOLVE_USE_DNS_PERSIST_ONLY 2
+#define HOST_RESOLVE_USE_DNS_ASYNC 3
+
 typedef struct _HostResolveOptions
 {
   gboolean use_dns;
@@ -46,4 +50,7 @@ void host_resolve_options_init_globals(HostResolveOptions *options);
 void host_resolve_options_init(HostResolveOptions *options, HostResolveOptions *global_options);
 void host_resolve_options_destroy(HostResolveOptions *options);
 
+void host_resolve_global_init(void);
+void host_resolve_global_deinit(void);
+
 #endif
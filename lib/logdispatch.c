@@ -0,0 +1,202 @@
+/*
+ * Copyright (c) 2024 One Identity LLC.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#include "logdispatch.h"
+#include "cfg-walker.h"
+
+#include <string.h>
+
+typedef struct _LogDispatcherKey
+{
+  gchar *value;
+  gsize value_len;
+} LogDispatcherKey;
+
+static guint
+_key_hash(gconstpointer k)
+{
+  const LogDispatcherKey *key = (const LogDispatcherKey *) k;
+  guint32 h = 5381;
+
+  for (gsize i = 0; i < key->value_len; i++)
+    h = (h << 5) + h + (guchar) key->value[i];
+  return h;
+}
+
+static gboolean
+_key_equal(gconstpointer a, gconstpointer b)
+{
+  const LogDispatcherKey *key_a = (const LogDispatcherKey *) a;
+  const LogDispatcherKey *key_b = (const LogDispatcherKey *) b;
+
+  return key_a->value_len == key_b->value_len && memcmp(key_a->value, key_b->value, key_a->value_len) == 0;
+}
+
+static void
+_key_free(gpointer k)
+{
+  LogDispatcherKey *key = (LogDispatcherKey *) k;
+
+  g_free(key->value);
+  g_free(key);
+}
+
+/*
+ * @keys are the strings that select @branch_head, keys that are already
+ * associated with a branch are ignored, as the first matching branch of
+ * an if/elif chain wins.  @keys is NULL if the branches are selected by
+ * a matcher, where the branch is identified by the order of the calls.
+ */
+void
+log_dispatcher_add_branch(LogDispatcher *self, LogPipe *branch_head, GPtrArray *keys)
+{
+  for (guint i = 0; keys && i < keys->len; i++)
+    {
+      const gchar *value = g_ptr_array_index(keys, i);
+      LogDispatcherKey lookup_key = { (gchar *) value, strlen(value) };
+
+      if (g_hash_table_contains(self->branches, &lookup_key))
+        continue;
+
+      LogDispatcherKey *key = g_new0(LogDispatcherKey, 1);
+      key->value = g_strdup(value);
+      key->value_len = lookup_key.value_len;
+      g_hash_table_insert(self->branches, key, branch_head);
+    }
+  g_ptr_array_add(self->next_hops, branch_head);
+}
+
+void
+log_dispatcher_set_default_branch(LogDispatcher *self, LogPipe *branch_head)
+{
+  self->default_branch = branch_head;
+  g_ptr_array_add(self->next_hops, branch_head);
+}
+
+/* takes ownership of @matcher, the ids of its patterns are the branch indexes */
+void
+log_dispatcher_set_matcher(LogDispatcher *self, LogMultiMatcher *matcher)
+{
+  if (self->matcher)
+    log_multi_matcher_free(self->matcher);
+  self->matcher = matcher;
+}
+
+static gboolean
+log_dispatcher_init(LogPipe *s)
+{
+  LogDispatcher *self = (LogDispatcher *) s;
+
+  g_assert(self->default_branch);
+  return TRUE;
+}
+
+static LogPipe *
+_match_branch(LogDispatcher *self, LogMessage *msg)
+{
+  gssize value_len;
+  const gchar *value = log_msg_get_value(msg, self->value_handle, &value_len);
+
+  gint branch = log_multi_matcher_match_first(self->matcher, msg, self->value_handle, value, value_len);
+  if (branch < 0)
+    return self->default_branch;
+  return g_ptr_array_index(self->next_hops, branch);
+}
+
+static LogPipe *
+_lookup_branch(LogDispatcher *self, LogMessage *msg)
+{
+  LogDispatcherKey key;
+  gssize value_len;
+
+  if (self->matcher)
+    return _match_branch(self, msg);
+
+  key.value = (gchar *) log_msg_get_value(msg, self->value_handle, &value_len);
+  key.value_len = value_len;
+
+  LogPipe *branch_head = g_hash_table_lookup(self->branches, &key);
+  return branch_head ? : self->default_branch;
+}
+
+static void
+log_dispatcher_queue(LogPipe *s, LogMessage *msg, const LogPathOptions *path_options)
+{
+  LogDispatcher *self = (LogDispatcher *) s;
+  gboolean matched = TRUE;
+  LogPathOptions local_options;
+
+  LogPipe *next_hop = _lookup_branch(self, msg);
+
+  log_path_options_push_junction(&local_options, &matched, path_options);
+  log_pipe_queue(next_hop, log_msg_add_ack_and_ref(msg, &local_options), &local_options);
+
+  /* the branch dropped the message before its conditional-midpoint (e.g.
+   * the else branch filtered it out), let our parent know, the same way
+   * LogMultiplexer does */
+  if (!matched && path_options->matched)
+    *path_options->matched = FALSE;
+  log_pipe_forward_msg(s, msg, path_options);
+}
+
+static void
+log_dispatcher_free(LogPipe *s)
+{
+  LogDispatcher *self = (LogDispatcher *) s;
+
+  g_hash_table_unref(self->branches);
+  if (self->matcher)
+    log_multi_matcher_free(self->matcher);
+  g_ptr_array_free(self->next_hops, TRUE);
+  log_pipe_free_method(s);
+}
+
+static GList *
+_arcs(LogPipe *s)
+{
+  LogDispatcher *self = (LogDispatcher *) s;
+  GList *list = NULL;
+
+  for (guint i = 0; i < self->next_hops->len; i++)
+    list = g_list_append(list, arc_new(s, g_ptr_array_index(self->next_hops, i), ARC_TYPE_NEXT_HOP));
+  if (s->pipe_next)
+    list = g_list_append(list, arc_new(s, s->pipe_next, ARC_TYPE_PIPE_NEXT));
+  return list;
+}
+
+LogDispatcher *
+log_dispatcher_new(GlobalConfig *cfg, NVHandle value_handle)
+{
+  LogDispatcher *self = g_new0(LogDispatcher, 1);
+
+  log_pipe_init_instance(&self->super, cfg);
+  self->super.init = log_dispatcher_init;
+  self->super.queue = log_dispatcher_queue;
+  self->super.free_fn = log_dispatcher_free;
+  self->super.arcs = _arcs;
+  self->value_handle = value_handle;
+  self->branches = g_hash_table_new_full(_key_hash, _key_equal, _key_free, NULL);
+  self->next_hops = g_ptr_array_new();
+  log_pipe_add_info(&self->super, "dispatcher");
+  return self;
+}
@@ -0,0 +1,60 @@
+/*
+ * Copyright (c) 2024 One Identity LLC.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#ifndef LOGDISPATCH_H_INCLUDED
+#define LOGDISPATCH_H_INCLUDED
+
+#include "logpipe.h"
+#include "logmatcher-multi.h"
+
+/*
+ * This class routes each message to exactly one of its branches, chosen
+ * by looking up the value of a name-value pair in a hash table, or by
+ * matching it against the patterns of the branches with a LogMultiMatcher.
+ * Messages with values that are not associated with any of the branches go
+ * to the default branch.
+ *
+ * It replaces the chain of multiplexers of an if/elif/else block where all
+ * conditions compare the same name-value pair with constant strings, or
+ * match it against patterns, see cfg_tree_compile_conditional().  Path
+ * options are handled the same way as the multiplexer at the head of a
+ * conditional does.
+ */
+typedef struct _LogDispatcher
+{
+  LogPipe super;
+  NVHandle value_handle;
+  GHashTable *branches;
+  /* if set, it selects the branch by its index in next_hops */
+  LogMultiMatcher *matcher;
+  GPtrArray *next_hops;
+  LogPipe *default_branch;
+} LogDispatcher;
+
+void log_dispatcher_add_branch(LogDispatcher *self, LogPipe *branch_head, GPtrArray *keys);
+void log_dispatcher_set_default_branch(LogDispatcher *self, LogPipe *branch_head);
+void log_dispatcher_set_matcher(LogDispatcher *self, LogMultiMatcher *matcher);
+
+LogDispatcher *log_dispatcher_new(GlobalConfig *cfg, NVHandle value_handle);
+
+#endif
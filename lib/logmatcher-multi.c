@@ -0,0 +1,348 @@
+/*
+ * Copyright (c) 2024 One Identity LLC.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#include "logmatcher-multi.h"
+#include "messages.h"
+#include "tls-support.h"
+
+#include <string.h>
+
+#if SYSLOG_NG_ENABLE_HYPERSCAN
+#include <hs.h>
+#endif
+
+typedef struct _LogMultiMatcherEntry
+{
+  LogMatcher *matcher;
+  gint id;
+  /* the pattern is part of the database, no need to run the matcher itself */
+  gboolean compiled;
+#if SYSLOG_NG_ENABLE_HYPERSCAN
+  guint hs_flags;
+#endif
+} LogMultiMatcherEntry;
+
+struct _LogMultiMatcher
+{
+  GArray *entries;
+  guint compiled_count;
+#if SYSLOG_NG_ENABLE_HYPERSCAN
+  hs_database_t *database;
+#endif
+};
+
+#if SYSLOG_NG_ENABLE_HYPERSCAN
+
+/*
+ * Scratch space is needed for every scan, and it has to be large enough
+ * for the database being scanned.  It is allocated for all databases in
+ * the prototype at compile time, which threads clone when they scan for
+ * the first time, or when a database compiled since then needed more.
+ */
+static GMutex scratch_prototype_lock;
+static hs_scratch_t *scratch_prototype;
+static gint scratch_prototype_generation;
+
+TLS_BLOCK_START
+{
+  hs_scratch_t *log_multi_matcher_scratch;
+  gint log_multi_matcher_scratch_generation;
+}
+TLS_BLOCK_END;
+
+#define log_multi_matcher_scratch  __tls_deref(log_multi_matcher_scratch)
+#define log_multi_matcher_scratch_generation  __tls_deref(log_multi_matcher_scratch_generation)
+
+static gboolean
+_grow_scratch_prototype(hs_database_t *database)
+{
+  g_mutex_lock(&scratch_prototype_lock);
+  hs_error_t rc = hs_alloc_scratch(database, &scratch_prototype);
+  if (rc == HS_SUCCESS)
+    g_atomic_int_inc(&scratch_prototype_generation);
+  g_mutex_unlock(&scratch_prototype_lock);
+  return rc == HS_SUCCESS;
+}
+
+static hs_scratch_t *
+_get_thread_scratch(void)
+{
+  if (log_multi_matcher_scratch &&
+      log_multi_matcher_scratch_generation == g_atomic_int_get(&scratch_prototype_generation))
+    return log_multi_matcher_scratch;
+
+  g_mutex_lock(&scratch_prototype_lock);
+  hs_free_scratch(log_multi_matcher_scratch);
+  log_multi_matcher_scratch = NULL;
+  if (hs_clone_scratch(scratch_prototype, &log_multi_matcher_scratch) != HS_SUCCESS)
+    log_multi_matcher_scratch = NULL;
+  log_multi_matcher_scratch_generation = scratch_prototype_generation;
+  g_mutex_unlock(&scratch_prototype_lock);
+  return log_multi_matcher_scratch;
+}
+
+/* PCRE2 flags that Hyperscan can reproduce exactly, the utf8 flag is not
+ * among them as Hyperscan requires valid UTF-8 input, which PCRE does not
+ * (LogMatcherPcreRe uses PCRE2_NO_UTF_CHECK) */
+static gboolean
+_is_compilable(LogMatcher *matcher, guint *hs_flags)
+{
+  if (!log_matcher_get_pcre_pattern(matcher))
+    return FALSE;
+  if (matcher->flags & (LMF_UTF8 | LMF_NEWLINE))
+    return FALSE;
+
+  *hs_flags = HS_FLAG_SINGLEMATCH;
+  if (matcher->flags & LMF_ICASE)
+    *hs_flags |= HS_FLAG_CASELESS;
+  return TRUE;
+}
+
+static hs_database_t *
+_compile_database(LogMultiMatcher *self)
+{
+  const gchar **expressions = g_new0(const gchar *, self->entries->len);
+  guint *flags = g_new0(guint, self->entries->len);
+  guint *ids = g_new0(guint, self->entries->len);
+  hs_database_t *database = NULL;
+
+  while (!database)
+    {
+      guint count = 0;
+
+      for (guint i = 0; i < self->entries->len; i++)
+        {
+          LogMultiMatcherEntry *entry = &g_array_index(self->entries, LogMultiMatcherEntry, i);
+
+          if (!entry->compiled)
+            continue;
+          expressions[count] = log_matcher_get_pcre_pattern(entry->matcher);
+          flags[count] = entry->hs_flags;
+          ids[count] = i;
+          count++;
+        }
+      if (count == 0)
+        break;
+
+      hs_compile_error_t *compile_error = NULL;
+      if (hs_compile_multi(expressions, flags, ids, count, HS_MODE_BLOCK, NULL,
+                           &database, &compile_error) == HS_SUCCESS)
+        break;
+
+      database = NULL;
+      if (compile_error->expression < 0)
+        {
+          msg_debug("Unable to compile regexps into a multi-pattern database, evaluating them one by one",
+                    evt_tag_str("error", compile_error->message));
+          hs_free_compile_error(compile_error);
+          break;
+        }
+
+      /* leave the pattern to PCRE and try again without it */
+      LogMultiMatcherEntry *entry = &g_array_index(self->entries, LogMultiMatcherEntry,
+                                                   ids[compile_error->expression]);
+      msg_debug("Regexp is not supported by the multi-pattern engine, evaluating it with PCRE",
+                evt_tag_str("regexp", log_matcher_get_pcre_pattern(entry->matcher)),
+                evt_tag_str("error", compile_error->message));
+      entry->compiled = FALSE;
+      hs_free_compile_error(compile_error);
+    }
+
+  g_free(expressions);
+  g_free(flags);
+  g_free(ids);
+  return database;
+}
+
+void
+log_multi_matcher_compile(LogMultiMatcher *self)
+{
+  hs_free_database(self->database);
+  self->database = NULL;
+  self->compiled_count = 0;
+
+  for (guint i = 0; i < self->entries->len; i++)
+    {
+      LogMultiMatcherEntry *entry = &g_array_index(self->entries, LogMultiMatcherEntry, i);
+
+      entry->compiled = _is_compilable(entry->matcher, &entry->hs_flags);
+    }
+
+  self->database = _compile_database(self);
+  if (self->database && !_grow_scratch_prototype(self->database))
+    {
+      hs_free_database(self->database);
+      self->database = NULL;
+    }
+
+  for (guint i = 0; i < self->entries->len; i++)
+    {
+      LogMultiMatcherEntry *entry = &g_array_index(self->entries, LogMultiMatcherEntry, i);
+
+      entry->compiled = self->database && entry->compiled;
+      if (entry->compiled)
+        self->compiled_count++;
+    }
+}
+
+typedef struct _LogMultiMatcherScanState
+{
+  LogMultiMatcher *self;
+  gint first;
+} LogMultiMatcherScanState;
+
+static int
+_on_match(unsigned int index, unsigned long long from, unsigned long long to, unsigned int flags, void *context)
+{
+  LogMultiMatcherScanState *state = (LogMultiMatcherScanState *) context;
+  LogMultiMatcherEntry *entry = &g_array_index(state->self->entries, LogMultiMatcherEntry, index);
+
+  if (state->first < 0 || entry->id < state->first)
+    state->first = entry->id;
+
+  /* nothing can precede the first entry, stop scanning */
+  return state->first == g_array_index(state->self->entries, LogMultiMatcherEntry, 0).id;
+}
+
+static gint
+_scan(LogMultiMatcher *self, const gchar *value, gssize value_len)
+{
+  LogMultiMatcherScanState state = { self, -1 };
+  hs_scratch_t *scratch;
+
+  if (!self->database)
+    return -1;
+
+  scratch = _get_thread_scratch();
+  g_assert(scratch);
+
+  hs_error_t rc = hs_scan(self->database, value, value_len, 0, scratch, _on_match, &state);
+  g_assert(rc == HS_SUCCESS || rc == HS_SCAN_TERMINATED);
+  return state.first;
+}
+
+void
+log_multi_matcher_thread_deinit(void)
+{
+  hs_free_scratch(log_multi_matcher_scratch);
+  log_multi_matcher_scratch = NULL;
+}
+
+void
+log_multi_matcher_global_deinit(void)
+{
+  log_multi_matcher_thread_deinit();
+  hs_free_scratch(scratch_prototype);
+  scratch_prototype = NULL;
+}
+
+#else
+
+void
+log_multi_matcher_compile(LogMultiMatcher *self)
+{
+}
+
+static gint
+_scan(LogMultiMatcher *self, const gchar *value, gssize value_len)
+{
+  return -1;
+}
+
+void
+log_multi_matcher_thread_deinit(void)
+{
+}
+
+void
+log_multi_matcher_global_deinit(void)
+{
+}
+
+#endif
+
+/* entries have to be added in the order of their @id, ids may repeat */
+void
+log_multi_matcher_add(LogMultiMatcher *self, LogMatcher *matcher, gint id)
+{
+  LogMultiMatcherEntry entry = { .matcher = log_matcher_ref(matcher), .id = id };
+
+  g_assert(id >= 0);
+  g_assert(self->entries->len == 0 || g_array_index(self->entries, LogMultiMatcherEntry,
+                                                    self->entries->len - 1).id <= id);
+  g_array_append_val(self->entries, entry);
+}
+
+/*
+ * Returns the smallest id among the matchers that match the value, or -1
+ * if none of them do.  Matchers not in the database are only run if they
+ * could precede the match found by the database.
+ */
+gint
+log_multi_matcher_match_first(LogMultiMatcher *self, LogMessage *msg, NVHandle value_handle,
+                              const gchar *value, gssize value_len)
+{
+  if (value_len < 0)
+    value_len = strlen(value);
+
+  gint first = _scan(self, value, value_len);
+
+  for (guint i = 0; i < self->entries->len; i++)
+    {
+      LogMultiMatcherEntry *entry = &g_array_index(self->entries, LogMultiMatcherEntry, i);
+
+      if (first >= 0 && entry->id >= first)
+        break;
+      if (!entry->compiled && log_matcher_match(entry->matcher, msg, value_handle, value, value_len))
+        return entry->id;
+    }
+  return first;
+}
+
+/* the number of matchers handled by the multi-pattern database */
+guint
+log_multi_matcher_get_compiled_count(LogMultiMatcher *self)
+{
+  return self->compiled_count;
+}
+
+LogMultiMatcher *
+log_multi_matcher_new(void)
+{
+  LogMultiMatcher *self = g_new0(LogMultiMatcher, 1);
+
+  self->entries = g_array_new(FALSE, FALSE, sizeof(LogMultiMatcherEntry));
+  return self;
+}
+
+void
+log_multi_matcher_free(LogMultiMatcher *self)
+{
+  for (guint i = 0; i < self->entries->len; i++)
+    log_matcher_unref(g_array_index(self->entries, LogMultiMatcherEntry, i).matcher);
+  g_array_free(self->entries, TRUE);
+#if SYSLOG_NG_ENABLE_HYPERSCAN
+  hs_free_database(self->database);
+#endif
+  g_free(self);
+}
@@ -0,0 +1,56 @@
+/*
+ * Copyright (c) 2024 One Identity LLC.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#ifndef LOGMATCHER_MULTI_H_INCLUDED
+#define LOGMATCHER_MULTI_H_INCLUDED
+
+#include "logmatcher.h"
+
+/*
+ * Matches a value against an ordered list of LogMatcher instances and
+ * returns the id of the first one that matches, the way an if/elif chain
+ * of message() or match() filters would pick its branch.
+ *
+ * When syslog-ng is built with Hyperscan (or Vectorscan), the PCRE
+ * patterns are compiled into a single database, so the value is scanned
+ * once instead of once per pattern.  Matchers that cannot be compiled this
+ * way (string and glob matchers, the utf8 and newline flags, regexp
+ * constructs Hyperscan does not support) are evaluated one by one with
+ * their own engine, so the result is always the same as evaluating the
+ * chain.
+ */
+typedef struct _LogMultiMatcher LogMultiMatcher;
+
+void log_multi_matcher_add(LogMultiMatcher *self, LogMatcher *matcher, gint id);
+void log_multi_matcher_compile(LogMultiMatcher *self);
+gint log_multi_matcher_match_first(LogMultiMatcher *self, LogMessage *msg, NVHandle value_handle,
+                                   const gchar *value, gssize value_len);
+guint log_multi_matcher_get_compiled_count(LogMultiMatcher *self);
+
+LogMultiMatcher *log_multi_matcher_new(void);
+void log_multi_matcher_free(LogMultiMatcher *self);
+
+void log_multi_matcher_thread_deinit(void);
+void log_multi_matcher_global_deinit(void);
+
+#endif
@@ -29,6 +29,14 @@
 #include "scratch-buffers.h"
 #include "compat/string.h"
 #include "compat/pcre.h"
+#include "template/repr.h"
+#include "template/globals.h"
+#include "stats/stats-registry.h"
+#include "stats/stats-cluster-single.h"
+#include "apphook.h"
+#include "tls-support.h"
+
+#include <stdlib.h>
 
 static void
 log_matcher_store_pattern(LogMatcher *self, const gchar *pattern)
@@ -123,12 +131,12 @@ log_matcher_string_match(LogMatcher *s, LogMessage *msg, gint value_handle, cons
   return log_matcher_string_match_string(self, value, value_len) != NULL;
 }
 
-static gchar *
+static gboolean
 log_matcher_string_replace(LogMatcher *s, LogMessage *msg, gint value_handle, const gchar *value, gssize value_len,
-                           LogTemplate *replacement, gssize *new_length)
+                           LogTemplate *replacement, GString *new_value)
 {
   LogMatcherString *self = (LogMatcherString *) s;
-  GString *new_value = NULL;
+  gboolean replaced = FALSE;
   gsize current_ofs = 0;
   gboolean first_round = TRUE;
 
@@ -159,9 +167,7 @@ log_matcher_string_replace(LogMatcher *s, LogMessage *msg, gint value_handle, co
           if ((s->flags & LMF_STORE_MATCHES))
             log_msg_clear_matches(msg);
 
-          if (!new_value)
-            new_value = g_string_sized_new(value_len);
-
+          replaced = TRUE;
           g_string_append_len(new_value, value + current_ofs, start_ofs - current_ofs);
           log_template_append_format(replacement, msg, &DEFAULT_TEMPLATE_EVAL_OPTIONS, new_value);
           current_ofs = end_ofs;
@@ -174,7 +180,7 @@ log_matcher_string_replace(LogMatcher *s, LogMessage *msg, gint value_handle, co
         }
       else
         {
-          if (new_value)
+          if (replaced)
             {
               /* no more matches, append the end of the string */
               g_string_append_len(new_value, value + current_ofs, value_len - current_ofs);
@@ -184,13 +190,15 @@ log_matcher_string_replace(LogMatcher *s, LogMessage *msg, gint value_handle, co
     }
   while (match && (self->super.flags & LMF_GLOBAL));
 
-  if (new_value)
-    {
-      if (new_length)
-        *new_length = new_value->len;
-      return g_string_free(new_value, FALSE);
-    }
-  return NULL;
+  return replaced;
+}
+
+static const gchar *
+log_matcher_string_get_equality_literal(LogMatcher *s, gboolean *trailing_newline)
+{
+  if (s->flags & (LMF_SUBSTRING | LMF_PREFIX | LMF_ICASE))
+    return NULL;
+  return s->pattern;
 }
 
 LogMatcher *
@@ -202,6 +210,7 @@ log_matcher_string_new(const LogMatcherOptions *options)
   self->super.compile = log_matcher_string_compile;
   self->super.match = log_matcher_string_match;
   self->super.replace = log_matcher_string_replace;
+  self->super.get_equality_literal = log_matcher_string_get_equality_literal;
 
   return &self->super;
 }
@@ -285,8 +294,311 @@ typedef struct _LogMatcherPcreRe
   gint match_options;
   gchar *nv_prefix;
   gint nv_prefix_len;
+  guint32 ovector_count;
+
+  /* a string that is contained by all matching values, see
+   * _compile_literal(), literal_is_pattern is set if the pattern has no
+   * regexp constructs at all */
+  gchar *literal;
+  gsize literal_len;
+  gboolean literal_is_pattern;
+
+  /* the value matched by "^literal$" patterns, see _compile_equality_literal() */
+  gchar *equality_literal;
 } LogMatcherPcreRe;
 
+/* match data of log_matcher_pcre_re_match(), reused by all matchers
+ * running in the same thread */
+TLS_BLOCK_START
+{
+  pcre2_match_data *log_matcher_pcre_match_data;
+}
+TLS_BLOCK_END;
+
+#define log_matcher_pcre_match_data  __tls_deref(log_matcher_pcre_match_data)
+
+static StatsCounterItem *stats_prefilter_rejects;
+
+#define LOG_MATCHER_PCRE_PREFILTER_MIN_LEN 3
+
+static const gchar *
+_skip_char_class(const gchar *p)
+{
+  /* p points right after the opening bracket */
+  if (*p == '^')
+    p++;
+  if (*p == ']')
+    p++;
+  while (*p && *p != ']')
+    {
+      if (*p == '\\')
+        {
+          if (!p[1])
+            return NULL;
+          p += 2;
+        }
+      else if (p[0] == '[' && p[1] == ':')
+        {
+          const gchar *end = strstr(p + 2, ":]");
+          if (!end)
+            return NULL;
+          p = end + 2;
+        }
+      else
+        p++;
+    }
+  return *p ? p + 1 : NULL;
+}
+
+static const gchar *
+_skip_group(const gchar *p)
+{
+  /* p points right after the opening parenthesis */
+  gint depth = 1;
+
+  while (*p)
+    {
+      if (*p == '\\')
+        {
+          if (!p[1])
+            return NULL;
+          p += 2;
+          continue;
+        }
+      if (*p == '[')
+        {
+          p = _skip_char_class(p + 1);
+          if (!p)
+            return NULL;
+          continue;
+        }
+      if (*p == '(')
+        depth++;
+      else if (*p == ')' && --depth == 0)
+        return p + 1;
+      p++;
+    }
+  return NULL;
+}
+
+/* returns the minimum repeat count of the quantifier at *p, or 1 if there's none */
+static gint
+_parse_quantifier(const gchar **p)
+{
+  const gchar *q = *p;
+  gint min = 1;
+
+  if (*q == '?' || *q == '*')
+    {
+      min = 0;
+      q++;
+    }
+  else if (*q == '+')
+    {
+      q++;
+    }
+  else if (*q == '{')
+    {
+      const gchar *digits = ++q;
+
+      while (g_ascii_isdigit(*q))
+        q++;
+      min = (q > digits) ? atoi(digits) : 0;
+      if (*q == ',')
+        {
+          q++;
+          while (g_ascii_isdigit(*q))
+            q++;
+        }
+      else if (q == digits)
+        return 1;
+      if (*q != '}')
+        return 1;
+      q++;
+    }
+  else
+    {
+      return 1;
+    }
+
+  /* lazy or possessive variant */
+  if (*q == '?' || *q == '+')
+    q++;
+  *p = q;
+  return min;
+}
+
+static void
+_finish_literal_run(GString *run, GString *longest)
+{
+  if (run->len > longest->len)
+    g_string_assign_len(longest, run->str, run->len);
+  g_string_truncate(run, 0);
+}
+
+/*
+ * Most regular expressions in filters contain a literal that has to be
+ * present in every match (e.g. "Failed password for .* from"), or are
+ * plain strings altogether (e.g. message("sshd"), escaped special
+ * characters included).  The longest such literal is searched for before
+ * running PCRE, which rejects most of the non-matching values without
+ * running the regexp engine.  If the pattern is nothing but that literal
+ * (@plain), the substring search is the match itself and PCRE is only
+ * invoked when matching substrings have to be stored.
+ *
+ * Only top-level sequences are analyzed: alternations, inline options and
+ * escapes that are not simple character classes disable the prefilter.
+ */
+static gboolean
+_extract_required_literal(const gchar *re, GString *literal, gboolean *plain)
+{
+  GString *run = g_string_new("");
+  gboolean success = FALSE;
+
+  *plain = TRUE;
+  if (strstr(re, "\\Q"))
+    goto exit;
+
+  for (const gchar *p = re; *p; )
+    {
+      gint c = -1;
+
+      if (*p == '\\')
+        {
+          p++;
+          if (g_ascii_ispunct(*p) || *p == ' ')
+            c = *p;
+          else if (!*p || !strchr("dDsSwWbBhHvVRXAzZGK", *p))
+            goto exit;
+          p++;
+        }
+      else if (*p == '[')
+        {
+          p = _skip_char_class(p + 1);
+          if (!p)
+            goto exit;
+        }
+      else if (*p == '(')
+        {
+          /* verbs and inline options could change the meaning of the rest of the pattern */
+          if (p[1] == '*' || (p[1] == '?' && strchr("imnsxJU-^", p[2])))
+            goto exit;
+          p = _skip_group(p + 1);
+          if (!p)
+            goto exit;
+        }
+      else if (*p == '|' || *p == ')' || *p == '{')
+        {
+          goto exit;
+        }
+      else if (strchr(".^$", *p))
+        {
+          p++;
+        }
+      else
+        {
+          c = (guchar) *p;
+          p++;
+        }
+
+      const gchar *atom_end = p;
+      gint min_repeat = _parse_quantifier(&p);
+      gboolean quantified = (p != atom_end);
+
+      /* in UTF mode the quantifier applies to the whole multi-byte
+       * character, whose leading bytes are already in the run */
+      if (quantified && c >= 0x80)
+        {
+          while (run->len > 0 && (guchar) run->str[run->len - 1] >= 0x80)
+            g_string_truncate(run, run->len - 1);
+          c = -1;
+        }
+
+      if (c >= 0 && min_repeat > 0)
+        g_string_append_c(run, c);
+      if (c < 0 || quantified)
+        {
+          _finish_literal_run(run, literal);
+          *plain = FALSE;
+        }
+    }
+  _finish_literal_run(run, literal);
+  success = literal->len > 0;
+
+exit:
+  g_string_free(run, TRUE);
+  return success;
+}
+
+static void
+_compile_literal(LogMatcherPcreRe *self, const gchar *re)
+{
+  g_free(self->literal);
+  self->literal = NULL;
+  self->literal_len = 0;
+  self->literal_is_pattern = FALSE;
+
+  /* PCRE uses Unicode case folding in UTF mode (e.g. KELVIN SIGN matches "k") */
+  if ((self->super.flags & LMF_ICASE) && (self->super.flags & LMF_UTF8))
+    return;
+
+  GString *literal = g_string_new("");
+  gboolean plain;
+
+  if (!_extract_required_literal(re, literal, &plain) ||
+      (!plain && literal->len < LOG_MATCHER_PCRE_PREFILTER_MIN_LEN))
+    {
+      g_string_free(literal, TRUE);
+      return;
+    }
+  self->literal_is_pattern = plain;
+  self->literal_len = literal->len;
+  self->literal = g_string_free(literal, FALSE);
+}
+
+static gboolean
+_contains_literal(LogMatcherPcreRe *self, const gchar *value, gsize value_len)
+{
+  const gchar *literal = self->literal;
+  gsize literal_len = self->literal_len;
+
+  if (literal_len > value_len)
+    return FALSE;
+
+  const gchar *last = value + value_len - literal_len;
+
+  if (!(self->super.flags & LMF_ICASE))
+    {
+      for (const gchar *p = value; p <= last && (p = memchr(p, literal[0], last - p + 1)); p++)
+        {
+          if (memcmp(p, literal, literal_len) == 0)
+            return TRUE;
+        }
+      return FALSE;
+    }
+
+  for (const gchar *p = value; p <= last; p++)
+    {
+      gsize i;
+
+      for (i = 0; i < literal_len && g_ascii_tolower(p[i]) == g_ascii_tolower(literal[i]); i++)
+        ;
+      if (i == literal_len)
+        return TRUE;
+    }
+  return FALSE;
+}
+
+static gboolean
+_prefilter_literal(LogMatcherPcreRe *self, const gchar *value, gsize value_len)
+{
+  if (!self->literal || _contains_literal(self, value, value_len))
+    return TRUE;
+
+  stats_counter_inc(stats_prefilter_rejects);
+  return FALSE;
+}
+
 static gboolean
 _compile_pcre2_regexp(LogMatcherPcreRe *self, const gchar *re, GError **error)
 {
@@ -361,6 +673,39 @@ _jit_pcre2_regexp(LogMatcherPcreRe *self, const gchar *re, GError **error)
   return TRUE;
 }
 
+/*
+ * A pattern like "^literal$" matches that single string (or the same
+ * followed by a newline, unless a different newline convention is in
+ * effect), which lets callers replace a series of such matchers with a
+ * lookup, see log_matcher_get_equality_literal().
+ */
+static void
+_compile_equality_literal(LogMatcherPcreRe *self, const gchar *re)
+{
+  gsize re_len = strlen(re);
+  guint32 newline;
+
+  g_free(self->equality_literal);
+  self->equality_literal = NULL;
+
+  if (self->super.flags & (LMF_ICASE | LMF_NEWLINE))
+    return;
+  if (re_len < 3 || re[0] != '^' || re[re_len - 1] != '$')
+    return;
+  if (pcre2_pattern_info(self->pattern, PCRE2_INFO_NEWLINE, &newline) != 0 || newline != PCRE2_NEWLINE_LF)
+    return;
+
+  gchar *inner = g_strndup(re + 1, re_len - 2);
+  GString *literal = g_string_new("");
+  gboolean plain;
+
+  if (_extract_required_literal(inner, literal, &plain) && plain)
+    self->equality_literal = g_string_free(literal, FALSE);
+  else
+    g_string_free(literal, TRUE);
+  g_free(inner);
+}
+
 static gboolean
 log_matcher_pcre_re_compile(LogMatcher *s, const gchar *re, GError **error)
 {
@@ -375,6 +720,12 @@ log_matcher_pcre_re_compile(LogMatcher *s, const gchar *re, GError **error)
   if (!_jit_pcre2_regexp(self, re, error))
     return FALSE;
 
+  guint32 capture_count = 0;
+  pcre2_pattern_info(self->pattern, PCRE2_INFO_CAPTURECOUNT, &capture_count);
+  self->ovector_count = capture_count + 1;
+
+  _compile_literal(self, re);
+  _compile_equality_literal(self, re);
   return TRUE;
 }
 
@@ -428,7 +779,7 @@ static void
 log_matcher_pcre_re_feed_backrefs(LogMatcherPcreRe *self, LogMessage *msg, LogMatcherPcreMatchResult *result)
 {
   gint i;
-  guint32 num_matches = pcre2_get_ovector_count(result->match_data);
+  guint32 num_matches = self->ovector_count;
   PCRE2_SIZE *matches = pcre2_get_ovector_pointer(result->match_data);
 
   for (i = 0; i < (LOGMSG_MAX_MATCHES) && i < num_matches; i++)
@@ -494,6 +845,21 @@ log_matcher_pcre_re_feed_named_substrings(LogMatcherPcreRe *self, LogMessage *ms
     }
 }
 
+/* NOTE: the match data is only valid until the next match in the same thread */
+static pcre2_match_data *
+_get_thread_match_data(LogMatcherPcreRe *self)
+{
+  pcre2_match_data *match_data = log_matcher_pcre_match_data;
+
+  if (match_data && pcre2_get_ovector_count(match_data) >= self->ovector_count)
+    return match_data;
+
+  pcre2_match_data_free(match_data);
+  match_data = pcre2_match_data_create(MAX(self->ovector_count, 16), NULL);
+  log_matcher_pcre_match_data = match_data;
+  return match_data;
+}
+
 static gboolean
 log_matcher_pcre_re_match(LogMatcher *s, LogMessage *msg, gint value_handle, const gchar *value, gssize value_len)
 {
@@ -505,7 +871,12 @@ log_matcher_pcre_re_match(LogMatcher *s, LogMessage *msg, gint value_handle, con
   if (value_len == -1)
     value_len = strlen(value);
 
-  result.match_data = pcre2_match_data_create_from_pattern(self->pattern, NULL);
+  if (!_prefilter_literal(self, value, value_len))
+    return FALSE;
+  if (self->literal_is_pattern && !(s->flags & LMF_STORE_MATCHES))
+    return TRUE;
+
+  result.match_data = _get_thread_match_data(self);
   result.source_value = value;
   result.source_value_len = value_len;
   result.source_handle = value_handle;
@@ -544,22 +915,96 @@ log_matcher_pcre_re_match(LogMatcher *s, LogMessage *msg, gint value_handle, con
           log_matcher_pcre_re_feed_named_substrings(self, msg, &result);
         }
     }
-  pcre2_match_data_free(result.match_data);
   return res;
 }
 
-static gchar *
+/*
+ * Replacements that consist of literal text and references to capture
+ * groups only (e.g. "$1-$2") are expanded right from the offsets of the
+ * match, instead of evaluating the template, which would look up the
+ * values stored by log_matcher_pcre_re_feed_backrefs() one by one.
+ */
+static gboolean
+_is_replacement_expandable_from_matches(LogTemplate *replacement)
+{
+  LogTemplateProgram *program = replacement->program;
+  LogTemplateOptions *template_options = replacement->cfg ? &replacement->cfg->template_options
+                                         : log_template_get_global_template_options();
+
+  if (!program || replacement->escape || (replacement->top_level && template_options->escape))
+    return FALSE;
+
+  for (gint i = 0; i < program->num_ops; i++)
+    {
+      const LogTemplateOp *op = &program->ops[i];
+
+      if (op->type == LTO_LITERAL)
+        continue;
+      if (op->type != LTO_VALUE || op->msg_ref != 0 || op->value.default_value ||
+          !log_msg_is_handle_match(op->value.handle))
+        return FALSE;
+    }
+  return TRUE;
+}
+
+/* returns FALSE if the template has to be evaluated instead, as a group did not participate in the match */
+static gboolean
+_append_replacement_from_matches(LogMatcherPcreRe *self, LogTemplate *replacement,
+                                 LogMatcherPcreMatchResult *result, GString *new_value)
+{
+  LogTemplateProgram *program = replacement->program;
+  PCRE2_SIZE *matches = pcre2_get_ovector_pointer(result->match_data);
+  gsize start_len = new_value->len;
+
+  for (gint i = 0; i < program->num_ops; i++)
+    {
+      const LogTemplateOp *op = &program->ops[i];
+
+      if (op->type == LTO_LITERAL)
+        {
+          g_string_append_len(new_value, op->literal.text, op->literal.text_len);
+          continue;
+        }
+
+      guint32 group = log_msg_get_match_index(op->value.handle);
+
+      /* matches above the number of groups were truncated, these expand to an empty string */
+      if (group >= self->ovector_count)
+        continue;
+
+      if (matches[2 * group] == PCRE2_UNSET)
+        {
+          g_string_truncate(new_value, start_len);
+          return FALSE;
+        }
+      g_string_append_len(new_value, &result->source_value[matches[2 * group]],
+                          matches[2 * group + 1] - matches[2 * group]);
+    }
+  return TRUE;
+}
+
+static gboolean
 log_matcher_pcre_re_replace(LogMatcher *s, LogMessage *msg, gint value_handle, const gchar *value, gssize value_len,
-                            LogTemplate *replacement, gssize *new_length)
+                            LogTemplate *replacement, GString *new_value)
 {
   LogMatcherPcreRe *self = (LogMatcherPcreRe *) s;
   LogMatcherPcreMatchResult result;
-  GString *new_value = NULL;
+  gboolean replaced = FALSE;
   gint rc;
   gint start_offset, last_offset;
   gint options;
   gboolean last_match_was_empty;
 
+  if (value_len == -1)
+    value_len = strlen(value);
+
+  if (!_prefilter_literal(self, value, value_len))
+    return FALSE;
+
+  gboolean expand_from_matches = _is_replacement_expandable_from_matches(replacement);
+
+  /* the replacement template may run other matchers, so the per-thread
+   * match data cannot be used here */
   result.match_data = pcre2_match_data_create_from_pattern(self->pattern, NULL);
   PCRE2_SIZE *matches = pcre2_get_ovector_pointer(result.match_data);
 
@@ -569,9 +1014,6 @@ log_matcher_pcre_re_replace(LogMatcher *s, LogMessage *msg, gint value_handle, c
 
   matches[0] = matches[1] = 0;
 
-  if (value_len == -1)
-    value_len = strlen(value);
-
   result.source_value = value;
   result.source_value_len = value_len;
   result.source_handle = value_handle;
@@ -656,12 +1098,12 @@ log_matcher_pcre_re_replace(LogMatcher *s, LogMessage *msg, gint value_handle, c
           log_matcher_pcre_re_feed_backrefs(self, msg, &result);
           log_matcher_pcre_re_feed_named_substrings(self, msg, &result);
 
-          if (!new_value)
-            new_value = g_string_sized_new(result.source_value_len);
+          replaced = TRUE;
           /* append non-matching portion */
           g_string_append_len(new_value, &result.source_value[last_offset], matches[0] - last_offset);
           /* replacement */
-          log_template_append_format(replacement, msg, &DEFAULT_TEMPLATE_EVAL_OPTIONS, new_value);
+          if (!expand_from_matches || !_append_replacement_from_matches(self, replacement, &result, new_value))
+            log_template_append_format(replacement, msg, &DEFAULT_TEMPLATE_EVAL_OPTIONS, new_value);
 
           last_match_was_empty = (matches[0] == matches[1]);
           start_offset = last_offset = matches[1];
@@ -671,15 +1113,21 @@ log_matcher_pcre_re_replace(LogMatcher *s, LogMessage *msg, gint value_handle, c
 
   pcre2_match_data_free(result.match_data);
 
-  if (new_value)
+  if (replaced)
     {
       /* append the last literal */
       g_string_append_len(new_value, &result.source_value[last_offset], result.source_value_len - last_offset);
-      if (new_length)
-        *new_length = new_value->len;
-      return g_string_free(new_value, FALSE);
     }
-  return NULL;
+  return replaced;
+}
+
+static const gchar *
+log_matcher_pcre_re_get_equality_literal(LogMatcher *s, gboolean *trailing_newline)
+{
+  LogMatcherPcreRe *self = (LogMatcherPcreRe *) s;
+
+  *trailing_newline = TRUE;
+  return self->equality_literal;
 }
 
 static void
@@ -687,9 +1135,24 @@ log_matcher_pcre_re_free(LogMatcher *s)
 {
   LogMatcherPcreRe *self = (LogMatcherPcreRe *) s;
   pcre2_code_free(self->pattern);
+  g_free(self->literal);
+  g_free(self->equality_literal);
   log_matcher_free_method(s);
 }
 
+/*
+ * Returns the regexp of @s if it is a PCRE matcher, so that it can be
+ * compiled by a different engine, see LogMultiMatcher.  The flags of the
+ * pattern are in s->flags.
+ */
+const gchar *
+log_matcher_get_pcre_pattern(LogMatcher *s)
+{
+  if (s->match != log_matcher_pcre_re_match)
+    return NULL;
+  return s->pattern;
+}
+
 LogMatcher *
 log_matcher_pcre_re_new(const LogMatcherOptions *options)
 {
@@ -701,11 +1164,29 @@ log_matcher_pcre_re_new(const LogMatcherOptions *options)
   self->super.compile = log_matcher_pcre_re_compile;
   self->super.match = log_matcher_pcre_re_match;
   self->super.replace = log_matcher_pcre_re_replace;
+  self->super.get_equality_literal = log_matcher_pcre_re_get_equality_literal;
   self->super.free_fn = log_matcher_pcre_re_free;
 
   return &self->super;
 }
 
+gchar *
+log_matcher_replace(LogMatcher *s, LogMessage *msg, gint value_handle, const gchar *value, gssize value_len,
+                    LogTemplate *replacement, gssize *new_length)
+{
+  GString *new_value = g_string_new("");
+
+  if (!log_matcher_replace_append(s, msg, value_handle, value, value_len, replacement, new_value))
+    {
+      g_string_free(new_value, TRUE);
+      return NULL;
+    }
+
+  if (new_length)
+    *new_length = new_value->len;
+  return g_string_free(new_value, FALSE);
+}
+
 void
 log_matcher_pcre_set_nv_prefix(LogMatcher *s, const gchar *prefix)
 {
@@ -729,6 +1210,8 @@ typedef LogMatcher *(*LogMatcherConstructFunc)(const LogMatcherOptions *options)
 gboolean
 log_matcher_match_value(LogMatcher *s, LogMessage *msg, gint value_handle)
 {
+  /* parse lazy SDATA first, as that would replace the payload we reference */
+  log_msg_ensure_sdata_parsed(msg);
   NVTable *payload = nv_table_ref(msg->payload);
   gssize value_len;
   const gchar *value = log_msg_get_value(msg, value_handle, &value_len);
@@ -909,3 +1392,47 @@ log_matcher_error_quark(void)
 {
   return g_quark_from_static_string("log-matcher-error-quark");
 }
+
+static void
+_register_stats(void)
+{
+  StatsClusterKey sc_key;
+
+  stats_lock();
+  stats_cluster_single_key_set(&sc_key, "regexp_prefilter_rejects_total", NULL, 0);
+  stats_cluster_single_key_add_legacy_alias_with_name(&sc_key, SCS_GLOBAL, "regexp_prefilter", NULL, "rejects");
+  stats_register_counter(0, &sc_key, SC_TYPE_SINGLE_VALUE, &stats_prefilter_rejects);
+  stats_unlock();
+}
+
+static void
+_unregister_stats(void)
+{
+  StatsClusterKey sc_key;
+
+  stats_lock();
+  stats_cluster_single_key_set(&sc_key, "regexp_prefilter_rejects_total", NULL, 0);
+  stats_cluster_single_key_add_legacy_alias_with_name(&sc_key, SCS_GLOBAL, "regexp_prefilter", NULL, "rejects");
+  stats_unregister_counter(&sc_key, SC_TYPE_SINGLE_VALUE, &stats_prefilter_rejects);
+  stats_unlock();
+}
+
+void
+log_matcher_thread_deinit(void)
+{
+  pcre2_match_data_free(log_matcher_pcre_match_data);
+  log_matcher_pcre_match_data = NULL;
+}
+
+void
+log_matcher_global_init(void)
+{
+  register_application_hook(AH_RUNNING, (ApplicationHookFunc) _register_stats, NULL, AHM_RUN_ONCE);
+}
+
+void
+log_matcher_global_deinit(void)
+{
+  log_matcher_thread_deinit();
+  _unregister_stats();
+}
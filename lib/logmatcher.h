@@ -69,9 +69,12 @@ struct _LogMatcher
   gboolean (*compile)(LogMatcher *s, const gchar *re, GError **error);
   /* value_len can be -1 to indicate unknown length */
   gboolean (*match)(LogMatcher *s, LogMessage *msg, gint value_handle, const gchar *value, gssize value_len);
-  /* value_len can be -1 to indicate unknown length, new_length can be returned as -1 to indicate unknown length */
-  gchar *(*replace)(LogMatcher *s, LogMessage *msg, gint value_handle, const gchar *value, gssize value_len,
-                    LogTemplate *replacement, gssize *new_length);
+  /* value_len can be -1 to indicate unknown length, the new value is appended to new_value, returns FALSE if
+   * there was nothing to replace */
+  gboolean (*replace)(LogMatcher *s, LogMessage *msg, gint value_handle, const gchar *value, gssize value_len,
+                      LogTemplate *replacement, GString *new_value);
+  /* optional, see log_matcher_get_equality_literal() */
+  const gchar *(*get_equality_literal)(LogMatcher *s, gboolean *trailing_newline);
   void (*free_fn)(LogMatcher *s);
 };
 
@@ -92,12 +95,30 @@ gboolean log_matcher_match_buffer(LogMatcher *s, LogMessage *msg, const gchar *v
 gboolean log_matcher_match_template(LogMatcher *s, LogMessage *msg,
                                     LogTemplate *template, LogTemplateEvalOptions *options);
 
-static inline gchar *
-log_matcher_replace(LogMatcher *s, LogMessage *msg, gint value_handle, const gchar *value, gssize value_len,
-                    LogTemplate *replacement, gssize *new_length)
+static inline gboolean
+log_matcher_replace_append(LogMatcher *s, LogMessage *msg, gint value_handle, const gchar *value, gssize value_len,
+                           LogTemplate *replacement, GString *new_value)
 {
   if (s->replace)
-    return s->replace(s, msg, value_handle, value, value_len, replacement, new_length);
+    return s->replace(s, msg, value_handle, value, value_len, replacement, new_value);
+  return FALSE;
+}
+
+gchar *log_matcher_replace(LogMatcher *s, LogMessage *msg, gint value_handle, const gchar *value, gssize value_len,
+                           LogTemplate *replacement, gssize *new_length);
+
+/*
+ * Returns the string that a value has to be equal to in order to match, or
+ * NULL if the matcher accepts anything else.  As "$" matches before a
+ * trailing newline in PCRE, @trailing_newline is set if the same string
+ * followed by a newline matches too.
+ */
+static inline const gchar *
+log_matcher_get_equality_literal(LogMatcher *s, gboolean *trailing_newline)
+{
+  *trailing_newline = FALSE;
+  if (s->get_equality_literal)
+    return s->get_equality_literal(s, trailing_newline);
   return NULL;
 }
 
@@ -113,6 +134,8 @@ log_matcher_is_replace_supported(LogMatcher *s)
   return s->replace != NULL;
 }
 
+const gchar *log_matcher_get_pcre_pattern(LogMatcher *s);
+
 LogMatcher *log_matcher_pcre_re_new(const LogMatcherOptions *options);
 LogMatcher *log_matcher_string_new(const LogMatcherOptions *options);
 LogMatcher *log_matcher_glob_new(const LogMatcherOptions *options);
@@ -130,4 +153,8 @@ void log_matcher_options_destroy(LogMatcherOptions *options);
 
 void log_matcher_pcre_set_nv_prefix(LogMatcher *s, const gchar *prefix);
 
+void log_matcher_thread_deinit(void);
+void log_matcher_global_init(void);
+void log_matcher_global_deinit(void);
+
 #endif
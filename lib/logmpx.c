@@ -106,8 +106,7 @@ log_multiplexer_queue(LogPipe *s, LogMessage *msg, const LogPathOptions *path_op
             }
 
           matched = TRUE;
-          log_msg_add_ack(msg, &local_options);
-          log_pipe_queue(next_hop, log_msg_ref(msg), &local_options);
+          log_pipe_queue(next_hop, log_msg_add_ack_and_ref(msg, &local_options), &local_options);
 
           if (matched)
             {
@@ -0,0 +1,141 @@
+/*
+ * Copyright (c) 2024 One Identity LLC.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#include "logmsg/logmsg-cache.h"
+
+/*
+ * Per-message cache of formatted values
+ *
+ * This is the side table of a LogMessage behind template-cache(yes) (see
+ * template/eval-cache.c) and flags(format-cache) (see
+ * logwriter-format-cache.c): values computed from the message are stored
+ * here, so that multiple destinations formatting the same message share
+ * a single rendering.
+ *
+ * Values are only cached for write protected messages: these can't be
+ * changed anymore (log_msg_make_writable() clones them, and the clone
+ * starts with an empty cache), so the cache never needs to be invalidated.
+ * On the other hand, these messages are shared between threads, so the
+ * table is allocated with a compare-and-exchange and is append-only: a
+ * slot is reserved atomically, filled in, then published by setting its
+ * "ready" flag.  Once all slots are taken, new values are not cached.
+ */
+
+typedef struct _LogMessageCacheEntry
+{
+  gint ready;
+  gpointer key;
+  LogMessageValueType type;
+  gchar *value;
+  gsize value_len;
+} LogMessageCacheEntry;
+
+struct _LogMessageCache
+{
+  const LogMessageCacheKeyClass *key_class;
+  gint reserved;
+  LogMessageCacheEntry entries[LOG_MSG_CACHE_SIZE];
+};
+
+gboolean
+log_msg_cache_lookup(LogMessageCache **cache, gconstpointer key, GString *result, LogMessageValueType *type)
+{
+  LogMessageCache *self = g_atomic_pointer_get(cache);
+
+  if (!self)
+    return FALSE;
+
+  gint num_entries = MIN(g_atomic_int_get(&self->reserved), LOG_MSG_CACHE_SIZE);
+  for (gint i = 0; i < num_entries; i++)
+    {
+      LogMessageCacheEntry *entry = &self->entries[i];
+
+      if (!g_atomic_int_get(&entry->ready) || !self->key_class->equal(entry->key, key))
+        continue;
+
+      g_string_append_len(result, entry->value, entry->value_len);
+      if (type)
+        *type = entry->type;
+      return TRUE;
+    }
+  return FALSE;
+}
+
+static LogMessageCache *
+_get_or_create_cache(LogMessageCache **cache, const LogMessageCacheKeyClass *key_class)
+{
+  LogMessageCache *self = g_atomic_pointer_get(cache);
+
+  if (self)
+    return self;
+
+  self = g_new0(LogMessageCache, 1);
+  self->key_class = key_class;
+  if (!g_atomic_pointer_compare_and_exchange(cache, NULL, self))
+    {
+      /* another thread was faster */
+      g_free(self);
+      self = g_atomic_pointer_get(cache);
+    }
+  return self;
+}
+
+void
+log_msg_cache_store(LogMessageCache **cache, const LogMessageCacheKeyClass *key_class, gconstpointer key,
+                    const gchar *value, gsize value_len, LogMessageValueType type)
+{
+  LogMessageCache *self = _get_or_create_cache(cache, key_class);
+
+  g_assert(self->key_class == key_class);
+  if (g_atomic_int_get(&self->reserved) >= LOG_MSG_CACHE_SIZE)
+    return;
+
+  gint slot = g_atomic_int_add(&self->reserved, 1);
+  if (slot >= LOG_MSG_CACHE_SIZE)
+    return;
+
+  LogMessageCacheEntry *entry = &self->entries[slot];
+
+  entry->key = key_class->dup(key);
+  entry->type = type;
+  entry->value = g_strndup(value, value_len);
+  entry->value_len = value_len;
+  g_atomic_int_set(&entry->ready, TRUE);
+}
+
+void
+log_msg_cache_free(LogMessageCache *self)
+{
+  if (!self)
+    return;
+
+  gint num_entries = MIN(self->reserved, LOG_MSG_CACHE_SIZE);
+  for (gint i = 0; i < num_entries; i++)
+    {
+      LogMessageCacheEntry *entry = &self->entries[i];
+
+      self->key_class->free(entry->key);
+      g_free(entry->value);
+    }
+  g_free(self);
+}
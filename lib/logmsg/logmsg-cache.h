@@ -0,0 +1,47 @@
+/*
+ * Copyright (c) 2024 One Identity LLC.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#ifndef LOGMSG_CACHE_H_INCLUDED
+#define LOGMSG_CACHE_H_INCLUDED
+
+#include "syslog-ng.h"
+#include "logmsg/logmsg.h"
+
+/* number of values a single per-message cache can hold */
+#define LOG_MSG_CACHE_SIZE 4
+
+/* the key of the cached values is opaque, its owner describes how it can be
+ * compared, copied into the cache and freed along with it */
+typedef struct _LogMessageCacheKeyClass
+{
+  gboolean (*equal)(gconstpointer a, gconstpointer b);
+  gpointer (*dup)(gconstpointer key);
+  GDestroyNotify free;
+} LogMessageCacheKeyClass;
+
+gboolean log_msg_cache_lookup(LogMessageCache **cache, gconstpointer key, GString *result, LogMessageValueType *type);
+void log_msg_cache_store(LogMessageCache **cache, const LogMessageCacheKeyClass *key_class, gconstpointer key,
+                         const gchar *value, gsize value_len, LogMessageValueType type);
+void log_msg_cache_free(LogMessageCache *self);
+
+#endif
@@ -0,0 +1,319 @@
+/*
+ * Copyright (c) 2024 One Identity LLC.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+#include "logmsg/logmsg-pool.h"
+#include "tls-support.h"
+#include "stats/stats-registry.h"
+#include "stats/stats-cluster-single.h"
+#include "timeutils/cache.h"
+#include "apphook.h"
+
+#include <string.h>
+
+/*
+ * log_msg_pool
+ *
+ * A per-thread cache of the memory blocks used by LogMessage instances
+ * (including their trailing LogMessageQueueNode array) and NVTable
+ * payloads.  Allocating and freeing these go through the global malloc
+ * for every single message, which on many-core boxes causes arena
+ * contention.
+ *
+ * Design principles:
+ *   - blocks are ordinary g_malloc() allocations, the pool only defers
+ *     their g_free(), so a block allocated from the pool can be
+ *     g_realloc()-ed or g_free()-d directly.
+ *
+ *   - blocks are keyed by their exact size, size classes are learnt on
+ *     the fly: an empty size class is reassigned to the next block size
+ *     that does not match any of the existing ones.  In practice there are
+ *     just a handful of sizes in use (LogMessage with an embedded payload,
+ *     LogMessage clones and the doubling payload sizes of NVTable).
+ *
+ *   - the pool is thread local and is owned by the thread space of the
+ *     worker threads, it gets initialized/freed by app_thread_start() and
+ *     app_thread_stop().  Blocks are returned to the pool of the thread
+ *     that frees them, which is not necessarily the one that allocated
+ *     them, so the number of cached bytes is capped per-thread.
+ *
+ *   - threads without a pool (e.g. threads not started by syslog-ng)
+ *     simply use g_malloc()/g_free().
+ *
+ *   - statistics are accumulated locally and are published lazily to
+ *     avoid atomic operations on the fast path.
+ */
+
+typedef struct _LogMsgPoolBlock LogMsgPoolBlock;
+struct _LogMsgPoolBlock
+{
+  LogMsgPoolBlock *next;
+};
+
+typedef struct _LogMsgPoolSizeClass
+{
+  gsize size;
+  gint count;
+  LogMsgPoolBlock *free_list;
+} LogMsgPoolSizeClass;
+
+TLS_BLOCK_START
+{
+  gboolean log_msg_pool_initialized;
+  LogMsgPoolSizeClass log_msg_pool_classes[LOG_MSG_POOL_SIZE_CLASSES];
+  gsize log_msg_pool_cached_bytes;
+  gint log_msg_pool_cached_blocks;
+
+  /* not yet published changes to the stats counters */
+  gssize log_msg_pool_hits_pending;
+  gssize log_msg_pool_misses_pending;
+  gssize log_msg_pool_cached_bytes_reported;
+  time_t log_msg_pool_time_of_last_update;
+}
+TLS_BLOCK_END;
+
+#define log_msg_pool_initialized            __tls_deref(log_msg_pool_initialized)
+#define log_msg_pool_classes                __tls_deref(log_msg_pool_classes)
+#define log_msg_pool_cached_bytes           __tls_deref(log_msg_pool_cached_bytes)
+#define log_msg_pool_cached_blocks          __tls_deref(log_msg_pool_cached_blocks)
+#define log_msg_pool_hits_pending           __tls_deref(log_msg_pool_hits_pending)
+#define log_msg_pool_misses_pending         __tls_deref(log_msg_pool_misses_pending)
+#define log_msg_pool_cached_bytes_reported  __tls_deref(log_msg_pool_cached_bytes_reported)
+#define log_msg_pool_time_of_last_update    __tls_deref(log_msg_pool_time_of_last_update)
+
+/* publish stats once every period, in seconds */
+#define LOG_MSG_POOL_STATS_UPDATE_PERIOD 5
+
+static StatsCounterItem *stats_msg_pool_hits;
+static StatsCounterItem *stats_msg_pool_misses;
+static StatsCounterItem *stats_msg_pool_cached_bytes;
+
+static inline LogMsgPoolSizeClass *
+_lookup_size_class(gsize size)
+{
+  for (gint i = 0; i < LOG_MSG_POOL_SIZE_CLASSES; i++)
+    {
+      if (log_msg_pool_classes[i].size == size)
+        return &log_msg_pool_classes[i];
+    }
+  return NULL;
+}
+
+static inline LogMsgPoolSizeClass *
+_lookup_or_assign_size_class(gsize size)
+{
+  LogMsgPoolSizeClass *unused = NULL;
+
+  for (gint i = 0; i < LOG_MSG_POOL_SIZE_CLASSES; i++)
+    {
+      LogMsgPoolSizeClass *size_class = &log_msg_pool_classes[i];
+
+      if (size_class->size == size)
+        return size_class;
+      if (!unused && size_class->count == 0)
+        unused = size_class;
+    }
+
+  if (unused)
+    unused->size = size;
+  return unused;
+}
+
+gpointer
+log_msg_pool_alloc(gsize size)
+{
+  if (G_UNLIKELY(!log_msg_pool_initialized))
+    return g_malloc(size);
+
+  LogMsgPoolSizeClass *size_class = _lookup_size_class(size);
+  if (size_class && size_class->free_list)
+    {
+      LogMsgPoolBlock *block = size_class->free_list;
+
+      size_class->free_list = block->next;
+      size_class->count--;
+      log_msg_pool_cached_blocks--;
+      log_msg_pool_cached_bytes -= size;
+      log_msg_pool_hits_pending++;
+      return block;
+    }
+
+  log_msg_pool_misses_pending++;
+  return g_malloc(size);
+}
+
+static gboolean
+_cache_block(gpointer block, gsize size)
+{
+  if (size < sizeof(LogMsgPoolBlock) || size > LOG_MSG_POOL_MAX_BLOCK_SIZE)
+    return FALSE;
+
+  if (log_msg_pool_cached_bytes + size > LOG_MSG_POOL_MAX_CACHED_BYTES)
+    return FALSE;
+
+  LogMsgPoolSizeClass *size_class = _lookup_or_assign_size_class(size);
+  if (!size_class || size_class->count >= LOG_MSG_POOL_MAX_BLOCKS)
+    return FALSE;
+
+  LogMsgPoolBlock *pool_block = (LogMsgPoolBlock *) block;
+  pool_block->next = size_class->free_list;
+  size_class->free_list = pool_block;
+  size_class->count++;
+  log_msg_pool_cached_blocks++;
+  log_msg_pool_cached_bytes += size;
+  return TRUE;
+}
+
+void
+log_msg_pool_free(gpointer block, gsize size)
+{
+  if (G_LIKELY(log_msg_pool_initialized) && _cache_block(block, size))
+    return;
+
+  g_free(block);
+}
+
+gssize
+log_msg_pool_get_local_cached_bytes(void)
+{
+  return log_msg_pool_cached_bytes;
+}
+
+gint
+log_msg_pool_get_local_cached_blocks(void)
+{
+  return log_msg_pool_cached_blocks;
+}
+
+void
+log_msg_pool_update_stats(void)
+{
+  stats_counter_add(stats_msg_pool_hits, log_msg_pool_hits_pending);
+  stats_counter_add(stats_msg_pool_misses, log_msg_pool_misses_pending);
+  log_msg_pool_hits_pending = 0;
+  log_msg_pool_misses_pending = 0;
+
+  gssize prev_reported = log_msg_pool_cached_bytes_reported;
+  log_msg_pool_cached_bytes_reported = log_msg_pool_cached_bytes;
+  stats_counter_add(stats_msg_pool_cached_bytes, log_msg_pool_cached_bytes_reported - prev_reported);
+}
+
+void
+log_msg_pool_lazy_update_stats(void)
+{
+  if (!log_msg_pool_initialized)
+    return;
+
+  time_t now = cached_g_current_time_sec();
+  if (now - log_msg_pool_time_of_last_update >= LOG_MSG_POOL_STATS_UPDATE_PERIOD)
+    {
+      log_msg_pool_update_stats();
+      log_msg_pool_time_of_last_update = now;
+    }
+}
+
+static void
+_free_size_class(LogMsgPoolSizeClass *size_class)
+{
+  while (size_class->free_list)
+    {
+      LogMsgPoolBlock *block = size_class->free_list;
+
+      size_class->free_list = block->next;
+      g_free(block);
+    }
+  size_class->count = 0;
+  size_class->size = 0;
+}
+
+void
+log_msg_pool_thread_init(void)
+{
+  for (gint i = 0; i < LOG_MSG_POOL_SIZE_CLASSES; i++)
+    memset(&log_msg_pool_classes[i], 0, sizeof(LogMsgPoolSizeClass));
+  log_msg_pool_cached_bytes = 0;
+  log_msg_pool_cached_blocks = 0;
+  log_msg_pool_hits_pending = 0;
+  log_msg_pool_misses_pending = 0;
+  log_msg_pool_cached_bytes_reported = 0;
+  log_msg_pool_time_of_last_update = 0;
+  log_msg_pool_initialized = TRUE;
+}
+
+void
+log_msg_pool_thread_deinit(void)
+{
+  if (!log_msg_pool_initialized)
+    return;
+
+  for (gint i = 0; i < LOG_MSG_POOL_SIZE_CLASSES; i++)
+    _free_size_class(&log_msg_pool_classes[i]);
+  log_msg_pool_cached_bytes = 0;
+  log_msg_pool_cached_blocks = 0;
+
+  /* publish our last changes and remove our cached bytes from the stats */
+  log_msg_pool_update_stats();
+  log_msg_pool_initialized = FALSE;
+}
+
+void
+log_msg_pool_register_stats(void)
+{
+  StatsClusterKey sc_key;
+
+  stats_lock();
+  stats_cluster_single_key_set(&sc_key, "msg_pool_hits_total", NULL, 0);
+  stats_register_counter(1, &sc_key, SC_TYPE_SINGLE_VALUE, &stats_msg_pool_hits);
+  stats_cluster_single_key_set(&sc_key, "msg_pool_misses_total", NULL, 0);
+  stats_register_counter(1, &sc_key, SC_TYPE_SINGLE_VALUE, &stats_msg_pool_misses);
+  stats_cluster_single_key_set(&sc_key, "msg_pool_cached_bytes", NULL, 0);
+  stats_cluster_single_key_add_unit(&sc_key, SCU_BYTES);
+  stats_register_counter(1, &sc_key, SC_TYPE_SINGLE_VALUE, &stats_msg_pool_cached_bytes);
+  stats_unlock();
+}
+
+void
+log_msg_pool_unregister_stats(void)
+{
+  StatsClusterKey sc_key;
+
+  stats_lock();
+  stats_cluster_single_key_set(&sc_key, "msg_pool_hits_total", NULL, 0);
+  stats_unregister_counter(&sc_key, SC_TYPE_SINGLE_VALUE, &stats_msg_pool_hits);
+  stats_cluster_single_key_set(&sc_key, "msg_pool_misses_total", NULL, 0);
+  stats_unregister_counter(&sc_key, SC_TYPE_SINGLE_VALUE, &stats_msg_pool_misses);
+  stats_cluster_single_key_set(&sc_key, "msg_pool_cached_bytes", NULL, 0);
+  stats_cluster_single_key_add_unit(&sc_key, SCU_BYTES);
+  stats_unregister_counter(&sc_key, SC_TYPE_SINGLE_VALUE, &stats_msg_pool_cached_bytes);
+  stats_unlock();
+}
+
+void
+log_msg_pool_global_init(void)
+{
+  register_application_hook(AH_RUNNING, (ApplicationHookFunc) log_msg_pool_register_stats, NULL, AHM_RUN_ONCE);
+}
+
+void
+log_msg_pool_global_deinit(void)
+{
+  log_msg_pool_unregister_stats();
+}
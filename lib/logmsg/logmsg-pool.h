@@ -0,0 +1,56 @@
+/*
+ * Copyright (c) 2024 One Identity LLC.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#ifndef LOGMSG_POOL_H_INCLUDED
+#define LOGMSG_POOL_H_INCLUDED 1
+
+#include "syslog-ng.h"
+
+/* number of distinct block sizes cached per thread */
+#define LOG_MSG_POOL_SIZE_CLASSES        8
+/* maximum number of cached blocks in a single size class */
+#define LOG_MSG_POOL_MAX_BLOCKS          256
+/* maximum number of bytes cached by a single thread */
+#define LOG_MSG_POOL_MAX_CACHED_BYTES    (4 * 1024 * 1024)
+/* blocks larger than this are never cached */
+#define LOG_MSG_POOL_MAX_BLOCK_SIZE      (64 * 1024)
+
+gpointer log_msg_pool_alloc(gsize size);
+void log_msg_pool_free(gpointer block, gsize size);
+
+gssize log_msg_pool_get_local_cached_bytes(void);
+gint log_msg_pool_get_local_cached_blocks(void);
+
+void log_msg_pool_update_stats(void);
+void log_msg_pool_lazy_update_stats(void);
+
+void log_msg_pool_thread_init(void);
+void log_msg_pool_thread_deinit(void);
+
+void log_msg_pool_register_stats(void);
+void log_msg_pool_unregister_stats(void);
+
+void log_msg_pool_global_init(void);
+void log_msg_pool_global_deinit(void);
+
+#endif
@@ -0,0 +1,403 @@
+/*
+ * Copyright (c) 2024 One Identity LLC.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#include "logmsg/logmsg-serialize-compact.h"
+#include "scratch-buffers.h"
+
+/*
+ * Compact encoding of the LogMessage payload (LGM_V27)
+ *
+ * Instead of dumping the NVTable as it is laid out in memory (including
+ * its index and the fixed size entry headers), the payload is written as a
+ * list of name-value pairs:
+ *
+ *    varint      size hint (the number of payload bytes in memory)
+ *    varint      number of direct values
+ *    entry[]     key, type (uint8), varint length, value
+ *    varint      number of indirect values
+ *    entry[]     key, type (uint8), referenced key, varint offset, varint length
+ *    varint      number of SDATA handles
+ *    sdata[]     1 based position of the value in the lists above, or 0
+ *                followed by the name of the value
+ *
+ * Keys are the handles of builtin values or a 0 followed by the varint
+ * length and the name of the value.  As names are resolved to handles upon
+ * reading, there is no need for the handle fixups of the older formats.
+ *
+ * Unset values are not written at all, borrowed values and overlays are
+ * written as if they were ordinary direct values.
+ */
+
+#define COMPACT_PAYLOAD_MAX_INITIAL_SIZE 65536
+
+typedef struct _CompactPayloadWriter
+{
+  SerializeArchive *sa;
+  NVTable *payload;
+  gboolean indirect;
+  guint32 count;
+  GArray *written_handles;
+} CompactPayloadWriter;
+
+static gboolean
+_write_key(SerializeArchive *sa, NVTable *payload, NVHandle handle)
+{
+  if (handle <= payload->num_static_entries)
+    return serialize_write_varint(sa, handle);
+
+  gssize name_len;
+  const gchar *name = log_msg_get_value_name(handle, &name_len);
+
+  return serialize_write_varint(sa, 0) &&
+         serialize_write_varint(sa, name_len) &&
+         serialize_write_blob(sa, name, name_len);
+}
+
+static inline gboolean
+_is_written_as_indirect(NVEntry *entry)
+{
+  return entry->indirect && !entry->borrowed;
+}
+
+static gboolean
+_count_entry(NVHandle handle, NVEntry *entry, NVIndexEntry *index_entry, gpointer user_data)
+{
+  CompactPayloadWriter *writer = (CompactPayloadWriter *) user_data;
+
+  if (!entry->unset && _is_written_as_indirect(entry) == writer->indirect)
+    writer->count++;
+  return FALSE;
+}
+
+static gboolean
+_write_entry(NVHandle handle, NVEntry *entry, NVIndexEntry *index_entry, gpointer user_data)
+{
+  CompactPayloadWriter *writer = (CompactPayloadWriter *) user_data;
+  SerializeArchive *sa = writer->sa;
+
+  if (entry->unset || _is_written_as_indirect(entry) != writer->indirect)
+    return FALSE;
+
+  g_array_append_val(writer->written_handles, handle);
+  _write_key(sa, writer->payload, handle);
+  serialize_write_uint8(sa, entry->type);
+
+  if (writer->indirect)
+    {
+      _write_key(sa, writer->payload, entry->vindirect.handle);
+      serialize_write_varint(sa, entry->vindirect.ofs);
+      serialize_write_varint(sa, entry->vindirect.len);
+    }
+  else
+    {
+      gssize value_len;
+      const gchar *value;
+
+      if (entry->indirect)
+        value = nv_table_resolve_indirect(writer->payload, entry, &value_len);
+      else
+        {
+          value = entry->vdirect.data + entry->name_len + 1;
+          value_len = entry->vdirect.value_len;
+        }
+      serialize_write_varint(sa, value_len);
+      serialize_write_blob(sa, value, value_len);
+    }
+  return FALSE;
+}
+
+static void
+_write_entries(CompactPayloadWriter *writer, gboolean indirect)
+{
+  writer->indirect = indirect;
+  writer->count = 0;
+  nv_table_foreach_entry(writer->payload, _count_entry, writer);
+  serialize_write_varint(writer->sa, writer->count);
+  nv_table_foreach_entry(writer->payload, _write_entry, writer);
+}
+
+static guint32
+_lookup_written_handle(CompactPayloadWriter *writer, NVHandle handle)
+{
+  for (guint32 i = 0; i < writer->written_handles->len; i++)
+    {
+      if (g_array_index(writer->written_handles, NVHandle, i) == handle)
+        return i + 1;
+    }
+  return 0;
+}
+
+static void
+_write_sdata(CompactPayloadWriter *writer, LogMessage *msg)
+{
+  serialize_write_varint(writer->sa, msg->num_sdata);
+  for (gint i = 0; i < msg->num_sdata; i++)
+    {
+      guint32 pos = _lookup_written_handle(writer, msg->sdata[i]);
+
+      if (pos)
+        serialize_write_varint(writer->sa, pos);
+      else
+        _write_key(writer->sa, writer->payload, msg->sdata[i]);
+    }
+}
+
+gboolean
+log_msg_serialize_payload_compact(LogMessageSerializationState *state, NVTable *payload)
+{
+  CompactPayloadWriter writer =
+  {
+    .sa = state->sa,
+    .payload = payload,
+    .written_handles = g_array_sized_new(FALSE, FALSE, sizeof(NVHandle), 32),
+  };
+
+  serialize_write_varint(state->sa, payload->used);
+  _write_entries(&writer, FALSE);
+  _write_entries(&writer, TRUE);
+  _write_sdata(&writer, state->msg);
+
+  g_array_free(writer.written_handles, TRUE);
+  return TRUE;
+}
+
+/**********************************************************************
+ * deserialization
+ **********************************************************************/
+
+static gboolean
+_read_name(SerializeArchive *sa, gchar *name, gsize name_size, gsize *name_len)
+{
+  guint64 len;
+
+  if (!serialize_read_varint(sa, &len) || len == 0 || len >= name_size)
+    return FALSE;
+  if (!serialize_read_blob(sa, name, len))
+    return FALSE;
+  name[len] = 0;
+  *name_len = len;
+  return TRUE;
+}
+
+static gboolean
+_read_key(SerializeArchive *sa, NVHandle *handle)
+{
+  guint64 key;
+
+  if (!serialize_read_varint(sa, &key))
+    return FALSE;
+
+  if (key > 0)
+    {
+      if (key > LM_V_MAX)
+        return FALSE;
+      *handle = key;
+      return TRUE;
+    }
+
+  gchar name[256];
+  gsize name_len;
+
+  if (!_read_name(sa, name, sizeof(name), &name_len))
+    return FALSE;
+  *handle = log_msg_get_value_handle(name);
+  return TRUE;
+}
+
+static gboolean
+_read_count(SerializeArchive *sa, guint32 *count, guint32 max)
+{
+  guint64 n;
+
+  if (!serialize_read_varint(sa, &n) || n > max)
+    return FALSE;
+  *count = n;
+  return TRUE;
+}
+
+static gboolean
+_add_direct_value(NVTable **payload, NVHandle handle, const gchar *value, gsize value_len, NVType type)
+{
+  gssize name_len;
+  const gchar *name = log_msg_get_value_name(handle, &name_len);
+  gboolean new_entry;
+
+  while (!nv_table_add_value(*payload, handle, name, name_len, value, value_len, type, &new_entry))
+    {
+      if (!nv_table_realloc(*payload, payload))
+        return FALSE;
+    }
+  return TRUE;
+}
+
+static gboolean
+_add_indirect_value(NVTable **payload, NVHandle handle, NVReferencedSlice *ref_slice, NVType type)
+{
+  gssize name_len;
+  const gchar *name = log_msg_get_value_name(handle, &name_len);
+  gboolean new_entry;
+
+  while (!nv_table_add_value_indirect(*payload, handle, name, name_len, ref_slice, type, &new_entry))
+    {
+      if (!nv_table_realloc(*payload, payload))
+        return FALSE;
+    }
+  return TRUE;
+}
+
+static gboolean
+_read_direct_values(SerializeArchive *sa, NVTable **payload, GArray *read_handles)
+{
+  guint32 count;
+  gboolean success = FALSE;
+  ScratchBuffersMarker marker;
+  GString *value = scratch_buffers_alloc_and_mark(&marker);
+
+  if (!_read_count(sa, &count, G_MAXUINT16))
+    goto exit;
+
+  for (guint32 i = 0; i < count; i++)
+    {
+      NVHandle handle;
+      guint8 type;
+      guint64 value_len;
+
+      if (!_read_key(sa, &handle) ||
+          !serialize_read_uint8(sa, &type) ||
+          !serialize_read_varint(sa, &value_len) ||
+          value_len > NV_TABLE_MAX_BYTES)
+        goto exit;
+
+      g_string_set_size(value, value_len);
+      if (!serialize_read_blob(sa, value->str, value_len))
+        goto exit;
+
+      if (!_add_direct_value(payload, handle, value->str, value_len, type))
+        goto exit;
+      g_array_append_val(read_handles, handle);
+    }
+  success = TRUE;
+
+exit:
+  scratch_buffers_reclaim_marked(marker);
+  return success;
+}
+
+static gboolean
+_read_indirect_values(SerializeArchive *sa, NVTable **payload, GArray *read_handles)
+{
+  guint32 count;
+
+  if (!_read_count(sa, &count, G_MAXUINT16))
+    return FALSE;
+
+  for (guint32 i = 0; i < count; i++)
+    {
+      NVHandle handle;
+      guint8 type;
+      guint64 ofs, len;
+      NVReferencedSlice ref_slice;
+
+      if (!_read_key(sa, &handle) ||
+          !serialize_read_uint8(sa, &type) ||
+          !_read_key(sa, &ref_slice.handle) ||
+          !serialize_read_varint(sa, &ofs) ||
+          !serialize_read_varint(sa, &len) ||
+          ofs > G_MAXUINT32 || len > G_MAXUINT32)
+        return FALSE;
+
+      ref_slice.ofs = ofs;
+      ref_slice.len = len;
+      if (!_add_indirect_value(payload, handle, &ref_slice, type))
+        return FALSE;
+      g_array_append_val(read_handles, handle);
+    }
+  return TRUE;
+}
+
+static gboolean
+_read_sdata(SerializeArchive *sa, LogMessage *msg, GArray *read_handles)
+{
+  guint32 count;
+
+  if (!_read_count(sa, &count, G_MAXUINT8))
+    return FALSE;
+
+  g_assert(!msg->sdata);
+  msg->num_sdata = 0;
+  msg->alloc_sdata = count;
+  msg->sdata = (NVHandle *) g_malloc(sizeof(NVHandle) * count);
+
+  for (guint32 i = 0; i < count; i++)
+    {
+      guint64 pos;
+
+      if (!serialize_read_varint(sa, &pos) || pos > read_handles->len)
+        return FALSE;
+
+      if (pos > 0)
+        msg->sdata[i] = g_array_index(read_handles, NVHandle, pos - 1);
+      else
+        {
+          gchar name[256];
+          gsize name_len;
+
+          if (!_read_name(sa, name, sizeof(name), &name_len))
+            return FALSE;
+          msg->sdata[i] = log_msg_get_value_handle(name);
+        }
+      msg->num_sdata++;
+    }
+  return TRUE;
+}
+
+gboolean
+log_msg_deserialize_payload_compact(LogMessageSerializationState *state)
+{
+  SerializeArchive *sa = state->sa;
+  LogMessage *msg = state->msg;
+  GArray *read_handles = NULL;
+  NVTable *payload = NULL;
+  guint64 size_hint;
+
+  if (!serialize_read_varint(sa, &size_hint))
+    return FALSE;
+
+  payload = nv_table_new(LM_V_MAX, 16, MIN(size_hint, COMPACT_PAYLOAD_MAX_INITIAL_SIZE));
+  read_handles = g_array_sized_new(FALSE, FALSE, sizeof(NVHandle), 32);
+
+  if (!_read_direct_values(sa, &payload, read_handles) ||
+      !_read_indirect_values(sa, &payload, read_handles) ||
+      !_read_sdata(sa, msg, read_handles))
+    goto error;
+
+  g_array_free(read_handles, TRUE);
+  nv_table_unref(msg->payload);
+  msg->payload = payload;
+  return TRUE;
+
+error:
+  g_array_free(read_handles, TRUE);
+  nv_table_unref(payload);
+  return FALSE;
+}
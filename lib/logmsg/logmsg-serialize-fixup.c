@@ -272,6 +272,15 @@ _update_entry(LogMessageSerializationState *state, NVEntry *entry)
        * adding new flags easier. */
       entry->flags = entry->flags & NVENTRY_FLAGS_DEFINED_IN_LEGACY_FORMATS;
     }
+
+  /* borrowed entries contain a pointer, they are never serialized */
+  if (entry->borrowed)
+    return FALSE;
+
+  /* the binary form of numbers is in host byte order and is only a cache,
+   * don't trust it coming from elsewhere */
+  entry->number_present = FALSE;
+
   if (!entry->type_present)
     {
       entry->type_present = TRUE;
@@ -24,6 +24,7 @@
 
 #include "logmsg/logmsg-serialize.h"
 #include "logmsg/logmsg-serialize-fixup.h"
+#include "logmsg/logmsg-serialize-compact.h"
 #include "logmsg/nvtable-serialize.h"
 #include "logmsg/nvtable-serialize-legacy.h"
 #include "logmsg/gsockaddr-serialize.h"
@@ -54,6 +55,14 @@ nv_table_serialize_with_compaction(LogMessageSerializationState *state, NVTable
   nv_table_unref(payload);
 };
 
+static void
+nv_table_serialize_flattened(LogMessageSerializationState *state, NVTable *overlay, NVTable *parent)
+{
+  NVTable *flattened = nv_table_flatten_overlay(overlay, parent, 0);
+  nv_table_serialize_with_compaction(state, flattened);
+  nv_table_unref(flattened);
+}
+
 static gboolean
 _serialize_message(LogMessageSerializationState *state)
 {
@@ -79,18 +88,66 @@ _serialize_message(LogMessageSerializationState *state)
   serialize_write_uint8(sa, msg->alloc_sdata);
   serialize_write_uint32_array(sa, (guint32 *) msg->sdata, msg->num_sdata);
 
-  if (state->flags & LMSF_COMPACTION)
+  /* overlays are flattened, so the payload is self-contained on disk */
+  if (msg->payload_parent)
+    nv_table_serialize_flattened(state, msg->payload, msg->payload_parent);
+  /* borrowed values point to the input chunk or to interned strings,
+   * compaction copies them */
+  else if ((state->flags & LMSF_COMPACTION) || log_msg_get_input_chunk(msg) ||
+           (msg->flags & LF_STATE_INTERNED_VALUES))
     nv_table_serialize_with_compaction(state, msg->payload);
   else
     nv_table_serialize(state, msg->payload);
   return TRUE;
 }
 
+static gboolean
+_serialize_message_compact(LogMessageSerializationState *state)
+{
+  LogMessage *msg = state->msg;
+  SerializeArchive *sa = state->sa;
+  UnixTime timestamps[LM_TS_MAX];
+
+  memcpy(&timestamps, msg->timestamps, LM_TS_MAX*sizeof(UnixTime));
+  _setup_ts_processed(timestamps, state->processed);
+
+  serialize_write_uint8(sa, state->version);
+  serialize_write_varint(sa, msg->rcptid);
+  serialize_write_varint(sa, msg->flags & ~LF_STATE_MASK);
+  serialize_write_varint(sa, msg->pri);
+  g_sockaddr_serialize(sa, msg->saddr);
+  timestamp_serialize_compact(sa, timestamps);
+  serialize_write_varint(sa, msg->host_id);
+  tags_serialize(msg, sa);
+  serialize_write_uint8(sa, msg->initial_parse);
+  serialize_write_uint8(sa, msg->num_matches);
+
+  if (msg->payload_parent)
+    {
+      NVTable *flattened = nv_table_flatten_overlay(msg->payload, msg->payload_parent, 0);
+      log_msg_serialize_payload_compact(state, flattened);
+      nv_table_unref(flattened);
+    }
+  else
+    log_msg_serialize_payload_compact(state, msg->payload);
+  return TRUE;
+}
+
 gboolean
 log_msg_serialize_with_ts_processed(LogMessage *self, SerializeArchive *sa, const UnixTime *processed, guint32 flags)
 {
   LogMessageSerializationState state = { 0 };
 
+  if (flags & LMSF_COMPACT_ENCODING)
+    {
+      state.version = LGM_V27;
+      state.msg = self;
+      state.sa = sa;
+      state.processed = processed;
+      state.flags = flags;
+      return _serialize_message_compact(&state);
+    }
+
   state.version = LGM_V26;
   state.msg = self;
   state.sa = sa;
@@ -207,6 +264,49 @@ _deserialize_message_version_2x(LogMessageSerializationState *state)
   return TRUE;
 }
 
+static gboolean
+_read_varint_bounded(SerializeArchive *sa, guint64 *value, guint64 max)
+{
+  return serialize_read_varint(sa, value) && *value <= max;
+}
+
+static gboolean
+_deserialize_message_version_27(LogMessageSerializationState *state)
+{
+  LogMessage *msg = state->msg;
+  SerializeArchive *sa = state->sa;
+  guint8 initial_parse = 0;
+  guint64 value;
+
+  if (!serialize_read_varint(sa, &msg->rcptid))
+    return FALSE;
+  if (!_read_varint_bounded(sa, &value, G_MAXUINT32))
+    return FALSE;
+  msg->flags = value | LF_STATE_MASK;
+  if (!_read_varint_bounded(sa, &value, G_MAXUINT16))
+    return FALSE;
+  msg->pri = value;
+  if (!g_sockaddr_deserialize(sa, &msg->saddr))
+    return FALSE;
+  if (!timestamp_deserialize_compact(sa, msg->timestamps))
+    return FALSE;
+  if (!_read_varint_bounded(sa, &value, G_MAXUINT32))
+    return FALSE;
+  msg->host_id = value;
+
+  if (!tags_deserialize(msg, sa))
+    return FALSE;
+
+  if (!serialize_read_uint8(sa, &initial_parse))
+    return FALSE;
+  msg->initial_parse = initial_parse;
+
+  if (!serialize_read_uint8(sa, &msg->num_matches))
+    return FALSE;
+
+  return log_msg_deserialize_payload_compact(state);
+}
+
 static gboolean
 log_msg_read_tags(LogMessage *self, SerializeArchive *sa)
 {
@@ -499,7 +599,7 @@ _check_msg_version(LogMessageSerializationState *state)
   if (!serialize_read_uint8(state->sa, &state->version))
     return FALSE;
 
-  if (state->version < LGM_V10 || state->version > LGM_V26)
+  if (state->version < LGM_V10 || state->version > LGM_V27)
     {
       msg_error("Error deserializing log message, unsupported version",
                 evt_tag_int("version", state->version));
@@ -523,5 +623,8 @@ log_msg_deserialize(LogMessage *self, SerializeArchive *sa)
   if (state.version < LGM_V20)
     return _deserialize_message_version_1x(&state);
 
+  if (state.version == LGM_V27)
+    return _deserialize_message_version_27(&state);
+
   return _deserialize_message_version_2x(&state);
 }
@@ -48,6 +48,8 @@
  *   24      new processed timestamp
  *   25      added hostid
  *   26      use 32 bit values nvtable
+ *   27      compact encoding: varints, payload as a list of values (only
+ *           used with LMSF_COMPACT_ENCODING)
  */
 
 enum _LogMessageVersion
@@ -62,12 +64,14 @@ enum _LogMessageVersion
   LGM_V23 = 23,
   LGM_V24 = 24,
   LGM_V25 = 25,
-  LGM_V26 = 26
+  LGM_V26 = 26,
+  LGM_V27 = 27
 };
 
 enum _LogMessageSerializationFlags
 {
   LMSF_COMPACTION = 0x0001,
+  LMSF_COMPACT_ENCODING = 0x0002,
 };
 
 gboolean log_msg_deserialize(LogMessage *self, SerializeArchive *sa);
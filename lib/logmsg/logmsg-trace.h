@@ -0,0 +1,106 @@
+/*
+ * Copyright (c) 2024 One Identity LLC.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#ifndef LOGMSG_TRACE_H_INCLUDED
+#define LOGMSG_TRACE_H_INCLUDED
+
+#include "logmsg/logmsg.h"
+
+#include <time.h>
+
+/*
+ * Latency trace of sampled messages, see stats(latency-trace-sampling()).
+ *
+ * A traced message carries monotonic timestamps (in nanoseconds) of the
+ * points it passes from log_source_post() until it gets acknowledged.
+ * Clones share the trace of their original, which owns it.  With multiple
+ * destinations, the first push and the last pop is recorded: races between
+ * destination threads only affect the accuracy of a single sample.
+ */
+
+typedef enum
+{
+  LM_TRACE_POSTED,
+  /* after the last parser or filter the message has passed */
+  LM_TRACE_PROCESSED,
+  LM_TRACE_QUEUED,
+  LM_TRACE_DEQUEUED,
+  LM_TRACE_ACKED,
+  LM_TRACE_MAX
+} LogMessageTraceStage;
+
+struct _LogMessageTrace
+{
+  gint64 stamps[LM_TRACE_MAX];
+};
+
+static inline gint64
+log_msg_trace_now(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * G_GINT64_CONSTANT(1000000000) + ts.tv_nsec;
+}
+
+static inline void
+log_msg_trace_start(LogMessage *msg)
+{
+  g_assert(!msg->trace);
+
+  msg->trace = g_new0(LogMessageTrace, 1);
+  msg->trace->stamps[LM_TRACE_POSTED] = log_msg_trace_now();
+}
+
+static inline void
+log_msg_trace_stamp(LogMessage *msg, LogMessageTraceStage stage)
+{
+  if (G_LIKELY(!msg->trace))
+    return;
+
+  if (stage == LM_TRACE_QUEUED && msg->trace->stamps[stage])
+    return;
+
+  msg->trace->stamps[stage] = log_msg_trace_now();
+}
+
+static inline void
+log_msg_trace_stamp_batch(LogMessage **msgs, gint num_msgs, LogMessageTraceStage stage)
+{
+  for (gint i = 0; i < num_msgs; i++)
+    log_msg_trace_stamp(msgs[i], stage);
+}
+
+/* in nanoseconds, -1 if any of the stages was not reached */
+static inline gint64
+log_msg_trace_get_duration(LogMessage *msg, LogMessageTraceStage from, LogMessageTraceStage to)
+{
+  gint64 start = msg->trace->stamps[from];
+  gint64 end = msg->trace->stamps[to];
+
+  if (!start || !end || end < start)
+    return -1;
+  return end - start;
+}
+
+#endif
@@ -30,6 +30,8 @@
 #include "timeutils/cache.h"
 #include "timeutils/misc.h"
 #include "logmsg/nvtable.h"
+#include "logmsg/logmsg-pool.h"
+#include "logmsg/string-intern.h"
 #include "stats/stats-registry.h"
 #include "stats/stats-cluster-single.h"
 #include "template/templates.h"
@@ -37,6 +39,7 @@
 #include "compat/string.h"
 #include "rcptid.h"
 #include "template/macros.h"
+#include "logmsg/logmsg-cache.h"
 #include "host-id.h"
 #include "ack-tracker/ack_tracker.h"
 #include "apphook.h"
@@ -118,6 +121,20 @@
  * counter becomes somewhat more complicated, therefore a g_atomic_int_add()
  * doesn't suffice.  We're using a CAS loop (compare-and-exchange) to do our
  * stuff, but that shouldn't have that much of an overhead.
+ *
+ * Outside of the refcache, operations that are usually performed in pairs
+ * are folded into a single atomic operation:
+ *
+ *    - log_msg_add_ack_and_ref() is used to fan out a message to a branch
+ *      (LogMultiplexer) or to a queue
+ *
+ *    - log_msg_drop() acks and unrefs the message at once, used by filters
+ *      dropping messages and by destinations acknowledging their batches,
+ *      unless the ack is the last one: in that case the ack callback has to
+ *      run while we still hold our reference.
+ *
+ * The number of atomic operations avoided this way (and by the refcache
+ * itself) is published as the msg_refcache_saved_atomics_total counter.
  */
 
 TLS_BLOCK_START
@@ -136,6 +153,10 @@ TLS_BLOCK_START
   gboolean logmsg_cached_abort;
   /* suspend flag in the current thread for acks */
   gboolean logmsg_cached_suspend;
+  /* number of atomic operations saved by the cache since refcache_start */
+  gint logmsg_cached_saved_atomics;
+  /* number of atomic operations saved, not yet published to the stats counter */
+  gint logmsg_saved_atomics_pending;
 }
 TLS_BLOCK_END;
 
@@ -145,6 +166,11 @@ TLS_BLOCK_END;
 #define logmsg_cached_ack_needed    __tls_deref(logmsg_cached_ack_needed)
 #define logmsg_cached_abort         __tls_deref(logmsg_cached_abort)
 #define logmsg_cached_suspend       __tls_deref(logmsg_cached_suspend)
+#define logmsg_cached_saved_atomics __tls_deref(logmsg_cached_saved_atomics)
+#define logmsg_saved_atomics_pending __tls_deref(logmsg_saved_atomics_pending)
+
+/* publish the number of saved atomic operations in chunks of this size */
+#define LOGMSG_SAVED_ATOMICS_UPDATE_THRESHOLD 1024
 
 #define LOGMSG_REFCACHE_SUSPEND_SHIFT                 31 /* number of bits to shift to get the SUSPEND flag */
 #define LOGMSG_REFCACHE_SUSPEND_MASK          0x80000000 /* bit mask to extract the SUSPEND flag */
@@ -293,6 +319,8 @@ __free_macro_value(void *val)
 }
 
 static NVHandle match_handles[256];
+static NVHandle lazy_sdata_handle;
+static LogMessageLazySDataParser lazy_sdata_parser;
 NVRegistry *logmsg_registry;
 const char logmsg_sd_prefix[] = ".SDATA.";
 const gint logmsg_sd_prefix_len = sizeof(logmsg_sd_prefix) - 1;
@@ -302,6 +330,7 @@ static StatsCounterItem *count_msg_clones;
 static StatsCounterItem *count_payload_reallocs;
 static StatsCounterItem *count_sdata_updates;
 static StatsCounterItem *count_allocated_bytes;
+static StatsCounterItem *count_refcache_saved_atomics;
 static GPrivate priv_macro_value = G_PRIVATE_INIT(__free_macro_value);
 
 void
@@ -578,6 +607,60 @@ _value_invalidates_legacy_header(NVHandle handle)
   return handle == LM_V_PROGRAM || handle == LM_V_PID;
 }
 
+/* payloads at least this large are not copied by COW clones on the first
+ * write, an overlay is used instead (see log_msg_make_payload_writable()) */
+#define LOGMSG_PAYLOAD_OVERLAY_MIN_SIZE 1024
+
+/*
+ * A COW clone shares the payload of its original until it is first
+ * changed.  At that point small payloads are simply copied, while larger
+ * ones are left in place as the read-only parent of an empty overlay
+ * NVTable, which only stores the values changed in the clone.  This saves
+ * copying the entire payload for each branch in fan-out heavy
+ * configurations.
+ *
+ * Only a single level of overlays is supported: when a clone of a clone
+ * with an overlay is changed, the overlay is flattened.
+ */
+static void
+log_msg_make_payload_writable(LogMessage *self, gsize additional_space)
+{
+  if (log_msg_chk_flag(self, LF_STATE_OWN_PAYLOAD))
+    return;
+
+  if (self->payload_parent)
+    {
+      self->payload = nv_table_flatten_overlay(self->payload, self->payload_parent, additional_space);
+      self->payload_parent = NULL;
+    }
+  else if (self->payload->used >= LOGMSG_PAYLOAD_OVERLAY_MIN_SIZE)
+    {
+      self->payload_parent = self->payload;
+      self->payload = nv_table_new(LM_V_MAX, 16, additional_space);
+    }
+  else
+    {
+      self->payload = nv_table_clone(self->payload, additional_space);
+    }
+  log_msg_set_flag(self, LF_STATE_OWN_PAYLOAD);
+  self->allocated_bytes += self->payload->size;
+  stats_counter_add(count_allocated_bytes, self->payload->size);
+}
+
+static inline gboolean
+_is_value_present(const LogMessage *self, NVHandle handle)
+{
+  return nv_table_is_value_set(self->payload, handle) ||
+         (self->payload_parent && nv_table_is_value_set(self->payload_parent, handle));
+}
+
+/* new_entry as returned by nv_table_add_value() only covers the overlay */
+static inline gboolean
+_is_new_entry(const LogMessage *self, NVHandle handle, gboolean new_entry)
+{
+  return new_entry && !(self->payload_parent && nv_table_is_value_set(self->payload_parent, handle));
+}
+
 void
 log_msg_rename_value(LogMessage *self, NVHandle from, NVHandle to)
 {
@@ -593,10 +676,34 @@ log_msg_rename_value(LogMessage *self, NVHandle from, NVHandle to)
   log_msg_unset_value(self, from);
 }
 
-void
-log_msg_set_value_with_type(LogMessage *self, NVHandle handle,
-                            const gchar *value, gssize value_len,
-                            LogMessageValueType type)
+static inline const gchar *
+_intern_value(NVHandle handle, const gchar *value, gssize value_len, const NVNumericValue *number)
+{
+  if (G_LIKELY(!(nv_registry_get_handle_flags(logmsg_registry, handle) & LM_VF_INTERNED)) || number)
+    return NULL;
+
+  return string_intern_lookup(value, value_len);
+}
+
+static inline gboolean
+_add_value_to_payload(LogMessage *self, NVHandle handle, const gchar *name, gssize name_len,
+                      const gchar *value, gssize value_len, const gchar *interned_value,
+                      LogMessageValueType type, const NVNumericValue *number, gboolean *new_entry)
+{
+  if (interned_value)
+    {
+      log_msg_set_flag(self, LF_STATE_INTERNED_VALUES);
+      return nv_table_add_value_interned(self->payload, handle, name, name_len, interned_value, value_len, type,
+                                         new_entry);
+    }
+  return nv_table_add_value_with_number(self->payload, handle, name, name_len, value, value_len, type, number,
+                                        new_entry);
+}
+
+static void
+_set_value(LogMessage *self, NVHandle handle,
+           const gchar *value, gssize value_len,
+           LogMessageValueType type, const NVNumericValue *number)
 {
   const gchar *name;
   gssize name_len;
@@ -607,6 +714,9 @@ log_msg_set_value_with_type(LogMessage *self, NVHandle handle,
   if (handle == LM_V_NONE)
     return;
 
+  if (G_UNLIKELY(self->flags & LF_LAZY_SDATA) && log_msg_is_handle_sdata(handle))
+    log_msg_parse_lazy_sdata(self);
+
   name_len = 0;
   name = log_msg_get_value_name(handle, &name_len);
 
@@ -622,18 +732,18 @@ log_msg_set_value_with_type(LogMessage *self, NVHandle handle,
                 evt_tag_msg_reference(self));
     }
 
-  if (!log_msg_chk_flag(self, LF_STATE_OWN_PAYLOAD))
-    {
-      self->payload = nv_table_clone(self->payload, name_len + value_len + 2);
-      log_msg_set_flag(self, LF_STATE_OWN_PAYLOAD);
-      self->allocated_bytes += self->payload->size;
-      stats_counter_add(count_allocated_bytes, self->payload->size);
-    }
+  const gchar *interned_value = _intern_value(handle, value, value_len, number);
+
+  if (interned_value)
+    log_msg_make_payload_writable(self, NV_ENTRY_INDIRECT_SIZE(name_len));
+  else
+    log_msg_make_payload_writable(self, name_len + value_len + 2 + (number ? NV_ENTRY_NUMBER_SIZE : 0));
 
   /* we need a loop here as a single realloc may not be enough. Might help
    * if we pass how much bytes we need though. */
 
-  while (!nv_table_add_value(self->payload, handle, name, name_len, value, value_len, type, &new_entry))
+  while (!_add_value_to_payload(self, handle, name, name_len, value, value_len, interned_value, type, number,
+                                &new_entry))
     {
       /* error allocating string in payload, reallocate */
       guint32 old_size = self->payload->size;
@@ -652,7 +762,7 @@ log_msg_set_value_with_type(LogMessage *self, NVHandle handle,
       stats_counter_inc(count_payload_reallocs);
     }
 
-  if (new_entry)
+  if (_is_new_entry(self, handle, new_entry))
     log_msg_update_sdata(self, handle, name, name_len);
   log_msg_update_num_matches(self, handle);
 
@@ -660,6 +770,29 @@ log_msg_set_value_with_type(LogMessage *self, NVHandle handle,
     log_msg_unset_value(self, LM_V_LEGACY_MSGHDR);
 }
 
+void
+log_msg_set_value_with_type(LogMessage *self, NVHandle handle,
+                            const gchar *value, gssize value_len,
+                            LogMessageValueType type)
+{
+  _set_value(self, handle, value, value_len, type, NULL);
+}
+
+/* Stores the binary form of the value along with its string form, so
+ * consumers can skip parsing the string, see log_msg_get_value_number().
+ * The number must be what parsing the string would produce: an int64 for
+ * LM_VT_INTEGER, a double for LM_VT_DOUBLE and 0 or 1 for LM_VT_BOOLEAN.
+ * For other types the number is ignored.  */
+void
+log_msg_set_value_with_number(LogMessage *self, NVHandle handle,
+                              const gchar *value, gssize value_len,
+                              LogMessageValueType type, const NVNumericValue *number)
+{
+  if (type != LM_VT_INTEGER && type != LM_VT_DOUBLE && type != LM_VT_BOOLEAN)
+    number = NULL;
+  _set_value(self, handle, value, value_len, type, number);
+}
+
 void
 log_msg_set_value(LogMessage *self, NVHandle handle, const gchar *value, gssize value_len)
 {
@@ -671,10 +804,19 @@ log_msg_unset_value(LogMessage *self, NVHandle handle)
 {
   g_assert(!log_msg_is_write_protected(self));
 
-  if (!log_msg_chk_flag(self, LF_STATE_OWN_PAYLOAD))
+  if (G_UNLIKELY(self->flags & LF_LAZY_SDATA) && log_msg_is_handle_sdata(handle))
+    log_msg_parse_lazy_sdata(self);
+
+  log_msg_make_payload_writable(self, 0);
+
+  if (G_UNLIKELY(self->payload_parent) && !nv_table_is_value_set(self->payload, handle))
     {
-      self->payload = nv_table_clone(self->payload, 0);
-      log_msg_set_flag(self, LF_STATE_OWN_PAYLOAD);
+      if (!nv_table_is_value_set(self->payload_parent, handle))
+        return;
+
+      /* the value is only present in the parent of our overlay, add an
+       * entry to the overlay we can mark as unset */
+      log_msg_set_value(self, handle, "", 0);
     }
 
   while (!nv_table_unset_value(self->payload, handle))
@@ -706,6 +848,28 @@ log_msg_unset_value_by_name(LogMessage *self, const gchar *name)
   log_msg_unset_value(self, log_msg_get_value_handle(name));
 }
 
+static gboolean
+_add_value_indirect_to_payload(LogMessage *self, NVHandle handle, const gchar *name, gssize name_len,
+                               NVReferencedSlice *referenced_slice, LogMessageValueType type, gboolean *new_entry)
+{
+  if (G_UNLIKELY(self->payload_parent) && !nv_table_is_value_set(self->payload, referenced_slice->handle))
+    {
+      gssize ref_len;
+      const gchar *ref_value = nv_table_get_value(self->payload_parent, referenced_slice->handle, &ref_len, NULL);
+
+      if (ref_value)
+        {
+          /* the referenced value is in the parent of our overlay, which is
+           * immutable and outlives us, so we can point to it directly */
+          guint32 ofs = MIN(referenced_slice->ofs, ref_len);
+          guint32 len = MIN(ofs + referenced_slice->len, ref_len) - ofs;
+
+          return nv_table_add_value_borrowed(self->payload, handle, name, name_len, ref_value + ofs, len, type, new_entry);
+        }
+    }
+  return nv_table_add_value_indirect(self->payload, handle, name, name_len, referenced_slice, type, new_entry);
+}
+
 void
 log_msg_set_value_indirect_with_type(LogMessage *self, NVHandle handle,
                                      NVHandle ref_handle, guint16 ofs, guint16 len,
@@ -736,11 +900,7 @@ log_msg_set_value_indirect_with_type(LogMessage *self, NVHandle handle,
                 evt_tag_msg_reference(self));
     }
 
-  if (!log_msg_chk_flag(self, LF_STATE_OWN_PAYLOAD))
-    {
-      self->payload = nv_table_clone(self->payload, name_len + 1);
-      log_msg_set_flag(self, LF_STATE_OWN_PAYLOAD);
-    }
+  log_msg_make_payload_writable(self, name_len + 1);
 
   NVReferencedSlice referenced_slice =
   {
@@ -749,7 +909,7 @@ log_msg_set_value_indirect_with_type(LogMessage *self, NVHandle handle,
     .len = len,
   };
 
-  while (!nv_table_add_value_indirect(self->payload, handle, name, name_len, &referenced_slice, type, &new_entry))
+  while (!_add_value_indirect_to_payload(self, handle, name, name_len, &referenced_slice, type, &new_entry))
     {
       /* error allocating string in payload, reallocate */
       if (!nv_table_realloc(self->payload, &self->payload))
@@ -763,7 +923,7 @@ log_msg_set_value_indirect_with_type(LogMessage *self, NVHandle handle,
       stats_counter_inc(count_payload_reallocs);
     }
 
-  if (new_entry)
+  if (_is_new_entry(self, handle, new_entry))
     log_msg_update_sdata(self, handle, name, name_len);
   log_msg_update_num_matches(self, handle);
 }
@@ -775,10 +935,246 @@ log_msg_set_value_indirect(LogMessage *self, NVHandle handle, NVHandle ref_handl
   log_msg_set_value_indirect_with_type(self, handle, ref_handle, ofs, len, LM_VT_STRING);
 }
 
+static gboolean
+_is_value_in_input_chunk(LogMessage *self, const gchar *value, gssize value_len)
+{
+  if (!self->input_chunk)
+    return FALSE;
+
+  gsize chunk_len;
+  const gchar *chunk = g_bytes_get_data(self->input_chunk, &chunk_len);
+
+  return value >= chunk && value + value_len <= chunk + chunk_len;
+}
+
+/*
+ * Set a value without copying it into the payload: @value must point into
+ * the input chunk of the message (see log_msg_set_input_chunk()), which is
+ * kept alive as long as the message (or any of its clones) is.  The value
+ * is copied when the payload is serialized or when the value is
+ * overwritten.
+ *
+ * As borrowed values are not NUL terminated, only dynamic handles are
+ * supported, similarly to indirect values.
+ */
+void
+log_msg_set_value_borrowed_with_type(LogMessage *self, NVHandle handle,
+                                     const gchar *value, gssize value_len,
+                                     LogMessageValueType type)
+{
+  const gchar *name;
+  gssize name_len;
+  gboolean new_entry = FALSE;
+
+  g_assert(!log_msg_is_write_protected(self));
+
+  if (handle == LM_V_NONE)
+    return;
+
+  g_assert(handle >= LM_V_MAX);
+
+  if (value_len < 0)
+    value_len = strlen(value);
+
+  g_assert(_is_value_in_input_chunk(self, value, value_len));
+
+  name_len = 0;
+  name = log_msg_get_value_name(handle, &name_len);
+
+  if (_log_name_value_updates(self))
+    {
+      msg_trace("Setting borrowed value",
+                evt_tag_str("name", name),
+                evt_tag_mem("value", value, value_len),
+                evt_tag_str("type", log_msg_value_type_to_str(type)),
+                evt_tag_msg_reference(self));
+    }
+
+  log_msg_make_payload_writable(self, name_len + 1);
+
+  while (!nv_table_add_value_borrowed(self->payload, handle, name, name_len, value, value_len, type, &new_entry))
+    {
+      /* error allocating string in payload, reallocate */
+      guint32 old_size = self->payload->size;
+      if (!nv_table_realloc(self->payload, &self->payload))
+        {
+          /* can't grow the payload, it has reached the maximum size */
+          msg_info("Cannot store borrowed value for this log message, maximum size has been reached",
+                   evt_tag_int("maximum_payload", NV_TABLE_MAX_BYTES),
+                   evt_tag_str("name", name));
+          break;
+        }
+      guint32 new_size = self->payload->size;
+      self->allocated_bytes += (new_size - old_size);
+      stats_counter_add(count_allocated_bytes, new_size-old_size);
+      stats_counter_inc(count_payload_reallocs);
+    }
+
+  if (_is_new_entry(self, handle, new_entry))
+    log_msg_update_sdata(self, handle, name, name_len);
+  log_msg_update_num_matches(self, handle);
+}
+
+void
+log_msg_set_value_borrowed(LogMessage *self, NVHandle handle, const gchar *value, gssize value_len)
+{
+  log_msg_set_value_borrowed_with_type(self, handle, value, value_len, LM_VT_STRING);
+}
+
+/*
+ * Attach the immutable buffer the message was parsed from, so that values
+ * can be borrowed from it instead of being copied, the message takes a
+ * reference.  The chunk cannot be replaced once set, as borrowed values
+ * may already point into it.
+ */
+void
+log_msg_set_input_chunk(LogMessage *self, GBytes *input_chunk)
+{
+  g_assert(!log_msg_is_write_protected(self));
+  g_assert(!self->input_chunk);
+
+  self->input_chunk = g_bytes_ref(input_chunk);
+  self->allocated_bytes += g_bytes_get_size(input_chunk);
+  stats_counter_add(count_allocated_bytes, g_bytes_get_size(input_chunk));
+}
+
+/*
+ * Lazy SDATA parsing
+ *
+ * Parsing the SDATA block of RFC5424 messages is expensive and is
+ * useless if the message is forwarded as it is.  The syslog parser may
+ * store the unparsed block using log_msg_set_lazy_sdata() instead, which
+ * is then parsed by the registered parser upon the first access of an
+ * SDATA value (or anything that enumerates all values).
+ *
+ * Parsing a writable message stores the values in its payload.  A write
+ * protected message may be shared between threads, so its block is parsed
+ * into a separate message instead, published in lazy_sdata, where the
+ * SDATA values are then looked up.  The unparsed block (and the
+ * LF_LAZY_SDATA flag) is kept by clones and is serialized as is, so it
+ * survives disk-buffers: the values are only parsed where they are used.
+ */
+void
+log_msg_set_lazy_sdata_parser(LogMessageLazySDataParser parser)
+{
+  lazy_sdata_parser = parser;
+}
+
+void
+log_msg_set_lazy_sdata(LogMessage *self, const gchar *sdata, gsize sdata_len)
+{
+  log_msg_set_value(self, lazy_sdata_handle, sdata, sdata_len);
+  self->flags |= LF_LAZY_SDATA;
+}
+
+static const LogMessage *
+_parse_lazy_sdata_of_write_protected(LogMessage *self)
+{
+  LogMessage *parsed = g_atomic_pointer_get(&self->lazy_sdata);
+  if (parsed)
+    return parsed;
+
+  parsed = log_msg_new_empty();
+  if (lazy_sdata_parser)
+    {
+      gssize sdata_len;
+      const gchar *sdata = log_msg_get_value(self, lazy_sdata_handle, &sdata_len);
+
+      parsed->initial_parse = TRUE;
+      lazy_sdata_parser(parsed, sdata, sdata_len);
+      parsed->initial_parse = FALSE;
+    }
+
+  /* another thread may have parsed it meanwhile */
+  if (!g_atomic_pointer_compare_and_exchange(&self->lazy_sdata, NULL, parsed))
+    {
+      log_msg_unref(parsed);
+      parsed = g_atomic_pointer_get(&self->lazy_sdata);
+    }
+  return parsed;
+}
+
+const LogMessage *
+log_msg_parse_lazy_sdata(LogMessage *self)
+{
+  if (log_msg_is_write_protected(self))
+    return _parse_lazy_sdata_of_write_protected(self);
+
+  self->flags &= ~LF_LAZY_SDATA;
+
+  /* without a parser (e.g. the message was read from a disk-buffer
+   * without the syslog parser loaded), the unparsed block is kept */
+  if (!lazy_sdata_parser)
+    return self;
+
+  gssize sdata_len;
+  const gchar *sdata = log_msg_get_value(self, lazy_sdata_handle, &sdata_len);
+
+  /* the parser changes the payload, which may move the value */
+  gchar *sdata_copy = g_strndup(sdata, sdata_len);
+  log_msg_unset_value(self, lazy_sdata_handle);
+
+  gboolean initial_parse = self->initial_parse;
+  self->initial_parse = TRUE;
+  lazy_sdata_parser(self, sdata_copy, sdata_len);
+  self->initial_parse = initial_parse;
+  g_free(sdata_copy);
+  return self;
+}
+
+static gboolean
+_foreach_parent_value(NVHandle handle, const gchar *name, const gchar *value, gssize value_len,
+                      NVType type, gpointer user_data)
+{
+  gpointer *args = (gpointer *) user_data;
+  const LogMessage *self = (const LogMessage *) args[0];
+  NVTableForeachFunc func = (NVTableForeachFunc) args[1];
+
+  /* values in the overlay (including unset ones) hide those in the parent */
+  if (nv_table_is_value_set(self->payload, handle))
+    return FALSE;
+  return func(handle, name, value, value_len, type, args[2]);
+}
+
+static gboolean
+_foreach_value_except_lazy_sdata(NVHandle handle, const gchar *name, const gchar *value, gssize value_len,
+                                 NVType type, gpointer user_data)
+{
+  gpointer *args = (gpointer *) user_data;
+  NVTableForeachFunc func = (NVTableForeachFunc) args[0];
+
+  if (handle == lazy_sdata_handle)
+    return FALSE;
+  return func(handle, name, value, value_len, type, args[1]);
+}
+
+static gboolean
+_values_foreach(const LogMessage *self, NVTableForeachFunc func, gpointer user_data)
+{
+  if (nv_table_foreach(self->payload, logmsg_registry, func, user_data))
+    return TRUE;
+
+  if (G_UNLIKELY(self->payload_parent))
+    {
+      gpointer args[] = { (gpointer) self, func, user_data };
+
+      return nv_table_foreach(self->payload_parent, logmsg_registry, _foreach_parent_value, args);
+    }
+  return FALSE;
+}
+
 gboolean
 log_msg_values_foreach(const LogMessage *self, NVTableForeachFunc func, gpointer user_data)
 {
-  return nv_table_foreach(self->payload, logmsg_registry, func, user_data);
+  const LogMessage *sdata_values = log_msg_ensure_sdata_parsed(self);
+
+  if (G_LIKELY(sdata_values == self))
+    return _values_foreach(self, func, user_data);
+
+  /* the SDATA values of a write protected message are parsed separately */
+  gpointer args[] = { func, user_data };
+  return _values_foreach(self, _foreach_value_except_lazy_sdata, args)
+         || _values_foreach(sdata_values, func, user_data);
 }
 
 NVHandle
@@ -835,7 +1231,7 @@ log_msg_get_match_if_set_with_type(const LogMessage *self, gint index_, gssize *
                                    LogMessageValueType *type)
 {
   if (index_ >= 0 && index_ < LOGMSG_MAX_MATCHES)
-    return nv_table_get_value(self->payload, match_handles[index_], value_len, type);
+    return log_msg_get_payload_value(self, match_handles[index_], value_len, type);
   return NULL;
 }
 
@@ -884,22 +1280,6 @@ log_msg_clear_matches(LogMessage *self)
   log_msg_truncate_matches(self, 0);
 }
 
-#if GLIB_SIZEOF_LONG != GLIB_SIZEOF_VOID_P
-#error "The tags bit array assumes that long is the same size as the pointer"
-#endif
-
-#if GLIB_SIZEOF_LONG == 8
-#define LOGMSG_TAGS_NDX_SHIFT 6
-#define LOGMSG_TAGS_NDX_MASK  0x3F
-#define LOGMSG_TAGS_BITS      64
-#elif GLIB_SIZEOF_LONG == 4
-#define LOGMSG_TAGS_NDX_SHIFT 5
-#define LOGMSG_TAGS_NDX_MASK  0x1F
-#define LOGMSG_TAGS_BITS      32
-#else
-#error "Unsupported word length, only 32 or 64 bit platforms are supported"
-#endif
-
 static inline void
 log_msg_tags_foreach_item(const LogMessage *self, gint base, gulong item, LogMessageTagsForeachFunc callback,
                           gpointer user_data)
@@ -928,7 +1308,10 @@ log_msg_tags_foreach(const LogMessage *self, LogMessageTagsForeachFunc callback,
 
   if (self->num_tags == 0)
     {
-      log_msg_tags_foreach_item(self, 0, (gulong) self->tags, callback, user_data);
+      for (i = 0; i != LOGMSG_TAGS_INLINE_WORDS; ++i)
+        {
+          log_msg_tags_foreach_item(self, i * LOGMSG_TAGS_BITS, self->tags_inline[i], callback, user_data);
+        }
     }
   else
     {
@@ -955,10 +1338,49 @@ log_msg_get_bit(gulong *tags, gint index_)
   return !!(tags[index_ >> LOGMSG_TAGS_NDX_SHIFT] & ((gulong) (1UL << (index_ & LOGMSG_TAGS_NDX_MASK))));
 }
 
+static inline const gulong *
+log_msg_get_tags_words(const LogMessage *self, gint *num_words)
+{
+  if (self->num_tags == 0)
+    {
+      *num_words = LOGMSG_TAGS_INLINE_WORDS;
+      return self->tags_inline;
+    }
+  *num_words = self->num_tags;
+  return self->tags;
+}
+
+/*
+ * Checks if any of the tags in mask is set in the message.  mask is a bit
+ * array of mask_len words, in the same layout as the message stores its
+ * tags, which makes it possible to check a large set of tags with a
+ * couple of word-wide ANDs.  The first matching tag is returned in match.
+ */
+gboolean
+log_msg_is_any_tag_set_by_mask(const LogMessage *self, const gulong *mask, gint mask_len, LogTagId *match)
+{
+  gint num_words;
+  const gulong *tags = log_msg_get_tags_words(self, &num_words);
+
+  num_words = MIN(num_words, mask_len);
+  for (gint i = 0; i < num_words; i++)
+    {
+      gulong matching_bits = tags[i] & mask[i];
+
+      if (matching_bits)
+        {
+          if (match)
+            *match = i * LOGMSG_TAGS_BITS + g_bit_nth_lsf(matching_bits, -1);
+          return TRUE;
+        }
+    }
+  return FALSE;
+}
+
 void
 log_msg_set_tag_by_id_onoff(LogMessage *self, LogTagId id, gboolean on)
 {
-  gulong *old_tags;
+  gulong *new_tags;
   gint old_num_tags;
   gboolean inline_tags;
 
@@ -976,10 +1398,10 @@ log_msg_set_tag_by_id_onoff(LogMessage *self, LogTagId id, gboolean on)
 
   /* if num_tags is 0, it means that we use inline storage of tags */
   inline_tags = self->num_tags == 0;
-  if (inline_tags && id < LOGMSG_TAGS_BITS)
+  if (inline_tags && id < LOGMSG_TAGS_INLINE_MAX)
     {
       /* store this tag inline */
-      log_msg_set_bit((gulong *) &self->tags, id, on);
+      log_msg_set_bit(self->tags_inline, id, on);
     }
   else
     {
@@ -995,15 +1417,19 @@ log_msg_set_tag_by_id_onoff(LogMessage *self, LogTagId id, gboolean on)
           old_num_tags = self->num_tags;
           self->num_tags = (id / LOGMSG_TAGS_BITS) + 1;
 
-          old_tags = self->tags;
           if (old_num_tags)
-            self->tags = g_realloc(self->tags, sizeof(self->tags[0]) * self->num_tags);
+            {
+              self->tags = g_realloc(self->tags, sizeof(self->tags[0]) * self->num_tags);
+            }
           else
-            self->tags = g_malloc(sizeof(self->tags[0]) * self->num_tags);
+            {
+              /* move the inline tags out, tags and tags_inline share their storage */
+              new_tags = g_malloc(sizeof(self->tags[0]) * self->num_tags);
+              memcpy(new_tags, self->tags_inline, sizeof(self->tags_inline));
+              old_num_tags = LOGMSG_TAGS_INLINE_WORDS;
+              self->tags = new_tags;
+            }
           memset(&self->tags[old_num_tags], 0, (self->num_tags - old_num_tags) * sizeof(self->tags[0]));
-
-          if (inline_tags)
-            self->tags[0] = (gulong) old_tags;
         }
 
       log_msg_set_bit(self->tags, id, on);
@@ -1050,8 +1476,8 @@ log_msg_is_tag_by_id(LogMessage *self, LogTagId id)
       msg_error("Invalid tag", evt_tag_int("id", (gint) id));
       return FALSE;
     }
-  if (self->num_tags == 0 && id < LOGMSG_TAGS_BITS)
-    return log_msg_get_bit((gulong *) &self->tags, id);
+  if (self->num_tags == 0 && id < LOGMSG_TAGS_INLINE_MAX)
+    return log_msg_get_bit(self->tags_inline, id);
   else if (id < self->num_tags * LOGMSG_TAGS_BITS)
     return log_msg_get_bit(self->tags, id);
   else
@@ -1113,6 +1539,8 @@ log_msg_append_format_sdata(const LogMessage *self, GString *result,  guint32 se
   gssize sdata_name_len, sdata_elem_len, sdata_param_len, cur_elem_len = 0, len;
   gint i;
   static NVHandle meta_seqid = 0;
+
+  self = log_msg_ensure_sdata_parsed(self);
   gssize seqid_length;
   gboolean has_seq_num = FALSE;
   const gchar *seqid;
@@ -1361,19 +1789,23 @@ log_msg_clear(LogMessage *self)
   if(log_msg_chk_flag(self, LF_STATE_OWN_PAYLOAD))
     nv_table_unref(self->payload);
   self->payload = nv_table_new(LM_V_MAX, 16, 256);
+  self->payload_parent = NULL;
 
-  if (log_msg_chk_flag(self, LF_STATE_OWN_TAGS) && self->tags)
+  /* the new payload has no borrowed values */
+  self->flags &= ~LF_STATE_INTERNED_VALUES;
+  if (self->input_chunk)
     {
-      gboolean inline_tags = self->num_tags == 0;
+      g_bytes_unref(self->input_chunk);
+      self->input_chunk = NULL;
+    }
 
-      if (inline_tags)
-        self->tags = NULL;
-      else
-        memset(self->tags, 0, self->num_tags * sizeof(self->tags[0]));
+  if (log_msg_chk_flag(self, LF_STATE_OWN_TAGS) && self->num_tags > 0)
+    {
+      memset(self->tags, 0, self->num_tags * sizeof(self->tags[0]));
     }
   else
     {
-      self->tags = NULL;
+      memset(self->tags_inline, 0, sizeof(self->tags_inline));
       self->num_tags = 0;
     }
 
@@ -1414,7 +1846,7 @@ log_msg_alloc(gsize payload_size)
       payload_ofs = alloc_size;
       alloc_size += payload_space;
     }
-  msg = g_malloc(alloc_size);
+  msg = log_msg_pool_alloc(alloc_size);
 
   memset(msg, 0, sizeof(LogMessage));
 
@@ -1422,6 +1854,7 @@ log_msg_alloc(gsize payload_size)
     msg->payload = nv_table_init_borrowed(((gchar *) msg) + payload_ofs, payload_space, LM_V_MAX);
 
   msg->num_nodes = nodes;
+  msg->alloc_size = alloc_size;
   msg->allocated_bytes = alloc_size + payload_space;
   stats_counter_add(count_allocated_bytes, msg->allocated_bytes);
   return msg;
@@ -1434,7 +1867,7 @@ _merge_value(NVHandle handle,
 {
   LogMessage *msg = (LogMessage *) user_data;
 
-  if (!nv_table_is_value_set(msg->payload, handle))
+  if (!_is_value_present(msg, handle))
     log_msg_set_value_with_type(msg, handle, value, value_len, type);
   return FALSE;
 }
@@ -1472,12 +1905,16 @@ log_msg_clone_cow(LogMessage *msg, const LogPathOptions *path_options)
 {
   LogMessage *self = log_msg_alloc(0);
   gsize allocated_bytes = self->allocated_bytes;
+  guint32 alloc_size = self->alloc_size;
+  guint8 num_nodes = self->num_nodes;
 
   stats_counter_inc(count_msg_clones);
   log_msg_write_protect(msg);
 
   memcpy(self, msg, sizeof(*msg));
   msg->allocated_bytes = allocated_bytes;
+  self->alloc_size = alloc_size;
+  self->num_nodes = num_nodes;
 
   msg_trace("Message was cloned",
             evt_tag_printf("original_msg", "%p", msg),
@@ -1492,6 +1929,14 @@ log_msg_clone_cow(LogMessage *msg, const LogPathOptions *path_options)
                                                 0) + LOGMSG_REFCACHE_ABORT_TO_VALUE(0);
   self->cur_node = 0;
   self->write_protected = FALSE;
+  self->template_cache = NULL;
+  self->format_cache = NULL;
+  self->lazy_sdata = NULL;
+  self->filter_results = 0;
+
+  /* borrowed values in the shared payload point into the input chunk */
+  if (self->input_chunk)
+    g_bytes_ref(self->input_chunk);
 
   log_msg_add_ack(self, path_options);
   if (!path_options->ack_needed)
@@ -1604,25 +2049,20 @@ log_msg_free(LogMessage *self)
 
   if (self->original)
     log_msg_unref(self->original);
+  else
+    g_free(self->trace);
 
-  stats_counter_sub(count_allocated_bytes, self->allocated_bytes);
+  if (self->input_chunk)
+    g_bytes_unref(self->input_chunk);
 
-  g_free(self);
-}
+  log_msg_cache_free(self->template_cache);
+  log_msg_cache_free(self->format_cache);
+  if (self->lazy_sdata)
+    log_msg_unref(self->lazy_sdata);
 
-/**
- * log_msg_drop:
- * @msg: LogMessage instance
- * @path_options: path specific options
- *
- * This function is called whenever a destination driver feels that it is
- * unable to process this message. It acks and unrefs the message.
- **/
-void
-log_msg_drop(LogMessage *msg, const LogPathOptions *path_options, AckType ack_type)
-{
-  log_msg_ack(msg, path_options, ack_type);
-  log_msg_unref(msg);
+  stats_counter_sub(count_allocated_bytes, self->allocated_bytes);
+
+  log_msg_pool_free(self, self->alloc_size);
 }
 
 static AckType
@@ -1674,6 +2114,17 @@ log_msg_update_ack_and_ref(LogMessage *self, gint add_ref, gint add_ack)
   return log_msg_update_ack_and_ref_and_abort_and_suspended(self, add_ref, add_ack, 0, 0);
 }
 
+static inline void
+_account_saved_atomics(gint count)
+{
+  logmsg_saved_atomics_pending += count;
+  if (G_UNLIKELY(logmsg_saved_atomics_pending >= LOGMSG_SAVED_ATOMICS_UPDATE_THRESHOLD))
+    {
+      stats_counter_add(count_refcache_saved_atomics, logmsg_saved_atomics_pending);
+      logmsg_saved_atomics_pending = 0;
+    }
+}
+
 /**
  * log_msg_ref:
  * @self: LogMessage instance
@@ -1691,6 +2142,7 @@ log_msg_ref(LogMessage *self)
        * delayed until log_msg_refcache_stop() is called */
 
       logmsg_cached_refs++;
+      logmsg_cached_saved_atomics++;
       return self;
     }
 
@@ -1717,6 +2169,7 @@ log_msg_unref(LogMessage *self)
        * delayed until log_msg_refcache_stop() is called */
 
       logmsg_cached_refs--;
+      logmsg_cached_saved_atomics++;
       return;
     }
 
@@ -1747,6 +2200,7 @@ log_msg_add_ack(LogMessage *self, const LogPathOptions *path_options)
 
           logmsg_cached_acks++;
           logmsg_cached_ack_needed = TRUE;
+          logmsg_cached_saved_atomics++;
           return;
         }
       log_msg_update_ack_and_ref(self, 0, 1);
@@ -1778,6 +2232,7 @@ log_msg_ack(LogMessage *self, const LogPathOptions *path_options, AckType ack_ty
           logmsg_cached_acks--;
           logmsg_cached_abort |= IS_ACK_ABORTED(ack_type);
           logmsg_cached_suspend |= IS_ACK_SUSPENDED(ack_type);
+          logmsg_cached_saved_atomics++;
           return;
         }
       old_value = log_msg_update_ack_and_ref_and_abort_and_suspended(self, 0, -1, IS_ACK_ABORTED(ack_type),
@@ -1794,6 +2249,92 @@ log_msg_ack(LogMessage *self, const LogPathOptions *path_options, AckType ack_ty
     }
 }
 
+/**
+ * log_msg_add_ack_and_ref:
+ * @self: LogMessage instance
+ * @path_options: path specific options
+ *
+ * Equivalent to log_msg_add_ack() followed by log_msg_ref(), using a
+ * single atomic operation.  Returns the new reference.
+ **/
+LogMessage *
+log_msg_add_ack_and_ref(LogMessage *self, const LogPathOptions *path_options)
+{
+  gint old_value;
+
+  if (G_LIKELY(logmsg_current == self) || !path_options->ack_needed)
+    {
+      log_msg_add_ack(self, path_options);
+      return log_msg_ref(self);
+    }
+
+  old_value = log_msg_update_ack_and_ref(self, 1, 1);
+  g_assert(LOGMSG_REFCACHE_VALUE_TO_REF(old_value) >= 1);
+  _account_saved_atomics(1);
+  return self;
+}
+
+/**
+ * log_msg_drop:
+ * @msg: LogMessage instance
+ * @path_options: path specific options
+ *
+ * This function is called whenever a destination driver feels that it is
+ * unable to process this message. It acks and unrefs the message.
+ *
+ * The ack and the unref are folded into a single atomic operation, except
+ * if this is the last pending ack: the ack callback is to be invoked while
+ * we still hold our reference.
+ **/
+void
+log_msg_drop(LogMessage *msg, const LogPathOptions *path_options, AckType ack_type)
+{
+  gint old_value, new_value;
+  gboolean last_ack;
+
+  if (G_LIKELY(logmsg_current == msg) || !path_options->ack_needed)
+    {
+      log_msg_ack(msg, path_options, ack_type);
+      log_msg_unref(msg);
+      return;
+    }
+
+  do
+    {
+      new_value = old_value = (volatile gint) msg->ack_and_ref_and_abort_and_suspended;
+      last_ack = LOGMSG_REFCACHE_VALUE_TO_ACK(old_value) == 1;
+
+      new_value = (new_value & ~LOGMSG_REFCACHE_ACK_MASK) + LOGMSG_REFCACHE_ACK_TO_VALUE(LOGMSG_REFCACHE_VALUE_TO_ACK(
+                    old_value) - 1);
+      new_value = (new_value & ~LOGMSG_REFCACHE_ABORT_MASK) + LOGMSG_REFCACHE_ABORT_TO_VALUE((LOGMSG_REFCACHE_VALUE_TO_ABORT(
+                    old_value) | IS_ACK_ABORTED(ack_type)));
+      new_value = (new_value & ~LOGMSG_REFCACHE_SUSPEND_MASK) + LOGMSG_REFCACHE_SUSPEND_TO_VALUE((
+                    LOGMSG_REFCACHE_VALUE_TO_SUSPEND(old_value) | IS_ACK_SUSPENDED(ack_type)));
+      if (!last_ack)
+        new_value = (new_value & ~LOGMSG_REFCACHE_REF_MASK) + LOGMSG_REFCACHE_REF_TO_VALUE(LOGMSG_REFCACHE_VALUE_TO_REF(
+                      old_value) - 1);
+    }
+  while (!g_atomic_int_compare_and_exchange(&msg->ack_and_ref_and_abort_and_suspended, old_value, new_value));
+
+  g_assert(LOGMSG_REFCACHE_VALUE_TO_REF(old_value) >= 1);
+
+  if (!last_ack)
+    {
+      _account_saved_atomics(1);
+      if (LOGMSG_REFCACHE_VALUE_TO_REF(old_value) == 1)
+        log_msg_free(msg);
+      return;
+    }
+
+  if (ack_type == AT_SUSPENDED)
+    msg->ack_func(msg, AT_SUSPENDED);
+  else if (ack_type == AT_ABORTED)
+    msg->ack_func(msg, AT_ABORTED);
+  else
+    msg->ack_func(msg, _ack_and_ref_and_abort_and_suspend_to_acktype(old_value));
+  log_msg_unref(msg);
+}
+
 /*
  * Break out of an acknowledgement chain. The incoming message is
  * ACKed and a new path options structure is returned that can be used
@@ -1854,6 +2395,7 @@ log_msg_refcache_start_producer(LogMessage *self)
   logmsg_cached_abort = FALSE;
   logmsg_cached_suspend = FALSE;
   logmsg_cached_ack_needed = TRUE;
+  logmsg_cached_saved_atomics = 0;
 }
 
 /*
@@ -1879,6 +2421,7 @@ log_msg_refcache_start_consumer(LogMessage *self, const LogPathOptions *path_opt
   logmsg_cached_acks = 0;
   logmsg_cached_abort = FALSE;
   logmsg_cached_suspend = FALSE;
+  logmsg_cached_saved_atomics = 0;
 }
 
 /*
@@ -1987,6 +2530,12 @@ log_msg_refcache_stop(void)
     log_msg_free(logmsg_current);
   logmsg_cached_refs = 0;
   logmsg_current = NULL;
+
+  /* we took and dropped a cached ref of our own and folded the results in
+   * using two atomic operations, these are not savings */
+  if (logmsg_cached_saved_atomics > 4)
+    _account_saved_atomics(logmsg_cached_saved_atomics - 4);
+  logmsg_cached_saved_atomics = 0;
 }
 
 void
@@ -1999,6 +2548,9 @@ log_msg_registry_init(void)
   nv_registry_add_alias(logmsg_registry, LM_V_MESSAGE, "MSGONLY");
   nv_registry_add_alias(logmsg_registry, LM_V_HOST, "FULLHOST");
   nv_registry_add_alias(logmsg_registry, LM_V_HOST_FROM, "FULLHOST_FROM");
+  nv_registry_set_handle_flags(logmsg_registry, LM_V_HOST, LM_VF_INTERNED);
+  nv_registry_set_handle_flags(logmsg_registry, LM_V_HOST_FROM, LM_VF_INTERNED);
+  nv_registry_set_handle_flags(logmsg_registry, LM_V_PROGRAM, LM_VF_INTERNED);
 
   for (i = 0; macros[i].name; i++)
     {
@@ -2011,6 +2563,8 @@ log_msg_registry_init(void)
         }
     }
 
+  lazy_sdata_handle = nv_registry_alloc_handle(logmsg_registry, "._lazy_sdata");
+
   /* register $0 - $255 in order */
   for (i = 0; i < LOGMSG_MAX_MATCHES; i++)
     {
@@ -2043,8 +2597,9 @@ log_msg_register_stats(void)
   stats_cluster_logpipe_key_legacy_set(&sc_key, SCS_GLOBAL, "msg_clones", NULL );
   stats_register_counter(0, &sc_key, SC_TYPE_PROCESSED, &count_msg_clones);
 
-  stats_cluster_logpipe_key_legacy_set(&sc_key, SCS_GLOBAL, "payload_reallocs", NULL );
-  stats_register_counter(0, &sc_key, SC_TYPE_PROCESSED, &count_payload_reallocs);
+  stats_cluster_single_key_set(&sc_key, "events_payload_reallocs_total", NULL, 0);
+  stats_cluster_single_key_add_legacy_alias_with_name(&sc_key, SCS_GLOBAL, "payload_reallocs", NULL, "processed");
+  stats_register_counter(0, &sc_key, SC_TYPE_SINGLE_VALUE, &count_payload_reallocs);
 
   stats_cluster_logpipe_key_legacy_set(&sc_key, SCS_GLOBAL, "sdata_updates", NULL );
   stats_register_counter(0, &sc_key, SC_TYPE_PROCESSED, &count_sdata_updates);
@@ -2052,12 +2607,16 @@ log_msg_register_stats(void)
   stats_cluster_single_key_set(&sc_key, "events_allocated_bytes", NULL, 0);
   stats_cluster_single_key_add_legacy_alias(&sc_key, SCS_GLOBAL, "msg_allocated_bytes", NULL);
   stats_register_counter(1, &sc_key, SC_TYPE_SINGLE_VALUE, &count_allocated_bytes);
+
+  stats_cluster_single_key_set(&sc_key, "msg_refcache_saved_atomics_total", NULL, 0);
+  stats_register_counter(1, &sc_key, SC_TYPE_SINGLE_VALUE, &count_refcache_saved_atomics);
   stats_unlock();
 }
 
 void
 log_msg_global_init(void)
 {
+  string_intern_global_init();
   log_msg_registry_init();
 
   /* NOTE: we always initialize counters as they are on stats-level(0),
@@ -2077,6 +2636,7 @@ void
 log_msg_global_deinit(void)
 {
   log_msg_registry_deinit();
+  string_intern_global_deinit();
 }
 
 gint
@@ -2103,6 +2663,19 @@ log_msg_get_size(LogMessage *self)
     nv_table_get_memory_consumption(self->payload); // msg.payload (nvtable)
 }
 
+void
+log_msg_get_memory_usage(const LogMessage *self, LogMessageMemoryUsage *usage)
+{
+  /* inline tags live in the LogMessage itself, they are reported as tags instead of header */
+  gsize inline_tags = self->num_tags ? 0 : sizeof(self->tags_inline);
+
+  usage->header = sizeof(LogMessage) - inline_tags + g_sockaddr_len(self->saddr) + g_sockaddr_len(self->daddr);
+  usage->payload_slack = nv_table_get_slack(self->payload);
+  usage->payload_used = self->payload->size - usage->payload_slack;
+  usage->tags = self->num_tags ? self->num_tags * sizeof(self->tags[0]) : inline_tags;
+  usage->sdata = self->alloc_sdata * sizeof(self->sdata[0]);
+}
+
 #ifdef __linux__
 
 const gchar *
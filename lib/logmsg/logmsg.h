@@ -61,6 +61,8 @@ typedef enum
 typedef struct _LogPathOptions LogPathOptions;
 
 typedef void (*LMAckFunc)(LogMessage *lm, AckType ack_type);
+typedef struct _LogMessageTrace LogMessageTrace;
+typedef struct _LogMessageCache LogMessageCache;
 
 #define LOGMSG_MAX_MATCHES 256
 
@@ -99,6 +101,8 @@ enum
   LM_VF_SDATA = 0x0001,
   LM_VF_MATCH = 0x0002,
   LM_VF_MACRO = 0x0004,
+  /* low-cardinality value, stored as a reference to the string intern table */
+  LM_VF_INTERNED = 0x0008,
 };
 
 enum
@@ -127,6 +131,8 @@ enum
   /* part of the state that is kept across clones */
   LF_STATE_CLONED_MASK = 0xFE00,
   LF_STATE_TRACING     = 0x0200,
+  /* the payload references interned strings, it needs compaction when serialized */
+  LF_STATE_INTERNED_VALUES = 0x0400,
 
   LF_CHAINED_HOSTNAME  = 0x00010000,
 
@@ -142,6 +148,11 @@ enum
    * The flag remains here for documentation, and also because it is serialized in disk-buffers
    */
   __UNUSED_LF_LEGACY_MSGHDR    = 0x00020000,
+
+  /* the SDATA block of the message was not parsed yet, it is stored as a
+   * single value and is parsed upon first access (see
+   * log_msg_set_lazy_sdata()) */
+  LF_LAZY_SDATA        = 0x00040000,
 };
 
 typedef NVType LogMessageValueType;
@@ -178,6 +189,29 @@ enum _LogMessageValueType
 const gchar *log_msg_value_type_to_str(LogMessageValueType self);
 gboolean log_msg_value_type_from_str(const gchar *in_str, LogMessageValueType *out_type);
 
+#if GLIB_SIZEOF_LONG != GLIB_SIZEOF_VOID_P
+#error "The tags bit array assumes that long is the same size as the pointer"
+#endif
+
+#if GLIB_SIZEOF_LONG == 8
+#define LOGMSG_TAGS_NDX_SHIFT 6
+#define LOGMSG_TAGS_NDX_MASK  0x3F
+#define LOGMSG_TAGS_BITS      64
+#elif GLIB_SIZEOF_LONG == 4
+#define LOGMSG_TAGS_NDX_SHIFT 5
+#define LOGMSG_TAGS_NDX_MASK  0x1F
+#define LOGMSG_TAGS_BITS      32
+#else
+#error "Unsupported word length, only 32 or 64 bit platforms are supported"
+#endif
+
+/* tags with an ID below this are stored inline, without an allocation */
+#define LOGMSG_TAGS_INLINE_MAX   128
+#define LOGMSG_TAGS_INLINE_WORDS (LOGMSG_TAGS_INLINE_MAX / LOGMSG_TAGS_BITS)
+
+/* the number of filter rules whose results fit into LogMessage->filter_results */
+#define LOGMSG_FILTER_RESULT_SLOTS (GLIB_SIZEOF_SIZE_T * 8 / 2)
+
 typedef struct _LogMessageQueueNode
 {
   struct iv_list_head list;
@@ -215,10 +249,42 @@ struct _LogMessage
 
   guint32 recvd_rawmsg_size;
 
+  /* the size of the memory block holding this LogMessage (including the
+   * queue nodes and the embedded payload), used to return it to the
+   * log_msg_pool */
+  guint32 alloc_size;
+
   AckRecord *ack_record;
   LMAckFunc ack_func;
   LogMessage *original;
 
+  /* immutable copy of the input this message was parsed from, borrowed
+   * values in the payload may point into it, see
+   * log_msg_set_value_borrowed() */
+  GBytes *input_chunk;
+
+  /* timestamps of sampled messages, shared with clones, see logmsg-trace.h */
+  LogMessageTrace *trace;
+
+  /* results of templates evaluated on this message while it was write
+   * protected, never copied into clones, see template/eval-cache.c */
+  LogMessageCache *template_cache;
+
+  /* output lines generated by the builtin LogWriter formats, never copied
+   * into clones, see logwriter-format-cache.c */
+  LogMessageCache *format_cache;
+
+  /* the lazily stored SDATA block parsed after the message got write
+   * protected, the SDATA values are looked up here instead of the shared
+   * payload, never copied into clones, see log_msg_parse_lazy_sdata() */
+  LogMessage *lazy_sdata;
+
+  /* results of the filter rules evaluated on this message while it was
+   * write protected, two bits for each slot assigned by
+   * cfg_tree_allocate_filter_result_slot(), never copied into clones, see
+   * filter/filter-pipe.c */
+  gsize filter_results;
+
   /* message parts */
 
   /* the contents of the members below is directly copied into another
@@ -228,13 +294,26 @@ struct _LogMessage
    */
   /* ==== start of directly copied part ==== */
   UnixTime timestamps[LM_TS_MAX];
-  gulong *tags;
+
+  /* tags are stored as a bit array: if num_tags is 0, the bits are stored
+   * inline in tags_inline, otherwise tags points to num_tags words */
+  union
+  {
+    gulong *tags;
+    gulong tags_inline[LOGMSG_TAGS_INLINE_WORDS];
+  };
   NVHandle *sdata;
 
   GSockAddr *saddr;
   GSockAddr *daddr;
   NVTable *payload;
 
+  /* if set, payload is an overlay that only contains the values changed
+   * in this COW clone, anything else is looked up here.  This is the
+   * read-only payload of one of our originals and is kept alive by
+   * the reference in "original". */
+  NVTable *payload_parent;
+
   guint32 flags;
   guint16 pri;
   guint8 initial_parse:1,
@@ -354,6 +433,34 @@ const gchar *log_msg_get_match_if_set_with_type(const LogMessage *self, gint ind
 
 
 
+typedef void (*LogMessageLazySDataParser)(LogMessage *self, const gchar *sdata, gsize sdata_len);
+
+void log_msg_set_lazy_sdata_parser(LogMessageLazySDataParser parser);
+void log_msg_set_lazy_sdata(LogMessage *self, const gchar *sdata, gsize sdata_len);
+const LogMessage *log_msg_parse_lazy_sdata(LogMessage *self);
+
+/* lazily stored SDATA is parsed upon first access, returns the message
+ * holding the SDATA values: @self, unless it is write protected */
+static inline const LogMessage *
+log_msg_ensure_sdata_parsed(const LogMessage *self)
+{
+  if (G_UNLIKELY(self->flags & LF_LAZY_SDATA))
+    return log_msg_parse_lazy_sdata((LogMessage *) self);
+  return self;
+}
+
+static inline const gchar *
+log_msg_get_payload_value(const LogMessage *self, NVHandle handle, gssize *value_len, LogMessageValueType *type)
+{
+  NVTable *payload = self->payload;
+
+  /* values not present in an overlay are looked up in its parent,
+   * unset values in the overlay hide those in the parent */
+  if (G_UNLIKELY(self->payload_parent) && !nv_table_is_value_set(payload, handle))
+    payload = self->payload_parent;
+  return nv_table_get_value(payload, handle, value_len, type);
+}
+
 static inline const gchar *
 log_msg_get_value_if_set_with_type(const LogMessage *self, NVHandle handle,
                                    gssize *value_len,
@@ -364,8 +471,27 @@ log_msg_get_value_if_set_with_type(const LogMessage *self, NVHandle handle,
   flags = nv_registry_get_handle_flags(logmsg_registry, handle);
   if (G_UNLIKELY((flags & LM_VF_MACRO)))
     return log_msg_get_macro_value(self, flags >> 8, value_len, type);
-  else
-    return nv_table_get_value(self->payload, handle, value_len, type);
+
+  if (G_UNLIKELY((flags & LM_VF_SDATA)))
+    self = log_msg_ensure_sdata_parsed(self);
+  return log_msg_get_payload_value(self, handle, value_len, type);
+}
+
+/* the binary form of numeric values, if it was stored by
+ * log_msg_set_value_with_number(), interpret it according to the type of
+ * the value */
+static inline gboolean
+log_msg_get_value_number(const LogMessage *self, NVHandle handle, NVNumericValue *number)
+{
+  guint16 flags = nv_registry_get_handle_flags(logmsg_registry, handle);
+
+  if (G_UNLIKELY(flags & (LM_VF_MACRO | LM_VF_SDATA)))
+    return FALSE;
+
+  NVTable *payload = self->payload;
+  if (G_UNLIKELY(self->payload_parent) && !nv_table_is_value_set(payload, handle))
+    payload = self->payload_parent;
+  return nv_table_get_value_number(payload, handle, number);
 }
 
 static inline const gchar *
@@ -423,11 +549,19 @@ void log_msg_set_value(LogMessage *self, NVHandle handle, const gchar *new_value
 void log_msg_set_value_with_type(LogMessage *self, NVHandle handle,
                                  const gchar *value, gssize value_len,
                                  LogMessageValueType type);
+void log_msg_set_value_with_number(LogMessage *self, NVHandle handle,
+                                   const gchar *value, gssize value_len,
+                                   LogMessageValueType type, const NVNumericValue *number);
 
 void log_msg_set_value_indirect(LogMessage *self, NVHandle handle, NVHandle ref_handle,
                                 guint16 ofs, guint16 len);
 void log_msg_set_value_indirect_with_type(LogMessage *self, NVHandle handle, NVHandle ref_handle,
                                           guint16 ofs, guint16 len, LogMessageValueType type);
+void log_msg_set_value_borrowed(LogMessage *self, NVHandle handle, const gchar *value, gssize value_len);
+void log_msg_set_value_borrowed_with_type(LogMessage *self, NVHandle handle,
+                                          const gchar *value, gssize value_len,
+                                          LogMessageValueType type);
+void log_msg_set_input_chunk(LogMessage *self, GBytes *input_chunk);
 void log_msg_unset_value(LogMessage *self, NVHandle handle);
 void log_msg_unset_value_by_name(LogMessage *self, const gchar *name);
 gboolean log_msg_values_foreach(const LogMessage *self, NVTableForeachFunc func, gpointer user_data);
@@ -456,6 +590,15 @@ log_msg_set_value_by_name_with_type(LogMessage *self,
   log_msg_set_value_with_type(self, handle, value, length, type);
 }
 
+static inline void
+log_msg_set_value_by_name_with_number(LogMessage *self,
+                                      const gchar *name, const gchar *value, gssize length,
+                                      LogMessageValueType type, const NVNumericValue *number)
+{
+  NVHandle handle = log_msg_get_value_handle(name);
+  log_msg_set_value_with_number(self, handle, value, length, type, number);
+}
+
 static inline void
 log_msg_set_value_by_name(LogMessage *self, const gchar *name, const gchar *value, gssize length)
 {
@@ -474,11 +617,18 @@ void log_msg_clear_tag_by_id(LogMessage *self, LogTagId id);
 void log_msg_clear_tag_by_name(LogMessage *self, const gchar *name);
 gboolean log_msg_is_tag_by_id(LogMessage *self, LogTagId id);
 gboolean log_msg_is_tag_by_name(LogMessage *self, const gchar *name);
+gboolean log_msg_is_any_tag_set_by_mask(const LogMessage *self, const gulong *mask, gint mask_len, LogTagId *match);
 void log_msg_tags_foreach(const LogMessage *self, LogMessageTagsForeachFunc callback, gpointer user_data);
 void log_msg_format_tags(const LogMessage *self, GString *result);
 void log_msg_format_matches(const LogMessage *self, GString *result);
 
 
+static inline GBytes *
+log_msg_get_input_chunk(const LogMessage *self)
+{
+  return self->input_chunk;
+}
+
 static inline void
 log_msg_set_recvd_rawmsg_size(LogMessage *self, guint32 size)
 {
@@ -505,6 +655,7 @@ LogMessage *log_msg_new_empty(void);
 LogMessage *log_msg_new_local(void);
 
 void log_msg_add_ack(LogMessage *msg, const LogPathOptions *path_options);
+LogMessage *log_msg_add_ack_and_ref(LogMessage *msg, const LogPathOptions *path_options);
 void log_msg_ack(LogMessage *msg, const LogPathOptions *path_options, AckType ack_type);
 void log_msg_drop(LogMessage *msg, const LogPathOptions *path_options, AckType ack_type);
 const LogPathOptions *log_msg_break_ack(LogMessage *msg, const LogPathOptions *path_options,
@@ -525,6 +676,18 @@ gint log_msg_lookup_time_stamp_name(const gchar *name);
 
 gssize log_msg_get_size(LogMessage *self);
 
+/* breakdown of the memory used by a LogMessage, in bytes */
+typedef struct _LogMessageMemoryUsage
+{
+  gsize header;
+  gsize payload_used;
+  gsize payload_slack;
+  gsize tags;
+  gsize sdata;
+} LogMessageMemoryUsage;
+
+void log_msg_get_memory_usage(const LogMessage *self, LogMessageMemoryUsage *usage);
+
 #define evt_tag_msg_reference(msg)             \
     evt_tag_printf("msg", "%p", (msg)),        \
     evt_tag_printf("rcptid", "%" G_GUINT64_FORMAT, (msg)->rcptid)
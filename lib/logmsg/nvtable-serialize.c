@@ -214,6 +214,24 @@ _write_struct(SerializeArchive *sa, NVTable *self)
   serialize_write_uint32_array(sa, (guint32 *) nv_table_get_index(self), self->index_size * 2);
 }
 
+/* a hashed index is only an in-memory representation, it is always
+ * written as a sorted array, which is what the deserializer (including
+ * those in earlier versions) expect */
+static void
+_write_struct_with_hashed_index(SerializeArchive *sa, NVTable *self)
+{
+  NVIndexEntry *sorted_index = g_new(NVIndexEntry, self->index_size);
+  guint16 index_size = nv_table_get_sorted_index(self, sorted_index);
+
+  serialize_write_uint32(sa, self->size);
+  serialize_write_uint32(sa, self->used);
+  serialize_write_uint16(sa, index_size);
+  serialize_write_uint8(sa, self->num_static_entries);
+  serialize_write_uint32_array(sa, self->static_entries, self->num_static_entries);
+  serialize_write_uint32_array(sa, (guint32 *) sorted_index, index_size * 2);
+  g_free(sorted_index);
+}
+
 static void
 _write_meta_data(SerializeArchive *sa, NVTableMetaData *meta_data)
 {
@@ -245,7 +263,10 @@ nv_table_serialize(LogMessageSerializationState *state, NVTable *self)
   _fill_meta_data(self, &meta_data);
   _write_meta_data(sa, &meta_data);
 
-  _write_struct(sa, self);
+  if (nv_table_is_index_hashed(self))
+    _write_struct_with_hashed_index(sa, self);
+  else
+    _write_struct(sa, self);
 
   _write_payload(sa, self);
   return TRUE;
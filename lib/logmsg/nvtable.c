@@ -22,6 +22,7 @@
  *
  */
 #include "logmsg/nvtable.h"
+#include "logmsg/logmsg-pool.h"
 #include "messages.h"
 
 #include <string.h>
@@ -185,6 +186,17 @@ nv_table_resolve_indirect(NVTable *self, NVEntry *entry, gssize *length)
 
   g_assert(entry->indirect);
 
+  if (entry->borrowed)
+    {
+      /* borrowed values are not NUL terminated either, except for
+       * interned ones */
+      g_assert(length != NULL || entry->interned);
+
+      if (length)
+        *length = entry->vindirect.len;
+      return nv_entry_get_borrowed_value(entry);
+    }
+
   referenced_value = nv_table_get_value(self, entry->vindirect.handle, &referenced_length, NULL);
   if (!referenced_value || entry->vindirect.ofs > referenced_length)
     {
@@ -276,8 +288,166 @@ _find_index_entry(NVIndexEntry *index_table, gint index_size, NVHandle handle, N
   return NULL;
 }
 
+/* hashed index, see the description of the memory layout in nvtable.h */
+
+static inline NVIndexEntry *
+_get_hashed_index_header(NVTable *self)
+{
+  return &nv_table_get_index(self)[0];
+}
+
+static inline NVIndexEntry *
+_get_hashed_index_slots(NVTable *self)
+{
+  return &nv_table_get_index(self)[1];
+}
+
+static inline guint32
+_get_hashed_index_capacity(NVTable *self)
+{
+  return self->index_size - 1;
+}
+
+static inline guint32
+_hash_handle(NVHandle handle)
+{
+  /* multiplicative hashing, handles are mostly consecutive integers, which
+   * this spreads evenly in the low bits */
+  return handle * 2654435761U;
+}
+
+static inline NVIndexEntry *
+_find_hashed_index_entry(NVTable *self, NVHandle handle, NVIndexEntry **index_slot)
+{
+  NVIndexEntry *slots = _get_hashed_index_slots(self);
+  guint32 mask = _get_hashed_index_capacity(self) - 1;
+  guint32 i = _hash_handle(handle) & mask;
+
+  /* the load factor is kept below 1, so there's always an empty slot */
+  while (slots[i].handle != 0)
+    {
+      if (slots[i].handle == handle)
+        {
+          *index_slot = &slots[i];
+          return &slots[i];
+        }
+      i = (i + 1) & mask;
+    }
+  *index_slot = &slots[i];
+  return NULL;
+}
+
+static gint
+_index_entry_cmp(const void *a, const void *b)
+{
+  NVHandle handle_a = ((const NVIndexEntry *) a)->handle;
+  NVHandle handle_b = ((const NVIndexEntry *) b)->handle;
+
+  if (handle_a < handle_b)
+    return -1;
+  return handle_a > handle_b;
+}
+
+/* fills @sorted_index with the elements of the index, sorted by handle.
+ * @sorted_index must have room for self->index_size elements, the number
+ * of elements stored is returned */
+guint16
+nv_table_get_sorted_index(NVTable *self, NVIndexEntry *sorted_index)
+{
+  if (!nv_table_is_index_hashed(self))
+    {
+      memcpy(sorted_index, nv_table_get_index(self), self->index_size * sizeof(NVIndexEntry));
+      return self->index_size;
+    }
+
+  NVIndexEntry *slots = _get_hashed_index_slots(self);
+  guint32 capacity = _get_hashed_index_capacity(self);
+  guint16 count = 0;
+
+  for (guint32 i = 0; i < capacity; i++)
+    {
+      if (slots[i].handle != 0)
+        sorted_index[count++] = slots[i];
+    }
+  qsort(sorted_index, count, sizeof(NVIndexEntry), _index_entry_cmp);
+  return count;
+}
+
+/* converts the index into a hashed one with @new_capacity slots, or grows
+ * an already hashed index */
+static gboolean
+_rehash_index(NVTable *self, guint32 new_capacity)
+{
+  NVIndexEntry *index_table = nv_table_get_index(self);
+  guint32 new_index_size = new_capacity + 1;
+
+  if (!nv_table_alloc_check(self, (new_index_size - self->index_size) * sizeof(NVIndexEntry)))
+    return FALSE;
+
+  NVIndexEntry *entries = g_new(NVIndexEntry, self->index_size);
+  guint16 count = nv_table_get_sorted_index(self, entries);
+
+  memset(index_table, 0, new_index_size * sizeof(NVIndexEntry));
+  self->index_size = new_index_size;
+  _get_hashed_index_header(self)->ofs = count;
+
+  for (guint16 i = 0; i < count; i++)
+    {
+      NVIndexEntry *index_slot;
+
+      _find_hashed_index_entry(self, entries[i].handle, &index_slot);
+      *index_slot = entries[i];
+    }
+  g_free(entries);
+  return TRUE;
+}
+
+static inline guint32
+_calculate_hashed_index_capacity(guint32 count, guint32 capacity)
+{
+  /* keep the load factor below 3/4 */
+  while (count * 4 > capacity * 3)
+    capacity *= 2;
+  return capacity;
+}
+
+static gboolean
+_alloc_hashed_index_entry(NVTable *self, NVHandle handle, NVIndexEntry **index_entry, NVIndexEntry *index_slot)
+{
+  gboolean hashed = nv_table_is_index_hashed(self);
+  guint32 count = hashed ? _get_hashed_index_header(self)->ofs : self->index_size;
+  guint32 capacity = hashed ? _get_hashed_index_capacity(self) : 0;
+
+  if ((count + 1) * 4 > capacity * 3)
+    {
+      guint32 new_capacity = _calculate_hashed_index_capacity(count + 1,
+                                                              capacity ? capacity * 2 : NV_TABLE_HASHED_INDEX_THRESHOLD * 2);
+
+      if (new_capacity + 1 > G_MAXUINT16)
+        {
+          /* index_size is 16 bits, we can't grow any further, but we
+           * still need to keep an empty slot around */
+          if (!hashed || count + 1 >= capacity)
+            return FALSE;
+        }
+      else
+        {
+          if (!_rehash_index(self, new_capacity))
+            return FALSE;
+          _find_hashed_index_entry(self, handle, &index_slot);
+        }
+    }
+
+  *index_entry = index_slot;
+  (*index_entry)->handle = handle;
+  (*index_entry)->ofs = 0;
+  _get_hashed_index_header(self)->ofs++;
+  return TRUE;
+}
+
 /* slow path for nv_table_get_entry(), i.e.  we need to perform the lookup
- * for handle in the sorted index_table by implementing a binary search.
+ * for handle in the sorted index_table by implementing a binary search, or
+ * in the hashed index.
  *
  * The two output arguments `index_entry` and `index_slot` deserve further
  * explanation:
@@ -297,7 +467,10 @@ _find_index_entry(NVIndexEntry *index_table, gint index_size, NVHandle handle, N
 NVEntry *
 nv_table_get_entry_slow(NVTable *self, NVHandle handle, NVIndexEntry **index_entry, NVIndexEntry **index_slot)
 {
-  *index_entry = _find_index_entry(nv_table_get_index(self), self->index_size, handle, index_slot);
+  if (nv_table_is_index_hashed(self))
+    *index_entry = _find_hashed_index_entry(self, handle, index_slot);
+  else
+    *index_entry = _find_index_entry(nv_table_get_index(self), self->index_size, handle, index_slot);
   if (*index_entry)
     return nv_table_get_entry_at_ofs(self, (*index_entry)->ofs);
   return NULL;
@@ -311,6 +484,9 @@ _alloc_index_entry(NVTable *self, NVHandle handle, NVIndexEntry **index_entry, N
       /* this is a dynamic value */
       NVIndexEntry *index_table = nv_table_get_index(self);
 
+      if (nv_table_is_index_hashed(self) || self->index_size >= NV_TABLE_HASHED_INDEX_THRESHOLD)
+        return _alloc_hashed_index_entry(self, handle, index_entry, index_slot);
+
       if (!nv_table_alloc_check(self, sizeof(index_table[0])))
         return FALSE;
 
@@ -354,7 +530,7 @@ _make_entry_direct(NVHandle handle, NVEntry *entry, NVIndexEntry *index_entry, g
   NVTable *self = (NVTable *) (((gpointer *) user_data)[0]);
   NVHandle ref_handle = GPOINTER_TO_UINT(((gpointer *) user_data)[1]);
 
-  if (entry->indirect && entry->vindirect.handle == ref_handle)
+  if (entry->indirect && !entry->borrowed && entry->vindirect.handle == ref_handle)
     {
       const gchar *value;
       gssize value_len;
@@ -390,9 +566,24 @@ nv_table_break_references_to_entry(NVTable *self, NVHandle handle, NVEntry *entr
   return TRUE;
 }
 
+static inline gsize
+_get_direct_entry_size(gsize name_len, gsize value_len, const NVNumericValue *number)
+{
+  return NV_ENTRY_DIRECT_SIZE(name_len, value_len) + (number ? NV_ENTRY_NUMBER_SIZE : 0);
+}
+
+static inline void
+_set_entry_number(NVEntry *entry, const NVNumericValue *number)
+{
+  entry->number_present = !!number;
+  if (number)
+    memcpy(((gchar *) entry) + NV_ENTRY_DIRECT_SIZE(entry->name_len, entry->vdirect.value_len),
+           number, sizeof(*number));
+}
+
 static inline void
 _overwrite_with_a_direct_entry(NVTable *self, NVHandle handle, NVEntry *entry, const gchar *name, gsize name_len,
-                               const gchar *value, gsize value_len, NVType type)
+                               const gchar *value, gsize value_len, NVType type, const NVNumericValue *number)
 {
   gchar *dst;
 
@@ -409,6 +600,8 @@ _overwrite_with_a_direct_entry(NVTable *self, NVHandle handle, NVEntry *entry, c
     {
       /* this was an indirect entry, convert it */
       entry->indirect = 0;
+      entry->borrowed = 0;
+      entry->interned = 0;
       entry->vdirect.value_len = value_len;
 
       if (!nv_table_is_handle_static(self, handle))
@@ -428,14 +621,15 @@ _overwrite_with_a_direct_entry(NVTable *self, NVHandle handle, NVEntry *entry, c
     }
   entry->unset = FALSE;
   entry->type = type;
+  _set_entry_number(entry, number);
 }
 
-gboolean
-nv_table_add_value(NVTable *self, NVHandle handle,
-                   const gchar *name, gsize name_len,
-                   const gchar *value, gsize value_len,
-                   NVType type,
-                   gboolean *new_entry)
+static gboolean
+_add_direct_value(NVTable *self, NVHandle handle,
+                  const gchar *name, gsize name_len,
+                  const gchar *value, gsize value_len,
+                  NVType type, const NVNumericValue *number,
+                  gboolean *new_entry)
 {
   NVEntry *entry;
   guint32 ofs;
@@ -449,9 +643,9 @@ nv_table_add_value(NVTable *self, NVHandle handle,
   if (!nv_table_break_references_to_entry(self, handle, entry))
     return FALSE;
 
-  if (entry && entry->alloc_len >= NV_ENTRY_DIRECT_SIZE(entry->name_len, value_len))
+  if (entry && entry->alloc_len >= _get_direct_entry_size(entry->name_len, value_len, number))
     {
-      _overwrite_with_a_direct_entry(self, handle, entry, name, name_len, value, value_len, type);
+      _overwrite_with_a_direct_entry(self, handle, entry, name, name_len, value, value_len, type, number);
       return TRUE;
     }
   else if (!entry && new_entry)
@@ -465,7 +659,7 @@ nv_table_add_value(NVTable *self, NVHandle handle,
   if (nv_table_is_handle_static(self, handle))
     name_len = 0;
 
-  entry = nv_table_alloc_value(self, NV_ENTRY_DIRECT_SIZE(name_len, value_len));
+  entry = nv_table_alloc_value(self, _get_direct_entry_size(name_len, value_len, number));
   if (G_UNLIKELY(!entry))
     {
       return FALSE;
@@ -482,11 +676,34 @@ nv_table_add_value(NVTable *self, NVHandle handle,
     }
   memmove(entry->vdirect.data + entry->name_len + 1, value, value_len);
   entry->vdirect.data[entry->name_len + 1 + value_len] = 0;
+  _set_entry_number(entry, number);
 
   nv_table_set_table_entry(self, handle, ofs, index_entry);
   return TRUE;
 }
 
+gboolean
+nv_table_add_value(NVTable *self, NVHandle handle,
+                   const gchar *name, gsize name_len,
+                   const gchar *value, gsize value_len,
+                   NVType type,
+                   gboolean *new_entry)
+{
+  return _add_direct_value(self, handle, name, name_len, value, value_len, type, NULL, new_entry);
+}
+
+/* the number is stored next to the value, it must be the binary form of
+ * the string, as parsing the string would produce it */
+gboolean
+nv_table_add_value_with_number(NVTable *self, NVHandle handle,
+                               const gchar *name, gsize name_len,
+                               const gchar *value, gsize value_len,
+                               NVType type, const NVNumericValue *number,
+                               gboolean *new_entry)
+{
+  return _add_direct_value(self, handle, name, name_len, value, value_len, type, number, new_entry);
+}
+
 gboolean
 nv_table_unset_value(NVTable *self, NVHandle handle)
 {
@@ -500,12 +717,20 @@ nv_table_unset_value(NVTable *self, NVHandle handle)
     return FALSE;
 
   entry->unset = TRUE;
+  entry->number_present = FALSE;
 
   /* make sure the actual value is also set to the null_string just in case
    * this message is serialized and then deserialized by an earlier
    * syslog-ng version which does not support the unset flag */
   if (entry->indirect)
     {
+      if (entry->borrowed)
+        {
+          /* the handle/ofs pair holds a pointer, don't leave half of it here */
+          entry->borrowed = 0;
+          entry->interned = 0;
+          entry->vindirect.handle = 0;
+        }
       entry->vindirect.ofs = 0;
       entry->vindirect.len = 0;
     }
@@ -518,21 +743,14 @@ nv_table_unset_value(NVTable *self, NVHandle handle)
 }
 
 static void
-nv_table_set_indirect_entry(NVTable *self, NVHandle handle, NVEntry *entry, const gchar *name, gsize name_len,
-                            const NVReferencedSlice *referenced_slice, NVType type)
+_convert_to_an_indirect_entry(NVTable *self, NVHandle handle, NVEntry *entry, const gchar *name, gsize name_len)
 {
-  entry->vindirect.handle = referenced_slice->handle;
-  entry->vindirect.ofs = referenced_slice->ofs;
-  entry->vindirect.len = referenced_slice->len;
-  entry->vindirect.__deprecated_type_field = 0;
-  entry->type = type;
-  entry->unset = FALSE;
-
   if (entry->indirect)
     return;
 
   /* previously a non-indirect entry, convert it */
   entry->indirect = 1;
+  entry->number_present = 0;
 
   if (!nv_table_is_handle_static(self, handle))
     {
@@ -545,6 +763,37 @@ nv_table_set_indirect_entry(NVTable *self, NVHandle handle, NVEntry *entry, cons
     }
 }
 
+static void
+nv_table_set_indirect_entry(NVTable *self, NVHandle handle, NVEntry *entry, const gchar *name, gsize name_len,
+                            const NVReferencedSlice *referenced_slice, NVType type)
+{
+  _convert_to_an_indirect_entry(self, handle, entry, name, name_len);
+
+  entry->borrowed = 0;
+  entry->interned = 0;
+  entry->vindirect.handle = referenced_slice->handle;
+  entry->vindirect.ofs = referenced_slice->ofs;
+  entry->vindirect.len = referenced_slice->len;
+  entry->vindirect.__deprecated_type_field = 0;
+  entry->type = type;
+  entry->unset = FALSE;
+}
+
+static void
+nv_table_set_borrowed_entry(NVTable *self, NVHandle handle, NVEntry *entry, const gchar *name, gsize name_len,
+                            const gchar *value, gsize value_len, NVType type, gboolean interned)
+{
+  _convert_to_an_indirect_entry(self, handle, entry, name, name_len);
+
+  entry->borrowed = 1;
+  entry->interned = interned;
+  nv_entry_set_borrowed_value(entry, value);
+  entry->vindirect.len = value_len;
+  entry->vindirect.__deprecated_type_field = 0;
+  entry->type = type;
+  entry->unset = FALSE;
+}
+
 static gboolean
 nv_table_copy_referenced_value(NVTable *self, NVEntry *ref_entry, NVHandle handle, const gchar *name,
                                gsize name_len, NVReferencedSlice *ref_slice, NVType type, gboolean *new_entry)
@@ -629,6 +878,83 @@ nv_table_add_value_indirect(NVTable *self, NVHandle handle, const gchar *name, g
   return TRUE;
 }
 
+/*
+ * nv_table_add_value_borrowed:
+ *
+ * Store a value that is not copied into the NVTable, rather it points to
+ * memory owned by someone else (e.g.  the buffer the message was received
+ * into).  The caller must ensure that this memory is immutable and
+ * outlives the NVTable and all of its clones, and that the NVTable is
+ * compacted (see nv_table_compact()) before it is serialized.
+ *
+ * Borrowed values are not NUL terminated and are resolved just like
+ * indirect ones, so the same restrictions apply to handles.
+ */
+static gboolean
+_add_borrowed_value(NVTable *self, NVHandle handle, const gchar *name, gsize name_len,
+                    const gchar *value, gsize value_len, NVType type, gboolean interned, gboolean *new_entry)
+{
+  NVEntry *entry;
+  NVIndexEntry *index_entry, *index_slot;
+  guint32 ofs;
+
+  if (value_len > NV_TABLE_MAX_BYTES)
+    value_len = NV_TABLE_MAX_BYTES;
+  if (new_entry)
+    *new_entry = FALSE;
+  if (nv_table_is_handle_static(self, handle))
+    name_len = 0;
+
+  entry = nv_table_get_entry(self, handle, &index_entry, &index_slot);
+  if (!nv_table_break_references_to_entry(self, handle, entry))
+    return FALSE;
+
+  if (entry && (entry->alloc_len >= NV_ENTRY_INDIRECT_SIZE(name_len)))
+    {
+      nv_table_set_borrowed_entry(self, handle, entry, name, name_len, value, value_len, type, interned);
+      return TRUE;
+    }
+  else if (!entry && new_entry)
+    {
+      *new_entry = TRUE;
+    }
+
+  if (!_alloc_index_entry(self, handle, &index_entry, index_slot))
+    return FALSE;
+  entry = nv_table_alloc_value(self, NV_ENTRY_INDIRECT_SIZE(name_len));
+  if (!entry)
+    return FALSE;
+
+  ofs = nv_table_get_ofs_for_an_entry(self, entry);
+  nv_table_set_borrowed_entry(self, handle, entry, name, name_len, value, value_len, type, interned);
+  nv_table_set_table_entry(self, handle, ofs, index_entry);
+  return TRUE;
+}
+
+gboolean
+nv_table_add_value_borrowed(NVTable *self, NVHandle handle, const gchar *name, gsize name_len,
+                            const gchar *value, gsize value_len, NVType type, gboolean *new_entry)
+{
+  return _add_borrowed_value(self, handle, name, name_len, value, value_len, type, FALSE, new_entry);
+}
+
+/*
+ * nv_table_add_value_interned:
+ *
+ * Store a reference to a string of the string intern table (see
+ * string_intern_lookup()), which is NUL terminated and outlives every
+ * NVTable.  Unlike other borrowed values these can be used with static
+ * handles as well.  The NVTable must be compacted before serialization,
+ * just like with other borrowed values.
+ */
+gboolean
+nv_table_add_value_interned(NVTable *self, NVHandle handle, const gchar *name, gsize name_len,
+                            const gchar *value, gsize value_len, NVType type, gboolean *new_entry)
+{
+  g_assert(value[value_len] == 0);
+  return _add_borrowed_value(self, handle, name, name_len, value, value_len, type, TRUE, new_entry);
+}
+
 static gboolean
 nv_table_call_foreach(NVHandle handle, NVEntry *entry, NVIndexEntry *index_entry, gpointer user_data)
 {
@@ -673,7 +999,9 @@ nv_table_foreach_entry(NVTable *self, NVTableForeachEntryFunc func, gpointer use
     }
 
   index_table = nv_table_get_index(self);
-  for (i = 0; i < self->index_size; i++)
+
+  /* skip the header of a hashed index, empty slots have a zero offset */
+  for (i = nv_table_is_index_hashed(self) ? 1 : 0; i < self->index_size; i++)
     {
       entry = nv_table_get_entry_at_ofs(self, index_table[i].ofs);
 
@@ -707,7 +1035,7 @@ nv_table_new(gint num_static_entries, gint index_size_hint, gint init_length)
   gsize alloc_length;
 
   alloc_length = nv_table_get_alloc_size(num_static_entries, index_size_hint, init_length);
-  self = (NVTable *) g_malloc(alloc_length);
+  self = (NVTable *) log_msg_pool_alloc(alloc_length);
 
   nv_table_init(self, alloc_length, num_static_entries);
   return self;
@@ -751,7 +1079,7 @@ nv_table_realloc(NVTable *self, NVTable **new_nv_table)
     }
   else
     {
-      *new_nv_table = g_malloc(new_size);
+      *new_nv_table = log_msg_pool_alloc(new_size);
 
       /* we only copy the header first */
       memcpy(*new_nv_table, self, sizeof(NVTable) + self->num_static_entries * sizeof(self->static_entries[0]) +
@@ -781,7 +1109,9 @@ nv_table_unref(NVTable *self)
 {
   if ((--self->ref_cnt == 0) && !self->borrowed)
     {
-      g_free(self);
+      /* NOTE: self->size is always the size of the allocation for
+       * non-borrowed NVTable instances */
+      log_msg_pool_free(self, self->size);
     }
 }
 
@@ -806,7 +1136,7 @@ nv_table_clone(NVTable *self, gint additional_space)
   if (new_size > NV_TABLE_MAX_BYTES)
     new_size = NV_TABLE_MAX_BYTES;
 
-  new = g_malloc(new_size);
+  new = log_msg_pool_alloc(new_size);
   memcpy(new, self, sizeof(NVTable) + self->num_static_entries * sizeof(self->static_entries[0]) + self->index_size *
          sizeof(NVIndexEntry));
   new->size = new_size;
@@ -848,9 +1178,11 @@ _compact_foreach_entry(NVHandle handle, NVEntry *entry, NVIndexEntry *index_entr
       name_len = 0;
     }
 
-  if (!entry->indirect)
+  if (!entry->indirect || entry->borrowed)
     {
-      value = nv_table_resolve_direct(old, entry, &value_len);
+      /* borrowed values are copied, the compacted NVTable is
+       * self-contained */
+      value = nv_table_resolve_entry(old, entry, &value_len, NULL);
 
       gboolean value_successfully_added =
         nv_table_add_value(new, handle,
@@ -878,11 +1210,34 @@ _compact_foreach_entry(NVHandle handle, NVEntry *entry, NVIndexEntry *index_entr
   return FALSE;
 }
 
+static gboolean
+_calculate_borrowed_size(NVHandle handle, NVEntry *entry, NVIndexEntry *index_entry, gpointer user_data)
+{
+  gsize *borrowed_size = (gsize *) user_data;
+
+  if (entry->borrowed && !entry->unset)
+    *borrowed_size += NV_TABLE_BOUND(NV_ENTRY_DIRECT_SIZE(entry->name_len, entry->vindirect.len));
+  return FALSE;
+}
+
 NVTable *
 nv_table_compact(NVTable *self)
 {
-  gint new_size = self->size;
-  NVTable *new = g_malloc(new_size);
+  gsize new_size = self->size;
+
+  /* borrowed values become direct values, make room for them */
+  nv_table_foreach_entry(self, _calculate_borrowed_size, &new_size);
+
+  /* the index of the compacted NVTable may become hashed, even if ours
+   * is not (e.g.  we were deserialized) */
+  if (!nv_table_is_index_hashed(self) && self->index_size >= NV_TABLE_HASHED_INDEX_THRESHOLD)
+    new_size += (_calculate_hashed_index_capacity(self->index_size, NV_TABLE_HASHED_INDEX_THRESHOLD * 2) + 1) *
+                sizeof(NVIndexEntry);
+
+  if (new_size > NV_TABLE_MAX_BYTES)
+    new_size = NV_TABLE_MAX_BYTES;
+
+  NVTable *new = log_msg_pool_alloc(new_size);
   gpointer args[2] = { self, new };
 
   nv_table_init(new, new_size, self->num_static_entries);
@@ -890,3 +1245,56 @@ nv_table_compact(NVTable *self)
   nv_table_foreach_entry(self, _compact_foreach_entry, args);
   return new;
 }
+
+static gboolean
+_flatten_foreach_entry(NVHandle handle, NVEntry *entry, NVIndexEntry *index_entry, gpointer user_data)
+{
+  gpointer *args = (gpointer *) user_data;
+  NVTable *overlay = (NVTable *) args[0];
+  NVTable **flat = (NVTable **) args[1];
+  const gchar *value;
+  gssize value_len;
+  NVType type;
+
+  if (entry->unset)
+    {
+      while (!nv_table_unset_value(*flat, handle))
+        {
+          if (!nv_table_realloc(*flat, flat))
+            break;
+        }
+      return FALSE;
+    }
+
+  value = nv_table_resolve_entry(overlay, entry, &value_len, &type);
+  while (!nv_table_add_value(*flat, handle, nv_entry_get_name(entry), entry->name_len, value, value_len, type, NULL))
+    {
+      if (!nv_table_realloc(*flat, flat))
+        {
+          msg_info("Cannot store value while flattening the payload, maximum size has been reached",
+                   evt_tag_int("maximum_payload", NV_TABLE_MAX_BYTES),
+                   evt_tag_str("name", nv_entry_get_name(entry)));
+          break;
+        }
+    }
+  return FALSE;
+}
+
+/*
+ * nv_table_flatten_overlay:
+ * @self: the overlay NVTable
+ * @parent: the NVTable the overlay is on top of
+ * @additional_space: additional space needed in the result
+ *
+ * Returns a new NVTable that contains the values of @parent, changed by the
+ * values (and unsets) stored in @self.  Both NVTables are left intact.
+ */
+NVTable *
+nv_table_flatten_overlay(NVTable *self, NVTable *parent, gint additional_space)
+{
+  NVTable *flat = nv_table_clone(parent, self->used + NV_TABLE_BOUND(additional_space));
+  gpointer args[2] = { self, &flat };
+
+  nv_table_foreach_entry(self, _flatten_foreach_entry, args);
+  return flat;
+}
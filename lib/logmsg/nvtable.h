@@ -28,6 +28,8 @@
 #include "syslog-ng.h"
 #include "nvhandle-descriptors.h"
 
+#include <string.h>
+
 typedef struct _NVTable NVTable;
 typedef struct _NVRegistry NVRegistry;
 typedef struct _NVIndexEntry NVIndexEntry;
@@ -141,12 +143,26 @@ struct _NVEntry
        * NVENTRY_FLAGS_DEFINED_IN_LEGACY_FORMATS as a bitmask to mask out
        * "indirect" and "referenced" in the "flags" member below, which is
        * unioned on the bitfield.
+       *
+       * "borrowed" entries are indirect entries that point to memory
+       * outside of the NVTable (see nv_table_add_value_borrowed()), they
+       * are never serialized.
+       *
+       * "number_present" direct entries carry the binary form of their
+       * numeric value after the string (see nv_table_add_value_with_number()).
+       *
+       * "interned" entries are borrowed entries pointing to a NUL
+       * terminated string in the string intern table (see
+       * nv_table_add_value_interned()).
        */
       guint8 indirect:1,
              referenced:1,
              unset:1,
              type_present:1,
-             __bit_padding:4;
+             borrowed:1,
+             number_present:1,
+             interned:1,
+             __bit_padding:1;
     };
     guint8 flags;
   };
@@ -204,6 +220,51 @@ nv_entry_get_name(NVEntry *self)
     return self->vdirect.data;
 }
 
+/* The binary form of a numeric value, which is interpreted according to the
+ * type of the entry: int64 for integers (and booleans, 0 or 1), double for
+ * doubles.  It is a cache of the string value, consumers that need a number
+ * can use it instead of parsing the string again.  As NVEntry instances are
+ * only aligned to 4 bytes, it is stored with memcpy(). */
+typedef union _NVNumericValue
+{
+  gint64 as_int64;
+  gdouble as_double;
+} NVNumericValue;
+
+G_STATIC_ASSERT(sizeof(NVNumericValue) == 8);
+
+#define NV_ENTRY_NUMBER_SIZE (sizeof(NVNumericValue))
+
+static inline gboolean
+nv_entry_get_number(NVEntry *self, NVNumericValue *number)
+{
+  if (!self->number_present || self->indirect || self->unset)
+    return FALSE;
+
+  memcpy(number, ((gchar *) self) + NV_ENTRY_DIRECT_SIZE(self->name_len, self->vdirect.value_len), sizeof(*number));
+  return TRUE;
+}
+
+/* borrowed entries store the address of their value in place of the
+ * handle/ofs pair of the indirect entry, NVEntry instances are only
+ * aligned to 4 bytes, thus the memcpy() */
+G_STATIC_ASSERT(sizeof(const gchar *) <= sizeof(NVHandle) + sizeof(guint32));
+
+static inline const gchar *
+nv_entry_get_borrowed_value(NVEntry *self)
+{
+  const gchar *value;
+
+  memcpy(&value, &self->vindirect.handle, sizeof(value));
+  return value;
+}
+
+static inline void
+nv_entry_set_borrowed_value(NVEntry *self, const gchar *value)
+{
+  memcpy(&self->vindirect.handle, &value, sizeof(value));
+}
+
 /*
  * Contains a set of ordered name-value pairs.
  *
@@ -230,6 +291,14 @@ nv_entry_get_name(NVEntry *self)
  * Dynamic values:
  *   - a dynamically sized NVIndexEntry array (contains ID + offset)
  *   - dynamic values are sorted by the global ID to make handle->entry lookups fast
+ *   - once the number of dynamic values reaches
+ *     NV_TABLE_HASHED_INDEX_THRESHOLD, the array is converted into an
+ *     open-addressing hash table keyed by the ID, to avoid the memmove()
+ *     on inserts and the binary search on lookups.  The first element of
+ *     a hashed index is a header (ID == 0, offset == number of elements),
+ *     followed by a power of 2 number of slots, an empty slot has an ID
+ *     of 0.  The hashed layout is only used in memory, it is written out
+ *     as a sorted array by the serialization code.
  *
  * Memory allocation
  * =================
@@ -295,15 +364,31 @@ struct _NVTable
  * static values */
 #define NV_TABLE_MIN_BYTES  128
 
+/* number of dynamic values where we switch to a hashed index */
+#define NV_TABLE_HASHED_INDEX_THRESHOLD  32
+
 gboolean nv_table_add_value(NVTable *self, NVHandle handle,
                             const gchar *name, gsize name_len,
                             const gchar *value, gsize value_len,
                             NVType type, gboolean *new_entry);
+gboolean nv_table_add_value_with_number(NVTable *self, NVHandle handle,
+                                        const gchar *name, gsize name_len,
+                                        const gchar *value, gsize value_len,
+                                        NVType type, const NVNumericValue *number,
+                                        gboolean *new_entry);
 gboolean nv_table_unset_value(NVTable *self, NVHandle handle);
 gboolean nv_table_add_value_indirect(NVTable *self, NVHandle handle,
                                      const gchar *name, gsize name_len,
                                      NVReferencedSlice *referenced_slice,
                                      NVType type, gboolean *new_entry);
+gboolean nv_table_add_value_borrowed(NVTable *self, NVHandle handle,
+                                     const gchar *name, gsize name_len,
+                                     const gchar *value, gsize value_len,
+                                     NVType type, gboolean *new_entry);
+gboolean nv_table_add_value_interned(NVTable *self, NVHandle handle,
+                                     const gchar *name, gsize name_len,
+                                     const gchar *value, gsize value_len,
+                                     NVType type, gboolean *new_entry);
 
 gboolean nv_table_foreach(NVTable *self, NVRegistry *registry, NVTableForeachFunc func, gpointer user_data);
 gboolean nv_table_foreach_entry(NVTable *self, NVTableForeachEntryFunc func, gpointer user_data);
@@ -312,9 +397,11 @@ NVTable *nv_table_new(gint num_static_values, gint index_size_hint, gint init_le
 NVTable *nv_table_init_borrowed(gpointer space, gsize space_len, gint num_static_entries);
 gboolean nv_table_realloc(NVTable *self, NVTable **new_nv_table);
 NVTable *nv_table_compact(NVTable *self);
+NVTable *nv_table_flatten_overlay(NVTable *self, NVTable *parent, gint additional_space);
 NVTable *nv_table_clone(NVTable *self, gint additional_space);
 NVTable *nv_table_ref(NVTable *self);
 void nv_table_unref(NVTable *self);
+guint16 nv_table_get_sorted_index(NVTable *self, NVIndexEntry *sorted_index);
 
 static inline gboolean
 nv_table_is_handle_static(NVTable *self, NVHandle handle)
@@ -439,12 +526,28 @@ nv_table_get_value(NVTable *self, NVHandle handle, gssize *length, NVType *type)
   return nv_table_resolve_indirect(self, entry, length);
 }
 
+static inline gboolean
+nv_table_get_value_number(NVTable *self, NVHandle handle, NVNumericValue *number)
+{
+  NVEntry *entry = nv_table_get_entry(self, handle, NULL, NULL);
+
+  return entry && nv_entry_get_number(entry, number);
+}
+
 static inline NVIndexEntry *
 nv_table_get_index(NVTable *self)
 {
   return (NVIndexEntry *)&self->static_entries[self->num_static_entries];
 }
 
+static inline gboolean
+nv_table_is_index_hashed(NVTable *self)
+{
+  /* handle 0 is never stored in a sorted index, it marks the header of a
+   * hashed one */
+  return self->index_size > 0 && nv_table_get_index(self)[0].handle == 0;
+}
+
 static inline NVEntry *
 nv_table_get_entry_at_ofs(NVTable *self, guint32 ofs)
 {
@@ -459,6 +562,13 @@ nv_table_get_ofs_for_an_entry(NVTable *self, NVEntry *entry)
   return (nv_table_get_top(self) - (gchar *) entry);
 }
 
+/* number of bytes still available between the index and the payload area */
+static inline gsize
+nv_table_get_slack(NVTable *self)
+{
+  return nv_table_get_bottom(self) - nv_table_get_ofs_table_top(self);
+}
+
 static inline gssize
 nv_table_get_memory_consumption(NVTable *self)
 {
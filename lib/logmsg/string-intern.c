@@ -0,0 +1,153 @@
+/*
+ * Copyright (c) 2024 One Identity LLC.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+
+#include "logmsg/string-intern.h"
+#include "str-utils.h"
+#include "tls-support.h"
+
+#include <string.h>
+
+#define STRING_INTERN_SHARDS 16
+#define STRING_INTERN_CACHE_SIZE 256
+
+typedef struct _StringInternShard
+{
+  GMutex lock;
+  GHashTable *strings;
+} StringInternShard;
+
+static StringInternShard string_intern_shards[STRING_INTERN_SHARDS];
+static gint string_intern_count;
+/* bumped whenever the table is destroyed, invalidating the per-thread caches */
+static gint string_intern_generation;
+
+typedef struct _StringInternCacheEntry
+{
+  guint hash;
+  gsize len;
+  const gchar *interned;
+} StringInternCacheEntry;
+
+/*
+ * The values repeat a lot (the same few hosts and programs), so each
+ * thread keeps the strings it looked up in a small direct mapped cache,
+ * and only goes to the shared table (and its lock) on a miss.  Interned
+ * strings are never freed while the table exists, so the cached pointers
+ * stay valid.
+ */
+TLS_BLOCK_START
+{
+  gint string_intern_cache_generation;
+  StringInternCacheEntry string_intern_cache[STRING_INTERN_CACHE_SIZE];
+}
+TLS_BLOCK_END;
+
+#define string_intern_cache_generation  __tls_deref(string_intern_cache_generation)
+#define string_intern_cache             __tls_deref(string_intern_cache)
+
+static StringInternCacheEntry *
+_get_cache_entry(guint hash)
+{
+  gint generation = g_atomic_int_get(&string_intern_generation);
+
+  if (G_UNLIKELY(string_intern_cache_generation != generation))
+    {
+      memset(string_intern_cache, 0, sizeof(string_intern_cache));
+      string_intern_cache_generation = generation;
+    }
+
+  return &string_intern_cache[hash % STRING_INTERN_CACHE_SIZE];
+}
+
+static const gchar *
+_lookup_shared(const gchar *value, gsize value_len, guint hash)
+{
+  StringInternShard *shard = &string_intern_shards[hash % STRING_INTERN_SHARDS];
+  gchar *interned;
+
+  g_mutex_lock(&shard->lock);
+  interned = g_hash_table_lookup(shard->strings, value);
+  /* the limit is checked without a global lock, it may be exceeded by a
+   * few entries racing in different shards */
+  if (!interned && g_atomic_int_get(&string_intern_count) < STRING_INTERN_MAX_ENTRIES)
+    {
+      interned = g_strndup(value, value_len);
+      g_hash_table_add(shard->strings, interned);
+      g_atomic_int_inc(&string_intern_count);
+    }
+  g_mutex_unlock(&shard->lock);
+
+  return interned;
+}
+
+/* returns a NUL terminated copy of @value that remains valid until
+ * string_intern_global_deinit(), or NULL if @value is not worth interning
+ * or the table is full */
+const gchar *
+string_intern_lookup(const gchar *value, gsize value_len)
+{
+  if (value_len < STRING_INTERN_MIN_LENGTH || value_len > STRING_INTERN_MAX_LENGTH)
+    return NULL;
+
+  APPEND_ZERO(value, value, value_len);
+  guint hash = g_str_hash(value);
+  StringInternCacheEntry *entry = _get_cache_entry(hash);
+
+  if (entry->interned && entry->hash == hash && entry->len == value_len &&
+      memcmp(entry->interned, value, value_len) == 0)
+    return entry->interned;
+
+  const gchar *interned = _lookup_shared(value, value_len, hash);
+  if (interned)
+    {
+      entry->hash = hash;
+      entry->len = value_len;
+      entry->interned = interned;
+    }
+
+  return interned;
+}
+
+void
+string_intern_global_init(void)
+{
+  for (gint i = 0; i < STRING_INTERN_SHARDS; i++)
+    {
+      g_mutex_init(&string_intern_shards[i].lock);
+      string_intern_shards[i].strings = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+    }
+  string_intern_count = 0;
+}
+
+void
+string_intern_global_deinit(void)
+{
+  g_atomic_int_inc(&string_intern_generation);
+  for (gint i = 0; i < STRING_INTERN_SHARDS; i++)
+    {
+      g_hash_table_unref(string_intern_shards[i].strings);
+      string_intern_shards[i].strings = NULL;
+      g_mutex_clear(&string_intern_shards[i].lock);
+    }
+}
@@ -0,0 +1,55 @@
+/*
+ * Copyright (c) 2024 One Identity LLC.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+
+#ifndef LOGMSG_STRING_INTERN_H_INCLUDED
+#define LOGMSG_STRING_INTERN_H_INCLUDED
+
+#include "syslog-ng.h"
+
+/* values shorter than this are cheaper to store inline than as a reference */
+#define STRING_INTERN_MIN_LENGTH 16
+#define STRING_INTERN_MAX_LENGTH 255
+#define STRING_INTERN_MAX_ENTRIES 16384
+
+/*
+ * A process wide table of immutable strings for low-cardinality values
+ * (e.g.  $HOST or $PROGRAM), that are referenced from NVTables instead of
+ * being copied into each message.
+ *
+ * Interned strings are never freed while syslog-ng is running, thus
+ * references to them need no reference counting.  For the same reason
+ * the table is not emptied on reload either (queued messages may still
+ * refer to its strings): the first STRING_INTERN_MAX_ENTRIES distinct
+ * values stay interned for the lifetime of the process, later values are
+ * stored inline in the messages, which is correct, just not deduplicated.
+ *
+ * Lookups of values the current thread has already seen do not take any
+ * locks.
+ */
+const gchar *string_intern_lookup(const gchar *value, gsize value_len);
+
+void string_intern_global_init(void);
+void string_intern_global_deinit(void);
+
+#endif
@@ -29,6 +29,8 @@
 #include "logpipe.h"
 #include "scratch-buffers.h"
 #include "rcptid.h"
+#include "logmsg/logmsg-trace.h"
+#include "logmsg/string-intern.h"
 
 typedef struct _LogMessageTestParams
 {
@@ -930,3 +932,209 @@ Test(log_message, test_cow_unset_value)
   log_msg_unref(orig_msg);
   log_msg_unref(msg);
 }
+
+Test(log_message, test_borrowed_value_is_shared_with_cow_clones)
+{
+  LogMessage *msg = _construct_log_message();
+  GBytes *input_chunk = g_bytes_new("borrowed-value", 14);
+  const gchar *input = g_bytes_get_data(input_chunk, NULL);
+
+  log_msg_set_input_chunk(msg, input_chunk);
+  g_bytes_unref(input_chunk);
+  log_msg_set_value_borrowed(msg, log_msg_get_value_handle("borrowed"), input + 9, 5);
+
+  LogPathOptions path_options = LOG_PATH_OPTIONS_INIT;
+  LogMessage *cloned = log_msg_clone_cow(msg, &path_options);
+  log_msg_unref(msg);
+
+  gssize value_len;
+  const gchar *value = log_msg_get_value_by_name(cloned, "borrowed", &value_len);
+  cr_assert_eq(value, input + 9);
+  cr_assert_eq(value_len, 5);
+
+  log_msg_set_value_by_name(cloned, "cloned_name", "cloned_value", -1);
+  value = log_msg_get_value_by_name(cloned, "borrowed", &value_len);
+  cr_assert(strncmp(value, "value", value_len) == 0);
+  cr_assert_eq(value_len, 5);
+
+  log_msg_unref(cloned);
+}
+
+Test(log_message, test_low_cardinality_values_are_interned)
+{
+  LogMessage *msg = log_msg_new_empty();
+  LogMessage *other = log_msg_new_empty();
+
+  log_msg_set_value(msg, LM_V_HOST, "host.with.a.long.name", -1);
+  log_msg_set_value(other, LM_V_HOST, "host.with.a.long.name", -1);
+
+  const gchar *value = log_msg_get_value(msg, LM_V_HOST, NULL);
+  cr_assert_str_eq(value, "host.with.a.long.name");
+  cr_assert_eq(value, log_msg_get_value(other, LM_V_HOST, NULL), "interned values should be shared");
+
+  /* short values are stored inline */
+  log_msg_set_value(msg, LM_V_PROGRAM, "prg", -1);
+  log_msg_set_value(other, LM_V_PROGRAM, "prg", -1);
+  cr_assert_neq(log_msg_get_value(msg, LM_V_PROGRAM, NULL), log_msg_get_value(other, LM_V_PROGRAM, NULL));
+
+  log_msg_set_value(msg, LM_V_HOST, "short", -1);
+  assert_log_message_value(msg, LM_V_HOST, "short");
+  assert_log_message_value(other, LM_V_HOST, "host.with.a.long.name");
+
+  log_msg_unref(msg);
+  log_msg_unref(other);
+}
+
+static gpointer
+_intern_in_thread(gpointer value)
+{
+  return (gpointer) string_intern_lookup(value, strlen(value));
+}
+
+Test(log_message, test_interned_values_are_shared_between_threads)
+{
+  const gchar *value = "program.with.a.long.name";
+  const gchar *interned = string_intern_lookup(value, strlen(value));
+
+  cr_assert_str_eq(interned, value);
+  /* served from the cache of the current thread */
+  cr_assert_eq(string_intern_lookup(value, strlen(value)), interned);
+
+  GThread *thread = g_thread_new("intern", _intern_in_thread, (gpointer) value);
+  cr_assert_eq(g_thread_join(thread), interned);
+
+  /* the length is part of the key, a prefix is a different value */
+  const gchar *prefix = string_intern_lookup(value, strlen(value) - 1);
+  cr_assert_neq(prefix, interned);
+  cr_assert_eq(strlen(prefix), strlen(value) - 1);
+}
+
+static LogMessage *
+_construct_log_message_with_large_payload(void)
+{
+  LogMessage *msg = _construct_log_message();
+  gchar name[32];
+
+  for (gint i = 0; i < 64; i++)
+    {
+      g_snprintf(name, sizeof(name), "large_payload_%d", i);
+      log_msg_set_value_by_name(msg, name, "value-of-the-large-payload", -1);
+    }
+  log_msg_set_value_by_name(msg, "orig_name", "orig_value", -1);
+  return msg;
+}
+
+static gboolean
+_count_values(NVHandle handle, const gchar *name, const gchar *value, gssize value_len,
+              LogMessageValueType type, gpointer user_data)
+{
+  gint *count = (gint *) user_data;
+
+  (*count)++;
+  return FALSE;
+}
+
+Test(log_message, test_cow_clone_of_a_large_payload_uses_an_overlay)
+{
+  LogMessage *msg = _construct_log_message_with_large_payload();
+  gint orig_count = 0;
+  log_msg_values_foreach(msg, _count_values, &orig_count);
+
+  LogPathOptions path_options = LOG_PATH_OPTIONS_INIT;
+  LogMessage *cloned = log_msg_clone_cow(msg, &path_options);
+
+  log_msg_set_value_by_name(cloned, "cloned_name", "cloned_value", -1);
+  log_msg_set_value_by_name(cloned, "orig_name", "modified_value", -1);
+  log_msg_unset_value_by_name(cloned, "large_payload_0");
+
+  cr_assert_eq(cloned->payload_parent, msg->payload);
+  cr_assert_lt(cloned->payload->size, msg->payload->size);
+
+  cr_assert_str_eq(log_msg_get_value_by_name(cloned, "cloned_name", NULL), "cloned_value");
+  cr_assert_str_eq(log_msg_get_value_by_name(cloned, "orig_name", NULL), "modified_value");
+  cr_assert_str_eq(log_msg_get_value_by_name(cloned, "large_payload_1", NULL), "value-of-the-large-payload");
+  cr_assert_null(log_msg_get_value_if_set(cloned, log_msg_get_value_handle("large_payload_0"), NULL));
+
+  cr_assert_str_eq(log_msg_get_value_by_name(msg, "orig_name", NULL), "orig_value");
+  cr_assert_str_eq(log_msg_get_value_by_name(msg, "large_payload_0", NULL), "value-of-the-large-payload");
+  cr_assert_null(log_msg_get_value_if_set(msg, log_msg_get_value_handle("cloned_name"), NULL));
+
+  gint cloned_count = 0;
+  log_msg_values_foreach(cloned, _count_values, &cloned_count);
+  cr_assert_eq(cloned_count, orig_count);
+
+  log_msg_unref(cloned);
+  log_msg_unref(msg);
+}
+
+Test(log_message, test_cow_overlay_indirect_values_referencing_the_parent)
+{
+  LogMessage *msg = _construct_log_message_with_large_payload();
+
+  LogPathOptions path_options = LOG_PATH_OPTIONS_INIT;
+  LogMessage *cloned = log_msg_clone_cow(msg, &path_options);
+
+  NVHandle indirect = log_msg_get_value_handle("indirect");
+  log_msg_set_value_indirect(cloned, indirect, log_msg_get_value_handle("orig_name"), 5, 5);
+
+  gssize value_len;
+  const gchar *value = log_msg_get_value(cloned, indirect, &value_len);
+  cr_assert_eq(value_len, 5);
+  cr_assert(strncmp(value, "value", value_len) == 0);
+
+  log_msg_unref(cloned);
+  log_msg_unref(msg);
+}
+
+Test(log_message, test_cow_overlay_is_flattened_by_further_clones)
+{
+  LogMessage *msg = _construct_log_message_with_large_payload();
+
+  LogPathOptions path_options = LOG_PATH_OPTIONS_INIT;
+  LogMessage *cloned = log_msg_clone_cow(msg, &path_options);
+  log_msg_set_value_by_name(cloned, "orig_name", "modified_value", -1);
+  log_msg_unset_value_by_name(cloned, "large_payload_0");
+
+  LogMessage *cloned2 = log_msg_clone_cow(cloned, &path_options);
+  log_msg_set_value_by_name(cloned2, "cloned2_name", "cloned2_value", -1);
+
+  cr_assert_null(cloned2->payload_parent);
+  cr_assert_str_eq(log_msg_get_value_by_name(cloned2, "cloned2_name", NULL), "cloned2_value");
+  cr_assert_str_eq(log_msg_get_value_by_name(cloned2, "orig_name", NULL), "modified_value");
+  cr_assert_str_eq(log_msg_get_value_by_name(cloned2, "large_payload_1", NULL), "value-of-the-large-payload");
+  cr_assert_null(log_msg_get_value_if_set(cloned2, log_msg_get_value_handle("large_payload_0"), NULL));
+  cr_assert_null(log_msg_get_value_if_set(cloned, log_msg_get_value_handle("cloned2_name"), NULL));
+
+  log_msg_unref(cloned2);
+  log_msg_unref(cloned);
+  log_msg_unref(msg);
+}
+
+Test(log_message, test_latency_trace_is_shared_with_cow_clones)
+{
+  LogMessage *msg = _construct_log_message();
+
+  log_msg_trace_stamp(msg, LM_TRACE_QUEUED);
+  cr_assert_null(msg->trace, "messages are not traced unless sampled");
+
+  log_msg_trace_start(msg);
+  cr_assert_gt(msg->trace->stamps[LM_TRACE_POSTED], 0);
+  cr_assert_eq(log_msg_trace_get_duration(msg, LM_TRACE_POSTED, LM_TRACE_ACKED), -1);
+
+  LogPathOptions path_options = LOG_PATH_OPTIONS_INIT;
+  LogMessage *cloned = log_msg_clone_cow(msg, &path_options);
+  cr_assert_eq(cloned->trace, msg->trace);
+
+  log_msg_trace_stamp(cloned, LM_TRACE_QUEUED);
+  gint64 first_queued = msg->trace->stamps[LM_TRACE_QUEUED];
+  log_msg_trace_stamp(msg, LM_TRACE_QUEUED);
+  cr_assert_eq(msg->trace->stamps[LM_TRACE_QUEUED], first_queued, "the first push should be recorded");
+
+  log_msg_trace_stamp(cloned, LM_TRACE_DEQUEUED);
+  log_msg_trace_stamp(msg, LM_TRACE_ACKED);
+  cr_assert_geq(log_msg_trace_get_duration(msg, LM_TRACE_POSTED, LM_TRACE_ACKED),
+                log_msg_trace_get_duration(msg, LM_TRACE_QUEUED, LM_TRACE_DEQUEUED));
+
+  log_msg_unref(cloned);
+  log_msg_unref(msg);
+}
@@ -181,3 +181,42 @@ ParameterizedTest(struct nv_pair *param, msg_ack, test_cloned_clone)
   cr_assert(t->acked);
   ack_record_free(t);
 }
+
+static gint fanout_ack_count;
+static AckType fanout_ack_type;
+
+static void
+_fanout_ack_message(LogMessage *msg, AckType ack_type)
+{
+  fanout_ack_count++;
+  fanout_ack_type = ack_type;
+}
+
+Test(msg_ack, fanned_out_messages_are_acked_once_after_the_last_drop)
+{
+  LogPathOptions path_options = LOG_PATH_OPTIONS_INIT;
+  LogMessage *msg = log_msg_new_empty();
+
+  fanout_ack_count = 0;
+  msg->ack_func = _fanout_ack_message;
+  path_options.ack_needed = TRUE;
+
+  log_msg_add_ack(msg, &path_options);
+  LogMessage *branch1 = log_msg_add_ack_and_ref(msg, &path_options);
+  LogMessage *branch2 = log_msg_add_ack_and_ref(msg, &path_options);
+  cr_assert_eq(branch1, msg);
+  cr_assert_eq(branch2, msg);
+
+  /* keep a ref of our own so that we can check the state after the last drop */
+  log_msg_ref(msg);
+
+  log_msg_drop(branch1, &path_options, AT_PROCESSED);
+  cr_assert_eq(fanout_ack_count, 0);
+  log_msg_drop(branch2, &path_options, AT_ABORTED);
+  cr_assert_eq(fanout_ack_count, 0);
+  log_msg_drop(msg, &path_options, AT_PROCESSED);
+  cr_assert_eq(fanout_ack_count, 1);
+  cr_assert_eq(fanout_ack_type, AT_ABORTED, "the abort flag of an earlier drop is to be propagated");
+
+  log_msg_unref(msg);
+}
@@ -0,0 +1,121 @@
+/*
+ * Copyright (c) 2024 One Identity LLC.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+#include <criterion/criterion.h>
+
+#include "logmsg/logmsg.h"
+#include "logmsg/logmsg-pool.h"
+#include "logpipe.h"
+#include "apphook.h"
+
+Test(log_msg_pool, freed_blocks_are_reused)
+{
+  gint cached_blocks = log_msg_pool_get_local_cached_blocks();
+  gssize cached_bytes = log_msg_pool_get_local_cached_bytes();
+  gpointer block = log_msg_pool_alloc(512);
+
+  log_msg_pool_free(block, 512);
+  cr_assert_eq(log_msg_pool_get_local_cached_blocks(), cached_blocks + 1);
+  cr_assert_eq(log_msg_pool_get_local_cached_bytes(), cached_bytes + 512);
+
+  gpointer reused = log_msg_pool_alloc(512);
+  cr_assert_eq(reused, block);
+  cr_assert_eq(log_msg_pool_get_local_cached_blocks(), cached_blocks);
+  cr_assert_eq(log_msg_pool_get_local_cached_bytes(), cached_bytes);
+  log_msg_pool_free(reused, 512);
+}
+
+Test(log_msg_pool, blocks_of_a_different_size_are_not_reused)
+{
+  gpointer block = log_msg_pool_alloc(512);
+  log_msg_pool_free(block, 512);
+
+  gint cached_blocks = log_msg_pool_get_local_cached_blocks();
+  gpointer other = log_msg_pool_alloc(1000);
+  cr_assert_neq(other, block);
+  cr_assert_eq(log_msg_pool_get_local_cached_blocks(), cached_blocks);
+  log_msg_pool_free(other, 1000);
+  cr_assert_eq(log_msg_pool_get_local_cached_blocks(), cached_blocks + 1);
+}
+
+Test(log_msg_pool, large_blocks_are_not_cached)
+{
+  gint cached_blocks = log_msg_pool_get_local_cached_blocks();
+  gpointer block = log_msg_pool_alloc(LOG_MSG_POOL_MAX_BLOCK_SIZE + 1);
+
+  log_msg_pool_free(block, LOG_MSG_POOL_MAX_BLOCK_SIZE + 1);
+  cr_assert_eq(log_msg_pool_get_local_cached_blocks(), cached_blocks);
+}
+
+Test(log_msg_pool, number_of_cached_blocks_is_limited)
+{
+  gpointer blocks[LOG_MSG_POOL_MAX_BLOCKS + 1];
+  gint cached_blocks = log_msg_pool_get_local_cached_blocks();
+
+  for (gint i = 0; i < G_N_ELEMENTS(blocks); i++)
+    blocks[i] = g_malloc(200);
+  for (gint i = 0; i < G_N_ELEMENTS(blocks); i++)
+    log_msg_pool_free(blocks[i], 200);
+
+  cr_assert_eq(log_msg_pool_get_local_cached_blocks(), cached_blocks + LOG_MSG_POOL_MAX_BLOCKS);
+}
+
+Test(log_msg_pool, log_messages_are_recycled_through_the_pool)
+{
+  LogMessage *msg = log_msg_new_empty();
+  log_msg_set_value(msg, LM_V_MESSAGE, "foobar", -1);
+  log_msg_unref(msg);
+
+  gint cached_blocks = log_msg_pool_get_local_cached_blocks();
+  cr_assert_gt(cached_blocks, 0);
+
+  LogMessage *recycled = log_msg_new_empty();
+  cr_assert_eq(recycled, msg);
+  cr_assert_eq(log_msg_pool_get_local_cached_blocks(), cached_blocks - 1);
+  cr_assert_str_eq(log_msg_get_value(recycled, LM_V_MESSAGE, NULL), "");
+  log_msg_unref(recycled);
+}
+
+Test(log_msg_pool, cloned_log_messages_are_returned_with_their_own_size)
+{
+  LogPathOptions path_options = LOG_PATH_OPTIONS_INIT;
+  LogMessage *msg = log_msg_new_empty();
+  LogMessage *cloned = log_msg_clone_cow(msg, &path_options);
+
+  cr_assert_neq(cloned->alloc_size, msg->alloc_size);
+  log_msg_unref(cloned);
+  log_msg_unref(msg);
+}
+
+static void
+setup(void)
+{
+  app_startup();
+}
+
+static void
+teardown(void)
+{
+  app_shutdown();
+}
+
+TestSuite(log_msg_pool, .init = setup, .fini = teardown);
@@ -226,6 +226,106 @@ Test(logmsg_serialize, simple_serialization)
   g_string_free(stream, TRUE);
 }
 
+Test(logmsg_serialize, borrowed_values_are_serialized_as_copies)
+{
+  parse_options.flags |= LP_STORE_RAW_MESSAGE;
+  LogMessage *msg = _create_message_to_be_serialized(RAW_MSG, strlen(RAW_MSG));
+  parse_options.flags &= ~LP_STORE_RAW_MESSAGE;
+
+  cr_assert_not_null(log_msg_get_input_chunk(msg));
+
+  GString *stream = g_string_sized_new(512);
+  SerializeArchive *sa = serialize_string_archive_new(stream);
+
+  log_msg_serialize(msg, sa, 0);
+  log_msg_unref(msg);
+
+  msg = log_msg_new_empty();
+  cr_assert(log_msg_deserialize(msg, sa), ERROR_MSG);
+  cr_assert_null(log_msg_get_input_chunk(msg));
+
+  gssize rawmsg_len;
+  const gchar *rawmsg = log_msg_get_value_by_name(msg, "RAWMSG", &rawmsg_len);
+  cr_assert_eq(rawmsg_len, strlen(RAW_MSG));
+  cr_assert(strncmp(rawmsg, RAW_MSG, rawmsg_len) == 0);
+
+  log_msg_unref(msg);
+  serialize_archive_free(sa);
+  g_string_free(stream, TRUE);
+}
+
+Test(logmsg_serialize, interned_values_are_serialized_as_copies)
+{
+  LogMessage *msg = _create_message_to_be_serialized(RAW_MSG, strlen(RAW_MSG));
+  log_msg_set_value(msg, LM_V_HOST, "host.with.a.long.name", -1);
+
+  GString *stream = g_string_sized_new(512);
+  SerializeArchive *sa = serialize_string_archive_new(stream);
+
+  log_msg_serialize(msg, sa, 0);
+  log_msg_unref(msg);
+
+  msg = log_msg_new_empty();
+  cr_assert(log_msg_deserialize(msg, sa), ERROR_MSG);
+
+  gssize host_len;
+  const gchar *host = log_msg_get_value(msg, LM_V_HOST, &host_len);
+  cr_assert_eq(host_len, strlen("host.with.a.long.name"));
+  cr_assert(strncmp(host, "host.with.a.long.name", host_len) == 0);
+
+  log_msg_unref(msg);
+  serialize_archive_free(sa);
+  g_string_free(stream, TRUE);
+}
+
+static gsize
+_serialized_length(LogMessage *msg, guint32 flags)
+{
+  GString *stream = g_string_new("");
+  SerializeArchive *sa = serialize_string_archive_new(stream);
+
+  log_msg_serialize(msg, sa, flags);
+  gsize length = stream->len;
+
+  serialize_archive_free(sa);
+  g_string_free(stream, TRUE);
+  return length;
+}
+
+Test(logmsg_serialize, compact_encoding)
+{
+  LogMessage *msg = _create_message_to_be_serialized(RAW_MSG, strlen(RAW_MSG));
+  GString *stream = g_string_new("");
+  SerializeArchive *sa = serialize_string_archive_new(stream);
+
+  cr_assert_lt(_serialized_length(msg, LMSF_COMPACT_ENCODING), _serialized_length(msg, LMSF_COMPACTION));
+
+  NVHandle first_sdata = msg->sdata[0];
+  NVHandle last_sdata = msg->sdata[msg->num_sdata - 1];
+  gint num_sdata = msg->num_sdata;
+  gchar *first_sdata_name = g_strdup(log_msg_get_value_name(first_sdata, NULL));
+  gchar *last_sdata_name = g_strdup(log_msg_get_value_name(last_sdata, NULL));
+
+  log_msg_serialize(msg, sa, LMSF_COMPACT_ENCODING);
+  log_msg_unref(msg);
+
+  _reset_log_msg_registry();
+  msg = log_msg_new_empty();
+  cr_assert(log_msg_deserialize(msg, sa), ERROR_MSG);
+
+  _check_deserialized_message_all_fields(msg);
+  cr_assert_eq(msg->num_sdata, num_sdata);
+  cr_assert_str_eq(log_msg_get_value_name(msg->sdata[0], NULL), first_sdata_name);
+  cr_assert_str_eq(log_msg_get_value_name(msg->sdata[msg->num_sdata - 1], NULL), last_sdata_name);
+  cr_assert(log_msg_is_handle_sdata(msg->sdata[0]));
+
+  g_free(first_sdata_name);
+  g_free(last_sdata_name);
+  log_msg_unref(msg);
+  serialize_archive_free(sa);
+  g_string_free(stream, TRUE);
+}
+
 Test(logmsg_serialize, given_ts_processed)
 {
   LogMessage *msg = _create_message_to_be_serialized(RAW_MSG, strlen(RAW_MSG));
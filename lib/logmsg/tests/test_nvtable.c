@@ -1021,6 +1021,49 @@ Test(nvtable, test_nvtable_unset_values)
   nv_table_unref(tab);
 }
 
+Test(nvtable, test_nvtable_numbers_are_stored_next_to_direct_values)
+{
+  NVTable *tab = nv_table_new(STATIC_VALUES, STATIC_VALUES, 1024);
+  NVNumericValue number = { .as_int64 = 12345 };
+  NVNumericValue stored;
+
+  cr_assert(nv_table_add_value_with_number(tab, DYN_HANDLE, DYN_NAME, strlen(DYN_NAME), "12345", 5,
+                                           LM_VT_INTEGER, &number, NULL));
+  cr_assert(nv_table_add_value_with_number(tab, STATIC_HANDLE, STATIC_NAME, strlen(STATIC_NAME), "1.5", 3,
+                                           LM_VT_DOUBLE, &(NVNumericValue) { .as_double = 1.5 }, NULL));
+  assert_nvtable(tab, DYN_HANDLE, "12345", 5);
+  assert_nvtable(tab, STATIC_HANDLE, "1.5", 3);
+
+  cr_assert(nv_table_get_value_number(tab, DYN_HANDLE, &stored));
+  cr_assert_eq(stored.as_int64, 12345);
+  cr_assert(nv_table_get_value_number(tab, STATIC_HANDLE, &stored));
+  cr_assert_float_eq(stored.as_double, 1.5, 1e-9);
+
+  /* overwritten in place, with and without a number */
+  number.as_int64 = 42;
+  cr_assert(nv_table_add_value_with_number(tab, DYN_HANDLE, DYN_NAME, strlen(DYN_NAME), "42", 2,
+                                           LM_VT_INTEGER, &number, NULL));
+  cr_assert(nv_table_get_value_number(tab, DYN_HANDLE, &stored));
+  cr_assert_eq(stored.as_int64, 42);
+
+  cr_assert(nv_table_add_value(tab, DYN_HANDLE, DYN_NAME, strlen(DYN_NAME), "43", 2, LM_VT_INTEGER, NULL));
+  assert_nvtable(tab, DYN_HANDLE, "43", 2);
+  cr_assert_not(nv_table_get_value_number(tab, DYN_HANDLE, &stored));
+
+  /* unset and indirect values have no number */
+  nv_table_unset_value(tab, STATIC_HANDLE);
+  cr_assert_not(nv_table_get_value_number(tab, STATIC_HANDLE, &stored));
+
+  cr_assert(nv_table_add_value_with_number(tab, STATIC_HANDLE, STATIC_NAME, strlen(STATIC_NAME), "4", 1,
+                                           LM_VT_INTEGER, &(NVNumericValue) { .as_int64 = 4 }, NULL));
+  NVReferencedSlice ref_slice = { .handle = DYN_HANDLE, .ofs = 0, .len = 1 };
+  cr_assert(nv_table_add_value_indirect(tab, STATIC_HANDLE, STATIC_NAME, strlen(STATIC_NAME), &ref_slice,
+                                        LM_VT_INTEGER, NULL));
+  cr_assert_not(nv_table_get_value_number(tab, STATIC_HANDLE, &stored));
+
+  nv_table_unref(tab);
+}
+
 Test(nvtable, test_nvtable_unset_copies_indirect_references)
 {
   NVTable *tab;
@@ -1166,3 +1209,173 @@ Test(nvtable, test_nvtable_compact_skips_unset_values)
 
   nv_table_unref(tab2);
 }
+
+Test(nvtable, test_nvtable_borrowed_values_are_not_copied)
+{
+  NVTable *tab;
+  gssize size = 9999;
+  const gchar *value;
+  const gchar *input = "borrowed-foobar";
+  const gchar *borrowed_nv_name = "borrowed-name";
+
+  tab = nv_table_new(STATIC_VALUES, STATIC_VALUES, 1024);
+  nv_table_add_value_borrowed(tab, DYN_HANDLE, borrowed_nv_name, strlen(borrowed_nv_name), input + 9, 3, 0, NULL);
+
+  value = nv_table_get_value(tab, DYN_HANDLE, &size, NULL);
+  cr_assert_eq(value, input + 9);
+  cr_assert_eq(size, 3);
+
+  /* overwriting a borrowed value makes it direct again */
+  nv_table_add_value(tab, DYN_HANDLE, borrowed_nv_name, strlen(borrowed_nv_name), "bar", 3, 0, NULL);
+  value = nv_table_get_value(tab, DYN_HANDLE, &size, NULL);
+  cr_assert_neq(value, input + 9);
+  cr_assert_str_eq(value, "bar");
+
+  nv_table_add_value_borrowed(tab, DYN_HANDLE, borrowed_nv_name, strlen(borrowed_nv_name), input, 8, 0, NULL);
+  nv_table_unset_value(tab, DYN_HANDLE);
+  value = nv_table_get_value(tab, DYN_HANDLE, &size, NULL);
+  cr_assert_null(value);
+
+  nv_table_unref(tab);
+}
+
+Test(nvtable, test_nvtable_borrowed_values_can_be_referenced)
+{
+  NVTable *tab;
+  gssize size = 9999;
+  const gchar *value;
+  const gchar *input = "borrowed-foobar";
+  const gchar *borrowed_nv_name = "borrowed-name";
+  const gchar *indirect_nv_name = "indirect-name";
+
+  tab = nv_table_new(STATIC_VALUES, STATIC_VALUES, 1024);
+  nv_table_add_value_borrowed(tab, DYN_HANDLE, borrowed_nv_name, strlen(borrowed_nv_name), input, strlen(input), 0,
+                              NULL);
+  nv_table_add_value_indirect(tab, DYN_HANDLE+1, indirect_nv_name, strlen(indirect_nv_name),
+                              &(NVReferencedSlice)
+  {
+    DYN_HANDLE, 9, 3
+  }, 0, NULL);
+
+  value = nv_table_get_value(tab, DYN_HANDLE+1, &size, NULL);
+  cr_assert_not_null(value);
+  cr_assert(strncmp(value, "foo", size) == 0);
+  cr_assert_eq(size, 3);
+
+  nv_table_unref(tab);
+}
+
+Test(nvtable, test_nvtable_compact_copies_borrowed_values)
+{
+  NVTable *tab1, *tab2;
+  gssize size = 9999;
+  const gchar *value;
+  gchar input[] = "borrowed-foobar";
+  const gchar *borrowed_nv_name = "borrowed-name";
+
+  tab1 = nv_table_new(STATIC_VALUES, STATIC_VALUES, 128);
+  nv_table_add_value_borrowed(tab1, DYN_HANDLE, borrowed_nv_name, strlen(borrowed_nv_name), input, strlen(input), 0,
+                              NULL);
+
+  tab2 = nv_table_compact(tab1);
+  nv_table_unref(tab1);
+  memset(input, 'x', strlen(input));
+
+  value = nv_table_get_value(tab2, DYN_HANDLE, &size, NULL);
+  cr_assert_str_eq(value, "borrowed-foobar");
+  cr_assert_eq(size, 15);
+
+  nv_table_unref(tab2);
+}
+
+static gboolean
+_count_entries(NVHandle handle, NVEntry *entry, NVIndexEntry *index_entry, gpointer user_data)
+{
+  gint *count = (gint *) user_data;
+
+  (*count)++;
+  return FALSE;
+}
+
+static NVTable *
+_construct_nvtable_with_dynamic_values(gint num_values)
+{
+  NVTable *tab = nv_table_new(STATIC_VALUES, STATIC_VALUES, 256);
+  gchar name[16];
+
+  for (gint i = 0; i < num_values; i++)
+    {
+      NVHandle handle = DYN_HANDLE + i * 7;
+
+      g_snprintf(name, sizeof(name), "VAL%d", handle);
+      while (!nv_table_add_value(tab, handle, name, strlen(name), name, strlen(name), 0, NULL))
+        cr_assert(nv_table_realloc(tab, &tab));
+    }
+  return tab;
+}
+
+Test(nvtable, test_nvtable_index_is_hashed_above_the_threshold)
+{
+  NVTable *tab;
+  gchar name[16];
+
+  tab = _construct_nvtable_with_dynamic_values(NV_TABLE_HASHED_INDEX_THRESHOLD - 1);
+  cr_assert_not(nv_table_is_index_hashed(tab));
+  nv_table_unref(tab);
+
+  tab = _construct_nvtable_with_dynamic_values(NV_TABLE_HASHED_INDEX_THRESHOLD * 10);
+  cr_assert(nv_table_is_index_hashed(tab));
+
+  for (gint i = 0; i < NV_TABLE_HASHED_INDEX_THRESHOLD * 10; i++)
+    {
+      NVHandle handle = DYN_HANDLE + i * 7;
+
+      g_snprintf(name, sizeof(name), "VAL%d", handle);
+      assert_nvtable(tab, handle, name, strlen(name));
+    }
+  cr_assert_not(nv_table_is_value_set(tab, DYN_HANDLE + 1));
+
+  gint count = 0;
+  nv_table_foreach_entry(tab, _count_entries, &count);
+  cr_assert_eq(count, NV_TABLE_HASHED_INDEX_THRESHOLD * 10);
+  nv_table_unref(tab);
+}
+
+Test(nvtable, test_nvtable_hashed_index_is_sorted_on_request)
+{
+  NVTable *tab = _construct_nvtable_with_dynamic_values(NV_TABLE_HASHED_INDEX_THRESHOLD * 2);
+  NVIndexEntry *sorted_index = g_new(NVIndexEntry, tab->index_size);
+
+  cr_assert(nv_table_is_index_hashed(tab));
+  guint16 index_size = nv_table_get_sorted_index(tab, sorted_index);
+  cr_assert_eq(index_size, NV_TABLE_HASHED_INDEX_THRESHOLD * 2);
+
+  for (gint i = 0; i < index_size; i++)
+    {
+      cr_assert_eq(sorted_index[i].handle, DYN_HANDLE + i * 7);
+      cr_assert_eq(nv_table_get_entry_at_ofs(tab, sorted_index[i].ofs),
+                   nv_table_get_entry(tab, sorted_index[i].handle, NULL, NULL));
+    }
+  g_free(sorted_index);
+  nv_table_unref(tab);
+}
+
+Test(nvtable, test_nvtable_hashed_index_survives_clone_and_compact)
+{
+  NVTable *tab = _construct_nvtable_with_dynamic_values(NV_TABLE_HASHED_INDEX_THRESHOLD * 3);
+  NVTable *cloned = nv_table_clone(tab, 0);
+  NVTable *compacted = nv_table_compact(tab);
+  gchar name[16];
+
+  nv_table_unref(tab);
+  for (gint i = 0; i < NV_TABLE_HASHED_INDEX_THRESHOLD * 3; i++)
+    {
+      NVHandle handle = DYN_HANDLE + i * 7;
+
+      g_snprintf(name, sizeof(name), "VAL%d", handle);
+      assert_nvtable(cloned, handle, name, strlen(name));
+      assert_nvtable(compacted, handle, name, strlen(name));
+    }
+  nv_table_unref(cloned);
+  nv_table_unref(compacted);
+}
@@ -219,6 +219,91 @@ Test(tags, test_filters_false)
   log_msg_unref(msg);
 }
 
+static void
+_register_tags(guint num)
+{
+  for (guint i = 0; i < num; i++)
+    {
+      gchar *name = get_tag_by_id(i);
+      cr_assert_eq(log_tags_get_by_name(name), i);
+      g_free(name);
+    }
+}
+
+Test(tags, test_tags_below_inline_max_are_stored_inline)
+{
+  _register_tags(LOGMSG_TAGS_INLINE_MAX + 1);
+
+  LogMessage *msg = log_msg_new_empty();
+  for (LogTagId id = 0; id < LOGMSG_TAGS_INLINE_MAX; id += 3)
+    log_msg_set_tag_by_id(msg, id);
+  cr_assert_eq(msg->num_tags, 0, "Tags below LOGMSG_TAGS_INLINE_MAX should be stored in-line");
+
+  log_msg_set_tag_by_id(msg, LOGMSG_TAGS_INLINE_MAX);
+  cr_assert_neq(msg->num_tags, 0);
+
+  for (LogTagId id = 0; id <= LOGMSG_TAGS_INLINE_MAX; id++)
+    {
+      gboolean expected = (id % 3 == 0) || id == LOGMSG_TAGS_INLINE_MAX;
+      cr_assert_eq(log_msg_is_tag_by_id(msg, id), expected,
+                   "Tag %d was not retained when tags were moved out of the message", id);
+    }
+  log_msg_unref(msg);
+}
+
+Test(tags, test_memory_usage_accounts_inline_and_spilled_tags)
+{
+  LogMessageMemoryUsage inline_usage, spilled_usage;
+
+  _register_tags(LOGMSG_TAGS_INLINE_MAX + 1);
+
+  LogMessage *msg = log_msg_new_empty();
+  log_msg_set_tag_by_id(msg, 1);
+  log_msg_get_memory_usage(msg, &inline_usage);
+  cr_assert_eq(inline_usage.tags, sizeof(msg->tags_inline));
+
+  log_msg_set_tag_by_id(msg, LOGMSG_TAGS_INLINE_MAX);
+  log_msg_get_memory_usage(msg, &spilled_usage);
+  cr_assert_eq(spilled_usage.tags, msg->num_tags * sizeof(msg->tags[0]));
+  cr_assert_eq(spilled_usage.header, inline_usage.header + sizeof(msg->tags_inline),
+               "once tags are moved out, the inline storage belongs to the header again");
+  log_msg_unref(msg);
+}
+
+Test(tags, test_filters_with_tags_outside_of_the_message_storage)
+{
+  _register_tags(300);
+
+  FilterExprNode *f = filter_tags_new(g_list_prepend(g_list_prepend(NULL, get_tag_by_id(5)), get_tag_by_id(299)));
+
+  LogMessage *msg = log_msg_new_empty();
+  log_msg_set_tag_by_id(msg, 7);
+  cr_assert_not(filter_expr_eval(f, msg), "Filter matched a message without the tags in the filter");
+
+  log_msg_set_tag_by_id(msg, 5);
+  cr_assert(filter_expr_eval(f, msg), "Filter did not match an in-line tag");
+  log_msg_clear_tag_by_id(msg, 5);
+
+  log_msg_set_tag_by_id(msg, 299);
+  cr_assert(filter_expr_eval(f, msg), "Filter did not match a tag stored outside of the message");
+  log_msg_clear_tag_by_id(msg, 299);
+  cr_assert_not(filter_expr_eval(f, msg));
+
+  log_msg_unref(msg);
+  filter_expr_unref(f);
+
+  /* the filter is shorter than the tags of the message */
+  f = filter_tags_new(g_list_prepend(NULL, get_tag_by_id(5)));
+  msg = log_msg_new_empty();
+  log_msg_set_tag_by_id(msg, 299);
+  cr_assert_not(filter_expr_eval(f, msg));
+  log_msg_set_tag_by_id(msg, 5);
+  cr_assert(filter_expr_eval(f, msg));
+
+  log_msg_unref(msg);
+  filter_expr_unref(f);
+}
+
 static void
 setup(void)
 {
@@ -62,6 +62,21 @@ Test(template_timestamp, test_derializing_injured_timestamp)
   cr_assert_not(timestamp_deserialize(sa, output_timestamps), "Should be failed");
 }
 
+Test(template_timestamp, test_compact_form)
+{
+  cr_assert(timestamp_serialize_compact(sa, input_timestamps), "Failed to serialize timestamps");
+  cr_assert_lt(stream->len, 3 * (sizeof(guint64) + 2 * sizeof(guint32)),
+               "The compact form is expected to be smaller than the fixed size one");
+  cr_assert(timestamp_deserialize_compact(sa, output_timestamps), "Failed to deserialize timestamps");
+
+  for (gint i = 0; i < LM_TS_MAX; i++)
+    {
+      cr_assert_eq(input_timestamps[i].ut_sec, output_timestamps[i].ut_sec);
+      cr_assert_eq(input_timestamps[i].ut_usec, output_timestamps[i].ut_usec);
+      cr_assert_eq(input_timestamps[i].ut_gmtoff, output_timestamps[i].ut_gmtoff);
+    }
+}
+
 static void
 setup(void)
 {
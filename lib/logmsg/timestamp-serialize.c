@@ -74,3 +74,49 @@ timestamp_deserialize(SerializeArchive *sa, UnixTime *timestamps)
   return (timestamp_deserialize_legacy(sa, timestamps) &&
           _read_log_stamp(sa, &timestamps[LM_TS_PROCESSED]));
 }
+
+/* the compact form stores the seconds as a difference to the previous
+ * timestamp, these are usually very close to each other */
+static gboolean
+_write_log_stamp_compact(SerializeArchive *sa, const UnixTime *stamp, gint64 base_sec)
+{
+  return serialize_write_varint_signed(sa, stamp->ut_sec - base_sec) &&
+         serialize_write_varint(sa, stamp->ut_usec) &&
+         serialize_write_varint_signed(sa, stamp->ut_gmtoff);
+}
+
+static gboolean
+_read_log_stamp_compact(SerializeArchive *sa, UnixTime *stamp, gint64 base_sec)
+{
+  gint64 sval;
+  guint64 val;
+
+  if (!serialize_read_varint_signed(sa, &sval))
+    return FALSE;
+  stamp->ut_sec = base_sec + sval;
+
+  if (!serialize_read_varint(sa, &val) || val > G_MAXUINT32)
+    return FALSE;
+  stamp->ut_usec = val;
+
+  if (!serialize_read_varint_signed(sa, &sval) || sval < G_MININT32 || sval > G_MAXINT32)
+    return FALSE;
+  stamp->ut_gmtoff = (gint) sval;
+  return TRUE;
+}
+
+gboolean
+timestamp_serialize_compact(SerializeArchive *sa, UnixTime *timestamps)
+{
+  return _write_log_stamp_compact(sa, &timestamps[LM_TS_STAMP], 0) &&
+         _write_log_stamp_compact(sa, &timestamps[LM_TS_RECVD], timestamps[LM_TS_STAMP].ut_sec) &&
+         _write_log_stamp_compact(sa, &timestamps[LM_TS_PROCESSED], timestamps[LM_TS_RECVD].ut_sec);
+}
+
+gboolean
+timestamp_deserialize_compact(SerializeArchive *sa, UnixTime *timestamps)
+{
+  return _read_log_stamp_compact(sa, &timestamps[LM_TS_STAMP], 0) &&
+         _read_log_stamp_compact(sa, &timestamps[LM_TS_RECVD], timestamps[LM_TS_STAMP].ut_sec) &&
+         _read_log_stamp_compact(sa, &timestamps[LM_TS_PROCESSED], timestamps[LM_TS_RECVD].ut_sec);
+}
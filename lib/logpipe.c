@@ -72,6 +72,7 @@ log_pipe_init_instance(LogPipe *self, GlobalConfig *cfg)
   self->pipe_next = NULL;
   self->persist_name = NULL;
   self->plugin_name = NULL;
+  self->sampler_tag = NULL;
   self->signal_slot_connector = signal_slot_connector_new();
 
   /* NOTE: queue == NULL means that this pipe simply forwards the
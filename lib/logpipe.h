@@ -31,6 +31,7 @@
 #include "atomic.h"
 #include "messages.h"
 #include "signal-slot-connector/signal-slot-connector.h"
+#include "stack-sampler.h"
 
 /* notify code values */
 #define NC_CLOSE       1
@@ -274,6 +275,8 @@ struct _LogPipe
   gchar *plugin_name;
   SignalSlotConnector *signal_slot_connector;
   LogPipeOptions options;
+  /* the tag of the enclosing rule in stack samples, "" if none, see stack-sampler.h */
+  const gchar *sampler_tag;
 
   gboolean (*pre_init)(LogPipe *self);
   gboolean (*init)(LogPipe *self);
@@ -413,6 +416,8 @@ static inline void
 log_pipe_queue(LogPipe *s, LogMessage *msg, const LogPathOptions *path_options)
 {
   LogPathOptions local_path_options;
+  const gchar *saved_sampler_tag = NULL;
+  gboolean sampled = FALSE;
   g_assert((s->flags & PIF_INITIALIZED) != 0);
 
   if (G_UNLIKELY(pipe_single_step_hook))
@@ -443,6 +448,12 @@ log_pipe_queue(LogPipe *s, LogMessage *msg, const LogPathOptions *path_options)
       path_options = &local_path_options;
     }
 
+  if (G_UNLIKELY(stack_sampler_running))
+    {
+      saved_sampler_tag = stack_sampler_enter_pipe(s);
+      sampled = TRUE;
+    }
+
   if (s->queue)
     {
       s->queue(s, msg, path_options);
@@ -452,6 +463,8 @@ log_pipe_queue(LogPipe *s, LogMessage *msg, const LogPathOptions *path_options)
       log_pipe_forward_msg(s, msg, path_options);
     }
 
+  if (G_UNLIKELY(sampled))
+    stack_sampler_leave_pipe(saved_sampler_tag);
 }
 
 static inline LogPipe *
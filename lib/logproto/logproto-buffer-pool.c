@@ -0,0 +1,145 @@
+/*
+ * Copyright (c) 2024 One Identity LLC.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#include "logproto/logproto-buffer-pool.h"
+
+/*
+ * Process wide pool of LogProtoBufferedServer read buffers.
+ *
+ * Idle connections return their buffer here, so that thousands of idle
+ * connections do not each hold on to a buffer of their own.  Buffers are
+ * kept in power of two size classes, with a free list threaded through
+ * the buffers themselves.  Sizes that do not match a class are not pooled.
+ */
+
+typedef struct _PooledBuffer PooledBuffer;
+struct _PooledBuffer
+{
+  PooledBuffer *next;
+};
+
+static struct
+{
+  GMutex lock;
+  PooledBuffer *free_list[LOG_PROTO_BUFFER_POOL_SIZE_CLASSES];
+  gsize pooled_bytes;
+} buffer_pool;
+
+static gint
+_get_size_class(gsize size)
+{
+  gsize class_size = LOG_PROTO_BUFFER_POOL_MIN_SIZE;
+
+  for (gint i = 0; i < LOG_PROTO_BUFFER_POOL_SIZE_CLASSES; i++)
+    {
+      if (size == class_size)
+        return i;
+      class_size <<= 1;
+    }
+  return -1;
+}
+
+guchar *
+log_proto_buffer_pool_acquire(gsize size)
+{
+  gint size_class = _get_size_class(size);
+  PooledBuffer *buffer = NULL;
+
+  if (size_class < 0)
+    return g_malloc(size);
+
+  g_mutex_lock(&buffer_pool.lock);
+  buffer = buffer_pool.free_list[size_class];
+  if (buffer)
+    {
+      buffer_pool.free_list[size_class] = buffer->next;
+      buffer_pool.pooled_bytes -= size;
+    }
+  g_mutex_unlock(&buffer_pool.lock);
+
+  if (!buffer)
+    return g_malloc(size);
+  return (guchar *) buffer;
+}
+
+void
+log_proto_buffer_pool_release(guchar *buffer, gsize size)
+{
+  gint size_class = _get_size_class(size);
+
+  if (!buffer)
+    return;
+
+  if (size_class < 0)
+    {
+      g_free(buffer);
+      return;
+    }
+
+  g_mutex_lock(&buffer_pool.lock);
+  if (buffer_pool.pooled_bytes + size <= LOG_PROTO_BUFFER_POOL_MAX_BYTES)
+    {
+      PooledBuffer *pooled = (PooledBuffer *) buffer;
+
+      pooled->next = buffer_pool.free_list[size_class];
+      buffer_pool.free_list[size_class] = pooled;
+      buffer_pool.pooled_bytes += size;
+      buffer = NULL;
+    }
+  g_mutex_unlock(&buffer_pool.lock);
+
+  g_free(buffer);
+}
+
+gsize
+log_proto_buffer_pool_get_pooled_bytes(void)
+{
+  g_mutex_lock(&buffer_pool.lock);
+  gsize pooled_bytes = buffer_pool.pooled_bytes;
+  g_mutex_unlock(&buffer_pool.lock);
+
+  return pooled_bytes;
+}
+
+void
+log_proto_buffer_pool_global_init(void)
+{
+  g_mutex_init(&buffer_pool.lock);
+}
+
+void
+log_proto_buffer_pool_global_deinit(void)
+{
+  for (gint i = 0; i < LOG_PROTO_BUFFER_POOL_SIZE_CLASSES; i++)
+    {
+      while (buffer_pool.free_list[i])
+        {
+          PooledBuffer *buffer = buffer_pool.free_list[i];
+
+          buffer_pool.free_list[i] = buffer->next;
+          g_free(buffer);
+        }
+    }
+  buffer_pool.pooled_bytes = 0;
+  g_mutex_clear(&buffer_pool.lock);
+}
@@ -0,0 +1,44 @@
+/*
+ * Copyright (c) 2024 One Identity LLC.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#ifndef LOGPROTO_BUFFER_POOL_H_INCLUDED
+#define LOGPROTO_BUFFER_POOL_H_INCLUDED 1
+
+#include "syslog-ng.h"
+
+/* smallest buffer handed out by the pool, buffer sizes are powers of two from here */
+#define LOG_PROTO_BUFFER_POOL_MIN_SIZE       4096
+/* number of size classes, the largest pooled buffer is 1 MiB */
+#define LOG_PROTO_BUFFER_POOL_SIZE_CLASSES   9
+/* maximum number of bytes kept in the pool */
+#define LOG_PROTO_BUFFER_POOL_MAX_BYTES      (32 * 1024 * 1024)
+
+guchar *log_proto_buffer_pool_acquire(gsize size);
+void log_proto_buffer_pool_release(guchar *buffer, gsize size);
+
+gsize log_proto_buffer_pool_get_pooled_bytes(void);
+
+void log_proto_buffer_pool_global_init(void);
+void log_proto_buffer_pool_global_deinit(void);
+
+#endif
@@ -23,6 +23,7 @@
  */
 #include "logproto-buffered-server.h"
 #include "logproto.h"
+#include "logproto-buffer-pool.h"
 #include "messages.h"
 #include "serialize.h"
 #include "compat/string.h"
@@ -593,6 +594,11 @@ log_proto_buffered_server_prepare(LogProtoServer *s, GIOCondition *cond, gint *t
   if (*cond == 0)
     *cond = G_IO_IN;
 
+  /* the transport has already received data that we haven't fetched yet,
+   * the fd might not become readable again until we do */
+  if (log_transport_has_pending_input(self->super.transport))
+    return LPPA_FORCE_SCHEDULE_FETCH;
+
   return LPPA_POLL_IO;
 }
 
@@ -675,6 +681,9 @@ log_proto_buffered_server_get_raw_size_of_buffer(LogProtoBufferedServer *self, c
     }
 }
 
+static void log_proto_buffered_server_release_buffer(LogProtoBufferedServer *self,
+                                                     LogProtoBufferedServerState *state);
+
 static void
 log_proto_buffered_server_split_buffer(LogProtoBufferedServer *self, LogProtoBufferedServerState *state,
                                        const guchar **buffer_start, gsize buffer_bytes)
@@ -683,7 +692,20 @@ log_proto_buffered_server_split_buffer(LogProtoBufferedServer *self, LogProtoBuf
     return;
 
   /* move partial message to the beginning of the buffer to make space for new data */
-  memmove(self->buffer, *buffer_start, buffer_bytes);
+  if (self->buffer_chunk)
+    {
+      /* messages still point into the buffer, continue in a new one */
+      guchar *new_buffer = self->pooled_buffer ? log_proto_buffer_pool_acquire(state->buffer_size)
+                           : g_malloc(state->buffer_size);
+
+      memcpy(new_buffer, *buffer_start, buffer_bytes);
+      log_proto_buffered_server_release_buffer(self, state);
+      self->buffer = new_buffer;
+    }
+  else
+    {
+      memmove(self->buffer, *buffer_start, buffer_bytes);
+    }
   state->pending_buffer_pos = 0;
   state->pending_buffer_end = buffer_bytes;
   *buffer_start = self->buffer;
@@ -713,7 +735,7 @@ log_proto_buffered_server_split_buffer(LogProtoBufferedServer *self, LogProtoBuf
 
 static gboolean
 log_proto_buffered_server_fetch_from_buffer(LogProtoBufferedServer *self, const guchar **msg, gsize *msg_len,
-                                            LogTransportAuxData *aux)
+                                            LogTransportAuxData *aux, gboolean may_split_buffer)
 {
   gsize buffer_bytes;
   const guchar *buffer_start;
@@ -744,7 +766,7 @@ log_proto_buffered_server_fetch_from_buffer(LogProtoBufferedServer *self, const
 
   success = self->fetch_from_buffer(self, buffer_start, buffer_bytes, msg, msg_len);
 
-  if (!success)
+  if (!success && may_split_buffer)
     {
       log_proto_buffered_server_split_buffer(self, state, &buffer_start, buffer_bytes);
     }
@@ -756,11 +778,196 @@ exit:
   return success;
 }
 
+/*
+ * Adaptive buffer sizing
+ *
+ * Stream based connections without position tracking or character set
+ * conversion (e.g. TCP and TLS sources) do not keep their buffer while
+ * they are idle: once the buffer is fully consumed and the transport has
+ * no more data, the buffer is returned to the shared buffer pool.  The
+ * buffer is then acquired again when the connection becomes readable.
+ *
+ * These buffers start at LOG_PROTO_BUFFER_POOL_MIN_SIZE and grow by a
+ * factor of 4, up to init_buffer_size, whenever a read fills all the
+ * available space.  Each idle period halves the size of the next
+ * allocation, so connections that are mostly idle shrink back to small
+ * buffers, while bursts quickly get a large one.
+ *
+ * The contents of LogProtoBufferedServerState are not affected,
+ * buffer_size always reflects the size of the current buffer.
+ */
+static inline gboolean
+_is_buffer_adaptive(LogProtoBufferedServer *self)
+{
+  return self->stream_based && !self->pos_tracking && !self->persist_state && self->convert == (GIConv) -1;
+}
+
+static gsize
+_get_max_adaptive_buffer_size(LogProtoBufferedServer *self)
+{
+  return self->super.options->init_buffer_size;
+}
+
 static inline void
 log_proto_buffered_server_allocate_buffer(LogProtoBufferedServer *self, LogProtoBufferedServerState *state)
 {
-  state->buffer_size = self->super.options->init_buffer_size;
-  self->buffer = g_malloc(state->buffer_size);
+  if (!_is_buffer_adaptive(self))
+    {
+      state->buffer_size = self->super.options->init_buffer_size;
+      self->buffer = g_malloc(state->buffer_size);
+      self->pooled_buffer = FALSE;
+      return;
+    }
+
+  if (!self->adaptive_buffer_size)
+    self->adaptive_buffer_size = LOG_PROTO_BUFFER_POOL_MIN_SIZE;
+
+  state->buffer_size = MIN(self->adaptive_buffer_size, _get_max_adaptive_buffer_size(self));
+  self->buffer = log_proto_buffer_pool_acquire(state->buffer_size);
+  self->pooled_buffer = TRUE;
+}
+
+/*
+ * Sharing the buffer with the messages
+ *
+ * Messages of stream based connections without character set conversion
+ * point into our buffer, which can be shared with the messages as their
+ * input chunk (see log_proto_server_steal_input_chunk()), so that $RAWMSG
+ * does not have to be copied.  Once shared, the buffer is only appended
+ * to: as soon as we would move data within it, or start over from its
+ * beginning, we drop our reference and continue in a new buffer.  The
+ * shared one is freed (or returned to the pool) along with the last
+ * message pointing into it.  As the data already consumed is never moved,
+ * this costs a buffer allocation per read at most, instead of a copy per
+ * message.
+ *
+ * Datagrams are not shared: each datagram is read to the beginning of the
+ * buffer, so every message would hold on to a whole buffer of its own.
+ */
+typedef struct _SharedPooledBuffer
+{
+  guchar *buffer;
+  gsize size;
+} SharedPooledBuffer;
+
+static void
+_shared_pooled_buffer_free(gpointer user_data)
+{
+  SharedPooledBuffer *shared = (SharedPooledBuffer *) user_data;
+
+  log_proto_buffer_pool_release(shared->buffer, shared->size);
+  g_free(shared);
+}
+
+static inline gboolean
+_is_buffer_shareable(LogProtoBufferedServer *self)
+{
+  return self->stream_based && self->convert == (GIConv) -1;
+}
+
+static GBytes *
+log_proto_buffered_server_steal_input_chunk(LogProtoServer *s)
+{
+  LogProtoBufferedServer *self = (LogProtoBufferedServer *) s;
+
+  if (!_is_buffer_shareable(self) || !self->buffer)
+    return NULL;
+
+  if (!self->buffer_chunk)
+    {
+      LogProtoBufferedServerState *state = log_proto_buffered_server_get_state(self);
+
+      if (self->pooled_buffer)
+        {
+          SharedPooledBuffer *shared = g_new(SharedPooledBuffer, 1);
+
+          shared->buffer = self->buffer;
+          shared->size = state->buffer_size;
+          self->buffer_chunk = g_bytes_new_with_free_func(self->buffer, state->buffer_size,
+                                                          _shared_pooled_buffer_free, shared);
+        }
+      else
+        {
+          self->buffer_chunk = g_bytes_new_take(self->buffer, state->buffer_size);
+        }
+      log_proto_buffered_server_put_state(self);
+    }
+  return g_bytes_ref(self->buffer_chunk);
+}
+
+static void
+log_proto_buffered_server_release_buffer(LogProtoBufferedServer *self, LogProtoBufferedServerState *state)
+{
+  if (self->buffer_chunk)
+    {
+      g_bytes_unref(self->buffer_chunk);
+      self->buffer_chunk = NULL;
+    }
+  else if (self->pooled_buffer)
+    {
+      log_proto_buffer_pool_release(self->buffer, state->buffer_size);
+    }
+  else
+    {
+      g_free(self->buffer);
+    }
+  self->buffer = NULL;
+}
+
+static void
+log_proto_buffered_server_grow_buffer(LogProtoBufferedServer *self, LogProtoBufferedServerState *state)
+{
+  gsize max_buffer_size = _get_max_adaptive_buffer_size(self);
+
+  if (state->buffer_size >= max_buffer_size)
+    return;
+
+  gsize new_buffer_size = MIN(state->buffer_size * 4, max_buffer_size);
+  guchar *new_buffer = log_proto_buffer_pool_acquire(new_buffer_size);
+
+  memcpy(new_buffer, self->buffer, state->pending_buffer_end);
+  log_proto_buffered_server_release_buffer(self, state);
+
+  self->buffer = new_buffer;
+  state->buffer_size = new_buffer_size;
+  self->adaptive_buffer_size = new_buffer_size;
+}
+
+static void
+log_proto_buffered_server_release_idle_buffer(LogProtoBufferedServer *self, LogProtoBufferedServerState *state)
+{
+  if (state->pending_buffer_end != 0 || state->raw_buffer_leftover_size != 0)
+    return;
+
+  log_proto_buffered_server_release_buffer(self, state);
+  self->pooled_buffer = FALSE;
+  self->adaptive_buffer_size = MAX(state->buffer_size / 2, LOG_PROTO_BUFFER_POOL_MIN_SIZE);
+}
+
+static void
+log_proto_buffered_server_free_buffer(LogProtoBufferedServer *self)
+{
+  if (!self->buffer)
+    return;
+
+  if (self->buffer_chunk)
+    {
+      g_bytes_unref(self->buffer_chunk);
+      self->buffer_chunk = NULL;
+    }
+  else if (self->pooled_buffer)
+    {
+      LogProtoBufferedServerState *state = log_proto_buffered_server_get_state(self);
+
+      log_proto_buffer_pool_release(self->buffer, state->buffer_size);
+      log_proto_buffered_server_put_state(self);
+    }
+  else
+    {
+      g_free(self->buffer);
+    }
+  self->buffer = NULL;
+  self->pooled_buffer = FALSE;
 }
 
 static inline gint
@@ -782,12 +989,19 @@ log_proto_buffered_server_fetch_into_buffer(LogProtoBufferedServer *self)
   LogProtoBufferedServerState *state = log_proto_buffered_server_get_state(self);
   GIOStatus result = G_IO_STATUS_NORMAL;
 
+  /* the buffer is shared and we would start over from its beginning */
+  if (self->buffer_chunk && state->pending_buffer_end == 0)
+    log_proto_buffered_server_release_buffer(self, state);
+
   if (G_UNLIKELY(!self->buffer))
     log_proto_buffered_server_allocate_buffer(self, state);
 
   if (self->convert == (GIConv) -1)
     {
       /* no conversion, we read directly into our buffer */
+      if (state->pending_buffer_end == state->buffer_size && self->pooled_buffer)
+        log_proto_buffered_server_grow_buffer(self, state);
+
       raw_buffer = self->buffer + state->pending_buffer_end;
       avail = state->buffer_size - state->pending_buffer_end;
     }
@@ -811,6 +1025,8 @@ log_proto_buffered_server_fetch_into_buffer(LogProtoBufferedServer *self)
         {
           /* ok we don't have any more data to read, return to main poll loop */
           result = G_IO_STATUS_AGAIN;
+          if (self->pooled_buffer)
+            log_proto_buffered_server_release_idle_buffer(self, state);
         }
       else
         {
@@ -842,6 +1058,10 @@ log_proto_buffered_server_fetch_into_buffer(LogProtoBufferedServer *self)
       if (self->convert == (GIConv) -1)
         {
           state->pending_buffer_end += rc;
+
+          /* the read filled all the space we had, expect a burst */
+          if (rc == avail && self->pooled_buffer)
+            log_proto_buffered_server_grow_buffer(self, state);
         }
       else if (!log_proto_buffered_server_convert_from_raw(self, raw_buffer, rc))
         {
@@ -977,7 +1197,7 @@ log_proto_buffered_server_fetch(LogProtoServer *s, const guchar **msg, gsize *ms
     {
       if (self->fetch_state == LPBSF_FETCHING_FROM_BUFFER)
         {
-          if (log_proto_buffered_server_fetch_from_buffer(self, msg, msg_len, aux))
+          if (log_proto_buffered_server_fetch_from_buffer(self, msg, msg_len, aux, TRUE))
             goto exit;
 
           if (log_proto_buffered_server_is_input_closed(self))
@@ -1036,6 +1256,41 @@ exit:
   return result;
 }
 
+/*
+ * Fetches a message the same way as log_proto_buffered_server_fetch()
+ * does, then continues extracting messages that are already complete in
+ * our buffer.  The batch ends before anything would move data around in
+ * the buffer (reading or splitting it), so the slices remain valid until
+ * the next fetch call.
+ */
+LogProtoStatus
+log_proto_buffered_server_fetch_batch(LogProtoServer *s, LogProtoServerFetchBatch *batch, gboolean *may_read)
+{
+  LogProtoBufferedServer *self = (LogProtoBufferedServer *) s;
+  LogProtoServerFetchSlice *slice = &batch->slices[0];
+
+  LogProtoStatus status = log_proto_server_fetch(s, &slice->msg, &slice->msg_len, may_read, batch->aux,
+                                                 &slice->bookmark);
+  if (!slice->msg)
+    return status;
+  batch->num_slices++;
+
+  while (status == LPS_SUCCESS && batch->num_slices < batch->max_slices)
+    {
+      if (self->fetch_state != LPBSF_FETCHING_FROM_BUFFER)
+        break;
+
+      slice = &batch->slices[batch->num_slices];
+      if (!log_proto_buffered_server_fetch_from_buffer(self, &slice->msg, &slice->msg_len, NULL, FALSE))
+        break;
+
+      _buffered_server_bookmark_fill(self, &slice->bookmark);
+      _buffered_server_update_pos(s);
+      batch->num_slices++;
+    }
+  return status;
+}
+
 gboolean
 log_proto_buffered_server_validate_options_method(LogProtoServer *s)
 {
@@ -1062,7 +1317,7 @@ log_proto_buffered_server_free_method(LogProtoServer *s)
 
   log_transport_aux_data_destroy(&self->buffer_aux);
 
-  g_free(self->buffer);
+  log_proto_buffered_server_free_buffer(self);
   if (self->state1)
     {
       g_free(self->state1);
@@ -1083,6 +1338,7 @@ log_proto_buffered_server_init(LogProtoBufferedServer *self, LogTransport *trans
   self->super.transport = transport;
   self->super.restart_with_state = log_proto_buffered_server_restart_with_state;
   self->super.validate_options = log_proto_buffered_server_validate_options_method;
+  self->super.steal_input_chunk = log_proto_buffered_server_steal_input_chunk;
   self->convert = (GIConv) -1;
   self->reverse_convert = (GIConv) -1;
   self->read_data = log_proto_buffered_server_read_data_method;
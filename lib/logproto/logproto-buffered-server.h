@@ -83,7 +83,13 @@ struct _LogProtoBufferedServer
                stream_based:1,
 
                no_multi_read:1,
-               flush_partial_message:1;
+               flush_partial_message:1,
+
+               /* buffer was acquired from the shared buffer pool */
+               pooled_buffer:1;
+  /* size of the next buffer allocation on connections with adaptive
+   * buffer sizing, see log_proto_buffered_server_allocate_buffer() */
+  gsize adaptive_buffer_size;
   gint fetch_state;
   GIOStatus io_status;
   LogProtoBufferedServerState *state1;
@@ -91,6 +97,9 @@ struct _LogProtoBufferedServer
   PersistEntryHandle persist_handle;
   GIConv convert;
   guchar *buffer;
+  /* set once the buffer is shared with the messages pointing into it, see
+   * log_proto_buffered_server_steal_input_chunk() */
+  GBytes *buffer_chunk;
 
   GIConv reverse_convert;
   gchar *reverse_buffer;
@@ -127,5 +136,7 @@ void log_proto_buffered_server_free_method(LogProtoServer *s);
 
 LogProtoStatus log_proto_buffered_server_fetch(LogProtoServer *s, const guchar **msg, gsize *msg_len,
                                                gboolean *may_read, LogTransportAuxData *aux, Bookmark *bookmark);
+LogProtoStatus log_proto_buffered_server_fetch_batch(LogProtoServer *s, LogProtoServerFetchBatch *batch,
+                                                     gboolean *may_read);
 
 #endif
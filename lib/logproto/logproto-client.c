@@ -76,11 +76,25 @@ log_proto_client_options_get_timeout(LogProtoClientOptions *options)
   return options->timeout;
 }
 
+void
+log_proto_client_options_set_batch_lines(LogProtoClientOptions *options, gint batch_lines)
+{
+  options->batch_lines = batch_lines;
+}
+
+void
+log_proto_client_options_set_batch_bytes(LogProtoClientOptions *options, gint batch_bytes)
+{
+  options->batch_bytes = batch_bytes;
+}
+
 void
 log_proto_client_options_defaults(LogProtoClientOptions *options)
 {
   options->drop_input = FALSE;
   options->timeout = 0;
+  options->batch_lines = 0;
+  options->batch_bytes = 0;
 }
 
 void
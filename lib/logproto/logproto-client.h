@@ -36,6 +36,9 @@ typedef struct _LogProtoClientOptions
 {
   gboolean drop_input;
   gint timeout;
+  /* the number of messages/bytes collected for a single writev(), 0 means no batching */
+  gint batch_lines;
+  gint batch_bytes;
 } LogProtoClientOptions;
 
 typedef union _LogProtoClientOptionsStorage
@@ -57,6 +60,8 @@ typedef struct
 void log_proto_client_options_set_drop_input(LogProtoClientOptions *options, gboolean drop_input);
 void log_proto_client_options_set_timeout(LogProtoClientOptions *options, gint timeout);
 gint log_proto_client_options_get_timeout(LogProtoClientOptions *options);
+void log_proto_client_options_set_batch_lines(LogProtoClientOptions *options, gint batch_lines);
+void log_proto_client_options_set_batch_bytes(LogProtoClientOptions *options, gint batch_bytes);
 
 void log_proto_client_options_defaults(LogProtoClientOptions *options);
 void log_proto_client_options_init(LogProtoClientOptions *options, GlobalConfig *cfg);
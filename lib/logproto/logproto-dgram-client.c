@@ -0,0 +1,147 @@
+/*
+ * Copyright (c) 2024 One Identity LLC.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+#include "logproto-dgram-client.h"
+#include "messages.h"
+
+#include <errno.h>
+#include <string.h>
+
+#define LOG_PROTO_DGRAM_CLIENT_MAX_BATCH 64
+
+typedef struct _LogProtoDGramClient
+{
+  LogProtoClient super;
+  /* formatted messages consumed by post() but not sent yet */
+  struct iovec batch[LOG_PROTO_DGRAM_CLIENT_MAX_BATCH];
+  gint batch_len;
+} LogProtoDGramClient;
+
+static gboolean
+log_proto_dgram_client_prepare(LogProtoClient *s, gint *fd, GIOCondition *cond, gint *timeout)
+{
+  LogProtoDGramClient *self = (LogProtoDGramClient *) s;
+
+  *fd = self->super.transport->fd;
+  *cond = self->super.transport->cond;
+
+  if (*cond == 0)
+    *cond = G_IO_OUT;
+
+  const gboolean pending_write = self->batch_len > 0;
+
+  if (!pending_write && s->options->timeout > 0)
+    *timeout = s->options->timeout;
+
+  return pending_write;
+}
+
+static void
+_drop_sent_datagrams(LogProtoDGramClient *self, gint sent)
+{
+  for (gint i = 0; i < sent; i++)
+    g_free(self->batch[i].iov_base);
+
+  self->batch_len -= sent;
+  memmove(&self->batch[0], &self->batch[sent], self->batch_len * sizeof(self->batch[0]));
+}
+
+static LogProtoStatus
+log_proto_dgram_client_flush(LogProtoClient *s)
+{
+  LogProtoDGramClient *self = (LogProtoDGramClient *) s;
+  LogProtoStatus status = LPS_SUCCESS;
+  gint sent = 0;
+
+  while (sent < self->batch_len)
+    {
+      gint rc = log_transport_write_datagrams(self->super.transport, &self->batch[sent], self->batch_len - sent);
+
+      if (rc < 0)
+        {
+          if (errno != EAGAIN && errno != EINTR)
+            {
+              msg_error("I/O error occurred while writing",
+                        evt_tag_int("fd", self->super.transport->fd),
+                        evt_tag_error(EVT_TAG_OSERROR));
+              status = LPS_ERROR;
+            }
+          break;
+        }
+      sent += rc;
+    }
+
+  if (sent > 0)
+    {
+      _drop_sent_datagrams(self, sent);
+      log_proto_client_msg_ack(&self->super, sent);
+    }
+  return status;
+}
+
+static LogProtoStatus
+log_proto_dgram_client_post(LogProtoClient *s, LogMessage *logmsg, guchar *msg, gsize msg_len, gboolean *consumed)
+{
+  LogProtoDGramClient *self = (LogProtoDGramClient *) s;
+
+  *consumed = FALSE;
+  if (self->batch_len == LOG_PROTO_DGRAM_CLIENT_MAX_BATCH)
+    {
+      LogProtoStatus status = log_proto_dgram_client_flush(s);
+      if (status != LPS_SUCCESS)
+        return status;
+
+      /* the transport is not writable, wait for it before accepting more */
+      if (self->batch_len == LOG_PROTO_DGRAM_CLIENT_MAX_BATCH)
+        return LPS_PARTIAL;
+    }
+
+  self->batch[self->batch_len].iov_base = msg;
+  self->batch[self->batch_len].iov_len = msg_len;
+  self->batch_len++;
+  *consumed = TRUE;
+  return LPS_SUCCESS;
+}
+
+static void
+log_proto_dgram_client_free(LogProtoClient *s)
+{
+  LogProtoDGramClient *self = (LogProtoDGramClient *) s;
+
+  for (gint i = 0; i < self->batch_len; i++)
+    g_free(self->batch[i].iov_base);
+  self->batch_len = 0;
+  log_proto_client_free_method(s);
+}
+
+LogProtoClient *
+log_proto_dgram_client_new(LogTransport *transport, const LogProtoClientOptions *options)
+{
+  LogProtoDGramClient *self = g_new0(LogProtoDGramClient, 1);
+
+  log_proto_client_init(&self->super, transport, options);
+  self->super.prepare = log_proto_dgram_client_prepare;
+  self->super.flush = log_proto_dgram_client_flush;
+  self->super.post = log_proto_dgram_client_post;
+  self->super.free_fn = log_proto_dgram_client_free;
+  return &self->super;
+}
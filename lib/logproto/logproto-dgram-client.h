@@ -0,0 +1,37 @@
+/*
+ * Copyright (c) 2024 One Identity LLC.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+#ifndef LOGPROTO_DGRAM_CLIENT_H_INCLUDED
+#define LOGPROTO_DGRAM_CLIENT_H_INCLUDED
+
+#include "logproto-client.h"
+
+/*
+ * LogProtoDGramClient
+ *
+ * This class sends each message as a separate datagram.  Messages posted
+ * during a single flush of the LogWriter are collected and sent with as
+ * few syscalls as the transport allows (sendmmsg() for sockets).
+ */
+LogProtoClient *log_proto_dgram_client_new(LogTransport *transport, const LogProtoClientOptions *options);
+
+#endif
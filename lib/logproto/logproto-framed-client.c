@@ -54,6 +54,12 @@ log_proto_framed_client_post(LogProtoClient *s, LogMessage *logmsg, guchar *msg,
       msg_len = 9999999;
     }
 
+  if (self->super.batch)
+    {
+      frame_hdr_len = g_snprintf((gchar *) self->frame_hdr_buf, sizeof(self->frame_hdr_buf), "%" G_GSIZE_FORMAT" ", msg_len);
+      return log_proto_text_client_post_batched(s, self->frame_hdr_buf, frame_hdr_len, msg, msg_len, consumed);
+    }
+
   status = LPS_SUCCESS;
   while (status == LPS_SUCCESS && !(*consumed) && self->super.partial == NULL)
     {
@@ -31,6 +31,10 @@
 #define MAX_FRAME_LEN_DIGITS 10
 static const guint MAX_FETCH_COUNT = 3;
 
+/* frames at least this large are read into a buffer of their own, see
+ * _on_direct_message_read() */
+#define DIRECT_READ_MIN_FRAME_LEN 8192
+
 typedef enum
 {
   LPFSS_FRAME_READ,
@@ -39,7 +43,8 @@ typedef enum
   LPFSS_MESSAGE_EXTRACT,
   LPFSS_TRIM_MESSAGE,
   LPFSS_TRIM_MESSAGE_READ,
-  LPFSS_CONSUME_TRIMMED
+  LPFSS_CONSUME_TRIMMED,
+  LPFSS_DIRECT_MESSAGE_READ,
 } LogProtoFramedServerState;
 
 typedef enum
@@ -59,6 +64,14 @@ typedef struct _LogProtoFramedServer
   guint32 frame_len;
   gboolean half_message_in_buffer;
   guint32 fetch_counter;
+
+  /* the payload of a large frame, being read directly from the transport */
+  struct
+  {
+    guchar *payload;
+    guint32 payload_len;
+    GBytes *input_chunk;
+  } direct;
 } LogProtoFramedServer;
 
 static LogProtoPrepareAction
@@ -256,6 +269,12 @@ _on_frame_extract(LogProtoFramedServer *self, LogTransportAuxData *aux, LogProto
 
   self->state = LPFSS_MESSAGE_EXTRACT;
 
+  if (self->frame_len >= DIRECT_READ_MIN_FRAME_LEN && self->frame_len <= self->super.options->max_msg_size)
+    {
+      self->state = LPFSS_DIRECT_MESSAGE_READ;
+      return LPFSSCTRL_NEXT_STATE;
+    }
+
   if (self->frame_len > self->super.options->max_msg_size)
     {
       if (self->super.options->trim_large_messages)
@@ -362,6 +381,75 @@ _on_message_extract(LogProtoFramedServer *self, const guchar **msg, gsize *msg_l
   return LPFSSCTRL_NEXT_STATE;
 }
 
+/*
+ * Large frames are not read into self->buffer, as they would need to be
+ * moved to its beginning to fit.  Their payload is allocated according to
+ * the frame header instead: it gets the part of the frame already in the
+ * buffer and the rest is read right into it, without reading ahead of the
+ * frame.  The payload can be taken over by the LogMessage as its input
+ * chunk via log_proto_server_steal_input_chunk().
+ */
+static LogProtoFramedServerStateControl
+_on_direct_message_read(LogProtoFramedServer *self, const guchar **msg, gsize *msg_len, gboolean *may_read,
+                        LogTransportAuxData *aux, LogProtoStatus *status)
+{
+  *status = LPS_SUCCESS;
+
+  if (!self->direct.payload)
+    {
+      guint32 buffered = MIN(self->buffer_end - self->buffer_pos, self->frame_len);
+
+      self->direct.payload = g_malloc(self->frame_len);
+      memcpy(self->direct.payload, &self->buffer[self->buffer_pos], buffered);
+      self->direct.payload_len = buffered;
+      self->buffer_pos += buffered;
+    }
+
+  while (self->direct.payload_len < self->frame_len)
+    {
+      if (!(*may_read) || self->fetch_counter++ >= MAX_FETCH_COUNT)
+        return LPFSSCTRL_RETURN_WITH_STATUS;
+
+      gint rc = log_transport_read(self->super.transport, &self->direct.payload[self->direct.payload_len],
+                                   self->frame_len - self->direct.payload_len, aux);
+      if (rc < 0)
+        {
+          if (errno != EAGAIN)
+            {
+              msg_error("Error reading RFC6587 style framed data",
+                        evt_tag_int("fd", self->super.transport->fd),
+                        evt_tag_error("error"));
+              log_transport_aux_data_reinit(aux);
+              *status = LPS_ERROR;
+            }
+          else
+            {
+              self->half_message_in_buffer = TRUE;
+            }
+          return LPFSSCTRL_RETURN_WITH_STATUS;
+        }
+
+      if (rc == 0)
+        {
+          msg_trace("EOF occurred while reading",
+                    evt_tag_int(EVT_TAG_FD, self->super.transport->fd));
+          log_transport_aux_data_reinit(aux);
+          *status = LPS_EOF;
+          return LPFSSCTRL_RETURN_WITH_STATUS;
+        }
+      self->direct.payload_len += rc;
+    }
+
+  self->direct.input_chunk = g_bytes_new_take(self->direct.payload, self->direct.payload_len);
+  self->direct.payload = NULL;
+  self->direct.payload_len = 0;
+
+  *msg = g_bytes_get_data(self->direct.input_chunk, msg_len);
+  self->state = LPFSS_FRAME_EXTRACT;
+  self->half_message_in_buffer = FALSE;
+  return LPFSSCTRL_RETURN_WITH_STATUS;
+}
+
 static LogProtoFramedServerStateControl
 _step_state_machine(LogProtoFramedServer *self, const guchar **msg, gsize *msg_len, gboolean *may_read,
                     LogTransportAuxData *aux, LogProtoStatus *status)
@@ -389,6 +477,9 @@ _step_state_machine(LogProtoFramedServer *self, const guchar **msg, gsize *msg_l
     case LPFSS_MESSAGE_EXTRACT:
       return _on_message_extract(self, msg, msg_len, status);
 
+    case LPFSS_DIRECT_MESSAGE_READ:
+      return _on_direct_message_read(self, msg, msg_len, may_read, aux, status);
+
     default:
       return LPFSSCTRL_NEXT_STATE;
     }
@@ -403,17 +494,37 @@ log_proto_framed_server_fetch(LogProtoServer *s, const guchar **msg, gsize *msg_
 
   _ensure_buffer(self);
 
+  /* the message returned by the previous fetch is not needed anymore */
+  if (self->direct.input_chunk)
+    {
+      g_bytes_unref(self->direct.input_chunk);
+      self->direct.input_chunk = NULL;
+    }
+
   self->fetch_counter = 0;
   while (_step_state_machine(self, msg, msg_len, may_read, aux, &status) != LPFSSCTRL_RETURN_WITH_STATUS) ;
 
   return status;
 }
 
+static GBytes *
+log_proto_framed_server_steal_input_chunk(LogProtoServer *s)
+{
+  LogProtoFramedServer *self = (LogProtoFramedServer *) s;
+  GBytes *input_chunk = self->direct.input_chunk;
+
+  self->direct.input_chunk = NULL;
+  return input_chunk;
+}
+
 static void
 log_proto_framed_server_free(LogProtoServer *s)
 {
   LogProtoFramedServer *self = (LogProtoFramedServer *) s;
   g_free(self->buffer);
+  g_free(self->direct.payload);
+  if (self->direct.input_chunk)
+    g_bytes_unref(self->direct.input_chunk);
 
   log_proto_server_free_method(s);
 }
@@ -426,6 +537,7 @@ log_proto_framed_server_new(LogTransport *transport, const LogProtoServerOptions
   log_proto_server_init(&self->super, transport, options);
   self->super.prepare = log_proto_framed_server_prepare;
   self->super.fetch = log_proto_framed_server_fetch;
+  self->super.steal_input_chunk = log_proto_framed_server_steal_input_chunk;
   self->super.free_fn = log_proto_framed_server_free;
   self->half_message_in_buffer = FALSE;
   self->state = LPFSS_FRAME_READ;
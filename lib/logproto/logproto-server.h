@@ -67,6 +67,23 @@ void log_proto_server_options_defaults(LogProtoServerOptions *options);
 void log_proto_server_options_init(LogProtoServerOptions *options, GlobalConfig *cfg);
 void log_proto_server_options_destroy(LogProtoServerOptions *options);
 
+/* a message returned by fetch_batch(), pointing into the buffer of the LogProtoServer */
+typedef struct _LogProtoServerFetchSlice
+{
+  const guchar *msg;
+  gsize msg_len;
+  Bookmark bookmark;
+} LogProtoServerFetchSlice;
+
+typedef struct _LogProtoServerFetchBatch
+{
+  LogProtoServerFetchSlice *slices;
+  gint max_slices;
+  gint num_slices;
+  /* the slices of a batch are extracted from the same input, they share their aux data */
+  LogTransportAuxData *aux;
+} LogProtoServerFetchBatch;
+
 typedef void (*LogProtoServerWakeupFunc)(gpointer user_data);
 typedef struct _LogProtoServerWakeupCallback
 {
@@ -87,6 +104,10 @@ struct _LogProtoServer
   gboolean (*restart_with_state)(LogProtoServer *s, PersistState *state, const gchar *persist_name);
   LogProtoStatus (*fetch)(LogProtoServer *s, const guchar **msg, gsize *msg_len, gboolean *may_read,
                           LogTransportAuxData *aux, Bookmark *bookmark);
+  /* optional, returns the messages already available in the buffer at once */
+  LogProtoStatus (*fetch_batch)(LogProtoServer *s, LogProtoServerFetchBatch *batch, gboolean *may_read);
+  /* optional, shares the buffer the last fetched messages point into */
+  GBytes *(*steal_input_chunk)(LogProtoServer *s);
   gboolean (*validate_options)(LogProtoServer *s);
   gboolean (*handshake_in_progess)(LogProtoServer *s);
   LogProtoStatus (*handshake)(LogProtoServer *s);
@@ -148,6 +169,47 @@ log_proto_server_fetch(LogProtoServer *s, const guchar **msg, gsize *msg_len, gb
   return s->status;
 }
 
+static inline gboolean
+log_proto_server_is_fetch_batch_supported(LogProtoServer *s)
+{
+  return s->fetch_batch != NULL;
+}
+
+/*
+ * The slices returned in @batch remain valid until the next fetch call.
+ * Their bookmarks are filled by the LogProtoServer, but they have to be
+ * copied to the ones requested from the AckTracker by the caller.
+ */
+static inline LogProtoStatus
+log_proto_server_fetch_batch(LogProtoServer *s, LogProtoServerFetchBatch *batch, gboolean *may_read)
+{
+  g_assert(batch->max_slices > 0);
+
+  batch->num_slices = 0;
+  batch->slices[0].msg = NULL;
+  if (s->status == LPS_SUCCESS)
+    return s->fetch_batch(s, batch, may_read);
+  return s->status;
+}
+
+/*
+ * Right after a successful fetch (or fetch_batch), returns a reference to
+ * the immutable buffer the fetched message(s) point into, e.g. to be
+ * attached to the LogMessage as its input chunk, so that the message does
+ * not have to be copied again.  The buffer may be larger than the
+ * messages: it is either a buffer the LogProtoServer read a (large)
+ * message into, or its whole receive buffer, which the LogProtoServer then
+ * stops writing into.  Returns NULL if the buffer cannot be shared, the
+ * caller owns the returned reference otherwise.
+ */
+static inline GBytes *
+log_proto_server_steal_input_chunk(LogProtoServer *s)
+{
+  if (s->steal_input_chunk)
+    return s->steal_input_chunk(s);
+  return NULL;
+}
+
 static inline gint
 log_proto_server_get_fd(LogProtoServer *s)
 {
@@ -25,6 +25,13 @@
 #include "messages.h"
 
 #include <errno.h>
+#include <string.h>
+#include <limits.h>
+#include <sys/uio.h>
+
+#ifndef IOV_MAX
+#define IOV_MAX 1024
+#endif
 
 static gboolean
 log_proto_text_client_prepare(LogProtoClient *s, gint *fd, GIOCondition *cond, gint *timeout)
@@ -38,7 +45,7 @@ log_proto_text_client_prepare(LogProtoClient *s, gint *fd, GIOCondition *cond, g
   if (*cond == 0)
     *cond = G_IO_OUT;
 
-  const gboolean pending_write = self->partial != NULL;
+  const gboolean pending_write = self->partial != NULL || (self->batch && self->batch->len > 0);
 
   if (!pending_write && s->options->timeout > 0)
     *timeout = s->options->timeout;
@@ -74,9 +81,8 @@ log_proto_text_client_drop_input(LogProtoClient *s)
 }
 
 static LogProtoStatus
-log_proto_text_client_flush(LogProtoClient *s)
+_flush_partial(LogProtoTextClient *self)
 {
-  LogProtoTextClient *self = (LogProtoTextClient *) s;
   gint rc;
 
   if (!self->partial)
@@ -115,12 +121,149 @@ log_proto_text_client_flush(LogProtoClient *s)
       self->next_state = -1;
     }
 
-  log_proto_client_msg_ack(&self->super, 1);
+  log_proto_client_msg_ack(&self->super, self->partial_messages);
 
   /* NOTE: we return here to give a chance to the framed protocol to send the frame header. */
   return LPS_SUCCESS;
 }
 
+static void
+_free_batch_entry(LogProtoTextClient *self, LogProtoTextClientBatchEntry *entry)
+{
+  self->batch_bytes -= entry->header_len + entry->msg_len;
+  g_free(entry->msg);
+}
+
+/* the remainder of a partially written entry is sent from the partial buffer */
+static void
+_move_entry_to_partial(LogProtoTextClient *self, LogProtoTextClientBatchEntry *entry, gsize written)
+{
+  gsize remaining = entry->header_len + entry->msg_len - written;
+  guchar *buf = g_malloc(remaining);
+
+  if (written < entry->header_len)
+    {
+      gsize header_remaining = entry->header_len - written;
+
+      memcpy(buf, entry->header + written, header_remaining);
+      memcpy(buf + header_remaining, entry->msg, entry->msg_len);
+    }
+  else
+    {
+      memcpy(buf, entry->msg + (written - entry->header_len), remaining);
+    }
+
+  self->partial = buf;
+  self->partial_len = remaining;
+  self->partial_pos = 0;
+  self->partial_free = g_free;
+  self->partial_messages = 1;
+  self->next_state = -1;
+}
+
+/* drop the first @written bytes of the batch, acknowledging the messages sent completely */
+static void
+_consume_batch(LogProtoTextClient *self, gsize written)
+{
+  gint acked = 0;
+  guint i;
+
+  for (i = 0; i < self->batch->len && written > 0; i++)
+    {
+      LogProtoTextClientBatchEntry *entry = &g_array_index(self->batch, LogProtoTextClientBatchEntry, i);
+      gsize entry_len = entry->header_len + entry->msg_len;
+
+      if (written < entry_len)
+        {
+          _move_entry_to_partial(self, entry, written);
+          _free_batch_entry(self, entry);
+          i++;
+          break;
+        }
+
+      written -= entry_len;
+      _free_batch_entry(self, entry);
+      acked++;
+    }
+  g_array_remove_range(self->batch, 0, i);
+
+  if (acked > 0)
+    log_proto_client_msg_ack(&self->super, acked);
+}
+
+static gint
+_fill_batch_iov(LogProtoTextClient *self, struct iovec *iov, gint max_iov)
+{
+  gint iov_count = 0;
+
+  for (guint i = 0; i < self->batch->len && iov_count + 2 <= max_iov; i++)
+    {
+      LogProtoTextClientBatchEntry *entry = &g_array_index(self->batch, LogProtoTextClientBatchEntry, i);
+
+      if (entry->header_len)
+        {
+          iov[iov_count].iov_base = entry->header;
+          iov[iov_count].iov_len = entry->header_len;
+          iov_count++;
+        }
+      iov[iov_count].iov_base = entry->msg;
+      iov[iov_count].iov_len = entry->msg_len;
+      iov_count++;
+    }
+  return iov_count;
+}
+
+static LogProtoStatus
+_flush_batch(LogProtoTextClient *self)
+{
+  gint max_iov = MIN(self->batch->len * 2, IOV_MAX);
+  struct iovec *iov = g_new(struct iovec, max_iov);
+  LogProtoStatus status = LPS_SUCCESS;
+
+  while (self->batch->len > 0 && !self->partial)
+    {
+      gint iov_count = _fill_batch_iov(self, iov, max_iov);
+      gssize rc = log_transport_writev(self->super.transport, iov, iov_count);
+
+      if (rc < 0)
+        {
+          if (errno != EAGAIN && errno != EINTR)
+            {
+              msg_error("I/O error occurred while writing",
+                        evt_tag_int("fd", self->super.transport->fd),
+                        evt_tag_error(EVT_TAG_OSERROR));
+              status = LPS_ERROR;
+            }
+          break;
+        }
+
+      if (rc == 0)
+        break;
+
+      _consume_batch(self, rc);
+    }
+
+  g_free(iov);
+  if (status == LPS_SUCCESS && self->partial)
+    return _flush_partial(self);
+  return status;
+}
+
+static LogProtoStatus
+log_proto_text_client_flush(LogProtoClient *s)
+{
+  LogProtoTextClient *self = (LogProtoTextClient *) s;
+
+  LogProtoStatus status = _flush_partial(self);
+  if (status != LPS_SUCCESS || self->partial)
+    return status;
+
+  if (!self->batch || self->batch->len == 0)
+    return LPS_SUCCESS;
+
+  return _flush_batch(self);
+}
+
 LogProtoStatus
 log_proto_text_client_submit_write(LogProtoClient *s, guchar *msg, gsize msg_len, GDestroyNotify msg_free,
                                    gint next_state)
@@ -132,8 +275,63 @@ log_proto_text_client_submit_write(LogProtoClient *s, guchar *msg, gsize msg_len
   self->partial_len = msg_len;
   self->partial_pos = 0;
   self->partial_free = msg_free;
+  self->partial_messages = 1;
   self->next_state = next_state;
-  return log_proto_text_client_flush(s);
+  return _flush_partial(self);
+}
+
+static gboolean
+_is_batch_full(LogProtoTextClient *self)
+{
+  const LogProtoClientOptions *options = self->super.options;
+
+  return (options->batch_lines > 0 && self->batch->len >= options->batch_lines) ||
+         (options->batch_bytes > 0 && self->batch_bytes >= options->batch_bytes);
+}
+
+/*
+ * Messages are collected into a batch and then written with a single
+ * writev() once batch-lines() or batch-bytes() is reached, or when the
+ * LogWriter flushes at the end of its cycle.  @header is sent in front of
+ * the message, as the frame header of the framed protocol.  Messages are
+ * acknowledged as they get written completely.
+ */
+LogProtoStatus
+log_proto_text_client_post_batched(LogProtoClient *s, const guchar *header, gsize header_len,
+                                   guchar *msg, gsize msg_len, gboolean *consumed)
+{
+  LogProtoTextClient *self = (LogProtoTextClient *) s;
+
+  g_assert(self->batch);
+  g_assert(header_len <= LOG_PROTO_TEXT_CLIENT_MAX_HEADER);
+
+  *consumed = FALSE;
+  if (_is_batch_full(self))
+    {
+      LogProtoStatus status = log_proto_text_client_flush(s);
+      if (status == LPS_ERROR)
+        return status;
+
+      if (_is_batch_full(self))
+        return LPS_PARTIAL;
+    }
+
+  LogProtoTextClientBatchEntry entry =
+  {
+    .header_len = header_len,
+    .msg = msg,
+    .msg_len = msg_len,
+  };
+  if (header_len)
+    memcpy(entry.header, header, header_len);
+
+  g_array_append_val(self->batch, entry);
+  self->batch_bytes += header_len + msg_len;
+  *consumed = TRUE;
+
+  if (_is_batch_full(self))
+    return log_proto_text_client_flush(s);
+  return LPS_SUCCESS;
 }
 
 
@@ -153,6 +351,9 @@ log_proto_text_client_post(LogProtoClient *s, LogMessage *logmsg, guchar *msg, g
 {
   LogProtoTextClient *self = (LogProtoTextClient *) s;
 
+  if (self->batch)
+    return log_proto_text_client_post_batched(s, NULL, 0, msg, msg_len, consumed);
+
   /* try to flush already buffered data */
   *consumed = FALSE;
   const LogProtoStatus status = log_proto_text_client_flush(s);
@@ -189,6 +390,12 @@ log_proto_text_client_free(LogProtoClient *s)
   if (self->partial_free)
     self->partial_free(self->partial);
   self->partial = NULL;
+  if (self->batch)
+    {
+      for (guint i = 0; i < self->batch->len; i++)
+        g_free(g_array_index(self->batch, LogProtoTextClientBatchEntry, i).msg);
+      g_array_free(self->batch, TRUE);
+    }
   log_proto_client_free_method(s);
 };
 
@@ -204,6 +411,9 @@ log_proto_text_client_init(LogProtoTextClient *self, LogTransport *transport, co
   self->super.free_fn = log_proto_text_client_free;
   self->super.transport = transport;
   self->next_state = -1;
+  if (options->batch_lines > 0 || options->batch_bytes > 0)
+    self->batch = g_array_sized_new(FALSE, FALSE, sizeof(LogProtoTextClientBatchEntry),
+                                    MAX(options->batch_lines, 16));
 }
 
 LogProtoClient *
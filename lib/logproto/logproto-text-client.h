@@ -26,6 +26,16 @@
 
 #include "logproto-client.h"
 
+#define LOG_PROTO_TEXT_CLIENT_MAX_HEADER 16
+
+typedef struct _LogProtoTextClientBatchEntry
+{
+  guchar header[LOG_PROTO_TEXT_CLIENT_MAX_HEADER];
+  gsize header_len;
+  guchar *msg;
+  gsize msg_len;
+} LogProtoTextClientBatchEntry;
+
 typedef struct _LogProtoTextClient
 {
   LogProtoClient super;
@@ -33,10 +43,19 @@ typedef struct _LogProtoTextClient
   guchar *partial;
   GDestroyNotify partial_free;
   gsize partial_len, partial_pos;
+  /* the number of messages acknowledged once the partial buffer is written */
+  gint partial_messages;
+
+  /* messages waiting to be written by a single writev(), NULL unless
+   * batch-lines() or batch-bytes() is set */
+  GArray *batch;
+  gsize batch_bytes;
 } LogProtoTextClient;
 
 LogProtoStatus log_proto_text_client_submit_write(LogProtoClient *s, guchar *msg, gsize msg_len,
                                                   GDestroyNotify msg_free, gint next_state);
+LogProtoStatus log_proto_text_client_post_batched(LogProtoClient *s, const guchar *header, gsize header_len,
+                                                  guchar *msg, gsize msg_len, gboolean *consumed);
 void log_proto_text_client_init(LogProtoTextClient *self, LogTransport *transport,
                                 const LogProtoClientOptions *options);
 LogProtoClient *log_proto_text_client_new(LogTransport *transport, const LogProtoClientOptions *options);
@@ -306,6 +306,7 @@ log_proto_text_server_init(LogProtoTextServer *self, LogTransport *transport, co
   log_proto_buffered_server_init(&self->super, transport, options);
   self->super.super.prepare = log_proto_text_server_prepare_method;
   self->super.super.free_fn = log_proto_text_server_free;
+  self->super.super.fetch_batch = log_proto_buffered_server_fetch_batch;
   self->super.fetch_from_buffer = log_proto_text_server_fetch_from_buffer;
   self->super.flush = log_proto_text_server_flush;
   self->find_eom = find_eom;
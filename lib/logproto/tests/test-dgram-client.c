@@ -0,0 +1,119 @@
+/*
+ * Copyright (c) 2024 One Identity LLC.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#include <criterion/criterion.h>
+#include "libtest/mock-transport.h"
+
+#include "logproto/logproto-dgram-client.h"
+
+static gint acked_messages;
+
+static void
+_ack_callback(gint num_msg_acked, gpointer user_data)
+{
+  acked_messages += num_msg_acked;
+}
+
+static LogProtoClient *
+_construct_dgram_client(LogTransportMock **transport, LogProtoClientOptionsStorage *options)
+{
+  *transport = (LogTransportMock *) log_transport_mock_records_new(LTM_EOF);
+
+  log_proto_client_options_defaults(&options->super);
+  LogProtoClient *proto = log_proto_dgram_client_new((LogTransport *) *transport, &options->super);
+
+  LogProtoClientFlowControlFuncs flow_control_funcs =
+  {
+    .ack_callback = _ack_callback,
+  };
+  log_proto_client_set_client_flow_control(proto, &flow_control_funcs);
+  acked_messages = 0;
+  return proto;
+}
+
+static void
+_post_message(LogProtoClient *proto, const gchar *message)
+{
+  gboolean consumed = FALSE;
+
+  cr_assert_eq(log_proto_client_post(proto, NULL, (guchar *) g_strdup(message), strlen(message), &consumed),
+               LPS_SUCCESS);
+  cr_assert(consumed);
+}
+
+static void
+_assert_datagram(LogTransportMock *transport, const gchar *expected)
+{
+  gchar buf[128];
+  gssize len = log_transport_mock_read_chunk_from_write_buffer(transport, buf);
+
+  cr_assert_eq(len, strlen(expected));
+  cr_assert(memcmp(buf, expected, len) == 0);
+}
+
+Test(log_proto, test_log_proto_dgram_client_sends_posted_messages_as_separate_datagrams_on_flush)
+{
+  LogProtoClientOptionsStorage options;
+  LogTransportMock *transport;
+  LogProtoClient *proto = _construct_dgram_client(&transport, &options);
+  gchar buf[128];
+
+  _post_message(proto, "message1");
+  _post_message(proto, "message2");
+  _post_message(proto, "message3");
+
+  cr_assert_eq(log_transport_mock_read_from_write_buffer(transport, buf, sizeof(buf)), 0,
+               "messages should not be sent before flush");
+  cr_assert_eq(acked_messages, 0);
+
+  cr_assert_eq(log_proto_client_flush(proto), LPS_SUCCESS);
+  cr_assert_eq(acked_messages, 3);
+
+  _assert_datagram(transport, "message1");
+  _assert_datagram(transport, "message2");
+  _assert_datagram(transport, "message3");
+
+  log_proto_client_free(proto);
+}
+
+Test(log_proto, test_log_proto_dgram_client_flushes_a_full_batch_on_post)
+{
+  LogProtoClientOptionsStorage options;
+  LogTransportMock *transport;
+  LogProtoClient *proto = _construct_dgram_client(&transport, &options);
+  gint i;
+
+  for (i = 0; i < 100; i++)
+    _post_message(proto, "message");
+
+  cr_assert_gt(acked_messages, 0, "a full batch should be sent without waiting for flush");
+  cr_assert_lt(acked_messages, 100);
+
+  cr_assert_eq(log_proto_client_flush(proto), LPS_SUCCESS);
+  cr_assert_eq(acked_messages, 100);
+
+  for (i = 0; i < 100; i++)
+    _assert_datagram(transport, "message");
+
+  log_proto_client_free(proto);
+}
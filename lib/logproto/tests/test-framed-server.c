@@ -30,6 +30,7 @@
 #include "logproto/logproto-framed-server.h"
 
 #include <errno.h>
+#include <stdio.h>
 
 Test(log_proto, test_log_proto_framed_server_simple_messages)
 {
@@ -281,3 +282,85 @@ Test(log_proto, test_log_proto_framed_server_multi_read)
 
   /* NOTE: LPBS_NOMREAD is not implemented for framed protocol */
 }
+
+Test(log_proto, test_log_proto_framed_server_large_frame_is_read_directly)
+{
+  LogProtoServer *proto;
+  GString *frame = g_string_new("20000 ");
+
+  for (gint i = 0; i < 20000; i++)
+    g_string_append_c(frame, 'a' + (i % 26));
+
+  proto_server_options.max_msg_size = 32768;
+  proto = log_proto_framed_server_new(
+            log_transport_mock_records_new(
+              frame->str, 1000,
+              frame->str + 1000, frame->len - 1000,
+              "4 abcd", -1,
+              LTM_EOF),
+            get_inited_proto_server_options());
+  assert_proto_server_fetch(proto, frame->str + 6, 20000);
+
+  GBytes *input_chunk = log_proto_server_steal_input_chunk(proto);
+  cr_assert_not_null(input_chunk, "large frames should be handed over as an input chunk");
+  cr_assert_eq(g_bytes_get_size(input_chunk), 20000);
+  cr_assert_arr_eq(g_bytes_get_data(input_chunk, NULL), frame->str + 6, 20000);
+  g_bytes_unref(input_chunk);
+
+  assert_proto_server_fetch(proto, "abcd", -1);
+  cr_assert_null(log_proto_server_steal_input_chunk(proto), "small frames are returned from the buffer");
+  assert_proto_server_fetch_failure(proto, LPS_EOF, NULL);
+  log_proto_server_free(proto);
+  g_string_free(frame, TRUE);
+}
+
+/*
+ * Throughput of the framed server for a range of frame sizes, frames above
+ * the direct read threshold are read straight into their own buffer.
+ */
+#define FRAMED_PERF_INPUT_SIZE (16 * 1024 * 1024)
+
+static void
+_run_framed_server_benchmark(gsize frame_len)
+{
+  GString *input = g_string_sized_new(FRAMED_PERF_INPUT_SIZE + frame_len);
+  gsize frames = 0;
+
+  while (input->len < FRAMED_PERF_INPUT_SIZE)
+    {
+      g_string_append_printf(input, "%" G_GSIZE_FORMAT " ", frame_len);
+      for (gsize i = 0; i < frame_len; i++)
+        g_string_append_c(input, 'a' + (i % 26));
+      frames++;
+    }
+
+  proto_server_options.max_msg_size = 2 * 1024 * 1024;
+  LogProtoServer *proto = log_proto_framed_server_new(
+                            log_transport_mock_records_new(input->str, input->len, LTM_EOF),
+                            get_inited_proto_server_options());
+
+  gint64 start = g_get_monotonic_time();
+  for (gsize i = 0; i < frames; i++)
+    {
+      const guchar *msg = NULL;
+      gsize msg_len = 0;
+
+      cr_assert_eq(proto_server_fetch(proto, &msg, &msg_len), LPS_SUCCESS);
+      cr_assert_eq(msg_len, frame_len);
+    }
+  gint64 end = g_get_monotonic_time();
+
+  printf("      %8" G_GSIZE_FORMAT " byte frames, speed: %12.3f MB/sec\n", frame_len,
+         (gdouble) input->len / (end - start));
+
+  log_proto_server_free(proto);
+  g_string_free(input, TRUE);
+}
+
+Test(log_proto, test_log_proto_framed_server_throughput)
+{
+  gsize frame_sizes[] = { 100, 1024, 8192, 65536, 1024 * 1024 };
+
+  for (gint i = 0; i < G_N_ELEMENTS(frame_sizes); i++)
+    _run_framed_server_benchmark(frame_sizes[i]);
+}
@@ -0,0 +1,122 @@
+/*
+ * Copyright (c) 2024 One Identity LLC.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#include <criterion/criterion.h>
+#include "libtest/mock-transport.h"
+
+#include "logproto/logproto-text-client.h"
+#include "logproto/logproto-framed-client.h"
+
+static gint acked_messages;
+
+static void
+_ack_callback(gint num_msg_acked, gpointer user_data)
+{
+  acked_messages += num_msg_acked;
+}
+
+static LogProtoClient *
+_construct_client(LogProtoClient *(*construct)(LogTransport *, const LogProtoClientOptions *),
+                  LogTransportMock **transport, LogProtoClientOptionsStorage *options, gint batch_lines)
+{
+  *transport = (LogTransportMock *) log_transport_mock_stream_new(LTM_EOF);
+
+  log_proto_client_options_defaults(&options->super);
+  log_proto_client_options_set_batch_lines(&options->super, batch_lines);
+  LogProtoClient *proto = construct((LogTransport *) *transport, &options->super);
+
+  LogProtoClientFlowControlFuncs flow_control_funcs =
+  {
+    .ack_callback = _ack_callback,
+  };
+  log_proto_client_set_client_flow_control(proto, &flow_control_funcs);
+  acked_messages = 0;
+  return proto;
+}
+
+static void
+_post_message(LogProtoClient *proto, const gchar *message)
+{
+  gboolean consumed = FALSE;
+
+  cr_assert_eq(log_proto_client_post(proto, NULL, (guchar *) g_strdup(message), strlen(message), &consumed),
+               LPS_SUCCESS);
+  cr_assert(consumed);
+}
+
+static void
+_assert_written(LogTransportMock *transport, const gchar *expected)
+{
+  gchar buf[256];
+  gsize len = log_transport_mock_read_from_write_buffer(transport, buf, sizeof(buf));
+
+  cr_assert_eq(len, strlen(expected), "written: %.*s", (gint) len, buf);
+  cr_assert(memcmp(buf, expected, len) == 0, "written: %.*s", (gint) len, buf);
+}
+
+Test(log_proto, test_log_proto_framed_client_batches_messages_into_a_single_write)
+{
+  LogProtoClientOptionsStorage options;
+  LogTransportMock *transport;
+  LogProtoClient *proto = _construct_client(log_proto_framed_client_new, &transport, &options, 3);
+
+  _post_message(proto, "message1");
+  _post_message(proto, "message2");
+  cr_assert_eq(acked_messages, 0, "messages should not be sent before the batch is full");
+  _assert_written(transport, "");
+
+  _post_message(proto, "message3");
+  cr_assert_eq(acked_messages, 3);
+  _assert_written(transport, "8 message18 message28 message3");
+
+  _post_message(proto, "msg4");
+  cr_assert_eq(log_proto_client_flush(proto), LPS_SUCCESS);
+  cr_assert_eq(acked_messages, 4);
+  _assert_written(transport, "4 msg4");
+
+  log_proto_client_free(proto);
+}
+
+Test(log_proto, test_log_proto_text_client_batch_survives_partial_writes)
+{
+  LogProtoClientOptionsStorage options;
+  LogTransportMock *transport;
+  LogProtoClient *proto = _construct_client(log_proto_text_client_new, &transport, &options, 100);
+
+  log_transport_mock_set_write_chunk_limit(transport, 5);
+
+  _post_message(proto, "message1\n");
+  _post_message(proto, "message2\n");
+  _post_message(proto, "message3\n");
+
+  /* each flush writes the head of the batch and the rest of the cut message */
+  for (gint i = 1; i <= 3; i++)
+    {
+      cr_assert_eq(log_proto_client_flush(proto), LPS_SUCCESS);
+      cr_assert_eq(acked_messages, i, "only completely written messages should be acked");
+    }
+
+  _assert_written(transport, "message1\nmessage2\nmessage3\n");
+
+  log_proto_client_free(proto);
+}
@@ -29,9 +29,11 @@
 #include "libtest/grab-logging.h"
 
 #include "logproto/logproto-text-server.h"
+#include "logproto/logproto-buffer-pool.h"
 #include "ack-tracker/ack_tracker_factory.h"
 
 #include <errno.h>
+#include <string.h>
 
 
 static gint accumulate_seq;
@@ -674,3 +676,136 @@ Test(log_proto, buffer_split_with_encoding_and_position_tracking)
   g_string_free(data_smaller, TRUE);
   g_string_free(data, TRUE);
 }
+
+static void
+_assert_fetch_batch(LogProtoServer *proto, gint max_slices, const gchar **expected_msgs)
+{
+  LogProtoServerFetchSlice slices[8];
+  LogProtoServerFetchBatch batch = { .slices = slices, .max_slices = max_slices };
+  LogTransportAuxData aux;
+  gboolean may_read = TRUE;
+  gint expected_count = g_strv_length((gchar **) expected_msgs);
+
+  log_transport_aux_data_init(&aux);
+  batch.aux = &aux;
+  cr_assert_eq(log_proto_server_fetch_batch(proto, &batch, &may_read), LPS_SUCCESS);
+  cr_assert_eq(batch.num_slices, expected_count);
+
+  for (gint i = 0; i < expected_count; i++)
+    {
+      cr_assert_eq(slices[i].msg_len, strlen(expected_msgs[i]));
+      cr_assert_arr_eq(slices[i].msg, expected_msgs[i], slices[i].msg_len);
+    }
+  log_transport_aux_data_destroy(&aux);
+}
+
+Test(log_proto, test_log_proto_text_server_fetch_batch)
+{
+  LogProtoServer *proto;
+
+  proto = construct_test_proto(
+            log_transport_mock_records_new(
+              "foo\n"
+              "bar\n"
+              "baz\n"
+              "ba", -1,
+              "z\n", -1,
+              LTM_EOF));
+
+  cr_assert(log_proto_server_is_fetch_batch_supported(proto));
+
+  /* the batch is limited to max_slices */
+  _assert_fetch_batch(proto, 2, (const gchar *[]) { "foo", "bar", NULL });
+
+  /* the batch ends at the partial line, without reading further input */
+  _assert_fetch_batch(proto, 8, (const gchar *[]) { "baz", NULL });
+  _assert_fetch_batch(proto, 8, (const gchar *[]) { "baz", NULL });
+
+  assert_proto_server_fetch_failure(proto, LPS_EOF, NULL);
+  log_proto_server_free(proto);
+}
+
+Test(log_proto, test_log_proto_text_server_adaptive_buffer)
+{
+  LogProtoServer *proto;
+  GString *long_line = g_string_new("");
+
+  for (gint i = 0; i < 20000; i++)
+    g_string_append_c(long_line, 'a' + (i % 26));
+  g_string_append_c(long_line, '\n');
+
+  proto_server_options.max_msg_size = 32768;
+  proto = log_proto_text_server_new(
+            log_transport_mock_records_new(
+              "01234567\n", -1,
+              LTM_INJECT_ERROR(EAGAIN),
+              long_line->str, long_line->len,
+              LTM_INJECT_ERROR(EAGAIN),
+              LTM_EOF),
+            get_inited_proto_server_options());
+
+  LogProtoBufferedServer *buffered = (LogProtoBufferedServer *) proto;
+  LogProtoBufferedServerState *state = log_proto_buffered_server_get_state(buffered);
+
+  assert_proto_server_fetch(proto, "01234567", -1);
+  cr_assert_eq(state->buffer_size, LOG_PROTO_BUFFER_POOL_MIN_SIZE, "connections should start with a small buffer");
+
+  /* idle connections return their buffer to the pool */
+  Bookmark bookmark;
+  LogTransportAuxData aux;
+  gboolean may_read = TRUE;
+  const guchar *msg = NULL;
+  gsize msg_len;
+  gsize pooled_bytes = log_proto_buffer_pool_get_pooled_bytes();
+
+  log_transport_aux_data_init(&aux);
+  cr_assert_eq(log_proto_server_fetch(proto, &msg, &msg_len, &may_read, &aux, &bookmark), LPS_AGAIN);
+  cr_assert_null(buffered->buffer);
+  cr_assert_eq(log_proto_buffer_pool_get_pooled_bytes(), pooled_bytes + LOG_PROTO_BUFFER_POOL_MIN_SIZE);
+
+  /* bursts grow the buffer as needed */
+  long_line->str[long_line->len - 1] = 0;
+  assert_proto_server_fetch(proto, long_line->str, long_line->len - 1);
+  cr_assert_eq(state->buffer_size, 32768);
+
+  log_proto_server_free(proto);
+  g_string_free(long_line, TRUE);
+}
+
+Test(log_proto, test_log_proto_text_server_shared_buffer_is_not_overwritten)
+{
+  LogProtoServer *proto;
+
+  proto = construct_test_proto(
+            log_transport_mock_records_new(
+              "foo\n"
+              "ba", -1,
+              "r\n", -1,
+              "baz\n", -1,
+              LTM_EOF));
+
+  Bookmark bookmark;
+  LogTransportAuxData aux;
+  gboolean may_read = TRUE;
+  const guchar *msg = NULL;
+  gsize msg_len;
+
+  log_transport_aux_data_init(&aux);
+  cr_assert_eq(log_proto_server_fetch(proto, &msg, &msg_len, &may_read, &aux, &bookmark), LPS_SUCCESS);
+  cr_assert_arr_eq(msg, "foo", 3);
+
+  GBytes *input_chunk = log_proto_server_steal_input_chunk(proto);
+  gsize chunk_len;
+  const guchar *chunk = g_bytes_get_data(input_chunk, &chunk_len);
+  cr_assert(msg >= chunk && msg + msg_len <= chunk + chunk_len, "the message should point into the shared buffer");
+  const guchar *foo = msg;
+
+  /* moving the partial line and reading new input must not touch the shared buffer */
+  assert_proto_server_fetch(proto, "bar", -1);
+  assert_proto_server_fetch(proto, "baz", -1);
+  cr_assert_arr_eq(foo, "foo\nba", 6);
+
+  g_bytes_unref(input_chunk);
+  assert_proto_server_fetch_failure(proto, LPS_EOF, NULL);
+  log_proto_server_free(proto);
+}
@@ -119,11 +119,14 @@ iv_list_update_msg_size(LogQueueFifo *self, struct iv_list_head *head)
 {
   LogMessage *msg;
   struct iv_list_head *ilh, *ilh2;
+  gsize memory_usage = 0;
+
   iv_list_for_each_safe(ilh, ilh2, head)
   {
     msg = iv_list_entry(ilh, LogMessageQueueNode, list)->msg;
-    log_queue_memory_usage_add(&self->super, log_msg_get_size(msg));
+    memory_usage += log_msg_get_size(msg);
   }
+  log_queue_memory_usage_add(&self->super, memory_usage);
 }
 
 static gint64
@@ -300,10 +303,19 @@ log_queue_fifo_move_input(gpointer user_data)
   return NULL;
 }
 
+static inline gboolean
+_message_exceeds_memory_budget(const LogPathOptions *path_options)
+{
+  return !path_options->flow_control_requested && log_queue_is_global_memory_budget_exhausted();
+}
+
 /* lock must be held */
 static inline gboolean
 _message_has_to_be_dropped(LogQueueFifo *self, const LogPathOptions *path_options)
 {
+  if (_message_exceeds_memory_budget(path_options))
+    return TRUE;
+
   if (G_UNLIKELY(self->use_legacy_fifo_size))
     return log_queue_fifo_get_length(&self->super) >= self->log_fifo_size;
 
@@ -323,6 +335,85 @@ _drop_message(LogMessage *msg, const LogPathOptions *path_options)
   log_msg_drop(msg, path_options, AT_PROCESSED);
 }
 
+static inline void
+_drop_message_on_full_queue(LogQueueFifo *self, LogMessage *msg, const LogPathOptions *path_options)
+{
+  _drop_message(msg, path_options);
+
+  msg_debug("Destination queue full, dropping message",
+            evt_tag_int("queue_len", log_queue_fifo_get_length(&self->super)),
+            evt_tag_int("log_fifo_size", self->log_fifo_size),
+            evt_tag_long("global_memory_usage", log_queue_get_global_memory_usage()),
+            evt_tag_str("persist_name", self->super.persist_name));
+}
+
+static inline gint
+_get_input_queue_index(LogQueueFifo *self)
+{
+  gint thread_index = main_loop_worker_get_thread_index();
+
+  /* if this thread has an ID than the number of input queues we have (due
+   * to a config change), handle the load via the slow path */
+
+  if (thread_index >= self->num_input_queues)
+    return -1;
+  return thread_index;
+}
+
+static inline void
+_register_input_queue_callback(LogQueueFifo *self, gint thread_index)
+{
+  if (!self->input_queues[thread_index].finish_cb_registered)
+    {
+      /* this is the first item in the input FIFO, register a finish
+       * callback to make sure it gets moved to the wait_queue if the
+       * input thread finishes
+       * One reference should be held, while the callback is registered
+       * avoiding use-after-free situation
+       */
+
+      main_loop_worker_register_batch_callback(&self->input_queues[thread_index].cb);
+      self->input_queues[thread_index].finish_cb_registered = TRUE;
+      log_queue_ref(&self->super);
+    }
+}
+
+/* NOTE: It consumes the reference passed by the caller. */
+static inline void
+_push_tail_input_queue(LogQueueFifo *self, gint thread_index, LogMessage *msg, const LogPathOptions *path_options)
+{
+  LogMessageQueueNode *node;
+
+  log_msg_write_protect(msg);
+  node = log_msg_alloc_queue_node(msg, path_options);
+  iv_list_add_tail(&node->list, &self->input_queues[thread_index].items);
+  self->input_queues[thread_index].len++;
+
+  if (!path_options->flow_control_requested)
+    self->input_queues[thread_index].non_flow_controlled_len++;
+
+  log_msg_unref(msg);
+}
+
+/* lock must be held, it consumes the reference passed by the caller */
+static inline void
+_push_tail_wait_queue(LogQueueFifo *self, LogMessage *msg, const LogPathOptions *path_options)
+{
+  LogMessageQueueNode *node;
+
+  log_msg_write_protect(msg);
+  node = log_msg_alloc_queue_node(msg, path_options);
+
+  iv_list_add_tail(&node->list, &self->wait_queue.items);
+  self->wait_queue.len++;
+
+  if (!path_options->flow_control_requested)
+    self->wait_queue.non_flow_controlled_len++;
+
+  /* the node holds a reference of its own */
+  log_msg_unref(msg);
+}
+
 /**
  * Assumed to be called from one of the input threads. If the thread_index
  * cannot be determined, the item is put directly in the wait queue.
@@ -338,16 +429,7 @@ static void
 log_queue_fifo_push_tail(LogQueue *s, LogMessage *msg, const LogPathOptions *path_options)
 {
   LogQueueFifo *self = (LogQueueFifo *) s;
-  gint thread_index;
-  LogMessageQueueNode *node;
-
-  thread_index = main_loop_worker_get_thread_index();
-
-  /* if this thread has an ID than the number of input queues we have (due
-   * to a config change), handle the load via the slow path */
-
-  if (thread_index >= self->num_input_queues)
-    thread_index = -1;
+  gint thread_index = _get_input_queue_index(self);
 
   /* NOTE: we don't use high-water marks for now, as log_fetch_limit
    * limits the number of items placed on the per-thread input queue
@@ -362,30 +444,16 @@ log_queue_fifo_push_tail(LogQueue *s, LogMessage *msg, const LogPathOptions *pat
 
   if (thread_index >= 0)
     {
-      /* fastpath, use per-thread input FIFOs */
-      if (!self->input_queues[thread_index].finish_cb_registered)
+      if (_message_exceeds_memory_budget(path_options))
         {
-          /* this is the first item in the input FIFO, register a finish
-           * callback to make sure it gets moved to the wait_queue if the
-           * input thread finishes
-           * One reference should be held, while the callback is registered
-           * avoiding use-after-free situation
-           */
-
-          main_loop_worker_register_batch_callback(&self->input_queues[thread_index].cb);
-          self->input_queues[thread_index].finish_cb_registered = TRUE;
-          log_queue_ref(&self->super);
+          log_queue_dropped_messages_inc(&self->super);
+          _drop_message_on_full_queue(self, msg, path_options);
+          return;
         }
 
-      log_msg_write_protect(msg);
-      node = log_msg_alloc_queue_node(msg, path_options);
-      iv_list_add_tail(&node->list, &self->input_queues[thread_index].items);
-      self->input_queues[thread_index].len++;
-
-      if (!path_options->flow_control_requested)
-        self->input_queues[thread_index].non_flow_controlled_len++;
-
-      log_msg_unref(msg);
+      /* fastpath, use per-thread input FIFOs */
+      _register_input_queue_callback(self, thread_index);
+      _push_tail_input_queue(self, thread_index, msg, path_options);
       return;
     }
 
@@ -398,31 +466,78 @@ log_queue_fifo_push_tail(LogQueue *s, LogMessage *msg, const LogPathOptions *pat
       log_queue_dropped_messages_inc(&self->super);
       g_mutex_unlock(&self->super.lock);
 
-      _drop_message(msg, path_options);
-
-      msg_debug("Destination queue full, dropping message",
-                evt_tag_int("queue_len", log_queue_fifo_get_length(&self->super)),
-                evt_tag_int("log_fifo_size", self->log_fifo_size),
-                evt_tag_str("persist_name", self->super.persist_name));
+      _drop_message_on_full_queue(self, msg, path_options);
       return;
     }
 
-  log_msg_write_protect(msg);
-  node = log_msg_alloc_queue_node(msg, path_options);
-
-  iv_list_add_tail(&node->list, &self->wait_queue.items);
-  self->wait_queue.len++;
-
-  if (!path_options->flow_control_requested)
-    self->wait_queue.non_flow_controlled_len++;
+  gsize msg_size = log_msg_get_size(msg);
+  _push_tail_wait_queue(self, msg, path_options);
 
   log_queue_push_notify(&self->super);
   log_queue_queued_messages_inc(&self->super);
 
-  log_queue_memory_usage_add(&self->super, log_msg_get_size(msg));
+  log_queue_memory_usage_add(&self->super, msg_size);
   g_mutex_unlock(&self->super.lock);
+}
 
-  log_msg_unref(msg);
+/*
+ * Same as log_queue_fifo_push_tail(), but the lock is taken and the
+ * counters are updated once for the whole batch on the slow path.
+ */
+static void
+log_queue_fifo_push_tail_batch(LogQueue *s, LogMessage **msgs, const LogPathOptions *path_options, gint num_msgs)
+{
+  LogQueueFifo *self = (LogQueueFifo *) s;
+  gint thread_index = _get_input_queue_index(self);
+
+  if (num_msgs == 0)
+    return;
+
+  if (thread_index >= 0)
+    {
+      _register_input_queue_callback(self, thread_index);
+      for (gint i = 0; i < num_msgs; i++)
+        {
+          if (_message_exceeds_memory_budget(&path_options[i]))
+            {
+              log_queue_dropped_messages_inc(&self->super);
+              _drop_message_on_full_queue(self, msgs[i], &path_options[i]);
+              continue;
+            }
+          _push_tail_input_queue(self, thread_index, msgs[i], &path_options[i]);
+        }
+      return;
+    }
+
+  gint num_queued = 0;
+  gsize memory_usage = 0;
+
+  g_mutex_lock(&self->super.lock);
+  for (gint i = 0; i < num_msgs; i++)
+    {
+      if (_message_has_to_be_dropped(self, &path_options[i]))
+        {
+          log_queue_dropped_messages_inc(&self->super);
+          g_mutex_unlock(&self->super.lock);
+
+          _drop_message_on_full_queue(self, msgs[i], &path_options[i]);
+
+          g_mutex_lock(&self->super.lock);
+          continue;
+        }
+
+      memory_usage += log_msg_get_size(msgs[i]);
+      _push_tail_wait_queue(self, msgs[i], &path_options[i]);
+      num_queued++;
+    }
+
+  if (num_queued > 0)
+    {
+      log_queue_push_notify(&self->super);
+      log_queue_queued_messages_add(&self->super, num_queued);
+      log_queue_memory_usage_add(&self->super, memory_usage);
+    }
+  g_mutex_unlock(&self->super.lock);
 }
 
 /*
@@ -463,6 +578,40 @@ log_queue_fifo_peek_head(LogQueue *s)
   return msg;
 }
 
+/*
+ * Can only run from the output thread, the output queue must not be empty.
+ *
+ * Moves the head of the output queue to the backlog, the stats counters are
+ * left for the caller to update.
+ */
+static inline LogMessage *
+_pop_output_queue_head(LogQueueFifo *self, LogPathOptions *path_options)
+{
+  LogMessageQueueNode *node;
+  LogMessage *msg;
+
+  node = iv_list_entry(self->output_queue.items.next, LogMessageQueueNode, list);
+
+  msg = node->msg;
+  path_options->ack_needed = node->ack_needed;
+  self->output_queue.len--;
+
+  if (!node->flow_control_requested)
+    self->output_queue.non_flow_controlled_len--;
+
+  iv_list_del_init(&node->list);
+
+  /* push to backlog */
+  log_msg_ref(msg);
+  iv_list_add_tail(&node->list, &self->backlog_queue.items);
+  self->backlog_queue.len++;
+
+  if (!node->flow_control_requested)
+    self->backlog_queue.non_flow_controlled_len++;
+
+  return msg;
+}
+
 /*
  * Can only run from the output thread.
  *
@@ -472,26 +621,12 @@ static LogMessage *
 log_queue_fifo_pop_head(LogQueue *s, LogPathOptions *path_options)
 {
   LogQueueFifo *self = (LogQueueFifo *) s;
-  LogMessageQueueNode *node;
   LogMessage *msg = NULL;
 
   if (self->output_queue.len == 0)
     _move_items_from_wait_queue_to_output_queue(self);
 
-  if (self->output_queue.len > 0)
-    {
-      node = iv_list_entry(self->output_queue.items.next, LogMessageQueueNode, list);
-
-      msg = node->msg;
-      path_options->ack_needed = node->ack_needed;
-      self->output_queue.len--;
-
-      if (!node->flow_control_requested)
-        self->output_queue.non_flow_controlled_len--;
-
-      iv_list_del_init(&node->list);
-    }
-  else
+  if (self->output_queue.len == 0)
     {
       /* no items either on the wait queue nor the output queue.
        *
@@ -503,18 +638,89 @@ log_queue_fifo_pop_head(LogQueue *s, LogPathOptions *path_options)
        */
       return NULL;
     }
+
+  msg = _pop_output_queue_head(self, path_options);
+
   log_queue_queued_messages_dec(&self->super);
   log_queue_memory_usage_sub(&self->super, log_msg_get_size(msg));
 
-  /* push to backlog */
-  log_msg_ref(msg);
-  iv_list_add_tail(&node->list, &self->backlog_queue.items);
-  self->backlog_queue.len++;
+  return msg;
+}
 
-  if (!node->flow_control_requested)
-    self->backlog_queue.non_flow_controlled_len++;
+/*
+ * Can only run from the output thread.
+ *
+ * NOTE: the returned messages are references which the caller must take care to free.
+ */
+static gint
+log_queue_fifo_pop_head_batch(LogQueue *s, LogMessage **msgs, LogPathOptions *path_options, gint max_msgs)
+{
+  LogQueueFifo *self = (LogQueueFifo *) s;
+  gint num_msgs = 0;
+  gsize memory_usage = 0;
 
-  return msg;
+  while (num_msgs < max_msgs)
+    {
+      if (self->output_queue.len == 0)
+        {
+          _move_items_from_wait_queue_to_output_queue(self);
+          if (self->output_queue.len == 0)
+            break;
+        }
+
+      LogMessage *msg = _pop_output_queue_head(self, &path_options[num_msgs]);
+
+      memory_usage += log_msg_get_size(msg);
+      msgs[num_msgs++] = msg;
+    }
+
+  if (num_msgs > 0)
+    {
+      log_queue_queued_messages_sub(&self->super, num_msgs);
+      log_queue_memory_usage_sub(&self->super, memory_usage);
+    }
+  return num_msgs;
+}
+
+/*
+ * Can run from any thread: only the wait queue is touched, which is
+ * protected by the lock, as the output queue belongs to the output thread.
+ */
+static gint
+log_queue_fifo_steal_tail_batch(LogQueue *s, LogMessage **msgs, LogPathOptions *path_options, gint max_msgs)
+{
+  LogQueueFifo *self = (LogQueueFifo *) s;
+  gsize memory_usage = 0;
+
+  g_mutex_lock(&self->super.lock);
+
+  gint num_msgs = MIN(max_msgs, self->wait_queue.len);
+  for (gint i = num_msgs - 1; i >= 0; i--)
+    {
+      LogMessageQueueNode *node = iv_list_entry(self->wait_queue.items.prev, LogMessageQueueNode, list);
+      iv_list_del_init(&node->list);
+      self->wait_queue.len--;
+
+      if (!node->flow_control_requested)
+        self->wait_queue.non_flow_controlled_len--;
+
+      path_options[i] = (LogPathOptions) LOG_PATH_OPTIONS_INIT;
+      path_options[i].ack_needed = node->ack_needed;
+      path_options[i].flow_control_requested = node->flow_control_requested;
+      msgs[i] = node->msg;
+      log_msg_free_queue_node(node);
+
+      memory_usage += log_msg_get_size(msgs[i]);
+    }
+
+  if (num_msgs > 0)
+    {
+      log_queue_queued_messages_sub(&self->super, num_msgs);
+      log_queue_memory_usage_sub(&self->super, memory_usage);
+    }
+
+  g_mutex_unlock(&self->super.lock);
+  return num_msgs;
 }
 
 /*
@@ -541,9 +747,8 @@ log_queue_fifo_ack_backlog(LogQueue *s, gint rewind_count)
         self->backlog_queue.non_flow_controlled_len--;
 
       path_options.ack_needed = node->ack_needed;
-      log_msg_ack(msg, &path_options, AT_PROCESSED);
       log_msg_free_queue_node(node);
-      log_msg_unref(msg);
+      log_msg_drop(msg, &path_options, AT_PROCESSED);
     }
 }
 
@@ -666,11 +871,14 @@ log_queue_fifo_new(gint log_fifo_size, const gchar *persist_name, gint stats_lev
   self->super.is_empty_racy = log_queue_fifo_is_empty_racy;
   self->super.keep_on_reload = log_queue_fifo_keep_on_reload;
   self->super.push_tail = log_queue_fifo_push_tail;
+  self->super.push_tail_batch = log_queue_fifo_push_tail_batch;
   self->super.pop_head = log_queue_fifo_pop_head;
+  self->super.pop_head_batch = log_queue_fifo_pop_head_batch;
   self->super.peek_head = log_queue_fifo_peek_head;
   self->super.ack_backlog = log_queue_fifo_ack_backlog;
   self->super.rewind_backlog = log_queue_fifo_rewind_backlog;
   self->super.rewind_backlog_all = log_queue_fifo_rewind_backlog_all;
+  self->super.steal_tail_batch = log_queue_fifo_steal_tail_batch;
 
   self->super.free_fn = log_queue_fifo_free;
 
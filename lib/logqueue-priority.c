@@ -0,0 +1,373 @@
+/*
+ * Copyright (c) 2024 One Identity LLC.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#include "logqueue-priority.h"
+#include "logqueue-fifo.h"
+#include "scratch-buffers.h"
+
+QueueType log_queue_priority_type = "PRIORITY";
+
+/*
+ * LogQueuePriority is a memory queue made of multiple lanes, so that
+ * important messages (e.g. security alerts) can overtake bulk traffic when
+ * the destination is backed up.
+ *
+ * Each lane is a LogQueueFifo of its own, with its own log_fifo_size() and
+ * stats counters (labelled with the index of the lane), so all the
+ * flow-control and drop bookkeeping of LogQueueFifo applies to the lanes
+ * unchanged.  Messages are classified by the lane key template, which is
+ * expected to expand to the index of the lane; anything else (including
+ * out of range indexes) is put to the last lane.
+ *
+ * The consumer drains the lanes with weighted round robin: each lane can
+ * deliver "weight" messages per round, lanes with a lower index are served
+ * first within a round, and a new round starts once none of the non-empty
+ * lanes has any credit left.
+ *
+ * Threading assumptions:
+ *   - the lanes are pushed by the input threads, the lanes notify the
+ *     queue (and through that the consumer) about new items
+ *   - the head of the queue (lane selection, backlog) is only manipulated
+ *     from the output thread
+ */
+
+typedef struct _LogQueuePriority LogQueuePriority;
+
+typedef struct _LogQueuePriorityLane
+{
+  LogQueuePriority *owner;
+  LogQueue *queue;
+  gint weight;
+
+  /* output thread only */
+  gint credit;
+} LogQueuePriorityLane;
+
+struct _LogQueuePriority
+{
+  LogQueue super;
+  LogTemplate *lane_key;
+
+  /* output thread only: the lane of each message on the backlog, in the order they were popped */
+  GQueue backlog_lanes;
+
+  gint num_lanes;
+  LogQueuePriorityLane lanes[0];
+};
+
+LogQueuePriorityLaneOptions *
+log_queue_priority_lane_options_new(void)
+{
+  LogQueuePriorityLaneOptions *self = g_new0(LogQueuePriorityLaneOptions, 1);
+
+  self->weight = 1;
+  self->log_fifo_size = -1;
+  return self;
+}
+
+void
+log_queue_priority_lane_options_free(LogQueuePriorityLaneOptions *self)
+{
+  g_free(self);
+}
+
+QueueType
+log_queue_priority_get_type(void)
+{
+  return log_queue_priority_type;
+}
+
+static gint64
+log_queue_priority_get_length(LogQueue *s)
+{
+  LogQueuePriority *self = (LogQueuePriority *) s;
+  gint64 length = 0;
+
+  for (gint i = 0; i < self->num_lanes; i++)
+    length += log_queue_get_length(self->lanes[i].queue);
+  return length;
+}
+
+static gboolean
+log_queue_priority_is_empty_racy(LogQueue *s)
+{
+  LogQueuePriority *self = (LogQueuePriority *) s;
+
+  for (gint i = 0; i < self->num_lanes; i++)
+    {
+      if (!log_queue_is_empty_racy(self->lanes[i].queue))
+        return FALSE;
+    }
+  return TRUE;
+}
+
+static gboolean
+log_queue_priority_keep_on_reload(LogQueue *s)
+{
+  LogQueuePriority *self = (LogQueuePriority *) s;
+
+  for (gint i = 0; i < self->num_lanes; i++)
+    {
+      if (log_queue_keep_on_reload(self->lanes[i].queue))
+        return TRUE;
+    }
+  return FALSE;
+}
+
+static LogQueuePriorityLane *
+_classify_message(LogQueuePriority *self, LogMessage *msg)
+{
+  LogQueuePriorityLane *last_lane = &self->lanes[self->num_lanes - 1];
+
+  if (!self->lane_key)
+    return &self->lanes[0];
+
+  ScratchBuffersMarker marker;
+  GString *buffer = scratch_buffers_alloc_and_mark(&marker);
+  LogTemplateEvalOptions options = DEFAULT_TEMPLATE_EVAL_OPTIONS;
+
+  log_template_format(self->lane_key, msg, &options, buffer);
+
+  gchar *end;
+  gint64 index = g_ascii_strtoll(buffer->str, &end, 10);
+  gboolean valid = end != buffer->str && *end == 0;
+
+  scratch_buffers_reclaim_marked(marker);
+
+  if (!valid || index < 0 || index >= self->num_lanes)
+    return last_lane;
+  return &self->lanes[index];
+}
+
+/* NOTE: It consumes the reference passed by the caller. */
+static void
+log_queue_priority_push_tail(LogQueue *s, LogMessage *msg, const LogPathOptions *path_options)
+{
+  LogQueuePriority *self = (LogQueuePriority *) s;
+  LogQueuePriorityLane *lane = _classify_message(self, msg);
+
+  log_queue_push_tail(lane->queue, msg, path_options);
+}
+
+static void
+_refill_credits(LogQueuePriority *self)
+{
+  for (gint i = 0; i < self->num_lanes; i++)
+    self->lanes[i].credit = self->lanes[i].weight;
+}
+
+/* output thread only */
+static LogQueuePriorityLane *
+_select_lane(LogQueuePriority *self)
+{
+  for (gint round = 0; round < 2; round++)
+    {
+      for (gint i = 0; i < self->num_lanes; i++)
+        {
+          LogQueuePriorityLane *lane = &self->lanes[i];
+
+          if (lane->credit > 0 && log_queue_get_length(lane->queue) > 0)
+            return lane;
+        }
+      _refill_credits(self);
+    }
+  return NULL;
+}
+
+static LogMessage *
+log_queue_priority_peek_head(LogQueue *s)
+{
+  LogQueuePriority *self = (LogQueuePriority *) s;
+  LogQueuePriorityLane *lane = _select_lane(self);
+
+  if (!lane)
+    return NULL;
+  return log_queue_peek_head(lane->queue);
+}
+
+/* NOTE: this returns a reference which the caller must take care to free. */
+static LogMessage *
+log_queue_priority_pop_head(LogQueue *s, LogPathOptions *path_options)
+{
+  LogQueuePriority *self = (LogQueuePriority *) s;
+  LogQueuePriorityLane *lane = _select_lane(self);
+
+  if (!lane)
+    return NULL;
+
+  LogMessage *msg = log_queue_pop_head_ignore_throttle(lane->queue, path_options);
+  if (!msg)
+    return NULL;
+
+  lane->credit--;
+  g_queue_push_tail(&self->backlog_lanes, lane);
+  return msg;
+}
+
+static void
+log_queue_priority_ack_backlog(LogQueue *s, gint num_msg_to_ack)
+{
+  LogQueuePriority *self = (LogQueuePriority *) s;
+
+  for (gint i = 0; i < num_msg_to_ack && !g_queue_is_empty(&self->backlog_lanes); i++)
+    {
+      LogQueuePriorityLane *lane = g_queue_pop_head(&self->backlog_lanes);
+      log_queue_ack_backlog(lane->queue, 1);
+    }
+}
+
+static void
+log_queue_priority_rewind_backlog(LogQueue *s, guint rewind_count)
+{
+  LogQueuePriority *self = (LogQueuePriority *) s;
+
+  for (guint i = 0; i < rewind_count && !g_queue_is_empty(&self->backlog_lanes); i++)
+    {
+      LogQueuePriorityLane *lane = g_queue_pop_tail(&self->backlog_lanes);
+      log_queue_rewind_backlog(lane->queue, 1);
+    }
+}
+
+static void
+log_queue_priority_rewind_backlog_all(LogQueue *s)
+{
+  LogQueuePriority *self = (LogQueuePriority *) s;
+
+  for (gint i = 0; i < self->num_lanes; i++)
+    log_queue_rewind_backlog_all(self->lanes[i].queue);
+  g_queue_clear(&self->backlog_lanes);
+}
+
+static void _arm_lane_notification(LogQueuePriorityLane *lane);
+
+/*
+ * Called by a lane once it has new items to consume, without holding the
+ * lane's lock.  The notification of the lanes is one-shot, so it is
+ * re-armed before passing the notification on to our consumer.
+ */
+static void
+_lane_push_notify(gpointer user_data)
+{
+  LogQueuePriorityLane *lane = (LogQueuePriorityLane *) user_data;
+  LogQueuePriority *self = lane->owner;
+
+  _arm_lane_notification(lane);
+
+  g_mutex_lock(&self->super.lock);
+  log_queue_push_notify(&self->super);
+  g_mutex_unlock(&self->super.lock);
+}
+
+static void
+_arm_lane_notification(LogQueuePriorityLane *lane)
+{
+  log_queue_set_parallel_push(lane->queue, _lane_push_notify, lane, NULL);
+}
+
+/*
+ * The queue is only freed once the input threads are done with it (just
+ * like LogQueueFifo asserts that it has no pending input batches), so no
+ * lane notification can be in flight at this point.
+ */
+static void
+log_queue_priority_free(LogQueue *s)
+{
+  LogQueuePriority *self = (LogQueuePriority *) s;
+
+  for (gint i = 0; i < self->num_lanes; i++)
+    {
+      log_queue_reset_parallel_push(self->lanes[i].queue);
+      log_queue_unref(self->lanes[i].queue);
+    }
+
+  g_queue_clear(&self->backlog_lanes);
+  log_template_unref(self->lane_key);
+  log_queue_free_method(s);
+}
+
+static void
+_init_lane(LogQueuePriority *self, gint index, LogQueuePriorityLaneOptions *options, gint log_fifo_size,
+           gint stats_level, StatsClusterKeyBuilder *driver_sck_builder, StatsClusterKeyBuilder *queue_sck_builder)
+{
+  LogQueuePriorityLane *lane = &self->lanes[index];
+
+  if (options && options->log_fifo_size > 0)
+    log_fifo_size = options->log_fifo_size;
+
+  if (queue_sck_builder)
+    {
+      gchar index_str[16];
+
+      g_snprintf(index_str, sizeof(index_str), "%d", index);
+      stats_cluster_key_builder_push(queue_sck_builder);
+      stats_cluster_key_builder_add_label(queue_sck_builder, stats_cluster_label("lane", index_str));
+    }
+
+  lane->owner = self;
+  lane->weight = options ? MAX(options->weight, 1) : 1;
+  lane->credit = lane->weight;
+  lane->queue = log_queue_fifo_new(log_fifo_size, self->super.persist_name, stats_level,
+                                   driver_sck_builder, queue_sck_builder);
+  _arm_lane_notification(lane);
+
+  if (queue_sck_builder)
+    stats_cluster_key_builder_pop(queue_sck_builder);
+}
+
+LogQueue *
+log_queue_priority_new(LogTemplate *lane_key, GList *lanes, gint log_fifo_size,
+                       const gchar *persist_name, gint stats_level,
+                       StatsClusterKeyBuilder *driver_sck_builder, StatsClusterKeyBuilder *queue_sck_builder)
+{
+  LogQueuePriority *self;
+  gint num_lanes = MAX(g_list_length(lanes), 1);
+
+  self = g_malloc0(sizeof(LogQueuePriority) + num_lanes * sizeof(self->lanes[0]));
+
+  /* the lanes register the counters, the queue itself only aggregates them */
+  log_queue_init_instance(&self->super, persist_name, stats_level, NULL, NULL);
+  self->super.type = log_queue_priority_type;
+  self->super.get_length = log_queue_priority_get_length;
+  self->super.is_empty_racy = log_queue_priority_is_empty_racy;
+  self->super.keep_on_reload = log_queue_priority_keep_on_reload;
+  self->super.push_tail = log_queue_priority_push_tail;
+  self->super.pop_head = log_queue_priority_pop_head;
+  self->super.peek_head = log_queue_priority_peek_head;
+  self->super.ack_backlog = log_queue_priority_ack_backlog;
+  self->super.rewind_backlog = log_queue_priority_rewind_backlog;
+  self->super.rewind_backlog_all = log_queue_priority_rewind_backlog_all;
+
+  self->super.free_fn = log_queue_priority_free;
+
+  self->lane_key = log_template_ref(lane_key);
+  g_queue_init(&self->backlog_lanes);
+
+  self->num_lanes = num_lanes;
+  for (gint i = 0; i < num_lanes; i++)
+    {
+      _init_lane(self, i, (LogQueuePriorityLaneOptions *) g_list_nth_data(lanes, i), log_fifo_size,
+                 stats_level, driver_sck_builder, queue_sck_builder);
+    }
+
+  return &self->super;
+}
@@ -0,0 +1,652 @@
+/*
+ * Copyright (c) 2024 One Identity LLC.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#include "logqueue-ring.h"
+#include "logpipe.h"
+#include "messages.h"
+#include "atomic-gssize.h"
+#include "mainloop-worker.h"
+
+#include <iv_list.h>
+
+QueueType log_queue_ring_type = "RING";
+
+/*
+ * LogQueueRing is an alternative to LogQueueFifo for destinations with a
+ * lot of input threads feeding a single output thread.
+ *
+ * Input threads put their messages directly into a bounded, lock-free
+ * multi-producer/single-consumer ring of LogMessageQueueNode pointers,
+ * which the output thread consumes without taking any locks.  The ring is
+ * a classic sequence-numbered array: every slot has a sequence number,
+ * which tells producers if the slot is free to be claimed for the current
+ * position of the tail, and the consumer if the slot has been published.
+ *
+ * The queue lock is only taken:
+ *
+ *   - once per input batch, to wake up the output thread (via the
+ *     per-thread batch callback, similarly to LogQueueFifo)
+ *
+ *   - if the ring is full, in which case messages are put to a locked
+ *     overflow list.  Once there is anything on the overflow list, new
+ *     messages also go there until the output thread drains it, so the
+ *     ordering of an input thread's messages is kept.
+ *
+ * The capacity of the ring is log_fifo_size rounded up to the next power
+ * of two.  Flow-controlled messages are never dropped and they can spill
+ * over to the overflow list, log_fifo_size() only limits the number of
+ * non-flow-controlled messages, just like with LogQueueFifo.
+ *
+ * Threading assumptions:
+ *   - the head of the queue (output, backlog, consuming the ring) is only
+ *     manipulated from the output thread
+ *   - the tail of the queue is only manipulated from the input threads
+ */
+
+#define LOG_QUEUE_RING_MIN_CAPACITY 64
+
+typedef struct _LogQueueRingSlot
+{
+  atomic_gssize sequence;
+  LogMessageQueueNode *node;
+} LogQueueRingSlot;
+
+typedef struct _LogQueueRingInput
+{
+  WorkerBatchCallback cb;
+  gboolean finish_cb_registered;
+} LogQueueRingInput;
+
+typedef struct _LogQueueRingList
+{
+  struct iv_list_head items;
+  gint len;
+  gint non_flow_controlled_len;
+} LogQueueRingList;
+
+typedef struct _LogQueueRing
+{
+  LogQueue super;
+
+  LogQueueRingSlot *slots;
+  gsize capacity;
+  gsize mask;
+
+  /* producer side, claimed by CAS */
+  atomic_gssize tail;
+
+  /* consumer side, only touched by the output thread */
+  gsize head;
+
+  /* number of messages in the ring and in the overflow list */
+  atomic_gssize len;
+  atomic_gssize non_flow_controlled_len;
+
+  /* protected by super.lock, overflow_len is also read without the lock by producers */
+  LogQueueRingList overflow;
+  atomic_gssize overflow_len;
+
+  /* output thread only: drained overflow items and rewound messages,
+   * these are consumed before the ring */
+  LogQueueRingList output;
+  LogQueueRingList backlog;
+
+  gint log_fifo_size;
+
+  gint num_inputs;
+  LogQueueRingInput inputs[0];
+} LogQueueRing;
+
+static gboolean
+_ring_push(LogQueueRing *self, LogMessageQueueNode *node)
+{
+  LogQueueRingSlot *slot;
+  gssize pos = atomic_gssize_get(&self->tail);
+
+  while (TRUE)
+    {
+      slot = &self->slots[pos & self->mask];
+      gssize diff = atomic_gssize_get(&slot->sequence) - pos;
+
+      if (diff == 0)
+        {
+          if (atomic_gssize_compare_and_exchange(&self->tail, pos, pos + 1))
+            break;
+        }
+      else if (diff < 0)
+        {
+          /* the slot still holds a message from the previous round: full */
+          return FALSE;
+        }
+      pos = atomic_gssize_get(&self->tail);
+    }
+
+  slot->node = node;
+  atomic_gssize_set(&slot->sequence, pos + 1);
+  return TRUE;
+}
+
+/* output thread only */
+static LogMessageQueueNode *
+_ring_peek(LogQueueRing *self)
+{
+  LogQueueRingSlot *slot = &self->slots[self->head & self->mask];
+
+  if (atomic_gssize_get(&slot->sequence) != (gssize) (self->head + 1))
+    return NULL;
+  return slot->node;
+}
+
+/* output thread only */
+static LogMessageQueueNode *
+_ring_pop(LogQueueRing *self)
+{
+  LogQueueRingSlot *slot = &self->slots[self->head & self->mask];
+  LogMessageQueueNode *node = _ring_peek(self);
+
+  if (!node)
+    return NULL;
+
+  slot->node = NULL;
+  atomic_gssize_set(&slot->sequence, self->head + self->capacity);
+  self->head++;
+  return node;
+}
+
+/* a producer may have claimed a slot without publishing it yet, this
+ * only returns TRUE if there is nothing claimed at all */
+static inline gboolean
+_ring_is_drained(LogQueueRing *self)
+{
+  return (gssize) self->head == atomic_gssize_get(&self->tail);
+}
+
+static inline void
+_list_add_len(LogQueueRingList *list, LogMessageQueueNode *node, gint diff)
+{
+  list->len += diff;
+  if (!node->flow_control_requested)
+    list->non_flow_controlled_len += diff;
+}
+
+static gint64
+log_queue_ring_get_length(LogQueue *s)
+{
+  LogQueueRing *self = (LogQueueRing *) s;
+
+  return atomic_gssize_get(&self->len) + self->output.len;
+}
+
+static gboolean
+log_queue_ring_is_empty_racy(LogQueue *s)
+{
+  LogQueueRing *self = (LogQueueRing *) s;
+
+  if (log_queue_ring_get_length(s) > 0)
+    return FALSE;
+
+  for (gint i = 0; i < self->num_inputs; i++)
+    {
+      if (self->inputs[i].finish_cb_registered)
+        return FALSE;
+    }
+  return TRUE;
+}
+
+/* NOTE: this is inherently racy, can only be called if log processing is suspended (e.g. reload time) */
+static gboolean
+log_queue_ring_keep_on_reload(LogQueue *s)
+{
+  LogQueueRing *self = (LogQueueRing *) s;
+
+  return log_queue_ring_get_length(s) > 0 || self->backlog.len > 0;
+}
+
+static inline gboolean
+_message_has_to_be_dropped(LogQueueRing *self, const LogPathOptions *path_options)
+{
+  if (path_options->flow_control_requested)
+    return FALSE;
+
+  if (log_queue_is_global_memory_budget_exhausted())
+    return TRUE;
+
+  /* racy, see the similar comment in logqueue-fifo.c */
+  return atomic_gssize_get(&self->non_flow_controlled_len) + self->output.non_flow_controlled_len >= self->log_fifo_size;
+}
+
+static void
+_push_to_overflow(LogQueueRing *self, LogMessageQueueNode *node)
+{
+  g_mutex_lock(&self->super.lock);
+  iv_list_add_tail(&node->list, &self->overflow.items);
+  _list_add_len(&self->overflow, node, 1);
+  atomic_gssize_inc(&self->overflow_len);
+  g_mutex_unlock(&self->super.lock);
+}
+
+static void
+_push_node(LogQueueRing *self, LogMessageQueueNode *node)
+{
+  /* account for the message first, so that the length never goes
+   * negative, even if the output thread consumes it right away */
+  atomic_gssize_inc(&self->len);
+  if (!node->flow_control_requested)
+    atomic_gssize_inc(&self->non_flow_controlled_len);
+
+  /* once the overflow list is in use, we have to keep using it to keep
+   * the order of messages, until the output thread drains it */
+  if (atomic_gssize_get(&self->overflow_len) > 0 || !_ring_push(self, node))
+    _push_to_overflow(self, node);
+}
+
+static void
+_notify_output_thread(LogQueueRing *self)
+{
+  g_mutex_lock(&self->super.lock);
+  log_queue_push_notify(&self->super);
+  g_mutex_unlock(&self->super.lock);
+}
+
+/* called when an input thread finishes its batch */
+static gpointer
+log_queue_ring_finish_input_batch(gpointer user_data)
+{
+  LogQueueRing *self = (LogQueueRing *) user_data;
+  gint thread_index = main_loop_worker_get_thread_index();
+
+  g_assert(thread_index >= 0);
+
+  _notify_output_thread(self);
+  self->inputs[thread_index].finish_cb_registered = FALSE;
+  log_queue_unref(&self->super);
+  return NULL;
+}
+
+/*
+ * Can be called from any of the input threads.  Wakeups of the output
+ * thread are deferred to the end of the input batch if the thread is a
+ * worker thread that we have an input slot for.
+ *
+ * NOTE: It consumes the reference passed by the caller.
+ */
+static void
+log_queue_ring_push_tail(LogQueue *s, LogMessage *msg, const LogPathOptions *path_options)
+{
+  LogQueueRing *self = (LogQueueRing *) s;
+  gint thread_index = main_loop_worker_get_thread_index();
+
+  if (thread_index >= self->num_inputs)
+    thread_index = -1;
+
+  if (_message_has_to_be_dropped(self, path_options))
+    {
+      log_queue_dropped_messages_inc(&self->super);
+      log_msg_drop(msg, path_options, AT_PROCESSED);
+
+      msg_debug("Destination queue full, dropping message",
+                evt_tag_int("queue_len", log_queue_ring_get_length(&self->super)),
+                evt_tag_int("log_fifo_size", self->log_fifo_size),
+                evt_tag_str("persist_name", self->super.persist_name));
+      return;
+    }
+
+  log_msg_write_protect(msg);
+  LogMessageQueueNode *node = log_msg_alloc_queue_node(msg, path_options);
+
+  log_queue_queued_messages_inc(&self->super);
+  log_queue_memory_usage_add(&self->super, log_msg_get_size(msg));
+  _push_node(self, node);
+
+  if (thread_index >= 0)
+    {
+      LogQueueRingInput *input = &self->inputs[thread_index];
+
+      if (!input->finish_cb_registered)
+        {
+          /* One reference is held while the callback is registered, see LogQueueFifo */
+          main_loop_worker_register_batch_callback(&input->cb);
+          input->finish_cb_registered = TRUE;
+          log_queue_ref(&self->super);
+        }
+    }
+  else
+    {
+      _notify_output_thread(self);
+    }
+
+  log_msg_unref(msg);
+}
+
+/* output thread only */
+static void
+_move_overflow_to_output(LogQueueRing *self)
+{
+  g_mutex_lock(&self->super.lock);
+  iv_list_splice_tail_init(&self->overflow.items, &self->output.items);
+  self->output.len += self->overflow.len;
+  self->output.non_flow_controlled_len += self->overflow.non_flow_controlled_len;
+
+  atomic_gssize_sub(&self->len, self->overflow.len);
+  atomic_gssize_sub(&self->non_flow_controlled_len, self->overflow.non_flow_controlled_len);
+
+  self->overflow.len = 0;
+  self->overflow.non_flow_controlled_len = 0;
+  atomic_gssize_set(&self->overflow_len, 0);
+  g_mutex_unlock(&self->super.lock);
+}
+
+/* output thread only: make sure that the next message is either on the
+ * output list or at the head of the ring */
+static void
+_refill_output(LogQueueRing *self)
+{
+  if (self->output.len > 0)
+    return;
+
+  if (_ring_is_drained(self) && atomic_gssize_get(&self->overflow_len) > 0)
+    _move_overflow_to_output(self);
+}
+
+static LogMessageQueueNode *
+_pop_node(LogQueueRing *self)
+{
+  LogMessageQueueNode *node;
+
+  _refill_output(self);
+
+  if (self->output.len > 0)
+    {
+      node = iv_list_entry(self->output.items.next, LogMessageQueueNode, list);
+      iv_list_del_init(&node->list);
+      _list_add_len(&self->output, node, -1);
+      return node;
+    }
+
+  node = _ring_pop(self);
+  if (node)
+    {
+      INIT_IV_LIST_HEAD(&node->list);
+      atomic_gssize_dec(&self->len);
+      if (!node->flow_control_requested)
+        atomic_gssize_dec(&self->non_flow_controlled_len);
+    }
+  return node;
+}
+
+/*
+ * Can only run from the output thread.
+ */
+static LogMessage *
+log_queue_ring_peek_head(LogQueue *s)
+{
+  LogQueueRing *self = (LogQueueRing *) s;
+  LogMessageQueueNode *node;
+
+  _refill_output(self);
+
+  if (self->output.len > 0)
+    node = iv_list_entry(self->output.items.next, LogMessageQueueNode, list);
+  else
+    node = _ring_peek(self);
+
+  return node ? node->msg : NULL;
+}
+
+static inline LogMessage *
+_push_to_backlog(LogQueueRing *self, LogMessageQueueNode *node, LogPathOptions *path_options)
+{
+  LogMessage *msg = node->msg;
+
+  path_options->ack_needed = node->ack_needed;
+  log_msg_ref(msg);
+  iv_list_add_tail(&node->list, &self->backlog.items);
+  _list_add_len(&self->backlog, node, 1);
+  return msg;
+}
+
+/*
+ * Can only run from the output thread.
+ *
+ * NOTE: this returns a reference which the caller must take care to free.
+ */
+static LogMessage *
+log_queue_ring_pop_head(LogQueue *s, LogPathOptions *path_options)
+{
+  LogQueueRing *self = (LogQueueRing *) s;
+  LogMessageQueueNode *node = _pop_node(self);
+
+  if (!node)
+    return NULL;
+
+  LogMessage *msg = _push_to_backlog(self, node, path_options);
+
+  log_queue_queued_messages_dec(&self->super);
+  log_queue_memory_usage_sub(&self->super, log_msg_get_size(msg));
+
+  return msg;
+}
+
+/*
+ * Can only run from the output thread.
+ */
+static gint
+log_queue_ring_pop_head_batch(LogQueue *s, LogMessage **msgs, LogPathOptions *path_options, gint max_msgs)
+{
+  LogQueueRing *self = (LogQueueRing *) s;
+  gint num_msgs = 0;
+  gsize memory_usage = 0;
+
+  while (num_msgs < max_msgs)
+    {
+      LogMessageQueueNode *node = _pop_node(self);
+
+      if (!node)
+        break;
+
+      LogMessage *msg = _push_to_backlog(self, node, &path_options[num_msgs]);
+      memory_usage += log_msg_get_size(msg);
+      msgs[num_msgs++] = msg;
+    }
+
+  if (num_msgs > 0)
+    {
+      log_queue_queued_messages_sub(&self->super, num_msgs);
+      log_queue_memory_usage_sub(&self->super, memory_usage);
+    }
+  return num_msgs;
+}
+
+/*
+ * Can only run from the output thread.
+ */
+static void
+log_queue_ring_ack_backlog(LogQueue *s, gint rewind_count)
+{
+  LogQueueRing *self = (LogQueueRing *) s;
+  LogPathOptions path_options = LOG_PATH_OPTIONS_INIT;
+
+  for (gint pos = 0; pos < rewind_count && self->backlog.len > 0; pos++)
+    {
+      LogMessageQueueNode *node = iv_list_entry(self->backlog.items.next, LogMessageQueueNode, list);
+      LogMessage *msg = node->msg;
+
+      iv_list_del(&node->list);
+      _list_add_len(&self->backlog, node, -1);
+
+      path_options.ack_needed = node->ack_needed;
+      log_msg_free_queue_node(node);
+      log_msg_drop(msg, &path_options, AT_PROCESSED);
+    }
+}
+
+static void
+_rewind_node(LogQueueRing *self, LogMessageQueueNode *node)
+{
+  iv_list_del_init(&node->list);
+  iv_list_add(&node->list, &self->output.items);
+
+  _list_add_len(&self->backlog, node, -1);
+  _list_add_len(&self->output, node, 1);
+
+  log_queue_queued_messages_inc(&self->super);
+  log_queue_memory_usage_add(&self->super, log_msg_get_size(node->msg));
+}
+
+/*
+ * Rewound messages are put back to the front of the output list, which
+ * is consumed before the ring.
+ *
+ * NOTE: this is assumed to be called from the output thread.
+ */
+static void
+log_queue_ring_rewind_backlog(LogQueue *s, guint rewind_count)
+{
+  LogQueueRing *self = (LogQueueRing *) s;
+
+  rewind_count = MIN(rewind_count, self->backlog.len);
+  for (guint pos = 0; pos < rewind_count; pos++)
+    _rewind_node(self, iv_list_entry(self->backlog.items.prev, LogMessageQueueNode, list));
+}
+
+static void
+log_queue_ring_rewind_backlog_all(LogQueue *s)
+{
+  LogQueueRing *self = (LogQueueRing *) s;
+
+  log_queue_ring_rewind_backlog(s, self->backlog.len);
+}
+
+static void
+_free_node(LogMessageQueueNode *node)
+{
+  LogPathOptions path_options = LOG_PATH_OPTIONS_INIT;
+  LogMessage *msg = node->msg;
+
+  path_options.ack_needed = node->ack_needed;
+  log_msg_free_queue_node(node);
+  log_msg_ack(msg, &path_options, AT_ABORTED);
+  log_msg_unref(msg);
+}
+
+static void
+_free_list(struct iv_list_head *q)
+{
+  while (!iv_list_empty(q))
+    {
+      LogMessageQueueNode *node = iv_list_entry(q->next, LogMessageQueueNode, list);
+
+      iv_list_del(&node->list);
+      _free_node(node);
+    }
+}
+
+static void
+log_queue_ring_free(LogQueue *s)
+{
+  LogQueueRing *self = (LogQueueRing *) s;
+  LogMessageQueueNode *node;
+
+  for (gint i = 0; i < self->num_inputs; i++)
+    g_assert(self->inputs[i].finish_cb_registered == FALSE);
+
+  _free_list(&self->output.items);
+  while ((node = _ring_pop(self)))
+    _free_node(node);
+  _free_list(&self->overflow.items);
+  _free_list(&self->backlog.items);
+
+  g_free(self->slots);
+  log_queue_free_method(s);
+}
+
+static gsize
+_calculate_capacity(gint log_fifo_size)
+{
+  gsize capacity = LOG_QUEUE_RING_MIN_CAPACITY;
+
+  while (capacity < (gsize) log_fifo_size)
+    capacity <<= 1;
+  return capacity;
+}
+
+LogQueue *
+log_queue_ring_new(gint log_fifo_size, const gchar *persist_name, gint stats_level,
+                   StatsClusterKeyBuilder *driver_sck_builder, StatsClusterKeyBuilder *queue_sck_builder)
+{
+  LogQueueRing *self;
+
+  gint max_threads = main_loop_worker_get_max_number_of_threads();
+  self = g_malloc0(sizeof(LogQueueRing) + max_threads * sizeof(self->inputs[0]));
+
+  if (queue_sck_builder)
+    {
+      stats_cluster_key_builder_push(queue_sck_builder);
+      stats_cluster_key_builder_set_name_prefix(queue_sck_builder, "memory_queue_");
+    }
+
+  log_queue_init_instance(&self->super, persist_name, stats_level, driver_sck_builder, queue_sck_builder);
+  self->super.type = log_queue_ring_type;
+  self->super.get_length = log_queue_ring_get_length;
+  self->super.is_empty_racy = log_queue_ring_is_empty_racy;
+  self->super.keep_on_reload = log_queue_ring_keep_on_reload;
+  self->super.push_tail = log_queue_ring_push_tail;
+  self->super.pop_head = log_queue_ring_pop_head;
+  self->super.pop_head_batch = log_queue_ring_pop_head_batch;
+  self->super.peek_head = log_queue_ring_peek_head;
+  self->super.ack_backlog = log_queue_ring_ack_backlog;
+  self->super.rewind_backlog = log_queue_ring_rewind_backlog;
+  self->super.rewind_backlog_all = log_queue_ring_rewind_backlog_all;
+
+  self->super.free_fn = log_queue_ring_free;
+
+  self->capacity = _calculate_capacity(log_fifo_size);
+  self->mask = self->capacity - 1;
+  self->slots = g_new0(LogQueueRingSlot, self->capacity);
+  for (gsize i = 0; i < self->capacity; i++)
+    atomic_gssize_set(&self->slots[i].sequence, i);
+
+  self->num_inputs = max_threads;
+  for (gint i = 0; i < self->num_inputs; i++)
+    {
+      worker_batch_callback_init(&self->inputs[i].cb);
+      self->inputs[i].cb.func = log_queue_ring_finish_input_batch;
+      self->inputs[i].cb.user_data = self;
+    }
+  INIT_IV_LIST_HEAD(&self->overflow.items);
+  INIT_IV_LIST_HEAD(&self->output.items);
+  INIT_IV_LIST_HEAD(&self->backlog.items);
+
+  self->log_fifo_size = log_fifo_size;
+
+  if (queue_sck_builder)
+    stats_cluster_key_builder_pop(queue_sck_builder);
+
+  return &self->super;
+}
+
+QueueType
+log_queue_ring_get_type(void)
+{
+  return log_queue_ring_type;
+}
@@ -28,11 +28,85 @@
 #include "messages.h"
 #include "timeutils/misc.h"
 
+/*
+ * Process-wide memory budget
+ *
+ * Every queue reserves the bytes it accounts via log_queue_memory_usage_add()
+ * from a single pool, so the memory used by all destination queues can be
+ * bounded regardless of the number of destinations.  Once the pool is
+ * exhausted, memory queues drop non flow-controlled messages (flow-controlled
+ * ones are kept, their sources get suspended by the lack of acks) and
+ * disk-buffers stop using their in-memory caches and spill to disk instead.
+ *
+ * A budget of 0 means unlimited, in which case only the accounting is done.
+ */
+static struct
+{
+  atomic_gssize budget;
+  atomic_gssize usage;
+
+  StatsCounterItem *budget_counter;
+  StatsCounterItem *usage_counter;
+} global_memory;
+
+static void
+_register_global_memory_counters(void)
+{
+  StatsClusterKey sc_key;
+
+  stats_lock();
+  {
+    stats_cluster_single_key_set(&sc_key, "memory_queue_budget_bytes", NULL, 0);
+    stats_register_counter(STATS_LEVEL0, &sc_key, SC_TYPE_SINGLE_VALUE, &global_memory.budget_counter);
+
+    stats_cluster_single_key_set(&sc_key, "memory_queue_global_usage_bytes", NULL, 0);
+    stats_register_counter(STATS_LEVEL0, &sc_key, SC_TYPE_SINGLE_VALUE, &global_memory.usage_counter);
+  }
+  stats_unlock();
+}
+
+void
+log_queue_set_global_memory_budget(gsize budget)
+{
+  atomic_gssize_set(&global_memory.budget, budget);
+
+  if (budget && !global_memory.budget_counter)
+    _register_global_memory_counters();
+
+  stats_counter_set(global_memory.budget_counter, budget);
+  stats_counter_set(global_memory.usage_counter, atomic_gssize_get(&global_memory.usage));
+}
+
+gsize
+log_queue_get_global_memory_usage(void)
+{
+  return atomic_gssize_get_unsigned(&global_memory.usage);
+}
+
+/* racy, it is only used as a hint when deciding where to put a message */
+gboolean
+log_queue_is_global_memory_budget_exhausted(void)
+{
+  gssize budget = atomic_gssize_racy_get(&global_memory.budget);
+
+  return budget > 0 && atomic_gssize_racy_get(&global_memory.usage) >= budget;
+}
+
+static inline void
+_global_memory_usage_add(gssize value)
+{
+  atomic_gssize_add(&global_memory.usage, value);
+  stats_counter_add(global_memory.usage_counter, value);
+}
+
 void
 log_queue_memory_usage_add(LogQueue *self, gsize value)
 {
   stats_counter_add(self->metrics.shared.memory_usage, value);
   stats_counter_add(self->metrics.owned.memory_usage, value);
+
+  atomic_gssize_add(&self->memory_reserved, value);
+  _global_memory_usage_add(value);
 }
 
 void
@@ -40,6 +114,9 @@ log_queue_memory_usage_sub(LogQueue *self, gsize value)
 {
   stats_counter_sub(self->metrics.shared.memory_usage, value);
   stats_counter_sub(self->metrics.owned.memory_usage, value);
+
+  atomic_gssize_sub(&self->memory_reserved, value);
+  _global_memory_usage_add(-(gssize) value);
 }
 
 void
@@ -255,6 +332,7 @@ _register_shared_counters(LogQueue *self, gint stats_level, StatsClusterKeyBuild
   {
     stats_register_counter(stats_level, self->metrics.shared.output_events_sc_key, SC_TYPE_QUEUED,
                            &self->metrics.shared.queued_messages);
+    stats_counter_enable_striping(self->metrics.shared.queued_messages);
     stats_register_counter(stats_level, self->metrics.shared.output_events_sc_key, SC_TYPE_DROPPED,
                            &self->metrics.shared.dropped_messages);
     stats_register_counter_and_index(stats_level, self->metrics.shared.memory_usage_sc_key, SC_TYPE_SINGLE_VALUE,
@@ -283,6 +361,7 @@ _register_owned_counters(LogQueue *self, gint stats_level, StatsClusterKeyBuilde
   {
     stats_register_counter(stats_level, self->metrics.owned.events_sc_key, SC_TYPE_SINGLE_VALUE,
                            &self->metrics.owned.queued_messages);
+    stats_counter_enable_striping(self->metrics.owned.queued_messages);
     stats_register_counter(stats_level, self->metrics.owned.memory_usage_sc_key, SC_TYPE_SINGLE_VALUE,
                            &self->metrics.owned.memory_usage);
   }
@@ -317,7 +396,9 @@ _unregister_shared_counters(LogQueue *self)
 
     if (self->metrics.shared.memory_usage_sc_key)
       {
-        log_queue_memory_usage_sub(self, stats_counter_get(self->metrics.owned.memory_usage));
+        gsize memory_usage = stats_counter_get(self->metrics.owned.memory_usage);
+        stats_counter_sub(self->metrics.shared.memory_usage, memory_usage);
+        stats_counter_sub(self->metrics.owned.memory_usage, memory_usage);
         stats_unregister_counter(self->metrics.shared.memory_usage_sc_key, SC_TYPE_SINGLE_VALUE,
                                  &self->metrics.shared.memory_usage);
 
@@ -358,12 +439,37 @@ _unregister_counters(LogQueue *self)
   _unregister_owned_counters(self);
 }
 
+/* fallback implementations of the batch operations for queues that do not have a native one */
+static void
+_push_tail_batch_method(LogQueue *self, LogMessage **msgs, const LogPathOptions *path_options, gint num_msgs)
+{
+  for (gint i = 0; i < num_msgs; i++)
+    self->push_tail(self, msgs[i], &path_options[i]);
+}
+
+static gint
+_pop_head_batch_method(LogQueue *self, LogMessage **msgs, LogPathOptions *path_options, gint max_msgs)
+{
+  gint num_msgs = 0;
+
+  while (num_msgs < max_msgs)
+    {
+      LogMessage *msg = self->pop_head(self, &path_options[num_msgs]);
+      if (!msg)
+        break;
+      msgs[num_msgs++] = msg;
+    }
+  return num_msgs;
+}
+
 void
 log_queue_init_instance(LogQueue *self, const gchar *persist_name, gint stats_level,
                         StatsClusterKeyBuilder *driver_sck_builder, StatsClusterKeyBuilder *queue_sck_builder)
 {
   g_atomic_counter_set(&self->ref_cnt, 1);
   self->free_fn = log_queue_free_method;
+  self->push_tail_batch = _push_tail_batch_method;
+  self->pop_head_batch = _pop_head_batch_method;
 
   self->persist_name = persist_name ? g_strdup(persist_name) : NULL;
   g_mutex_init(&self->lock);
@@ -374,6 +480,8 @@ log_queue_init_instance(LogQueue *self, const gchar *persist_name, gint stats_le
 void
 log_queue_free_method(LogQueue *self)
 {
+  /* release whatever is still reserved from the global budget */
+  _global_memory_usage_add(-atomic_gssize_get(&self->memory_reserved));
   _unregister_counters(self);
   g_mutex_clear(&self->lock);
   g_free(self->persist_name);
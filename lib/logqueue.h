@@ -26,8 +26,10 @@
 #define LOGQUEUE_H_INCLUDED
 
 #include "logmsg/logmsg.h"
+#include "logmsg/logmsg-trace.h"
 #include "stats/stats-registry.h"
 #include "stats/stats-cluster-key-builder.h"
+#include "atomic-gssize.h"
 
 typedef void (*LogQueuePushNotifyFunc)(gpointer user_data);
 
@@ -70,6 +72,9 @@ struct _LogQueue
 
   LogQueueMetrics metrics;
 
+  /* this queue's share of the process-wide memory budget */
+  atomic_gssize memory_reserved;
+
   GMutex lock;
   LogQueuePushNotifyFunc parallel_push_notify;
   gpointer parallel_push_data;
@@ -80,12 +85,17 @@ struct _LogQueue
   gint64 (*get_length)(LogQueue *self);
   gboolean (*is_empty_racy)(LogQueue *self);
   void (*push_tail)(LogQueue *self, LogMessage *msg, const LogPathOptions *path_options);
+  void (*push_tail_batch)(LogQueue *self, LogMessage **msgs, const LogPathOptions *path_options, gint num_msgs);
   LogMessage *(*pop_head)(LogQueue *self, LogPathOptions *path_options);
+  gint (*pop_head_batch)(LogQueue *self, LogMessage **msgs, LogPathOptions *path_options, gint max_msgs);
   LogMessage *(*peek_head)(LogQueue *self);
   void (*ack_backlog)(LogQueue *self, gint n);
   void (*rewind_backlog)(LogQueue *self, guint rewind_count);
   void (*rewind_backlog_all)(LogQueue *self);
 
+  /* optional, may be called from any thread, see log_queue_steal_tail_batch() */
+  gint (*steal_tail_batch)(LogQueue *self, LogMessage **msgs, LogPathOptions *path_options, gint max_msgs);
+
   void (*free_fn)(LogQueue *self);
 };
 
@@ -115,9 +125,22 @@ log_queue_is_empty_racy(LogQueue *self)
 static inline void
 log_queue_push_tail(LogQueue *self, LogMessage *msg, const LogPathOptions *path_options)
 {
+  log_msg_trace_stamp(msg, LM_TRACE_QUEUED);
   self->push_tail(self, msg, path_options);
 }
 
+/*
+ * Pushes num_msgs messages at once, path_options is an array of the same
+ * length.  Just like log_queue_push_tail(), it consumes the references of
+ * the messages.
+ */
+static inline void
+log_queue_push_tail_batch(LogQueue *self, LogMessage **msgs, const LogPathOptions *path_options, gint num_msgs)
+{
+  log_msg_trace_stamp_batch(msgs, num_msgs, LM_TRACE_QUEUED);
+  self->push_tail_batch(self, msgs, path_options, num_msgs);
+}
+
 static inline LogMessage *
 log_queue_pop_head(LogQueue *self, LogPathOptions *path_options)
 {
@@ -128,12 +151,76 @@ log_queue_pop_head(LogQueue *self, LogPathOptions *path_options)
 
   msg = self->pop_head(self, path_options);
 
+  if (msg)
+    log_msg_trace_stamp(msg, LM_TRACE_DEQUEUED);
+
   if (msg && self->throttle_buckets > 0)
     self->throttle_buckets--;
 
   return msg;
 }
 
+/*
+ * Pops at most max_msgs messages into msgs, their ack_needed state is
+ * returned in the path_options array.  Returns the number of messages
+ * popped, each of them is a reference which the caller must free, just
+ * like with log_queue_pop_head().
+ */
+static inline gint
+log_queue_pop_head_batch(LogQueue *self, LogMessage **msgs, LogPathOptions *path_options, gint max_msgs)
+{
+  if (self->throttle)
+    max_msgs = MIN(max_msgs, self->throttle_buckets);
+
+  if (max_msgs <= 0)
+    return 0;
+
+  gint num_msgs = self->pop_head_batch(self, msgs, path_options, max_msgs);
+  log_msg_trace_stamp_batch(msgs, num_msgs, LM_TRACE_DEQUEUED);
+
+  if (self->throttle)
+    self->throttle_buckets -= num_msgs;
+
+  return num_msgs;
+}
+
+/*
+ * Gives back the throttle buckets taken by messages that were popped, but
+ * then rewound without being sent, e.g. the unprocessed part of a batch.
+ */
+static inline void
+log_queue_refund_throttle(LogQueue *self, gint num_msgs)
+{
+  if (self->throttle)
+    self->throttle_buckets = MIN(self->throttle, self->throttle_buckets + num_msgs);
+}
+
+static inline gint
+log_queue_pop_head_batch_ignore_throttle(LogQueue *self, LogMessage **msgs, LogPathOptions *path_options,
+                                         gint max_msgs)
+{
+  gint num_msgs = self->pop_head_batch(self, msgs, path_options, max_msgs);
+
+  log_msg_trace_stamp_batch(msgs, num_msgs, LM_TRACE_DEQUEUED);
+  return num_msgs;
+}
+
+/*
+ * Removes at most max_msgs of the newest messages from the queue, bypassing
+ * the backlog, so that they can be pushed to another queue.  The messages
+ * are returned in their original order along with their ack_needed and
+ * flow_control_requested state, the caller owns the references.  Queues
+ * that do not support it return 0.
+ */
+static inline gint
+log_queue_steal_tail_batch(LogQueue *self, LogMessage **msgs, LogPathOptions *path_options, gint max_msgs)
+{
+  if (!self->steal_tail_batch || max_msgs <= 0)
+    return 0;
+
+  return self->steal_tail_batch(self, msgs, path_options, max_msgs);
+}
+
 static inline LogMessage *
 log_queue_peek_head(LogQueue *self)
 {
@@ -143,7 +230,11 @@ log_queue_peek_head(LogQueue *self)
 static inline LogMessage *
 log_queue_pop_head_ignore_throttle(LogQueue *self, LogPathOptions *path_options)
 {
-  return self->pop_head(self, path_options);
+  LogMessage *msg = self->pop_head(self, path_options);
+
+  if (msg)
+    log_msg_trace_stamp(msg, LM_TRACE_DEQUEUED);
+  return msg;
 }
 
 static inline void
@@ -204,6 +295,10 @@ log_queue_has_type(LogQueue *self, QueueType type)
 void log_queue_memory_usage_add(LogQueue *self, gsize value);
 void log_queue_memory_usage_sub(LogQueue *self, gsize value);
 
+void log_queue_set_global_memory_budget(gsize budget);
+gsize log_queue_get_global_memory_usage(void);
+gboolean log_queue_is_global_memory_budget_exhausted(void);
+
 void log_queue_queued_messages_add(LogQueue *self, gsize value);
 void log_queue_queued_messages_sub(LogQueue *self, gsize value);
 void log_queue_queued_messages_inc(LogQueue *self);
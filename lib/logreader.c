@@ -104,6 +104,22 @@ log_reader_disable_bookmark_saving(LogReader *s)
  * Watches: the poll_events instance and the idle timer
  ***************************************************************************/
 
+void
+log_reader_set_dedicated_thread(LogReader *s, gboolean dedicated_thread)
+{
+  LogReader *self = (LogReader *) s;
+
+  self->dedicated_thread = dedicated_thread;
+}
+
+void
+log_reader_set_scheduler(LogReader *s, LogReaderScheduler *scheduler)
+{
+  LogReader *self = (LogReader *) s;
+
+  self->scheduler = scheduler;
+}
+
 static void
 log_reader_idle_timeout(void *cookie)
 {
@@ -361,11 +377,22 @@ log_reader_work_perform(void *s, gpointer arg)
   self->notify_code = log_reader_fetch_log(self);
 }
 
+static void
+log_reader_end_turn(LogReader *self)
+{
+  if (!self->in_turn)
+    return;
+
+  self->in_turn = FALSE;
+  self->scheduler->release(self->scheduler, self);
+}
+
 static void
 log_reader_work_finished(void *s, gpointer arg)
 {
   LogReader *self = (LogReader *) s;
 
+  log_reader_end_turn(self);
   if (self->pending_close)
     {
       /* pending proto is only set in the main thread, so no need to
@@ -444,12 +471,16 @@ _log_reader_insert_msg_length_stats(LogReader *self, gsize len)
   stats_aggregator_add_data_point(self->average_messages_size, len);
 }
 
-static gboolean
-log_reader_handle_line(LogReader *self, const guchar *line, gint length, LogTransportAuxData *aux)
+static LogMessage *
+log_reader_construct_msg(LogReader *self, const guchar *line, gint length, GBytes *input_chunk,
+                         LogTransportAuxData *aux)
 {
   LogMessage *m;
 
   m = msg_format_construct_message(&self->options->parse_options, line, length);
+  if (input_chunk)
+    log_msg_set_input_chunk(m, input_chunk);
+
   msg_debug("Incoming log entry",
             evt_tag_mem("input", line, length),
             evt_tag_msg_reference(m));
@@ -473,15 +504,150 @@ log_reader_handle_line(LogReader *self, const guchar *line, gint length, LogTran
         }
       m->proto = aux->proto;
     }
-  log_msg_refcache_start_producer(m);
 
   log_transport_aux_data_foreach(aux, _add_aux_nvpair, m);
+  return m;
+}
+
+static GBytes *
+log_reader_steal_input_chunk(LogReader *self)
+{
+  if (!msg_format_options_borrows_input(&self->options->parse_options))
+    return NULL;
+  return log_proto_server_steal_input_chunk(self->proto);
+}
+
+/*
+ * The input chunk returned by the LogProtoServer may be its whole receive
+ * buffer, the message only holds on to the part it was parsed from, so
+ * that its allocated bytes reflect the size of the message.
+ */
+static GBytes *
+log_reader_slice_input_chunk(GBytes *input_chunk, const guchar *line, gsize length)
+{
+  gsize chunk_len;
+  const guchar *chunk;
+
+  if (!input_chunk || length == 0)
+    return NULL;
+
+  chunk = g_bytes_get_data(input_chunk, &chunk_len);
+  if (line < chunk || line + length > chunk + chunk_len)
+    return NULL;
+
+  if (line == chunk && length == chunk_len)
+    return g_bytes_ref(input_chunk);
+  return g_bytes_new_from_bytes(input_chunk, line - chunk, length);
+}
 
+static gboolean
+log_reader_handle_line(LogReader *self, const guchar *line, gint length, LogTransportAuxData *aux)
+{
+  GBytes *received_chunk = log_reader_steal_input_chunk(self);
+  GBytes *input_chunk = log_reader_slice_input_chunk(received_chunk, line, length);
+  LogMessage *m = log_reader_construct_msg(self, line, length, input_chunk, aux);
+
+  if (input_chunk)
+    g_bytes_unref(input_chunk);
+  if (received_chunk)
+    g_bytes_unref(received_chunk);
+
+  log_msg_refcache_start_producer(m);
   log_source_post(&self->super, m);
   log_msg_refcache_stop();
   return log_source_free_to_send(&self->super);
 }
 
+static gint
+log_reader_handle_batch(LogReader *self, LogProtoServerFetchBatch *batch)
+{
+  LogMessage *msgs[LOG_READER_FETCH_BATCH_MAX];
+  Bookmark *bookmarks[LOG_READER_FETCH_BATCH_MAX];
+  GBytes *received_chunk = log_reader_steal_input_chunk(self);
+  gint count = 0;
+
+  for (gint i = 0; i < batch->num_slices; i++)
+    {
+      LogProtoServerFetchSlice *slice = &batch->slices[i];
+
+      if (slice->msg_len == 0 && !(self->options->flags & LR_EMPTY_LINES))
+        continue;
+
+      GBytes *input_chunk = log_reader_slice_input_chunk(received_chunk, slice->msg, slice->msg_len);
+      msgs[count] = log_reader_construct_msg(self, slice->msg, slice->msg_len, input_chunk, batch->aux);
+      if (input_chunk)
+        g_bytes_unref(input_chunk);
+      bookmarks[count] = &slice->bookmark;
+      count++;
+    }
+  if (received_chunk)
+    g_bytes_unref(received_chunk);
+
+  log_source_post_batch(&self->super, msgs, bookmarks, count);
+  return count;
+}
+
+/*
+ * Same as log_reader_fetch_log() below, but the LogProtoServer returns
+ * all the messages it has in its buffer at once, which are then posted
+ * as a batch.
+ */
+static gint
+log_reader_fetch_log_batch(LogReader *self, LogTransportAuxData *aux)
+{
+  gint msg_count = 0;
+  gboolean may_read = TRUE;
+  LogProtoServerFetchBatch batch = { .aux = aux };
+
+  if (!self->fetch_batch)
+    self->fetch_batch = g_new(LogProtoServerFetchSlice, LOG_READER_FETCH_BATCH_MAX);
+  batch.slices = self->fetch_batch;
+
+  while (msg_count < self->options->fetch_limit && !main_loop_worker_job_quit())
+    {
+      gint max_slices = MIN(log_source_get_free_window(&self->super), LOG_READER_FETCH_BATCH_MAX);
+
+      if (max_slices == 0)
+        break;
+
+      batch.max_slices = MIN(self->options->fetch_limit - msg_count, max_slices);
+
+      log_transport_aux_data_reinit(aux);
+      switch (log_proto_server_fetch_batch(self->proto, &batch, &may_read))
+        {
+        case LPS_EOF:
+          log_transport_aux_data_destroy(aux);
+          return NC_CLOSE;
+        case LPS_ERROR:
+          log_transport_aux_data_destroy(aux);
+          return NC_READ_ERROR;
+        case LPS_SUCCESS:
+        case LPS_AGAIN:
+          break;
+        default:
+          g_assert_not_reached();
+          break;
+        }
+
+      if (batch.num_slices == 0)
+        {
+          /* no more messages for now */
+          break;
+        }
+      msg_count += log_reader_handle_batch(self, &batch);
+      if (!log_source_free_to_send(&self->super))
+        {
+          /* window is full, don't generate further messages */
+          break;
+        }
+    }
+  log_transport_aux_data_destroy(aux);
+
+  if (msg_count == self->options->fetch_limit)
+    self->immediate_check = TRUE;
+  return 0;
+}
+
 /* returns: notify_code (NC_XXXX) or 0 for success */
 static gint
 log_reader_fetch_log(LogReader *self)
@@ -499,6 +665,9 @@ log_reader_fetch_log(LogReader *self)
       return log_reader_process_handshake(self);
     }
 
+  if (log_proto_server_is_fetch_batch_supported(self->proto))
+    return log_reader_fetch_log_batch(self, aux);
+
   /* NOTE: this loop is here to decrease the load on the main loop, we try
    * to fetch a couple of messages in a single run (but only up to
    * fetch_limit).
@@ -567,7 +736,18 @@ log_reader_io_handle_in(gpointer s)
   LogReader *self = (LogReader *) s;
 
   log_reader_disable_watches(self);
-  if ((self->options->flags & LR_THREADED))
+  if (self->scheduler && !self->in_turn)
+    {
+      /* watches stay suspended until we get our turn */
+      self->scheduler->schedule(self->scheduler, self);
+      return;
+    }
+
+  if (self->dedicated_worker)
+    {
+      main_loop_io_worker_job_submit_to_pool(&self->io_job, self->dedicated_worker, NULL);
+    }
+  else if ((self->options->flags & LR_THREADED))
     {
       main_loop_io_worker_job_submit(&self->io_job, NULL);
     }
@@ -588,9 +768,20 @@ log_reader_io_handle_in(gpointer s)
           log_reader_work_finished(s, NULL);
           log_pipe_unref(&self->super.super);
         }
+      else
+        log_reader_end_turn(self);
     }
 }
 
+void
+log_reader_run_turn(LogReader *s)
+{
+  LogReader *self = (LogReader *) s;
+
+  self->in_turn = TRUE;
+  log_reader_io_handle_in(self);
+}
+
 static void
 _register_aggregated_stats(LogReader *self)
 {
@@ -666,6 +857,9 @@ log_reader_init(LogPipe *s)
 
   iv_event_register(&self->schedule_wakeup);
 
+  if (self->dedicated_thread)
+    self->dedicated_worker = main_loop_io_worker_pool_new(1);
+
   log_reader_start_watches(self);
 
   _register_aggregated_stats(self);
@@ -684,8 +878,20 @@ log_reader_deinit(LogPipe *s)
   if (iv_task_registered(&self->restart_task))
     iv_task_unregister(&self->restart_task);
 
+  if (self->scheduler)
+    {
+      self->in_turn = FALSE;
+      self->scheduler->release(self->scheduler, self);
+    }
+
   log_reader_stop_watches(self);
 
+  if (self->dedicated_worker)
+    {
+      main_loop_io_worker_pool_free(self->dedicated_worker);
+      self->dedicated_worker = NULL;
+    }
+
   _unregister_aggregated_stats(self);
   if (!log_source_deinit(s))
     return FALSE;
@@ -733,6 +939,7 @@ log_reader_free(LogPipe *s)
   log_pipe_unref(self->control);
   g_sockaddr_unref(self->peer_addr);
   g_sockaddr_unref(self->local_addr);
+  g_free(self->fetch_batch);
   g_mutex_clear(&self->pending_close_lock);
   g_cond_clear(&self->pending_close_cond);
   log_source_free(s);
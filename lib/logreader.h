@@ -40,6 +40,9 @@
 #define LR_IGNORE_AUX_DATA 0x0008
 #define LR_THREADED        0x0040
 
+/* the maximum number of messages fetched and posted at once */
+#define LOG_READER_FETCH_BATCH_MAX 32
+
 /* options */
 
 typedef struct _LogReaderOptions
@@ -56,6 +59,18 @@ typedef struct _LogReaderOptions
 
 typedef struct _LogReader LogReader;
 
+/* Orders the read turns of a group of readers.  A reader with a scheduler
+ * does not process its input as soon as it is signalled, it asks for a
+ * turn via schedule() instead and processes the input once the scheduler
+ * calls log_reader_run_turn().  release() is called when that turn is over
+ * or when the reader is deinitialized (queued or not). */
+typedef struct _LogReaderScheduler LogReaderScheduler;
+struct _LogReaderScheduler
+{
+  void (*schedule)(LogReaderScheduler *self, LogReader *reader);
+  void (*release)(LogReaderScheduler *self, LogReader *reader);
+};
+
 struct _LogReader
 {
   LogSource super;
@@ -69,6 +84,13 @@ struct _LogReader
   StatsAggregator *max_message_size;
   StatsAggregator *average_messages_size;
   StatsAggregator *CPS;
+  LogProtoServerFetchSlice *fetch_batch;
+
+  /* fetches are run by a thread of our own instead of the shared I/O worker pool */
+  gboolean dedicated_thread;
+  MainLoopIOWorkerPool *dedicated_worker;
+
+  LogReaderScheduler *scheduler;
 
   /* NOTE: these used to be LogReaderWatch members, which were merged into
    * LogReader with the multi-thread refactorization */
@@ -76,7 +98,7 @@ struct _LogReader
   struct iv_task restart_task;
   struct iv_event schedule_wakeup;
   MainLoopIOWorkerJob io_job;
-  guint watches_running:1, suspended:1, realloc_window_after_fetch:1;
+  guint watches_running:1, suspended:1, realloc_window_after_fetch:1, in_turn:1;
   gint notify_code;
 
 
@@ -99,6 +121,9 @@ void log_reader_set_peer_addr(LogReader *s, GSockAddr *peer_addr);
 void log_reader_set_local_addr(LogReader *s, GSockAddr *local_addr);
 void log_reader_set_immediate_check(LogReader *s);
 void log_reader_disable_bookmark_saving(LogReader *s);
+void log_reader_set_dedicated_thread(LogReader *s, gboolean dedicated_thread);
+void log_reader_set_scheduler(LogReader *s, LogReaderScheduler *scheduler);
+void log_reader_run_turn(LogReader *s);
 void log_reader_open(LogReader *s, LogProtoServer *proto, PollEvents *poll_events);
 void log_reader_close_proto(LogReader *s);
 LogReader *log_reader_new(GlobalConfig *cfg);
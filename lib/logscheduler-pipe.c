@@ -29,6 +29,15 @@ log_scheduler_pipe_get_scheduler_options(LogPipe *s)
   return &self->scheduler_options;
 }
 
+static gboolean
+_pre_config_init(LogPipe *s)
+{
+  LogSchedulerPipe *self = (LogSchedulerPipe *) s;
+
+  main_loop_worker_allocate_thread_space(log_scheduler_options_get_num_partition_threads(&self->scheduler_options));
+  return TRUE;
+}
+
 static gboolean
 _init(LogPipe *s)
 {
@@ -46,6 +55,14 @@ _init(LogPipe *s)
   return TRUE;
 }
 
+static gboolean
+_post_config_init(LogPipe *s)
+{
+  LogSchedulerPipe *self = (LogSchedulerPipe *) s;
+
+  return log_scheduler_start_threads(self->scheduler);
+}
+
 static gboolean
 _deinit(LogPipe *s)
 {
@@ -78,7 +95,9 @@ log_scheduler_pipe_new(GlobalConfig *cfg)
   LogSchedulerPipe *self = g_new0(LogSchedulerPipe, 1);
 
   log_pipe_init_instance(&self->super, cfg);
+  self->super.pre_config_init = _pre_config_init;
   self->super.init = _init;
+  self->super.post_config_init = _post_config_init;
   self->super.deinit = _deinit;
   self->super.queue = _queue;
   self->super.free_fn = _free;
@@ -86,3 +105,22 @@ log_scheduler_pipe_new(GlobalConfig *cfg)
   log_pipe_add_info(&self->super, "scheduler");
   return &self->super;
 }
+
+/* resequence(): the counterpart of parallelize(preserve-order(yes)) */
+
+static void
+_resequence_queue(LogPipe *s, LogMessage *msg, const LogPathOptions *path_options)
+{
+  if (!log_scheduler_resequence(s->pipe_next, msg, path_options))
+    log_pipe_forward_msg(s, msg, path_options);
+}
+
+LogPipe *
+log_resequence_pipe_new(GlobalConfig *cfg)
+{
+  LogPipe *self = log_pipe_new(cfg);
+
+  self->queue = _resequence_queue;
+  log_pipe_add_info(self, "resequence");
+  return self;
+}
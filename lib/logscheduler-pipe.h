@@ -35,5 +35,6 @@ typedef struct _LogSchedulerPipe
 
 LogSchedulerOptions *log_scheduler_pipe_get_scheduler_options(LogPipe *s);
 LogPipe *log_scheduler_pipe_new(GlobalConfig *cfg);
+LogPipe *log_resequence_pipe_new(GlobalConfig *cfg);
 
 #endif
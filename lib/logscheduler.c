@@ -23,6 +23,9 @@
 
 #include "logscheduler.h"
 #include "template/eval.h"
+#include "tls-support.h"
+
+#include <iv.h>
 
 static void
 _reinject_message(LogPipe *front_pipe, LogMessage *msg, const LogPathOptions *path_options)
@@ -51,17 +54,254 @@ _batch_new(struct iv_list_head *elements)
 void
 _batch_free(LogSchedulerBatch *batch)
 {
+  if (batch->sequence)
+    g_array_free(batch->sequence, TRUE);
   g_free(batch);
 }
 
+/*
+ * Reordering
+ *
+ * With preserve-order(yes) messages get a sequence number from their input
+ * thread as they are queued.  The resequence() element, placed after the
+ * CPU heavy part of the log path, hands the messages over to the reorder
+ * buffer of their input thread instead of forwarding them right away.  A
+ * message is forwarded once every message with a smaller sequence number
+ * has finished its processing in the partitions, either by reaching
+ * resequence() or by being dropped on the way.  As processing is
+ * synchronous, that is when the partition returns from log_pipe_queue().
+ *
+ * The messages keep their ack and flow-control state while sitting in the
+ * reorder buffer, so the window of the sources bounds its size.
+ */
+
+typedef struct _LogSchedulerReorderedMessage
+{
+  LogPipe *next_pipe;
+  LogMessageQueueNode *node;
+} LogSchedulerReorderedMessage;
+
+typedef struct _LogSchedulerReorderSlot
+{
+  gboolean completed;
+  GQueue messages;
+} LogSchedulerReorderSlot;
+
+#define LOGSCHEDULER_REORDER_COMPACT_THRESHOLD 1024
+
+TLS_BLOCK_START
+{
+  LogSchedulerReorderBuffer *current_reorder_buffer;
+  guint64 current_seq;
+}
+TLS_BLOCK_END;
+
+#define current_reorder_buffer __tls_deref(current_reorder_buffer)
+#define current_seq __tls_deref(current_seq)
+
+static void
+_forward_queue_node(LogPipe *front_pipe, LogMessageQueueNode *node)
+{
+  LogMessage *msg = log_msg_ref(node->msg);
+
+  LogPathOptions path_options = LOG_PATH_OPTIONS_INIT;
+  path_options.ack_needed = node->ack_needed;
+  path_options.flow_control_requested = node->flow_control_requested;
+
+  log_msg_free_queue_node(node);
+
+  log_msg_refcache_start_consumer(msg, &path_options);
+  _reinject_message(front_pipe, msg, &path_options);
+  log_msg_unref(msg);
+  log_msg_refcache_stop();
+}
+
+static void
+_reorder_slot_forward(LogSchedulerReorderSlot *slot)
+{
+  LogSchedulerReorderedMessage *entry;
+
+  while ((entry = g_queue_pop_head(&slot->messages)))
+    {
+      _forward_queue_node(entry->next_pipe, entry->node);
+      g_free(entry);
+    }
+  g_free(slot);
+}
+
+static void
+_reorder_slot_drop(LogSchedulerReorderSlot *slot)
+{
+  LogSchedulerReorderedMessage *entry;
+
+  while ((entry = g_queue_pop_head(&slot->messages)))
+    {
+      _forward_queue_node(NULL, entry->node);
+      g_free(entry);
+    }
+  g_free(slot);
+}
+
+static void
+_reorder_buffer_init(LogSchedulerReorderBuffer *self)
+{
+  g_mutex_init(&self->lock);
+  self->slots = g_ptr_array_new();
+  self->head = 0;
+  self->base_seq = 0;
+  self->draining = FALSE;
+}
+
+static void
+_reorder_buffer_clear(LogSchedulerReorderBuffer *self)
+{
+  if (!self->slots)
+    return;
+
+  for (guint i = self->head; i < self->slots->len; i++)
+    {
+      LogSchedulerReorderSlot *slot = g_ptr_array_index(self->slots, i);
+
+      if (slot)
+        _reorder_slot_drop(slot);
+    }
+  g_ptr_array_free(self->slots, TRUE);
+  self->slots = NULL;
+  g_mutex_clear(&self->lock);
+}
+
+/* must be called with the lock held */
+static LogSchedulerReorderSlot *
+_reorder_buffer_lookup_slot(LogSchedulerReorderBuffer *self, guint64 seq)
+{
+  g_assert(seq >= self->base_seq);
+
+  guint index = self->head + (seq - self->base_seq);
+  if (index >= self->slots->len)
+    g_ptr_array_set_size(self->slots, index + 1);
+
+  LogSchedulerReorderSlot *slot = g_ptr_array_index(self->slots, index);
+  if (!slot)
+    {
+      slot = g_new0(LogSchedulerReorderSlot, 1);
+      g_queue_init(&slot->messages);
+      g_ptr_array_index(self->slots, index) = slot;
+    }
+  return slot;
+}
+
+/* must be called with the lock held */
+static LogSchedulerReorderSlot *
+_reorder_buffer_pop_completed_slot(LogSchedulerReorderBuffer *self)
+{
+  if (self->head >= self->slots->len)
+    return NULL;
+
+  LogSchedulerReorderSlot *slot = g_ptr_array_index(self->slots, self->head);
+  if (!slot || !slot->completed)
+    return NULL;
+
+  g_ptr_array_index(self->slots, self->head) = NULL;
+  self->head++;
+  self->base_seq++;
+
+  if (self->head == self->slots->len || self->head >= LOGSCHEDULER_REORDER_COMPACT_THRESHOLD)
+    {
+      g_ptr_array_remove_range(self->slots, 0, self->head);
+      self->head = 0;
+    }
+  return slot;
+}
+
+static void
+_reorder_buffer_add(LogSchedulerReorderBuffer *self, guint64 seq, LogPipe *next_pipe, LogMessageQueueNode *node)
+{
+  LogSchedulerReorderedMessage *entry = g_new0(LogSchedulerReorderedMessage, 1);
+  entry->next_pipe = next_pipe;
+  entry->node = node;
+
+  g_mutex_lock(&self->lock);
+  g_queue_push_tail(&_reorder_buffer_lookup_slot(self, seq)->messages, entry);
+  g_mutex_unlock(&self->lock);
+}
+
+/* the message with the sequence number seq has finished its processing,
+ * forward everything that became contiguous.  Only one thread forwards at
+ * a time, the others just mark their slot completed and leave. */
+static void
+_reorder_buffer_complete(LogSchedulerReorderBuffer *self, guint64 seq)
+{
+  LogSchedulerReorderSlot *slot;
+
+  g_mutex_lock(&self->lock);
+  _reorder_buffer_lookup_slot(self, seq)->completed = TRUE;
+  if (self->draining)
+    {
+      g_mutex_unlock(&self->lock);
+      return;
+    }
+
+  self->draining = TRUE;
+  while ((slot = _reorder_buffer_pop_completed_slot(self)))
+    {
+      g_mutex_unlock(&self->lock);
+      _reorder_slot_forward(slot);
+      g_mutex_lock(&self->lock);
+    }
+  self->draining = FALSE;
+  g_mutex_unlock(&self->lock);
+}
+
+gboolean
+log_scheduler_resequence(LogPipe *next_pipe, LogMessage *msg, const LogPathOptions *path_options)
+{
+  LogSchedulerReorderBuffer *reorder_buffer = current_reorder_buffer;
+
+  if (!reorder_buffer)
+    return FALSE;
+
+  _reorder_buffer_add(reorder_buffer, current_seq, next_pipe, log_msg_alloc_queue_node(msg, path_options));
+  log_msg_unref(msg);
+  return TRUE;
+}
+
 /* LogSchedulerPartition */
 
+static void
+_process_batch(LogSchedulerPartition *partition, LogSchedulerBatch *batch)
+{
+  struct iv_list_head *ilh, *next;
+  guint element_index = 0;
+
+  iv_list_for_each_safe(ilh, next, &batch->elements)
+  {
+    LogMessageQueueNode *node = iv_list_entry(ilh, LogMessageQueueNode, list);
+
+    iv_list_del(&node->list);
+
+    if (!batch->reorder_buffer)
+      {
+        _forward_queue_node(partition->front_pipe, node);
+        continue;
+      }
+
+    guint64 seq = g_array_index(batch->sequence, guint64, element_index++);
+
+    current_reorder_buffer = batch->reorder_buffer;
+    current_seq = seq;
+    _forward_queue_node(partition->front_pipe, node);
+    current_reorder_buffer = NULL;
+
+    _reorder_buffer_complete(batch->reorder_buffer, seq);
+  }
+  _batch_free(batch);
+}
+
 static void
 _work(gpointer s, gpointer arg)
 {
   LogSchedulerPartition *partition = (LogSchedulerPartition *) s;
   struct iv_list_head *ilh, *next;
-  struct iv_list_head *ilh2, *next2;
 
   /* batches_lock protects the batches list itself.  We take off partitions
    * one-by-one under the protection of the lock */
@@ -80,26 +320,7 @@ _work(gpointer s, gpointer arg)
         LogSchedulerBatch *batch = iv_list_entry(ilh, LogSchedulerBatch, list);
         iv_list_del(&batch->list);
 
-        iv_list_for_each_safe(ilh2, next2, &batch->elements)
-        {
-          LogMessageQueueNode *node = iv_list_entry(ilh2, LogMessageQueueNode, list);
-
-          iv_list_del(&node->list);
-
-          LogMessage *msg = log_msg_ref(node->msg);
-
-          LogPathOptions path_options = LOG_PATH_OPTIONS_INIT;
-          path_options.ack_needed = node->ack_needed;
-          path_options.flow_control_requested = node->flow_control_requested;
-
-          log_msg_free_queue_node(node);
-
-          log_msg_refcache_start_consumer(msg, &path_options);
-          _reinject_message(partition->front_pipe, msg, &path_options);
-          log_msg_unref(msg);
-          log_msg_refcache_stop();
-        }
-        _batch_free(batch);
+        _process_batch(partition, batch);
       }
       g_mutex_lock(&partition->batches_lock);
     }
@@ -128,9 +349,170 @@ _complete(gpointer s, gpointer arg)
     main_loop_io_worker_job_submit(&partition->io_job, NULL);
 }
 
+/*
+ * Partition threads
+ *
+ * With partition-threads(yes) each partition is bound to its own
+ * MainLoopThreadedWorker instead of being flushed as an io_job on the
+ * shared worker pool.  Input threads hand over their batches through a
+ * bounded ring: if the ring is full, the input thread waits until the
+ * partition thread catches up, which propagates backpressure back to the
+ * sources.  As a partition is only ever drained by its own thread, in the
+ * order of the ring, messages with the same partition-key are still
+ * delivered in order.
+ */
+
+static LogSchedulerBatch *
+_partition_ring_pop(LogSchedulerPartition *partition)
+{
+  LogSchedulerBatch *batch = NULL;
+
+  g_mutex_lock(&partition->batches_lock);
+  if (partition->thread.ring_len > 0)
+    {
+      batch = partition->thread.ring[partition->thread.ring_head];
+      partition->thread.ring_head = (partition->thread.ring_head + 1) % LOGSCHEDULER_PARTITION_RING_SIZE;
+      partition->thread.ring_len--;
+      g_cond_signal(&partition->thread.ring_cond);
+    }
+  g_mutex_unlock(&partition->batches_lock);
+  return batch;
+}
+
+static void
+_partition_drain_ring(LogSchedulerPartition *partition)
+{
+  LogSchedulerBatch *batch;
+
+  while ((batch = _partition_ring_pop(partition)))
+    {
+      _process_batch(partition, batch);
+      main_loop_worker_invoke_batch_callbacks();
+    }
+  main_loop_worker_run_gc();
+}
+
+static void
+_partition_thread_wakeup(gpointer s)
+{
+  LogSchedulerPartition *partition = (LogSchedulerPartition *) s;
+
+  _partition_drain_ring(partition);
+
+  g_mutex_lock(&partition->batches_lock);
+  gboolean exiting = partition->thread.exiting;
+  g_mutex_unlock(&partition->batches_lock);
+
+  if (exiting)
+    iv_quit();
+}
+
+static void
+_partition_thread_add_batch(LogSchedulerPartition *partition, LogSchedulerBatch *batch)
+{
+  g_mutex_lock(&partition->batches_lock);
+  while (partition->thread.ring_len == LOGSCHEDULER_PARTITION_RING_SIZE &&
+         !partition->thread.exiting)
+    g_cond_wait(&partition->thread.ring_cond, &partition->batches_lock);
+
+  if (partition->thread.exiting)
+    {
+      /* the partition thread is about to exit (or has already exited), it
+       * drains the ring one last time, but anything coming later is
+       * processed right here */
+      g_mutex_unlock(&partition->batches_lock);
+      _process_batch(partition, batch);
+      return;
+    }
+
+  gint tail = (partition->thread.ring_head + partition->thread.ring_len) % LOGSCHEDULER_PARTITION_RING_SIZE;
+  partition->thread.ring[tail] = batch;
+  gboolean trigger_wakeup = (partition->thread.ring_len++ == 0);
+  g_mutex_unlock(&partition->batches_lock);
+
+  if (trigger_wakeup)
+    iv_event_post(&partition->thread.wakeup);
+}
+
+static gboolean
+_partition_thread_init(MainLoopThreadedWorker *s)
+{
+  LogSchedulerPartition *partition = (LogSchedulerPartition *) s->data;
+
+  iv_event_register(&partition->thread.wakeup);
+  return TRUE;
+}
+
+static void
+_partition_thread_deinit(MainLoopThreadedWorker *s)
+{
+  LogSchedulerPartition *partition = (LogSchedulerPartition *) s->data;
+
+  iv_event_unregister(&partition->thread.wakeup);
+}
+
+static void
+_partition_thread_run(MainLoopThreadedWorker *s)
+{
+  LogSchedulerPartition *partition = (LogSchedulerPartition *) s->data;
+
+  iv_main();
+
+  /* batches added before the exit request was noticed */
+  _partition_drain_ring(partition);
+}
+
 static void
-_partition_add_batch(LogSchedulerPartition *partition, LogSchedulerBatch *batch)
+_partition_thread_request_exit(MainLoopThreadedWorker *s)
 {
+  LogSchedulerPartition *partition = (LogSchedulerPartition *) s->data;
+
+  g_mutex_lock(&partition->batches_lock);
+  partition->thread.exiting = TRUE;
+  g_cond_broadcast(&partition->thread.ring_cond);
+  g_mutex_unlock(&partition->batches_lock);
+
+  iv_event_post(&partition->thread.wakeup);
+}
+
+static gboolean
+_partition_thread_start(LogSchedulerPartition *partition)
+{
+  main_loop_threaded_worker_init(&partition->thread.worker, MLW_THREADED_INPUT_WORKER, partition);
+  partition->thread.worker.thread_init = _partition_thread_init;
+  partition->thread.worker.thread_deinit = _partition_thread_deinit;
+  partition->thread.worker.run = _partition_thread_run;
+  partition->thread.worker.request_exit = _partition_thread_request_exit;
+
+  IV_EVENT_INIT(&partition->thread.wakeup);
+  partition->thread.wakeup.cookie = partition;
+  partition->thread.wakeup.handler = _partition_thread_wakeup;
+
+  partition->thread.ring_head = 0;
+  partition->thread.ring_len = 0;
+  partition->thread.exiting = FALSE;
+
+  return main_loop_threaded_worker_start(&partition->thread.worker);
+}
+
+static void
+_partition_thread_stop(LogSchedulerPartition *partition)
+{
+  /* the thread itself is stopped by the request_exit mechanism of main
+   * loop worker threads, by now we only need to join it */
+  main_loop_threaded_worker_clear(&partition->thread.worker);
+  g_assert(partition->thread.ring_len == 0);
+}
+
+static void
+_partition_add_batch(LogScheduler *self, LogSchedulerPartition *partition, LogSchedulerBatch *batch)
+{
+  if (self->num_partition_threads > 0)
+    {
+      _partition_thread_add_batch(partition, batch);
+      return;
+    }
+
   gboolean trigger_flush = FALSE;
 
   g_mutex_lock(&partition->batches_lock);
@@ -164,11 +546,13 @@ _partition_init(LogSchedulerPartition *partition, LogPipe *front_pipe)
 
   INIT_IV_LIST_HEAD(&partition->batches);
   g_mutex_init(&partition->batches_lock);
+  g_cond_init(&partition->thread.ring_cond);
 }
 
 void
 _partition_clear(LogSchedulerPartition *partition)
 {
+  g_cond_clear(&partition->thread.ring_cond);
   g_mutex_clear(&partition->batches_lock);
 }
 
@@ -209,11 +593,18 @@ _flush_batch(gpointer s)
       LogSchedulerBatch *batch = _batch_new(&thread_state->batch_by_partition[partition_index]);
       INIT_IV_LIST_HEAD(&thread_state->batch_by_partition[partition_index]);
 
+      if (self->options->preserve_order)
+        {
+          batch->reorder_buffer = &thread_state->reorder;
+          batch->sequence = thread_state->sequence_by_partition[partition_index];
+          thread_state->sequence_by_partition[partition_index] = g_array_new(FALSE, FALSE, sizeof(guint64));
+        }
+
       /* add the new batch to the target partition */
 
       LogSchedulerPartition *partition = &self->partitions[partition_index];
 
-      _partition_add_batch(partition, batch);
+      _partition_add_batch(self, partition, batch);
 
 
     }
@@ -233,6 +624,11 @@ _queue_thread(LogScheduler *self, LogSchedulerThreadState *thread_state, LogMess
   LogMessageQueueNode *node;
   node = log_msg_alloc_queue_node(msg, path_options);
   iv_list_add_tail(&node->list, &thread_state->batch_by_partition[partition_index]);
+  if (self->options->preserve_order)
+    {
+      guint64 seq = thread_state->next_seq++;
+      g_array_append_val(thread_state->sequence_by_partition[partition_index], seq);
+    }
   thread_state->num_messages++;
   log_msg_unref(msg);
 }
@@ -247,6 +643,24 @@ _thread_state_init(LogScheduler *self, LogSchedulerThreadState *state)
 
   for (gint i = 0; i < self->options->num_partitions; i++)
     INIT_IV_LIST_HEAD(&state->batch_by_partition[i]);
+
+  if (!self->options->preserve_order)
+    return;
+
+  for (gint i = 0; i < self->options->num_partitions; i++)
+    state->sequence_by_partition[i] = g_array_new(FALSE, FALSE, sizeof(guint64));
+  _reorder_buffer_init(&state->reorder);
+}
+
+static void
+_thread_state_clear(LogScheduler *self, LogSchedulerThreadState *state)
+{
+  for (gint i = 0; i < self->options->num_partitions; i++)
+    {
+      if (state->sequence_by_partition[i])
+        g_array_free(state->sequence_by_partition[i], TRUE);
+    }
+  _reorder_buffer_clear(&state->reorder);
 }
 
 static void
@@ -258,6 +672,15 @@ _init_thread_states(LogScheduler *self)
     }
 }
 
+static void
+_free_thread_states(LogScheduler *self)
+{
+  for (gint i = 0; i < self->num_threads; i++)
+    {
+      _thread_state_clear(self, &self->thread_states[i]);
+    }
+}
+
 static void
 _init_partitions(LogScheduler *self)
 {
@@ -282,9 +705,36 @@ log_scheduler_init(LogScheduler *self)
   return TRUE;
 }
 
+/* must be called from the main thread, after log_scheduler_init() */
+gboolean
+log_scheduler_start_threads(LogScheduler *self)
+{
+  if (!self->options->partition_threads || self->num_partition_threads > 0)
+    return TRUE;
+
+  for (gint i = 0; i < self->options->num_partitions; i++)
+    {
+      if (!_partition_thread_start(&self->partitions[i]))
+        {
+          /* the thread has already exited, only the join is left */
+          main_loop_threaded_worker_clear(&self->partitions[i].thread.worker);
+          msg_error("Error starting the partition threads of parallelize()",
+                    evt_tag_int("partition", i),
+                    evt_tag_int("started", self->num_partition_threads));
+          return FALSE;
+        }
+      self->num_partition_threads++;
+    }
+
+  return TRUE;
+}
+
 void
 log_scheduler_deinit(LogScheduler *self)
 {
+  for (gint i = 0; i < self->num_partition_threads; i++)
+    _partition_thread_stop(&self->partitions[i]);
+  self->num_partition_threads = 0;
 }
 
 void
@@ -323,6 +773,7 @@ void
 log_scheduler_free(LogScheduler *self)
 {
   log_pipe_unref(self->front_pipe);
+  _free_thread_states(self);
   _free_partitions(self);
   g_free(self);
 }
@@ -342,6 +793,12 @@ log_scheduler_init(LogScheduler *self)
   return TRUE;
 }
 
+gboolean
+log_scheduler_start_threads(LogScheduler *self)
+{
+  return TRUE;
+}
+
 void
 log_scheduler_deinit(LogScheduler *self)
 {
@@ -353,6 +810,12 @@ log_scheduler_push(LogScheduler *self, LogMessage *msg, const LogPathOptions *pa
   _reinject_message(self->front_pipe, msg, path_options);
 }
 
+gboolean
+log_scheduler_resequence(LogPipe *next_pipe, LogMessage *msg, const LogPathOptions *path_options)
+{
+  return FALSE;
+}
+
 LogScheduler *
 log_scheduler_new(LogSchedulerOptions *options, LogPipe *front_pipe)
 {
@@ -379,11 +842,24 @@ log_scheduler_options_set_partition_key_ref(LogSchedulerOptions *options, LogTem
   options->partition_key = partition_key;
 }
 
+/* the number of worker threads to be allocated in pre_config_init() */
+gint
+log_scheduler_options_get_num_partition_threads(LogSchedulerOptions *options)
+{
+#if SYSLOG_NG_HAVE_IV_WORK_POOL_SUBMIT_CONTINUATION
+  if (options->partition_threads && options->num_partitions > 0)
+    return MIN(options->num_partitions, LOGSCHEDULER_MAX_PARTITIONS);
+#endif
+  return 0;
+}
+
 void
 log_scheduler_options_defaults(LogSchedulerOptions *options)
 {
   options->num_partitions = -1;
   options->partition_key = NULL;
+  options->partition_threads = FALSE;
+  options->preserve_order = FALSE;
 }
 
 gboolean
@@ -26,17 +26,22 @@
 
 #include "logpipe.h"
 #include "mainloop-io-worker.h"
+#include "mainloop-threaded-worker.h"
 #include "template/templates.h"
 
 #include <iv_list.h>
 #include <iv_event.h>
 
 #define LOGSCHEDULER_MAX_PARTITIONS 16
+#define LOGSCHEDULER_PARTITION_RING_SIZE 64
 
 typedef struct _LogSchedulerBatch
 {
   struct iv_list_head elements;
   struct iv_list_head list;
+  /* sequence numbers of the elements, with preserve-order(yes) */
+  struct _LogSchedulerReorderBuffer *reorder_buffer;
+  GArray *sequence;
 } LogSchedulerBatch;
 
 typedef struct _LogSchedulerPartition
@@ -46,21 +51,52 @@ typedef struct _LogSchedulerPartition
   gboolean flush_running;
   MainLoopIOWorkerJob io_job;
   LogPipe *front_pipe;
+
+  /* used with partition-threads(yes): batches are handed over to a
+   * dedicated thread through a bounded ring, protected by batches_lock */
+  struct
+  {
+    MainLoopThreadedWorker worker;
+    struct iv_event wakeup;
+    GCond ring_cond;
+    LogSchedulerBatch *ring[LOGSCHEDULER_PARTITION_RING_SIZE];
+    gint ring_head;
+    gint ring_len;
+    gboolean exiting;
+  } thread;
 } LogSchedulerPartition;
 
+/* restores the order of the messages taken off an input thread, see
+ * log_scheduler_resequence() */
+typedef struct _LogSchedulerReorderBuffer
+{
+  GMutex lock;
+  /* slots in the order of sequence numbers, slots[head] is base_seq */
+  GPtrArray *slots;
+  guint head;
+  guint64 base_seq;
+  gboolean draining;
+} LogSchedulerReorderBuffer;
+
 typedef struct _LogSchedulerThreadState
 {
   WorkerBatchCallback batch_callback;
   struct iv_list_head batch_by_partition[LOGSCHEDULER_MAX_PARTITIONS];
+  GArray *sequence_by_partition[LOGSCHEDULER_MAX_PARTITIONS];
 
   guint64 num_messages;
   gint last_partition;
+
+  guint64 next_seq;
+  LogSchedulerReorderBuffer reorder;
 } LogSchedulerThreadState;
 
 typedef struct _LogSchedulerOptions
 {
   gint num_partitions;
   LogTemplate *partition_key;
+  gboolean partition_threads;
+  gboolean preserve_order;
 } LogSchedulerOptions;
 
 typedef struct _LogScheduler
@@ -68,18 +104,22 @@ typedef struct _LogScheduler
   LogPipe *front_pipe;
   LogSchedulerOptions *options;
   gint num_threads;
+  gint num_partition_threads;
   LogSchedulerPartition partitions[LOGSCHEDULER_MAX_PARTITIONS];
   LogSchedulerThreadState thread_states[];
 } LogScheduler;
 
 gboolean log_scheduler_init(LogScheduler *self);
+gboolean log_scheduler_start_threads(LogScheduler *self);
 void log_scheduler_deinit(LogScheduler *self);
 
 void log_scheduler_push(LogScheduler *self, LogMessage *msg, const LogPathOptions *path_options);
+gboolean log_scheduler_resequence(LogPipe *next_pipe, LogMessage *msg, const LogPathOptions *path_options);
 LogScheduler *log_scheduler_new(LogSchedulerOptions *options, LogPipe *front_pipe);
 void log_scheduler_free(LogScheduler *self);
 
 void log_scheduler_options_set_partition_key_ref(LogSchedulerOptions *options, LogTemplate *partition_key);
+gint log_scheduler_options_get_num_partition_threads(LogSchedulerOptions *options);
 void log_scheduler_options_defaults(LogSchedulerOptions *options);
 gboolean log_scheduler_options_init(LogSchedulerOptions *options, GlobalConfig *cfg);
 void log_scheduler_options_destroy(LogSchedulerOptions *options);
@@ -30,17 +30,30 @@
 #include "stats/stats-cluster-single.h"
 #include "msg-stats.h"
 #include "logmsg/tags.h"
+#include "logmsg/logmsg-trace.h"
 #include "ack-tracker/ack_tracker.h"
 #include "ack-tracker/ack_tracker_factory.h"
 #include "timeutils/misc.h"
 #include "compat/time.h"
 #include "scratch-buffers.h"
+#include "mainloop-worker.h"
+#include "apphook.h"
 
 #include <string.h>
 #include <unistd.h>
 
 gboolean accurate_nanosleep = FALSE;
 
+struct _LogSourcePendingAck
+{
+  WorkerBatchCallback cb;
+  LogSource *source;
+  guint32 window_size_increment;
+  guint32 num_acks;
+};
+
+static StatsCounterItem *stat_coalesced_window_updates;
+
 void
 log_source_wakeup(LogSource *self)
 {
@@ -155,10 +168,87 @@ _flow_control_rate_adjust(LogSource *self)
 #endif
 }
 
+/*
+ * Ack coalescing
+ *
+ * Destinations ack messages one by one (or range by range), each ack
+ * becoming an atomic add on the window shared with the source thread and,
+ * if the window was empty, a wakeup of the source.  Acks in worker threads
+ * are summed up per source instead, and delivered as a single window update
+ * (and at most one wakeup) once the worker finishes its batch.
+ *
+ * This is only done in threads that are guaranteed to invoke their batch
+ * callbacks without waiting on a source window first: I/O workers (at the
+ * end of each job) and threaded destination workers (after each ack).
+ * Threaded sources may block waiting for their own window, so acks in
+ * those threads are delivered immediately.
+ */
+
+static void
+_flush_pending_ack(gpointer user_data)
+{
+  LogSourcePendingAck *pending = (LogSourcePendingAck *) user_data;
+  LogSource *self = pending->source;
+
+  _flow_control_window_size_adjust(self, pending->window_size_increment, FALSE);
+  if (pending->num_acks > 1)
+    stats_counter_add(stat_coalesced_window_updates, pending->num_acks - 1);
+  pending->window_size_increment = 0;
+  pending->num_acks = 0;
+
+  log_pipe_unref(&self->super);
+}
+
+static void
+_init_pending_acks(LogSource *self)
+{
+  if (self->pending_acks)
+    return;
+
+  self->num_pending_acks = main_loop_worker_get_max_number_of_threads();
+  self->pending_acks = g_new0(LogSourcePendingAck, self->num_pending_acks);
+  for (gint i = 0; i < self->num_pending_acks; i++)
+    {
+      worker_batch_callback_init(&self->pending_acks[i].cb);
+      self->pending_acks[i].cb.func = _flush_pending_ack;
+      self->pending_acks[i].cb.user_data = &self->pending_acks[i];
+      self->pending_acks[i].source = self;
+    }
+}
+
+static inline gboolean
+_thread_can_coalesce_acks(void)
+{
+  MainLoopWorkerType worker_type = main_loop_worker_get_thread_type();
+
+  return worker_type == MLW_ASYNC_WORKER || worker_type == MLW_THREADED_OUTPUT_WORKER;
+}
+
+static gboolean
+_coalesce_ack(LogSource *self, guint32 window_size_increment)
+{
+  gint thread_index = main_loop_worker_get_thread_index();
+
+  if (thread_index < 0 || thread_index >= self->num_pending_acks || !_thread_can_coalesce_acks())
+    return FALSE;
+
+  LogSourcePendingAck *pending = &self->pending_acks[thread_index];
+  if (pending->num_acks == 0)
+    {
+      /* the reference is dropped by _flush_pending_ack() */
+      log_pipe_ref(&self->super);
+      main_loop_worker_register_batch_callback(&pending->cb);
+    }
+  pending->window_size_increment += window_size_increment;
+  pending->num_acks++;
+  return TRUE;
+}
+
 void
 log_source_flow_control_adjust(LogSource *self, guint32 window_size_increment)
 {
-  _flow_control_window_size_adjust(self, window_size_increment, FALSE);
+  if (!_coalesce_ack(self, window_size_increment))
+    _flow_control_window_size_adjust(self, window_size_increment, FALSE);
   _flow_control_rate_adjust(self);
 }
 
@@ -181,10 +271,51 @@ log_source_disable_bookmark_saving(LogSource *self)
  * This is running in the same thread as the _destination_, thus care must
  * be taken when manipulating the LogSource data structure.
  **/
+static void
+_release_window_bytes(LogSource *self, gsize bytes)
+{
+  if (self->window_bytes_limit <= 0 || bytes == 0)
+    return;
+
+  gssize old_bytes_in_flight = atomic_gssize_sub(&self->window_bytes_in_flight, bytes);
+
+  if (old_bytes_in_flight >= self->window_bytes_limit &&
+      old_bytes_in_flight - (gssize) bytes < self->window_bytes_limit)
+    log_source_wakeup(self);
+}
+
+static void
+_observe_latency(StatsHistogram *histogram, LogMessage *msg, LogMessageTraceStage from, LogMessageTraceStage to)
+{
+  gint64 duration = log_msg_trace_get_duration(msg, from, to);
+
+  if (duration >= 0)
+    stats_histogram_observe(histogram, duration / 1000);
+}
+
+static void
+_finish_latency_trace(LogSource *self, LogMessage *msg, AckType ack_type)
+{
+  if (ack_type != AT_PROCESSED)
+    return;
+
+  log_msg_trace_stamp(msg, LM_TRACE_ACKED);
+  _observe_latency(&self->metrics.latency_trace.processing, msg, LM_TRACE_POSTED, LM_TRACE_PROCESSED);
+  _observe_latency(&self->metrics.latency_trace.queue, msg, LM_TRACE_QUEUED, LM_TRACE_DEQUEUED);
+  _observe_latency(&self->metrics.latency_trace.delivery, msg, LM_TRACE_DEQUEUED, LM_TRACE_ACKED);
+  _observe_latency(&self->metrics.latency_trace.total, msg, LM_TRACE_POSTED, LM_TRACE_ACKED);
+}
+
 static void
 log_source_msg_ack(LogMessage *msg, AckType ack_type)
 {
   AckTracker *ack_tracker = msg->ack_record->tracker;
+
+  if (G_UNLIKELY(msg->trace))
+    _finish_latency_trace(ack_tracker->source, msg, ack_type);
+
+  /* NOTE: the message may be freed by the AckTracker */
+  _release_window_bytes(ack_tracker->source, msg->recvd_rawmsg_size);
   ack_tracker_manage_msg_ack(ack_tracker, msg, ack_type);
 }
 
@@ -210,10 +341,27 @@ log_source_is_dynamic_window_enabled(LogSource *self)
   return dynamic_window_is_enabled(&self->dynamic_window);
 }
 
+/* Starvation is sampled: if the window is found empty, the whole interval
+ * since the previous sample is accounted as starvation time. */
+static void
+_update_window_starvation(LogSource *self, gsize free_window)
+{
+  gint64 now = g_get_monotonic_time();
+  DynamicWindow *dynamic_window = &self->dynamic_window;
+
+  dynamic_window->starving = (free_window == 0);
+  if (dynamic_window->starving && dynamic_window->last_sample_time)
+    stats_counter_add(self->metrics.stat_window_starvation, (now - dynamic_window->last_sample_time) / 1000);
+  dynamic_window->last_sample_time = now;
+}
+
 void
 log_source_dynamic_window_update_statistics(LogSource *self)
 {
-  dynamic_window_stat_update(&self->dynamic_window.stat, window_size_counter_get(&self->window_size, NULL));
+  gsize free_window = window_size_counter_get(&self->window_size, NULL);
+
+  dynamic_window_stat_update(&self->dynamic_window.stat, free_window);
+  _update_window_starvation(self, free_window);
   msg_trace("Updating dynamic window statistic", evt_tag_int("avg window size",
                                                              dynamic_window_stat_get_avg(&self->dynamic_window.stat)));
 }
@@ -333,12 +481,19 @@ _reclaim_window_instead_of_rebalance(LogSource *self)
   return reclaim_in_progress;
 }
 
+static inline gsize
+_get_current_dynamic_window(LogSource *self)
+{
+  return self->full_window_size - self->initial_window_size;
+}
+
 static void
 _dynamic_window_rebalance(LogSource *self)
 {
-  gsize current_dynamic_win = self->full_window_size - self->initial_window_size;
-  gboolean have_to_increase = current_dynamic_win < self->dynamic_window.pool->balanced_window;
-  gboolean have_to_decrease = current_dynamic_win > self->dynamic_window.pool->balanced_window;
+  gsize current_dynamic_win = _get_current_dynamic_window(self);
+  gsize target_window = dynamic_window_get_target(&self->dynamic_window);
+  gboolean have_to_increase = current_dynamic_win < target_window;
+  gboolean have_to_decrease = current_dynamic_win > target_window;
 
   msg_trace("Rebalance dynamic window",
             log_pipe_location_tag(&self->super),
@@ -347,12 +502,13 @@ _dynamic_window_rebalance(LogSource *self)
             evt_tag_int("dynamic_win", current_dynamic_win),
             evt_tag_int("static_window", self->initial_window_size),
             evt_tag_int("balanced_window", self->dynamic_window.pool->balanced_window),
+            evt_tag_int("target_window", target_window),
             evt_tag_int("avg_free", dynamic_window_stat_get_avg(&self->dynamic_window.stat)));
 
   if (have_to_increase)
-    _inc_balanced(self, self->dynamic_window.pool->balanced_window - current_dynamic_win);
+    _inc_balanced(self, target_window - current_dynamic_win);
   else if (have_to_decrease)
-    _dec_balanced(self, current_dynamic_win - self->dynamic_window.pool->balanced_window);
+    _dec_balanced(self, current_dynamic_win - target_window);
 }
 
 void
@@ -367,6 +523,63 @@ log_source_dynamic_window_realloc(LogSource *self)
   dynamic_window_stat_reset(&self->dynamic_window.stat);
 }
 
+gboolean
+log_source_dynamic_window_is_starving(LogSource *self)
+{
+  return dynamic_window_is_enabled(&self->dynamic_window) && self->dynamic_window.starving;
+}
+
+/* the part of the dynamic window this connection could give away: half of
+ * what it kept unused on average since the last realloc, without going
+ * below the per-connection minimum */
+gsize
+log_source_dynamic_window_get_surplus(LogSource *self)
+{
+  if (!dynamic_window_is_enabled(&self->dynamic_window) || self->dynamic_window.starving)
+    return 0;
+
+  gsize current_dynamic_win = _get_current_dynamic_window(self);
+  gsize min_window = dynamic_window_pool_clamp(self->dynamic_window.pool, 0);
+  if (current_dynamic_win <= min_window)
+    return 0;
+
+  gsize avg_free = dynamic_window_stat_get_avg(&self->dynamic_window.stat);
+  return MIN(avg_free / 2, current_dynamic_win - min_window);
+}
+
+/* how much the dynamic window of this connection may still grow */
+gsize
+log_source_dynamic_window_get_headroom(LogSource *self)
+{
+  if (!dynamic_window_is_enabled(&self->dynamic_window))
+    return 0;
+
+  gsize current_dynamic_win = _get_current_dynamic_window(self);
+  gsize max_window = dynamic_window_pool_clamp(self->dynamic_window.pool, G_MAXSIZE);
+
+  return max_window > current_dynamic_win ? max_window - current_dynamic_win : 0;
+}
+
+/* move the dynamic window of this connection by delta relative to its
+ * current size, independently of the periodic rebalance */
+void
+log_source_dynamic_window_shift(LogSource *self, gssize delta)
+{
+  if (!dynamic_window_is_enabled(&self->dynamic_window) || delta == 0)
+    return;
+
+  gssize target_window = (gssize) _get_current_dynamic_window(self) + delta;
+  self->dynamic_window.demand_offset = target_window - (gssize) self->dynamic_window.pool->balanced_window;
+
+  msg_trace("Shifting dynamic window",
+            log_pipe_location_tag(&self->super),
+            evt_tag_printf("connection", "%p", self),
+            evt_tag_long("delta", delta),
+            evt_tag_long("target_window", target_window));
+
+  log_source_schedule_dynamic_window_realloc(self);
+}
+
 void
 log_source_mangle_hostname(LogSource *self, LogMessage *msg)
 {
@@ -437,6 +650,10 @@ _register_window_stats(LogSource *self)
                                            &self->metrics.stat_full_window);
   stats_counter_set(self->metrics.stat_full_window, self->full_window_size);
 
+  stats_cluster_single_key_legacy_set_with_name(&sc_key, self->options->stats_source | SCS_SOURCE, self->stats_id,
+                                                instance_name, "window_starvation_msec");
+  self->metrics.stat_window_starvation_cluster = stats_register_dynamic_counter(4, &sc_key, SC_TYPE_SINGLE_VALUE,
+                                                 &self->metrics.stat_window_starvation);
 }
 
 static void
@@ -449,6 +666,8 @@ _unregister_window_stats(LogSource *self)
                                    &self->metrics.stat_window_size);
   stats_unregister_dynamic_counter(self->metrics.stat_full_window_cluster, SC_TYPE_SINGLE_VALUE,
                                    &self->metrics.stat_full_window);
+  stats_unregister_dynamic_counter(self->metrics.stat_window_starvation_cluster, SC_TYPE_SINGLE_VALUE,
+                                   &self->metrics.stat_window_starvation);
 }
 
 static inline void
@@ -474,6 +693,166 @@ _unregister_raw_bytes_stats(LogSource *self)
   stats_byte_counter_deinit(&self->metrics.recvd_bytes, self->metrics.recvd_bytes_key);
 }
 
+/*
+ * Message memory accounting
+ *
+ * Each message posted by the source is sorted into a size bucket based on
+ * the memory it occupies (input_events_by_size_total) and the memory is
+ * also broken down to its components (input_event_memory_bytes_total).
+ * Buckets are not cumulative, each message increments exactly one of
+ * them.  These are meant to help sizing log-fifo-size() and disk-buffers.
+ */
+static const gsize event_size_bucket_limits[LOG_SOURCE_EVENT_SIZE_BUCKETS - 1] =
+{
+  512, 1024, 2048, 4096, 8192, 16384, 32768, 65536
+};
+
+static const gchar *event_size_bucket_labels[LOG_SOURCE_EVENT_SIZE_BUCKETS] =
+{
+  "512", "1024", "2048", "4096", "8192", "16384", "32768", "65536", "inf"
+};
+
+static void
+_event_size_bucket_key_set(LogSource *self, StatsClusterKey *sc_key, gint bucket, StatsClusterLabel *labels)
+{
+  labels[0] = stats_cluster_label("id", self->stats_id);
+  labels[1] = stats_cluster_label("max_bytes", event_size_bucket_labels[bucket]);
+  stats_cluster_single_key_set(sc_key, "input_events_by_size_total", labels, 2);
+}
+
+static void
+_event_memory_key_set(LogSource *self, StatsClusterKey *sc_key, const gchar *component, StatsClusterLabel *labels)
+{
+  labels[0] = stats_cluster_label("id", self->stats_id);
+  labels[1] = stats_cluster_label("component", component);
+  stats_cluster_single_key_set(sc_key, "input_event_memory_bytes_total", labels, 2);
+}
+
+static void
+_register_event_memory_counter(LogSource *self, gint level, const gchar *component, StatsCounterItem **counter)
+{
+  StatsClusterKey sc_key;
+  StatsClusterLabel labels[2];
+
+  _event_memory_key_set(self, &sc_key, component, labels);
+  stats_register_counter(level, &sc_key, SC_TYPE_SINGLE_VALUE, counter);
+}
+
+static void
+_unregister_event_memory_counter(LogSource *self, const gchar *component, StatsCounterItem **counter)
+{
+  StatsClusterKey sc_key;
+  StatsClusterLabel labels[2];
+
+  _event_memory_key_set(self, &sc_key, component, labels);
+  stats_unregister_counter(&sc_key, SC_TYPE_SINGLE_VALUE, counter);
+}
+
+static void
+_register_event_memory_stats(LogSource *self, gint level)
+{
+  StatsClusterKey sc_key;
+  StatsClusterLabel labels[2];
+
+  for (gint i = 0; i < LOG_SOURCE_EVENT_SIZE_BUCKETS; i++)
+    {
+      _event_size_bucket_key_set(self, &sc_key, i, labels);
+      stats_register_counter(level, &sc_key, SC_TYPE_SINGLE_VALUE, &self->metrics.event_memory.size_buckets[i]);
+    }
+
+  _register_event_memory_counter(self, level, "header", &self->metrics.event_memory.header);
+  _register_event_memory_counter(self, level, "payload_used", &self->metrics.event_memory.payload_used);
+  _register_event_memory_counter(self, level, "payload_slack", &self->metrics.event_memory.payload_slack);
+  _register_event_memory_counter(self, level, "tags", &self->metrics.event_memory.tags);
+  _register_event_memory_counter(self, level, "sdata", &self->metrics.event_memory.sdata);
+}
+
+static void
+_unregister_event_memory_stats(LogSource *self)
+{
+  StatsClusterKey sc_key;
+  StatsClusterLabel labels[2];
+
+  for (gint i = 0; i < LOG_SOURCE_EVENT_SIZE_BUCKETS; i++)
+    {
+      _event_size_bucket_key_set(self, &sc_key, i, labels);
+      stats_unregister_counter(&sc_key, SC_TYPE_SINGLE_VALUE, &self->metrics.event_memory.size_buckets[i]);
+    }
+
+  _unregister_event_memory_counter(self, "header", &self->metrics.event_memory.header);
+  _unregister_event_memory_counter(self, "payload_used", &self->metrics.event_memory.payload_used);
+  _unregister_event_memory_counter(self, "payload_slack", &self->metrics.event_memory.payload_slack);
+  _unregister_event_memory_counter(self, "tags", &self->metrics.event_memory.tags);
+  _unregister_event_memory_counter(self, "sdata", &self->metrics.event_memory.sdata);
+}
+
+static gint
+_lookup_event_size_bucket(gsize size)
+{
+  gint bucket = 0;
+
+  while (bucket < LOG_SOURCE_EVENT_SIZE_BUCKETS - 1 && size > event_size_bucket_limits[bucket])
+    bucket++;
+  return bucket;
+}
+
+static void
+_account_event_memory(LogSource *self, LogMessage *msg)
+{
+  /* all of these are registered at the same level, either all or none of
+   * them exist */
+  if (!self->metrics.event_memory.header)
+    return;
+
+  LogMessageMemoryUsage usage;
+
+  log_msg_get_memory_usage(msg, &usage);
+  stats_counter_add(self->metrics.event_memory.header, usage.header);
+  stats_counter_add(self->metrics.event_memory.payload_used, usage.payload_used);
+  stats_counter_add(self->metrics.event_memory.payload_slack, usage.payload_slack);
+  stats_counter_add(self->metrics.event_memory.tags, usage.tags);
+  stats_counter_add(self->metrics.event_memory.sdata, usage.sdata);
+
+  gsize total = usage.header + usage.payload_used + usage.payload_slack + usage.tags + usage.sdata;
+  stats_counter_inc(self->metrics.event_memory.size_buckets[_lookup_event_size_bucket(total)]);
+}
+
+static void
+_init_latency_trace_histogram(LogSource *self, StatsHistogram *histogram, const gchar *stage)
+{
+  StatsClusterKeyBuilder *kb = self->metrics.stats_kb;
+
+  stats_cluster_key_builder_push(kb);
+  stats_cluster_key_builder_add_label(kb, stats_cluster_label("id", self->stats_id));
+  stats_cluster_key_builder_add_label(kb, stats_cluster_label("stage", stage));
+  stats_histogram_init(histogram, kb, "input_event_latency_seconds", STATS_LEVEL0);
+  stats_cluster_key_builder_pop(kb);
+}
+
+/* enabling stats(latency-trace-sampling()) implies these histograms, regardless of the stats level */
+static void
+_register_latency_trace_stats(LogSource *self)
+{
+  self->metrics.latency_trace.sampling = log_pipe_is_internal(&self->super) ? 0 : stats_get_latency_trace_sampling();
+  self->metrics.latency_trace.counter = 0;
+  if (!self->metrics.latency_trace.sampling)
+    return;
+
+  _init_latency_trace_histogram(self, &self->metrics.latency_trace.processing, "processing");
+  _init_latency_trace_histogram(self, &self->metrics.latency_trace.queue, "queue");
+  _init_latency_trace_histogram(self, &self->metrics.latency_trace.delivery, "delivery");
+  _init_latency_trace_histogram(self, &self->metrics.latency_trace.total, "total");
+}
+
+static void
+_unregister_latency_trace_stats(LogSource *self)
+{
+  stats_histogram_deinit(&self->metrics.latency_trace.processing);
+  stats_histogram_deinit(&self->metrics.latency_trace.queue);
+  stats_histogram_deinit(&self->metrics.latency_trace.delivery);
+  stats_histogram_deinit(&self->metrics.latency_trace.total);
+}
+
 static void
 _register_counters(LogSource *self)
 {
@@ -482,6 +861,7 @@ _register_counters(LogSource *self)
   gint level = log_pipe_is_internal(&self->super) ? STATS_LEVEL3 : self->options->stats_level;
 
   stats_register_counter(level, self->metrics.recvd_messages_key, SC_TYPE_SINGLE_VALUE, &self->metrics.recvd_messages);
+  stats_counter_enable_striping(self->metrics.recvd_messages);
 
   StatsClusterKey sc_key;
   gchar stats_instance[1024];
@@ -493,6 +873,7 @@ _register_counters(LogSource *self)
   stats_register_counter(level, &sc_key, SC_TYPE_STAMP, &self->metrics.last_message_seen);
 
   _register_window_stats(self);
+  _register_event_memory_stats(self, log_pipe_is_internal(&self->super) ? STATS_LEVEL3 : STATS_LEVEL1);
 
   stats_unlock();
 
@@ -501,6 +882,29 @@ _register_counters(LogSource *self)
       level = log_pipe_is_internal(&self->super) ? STATS_LEVEL3 : STATS_LEVEL1;
       _register_raw_bytes_stats(self, level);
     }
+
+  _register_latency_trace_stats(self);
+}
+
+/* With stats(lazy-registration(yes)) the counters of a source are
+ * registered when it posts its first message, so that thousands of idle
+ * sources (e.g. wildcard-file() matches) do not have to go through the
+ * stats registry during startup.  Until then, the counters are NULL and
+ * updating them is a no-op. */
+static inline gboolean
+_defer_counter_registration(LogSource *self)
+{
+  return stats_is_lazy_registration_enabled() && !log_pipe_is_internal(&self->super);
+}
+
+static inline void
+_ensure_counters_registered(LogSource *self)
+{
+  if (G_LIKELY(g_atomic_int_get(&self->metrics.counters_registered)))
+    return;
+
+  if (g_atomic_int_compare_and_exchange(&self->metrics.counters_registered, FALSE, TRUE))
+    _register_counters(self);
 }
 
 gboolean
@@ -508,6 +912,7 @@ log_source_init(LogPipe *s)
 {
   LogSource *self = (LogSource *) s;
 
+  _init_pending_acks(self);
   _create_ack_tracker_if_not_exists(self);
   if (!ack_tracker_init(self->ack_tracker))
     {
@@ -515,7 +920,9 @@ log_source_init(LogPipe *s)
       return FALSE;
     }
 
-  _register_counters(self);
+  g_atomic_int_set(&self->metrics.counters_registered, FALSE);
+  if (!_defer_counter_registration(self))
+    _ensure_counters_registered(self);
 
   return TRUE;
 }
@@ -523,6 +930,8 @@ log_source_init(LogPipe *s)
 static void
 _unregister_counters(LogSource *self)
 {
+  _unregister_latency_trace_stats(self);
+
   if (self->metrics.raw_bytes_enabled)
     _unregister_raw_bytes_stats(self);
 
@@ -540,6 +949,7 @@ _unregister_counters(LogSource *self)
   stats_unregister_counter(&sc_key, SC_TYPE_STAMP, &self->metrics.last_message_seen);
 
   _unregister_window_stats(self);
+  _unregister_event_memory_stats(self);
 
   stats_unlock();
 }
@@ -550,29 +960,20 @@ log_source_deinit(LogPipe *s)
   LogSource *self = (LogSource *) s;
   ack_tracker_deinit(self->ack_tracker);
 
-  _unregister_counters(self);
+  if (g_atomic_int_get(&self->metrics.counters_registered))
+    _unregister_counters(self);
+  g_atomic_int_set(&self->metrics.counters_registered, FALSE);
 
   return TRUE;
 }
 
-void
-log_source_post(LogSource *self, LogMessage *msg)
+static void
+_take_window(LogSource *self, gint count)
 {
-  LogPathOptions path_options = LOG_PATH_OPTIONS_INIT;
-  gint old_window_size;
-
-  ack_tracker_track_msg(self->ack_tracker, msg);
+  gint old_window_size = window_size_counter_sub(&self->window_size, count, NULL);
+  stats_counter_sub(self->metrics.stat_window_size, count);
 
-  /* NOTE: we start by enabling flow-control, thus we need an acknowledgement */
-  path_options.ack_needed = TRUE;
-  log_msg_ref(msg);
-  log_msg_add_ack(msg, &path_options);
-  msg->ack_func = log_source_msg_ack;
-
-  old_window_size = window_size_counter_sub(&self->window_size, 1, NULL);
-  stats_counter_sub(self->metrics.stat_window_size, 1);
-
-  if (G_UNLIKELY(old_window_size == 1))
+  if (G_UNLIKELY(old_window_size == count))
     {
       msg_debug("Source has been suspended",
                 log_pipe_location_tag(&self->super),
@@ -583,11 +984,42 @@ log_source_post(LogSource *self, LogMessage *msg)
    * NOTE: this assertion validates that the source is not overflowing its
    * own flow-control window size, decreased above, by the atomic statement.
    *
-   * If the _old_ value is zero, that means that the decrement operation
-   * above has decreased the value to -1.
+   * If the _old_ value is less than count, that means that the decrement
+   * operation above has decreased the value below zero.
    */
 
-  g_assert(old_window_size > 0);
+  g_assert(old_window_size >= count);
+}
+
+static inline void
+_take_window_bytes(LogSource *self, LogMessage *msg)
+{
+  if (self->window_bytes_limit > 0)
+    atomic_gssize_add(&self->window_bytes_in_flight, msg->recvd_rawmsg_size);
+}
+
+static inline void
+_sample_latency_trace(LogSource *self, LogMessage *msg)
+{
+  gint sampling = self->metrics.latency_trace.sampling;
+
+  if (G_LIKELY(sampling == 0) || msg->trace)
+    return;
+
+  if (self->metrics.latency_trace.counter++ % sampling == 0)
+    log_msg_trace_start(msg);
+}
+
+static void
+_queue_tracked_msg(LogSource *self, LogMessage *msg)
+{
+  LogPathOptions path_options = LOG_PATH_OPTIONS_INIT;
+
+  /* NOTE: we start by enabling flow-control, thus we need an acknowledgement */
+  path_options.ack_needed = TRUE;
+  log_msg_ref(msg);
+  log_msg_add_ack(msg, &path_options);
+  msg->ack_func = log_source_msg_ack;
 
   ScratchBuffersMarker mark;
   scratch_buffers_mark(&mark);
@@ -595,6 +1027,57 @@ log_source_post(LogSource *self, LogMessage *msg)
   scratch_buffers_reclaim_marked(mark);
 }
 
+void
+log_source_post(LogSource *self, LogMessage *msg)
+{
+  _ensure_counters_registered(self);
+  ack_tracker_track_msg(self->ack_tracker, msg);
+  _take_window(self, 1);
+  _take_window_bytes(self, msg);
+  _sample_latency_trace(self, msg);
+  _queue_tracked_msg(self, msg);
+}
+
+/*
+ * Posts @count messages, the caller is responsible for not exceeding the
+ * free window (see log_source_get_free_window()).  The window is taken for
+ * the whole batch at once.
+ *
+ * As opposed to log_source_post(), the caller must not start the refcache
+ * producer, this is done here for each message.  If @bookmarks is not
+ * NULL, its elements are copied to the bookmarks requested from the
+ * AckTracker, right before tracking the corresponding message.
+ */
+void
+log_source_post_batch(LogSource *self, LogMessage **msgs, Bookmark **bookmarks, gint count)
+{
+  if (count == 0)
+    return;
+
+  _ensure_counters_registered(self);
+  _take_window(self, count);
+
+  for (gint i = 0; i < count; i++)
+    {
+      LogMessage *msg = msgs[i];
+
+      if (bookmarks)
+        {
+          Bookmark *bookmark = ack_tracker_request_bookmark(self->ack_tracker);
+
+          if (bookmark)
+            bookmark_copy(bookmark, bookmarks[i]);
+        }
+
+      log_msg_refcache_start_producer(msg);
+      ack_tracker_track_msg(self->ack_tracker, msg);
+      _take_window_bytes(self, msg);
+      _sample_latency_trace(self, msg);
+      _queue_tracked_msg(self, msg);
+      log_msg_refcache_stop();
+    }
+}
+
 static gboolean
 _invoke_mangle_callbacks(LogPipe *s, LogMessage *msg, const LogPathOptions *path_options)
 {
@@ -697,6 +1180,7 @@ log_source_queue(LogPipe *s, LogMessage *msg, const LogPathOptions *path_options
   stats_counter_inc(self->metrics.recvd_messages);
   stats_counter_set_time(self->metrics.last_message_seen, msg->timestamps[LM_TS_RECVD].ut_sec);
   stats_byte_counter_add(&self->metrics.recvd_bytes, msg->recvd_rawmsg_size);
+  _account_event_memory(self, msg);
   log_pipe_forward_msg(s, msg, path_options);
 
   if (accurate_nanosleep && self->threaded && self->window_full_sleep_nsec > 0 && !log_source_free_to_send(self))
@@ -716,13 +1200,16 @@ log_source_queue(LogPipe *s, LogMessage *msg, const LogPathOptions *path_options
 }
 
 static void
-_initialize_window(LogSource *self, gint init_window_size)
+_initialize_window(LogSource *self, gint init_window_size, gssize init_window_bytes)
 {
   self->window_initialized = TRUE;
   window_size_counter_set(&self->window_size, init_window_size);
 
   self->initial_window_size = init_window_size;
   self->full_window_size = init_window_size;
+
+  self->window_bytes_limit = init_window_bytes;
+  atomic_gssize_set(&self->window_bytes_in_flight, 0);
 }
 
 static gboolean
@@ -778,7 +1265,7 @@ log_source_set_options(LogSource *self, LogSourceOptions *options,
    * connections will not have their window_size changed. */
 
   if (!_is_window_initialized(self))
-    _initialize_window(self, options->init_window_size);
+    _initialize_window(self, options->init_window_size, options->init_window_bytes);
 
   self->options = options;
   _set_metric_options(self, stats_id, kb);
@@ -822,6 +1309,7 @@ log_source_free(LogPipe *s)
 
   ack_tracker_free(self->ack_tracker);
   self->ack_tracker = NULL;
+  g_free(self->pending_acks);
 
   g_free(self->name);
   g_free(self->stats_id);
@@ -847,6 +1335,7 @@ void
 log_source_options_defaults(LogSourceOptions *options)
 {
   options->init_window_size = -1;
+  options->init_window_bytes = 0;
   options->keep_hostname = -1;
   options->chain_hostnames = -1;
   options->keep_timestamp = -1;
@@ -914,6 +1403,28 @@ log_source_options_set_tags(LogSourceOptions *options, GList *tags)
     }
 }
 
+static void
+_register_global_stats(void)
+{
+  StatsClusterKey sc_key;
+
+  stats_lock();
+  stats_cluster_single_key_set(&sc_key, "source_coalesced_window_updates_total", NULL, 0);
+  stats_register_counter(1, &sc_key, SC_TYPE_SINGLE_VALUE, &stat_coalesced_window_updates);
+  stats_unlock();
+}
+
+static void
+_unregister_global_stats(void)
+{
+  StatsClusterKey sc_key;
+
+  stats_lock();
+  stats_cluster_single_key_set(&sc_key, "source_coalesced_window_updates_total", NULL, 0);
+  stats_unregister_counter(&sc_key, SC_TYPE_SINGLE_VALUE, &stat_coalesced_window_updates);
+  stats_unlock();
+}
+
 void
 log_source_global_init(void)
 {
@@ -922,4 +1433,11 @@ log_source_global_init(void)
     {
       msg_debug("nanosleep() is not accurate enough to introduce minor stalls on the reader side, multi-threaded performance may be affected");
     }
+  register_application_hook(AH_RUNNING, (ApplicationHookFunc) _register_global_stats, NULL, AHM_RUN_ONCE);
+}
+
+void
+log_source_global_deinit(void)
+{
+  _unregister_global_stats();
 }
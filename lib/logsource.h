@@ -29,12 +29,15 @@
 #include "stats/stats-registry.h"
 #include "stats/stats-compat.h"
 #include "stats/stats-cluster-key-builder.h"
+#include "stats/stats-histogram.h"
 #include "window-size-counter.h"
 #include "dynamic-window.h"
 
 typedef struct _LogSourceOptions
 {
   gssize init_window_size;
+  /* limit of the input bytes held by unacknowledged messages, 0 if unlimited */
+  gssize init_window_bytes;
   const gchar *group_name;
   gboolean keep_timestamp;
   gboolean keep_hostname;
@@ -55,6 +58,11 @@ typedef struct _LogSourceOptions
 
 typedef struct _LogSource LogSource;
 
+typedef struct _LogSourcePendingAck LogSourcePendingAck;
+
+/* number of buckets in the per-source message size distribution */
+#define LOG_SOURCE_EVENT_SIZE_BUCKETS 9
+
 /**
  * LogSource:
  *
@@ -78,13 +86,19 @@ struct _LogSource
   gsize full_window_size;
   atomic_gssize window_size_to_be_reclaimed;
   atomic_gssize pending_reclaimed;
+  /* bytes of received input held by messages that are not acknowledged
+   * yet, limited to window_bytes_limit (0 means unlimited) */
+  gssize window_bytes_limit;
+  atomic_gssize window_bytes_in_flight;
 
   struct
   {
     StatsClusterKeyBuilder *stats_kb;
+    gint counters_registered;
 
     StatsCounterItem *stat_window_size;
     StatsCounterItem *stat_full_window;
+    StatsCounterItem *stat_window_starvation;
     StatsCounterItem *last_message_seen;
 
     StatsClusterKey *recvd_messages_key;
@@ -96,6 +110,28 @@ struct _LogSource
 
     StatsCluster *stat_window_size_cluster;
     StatsCluster *stat_full_window_cluster;
+    StatsCluster *stat_window_starvation_cluster;
+
+    struct
+    {
+      StatsCounterItem *size_buckets[LOG_SOURCE_EVENT_SIZE_BUCKETS];
+      StatsCounterItem *header;
+      StatsCounterItem *payload_used;
+      StatsCounterItem *payload_slack;
+      StatsCounterItem *tags;
+      StatsCounterItem *sdata;
+    } event_memory;
+
+    /* every sampling-th message is traced, see logmsg/logmsg-trace.h */
+    struct
+    {
+      gint sampling;
+      guint32 counter;
+      StatsHistogram processing;
+      StatsHistogram queue;
+      StatsHistogram delivery;
+      StatsHistogram total;
+    } latency_trace;
   } metrics;
 
   guint32 last_ack_count;
@@ -105,14 +141,38 @@ struct _LogSource
   AckTrackerFactory *ack_tracker_factory;
   AckTracker *ack_tracker;
 
+  /* window increments from acks in worker threads, indexed by thread
+   * index, delivered at the end of the worker's batch */
+  LogSourcePendingAck *pending_acks;
+  gint num_pending_acks;
+
   void (*wakeup)(LogSource *s);
   void (*schedule_dynamic_window_realloc)(LogSource *s);
 };
 
+static inline gboolean
+log_source_window_bytes_exhausted(LogSource *self)
+{
+  if (self->window_bytes_limit <= 0)
+    return FALSE;
+
+  return atomic_gssize_racy_get(&self->window_bytes_in_flight) >= self->window_bytes_limit;
+}
+
 static inline gboolean
 log_source_free_to_send(LogSource *self)
 {
-  return !window_size_counter_suspended(&self->window_size);
+  return !window_size_counter_suspended(&self->window_size) && !log_source_window_bytes_exhausted(self);
+}
+
+/* the number of messages that can be posted without overflowing the window */
+static inline gsize
+log_source_get_free_window(LogSource *self)
+{
+  gboolean suspended;
+  gsize window_size = window_size_counter_get(&self->window_size, &suspended);
+
+  return (suspended || log_source_window_bytes_exhausted(self)) ? 0 : window_size;
 }
 
 static inline gsize
@@ -133,6 +193,7 @@ gboolean log_source_init(LogPipe *s);
 gboolean log_source_deinit(LogPipe *s);
 
 void log_source_post(LogSource *self, LogMessage *msg);
+void log_source_post_batch(LogSource *self, LogMessage **msgs, Bookmark **bookmarks, gint count);
 
 void log_source_set_options(LogSource *self, LogSourceOptions *options, const gchar *stats_id,
                             StatsClusterKeyBuilder *kb, gboolean threaded, LogExprNode *expr_node);
@@ -155,8 +216,13 @@ void log_source_dynamic_window_update_statistics(LogSource *self);
 gboolean log_source_is_dynamic_window_enabled(LogSource *self);
 
 void log_source_global_init(void);
+void log_source_global_deinit(void);
 
 /* protected */
 void log_source_dynamic_window_realloc(LogSource *self);
+gboolean log_source_dynamic_window_is_starving(LogSource *self);
+gsize log_source_dynamic_window_get_surplus(LogSource *self);
+gsize log_source_dynamic_window_get_headroom(LogSource *self);
+void log_source_dynamic_window_shift(LogSource *self, gssize delta);
 
 #endif
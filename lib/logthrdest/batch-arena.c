@@ -0,0 +1,136 @@
+/*
+ * Copyright (c) 2024 One Identity LLC.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#include "logthrdest/batch-arena.h"
+
+#define BATCH_ARENA_INITIAL_SIZE 4096
+#define BATCH_ARENA_SHRINK_INTERVAL 256
+#define BATCH_ARENA_SHRINK_RATIO 4
+
+void
+log_threaded_dest_batch_arena_init(LogThreadedDestBatchArena *self)
+{
+  self->buffer = NULL;
+  self->offsets = NULL;
+  self->high_water_mark = 0;
+  self->num_resets = 0;
+}
+
+void
+log_threaded_dest_batch_arena_clear(LogThreadedDestBatchArena *self)
+{
+  if (self->buffer)
+    g_string_free(self->buffer, TRUE);
+  if (self->offsets)
+    g_array_free(self->offsets, TRUE);
+  log_threaded_dest_batch_arena_init(self);
+}
+
+/* the buffer is only allocated at first use, so that drivers not using
+ * the arena don't pay for it */
+static void
+_allocate(LogThreadedDestBatchArena *self)
+{
+  self->buffer = g_string_sized_new(MAX(self->high_water_mark, BATCH_ARENA_INITIAL_SIZE));
+  self->offsets = g_array_sized_new(FALSE, FALSE, sizeof(gsize), 64);
+}
+
+/* GString never gives back memory, reallocate it if the buffer grew a
+ * lot larger than the batches we saw recently */
+static void
+_shrink_if_oversized(LogThreadedDestBatchArena *self)
+{
+  if (++self->num_resets < BATCH_ARENA_SHRINK_INTERVAL)
+    return;
+
+  if (self->buffer->allocated_len > BATCH_ARENA_SHRINK_RATIO * MAX(self->high_water_mark, BATCH_ARENA_INITIAL_SIZE))
+    {
+      g_string_free(self->buffer, TRUE);
+      self->buffer = g_string_sized_new(MAX(self->high_water_mark, BATCH_ARENA_INITIAL_SIZE));
+    }
+  self->high_water_mark = 0;
+  self->num_resets = 0;
+}
+
+void
+log_threaded_dest_batch_arena_reset(LogThreadedDestBatchArena *self)
+{
+  if (!self->buffer)
+    return;
+
+  self->high_water_mark = MAX(self->high_water_mark, self->buffer->len);
+  g_string_truncate(self->buffer, 0);
+  g_array_set_size(self->offsets, 0);
+  _shrink_if_oversized(self);
+}
+
+/* returns the buffer to append the next message to */
+GString *
+log_threaded_dest_batch_arena_begin_message(LogThreadedDestBatchArena *self)
+{
+  if (!self->buffer)
+    _allocate(self);
+
+  gsize offset = self->buffer->len;
+  g_array_append_val(self->offsets, offset);
+  return self->buffer;
+}
+
+/* drops the last message, e.g. if it could not be formatted */
+void
+log_threaded_dest_batch_arena_discard_message(LogThreadedDestBatchArena *self)
+{
+  gint num_messages = log_threaded_dest_batch_arena_get_num_messages(self);
+  g_assert(num_messages > 0);
+
+  g_string_truncate(self->buffer, g_array_index(self->offsets, gsize, num_messages - 1));
+  g_array_set_size(self->offsets, num_messages - 1);
+}
+
+const gchar *
+log_threaded_dest_batch_arena_get_message(LogThreadedDestBatchArena *self, gint index, gsize *len)
+{
+  gint num_messages = log_threaded_dest_batch_arena_get_num_messages(self);
+  g_assert(index >= 0 && index < num_messages);
+
+  gsize start = g_array_index(self->offsets, gsize, index);
+  gsize end = (index + 1 < num_messages) ? g_array_index(self->offsets, gsize, index + 1) : self->buffer->len;
+
+  *len = end - start;
+  return self->buffer->str + start;
+}
+
+/* one iovec per message, returns the number of iovecs filled */
+gint
+log_threaded_dest_batch_arena_fill_iovec(LogThreadedDestBatchArena *self, struct iovec *iov, gint max_iov)
+{
+  gint num_messages = MIN(log_threaded_dest_batch_arena_get_num_messages(self), max_iov);
+
+  for (gint i = 0; i < num_messages; i++)
+    {
+      gsize len;
+      iov[i].iov_base = (gchar *) log_threaded_dest_batch_arena_get_message(self, i, &len);
+      iov[i].iov_len = len;
+    }
+  return num_messages;
+}
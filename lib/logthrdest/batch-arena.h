@@ -0,0 +1,78 @@
+/*
+ * Copyright (c) 2024 One Identity LLC.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#ifndef LOGTHRDEST_BATCH_ARENA_H_INCLUDED
+#define LOGTHRDEST_BATCH_ARENA_H_INCLUDED
+
+#include "syslog-ng.h"
+
+#include <sys/uio.h>
+
+/*
+ * A contiguous, growable buffer holding the formatted messages of the
+ * current batch, along with the offset of each message.  Drivers format
+ * messages right into the buffer (e.g. with log_template_append_format())
+ * and submit it as a single body or as an iovec, without copying the
+ * messages around.
+ *
+ * The arena of a LogThreadedDestWorker is reset automatically when a new
+ * batch is started, after the previous batch was acked, dropped or
+ * rewound.  Its capacity is retained between batches, it is only shrunk
+ * if it has grown well beyond the recent high-water mark.  As the next
+ * batch starts right after flush_async() returns, drivers using
+ * max-inflight-batches() must not refer to the arena once flush_async()
+ * returned.
+ */
+
+typedef struct _LogThreadedDestBatchArena
+{
+  GString *buffer;
+  /* start offsets of the messages in buffer, each message ends where the
+   * next one starts */
+  GArray *offsets;
+  gsize high_water_mark;
+  gint num_resets;
+} LogThreadedDestBatchArena;
+
+void log_threaded_dest_batch_arena_init(LogThreadedDestBatchArena *self);
+void log_threaded_dest_batch_arena_clear(LogThreadedDestBatchArena *self);
+void log_threaded_dest_batch_arena_reset(LogThreadedDestBatchArena *self);
+
+GString *log_threaded_dest_batch_arena_begin_message(LogThreadedDestBatchArena *self);
+void log_threaded_dest_batch_arena_discard_message(LogThreadedDestBatchArena *self);
+const gchar *log_threaded_dest_batch_arena_get_message(LogThreadedDestBatchArena *self, gint index, gsize *len);
+gint log_threaded_dest_batch_arena_fill_iovec(LogThreadedDestBatchArena *self, struct iovec *iov, gint max_iov);
+
+static inline gint
+log_threaded_dest_batch_arena_get_num_messages(LogThreadedDestBatchArena *self)
+{
+  return self->offsets ? self->offsets->len : 0;
+}
+
+static inline gsize
+log_threaded_dest_batch_arena_get_size(LogThreadedDestBatchArena *self)
+{
+  return self->buffer ? self->buffer->len : 0;
+}
+
+#endif
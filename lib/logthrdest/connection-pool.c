@@ -0,0 +1,317 @@
+/*
+ * Copyright (c) 2024 One Identity LLC.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#include "logthrdest/connection-pool.h"
+#include "messages.h"
+
+#include <string.h>
+
+typedef struct _PooledConnection
+{
+  gpointer connection;
+  gint64 last_used;
+} PooledConnection;
+
+struct _LogThreadedConnectionPool
+{
+  gint ref_cnt;
+  gchar *target;
+  const LogThreadedConnectionPoolMethods *methods;
+  gint max_connections;
+  gint idle_timeout;
+
+  GMutex lock;
+  GCond connection_returned;
+  /* most recently used first, so the ones at the tail expire */
+  GQueue idle_connections;
+  /* idle, borrowed and the ones being connected */
+  gint num_connections;
+};
+
+/* the registry of pools, protected by pools_lock */
+static GMutex pools_lock;
+static GList *pools;
+
+static void
+_free_pooled_connection(LogThreadedConnectionPool *self, PooledConnection *pc)
+{
+  self->methods->disconnect(pc->connection);
+  g_free(pc);
+}
+
+static gboolean
+_is_expired(LogThreadedConnectionPool *self, PooledConnection *pc, gint64 now)
+{
+  return self->idle_timeout > 0 && now - pc->last_used >= self->idle_timeout * G_TIME_SPAN_SECOND;
+}
+
+/* must be called under self->lock, the expired connections are returned
+ * so that they can be closed without holding the lock */
+static GList *
+_collect_expired_connections(LogThreadedConnectionPool *self)
+{
+  gint64 now = g_get_monotonic_time();
+  GList *expired = NULL;
+
+  while (!g_queue_is_empty(&self->idle_connections) &&
+         _is_expired(self, g_queue_peek_tail(&self->idle_connections), now))
+    {
+      expired = g_list_prepend(expired, g_queue_pop_tail(&self->idle_connections));
+      self->num_connections--;
+    }
+  return expired;
+}
+
+static void
+_close_connections(LogThreadedConnectionPool *self, GList *connections)
+{
+  for (GList *l = connections; l; l = l->next)
+    _free_pooled_connection(self, l->data);
+  g_list_free(connections);
+}
+
+static inline gboolean
+_is_full(LogThreadedConnectionPool *self)
+{
+  return self->max_connections > 0 && self->num_connections >= self->max_connections;
+}
+
+static void
+_forget_connection(LogThreadedConnectionPool *self)
+{
+  g_mutex_lock(&self->lock);
+  self->num_connections--;
+  g_cond_signal(&self->connection_returned);
+  g_mutex_unlock(&self->lock);
+}
+
+static gpointer
+_open_connection(LogThreadedConnectionPool *self)
+{
+  gpointer connection = self->methods->connect(self->target);
+
+  if (!connection)
+    _forget_connection(self);
+  return connection;
+}
+
+static gboolean
+_check_health(LogThreadedConnectionPool *self, gpointer connection)
+{
+  if (!self->methods->check_health || self->methods->check_health(connection))
+    return TRUE;
+
+  msg_debug("Connection pool: dropping broken idle connection",
+            evt_tag_str("target", self->target));
+  self->methods->disconnect(connection);
+  _forget_connection(self);
+  return FALSE;
+}
+
+/*
+ * Borrow a connection: an idle one is reused if it passes the health
+ * check, otherwise a new one is opened unless max_connections is reached,
+ * in which case we wait at most timeout_msec for one to be returned.
+ * Returns NULL if no connection is available.
+ */
+gpointer
+log_threaded_connection_pool_borrow(LogThreadedConnectionPool *self, gint timeout_msec)
+{
+  gint64 deadline = g_get_monotonic_time() + timeout_msec * G_TIME_SPAN_MILLISECOND;
+
+  g_mutex_lock(&self->lock);
+  while (TRUE)
+    {
+      GList *expired = _collect_expired_connections(self);
+
+      if (expired)
+        {
+          g_mutex_unlock(&self->lock);
+          _close_connections(self, expired);
+          g_mutex_lock(&self->lock);
+          continue;
+        }
+
+      PooledConnection *pc = g_queue_pop_head(&self->idle_connections);
+      if (pc)
+        {
+          g_mutex_unlock(&self->lock);
+
+          gpointer connection = pc->connection;
+          g_free(pc);
+          if (_check_health(self, connection))
+            return connection;
+
+          g_mutex_lock(&self->lock);
+          continue;
+        }
+
+      if (!_is_full(self))
+        {
+          self->num_connections++;
+          g_mutex_unlock(&self->lock);
+          return _open_connection(self);
+        }
+
+      if (!g_cond_wait_until(&self->connection_returned, &self->lock, deadline))
+        break;
+    }
+  g_mutex_unlock(&self->lock);
+  return NULL;
+}
+
+/* reusable is FALSE if the connection broke while it was borrowed */
+void
+log_threaded_connection_pool_return(LogThreadedConnectionPool *self, gpointer connection, gboolean reusable)
+{
+  if (!reusable)
+    {
+      self->methods->disconnect(connection);
+      _forget_connection(self);
+      return;
+    }
+
+  PooledConnection *pc = g_new0(PooledConnection, 1);
+  pc->connection = connection;
+  pc->last_used = g_get_monotonic_time();
+
+  g_mutex_lock(&self->lock);
+  g_queue_push_head(&self->idle_connections, pc);
+  GList *expired = _collect_expired_connections(self);
+  g_cond_signal(&self->connection_returned);
+  g_mutex_unlock(&self->lock);
+
+  _close_connections(self, expired);
+}
+
+gint
+log_threaded_connection_pool_get_num_connections(LogThreadedConnectionPool *self)
+{
+  g_mutex_lock(&self->lock);
+  gint result = self->num_connections;
+  g_mutex_unlock(&self->lock);
+  return result;
+}
+
+gint
+log_threaded_connection_pool_get_num_idle_connections(LogThreadedConnectionPool *self)
+{
+  g_mutex_lock(&self->lock);
+  gint result = g_queue_get_length(&self->idle_connections);
+  g_mutex_unlock(&self->lock);
+  return result;
+}
+
+static LogThreadedConnectionPool *
+_pool_new(const gchar *target, const LogThreadedConnectionPoolMethods *methods,
+          gint max_connections, gint idle_timeout)
+{
+  LogThreadedConnectionPool *self = g_new0(LogThreadedConnectionPool, 1);
+
+  self->ref_cnt = 1;
+  self->target = g_strdup(target);
+  self->methods = methods;
+  self->max_connections = max_connections;
+  self->idle_timeout = idle_timeout;
+  g_mutex_init(&self->lock);
+  g_cond_init(&self->connection_returned);
+  g_queue_init(&self->idle_connections);
+  return self;
+}
+
+static void
+_pool_free(LogThreadedConnectionPool *self)
+{
+  /* all borrowed connections must have been returned by now */
+  g_assert((guint) self->num_connections == g_queue_get_length(&self->idle_connections));
+
+  PooledConnection *pc;
+  while ((pc = g_queue_pop_head(&self->idle_connections)))
+    _free_pooled_connection(self, pc);
+
+  g_cond_clear(&self->connection_returned);
+  g_mutex_clear(&self->lock);
+  g_free(self->target);
+  g_free(self);
+}
+
+static LogThreadedConnectionPool *
+_lookup_pool(const gchar *target, const LogThreadedConnectionPoolMethods *methods)
+{
+  for (GList *l = pools; l; l = l->next)
+    {
+      LogThreadedConnectionPool *pool = l->data;
+
+      if (pool->methods == methods && strcmp(pool->target, target) == 0)
+        return pool;
+    }
+  return NULL;
+}
+
+/*
+ * Returns the pool of the target, creating it on first use.  When the
+ * pool is shared, the largest max_connections and idle_timeout asked for
+ * is used.  max_connections <= 0 means no limit, idle_timeout <= 0 keeps
+ * idle connections open indefinitely.
+ */
+LogThreadedConnectionPool *
+log_threaded_connection_pool_acquire(const gchar *target, const LogThreadedConnectionPoolMethods *methods,
+                                     gint max_connections, gint idle_timeout)
+{
+  g_assert(methods->connect && methods->disconnect);
+
+  g_mutex_lock(&pools_lock);
+  LogThreadedConnectionPool *self = _lookup_pool(target, methods);
+  if (self)
+    {
+      self->ref_cnt++;
+
+      g_mutex_lock(&self->lock);
+      if (self->max_connections > 0)
+        self->max_connections = max_connections > 0 ? MAX(self->max_connections, max_connections) : 0;
+      if (self->idle_timeout > 0)
+        self->idle_timeout = idle_timeout > 0 ? MAX(self->idle_timeout, idle_timeout) : 0;
+      g_mutex_unlock(&self->lock);
+    }
+  else
+    {
+      self = _pool_new(target, methods, max_connections, idle_timeout);
+      pools = g_list_prepend(pools, self);
+    }
+  g_mutex_unlock(&pools_lock);
+
+  return self;
+}
+
+void
+log_threaded_connection_pool_release(LogThreadedConnectionPool *self)
+{
+  g_mutex_lock(&pools_lock);
+  gboolean last_ref = (--self->ref_cnt == 0);
+  if (last_ref)
+    pools = g_list_remove(pools, self);
+  g_mutex_unlock(&pools_lock);
+
+  if (last_ref)
+    _pool_free(self);
+}
@@ -0,0 +1,63 @@
+/*
+ * Copyright (c) 2024 One Identity LLC.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#ifndef LOGTHRDEST_CONNECTION_POOL_H_INCLUDED
+#define LOGTHRDEST_CONNECTION_POOL_H_INCLUDED
+
+#include "syslog-ng.h"
+
+/*
+ * A pool of connections shared between the workers of threaded
+ * destinations talking to the same target.  Instead of owning a connection
+ * in connect()/disconnect(), workers borrow one for the duration of a
+ * batch and return it afterwards.
+ *
+ * Pools are registered globally by their target name, all drivers
+ * acquiring the same target with the same methods share a single pool.
+ * The driver specific prefix of the target name (e.g. "redis://") is the
+ * responsibility of the caller.
+ */
+
+typedef struct _LogThreadedConnectionPool LogThreadedConnectionPool;
+
+typedef struct _LogThreadedConnectionPoolMethods
+{
+  /* returns NULL on failure */
+  gpointer (*connect)(const gchar *target);
+  void (*disconnect)(gpointer connection);
+  /* optional, called when an idle connection is borrowed */
+  gboolean (*check_health)(gpointer connection);
+} LogThreadedConnectionPoolMethods;
+
+LogThreadedConnectionPool *log_threaded_connection_pool_acquire(const gchar *target,
+    const LogThreadedConnectionPoolMethods *methods,
+    gint max_connections, gint idle_timeout);
+void log_threaded_connection_pool_release(LogThreadedConnectionPool *self);
+
+gpointer log_threaded_connection_pool_borrow(LogThreadedConnectionPool *self, gint timeout_msec);
+void log_threaded_connection_pool_return(LogThreadedConnectionPool *self, gpointer connection, gboolean reusable);
+
+gint log_threaded_connection_pool_get_num_connections(LogThreadedConnectionPool *self);
+gint log_threaded_connection_pool_get_num_idle_connections(LogThreadedConnectionPool *self);
+
+#endif
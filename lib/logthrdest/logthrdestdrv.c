@@ -30,12 +30,32 @@
 #include "scratch-buffers.h"
 #include "template/eval.h"
 #include "mainloop-threaded-worker.h"
+#include "mainloop-worker.h"
 
 #include <string.h>
 
 #define MAX_RETRIES_ON_ERROR_DEFAULT 3
 #define MAX_RETRIES_BEFORE_SUSPEND_DEFAULT 3
 
+/* how often an idle worker looks for messages to steal, in milliseconds */
+#define WORK_STEALING_INTERVAL 100
+
+/* how long we wait for inflight batches at shutdown, in seconds */
+#define INFLIGHT_BATCHES_SHUTDOWN_TIMEOUT 10
+
+/* adaptive-batching() halves the batch if a flush takes this many times
+ * longer than usual */
+#define ADAPTIVE_BATCHING_LATENCY_SPIKE_RATIO 2
+
+/* workers(min, max): how often the load of the workers is checked, in milliseconds */
+#define AUTOSCALE_INTERVAL 10000
+/* a worker is added if this many batches are waiting per worker... */
+#define AUTOSCALE_QUEUED_BATCHES_PER_WORKER 4
+/* ... or if a flush takes longer than this, in milliseconds */
+#define AUTOSCALE_FLUSH_LATENCY_THRESHOLD 1000
+/* a worker is retired once the queues were empty for this many checks */
+#define AUTOSCALE_IDLE_ROUNDS 6
+
 const gchar *
 log_threaded_result_to_str(LogThreadedResult self)
 {
@@ -72,6 +92,30 @@ log_threaded_dest_driver_set_batch_timeout(LogDriver *s, gint batch_timeout)
   self->batch_timeout = batch_timeout;
 }
 
+void
+log_threaded_dest_driver_set_batch_bytes(LogDriver *s, glong batch_bytes)
+{
+  LogThreadedDestDriver *self = (LogThreadedDestDriver *) s;
+
+  self->batch_bytes = batch_bytes;
+}
+
+void
+log_threaded_dest_driver_set_adaptive_batching(LogDriver *s, gboolean adaptive_batching)
+{
+  LogThreadedDestDriver *self = (LogThreadedDestDriver *) s;
+
+  self->adaptive_batching = adaptive_batching;
+}
+
+void
+log_threaded_dest_driver_set_max_inflight_batches(LogDriver *s, gint max_inflight_batches)
+{
+  LogThreadedDestDriver *self = (LogThreadedDestDriver *) s;
+
+  self->max_inflight_batches = max_inflight_batches;
+}
+
 void
 log_threaded_dest_driver_set_time_reopen(LogDriver *s, time_t time_reopen)
 {
@@ -80,6 +124,15 @@ log_threaded_dest_driver_set_time_reopen(LogDriver *s, time_t time_reopen)
   self->time_reopen = time_reopen;
 }
 
+/* sources coalesce the acks of worker threads until their batch callbacks
+ * are invoked, see log_source_flow_control_adjust() */
+static inline void
+_deliver_coalesced_acks(void)
+{
+  if (main_loop_worker_is_worker_thread())
+    main_loop_worker_invoke_batch_callbacks();
+}
+
 /* this should be used in combination with LTR_EXPLICIT_ACK_MGMT to actually confirm message delivery. */
 void
 log_threaded_dest_worker_ack_messages(LogThreadedDestWorker *self, gint batch_size)
@@ -88,6 +141,7 @@ log_threaded_dest_worker_ack_messages(LogThreadedDestWorker *self, gint batch_si
   stats_counter_add(self->owner->metrics.written_messages, batch_size);
   self->retries_on_error_counter = 0;
   self->batch_size -= batch_size;
+  _deliver_coalesced_acks();
 }
 
 void
@@ -97,16 +151,98 @@ log_threaded_dest_worker_drop_messages(LogThreadedDestWorker *self, gint batch_s
   stats_counter_add(self->owner->metrics.dropped_messages, batch_size);
   self->retries_on_error_counter = 0;
   self->batch_size -= batch_size;
+  _deliver_coalesced_acks();
+}
+
+/* the prefetched messages are the last ones on the backlog, put them back
+ * to the queue, so that the backlog only contains inserted messages */
+static void
+_rewind_prefetched_messages(LogThreadedDestWorker *self)
+{
+  gint num_msgs = self->prefetch.len - self->prefetch.pos;
+
+  if (num_msgs > 0)
+    log_queue_rewind_backlog(self->queue, num_msgs);
+
+  for (gint i = self->prefetch.pos; i < self->prefetch.len; i++)
+    log_msg_unref(self->prefetch.msgs[i]);
+
+  self->prefetch.pos = self->prefetch.len = 0;
+}
+
+static inline LogThreadedDestInflightBatch *
+_get_inflight_batch(LogThreadedDestWorker *self, gint index)
+{
+  gint pos = (self->inflight.head + index) % LOG_THREADED_DEST_WORKER_MAX_INFLIGHT_BATCHES;
+
+  return &self->inflight.batches[pos];
+}
+
+/* forgets about all inflight batches, their completion is ignored from now
+ * on.  Returns the number of messages they contained. */
+static gint
+_abandon_inflight_batches(LogThreadedDestWorker *self)
+{
+  gint num_msgs = 0;
+
+  g_mutex_lock(&self->inflight.lock);
+  for (gint i = 0; i < self->inflight.len; i++)
+    num_msgs += _get_inflight_batch(self, i)->len;
+  self->inflight.head = self->inflight.len = 0;
+  g_mutex_unlock(&self->inflight.lock);
+
+  return num_msgs;
 }
 
 void
 log_threaded_dest_worker_rewind_messages(LogThreadedDestWorker *self, gint batch_size)
 {
-  log_queue_rewind_backlog(self->queue, batch_size);
+  _rewind_prefetched_messages(self);
+
+  /* inflight batches precede the current batch on the backlog, so they are
+   * rewound after it.  If we are completing the oldest inflight batch, it
+   * is rewound together with the others. */
+  if (!self->inflight.completing)
+    log_queue_rewind_backlog(self->queue, batch_size);
+
+  gint inflight_msgs = _abandon_inflight_batches(self);
+  if (inflight_msgs > 0)
+    log_queue_rewind_backlog(self->queue, inflight_msgs);
+
   self->rewound_batch_size = self->batch_size;
   self->batch_size -= batch_size;
 }
 
+/* can be called from any thread, to report the outcome of a batch
+ * submitted with flush_async() */
+void
+log_threaded_dest_worker_complete_batch(LogThreadedDestWorker *self, guint32 batch_id, LogThreadedResult result)
+{
+  g_assert(result != LTR_QUEUED && result != LTR_EXPLICIT_ACK_MGMT);
+
+  g_mutex_lock(&self->inflight.lock);
+  for (gint i = 0; i < self->inflight.len; i++)
+    {
+      LogThreadedDestInflightBatch *batch = _get_inflight_batch(self, i);
+
+      if (batch->id != batch_id)
+        continue;
+
+      batch->completed = TRUE;
+      batch->result = result;
+
+      /* later batches are only processed once the oldest one completes */
+      if (i == 0)
+        {
+          g_cond_signal(&self->inflight.cond);
+          if (!self->owner->under_termination)
+            iv_event_post(&self->wake_up_event);
+        }
+      break;
+    }
+  g_mutex_unlock(&self->inflight.lock);
+}
+
 static gchar *
 _format_queue_persist_name(LogThreadedDestWorker *self)
 {
@@ -134,7 +270,7 @@ _should_flush_now(LogThreadedDestWorker *self)
   glong diff;
 
   if (self->owner->batch_timeout <= 0 ||
-      self->owner->batch_lines <= 1 ||
+      (self->owner->batch_lines <= 1 && self->owner->batch_bytes <= 0) ||
       !self->enable_batching)
     return TRUE;
 
@@ -164,6 +300,10 @@ _stop_watches(LogThreadedDestWorker *self)
     {
       iv_timer_unregister(&self->timer_flush);
     }
+  if (iv_timer_registered(&self->timer_steal))
+    {
+      iv_timer_unregister(&self->timer_steal);
+    }
 }
 
 /* NOTE: runs in the worker thread in response to a wakeup event being
@@ -197,9 +337,27 @@ _shutdown_event_callback(gpointer data)
 static void
 _suspend(LogThreadedDestWorker *self)
 {
+  if (!self->metrics.suspend_start && stats_histogram_is_enabled(&self->metrics.retry_backoff))
+    self->metrics.suspend_start = g_get_monotonic_time();
+  if (!self->suspended)
+    stats_counter_inc(self->owner->metrics.unreachable_workers);
   self->suspended = TRUE;
 }
 
+/* NOTE: runs in the worker thread */
+static void
+_resume(LogThreadedDestWorker *self)
+{
+  if (self->metrics.suspend_start)
+    {
+      stats_histogram_observe(&self->metrics.retry_backoff, g_get_monotonic_time() - self->metrics.suspend_start);
+      self->metrics.suspend_start = 0;
+    }
+  if (self->suspended)
+    stats_counter_dec(self->owner->metrics.unreachable_workers);
+  self->suspended = FALSE;
+}
+
 /* NOTE: runs in the worker thread */
 static void
 _connect(LogThreadedDestWorker *self)
@@ -371,6 +529,214 @@ _process_result(LogThreadedDestWorker *self, gint result)
 
 }
 
+static inline gint
+_get_batch_lines(LogThreadedDestWorker *self)
+{
+  if (self->owner->adaptive_batching)
+    return self->adaptive.batch_lines;
+  return self->owner->batch_lines;
+}
+
+static inline gboolean
+_is_batch_full(LogThreadedDestWorker *self)
+{
+  if (self->owner->batch_bytes > 0 && self->batch_bytes >= self->owner->batch_bytes)
+    return TRUE;
+
+  /* batch-bytes() on its own */
+  if (self->owner->batch_lines <= 0 && self->owner->batch_bytes > 0)
+    return FALSE;
+
+  return self->batch_size >= _get_batch_lines(self);
+}
+
+/* keeps the slowest flush until the autoscaler takes it, see _take_flush_latency() */
+static void
+_record_flush_latency(LogThreadedDestWorker *self, gint64 flush_latency)
+{
+  gint flush_latency_msec = MIN(flush_latency / 1000, G_MAXINT);
+  gint old_value;
+
+  do
+    {
+      old_value = g_atomic_int_get(&self->last_flush_latency);
+      if (old_value >= flush_latency_msec)
+        return;
+    }
+  while (!g_atomic_int_compare_and_exchange(&self->last_flush_latency, old_value, flush_latency_msec));
+}
+
+/* AIMD: the batch grows by a small step while flushes succeed with their
+ * usual latency, and it is halved on errors and latency spikes */
+static void
+_adapt_batch_lines(LogThreadedDestWorker *self, LogThreadedResult result, gint64 flush_latency)
+{
+  if (!self->owner->adaptive_batching || self->owner->batch_lines <= 1)
+    return;
+
+  gint batch_lines = self->adaptive.batch_lines;
+  gint64 avg_latency = self->adaptive.avg_flush_latency;
+
+  switch (result)
+    {
+    case LTR_SUCCESS:
+      if (avg_latency > 0 && flush_latency > ADAPTIVE_BATCHING_LATENCY_SPIKE_RATIO * avg_latency)
+        batch_lines /= 2;
+      else
+        batch_lines += MAX(1, self->owner->batch_lines / 16);
+      self->adaptive.avg_flush_latency = avg_latency ? (7 * avg_latency + flush_latency) / 8 : flush_latency;
+      break;
+
+    case LTR_DROP:
+    case LTR_ERROR:
+    case LTR_NOT_CONNECTED:
+    case LTR_RETRY:
+      batch_lines /= 2;
+      break;
+
+    default:
+      return;
+    }
+
+  batch_lines = CLAMP(batch_lines, 1, self->owner->batch_lines);
+  if (batch_lines != self->adaptive.batch_lines)
+    {
+      msg_trace("Adjusting batch size",
+                evt_tag_str("driver", self->owner->super.super.id),
+                evt_tag_int("worker_index", self->worker_index),
+                evt_tag_str("result", log_threaded_result_to_str(result)),
+                evt_tag_long("flush_latency_usec", flush_latency),
+                evt_tag_int("batch_lines", batch_lines));
+      self->adaptive.batch_lines = batch_lines;
+      stats_counter_set(self->metrics.batch_lines, batch_lines);
+    }
+}
+
+static inline gboolean
+_is_async_flush_enabled(LogThreadedDestWorker *self)
+{
+  return self->flush_async && self->owner->max_inflight_batches > 1;
+}
+
+static inline gboolean
+_is_inflight_window_full(LogThreadedDestWorker *self)
+{
+  return _is_async_flush_enabled(self) && self->inflight.len >= self->owner->max_inflight_batches;
+}
+
+static void
+_drop_oldest_inflight_batch(LogThreadedDestWorker *self, guint32 batch_id)
+{
+  g_mutex_lock(&self->inflight.lock);
+  if (self->inflight.len > 0 && _get_inflight_batch(self, 0)->id == batch_id)
+    {
+      self->inflight.head = (self->inflight.head + 1) % LOG_THREADED_DEST_WORKER_MAX_INFLIGHT_BATCHES;
+      self->inflight.len--;
+    }
+  g_mutex_unlock(&self->inflight.lock);
+}
+
+/* Processes the completed inflight batches in the order they were
+ * submitted, as if their result was returned by flush().
+ *
+ * NOTE: runs in the worker thread, with an empty current batch */
+static void
+_process_completed_batches(LogThreadedDestWorker *self)
+{
+  g_assert(self->batch_size == 0);
+
+  while (self->inflight.len > 0)
+    {
+      g_mutex_lock(&self->inflight.lock);
+      LogThreadedDestInflightBatch batch = *_get_inflight_batch(self, 0);
+      g_mutex_unlock(&self->inflight.lock);
+
+      if (!batch.completed)
+        break;
+
+      msg_trace("Inflight batch completed",
+                evt_tag_str("driver", self->owner->super.super.id),
+                evt_tag_int("worker_index", self->worker_index),
+                evt_tag_int("batch_id", batch.id),
+                evt_tag_str("result", log_threaded_result_to_str(batch.result)),
+                evt_tag_int("batch_size", batch.len));
+
+      gint64 flush_latency = g_get_monotonic_time() - batch.submit_time;
+      _record_flush_latency(self, flush_latency);
+      _adapt_batch_lines(self, batch.result, flush_latency);
+
+      self->batch_size = batch.len;
+      self->inflight.completing = TRUE;
+      _process_result(self, batch.result);
+      self->inflight.completing = FALSE;
+
+      _drop_oldest_inflight_batch(self, batch.id);
+    }
+}
+
+/* NOTE: runs in the worker thread */
+static LogThreadedResult
+_submit_batch(LogThreadedDestWorker *self, LogThreadedFlushMode mode)
+{
+  LogThreadedResult result = LTR_SUCCESS;
+
+  if (self->batch_size > 0)
+    {
+      guint32 batch_id = self->inflight.next_id++;
+
+      g_mutex_lock(&self->inflight.lock);
+      *_get_inflight_batch(self, self->inflight.len) = (LogThreadedDestInflightBatch)
+      {
+        .id = batch_id,
+        .len = self->batch_size,
+        .submit_time = g_get_monotonic_time(),
+      };
+      self->inflight.len++;
+      g_mutex_unlock(&self->inflight.lock);
+      self->batch_size = 0;
+
+      result = self->flush_async(self, mode, batch_id);
+      iv_validate_now();
+      self->last_flush_time = iv_now;
+
+      if (result == LTR_QUEUED)
+        result = LTR_SUCCESS;
+      else
+        log_threaded_dest_worker_complete_batch(self, batch_id, result);
+    }
+
+  _process_completed_batches(self);
+  return result;
+}
+
+/* NOTE: runs in the worker thread, at shutdown */
+static void
+_wait_for_inflight_batches(LogThreadedDestWorker *self)
+{
+  gint64 end_time = g_get_monotonic_time() + INFLIGHT_BATCHES_SHUTDOWN_TIMEOUT * G_TIME_SPAN_SECOND;
+
+  while (self->inflight.len > 0)
+    {
+      gboolean timed_out = FALSE;
+
+      g_mutex_lock(&self->inflight.lock);
+      while (!_get_inflight_batch(self, 0)->completed && !timed_out)
+        timed_out = !g_cond_wait_until(&self->inflight.cond, &self->inflight.lock, end_time);
+      g_mutex_unlock(&self->inflight.lock);
+
+      if (timed_out)
+        {
+          msg_warning("Timed out waiting for inflight batches at shutdown, they will be sent again",
+                      evt_tag_str("driver", self->owner->super.super.id),
+                      evt_tag_int("worker_index", self->worker_index),
+                      evt_tag_int("inflight_batches", self->inflight.len));
+          break;
+        }
+      _process_completed_batches(self);
+    }
+  _abandon_inflight_batches(self);
+}
+
 static LogThreadedResult
 _perform_flush(LogThreadedDestWorker *self)
 {
@@ -388,8 +754,24 @@ _perform_flush(LogThreadedDestWorker *self)
                 evt_tag_int("worker_index", self->worker_index),
                 evt_tag_int("batch_size", self->batch_size));
 
-      result = log_threaded_dest_worker_flush(self, LTF_FLUSH_NORMAL);
-      _process_result(self, result);
+      if (_is_async_flush_enabled(self))
+        {
+          result = _submit_batch(self, LTF_FLUSH_NORMAL);
+        }
+      else
+        {
+          gint batch_size = self->batch_size;
+          gint64 start_time = g_get_monotonic_time();
+
+          result = log_threaded_dest_worker_flush(self, LTF_FLUSH_NORMAL);
+          if (batch_size > 0)
+            {
+              gint64 flush_latency = g_get_monotonic_time() - start_time;
+              _record_flush_latency(self, flush_latency);
+              _adapt_batch_lines(self, result, flush_latency);
+            }
+          _process_result(self, result);
+        }
     }
 
   iv_invalidate_now();
@@ -417,6 +799,38 @@ _should_flush_due_to_partition_key_change(LogThreadedDestWorker *self, LogMessag
   return should_flush;
 }
 
+static LogMessage *
+_peek_message(LogThreadedDestWorker *self)
+{
+  if (self->prefetch.pos < self->prefetch.len)
+    return self->prefetch.msgs[self->prefetch.pos];
+
+  return log_queue_peek_head(self->queue);
+}
+
+/* NOTE: returns a reference, similarly to log_queue_pop_head() */
+static LogMessage *
+_pop_message(LogThreadedDestWorker *self, LogPathOptions *path_options)
+{
+  if (self->prefetch.pos == self->prefetch.len)
+    {
+      gint max_msgs = LOG_THREADED_DEST_WORKER_POP_BATCH_SIZE;
+
+      /* no need to fetch more than what we are going to process */
+      if (self->rewound_batch_size)
+        max_msgs = MIN(max_msgs, self->rewound_batch_size);
+
+      self->prefetch.pos = 0;
+      self->prefetch.len = log_queue_pop_head_batch(self->queue, self->prefetch.msgs, self->prefetch.path_options,
+                                                    max_msgs);
+      if (self->prefetch.len == 0)
+        return NULL;
+    }
+
+  path_options->ack_needed = self->prefetch.path_options[self->prefetch.pos].ack_needed;
+  return self->prefetch.msgs[self->prefetch.pos++];
+}
+
 /* NOTE: runs in the worker thread, whenever items on our queue are
  * available. It iterates all elements on the queue, however will terminate
  * if the mainloop requests that we exit. */
@@ -436,14 +850,14 @@ _perform_inserts(LogThreadedDestWorker *self)
       self->last_flush_time = iv_now;
     }
 
-  while (G_LIKELY(!self->owner->under_termination) && !self->suspended)
+  while (G_LIKELY(!self->owner->under_termination) && !self->suspended && !_is_inflight_window_full(self))
     {
       ScratchBuffersMarker mark;
       scratch_buffers_mark(&mark);
 
       if (G_UNLIKELY(_flush_on_worker_partition_key_change_enabled(self)))
         {
-          LogMessage *msg = log_queue_peek_head(self->queue);
+          LogMessage *msg = _peek_message(self);
           if (!msg)
             {
               scratch_buffers_reclaim_marked(mark);
@@ -458,7 +872,7 @@ _perform_inserts(LogThreadedDestWorker *self)
             }
         }
 
-      LogMessage *msg = log_queue_pop_head(self->queue, &path_options);
+      LogMessage *msg = _pop_message(self, &path_options);
       if (!msg)
         {
           scratch_buffers_reclaim_marked(mark);
@@ -468,12 +882,23 @@ _perform_inserts(LogThreadedDestWorker *self)
       msg_set_context(msg);
       log_msg_refcache_start_consumer(msg, &path_options);
 
+      if (self->batch_size == 0)
+        {
+          self->batch_bytes = 0;
+          log_threaded_dest_batch_arena_reset(&self->arena);
+        }
+      gsize reported_batch_bytes = self->batch_bytes;
+
       self->batch_size++;
       result = log_threaded_dest_worker_insert(self, msg);
 
+      /* the driver did not report the size of the message */
+      if (self->batch_bytes == reported_batch_bytes)
+        self->batch_bytes += log_msg_get_size(msg);
+
       _process_result(self, result);
 
-      if (self->enable_batching && self->batch_size >= self->owner->batch_lines)
+      if (self->enable_batching && _is_batch_full(self))
         _perform_flush(self);
 
       log_msg_unref(msg);
@@ -491,6 +916,7 @@ flush_error:
 
       iv_invalidate_now();
     }
+  _rewind_prefetched_messages(self);
   self->rewound_batch_size = 0;
 }
 
@@ -557,21 +983,128 @@ _schedule_restart_on_throttle_timeout(LogThreadedDestWorker *self, gint timeout_
 }
 
 static void
-_perform_work(gpointer data)
+_schedule_restart_on_steal_timeout(LogThreadedDestWorker *self)
+{
+  iv_validate_now();
+  self->timer_steal.expires = iv_now;
+  timespec_add_msec(&self->timer_steal.expires, WORK_STEALING_INTERVAL);
+  iv_timer_register(&self->timer_steal);
+}
+
+/* retired by the autoscaler, no new messages are routed to us */
+static inline gboolean
+_is_retired(LogThreadedDestWorker *self)
+{
+  return self->worker_index >= g_atomic_int_get(&self->owner->autoscale.active_workers);
+}
+
+static inline gboolean
+_is_work_stealing_enabled(LogThreadedDestWorker *self)
+{
+  return self->owner->work_stealing && self->owner->num_workers > 1 && !_is_retired(self);
+}
+
+/* a worker is only worth stealing from if it has more than a batch waiting */
+static LogThreadedDestWorker *
+_find_busiest_worker(LogThreadedDestWorker *self)
+{
+  LogThreadedDestWorker *busiest = NULL;
+  gint64 busiest_length = LOG_THREADED_DEST_WORKER_POP_BATCH_SIZE;
+
+  for (gint i = 0; i < self->owner->num_workers; i++)
+    {
+      LogThreadedDestWorker *worker = self->owner->workers[i];
+      if (worker == self)
+        continue;
+
+      gint64 length = log_queue_get_length(worker->queue);
+      if (length > busiest_length)
+        {
+          busiest = worker;
+          busiest_length = length;
+        }
+    }
+
+  return busiest;
+}
+
+/*
+ * Moves up to a batch of the newest messages of the busiest worker to our
+ * own queue, which wakes us up through the usual push notification.  Only
+ * queues that support log_queue_steal_tail_batch() (e.g. memory queues)
+ * can be stolen from.
+ */
+static gint
+_steal_messages(LogThreadedDestWorker *self)
+{
+  LogThreadedDestWorker *victim = _find_busiest_worker(self);
+  if (!victim)
+    return 0;
+
+  LogMessage *msgs[LOG_THREADED_DEST_WORKER_POP_BATCH_SIZE];
+  LogPathOptions path_options[LOG_THREADED_DEST_WORKER_POP_BATCH_SIZE];
+  gint max_msgs = MIN(LOG_THREADED_DEST_WORKER_POP_BATCH_SIZE, log_queue_get_length(victim->queue) / 2);
+
+  gint num_msgs = log_queue_steal_tail_batch(victim->queue, msgs, path_options, max_msgs);
+  if (num_msgs == 0)
+    return 0;
+
+  log_queue_push_tail_batch(self->queue, msgs, path_options, num_msgs);
+  main_loop_worker_invoke_batch_callbacks();
+
+  stats_counter_add(self->metrics.stolen_events, num_msgs);
+
+  msg_trace("Stolen messages from a busy worker",
+            evt_tag_str("driver", self->owner->super.super.id),
+            evt_tag_int("worker_index", self->worker_index),
+            evt_tag_int("victim_worker_index", victim->worker_index),
+            evt_tag_int("num_messages", num_msgs));
+
+  return num_msgs;
+}
+
+static void
+_do_work(LogThreadedDestWorker *self)
 {
-  LogThreadedDestWorker *self = (LogThreadedDestWorker *) data;
   gint timeout_msec = 0;
 
-  self->suspended = FALSE;
+  _resume(self);
   main_loop_worker_run_gc();
   _stop_watches(self);
 
-  if (!self->connected)
+  if (self->batch_size == 0)
+    {
+      _process_completed_batches(self);
+      if (self->suspended)
+        {
+          _schedule_restart(self);
+          return;
+        }
+    }
+
+  if (!self->connected && _is_retired(self) &&
+      !log_queue_check_items(self->queue, &timeout_msec, _message_became_available_callback, self, NULL))
+    {
+      /* retired and disconnected, we only connect again if a message
+       * still gets to our queue, which wakes us up */
+      if (timeout_msec != 0)
+        _schedule_restart_on_throttle_timeout(self, timeout_msec);
+    }
+  else if (!self->connected)
     {
       /* try to connect and come back if successful, would be suspended otherwise. */
       _connect(self);
       _schedule_restart(self);
     }
+  else if (_is_inflight_window_full(self))
+    {
+      /* all batches we are allowed to send are in flight, we are woken up
+       * by log_threaded_dest_worker_complete_batch() */
+      msg_trace("Waiting for inflight batches to complete",
+                evt_tag_str("driver", self->owner->super.super.id),
+                evt_tag_int("worker_index", self->worker_index),
+                evt_tag_int("inflight_batches", self->inflight.len));
+    }
   else if (log_queue_check_items(self->queue, &timeout_msec,
                                  _message_became_available_callback,
                                  self, NULL))
@@ -625,6 +1158,24 @@ _perform_work(gpointer data)
       _schedule_restart_on_throttle_timeout(self, timeout_msec);
 
     }
+  else if (_is_retired(self) && self->inflight.len == 0)
+    {
+      /* our queue is drained since the autoscaler retired us, release the
+       * connection.  The parallel_push callback stays registered, in case
+       * a message still gets routed to us. */
+      msg_debug("Disconnecting retired worker",
+                evt_tag_str("driver", self->owner->super.super.id),
+                evt_tag_int("worker_index", self->worker_index));
+      _disconnect(self);
+    }
+  else if (_is_work_stealing_enabled(self))
+    {
+      /* Idle, look for work at the other workers.  Stolen messages are
+       * pushed to our queue, which wakes us up via the parallel_push
+       * callback, otherwise try again later. */
+      if (self->owner->under_termination || _steal_messages(self) == 0)
+        _schedule_restart_on_steal_timeout(self);
+    }
   else
     {
       /* NOTE: at this point we are not doing anything but keep the
@@ -640,6 +1191,18 @@ _perform_work(gpointer data)
     }
 }
 
+static void
+_perform_work(gpointer data)
+{
+  LogThreadedDestWorker *self = (LogThreadedDestWorker *) data;
+
+  _do_work(self);
+
+  /* messages dropped while popping them are acked outside of
+   * log_threaded_dest_worker_ack_messages() */
+  _deliver_coalesced_acks();
+}
+
 void
 log_threaded_dest_worker_wakeup_when_suspended(LogThreadedDestWorker *self)
 {
@@ -698,6 +1261,10 @@ _init_watches(LogThreadedDestWorker *self)
   self->timer_flush.cookie = self;
   self->timer_flush.handler = _flush_timer_cb;
 
+  IV_TIMER_INIT(&self->timer_steal);
+  self->timer_steal.cookie = self;
+  self->timer_steal.handler = _perform_work;
+
   IV_TASK_INIT(&self->do_work);
   self->do_work.cookie = self;
   self->do_work.handler = _perform_work;
@@ -713,8 +1280,16 @@ _perform_final_flush(LogThreadedDestWorker *self)
   if (!cfg_is_shutting_down(cfg))
     mode = LTF_FLUSH_EXPEDITE;
 
-  result = log_threaded_dest_worker_flush(self, mode);
-  _process_result(self, result);
+  if (_is_async_flush_enabled(self))
+    {
+      _submit_batch(self, mode);
+      _wait_for_inflight_batches(self);
+    }
+  else
+    {
+      result = log_threaded_dest_worker_flush(self, mode);
+      _process_result(self, result);
+    }
   log_queue_rewind_backlog_all(self->queue);
 }
 
@@ -880,11 +1455,43 @@ _register_worker_stats(LogThreadedDestWorker *self)
       self->metrics.message_delay_sample_age_key = stats_cluster_key_builder_build_single(kb);
       stats_register_counter(level, self->metrics.message_delay_sample_age_key, SC_TYPE_SINGLE_VALUE,
                              &self->metrics.message_delay_sample_age);
+
+      if (self->owner->adaptive_batching)
+        {
+          stats_cluster_key_builder_set_name(kb, "output_batch_lines");
+          stats_cluster_key_builder_set_unit(kb, SCU_NONE);
+          stats_cluster_key_builder_set_frame_of_reference(kb, SCFOR_ABSOLUTE);
+          self->metrics.batch_lines_sc_key = stats_cluster_key_builder_build_single(kb);
+          stats_register_counter(level, self->metrics.batch_lines_sc_key, SC_TYPE_SINGLE_VALUE,
+                                 &self->metrics.batch_lines);
+        }
+
+      if (self->owner->work_stealing)
+        {
+          stats_cluster_key_builder_set_name(kb, "output_stolen_events_total");
+          stats_cluster_key_builder_set_unit(kb, SCU_NONE);
+          stats_cluster_key_builder_set_frame_of_reference(kb, SCFOR_ABSOLUTE);
+          self->metrics.stolen_events_sc_key = stats_cluster_key_builder_build_single(kb);
+          stats_register_counter(level, self->metrics.stolen_events_sc_key, SC_TYPE_SINGLE_VALUE,
+                                 &self->metrics.stolen_events);
+        }
     }
     stats_unlock();
   }
   stats_cluster_key_builder_pop(kb);
 
+  stats_cluster_key_builder_push(kb);
+  {
+    gint histogram_level = log_pipe_is_internal(&self->owner->super.super.super) ? STATS_LEVEL3 : STATS_LEVEL2;
+
+    _init_worker_sck_builder(self, kb);
+    stats_histogram_init(&self->metrics.time_in_queue, kb, "output_event_time_in_queue_seconds", histogram_level);
+    stats_histogram_init(&self->metrics.insert_duration, kb, "output_insert_duration_seconds", histogram_level);
+    stats_histogram_init(&self->metrics.flush_duration, kb, "output_flush_duration_seconds", histogram_level);
+    stats_histogram_init(&self->metrics.retry_backoff, kb, "output_retry_backoff_seconds", histogram_level);
+  }
+  stats_cluster_key_builder_pop(kb);
+
   UnixTime now;
   unix_time_set_now(&now);
   stats_counter_set_time(self->metrics.message_delay_sample_age, now.ut_sec);
@@ -920,9 +1527,29 @@ _unregister_worker_stats(LogThreadedDestWorker *self)
         stats_cluster_key_free(self->metrics.message_delay_sample_age_key);
         self->metrics.message_delay_sample_age_key = NULL;
       }
+
+    if (self->metrics.batch_lines_sc_key)
+      {
+        stats_unregister_counter(self->metrics.batch_lines_sc_key, SC_TYPE_SINGLE_VALUE,
+                                 &self->metrics.batch_lines);
+        stats_cluster_key_free(self->metrics.batch_lines_sc_key);
+        self->metrics.batch_lines_sc_key = NULL;
+      }
+
+    if (self->metrics.stolen_events_sc_key)
+      {
+        stats_unregister_counter(self->metrics.stolen_events_sc_key, SC_TYPE_SINGLE_VALUE,
+                                 &self->metrics.stolen_events);
+        stats_cluster_key_free(self->metrics.stolen_events_sc_key);
+        self->metrics.stolen_events_sc_key = NULL;
+      }
   }
   stats_unlock();
 
+  stats_histogram_deinit(&self->metrics.time_in_queue);
+  stats_histogram_deinit(&self->metrics.insert_duration);
+  stats_histogram_deinit(&self->metrics.flush_duration);
+  stats_histogram_deinit(&self->metrics.retry_backoff);
 }
 
 gboolean
@@ -934,6 +1561,10 @@ log_threaded_dest_worker_init_method(LogThreadedDestWorker *self)
   if (self->owner->flush_on_key_change)
     self->partitioning.last_key = g_string_sized_new(128);
 
+  self->adaptive.batch_lines = self->owner->batch_lines;
+  self->adaptive.avg_flush_latency = 0;
+  stats_counter_set(self->metrics.batch_lines, self->adaptive.batch_lines);
+
   return TRUE;
 }
 
@@ -949,6 +1580,9 @@ log_threaded_dest_worker_free_method(LogThreadedDestWorker *self)
 {
   _unregister_worker_stats(self);
 
+  g_cond_clear(&self->inflight.cond);
+  g_mutex_clear(&self->inflight.lock);
+  log_threaded_dest_batch_arena_clear(&self->arena);
   main_loop_threaded_worker_clear(&self->thread);
 }
 
@@ -969,6 +1603,10 @@ log_threaded_dest_worker_init_instance(LogThreadedDestWorker *self, LogThreadedD
 
   self->partitioning.last_key = NULL;
 
+  g_mutex_init(&self->inflight.lock);
+  log_threaded_dest_batch_arena_init(&self->arena);
+  g_cond_init(&self->inflight.cond);
+
   _init_watches(self);
 
   /* cannot be moved to the thread's init() as neither StatsByteCounter nor format_stats_key() is thread-safe */
@@ -991,6 +1629,16 @@ log_threaded_dest_driver_set_num_workers(LogDriver *s, gint num_workers)
   LogThreadedDestDriver *self = (LogThreadedDestDriver *) s;
 
   self->num_workers = num_workers;
+  self->autoscale.min_workers = 0;
+}
+
+void
+log_threaded_dest_driver_set_num_workers_range(LogDriver *s, gint min_workers, gint max_workers)
+{
+  LogThreadedDestDriver *self = (LogThreadedDestDriver *) s;
+
+  self->num_workers = max_workers;
+  self->autoscale.min_workers = min_workers;
 }
 
 void
@@ -1010,6 +1658,30 @@ log_threaded_dest_driver_set_flush_on_worker_key_change(LogDriver *s, gboolean f
   self->flush_on_key_change = f;
 }
 
+void
+log_threaded_dest_driver_set_work_stealing(LogDriver *s, gboolean work_stealing)
+{
+  LogThreadedDestDriver *self = (LogThreadedDestDriver *) s;
+
+  self->work_stealing = work_stealing;
+}
+
+void
+log_threaded_dest_driver_set_hot_key_threshold(LogDriver *s, gint threshold)
+{
+  LogThreadedDestDriver *self = (LogThreadedDestDriver *) s;
+
+  self->hot_key.threshold = threshold;
+}
+
+void
+log_threaded_dest_driver_set_hot_key_spread(LogDriver *s, gboolean spread)
+{
+  LogThreadedDestDriver *self = (LogThreadedDestDriver *) s;
+
+  self->hot_key.spread = spread;
+}
+
 /* compatibility bridge between LogThreadedDestWorker */
 
 static gboolean
@@ -1106,18 +1778,168 @@ log_threaded_dest_driver_set_max_retries_on_error(LogDriver *s, gint max_retries
   self->retries_on_error_max = max_retries;
 }
 
+/*
+ * Hot key detection
+ *
+ * Every HOT_KEY_SAMPLING_RATE-th message has its worker-partition-key()
+ * counted.  Once HOT_KEY_SAMPLE_WINDOW samples are collected, the most
+ * frequent key is flagged as hot if its share reaches hot-key-threshold()
+ * percent.  With hot-key-spread(yes), messages of the hot key are spread
+ * across all workers in a round robin fashion, giving up their ordering.
+ */
+
+#define HOT_KEY_SAMPLING_RATE 64
+#define HOT_KEY_SAMPLE_WINDOW 1024
+
+static inline gboolean
+_is_hot_key_detection_enabled(LogThreadedDestDriver *self)
+{
+  return self->hot_key.threshold > 0 && self->worker_partition_key;
+}
+
+static void
+_evaluate_hot_key_samples(LogThreadedDestDriver *self)
+{
+  GHashTableIter iter;
+  gpointer key, value;
+  const gchar *top_key = NULL;
+  gint top_count = 0;
+
+  g_hash_table_iter_init(&iter, self->hot_key.samples);
+  while (g_hash_table_iter_next(&iter, &key, &value))
+    {
+      if (GPOINTER_TO_INT(value) > top_count)
+        {
+          top_key = key;
+          top_count = GPOINTER_TO_INT(value);
+        }
+    }
+
+  gint share = top_count * 100 / self->hot_key.num_samples;
+  gboolean detected = share >= self->hot_key.threshold;
+
+  if (detected && (!self->hot_key.detected || self->hot_key.hash != g_str_hash(top_key)))
+    {
+      msg_warning("Hot worker-partition-key() detected, a single key carries most of the traffic of the destination",
+                  evt_tag_str("key", top_key),
+                  evt_tag_int("share", share),
+                  evt_tag_int("threshold", self->hot_key.threshold),
+                  evt_tag_str("action", self->hot_key.spread ? "spread across workers" : "none"),
+                  evt_tag_str("driver", self->super.super.id),
+                  log_expr_node_location_tag(self->super.super.super.expr_node));
+    }
+  else if (!detected && self->hot_key.detected)
+    {
+      msg_notice("Hot worker-partition-key() is gone",
+                 evt_tag_str("driver", self->super.super.id),
+                 log_expr_node_location_tag(self->super.super.super.expr_node));
+    }
+
+  g_atomic_int_set(&self->hot_key.hash, detected ? g_str_hash(top_key) : 0);
+  g_atomic_int_set(&self->hot_key.detected, detected);
+  stats_counter_set(self->metrics.hot_key_detected, detected);
+
+  g_hash_table_remove_all(self->hot_key.samples);
+  self->hot_key.num_samples = 0;
+}
+
+static void
+_record_hot_key_sample(LogThreadedDestDriver *self, const gchar *key)
+{
+  g_mutex_lock(&self->hot_key.lock);
+
+  gint count = GPOINTER_TO_INT(g_hash_table_lookup(self->hot_key.samples, key));
+  if (count == 0)
+    g_hash_table_insert(self->hot_key.samples, g_strdup(key), GINT_TO_POINTER(1));
+  else
+    g_hash_table_replace(self->hot_key.samples, g_strdup(key), GINT_TO_POINTER(count + 1));
+
+  if (++self->hot_key.num_samples >= HOT_KEY_SAMPLE_WINDOW)
+    _evaluate_hot_key_samples(self);
+
+  g_mutex_unlock(&self->hot_key.lock);
+}
+
+static guint
+_hash_worker_partition_key(LogThreadedDestDriver *self, LogMessage *msg)
+{
+  LogTemplateEvalOptions options = DEFAULT_TEMPLATE_EVAL_OPTIONS;
+
+  if (!_is_hot_key_detection_enabled(self) ||
+      ((guint) g_atomic_int_add(&self->hot_key.sample_counter, 1) % HOT_KEY_SAMPLING_RATE) != 0)
+    return log_template_hash(self->worker_partition_key, msg, &options);
+
+  /* same as log_template_hash(), but we need the key itself too */
+  ScratchBuffersMarker mark;
+  GString *buffer = scratch_buffers_alloc_and_mark(&mark);
+  log_template_format(self->worker_partition_key, msg, &options, buffer);
+  guint hash = g_str_hash(buffer->str);
+  _record_hot_key_sample(self, buffer->str);
+  scratch_buffers_reclaim_marked(mark);
+
+  return hash;
+}
+
+static inline gboolean
+_is_spread_hot_key(LogThreadedDestDriver *self, guint hash)
+{
+  return self->hot_key.spread &&
+         g_atomic_int_get(&self->hot_key.detected) &&
+         (guint) g_atomic_int_get(&self->hot_key.hash) == hash;
+}
+
+/* Jump consistent hash (Lamping, Veach): when the number of workers
+ * changes from N to N+1, only 1/(N+1) of the keys are moved to a
+ * different worker, instead of reshuffling almost all of them like a
+ * plain modulo would do. */
+static gint
+_jump_consistent_hash(guint64 key, gint num_buckets)
+{
+  gint64 b = -1, j = 0;
+
+  while (j < num_buckets)
+    {
+      b = j;
+      key = key * G_GUINT64_CONSTANT(2862933555777941757) + 1;
+      j = (b + 1) * ((gdouble) (G_GINT64_CONSTANT(1) << 31) / (gdouble) ((key >> 33) + 1));
+    }
+  return b;
+}
+
+/*
+ * Messages are assigned to workers in one of the following ways:
+ *
+ *   - worker-partition-key(): messages with the same key go to the same
+ *     worker, in the order they were received.  Keys are mapped to workers
+ *     using consistent hashing, so changing workers() only moves a
+ *     fraction of the keys.  With hot-key-spread(yes), a hot key (see
+ *     above) is spread across all workers, losing its ordering.
+ *
+ *   - round robin (default): messages are spread evenly, each worker
+ *     delivers its own share in order, but there is no ordering between
+ *     the workers.
+ *
+ *   - work-stealing(yes): like round robin, but idle workers take the
+ *     newest messages waiting for a busy worker, so those may be delivered
+ *     before the older ones left at the busy worker.  It cannot be combined
+ *     with worker-partition-key().
+ *
+ * With workers(min, max), round robin only uses the active workers.
+ */
 LogThreadedDestWorker *
 _lookup_worker(LogThreadedDestDriver *self, LogMessage *msg)
 {
   if (self->worker_partition_key)
     {
-      LogTemplateEvalOptions options = DEFAULT_TEMPLATE_EVAL_OPTIONS;
-      guint worker_index = log_template_hash(self->worker_partition_key, msg, &options) % self->num_workers;
-      return self->workers[worker_index];
+      guint hash = _hash_worker_partition_key(self, msg);
+
+      if (!_is_spread_hot_key(self, hash))
+        return self->workers[_jump_consistent_hash(hash, self->num_workers)];
     }
 
-  guint worker_index = self->last_worker;
-  self->last_worker = (self->last_worker + 1) % self->num_workers;
+  gint active_workers = g_atomic_int_get(&self->autoscale.active_workers);
+  guint worker_index = self->last_worker % active_workers;
+  self->last_worker = (worker_index + 1) % active_workers;
   return self->workers[worker_index];
 }
 
@@ -1240,12 +2062,38 @@ _register_driver_stats(LogThreadedDestDriver *self, StatsClusterKeyBuilder *driv
   }
   stats_cluster_key_builder_pop(driver_sck_builder);
 
+  if (_is_hot_key_detection_enabled(self))
+    {
+      stats_cluster_key_builder_push(driver_sck_builder);
+      {
+        stats_cluster_key_builder_set_name(driver_sck_builder, "output_hot_partition_key");
+        self->metrics.hot_key_sc_key = stats_cluster_key_builder_build_single(driver_sck_builder);
+      }
+      stats_cluster_key_builder_pop(driver_sck_builder);
+    }
+
+  stats_cluster_key_builder_push(driver_sck_builder);
+  {
+    stats_cluster_key_builder_set_name(driver_sck_builder, "output_unreachable_workers");
+    self->metrics.unreachable_workers_sc_key = stats_cluster_key_builder_build_single(driver_sck_builder);
+  }
+  stats_cluster_key_builder_pop(driver_sck_builder);
+
   stats_lock();
   {
+    if (self->metrics.hot_key_sc_key)
+      stats_register_counter(level, self->metrics.hot_key_sc_key, SC_TYPE_SINGLE_VALUE, &self->metrics.hot_key_detected);
     stats_register_counter(level, self->metrics.output_events_sc_key, SC_TYPE_DROPPED, &self->metrics.dropped_messages);
     stats_register_counter(level, self->metrics.output_events_sc_key, SC_TYPE_WRITTEN, &self->metrics.written_messages);
     stats_register_counter(level, self->metrics.processed_sc_key, SC_TYPE_SINGLE_VALUE,
                            &self->metrics.processed_messages);
+    stats_counter_enable_striping(self->metrics.written_messages);
+    stats_counter_enable_striping(self->metrics.processed_messages);
+
+    /* kept across reloads, but the new workers start resumed */
+    stats_register_counter(level, self->metrics.unreachable_workers_sc_key, SC_TYPE_SINGLE_VALUE,
+                           &self->metrics.unreachable_workers);
+    stats_counter_set(self->metrics.unreachable_workers, 0);
   }
   stats_unlock();
 }
@@ -1281,6 +2129,23 @@ _unregister_driver_stats(LogThreadedDestDriver *self)
         stats_cluster_key_free(self->metrics.processed_sc_key);
         self->metrics.processed_sc_key = NULL;
       }
+
+    if (self->metrics.hot_key_sc_key)
+      {
+        stats_unregister_counter(self->metrics.hot_key_sc_key, SC_TYPE_SINGLE_VALUE, &self->metrics.hot_key_detected);
+
+        stats_cluster_key_free(self->metrics.hot_key_sc_key);
+        self->metrics.hot_key_sc_key = NULL;
+      }
+
+    if (self->metrics.unreachable_workers_sc_key)
+      {
+        stats_unregister_counter(self->metrics.unreachable_workers_sc_key, SC_TYPE_SINGLE_VALUE,
+                                 &self->metrics.unreachable_workers);
+
+        stats_cluster_key_free(self->metrics.unreachable_workers_sc_key);
+        self->metrics.unreachable_workers_sc_key = NULL;
+      }
   }
   stats_unlock();
 }
@@ -1296,6 +2161,113 @@ _format_seqnum_persist_name(LogThreadedDestDriver *self)
   return persist_name;
 }
 
+static inline gboolean
+_is_autoscaling_enabled(LogThreadedDestDriver *self)
+{
+  return self->autoscale.min_workers > 0 && self->autoscale.min_workers < self->num_workers;
+}
+
+/*
+ * Returns the number of workers to keep active, given the messages queued
+ * at the active ones and their slowest flush in the last check.  Workers
+ * are added one per check while overloaded, but only removed after
+ * AUTOSCALE_IDLE_ROUNDS idle checks in a row, counted from the last
+ * change, so that a bursty load does not make the count flap.
+ */
+static gint
+_calculate_active_workers(LogThreadedDestDriver *self, gint active_workers, gint64 queued_messages,
+                          gint flush_latency)
+{
+  gint batch_lines = MAX(self->batch_lines, LOG_THREADED_DEST_WORKER_POP_BATCH_SIZE);
+  gboolean overloaded = queued_messages / active_workers > batch_lines * AUTOSCALE_QUEUED_BATCHES_PER_WORKER ||
+                        flush_latency > AUTOSCALE_FLUSH_LATENCY_THRESHOLD;
+  gint new_active_workers = active_workers;
+
+  self->autoscale.idle_rounds = queued_messages == 0 ? self->autoscale.idle_rounds + 1 : 0;
+
+  if (overloaded && active_workers < self->num_workers)
+    new_active_workers++;
+  else if (self->autoscale.idle_rounds >= AUTOSCALE_IDLE_ROUNDS && active_workers > self->autoscale.min_workers)
+    new_active_workers--;
+
+  if (new_active_workers != active_workers)
+    self->autoscale.idle_rounds = 0;
+  return new_active_workers;
+}
+
+/* the slowest flush of a worker since the previous check, workers that did
+ * not flush since then are not slow */
+static gint
+_take_flush_latency(LogThreadedDestWorker *worker)
+{
+  gint flush_latency;
+
+  do
+    flush_latency = g_atomic_int_get(&worker->last_flush_latency);
+  while (!g_atomic_int_compare_and_exchange(&worker->last_flush_latency, flush_latency, 0));
+  return flush_latency;
+}
+
+/*
+ * All the max workers are started with their own queue, so the
+ * persistent state of disk-buffers remains assigned to the same worker.
+ * Scaling only changes the number of workers that new messages are routed
+ * to: a retired worker drains its queue, then disconnects and sleeps until
+ * it is activated again.
+ *
+ * NOTE: runs in the main thread
+ */
+static void
+_autoscale_workers(gpointer s)
+{
+  LogThreadedDestDriver *self = (LogThreadedDestDriver *) s;
+  gint active_workers = g_atomic_int_get(&self->autoscale.active_workers);
+  gint64 queued_messages = 0;
+  gint flush_latency = 0;
+
+  for (gint i = 0; i < active_workers; i++)
+    {
+      queued_messages += log_queue_get_length(self->workers[i]->queue);
+      flush_latency = MAX(flush_latency, _take_flush_latency(self->workers[i]));
+    }
+
+  gint new_active_workers = _calculate_active_workers(self, active_workers, queued_messages, flush_latency);
+  if (new_active_workers != active_workers)
+    {
+      msg_info("Changing the number of active workers",
+               evt_tag_str("driver", self->super.super.id),
+               evt_tag_int("active_workers", new_active_workers),
+               evt_tag_long("queued_messages", queued_messages),
+               evt_tag_int("flush_latency_msec", flush_latency),
+               log_expr_node_location_tag(self->super.super.super.expr_node));
+      g_atomic_int_set(&self->autoscale.active_workers, new_active_workers);
+    }
+
+  iv_validate_now();
+  self->autoscale.timer.expires = iv_now;
+  timespec_add_msec(&self->autoscale.timer.expires, AUTOSCALE_INTERVAL);
+  iv_timer_register(&self->autoscale.timer);
+}
+
+static void
+_start_autoscaling(LogThreadedDestDriver *self)
+{
+  if (!_is_autoscaling_enabled(self))
+    return;
+
+  iv_validate_now();
+  self->autoscale.timer.expires = iv_now;
+  timespec_add_msec(&self->autoscale.timer.expires, AUTOSCALE_INTERVAL);
+  iv_timer_register(&self->autoscale.timer);
+}
+
+static void
+_stop_autoscaling(LogThreadedDestDriver *self)
+{
+  if (iv_timer_registered(&self->autoscale.timer))
+    iv_timer_unregister(&self->autoscale.timer);
+}
+
 static gboolean
 _create_workers(LogThreadedDestDriver *self, gint stats_level, StatsClusterKeyBuilder *driver_sck_builder)
 {
@@ -1351,6 +2323,57 @@ log_threaded_dest_driver_init_method(LogPipe *s)
       return FALSE;
     }
 
+  if (self->max_inflight_batches > LOG_THREADED_DEST_WORKER_MAX_INFLIGHT_BATCHES)
+    {
+      msg_warning("WARNING: max-inflight-batches() is too large, using the maximum",
+                  evt_tag_int("max_inflight_batches", self->max_inflight_batches),
+                  evt_tag_int("limit", LOG_THREADED_DEST_WORKER_MAX_INFLIGHT_BATCHES),
+                  log_expr_node_location_tag(self->super.super.super.expr_node));
+      self->max_inflight_batches = LOG_THREADED_DEST_WORKER_MAX_INFLIGHT_BATCHES;
+    }
+
+  if (self->autoscale.min_workers > self->num_workers)
+    {
+      msg_error("workers(): the minimum number of workers must not be larger than the maximum",
+                evt_tag_int("min_workers", self->autoscale.min_workers),
+                evt_tag_int("max_workers", self->num_workers),
+                log_expr_node_location_tag(self->super.super.super.expr_node));
+      return FALSE;
+    }
+
+  if (_is_autoscaling_enabled(self) && self->worker_partition_key)
+    {
+      msg_warning("WARNING: the number of workers is not scaled when worker-partition-key() is set, as it would "
+                  "break the partitioning of messages, using the maximum",
+                  log_expr_node_location_tag(self->super.super.super.expr_node));
+      self->autoscale.min_workers = 0;
+    }
+
+  self->autoscale.active_workers = _is_autoscaling_enabled(self) ? self->autoscale.min_workers : self->num_workers;
+  self->autoscale.idle_rounds = 0;
+
+  if (self->work_stealing && self->worker_partition_key)
+    {
+      msg_warning("WARNING: work-stealing() is ignored when worker-partition-key() is set, as it would break "
+                  "the partitioning of messages",
+                  log_expr_node_location_tag(self->super.super.super.expr_node));
+      self->work_stealing = FALSE;
+    }
+
+  if (self->hot_key.threshold > 100)
+    {
+      msg_error("hot-key-threshold() is a percentage, it must be between 0 and 100",
+                evt_tag_int("hot_key_threshold", self->hot_key.threshold),
+                log_expr_node_location_tag(self->super.super.super.expr_node));
+      return FALSE;
+    }
+
+  if (_is_hot_key_detection_enabled(self) && !self->hot_key.samples)
+    self->hot_key.samples = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+  self->hot_key.num_samples = 0;
+  self->hot_key.detected = FALSE;
+  self->hot_key.hash = 0;
+
   StatsClusterKeyBuilder *driver_sck_builder = stats_cluster_key_builder_new();
   _init_driver_sck_builder(self, driver_sck_builder);
 
@@ -1381,6 +2404,8 @@ log_threaded_dest_driver_start_workers(LogPipe *s)
       if (!log_threaded_dest_worker_start(self->workers[worker_index]))
         return FALSE;
     }
+
+  _start_autoscaling(self);
   return TRUE;
 }
 
@@ -1412,6 +2437,7 @@ log_threaded_dest_driver_deinit_method(LogPipe *s)
                          _format_seqnum_persist_name(self),
                          GINT_TO_POINTER(self->shared_seq_num), NULL);
 
+  _stop_autoscaling(self);
   _unregister_driver_stats(self);
 
   _destroy_workers(self);
@@ -1426,6 +2452,9 @@ log_threaded_dest_driver_free(LogPipe *s)
   LogThreadedDestDriver *self = (LogThreadedDestDriver *)s;
 
   g_free(self->workers);
+  if (self->hot_key.samples)
+    g_hash_table_destroy(self->hot_key.samples);
+  g_mutex_clear(&self->hot_key.lock);
   log_dest_driver_free((LogPipe *)self);
 }
 
@@ -1446,8 +2475,17 @@ log_threaded_dest_driver_init_instance(LogThreadedDestDriver *self, GlobalConfig
   self->num_workers = 1;
   self->last_worker = 0;
 
+  IV_TIMER_INIT(&self->autoscale.timer);
+  self->autoscale.timer.cookie = self;
+  self->autoscale.timer.handler = _autoscale_workers;
+
   self->retries_on_error_max = MAX_RETRIES_ON_ERROR_DEFAULT;
   self->retries_max = MAX_RETRIES_BEFORE_SUSPEND_DEFAULT;
 
   self->flush_on_key_change = FALSE;
+  self->work_stealing = FALSE;
+  g_mutex_init(&self->hot_key.lock);
+  self->max_inflight_batches = 1;
+  self->batch_bytes = 0;
+  self->adaptive_batching = FALSE;
 }
@@ -31,6 +31,8 @@
 #include "stats/aggregator/stats-aggregator.h"
 #include "stats/stats-compat.h"
 #include "stats/stats-cluster-key-builder.h"
+#include "stats/stats-histogram.h"
+#include "logthrdest/batch-arena.h"
 #include "logqueue.h"
 #include "seqnum.h"
 #include "mainloop-threaded-worker.h"
@@ -67,6 +69,21 @@ typedef enum
 typedef struct _LogThreadedDestDriver LogThreadedDestDriver;
 typedef struct _LogThreadedDestWorker LogThreadedDestWorker;
 
+/* number of messages fetched from the queue at once by the worker */
+#define LOG_THREADED_DEST_WORKER_POP_BATCH_SIZE 64
+
+/* upper limit of max-inflight-batches() */
+#define LOG_THREADED_DEST_WORKER_MAX_INFLIGHT_BATCHES 64
+
+typedef struct _LogThreadedDestInflightBatch
+{
+  guint32 id;
+  gint len;
+  gint64 submit_time;
+  gboolean completed;
+  LogThreadedResult result;
+} LogThreadedDestInflightBatch;
+
 struct _LogThreadedDestWorker
 {
   MainLoopThreadedWorker thread;
@@ -77,17 +94,21 @@ struct _LogThreadedDestWorker
   struct iv_timer timer_reopen;
   struct iv_timer timer_throttle;
   struct iv_timer timer_flush;
+  struct iv_timer timer_steal;
 
   LogThreadedDestDriver *owner;
 
   gint worker_index;
   gboolean connected;
   gint batch_size;
+  gsize batch_bytes;
   gint rewound_batch_size;
   gint retries_on_error_counter;
   guint retries_counter;
   gint32 seq_num;
   struct timespec last_flush_time;
+  /* the slowest flush since the last autoscale check, in milliseconds */
+  gint last_flush_latency;
   gboolean enable_batching;
   gboolean suspended;
   time_t time_reopen;
@@ -97,17 +118,59 @@ struct _LogThreadedDestWorker
     GString *last_key;
   } partitioning;
 
+  /* messages popped from the queue (and thus on its backlog), but not yet inserted */
+  struct
+  {
+    LogMessage *msgs[LOG_THREADED_DEST_WORKER_POP_BATCH_SIZE];
+    LogPathOptions path_options[LOG_THREADED_DEST_WORKER_POP_BATCH_SIZE];
+    gint pos, len;
+  } prefetch;
+
+  /* batches submitted using flush_async(), but not yet processed, oldest
+   * first.  They are on the backlog of the queue, before the messages of
+   * the current batch. */
+  struct
+  {
+    GMutex lock;
+    GCond cond;
+    LogThreadedDestInflightBatch batches[LOG_THREADED_DEST_WORKER_MAX_INFLIGHT_BATCHES];
+    gint head, len;
+    guint32 next_id;
+    gboolean completing;
+  } inflight;
+
+  /* formatted messages of the current batch, see batch-arena.h */
+  LogThreadedDestBatchArena arena;
+
+  /* batch_lines limit chosen by adaptive-batching() */
+  struct
+  {
+    gint batch_lines;
+    gint64 avg_flush_latency;
+  } adaptive;
+
   struct
   {
     StatsClusterKey *output_event_bytes_sc_key;
     StatsClusterKey *message_delay_sample_key;
     StatsClusterKey *message_delay_sample_age_key;
+    StatsClusterKey *stolen_events_sc_key;
+    StatsClusterKey *batch_lines_sc_key;
 
     StatsByteCounter written_bytes;
     StatsCounterItem *message_delay_sample;
     StatsCounterItem *message_delay_sample_age;
+    StatsCounterItem *stolen_events;
+    StatsCounterItem *batch_lines;
 
     gint64 last_delay_update;
+
+    /* latency histograms, at stats level 2 */
+    StatsHistogram time_in_queue;
+    StatsHistogram insert_duration;
+    StatsHistogram flush_duration;
+    StatsHistogram retry_backoff;
+    gint64 suspend_start;
   } metrics;
 
   gboolean (*init)(LogThreadedDestWorker *s);
@@ -116,6 +179,23 @@ struct _LogThreadedDestWorker
   void (*disconnect)(LogThreadedDestWorker *s);
   LogThreadedResult (*insert)(LogThreadedDestWorker *s, LogMessage *msg);
   LogThreadedResult (*flush)(LogThreadedDestWorker *s, LogThreadedFlushMode mode);
+
+  /*
+   * Optional, used instead of flush() if max-inflight-batches() is larger
+   * than 1.  It starts sending the current batch and returns LTR_QUEUED,
+   * in which case the worker continues with the next batch and the
+   * outcome is reported later using
+   * log_threaded_dest_worker_complete_batch() with the same batch_id.  Any
+   * other return value completes the batch right away.
+   *
+   * Batches are acknowledged in the order of submission; the failure of a
+   * batch rewinds it together with all the batches submitted after it.
+   *
+   * The completion must not depend on the worker's ivykis loop: at
+   * shutdown, the worker waits for the outstanding batches without
+   * running it.
+   */
+  LogThreadedResult (*flush_async)(LogThreadedDestWorker *s, LogThreadedFlushMode mode, guint32 batch_id);
   void (*free_fn)(LogThreadedDestWorker *s);
 };
 
@@ -141,10 +221,20 @@ struct _LogThreadedDestDriver
     StatsAggregator *max_batch_size;
     StatsAggregator *average_batch_size;
     StatsAggregator *CPS;
+
+    StatsClusterKey *hot_key_sc_key;
+    StatsCounterItem *hot_key_detected;
+
+    /* number of suspended workers */
+    StatsClusterKey *unreachable_workers_sc_key;
+    StatsCounterItem *unreachable_workers;
   } metrics;
 
   gint batch_lines;
+  glong batch_bytes;
+  gboolean adaptive_batching;
   gint batch_timeout;
+  gint max_inflight_batches;
   gboolean under_termination;
   time_t time_reopen;
   gint retries_on_error_max;
@@ -172,8 +262,33 @@ struct _LogThreadedDestDriver
   gint created_workers;
   guint last_worker;
 
+  /* workers(min, max): only the first active_workers workers get new
+   * messages, the rest are retired, they drain their queue and disconnect */
+  struct
+  {
+    gint min_workers;
+    gint active_workers;
+    gint idle_rounds;
+    struct iv_timer timer;
+  } autoscale;
+
   gboolean flush_on_key_change;
   LogTemplate *worker_partition_key;
+  gboolean work_stealing;
+
+  /* hot-key-threshold(): a sample of the worker-partition-key() values is
+   * counted to detect a single key carrying most of the traffic */
+  struct
+  {
+    gint threshold;
+    gboolean spread;
+    GMutex lock;
+    GHashTable *samples;
+    gint num_samples;
+    guint sample_counter;
+    guint hash;
+    gboolean detected;
+  } hot_key;
   gint stats_source;
 
   /* this counter is not thread safe if there are multiple worker threads,
@@ -233,9 +348,16 @@ log_threaded_dest_worker_insert(LogThreadedDestWorker *self, LogMessage *msg)
   else
     self->seq_num = 0;
 
+  gint64 insert_start = 0;
+  if (stats_histogram_is_enabled(&self->metrics.insert_duration))
+    insert_start = g_get_monotonic_time();
+
   LogThreadedResult result = self->insert(self, msg);
 
-  if (self->metrics.message_delay_sample
+  if (insert_start)
+    stats_histogram_observe(&self->metrics.insert_duration, g_get_monotonic_time() - insert_start);
+
+  if ((self->metrics.message_delay_sample || stats_histogram_is_enabled(&self->metrics.time_in_queue))
       && (result == LTR_QUEUED || result == LTR_SUCCESS || result == LTR_EXPLICIT_ACK_MGMT))
     {
       UnixTime now;
@@ -243,7 +365,9 @@ log_threaded_dest_worker_insert(LogThreadedDestWorker *self, LogMessage *msg)
       unix_time_set_now(&now);
       gint64 diff_msec = unix_time_diff_in_msec(&now, &msg->timestamps[LM_TS_RECVD]);
 
-      if (self->metrics.last_delay_update != now.ut_sec)
+      stats_histogram_observe(&self->metrics.time_in_queue, MAX(diff_msec, 0) * 1000);
+
+      if (self->metrics.message_delay_sample && self->metrics.last_delay_update != now.ut_sec)
         {
           stats_counter_set_time(self->metrics.message_delay_sample, diff_msec);
           stats_counter_set_time(self->metrics.message_delay_sample_age, now.ut_sec);
@@ -260,7 +384,16 @@ log_threaded_dest_worker_flush(LogThreadedDestWorker *self, LogThreadedFlushMode
   LogThreadedResult result = LTR_SUCCESS;
 
   if (self->flush)
-    result = self->flush(self, mode);
+    {
+      gint64 flush_start = 0;
+      if (stats_histogram_is_enabled(&self->metrics.flush_duration))
+        flush_start = g_get_monotonic_time();
+
+      result = self->flush(self, mode);
+
+      if (flush_start)
+        stats_histogram_observe(&self->metrics.flush_duration, g_get_monotonic_time() - flush_start);
+    }
   iv_validate_now();
   self->last_flush_time = iv_now;
   return result;
@@ -276,6 +409,7 @@ log_threaded_dest_driver_flush(LogThreadedDestDriver *self)
 void log_threaded_dest_worker_ack_messages(LogThreadedDestWorker *self, gint batch_size);
 void log_threaded_dest_worker_drop_messages(LogThreadedDestWorker *self, gint batch_size);
 void log_threaded_dest_worker_rewind_messages(LogThreadedDestWorker *self, gint batch_size);
+void log_threaded_dest_worker_complete_batch(LogThreadedDestWorker *self, guint32 batch_id, LogThreadedResult result);
 void log_threaded_dest_worker_wakeup_when_suspended(LogThreadedDestWorker *self);
 gboolean log_threaded_dest_worker_init_method(LogThreadedDestWorker *self);
 void log_threaded_dest_worker_deinit_method(LogThreadedDestWorker *self);
@@ -286,6 +420,16 @@ void log_threaded_dest_worker_free_method(LogThreadedDestWorker *self);
 void log_threaded_dest_worker_free(LogThreadedDestWorker *self);
 
 void log_threaded_dest_worker_written_bytes_add(LogThreadedDestWorker *self, gsize b);
+
+/* Drivers may report the formatted size of the message being inserted, to
+ * be used by batch-bytes().  Otherwise the size of the message in memory
+ * is used as an estimate. */
+static inline void
+log_threaded_dest_worker_batch_bytes_add(LogThreadedDestWorker *self, gsize b)
+{
+  self->batch_bytes += b;
+}
+
 void log_threaded_dest_driver_insert_msg_length_stats(LogThreadedDestDriver *self, gsize len);
 void log_threaded_dest_driver_insert_batch_length_stats(LogThreadedDestDriver *self, gsize len);
 void log_threaded_dest_driver_register_aggregated_stats(LogThreadedDestDriver *self);
@@ -300,10 +444,17 @@ void log_threaded_dest_driver_free(LogPipe *s);
 
 void log_threaded_dest_driver_set_max_retries_on_error(LogDriver *s, gint max_retries);
 void log_threaded_dest_driver_set_num_workers(LogDriver *s, gint num_workers);
+void log_threaded_dest_driver_set_num_workers_range(LogDriver *s, gint min_workers, gint max_workers);
 void log_threaded_dest_driver_set_worker_partition_key_ref(LogDriver *s, LogTemplate *key);
 void log_threaded_dest_driver_set_flush_on_worker_key_change(LogDriver *s, gboolean f);
+void log_threaded_dest_driver_set_work_stealing(LogDriver *s, gboolean work_stealing);
+void log_threaded_dest_driver_set_hot_key_threshold(LogDriver *s, gint threshold);
+void log_threaded_dest_driver_set_hot_key_spread(LogDriver *s, gboolean spread);
 void log_threaded_dest_driver_set_batch_lines(LogDriver *s, gint batch_lines);
 void log_threaded_dest_driver_set_batch_timeout(LogDriver *s, gint batch_timeout);
+void log_threaded_dest_driver_set_max_inflight_batches(LogDriver *s, gint max_inflight_batches);
+void log_threaded_dest_driver_set_batch_bytes(LogDriver *s, glong batch_bytes);
+void log_threaded_dest_driver_set_adaptive_batching(LogDriver *s, gboolean adaptive_batching);
 void log_threaded_dest_driver_set_time_reopen(LogDriver *s, time_t time_reopen);
 
 #endif
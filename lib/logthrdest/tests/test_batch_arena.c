@@ -0,0 +1,128 @@
+/*
+ * Copyright (c) 2024 One Identity LLC.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#include <criterion/criterion.h>
+
+#include "logthrdest/batch-arena.h"
+
+#include <string.h>
+
+static void
+_append_message(LogThreadedDestBatchArena *arena, const gchar *msg)
+{
+  GString *buffer = log_threaded_dest_batch_arena_begin_message(arena);
+  g_string_append(buffer, msg);
+}
+
+static void
+_assert_message(LogThreadedDestBatchArena *arena, gint index, const gchar *expected)
+{
+  gsize len;
+  const gchar *msg = log_threaded_dest_batch_arena_get_message(arena, index, &len);
+
+  cr_assert_eq(len, strlen(expected));
+  cr_assert(memcmp(msg, expected, len) == 0);
+}
+
+Test(batch_arena, messages_are_stored_contiguously_with_their_offsets)
+{
+  LogThreadedDestBatchArena arena;
+  log_threaded_dest_batch_arena_init(&arena);
+
+  cr_assert_eq(log_threaded_dest_batch_arena_get_num_messages(&arena), 0);
+
+  _append_message(&arena, "foo");
+  _append_message(&arena, "");
+  _append_message(&arena, "barbaz");
+
+  cr_assert_eq(log_threaded_dest_batch_arena_get_num_messages(&arena), 3);
+  cr_assert_eq(log_threaded_dest_batch_arena_get_size(&arena), 9);
+  cr_assert_str_eq(arena.buffer->str, "foobarbaz");
+  _assert_message(&arena, 0, "foo");
+  _assert_message(&arena, 1, "");
+  _assert_message(&arena, 2, "barbaz");
+
+  struct iovec iov[2];
+  cr_assert_eq(log_threaded_dest_batch_arena_fill_iovec(&arena, iov, G_N_ELEMENTS(iov)), 2);
+  cr_assert_eq(iov[0].iov_len, 3);
+  cr_assert_eq(iov[1].iov_len, 0);
+  cr_assert_eq(iov[0].iov_base, arena.buffer->str);
+
+  log_threaded_dest_batch_arena_clear(&arena);
+}
+
+Test(batch_arena, discarded_messages_are_removed_from_the_end)
+{
+  LogThreadedDestBatchArena arena;
+  log_threaded_dest_batch_arena_init(&arena);
+
+  _append_message(&arena, "foo");
+  _append_message(&arena, "broken");
+  log_threaded_dest_batch_arena_discard_message(&arena);
+  _append_message(&arena, "bar");
+
+  cr_assert_eq(log_threaded_dest_batch_arena_get_num_messages(&arena), 2);
+  cr_assert_str_eq(arena.buffer->str, "foobar");
+  _assert_message(&arena, 1, "bar");
+
+  log_threaded_dest_batch_arena_clear(&arena);
+}
+
+Test(batch_arena, reset_retains_the_capacity)
+{
+  LogThreadedDestBatchArena arena;
+  log_threaded_dest_batch_arena_init(&arena);
+
+  GString *buffer = log_threaded_dest_batch_arena_begin_message(&arena);
+  g_string_set_size(buffer, 65536);
+  gsize capacity = arena.buffer->allocated_len;
+
+  log_threaded_dest_batch_arena_reset(&arena);
+  cr_assert_eq(log_threaded_dest_batch_arena_get_num_messages(&arena), 0);
+  cr_assert_eq(log_threaded_dest_batch_arena_get_size(&arena), 0);
+  cr_assert_eq(arena.buffer->allocated_len, capacity);
+  cr_assert_eq(arena.high_water_mark, 65536);
+
+  log_threaded_dest_batch_arena_clear(&arena);
+}
+
+Test(batch_arena, oversized_buffer_is_shrunk_to_the_high_water_mark)
+{
+  LogThreadedDestBatchArena arena;
+  log_threaded_dest_batch_arena_init(&arena);
+
+  GString *buffer = log_threaded_dest_batch_arena_begin_message(&arena);
+  g_string_set_size(buffer, 1024 * 1024);
+  log_threaded_dest_batch_arena_reset(&arena);
+
+  /* a full shrink interval with small batches only */
+  for (gint i = 0; i < 1000; i++)
+    {
+      _append_message(&arena, "foo");
+      log_threaded_dest_batch_arena_reset(&arena);
+    }
+
+  cr_assert_lt(arena.buffer->allocated_len, 1024 * 1024);
+
+  log_threaded_dest_batch_arena_clear(&arena);
+}
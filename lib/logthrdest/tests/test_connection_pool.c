@@ -0,0 +1,200 @@
+/*
+ * Copyright (c) 2024 One Identity LLC.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#include <criterion/criterion.h>
+
+#include "logthrdest/connection-pool.h"
+#include "apphook.h"
+
+typedef struct _TestConnection
+{
+  gint id;
+  gboolean healthy;
+} TestConnection;
+
+static gint connect_counter;
+static gint disconnect_counter;
+static gboolean connect_fails;
+
+static gpointer
+_test_connect(const gchar *target)
+{
+  if (connect_fails)
+    return NULL;
+
+  TestConnection *connection = g_new0(TestConnection, 1);
+  connection->id = ++connect_counter;
+  connection->healthy = TRUE;
+  return connection;
+}
+
+static void
+_test_disconnect(gpointer connection)
+{
+  disconnect_counter++;
+  g_free(connection);
+}
+
+static gboolean
+_test_check_health(gpointer connection)
+{
+  return ((TestConnection *) connection)->healthy;
+}
+
+static const LogThreadedConnectionPoolMethods test_methods =
+{
+  .connect = _test_connect,
+  .disconnect = _test_disconnect,
+  .check_health = _test_check_health,
+};
+
+Test(connection_pool, returned_connections_are_reused)
+{
+  LogThreadedConnectionPool *pool = log_threaded_connection_pool_acquire("test://target", &test_methods, 2, 0);
+
+  TestConnection *c1 = log_threaded_connection_pool_borrow(pool, 0);
+  cr_assert_not_null(c1);
+  log_threaded_connection_pool_return(pool, c1, TRUE);
+
+  TestConnection *c2 = log_threaded_connection_pool_borrow(pool, 0);
+  cr_assert_eq(c2, c1);
+  cr_assert_eq(connect_counter, 1);
+  cr_assert_eq(log_threaded_connection_pool_get_num_connections(pool), 1);
+
+  log_threaded_connection_pool_return(pool, c2, TRUE);
+  log_threaded_connection_pool_release(pool);
+  cr_assert_eq(disconnect_counter, 1);
+}
+
+Test(connection_pool, the_number_of_connections_is_capped)
+{
+  LogThreadedConnectionPool *pool = log_threaded_connection_pool_acquire("test://target", &test_methods, 2, 0);
+
+  gpointer c1 = log_threaded_connection_pool_borrow(pool, 0);
+  gpointer c2 = log_threaded_connection_pool_borrow(pool, 0);
+  cr_assert_not_null(c1);
+  cr_assert_not_null(c2);
+  cr_assert_null(log_threaded_connection_pool_borrow(pool, 10));
+  cr_assert_eq(connect_counter, 2);
+
+  log_threaded_connection_pool_return(pool, c1, TRUE);
+  cr_assert_eq(log_threaded_connection_pool_borrow(pool, 10), c1);
+
+  log_threaded_connection_pool_return(pool, c1, TRUE);
+  log_threaded_connection_pool_return(pool, c2, TRUE);
+  log_threaded_connection_pool_release(pool);
+}
+
+Test(connection_pool, broken_connections_are_replaced)
+{
+  LogThreadedConnectionPool *pool = log_threaded_connection_pool_acquire("test://target", &test_methods, 1, 0);
+
+  TestConnection *c1 = log_threaded_connection_pool_borrow(pool, 0);
+  c1->healthy = FALSE;
+  log_threaded_connection_pool_return(pool, c1, TRUE);
+
+  TestConnection *c2 = log_threaded_connection_pool_borrow(pool, 0);
+  cr_assert_not_null(c2);
+  cr_assert_eq(c2->id, 2);
+  cr_assert_eq(disconnect_counter, 1);
+
+  log_threaded_connection_pool_return(pool, c2, FALSE);
+  cr_assert_eq(disconnect_counter, 2);
+  cr_assert_eq(log_threaded_connection_pool_get_num_connections(pool), 0);
+
+  log_threaded_connection_pool_release(pool);
+}
+
+Test(connection_pool, failed_connects_do_not_count_against_the_cap)
+{
+  LogThreadedConnectionPool *pool = log_threaded_connection_pool_acquire("test://target", &test_methods, 1, 0);
+
+  connect_fails = TRUE;
+  cr_assert_null(log_threaded_connection_pool_borrow(pool, 0));
+  cr_assert_eq(log_threaded_connection_pool_get_num_connections(pool), 0);
+
+  connect_fails = FALSE;
+  gpointer c1 = log_threaded_connection_pool_borrow(pool, 0);
+  cr_assert_not_null(c1);
+
+  log_threaded_connection_pool_return(pool, c1, TRUE);
+  log_threaded_connection_pool_release(pool);
+}
+
+Test(connection_pool, idle_connections_are_closed_after_idle_timeout)
+{
+  LogThreadedConnectionPool *pool = log_threaded_connection_pool_acquire("test://target", &test_methods, 2, 1);
+
+  gpointer c1 = log_threaded_connection_pool_borrow(pool, 0);
+  log_threaded_connection_pool_return(pool, c1, TRUE);
+  cr_assert_eq(log_threaded_connection_pool_get_num_idle_connections(pool), 1);
+
+  g_usleep(1100 * 1000);
+
+  TestConnection *c2 = log_threaded_connection_pool_borrow(pool, 0);
+  cr_assert_eq(c2->id, 2);
+  cr_assert_eq(disconnect_counter, 1);
+
+  log_threaded_connection_pool_return(pool, c2, TRUE);
+  log_threaded_connection_pool_release(pool);
+}
+
+Test(connection_pool, pools_are_shared_by_target)
+{
+  LogThreadedConnectionPool *pool1 = log_threaded_connection_pool_acquire("test://target", &test_methods, 1, 0);
+  LogThreadedConnectionPool *pool2 = log_threaded_connection_pool_acquire("test://target", &test_methods, 3, 0);
+  LogThreadedConnectionPool *other = log_threaded_connection_pool_acquire("test://other", &test_methods, 1, 0);
+
+  cr_assert_eq(pool1, pool2);
+  cr_assert_neq(pool1, other);
+
+  gpointer c1 = log_threaded_connection_pool_borrow(pool1, 0);
+  gpointer c2 = log_threaded_connection_pool_borrow(pool2, 0);
+  cr_assert_not_null(c2, "the largest cap asked for should be used");
+
+  log_threaded_connection_pool_return(pool1, c1, TRUE);
+  log_threaded_connection_pool_return(pool2, c2, TRUE);
+
+  log_threaded_connection_pool_release(pool1);
+  cr_assert_eq(disconnect_counter, 0);
+  log_threaded_connection_pool_release(pool2);
+  cr_assert_eq(disconnect_counter, 2);
+  log_threaded_connection_pool_release(other);
+}
+
+static void
+setup(void)
+{
+  app_startup();
+  connect_counter = 0;
+  disconnect_counter = 0;
+  connect_fails = FALSE;
+}
+
+static void
+teardown(void)
+{
+  app_shutdown();
+}
+
+TestSuite(connection_pool, .init = setup, .fini = teardown);
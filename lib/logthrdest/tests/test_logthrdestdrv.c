@@ -39,6 +39,7 @@ typedef struct TestThreadedDestDriver
   gint failure_counter;
   gint prev_flush_size;
   gint flush_size;
+  guint32 inflight_batch_ids[LOG_THREADED_DEST_WORKER_MAX_INFLIGHT_BATCHES];
 } TestThreadedDestDriver;
 
 static const gchar *
@@ -761,6 +762,35 @@ Test(logthrdestdrv, test_connect_failure_kicks_in_suspend_retry_logic_which_keep
   _generate_message_and_wait_for_processing(dd, dd->super.metrics.written_messages);
   cr_assert(dd->connect_counter == 11, "%d", dd->connect_counter);
   assert_grabbed_log_contains("Error establishing connection to server");
+  cr_assert(stats_counter_get(dd->super.metrics.unreachable_workers) == 0, "the reconnected worker is still counted");
+}
+
+static gboolean
+_connect_never(LogThreadedDestDriver *s)
+{
+  TestThreadedDestDriver *self = (TestThreadedDestDriver *) s;
+
+  self->connect_counter++;
+  return FALSE;
+}
+
+Test(logthrdestdrv, test_suspended_workers_are_counted_as_unreachable)
+{
+  /* the dd created by setup() is not good for us */
+  _teardown_dd();
+
+  start_grabbing_messages();
+  dd = test_threaded_dd_new(main_loop_get_current_config(main_loop));
+
+  dd->super.worker.connect = _connect_never;
+  dd->super.worker.insert = _insert_single_message_success;
+  dd->super.time_reopen = 60;
+  cr_assert(log_pipe_init(&dd->super.super.super.super));
+  cr_assert(stats_counter_get(dd->super.metrics.unreachable_workers) == 0);
+  cr_assert(log_pipe_post_config_init(&dd->super.super.super.super));
+
+  _spin_for_counter_value(dd->super.metrics.unreachable_workers, 1);
+  cr_assert(dd->connect_counter == 1, "the worker is not suspended for time-reopen(), %d", dd->connect_counter);
 }
 
 /* we batch 5 messages but then flush them only one-by-one */
@@ -806,6 +836,108 @@ Test(logthrdestdrv, test_explicit_ack_accept)
   cr_assert(dd->super.shared_seq_num == 11, "%d", dd->super.shared_seq_num);
 }
 
+static LogThreadedResult
+_insert_message_reporting_its_size(LogThreadedDestDriver *s, LogMessage *msg)
+{
+  TestThreadedDestDriver *self = (TestThreadedDestDriver *) s;
+
+  self->insert_counter++;
+  log_threaded_dest_worker_batch_bytes_add(&s->worker.instance, 100);
+  return LTR_QUEUED;
+}
+
+static LogThreadedResult
+_flush_batch_of_three_messages(LogThreadedDestDriver *s)
+{
+  TestThreadedDestDriver *self = (TestThreadedDestDriver *) s;
+
+  /* see the note in logthrdestdrv.c:_perform_flush() */
+  if (self->super.worker.instance.batch_size == 0)
+    return LTR_SUCCESS;
+
+  cr_expect_eq(self->super.worker.instance.batch_size, 3);
+  self->flush_size += self->super.worker.instance.batch_size;
+  return LTR_SUCCESS;
+}
+
+Test(logthrdestdrv, batch_bytes_flushes_the_batch_once_the_size_limit_is_reached)
+{
+  dd->super.worker.insert = _insert_message_reporting_its_size;
+  dd->super.worker.flush = _flush_batch_of_three_messages;
+  dd->super.batch_bytes = 250;
+  /* only flush full batches */
+  dd->super.batch_timeout = 10000;
+
+  _generate_messages_and_wait_for_processing(dd, 9, dd->super.metrics.written_messages);
+  cr_assert_eq(dd->insert_counter, 9);
+  cr_assert_eq(dd->flush_size, 9);
+  cr_assert_eq(stats_counter_get(dd->super.metrics.dropped_messages), 0);
+}
+
+static LogThreadedResult
+_insert_message_queued(LogThreadedDestDriver *s, LogMessage *msg)
+{
+  TestThreadedDestDriver *self = (TestThreadedDestDriver *) s;
+
+  self->insert_counter++;
+  return LTR_QUEUED;
+}
+
+static LogThreadedResult
+_flush_async_keeps_batch_in_flight(LogThreadedDestWorker *s, LogThreadedFlushMode mode, guint32 batch_id)
+{
+  TestThreadedDestDriver *self = (TestThreadedDestDriver *) s->owner;
+  gint flush_counter = g_atomic_int_get(&self->flush_counter);
+
+  self->inflight_batch_ids[flush_counter] = batch_id;
+  g_atomic_int_inc(&self->flush_counter);
+  return LTR_QUEUED;
+}
+
+static void
+_spin_for_flush_counter_value(TestThreadedDestDriver *self, gint expected_value)
+{
+  gint c = 0;
+
+  while (g_atomic_int_get(&self->flush_counter) != expected_value && c < MAX_SPIN_ITERATIONS)
+    {
+      _sleep_msec(1);
+      c++;
+    }
+  cr_assert_eq(g_atomic_int_get(&self->flush_counter), expected_value);
+}
+
+Test(logthrdestdrv, inflight_batches_are_acknowledged_in_the_order_of_submission)
+{
+  LogThreadedDestWorker *worker = &dd->super.worker.instance;
+
+  dd->super.worker.insert = _insert_message_queued;
+  worker->flush_async = _flush_async_keeps_batch_in_flight;
+  dd->super.batch_lines = 5;
+  /* only flush full batches */
+  dd->super.batch_timeout = 10000;
+  dd->super.max_inflight_batches = 3;
+
+  _generate_messages(dd, 15, TRUE);
+  _spin_for_flush_counter_value(dd, 3);
+  cr_assert_eq(dd->insert_counter, 15);
+  cr_assert_eq(stats_counter_get(dd->super.metrics.written_messages), 0);
+
+  /* the second batch has to wait for the first one */
+  log_threaded_dest_worker_complete_batch(worker, dd->inflight_batch_ids[1], LTR_SUCCESS);
+  _sleep_msec(10);
+  cr_assert_eq(stats_counter_get(dd->super.metrics.written_messages), 0);
+
+  log_threaded_dest_worker_complete_batch(worker, dd->inflight_batch_ids[0], LTR_SUCCESS);
+  _spin_for_counter_value(dd->super.metrics.written_messages, 10);
+
+  log_threaded_dest_worker_complete_batch(worker, dd->inflight_batch_ids[2], LTR_SUCCESS);
+  _spin_for_counter_value(dd->super.metrics.written_messages, 15);
+
+  cr_assert_eq(stats_counter_get(dd->super.metrics.dropped_messages), 0);
+  cr_assert_eq(stats_counter_get(worker->queue->metrics.shared.memory_usage), 0);
+}
+
 MainLoopOptions main_loop_options = {0};
 
 static void
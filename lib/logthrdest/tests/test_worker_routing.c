@@ -0,0 +1,338 @@
+/*
+ * Copyright (c) 2024 One Identity LLC.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#include <criterion/criterion.h>
+
+#include "logthrdest/logthrdestdrv.c"
+#include "apphook.h"
+
+#define TEST_MAX_WORKERS 4
+
+/* more batches than the autoscaler tolerates per worker */
+#define OVERLOADED_QUEUE_LENGTH(active_workers) \
+  ((active_workers) * (LOG_THREADED_DEST_WORKER_POP_BATCH_SIZE * AUTOSCALE_QUEUED_BATCHES_PER_WORKER + 1))
+
+static LogThreadedDestDriver *
+_create_driver(gint min_workers, gint max_workers)
+{
+  LogThreadedDestDriver *self = g_new0(LogThreadedDestDriver, 1);
+
+  self->num_workers = max_workers;
+  self->autoscale.min_workers = min_workers;
+  self->autoscale.active_workers = min_workers;
+  self->workers = g_new0(LogThreadedDestWorker *, max_workers);
+  for (gint i = 0; i < max_workers; i++)
+    {
+      self->workers[i] = g_new0(LogThreadedDestWorker, 1);
+      self->workers[i]->worker_index = i;
+    }
+  return self;
+}
+
+static void
+_enable_hot_key_detection(LogThreadedDestDriver *self, gint threshold, gboolean spread)
+{
+  self->hot_key.threshold = threshold;
+  self->hot_key.spread = spread;
+  self->hot_key.samples = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+  g_mutex_init(&self->hot_key.lock);
+}
+
+static void
+_free_driver(LogThreadedDestDriver *self)
+{
+  if (self->hot_key.samples)
+    {
+      g_hash_table_destroy(self->hot_key.samples);
+      g_mutex_clear(&self->hot_key.lock);
+    }
+  for (gint i = 0; i < self->num_workers; i++)
+    g_free(self->workers[i]);
+  g_free(self->workers);
+  g_free(self);
+}
+
+static void
+_check_load(LogThreadedDestDriver *self, gint64 queued_messages, gint flush_latency)
+{
+  self->autoscale.active_workers = _calculate_active_workers(self, self->autoscale.active_workers, queued_messages,
+                                   flush_latency);
+}
+
+Test(worker_routing, autoscaling_adds_one_worker_per_check_while_the_queues_are_long)
+{
+  LogThreadedDestDriver *self = _create_driver(1, TEST_MAX_WORKERS);
+
+  for (gint expected = 2; expected <= TEST_MAX_WORKERS; expected++)
+    {
+      _check_load(self, OVERLOADED_QUEUE_LENGTH(self->autoscale.active_workers), 0);
+      cr_assert_eq(self->autoscale.active_workers, expected);
+    }
+
+  _check_load(self, OVERLOADED_QUEUE_LENGTH(TEST_MAX_WORKERS), 0);
+  cr_assert_eq(self->autoscale.active_workers, TEST_MAX_WORKERS, "the maximum should not be exceeded");
+
+  _free_driver(self);
+}
+
+Test(worker_routing, autoscaling_adds_a_worker_if_flushes_are_slow)
+{
+  LogThreadedDestDriver *self = _create_driver(1, TEST_MAX_WORKERS);
+
+  _check_load(self, 1, AUTOSCALE_FLUSH_LATENCY_THRESHOLD);
+  cr_assert_eq(self->autoscale.active_workers, 1);
+
+  _check_load(self, 1, AUTOSCALE_FLUSH_LATENCY_THRESHOLD + 1);
+  cr_assert_eq(self->autoscale.active_workers, 2);
+
+  _free_driver(self);
+}
+
+Test(worker_routing, autoscaling_only_sees_the_flushes_since_the_previous_check)
+{
+  LogThreadedDestDriver *self = _create_driver(1, TEST_MAX_WORKERS);
+  LogThreadedDestWorker *worker = self->workers[0];
+  gint64 slow_flush = (AUTOSCALE_FLUSH_LATENCY_THRESHOLD + 1) * 1000;
+
+  /* a faster flush after a slow one does not hide the slow one */
+  _record_flush_latency(worker, slow_flush);
+  _record_flush_latency(worker, 1000);
+  cr_assert_eq(_take_flush_latency(worker), AUTOSCALE_FLUSH_LATENCY_THRESHOLD + 1);
+
+  /* the slow flush is not reported again on the next check */
+  cr_assert_eq(_take_flush_latency(worker), 0);
+
+  _free_driver(self);
+}
+
+Test(worker_routing, autoscaling_keeps_the_workers_while_the_load_is_moderate)
+{
+  LogThreadedDestDriver *self = _create_driver(1, TEST_MAX_WORKERS);
+
+  _check_load(self, OVERLOADED_QUEUE_LENGTH(1), 0);
+  cr_assert_eq(self->autoscale.active_workers, 2);
+
+  /* at the threshold, but not above it */
+  for (gint i = 0; i < 2 * AUTOSCALE_IDLE_ROUNDS; i++)
+    {
+      _check_load(self, OVERLOADED_QUEUE_LENGTH(2) - 2, 0);
+      cr_assert_eq(self->autoscale.active_workers, 2);
+    }
+
+  _free_driver(self);
+}
+
+Test(worker_routing, autoscaling_retires_a_worker_only_after_consecutive_idle_checks)
+{
+  LogThreadedDestDriver *self = _create_driver(1, TEST_MAX_WORKERS);
+
+  self->autoscale.active_workers = 3;
+  for (gint i = 0; i < AUTOSCALE_IDLE_ROUNDS - 1; i++)
+    _check_load(self, 0, 0);
+  cr_assert_eq(self->autoscale.active_workers, 3);
+
+  /* a single busy check restarts the count */
+  _check_load(self, 1, 0);
+  for (gint i = 0; i < AUTOSCALE_IDLE_ROUNDS - 1; i++)
+    _check_load(self, 0, 0);
+  cr_assert_eq(self->autoscale.active_workers, 3);
+
+  _check_load(self, 0, 0);
+  cr_assert_eq(self->autoscale.active_workers, 2);
+
+  /* the count restarts after a change too */
+  for (gint i = 0; i < AUTOSCALE_IDLE_ROUNDS - 1; i++)
+    _check_load(self, 0, 0);
+  cr_assert_eq(self->autoscale.active_workers, 2);
+  _check_load(self, 0, 0);
+  cr_assert_eq(self->autoscale.active_workers, 1);
+
+  for (gint i = 0; i < 2 * AUTOSCALE_IDLE_ROUNDS; i++)
+    _check_load(self, 0, 0);
+  cr_assert_eq(self->autoscale.active_workers, 1, "the minimum should be kept");
+
+  _free_driver(self);
+}
+
+Test(worker_routing, autoscaling_does_not_retire_a_worker_right_after_adding_it)
+{
+  LogThreadedDestDriver *self = _create_driver(1, TEST_MAX_WORKERS);
+
+  for (gint i = 0; i < AUTOSCALE_IDLE_ROUNDS - 1; i++)
+    _check_load(self, 0, 0);
+
+  /* a burst */
+  _check_load(self, OVERLOADED_QUEUE_LENGTH(1), 0);
+  cr_assert_eq(self->autoscale.active_workers, 2);
+
+  _check_load(self, 0, 0);
+  cr_assert_eq(self->autoscale.active_workers, 2);
+
+  _free_driver(self);
+}
+
+Test(worker_routing, round_robin_only_uses_the_active_workers)
+{
+  LogThreadedDestDriver *self = _create_driver(2, TEST_MAX_WORKERS);
+
+  for (gint i = 0; i < 4; i++)
+    cr_assert_eq(_lookup_worker(self, NULL)->worker_index, i % 2);
+
+  self->autoscale.active_workers = 3;
+  for (gint i = 0; i < 6; i++)
+    cr_assert_eq(_lookup_worker(self, NULL)->worker_index, i % 3);
+
+  /* a retired worker is skipped even if it would be the next one */
+  _lookup_worker(self, NULL);
+  _lookup_worker(self, NULL);
+  self->autoscale.active_workers = 2;
+  cr_assert_eq(_lookup_worker(self, NULL)->worker_index, 0);
+
+  _free_driver(self);
+}
+
+Test(worker_routing, jump_hash_matches_the_reference_vectors)
+{
+  cr_assert_eq(_jump_consistent_hash(1, 1), 0);
+  cr_assert_eq(_jump_consistent_hash(42, 57), 43);
+  cr_assert_eq(_jump_consistent_hash(0xDEAD10CC, 1), 0);
+  cr_assert_eq(_jump_consistent_hash(0xDEAD10CC, 666), 361);
+  cr_assert_eq(_jump_consistent_hash(256, 1024), 520);
+}
+
+Test(worker_routing, jump_hash_only_moves_keys_to_the_new_worker_when_a_worker_is_added)
+{
+  const gint num_keys = 10000;
+
+  for (gint num_workers = 1; num_workers < 16; num_workers++)
+    {
+      gint moved = 0;
+
+      for (gint i = 0; i < num_keys; i++)
+        {
+          gchar key[32];
+
+          g_snprintf(key, sizeof(key), "key-%d", i);
+          guint hash = g_str_hash(key);
+          gint before = _jump_consistent_hash(hash, num_workers);
+          gint after = _jump_consistent_hash(hash, num_workers + 1);
+
+          cr_assert(before >= 0 && before < num_workers);
+          if (before != after)
+            {
+              cr_assert_eq(after, num_workers, "a key may only move to the new worker, key: %s", key);
+              moved++;
+            }
+        }
+
+      /* the expected share of moved keys is 1/(N+1) */
+      gint expected = num_keys / (num_workers + 1);
+      cr_assert(moved > expected * 8 / 10 && moved < expected * 12 / 10,
+                "unexpected number of moved keys, workers: %d, moved: %d, expected: %d",
+                num_workers, moved, expected);
+    }
+}
+
+static void
+_record_window(LogThreadedDestDriver *self, const gchar *hot_key, gint hot_key_share)
+{
+  for (gint i = 0; i < HOT_KEY_SAMPLE_WINDOW; i++)
+    {
+      gchar key[32];
+
+      if (i * 100 < hot_key_share * HOT_KEY_SAMPLE_WINDOW)
+        g_strlcpy(key, hot_key, sizeof(key));
+      else
+        g_snprintf(key, sizeof(key), "key-%d", i);
+      _record_hot_key_sample(self, key);
+    }
+}
+
+Test(worker_routing, hot_key_is_detected_once_its_share_reaches_the_threshold)
+{
+  LogThreadedDestDriver *self = _create_driver(TEST_MAX_WORKERS, TEST_MAX_WORKERS);
+  _enable_hot_key_detection(self, 50, FALSE);
+
+  _record_window(self, "cold", 40);
+  cr_assert_not(self->hot_key.detected);
+  cr_assert_eq(self->hot_key.num_samples, 0, "samples should be reset after each window");
+
+  for (gint i = 0; i < HOT_KEY_SAMPLE_WINDOW - 1; i++)
+    _record_hot_key_sample(self, "hot");
+  cr_assert_not(self->hot_key.detected, "the key should only be evaluated at the end of the window");
+
+  _record_hot_key_sample(self, "hot");
+  cr_assert(self->hot_key.detected);
+  cr_assert_eq((guint) self->hot_key.hash, g_str_hash("hot"));
+
+  _free_driver(self);
+}
+
+Test(worker_routing, hot_key_detection_is_cleared_once_the_key_cools_down)
+{
+  LogThreadedDestDriver *self = _create_driver(TEST_MAX_WORKERS, TEST_MAX_WORKERS);
+  _enable_hot_key_detection(self, 50, FALSE);
+
+  _record_window(self, "hot", 60);
+  cr_assert(self->hot_key.detected);
+
+  _record_window(self, "other-hot", 70);
+  cr_assert(self->hot_key.detected);
+  cr_assert_eq((guint) self->hot_key.hash, g_str_hash("other-hot"));
+
+  _record_window(self, "hot", 10);
+  cr_assert_not(self->hot_key.detected);
+  cr_assert_eq(self->hot_key.hash, 0);
+
+  _free_driver(self);
+}
+
+Test(worker_routing, only_the_detected_hot_key_is_spread_and_only_with_hot_key_spread)
+{
+  LogThreadedDestDriver *self = _create_driver(TEST_MAX_WORKERS, TEST_MAX_WORKERS);
+  _enable_hot_key_detection(self, 50, FALSE);
+
+  _record_window(self, "hot", 60);
+  cr_assert(self->hot_key.detected);
+  cr_assert_not(_is_spread_hot_key(self, g_str_hash("hot")), "hot keys are only spread with hot-key-spread(yes)");
+
+  self->hot_key.spread = TRUE;
+  cr_assert(_is_spread_hot_key(self, g_str_hash("hot")));
+  cr_assert_not(_is_spread_hot_key(self, g_str_hash("key-1000")));
+
+  _free_driver(self);
+}
+
+static void
+setup(void)
+{
+  app_startup();
+}
+
+static void
+teardown(void)
+{
+  app_shutdown();
+}
+
+TestSuite(worker_routing, .init = setup, .fini = teardown);
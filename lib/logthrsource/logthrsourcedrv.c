@@ -124,20 +124,17 @@ log_threaded_source_worker_options_destroy(LogThreadedSourceWorkerOptions *optio
 
 /* The wakeup lock must be held before calling this function. */
 static void
-log_threaded_source_suspend(LogThreadedSourceDriver *self)
+log_threaded_source_suspend(LogThreadedSourceWorker *self)
 {
-  LogThreadedSourceWorker *worker = self->worker;
-
-  while (!log_threaded_source_free_to_send(self) && !worker->under_termination)
-    wakeup_cond_wait(&worker->wakeup_cond);
+  while (!log_threaded_source_worker_free_to_send(self) && !self->under_termination)
+    wakeup_cond_wait(&self->wakeup_cond);
 }
 
 static void
 log_threaded_source_wakeup(LogThreadedSourceDriver *self)
 {
-  LogThreadedSourceWorker *worker = self->worker;
-
-  wakeup_cond_signal(&worker->wakeup_cond);
+  for (gint i = 0; i < self->num_workers; i++)
+    wakeup_cond_signal(&self->workers[i]->wakeup_cond);
 }
 
 static gboolean
@@ -165,12 +162,17 @@ log_threaded_source_worker_run(MainLoopThreadedWorker *s)
   LogThreadedSourceWorker *self = (LogThreadedSourceWorker *) s->data;
 
   msg_debug("Worker thread started",
-            evt_tag_str("driver", self->control->super.super.id));
+            evt_tag_str("driver", self->control->super.super.id),
+            evt_tag_int("worker_index", self->worker_index));
 
-  self->control->run(self->control);
+  if (self->control->run_worker)
+    self->control->run_worker(self->control, self);
+  else
+    self->control->run(self->control);
 
   msg_debug("Worker thread finished",
-            evt_tag_str("driver", self->control->super.super.id));
+            evt_tag_str("driver", self->control->super.super.id),
+            evt_tag_int("worker_index", self->worker_index));
 }
 
 static void
@@ -179,10 +181,14 @@ log_threaded_source_worker_request_exit(MainLoopThreadedWorker *s)
   LogThreadedSourceWorker *self = (LogThreadedSourceWorker *) s->data;
 
   msg_debug("Requesting worker thread exit",
-            evt_tag_str("driver", self->control->super.super.id));
+            evt_tag_str("driver", self->control->super.super.id),
+            evt_tag_int("worker_index", self->worker_index));
   self->under_termination = TRUE;
-  self->control->request_exit(self->control);
-  log_threaded_source_wakeup(self->control);
+  if (self->control->request_worker_exit)
+    self->control->request_worker_exit(self->control, self);
+  else
+    self->control->request_exit(self->control);
+  wakeup_cond_signal(&self->wakeup_cond);
 }
 
 static void
@@ -217,10 +223,11 @@ log_threaded_source_worker_free(LogPipe *s)
 }
 
 static LogThreadedSourceWorker *
-log_threaded_source_worker_new(GlobalConfig *cfg)
+log_threaded_source_worker_new(GlobalConfig *cfg, gint worker_index)
 {
   LogThreadedSourceWorker *self = g_new0(LogThreadedSourceWorker, 1);
   log_source_init_instance(&self->super, cfg);
+  self->worker_index = worker_index;
   main_loop_threaded_worker_init(&self->thread, MLW_THREADED_INPUT_WORKER, self);
   self->thread.thread_init = log_threaded_source_worker_thread_init;
   self->thread.thread_deinit = log_threaded_source_worker_thread_deinit;
@@ -239,36 +246,72 @@ log_threaded_source_worker_new(GlobalConfig *cfg)
 gboolean
 log_threaded_source_driver_pre_config_init(LogPipe *s)
 {
-  main_loop_worker_allocate_thread_space(1);
+  LogThreadedSourceDriver *self = (LogThreadedSourceDriver *) s;
+
+  main_loop_worker_allocate_thread_space(self->num_workers);
   return TRUE;
 }
 
+static void
+_destroy_workers(LogThreadedSourceDriver *self, gint num_initialized)
+{
+  for (gint i = 0; i < self->num_workers; i++)
+    {
+      LogPipe *worker_pipe = log_threaded_source_worker_logpipe(self->workers[i]);
+
+      if (i < num_initialized)
+        log_pipe_deinit(worker_pipe);
+      log_pipe_unref(worker_pipe);
+    }
+
+  g_free(self->workers);
+  self->workers = NULL;
+  self->worker = NULL;
+}
+
+static gboolean
+_init_worker(LogThreadedSourceDriver *self, LogThreadedSourceWorker *worker)
+{
+  /* LogSource takes ownership of the key builder, each worker needs its own */
+  StatsClusterKeyBuilder *kb = stats_cluster_key_builder_new();
+  self->format_stats_key(self, kb);
+  log_threaded_source_worker_set_options(worker, self, &self->worker_options, self->super.super.id, kb);
+
+  LogPipe *worker_pipe = log_threaded_source_worker_logpipe(worker);
+  log_pipe_append(worker_pipe, &self->super.super.super);
+  return log_pipe_init(worker_pipe);
+}
+
 gboolean
 log_threaded_source_driver_init_method(LogPipe *s)
 {
   LogThreadedSourceDriver *self = (LogThreadedSourceDriver *) s;
   GlobalConfig *cfg = log_pipe_get_config(s);
 
-  self->worker = log_threaded_source_worker_new(cfg);
+  g_assert(self->num_workers == 1 || (self->run_worker && self->request_worker_exit));
+
+  self->workers = g_new0(LogThreadedSourceWorker *, self->num_workers);
+  for (gint i = 0; i < self->num_workers; i++)
+    self->workers[i] = log_threaded_source_worker_new(cfg, i);
+  self->worker = self->workers[0];
 
   if (!log_src_driver_init_method(s))
-    return FALSE;
+    {
+      _destroy_workers(self, 0);
+      return FALSE;
+    }
 
   g_assert(self->format_stats_key);
 
-  StatsClusterKeyBuilder *kb = stats_cluster_key_builder_new();
-  self->format_stats_key(self, kb);
   log_threaded_source_worker_options_init(&self->worker_options, cfg, self->super.super.group);
-  log_threaded_source_worker_set_options(self->worker, self, &self->worker_options,
-                                         self->super.super.id, kb);
 
-  LogPipe *worker_pipe = log_threaded_source_worker_logpipe(self->worker);
-  log_pipe_append(worker_pipe, s);
-  if (!log_pipe_init(worker_pipe))
+  for (gint i = 0; i < self->num_workers; i++)
     {
-      log_pipe_unref(worker_pipe);
-      self->worker = NULL;
-      return FALSE;
+      if (!_init_worker(self, self->workers[i]))
+        {
+          _destroy_workers(self, i);
+          return FALSE;
+        }
     }
 
   return TRUE;
@@ -278,10 +321,8 @@ gboolean
 log_threaded_source_driver_deinit_method(LogPipe *s)
 {
   LogThreadedSourceDriver *self = (LogThreadedSourceDriver *) s;
-  LogPipe *worker_pipe = log_threaded_source_worker_logpipe(self->worker);
 
-  log_pipe_deinit(worker_pipe);
-  log_pipe_unref(worker_pipe);
+  _destroy_workers(self, self->num_workers);
 
   return log_src_driver_deinit_method(s);
 }
@@ -296,12 +337,21 @@ log_threaded_source_driver_free_method(LogPipe *s)
   log_src_driver_free(s);
 }
 
+void
+log_threaded_source_driver_set_num_workers(LogDriver *s, gint num_workers)
+{
+  LogThreadedSourceDriver *self = (LogThreadedSourceDriver *) s;
+
+  self->num_workers = num_workers;
+}
+
 gboolean
 log_threaded_source_driver_start_worker(LogPipe *s)
 {
   LogThreadedSourceDriver *self = (LogThreadedSourceDriver *) s;
 
-  main_loop_threaded_worker_start(&self->worker->thread);
+  for (gint i = 0; i < self->num_workers; i++)
+    main_loop_threaded_worker_start(&self->workers[i]->thread);
 
   return TRUE;
 }
@@ -341,32 +391,34 @@ log_threaded_source_close_batch(LogThreadedSourceDriver *self)
   main_loop_worker_invoke_batch_callbacks();
 }
 
-void
-log_threaded_source_post(LogThreadedSourceDriver *self, LogMessage *msg)
+static void
+_post_message(LogThreadedSourceWorker *self, LogMessage *msg)
 {
   msg_debug("Incoming log message",
             evt_tag_str("input", log_msg_get_value(msg, LM_V_MESSAGE, NULL)),
             evt_tag_msg_reference(msg));
-  _apply_default_priority_and_facility(self, msg);
-  log_source_post(&self->worker->super, msg);
+  _apply_default_priority_and_facility(self->control, msg);
+  log_source_post(&self->super, msg);
+}
 
-  if (self->auto_close_batches)
-    log_threaded_source_close_batch(self);
+void
+log_threaded_source_worker_post(LogThreadedSourceWorker *self, LogMessage *msg)
+{
+  _post_message(self, msg);
+
+  if (self->control->auto_close_batches)
+    log_threaded_source_close_batch(self->control);
 }
 
 gboolean
-log_threaded_source_free_to_send(LogThreadedSourceDriver *self)
+log_threaded_source_worker_free_to_send(LogThreadedSourceWorker *self)
 {
-  return log_source_free_to_send(&self->worker->super);
+  return log_source_free_to_send(&self->super);
 }
 
-void
-log_threaded_source_blocking_post(LogThreadedSourceDriver *self, LogMessage *msg)
+static void
+_suspend_if_window_is_full(LogThreadedSourceWorker *self)
 {
-  LogThreadedSourceWorker *worker = self->worker;
-
-  log_threaded_source_post(self, msg);
-
   /*
    * The wakeup lock must be held before calling free_to_send() and suspend(),
    * otherwise g_cond_signal() might be called between free_to_send() and
@@ -377,10 +429,85 @@ log_threaded_source_blocking_post(LogThreadedSourceDriver *self, LogMessage *msg
    * "schedule_wakeup" event are guaranteed to be scheduled in the right order.
    */
 
-  wakeup_cond_lock(&worker->wakeup_cond);
-  if (!log_threaded_source_free_to_send(self))
+  wakeup_cond_lock(&self->wakeup_cond);
+  if (!log_threaded_source_worker_free_to_send(self))
     log_threaded_source_suspend(self);
-  wakeup_cond_unlock(&worker->wakeup_cond);
+  wakeup_cond_unlock(&self->wakeup_cond);
+}
+
+void
+log_threaded_source_worker_blocking_post(LogThreadedSourceWorker *self, LogMessage *msg)
+{
+  log_threaded_source_worker_post(self, msg);
+  _suspend_if_window_is_full(self);
+}
+
+/* Posts all messages, waiting for free space in the window as needed.  The
+ * batch is only closed once at the end, unless we have to wait for the
+ * window, as the messages posted so far have to be delivered for that. */
+void
+log_threaded_source_worker_blocking_post_batch(LogThreadedSourceWorker *self, LogMessage **msgs, gsize len)
+{
+  for (gsize i = 0; i < len; i++)
+    {
+      _post_message(self, msgs[i]);
+
+      if (!log_threaded_source_worker_free_to_send(self))
+        {
+          if (self->control->auto_close_batches)
+            log_threaded_source_close_batch(self->control);
+          _suspend_if_window_is_full(self);
+        }
+    }
+
+  if (self->control->auto_close_batches)
+    log_threaded_source_close_batch(self->control);
+}
+
+/* Posts messages while there is free space in the window, returns the
+ * number of messages posted, the rest is left to the caller. */
+gsize
+log_threaded_source_worker_post_batch(LogThreadedSourceWorker *self, LogMessage **msgs, gsize len)
+{
+  gsize posted = 0;
+
+  while (posted < len && log_threaded_source_worker_free_to_send(self))
+    _post_message(self, msgs[posted++]);
+
+  if (posted > 0 && self->control->auto_close_batches)
+    log_threaded_source_close_batch(self->control);
+
+  return posted;
+}
+
+void
+log_threaded_source_post(LogThreadedSourceDriver *self, LogMessage *msg)
+{
+  log_threaded_source_worker_post(self->worker, msg);
+}
+
+gboolean
+log_threaded_source_free_to_send(LogThreadedSourceDriver *self)
+{
+  return log_threaded_source_worker_free_to_send(self->worker);
+}
+
+void
+log_threaded_source_blocking_post(LogThreadedSourceDriver *self, LogMessage *msg)
+{
+  log_threaded_source_worker_blocking_post(self->worker, msg);
+}
+
+void
+log_threaded_source_blocking_post_batch(LogThreadedSourceDriver *self, LogMessage **msgs, gsize len)
+{
+  log_threaded_source_worker_blocking_post_batch(self->worker, msgs, len);
+}
+
+gsize
+log_threaded_source_post_batch(LogThreadedSourceDriver *self, LogMessage **msgs, gsize len)
+{
+  return log_threaded_source_worker_post_batch(self->worker, msgs, len);
 }
 
 void
@@ -398,5 +525,6 @@ log_threaded_source_driver_init_instance(LogThreadedSourceDriver *self, GlobalCo
 
   self->wakeup = log_threaded_source_wakeup;
 
+  self->num_workers = 1;
   self->auto_close_batches = TRUE;
 }
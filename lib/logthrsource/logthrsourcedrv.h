@@ -59,13 +59,17 @@ struct _LogThreadedSourceWorker
   LogThreadedSourceDriver *control;
   WakeupCondition wakeup_cond;
   gboolean under_termination;
+  gint worker_index;
 };
 
 struct _LogThreadedSourceDriver
 {
   LogSrcDriver super;
   LogThreadedSourceWorkerOptions worker_options;
+  /* the first worker, kept for drivers that only ever run a single one */
   LogThreadedSourceWorker *worker;
+  LogThreadedSourceWorker **workers;
+  gint num_workers;
   gboolean auto_close_batches;
 
   void (*format_stats_key)(LogThreadedSourceDriver *self, StatsClusterKeyBuilder *kb);
@@ -74,6 +78,10 @@ struct _LogThreadedSourceDriver
   void (*run)(LogThreadedSourceDriver *self);
   void (*request_exit)(LogThreadedSourceDriver *self);
   void (*wakeup)(LogThreadedSourceDriver *self);
+
+  /* mandatory for drivers running more than one worker, used instead of run() and request_exit() */
+  void (*run_worker)(LogThreadedSourceDriver *self, LogThreadedSourceWorker *worker);
+  void (*request_worker_exit)(LogThreadedSourceDriver *self, LogThreadedSourceWorker *worker);
 };
 
 void log_threaded_source_worker_options_defaults(LogThreadedSourceWorkerOptions *options);
@@ -85,6 +93,7 @@ void log_threaded_source_driver_init_instance(LogThreadedSourceDriver *self, Glo
 gboolean log_threaded_source_driver_init_method(LogPipe *s);
 gboolean log_threaded_source_driver_deinit_method(LogPipe *s);
 void log_threaded_source_driver_free_method(LogPipe *s);
+void log_threaded_source_driver_set_num_workers(LogDriver *s, gint num_workers);
 
 static inline LogSourceOptions *
 log_threaded_source_driver_get_source_options(LogDriver *s)
@@ -106,9 +115,18 @@ void log_threaded_source_close_batch(LogThreadedSourceDriver *self);
 
 /* blocking API */
 void log_threaded_source_blocking_post(LogThreadedSourceDriver *self, LogMessage *msg);
+void log_threaded_source_blocking_post_batch(LogThreadedSourceDriver *self, LogMessage **msgs, gsize len);
 
 /* non-blocking API, use it wisely (thread boundaries) */
 void log_threaded_source_post(LogThreadedSourceDriver *self, LogMessage *msg);
+gsize log_threaded_source_post_batch(LogThreadedSourceDriver *self, LogMessage **msgs, gsize len);
 gboolean log_threaded_source_free_to_send(LogThreadedSourceDriver *self);
 
+/* per-worker variants of the above, for drivers running more than one worker */
+void log_threaded_source_worker_blocking_post(LogThreadedSourceWorker *self, LogMessage *msg);
+void log_threaded_source_worker_blocking_post_batch(LogThreadedSourceWorker *self, LogMessage **msgs, gsize len);
+void log_threaded_source_worker_post(LogThreadedSourceWorker *self, LogMessage *msg);
+gsize log_threaded_source_worker_post_batch(LogThreadedSourceWorker *self, LogMessage **msgs, gsize len);
+gboolean log_threaded_source_worker_free_to_send(LogThreadedSourceWorker *self);
+
 #endif
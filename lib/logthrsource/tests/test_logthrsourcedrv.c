@@ -39,6 +39,7 @@ typedef struct _TestThreadedSourceDriver
   gint num_of_messages_to_generate;
   gboolean suspended;
   gboolean exit_requested;
+  gint worker_exit_requests;
 } TestThreadedSourceDriver;
 
 MainLoopOptions main_loop_options = {0};
@@ -85,7 +86,8 @@ test_threaded_source_driver_init_method(LogPipe *s)
     return FALSE;
 
   /* mock out the hard-coded DNS lookup calls inside log_source_queue() */
-  _get_source(self)->super.queue = _source_queue_mock;
+  for (gint i = 0; i < self->super.num_workers; i++)
+    ((LogSource *) self->super.workers[i])->super.queue = _source_queue_mock;
 
   return TRUE;
 }
@@ -188,6 +190,36 @@ _run_simple(LogThreadedSourceDriver *s)
     }
 }
 
+static void
+_run_using_blocking_batch_posts(LogThreadedSourceDriver *s)
+{
+  TestThreadedSourceDriver *self = (TestThreadedSourceDriver *) s;
+  LogMessage **msgs = g_new(LogMessage *, self->num_of_messages_to_generate);
+
+  for (gint i = 0; i < self->num_of_messages_to_generate; ++i)
+    msgs[i] = create_sample_message();
+
+  log_threaded_source_blocking_post_batch(&self->super, msgs, self->num_of_messages_to_generate);
+  g_free(msgs);
+}
+
+static void
+_run_using_batch_posts(LogThreadedSourceDriver *s)
+{
+  TestThreadedSourceDriver *self = (TestThreadedSourceDriver *) s;
+  LogMessage **msgs = g_new(LogMessage *, self->num_of_messages_to_generate);
+
+  for (gint i = 0; i < self->num_of_messages_to_generate; ++i)
+    msgs[i] = create_sample_message();
+
+  gsize posted = log_threaded_source_post_batch(&self->super, msgs, self->num_of_messages_to_generate);
+  self->suspended = !log_threaded_source_free_to_send(&self->super);
+
+  for (gint i = posted; i < self->num_of_messages_to_generate; ++i)
+    log_msg_unref(msgs[i]);
+  g_free(msgs);
+}
+
 static void
 _request_exit(LogThreadedSourceDriver *s)
 {
@@ -195,6 +227,25 @@ _request_exit(LogThreadedSourceDriver *s)
   self->exit_requested = TRUE;
 }
 
+static void
+_run_worker_using_blocking_posts(LogThreadedSourceDriver *s, LogThreadedSourceWorker *worker)
+{
+  TestThreadedSourceDriver *self = (TestThreadedSourceDriver *) s;
+
+  for (gint i = 0; i < self->num_of_messages_to_generate; ++i)
+    {
+      LogMessage *msg = create_sample_message();
+      log_threaded_source_worker_blocking_post(worker, msg);
+    }
+}
+
+static void
+_request_worker_exit(LogThreadedSourceDriver *s, LogThreadedSourceWorker *worker)
+{
+  TestThreadedSourceDriver *self = (TestThreadedSourceDriver *) s;
+  g_atomic_int_inc(&self->worker_exit_requests);
+}
+
 static void
 _do_not_ack_messages(LogPipe *s, LogMessage *msg, const LogPathOptions *path_options)
 {
@@ -237,3 +288,61 @@ Test(logthrsourcedrv, test_threaded_source_suspend)
 
   destroy_test_threaded_source(s);
 }
+
+Test(logthrsourcedrv, test_threaded_source_blocking_post_batch)
+{
+  TestThreadedSourceDriver *s = create_threaded_source_blocking();
+
+  s->num_of_messages_to_generate = 10;
+  s->super.run = _run_using_blocking_batch_posts;
+
+  start_test_threaded_source(s);
+  request_exit_and_wait_for_stop(s);
+
+  StatsCounterItem *recvd_messages = _get_source(s)->metrics.recvd_messages;
+  cr_assert_eq(stats_counter_get(recvd_messages), 10);
+  cr_assert(s->exit_requested);
+
+  destroy_test_threaded_source(s);
+}
+
+Test(logthrsourcedrv, test_threaded_source_post_batch_stops_at_full_window)
+{
+  TestThreadedSourceDriver *s = create_threaded_source();
+
+  s->num_of_messages_to_generate = 8;
+  s->super.run = _run_using_batch_posts;
+  s->super.worker_options.super.init_window_size = 5;
+  s->super.super.super.super.queue = _do_not_ack_messages;
+
+  start_test_threaded_source(s);
+  request_exit_and_wait_for_stop(s);
+
+  StatsCounterItem *recvd_messages = _get_source(s)->metrics.recvd_messages;
+  cr_assert_eq(stats_counter_get(recvd_messages), 5);
+  cr_assert(s->suspended);
+  cr_assert(s->exit_requested);
+
+  destroy_test_threaded_source(s);
+}
+
+Test(logthrsourcedrv, test_threaded_source_multiple_workers)
+{
+  TestThreadedSourceDriver *s = create_threaded_source();
+
+  s->num_of_messages_to_generate = 10;
+  s->super.run_worker = _run_worker_using_blocking_posts;
+  s->super.request_worker_exit = _request_worker_exit;
+  log_threaded_source_driver_set_num_workers(&s->super.super.super, 4);
+
+  cr_assert(log_pipe_pre_config_init(&s->super.super.super.super));
+  start_test_threaded_source(s);
+  request_exit_and_wait_for_stop(s);
+
+  StatsCounterItem *recvd_messages = _get_source(s)->metrics.recvd_messages;
+  cr_assert_eq(stats_counter_get(recvd_messages), 40);
+  cr_assert_eq(s->worker_exit_requests, 4);
+  cr_assert_not(s->exit_requested);
+
+  destroy_test_threaded_source(s);
+}
@@ -0,0 +1,178 @@
+/*
+ * Copyright (c) 2024 One Identity LLC.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#include "logwriter-format-cache.h"
+#include "logmsg/logmsg-cache.h"
+#include "stats/stats-registry.h"
+#include "stats/stats-cluster-single.h"
+#include "apphook.h"
+
+#include <string.h>
+
+/*
+ * Per-message cache of formatted lines
+ *
+ * Destinations with flags(format-cache) store the line generated by the
+ * builtin RFC3164/RFC5424/file formats in a small side table of the
+ * LogMessage, so that writers with identical format options (e.g. the
+ * same message relayed to several syslog servers) share a single
+ * rendering.  The table is keyed by the parts of LogWriterOptions that
+ * influence the output, writer specific post-processing (truncate-size()
+ * and its counters) is applied by each LogWriter on its own.
+ *
+ * Just like template-cache(yes), this only covers write protected
+ * messages, see logmsg/logmsg-cache.c.
+ */
+
+static StatsCounterItem *stats_format_cache_hits;
+static StatsCounterItem *stats_format_cache_misses;
+
+void
+log_writer_format_cache_key_init(LogWriterFormatCacheKey *key, guint32 flags, guint32 options, gint padding,
+                                 const LogTemplateOptions *template_options, gint32 seq_num)
+{
+  key->flags = flags;
+  key->options = options;
+  key->padding = padding;
+  key->seq_num = seq_num;
+  key->ts_format = template_options->ts_format;
+  key->frac_digits = template_options->frac_digits;
+  key->time_zone = template_options->time_zone[LTZ_SEND];
+
+  guint hash = flags;
+  hash = hash * 31 + options;
+  hash = hash * 31 + padding;
+  hash = hash * 31 + seq_num;
+  hash = hash * 31 + key->ts_format;
+  hash = hash * 31 + key->frac_digits;
+  if (key->time_zone)
+    hash = hash * 31 + g_str_hash(key->time_zone);
+  key->hash = hash;
+}
+
+static gboolean
+_key_equal(gconstpointer k1, gconstpointer k2)
+{
+  const LogWriterFormatCacheKey *a = (const LogWriterFormatCacheKey *) k1;
+  const LogWriterFormatCacheKey *b = (const LogWriterFormatCacheKey *) k2;
+
+  return a->hash == b->hash &&
+         a->flags == b->flags &&
+         a->options == b->options &&
+         a->padding == b->padding &&
+         a->seq_num == b->seq_num &&
+         a->ts_format == b->ts_format &&
+         a->frac_digits == b->frac_digits &&
+         g_strcmp0(a->time_zone, b->time_zone) == 0;
+}
+
+static gpointer
+_key_dup(gconstpointer k)
+{
+  const LogWriterFormatCacheKey *source = (const LogWriterFormatCacheKey *) k;
+  LogWriterFormatCacheKey *dest = g_new(LogWriterFormatCacheKey, 1);
+
+  *dest = *source;
+  dest->time_zone = g_strdup(source->time_zone);
+  return dest;
+}
+
+static void
+_key_free(gpointer k)
+{
+  LogWriterFormatCacheKey *key = (LogWriterFormatCacheKey *) k;
+
+  g_free(key->time_zone);
+  g_free(key);
+}
+
+static const LogMessageCacheKeyClass log_writer_format_cache_key_class =
+{
+  .equal = _key_equal,
+  .dup = _key_dup,
+  .free = _key_free,
+};
+
+gboolean
+log_writer_format_cache_lookup(LogMessage *msg, const LogWriterFormatCacheKey *key, GString *result)
+{
+  if (log_msg_cache_lookup(&msg->format_cache, key, result, NULL))
+    {
+      stats_counter_inc(stats_format_cache_hits);
+      return TRUE;
+    }
+
+  stats_counter_inc(stats_format_cache_misses);
+  return FALSE;
+}
+
+void
+log_writer_format_cache_store(LogMessage *msg, const LogWriterFormatCacheKey *key,
+                              const gchar *value, gsize value_len)
+{
+  g_assert(log_msg_is_write_protected(msg));
+
+  log_msg_cache_store(&msg->format_cache, &log_writer_format_cache_key_class, key, value, value_len, LM_VT_STRING);
+}
+
+static void
+_register_stats(void)
+{
+  StatsClusterKey sc_key;
+
+  stats_lock();
+  stats_cluster_single_key_set(&sc_key, "format_cache_hits_total", NULL, 0);
+  stats_cluster_single_key_add_legacy_alias_with_name(&sc_key, SCS_GLOBAL, "format_cache", NULL, "hits");
+  stats_register_counter(0, &sc_key, SC_TYPE_SINGLE_VALUE, &stats_format_cache_hits);
+  stats_cluster_single_key_set(&sc_key, "format_cache_misses_total", NULL, 0);
+  stats_cluster_single_key_add_legacy_alias_with_name(&sc_key, SCS_GLOBAL, "format_cache", NULL, "misses");
+  stats_register_counter(0, &sc_key, SC_TYPE_SINGLE_VALUE, &stats_format_cache_misses);
+  stats_unlock();
+}
+
+static void
+_unregister_stats(void)
+{
+  StatsClusterKey sc_key;
+
+  stats_lock();
+  stats_cluster_single_key_set(&sc_key, "format_cache_hits_total", NULL, 0);
+  stats_cluster_single_key_add_legacy_alias_with_name(&sc_key, SCS_GLOBAL, "format_cache", NULL, "hits");
+  stats_unregister_counter(&sc_key, SC_TYPE_SINGLE_VALUE, &stats_format_cache_hits);
+  stats_cluster_single_key_set(&sc_key, "format_cache_misses_total", NULL, 0);
+  stats_cluster_single_key_add_legacy_alias_with_name(&sc_key, SCS_GLOBAL, "format_cache", NULL, "misses");
+  stats_unregister_counter(&sc_key, SC_TYPE_SINGLE_VALUE, &stats_format_cache_misses);
+  stats_unlock();
+}
+
+void
+log_writer_format_cache_global_init(void)
+{
+  register_application_hook(AH_RUNNING, (ApplicationHookFunc) _register_stats, NULL, AHM_RUN_ONCE);
+}
+
+void
+log_writer_format_cache_global_deinit(void)
+{
+  _unregister_stats();
+}
@@ -0,0 +1,55 @@
+/*
+ * Copyright (c) 2024 One Identity LLC.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#ifndef LOGWRITER_FORMAT_CACHE_H_INCLUDED
+#define LOGWRITER_FORMAT_CACHE_H_INCLUDED
+
+#include "logmsg/logmsg.h"
+#include "template/templates.h"
+
+/* number of formatted lines a single LogMessage can hold */
+/* everything that influences the builtin output formats of LogWriter */
+typedef struct _LogWriterFormatCacheKey
+{
+  guint hash;
+  /* LW_* and LWO_* bits that select the format */
+  guint32 flags;
+  guint32 options;
+  gint padding;
+  gint32 seq_num;
+  gint ts_format;
+  gint frac_digits;
+  gchar *time_zone;
+} LogWriterFormatCacheKey;
+
+void log_writer_format_cache_key_init(LogWriterFormatCacheKey *key, guint32 flags, guint32 options, gint padding,
+                                      const LogTemplateOptions *template_options, gint32 seq_num);
+
+gboolean log_writer_format_cache_lookup(LogMessage *msg, const LogWriterFormatCacheKey *key, GString *result);
+void log_writer_format_cache_store(LogMessage *msg, const LogWriterFormatCacheKey *key,
+                                   const gchar *value, gsize value_len);
+
+void log_writer_format_cache_global_init(void);
+void log_writer_format_cache_global_deinit(void);
+
+#endif
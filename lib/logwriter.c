@@ -23,6 +23,7 @@
  */
 
 #include "logwriter.h"
+#include "logwriter-format-cache.h"
 #include "messages.h"
 #include "stats/stats-registry.h"
 #include "stats/aggregator/stats-aggregator-registry.h"
@@ -62,6 +63,9 @@ typedef enum
   LW_FLUSH_FORCE,
 } LogWriterFlushMode;
 
+/* number of messages fetched from the queue at once while flushing */
+#define LOG_WRITER_POP_BATCH_SIZE 64
+
 struct _LogWriter
 {
   LogPipe super;
@@ -105,6 +109,17 @@ struct _LogWriter
   time_t last_delay_update;
   GString *line_buffer;
 
+  /* messages popped from the queue (and thus on its backlog), but not yet
+   * processed by log_writer_flush() */
+  struct
+  {
+    LogMessage *msgs[LOG_WRITER_POP_BATCH_SIZE];
+    LogPathOptions path_options[LOG_WRITER_POP_BATCH_SIZE];
+    gint pos, len;
+    /* the batch took throttle buckets (it was not a forced flush) */
+    gboolean throttled;
+  } prefetch;
+
   gchar *stats_id;
 
   struct iv_fd fd_watch;
@@ -169,10 +184,33 @@ log_writer_msg_ack(gint num_msg_acked, gpointer user_data)
   log_queue_ack_backlog(self->queue, num_msg_acked);
 }
 
+/* releases the messages prefetched from the queue, rewinding them if they
+ * are still at the end of the backlog.  They are going to be popped again,
+ * so the throttle buckets they took are given back. */
+static void
+log_writer_release_prefetched_messages(LogWriter *self, gboolean rewind)
+{
+  gint num_msgs = self->prefetch.len - self->prefetch.pos;
+
+  if (rewind && num_msgs > 0)
+    log_queue_rewind_backlog(self->queue, num_msgs);
+
+  if (self->prefetch.throttled && num_msgs > 0)
+    log_queue_refund_throttle(self->queue, num_msgs);
+
+  for (gint i = self->prefetch.pos; i < self->prefetch.len; i++)
+    log_msg_unref(self->prefetch.msgs[i]);
+
+  self->prefetch.pos = self->prefetch.len = 0;
+}
+
 void
 log_writer_msg_rewind(LogWriter *self)
 {
   log_queue_rewind_backlog_all(self->queue);
+
+  /* the whole backlog got rewound, including the prefetched messages */
+  log_writer_release_prefetched_messages(self, FALSE);
 }
 
 static void
@@ -933,40 +971,82 @@ log_writer_do_padding(LogWriter *self, GString *result)
   memset(result->str + len - 1, '\0', padd_bytes);
 }
 
-void
-log_writer_format_log(LogWriter *self, LogMessage *lm, GString *result)
+/*
+ * raw-relay: the input of the message is written as it was received,
+ * without templating.  The LogProtoClient adds the framing of the
+ * destination, for newline terminated transports (anything but syslog())
+ * the terminator stripped by the source is restored.
+ */
+static gboolean
+_format_raw_relay(LogWriter *self, LogMessage *lm, GString *result)
+{
+  NVHandle rawmsg_handle = LOG_MSG_GET_VALUE_HANDLE_STATIC("RAWMSG");
+  gssize len;
+
+  const gchar *raw = log_msg_get_value_if_set(lm, rawmsg_handle, &len);
+  if (!raw)
+    return FALSE;
+
+  g_string_truncate(result, 0);
+  g_string_append_len(result, raw, len);
+  if (!(self->flags & LW_SYSLOG_PROTOCOL) && (len == 0 || raw[len - 1] != '\n'))
+    g_string_append_c(result, '\n');
+  return TRUE;
+}
+
+static inline gboolean
+_is_syslog_protocol(LogWriter *self)
+{
+  return (self->flags & LW_SYSLOG_PROTOCOL) || (self->options->options & LWO_SYSLOG_PROTOCOL);
+}
+
+/* the template used instead of the builtin format, if any */
+static LogTemplate *
+_get_output_template(LogWriter *self)
+{
+  if (self->options->template)
+    return self->options->template;
+  if (_is_syslog_protocol(self))
+    return NULL;
+  if (self->flags & LW_FORMAT_FILE)
+    return self->options->file_template;
+  if (self->flags & LW_FORMAT_PROTO)
+    return self->options->proto_template;
+  return NULL;
+}
+
+static guint32
+_get_seq_num(LogWriter *self, LogMessage *lm)
 {
-  LogTemplate *template = NULL;
-  UnixTime *stamp;
-  guint32 seq_num;
   static NVHandle meta_seqid = 0;
+  const gchar *seqid;
+  gssize seqid_length;
+
+  if (lm->flags & LF_LOCAL)
+    return self->seq_num;
 
   if (!meta_seqid)
     meta_seqid = log_msg_get_value_handle(".SDATA.meta.sequenceId");
 
-  if (lm->flags & LF_LOCAL)
-    {
-      seq_num = self->seq_num;
-    }
-  else
-    {
-      const gchar *seqid;
-      gssize seqid_length;
+  seqid = log_msg_get_value(lm, meta_seqid, &seqid_length);
+  APPEND_ZERO(seqid, seqid, seqid_length);
+  if (seqid[0])
+    return strtol(seqid, NULL, 10);
+  return 0;
+}
 
-      seqid = log_msg_get_value(lm, meta_seqid, &seqid_length);
-      APPEND_ZERO(seqid, seqid, seqid_length);
-      if (seqid[0])
-        seq_num = strtol(seqid, NULL, 10);
-      else
-        seq_num = 0;
-    }
+static void
+_format_message(LogWriter *self, LogMessage *lm, guint32 seq_num, GString *result)
+{
+  LogTemplate *template = NULL;
+  UnixTime *stamp;
 
   /* no template was specified, use default */
   stamp = &lm->timestamps[LM_TS_STAMP];
 
   g_string_truncate(result, 0);
 
-  if ((self->flags & LW_SYSLOG_PROTOCOL) || (self->options->options & LWO_SYSLOG_PROTOCOL))
+  if (_is_syslog_protocol(self))
     {
       gssize len;
 
@@ -1030,20 +1110,7 @@ log_writer_format_log(LogWriter *self, LogMessage *lm, GString *result)
     }
   else
     {
-
-      if (self->options->template)
-        {
-          template = self->options->template;
-        }
-      else if (self->flags & LW_FORMAT_FILE)
-        {
-          template = self->options->file_template;
-        }
-      else if ((self->flags & LW_FORMAT_PROTO))
-        {
-          template = self->options->proto_template;
-        }
-
+      template = _get_output_template(self);
       if (template)
         {
           LogTemplateEvalOptions options =
@@ -1124,6 +1191,53 @@ log_writer_format_log(LogWriter *self, LogMessage *lm, GString *result)
         }
 
     }
+}
+
+/* the builtin formats of write protected messages can be shared with other
+ * writers, user templates are cached by template-cache(yes) instead */
+static gboolean
+_is_format_cacheable(LogWriter *self, LogMessage *lm)
+{
+  return (self->options->options & LWO_FORMAT_CACHE) &&
+         log_msg_is_write_protected(lm) &&
+         !_get_output_template(self);
+}
+
+static void
+_format_message_cached(LogWriter *self, LogMessage *lm, guint32 seq_num, GString *result)
+{
+  LogWriterFormatCacheKey key;
+  gboolean syslog_protocol = _is_syslog_protocol(self);
+  guint32 format_flags = syslog_protocol ? LW_SYSLOG_PROTOCOL : self->flags & (LW_FORMAT_FILE | LW_FORMAT_PROTO);
+
+  /* the sequence id is only part of the RFC5424 output */
+  log_writer_format_cache_key_init(&key, format_flags,
+                                   self->options->options & LWO_NO_MULTI_LINE,
+                                   self->options->padding,
+                                   &self->options->template_options,
+                                   syslog_protocol ? seq_num : 0);
+
+  g_string_truncate(result, 0);
+  if (log_writer_format_cache_lookup(lm, &key, result))
+    return;
+
+  _format_message(self, lm, seq_num, result);
+  log_writer_format_cache_store(lm, &key, result->str, result->len);
+}
+
+void
+log_writer_format_log(LogWriter *self, LogMessage *lm, GString *result)
+{
+  guint32 seq_num;
+
+  if ((self->options->options & LWO_RAW_RELAY) && _format_raw_relay(self, lm, result))
+    return;
+
+  seq_num = _get_seq_num(self, lm);
+  if (_is_format_cacheable(self, lm))
+    _format_message_cached(self, lm, seq_num, result);
+  else
+    _format_message(self, lm, seq_num, result);
 
   if (self->options->truncate_size != -1 && result->len > self->options->truncate_size)
     {
@@ -1281,13 +1395,31 @@ log_writer_write_message(LogWriter *self, LogMessage *msg, LogPathOptions *path_
     }
 }
 
-static inline LogMessage *
-log_writer_queue_pop_message(LogWriter *self, LogPathOptions *path_options, gboolean force_flush)
+static inline gint
+log_writer_queue_pop_batch(LogWriter *self, gboolean force_flush)
 {
   if (force_flush)
-    return log_queue_pop_head_ignore_throttle(self->queue, path_options);
+    return log_queue_pop_head_batch_ignore_throttle(self->queue, self->prefetch.msgs, self->prefetch.path_options,
+                                                    LOG_WRITER_POP_BATCH_SIZE);
   else
-    return log_queue_pop_head(self->queue, path_options);
+    return log_queue_pop_head_batch(self->queue, self->prefetch.msgs, self->prefetch.path_options,
+                                    LOG_WRITER_POP_BATCH_SIZE);
+}
+
+static inline LogMessage *
+log_writer_queue_pop_message(LogWriter *self, LogPathOptions *path_options, gboolean force_flush)
+{
+  if (self->prefetch.pos == self->prefetch.len)
+    {
+      self->prefetch.pos = 0;
+      self->prefetch.throttled = !force_flush;
+      self->prefetch.len = log_writer_queue_pop_batch(self, force_flush);
+      if (self->prefetch.len == 0)
+        return NULL;
+    }
+
+  path_options->ack_needed = self->prefetch.path_options[self->prefetch.pos].ack_needed;
+  return self->prefetch.msgs[self->prefetch.pos++];
 }
 
 static inline gboolean
@@ -1349,6 +1481,11 @@ log_writer_flush(LogWriter *self, LogWriterFlushMode flush_mode)
         stats_counter_inc(self->metrics.written_messages);
     }
 
+  /* put back whatever we have fetched but not written, the message that
+   * failed to be written has already been rewound, which took the last
+   * one from the backlog, the messages are still in order afterwards */
+  log_writer_release_prefetched_messages(self, TRUE);
+
   if (write_error)
     return FALSE;
 
@@ -2026,6 +2163,10 @@ log_writer_options_lookup_flag(const gchar *flag)
     return LWO_THREADED;
   if (strcmp(flag, "ignore-errors") == 0)
     return LWO_IGNORE_ERRORS;
+  if (strcmp(flag, "raw-relay") == 0)
+    return LWO_RAW_RELAY;
+  if (strcmp(flag, "format-cache") == 0)
+    return LWO_FORMAT_CACHE;
   msg_error("Unknown dest writer flag", evt_tag_str("flag", flag));
   return 0;
 }
@@ -45,6 +45,10 @@
 #define LWO_NO_STATS        0x0004
 #define LWO_THREADED        0x0010
 #define LWO_IGNORE_ERRORS   0x0020
+/* write $RAWMSG unchanged instead of formatting the message */
+#define LWO_RAW_RELAY       0x0040
+/* share the output of the builtin formats with other writers, see logwriter-format-cache.c */
+#define LWO_FORMAT_CACHE    0x0080
 
 typedef struct _LogWriterOptions
 {
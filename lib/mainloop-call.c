@@ -22,6 +22,7 @@
  *
  */
 #include "mainloop-call.h"
+#include "mainloop-watchdog.h"
 #include "tls-support.h"
 
 #include <iv.h>
@@ -129,7 +130,9 @@ main_loop_call_handler(gpointer user_data)
       iv_list_del_init(&site->list);
       g_mutex_unlock(&main_task_lock);
 
+      main_loop_watchdog_callback_begin("main-loop-call", (gpointer) site->func);
       result = site->func(site->user_data);
+      main_loop_watchdog_callback_end();
 
       g_mutex_lock(&site->lock);
       site->result = result;
@@ -31,6 +31,7 @@
 #include "secret-storage/secret-storage.h"
 #include "cfg-walker.h"
 #include "logpipe.h"
+#include "startup-timeline.h"
 
 #include <string.h>
 
@@ -196,7 +197,10 @@ control_connection_reload(ControlConnection *cc, GString *command, gpointer user
   if (!main_loop_reload_config_prepare(main_loop, &error))
     {
       GString *result = g_string_new("");
-      g_string_printf(result, "FAIL %s, previous config remained intact", error->message);
+      if (g_error_matches(error, MAIN_LOOP_ERROR, MAIN_LOOP_ERROR_RELOAD_UNCHANGED))
+        g_string_printf(result, "OK %s", error->message);
+      else
+        g_string_printf(result, "FAIL %s, previous config remained intact", error->message);
       g_clear_error(&error);
       control_connection_send_reply(cc, result);
       return;
@@ -450,6 +454,16 @@ export_config_graph(ControlConnection *cc, GString *command, gpointer user_data,
   control_connection_send_reply(cc, result);
 }
 
+static void
+control_connection_startup_timeline(ControlConnection *cc, GString *command, gpointer user_data,
+                                    gboolean *cancelled)
+{
+  GString *result = g_string_sized_new(256);
+
+  startup_timeline_format(result);
+  control_connection_send_reply(cc, result);
+}
+
 ControlCommand default_commands[] =
 {
   { "LOG", control_connection_message_log },
@@ -461,6 +475,7 @@ ControlCommand default_commands[] =
   { "PWD", process_credentials },
   { "LISTFILES", control_connection_list_files },
   { "EXPORT_CONFIG_GRAPH", export_config_graph },
+  { "STARTUP_TIMELINE", control_connection_startup_timeline },
   { NULL, NULL },
 };
 
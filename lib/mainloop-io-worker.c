@@ -23,6 +23,7 @@
  */
 #include "mainloop-io-worker.h"
 #include "mainloop-worker.h"
+#include "mainloop-watchdog.h"
 #include "mainloop-call.h"
 #include "logqueue.h"
 #include "apphook.h"
@@ -33,6 +34,11 @@
 
 static struct iv_work_pool main_loop_io_workers;
 
+struct _MainLoopIOWorkerPool
+{
+  struct iv_work_pool work_pool;
+};
+
 static void
 _release(MainLoopIOWorkerJob *self)
 {
@@ -47,8 +53,8 @@ _engage(MainLoopIOWorkerJob *self)
     self->engage(self->user_data);
 }
 
-gboolean
-main_loop_io_worker_job_submit(MainLoopIOWorkerJob *self, gpointer arg)
+static gboolean
+_submit(MainLoopIOWorkerJob *self, struct iv_work_pool *work_pool, gpointer arg)
 {
   main_loop_assert_main_thread();
 
@@ -60,10 +66,22 @@ main_loop_io_worker_job_submit(MainLoopIOWorkerJob *self, gpointer arg)
   main_loop_worker_job_start();
   self->working = TRUE;
   self->arg = arg;
-  iv_work_pool_submit_work(&main_loop_io_workers, &self->work_item);
+  iv_work_pool_submit_work(work_pool, &self->work_item);
   return TRUE;
 }
 
+gboolean
+main_loop_io_worker_job_submit(MainLoopIOWorkerJob *self, gpointer arg)
+{
+  return _submit(self, &main_loop_io_workers, arg);
+}
+
+gboolean
+main_loop_io_worker_job_submit_to_pool(MainLoopIOWorkerJob *self, MainLoopIOWorkerPool *pool, gpointer arg)
+{
+  return _submit(self, &pool->work_pool, arg);
+}
+
 #if SYSLOG_NG_HAVE_IV_WORK_POOL_SUBMIT_CONTINUATION
 void
 main_loop_io_worker_job_submit_continuation(MainLoopIOWorkerJob *self, gpointer arg)
@@ -85,7 +103,9 @@ main_loop_io_worker_job_submit_continuation(MainLoopIOWorkerJob *self, gpointer
 static void
 _work(MainLoopIOWorkerJob *self)
 {
+  main_loop_watchdog_callback_begin("io-worker-job", (gpointer) self->work);
   self->work(self->user_data, self->arg);
+  main_loop_watchdog_callback_end();
   main_loop_worker_invoke_batch_callbacks();
   main_loop_worker_run_gc();
 }
@@ -96,7 +116,11 @@ _complete(MainLoopIOWorkerJob *self)
 {
   self->working = FALSE;
   if (self->completion)
-    self->completion(self->user_data, self->arg);
+    {
+      main_loop_watchdog_callback_begin("io-worker-completion", (gpointer) self->completion);
+      self->completion(self->user_data, self->arg);
+      main_loop_watchdog_callback_end();
+    }
   main_loop_worker_job_complete();
   _release(self);
 }
@@ -132,6 +156,35 @@ main_loop_io_worker_thread_stop(void *cookie)
   main_loop_worker_thread_stop();
 }
 
+static void
+main_loop_io_worker_pool_thread_start(void *cookie)
+{
+  main_loop_worker_thread_start(MLW_THREADED_INPUT_WORKER);
+}
+
+/* NOTE: must be called from the main thread, completions of the jobs are
+ * delivered there, just like in the case of the shared pool */
+MainLoopIOWorkerPool *
+main_loop_io_worker_pool_new(gint max_threads)
+{
+  MainLoopIOWorkerPool *self = g_new0(MainLoopIOWorkerPool, 1);
+
+  main_loop_assert_main_thread();
+  self->work_pool.max_threads = max_threads;
+  self->work_pool.thread_start = main_loop_io_worker_pool_thread_start;
+  self->work_pool.thread_stop = main_loop_io_worker_thread_stop;
+  iv_work_pool_create(&self->work_pool);
+  return self;
+}
+
+/* jobs still running are completed normally, the threads exit afterwards */
+void
+main_loop_io_worker_pool_free(MainLoopIOWorkerPool *self)
+{
+  iv_work_pool_put(&self->work_pool);
+  g_free(self);
+}
+
 static void
 __pre_pre_init_hook(gint type, gpointer user_data)
 {
@@ -159,9 +212,16 @@ main_loop_io_worker_deinit(void)
   iv_work_pool_put(&main_loop_io_workers);
 }
 
+static gboolean
+_parse_worker_cpu_list(const gchar *option_name, const gchar *value, gpointer data, GError **error)
+{
+  return main_loop_worker_set_cpu_list(value, error);
+}
+
 static GOptionEntry main_loop_io_worker_options[] =
 {
   { "worker-threads",      0,         0, G_OPTION_ARG_INT, &main_loop_io_workers.max_threads, "Set the number of I/O worker threads", "<max>" },
+  { "worker-cpu-list",     0,         0, G_OPTION_ARG_CALLBACK, _parse_worker_cpu_list, "Pin worker threads to these CPUs, e.g. 0-7,16-23", "<cpus>" },
   { NULL },
 };
 
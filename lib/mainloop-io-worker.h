@@ -40,8 +40,15 @@ typedef struct _MainLoopIOWorkerJob
   struct iv_work_item work_item;
 } MainLoopIOWorkerJob;
 
+/* a private pool of worker threads, for jobs that should not compete with others in the shared pool */
+typedef struct _MainLoopIOWorkerPool MainLoopIOWorkerPool;
+
 void main_loop_io_worker_job_init(MainLoopIOWorkerJob *self);
 gboolean main_loop_io_worker_job_submit(MainLoopIOWorkerJob *self, gpointer arg);
+gboolean main_loop_io_worker_job_submit_to_pool(MainLoopIOWorkerJob *self, MainLoopIOWorkerPool *pool, gpointer arg);
+
+MainLoopIOWorkerPool *main_loop_io_worker_pool_new(gint max_threads);
+void main_loop_io_worker_pool_free(MainLoopIOWorkerPool *self);
 
 #if SYSLOG_NG_HAVE_IV_WORK_POOL_SUBMIT_CONTINUATION
 void main_loop_io_worker_job_submit_continuation(MainLoopIOWorkerJob *self, gpointer arg);
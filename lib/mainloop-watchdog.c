@@ -0,0 +1,446 @@
+/*
+ * Copyright (c) 2024 One Identity LLC.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+
+#include "mainloop-watchdog.h"
+#include "mainloop.h"
+#include "mainloop-worker.h"
+#include "atomic-gssize.h"
+#include "messages.h"
+#include "timeutils/misc.h"
+#include "stats/stats-registry.h"
+#include "stats/stats-cluster-single.h"
+#include "signal-backtrace.h"
+
+#include <iv.h>
+#include <signal.h>
+#include <string.h>
+#include <pthread.h>
+
+#if SIGNAL_BACKTRACE_SUPPORTED
+#include <execinfo.h>
+#endif
+
+#if SYSLOG_NG_HAVE_DLFCN_H
+#include <dlfcn.h>
+#endif
+
+#define WATCHDOG_MAX_DEPTH 32
+#define WATCHDOG_MIN_CHECK_INTERVAL_MSEC 10
+/* the blocked thread is asked to take its own backtrace, SIGURG is ignored
+ * by default, so nothing else is expected to depend on it */
+#define WATCHDOG_BACKTRACE_SIGNAL SIGURG
+#define WATCHDOG_BACKTRACE_TIMEOUT_MSEC 100
+
+typedef struct _WatchdogSlot
+{
+  /* monotonic time of the start of the current callback in usec, 0 if idle */
+  atomic_gssize started;
+  const gchar *kind;
+  gpointer callback;
+  pthread_t thread;
+  gboolean reported;
+
+  gint backtrace_ready;
+  gint backtrace_depth;
+  gpointer backtrace[WATCHDOG_MAX_DEPTH];
+} WatchdogSlot;
+
+typedef struct _WatchdogMetrics
+{
+  StatsCounterItem *stalls;
+  StatsCounterItem *max_stall;
+} WatchdogMetrics;
+
+static gint stall_threshold_msec = 1000;
+
+static gboolean watchdog_running;
+static WatchdogSlot main_slot;
+static WatchdogSlot worker_slots[MAIN_LOOP_MAX_WORKER_THREADS];
+
+/* the main thread is blocked if the heartbeat timer is late */
+static struct iv_timer heartbeat_timer;
+static atomic_gssize last_heartbeat;
+static gint main_stall_reported;
+
+static WatchdogMetrics main_metrics;
+static WatchdogMetrics worker_metrics;
+
+static GThread *watchdog_thread;
+static GMutex watchdog_lock;
+static GCond watchdog_cond;
+static gboolean watchdog_quit;
+
+static glong
+_check_interval_msec(void)
+{
+  return MAX(stall_threshold_msec / 4, WATCHDOG_MIN_CHECK_INTERVAL_MSEC);
+}
+
+static WatchdogSlot *
+_current_slot(void)
+{
+  gint thread_index = main_loop_worker_get_thread_index();
+
+  if (thread_index >= 0 && thread_index < MAIN_LOOP_MAX_WORKER_THREADS)
+    return &worker_slots[thread_index];
+  if (main_loop_is_main_thread())
+    return &main_slot;
+  return NULL;
+}
+
+static void
+_record_stall(WatchdogMetrics *metrics, gint64 stall_msec)
+{
+  stats_counter_inc(metrics->stalls);
+  if ((gsize) stall_msec > stats_counter_get(metrics->max_stall))
+    stats_counter_set(metrics->max_stall, stall_msec);
+}
+
+void
+main_loop_watchdog_callback_begin(const gchar *kind, gpointer callback)
+{
+  if (!watchdog_running)
+    return;
+
+  WatchdogSlot *slot = _current_slot();
+  if (!slot)
+    return;
+
+  slot->kind = kind;
+  slot->callback = callback;
+  slot->thread = pthread_self();
+  slot->reported = FALSE;
+  atomic_gssize_set(&slot->started, g_get_monotonic_time());
+}
+
+void
+main_loop_watchdog_callback_end(void)
+{
+  WatchdogSlot *slot = _current_slot();
+  if (!slot)
+    return;
+
+  gssize started = atomic_gssize_set_and_get(&slot->started, 0);
+
+  /* stalls of the main thread are accounted by the heartbeat */
+  if (!started || slot == &main_slot)
+    return;
+
+  gint64 duration_msec = (g_get_monotonic_time() - started) / 1000;
+  if (duration_msec < stall_threshold_msec)
+    return;
+
+  _record_stall(&worker_metrics, duration_msec);
+  msg_warning("I/O worker callback finished after blocking its thread",
+              evt_tag_str("kind", slot->kind),
+              evt_tag_long("duration_msec", duration_msec));
+}
+
+#if SIGNAL_BACKTRACE_SUPPORTED
+
+static void
+_backtrace_signal_handler(int signo)
+{
+  WatchdogSlot *slot = _current_slot();
+
+  if (slot)
+    {
+      slot->backtrace_depth = signal_backtrace_capture(slot->backtrace, WATCHDOG_MAX_DEPTH);
+      g_atomic_int_set(&slot->backtrace_ready, TRUE);
+    }
+}
+
+static void
+_install_backtrace_signal_handler(void)
+{
+  struct sigaction sa;
+
+  signal_backtrace_init();
+
+  memset(&sa, 0, sizeof(sa));
+  sa.sa_handler = _backtrace_signal_handler;
+  sigemptyset(&sa.sa_mask);
+  sa.sa_flags = SA_RESTART;
+  sigaction(WATCHDOG_BACKTRACE_SIGNAL, &sa, NULL);
+}
+
+static gchar *
+_format_backtrace(WatchdogSlot *slot, pthread_t thread)
+{
+  g_atomic_int_set(&slot->backtrace_ready, FALSE);
+  if (pthread_kill(thread, WATCHDOG_BACKTRACE_SIGNAL) != 0)
+    return g_strdup("unavailable");
+
+  for (gint i = 0; i < WATCHDOG_BACKTRACE_TIMEOUT_MSEC && !g_atomic_int_get(&slot->backtrace_ready); i++)
+    g_usleep(1000);
+
+  if (!g_atomic_int_get(&slot->backtrace_ready))
+    return g_strdup("unavailable");
+
+  gint depth = slot->backtrace_depth;
+  if (depth <= 0)
+    return g_strdup("unavailable");
+
+  gchar **symbols = backtrace_symbols(slot->backtrace, depth);
+  if (!symbols)
+    return g_strdup("unavailable");
+
+  GString *result = g_string_sized_new(1024);
+  for (gint i = 0; i < depth; i++)
+    {
+      if (i)
+        g_string_append(result, ", ");
+      g_string_append(result, symbols[i]);
+    }
+  free(symbols);
+  return g_string_free(result, FALSE);
+}
+
+#else
+
+static void
+_install_backtrace_signal_handler(void)
+{
+}
+
+static gchar *
+_format_backtrace(WatchdogSlot *slot, pthread_t thread)
+{
+  return g_strdup("unavailable");
+}
+
+#endif
+
+static gchar *
+_format_callback(gpointer callback)
+{
+  if (!callback)
+    return g_strdup("unknown");
+
+#if SYSLOG_NG_HAVE_DLFCN_H
+  Dl_info info;
+
+  memset(&info, 0, sizeof(info));
+  if (dladdr(callback, &info) && info.dli_sname)
+    return g_strdup(info.dli_sname);
+#endif
+  return g_strdup_printf("%p", callback);
+}
+
+static void
+_report_stall(const gchar *thread_kind, gint thread_index, WatchdogSlot *slot, pthread_t thread, gint64 stall_msec)
+{
+  gboolean in_callback = atomic_gssize_get(&slot->started) != 0;
+  gchar *callback = _format_callback(in_callback ? slot->callback : NULL);
+  gchar *backtrace = _format_backtrace(slot, thread);
+
+  msg_warning("A callback has been blocking its thread for too long",
+              evt_tag_str("thread", thread_kind),
+              evt_tag_int("thread_index", thread_index),
+              evt_tag_str("kind", in_callback ? slot->kind : "ivykis"),
+              evt_tag_str("callback", callback),
+              evt_tag_long("blocked_msec", stall_msec),
+              evt_tag_int("threshold_msec", stall_threshold_msec),
+              evt_tag_str("backtrace", backtrace));
+  g_free(callback);
+  g_free(backtrace);
+}
+
+static void
+_check_main_thread(gint64 now)
+{
+  gint64 stall_msec = (now - atomic_gssize_get(&last_heartbeat)) / 1000 - _check_interval_msec();
+
+  if (stall_msec < stall_threshold_msec || g_atomic_int_get(&main_stall_reported))
+    return;
+
+  g_atomic_int_set(&main_stall_reported, TRUE);
+  _report_stall("main", -1, &main_slot, main_thread_handle, stall_msec);
+}
+
+static void
+_check_worker_threads(gint64 now)
+{
+  for (gint i = 0; i < MAIN_LOOP_MAX_WORKER_THREADS; i++)
+    {
+      WatchdogSlot *slot = &worker_slots[i];
+      gssize started = atomic_gssize_get(&slot->started);
+
+      if (!started || slot->reported)
+        continue;
+
+      gint64 stall_msec = (now - started) / 1000;
+      if (stall_msec < stall_threshold_msec)
+        continue;
+
+      slot->reported = TRUE;
+      _report_stall("worker", i, slot, slot->thread, stall_msec);
+    }
+}
+
+static gpointer
+_watchdog_thread_func(gpointer user_data)
+{
+  g_mutex_lock(&watchdog_lock);
+  while (!watchdog_quit)
+    {
+      gint64 end_time = g_get_monotonic_time() + _check_interval_msec() * 1000;
+
+      if (g_cond_wait_until(&watchdog_cond, &watchdog_lock, end_time))
+        continue;
+
+      g_mutex_unlock(&watchdog_lock);
+      gint64 now = g_get_monotonic_time();
+      _check_main_thread(now);
+      _check_worker_threads(now);
+      g_mutex_lock(&watchdog_lock);
+    }
+  g_mutex_unlock(&watchdog_lock);
+  return NULL;
+}
+
+static void
+_arm_heartbeat(void)
+{
+  iv_validate_now();
+  heartbeat_timer.expires = iv_now;
+  timespec_add_msec(&heartbeat_timer.expires, _check_interval_msec());
+  iv_timer_register(&heartbeat_timer);
+}
+
+static void
+_heartbeat(gpointer user_data)
+{
+  gint64 now = g_get_monotonic_time();
+  gint64 stall_msec = (now - atomic_gssize_get(&last_heartbeat)) / 1000 - _check_interval_msec();
+
+  if (stall_msec >= stall_threshold_msec)
+    {
+      _record_stall(&main_metrics, stall_msec);
+      msg_warning("The main loop has been blocked",
+                  evt_tag_long("duration_msec", stall_msec));
+    }
+
+  atomic_gssize_set(&last_heartbeat, now);
+  g_atomic_int_set(&main_stall_reported, FALSE);
+  _arm_heartbeat();
+}
+
+static void
+_metrics_key_set(StatsClusterKey *key, const gchar *name, const gchar *thread_kind, StatsClusterLabel *labels)
+{
+  labels[0] = stats_cluster_label("thread", thread_kind);
+  stats_cluster_single_key_set(key, name, labels, 1);
+}
+
+static void
+_register_metrics(WatchdogMetrics *metrics, const gchar *thread_kind)
+{
+  StatsClusterKey key;
+  StatsClusterLabel labels[1];
+
+  /* on stats-level 0, just like the other MainLoop metrics */
+  _metrics_key_set(&key, "mainloop_stalls_total", thread_kind, labels);
+  stats_register_counter(0, &key, SC_TYPE_SINGLE_VALUE, &metrics->stalls);
+
+  _metrics_key_set(&key, "mainloop_max_stall_seconds", thread_kind, labels);
+  stats_cluster_single_key_add_unit(&key, SCU_MILLISECONDS);
+  stats_register_counter(0, &key, SC_TYPE_SINGLE_VALUE, &metrics->max_stall);
+}
+
+static void
+_unregister_metrics(WatchdogMetrics *metrics, const gchar *thread_kind)
+{
+  StatsClusterKey key;
+  StatsClusterLabel labels[1];
+
+  _metrics_key_set(&key, "mainloop_stalls_total", thread_kind, labels);
+  stats_unregister_counter(&key, SC_TYPE_SINGLE_VALUE, &metrics->stalls);
+
+  _metrics_key_set(&key, "mainloop_max_stall_seconds", thread_kind, labels);
+  stats_cluster_single_key_add_unit(&key, SCU_MILLISECONDS);
+  stats_unregister_counter(&key, SC_TYPE_SINGLE_VALUE, &metrics->max_stall);
+}
+
+/* NOTE: runs in the main thread, right before entering the main loop */
+void
+main_loop_watchdog_start(void)
+{
+  main_loop_assert_main_thread();
+
+  if (stall_threshold_msec <= 0 || watchdog_running)
+    return;
+
+  stats_lock();
+  _register_metrics(&main_metrics, "main");
+  _register_metrics(&worker_metrics, "worker");
+  stats_unlock();
+
+  _install_backtrace_signal_handler();
+
+  IV_TIMER_INIT(&heartbeat_timer);
+  heartbeat_timer.handler = _heartbeat;
+  atomic_gssize_set(&last_heartbeat, g_get_monotonic_time());
+  _arm_heartbeat();
+
+  watchdog_quit = FALSE;
+  watchdog_running = TRUE;
+  watchdog_thread = g_thread_new("watchdog", _watchdog_thread_func, NULL);
+}
+
+void
+main_loop_watchdog_stop(void)
+{
+  if (!watchdog_running)
+    return;
+
+  watchdog_running = FALSE;
+
+  g_mutex_lock(&watchdog_lock);
+  watchdog_quit = TRUE;
+  g_cond_signal(&watchdog_cond);
+  g_mutex_unlock(&watchdog_lock);
+  g_thread_join(watchdog_thread);
+  watchdog_thread = NULL;
+
+  if (iv_timer_registered(&heartbeat_timer))
+    iv_timer_unregister(&heartbeat_timer);
+
+  stats_lock();
+  _unregister_metrics(&main_metrics, "main");
+  _unregister_metrics(&worker_metrics, "worker");
+  stats_unlock();
+}
+
+static GOptionEntry main_loop_watchdog_options[] =
+{
+  { "stall-threshold",     0,         0, G_OPTION_ARG_INT, &stall_threshold_msec, "Warn about callbacks blocking the main loop or a worker for longer than this (0 disables)", "<msec>" },
+  { NULL },
+};
+
+void
+main_loop_watchdog_add_options(GOptionContext *ctx)
+{
+  g_option_context_add_main_entries(ctx, main_loop_watchdog_options, NULL);
+}
@@ -0,0 +1,51 @@
+/*
+ * Copyright (c) 2024 One Identity LLC.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+
+#ifndef MAINLOOP_WATCHDOG_H_INCLUDED
+#define MAINLOOP_WATCHDOG_H_INCLUDED 1
+
+#include "syslog-ng.h"
+
+/*
+ * Detects callbacks blocking the main thread or an I/O worker for longer
+ * than --stall-threshold milliseconds.
+ *
+ * Callbacks dispatched by syslog-ng itself (I/O worker jobs and their
+ * completions, main_loop_call() and config reloads) are timestamped by
+ * main_loop_watchdog_callback_begin()/end(), everything else running on
+ * the main thread is covered by a heartbeat timer.  A separate thread
+ * checks these and logs a warning with the identity of the callback and
+ * the backtrace of the blocked thread, the number of stalls and the
+ * longest one are exported as metrics.
+ */
+
+void main_loop_watchdog_callback_begin(const gchar *kind, gpointer callback);
+void main_loop_watchdog_callback_end(void);
+
+void main_loop_watchdog_start(void);
+void main_loop_watchdog_stop(void);
+
+void main_loop_watchdog_add_options(GOptionContext *ctx);
+
+#endif
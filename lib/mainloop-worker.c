@@ -27,9 +27,21 @@
 #include "apphook.h"
 #include "messages.h"
 #include "scratch-buffers.h"
+#include "logmsg/logmsg-pool.h"
 #include "atomic.h"
 
 #include <iv.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+
+#if SYSLOG_NG_HAVE_PTHREAD_SETAFFINITY_NP
+#include <sched.h>
+#endif
+
+#if defined(_POSIX_THREAD_CPUTIME) && _POSIX_THREAD_CPUTIME >= 0
+#define MAIN_LOOP_WORKER_THREAD_CPUTIME 1
+#endif
 
 TLS_BLOCK_START
 {
@@ -68,6 +80,24 @@ static GMutex main_loop_workers_idmap_lock;
 #define MAIN_LOOP_IDMAP_ROWS            (MAIN_LOOP_MAX_WORKER_THREADS / MAIN_LOOP_IDMAP_BITS_PER_ROW)
 
 static guint64 main_loop_workers_idmap[MAIN_LOOP_IDMAP_ROWS];
+
+/* indexed by thread index, protected by main_loop_workers_idmap_lock */
+static struct
+{
+  MainLoopWorkerType type;
+#if MAIN_LOOP_WORKER_THREAD_CPUTIME
+  clockid_t cpu_clock;
+  gboolean cpu_clock_valid;
+#endif
+} main_loop_workers_threads[MAIN_LOOP_MAX_WORKER_THREADS];
+
+#if SYSLOG_NG_HAVE_PTHREAD_SETAFFINITY_NP
+/* CPUs worker threads are pinned to, thread index N runs on
+ * main_loop_worker_cpus[N % main_loop_worker_num_cpus] */
+static gint main_loop_worker_cpus[MAIN_LOOP_MAX_WORKER_THREADS];
+static gint main_loop_worker_num_cpus = 0;
+#endif
+
 static gint main_loop_max_workers = 0;
 static gint main_loop_estimated_number_of_workers = 0;
 
@@ -79,6 +109,12 @@ main_loop_worker_get_thread_index(void)
   return main_loop_worker_id - 1;
 }
 
+MainLoopWorkerType
+main_loop_worker_get_thread_type(void)
+{
+  return main_loop_worker_type;
+}
+
 static void
 _allocate_thread_id(void)
 {
@@ -103,6 +139,12 @@ _allocate_thread_id(void)
 
           main_loop_workers_idmap[row] |= (1ULL << bit_in_row);
           main_loop_worker_id = (thread_index + 1);
+
+          main_loop_workers_threads[thread_index].type = main_loop_worker_type;
+#if MAIN_LOOP_WORKER_THREAD_CPUTIME
+          main_loop_workers_threads[thread_index].cpu_clock_valid =
+            pthread_getcpuclockid(pthread_self(), &main_loop_workers_threads[thread_index].cpu_clock) == 0;
+#endif
           break;
         }
     }
@@ -148,6 +190,52 @@ _release_thread_id(void)
   g_mutex_unlock(&main_loop_workers_idmap_lock);
 }
 
+/*
+ * Calls func for each thread that has a thread index, with the CPU time
+ * the thread consumed so far, or -1 if that can not be measured on this
+ * platform.  The threads can not stop while func runs, so it should be
+ * quick.
+ */
+void
+main_loop_worker_foreach_thread(MainLoopWorkerThreadFunc func, gpointer user_data)
+{
+  g_mutex_lock(&main_loop_workers_idmap_lock);
+  for (gint thread_index = 0; thread_index < MAIN_LOOP_MAX_WORKER_THREADS; thread_index++)
+    {
+      gint row = thread_index / MAIN_LOOP_IDMAP_BITS_PER_ROW;
+      gint bit_in_row = thread_index % MAIN_LOOP_IDMAP_BITS_PER_ROW;
+
+      if ((main_loop_workers_idmap[row] & (1ULL << bit_in_row)) == 0)
+        continue;
+
+      gint64 cpu_time_usec = -1;
+#if MAIN_LOOP_WORKER_THREAD_CPUTIME
+      struct timespec ts;
+      if (main_loop_workers_threads[thread_index].cpu_clock_valid &&
+          clock_gettime(main_loop_workers_threads[thread_index].cpu_clock, &ts) == 0)
+        cpu_time_usec = ts.tv_sec * G_USEC_PER_SEC + ts.tv_nsec / 1000;
+#endif
+      func(thread_index, main_loop_workers_threads[thread_index].type, cpu_time_usec, user_data);
+    }
+  g_mutex_unlock(&main_loop_workers_idmap_lock);
+}
+
+const gchar *
+main_loop_worker_type_name(MainLoopWorkerType worker_type)
+{
+  switch (worker_type)
+    {
+    case MLW_ASYNC_WORKER:
+      return "io";
+    case MLW_THREADED_OUTPUT_WORKER:
+      return "output";
+    case MLW_THREADED_INPUT_WORKER:
+      return "input";
+    default:
+      return "unknown";
+    }
+}
+
 gboolean
 main_loop_worker_is_worker_thread(void)
 {
@@ -189,6 +277,112 @@ _request_all_threads_to_exit(void)
   main_loop_workers_quit = TRUE;
 }
 
+#if SYSLOG_NG_HAVE_PTHREAD_SETAFFINITY_NP
+
+static gboolean
+_add_cpu_range(gint64 first, gint64 last, GError **error)
+{
+  if (first < 0 || last < first || last >= CPU_SETSIZE)
+    {
+      g_set_error(error, G_OPTION_ERROR, G_OPTION_ERROR_BAD_VALUE, "Invalid CPU range %" G_GINT64_FORMAT "-%"
+                  G_GINT64_FORMAT, first, last);
+      return FALSE;
+    }
+
+  for (gint64 cpu = first; cpu <= last; cpu++)
+    {
+      if (main_loop_worker_num_cpus == MAIN_LOOP_MAX_WORKER_THREADS)
+        {
+          g_set_error(error, G_OPTION_ERROR, G_OPTION_ERROR_BAD_VALUE, "Too many CPUs listed, at most %d are used",
+                      MAIN_LOOP_MAX_WORKER_THREADS);
+          return FALSE;
+        }
+      main_loop_worker_cpus[main_loop_worker_num_cpus++] = cpu;
+    }
+  return TRUE;
+}
+
+static gboolean
+_parse_cpu_range(const gchar *range, gint64 *first, gint64 *last)
+{
+  gchar *end;
+
+  *first = g_ascii_strtoll(range, &end, 10);
+  *last = *first;
+  if (end == range)
+    return FALSE;
+
+  if (*end == '-')
+    {
+      const gchar *range_end = end + 1;
+
+      *last = g_ascii_strtoll(range_end, &end, 10);
+      if (end == range_end)
+        return FALSE;
+    }
+  return *end == 0;
+}
+
+#endif
+
+/* cpu_list is in the same format as taskset --cpu-list, e.g. "0-3,8,10-11" */
+gboolean
+main_loop_worker_set_cpu_list(const gchar *cpu_list, GError **error)
+{
+#if SYSLOG_NG_HAVE_PTHREAD_SETAFFINITY_NP
+  gchar **ranges = g_strsplit(cpu_list, ",", -1);
+  gboolean success = TRUE;
+
+  main_loop_worker_num_cpus = 0;
+  for (gint i = 0; success && ranges[i]; i++)
+    {
+      gint64 first, last;
+
+      if (!_parse_cpu_range(ranges[i], &first, &last))
+        {
+          g_set_error(error, G_OPTION_ERROR, G_OPTION_ERROR_BAD_VALUE, "Invalid CPU list: %s", cpu_list);
+          success = FALSE;
+          break;
+        }
+      success = _add_cpu_range(first, last, error);
+    }
+  g_strfreev(ranges);
+
+  if (!success)
+    main_loop_worker_num_cpus = 0;
+  return success;
+#else
+  g_set_error(error, G_OPTION_ERROR, G_OPTION_ERROR_BAD_VALUE,
+              "Pinning worker threads to CPUs is not supported on this platform");
+  return FALSE;
+#endif
+}
+
+static void
+_pin_thread_to_cpu(void)
+{
+#if SYSLOG_NG_HAVE_PTHREAD_SETAFFINITY_NP
+  const gint thread_index = main_loop_worker_get_thread_index();
+
+  if (main_loop_worker_num_cpus == 0 || thread_index < 0)
+    return;
+
+  gint cpu = main_loop_worker_cpus[thread_index % main_loop_worker_num_cpus];
+  cpu_set_t cpu_set;
+
+  CPU_ZERO(&cpu_set);
+  CPU_SET(cpu, &cpu_set);
+  gint rc = pthread_setaffinity_np(pthread_self(), sizeof(cpu_set), &cpu_set);
+  if (rc != 0)
+    {
+      msg_warning("Error pinning worker thread to CPU",
+                  evt_tag_int("thread_index", thread_index),
+                  evt_tag_int("cpu", cpu),
+                  evt_tag_str("error", g_strerror(rc)));
+    }
+#endif
+}
+
 /* Call this function from worker threads, when you start up */
 void
 main_loop_worker_thread_start(MainLoopWorkerType worker_type)
@@ -196,6 +390,7 @@ main_loop_worker_thread_start(MainLoopWorkerType worker_type)
   main_loop_worker_type = worker_type;
 
   _allocate_thread_id();
+  _pin_thread_to_cpu();
   INIT_IV_LIST_HEAD(&batch_callbacks);
 
   g_mutex_lock(&workers_running_lock);
@@ -222,6 +417,7 @@ void
 main_loop_worker_run_gc(void)
 {
   scratch_buffers_explicit_gc();
+  log_msg_pool_lazy_update_stats();
 }
 
 /*
@@ -67,8 +67,14 @@ void main_loop_worker_invoke_batch_callbacks(void);
 void main_loop_worker_assert_batch_callbacks_were_processed(void);
 
 typedef void (*WorkerExitNotificationFunc)(gpointer user_data);
+typedef void (*MainLoopWorkerThreadFunc)(gint thread_index, MainLoopWorkerType worker_type, gint64 cpu_time_usec,
+                                         gpointer user_data);
 
 gint main_loop_worker_get_thread_index(void);
+MainLoopWorkerType main_loop_worker_get_thread_type(void);
+gboolean main_loop_worker_set_cpu_list(const gchar *cpu_list, GError **error);
+void main_loop_worker_foreach_thread(MainLoopWorkerThreadFunc func, gpointer user_data);
+const gchar *main_loop_worker_type_name(MainLoopWorkerType worker_type);
 
 void main_loop_worker_job_start(void);
 void main_loop_worker_job_complete(void);
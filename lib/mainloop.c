@@ -24,6 +24,7 @@
 #include "mainloop.h"
 #include "mainloop-worker.h"
 #include "mainloop-io-worker.h"
+#include "mainloop-watchdog.h"
 #include "mainloop-call.h"
 #include "mainloop-control.h"
 #include "apphook.h"
@@ -37,6 +38,7 @@
 #include "reloc.h"
 #include "service-management.h"
 #include "persist-state.h"
+#include "startup-timeline.h"
 #include "run-id.h"
 #include "host-id.h"
 #include "debugger/debugger-main.h"
@@ -46,6 +48,7 @@
 #include "timeutils/misc.h"
 #include "stats/stats-control.h"
 #include "healthcheck/healthcheck-control.h"
+#include "rule-profiler-control.h"
 #include "signal-handler.h"
 #include "cfg-monitor.h"
 
@@ -211,6 +214,7 @@ main_loop_initialize_state(GlobalConfig *cfg, const gchar *persist_filename)
     return FALSE;
   if (!host_id_init(cfg->state))
     return FALSE;
+  startup_timeline_mark("persist-state-loaded");
 
   if (!cfg_init(cfg))
     {
@@ -218,8 +222,10 @@ main_loop_initialize_state(GlobalConfig *cfg, const gchar *persist_filename)
       persist_state_cancel(cfg->state);
       return FALSE;
     }
+  startup_timeline_mark("pipeline-initialized");
 
   persist_state_commit(cfg->state);
+  startup_timeline_mark("persist-state-committed");
   return TRUE;
 }
 
@@ -267,12 +273,9 @@ main_loop_reload_config_revert(gpointer user_data)
   main_loop_reload_config_finished(self);
 }
 
-/* called to apply the new configuration once all I/O worker threads have finished */
 static void
-main_loop_reload_config_apply(gpointer user_data)
+_reload_config_apply(MainLoop *self)
 {
-  MainLoop *self = (MainLoop *) user_data;
-
   if (main_loop_is_terminating(self))
     {
       if (self->new_config)
@@ -319,6 +322,17 @@ main_loop_reload_config_apply(gpointer user_data)
   main_loop_reload_config_finished(self);
 }
 
+/* called to apply the new configuration once all I/O worker threads have finished */
+static void
+main_loop_reload_config_apply(gpointer user_data)
+{
+  MainLoop *self = (MainLoop *) user_data;
+
+  main_loop_watchdog_callback_begin("config-reload", (gpointer) main_loop_reload_config_apply);
+  _reload_config_apply(self);
+  main_loop_watchdog_callback_end();
+}
+
 
 /* initiate configuration reload */
 gboolean
@@ -357,6 +371,20 @@ main_loop_reload_config_prepare(MainLoop *self, GError **error)
                   "Syntax error parsing configuration file");
       return FALSE;
     }
+  /* Tearing down and re-initializing every pipe is pointless if the
+   * preprocessed configuration did not change, keep the running one. */
+  if (self->new_config->skip_unchanged_reload && cfg_is_config_hash_equal(self->new_config, self->old_config))
+    {
+      cfg_free(self->new_config);
+      self->new_config = NULL;
+      self->old_config = NULL;
+      self->last_config_reload_successful = TRUE;
+      stats_counter_set(self->metrics.last_successful_reload, (gsize) self->last_config_reload_time);
+      service_management_clear_status();
+      g_set_error(error, MAIN_LOOP_ERROR, MAIN_LOOP_ERROR_RELOAD_UNCHANGED,
+                  "Configuration unchanged, reload skipped");
+      return FALSE;
+    }
   is_reloading_scheduled = TRUE;
   return TRUE;
 }
@@ -375,8 +403,11 @@ main_loop_reload_config(MainLoop *self)
 
   if (!main_loop_reload_config_prepare(self, &error))
     {
-      msg_error("Error reloading configuration",
-                evt_tag_str("reason", error->message));
+      if (g_error_matches(error, MAIN_LOOP_ERROR, MAIN_LOOP_ERROR_RELOAD_UNCHANGED))
+        msg_notice(error->message);
+      else
+        msg_error("Error reloading configuration",
+                  evt_tag_str("reason", error->message));
       g_clear_error(&error);
       return;
     }
@@ -652,6 +683,7 @@ void
 main_loop_init(MainLoop *self, MainLoopOptions *options)
 {
   service_management_publish_status("Starting up...");
+  startup_timeline_mark("main-loop-init");
 
   g_mutex_init(&workers_running_lock);
   self->options = options;
@@ -693,6 +725,7 @@ main_loop_read_and_init_config(MainLoop *self)
     {
       return 1;
     }
+  startup_timeline_mark("config-read");
 
   if (options->config_id)
     {
@@ -723,6 +756,7 @@ main_loop_read_and_init_config(MainLoop *self)
   main_loop_register_control_commands(self);
   stats_register_control_commands();
   healthcheck_register_control_commands();
+  rule_profiler_register_control_commands();
   return 0;
 }
 
@@ -772,7 +806,10 @@ main_loop_run(MainLoop *self)
       debugger_start(self, self->current_configuration);
     }
   app_running();
+  startup_timeline_mark("running");
+  main_loop_watchdog_start();
   iv_main();
+  main_loop_watchdog_stop();
   service_management_publish_status("Shutting down...");
 }
 
@@ -780,6 +817,7 @@ void
 main_loop_add_options(GOptionContext *ctx)
 {
   main_loop_io_worker_add_options(ctx);
+  main_loop_watchdog_add_options(ctx);
 }
 
 void
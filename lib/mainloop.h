@@ -98,6 +98,7 @@ enum MainLoopError
 {
   MAIN_LOOP_ERROR_FAILED,
   MAIN_LOOP_ERROR_RELOAD_FAILED,
+  MAIN_LOOP_ERROR_RELOAD_UNCHANGED,
 };
 
 #endif
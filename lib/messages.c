@@ -48,10 +48,31 @@ enum
 typedef struct _MsgContext
 {
   guint16 recurse_state;
-  guint recurse_warning:1;
+  guint recurse_warning:1, format_buffer_busy:1;
   gchar recurse_trigger[128];
+  /* events are formatted into this per-thread buffer, it is reused across messages */
+  gchar *format_buffer;
+  gsize format_buffer_size;
 } MsgContext;
 
+/*
+ * Repeated message coalescing: an internal message identical to the
+ * previous one (same priority and text) within MSG_REPEAT_WINDOW seconds
+ * is not posted, only counted.  The count is reported as a separate
+ * message once a different message arrives or the window elapses.
+ */
+#define MSG_REPEAT_WINDOW 10
+
+typedef struct _MsgRepeatState
+{
+  gboolean enabled;
+  gint prio;
+  gsize length;
+  gchar text[1024];
+  time_t first_seen;
+  guint repeated;
+} MsgRepeatState;
+
 static gint active_log_level = -1;
 static gint cmdline_log_level = -1;
 gboolean startup_debug_flag = 0;
@@ -62,8 +83,20 @@ gboolean log_stderr = FALSE;
 gboolean skip_timestamp_on_stderr = FALSE;
 static MsgPostFunc msg_post_func;
 static EVTCONTEXT *evt_context;
-static GPrivate msg_context_private = G_PRIVATE_INIT(g_free);
+static void msg_context_free(gpointer s);
+static GPrivate msg_context_private = G_PRIVATE_INIT(msg_context_free);
 static GMutex evtlog_lock;
+static MsgRepeatState msg_repeat_state = { .prio = -1 };
+static GMutex msg_repeat_lock;
+
+static void
+msg_context_free(gpointer s)
+{
+  MsgContext *context = (MsgContext *) s;
+
+  free(context->format_buffer);
+  g_free(context);
+}
 
 static MsgContext *
 msg_get_context(void)
@@ -152,6 +185,91 @@ msg_send_formatted_message_to_stderr(const char *msg)
     fprintf(stderr, "[%s] %s\n", msg_format_timestamp(tmtime, sizeof(tmtime)), msg);
 }
 
+static void
+msg_repeat_state_reset(void)
+{
+  msg_repeat_state.prio = -1;
+  msg_repeat_state.length = 0;
+  msg_repeat_state.repeated = 0;
+}
+
+void
+msg_set_coalesce_repeated_messages(gboolean enabled)
+{
+  g_mutex_lock(&msg_repeat_lock);
+  msg_repeat_state.enabled = enabled;
+  msg_repeat_state_reset();
+  g_mutex_unlock(&msg_repeat_lock);
+}
+
+/*
+ * Returns TRUE if msg repeats the previous message and should not be
+ * posted.  Otherwise msg becomes the message to compare against and the
+ * number of unreported repetitions of the previous one is returned in
+ * *repeated (with its priority in *repeated_prio).
+ */
+static gboolean
+msg_coalesce_repeated(int prio, const char *msg, guint *repeated, gint *repeated_prio)
+{
+  *repeated = 0;
+  if (!msg_repeat_state.enabled)
+    return FALSE;
+
+  gsize length = strlen(msg);
+  time_t now = cached_g_current_time_sec();
+
+  g_mutex_lock(&msg_repeat_lock);
+  if (prio == msg_repeat_state.prio && length == msg_repeat_state.length &&
+      memcmp(msg, msg_repeat_state.text, length) == 0 &&
+      now - msg_repeat_state.first_seen < MSG_REPEAT_WINDOW)
+    {
+      msg_repeat_state.repeated++;
+      g_mutex_unlock(&msg_repeat_lock);
+      return TRUE;
+    }
+
+  *repeated = msg_repeat_state.repeated;
+  *repeated_prio = msg_repeat_state.prio;
+
+  msg_repeat_state_reset();
+  /* messages not fitting into the buffer are never coalesced */
+  if (length < sizeof(msg_repeat_state.text))
+    {
+      memcpy(msg_repeat_state.text, msg, length);
+      msg_repeat_state.length = length;
+      msg_repeat_state.prio = prio;
+    }
+  msg_repeat_state.first_seen = now;
+  g_mutex_unlock(&msg_repeat_lock);
+  return FALSE;
+}
+
+static void
+msg_post_internal_message(MsgContext *context, int prio, const char *msg)
+{
+  LogMessage *m;
+
+  m = log_msg_new_internal(prio, msg);
+  m->recursed = context->recurse_state >= RECURSE_STATE_WATCH;
+  msg_post_message(m);
+}
+
+static void
+msg_post_repeat_count(MsgContext *context, gint prio, guint repeated)
+{
+  gchar buf[64];
+
+  g_snprintf(buf, sizeof(buf), "Last message repeated; count='%u'", repeated);
+  msg_post_internal_message(context, prio, buf);
+}
+
+/* whether msg_send_formatted_message() would send a message with this priority anywhere */
+static inline gboolean
+msg_is_routed(int prio)
+{
+  return log_stderr || msg_post_func || (prio & 0x7) <= EVT_PRI_WARNING;
+}
+
 void
 msg_send_formatted_message(int prio, const char *msg)
 {
@@ -161,18 +279,21 @@ msg_send_formatted_message(int prio, const char *msg)
     }
   else if (msg_post_func)
     {
-      LogMessage *m;
-
       MsgContext *context = msg_get_context();
+      guint repeated;
+      gint repeated_prio;
+
+      if (msg_coalesce_repeated(prio, msg, &repeated, &repeated_prio))
+        return;
 
       if (context->recurse_state == RECURSE_STATE_OK)
         {
           context->recurse_warning = FALSE;
           g_strlcpy(context->recurse_trigger, msg, sizeof(context->recurse_trigger));
         }
-      m = log_msg_new_internal(prio, msg);
-      m->recursed = context->recurse_state >= RECURSE_STATE_WATCH;
-      msg_post_message(m);
+      if (repeated > 0)
+        msg_post_repeat_count(context, repeated_prio, repeated);
+      msg_post_internal_message(context, prio, msg);
     }
 }
 
@@ -189,15 +310,46 @@ msg_send_message_printf(int prio, const gchar *fmt, ...)
   msg_send_formatted_message(prio, buf);
 }
 
+/*
+ * Formats the event into the per-thread buffer.  Formatting an event
+ * while the buffer is in use (e.g. a message emitted while sending the
+ * previous one) falls back to a freshly allocated string.  The result
+ * must be released with msg_event_release_formatted().
+ */
+static gchar *
+msg_event_format(MsgContext *context, EVTREC *e)
+{
+  if (context->format_buffer_busy ||
+      evt_format_into(e, &context->format_buffer, &context->format_buffer_size) < 0)
+    return evt_format(e);
+
+  context->format_buffer_busy = TRUE;
+  return context->format_buffer;
+}
+
+static void
+msg_event_release_formatted(MsgContext *context, gchar *msg)
+{
+  if (msg == context->format_buffer)
+    context->format_buffer_busy = FALSE;
+  else
+    free(msg);
+}
+
 static void
 msg_event_send_with_suppression(EVTREC *e, gboolean (*suppress)(const gchar *msg))
 {
-  gchar *msg;
+  gint prio = evt_rec_get_syslog_pri(e) | EVT_FAC_SYSLOG;
+
+  if (msg_is_routed(prio))
+    {
+      MsgContext *context = msg_get_context();
+      gchar *msg = msg_event_format(context, e);
 
-  msg = evt_format(e);
-  if (!suppress || suppress(msg))
-    msg_send_formatted_message(evt_rec_get_syslog_pri(e) | EVT_FAC_SYSLOG, msg);
-  free(msg);
+      if (msg && (!suppress || suppress(msg)))
+        msg_send_formatted_message(prio, msg);
+      msg_event_release_formatted(context, msg);
+    }
   msg_event_free(e);
 }
 
@@ -216,11 +368,13 @@ msg_event_suppress_recursions_and_send(EVTREC *e)
 void
 msg_event_print_event_to_stderr(EVTREC *e)
 {
+  MsgContext *context = msg_get_context();
   gchar *msg;
 
-  msg = evt_format(e);
-  msg_send_formatted_message_to_stderr(msg);
-  free(msg);
+  msg = msg_event_format(context, e);
+  if (msg)
+    msg_send_formatted_message_to_stderr(msg);
+  msg_event_release_formatted(context, msg);
   msg_event_free(e);
 
 }
@@ -373,6 +527,7 @@ msg_deinit(void)
   evt_ctx_free(evt_context);
   evt_context = NULL;
   log_stderr = TRUE;
+  msg_set_coalesce_repeated_messages(FALSE);
 
   if (g_log_handler_id)
     {
@@ -47,6 +47,7 @@ void msg_event_print_event_to_stderr(EVTREC *e);
 
 
 void msg_set_post_func(MsgPostFunc func);
+void msg_set_coalesce_repeated_messages(gboolean enabled);
 gint msg_map_string_to_log_level(const gchar *log_level);
 void msg_set_log_level(gint new_log_level);
 gint msg_get_log_level(void);
@@ -62,15 +62,85 @@ msg_format_inject_parse_error(LogMessage *msg, const guchar *data, gsize length,
   msg->pri = LOG_SYSLOG | LOG_ERR;
 }
 
+static inline gboolean
+_is_data_in_input_chunk(GBytes *input_chunk, const guchar *data, gsize length)
+{
+  gsize chunk_len;
+  const guchar *chunk = g_bytes_get_data(input_chunk, &chunk_len);
+
+  return data >= chunk && data + length <= chunk + chunk_len;
+}
+
 static void
 msg_format_preprocess_message(MsgFormatOptions *options, LogMessage *msg,
                               const guchar *data, gsize length)
 {
   if (options->flags & LP_STORE_RAW_MESSAGE)
     {
-      log_msg_set_value(msg, LOG_MSG_GET_VALUE_HANDLE_STATIC("RAWMSG"),
-                        (gchar *) data, _rstripped_message_length(data, length));
+      NVHandle rawmsg_handle = LOG_MSG_GET_VALUE_HANDLE_STATIC("RAWMSG");
+      gsize rawmsg_len = _rstripped_message_length(data, length);
+
+      GBytes *existing_chunk = log_msg_get_input_chunk(msg);
+      if (existing_chunk && rawmsg_len > 0 && _is_data_in_input_chunk(existing_chunk, data, rawmsg_len))
+        {
+          /* the input was read into a buffer of its own by the LogProtoServer */
+          log_msg_set_value_borrowed(msg, rawmsg_handle, (const gchar *) data, rawmsg_len);
+          return;
+        }
+
+      if (rawmsg_len == 0 || existing_chunk)
+        {
+          log_msg_set_value(msg, rawmsg_handle, (gchar *) data, rawmsg_len);
+          return;
+        }
+
+      /* The LogProtoServer could not share the buffer it read the message
+       * into (e.g. datagram sources or input converted from another
+       * encoding), so the raw message is copied once, into an input chunk
+       * of its own.  $RAWMSG is borrowed from that chunk, so that it is not
+       * copied again each time the payload is cloned. */
+      GBytes *input_chunk = g_bytes_new(data, rawmsg_len);
+      log_msg_set_input_chunk(msg, input_chunk);
+      log_msg_set_value_borrowed(msg, rawmsg_handle, g_bytes_get_data(input_chunk, NULL), rawmsg_len);
+      g_bytes_unref(input_chunk);
+    }
+}
+
+/*
+ * raw-relay: the message is not parsed at all, the input is stored
+ * unchanged (including any trailing newline) in $RAWMSG and $MSG, both are
+ * borrowed from the input chunk so the bytes are held only once.  Paired
+ * with the raw-relay flag of the destination, the input is forwarded
+ * without ever being templated.
+ */
+static void
+msg_format_store_raw_relay_message(MsgFormatOptions *options, LogMessage *msg,
+                                   const guchar *data, gsize length)
+{
+  NVHandle rawmsg_handle = LOG_MSG_GET_VALUE_HANDLE_STATIC("RAWMSG");
+  GBytes *input_chunk = log_msg_get_input_chunk(msg);
+
+  msg->pri = options->default_pri;
+  if (length == 0)
+    return;
+
+  if (!input_chunk)
+    {
+      GBytes *copy = g_bytes_new(data, length);
+
+      log_msg_set_input_chunk(msg, copy);
+      g_bytes_unref(copy);
+      data = g_bytes_get_data(log_msg_get_input_chunk(msg), NULL);
+    }
+  else if (!_is_data_in_input_chunk(input_chunk, data, length))
+    {
+      log_msg_set_value(msg, rawmsg_handle, (const gchar *) data, length);
+      log_msg_set_value(msg, LM_V_MESSAGE, (const gchar *) data, length);
+      return;
     }
+
+  log_msg_set_value_borrowed(msg, rawmsg_handle, (const gchar *) data, length);
+  log_msg_set_value_borrowed(msg, LM_V_MESSAGE, (const gchar *) data, length);
 }
 
 static void
@@ -125,6 +195,12 @@ msg_format_try_parse_into(MsgFormatOptions *options, LogMessage *msg,
                           const guchar *data, gsize length,
                           gsize *problem_position)
 {
+  if (options->flags & LP_RAW_RELAY)
+    {
+      msg_format_store_raw_relay_message(options, msg, data, length);
+      return TRUE;
+    }
+
   if (G_UNLIKELY(!options->format_handler))
     {
       gchar buf[256];
@@ -163,10 +239,13 @@ _determine_payload_size(MsgFormatOptions *parse_options, const guchar *data, gsi
 {
   gsize payload_size;
 
-  if ((parse_options->flags & LP_STORE_RAW_MESSAGE))
-    payload_size = length * 4;
-  else
-    payload_size = length * 2;
+  /* raw-relay messages only hold borrowed values */
+  if (parse_options->flags & LP_RAW_RELAY)
+    return 256;
+
+  /* $RAWMSG is borrowed from the input chunk, it does not need space in
+   * the payload */
+  payload_size = length * 2;
 
   return MAX(payload_size, 256);
 }
@@ -293,6 +372,8 @@ CfgFlagHandler msg_format_flag_handlers[] =
   { "guess-timezone",             CFH_SET, offsetof(MsgFormatOptions, flags), LP_GUESS_TIMEZONE },
   { "no-header",                  CFH_SET, offsetof(MsgFormatOptions, flags), LP_NO_HEADER },
   { "no-rfc3164-fallback",        CFH_SET, offsetof(MsgFormatOptions, flags), LP_NO_RFC3164_FALLBACK },
+  { "lazy-sdata",                 CFH_SET, offsetof(MsgFormatOptions, flags), LP_LAZY_SDATA },
+  { "raw-relay",                  CFH_SET, offsetof(MsgFormatOptions, flags), LP_RAW_RELAY },
   { NULL },
 };
 
@@ -59,6 +59,10 @@ enum
   LP_GUESS_TIMEZONE = 0x1000,
   LP_NO_HEADER = 0x2000,
   LP_NO_RFC3164_FALLBACK = 0x4000,
+  /* don't parse the SDATA block until the first SDATA value is accessed */
+  LP_LAZY_SDATA = 0x8000,
+  /* don't parse or preprocess the message, keep the input unchanged in $RAWMSG (and $MSG) for relaying */
+  LP_RAW_RELAY = 0x10000,
 };
 
 typedef struct _MsgFormatHandler MsgFormatHandler;
@@ -109,4 +113,11 @@ void msg_format_options_copy(MsgFormatOptions *options, const MsgFormatOptions *
 
 gboolean msg_format_options_process_flag(MsgFormatOptions *options, const gchar *flag);
 
+/* $RAWMSG (and $MSG with raw-relay) is borrowed from the input chunk of the message */
+static inline gboolean
+msg_format_options_borrows_input(const MsgFormatOptions *options)
+{
+  return !!(options->flags & (LP_STORE_RAW_MESSAGE | LP_RAW_RELAY));
+}
+
 #endif
@@ -55,8 +55,8 @@ msg_stats_update_counters(const gchar *source_id, const LogMessage *msg)
   if (stats_syslog_stats() == CYNA_YES
       || (stats_syslog_stats() == CYNA_AUTO && stats_check_level(2)))
     {
-      stats_lock();
-
+      /* dynamic counters are registered under the lock of their own
+       * shard, no need for stats_lock() here */
       StatsClusterKey sc_key;
       stats_cluster_logpipe_key_legacy_set(&sc_key, SCS_HOST | SCS_SOURCE, NULL, log_msg_get_value(msg, LM_V_HOST, NULL) );
       stats_register_and_increment_dynamic_counter(0, &sc_key, msg->timestamps[LM_TS_RECVD].ut_sec);
@@ -78,8 +78,6 @@ msg_stats_update_counters(const gchar *source_id, const LogMessage *msg)
                                                NULL));
           stats_register_and_increment_dynamic_counter(0, &sc_key, msg->timestamps[LM_TS_RECVD].ut_sec);
         }
-
-      stats_unlock();
     }
   _process_message_pri(msg->pri);
 }
@@ -46,6 +46,7 @@ typedef struct _SmartMultiLine
 {
   MultiLineLogic super;
   GMutex lock;
+  pcre2_match_data *match_data;
   gint current_state;
   gboolean last_segment_rewound;
   gboolean rewound_segment_is_trace;
@@ -57,6 +58,66 @@ gint last_state_id = SMLS_START_STATE;
 GArray *rules;
 GPtrArray *rules_by_from_state[64];
 
+/* The rules of each state combined into a single pattern, so that a
+ * segment is matched once per state instead of once per rule:
+ *
+ *    \A(?:(?=(?s:.*?)(?:rule0))(*MARK:0)|(?=(?s:.*?)(?:rule1))(*MARK:1)|...)
+ *
+ * Each alternative searches the segment for one rule, like the rule would
+ * on its own, the alternatives are attempted in their order in the .fsm
+ * file and the MARK tells which one matched.  Anchored rules skip the
+ * search prefix.  NULL if the combined pattern fails to compile (e.g. a
+ * rule uses back references), in which case we try the rules one by one.
+ */
+MultiLinePattern *combined_rules_by_from_state[G_N_ELEMENTS(rules_by_from_state)];
+
+static gboolean
+_is_rule_anchored(SmartMultiLineRule *rule)
+{
+  guint32 options;
+
+  return pcre2_pattern_info(rule->compiled_regexp->pattern, PCRE2_INFO_ALLOPTIONS, &options) == 0 &&
+         (options & PCRE2_ANCHORED);
+}
+
+static MultiLinePattern *
+_compile_combined_rules(GPtrArray *state_rules)
+{
+  GString *combined = g_string_new("\\A(?:");
+  GError *error = NULL;
+
+  for (gint i = 0; i < state_rules->len; i++)
+    {
+      SmartMultiLineRule *rule = g_ptr_array_index(state_rules, i);
+      const gchar *search_prefix = _is_rule_anchored(rule) ? "" : "(?s:.*?)";
+
+      if (i > 0)
+        g_string_append_c(combined, '|');
+      g_string_append_printf(combined, "(?=%s(?:%s))(*MARK:%d)", search_prefix, rule->regexp, i);
+    }
+  g_string_append_c(combined, ')');
+
+  MultiLinePattern *pattern = multi_line_pattern_compile(combined->str, &error);
+  if (!pattern)
+    {
+      msg_debug("smart-multi-line: unable to combine the rules of a state, matching them one by one",
+                evt_tag_str("error", error->message));
+      g_clear_error(&error);
+    }
+  g_string_free(combined, TRUE);
+  return pattern;
+}
+
+static void
+_combine_rules_by_from_state(void)
+{
+  for (gint state_ndx = 0; state_ndx < G_N_ELEMENTS(rules_by_from_state); state_ndx++)
+    {
+      if (rules_by_from_state[state_ndx])
+        combined_rules_by_from_state[state_ndx] = _compile_combined_rules(rules_by_from_state[state_ndx]);
+    }
+}
+
 static void
 _reshuffle_rules_by_from_state(void)
 {
@@ -203,6 +264,7 @@ _load_rules(const gchar *sml_file_name)
   rules = g_array_new(FALSE, TRUE, sizeof(SmartMultiLineRule));
   _load_tsv_file(sml_file_name);
   _reshuffle_rules_by_from_state();
+  _combine_rules_by_from_state();
   if (state_map)
     {
       g_hash_table_unref(state_map);
@@ -227,6 +289,8 @@ _free_rules(void)
           g_ptr_array_free(rules_by_from_state[state_ndx], TRUE);
           rules_by_from_state[state_ndx] = NULL;
         }
+      multi_line_pattern_unref(combined_rules_by_from_state[state_ndx]);
+      combined_rules_by_from_state[state_ndx] = NULL;
     }
 
   for (gint rule_ndx = 0; rule_ndx < rules->len; rule_ndx++)
@@ -240,24 +304,55 @@ _free_rules(void)
   rules = NULL;
 }
 
-gboolean
-_fsm_transition(SmartMultiLine *self, const gchar *segment, gsize segment_len)
+static SmartMultiLineRule *
+_find_matching_rule_combined(SmartMultiLine *self, GPtrArray *applicable_rules, MultiLinePattern *combined,
+                             const gchar *segment, gsize segment_len)
 {
-  GPtrArray *applicable_rules = rules_by_from_state[self->current_state];
+  if (multi_line_pattern_eval(combined, (const guchar *) segment, segment_len, self->match_data) < 0)
+    return NULL;
 
-  for (gint i = 0; applicable_rules && i < applicable_rules->len; i++)
+  const gchar *mark = (const gchar *) pcre2_get_mark(self->match_data);
+  g_assert(mark);
+
+  return g_ptr_array_index(applicable_rules, atoi(mark));
+}
+
+static SmartMultiLineRule *
+_find_matching_rule_one_by_one(SmartMultiLine *self, GPtrArray *applicable_rules,
+                               const gchar *segment, gsize segment_len)
+{
+  for (gint i = 0; i < applicable_rules->len; i++)
     {
       SmartMultiLineRule *rule = g_ptr_array_index(applicable_rules, i);
-      gboolean match = multi_line_pattern_match(rule->compiled_regexp, (const guchar *) segment, segment_len);
+      gboolean match = multi_line_pattern_eval(rule->compiled_regexp, (const guchar *) segment, segment_len,
+                                               self->match_data) >= 0;
 
       msg_trace_printf("smart-multi-line: Matching against pattern: %s in state %d, matched %d", rule->regexp,
                        self->current_state, match);
       if (match)
-        {
-          self->current_state = rule->to_state;
-          /* the current segment is part of a sequence */
-          return TRUE;
-        }
+        return rule;
+    }
+  return NULL;
+}
+
+gboolean
+_fsm_transition(SmartMultiLine *self, const gchar *segment, gsize segment_len)
+{
+  GPtrArray *applicable_rules = rules_by_from_state[self->current_state];
+  MultiLinePattern *combined = combined_rules_by_from_state[self->current_state];
+  SmartMultiLineRule *rule = NULL;
+
+  if (applicable_rules && combined)
+    rule = _find_matching_rule_combined(self, applicable_rules, combined, segment, segment_len);
+  else if (applicable_rules)
+    rule = _find_matching_rule_one_by_one(self, applicable_rules, segment, segment_len);
+
+  if (rule)
+    {
+      msg_trace_printf("smart-multi-line: Matched pattern: %s in state %d", rule->regexp, self->current_state);
+      self->current_state = rule->to_state;
+      /* the current segment is part of a sequence */
+      return TRUE;
     }
   self->current_state = SMLS_START_STATE;
   return FALSE;
@@ -422,6 +517,7 @@ _free(MultiLineLogic *s)
 {
   SmartMultiLine *self = (SmartMultiLine *) s;
   g_mutex_clear(&self->lock);
+  pcre2_match_data_free(self->match_data);
   multi_line_logic_free_method(s);
 }
 
@@ -435,6 +531,7 @@ smart_multi_line_new(void)
   self->super.accumulate_line = _accumulate_line;
   self->last_segment_rewound = FALSE;
   self->current_state = SMLS_START_STATE;
+  self->match_data = pcre2_match_data_create(1, NULL);
   g_mutex_init(&self->lock);
 
   return &self->super;
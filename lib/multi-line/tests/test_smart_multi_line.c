@@ -22,6 +22,7 @@
 #include <criterion/criterion.h>
 
 #include "multi-line/smart-multi-line.h"
+#include "multi-line/multi-line-pattern.h"
 #include "scratch-buffers.h"
 #include "apphook.h"
 #include "cfg.h"
@@ -667,6 +668,77 @@ Test(smart_multi_line, test_dart_backtrace)
   multi_line_logic_free(mll);
 }
 
+/* the rule tables of smart-multi-line.c */
+extern GPtrArray *rules_by_from_state[64];
+extern MultiLinePattern *combined_rules_by_from_state[64];
+
+Test(smart_multi_line, test_the_rules_of_every_state_are_combined)
+{
+  for (gint i = 0; i < G_N_ELEMENTS(rules_by_from_state); i++)
+    {
+      if (rules_by_from_state[i])
+        cr_assert_not_null(combined_rules_by_from_state[i], "the rules of state %d are matched one by one", i);
+      else
+        cr_assert_null(combined_rules_by_from_state[i]);
+    }
+}
+
+static GPtrArray *
+_feed_lines_and_take_output(const gchar *messages[])
+{
+  MultiLineLogic *mll = smart_multi_line_new();
+  GPtrArray *result;
+
+  _feed_lines(mll, messages);
+  multi_line_logic_free(mll);
+
+  result = output_messages;
+  output_messages = g_ptr_array_new();
+  g_string_truncate(buffer, 0);
+  return result;
+}
+
+Test(smart_multi_line, test_combined_rules_group_lines_like_rules_matched_one_by_one)
+{
+  const gchar *messages[] =
+  {
+    "an unrelated line",
+    "Traceback (most recent call last):",
+    "File \"./lib/merge-grammar.py\", line 62, in <module>",
+    "  for line in fileinput.input(openhook=fileinput.hook_encoded(\"utf-8\")):",
+    "ValueError: whatever exception that happened",
+    "java.lang.RuntimeException: javax.mail.SendFailedException: Invalid Addresses;",
+    "  nested exception is:",
+    "com.sun.mail.smtp.SMTPAddressFailedException: 550 5.7.1 Relaying denied",
+    "\tat java.util.Optional.ifPresent(Optional.java:159)",
+    "Caused by: javax.mail.SendFailedException: Invalid Addresses;",
+    "\t... 12 more",
+    "another unrelated line",
+    "Traceback (most recent call last):",
+    "  not a frame of the traceback",
+    NULL,
+  };
+  MultiLinePattern *combined[G_N_ELEMENTS(combined_rules_by_from_state)];
+
+  GPtrArray *combined_output = _feed_lines_and_take_output(messages);
+
+  memcpy(combined, combined_rules_by_from_state, sizeof(combined));
+  memset(combined_rules_by_from_state, 0, sizeof(combined_rules_by_from_state));
+  GPtrArray *one_by_one_output = _feed_lines_and_take_output(messages);
+  memcpy(combined_rules_by_from_state, combined, sizeof(combined));
+
+  cr_assert_gt(combined_output->len, 3, "the lines are not grouped into several messages");
+  cr_assert_eq(combined_output->len, one_by_one_output->len);
+  for (gint i = 0; i < combined_output->len; i++)
+    cr_assert_str_eq(g_ptr_array_index(combined_output, i), g_ptr_array_index(one_by_one_output, i),
+                     "message #%d is grouped differently", i);
+
+  g_ptr_array_foreach(combined_output, (GFunc) g_free, NULL);
+  g_ptr_array_free(combined_output, TRUE);
+  g_ptr_array_foreach(one_by_one_output, (GFunc) g_free, NULL);
+  g_ptr_array_free(one_by_one_output, TRUE);
+}
+
 
 void
 setup(void)
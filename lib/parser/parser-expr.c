@@ -25,6 +25,7 @@
 #include "parser/parser-expr.h"
 #include "template/templates.h"
 #include "logmatcher.h"
+#include "logmsg/logmsg-trace.h"
 
 #include <string.h>
 
@@ -48,9 +49,13 @@ log_parser_process_message(LogParser *self, LogMessage **pmsg, const LogPathOpti
 {
   LogMessage *msg = *pmsg;
   gboolean success;
+  RuleProfileSample sample;
 
+  rule_profile_begin(self->profile, &sample);
   if (G_LIKELY(!self->template_obj))
     {
+      /* parse lazy SDATA first, as that would replace the payload we reference */
+      log_msg_ensure_sdata_parsed(msg);
       NVTable *payload = nv_table_ref(msg->payload);
       const gchar *value;
       gssize value_len;
@@ -76,6 +81,7 @@ log_parser_process_message(LogParser *self, LogMessage **pmsg, const LogPathOpti
       success = self->process(self, pmsg, path_options, input->str, input->len);
       g_string_free(input, TRUE);
     }
+  rule_profile_end(self->profile, &sample, success);
 
   if (!success)
     stats_counter_inc(self->super.discarded_messages);
@@ -102,6 +108,7 @@ log_parser_queue_method(LogPipe *s, LogMessage *msg, const LogPathOptions *path_
   if (success)
     {
       parser_result = "Forwarding message to the next LogPipe";
+      log_msg_trace_stamp(msg, LM_TRACE_PROCESSED);
       log_pipe_forward_msg(s, msg, path_options);
     }
   else
@@ -144,6 +151,9 @@ log_parser_init_method(LogPipe *s)
 
   _register_counters(self);
 
+  rule_profile_unref(self->profile);
+  self->profile = rule_profile_get("parser", self->name, s);
+
   return TRUE;
 }
 
@@ -167,6 +177,9 @@ log_parser_deinit_method(LogPipe *s)
 
   _unregister_stats(self);
 
+  rule_profile_unref(self->profile);
+  self->profile = NULL;
+
   return TRUE;
 }
 
@@ -175,6 +188,7 @@ log_parser_free_method(LogPipe *s)
 {
   LogParser *self = (LogParser *) s;
 
+  rule_profile_unref(self->profile);
   g_free(self->name);
   log_template_unref(self->template_obj);
   log_pipe_free_method(s);
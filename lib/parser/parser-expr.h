@@ -30,6 +30,7 @@
 #include "logpipe.h"
 #include "template/templates.h"
 #include "stats/stats-registry.h"
+#include "rule-profiler.h"
 #include <string.h>
 
 typedef struct _LogParser LogParser;
@@ -42,6 +43,7 @@ struct _LogParser
   gboolean (*process)(LogParser *s, LogMessage **pmsg, const LogPathOptions *path_options, const gchar *input,
                       gsize input_len);
   gchar *name;
+  RuleProfile *profile;
 };
 
 gboolean log_parser_deinit_method(LogPipe *s);
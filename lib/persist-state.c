@@ -40,6 +40,9 @@
 #define PERSIST_STATE_KEY_BLOCK_SIZE 4096
 #define PERSIST_FILE_MAX_ENTRY_SIZE 8448
 
+/* address space reserved for the mapping, see _grow_store() */
+#define PERSIST_FILE_RESERVED_MAP_SIZE (256 * 1024 * 1024)
+
 /*
  * The syslog-ng persistent state is a set of name-value pairs,
  * updated atomically during syslog-ng runtime. When syslog-ng
@@ -106,6 +109,18 @@
  * blindly without checking. However when reading the same value from
  * the file you need to check it whether it is inside the mapped file.
  *
+ * Growing:
+ * --------
+ *
+ * The file is mapped into an address range reserved up front, so growing
+ * it only maps the new tail right after the existing mapping.  Entries
+ * never move, which means that the file can grow while other threads
+ * have entries mapped.  Mapping an entry is a single atomic increment.
+ *
+ * If the address range cannot be reserved, or the file outgrows it, the
+ * file is remapped as a whole when it grows, which has to wait until all
+ * entries are unmapped.
+ *
  */
 
 /* everything is big-endian */
@@ -123,7 +138,7 @@ static void
 _wait_until_map_release(PersistState *self)
 {
   g_mutex_lock(&self->mapped_lock);
-  while (self->mapped_counter)
+  while (g_atomic_int_get(&self->mapped_counter))
     g_cond_wait(&self->mapped_release_cond, &self->mapped_lock);
 }
 
@@ -146,19 +161,107 @@ _increase_file_size(PersistState *self, guint32 new_size)
   return result;
 }
 
+static void
+_reserve_map(PersistState *self)
+{
+  gint flags = MAP_PRIVATE | MAP_ANONYMOUS;
+#ifdef MAP_NORESERVE
+  flags |= MAP_NORESERVE;
+#endif
+
+  gpointer reserved = mmap(NULL, PERSIST_FILE_RESERVED_MAP_SIZE, PROT_NONE, flags, -1, 0);
+  if (reserved == MAP_FAILED)
+    {
+      msg_debug("Unable to reserve address space for the persist file, growing it will remap the file",
+                evt_tag_error("error"));
+      return;
+    }
+
+  self->current_map = reserved;
+  self->reserved_size = PERSIST_FILE_RESERVED_MAP_SIZE;
+}
+
+/*
+ * Falls back to remapping the file as a whole.  From here on,
+ * persist_state_map_entry() goes through mapped_lock, and the remap waits
+ * for the entries mapped before the switch.  The unused part of the
+ * reserved range is given back right away, so current_map only covers the
+ * file afterwards.
+ */
+static void
+_release_reserved_map(PersistState *self, guint32 new_size)
+{
+  msg_debug("The persist file outgrew its reserved address space, it is remapped from now on",
+            evt_tag_int("new_size", new_size),
+            evt_tag_int("reserved_size", self->reserved_size));
+
+  gint reserved_size = self->reserved_size;
+  g_atomic_int_set(&self->reserved_size, 0);
+
+  if (self->current_size)
+    munmap(((gchar *) self->current_map) + self->current_size, reserved_size - self->current_size);
+  else
+    {
+      munmap(self->current_map, reserved_size);
+      self->current_map = NULL;
+    }
+}
+
+/* maps the new tail of the file after the existing mapping, the already mapped part is left in place */
+static gboolean
+_grow_reserved_store(PersistState *self, guint32 new_size)
+{
+  if (!_increase_file_size(self, new_size))
+    return FALSE;
+
+  gchar *tail = ((gchar *) self->current_map) + self->current_size;
+  if (mmap(tail, new_size - self->current_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED,
+           self->fd, self->current_size) == MAP_FAILED)
+    {
+      msg_error("Can't map the grown persist file",
+                evt_tag_int("new_size", new_size),
+                evt_tag_error("error"));
+      return FALSE;
+    }
+
+  if (self->current_size == 0)
+    {
+      self->header = (PersistFileHeader *) self->current_map;
+      memcpy(&self->header->magic, "SLP4", 4);
+    }
+
+  /* the new tail is visible to other threads only through handles handed out after this */
+  self->current_size = new_size;
+  return TRUE;
+}
+
 static gboolean
 _grow_store(PersistState *self, guint32 new_size)
 {
   int pgsize = getpagesize();
   gboolean result = FALSE;
 
-  _wait_until_map_release(self);
-
   if ((new_size & (pgsize-1)) != 0)
     {
       new_size = ((new_size / pgsize) + 1) * pgsize;
     }
 
+  if (!self->current_map)
+    _reserve_map(self);
+
+  if (g_atomic_int_get(&self->reserved_size))
+    {
+      if (new_size <= self->current_size)
+        return TRUE;
+
+      if (new_size <= self->reserved_size)
+        return _grow_reserved_store(self, new_size);
+
+      _release_reserved_map(self, new_size);
+    }
+
+  _wait_until_map_release(self);
+
   if (new_size > self->current_size)
     {
       if (!_increase_file_size(self, new_size))
@@ -724,18 +827,28 @@ close_and_exit:
  *
  * NOTE: it is not safe to keep an entry mapped while synchronizing with the
  * main thread (e.g.  mutexes, condvars, main_loop_call()), because
- * map_entry() may block the main thread in _grow_store().
+ * map_entry() may block the main thread in _grow_store(), if the address
+ * range of the file could not be reserved.
  **/
 gpointer
 persist_state_map_entry(PersistState *self, PersistEntryHandle handle)
 {
-  /* we count the number of mapped entries in order to know if we're
-   * safe to remap the file region */
   g_assert(handle);
+
+  /* we count the number of mapped entries in order to know if we're
+   * safe to remap the file region.  The counter is incremented before
+   * checking the mode, so a switch to remapping either sees this entry or
+   * this thread sees the switch. */
+  g_atomic_int_inc(&self->mapped_counter);
+
+  /* the mapping never moves */
+  if (g_atomic_int_get(&self->reserved_size))
+    return (gpointer) (((gchar *) self->current_map) + (guint32) handle);
+
   g_mutex_lock(&self->mapped_lock);
-  self->mapped_counter++;
+  gpointer entry = (gpointer) (((gchar *) self->current_map) + (guint32) handle);
   g_mutex_unlock(&self->mapped_lock);
-  return (gpointer) (((gchar *) self->current_map) + (guint32) handle);
+  return entry;
 }
 
 /*
@@ -744,14 +857,18 @@ persist_state_map_entry(PersistState *self, PersistEntryHandle handle)
 void
 persist_state_unmap_entry(PersistState *self, PersistEntryHandle handle)
 {
-  g_mutex_lock(&self->mapped_lock);
-  g_assert(self->mapped_counter >= 1);
-  self->mapped_counter--;
-  if (self->mapped_counter == 0)
+  g_assert(g_atomic_int_get(&self->mapped_counter) >= 1);
+
+  if (!g_atomic_int_dec_and_test(&self->mapped_counter))
+    return;
+
+  /* a remap may be waiting for the last entry, see _wait_until_map_release() */
+  if (!g_atomic_int_get(&self->reserved_size))
     {
+      g_mutex_lock(&self->mapped_lock);
       g_cond_signal(&self->mapped_release_cond);
+      g_mutex_unlock(&self->mapped_lock);
     }
-  g_mutex_unlock(&self->mapped_lock);
 }
 
 static PersistValueHeader *
@@ -976,13 +1093,13 @@ static void
 _destroy(PersistState *self)
 {
   g_mutex_lock(&self->mapped_lock);
-  g_assert(self->mapped_counter == 0);
+  g_assert(g_atomic_int_get(&self->mapped_counter) == 0);
   g_mutex_unlock(&self->mapped_lock);
 
   if (self->fd >= 0)
     close(self->fd);
   if (self->current_map)
-    munmap(self->current_map, self->current_size);
+    munmap(self->current_map, self->reserved_size ? : self->current_size);
   unlink(self->temp_filename);
 
   g_mutex_clear(&self->mapped_lock);
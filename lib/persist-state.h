@@ -75,6 +75,8 @@ struct _PersistState
   guint32 current_size;
   guint32 current_ofs;
   gpointer current_map;
+  /* the size of the address range reserved for current_map, 0 if it is remapped on growth */
+  gint reserved_size;
   PersistFileHeader *header;
   PersistStateErrorHandler error_handler;
 
@@ -30,6 +30,7 @@
 
 #include <gmodule.h>
 #include <string.h>
+#include <sys/stat.h>
 
 #ifdef _AIX
 #undef G_MODULE_SUFFIX
@@ -440,6 +441,223 @@ plugin_is_plugin_available(PluginContext *context, gint plugin_type, const gchar
 }
 
 
+/************************************************************
+ * Module metadata cache
+ ************************************************************/
+
+/*
+ * Discovery needs the list of plugins each module provides, which means
+ * dlopen()-ing every shared object on the module path (pulling in its
+ * dependencies and running its constructors) just to read module_info.
+ *
+ * The result is cached per shared object, keyed by its stat() identity,
+ * in memory (so reloads do not repeat it) and in the module cache file (so
+ * startup does not either).  Only new or modified modules are opened.
+ * Modules that fail to open are not cached, as installing a missing
+ * dependency makes them loadable without touching the .so itself.
+ */
+
+#define MODULE_CACHE_HEADER "# syslog-ng module cache " SYSLOG_NG_COMBINED_VERSION " " SYSLOG_NG_SOURCE_REVISION
+
+typedef struct _ModuleCacheEntry
+{
+  dev_t dev;
+  ino_t ino;
+  off_t size;
+  time_t mtime;
+  time_t ctime;
+  /* PluginCandidate instances, module_name is not used */
+  GList *plugins;
+} ModuleCacheEntry;
+
+static GHashTable *module_cache;
+static gboolean module_cache_dirty;
+
+static void
+_module_cache_entry_free(ModuleCacheEntry *self)
+{
+  g_list_free_full(self->plugins, (GDestroyNotify) plugin_candidate_free);
+  g_free(self);
+}
+
+static gboolean
+_module_cache_entry_matches(ModuleCacheEntry *self, struct stat *st)
+{
+  return self->dev == st->st_dev && self->ino == st->st_ino && self->size == st->st_size &&
+         self->mtime == st->st_mtime && self->ctime == st->st_ctime;
+}
+
+static void
+_module_cache_entry_set_stat(ModuleCacheEntry *self, struct stat *st)
+{
+  self->dev = st->st_dev;
+  self->ino = st->st_ino;
+  self->size = st->st_size;
+  self->mtime = st->st_mtime;
+  self->ctime = st->st_ctime;
+}
+
+static ModuleCacheEntry *
+_module_cache_parse_line(gchar *line, gchar **path)
+{
+  gchar **fields = g_strsplit(line, "\t", 0);
+  ModuleCacheEntry *entry = NULL;
+
+  if (g_strv_length(fields) != 7)
+    goto exit;
+
+  entry = g_new0(ModuleCacheEntry, 1);
+  entry->dev = g_ascii_strtoull(fields[1], NULL, 10);
+  entry->ino = g_ascii_strtoull(fields[2], NULL, 10);
+  entry->size = g_ascii_strtoll(fields[3], NULL, 10);
+  entry->mtime = g_ascii_strtoll(fields[4], NULL, 10);
+  entry->ctime = g_ascii_strtoll(fields[5], NULL, 10);
+
+  gchar **plugins = g_strsplit(fields[6], " ", 0);
+  for (gint i = 0; plugins[i]; i++)
+    {
+      gchar *name;
+      gint type = g_ascii_strtoll(plugins[i], &name, 10);
+
+      if (*name != ':' || !name[1])
+        continue;
+      entry->plugins = g_list_prepend(entry->plugins, plugin_candidate_new(type, name + 1, NULL));
+    }
+  entry->plugins = g_list_reverse(entry->plugins);
+  g_strfreev(plugins);
+  *path = g_strdup(fields[0]);
+
+exit:
+  g_strfreev(fields);
+  return entry;
+}
+
+static void
+_module_cache_load(const gchar *filename)
+{
+  gchar *contents;
+
+  if (!filename || !g_file_get_contents(filename, &contents, NULL, NULL))
+    return;
+
+  gchar **lines = g_strsplit(contents, "\n", 0);
+  if (lines[0] && strcmp(lines[0], MODULE_CACHE_HEADER) == 0)
+    {
+      for (gint i = 1; lines[i]; i++)
+        {
+          gchar *path;
+          ModuleCacheEntry *entry = _module_cache_parse_line(lines[i], &path);
+
+          if (entry)
+            g_hash_table_insert(module_cache, path, entry);
+        }
+    }
+  else
+    {
+      msg_debug("Ignoring module cache written by a different syslog-ng build",
+                evt_tag_str("filename", filename));
+    }
+  g_strfreev(lines);
+  g_free(contents);
+}
+
+static void
+_module_cache_format_entry(const gchar *path, ModuleCacheEntry *entry, GString *contents)
+{
+  if (strpbrk(path, "\t\n"))
+    return;
+
+  g_string_append_printf(contents, "%s\t%" G_GUINT64_FORMAT "\t%" G_GUINT64_FORMAT "\t%" G_GINT64_FORMAT
+                         "\t%" G_GINT64_FORMAT "\t%" G_GINT64_FORMAT "\t",
+                         path, (guint64) entry->dev, (guint64) entry->ino, (gint64) entry->size,
+                         (gint64) entry->mtime, (gint64) entry->ctime);
+  for (GList *l = entry->plugins; l; l = l->next)
+    {
+      PluginCandidate *pc = (PluginCandidate *) l->data;
+
+      g_string_append_printf(contents, "%s%d:%s", l == entry->plugins ? "" : " ", pc->super.type, pc->super.name);
+    }
+  g_string_append_c(contents, '\n');
+}
+
+static void
+_module_cache_save(const gchar *filename)
+{
+  GError *error = NULL;
+
+  if (!filename || !module_cache_dirty)
+    return;
+
+  GString *contents = g_string_new(MODULE_CACHE_HEADER "\n");
+  g_hash_table_foreach(module_cache, (GHFunc) _module_cache_format_entry, contents);
+  if (!g_file_set_contents(filename, contents->str, contents->len, &error))
+    {
+      msg_debug("Error writing module cache",
+                evt_tag_str("filename", filename),
+                evt_tag_str("error", error->message));
+      g_clear_error(&error);
+    }
+  module_cache_dirty = FALSE;
+  g_string_free(contents, TRUE);
+}
+
+static ModuleCacheEntry *
+_module_cache_scan(const gchar *path, const gchar *module_name, struct stat *st)
+{
+  GModule *mod = _dlopen_module_as_filename(path, module_name);
+
+  if (!mod)
+    return NULL;
+
+  ModuleCacheEntry *entry = g_new0(ModuleCacheEntry, 1);
+  _module_cache_entry_set_stat(entry, st);
+
+  ModuleInfo *module_info = _get_module_info(mod);
+  for (gint j = 0; module_info && j < module_info->plugins_len; j++)
+    {
+      Plugin *plugin = &module_info->plugins[j];
+
+      entry->plugins = g_list_prepend(entry->plugins, plugin_candidate_new(plugin->type, plugin->name, NULL));
+    }
+  entry->plugins = g_list_reverse(entry->plugins);
+  g_module_close(mod);
+
+  g_hash_table_insert(module_cache, g_strdup(path), entry);
+  module_cache_dirty = TRUE;
+  return entry;
+}
+
+static ModuleCacheEntry *
+_module_cache_lookup(const gchar *path, const gchar *module_name)
+{
+  struct stat st;
+
+  if (!module_cache)
+    {
+      module_cache = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+                                           (GDestroyNotify) _module_cache_entry_free);
+      _module_cache_load(resolved_configurable_paths.module_cache_file);
+    }
+
+  if (stat(path, &st) < 0)
+    return NULL;
+
+  ModuleCacheEntry *entry = g_hash_table_lookup(module_cache, path);
+  if (entry && _module_cache_entry_matches(entry, &st))
+    return entry;
+
+  return _module_cache_scan(path, module_name, &st);
+}
+
+void
+plugin_global_deinit(void)
+{
+  if (module_cache)
+    g_hash_table_destroy(module_cache);
+  module_cache = NULL;
+  module_cache_dirty = FALSE;
+}
+
 /************************************************************
  * Candidate modules
  ************************************************************/
@@ -458,12 +676,40 @@ plugin_has_discovery_run(PluginContext *context)
   return context->candidate_plugins != NULL;
 }
 
+static void
+_register_candidate_plugin(PluginContext *context, PluginCandidate *plugin, const gchar *module_name)
+{
+  PluginCandidate *candidate_plugin;
+
+  candidate_plugin = (PluginCandidate *) _find_plugin_in_list(context->candidate_plugins, plugin->super.type,
+                                                              plugin->super.name);
+
+  msg_debug("Registering candidate plugin",
+            evt_tag_str("module", module_name),
+            evt_tag_str("context", cfg_lexer_lookup_context_name_by_type(plugin->super.type)),
+            evt_tag_str("name", plugin->super.name));
+  if (candidate_plugin)
+    {
+      msg_debug("Duplicate plugin candidate, overriding previous registration with the new one",
+                evt_tag_str("old-module", candidate_plugin->module_name),
+                evt_tag_str("new-module", module_name),
+                evt_tag_str("context", cfg_lexer_lookup_context_name_by_type(plugin->super.type)),
+                evt_tag_str("name", plugin->super.name));
+      plugin_candidate_set_module_name(candidate_plugin, module_name);
+    }
+  else
+    {
+      context->candidate_plugins = g_list_prepend(context->candidate_plugins,
+                                                  plugin_candidate_new(plugin->super.type, plugin->super.name,
+                                                      module_name));
+    }
+}
+
 void
 plugin_discover_candidate_modules(PluginContext *context)
 {
-  GModule *mod;
   gchar **mod_paths;
-  gint i, j;
+  gint i;
 
   _free_candidate_plugins(context);
 
@@ -483,7 +729,6 @@ plugin_discover_candidate_modules(PluginContext *context)
           if (g_str_has_suffix(fname, G_MODULE_SUFFIX))
             {
               gchar *module_name;
-              ModuleInfo *module_info;
               const gchar *so_basename = fname;
 
               if (g_str_has_prefix(fname, "lib"))
@@ -494,51 +739,24 @@ plugin_discover_candidate_modules(PluginContext *context)
                         evt_tag_str("path", mod_paths[i]),
                         evt_tag_str("fname", fname),
                         evt_tag_str("module", module_name));
-              mod = _dlopen_module_as_dir_and_filename(mod_paths[i], fname, module_name);
-              module_info = _get_module_info(mod);
 
-              if (module_info)
-                {
-                  for (j = 0; j < module_info->plugins_len; j++)
-                    {
-                      Plugin *plugin = &module_info->plugins[j];
-                      PluginCandidate *candidate_plugin;
+              gchar *path = g_build_path(G_DIR_SEPARATOR_S, mod_paths[i], fname, NULL);
+              ModuleCacheEntry *entry = _module_cache_lookup(path, module_name);
 
-                      candidate_plugin = (PluginCandidate *) _find_plugin_in_list(context->candidate_plugins, plugin->type, plugin->name);
+              for (GList *l = entry ? entry->plugins : NULL; l; l = l->next)
+                _register_candidate_plugin(context, (PluginCandidate *) l->data, module_name);
 
-                      msg_debug("Registering candidate plugin",
-                                evt_tag_str("module", module_name),
-                                evt_tag_str("context", cfg_lexer_lookup_context_name_by_type(plugin->type)),
-                                evt_tag_str("name", plugin->name));
-                      if (candidate_plugin)
-                        {
-                          msg_debug("Duplicate plugin candidate, overriding previous registration with the new one",
-                                    evt_tag_str("old-module", candidate_plugin->module_name),
-                                    evt_tag_str("new-module", module_name),
-                                    evt_tag_str("context", cfg_lexer_lookup_context_name_by_type(plugin->type)),
-                                    evt_tag_str("name", plugin->name));
-                          plugin_candidate_set_module_name(candidate_plugin, module_name);
-                        }
-                      else
-                        {
-                          context->candidate_plugins = g_list_prepend(context->candidate_plugins,
-                                                                      plugin_candidate_new(plugin->type, plugin->name,
-                                                                          module_name));
-                        }
-                    }
-                }
+              g_free(path);
               g_free(module_name);
-              if (mod)
-                g_module_close(mod);
-              else
-                mod = NULL;
             }
         }
       g_dir_close(dir);
     }
   g_strfreev(mod_paths);
-}
 
+  if (module_cache)
+    _module_cache_save(resolved_configurable_paths.module_cache_file);
+}
 
 static void
 _free_plugins(PluginContext *context)
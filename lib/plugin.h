@@ -110,6 +110,7 @@ gboolean plugin_is_plugin_available(PluginContext *context, gint plugin_type, co
 gboolean plugin_is_module_available(PluginContext *context, const gchar *module_name);
 
 void plugin_list_modules(FILE *out, gboolean verbose);
+void plugin_global_deinit(void);
 
 gboolean plugin_has_discovery_run(PluginContext *context);
 void plugin_discover_candidate_modules(PluginContext *context);
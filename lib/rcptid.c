@@ -26,13 +26,37 @@
 #include "messages.h"
 #include "str-format.h"
 
+/*
+ * Threads do not touch the persisted counter for every message, instead
+ * they reserve blocks of RCPTID_BLOCK_SIZE IDs and hand those out without
+ * locking.  The unused tail of the most recently reserved block is given
+ * back to the counter when its owner thread exits or calls rcptid_deinit(),
+ * other unused IDs are simply skipped.
+ */
+#define RCPTID_BLOCK_SIZE 65536
+
+typedef struct _RcptidBlock
+{
+  guint64 next;
+  guint32 remaining;
+  guint generation;
+} RcptidBlock;
+
 static struct _RcptidService
 {
   PersistState *persist_state;
   PersistEntryHandle persist_handle;
   GMutex lock;
+  /* bumped whenever the counter is changed behind the blocks' back */
+  guint generation;
+  /* the block that was reserved last, protected by lock */
+  RcptidBlock *last_block;
 } rcptid_service;
 
+static void _rcptid_block_free(gpointer s);
+
+static GPrivate rcptid_block = G_PRIVATE_INIT(_rcptid_block_free);
+
 /* NOTE: RcptIdInstance is a singleton, so we don't pass self around as an argument */
 
 #define self (&rcpt_instance)
@@ -55,6 +79,44 @@ rcptid_is_initialized(void)
   return rcptid_service.persist_state != NULL;
 }
 
+/* must be called with the lock held */
+static void
+_invalidate_blocks(void)
+{
+  rcptid_service.last_block = NULL;
+  g_atomic_int_inc(&rcptid_service.generation);
+}
+
+/* must be called with the lock held, by the thread owning the block */
+static void
+_give_back_unused_ids(RcptidBlock *block)
+{
+  RcptidState *data;
+
+  if (rcptid_service.last_block != block)
+    return;
+
+  rcptid_service.last_block = NULL;
+  if (!rcptid_is_initialized() || block->remaining == 0 || block->generation != rcptid_service.generation)
+    return;
+
+  data = rcptid_map_state();
+  data->g_rcptid = block->next;
+  rcptid_unmap_state();
+  block->remaining = 0;
+}
+
+static void
+_rcptid_block_free(gpointer s)
+{
+  RcptidBlock *block = (RcptidBlock *) s;
+
+  g_mutex_lock(&rcptid_service.lock);
+  _give_back_unused_ids(block);
+  g_mutex_unlock(&rcptid_service.lock);
+  g_free(block);
+}
+
 static gboolean
 rcptid_restore_entry(void)
 {
@@ -124,31 +186,68 @@ rcptid_set_id(guint64 id)
 
   rcptid_unmap_state();
 
+  _invalidate_blocks();
+
   g_mutex_unlock(&rcptid_service.lock);
 }
 
-guint64
-rcptid_generate_id(void)
+static gboolean
+_reserve_block(RcptidBlock *block)
 {
   RcptidState *data;
-  guint64 new_id;
-
-  if (!rcptid_is_initialized())
-    return 0;
 
   g_mutex_lock(&rcptid_service.lock);
 
+  if (!rcptid_is_initialized())
+    {
+      g_mutex_unlock(&rcptid_service.lock);
+      return FALSE;
+    }
+
   data = rcptid_map_state();
 
-  new_id = data->g_rcptid++;
+  if (data->g_rcptid == 0)
+    data->g_rcptid = 1;
+
+  block->next = data->g_rcptid;
+  block->remaining = MIN(RCPTID_BLOCK_SIZE, G_MAXUINT64 - block->next + 1);
+  block->generation = rcptid_service.generation;
+
+  data->g_rcptid += block->remaining;
   if (data->g_rcptid == 0)
     data->g_rcptid = 1;
 
   rcptid_unmap_state();
 
+  rcptid_service.last_block = block;
+
   g_mutex_unlock(&rcptid_service.lock);
+  return TRUE;
+}
+
+guint64
+rcptid_generate_id(void)
+{
+  RcptidBlock *block;
+
+  if (!rcptid_is_initialized())
+    return 0;
 
-  return new_id;
+  block = g_private_get(&rcptid_block);
+  if (!block)
+    {
+      block = g_new0(RcptidBlock, 1);
+      g_private_set(&rcptid_block, block);
+    }
+
+  if (block->remaining == 0 || block->generation != g_atomic_int_get(&rcptid_service.generation))
+    {
+      if (!_reserve_block(block))
+        return 0;
+    }
+
+  block->remaining--;
+  return block->next++;
 }
 
 /*restore RCTPID from persist file, if possible, else
@@ -163,6 +262,10 @@ rcptid_init(PersistState *state, gboolean use_rcptid)
   if (!use_rcptid)
     return TRUE;
 
+  g_mutex_lock(&rcptid_service.lock);
+  _invalidate_blocks();
+  g_mutex_unlock(&rcptid_service.lock);
+
   rcptid_service.persist_state = state;
   rcptid_service.persist_handle = persist_state_lookup_entry(state, "next.rcptid", &size, &version);
 
@@ -181,5 +284,12 @@ rcptid_init(PersistState *state, gboolean use_rcptid)
 void
 rcptid_deinit(void)
 {
+  RcptidBlock *block = g_private_get(&rcptid_block);
+
+  g_mutex_lock(&rcptid_service.lock);
+  if (block)
+    _give_back_unused_ids(block);
+  _invalidate_blocks();
   rcptid_service.persist_state = NULL;
+  g_mutex_unlock(&rcptid_service.lock);
 }
@@ -23,6 +23,7 @@
  */
 
 #include "rewrite-subst.h"
+#include "scratch-buffers.h"
 
 /* LogRewriteSubst
  *
@@ -53,17 +54,20 @@ log_rewrite_subst_process(LogRewrite *s, LogMessage **pmsg, const LogPathOptions
   LogMessage *msg;
   NVTable *nvtable;
   const gchar *value;
-  gchar *new_value;
   gssize length;
-  gssize new_length = -1;
+  ScratchBuffersMarker marker;
+  GString *new_value = scratch_buffers_alloc_and_mark(&marker);
 
   msg = log_msg_make_writable(pmsg, path_options);
+  /* parse lazy SDATA first, as that would replace the payload we reference */
+  log_msg_ensure_sdata_parsed(msg);
   nvtable = nv_table_ref(msg->payload);
   value = log_msg_get_value(msg, self->super.value_handle, &length);
-  new_value = log_matcher_replace(self->matcher, msg, self->super.value_handle, value, length, self->replacement,
-                                  &new_length);
 
-  if (new_value)
+  /* the new value is built in a scratch buffer, log_msg_set_value() reuses
+   * the existing entry of the NVTable if the new value fits into it */
+  if (log_matcher_replace_append(self->matcher, msg, self->super.value_handle, value, length, self->replacement,
+                                 new_value))
     {
       msg_trace("Performing subst() rewrite",
                 evt_tag_str("rule", s->name),
@@ -73,7 +77,7 @@ log_rewrite_subst_process(LogRewrite *s, LogMessage **pmsg, const LogPathOptions
                 evt_tag_str("pattern", self->matcher->pattern),
                 evt_tag_str("replacement", self->replacement->template_str),
                 log_pipe_location_tag(&s->super));
-      log_msg_set_value(msg, self->super.value_handle, new_value, new_length);
+      log_msg_set_value(msg, self->super.value_handle, new_value->str, new_value->len);
     }
   else
     {
@@ -87,7 +91,7 @@ log_rewrite_subst_process(LogRewrite *s, LogMessage **pmsg, const LogPathOptions
                 log_pipe_location_tag(&s->super));
     }
   nv_table_unref(nvtable);
-  g_free(new_value);
+  scratch_buffers_reclaim_marked(marker);
 }
 
 gboolean
@@ -0,0 +1,120 @@
+/*
+ * Copyright (c) 2024 One Identity LLC.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#include "rule-profiler-control.h"
+#include "rule-profiler.h"
+#include "stack-sampler.h"
+#include "control/control-commands.h"
+#include "control/control-connection.h"
+#include "messages.h"
+
+#include <stdlib.h>
+
+/*
+ * PROFILE                   list the profiles in CSV format
+ * PROFILE ENABLE <rate>     start profiling, timing every <rate>-th call
+ * PROFILE DISABLE           stop profiling, the counters are kept
+ * PROFILE RESET             zero the counters
+ * PROFILE START <hz>        start sampling the call stacks of all threads
+ * PROFILE STOP              stop sampling, returns the stacks in collapsed format
+ */
+static void
+control_connection_profile(ControlConnection *cc, GString *command, gpointer user_data, gboolean *cancelled)
+{
+  gchar **arguments = g_strsplit(command->str, " ", 3);
+  GString *result = g_string_sized_new(1024);
+
+  if (!arguments[1])
+    {
+      g_string_append(result, "OK ");
+      rule_profiler_format_csv(result);
+    }
+  else if (g_str_equal(arguments[1], "ENABLE"))
+    {
+      gchar *end = NULL;
+      glong sample_rate = arguments[2] ? strtol(arguments[2], &end, 10) : 1;
+
+      if ((end && *end) || sample_rate <= 0 || sample_rate > G_MAXINT)
+        {
+          g_string_assign(result, "FAIL Invalid sample rate");
+          goto exit;
+        }
+
+      rule_profiler_enable(sample_rate);
+      msg_info("Rule profiling enabled", evt_tag_long("sample_rate", sample_rate));
+      g_string_printf(result, "OK Rule profiling enabled, timing every %ld. call", sample_rate);
+    }
+  else if (g_str_equal(arguments[1], "DISABLE"))
+    {
+      rule_profiler_disable();
+      msg_info("Rule profiling disabled");
+      g_string_assign(result, "OK Rule profiling disabled");
+    }
+  else if (g_str_equal(arguments[1], "RESET"))
+    {
+      rule_profiler_reset();
+      g_string_assign(result, "OK The rule profiles have been reset to 0");
+    }
+  else if (g_str_equal(arguments[1], "START"))
+    {
+      gchar *end = NULL;
+      glong frequency = arguments[2] ? strtol(arguments[2], &end, 10) : 99;
+      GError *error = NULL;
+
+      if ((end && *end) || frequency <= 0 || frequency > G_MAXINT)
+        {
+          g_string_assign(result, "FAIL Invalid sampling frequency");
+          goto exit;
+        }
+
+      if (!stack_sampler_start(frequency, &error))
+        {
+          g_string_printf(result, "FAIL %s", error->message);
+          g_clear_error(&error);
+          goto exit;
+        }
+
+      msg_info("Stack sampling started", evt_tag_long("frequency", frequency));
+      g_string_printf(result, "OK Stack sampling started at %ld Hz", frequency);
+    }
+  else if (g_str_equal(arguments[1], "STOP"))
+    {
+      g_string_assign(result, "OK ");
+      if (!stack_sampler_stop(result))
+        g_string_assign(result, "FAIL The stack sampler is not running");
+    }
+  else
+    {
+      g_string_assign(result, "FAIL Unknown PROFILE command");
+    }
+
+exit:
+  control_connection_send_reply(cc, result);
+  g_strfreev(arguments);
+}
+
+void
+rule_profiler_register_control_commands(void)
+{
+  control_register_command("PROFILE", control_connection_profile, NULL, FALSE);
+}
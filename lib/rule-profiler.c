@@ -0,0 +1,221 @@
+/*
+ * Copyright (c) 2024 One Identity LLC.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#include "rule-profiler.h"
+#include "cfg-tree.h"
+
+#include <string.h>
+
+gint rule_profiler_sample_rate;
+
+static GMutex rule_profiles_lock;
+static GHashTable *rule_profiles;
+
+static gchar *
+_format_key(const gchar *kind, const gchar *name, const gchar *location)
+{
+  return g_strdup_printf("%s;%s;%s", kind, name, location);
+}
+
+static void
+_reset_profile(RuleProfile *self)
+{
+  atomic_gssize_set(&self->calls, 0);
+  atomic_gssize_set(&self->matches, 0);
+  atomic_gssize_set(&self->timed_calls, 0);
+  atomic_gssize_set(&self->timed_nsec, 0);
+}
+
+static RuleProfile *
+_profile_new(const gchar *kind, const gchar *name, const gchar *location)
+{
+  RuleProfile *self = g_new0(RuleProfile, 1);
+
+  self->kind = g_strdup(kind);
+  self->name = g_strdup(name);
+  self->location = g_strdup(location);
+  _reset_profile(self);
+  return self;
+}
+
+static void
+_profile_free(RuleProfile *self)
+{
+  g_free(self->kind);
+  g_free(self->name);
+  g_free(self->location);
+  g_free(self);
+}
+
+/*
+ * Returns the profile of a rule, shared with the other instances of the
+ * same rule, the caller has to release it using rule_profile_unref().
+ * NULL is returned if the profiler is not initialized.
+ */
+RuleProfile *
+rule_profile_get(const gchar *kind, const gchar *name, LogPipe *pipe)
+{
+  gchar location[256];
+
+  log_expr_node_format_location(pipe->expr_node, location, sizeof(location));
+  return rule_profile_get_by_location(kind, name, location);
+}
+
+/* for rules that are not part of the configuration, e.g. patterndb rules */
+RuleProfile *
+rule_profile_get_by_location(const gchar *kind, const gchar *name, const gchar *location)
+{
+  RuleProfile *self;
+
+  /* not initialized, e.g. in unit tests */
+  if (!rule_profiles)
+    return NULL;
+
+  gchar *key = _format_key(kind, name ? : "#unnamed", location);
+
+  g_mutex_lock(&rule_profiles_lock);
+  self = g_hash_table_lookup(rule_profiles, key);
+  if (!self)
+    {
+      self = _profile_new(kind, name ? : "#unnamed", location);
+      g_hash_table_insert(rule_profiles, key, self);
+      key = NULL;
+    }
+  self->ref_cnt++;
+  g_mutex_unlock(&rule_profiles_lock);
+
+  g_free(key);
+  return self;
+}
+
+void
+rule_profile_unref(RuleProfile *self)
+{
+  if (!self)
+    return;
+
+  g_mutex_lock(&rule_profiles_lock);
+  if (--self->ref_cnt == 0)
+    {
+      gchar *key = _format_key(self->kind, self->name, self->location);
+      g_hash_table_remove(rule_profiles, key);
+      g_free(key);
+    }
+  g_mutex_unlock(&rule_profiles_lock);
+}
+
+void
+rule_profiler_enable(gint sample_rate)
+{
+  g_assert(sample_rate > 0);
+  rule_profiler_sample_rate = sample_rate;
+}
+
+void
+rule_profiler_disable(void)
+{
+  rule_profiler_sample_rate = 0;
+}
+
+static void
+_reset_profile_foreach(gpointer key, gpointer value, gpointer user_data)
+{
+  _reset_profile((RuleProfile *) value);
+}
+
+void
+rule_profiler_reset(void)
+{
+  g_mutex_lock(&rule_profiles_lock);
+  g_hash_table_foreach(rule_profiles, _reset_profile_foreach, NULL);
+  g_mutex_unlock(&rule_profiles_lock);
+}
+
+static gint
+_compare_by_time_spent(gconstpointer a, gconstpointer b)
+{
+  const RuleProfile *profile_a = *(const RuleProfile **) a;
+  const RuleProfile *profile_b = *(const RuleProfile **) b;
+  gssize nsec_a = atomic_gssize_racy_get((atomic_gssize *) &profile_a->timed_nsec);
+  gssize nsec_b = atomic_gssize_racy_get((atomic_gssize *) &profile_b->timed_nsec);
+
+  if (nsec_a != nsec_b)
+    return nsec_a < nsec_b ? 1 : -1;
+  return strcmp(profile_a->location, profile_b->location);
+}
+
+static void
+_append_profile(RuleProfile *self, GString *result)
+{
+  gsize calls = atomic_gssize_get_unsigned(&self->calls);
+  gsize matches = atomic_gssize_get_unsigned(&self->matches);
+  gsize timed_calls = atomic_gssize_get_unsigned(&self->timed_calls);
+  gsize timed_nsec = atomic_gssize_get_unsigned(&self->timed_nsec);
+
+  g_string_append_printf(result, "%s;%s;%s;%" G_GSIZE_FORMAT ";%" G_GSIZE_FORMAT ";%" G_GSIZE_FORMAT
+                         ";%" G_GSIZE_FORMAT ";%" G_GSIZE_FORMAT "\n",
+                         self->kind, self->name, self->location,
+                         calls, matches, timed_calls, timed_nsec,
+                         timed_calls ? timed_nsec / timed_calls : 0);
+}
+
+/*
+ * The profiles are listed with the most expensive rules (based on the
+ * time measured) first.  The estimated total time of a rule is
+ * calls * avg_nsec.
+ */
+void
+rule_profiler_format_csv(GString *result)
+{
+  GPtrArray *profiles = g_ptr_array_new();
+  GHashTableIter iter;
+  gpointer value;
+
+  g_string_append(result, "Kind;Name;Location;Calls;Matches;TimedCalls;TimedNsec;AvgNsec\n");
+
+  g_mutex_lock(&rule_profiles_lock);
+  g_hash_table_iter_init(&iter, rule_profiles);
+  while (g_hash_table_iter_next(&iter, NULL, &value))
+    g_ptr_array_add(profiles, value);
+
+  g_ptr_array_sort(profiles, _compare_by_time_spent);
+  for (guint i = 0; i < profiles->len; i++)
+    _append_profile(g_ptr_array_index(profiles, i), result);
+  g_mutex_unlock(&rule_profiles_lock);
+
+  g_ptr_array_free(profiles, TRUE);
+}
+
+void
+rule_profiler_global_init(void)
+{
+  rule_profiles = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, (GDestroyNotify) _profile_free);
+}
+
+void
+rule_profiler_global_deinit(void)
+{
+  rule_profiler_disable();
+  g_hash_table_destroy(rule_profiles);
+  rule_profiles = NULL;
+}
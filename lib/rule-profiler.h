@@ -0,0 +1,136 @@
+/*
+ * Copyright (c) 2024 One Identity LLC.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#ifndef RULE_PROFILER_H_INCLUDED
+#define RULE_PROFILER_H_INCLUDED
+
+#include "syslog-ng.h"
+#include "logpipe.h"
+#include "atomic-gssize.h"
+#include "timeutils/misc.h"
+
+#include <time.h>
+
+/*
+ * Optional CPU profiling of filter and parser rules, controlled by
+ * "syslog-ng-ctl profile".
+ *
+ * Rules are identified by their kind, name and configuration location, the
+ * clones of the same rule (e.g. a filter referenced from several log
+ * paths) share their RuleProfile.  While the profiler is enabled, calls
+ * and matches are counted and every sample_rate-th call is timed, so that
+ * the overhead stays low enough to leave it enabled in production.
+ */
+typedef struct _RuleProfile
+{
+  gint ref_cnt;
+  gchar *kind;
+  gchar *name;
+  gchar *location;
+  atomic_gssize calls;
+  atomic_gssize matches;
+  atomic_gssize timed_calls;
+  atomic_gssize timed_nsec;
+} RuleProfile;
+
+typedef struct _RuleProfileSample
+{
+  gboolean counted;
+  gboolean timed;
+  struct timespec start;
+} RuleProfileSample;
+
+/* 0 if the profiler is disabled, otherwise every sample_rate-th call is timed */
+extern gint rule_profiler_sample_rate;
+
+static inline void
+rule_profile_begin(RuleProfile *self, RuleProfileSample *sample)
+{
+  gint sample_rate = rule_profiler_sample_rate;
+
+  sample->counted = G_UNLIKELY(sample_rate != 0) && self;
+  sample->timed = FALSE;
+  if (G_LIKELY(!sample->counted))
+    return;
+
+  if (atomic_gssize_inc(&self->calls) % sample_rate == 0)
+    {
+      sample->timed = TRUE;
+      clock_gettime(CLOCK_MONOTONIC, &sample->start);
+    }
+}
+
+/* returns the time measured, 0 if the call was not timed */
+static inline gint64
+rule_profile_end(RuleProfile *self, RuleProfileSample *sample, gboolean matched)
+{
+  gint64 nsec = 0;
+
+  if (G_LIKELY(!sample->counted))
+    return 0;
+
+  if (matched)
+    atomic_gssize_inc(&self->matches);
+
+  if (sample->timed)
+    {
+      struct timespec end;
+
+      clock_gettime(CLOCK_MONOTONIC, &end);
+      nsec = timespec_diff_nsec(&end, &sample->start);
+      atomic_gssize_add(&self->timed_nsec, nsec);
+      atomic_gssize_inc(&self->timed_calls);
+    }
+  return nsec;
+}
+
+/* accounts a matching call of a nested rule, that was measured by the
+ * sample of the enclosing one, e.g. the rule of a patterndb program */
+static inline void
+rule_profile_add_nested_match(RuleProfile *self, RuleProfileSample *sample, gint64 nsec)
+{
+  if (G_LIKELY(!sample->counted) || !self)
+    return;
+
+  atomic_gssize_inc(&self->calls);
+  atomic_gssize_inc(&self->matches);
+  if (sample->timed)
+    {
+      atomic_gssize_add(&self->timed_nsec, nsec);
+      atomic_gssize_inc(&self->timed_calls);
+    }
+}
+
+RuleProfile *rule_profile_get(const gchar *kind, const gchar *name, LogPipe *pipe);
+RuleProfile *rule_profile_get_by_location(const gchar *kind, const gchar *name, const gchar *location);
+void rule_profile_unref(RuleProfile *self);
+
+void rule_profiler_enable(gint sample_rate);
+void rule_profiler_disable(void);
+void rule_profiler_reset(void);
+void rule_profiler_format_csv(GString *result);
+
+void rule_profiler_global_init(void);
+void rule_profiler_global_deinit(void);
+
+#endif
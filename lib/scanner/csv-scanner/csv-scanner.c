@@ -26,6 +26,7 @@
 #include "string-list.h"
 #include "scratch-buffers.h"
 #include "messages.h"
+#include "find-crlf.h"
 
 #include <string.h>
 
@@ -52,11 +53,35 @@ csv_scanner_options_set_columns(CSVScannerOptions *options, GList *columns)
   options->columns = columns;
 }
 
+static void
+_update_delimiter_start_chars(CSVScannerOptions *options)
+{
+  GString *start_chars = g_string_new(options->delimiters);
+
+  for (GList *l = options->string_delimiters; l; l = l->next)
+    {
+      const gchar *string_delimiter = (const gchar *) l->data;
+
+      /* an empty string delimiter matches anywhere, characters can't be skipped in bulk */
+      if (!string_delimiter[0])
+        {
+          g_string_free(start_chars, TRUE);
+          start_chars = NULL;
+          break;
+        }
+      if (!strchr(start_chars->str, string_delimiter[0]))
+        g_string_append_c(start_chars, string_delimiter[0]);
+    }
+  g_free(options->delimiter_start_chars);
+  options->delimiter_start_chars = start_chars ? g_string_free(start_chars, FALSE) : NULL;
+}
+
 void
 csv_scanner_options_set_delimiters(CSVScannerOptions *options, const gchar *delimiters)
 {
   g_free(options->delimiters);
   options->delimiters = g_strdup(delimiters);
+  _update_delimiter_start_chars(options);
 }
 
 void
@@ -64,6 +89,7 @@ csv_scanner_options_set_string_delimiters(CSVScannerOptions *options, GList *str
 {
   string_list_free(options->string_delimiters);
   options->string_delimiters = string_delimiters;
+  _update_delimiter_start_chars(options);
 }
 
 void
@@ -110,6 +136,13 @@ csv_scanner_options_set_null_value(CSVScannerOptions *options, const gchar *null
   options->null_value = null_value && null_value[0] ? g_strdup(null_value) : NULL;
 }
 
+void
+csv_scanner_options_set_extract_only(CSVScannerOptions *options, GList *extract_only)
+{
+  string_list_free(options->extract_only);
+  options->extract_only = extract_only;
+}
+
 void
 csv_scanner_options_copy(CSVScannerOptions *dst, CSVScannerOptions *src)
 {
@@ -118,6 +151,7 @@ csv_scanner_options_copy(CSVScannerOptions *dst, CSVScannerOptions *src)
   csv_scanner_options_set_null_value(dst, src->null_value);
   csv_scanner_options_set_string_delimiters(dst, string_list_clone(src->string_delimiters));
   csv_scanner_options_set_columns(dst, string_list_clone(src->columns));
+  csv_scanner_options_set_extract_only(dst, string_list_clone(src->extract_only));
   dst->dialect = src->dialect;
   dst->flags = src->flags;
 }
@@ -131,6 +165,44 @@ csv_scanner_options_clean(CSVScannerOptions *options)
   g_free(options->delimiters);
   string_list_free(options->string_delimiters);
   string_list_free(options->columns);
+  string_list_free(options->extract_only);
+  options->extract_only = NULL;
+  g_free(options->skipped_columns);
+  options->skipped_columns = NULL;
+  g_free(options->delimiter_start_chars);
+  options->delimiter_start_chars = NULL;
+}
+
+static gboolean
+_compile_extract_only(CSVScannerOptions *options)
+{
+  g_free(options->skipped_columns);
+  options->skipped_columns = NULL;
+  if (!options->extract_only)
+    return TRUE;
+
+  if (!options->columns)
+    {
+      msg_error("The extract-only() option of csv-parser can not be used without specifying the columns() option");
+      return FALSE;
+    }
+
+  for (GList *l = options->extract_only; l; l = l->next)
+    {
+      if (!g_list_find_custom(options->columns, l->data, (GCompareFunc) strcmp))
+        {
+          msg_error("csv-parser: extract-only() refers to a column not listed in columns()",
+                    evt_tag_str("column", (const gchar *) l->data));
+          return FALSE;
+        }
+    }
+
+  options->skipped_columns = g_new0(guint8, g_list_length(options->columns));
+
+  gint i = 0;
+  for (GList *l = options->columns; l; l = l->next, i++)
+    options->skipped_columns[i] = !g_list_find_custom(options->extract_only, l->data, (GCompareFunc) strcmp);
+  return TRUE;
 }
 
 gboolean
@@ -142,7 +214,7 @@ csv_scanner_options_validate(CSVScannerOptions *options)
       return FALSE;
     }
 
-  return TRUE;
+  return _compile_extract_only(options);
 }
 
 /************************************************************************
@@ -282,7 +354,8 @@ _parse_character_with_quotation(CSVScanner *self)
     {
       ch = *self->src;
     }
-  g_string_append_c(self->current_value, ch);
+  if (!self->skip_value)
+    g_string_append_c(self->current_value, ch);
   self->src++;
 }
 
@@ -349,10 +422,51 @@ _parse_delimiter(CSVScanner *self)
 static void
 _parse_unquoted_literal_character(CSVScanner *self)
 {
-  g_string_append_c(self->current_value, *self->src);
+  if (!self->skip_value)
+    g_string_append_c(self->current_value, *self->src);
   self->src++;
 }
 
+/*
+ * Appends the characters up to the next one in @chars to the current
+ * value.  These can't start a delimiter, a quote or an escape sequence, so
+ * they can be skipped over in bulk, instead of going through the per
+ * character state machine above.
+ */
+static void
+_parse_run_of_literal_characters(CSVScanner *self, const gchar *chars, gsize chars_len)
+{
+  const gchar *run_end = NULL;
+
+  if (chars_len > 0)
+    run_end = find_first_of(self->src, self->src_end - self->src, chars, chars_len);
+  if (!run_end)
+    run_end = self->src_end;
+
+  if (!self->skip_value)
+    g_string_append_len(self->current_value, self->src, run_end - self->src);
+  self->src = run_end;
+}
+
+static void
+_parse_run_of_quoted_characters(CSVScanner *self)
+{
+  const gchar specials[] = { self->current_quote, '\\' };
+  gboolean has_backslash_escapes = self->options->dialect == CSV_SCANNER_ESCAPE_BACKSLASH ||
+                                   self->options->dialect == CSV_SCANNER_ESCAPE_BACKSLASH_WITH_SEQUENCES;
+
+  _parse_run_of_literal_characters(self, specials, has_backslash_escapes ? 2 : 1);
+}
+
+static void
+_parse_run_of_unquoted_characters(CSVScanner *self)
+{
+  const gchar *delimiter_start_chars = self->options->delimiter_start_chars;
+
+  if (delimiter_start_chars)
+    _parse_run_of_literal_characters(self, delimiter_start_chars, strlen(delimiter_start_chars));
+}
+
 static void
 _parse_value_with_whitespace_and_delimiter(CSVScanner *self)
 {
@@ -361,11 +475,17 @@ _parse_value_with_whitespace_and_delimiter(CSVScanner *self)
       if (self->current_quote)
         {
           /* within quotation marks */
+          _parse_run_of_quoted_characters(self);
+          if (!*self->src)
+            break;
           _parse_character_with_quotation(self);
         }
       else
         {
           /* unquoted value */
+          _parse_run_of_unquoted_characters(self);
+          if (!*self->src)
+            break;
           if (_parse_delimiter(self))
             break;
           _parse_unquoted_literal_character(self);
@@ -425,6 +545,7 @@ _switch_to_next_column(CSVScanner *self)
     case CSV_STATE_INITIAL:
       self->state = CSV_STATE_COLUMNS;
       self->current_column = self->options->columns;
+      self->current_column_index = 0;
       if (self->current_column)
         return TRUE;
       self->state = CSV_STATE_FINISH;
@@ -432,6 +553,7 @@ _switch_to_next_column(CSVScanner *self)
     case CSV_STATE_COLUMNS:
     case CSV_STATE_GREEDY_COLUMN:
       self->current_column = self->current_column->next;
+      self->current_column_index++;
       if (self->current_column)
         return TRUE;
       self->state = CSV_STATE_FINISH;
@@ -445,15 +567,29 @@ _switch_to_next_column(CSVScanner *self)
   g_assert_not_reached();
 }
 
-gboolean
-csv_scanner_scan_next(CSVScanner *self)
+static gboolean
+_is_current_column_skipped(CSVScanner *self)
+{
+  return self->options->skipped_columns && self->current_column &&
+         self->options->skipped_columns[self->current_column_index];
+}
+
+static gboolean
+_scan_next_column(CSVScanner *self)
 {
   if (!_switch_to_next_column(self))
     return FALSE;
 
+  self->skip_value = _is_current_column_skipped(self);
   if (_is_last_column(self) && (self->options->flags & CSV_SCANNER_GREEDY))
     {
       _parse_left_whitespace(self);
+      if (self->skip_value)
+        {
+          self->src += strlen(self->src);
+          self->state = CSV_STATE_GREEDY_COLUMN;
+          return TRUE;
+        }
       g_string_assign(self->current_value, self->src);
       self->src += self->current_value->len;
       self->state = CSV_STATE_GREEDY_COLUMN;
@@ -476,6 +612,18 @@ csv_scanner_scan_next(CSVScanner *self)
     }
 }
 
+/* columns not listed in extract-only() are parsed, but they are never returned */
+gboolean
+csv_scanner_scan_next(CSVScanner *self)
+{
+  while (_scan_next_column(self))
+    {
+      if (!self->skip_value)
+        return TRUE;
+    }
+  return FALSE;
+}
+
 const gchar *
 csv_scanner_get_current_name(CSVScanner *self)
 {
@@ -503,6 +651,7 @@ csv_scanner_init(CSVScanner *scanner, CSVScannerOptions *options, const gchar *i
   memset(scanner, 0, sizeof(*scanner));
   scanner->state = CSV_STATE_INITIAL;
   scanner->src = input;
+  scanner->src_end = input + strlen(input);
   scanner->current_value = scratch_buffers_alloc();
   scanner->current_column = NULL;
   scanner->options = options;
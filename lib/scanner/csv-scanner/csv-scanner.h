@@ -49,6 +49,11 @@ typedef struct _CSVScannerOptions
   GList *string_delimiters;
   CSVScannerDialect dialect;
   guint32 flags;
+  /* columns to be returned by the scanner, the rest is skipped over */
+  GList *extract_only;
+  guint8 *skipped_columns;
+  /* characters that may start a delimiter, NULL if a delimiter may start anywhere */
+  gchar *delimiter_start_chars;
 } CSVScannerOptions;
 
 void csv_scanner_options_clean(CSVScannerOptions *options);
@@ -65,6 +70,7 @@ void csv_scanner_options_set_quotes_start_and_end(CSVScannerOptions *options, co
 void csv_scanner_options_set_quotes(CSVScannerOptions *options, const gchar *quotes);
 void csv_scanner_options_set_quote_pairs(CSVScannerOptions *options, const gchar *quote_pairs);
 void csv_scanner_options_set_null_value(CSVScannerOptions *options, const gchar *null_value);
+void csv_scanner_options_set_extract_only(CSVScannerOptions *options, GList *extract_only);
 
 typedef struct
 {
@@ -78,7 +84,10 @@ typedef struct
     CSV_STATE_FINISH,
   } state;
   GList *current_column;
+  gint current_column_index;
+  gboolean skip_value;
   const gchar *src;
+  const gchar *src_end;
   GString *current_value;
   gchar current_quote;
   gboolean columnless;
@@ -443,6 +443,39 @@ Test(csv_scanner, columnless_no_flags)
   csv_scanner_deinit(&scanner);
 }
 
+Test(csv_scanner, columns_not_in_extract_only_are_skipped)
+{
+  const gchar *columns[] = { "foo", "bar", "baz", "rest", NULL };
+  const gchar *extract_only[] = { "bar", "rest", NULL };
+
+  _default_options_with_flags(columns, CSV_SCANNER_GREEDY | CSV_SCANNER_STRIP_WHITESPACE);
+  csv_scanner_options_set_extract_only(&options, string_array_to_list(extract_only));
+  cr_assert(csv_scanner_options_validate(&options));
+  csv_scanner_init(&scanner, &options, "\"val,1\",val2,'val3',val4,val5");
+
+  cr_expect(_scan_next());
+  cr_expect(_column_nv_equals("bar", "val2"));
+  cr_expect(!_scan_complete());
+
+  cr_expect(_scan_next());
+  cr_expect(_column_nv_equals("rest", "val4,val5"));
+
+  /* go past the last column */
+  cr_expect(!_scan_next());
+  cr_expect(_scan_complete());
+  csv_scanner_deinit(&scanner);
+}
+
+Test(csv_scanner, extract_only_requires_known_columns)
+{
+  const gchar *columns[] = { "foo", "bar", NULL };
+  const gchar *extract_only[] = { "foo", "unknown", NULL };
+
+  _default_options(columns);
+  csv_scanner_options_set_extract_only(&options, string_array_to_list(extract_only));
+  cr_assert_not(csv_scanner_options_validate(&options));
+}
+
 static void
 setup(void)
 {
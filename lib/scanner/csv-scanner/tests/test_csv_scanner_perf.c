@@ -0,0 +1,133 @@
+/*
+ * Copyright (c) 2024 One Identity LLC.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+
+#include <criterion/criterion.h>
+
+#include "csv-scanner.h"
+#include "find-crlf.h"
+#include "string-list.h"
+#include "scratch-buffers.h"
+#include "apphook.h"
+
+#include <stdio.h>
+
+/*
+ * Microbenchmark of the CSV scanner on Palo Alto Networks TRAFFIC and
+ * THREAT logs, with every character search implementation available.
+ */
+
+#define ITERATIONS 100000
+
+static const gchar *implementations[] = { "scalar", "sse2", "neon", "avx2" };
+
+static const gchar *panos_traffic =
+  "1,2024/01/15 10:23:45,012801012345,TRAFFIC,end,2561,2024/01/15 10:23:45,10.1.2.3,172.217.16.14,"
+  "203.0.113.10,172.217.16.14,allow-web,corp\\jdoe,,ssl,vsys1,trust,untrust,ethernet1/1,ethernet1/2,"
+  "log-forwarding,2024/01/15 10:23:45,123456,1,52344,443,41234,443,0x400053,tcp,allow,5832,1418,4414,"
+  "22,2024/01/15 10:22:31,60,computer-and-internet-info,0,7891234567,0x0,10.0.0.0-10.255.255.255,"
+  "United States,0,12,10,tcp-fin,0,0,0,0,,PA-3220,from-policy,,,0,,0,,N/A,0,0,0,0";
+
+static const gchar *panos_threat =
+  "1,2024/01/15 10:24:02,012801012345,THREAT,url,2561,2024/01/15 10:24:02,10.1.2.3,93.184.216.34,"
+  "203.0.113.10,93.184.216.34,allow-web,corp\\jdoe,,web-browsing,vsys1,trust,untrust,ethernet1/1,"
+  "ethernet1/2,log-forwarding,2024/01/15 10:24:02,123457,1,52350,80,41240,80,0x8000,tcp,alert,"
+  "\"www.example.com/index.html?q=a,b,c\",(9999),shopping,informational,client-to-server,"
+  "7891234599,0x0,10.0.0.0-10.255.255.255,United States,0,text/html,0,,,1,"
+  "\"Mozilla/5.0 (X11; Linux x86_64) AppleWebKit/537.36 (KHTML, like Gecko)\",,,,,,,,0,0,0,0";
+
+static void
+_init_options(CSVScannerOptions *options, gint columns)
+{
+  GList *column_names = NULL;
+
+  memset(options, 0, sizeof(*options));
+  csv_scanner_options_set_delimiters(options, ",");
+  csv_scanner_options_set_quote_pairs(options, "\"\"");
+  csv_scanner_options_set_dialect(options, CSV_SCANNER_ESCAPE_DOUBLE_CHAR);
+  for (gint i = 0; i < columns; i++)
+    column_names = g_list_append(column_names, g_strdup_printf("column%d", i));
+  csv_scanner_options_set_columns(options, column_names);
+}
+
+static void
+_scan_input(CSVScannerOptions *options, const gchar *input)
+{
+  CSVScanner scanner;
+
+  csv_scanner_init(&scanner, options, input);
+  while (csv_scanner_scan_next(&scanner))
+    ;
+  cr_assert(csv_scanner_is_scan_complete(&scanner));
+  csv_scanner_deinit(&scanner);
+}
+
+static gint
+_count_columns(const gchar *input)
+{
+  CSVScannerOptions options;
+  CSVScanner scanner;
+  gint columns = 0;
+
+  _init_options(&options, 0);
+  csv_scanner_init(&scanner, &options, input);
+  while (csv_scanner_scan_next(&scanner))
+    columns++;
+  csv_scanner_deinit(&scanner);
+  csv_scanner_options_clean(&options);
+  return columns;
+}
+
+static void
+_run_benchmark(const gchar *name, const gchar *input)
+{
+  CSVScannerOptions options;
+
+  _init_options(&options, _count_columns(input));
+
+  for (gint i = 0; i < G_N_ELEMENTS(implementations); i++)
+    {
+      if (!find_crlf_set_implementation(implementations[i]))
+        continue;
+
+      gint64 start = g_get_monotonic_time();
+      for (gint j = 0; j < ITERATIONS; j++)
+        {
+          _scan_input(&options, input);
+          scratch_buffers_explicit_gc();
+        }
+      gint64 end = g_get_monotonic_time();
+
+      printf("      %-14s %-8s speed: %12.3f msg/sec\n", name, implementations[i],
+             ITERATIONS * 1e6 / (end - start));
+    }
+  csv_scanner_options_clean(&options);
+}
+
+Test(csv_scanner_perf, panos_logs)
+{
+  _run_benchmark("panos-traffic", panos_traffic);
+  _run_benchmark("panos-threat", panos_threat);
+}
+
+TestSuite(csv_scanner_perf, .init = app_startup, .fini = app_shutdown);
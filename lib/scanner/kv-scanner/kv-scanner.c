@@ -263,6 +263,7 @@ _decode_value(KVScanner *self)
     .match_delimiter = _match_delimiter,
     .match_delimiter_data = self,
     .delimiter_chars = { ' ', self->pair_separator[0], self->stop_char },
+    .input_end = self->input + self->input_len,
   };
 
   self->value_was_quoted = _is_quoted(input);
@@ -303,20 +304,31 @@ _transform_value(KVScanner *self)
     }
 }
 
+static inline gboolean
+_is_key_extracted(KVScanner *self)
+{
+  return !self->extract_only || g_hash_table_contains(self->extract_only, self->key->str);
+}
+
 gboolean
 kv_scanner_scan_next(KVScanner *s)
 {
   KVScanner *self = (KVScanner *)s;
 
-  if (_should_stop(self))
-    return FALSE;
+  /* the values of keys not in extract_only are scanned over, but not transformed or returned */
+  do
+    {
+      if (_should_stop(self))
+        return FALSE;
 
-  if (!_extract_key(self))
-    return FALSE;
+      if (!_extract_key(self))
+        return FALSE;
 
-  _extract_optional_annotation(self);
+      _extract_optional_annotation(self);
 
-  _extract_value(self);
+      _extract_value(self);
+    }
+  while (!_is_key_extracted(self));
   _transform_value(s);
 
   return TRUE;
@@ -37,6 +37,7 @@ struct _KVScanner
 {
   const gchar *input;
   gsize input_pos;
+  gsize input_len;
   GString *key;
   GString *value;
   GString *decoded_value;
@@ -46,10 +47,14 @@ struct _KVScanner
   const gchar *pair_separator;
   gsize pair_separator_len;
   gchar stop_char;
+  /* keys to be returned by the scanner, the rest is skipped over */
+  GHashTable *extract_only;
 
   KVTransformValueFunc transform_value;
   KVExtractAnnotationFunc extract_annotation;
   KVIsValidKeyCharFunc is_valid_key_character;
+  /* state of the callbacks while scanning an input, reset by kv_scanner_input() */
+  gpointer input_state;
 };
 
 void kv_scanner_init(KVScanner *self, gchar value_separator, const gchar *pair_separator, gboolean extract_stray_words);
@@ -60,6 +65,8 @@ kv_scanner_input(KVScanner *self, const gchar *input)
 {
   self->input = input;
   self->input_pos = 0;
+  self->input_len = strlen(input);
+  self->input_state = NULL;
   if (self->stray_words)
     g_string_truncate(self->stray_words, 0);
 }
@@ -76,6 +83,12 @@ kv_scanner_get_current_value(KVScanner *self)
   return self->value->str;
 }
 
+static inline gsize
+kv_scanner_get_current_value_len(KVScanner *self)
+{
+  return self->value->len;
+}
+
 static inline const gchar *
 kv_scanner_get_stray_words(KVScanner *self)
 {
@@ -106,6 +119,12 @@ kv_scanner_set_stop_character(KVScanner *self, gchar stop_char)
   self->stop_char = stop_char;
 }
 
+static inline void
+kv_scanner_set_extract_only(KVScanner *self, GHashTable *extract_only)
+{
+  self->extract_only = extract_only;
+}
+
 gboolean kv_scanner_scan_next(KVScanner *self);
 
 #endif
@@ -0,0 +1,108 @@
+/*
+ * Copyright (c) 2024 One Identity LLC.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+
+#include <criterion/criterion.h>
+
+#include "kv-scanner.h"
+#include "find-crlf.h"
+#include "scratch-buffers.h"
+#include "apphook.h"
+
+#include <stdio.h>
+
+/*
+ * Microbenchmark of the key-value scanner on FortiGate traffic and UTM
+ * logs, with every character search implementation available.
+ */
+
+#define ITERATIONS 100000
+
+static const gchar *implementations[] = { "scalar", "sse2", "neon", "avx2" };
+
+static const gchar *fortigate_traffic =
+  "date=2024-01-15 time=10:23:45 devname=\"FGT60F-HQ\" devid=\"FGT60FTK20012345\" "
+  "eventtime=1705314225123456789 tz=\"+0100\" logid=\"0000000013\" type=\"traffic\" subtype=\"forward\" "
+  "level=\"notice\" vd=\"root\" srcip=10.1.2.3 srcport=52344 srcintf=\"internal\" srcintfrole=\"lan\" "
+  "dstip=172.217.16.14 dstport=443 dstintf=\"wan1\" dstintfrole=\"wan\" srccountry=\"Reserved\" "
+  "dstcountry=\"United States\" sessionid=123456789 proto=6 action=\"close\" policyid=12 "
+  "policytype=\"policy\" poluuid=\"4f1b9c2e-1234-51ee-8a3b-0123456789ab\" policyname=\"LAN to WAN\" "
+  "service=\"HTTPS\" trandisp=\"snat\" transip=203.0.113.10 transport=41234 appid=40568 app=\"HTTPS.BROWSER\" "
+  "appcat=\"Web.Client\" apprisk=\"medium\" applist=\"default\" duration=60 sentbyte=5832 rcvdbyte=1418 "
+  "sentpkt=22 rcvdpkt=18 vwlid=0 srchwvendor=\"Dell\" devtype=\"Computer\" osname=\"Windows\" "
+  "mastersrcmac=\"00:11:22:33:44:55\" srcmac=\"00:11:22:33:44:55\" srcserver=0";
+
+static const gchar *fortigate_utm =
+  "date=2024-01-15 time=10:24:02 devname=\"FGT60F-HQ\" devid=\"FGT60FTK20012345\" "
+  "eventtime=1705314242987654321 tz=\"+0100\" logid=\"0316013056\" type=\"utm\" subtype=\"webfilter\" "
+  "eventtype=\"ftgd_blk\" level=\"warning\" vd=\"root\" policyid=12 sessionid=123456799 srcip=10.1.2.3 "
+  "srcport=52350 srcintf=\"internal\" dstip=93.184.216.34 dstport=80 dstintf=\"wan1\" proto=6 "
+  "service=\"HTTP\" hostname=\"www.example.com\" profile=\"default\" action=\"blocked\" reqtype=\"direct\" "
+  "url=\"http://www.example.com/index.html?q=a b&c=\\\"d\\\"\" sentbyte=512 rcvdbyte=0 direction=\"outgoing\" "
+  "msg=\"URL belongs to a category with warnings enabled\" method=\"domain\" cat=26 "
+  "catdesc=\"Malicious Websites\" crscore=30 craction=4194304 crlevel=\"high\"";
+
+static gint
+_scan_input(const gchar *input)
+{
+  KVScanner scanner;
+  gint pairs = 0;
+
+  kv_scanner_init(&scanner, '=', NULL, FALSE);
+  kv_scanner_input(&scanner, input);
+  while (kv_scanner_scan_next(&scanner))
+    pairs++;
+  kv_scanner_deinit(&scanner);
+  return pairs;
+}
+
+static void
+_run_benchmark(const gchar *name, const gchar *input)
+{
+  gint pairs = _scan_input(input);
+
+  for (gint i = 0; i < G_N_ELEMENTS(implementations); i++)
+    {
+      if (!find_crlf_set_implementation(implementations[i]))
+        continue;
+
+      gint64 start = g_get_monotonic_time();
+      for (gint j = 0; j < ITERATIONS; j++)
+        {
+          cr_assert_eq(_scan_input(input), pairs);
+          scratch_buffers_explicit_gc();
+        }
+      gint64 end = g_get_monotonic_time();
+
+      printf("      %-18s %-8s %3d pairs, speed: %12.3f msg/sec\n", name, implementations[i], pairs,
+             ITERATIONS * 1e6 / (end - start));
+    }
+}
+
+Test(kv_scanner_perf, fortigate_logs)
+{
+  _run_benchmark("fortigate-traffic", fortigate_traffic);
+  _run_benchmark("fortigate-utm", fortigate_utm);
+}
+
+TestSuite(kv_scanner_perf, .init = app_startup, .fini = app_shutdown);
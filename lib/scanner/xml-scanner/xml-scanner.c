@@ -91,6 +91,94 @@ xml_scanner_options_set_and_compile_exclude_tags(XMLScannerOptions *self, GList
   xml_scanner_options_compile_exclude_tags_to_patterns(self);
 }
 
+static XMLScannerSelection *
+_selection_lookup_child(XMLScannerSelection *self, const gchar *name)
+{
+  for (GList *l = self->children; l; l = l->next)
+    {
+      XMLScannerSelection *child = (XMLScannerSelection *) l->data;
+
+      if (strcmp(child->name, name) == 0)
+        return child;
+    }
+  return NULL;
+}
+
+static XMLScannerSelection *
+_selection_add_child(XMLScannerSelection *self, const gchar *name)
+{
+  XMLScannerSelection *child = _selection_lookup_child(self, name);
+
+  if (child)
+    return child;
+
+  child = g_new0(XMLScannerSelection, 1);
+  child->name = g_strdup(name);
+  child->parent = self;
+  self->children = g_list_append(self->children, child);
+  return child;
+}
+
+static void
+_selection_free(XMLScannerSelection *self)
+{
+  if (!self)
+    return;
+
+  g_list_free_full(self->children, (GDestroyNotify) _selection_free);
+  g_list_free_full(self->attributes, g_free);
+  g_free(self->name);
+  g_free(self);
+}
+
+/* A path is a list of element names separated by dots, starting with the
+ * root element, e.g.  "Event.System.EventID", just like the names of the
+ * extracted values without the prefix.  It selects the element with its
+ * attributes and the whole subtree below it.  If the last component starts
+ * with an underscore, it selects a single attribute, e.g.
+ * "Event.System.Provider._Name".  */
+static void
+_selection_add_path(XMLScannerSelection *self, const gchar *path)
+{
+  gchar **components = g_strsplit(path, ".", -1);
+  XMLScannerSelection *node = self;
+  gint last = g_strv_length(components) - 1;
+
+  for (gint i = 0; i <= last; i++)
+    {
+      if (!components[i][0])
+        continue;
+
+      if (i == last && components[i][0] == '_' && node != self)
+        {
+          node->attributes = g_list_append(node->attributes, g_strdup(&components[i][1]));
+          goto exit;
+        }
+      node = _selection_add_child(node, components[i]);
+    }
+  if (node != self)
+    node->whole_subtree = TRUE;
+
+exit:
+  g_strfreev(components);
+}
+
+void
+xml_scanner_options_set_and_compile_extract(XMLScannerOptions *self, GList *extract)
+{
+  g_list_free_full(self->extract, g_free);
+  self->extract = g_list_copy_deep(extract, ((GCopyFunc)g_strdup), NULL);
+
+  _selection_free(self->selection);
+  self->selection = NULL;
+  if (!self->extract)
+    return;
+
+  self->selection = g_new0(XMLScannerSelection, 1);
+  for (GList *l = self->extract; l; l = l->next)
+    _selection_add_path(self->selection, l->data);
+}
+
 void
 xml_scanner_options_set_strip_whitespaces(XMLScannerOptions *self, gboolean setting)
 {
@@ -104,6 +192,10 @@ xml_scanner_options_destroy(XMLScannerOptions *self)
   self->exclude_tags = NULL;
   g_ptr_array_free(self->exclude_patterns, TRUE);
   self->exclude_patterns = NULL;
+  g_list_free_full(self->extract, g_free);
+  self->extract = NULL;
+  _selection_free(self->selection);
+  self->selection = NULL;
 }
 
 void
@@ -111,6 +203,7 @@ xml_scanner_options_copy(XMLScannerOptions *dest, XMLScannerOptions *source)
 {
   xml_scanner_options_set_strip_whitespaces(dest, source->strip_whitespaces);
   xml_scanner_options_set_and_compile_exclude_tags(dest, source->exclude_tags);
+  xml_scanner_options_set_and_compile_extract(dest, source->extract);
 }
 
 void
@@ -120,6 +213,57 @@ xml_scanner_options_defaults(XMLScannerOptions *self)
   self->strip_whitespaces = FALSE;
 }
 
+static inline gboolean
+_is_within_selected_subtree(XMLScanner *self)
+{
+  return !self->options->selection || self->selected_depth > 0;
+}
+
+static gboolean
+_is_attribute_selected(XMLScanner *self, const gchar *attribute_name)
+{
+  if (_is_within_selected_subtree(self))
+    return TRUE;
+
+  return g_list_find_custom(self->selection_node->attributes, attribute_name, (GCompareFunc) strcmp) != NULL;
+}
+
+/* Returns FALSE if neither the element nor anything below it is selected
+ * by extract(), such subtrees are skipped altogether. */
+static gboolean
+_enter_selection(XMLScanner *self, const gchar *element_name)
+{
+  if (!self->options->selection)
+    return TRUE;
+
+  if (self->selected_depth > 0)
+    {
+      self->selected_depth++;
+      return TRUE;
+    }
+
+  XMLScannerSelection *child = _selection_lookup_child(self->selection_node, element_name);
+  if (!child)
+    return FALSE;
+
+  self->selection_node = child;
+  if (child->whole_subtree)
+    self->selected_depth = 1;
+  return TRUE;
+}
+
+static void
+_leave_selection(XMLScanner *self)
+{
+  if (!self->options->selection)
+    return;
+
+  if (self->selected_depth > 0 && --self->selected_depth > 0)
+    return;
+
+  self->selection_node = self->selection_node->parent;
+}
+
 static void
 scanner_push_attributes(XMLScanner *self, const gchar **attribute_names, const gchar **attribute_values)
 {
@@ -139,8 +283,12 @@ scanner_push_attributes(XMLScanner *self, const gchar **attribute_names, const g
 
   while (attribute_names[attrs])
     {
-      attr_key = g_string_overwrite(attr_key, base_index, attribute_names[attrs]);
-      xml_scanner_push_current_key_value(self, attr_key->str, attribute_values[attrs], -1);
+      if (_is_attribute_selected(self, attribute_names[attrs]))
+        {
+          g_string_truncate(attr_key, base_index);
+          g_string_append(attr_key, attribute_names[attrs]);
+          xml_scanner_push_current_key_value(self, attr_key->str, attribute_values[attrs], -1);
+        }
       attrs++;
     }
 }
@@ -222,7 +370,8 @@ xml_scanner_start_element_method(XMLScanner *self,
       reversed = g_utf8_strreverse(element_name, tag_length);
     }
 
-  if (tag_matches_patterns(self->options->exclude_patterns, tag_length, element_name, reversed))
+  if (tag_matches_patterns(self->options->exclude_patterns, tag_length, element_name, reversed) ||
+      !_enter_selection(self, element_name))
     {
       msg_debug("xml: subtree skipped",
                 evt_tag_str("tag", element_name));
@@ -263,6 +412,7 @@ xml_scanner_end_element_method(XMLScanner *self,
       self->pop_next_time = 0;
       return;
     }
+  _leave_selection(self);
   _clear_current_element_from_key(self);
 }
 
@@ -313,7 +463,7 @@ xml_scanner_text_method(XMLScanner *self,
                         gsize                text_len,
                         GError             **error)
 {
-  if (text_len == 0)
+  if (text_len == 0 || !_is_within_selected_subtree(self))
     return;
 
   _append_text(self, text, text_len);
@@ -374,6 +524,7 @@ xml_scanner_init(XMLScanner *self, XMLScannerOptions *options, PushCurrentKeyVal
   g_string_assign(self->key, key_prefix);
   self->text = NULL;
   self->text_stack = g_queue_new();
+  self->selection_node = options->selection;
 }
 
 void
@@ -32,12 +32,25 @@ typedef struct _XMLScanner XMLScanner;
 
 typedef void (*PushCurrentKeyValueCB)(const gchar *name, const gchar *value, gssize value_length, gpointer user_data);
 
+/* extract() paths compiled into a tree of element names */
+typedef struct _XMLScannerSelection XMLScannerSelection;
+struct _XMLScannerSelection
+{
+  gchar *name;
+  XMLScannerSelection *parent;
+  GList *children;
+  GList *attributes;
+  gboolean whole_subtree;
+};
+
 typedef struct
 {
   gboolean strip_whitespaces;
   GList *exclude_tags;
   gboolean matchstring_shouldreverse;
   GPtrArray *exclude_patterns;
+  GList *extract;
+  XMLScannerSelection *selection;
 } XMLScannerOptions;
 
 typedef struct
@@ -54,6 +67,8 @@ struct _XMLScanner
   GString *key;
   GString *text;
   GQueue *text_stack;
+  XMLScannerSelection *selection_node;
+  gint selected_depth;
   gboolean (*start_element_cb) (XMLScanner *self, const gchar *element_name, const gchar **attribute_names,
                                 const gchar **attribute_values, GError **error);
   void (*end_element_cb) (XMLScanner *self, const gchar *element_name, GError **error);
@@ -82,6 +97,7 @@ void xml_scanner_text_method(XMLScanner *self, const gchar *element_name,
                              const gchar *text, gsize text_len, GError **error);
 
 void xml_scanner_options_set_and_compile_exclude_tags(XMLScannerOptions *self, GList *exclude_tags);
+void xml_scanner_options_set_and_compile_extract(XMLScannerOptions *self, GList *extract);
 void xml_scanner_options_set_strip_whitespaces(XMLScannerOptions *self, gboolean setting);
 void xml_scanner_options_copy(XMLScannerOptions *dest, XMLScannerOptions *source);
 
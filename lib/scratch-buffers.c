@@ -30,6 +30,7 @@
 #include "apphook.h"
 
 #include <iv.h>
+#include <string.h>
 
 /*
  * scratch_buffers
@@ -71,6 +72,16 @@
  *     those that are allocated by the functions you called.  Please make
  *     sure that those do not hold references after returning.
  *
+ *   - small, fixed size temporaries (names, tokens, arrays) can be
+ *     allocated using scratch_buffers_alloc_bytes() and friends.  These come
+ *     from a per-thread bump-pointer arena and follow the same lifetime
+ *     rules: they are released by the GC or by reclaiming a mark taken
+ *     before them.
+ *
+ *   - buffers that grew large during a burst, and buffers/arena chunks
+ *     above the high-water mark of the last maintenance period are freed
+ *     by the GC, so a single burst does not pin memory forever.
+ *
  * Other notes:
  *   - this is not a complete garbage collector, but a very simple allocator for
  *     buffers that creates coupling between various/independent parts of
@@ -80,10 +91,30 @@
  *     MEASURABLE PERFORMANCE IMPACT.
  */
 
+/* arena allocations are carved out of chunks of this size, larger
+ * requests get a chunk of their own */
+#define SCRATCH_BUFFERS_ARENA_CHUNK_SIZE (16 * 1024)
+#define SCRATCH_BUFFERS_ARENA_ALIGNMENT  sizeof(guint64)
+
+/* GStrings grown above this size are freed by the periodic maintenance */
+#define SCRATCH_BUFFERS_MAX_RETAINED_SIZE (64 * 1024)
+
+typedef struct _ScratchBuffersArenaChunk
+{
+  /* 64 bits, so that data is aligned as SCRATCH_BUFFERS_ARENA_ALIGNMENT */
+  guint64 size;
+  guint8 data[];
+} ScratchBuffersArenaChunk;
+
 TLS_BLOCK_START
 {
   GPtrArray *scratch_buffers;
   gint scratch_buffers_used;
+  gint scratch_buffers_high_water_mark;
+  GPtrArray *scratch_buffers_arena;
+  gint scratch_buffers_arena_chunk;
+  gsize scratch_buffers_arena_used;
+  gint scratch_buffers_arena_high_water_mark;
   gssize scratch_buffers_bytes_reported;
   time_t scratch_buffers_time_of_last_maintenance;
   struct iv_task scratch_buffers_gc;
@@ -97,6 +128,11 @@ StatsCounterItem *stats_scratch_buffers_bytes;
 
 #define scratch_buffers       __tls_deref(scratch_buffers)
 #define scratch_buffers_used  __tls_deref(scratch_buffers_used)
+#define scratch_buffers_high_water_mark  __tls_deref(scratch_buffers_high_water_mark)
+#define scratch_buffers_arena  __tls_deref(scratch_buffers_arena)
+#define scratch_buffers_arena_chunk  __tls_deref(scratch_buffers_arena_chunk)
+#define scratch_buffers_arena_used  __tls_deref(scratch_buffers_arena_used)
+#define scratch_buffers_arena_high_water_mark  __tls_deref(scratch_buffers_arena_high_water_mark)
 #define scratch_buffers_bytes_reported  __tls_deref(scratch_buffers_bytes_reported)
 #define scratch_buffers_time_of_last_maintenance  __tls_deref(scratch_buffers_time_of_last_maintenance)
 #define scratch_buffers_gc  __tls_deref(scratch_buffers_gc)
@@ -110,7 +146,9 @@ static void _register_gc_task(void);
 void
 scratch_buffers_mark(ScratchBuffersMarker *marker)
 {
-  *marker = scratch_buffers_used;
+  marker->buffers = scratch_buffers_used;
+  marker->arena_chunk = scratch_buffers_arena_chunk;
+  marker->arena_used = scratch_buffers_arena_used;
 }
 
 GString *
@@ -128,6 +166,8 @@ scratch_buffers_alloc_and_mark(ScratchBuffersMarker *marker)
   GString *buffer = g_ptr_array_index(scratch_buffers, scratch_buffers_used);
   g_string_truncate(buffer, 0);
   scratch_buffers_used++;
+  if (scratch_buffers_used > scratch_buffers_high_water_mark)
+    scratch_buffers_high_water_mark = scratch_buffers_used;
   return buffer;
 }
 
@@ -137,16 +177,107 @@ scratch_buffers_alloc(void)
   return scratch_buffers_alloc_and_mark(NULL);
 }
 
+/*********************************************************
+ * Arena
+ *********************************************************/
+
+static ScratchBuffersArenaChunk *
+_arena_chunk_new(gsize size)
+{
+  ScratchBuffersArenaChunk *chunk = g_malloc(sizeof(ScratchBuffersArenaChunk) + size);
+
+  chunk->size = size;
+  return chunk;
+}
+
+static gsize
+_arena_get_bytes(void)
+{
+  gsize bytes = 0;
+
+  for (gint i = 0; i < scratch_buffers_arena->len; i++)
+    bytes += ((ScratchBuffersArenaChunk *) g_ptr_array_index(scratch_buffers_arena, i))->size;
+  return bytes;
+}
+
+/* moves to the next chunk that can hold size bytes, allocating it if needed */
+static ScratchBuffersArenaChunk *
+_arena_advance(gsize size)
+{
+  gint next = scratch_buffers_arena_chunk + 1;
+  gsize chunk_size = MAX(size, SCRATCH_BUFFERS_ARENA_CHUNK_SIZE);
+
+  if (next == scratch_buffers_arena->len)
+    {
+      g_ptr_array_add(scratch_buffers_arena, _arena_chunk_new(chunk_size));
+    }
+  else if (((ScratchBuffersArenaChunk *) g_ptr_array_index(scratch_buffers_arena, next))->size < size)
+    {
+      g_free(g_ptr_array_index(scratch_buffers_arena, next));
+      g_ptr_array_index(scratch_buffers_arena, next) = _arena_chunk_new(chunk_size);
+    }
+
+  scratch_buffers_arena_chunk = next;
+  scratch_buffers_arena_used = 0;
+  if (scratch_buffers_arena_chunk + 1 > scratch_buffers_arena_high_water_mark)
+    scratch_buffers_arena_high_water_mark = scratch_buffers_arena_chunk + 1;
+  return g_ptr_array_index(scratch_buffers_arena, next);
+}
+
+gpointer
+scratch_buffers_alloc_bytes(gsize size)
+{
+  ScratchBuffersArenaChunk *chunk = NULL;
+  gsize offset = 0;
+
+  _register_gc_task();
+  if (scratch_buffers_arena_chunk >= 0)
+    {
+      chunk = g_ptr_array_index(scratch_buffers_arena, scratch_buffers_arena_chunk);
+      offset = (scratch_buffers_arena_used + SCRATCH_BUFFERS_ARENA_ALIGNMENT - 1) &
+               ~(SCRATCH_BUFFERS_ARENA_ALIGNMENT - 1);
+    }
+
+  if (!chunk || offset + size > chunk->size)
+    {
+      chunk = _arena_advance(size);
+      offset = 0;
+    }
+
+  scratch_buffers_arena_used = offset + size;
+  return &chunk->data[offset];
+}
+
+gchar *
+scratch_buffers_strndup(const gchar *str, gsize len)
+{
+  gchar *result = scratch_buffers_alloc_bytes(len + 1);
+
+  memcpy(result, str, len);
+  result[len] = 0;
+  return result;
+}
+
+gchar *
+scratch_buffers_strdup(const gchar *str)
+{
+  return scratch_buffers_strndup(str, strlen(str));
+}
+
 void
 scratch_buffers_reclaim_allocations(void)
 {
-  scratch_buffers_reclaim_marked(0);
+  ScratchBuffersMarker marker = { .buffers = 0, .arena_chunk = -1, .arena_used = 0 };
+
+  scratch_buffers_reclaim_marked(marker);
 }
 
 void
 scratch_buffers_reclaim_marked(ScratchBuffersMarker marker)
 {
-  scratch_buffers_used = marker;
+  scratch_buffers_used = marker.buffers;
+  scratch_buffers_arena_chunk = marker.arena_chunk;
+  scratch_buffers_arena_used = marker.arena_used;
 }
 
 /* get a snapshot of the global allocation counter, can be racy */
@@ -173,7 +304,7 @@ scratch_buffers_get_local_allocation_bytes(void)
       GString *str = g_ptr_array_index(scratch_buffers, i);
       bytes += str->allocated_len;
     }
-  return bytes;
+  return bytes + _arena_get_bytes();
 }
 
 gint
@@ -190,10 +321,56 @@ scratch_buffers_update_stats(void)
   stats_counter_add(stats_scratch_buffers_bytes, -prev_reported + scratch_buffers_bytes_reported);
 }
 
+/* NOTE: only frees buffers that are not in use, e.g. it is effective right
+ * after the GC reclaimed all allocations */
+void
+scratch_buffers_trim(void)
+{
+  gint keep = MAX(scratch_buffers_used, scratch_buffers_high_water_mark);
+  gint freed = 0;
+
+  for (gint i = scratch_buffers->len - 1; i >= scratch_buffers_used; i--)
+    {
+      GString *buffer = g_ptr_array_index(scratch_buffers, i);
+
+      if (i >= keep)
+        {
+          g_string_free(buffer, TRUE);
+          g_ptr_array_remove_index(scratch_buffers, i);
+          freed++;
+        }
+      else if (buffer->allocated_len > SCRATCH_BUFFERS_MAX_RETAINED_SIZE)
+        {
+          g_string_free(buffer, TRUE);
+          g_ptr_array_index(scratch_buffers, i) = g_string_sized_new(255);
+        }
+    }
+  stats_counter_sub(stats_scratch_buffers_count, freed);
+  scratch_buffers_high_water_mark = scratch_buffers_used;
+
+  keep = MAX(scratch_buffers_arena_chunk + 1, scratch_buffers_arena_high_water_mark);
+  for (gint i = scratch_buffers_arena->len - 1; i > scratch_buffers_arena_chunk; i--)
+    {
+      ScratchBuffersArenaChunk *chunk = g_ptr_array_index(scratch_buffers_arena, i);
+
+      if (i >= keep)
+        g_ptr_array_remove_index(scratch_buffers_arena, i);
+      else if (chunk->size > SCRATCH_BUFFERS_ARENA_CHUNK_SIZE)
+        {
+          g_free(chunk);
+          g_ptr_array_index(scratch_buffers_arena, i) = _arena_chunk_new(SCRATCH_BUFFERS_ARENA_CHUNK_SIZE);
+        }
+    }
+  scratch_buffers_arena_high_water_mark = scratch_buffers_arena_chunk + 1;
+}
+
 void
 scratch_buffers_allocator_init(void)
 {
   scratch_buffers = g_ptr_array_sized_new(256);
+  scratch_buffers_arena = g_ptr_array_new_with_free_func(g_free);
+  scratch_buffers_arena_chunk = -1;
+  scratch_buffers_arena_used = 0;
 }
 
 void
@@ -218,6 +395,7 @@ scratch_buffers_allocator_deinit(void)
       g_string_free(buffer, TRUE);
     }
   g_ptr_array_free(scratch_buffers, TRUE);
+  g_ptr_array_free(scratch_buffers_arena, TRUE);
 }
 
 /*********************************************************
@@ -230,7 +408,7 @@ _thread_maintenance_period_elapsed(void)
   if (!scratch_buffers_time_of_last_maintenance)
     return TRUE;
 
-  if (scratch_buffers_time_of_last_maintenance - cached_g_current_time_sec() >= SCRATCH_BUFFERS_MAINTENANCE_PERIOD)
+  if (cached_g_current_time_sec() - scratch_buffers_time_of_last_maintenance >= SCRATCH_BUFFERS_MAINTENANCE_PERIOD)
     return TRUE;
   return FALSE;
 }
@@ -258,8 +436,13 @@ scratch_buffers_lazy_update_stats(void)
 void
 scratch_buffers_explicit_gc(void)
 {
-  scratch_buffers_lazy_update_stats();
   scratch_buffers_reclaim_allocations();
+  if (_thread_maintenance_period_elapsed())
+    {
+      scratch_buffers_trim();
+      scratch_buffers_update_stats();
+      _thread_maintenance_update_time();
+    }
   scratch_buffers_gc_executed = TRUE;
 }
 
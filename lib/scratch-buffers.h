@@ -27,10 +27,18 @@
 
 #include "syslog-ng.h"
 
-typedef gint32 ScratchBuffersMarker;
+typedef struct _ScratchBuffersMarker
+{
+  gint32 buffers;
+  gint32 arena_chunk;
+  gsize arena_used;
+} ScratchBuffersMarker;
 
 GString *scratch_buffers_alloc(void);
 GString *scratch_buffers_alloc_and_mark(ScratchBuffersMarker *marker);
+gpointer scratch_buffers_alloc_bytes(gsize size);
+gchar *scratch_buffers_strndup(const gchar *str, gsize len);
+gchar *scratch_buffers_strdup(const gchar *str);
 void scratch_buffers_mark(ScratchBuffersMarker *marker);
 void scratch_buffers_reclaim_allocations(void);
 void scratch_buffers_reclaim_marked(ScratchBuffersMarker marker);
@@ -40,6 +48,7 @@ gssize scratch_buffers_get_local_allocation_count(void);
 gssize scratch_buffers_get_local_allocation_bytes(void);
 gint scratch_buffers_get_local_usage_count(void);
 void scratch_buffers_update_stats(void);
+void scratch_buffers_trim(void);
 
 /* lazy stats update */
 void scratch_buffers_lazy_update_stats(void);
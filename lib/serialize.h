@@ -205,6 +205,64 @@ serialize_read_uint8(SerializeArchive *archive, guint8 *value)
 }
 
 
+/* LEB128 style variable length encoding, 7 bits per byte, the highest bit
+ * indicates that more bytes follow */
+static inline gboolean
+serialize_write_varint(SerializeArchive *archive, guint64 value)
+{
+  guint8 buf[10];
+  gsize len = 0;
+
+  do
+    {
+      buf[len] = value & 0x7F;
+      value >>= 7;
+      if (value)
+        buf[len] |= 0x80;
+      len++;
+    }
+  while (value);
+  return serialize_archive_write_bytes(archive, (gchar *) buf, len);
+}
+
+static inline gboolean
+serialize_read_varint(SerializeArchive *archive, guint64 *value)
+{
+  guint64 result = 0;
+  guint8 n;
+
+  for (gint shift = 0; shift < 64; shift += 7)
+    {
+      if (!serialize_read_uint8(archive, &n))
+        return FALSE;
+      result |= ((guint64) (n & 0x7F)) << shift;
+      if ((n & 0x80) == 0)
+        {
+          *value = result;
+          return TRUE;
+        }
+    }
+  return FALSE;
+}
+
+/* zigzag encoding maps signed values with a small absolute value to small
+ * unsigned values */
+static inline gboolean
+serialize_write_varint_signed(SerializeArchive *archive, gint64 value)
+{
+  return serialize_write_varint(archive, (((guint64) value) << 1) ^ (guint64)(value >> 63));
+}
+
+static inline gboolean
+serialize_read_varint_signed(SerializeArchive *archive, gint64 *value)
+{
+  guint64 n;
+
+  if (!serialize_read_varint(archive, &n))
+    return FALSE;
+  *value = (gint64) (n >> 1) ^ -((gint64) (n & 1));
+  return TRUE;
+}
 static inline gboolean
 serialize_write_blob(SerializeArchive *archive, const void *blob, gsize len)
 {
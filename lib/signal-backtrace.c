@@ -0,0 +1,78 @@
+/*
+ * Copyright (c) 2024 One Identity LLC.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+
+#include "signal-backtrace.h"
+
+#include <errno.h>
+#include <string.h>
+
+#if SIGNAL_BACKTRACE_SUPPORTED
+
+#include <execinfo.h>
+
+#define SIGNAL_BACKTRACE_MAX_FRAMES 128
+/* signal_backtrace_capture(), the signal handler and the signal trampoline of libc */
+#define SIGNAL_BACKTRACE_SKIPPED_FRAMES 3
+
+void
+signal_backtrace_init(void)
+{
+  /* the first call of backtrace() loads libgcc, which is not safe in a signal handler */
+  gpointer frame;
+  backtrace(&frame, 1);
+}
+
+/* must not be inlined into the handler, as that would change the number of frames to skip */
+__attribute__((noinline))
+gint
+signal_backtrace_capture(gpointer *frames, gint max_frames)
+{
+  gpointer all_frames[SIGNAL_BACKTRACE_SKIPPED_FRAMES + SIGNAL_BACKTRACE_MAX_FRAMES];
+  gint saved_errno = errno;
+
+  gint depth = backtrace(all_frames, SIGNAL_BACKTRACE_SKIPPED_FRAMES + MIN(max_frames, SIGNAL_BACKTRACE_MAX_FRAMES));
+  depth -= SIGNAL_BACKTRACE_SKIPPED_FRAMES;
+  if (depth > 0)
+    memcpy(frames, &all_frames[SIGNAL_BACKTRACE_SKIPPED_FRAMES], depth * sizeof(gpointer));
+  else
+    depth = 0;
+
+  errno = saved_errno;
+  return depth;
+}
+
+#else
+
+void
+signal_backtrace_init(void)
+{
+}
+
+gint
+signal_backtrace_capture(gpointer *frames, gint max_frames)
+{
+  return 0;
+}
+
+#endif
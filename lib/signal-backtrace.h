@@ -0,0 +1,44 @@
+/*
+ * Copyright (c) 2024 One Identity LLC.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+
+#ifndef SIGNAL_BACKTRACE_H_INCLUDED
+#define SIGNAL_BACKTRACE_H_INCLUDED 1
+
+#include "syslog-ng.h"
+
+#if SYSLOG_NG_HAVE_EXECINFO_H
+#define SIGNAL_BACKTRACE_SUPPORTED 1
+#endif
+
+/*
+ * Captures the stack of the thread interrupted by a signal, from within
+ * the signal handler.  signal_backtrace_init() has to be called before
+ * the handler is installed, signal_backtrace_capture() is then
+ * async-signal-safe.  The frames of the signal handler itself are not
+ * included, 0 is returned if backtraces are not supported.
+ */
+void signal_backtrace_init(void);
+gint signal_backtrace_capture(gpointer *frames, gint max_frames);
+
+#endif
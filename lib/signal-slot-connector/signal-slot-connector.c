@@ -226,6 +226,19 @@ signal_slot_emit(SignalSlotConnector *self, Signal signal, gpointer user_data)
   g_list_foreach(slots, _run_slot, user_data);
 }
 
+/* lets the emitter skip preparing data that nobody would look at */
+gboolean
+signal_slot_is_connected(SignalSlotConnector *self, Signal signal)
+{
+  g_assert(signal != NULL);
+
+  g_mutex_lock(&self->lock);
+  gboolean connected = g_hash_table_lookup(self->connections, signal) != NULL;
+  g_mutex_unlock(&self->lock);
+
+  return connected;
+}
+
 static void
 _destroy_list_of_slots(gpointer data)
 {
@@ -51,6 +51,7 @@ void signal_slot_connect(SignalSlotConnector *self, Signal signal, Slot slot, gp
 void signal_slot_disconnect(SignalSlotConnector *self, Signal signal, Slot slot, gpointer object);
 
 void signal_slot_emit(SignalSlotConnector *self, Signal signal, gpointer user_data);
+gboolean signal_slot_is_connected(SignalSlotConnector *self, Signal signal);
 
 SignalSlotConnector *signal_slot_connector_new(void);
 void signal_slot_connector_free(SignalSlotConnector *self);
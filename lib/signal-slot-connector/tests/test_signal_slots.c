@@ -181,6 +181,24 @@ Test(basic_signal_slots, when_disconnect_the_connected_slot_from_a_signal_then_t
   signal_slot_connector_free(ssc);
 }
 
+Test(basic_signal_slots, is_connected_reflects_the_connected_slots)
+{
+  SignalSlotConnector *ssc = signal_slot_connector_new();
+  SlotObj slot_obj;
+  slot_obj_init(&slot_obj);
+
+  cr_expect_not(signal_slot_is_connected(ssc, signal_test1));
+
+  CONNECT(ssc, signal_test1, test1_slot, &slot_obj);
+  cr_expect(signal_slot_is_connected(ssc, signal_test1));
+  cr_expect_not(signal_slot_is_connected(ssc, signal_test2));
+
+  DISCONNECT(ssc, signal_test1, test1_slot, &slot_obj);
+  cr_expect_not(signal_slot_is_connected(ssc, signal_test1));
+
+  signal_slot_connector_free(ssc);
+}
+
 Test(basic_signal_slots,
      abort_when_trying_to_disconnect_a_connected_slot_with_different_slot_object_then_slot_is_not_disconnected,
      .signal = SIGABRT)
@@ -0,0 +1,469 @@
+/*
+ * Copyright (c) 2024 One Identity LLC.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+
+#include "stack-sampler.h"
+#include "logpipe.h"
+#include "cfg-tree.h"
+#include "messages.h"
+#include "tls-support.h"
+#include "timeutils/misc.h"
+#include "signal-backtrace.h"
+
+#include <iv.h>
+#include <errno.h>
+#include <signal.h>
+#include <string.h>
+#include <sys/time.h>
+
+#if SIGNAL_BACKTRACE_SUPPORTED && SYSLOG_NG_HAVE_DLFCN_H && SYSLOG_NG_HAVE_THREAD_KEYWORD
+#define STACK_SAMPLER_SUPPORTED 1
+#include <dlfcn.h>
+#endif
+
+#define STACK_SAMPLER_MAX_FREQUENCY 1000
+#define STACK_SAMPLER_MAX_DEPTH 64
+/* must be a power of 2, enough for 1000Hz on 40 busy threads between two drains */
+#define STACK_SAMPLER_RING_SIZE 4096
+#define STACK_SAMPLER_DRAIN_INTERVAL_MSEC 100
+
+/*
+ * The ring is a bounded multi-producer queue, slots are reserved by a CAS
+ * on write_position and are published by setting their sequence number.
+ * The only consumer is the main thread.  It is allocated at the first
+ * start and kept afterwards, as a signal may still be delivered to another
+ * thread while the sampler is being stopped.
+ */
+typedef struct _StackSample
+{
+  gint sequence;
+  gint depth;
+  const gchar *tag;
+  gpointer frames[STACK_SAMPLER_MAX_DEPTH];
+} StackSample;
+
+typedef struct _StackKey
+{
+  const gchar *tag;
+  gint depth;
+  gpointer frames[];
+} StackKey;
+
+gboolean stack_sampler_running;
+
+static StackSample *samples;
+static gint write_position;
+static gint read_position;
+static gint dropped_samples;
+static gboolean signal_handler_installed;
+
+/* StackKey -> number of samples, only used by the main thread */
+static GHashTable *stacks;
+static guint collected_samples;
+static struct iv_timer drain_timer;
+
+TLS_BLOCK_START
+{
+  const gchar *stack_sampler_tag;
+}
+TLS_BLOCK_END;
+
+#define stack_sampler_tag __tls_deref(stack_sampler_tag)
+
+GQuark
+stack_sampler_error_quark(void)
+{
+  return g_quark_from_static_string("stack-sampler-error-quark");
+}
+
+static const gchar *
+_rule_kind(gint content)
+{
+  switch (content)
+    {
+    case ENC_SOURCE:
+      return "source";
+    case ENC_DESTINATION:
+      return "destination";
+    case ENC_FILTER:
+      return "filter";
+    case ENC_PARSER:
+      return "parser";
+    case ENC_REWRITE:
+      return "rewrite";
+    default:
+      return NULL;
+    }
+}
+
+/* the tags are interned, so that the samples referring to them remain
+ * valid after the configuration is reloaded */
+static const gchar *
+_lookup_pipe_tag(LogPipe *pipe)
+{
+  for (LogExprNode *node = pipe->expr_node; node; node = node->parent)
+    {
+      const gchar *kind = _rule_kind(node->content);
+
+      if (kind && node->name)
+        {
+          gchar *tag = g_strdup_printf("%s:%s", kind, node->name);
+          const gchar *interned_tag = g_intern_string(tag);
+
+          g_free(tag);
+          return interned_tag;
+        }
+    }
+  return "";
+}
+
+const gchar *
+stack_sampler_enter_pipe(LogPipe *pipe)
+{
+  const gchar *saved_tag = stack_sampler_tag;
+
+  /* racing threads store the same interned string here */
+  if (G_UNLIKELY(!pipe->sampler_tag))
+    pipe->sampler_tag = _lookup_pipe_tag(pipe);
+
+  if (pipe->sampler_tag[0])
+    stack_sampler_tag = pipe->sampler_tag;
+  return saved_tag;
+}
+
+void
+stack_sampler_leave_pipe(const gchar *saved_tag)
+{
+  stack_sampler_tag = saved_tag;
+}
+
+#if STACK_SAMPLER_SUPPORTED
+
+static void
+_sigprof_handler(int signo)
+{
+  if (!stack_sampler_running)
+    return;
+
+  gint saved_errno = errno;
+  guint position = g_atomic_int_get(&write_position);
+  StackSample *sample;
+
+  while (TRUE)
+    {
+      sample = &samples[position & (STACK_SAMPLER_RING_SIZE - 1)];
+
+      gint diff = (gint) ((guint) g_atomic_int_get(&sample->sequence) - position);
+      if (diff == 0)
+        {
+          if (g_atomic_int_compare_and_exchange(&write_position, (gint) position, (gint) (position + 1)))
+            break;
+        }
+      else if (diff < 0)
+        {
+          /* the ring is full, the main thread did not keep up */
+          g_atomic_int_inc(&dropped_samples);
+          errno = saved_errno;
+          return;
+        }
+      position = g_atomic_int_get(&write_position);
+    }
+
+  sample->tag = stack_sampler_tag;
+  sample->depth = signal_backtrace_capture(sample->frames, STACK_SAMPLER_MAX_DEPTH);
+  g_atomic_int_set(&sample->sequence, (gint) (position + 1));
+
+  errno = saved_errno;
+}
+
+static guint
+_stack_key_hash(gconstpointer k)
+{
+  const StackKey *key = (const StackKey *) k;
+  guint hash = g_direct_hash(key->tag) ^ key->depth;
+
+  for (gint i = 0; i < key->depth; i++)
+    hash = (hash * 31) ^ g_direct_hash(key->frames[i]);
+  return hash;
+}
+
+static gboolean
+_stack_key_equal(gconstpointer a, gconstpointer b)
+{
+  const StackKey *key_a = (const StackKey *) a;
+  const StackKey *key_b = (const StackKey *) b;
+
+  return key_a->tag == key_b->tag &&
+         key_a->depth == key_b->depth &&
+         memcmp(key_a->frames, key_b->frames, key_a->depth * sizeof(gpointer)) == 0;
+}
+
+static void
+_account_sample(StackSample *sample)
+{
+  gint depth = sample->depth;
+
+  if (depth <= 0)
+    return;
+
+  gsize key_size = sizeof(StackKey) + depth * sizeof(gpointer);
+  StackKey *key = g_alloca(key_size);
+
+  key->tag = sample->tag;
+  key->depth = depth;
+  memcpy(key->frames, sample->frames, depth * sizeof(gpointer));
+
+  gpointer orig_key, count;
+  if (g_hash_table_lookup_extended(stacks, key, &orig_key, &count))
+    g_hash_table_insert(stacks, orig_key, GUINT_TO_POINTER(GPOINTER_TO_UINT(count) + 1));
+  else
+    g_hash_table_insert(stacks, g_memdup(key, key_size), GUINT_TO_POINTER(1));
+  collected_samples++;
+}
+
+static void
+_drain_samples(void)
+{
+  while (TRUE)
+    {
+      StackSample *sample = &samples[(guint) read_position & (STACK_SAMPLER_RING_SIZE - 1)];
+
+      if (g_atomic_int_get(&sample->sequence) != (gint) ((guint) read_position + 1))
+        break;
+
+      _account_sample(sample);
+      g_atomic_int_set(&sample->sequence, (gint) ((guint) read_position + STACK_SAMPLER_RING_SIZE));
+      read_position = (gint) ((guint) read_position + 1);
+    }
+}
+
+static void
+_arm_drain_timer(void)
+{
+  iv_validate_now();
+  drain_timer.expires = iv_now;
+  timespec_add_msec(&drain_timer.expires, STACK_SAMPLER_DRAIN_INTERVAL_MSEC);
+  iv_timer_register(&drain_timer);
+}
+
+static void
+_drain_timer_expired(void *cookie)
+{
+  _drain_samples();
+  _arm_drain_timer();
+}
+
+/* return addresses point after the call instruction, which may already
+ * belong to the next function */
+static gchar *
+_symbolize_frame(gpointer frame, gboolean return_address)
+{
+  gpointer address = return_address ? (gchar *) frame - 1 : frame;
+  Dl_info info;
+
+  memset(&info, 0, sizeof(info));
+  if (!dladdr(address, &info) || !info.dli_fname)
+    return g_strdup_printf("%p", frame);
+
+  if (info.dli_sname)
+    return g_strdup(info.dli_sname);
+
+  /* static functions are not in the dynamic symbol table */
+  const gchar *basename = strrchr(info.dli_fname, '/');
+  return g_strdup_printf("%s+0x%lx", basename ? basename + 1 : info.dli_fname,
+                         (gulong) ((gchar *) address - (gchar *) info.dli_fbase));
+}
+
+static const gchar *
+_lookup_symbol(GHashTable *symbols, gpointer frame, gboolean return_address)
+{
+  gchar *symbol = g_hash_table_lookup(symbols, frame);
+
+  if (!symbol)
+    {
+      symbol = _symbolize_frame(frame, return_address);
+      g_hash_table_insert(symbols, frame, symbol);
+    }
+  return symbol;
+}
+
+static void
+_format_collapsed_stacks(GString *result)
+{
+  GHashTable *symbols = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, g_free);
+  GHashTableIter iter;
+  gpointer k, count;
+
+  g_hash_table_iter_init(&iter, stacks);
+  while (g_hash_table_iter_next(&iter, &k, &count))
+    {
+      StackKey *key = (StackKey *) k;
+
+      g_string_append(result, key->tag ? : "-");
+      for (gint i = key->depth - 1; i >= 0; i--)
+        {
+          g_string_append_c(result, ';');
+          g_string_append(result, _lookup_symbol(symbols, key->frames[i], i != 0));
+        }
+      g_string_append_printf(result, " %u\n", GPOINTER_TO_UINT(count));
+    }
+  g_hash_table_destroy(symbols);
+}
+
+static gboolean
+_install_signal_handler(GError **error)
+{
+  if (signal_handler_installed)
+    return TRUE;
+
+  signal_backtrace_init();
+
+  struct sigaction sa;
+
+  memset(&sa, 0, sizeof(sa));
+  sa.sa_handler = _sigprof_handler;
+  sigemptyset(&sa.sa_mask);
+  sa.sa_flags = SA_RESTART;
+  if (sigaction(SIGPROF, &sa, NULL) < 0)
+    {
+      g_set_error(error, STACK_SAMPLER_ERROR, 0, "Error installing the SIGPROF handler: %s", g_strerror(errno));
+      return FALSE;
+    }
+
+  samples = g_new0(StackSample, STACK_SAMPLER_RING_SIZE);
+  for (gint i = 0; i < STACK_SAMPLER_RING_SIZE; i++)
+    samples[i].sequence = i;
+
+  IV_TIMER_INIT(&drain_timer);
+  drain_timer.handler = _drain_timer_expired;
+  signal_handler_installed = TRUE;
+  return TRUE;
+}
+
+gboolean
+stack_sampler_start(gint frequency, GError **error)
+{
+  if (frequency <= 0 || frequency > STACK_SAMPLER_MAX_FREQUENCY)
+    {
+      g_set_error(error, STACK_SAMPLER_ERROR, 0, "Invalid sampling frequency, it must be between 1 and %d Hz",
+                  STACK_SAMPLER_MAX_FREQUENCY);
+      return FALSE;
+    }
+
+  if (stack_sampler_running)
+    {
+      g_set_error(error, STACK_SAMPLER_ERROR, 0, "The stack sampler is already running");
+      return FALSE;
+    }
+
+  if (!_install_signal_handler(error))
+    return FALSE;
+
+  stacks = g_hash_table_new_full(_stack_key_hash, _stack_key_equal, g_free, NULL);
+  collected_samples = 0;
+  g_atomic_int_set(&dropped_samples, 0);
+  stack_sampler_running = TRUE;
+
+  struct itimerval timer =
+  {
+    .it_interval = { .tv_sec = 0, .tv_usec = 1000000 / frequency },
+  };
+  timer.it_value = timer.it_interval;
+  if (setitimer(ITIMER_PROF, &timer, NULL) < 0)
+    {
+      g_set_error(error, STACK_SAMPLER_ERROR, 0, "Error starting the profiling timer: %s", g_strerror(errno));
+      stack_sampler_running = FALSE;
+      g_hash_table_destroy(stacks);
+      stacks = NULL;
+      return FALSE;
+    }
+
+  _arm_drain_timer();
+  return TRUE;
+}
+
+/* stops the sampler and appends the collected profile in the collapsed
+ * format to collapsed_stacks, one line per unique stack */
+gboolean
+stack_sampler_stop(GString *collapsed_stacks)
+{
+  if (!stack_sampler_running)
+    return FALSE;
+
+  struct itimerval disarm;
+
+  memset(&disarm, 0, sizeof(disarm));
+  setitimer(ITIMER_PROF, &disarm, NULL);
+  stack_sampler_running = FALSE;
+
+  if (iv_timer_registered(&drain_timer))
+    iv_timer_unregister(&drain_timer);
+  _drain_samples();
+
+  msg_info("Stack sampling stopped",
+           evt_tag_int("samples", collected_samples),
+           evt_tag_int("unique_stacks", g_hash_table_size(stacks)),
+           evt_tag_int("dropped_samples", g_atomic_int_get(&dropped_samples)));
+
+  if (collapsed_stacks)
+    _format_collapsed_stacks(collapsed_stacks);
+
+  g_hash_table_destroy(stacks);
+  stacks = NULL;
+  return TRUE;
+}
+
+void
+stack_sampler_global_deinit(void)
+{
+  stack_sampler_stop(NULL);
+  if (!signal_handler_installed)
+    return;
+
+  signal(SIGPROF, SIG_IGN);
+  g_free(samples);
+  samples = NULL;
+  signal_handler_installed = FALSE;
+}
+
+#else
+
+gboolean
+stack_sampler_start(gint frequency, GError **error)
+{
+  g_set_error(error, STACK_SAMPLER_ERROR, 0, "Stack sampling is not supported on this platform");
+  return FALSE;
+}
+
+gboolean
+stack_sampler_stop(GString *collapsed_stacks)
+{
+  return FALSE;
+}
+
+void
+stack_sampler_global_deinit(void)
+{
+}
+
+#endif
@@ -0,0 +1,61 @@
+/*
+ * Copyright (c) 2024 One Identity LLC.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+
+#ifndef STACK_SAMPLER_H_INCLUDED
+#define STACK_SAMPLER_H_INCLUDED
+
+#include "syslog-ng.h"
+
+/*
+ * Optional sampling CPU profiler, controlled by "syslog-ng-ctl profile
+ * start/stop", for boxes where perf is not available.
+ *
+ * While running, the threads consuming CPU are interrupted by SIGPROF at
+ * the requested frequency (of CPU time) and their call stacks are stored
+ * as raw addresses in a lock-free ring, which is periodically drained by
+ * the main thread.  Symbols are only resolved when the profile is
+ * formatted, in the collapsed stack format used by flamegraph.pl and
+ * friends.
+ *
+ * The samples are tagged with the innermost named source, destination,
+ * filter, parser or rewrite rule the thread was executing, as
+ * log_pipe_queue() maintains the tag of the current thread while the
+ * sampler runs.
+ */
+
+extern gboolean stack_sampler_running;
+
+const gchar *stack_sampler_enter_pipe(LogPipe *pipe);
+void stack_sampler_leave_pipe(const gchar *saved_tag);
+
+#define STACK_SAMPLER_ERROR stack_sampler_error_quark()
+
+GQuark stack_sampler_error_quark(void);
+
+gboolean stack_sampler_start(gint frequency, GError **error);
+gboolean stack_sampler_stop(GString *collapsed_stacks);
+
+void stack_sampler_global_deinit(void);
+
+#endif
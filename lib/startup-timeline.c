@@ -0,0 +1,67 @@
+/*
+ * Copyright (c) 2024 One Identity LLC.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+
+#include "startup-timeline.h"
+
+/*
+ * Milestones of the first startup of syslog-ng, reported by
+ * "syslog-ng-ctl startup-timeline".  They are recorded from the main
+ * thread only, in chronological order.
+ */
+
+#define STARTUP_TIMELINE_MAX_MILESTONES 16
+
+typedef struct _StartupMilestone
+{
+  const gchar *name;
+  gint64 time;
+} StartupMilestone;
+
+static StartupMilestone milestones[STARTUP_TIMELINE_MAX_MILESTONES];
+static gint num_milestones;
+
+void
+startup_timeline_mark(const gchar *milestone)
+{
+  if (num_milestones == STARTUP_TIMELINE_MAX_MILESTONES)
+    return;
+
+  milestones[num_milestones].name = milestone;
+  milestones[num_milestones].time = g_get_monotonic_time();
+  num_milestones++;
+}
+
+void
+startup_timeline_format(GString *result)
+{
+  g_string_append(result, "milestone;elapsed_msec;step_msec\n");
+
+  for (gint i = 0; i < num_milestones; i++)
+    {
+      gint64 elapsed = milestones[i].time - milestones[0].time;
+      gint64 step = i > 0 ? milestones[i].time - milestones[i - 1].time : 0;
+
+      g_string_append_printf(result, "%s;%.3f;%.3f\n", milestones[i].name, elapsed / 1000.0, step / 1000.0);
+    }
+}
@@ -0,0 +1,146 @@
+/*
+ * Copyright (c) 2024 One Identity LLC.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+
+#include "stats/aggregator/stats-rollup.h"
+
+#include <string.h>
+
+struct _StatsRollup
+{
+  /* key -> StatsRollupEntry, the entries are owned by the array */
+  GHashTable *index;
+  GPtrArray *entries;
+  GDestroyNotify user_data_free;
+};
+
+gboolean
+stats_rollup_type_parse(const gchar *name, StatsRollupType *type)
+{
+  if (strcmp(name, "counter") == 0)
+    *type = STATS_ROLLUP_COUNTER;
+  else if (strcmp(name, "gauge") == 0)
+    *type = STATS_ROLLUP_GAUGE;
+  else if (strcmp(name, "timing") == 0)
+    *type = STATS_ROLLUP_TIMING;
+  else
+    return FALSE;
+
+  return TRUE;
+}
+
+static StatsRollupEntry *
+_entry_new(const gchar *key, gdouble value)
+{
+  StatsRollupEntry *self = g_new0(StatsRollupEntry, 1);
+
+  self->key = g_strdup(key);
+  self->min = value;
+  self->max = value;
+  return self;
+}
+
+static void
+_entry_add_data_point(StatsRollupEntry *self, gdouble value)
+{
+  self->count++;
+  self->sum += value;
+  self->last = value;
+  if (value < self->min)
+    self->min = value;
+  if (value > self->max)
+    self->max = value;
+}
+
+static void
+_entry_free(StatsRollup *self, StatsRollupEntry *entry)
+{
+  if (entry->user_data && self->user_data_free)
+    self->user_data_free(entry->user_data);
+  g_free(entry->key);
+  g_free(entry);
+}
+
+StatsRollupEntry *
+stats_rollup_lookup(StatsRollup *self, const gchar *key)
+{
+  return g_hash_table_lookup(self->index, key);
+}
+
+StatsRollupEntry *
+stats_rollup_add_data_point(StatsRollup *self, const gchar *key, gdouble value)
+{
+  StatsRollupEntry *entry = stats_rollup_lookup(self, key);
+
+  if (!entry)
+    {
+      entry = _entry_new(key, value);
+      g_ptr_array_add(self->entries, entry);
+      g_hash_table_insert(self->index, entry->key, entry);
+    }
+
+  _entry_add_data_point(entry, value);
+  return entry;
+}
+
+void
+stats_rollup_foreach(StatsRollup *self, StatsRollupForeachFunc func, gpointer user_data)
+{
+  for (guint i = 0; i < self->entries->len; i++)
+    func(g_ptr_array_index(self->entries, i), user_data);
+}
+
+guint
+stats_rollup_get_size(StatsRollup *self)
+{
+  return self->entries->len;
+}
+
+void
+stats_rollup_reset(StatsRollup *self)
+{
+  g_hash_table_remove_all(self->index);
+  for (guint i = 0; i < self->entries->len; i++)
+    _entry_free(self, g_ptr_array_index(self->entries, i));
+  g_ptr_array_set_size(self->entries, 0);
+}
+
+StatsRollup *
+stats_rollup_new(GDestroyNotify user_data_free)
+{
+  StatsRollup *self = g_new0(StatsRollup, 1);
+
+  self->index = g_hash_table_new(g_str_hash, g_str_equal);
+  self->entries = g_ptr_array_new();
+  self->user_data_free = user_data_free;
+  return self;
+}
+
+void
+stats_rollup_free(StatsRollup *self)
+{
+  stats_rollup_reset(self);
+  g_hash_table_destroy(self->index);
+  g_ptr_array_free(self->entries, TRUE);
+  g_free(self);
+}
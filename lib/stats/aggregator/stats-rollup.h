@@ -0,0 +1,97 @@
+/*
+ * Copyright (c) 2024 One Identity LLC.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+
+#ifndef STATS_ROLLUP_H
+#define STATS_ROLLUP_H
+
+#include "syslog-ng.h"
+
+/*
+ * Client side rollup of metric data points.
+ *
+ * Unlike the StatsAggregator instances, which feed a single registered
+ * output counter, a rollup accumulates any number of metric keys over an
+ * interval chosen by its user, who then emits one summary per key and
+ * resets it.  It is not thread safe, it is meant to be owned by a single
+ * worker.  Entries are iterated in the order of their first data point.
+ */
+typedef enum
+{
+  /* the sum of the data points */
+  STATS_ROLLUP_COUNTER,
+  /* the last data point */
+  STATS_ROLLUP_GAUGE,
+  /* the mean, along with count, min and max */
+  STATS_ROLLUP_TIMING,
+} StatsRollupType;
+
+typedef struct _StatsRollupEntry
+{
+  gchar *key;
+  gint64 count;
+  gdouble sum;
+  gdouble min;
+  gdouble max;
+  gdouble last;
+  /* owned by the entry, freed with the user_data_free of the rollup */
+  gpointer user_data;
+} StatsRollupEntry;
+
+typedef struct _StatsRollup StatsRollup;
+typedef void (*StatsRollupForeachFunc)(StatsRollupEntry *entry, gpointer user_data);
+
+static inline gdouble
+stats_rollup_entry_get_mean(StatsRollupEntry *self)
+{
+  return self->count ? self->sum / self->count : 0;
+}
+
+static inline gdouble
+stats_rollup_entry_get_value(StatsRollupEntry *self, StatsRollupType type)
+{
+  switch (type)
+    {
+    case STATS_ROLLUP_COUNTER:
+      return self->sum;
+    case STATS_ROLLUP_GAUGE:
+      return self->last;
+    case STATS_ROLLUP_TIMING:
+      return stats_rollup_entry_get_mean(self);
+    default:
+      g_assert_not_reached();
+    }
+}
+
+gboolean stats_rollup_type_parse(const gchar *name, StatsRollupType *type);
+
+StatsRollupEntry *stats_rollup_lookup(StatsRollup *self, const gchar *key);
+StatsRollupEntry *stats_rollup_add_data_point(StatsRollup *self, const gchar *key, gdouble value);
+void stats_rollup_foreach(StatsRollup *self, StatsRollupForeachFunc func, gpointer user_data);
+guint stats_rollup_get_size(StatsRollup *self);
+void stats_rollup_reset(StatsRollup *self);
+
+StatsRollup *stats_rollup_new(GDestroyNotify user_data_free);
+void stats_rollup_free(StatsRollup *self);
+
+#endif /* STATS_ROLLUP_H */
@@ -447,6 +447,12 @@ stats_cluster_free(StatsCluster *self)
   stats_cluster_foreach_counter(self, stats_cluster_free_counter, NULL);
   stats_cluster_key_cloned_free(&self->key);
   g_free(self->query_key);
+  if (self->prometheus_names)
+    {
+      for (gint type = 0; type < self->counter_group.capacity; type++)
+        g_free(self->prometheus_names[type]);
+      g_free(self->prometheus_names);
+    }
   stats_counter_group_free(&self->counter_group);
   g_free(self);
 }
@@ -160,6 +160,8 @@ typedef struct _StatsCluster
   guint16 indexed_mask;
   guint16 dynamic:1;
   gchar *query_key;
+  /* formatted metric names per counter type, see stats-prometheus.c */
+  gchar **prometheus_names;
 } StatsCluster;
 
 typedef void (*StatsForeachCounterFunc)(StatsCluster *sc, gint type, StatsCounterItem *counter, gpointer user_data);
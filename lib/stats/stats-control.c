@@ -33,6 +33,8 @@
 #include "control/control-commands.h"
 #include "control/control-server.h"
 #include "control/control-connection.h"
+#include "mainloop-worker.h"
+#include "scratch-buffers.h"
 
 #include <string.h>
 
@@ -91,6 +93,76 @@ _send_batched_response(const gchar *record, gpointer user_data)
     }
 }
 
+/* the metrics of `syslog-ng-ctl top`, the queue metrics are part of output_events_total */
+static const gchar *top_metric_names[] =
+{
+  "input_events_total",
+  "output_events_total",
+  "output_unreachable_workers",
+  "output_flush_duration_seconds_sum",
+  "output_flush_duration_seconds_count",
+  "memory_usage_bytes",
+  NULL
+};
+
+static gboolean
+_is_top_metric(StatsCluster *sc, gint type)
+{
+  /* the windows of sources only have legacy names */
+  if (!sc->key.name)
+    {
+      const gchar *type_name = stats_cluster_get_type_name(sc, type);
+      return strcmp(type_name, "free_window") == 0 || strcmp(type_name, "full_window") == 0;
+    }
+
+  for (gint i = 0; top_metric_names[i]; i++)
+    {
+      if (strcmp(sc->key.name, top_metric_names[i]) == 0)
+        return TRUE;
+    }
+  return FALSE;
+}
+
+static void
+_format_top_counter(StatsCluster *sc, gint type, StatsCounterItem *counter, gpointer user_data)
+{
+  if (!_is_top_metric(sc, type))
+    return;
+
+  ScratchBuffersMarker marker;
+  scratch_buffers_mark(&marker);
+
+  GString *record = stats_prometheus_format_counter(sc, type, counter);
+  if (record)
+    _send_batched_response(record->str, user_data);
+
+  scratch_buffers_reclaim_marked(marker);
+}
+
+static void
+_format_top_thread(gint thread_index, MainLoopWorkerType worker_type, gint64 cpu_time_usec, gpointer user_data)
+{
+  if (cpu_time_usec < 0)
+    return;
+
+  gchar record[128];
+  g_snprintf(record, sizeof(record), "syslogng_worker_cpu_seconds{thread=\"%d\",type=\"%s\"} %.6f\n",
+             thread_index, main_loop_worker_type_name(worker_type), (gdouble) cpu_time_usec / G_USEC_PER_SEC);
+  _send_batched_response(record, user_data);
+}
+
+/*
+ * A snapshot of the saturation related metrics, sampled periodically by
+ * `syslog-ng-ctl top`.  It does not hold stats_lock() while walking the
+ * dynamic clusters, so it is cheap enough to poll on a busy instance.
+ */
+static void
+_generate_top(gpointer user_data, gboolean *cancelled)
+{
+  stats_foreach_counter_sharded(_format_top_counter, user_data, cancelled);
+  main_loop_worker_foreach_thread(_format_top_thread, user_data);
+}
+
 static void
 control_connection_send_stats(ControlConnection *cc, GString *command, gpointer user_data, gboolean *cancelled)
 {
@@ -105,6 +177,8 @@ control_connection_send_stats(ControlConnection *cc, GString *command, gpointer
       gboolean with_legacy = g_strcmp0(cmds[2], "WITH_LEGACY") == 0;
       stats_generate_prometheus(_send_batched_response, args, with_legacy, cancelled);
     }
+  else if (g_strcmp0(cmds[1], "TOP") == 0)
+    _generate_top(args, cancelled);
   else
     stats_generate_csv(_send_batched_response, args, cancelled);
 
@@ -29,6 +29,11 @@
 
 #define STATS_COUNTER_MAX_VALUE G_MAXSIZE
 
+/* striped counters: the number of per-thread slots and the distance
+ * between them (one cache line), see stats_counter_enable_striping() */
+#define STATS_COUNTER_STRIPES 16
+#define STATS_COUNTER_STRIPE_STRIDE (64 / sizeof(atomic_gssize))
+
 typedef struct _StatsCounterItem
 {
   union
@@ -36,11 +41,16 @@ typedef struct _StatsCounterItem
     atomic_gssize value;
     atomic_gssize *value_ref;
   };
+  atomic_gssize *stripes;
   gchar *name;
   gint type;
   gboolean external;
 } StatsCounterItem;
 
+void stats_counter_enable_striping(StatsCounterItem *counter);
+atomic_gssize *stats_counter_get_stripe(StatsCounterItem *counter, atomic_gssize *stripes);
+gsize stats_counter_sum_stripes(StatsCounterItem *counter, atomic_gssize *stripes);
+void stats_counter_clear_stripes(atomic_gssize *stripes);
 
 static gboolean
 stats_counter_read_only(StatsCounterItem *counter)
@@ -48,13 +58,24 @@ stats_counter_read_only(StatsCounterItem *counter)
   return counter->external;
 }
 
+/* the location to update: the value itself or the current thread's stripe */
+static inline atomic_gssize *
+_stats_counter_value_to_update(StatsCounterItem *counter)
+{
+  atomic_gssize *stripes = g_atomic_pointer_get(&counter->stripes);
+
+  if (G_LIKELY(!stripes))
+    return &counter->value;
+  return stats_counter_get_stripe(counter, stripes);
+}
+
 static inline void
 stats_counter_add(StatsCounterItem *counter, gssize add)
 {
   if (counter)
     {
       g_assert(!stats_counter_read_only(counter));
-      atomic_gssize_add(&counter->value, add);
+      atomic_gssize_add(_stats_counter_value_to_update(counter), add);
     }
 }
 
@@ -64,7 +85,7 @@ stats_counter_sub(StatsCounterItem *counter, gssize sub)
   if (counter)
     {
       g_assert(!stats_counter_read_only(counter));
-      atomic_gssize_sub(&counter->value, sub);
+      atomic_gssize_sub(_stats_counter_value_to_update(counter), sub);
     }
 }
 
@@ -74,7 +95,7 @@ stats_counter_inc(StatsCounterItem *counter)
   if (counter)
     {
       g_assert(!stats_counter_read_only(counter));
-      atomic_gssize_inc(&counter->value);
+      atomic_gssize_inc(_stats_counter_value_to_update(counter));
     }
 }
 
@@ -84,7 +105,7 @@ stats_counter_dec(StatsCounterItem *counter)
   if (counter)
     {
       g_assert(!stats_counter_read_only(counter));
-      atomic_gssize_dec(&counter->value);
+      atomic_gssize_dec(_stats_counter_value_to_update(counter));
     }
 }
 
@@ -93,7 +114,11 @@ stats_counter_set(StatsCounterItem *counter, gsize value)
 {
   if (counter && !stats_counter_read_only(counter))
     {
+      atomic_gssize *stripes = g_atomic_pointer_get(&counter->stripes);
+
       atomic_gssize_set(&counter->value, value);
+      if (stripes)
+        stats_counter_clear_stripes(stripes);
     }
 }
 
@@ -104,7 +129,11 @@ stats_counter_get(StatsCounterItem *counter)
 
   if (counter)
     {
-      if (!counter->external)
+      atomic_gssize *stripes = g_atomic_pointer_get(&counter->stripes);
+
+      if (!counter->external && stripes)
+        result = stats_counter_sum_stripes(counter, stripes);
+      else if (!counter->external)
         result = atomic_gssize_get_unsigned(&counter->value);
       else
         result = atomic_gssize_get_unsigned(counter->value_ref);
@@ -131,6 +160,7 @@ static inline void
 stats_counter_free(StatsCounterItem *counter)
 {
   g_free(counter->name);
+  g_free(counter->stripes);
 }
 
 #endif
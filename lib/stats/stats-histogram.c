@@ -0,0 +1,187 @@
+/*
+ * Copyright (c) 2024 One Identity LLC.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#include "stats/stats-histogram.h"
+#include "stats/stats-registry.h"
+#include "stats/stats-cluster-single.h"
+
+#include <string.h>
+
+static StatsClusterKey *
+_build_key(StatsClusterKeyBuilder *kb, const gchar *name, const gchar *suffix, const gchar *le,
+           StatsClusterUnit unit)
+{
+  stats_cluster_key_builder_push(kb);
+  stats_cluster_key_builder_set_name(kb, name);
+  stats_cluster_key_builder_set_name_suffix(kb, suffix);
+  stats_cluster_key_builder_set_unit(kb, unit);
+  if (le)
+    stats_cluster_key_builder_add_label(kb, stats_cluster_label("le", le));
+  StatsClusterKey *key = stats_cluster_key_builder_build_single(kb);
+  stats_cluster_key_builder_pop(kb);
+  return key;
+}
+
+/* bounds are multiplied by bound_multiplier to get them in the unit of the observed values */
+static void
+_build_keys(StatsHistogram *self, StatsClusterKeyBuilder *kb, const gchar *name,
+            const gdouble *bounds, gint num_bounds, gdouble bound_multiplier, StatsClusterUnit sum_unit)
+{
+  gchar le[G_ASCII_DTOSTR_BUF_SIZE];
+
+  g_assert(num_bounds <= STATS_HISTOGRAM_MAX_BUCKETS);
+  self->num_buckets = num_bounds;
+
+  for (gint i = 0; i < self->num_buckets; i++)
+    {
+      self->bounds[i] = bounds[i] * bound_multiplier;
+      g_ascii_dtostr(le, sizeof(le), bounds[i]);
+      self->bucket_keys[i] = _build_key(kb, name, "_bucket", le, SCU_NONE);
+    }
+  self->bucket_keys[self->num_buckets] = _build_key(kb, name, "_bucket", "+Inf", SCU_NONE);
+
+  self->sum_key = _build_key(kb, name, "_sum", NULL, sum_unit);
+  self->count_key = _build_key(kb, name, "_count", NULL, SCU_NONE);
+}
+
+static void
+_enable_striping(StatsHistogram *self)
+{
+  for (gint i = 0; i <= self->num_buckets; i++)
+    stats_counter_enable_striping(self->buckets[i]);
+  stats_counter_enable_striping(self->sum);
+  stats_counter_enable_striping(self->count);
+}
+
+static void
+_register_dynamic_counter(gint stats_level, StatsClusterKey *key, StatsCounterItem **counter)
+{
+  if (!stats_register_dynamic_counter(stats_level, key, SC_TYPE_SINGLE_VALUE, counter))
+    *counter = NULL;
+}
+
+static void
+_unregister_dynamic_counter(StatsClusterKey *key, StatsCounterItem **counter)
+{
+  if (!*counter)
+    return;
+
+  stats_unregister_dynamic_counter(stats_get_cluster(key), SC_TYPE_SINGLE_VALUE, counter);
+}
+
+/* kb carries the labels of the histogram, name is its base name */
+void
+stats_histogram_init(StatsHistogram *self, StatsClusterKeyBuilder *kb, const gchar *name, gint stats_level)
+{
+  const gdouble *bounds;
+
+  memset(self, 0, sizeof(*self));
+  gint num_bounds = stats_get_histogram_buckets(&bounds);
+
+#if STATS_COUNTER_MAX_VALUE < G_MAXUINT64
+  _build_keys(self, kb, name, bounds, num_bounds, G_USEC_PER_SEC, SCU_MILLISECONDS);
+#else
+  _build_keys(self, kb, name, bounds, num_bounds, G_USEC_PER_SEC, SCU_NANOSECONDS);
+#endif
+
+  stats_lock();
+  {
+    for (gint i = 0; i <= self->num_buckets; i++)
+      stats_register_counter(stats_level, self->bucket_keys[i], SC_TYPE_SINGLE_VALUE, &self->buckets[i]);
+    stats_register_counter(stats_level, self->sum_key, SC_TYPE_SINGLE_VALUE, &self->sum);
+    stats_register_counter(stats_level, self->count_key, SC_TYPE_SINGLE_VALUE, &self->count);
+  }
+  stats_unlock();
+
+  _enable_striping(self);
+}
+
+/*
+ * The histogram is only enabled if all of its counters could be
+ * registered, as the number of dynamic clusters may be limited by
+ * stats(max-dynamics()).  Observed values are integers, so fractional
+ * bounds are truncated when comparing.
+ */
+void
+stats_histogram_init_dynamic(StatsHistogram *self, StatsClusterKeyBuilder *kb, const gchar *name,
+                             gint stats_level, const gdouble *bounds, gint num_bounds)
+{
+  memset(self, 0, sizeof(*self));
+  self->dynamic = TRUE;
+  _build_keys(self, kb, name, bounds, num_bounds, 1, SCU_NONE);
+
+  stats_lock();
+  {
+    gboolean registered = TRUE;
+
+    for (gint i = 0; i <= self->num_buckets; i++)
+      {
+        _register_dynamic_counter(stats_level, self->bucket_keys[i], &self->buckets[i]);
+        registered = registered && self->buckets[i];
+      }
+    _register_dynamic_counter(stats_level, self->sum_key, &self->sum);
+    registered = registered && self->sum;
+
+    /* count is registered last, it enables the histogram */
+    if (registered)
+      _register_dynamic_counter(stats_level, self->count_key, &self->count);
+  }
+  stats_unlock();
+
+  _enable_striping(self);
+}
+
+static void
+_unregister_counter(StatsHistogram *self, StatsClusterKey *key, StatsCounterItem **counter)
+{
+  if (self->dynamic)
+    _unregister_dynamic_counter(key, counter);
+  else
+    stats_unregister_counter(key, SC_TYPE_SINGLE_VALUE, counter);
+}
+
+void
+stats_histogram_deinit(StatsHistogram *self)
+{
+  if (!self->count_key)
+    return;
+
+  stats_lock();
+  {
+    for (gint i = 0; i <= self->num_buckets; i++)
+      {
+        _unregister_counter(self, self->bucket_keys[i], &self->buckets[i]);
+        stats_cluster_key_free(self->bucket_keys[i]);
+        self->bucket_keys[i] = NULL;
+      }
+
+    _unregister_counter(self, self->sum_key, &self->sum);
+    stats_cluster_key_free(self->sum_key);
+    self->sum_key = NULL;
+
+    _unregister_counter(self, self->count_key, &self->count);
+    stats_cluster_key_free(self->count_key);
+    self->count_key = NULL;
+  }
+  stats_unlock();
+}
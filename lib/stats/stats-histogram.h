@@ -0,0 +1,110 @@
+/*
+ * Copyright (c) 2024 One Identity LLC.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#ifndef STATS_HISTOGRAM_H_INCLUDED
+#define STATS_HISTOGRAM_H_INCLUDED
+
+#include "stats/stats.h"
+#include "stats/stats-counter.h"
+#include "stats/stats-cluster-key-builder.h"
+
+/*
+ * StatsHistogram is a set of counters laid out the way Prometheus
+ * represents histograms:
+ *
+ *   <name>_bucket{le="<bound>"}   cumulative, one for each bound and +Inf
+ *   <name>_sum                    the sum of the observed durations
+ *   <name>_count                  the number of observations
+ *
+ * Histograms initialized with stats_histogram_init() measure durations:
+ * bucket bounds are in seconds and come from stats(histogram-buckets()),
+ * observations are in microseconds.  stats_histogram_init_dynamic() takes
+ * explicit bounds for plain integer values (e.g. sizes) and registers
+ * dynamic counters, observations go through stats_histogram_observe_value().
+ *
+ * Counters are only allocated if the stats level permits, otherwise
+ * observing is a no-op.  The counters are striped, so concurrent
+ * observations from worker threads do not contend on the same cache line.
+ */
+
+typedef struct _StatsHistogram
+{
+  gint num_buckets;
+  gboolean dynamic;
+  /* in the unit of the observed values */
+  gint64 bounds[STATS_HISTOGRAM_MAX_BUCKETS];
+
+  /* the last one is the +Inf bucket */
+  StatsClusterKey *bucket_keys[STATS_HISTOGRAM_MAX_BUCKETS + 1];
+  StatsCounterItem *buckets[STATS_HISTOGRAM_MAX_BUCKETS + 1];
+  StatsClusterKey *sum_key;
+  StatsCounterItem *sum;
+  StatsClusterKey *count_key;
+  StatsCounterItem *count;
+} StatsHistogram;
+
+void stats_histogram_init(StatsHistogram *self, StatsClusterKeyBuilder *kb, const gchar *name, gint stats_level);
+void stats_histogram_init_dynamic(StatsHistogram *self, StatsClusterKeyBuilder *kb, const gchar *name,
+                                  gint stats_level, const gdouble *bounds, gint num_bounds);
+void stats_histogram_deinit(StatsHistogram *self);
+
+static inline gboolean
+stats_histogram_is_enabled(StatsHistogram *self)
+{
+  return self->count != NULL;
+}
+
+static inline void
+_stats_histogram_observe(StatsHistogram *self, gint64 value, gssize sum_increment)
+{
+  for (gint i = self->num_buckets - 1; i >= 0 && value <= self->bounds[i]; i--)
+    stats_counter_inc(self->buckets[i]);
+  stats_counter_inc(self->buckets[self->num_buckets]);
+
+  stats_counter_add(self->sum, sum_increment);
+  stats_counter_inc(self->count);
+}
+
+static inline void
+stats_histogram_observe(StatsHistogram *self, gint64 value_usec)
+{
+  if (!stats_histogram_is_enabled(self))
+    return;
+
+#if STATS_COUNTER_MAX_VALUE < G_MAXUINT64
+  _stats_histogram_observe(self, value_usec, value_usec / 1000);
+#else
+  _stats_histogram_observe(self, value_usec, value_usec * 1000);
+#endif
+}
+
+static inline void
+stats_histogram_observe_value(StatsHistogram *self, gint64 value)
+{
+  if (!stats_histogram_is_enabled(self))
+    return;
+
+  _stats_histogram_observe(self, value, value);
+}
+
+#endif
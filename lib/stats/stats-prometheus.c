@@ -181,7 +181,7 @@ _format_labels(StatsCluster *sc, gint type)
 }
 
 static GString *
-_format_legacy(StatsCluster *sc, gint type, StatsCounterItem *counter)
+_format_legacy_name(StatsCluster *sc, gint type)
 {
   GString *record = scratch_buffers_alloc();
   GString *labels = scratch_buffers_alloc();
@@ -218,30 +218,59 @@ _format_legacy(StatsCluster *sc, gint type, StatsCounterItem *counter)
   if (labels->len != 0)
     g_string_append_printf(record, "{%s}", labels->str);
 
-  const gchar *metric_value = stats_format_prometheus_format_value(&sc->key, &sc->counter_group.counters[type]);
-  g_string_append_printf(record, " %s\n", metric_value);
+  return record;
+}
+
+static GString *
+_format_name(StatsCluster *sc, gint type)
+{
+  GString *record = scratch_buffers_alloc();
+  g_string_append_printf(record, PROMETHEUS_METRIC_PREFIX "%s", stats_format_prometheus_sanitize_name(sc->key.name));
+
+  const gchar *labels = _format_labels(sc, type);
+  if (labels)
+    g_string_append_printf(record, "{%s}", labels);
 
   return record;
 }
 
+/* The metric name and the labels only depend on the key of the cluster,
+ * which never changes, so they are formatted once and stored in the
+ * cluster.  Only the values are rendered on subsequent scrapes. */
+static const gchar *
+_get_formatted_name(StatsCluster *sc, gint type)
+{
+  if (!sc->prometheus_names)
+    sc->prometheus_names = g_new0(gchar *, sc->counter_group.capacity);
+
+  if (!sc->prometheus_names[type])
+    {
+      ScratchBuffersMarker marker;
+      scratch_buffers_mark(&marker);
+
+      GString *name = sc->key.name ? _format_name(sc, type) : _format_legacy_name(sc, type);
+      sc->prometheus_names[type] = g_strndup(name->str, name->len);
+
+      scratch_buffers_reclaim_marked(marker);
+    }
+
+  return sc->prometheus_names[type];
+}
+
 GString *
 stats_prometheus_format_counter(StatsCluster *sc, gint type, StatsCounterItem *counter)
 {
   if (_is_timestamp(sc, type))
     return NULL;
 
-  if (!sc->key.name)
-    return _format_legacy(sc, type, counter);
+  const gchar *name = _get_formatted_name(sc, type);
 
   GString *record = scratch_buffers_alloc();
-  g_string_append_printf(record, PROMETHEUS_METRIC_PREFIX "%s", stats_format_prometheus_sanitize_name(sc->key.name));
-
-  const gchar *labels = _format_labels(sc, type);
-  if (labels)
-    g_string_append_printf(record, "{%s}", labels);
-
   const gchar *metric_value = stats_format_prometheus_format_value(&sc->key, &sc->counter_group.counters[type]);
-  g_string_append_printf(record, " %s\n", metric_value);
+  g_string_append(record, name);
+  g_string_append_c(record, ' ');
+  g_string_append(record, metric_value);
+  g_string_append_c(record, '\n');
 
   return record;
 }
@@ -273,7 +302,8 @@ stats_generate_prometheus(StatsPrometheusRecordFunc process_record, gpointer use
                           gboolean *cancelled)
 {
   gpointer format_prometheus_args[] = {process_record, user_data, GINT_TO_POINTER(with_legacy)};
-  stats_lock();
-  stats_foreach_counter(stats_format_prometheus, format_prometheus_args, cancelled);
-  stats_unlock();
+
+  /* does not hold stats_lock() while walking the dynamic clusters, which
+   * make up the bulk of large registries */
+  stats_foreach_counter_sharded(stats_format_prometheus, format_prometheus_args, cancelled);
 }
@@ -26,10 +26,35 @@
 #include "cfg.h"
 #include <string.h>
 
+#define STATS_DYNAMIC_CLUSTER_SHARD_BITS 6
+#define STATS_DYNAMIC_CLUSTER_SHARDS (1 << STATS_DYNAMIC_CLUSTER_SHARD_BITS)
+
+/*
+ * Dynamic clusters (per-host, per-program, etc) are registered from the
+ * source threads for every message, see
+ * stats_register_and_increment_dynamic_counter().  They are sharded by the
+ * hash of their key, each shard protected by its own lock, so that these
+ * registrations do not serialize on stats_lock().
+ *
+ * Locking rules:
+ *   - static clusters are protected by stats_lock()
+ *   - a dynamic shard (its hash table and the use counts of its clusters)
+ *     is protected by the shard lock
+ *   - removing dynamic clusters requires both, so clusters returned while
+ *     holding stats_lock() remain valid until stats_unlock()
+ *   - stats_lock() is always acquired before a shard lock
+ */
+typedef struct _StatsClusterShard
+{
+  GMutex lock;
+  GHashTable *clusters;
+} StatsClusterShard;
+
 typedef struct _StatsClusterContainer
 {
   GHashTable *static_clusters;
-  GHashTable *dynamic_clusters;
+  StatsClusterShard dynamic_clusters[STATS_DYNAMIC_CLUSTER_SHARDS];
+  gint number_of_dynamic_clusters;
 } StatsClusterContainer;
 
 static StatsClusterContainer stats_cluster_container;
@@ -37,21 +62,46 @@ static StatsClusterContainer stats_cluster_container;
 static guint
 _number_of_dynamic_clusters(void)
 {
-  return g_hash_table_size(stats_cluster_container.dynamic_clusters);
+  return g_atomic_int_get(&stats_cluster_container.number_of_dynamic_clusters);
 }
 
 static GMutex stats_mutex;
 gboolean stats_locked;
 
-static void
-_insert_cluster(StatsCluster *sc)
+static StatsClusterShard *
+_get_dynamic_shard(const StatsClusterKey *sc_key)
 {
-  if (sc->dynamic)
-    g_hash_table_insert(stats_cluster_container.dynamic_clusters, &sc->key, sc);
-  else
-    g_hash_table_insert(stats_cluster_container.static_clusters, &sc->key, sc);
+  /* the hash tables use the low bits of the same hash, pick the shard by the high bits */
+  guint32 hash = stats_cluster_key_hash(sc_key) * 2654435769U;
+
+  return &stats_cluster_container.dynamic_clusters[hash >> (32 - STATS_DYNAMIC_CLUSTER_SHARD_BITS)];
+}
+
+static inline void
+_lock_dynamic_shard(StatsClusterShard *shard)
+{
+  g_mutex_lock(&shard->lock);
+}
+
+static inline void
+_unlock_dynamic_shard(StatsClusterShard *shard)
+{
+  g_mutex_unlock(&shard->lock);
+}
+
+static StatsCluster *
+_lookup_dynamic_cluster(const StatsClusterKey *sc_key)
+{
+  StatsClusterShard *shard = _get_dynamic_shard(sc_key);
+
+  _lock_dynamic_shard(shard);
+  StatsCluster *sc = g_hash_table_lookup(shard->clusters, sc_key);
+  _unlock_dynamic_shard(shard);
+
+  return sc;
 }
 
+
 void
 stats_lock(void)
 {
@@ -66,18 +116,20 @@ stats_unlock(void)
   g_mutex_unlock(&stats_mutex);
 }
 
+/* must be called with the shard lock held */
 static StatsCluster *
-_grab_dynamic_cluster(const StatsClusterKey *sc_key)
+_grab_dynamic_cluster(StatsClusterShard *shard, const StatsClusterKey *sc_key)
 {
   StatsCluster *sc;
 
-  sc = g_hash_table_lookup(stats_cluster_container.dynamic_clusters, sc_key);
+  sc = g_hash_table_lookup(shard->clusters, sc_key);
   if (!sc)
     {
       if (!stats_check_dynamic_clusters_limit(_number_of_dynamic_clusters()))
         return NULL;
       sc = stats_cluster_dynamic_new(sc_key);
-      _insert_cluster(sc);
+      g_hash_table_insert(shard->clusters, &sc->key, sc);
+      g_atomic_int_inc(&stats_cluster_container.number_of_dynamic_clusters);
       if ( !stats_check_dynamic_clusters_limit(_number_of_dynamic_clusters()))
         {
           msg_warning("Number of dynamic cluster limit has been reached.",
@@ -98,22 +150,24 @@ _grab_static_cluster(const StatsClusterKey *sc_key)
   if (!sc)
     {
       sc = stats_cluster_new(sc_key);
-      _insert_cluster(sc);
+      g_hash_table_insert(stats_cluster_container.static_clusters, &sc->key, sc);
     }
 
   return sc;
 }
 
+/* shard is the locked shard of sc_key for dynamic clusters, NULL otherwise */
 static StatsCluster *
-_grab_cluster(gint stats_level, const StatsClusterKey *sc_key, gboolean dynamic)
+_grab_cluster(gint stats_level, const StatsClusterKey *sc_key, StatsClusterShard *shard)
 {
   if (!stats_check_level(stats_level))
     return NULL;
 
   StatsCluster *sc = NULL;
+  gboolean dynamic = (shard != NULL);
 
   if (dynamic)
-    sc = _grab_dynamic_cluster(sc_key);
+    sc = _grab_dynamic_cluster(shard, sc_key);
   else
     sc = _grab_static_cluster(sc_key);
 
@@ -129,6 +183,33 @@ _grab_cluster(gint stats_level, const StatsClusterKey *sc_key, gboolean dynamic)
   return sc;
 }
 
+static StatsCounterItem *
+_track_counter(StatsCluster *sc, gint type)
+{
+  StatsCounterItem *ctr = stats_cluster_get_counter(sc, type);
+  StatsCounterItem *counter = stats_cluster_track_counter(sc, type);
+
+  if (ctr && ctr->external)
+    return counter;
+  counter->type = type;
+  counter->external = FALSE;
+  return counter;
+}
+
+static StatsCluster *
+_register_counter_unlocked(gint stats_level, const StatsClusterKey *sc_key, gint type,
+                           StatsClusterShard *shard, StatsCounterItem **counter)
+{
+  StatsCluster *sc;
+
+  sc = _grab_cluster(stats_level, sc_key, shard);
+  if (sc)
+    *counter = _track_counter(sc, type);
+  else
+    *counter = NULL;
+  return sc;
+}
+
 static StatsCluster *
 _register_counter(gint stats_level, const StatsClusterKey *sc_key, gint type,
                   gboolean dynamic, StatsCounterItem **counter)
@@ -137,20 +218,13 @@ _register_counter(gint stats_level, const StatsClusterKey *sc_key, gint type,
 
   g_assert(stats_locked);
 
-  sc = _grab_cluster(stats_level, sc_key, dynamic);
-  if (sc)
-    {
-      StatsCounterItem *ctr = stats_cluster_get_counter(sc, type);
-      *counter = stats_cluster_track_counter(sc, type);
-      if (ctr && ctr->external)
-        return sc;
-      (*counter)->type = type;
-      (*counter)->external = FALSE;
-    }
-  else
-    {
-      *counter = NULL;
-    }
+  if (!dynamic)
+    return _register_counter_unlocked(stats_level, sc_key, type, NULL, counter);
+
+  StatsClusterShard *shard = _get_dynamic_shard(sc_key);
+  _lock_dynamic_shard(shard);
+  sc = _register_counter_unlocked(stats_level, sc_key, type, shard, counter);
+  _unlock_dynamic_shard(shard);
   return sc;
 }
 
@@ -175,7 +249,11 @@ _register_external_counter(gint stats_level, const StatsClusterKey *sc_key, gint
 
   g_assert(stats_locked);
 
-  sc = _grab_cluster(stats_level, sc_key, dynamic);
+  StatsClusterShard *shard = dynamic ? _get_dynamic_shard(sc_key) : NULL;
+  if (shard)
+    _lock_dynamic_shard(shard);
+
+  sc = _grab_cluster(stats_level, sc_key, shard);
   if (sc)
     {
       _assert_when_internal_or_stores_different_ref(sc, type, external_counter);
@@ -185,6 +263,9 @@ _register_external_counter(gint stats_level, const StatsClusterKey *sc_key, gint
       ctr->type = type;
     }
 
+  if (shard)
+    _unlock_dynamic_shard(shard);
+
   return sc;
 }
 
@@ -223,6 +304,8 @@ stats_register_external_counter(gint stats_level, const StatsClusterKey *sc_key,
 StatsCluster *
 stats_register_alias_counter(gint level, const StatsClusterKey *sc_key, gint type, StatsCounterItem *aliased_counter)
 {
+  /* the alias would only see the part of the value that is not in the stripes */
+  g_assert(!aliased_counter->stripes);
   return stats_register_external_counter(level, sc_key, type, &aliased_counter->value);
 }
 
@@ -249,6 +332,9 @@ stats_register_dynamic_counter(gint stats_level, const StatsClusterKey *sc_key,
  * @timestamp: if non-negative, an associated timestamp will be created and set
  *
  * Instantly create (if not exists) and increment a dynamic counter.
+ *
+ * Only takes the lock of the shard the key belongs to, it can be called
+ * both with and without holding stats_lock().
  */
 void
 stats_register_and_increment_dynamic_counter(gint stats_level, const StatsClusterKey *sc_key,
@@ -256,19 +342,22 @@ stats_register_and_increment_dynamic_counter(gint stats_level, const StatsCluste
 {
   StatsCounterItem *counter, *stamp;
   StatsCluster *handle;
+  StatsClusterShard *shard = _get_dynamic_shard(sc_key);
 
-  g_assert(stats_locked);
-  handle = stats_register_dynamic_counter(stats_level, sc_key, SC_TYPE_PROCESSED, &counter);
+  _lock_dynamic_shard(shard);
+  handle = _register_counter_unlocked(stats_level, sc_key, SC_TYPE_PROCESSED, shard, &counter);
   if (!handle)
-    return;
+    goto exit;
   stats_counter_inc(counter);
   if (timestamp >= 0)
     {
-      stats_register_associated_counter(handle, SC_TYPE_STAMP, &stamp);
+      stamp = stats_cluster_track_counter(handle, SC_TYPE_STAMP);
       stats_counter_set(stamp, timestamp);
-      stats_unregister_dynamic_counter(handle, SC_TYPE_STAMP, &stamp);
+      stats_cluster_untrack_counter(handle, SC_TYPE_STAMP, &stamp);
     }
-  stats_unregister_dynamic_counter(handle, SC_TYPE_PROCESSED, &counter);
+  stats_cluster_untrack_counter(handle, SC_TYPE_PROCESSED, &counter);
+exit:
+  _unlock_dynamic_shard(shard);
 }
 
 /**
@@ -290,7 +379,10 @@ stats_register_associated_counter(StatsCluster *sc, gint type, StatsCounterItem
     return;
   g_assert(sc->dynamic);
 
+  StatsClusterShard *shard = _get_dynamic_shard(&sc->key);
+  _lock_dynamic_shard(shard);
   *counter = stats_cluster_track_counter(sc, type);
+  _unlock_dynamic_shard(shard);
 }
 
 void
@@ -339,7 +431,11 @@ stats_unregister_dynamic_counter(StatsCluster *sc, gint type, StatsCounterItem *
   g_assert(stats_locked);
   if (!sc)
     return;
+
+  StatsClusterShard *shard = _get_dynamic_shard(&sc->key);
+  _lock_dynamic_shard(shard);
   stats_cluster_untrack_counter(sc, type, counter);
+  _unlock_dynamic_shard(shard);
 }
 
 StatsCluster *
@@ -350,7 +446,7 @@ stats_get_cluster(const StatsClusterKey *sc_key)
   StatsCluster *sc = g_hash_table_lookup(stats_cluster_container.static_clusters, sc_key);
 
   if (!sc)
-    sc = g_hash_table_lookup(stats_cluster_container.dynamic_clusters, sc_key);
+    sc = _lookup_dynamic_cluster(sc_key);
 
   return sc;
 }
@@ -360,14 +456,23 @@ stats_remove_cluster(const StatsClusterKey *sc_key)
 {
   g_assert(stats_locked);
   StatsCluster *sc;
+  StatsClusterShard *shard = _get_dynamic_shard(sc_key);
 
-  sc = g_hash_table_lookup(stats_cluster_container.dynamic_clusters, sc_key);
+  _lock_dynamic_shard(shard);
+  sc = g_hash_table_lookup(shard->clusters, sc_key);
   if (sc)
     {
+      gboolean removed = FALSE;
+
       if (stats_cluster_is_orphaned(sc))
-        return g_hash_table_remove(stats_cluster_container.dynamic_clusters, sc_key);
-      return FALSE;
+        {
+          removed = g_hash_table_remove(shard->clusters, sc_key);
+          g_atomic_int_add(&stats_cluster_container.number_of_dynamic_clusters, -1);
+        }
+      _unlock_dynamic_shard(shard);
+      return removed;
     }
+  _unlock_dynamic_shard(shard);
 
   sc = g_hash_table_lookup(stats_cluster_container.static_clusters, sc_key);
   if (sc)
@@ -432,6 +537,22 @@ _foreach_cluster(GHashTable *clusters, gpointer *args, gboolean *cancelled)
     }
 }
 
+static void
+_foreach_dynamic_cluster(gpointer *args, gboolean *cancelled)
+{
+  for (gint i = 0; i < STATS_DYNAMIC_CLUSTER_SHARDS; i++)
+    {
+      StatsClusterShard *shard = &stats_cluster_container.dynamic_clusters[i];
+
+      if (cancelled && *cancelled)
+        break;
+
+      _lock_dynamic_shard(shard);
+      _foreach_cluster(shard->clusters, args, cancelled);
+      _unlock_dynamic_shard(shard);
+    }
+}
+
 void
 stats_foreach_cluster(StatsForeachClusterFunc func, gpointer user_data, gboolean *cancelled)
 {
@@ -439,7 +560,7 @@ stats_foreach_cluster(StatsForeachClusterFunc func, gpointer user_data, gboolean
 
   g_assert(stats_locked);
   _foreach_cluster(stats_cluster_container.static_clusters, args, cancelled);
-  _foreach_cluster(stats_cluster_container.dynamic_clusters, args, cancelled);
+  _foreach_dynamic_cluster(args, cancelled);
 }
 
 static gboolean
@@ -463,7 +584,16 @@ stats_foreach_cluster_remove(StatsForeachClusterRemoveFunc func, gpointer user_d
 {
   gpointer args[] = { func, user_data };
   g_hash_table_foreach_remove(stats_cluster_container.static_clusters, _foreach_cluster_remove_helper, args);
-  g_hash_table_foreach_remove(stats_cluster_container.dynamic_clusters, _foreach_cluster_remove_helper, args);
+
+  for (gint i = 0; i < STATS_DYNAMIC_CLUSTER_SHARDS; i++)
+    {
+      StatsClusterShard *shard = &stats_cluster_container.dynamic_clusters[i];
+
+      _lock_dynamic_shard(shard);
+      guint removed = g_hash_table_foreach_remove(shard->clusters, _foreach_cluster_remove_helper, args);
+      g_atomic_int_add(&stats_cluster_container.number_of_dynamic_clusters, -(gint) removed);
+      _unlock_dynamic_shard(shard);
+    }
 }
 
 static void
@@ -492,6 +622,28 @@ stats_foreach_counter(StatsForeachCounterFunc func, gpointer user_data, gboolean
   stats_foreach_cluster(_foreach_counter_helper, args, cancelled);
 }
 
+/*
+ * Same as stats_foreach_counter(), but it only holds stats_lock() while
+ * walking the static clusters.  Dynamic clusters are walked one shard at a
+ * time, holding only the lock of the shard, so neither registrations nor
+ * the hot path are blocked for the duration of the whole walk.
+ *
+ * Must be called without holding stats_lock(), func must not call back
+ * into the registry.
+ */
+void
+stats_foreach_counter_sharded(StatsForeachCounterFunc func, gpointer user_data, gboolean *cancelled)
+{
+  gpointer counter_args[] = { func, user_data };
+  gpointer args[] = { _foreach_counter_helper, counter_args };
+
+  stats_lock();
+  _foreach_cluster(stats_cluster_container.static_clusters, args, cancelled);
+  stats_unlock();
+
+  _foreach_dynamic_cluster(args, cancelled);
+}
+
 void
 stats_foreach_legacy_counter(StatsForeachCounterFunc func, gpointer user_data, gboolean *cancelled)
 {
@@ -507,9 +659,16 @@ stats_registry_init(void)
   stats_cluster_container.static_clusters = g_hash_table_new_full((GHashFunc) stats_cluster_key_hash,
                                             (GEqualFunc) stats_cluster_key_equal, NULL,
                                             (GDestroyNotify) stats_cluster_free);
-  stats_cluster_container.dynamic_clusters = g_hash_table_new_full((GHashFunc) stats_cluster_key_hash,
-                                             (GEqualFunc) stats_cluster_key_equal, NULL,
-                                             (GDestroyNotify) stats_cluster_free);
+  for (gint i = 0; i < STATS_DYNAMIC_CLUSTER_SHARDS; i++)
+    {
+      StatsClusterShard *shard = &stats_cluster_container.dynamic_clusters[i];
+
+      g_mutex_init(&shard->lock);
+      shard->clusters = g_hash_table_new_full((GHashFunc) stats_cluster_key_hash,
+                                              (GEqualFunc) stats_cluster_key_equal, NULL,
+                                              (GDestroyNotify) stats_cluster_free);
+    }
+  stats_cluster_container.number_of_dynamic_clusters = 0;
 
   g_mutex_init(&stats_mutex);
 }
@@ -518,8 +677,14 @@ void
 stats_registry_deinit(void)
 {
   g_hash_table_destroy(stats_cluster_container.static_clusters);
-  g_hash_table_destroy(stats_cluster_container.dynamic_clusters);
   stats_cluster_container.static_clusters = NULL;
-  stats_cluster_container.dynamic_clusters = NULL;
+  for (gint i = 0; i < STATS_DYNAMIC_CLUSTER_SHARDS; i++)
+    {
+      StatsClusterShard *shard = &stats_cluster_container.dynamic_clusters[i];
+
+      g_hash_table_destroy(shard->clusters);
+      shard->clusters = NULL;
+      g_mutex_clear(&shard->lock);
+    }
   g_mutex_clear(&stats_mutex);
 }
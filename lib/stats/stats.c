@@ -261,6 +261,23 @@ stats_options_defaults(StatsOptions *options)
   options->lifetime = 600;
   options->max_dynamic = -1;
   options->syslog_stats = CYNA_AUTO;
+  options->num_histogram_buckets = 0;
+  options->latency_trace_sampling = 0;
+  options->lazy_registration = FALSE;
+}
+
+gboolean
+stats_options_add_histogram_bucket(StatsOptions *options, gdouble bound)
+{
+  if (options->num_histogram_buckets == STATS_HISTOGRAM_MAX_BUCKETS)
+    return FALSE;
+
+  if (options->num_histogram_buckets > 0 &&
+      options->histogram_buckets[options->num_histogram_buckets - 1] >= bound)
+    return FALSE;
+
+  options->histogram_buckets[options->num_histogram_buckets++] = bound;
+  return TRUE;
 }
 
 gboolean
@@ -290,6 +307,41 @@ stats_number_of_dynamic_clusters_limit(void)
   return stats_options->max_dynamic;
 }
 
+/* the default follows the Prometheus client libraries, in seconds */
+static const gdouble default_histogram_buckets[] =
+{
+  0.001, 0.005, 0.01, 0.025, 0.05, 0.1, 0.25, 0.5, 1, 2.5, 5, 10
+};
+
+gint
+stats_get_histogram_buckets(const gdouble **bounds)
+{
+  if (stats_options && stats_options->num_histogram_buckets > 0)
+    {
+      *bounds = stats_options->histogram_buckets;
+      return stats_options->num_histogram_buckets;
+    }
+
+  *bounds = default_histogram_buckets;
+  return G_N_ELEMENTS(default_histogram_buckets);
+}
+
+gint
+stats_get_latency_trace_sampling(void)
+{
+  if (stats_options)
+    return stats_options->latency_trace_sampling;
+  return 0;
+}
+
+gboolean
+stats_is_lazy_registration_enabled(void)
+{
+  if (stats_options)
+    return stats_options->lazy_registration;
+  return FALSE;
+}
+
 CfgYesNoAuto
 stats_syslog_stats(void)
 {
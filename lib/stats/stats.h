@@ -29,6 +29,8 @@
 #include "stats/stats-cluster.h"
 #include "cfg-parser.h"
 
+#define STATS_HISTOGRAM_MAX_BUCKETS 16
+
 typedef struct _StatsOptions
 {
   gint log_freq;
@@ -36,6 +38,13 @@ typedef struct _StatsOptions
   gint lifetime;
   gint max_dynamic;
   CfgYesNoAuto syslog_stats;
+  /* upper bounds in seconds, increasing */
+  gdouble histogram_buckets[STATS_HISTOGRAM_MAX_BUCKETS];
+  gint num_histogram_buckets;
+  /* trace the latency of every Nth message of a source, 0 disables it */
+  gint latency_trace_sampling;
+  /* register the counters of a source when its first message arrives */
+  gboolean lazy_registration;
 } StatsOptions;
 
 enum
@@ -51,6 +60,10 @@ void stats_init(void);
 void stats_destroy(void);
 
 void stats_options_defaults(StatsOptions *options);
+gboolean stats_options_add_histogram_bucket(StatsOptions *options, gdouble bound);
+gint stats_get_histogram_buckets(const gdouble **bounds);
+gint stats_get_latency_trace_sampling(void);
+gboolean stats_is_lazy_registration_enabled(void);
 
 #endif
 
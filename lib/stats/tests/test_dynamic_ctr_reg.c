@@ -83,3 +83,89 @@ Test(stats_dynamic_clusters, register_limited)
   stats_unlock();
 }
 
+
+#define INCREMENT_THREADS 8
+#define INCREMENTS_PER_THREAD 1000
+#define INCREMENT_HOSTS 32
+
+static gpointer
+_increment_dynamic_counters(gpointer user_data)
+{
+  for (gint i = 0; i < INCREMENTS_PER_THREAD; i++)
+    {
+      gchar host[32];
+      StatsClusterKey sc_key;
+
+      g_snprintf(host, sizeof(host), "testhost%d", i % INCREMENT_HOSTS);
+      stats_cluster_logpipe_key_legacy_set(&sc_key, SCS_HOST | SCS_SOURCE, NULL, host);
+      stats_register_and_increment_dynamic_counter(1, &sc_key, 1234);
+    }
+  return NULL;
+}
+
+Test(stats_dynamic_clusters, increment_without_stats_lock)
+{
+  StatsOptions stats_opts;
+  stats_options_defaults(&stats_opts);
+  stats_opts.level = 3;
+  stats_reinit(&stats_opts);
+
+  GThread *threads[INCREMENT_THREADS];
+  for (gint i = 0; i < INCREMENT_THREADS; i++)
+    threads[i] = g_thread_new(NULL, _increment_dynamic_counters, NULL);
+  for (gint i = 0; i < INCREMENT_THREADS; i++)
+    g_thread_join(threads[i]);
+
+  stats_lock();
+  for (gint i = 0; i < INCREMENT_HOSTS; i++)
+    {
+      gchar host[32];
+      StatsClusterKey sc_key;
+
+      g_snprintf(host, sizeof(host), "testhost%d", i);
+      stats_cluster_logpipe_key_legacy_set(&sc_key, SCS_HOST | SCS_SOURCE, NULL, host);
+
+      StatsCounterItem *processed = stats_get_counter(&sc_key, SC_TYPE_PROCESSED);
+      cr_assert_not_null(processed);
+      cr_assert_eq(stats_counter_get(processed), INCREMENT_THREADS * INCREMENTS_PER_THREAD / INCREMENT_HOSTS);
+      cr_assert_eq(stats_counter_get(stats_get_counter(&sc_key, SC_TYPE_STAMP)), 1234);
+
+      StatsCluster *sc = stats_get_cluster(&sc_key);
+      cr_assert(stats_cluster_is_orphaned(sc));
+    }
+  stats_unlock();
+}
+
+static gboolean
+_remove_all(StatsCluster *sc, gpointer user_data)
+{
+  return TRUE;
+}
+
+Test(stats_dynamic_clusters, removed_clusters_do_not_count_towards_limit)
+{
+  StatsOptions stats_opts;
+  stats_options_defaults(&stats_opts);
+  stats_opts.level = 3;
+  stats_opts.max_dynamic = 2;
+  stats_reinit(&stats_opts);
+
+  StatsClusterKey sc_key;
+  stats_cluster_logpipe_key_legacy_set(&sc_key, SCS_HOST | SCS_SOURCE, NULL, "testhost1");
+  stats_register_and_increment_dynamic_counter(1, &sc_key, -1);
+  stats_cluster_logpipe_key_legacy_set(&sc_key, SCS_HOST | SCS_SOURCE, NULL, "testhost2");
+  stats_register_and_increment_dynamic_counter(1, &sc_key, -1);
+  stats_cluster_logpipe_key_legacy_set(&sc_key, SCS_HOST | SCS_SOURCE, NULL, "testhost3");
+  stats_register_and_increment_dynamic_counter(1, &sc_key, -1);
+
+  stats_lock();
+  cr_assert_not(stats_contains_counter(&sc_key, SC_TYPE_PROCESSED));
+  stats_foreach_cluster_remove(_remove_all, NULL);
+  stats_unlock();
+
+  stats_register_and_increment_dynamic_counter(1, &sc_key, -1);
+
+  stats_lock();
+  cr_assert(stats_contains_counter(&sc_key, SC_TYPE_PROCESSED));
+  stats_unlock();
+}
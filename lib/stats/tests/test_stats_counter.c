@@ -0,0 +1,103 @@
+/*
+ * Copyright (c) 2024 One Identity LLC.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#include <criterion/criterion.h>
+
+#include "apphook.h"
+#include "mainloop-worker.h"
+#include "stats/stats-counter.h"
+
+#define WORKER_THREADS 8
+#define INCREMENTS_PER_THREAD 10000
+
+static gpointer
+_increment_counter(gpointer user_data)
+{
+  StatsCounterItem *counter = (StatsCounterItem *) user_data;
+
+  main_loop_worker_thread_start(MLW_THREADED_OUTPUT_WORKER);
+  for (gint i = 0; i < INCREMENTS_PER_THREAD; i++)
+    {
+      stats_counter_inc(counter);
+      stats_counter_add(counter, 2);
+      stats_counter_sub(counter, 1);
+    }
+  main_loop_worker_thread_stop();
+  return NULL;
+}
+
+Test(stats_counter, striped_counter_sums_the_updates_of_all_threads)
+{
+  StatsCounterItem counter = {0};
+
+  stats_counter_set(&counter, 100);
+  stats_counter_enable_striping(&counter);
+  cr_assert_not_null(counter.stripes);
+  cr_assert_eq(stats_counter_get(&counter), 100);
+
+  /* the main thread has no thread index, it updates the value itself */
+  stats_counter_inc(&counter);
+  cr_assert_eq(stats_counter_get(&counter), 101);
+
+  GThread *threads[WORKER_THREADS];
+  for (gint i = 0; i < WORKER_THREADS; i++)
+    threads[i] = g_thread_new(NULL, _increment_counter, &counter);
+  for (gint i = 0; i < WORKER_THREADS; i++)
+    g_thread_join(threads[i]);
+
+  cr_assert_eq(stats_counter_get(&counter), 101 + WORKER_THREADS * INCREMENTS_PER_THREAD * 2);
+
+  stats_counter_set(&counter, 5);
+  cr_assert_eq(stats_counter_get(&counter), 5);
+
+  stats_counter_free(&counter);
+}
+
+Test(stats_counter, enabling_striping_twice_keeps_the_stripes)
+{
+  StatsCounterItem counter = {0};
+
+  stats_counter_enable_striping(&counter);
+  atomic_gssize *stripes = counter.stripes;
+  stats_counter_enable_striping(&counter);
+  cr_assert_eq(counter.stripes, stripes);
+
+  stats_counter_enable_striping(NULL);
+  stats_counter_free(&counter);
+}
+
+static void
+setup(void)
+{
+  app_startup();
+  main_loop_worker_allocate_thread_space(WORKER_THREADS);
+  main_loop_worker_finalize_thread_space();
+}
+
+static void
+teardown(void)
+{
+  app_shutdown();
+}
+
+TestSuite(stats_counter, .init = setup, .fini = teardown);
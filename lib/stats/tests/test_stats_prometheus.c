@@ -29,6 +29,7 @@
 #include "stats/stats-cluster-single.h"
 #include "stats/stats-cluster-logpipe.h"
 #include "stats/stats-prometheus.h"
+#include "stats/stats-histogram.h"
 #include "timeutils/unixtime.h"
 #include "scratch-buffers.h"
 #include "mainloop.h"
@@ -36,6 +37,7 @@
 
 #include <float.h>
 #include <limits.h>
+#include <string.h>
 
 static void
 setup(void)
@@ -130,6 +132,20 @@ Test(stats_prometheus, test_prometheus_format_logpipe)
   stats_cluster_free(cluster);
 }
 
+Test(stats_prometheus, test_prometheus_format_cached_name_renders_current_value)
+{
+  StatsClusterLabel labels[] = { stats_cluster_label("app", "cisco") };
+  StatsCluster *cluster = test_logpipe_cluster("test_name", labels, G_N_ELEMENTS(labels));
+  StatsCounterItem *counter = stats_cluster_track_counter(cluster, SC_TYPE_PROCESSED);
+
+  assert_prometheus_format(cluster, SC_TYPE_PROCESSED, "syslogng_test_name{app=\"cisco\",result=\"processed\"} 0\n");
+  stats_counter_add(counter, 42);
+  assert_prometheus_format(cluster, SC_TYPE_PROCESSED, "syslogng_test_name{app=\"cisco\",result=\"processed\"} 42\n");
+  assert_prometheus_format(cluster, SC_TYPE_DROPPED, "syslogng_test_name{app=\"cisco\",result=\"dropped\"} 0\n");
+
+  stats_cluster_free(cluster);
+}
+
 Test(stats_prometheus, test_prometheus_format_empty_label_value)
 {
   StatsClusterLabel labels[] =
@@ -285,3 +301,42 @@ Test(stats_prometheus, test_prometheus_format_legacy_alias_is_ignored)
   assert_prometheus_format(cluster, SC_TYPE_SINGLE_VALUE, "syslogng_name 0\n");
   stats_cluster_free(cluster);
 }
+
+static void
+_append_record(const gchar *record, gpointer user_data)
+{
+  g_string_append((GString *) user_data, record);
+}
+
+Test(stats_prometheus, test_prometheus_format_histogram)
+{
+  StatsHistogram histogram;
+  StatsClusterKeyBuilder *kb = stats_cluster_key_builder_new();
+  stats_cluster_key_builder_add_label(kb, stats_cluster_label("id", "d_test"));
+  stats_histogram_init(&histogram, kb, "test_duration_seconds", STATS_LEVEL0);
+  stats_cluster_key_builder_free(kb);
+
+  stats_histogram_observe(&histogram, 3000);
+  stats_histogram_observe(&histogram, 20000);
+  stats_histogram_observe(&histogram, 20 * G_USEC_PER_SEC);
+
+  GString *output = g_string_new("");
+  stats_generate_prometheus(_append_record, output, FALSE, NULL);
+
+  const gchar *expected_records[] =
+  {
+    "syslogng_test_duration_seconds_bucket{id=\"d_test\",le=\"0.001\"} 0\n",
+    "syslogng_test_duration_seconds_bucket{id=\"d_test\",le=\"0.005\"} 1\n",
+    "syslogng_test_duration_seconds_bucket{id=\"d_test\",le=\"0.025\"} 2\n",
+    "syslogng_test_duration_seconds_bucket{id=\"d_test\",le=\"10\"} 2\n",
+    "syslogng_test_duration_seconds_bucket{id=\"d_test\",le=\"+Inf\"} 3\n",
+    "syslogng_test_duration_seconds_sum{id=\"d_test\"} 20.023\n",
+    "syslogng_test_duration_seconds_count{id=\"d_test\"} 3\n",
+  };
+  for (gsize i = 0; i < G_N_ELEMENTS(expected_records); i++)
+    cr_assert(strstr(output->str, expected_records[i]), "missing record: %s, output: %s",
+              expected_records[i], output->str);
+
+  g_string_free(output, TRUE);
+  stats_histogram_deinit(&histogram);
+}
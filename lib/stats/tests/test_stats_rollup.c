@@ -0,0 +1,118 @@
+/*
+ * Copyright (c) 2024 One Identity LLC.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+
+#include <criterion/criterion.h>
+
+#include "stats/aggregator/stats-rollup.h"
+
+static gint freed_user_data;
+
+static void
+_free_user_data(gpointer user_data)
+{
+  freed_user_data++;
+  g_free(user_data);
+}
+
+static void
+_collect_keys(StatsRollupEntry *entry, gpointer user_data)
+{
+  GString *keys = (GString *) user_data;
+
+  g_string_append_printf(keys, "%s;", entry->key);
+}
+
+Test(stats_rollup, test_data_points_are_summarized_per_key)
+{
+  StatsRollup *rollup = stats_rollup_new(NULL);
+
+  stats_rollup_add_data_point(rollup, "foo", 3);
+  stats_rollup_add_data_point(rollup, "bar", 10);
+  stats_rollup_add_data_point(rollup, "foo", 1);
+  StatsRollupEntry *foo = stats_rollup_add_data_point(rollup, "foo", 5);
+
+  cr_assert_eq(stats_rollup_get_size(rollup), 2);
+  cr_assert_eq(foo->count, 3);
+  cr_assert_float_eq(foo->min, 1, 0.0001);
+  cr_assert_float_eq(foo->max, 5, 0.0001);
+  cr_assert_float_eq(stats_rollup_entry_get_value(foo, STATS_ROLLUP_COUNTER), 9, 0.0001);
+  cr_assert_float_eq(stats_rollup_entry_get_value(foo, STATS_ROLLUP_GAUGE), 5, 0.0001);
+  cr_assert_float_eq(stats_rollup_entry_get_value(foo, STATS_ROLLUP_TIMING), 3, 0.0001);
+
+  StatsRollupEntry *bar = stats_rollup_lookup(rollup, "bar");
+  cr_assert_eq(bar->count, 1);
+  cr_assert_float_eq(bar->min, 10, 0.0001);
+  cr_assert_float_eq(bar->max, 10, 0.0001);
+
+  stats_rollup_free(rollup);
+}
+
+Test(stats_rollup, test_entries_are_iterated_in_order_of_first_data_point)
+{
+  StatsRollup *rollup = stats_rollup_new(NULL);
+  GString *keys = g_string_new("");
+
+  stats_rollup_add_data_point(rollup, "c", 1);
+  stats_rollup_add_data_point(rollup, "a", 1);
+  stats_rollup_add_data_point(rollup, "c", 1);
+  stats_rollup_add_data_point(rollup, "b", 1);
+
+  stats_rollup_foreach(rollup, _collect_keys, keys);
+  cr_assert_str_eq(keys->str, "c;a;b;");
+
+  g_string_free(keys, TRUE);
+  stats_rollup_free(rollup);
+}
+
+Test(stats_rollup, test_reset_frees_entries_and_user_data)
+{
+  StatsRollup *rollup = stats_rollup_new(_free_user_data);
+
+  freed_user_data = 0;
+  stats_rollup_add_data_point(rollup, "foo", 1)->user_data = g_strdup("foo");
+  stats_rollup_add_data_point(rollup, "bar", 1);
+
+  stats_rollup_reset(rollup);
+  cr_assert_eq(stats_rollup_get_size(rollup), 0);
+  cr_assert_null(stats_rollup_lookup(rollup, "foo"));
+  cr_assert_eq(freed_user_data, 1);
+
+  stats_rollup_add_data_point(rollup, "foo", 2);
+  cr_assert_eq(stats_rollup_lookup(rollup, "foo")->count, 1);
+
+  stats_rollup_free(rollup);
+}
+
+Test(stats_rollup, test_type_names)
+{
+  StatsRollupType type;
+
+  cr_assert(stats_rollup_type_parse("counter", &type));
+  cr_assert_eq(type, STATS_ROLLUP_COUNTER);
+  cr_assert(stats_rollup_type_parse("gauge", &type));
+  cr_assert_eq(type, STATS_ROLLUP_GAUGE);
+  cr_assert(stats_rollup_type_parse("timing", &type));
+  cr_assert_eq(type, STATS_ROLLUP_TIMING);
+  cr_assert_not(stats_rollup_type_parse("histogram", &type));
+}
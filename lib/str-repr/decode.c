@@ -22,6 +22,7 @@
  *
  */
 #include "str-repr/decode.h"
+#include "find-crlf.h"
 
 #include <string.h>
 
@@ -139,6 +140,31 @@ _process_initial_character(StrReprDecodeState *state)
     }
 }
 
+/*
+ * Appends the run of characters starting at the current position that
+ * can't be any of @chars, leaving state->cur at the last character of the
+ * run, as the decoder loop steps over it. Without a known end of input,
+ * only the current character is appended.
+ */
+static void
+_append_run_of_plain_characters(StrReprDecodeState *state, const gchar *chars, gsize chars_len)
+{
+  const gchar *input_end = state->options->input_end;
+  const gchar *run_end = NULL;
+
+  if (input_end && state->cur + 1 < input_end)
+    {
+      run_end = find_first_of(state->cur + 1, input_end - (state->cur + 1), chars, chars_len);
+      if (!run_end)
+        run_end = input_end;
+    }
+  else
+    run_end = state->cur + 1;
+
+  g_string_append_len(state->value, state->cur, run_end - state->cur);
+  state->cur = run_end - 1;
+}
+
 static gint
 _process_quoted_string_characters(StrReprDecodeState *state)
 {
@@ -147,7 +173,9 @@ _process_quoted_string_characters(StrReprDecodeState *state)
   else if (*state->cur == '\\')
     return KV_QUOTE_BACKSLASH;
 
-  g_string_append_c(state->value, *state->cur);
+  const gchar specials[] = { state->quote_char, '\\' };
+
+  _append_run_of_plain_characters(state, specials, sizeof(specials));
   return KV_QUOTE_STRING;
 }
 
@@ -177,9 +205,16 @@ _process_junk_after_closing_quote(StrReprDecodeState *state)
 static gint
 _process_unquoted_characters(StrReprDecodeState *state)
 {
+  const StrReprDecodeOptions *options = state->options;
+
   if (_match_and_skip_delimiter(state))
     return KV_FINISH_SUCCESS;
-  g_string_append_c(state->value, *state->cur);
+
+  /* match_delimiter() is consulted for every character without delimiter_chars */
+  if (options->delimiter_chars[0])
+    _append_run_of_plain_characters(state, options->delimiter_chars, sizeof(options->delimiter_chars));
+  else
+    g_string_append_c(state->value, *state->cur);
   return KV_UNQUOTED_CHARACTERS;
 }
 
@@ -33,6 +33,8 @@ typedef struct _StrReprDecodeOptions
   MatchDelimiterFunc match_delimiter;
   gpointer match_delimiter_data;
   gchar delimiter_chars[3];
+  /* the terminating NUL of the input if known, enables skipping plain characters in bulk */
+  const gchar *input_end;
 } StrReprDecodeOptions;
 
 gboolean str_repr_decode(GString *value, const gchar *input, const gchar **end);
@@ -23,12 +23,84 @@
  */
 #include "str-repr/encode.h"
 #include "utf8utils.h"
+#include "str-utils.h"
 #include <string.h>
 
+typedef struct _EncodeScanResult
+{
+  gboolean apostrophe;
+  gboolean quote;
+  gboolean quoting_needed;
+} EncodeScanResult;
+
+static inline void
+_scan_byte(EncodeScanResult *result, guint8 c, const gchar *forbidden_chars)
+{
+  switch (c)
+    {
+    case '\'':
+      result->apostrophe = TRUE;
+      break;
+    case '"':
+      result->quote = TRUE;
+      break;
+    case 0:
+    case '\b':
+    case '\f':
+    case '\n':
+    case '\r':
+    case '\t':
+    case '\\':
+    case ' ':
+      result->quoting_needed = TRUE;
+      break;
+    default:
+      if (forbidden_chars && strchr(forbidden_chars, c))
+        result->quoting_needed = TRUE;
+      break;
+    }
+}
+
+/* Find out in a single, length bounded pass which quoting style the string
+ * needs.  Most strings contain none of the characters we are looking for,
+ * so they are checked eight bytes at a time and only words that may
+ * contain one of them are looked at byte-by-byte.  */
+static void
+_scan_string(EncodeScanResult *result, const gchar *str, gsize str_len, const gchar *forbidden_chars)
+{
+  gboolean use_swar = !forbidden_chars || !forbidden_chars[0] || !forbidden_chars[1];
+  guint8 forbidden_char = (forbidden_chars && forbidden_chars[0]) ? forbidden_chars[0] : ' ';
+  gsize i = 0;
+
+  while (i < str_len && !(result->apostrophe && result->quote))
+    {
+      gsize end = MIN(i + sizeof(guint64), str_len);
+
+      if (use_swar && end - i == sizeof(guint64))
+        {
+          guint64 word = swar_load(str + i);
+
+          /* control characters and space are all below 0x21 */
+          if (!swar_has_byte_less_than(word, ' ' + 1) &&
+              !swar_has_byte_equal_to(word, '\\') &&
+              !swar_has_byte_equal_to(word, '\'') &&
+              !swar_has_byte_equal_to(word, '"') &&
+              !swar_has_byte_equal_to(word, forbidden_char))
+            {
+              i = end;
+              continue;
+            }
+        }
+
+      for (; i < end; i++)
+        _scan_byte(result, str[i], forbidden_chars);
+    }
+}
+
 void
 str_repr_encode_append(GString *escaped_string, const gchar *str, gssize str_len, const gchar *forbidden_chars)
 {
-  const gchar *apostrophe, *quote;
+  EncodeScanResult scan = { 0 };
 
   if (str_len < 0)
     str_len = strlen(str);
@@ -39,35 +111,21 @@ str_repr_encode_append(GString *escaped_string, const gchar *str, gssize str_len
       return;
     }
 
-  apostrophe = memchr(str, '\'', str_len);
-  quote = memchr(str, '"', str_len);
+  _scan_string(&scan, str, str_len, forbidden_chars);
 
-  if (!apostrophe && !quote)
+  if (!scan.apostrophe && !scan.quote && !scan.quoting_needed)
     {
-      gboolean quoting_needed = FALSE;
-
-      /* NOTE: for non-NUL terminated strings, this would go over the end of
-       * the string until the first NUL character.  It is not ideal at all,
-       * but there's no strncspn() */
-
-      if ((strcspn(str, "\b\f\n\r\t\\ ")) < str_len ||
-          (forbidden_chars && strcspn(str, forbidden_chars) < str_len))
-        quoting_needed = TRUE;
-
-      if (!quoting_needed)
-        {
-          g_string_append_len(escaped_string, str, str_len);
-          return;
-        }
+      g_string_append_len(escaped_string, str, str_len);
+      return;
     }
 
-  if (!apostrophe && quote)
+  if (!scan.apostrophe && scan.quote)
     {
       g_string_append_c(escaped_string, '\'');
       append_unsafe_utf8_as_escaped_binary(escaped_string, str, str_len, NULL);
       g_string_append_c(escaped_string, '\'');
     }
-  else if (!quote && apostrophe)
+  else if (!scan.quote && scan.apostrophe)
     {
       g_string_append_c(escaped_string, '"');
       append_unsafe_utf8_as_escaped_binary(escaped_string, str, str_len, NULL);
@@ -90,7 +90,15 @@ ParameterizedTestParameters(encode, test_strings)
     {"\"value1", "'\"value1'"},
     {"'value1", "\"'value1\""},
     /* control sequences */
-    {"\b \f \n \r \t \\", "\"\\b \\f \\n \\r \\t \\\\\""}
+    {"\b \f \n \r \t \\", "\"\\b \\f \\n \\r \\t \\\\\""},
+    /* longer strings, where special characters are not in the first word */
+    {"0123456789abcdefghijklmnopqrstuvwxyz", "0123456789abcdefghijklmnopqrstuvwxyz"},
+    {"0123456789abcdefghijklm opqrstuvwxyz", "\"0123456789abcdefghijklm opqrstuvwxyz\""},
+    {"0123456789abcdefghijklmnopqrstuvwxy\t", "\"0123456789abcdefghijklmnopqrstuvwxy\\t\""},
+    {"0123456789abcdefghijklmnopqrstuvwx\"y", "'0123456789abcdefghijklmnopqrstuvwx\"y'"},
+    {"01234567'89abcdefghijklmnopqrstuvwx\"y", "\"01234567'89abcdefghijklmnopqrstuvwx\\\"y\""},
+    {"\xc3\xa1rv\xc3\xadzt\xc5\xb1r\xc5\x91 t\xc3\xbck\xc3\xb6rf\xc3\xbar\xc3\xb3g\xc3\xa9p",
+     "\"\xc3\xa1rv\xc3\xadzt\xc5\xb1r\xc5\x91 t\xc3\xbck\xc3\xb6rf\xc3\xbar\xc3\xb3g\xc3\xa9p\""},
   };
 
   return cr_make_param_array(EncodeTestStr, test_cases, sizeof(test_cases) / sizeof(test_cases[0]));
@@ -106,7 +114,10 @@ ParameterizedTestParameters(encode, test_encode_strings_that_need_quotation)
   static EncodeTestForbidden test_cases[] =
   {
     {"foo,", ",", "\"foo,\""},
-    {"\"'foo,", ",", "\"\\\"'foo,\""}
+    {"\"'foo,", ",", "\"\\\"'foo,\""},
+    {"0123456789abcdefghijklmnopqrstuvwxyz,", ",", "\"0123456789abcdefghijklmnopqrstuvwxyz,\""},
+    {"0123456789abcdefghijklmnopqrstuvwxyz=", ",=", "\"0123456789abcdefghijklmnopqrstuvwxyz=\""},
+    {"0123456789abcdefghijklmnopqrstuvwxyz", ",=", "0123456789abcdefghijklmnopqrstuvwxyz"},
   };
 
   return cr_make_param_array(EncodeTestForbidden, test_cases, sizeof(test_cases) / sizeof(test_cases[0]));
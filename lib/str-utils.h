@@ -115,6 +115,47 @@ _strchr_optimized_for_single_char_haystack(const char *str, int c)
   return strchr(str + 1, c);
 }
 
+/*
+ * Helpers to check eight bytes of a string at a time, with the usual
+ * SIMD-within-a-register tricks, which work on any architecture:
+ *   - a byte is >= 0x80 if its top bit is set
+ *   - a byte is < n if subtracting n borrows into its top bit
+ *   - a byte is equal to c if XOR-ing it with c yields a zero byte
+ *
+ * The results are only meaningful as booleans (non-zero if any of
+ * the bytes match), and _less_than() only works for n <= 128.
+ */
+
+#define SWAR_ONES     G_GUINT64_CONSTANT(0x0101010101010101)
+#define SWAR_HIGHS    G_GUINT64_CONSTANT(0x8080808080808080)
+
+static inline guint64
+swar_load(const gchar *p)
+{
+  guint64 word;
+
+  memcpy(&word, p, sizeof(word));
+  return word;
+}
+
+static inline guint64
+swar_has_non_ascii(guint64 word)
+{
+  return word & SWAR_HIGHS;
+}
+
+static inline guint64
+swar_has_byte_less_than(guint64 word, guint8 n)
+{
+  return (word - SWAR_ONES * n) & ~word & SWAR_HIGHS;
+}
+
+static inline guint64
+swar_has_byte_equal_to(guint64 word, guint8 c)
+{
+  return swar_has_byte_less_than(word ^ (SWAR_ONES * c), 1);
+}
+
 /*
  * strsplit() splits the `str` into `maxtokens` pieces.
  * This version skips multiple `delims`.
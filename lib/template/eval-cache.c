@@ -0,0 +1,215 @@
+/*
+ * Copyright (c) 2024 One Identity LLC.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#include "template/eval-cache.h"
+#include "template/templates.h"
+#include "logmsg/logmsg-cache.h"
+#include "stats/stats-registry.h"
+#include "stats/stats-cluster-single.h"
+#include "apphook.h"
+
+#include <string.h>
+
+/*
+ * Per-message cache of template results
+ *
+ * Templates with template-cache(yes) store their results in the
+ * template_cache of the LogMessage, so that the same template, evaluated
+ * by multiple destinations for the same message, is only expanded once.
+ * Only write protected messages are cached, see logmsg/logmsg-cache.c.
+ */
+
+typedef struct _LogTemplateEvalCacheKey
+{
+  LogTemplate *template;
+  gint tz;
+  gint seq_num;
+  gchar *context_id;
+  LogMessageValueType context_id_type;
+  LogTemplateEscapeFunction escape;
+
+  /* the parts of LogTemplateOptions that influence the result, copied as
+   * the options may be freed while the message is still around */
+  gint ts_format;
+  gint frac_digits;
+  gboolean use_fqdn;
+  gboolean escape_option;
+  gint on_error;
+  gchar *time_zone[LTZ_MAX];
+} LogTemplateEvalCacheKey;
+
+static StatsCounterItem *stats_template_cache_hits;
+static StatsCounterItem *stats_template_cache_misses;
+
+static void
+_key_init(LogTemplateEvalCacheKey *key, LogTemplate *template, LogTemplateEvalOptions *options)
+{
+  const LogTemplateOptions *opts = options->opts;
+
+  key->template = template;
+  key->tz = options->tz;
+  key->seq_num = options->seq_num;
+  key->context_id = (gchar *) options->context_id;
+  key->context_id_type = options->context_id_type;
+  key->escape = options->escape;
+  key->ts_format = opts->ts_format;
+  key->frac_digits = opts->frac_digits;
+  key->use_fqdn = opts->use_fqdn;
+  key->escape_option = opts->escape;
+  key->on_error = opts->on_error;
+  for (gint i = 0; i < LTZ_MAX; i++)
+    key->time_zone[i] = opts->time_zone[i];
+}
+
+static gpointer
+_key_dup(gconstpointer k)
+{
+  const LogTemplateEvalCacheKey *source = (const LogTemplateEvalCacheKey *) k;
+  LogTemplateEvalCacheKey *dest = g_new(LogTemplateEvalCacheKey, 1);
+
+  *dest = *source;
+  dest->template = log_template_ref(source->template);
+  dest->context_id = g_strdup(source->context_id);
+  for (gint i = 0; i < LTZ_MAX; i++)
+    dest->time_zone[i] = g_strdup(source->time_zone[i]);
+  return dest;
+}
+
+static void
+_key_free(gpointer k)
+{
+  LogTemplateEvalCacheKey *key = (LogTemplateEvalCacheKey *) k;
+
+  log_template_unref(key->template);
+  g_free(key->context_id);
+  for (gint i = 0; i < LTZ_MAX; i++)
+    g_free(key->time_zone[i]);
+  g_free(key);
+}
+
+static gboolean
+_key_equal(gconstpointer k1, gconstpointer k2)
+{
+  const LogTemplateEvalCacheKey *a = (const LogTemplateEvalCacheKey *) k1;
+  const LogTemplateEvalCacheKey *b = (const LogTemplateEvalCacheKey *) k2;
+
+  if (a->template != b->template ||
+      a->tz != b->tz ||
+      a->seq_num != b->seq_num ||
+      a->context_id_type != b->context_id_type ||
+      a->escape != b->escape ||
+      a->ts_format != b->ts_format ||
+      a->frac_digits != b->frac_digits ||
+      a->use_fqdn != b->use_fqdn ||
+      a->escape_option != b->escape_option ||
+      a->on_error != b->on_error)
+    return FALSE;
+
+  if (g_strcmp0(a->context_id, b->context_id) != 0)
+    return FALSE;
+
+  for (gint i = 0; i < LTZ_MAX; i++)
+    {
+      if (g_strcmp0(a->time_zone[i], b->time_zone[i]) != 0)
+        return FALSE;
+    }
+  return TRUE;
+}
+
+static const LogMessageCacheKeyClass log_template_eval_cache_key_class =
+{
+  .equal = _key_equal,
+  .dup = _key_dup,
+  .free = _key_free,
+};
+
+gboolean
+log_template_eval_cache_lookup(LogMessage *msg, LogTemplate *template, LogTemplateEvalOptions *options,
+                               GString *result, LogMessageValueType *type)
+{
+  LogTemplateEvalCacheKey key;
+
+  _key_init(&key, template, options);
+  if (log_msg_cache_lookup(&msg->template_cache, &key, result, type))
+    {
+      stats_counter_inc(stats_template_cache_hits);
+      return TRUE;
+    }
+
+  stats_counter_inc(stats_template_cache_misses);
+  return FALSE;
+}
+
+void
+log_template_eval_cache_store(LogMessage *msg, LogTemplate *template, LogTemplateEvalOptions *options,
+                              const gchar *value, gsize value_len, LogMessageValueType type)
+{
+  g_assert(log_msg_is_write_protected(msg));
+
+  LogTemplateEvalCacheKey key;
+
+  _key_init(&key, template, options);
+  log_msg_cache_store(&msg->template_cache, &log_template_eval_cache_key_class, &key, value, value_len, type);
+}
+
+static void
+_register_stats(void)
+{
+  StatsClusterKey sc_key;
+
+  stats_lock();
+  stats_cluster_single_key_set(&sc_key, "template_cache_hits_total", NULL, 0);
+  stats_cluster_single_key_add_legacy_alias_with_name(&sc_key, SCS_GLOBAL, "template_cache", NULL, "hits");
+  stats_register_counter(0, &sc_key, SC_TYPE_SINGLE_VALUE, &stats_template_cache_hits);
+  stats_cluster_single_key_set(&sc_key, "template_cache_misses_total", NULL, 0);
+  stats_cluster_single_key_add_legacy_alias_with_name(&sc_key, SCS_GLOBAL, "template_cache", NULL, "misses");
+  stats_register_counter(0, &sc_key, SC_TYPE_SINGLE_VALUE, &stats_template_cache_misses);
+  stats_unlock();
+}
+
+static void
+_unregister_stats(void)
+{
+  StatsClusterKey sc_key;
+
+  stats_lock();
+  stats_cluster_single_key_set(&sc_key, "template_cache_hits_total", NULL, 0);
+  stats_cluster_single_key_add_legacy_alias_with_name(&sc_key, SCS_GLOBAL, "template_cache", NULL, "hits");
+  stats_unregister_counter(&sc_key, SC_TYPE_SINGLE_VALUE, &stats_template_cache_hits);
+  stats_cluster_single_key_set(&sc_key, "template_cache_misses_total", NULL, 0);
+  stats_cluster_single_key_add_legacy_alias_with_name(&sc_key, SCS_GLOBAL, "template_cache", NULL, "misses");
+  stats_unregister_counter(&sc_key, SC_TYPE_SINGLE_VALUE, &stats_template_cache_misses);
+  stats_unlock();
+}
+
+void
+log_template_eval_cache_global_init(void)
+{
+  register_application_hook(AH_RUNNING, (ApplicationHookFunc) _register_stats, NULL, AHM_RUN_ONCE);
+}
+
+void
+log_template_eval_cache_global_deinit(void)
+{
+  _unregister_stats();
+}
@@ -0,0 +1,41 @@
+/*
+ * Copyright (c) 2024 One Identity LLC.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#ifndef TEMPLATE_EVAL_CACHE_H_INCLUDED
+#define TEMPLATE_EVAL_CACHE_H_INCLUDED
+
+#include "template/eval.h"
+#include "logmsg/logmsg-cache.h"
+
+/* number of template results a single LogMessage can hold */
+#define LOG_TEMPLATE_EVAL_CACHE_SIZE LOG_MSG_CACHE_SIZE
+
+gboolean log_template_eval_cache_lookup(LogMessage *msg, LogTemplate *template, LogTemplateEvalOptions *options,
+                                        GString *result, LogMessageValueType *type);
+void log_template_eval_cache_store(LogMessage *msg, LogTemplate *template, LogTemplateEvalOptions *options,
+                                   const gchar *value, gsize value_len, LogMessageValueType type);
+
+void log_template_eval_cache_global_init(void);
+void log_template_eval_cache_global_deinit(void);
+
+#endif
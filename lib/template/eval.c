@@ -23,6 +23,7 @@
  */
 
 #include "eval.h"
+#include "eval-cache.h"
 #include "repr.h"
 #include "macros.h"
 #include "escaping.h"
@@ -30,6 +31,7 @@
 #include "scratch-buffers.h"
 #include "templates.h"
 #include "globals.h"
+#include "parse-number.h"
 
 static LogMessageValueType
 _propagate_type(LogMessageValueType acc_type, LogMessageValueType elem_type)
@@ -56,21 +58,21 @@ _should_render(const gchar *value, LogMessageValueType value_type, LogMessageVal
 }
 
 static void
-log_template_append_elem_value(LogTemplate *self, LogTemplateElem *e, LogTemplateEvalOptions *options,
-                               LogMessage *msg, LogMessageValueType *type, GString *result)
+log_template_append_op_value(LogTemplate *self, const LogTemplateOp *op, LogTemplateEvalOptions *options,
+                             LogMessage *msg, LogMessageValueType *type, GString *result)
 {
   const gchar *value = NULL;
   gssize value_len = -1;
   LogMessageValueType value_type = LM_VT_NONE;
 
-  value = log_msg_get_value_with_type(msg, e->value_handle, &value_len, &value_type);
+  value = log_msg_get_value_with_type(msg, op->value.handle, &value_len, &value_type);
   if (value && _should_render(value, value_type, self->type_hint))
     {
       g_string_append_len(result, value, value_len);
     }
-  else if (e->default_value)
+  else if (op->value.default_value)
     {
-      g_string_append_len(result, e->default_value, -1);
+      g_string_append_len(result, op->value.default_value, -1);
       value_type = LM_VT_STRING;
     }
   else if (value_type == LM_VT_BYTES || value_type == LM_VT_PROTOBUF)
@@ -81,19 +83,16 @@ log_template_append_elem_value(LogTemplate *self, LogTemplateElem *e, LogTemplat
 }
 
 static void
-log_template_append_elem_macro(LogTemplate *self, LogTemplateElem *e, LogTemplateEvalOptions *options,
-                               LogMessage *msg, LogMessageValueType *type, GString *result)
+log_template_append_op_macro(LogTemplate *self, const LogTemplateOp *op, LogTemplateEvalOptions *options,
+                             LogMessage *msg, LogMessageValueType *type, GString *result)
 {
   gint len = result->len;
   LogMessageValueType value_type = LM_VT_NONE;
 
-  if (e->macro)
-    {
-      log_macro_expand(e->macro, options, msg, result, &value_type);
-      if (len == result->len && e->default_value)
-        g_string_append(result, e->default_value);
-      *type = _propagate_type(*type, value_type);
-    }
+  log_macro_expand(op->macro.id, options, msg, result, &value_type);
+  if (len == result->len && op->macro.default_value)
+    g_string_append(result, op->macro.default_value);
+  *type = _propagate_type(*type, value_type);
 }
 
 static void
@@ -101,14 +100,15 @@ log_template_append_elem_func(LogTemplate *self, LogTemplateElem *e, LogTemplate
                               LogMessage **messages, gint num_messages, gint msg_ndx,
                               LogMessageValueType *type, GString *result)
 {
-  LogTemplateInvokeArgs args =
-  {
-    e->msg_ref ? &messages[msg_ndx] : messages,
-    e->msg_ref ? 1 : num_messages,
-    options,
-  };
+  LogTemplateInvokeArgs args;
   LogMessageValueType value_type = LM_VT_NONE;
 
+  /* argv[] is filled by the eval() method, so only the header is
+   * initialized, clearing the argument arrays would be a waste */
+  args.messages = e->msg_ref ? &messages[msg_ndx] : messages;
+  args.num_messages = e->msg_ref ? 1 : num_messages;
+  args.options = options;
+
 
   /* if a function call is called with an msg_ref, we only
    * pass that given logmsg to argument resolution, otherwise
@@ -122,16 +122,9 @@ log_template_append_elem_func(LogTemplate *self, LogTemplateElem *e, LogTemplate
   *type = _propagate_type(*type, value_type);
 }
 
-void
-log_template_append_format_value_and_type_with_context(LogTemplate *self, LogMessage **messages, gint num_messages,
-                                                       LogTemplateEvalOptions *options,
-                                                       GString *result, LogMessageValueType *type)
+static void
+_resolve_template_options(LogTemplate *self, LogTemplateEvalOptions *options)
 {
-  LogTemplateElem *e;
-  LogMessageValueType t = LM_VT_NONE;
-  gboolean first_elem = TRUE;
-  GString *target_buffer = result;
-
   if (!options->opts)
     {
       /* try the configuration first */
@@ -141,30 +134,42 @@ log_template_append_format_value_and_type_with_context(LogTemplate *self, LogMes
       else
         options->opts = log_template_get_global_template_options();
     }
+}
+
+static void
+_append_format(LogTemplate *self, LogMessage **messages, gint num_messages, LogTemplateEvalOptions *options,
+               GString *result, LogMessageValueType *type)
+{
+  LogMessageValueType t = LM_VT_NONE;
+  GString *target_buffer = result;
+  const LogTemplateOp *ops = self->program ? self->program->ops : NULL;
+  gint num_ops = self->program ? self->program->num_ops : 0;
+
+  _resolve_template_options(self, options);
 
   gboolean escape = (self->escape || (self->top_level && options->opts->escape));
   if (escape)
     target_buffer = scratch_buffers_alloc();
 
-  for (GList *p = self->compiled_template; p; p = g_list_next(p), first_elem = FALSE)
+  for (gint i = 0; i < num_ops; i++)
     {
+      const LogTemplateOp *op = &ops[i];
       gint msg_ndx;
 
-      if (!first_elem)
+      if (op->type == LTO_LITERAL)
         {
-          /* this is the 2nd elem in the compiled template, we are
-           * concatenating multiple elements, convert the value to string */
-
+          /* concatenating literal text, literals are never escaped */
+          g_string_append_len(result, op->literal.text, op->literal.text_len);
           t = LM_VT_STRING;
+          continue;
         }
 
-      e = (LogTemplateElem *) p->data;
-      if (e->text)
+      if (i > 0)
         {
-          g_string_append_len(result, e->text, e->text_len);
-          /* concatenating literal text */
-          if (e->text_len)
-            t = LM_VT_STRING;
+          /* this is not the first operation in the program, we are
+           * concatenating multiple elements, convert the value to string */
+
+          t = LM_VT_STRING;
         }
 
       /* NOTE: msg_ref is 1 larger than the index specified by the user in
@@ -173,31 +178,31 @@ log_template_append_format_value_and_type_with_context(LogTemplate *self, LogMes
        *
        * msg_ref == 0 means that the user didn't specify msg_ref
        * msg_ref >= 1 means that the user supplied the given msg_ref, 1 is equal to @0 */
-      if (e->msg_ref > num_messages)
+      if (op->msg_ref > num_messages)
         {
           /* msg_ref out of range, we expand to empty string without evaluating the element */
           t = LM_VT_STRING;
           continue;
         }
-      msg_ndx = num_messages - e->msg_ref;
+      msg_ndx = num_messages - op->msg_ref;
 
       /* value and macro can't understand a context, assume that no msg_ref means @0 */
-      if (e->msg_ref == 0)
+      if (op->msg_ref == 0)
         msg_ndx--;
 
       if (escape)
         g_string_truncate(target_buffer, 0);
 
-      switch (e->type)
+      switch (op->type)
         {
-        case LTE_VALUE:
-          log_template_append_elem_value(self, e, options, messages[msg_ndx], &t, target_buffer);
+        case LTO_VALUE:
+          log_template_append_op_value(self, op, options, messages[msg_ndx], &t, target_buffer);
           break;
-        case LTE_MACRO:
-          log_template_append_elem_macro(self, e, options, messages[msg_ndx], &t, target_buffer);
+        case LTO_MACRO:
+          log_template_append_op_macro(self, op, options, messages[msg_ndx], &t, target_buffer);
           break;
-        case LTE_FUNC:
-          log_template_append_elem_func(self, e, options, messages, num_messages, msg_ndx, &t, target_buffer);
+        case LTO_FUNC:
+          log_template_append_elem_func(self, op->func, options, messages, num_messages, msg_ndx, &t, target_buffer);
           break;
         default:
           g_assert_not_reached();
@@ -215,7 +220,7 @@ log_template_append_format_value_and_type_with_context(LogTemplate *self, LogMes
     }
   if (type)
     {
-      if (first_elem && t == LM_VT_NONE)
+      if (num_ops == 0 && t == LM_VT_NONE)
         {
           /* empty template string, use LM_VT_STRING before applying the type-cast */
           t = LM_VT_STRING;
@@ -228,6 +233,36 @@ log_template_append_format_value_and_type_with_context(LogTemplate *self, LogMes
     }
 }
 
+static void
+_append_format_cached(LogTemplate *self, LogMessage *msg, LogTemplateEvalOptions *options,
+                      GString *result, LogMessageValueType *type)
+{
+  LogMessageValueType t;
+
+  _resolve_template_options(self, options);
+  if (!log_template_eval_cache_lookup(msg, self, options, result, &t))
+    {
+      gsize start = result->len;
+
+      _append_format(self, &msg, 1, options, result, &t);
+      log_template_eval_cache_store(msg, self, options, result->str + start, result->len - start, t);
+    }
+  if (type)
+    *type = t;
+}
+
+void
+log_template_append_format_value_and_type_with_context(LogTemplate *self, LogMessage **messages, gint num_messages,
+                                                       LogTemplateEvalOptions *options,
+                                                       GString *result, LogMessageValueType *type)
+{
+  /* only write protected messages are cached, as they can't change anymore */
+  if (self->cache_results && num_messages == 1 && log_msg_is_write_protected(messages[0]))
+    _append_format_cached(self, messages[0], options, result, type);
+  else
+    _append_format(self, messages, num_messages, options, result, type);
+}
+
 void
 log_template_append_format_with_context(LogTemplate *self, LogMessage **messages, gint num_messages,
                                         LogTemplateEvalOptions *options,
@@ -280,6 +315,180 @@ log_template_format(LogTemplate *self, LogMessage *lm, LogTemplateEvalOptions *o
   log_template_format_value_and_type(self, lm, options, result, NULL);
 }
 
+/* numbers stored in binary form by log_msg_set_value_with_number() need no parsing */
+static gboolean
+_load_stored_number(LogTemplateTypedValue *value, LogMessage *msg, NVHandle handle)
+{
+  NVNumericValue number;
+
+  if (!log_msg_get_value_number(msg, handle, &number))
+    return FALSE;
+
+  switch (value->type)
+    {
+    case LM_VT_INTEGER:
+      gn_set_int64(&value->as.number, number.as_int64);
+      return TRUE;
+    case LM_VT_DOUBLE:
+      gn_set_double(&value->as.number, number.as_double, -1);
+      return TRUE;
+    case LM_VT_BOOLEAN:
+      value->as.boolean = number.as_int64 != 0;
+      return TRUE;
+    default:
+      return FALSE;
+    }
+}
+
+static gboolean
+_eval_typed_as_view(LogTemplate *self, LogMessage **messages, gint num_messages, LogTemplateEvalOptions *options,
+                    LogTemplateTypedValue *value, gboolean *parsed)
+{
+  if (!log_template_is_trivial(self))
+    return FALSE;
+
+  _resolve_template_options(self, options);
+  if (self->top_level && options->opts->escape)
+    return FALSE;
+
+  if (log_template_is_literal_string(self))
+    {
+      gssize len = 0;
+
+      value->str = log_template_get_literal_value(self, &len);
+      value->str_len = len;
+      value->type = _propagate_type(self->type_hint, LM_VT_STRING);
+      return TRUE;
+    }
+
+  /* the trivial value API ignores ${VALUE:-default} */
+  LogTemplateElem *e = (LogTemplateElem *) self->compiled_template->data;
+  if (e->default_value)
+    return FALSE;
+
+  NVHandle handle = log_template_get_trivial_value_handle(self);
+  LogMessageValueType t = LM_VT_NONE;
+  gssize len;
+
+  value->str = log_msg_get_value_with_type(messages[num_messages - 1], handle, &len, &t);
+
+  /* binary values are rendered depending on the type-hint, leave that to
+   * the generic path */
+  if (t == LM_VT_BYTES || t == LM_VT_PROTOBUF)
+    return FALSE;
+
+  value->str_len = len;
+  value->type = _propagate_type(self->type_hint, t);
+  *parsed = value->type == t && _load_stored_number(value, messages[num_messages - 1], handle);
+  return TRUE;
+}
+
+static void
+_parse_typed_value(LogTemplateTypedValue *value)
+{
+  switch (value->type)
+    {
+    case LM_VT_INTEGER:
+    case LM_VT_DOUBLE:
+      if (!parse_generic_number(value->str, &value->as.number))
+        gn_set_nan(&value->as.number);
+      break;
+    case LM_VT_BOOLEAN:
+      if (!type_cast_to_boolean(value->str, &value->as.boolean, NULL))
+        value->as.boolean = FALSE;
+      break;
+    default:
+      break;
+    }
+}
+
+void
+log_template_eval_typed_with_context(LogTemplate *self, LogMessage **messages, gint num_messages,
+                                     LogTemplateEvalOptions *options,
+                                     GString *buffer, LogTemplateTypedValue *value)
+{
+  gboolean parsed = FALSE;
+
+  if (_eval_typed_as_view(self, messages, num_messages, options, value, &parsed))
+    {
+      /* indirect values are not NUL terminated, this is the only case we
+       * need to copy a trivial value */
+      if (value->str[value->str_len] != 0)
+        {
+          g_string_truncate(buffer, 0);
+          g_string_append_len(buffer, value->str, value->str_len);
+          value->str = buffer->str;
+        }
+    }
+  else
+    {
+      log_template_format_value_and_type_with_context(self, messages, num_messages, options, buffer, &value->type);
+      value->str = buffer->str;
+      value->str_len = buffer->len;
+    }
+  if (!parsed)
+    _parse_typed_value(value);
+}
+
+void
+log_template_eval_typed(LogTemplate *self, LogMessage *lm, LogTemplateEvalOptions *options,
+                        GString *buffer, LogTemplateTypedValue *value)
+{
+  log_template_eval_typed_with_context(self, &lm, 1, options, buffer, value);
+}
+
+gboolean
+log_template_typed_value_as_number(const LogTemplateTypedValue *value, GenericNumber *number)
+{
+  switch (value->type)
+    {
+    case LM_VT_INTEGER:
+    case LM_VT_DOUBLE:
+      *number = value->as.number;
+      return !gn_is_nan(number);
+    case LM_VT_STRING:
+      return parse_generic_number(value->str, number);
+    default:
+      return FALSE;
+    }
+}
+
+void
+log_template_append_format_batch(LogTemplate *self, LogMessage **messages, const gint32 *seq_nums,
+                                 gint num_messages, LogTemplateEvalOptions *options,
+                                 GString *result, gsize *offsets)
+{
+  LogTemplateEvalOptions message_options = *options;
+  LogTemplateTypedValue value;
+  gboolean parsed;
+
+  /* these only depend on the template and the options, not the message */
+  _resolve_template_options(self, &message_options);
+  gboolean trivial = log_template_is_trivial(self) && !(self->top_level && message_options.opts->escape);
+
+  for (gint i = 0; i < num_messages; i++)
+    {
+      offsets[i] = result->len;
+      if (seq_nums)
+        message_options.seq_num = seq_nums[i];
+
+      if (trivial && _eval_typed_as_view(self, &messages[i], 1, &message_options, &value, &parsed))
+        g_string_append_len(result, value.str, value.str_len);
+      else
+        log_template_append_format_value_and_type_with_context(self, &messages[i], 1, &message_options, result, NULL);
+    }
+  offsets[num_messages] = result->len;
+}
+
+void
+log_template_format_batch(LogTemplate *self, LogMessage **messages, const gint32 *seq_nums,
+                          gint num_messages, LogTemplateEvalOptions *options,
+                          GString *result, gsize *offsets)
+{
+  g_string_truncate(result, 0);
+  log_template_append_format_batch(self, messages, seq_nums, num_messages, options, result, offsets);
+}
+
 guint
 log_template_hash(LogTemplate *self, LogMessage *lm, LogTemplateEvalOptions *options)
 {
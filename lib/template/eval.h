@@ -29,6 +29,7 @@
 #include "common-template-typedefs.h"
 #include "escaping.h"
 #include "logmsg/logmsg.h"
+#include "generic-number.h"
 
 typedef struct _LogTemplateEvalOptions
 {
@@ -60,6 +61,50 @@ void log_template_format_value_and_type_with_context(LogTemplate *self, LogMessa
 void log_template_format_with_context(LogTemplate *self, LogMessage **messages, gint num_messages,
                                       LogTemplateEvalOptions *options, GString *result);
 
+/*
+ * The result of a typed template evaluation.  "str" is always set and NUL
+ * terminated, it points directly into the message (or the template) if the
+ * template is trivial, and into the buffer passed to log_template_eval_typed()
+ * otherwise, so it is only valid as long as those are not changed.
+ *
+ * Numbers and booleans are also stored in their parsed form, in which case
+ * "as" is valid for the type: as.number for LM_VT_INTEGER and LM_VT_DOUBLE
+ * (NaN if the value could not be parsed) and as.boolean for LM_VT_BOOLEAN.
+ */
+typedef struct _LogTemplateTypedValue
+{
+  LogMessageValueType type;
+  const gchar *str;
+  gsize str_len;
+  union
+  {
+    GenericNumber number;
+    gboolean boolean;
+  } as;
+} LogTemplateTypedValue;
+
+void log_template_eval_typed(LogTemplate *self, LogMessage *lm, LogTemplateEvalOptions *options,
+                             GString *buffer, LogTemplateTypedValue *value);
+void log_template_eval_typed_with_context(LogTemplate *self, LogMessage **messages, gint num_messages,
+                                          LogTemplateEvalOptions *options,
+                                          GString *buffer, LogTemplateTypedValue *value);
+gboolean log_template_typed_value_as_number(const LogTemplateTypedValue *value, GenericNumber *number);
+
+/*
+ * Formats the template for each message of a batch (separately, not as a
+ * context) into a single buffer: the output of messages[i] starts at
+ * offsets[i] and ends at offsets[i + 1], so offsets must have room for
+ * num_messages + 1 elements.  seq_nums[i] is used as the sequence number
+ * of messages[i], if seq_nums is NULL, options->seq_num is used for all of
+ * them.
+ */
+void log_template_append_format_batch(LogTemplate *self, LogMessage **messages, const gint32 *seq_nums,
+                                      gint num_messages, LogTemplateEvalOptions *options,
+                                      GString *result, gsize *offsets);
+void log_template_format_batch(LogTemplate *self, LogMessage **messages, const gint32 *seq_nums,
+                               gint num_messages, LogTemplateEvalOptions *options,
+                               GString *result, gsize *offsets);
+
 guint log_template_hash(LogTemplate *self, LogMessage *lm, LogTemplateEvalOptions *options);
 
 #endif
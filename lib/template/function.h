@@ -42,9 +42,19 @@ typedef struct _LogTemplateInvokeArgs
   gint num_messages;
 
   LogTemplateEvalOptions *options;
+
+  /* argument strings are read-only, they may point to buffers shared
+   * between invocations or directly into the message (see argv_views) */
   GString *argv[TEMPLATE_INVOKE_MAX_ARGS];
+
+  /* storage for arguments borrowed from the message, without copying */
+  GString argv_views[TEMPLATE_INVOKE_MAX_ARGS];
 } LogTemplateInvokeArgs;
 
+/* the function only depends on its arguments (and not on the message), so
+ * invocations with literal arguments can be evaluated at compile time */
+#define LTF_PURE 0x0001
+
 typedef struct _LogTemplateFunction LogTemplateFunction;
 struct _LogTemplateFunction
 {
@@ -74,6 +84,9 @@ struct _LogTemplateFunction
 
   /* generic argument that can be used to pass information from registration time */
   gpointer arg;
+
+  /* LTF_* flags */
+  guint32 flags;
 };
 
 #define TEMPLATE_FUNCTION_PROTOTYPE(prefix) \
@@ -84,7 +97,7 @@ struct _LogTemplateFunction
   TEMPLATE_FUNCTION_PROTOTYPE(prefix);
 
 /* helper macros for template function plugins */
-#define TEMPLATE_FUNCTION(state_struct, prefix, prepare, eval, call, free_state, arg) \
+#define TEMPLATE_FUNCTION_WITH_FLAGS(state_struct, prefix, prepare, eval, call, free_state, arg, flags) \
   TEMPLATE_FUNCTION_PROTOTYPE(prefix)           \
   {                                                                     \
     static LogTemplateFunction func = {                                 \
@@ -94,11 +107,15 @@ struct _LogTemplateFunction
       call,                                                             \
       free_state,                                                       \
       NULL,               \
-      arg                                                               \
+      arg,                                                              \
+      flags                                                             \
     };                                                                  \
     return &func;                                                       \
   }
 
+#define TEMPLATE_FUNCTION(state_struct, prefix, prepare, eval, call, free_state, arg) \
+  TEMPLATE_FUNCTION_WITH_FLAGS(state_struct, prefix, prepare, eval, call, free_state, arg, 0)
+
 #define TEMPLATE_FUNCTION_PLUGIN(x, tf_name) \
   {                                     \
     .type = LL_CONTEXT_TEMPLATE_FUNC,   \
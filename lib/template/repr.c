@@ -182,3 +182,106 @@ log_template_elem_free_list(GList *l)
     }
   g_list_free(l);
 }
+
+static LogTemplateOp *
+_program_append_op(LogTemplateProgram *self, guint8 type, guint16 msg_ref)
+{
+  LogTemplateOp *op = &self->ops[self->num_ops++];
+
+  op->type = type;
+  op->msg_ref = msg_ref;
+  return op;
+}
+
+static void
+_program_append_literal(LogTemplateProgram *self, gchar **literal_pos, const gchar *text, gsize text_len)
+{
+  LogTemplateOp *last_op = self->num_ops > 0 ? &self->ops[self->num_ops - 1] : NULL;
+
+  /* the literal buffer is filled sequentially, so the text of the last
+   * literal ends exactly where this one starts */
+  if (last_op && last_op->type == LTO_LITERAL)
+    {
+      last_op->literal.text_len += text_len;
+    }
+  else
+    {
+      LogTemplateOp *op = _program_append_op(self, LTO_LITERAL, 0);
+      op->literal.text = *literal_pos;
+      op->literal.text_len = text_len;
+    }
+  memcpy(*literal_pos, text, text_len);
+  *literal_pos += text_len;
+}
+
+static void
+_program_append_elem(LogTemplateProgram *self, LogTemplateElem *e)
+{
+  LogTemplateOp *op;
+
+  switch (e->type)
+    {
+    case LTE_VALUE:
+      op = _program_append_op(self, LTO_VALUE, e->msg_ref);
+      op->value.handle = e->value_handle;
+      op->value.default_value = e->default_value;
+      break;
+    case LTE_MACRO:
+      /* the literal elements at the end of the template */
+      if (e->macro == M_NONE)
+        break;
+      op = _program_append_op(self, LTO_MACRO, e->msg_ref);
+      op->macro.id = e->macro;
+      op->macro.default_value = e->default_value;
+      break;
+    case LTE_FUNC:
+      op = _program_append_op(self, LTO_FUNC, e->msg_ref);
+      op->func = e;
+      break;
+    default:
+      g_assert_not_reached();
+    }
+}
+
+LogTemplateProgram *
+log_template_program_new(GList *compiled_template)
+{
+  gint num_elems = 0;
+  gsize literals_len = 0;
+
+  if (!compiled_template)
+    return NULL;
+
+  for (GList *l = compiled_template; l; l = l->next)
+    {
+      LogTemplateElem *e = (LogTemplateElem *) l->data;
+
+      literals_len += e->text_len;
+      num_elems++;
+    }
+
+  /* each element yields at most two operations: its literal prefix and itself */
+  LogTemplateProgram *self = g_malloc0(sizeof(LogTemplateProgram) + 2 * num_elems * sizeof(LogTemplateOp));
+  self->literals = literals_len > 0 ? g_malloc(literals_len) : NULL;
+
+  gchar *literal_pos = self->literals;
+  for (GList *l = compiled_template; l; l = l->next)
+    {
+      LogTemplateElem *e = (LogTemplateElem *) l->data;
+
+      if (e->text_len > 0)
+        _program_append_literal(self, &literal_pos, e->text, e->text_len);
+      _program_append_elem(self, e);
+    }
+  return self;
+}
+
+void
+log_template_program_free(LogTemplateProgram *self)
+{
+  if (!self)
+    return;
+
+  g_free(self->literals);
+  g_free(self);
+}
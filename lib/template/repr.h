@@ -70,5 +70,58 @@ log_template_elem_is_literal_string(const LogTemplateElem *self)
 
 void log_template_elem_free_list(GList *el);
 
+/*
+ * LogTemplateProgram: the list of LogTemplateElems flattened into an array
+ * of operations.  The literal text that precedes an element becomes an
+ * operation of its own, consecutive literals are fused and their text is
+ * stored in a single buffer.  Values and macros are copied into the
+ * operation, template functions still refer to their LogTemplateElem.
+ *
+ * The program borrows the default values and function elements from the
+ * compiled_template list, so it must not outlive it.
+ */
+enum
+{
+  LTO_LITERAL,
+  LTO_VALUE,
+  LTO_MACRO,
+  LTO_FUNC,
+};
+
+typedef struct _LogTemplateOp
+{
+  guint8 type;
+  guint16 msg_ref;
+  union
+  {
+    struct
+    {
+      const gchar *text;
+      gsize text_len;
+    } literal;
+    struct
+    {
+      NVHandle handle;
+      const gchar *default_value;
+    } value;
+    struct
+    {
+      guint id;
+      const gchar *default_value;
+    } macro;
+    LogTemplateElem *func;
+  };
+} LogTemplateOp;
+
+struct _LogTemplateProgram
+{
+  gint num_ops;
+  gchar *literals;
+  LogTemplateOp ops[];
+};
+
+LogTemplateProgram *log_template_program_new(GList *compiled_template);
+void log_template_program_free(LogTemplateProgram *self);
+
 
 #endif
@@ -24,6 +24,7 @@
 
 #include "template/simple-function.h"
 #include "template/templates.h"
+#include "template/repr.h"
 #include "scratch-buffers.h"
 
 void
@@ -37,6 +38,50 @@ log_template_append_format_recursive(LogTemplate *self, const LogTemplateInvokeA
 
 /* simple template functions which take templates as arguments */
 
+static GString *
+_render_literal_argument(LogTemplate *template)
+{
+  gssize len = 0;
+  const gchar *value = log_template_get_literal_value(template, &len);
+
+  return g_string_new_len(value, len);
+}
+
+static gboolean
+_are_all_arguments_literal(TFSimpleFuncState *state)
+{
+  for (gint i = 0; i < state->argc; i++)
+    {
+      if (!state->argv_literals[i])
+        return FALSE;
+    }
+  return TRUE;
+}
+
+/* calls the function with its literal arguments, the result is then used
+ * for all invocations */
+static void
+_fold_constant_call(LogTemplateFunction *self, TFSimpleFuncState *state)
+{
+  LogMessage *msg = log_msg_new_empty();
+  LogTemplateEvalOptions options = DEFAULT_TEMPLATE_EVAL_OPTIONS;
+  LogTemplateInvokeArgs args;
+  GString *result = g_string_sized_new(64);
+  LogMessageValueType type = LM_VT_NONE;
+
+  args.messages = &msg;
+  args.num_messages = 1;
+  args.options = &options;
+  for (gint i = 0; i < state->argc; i++)
+    args.argv[i] = state->argv_literals[i];
+
+  self->call(self, state, &args, result, &type);
+  log_msg_unref(msg);
+
+  state->folded_result = result;
+  state->folded_type = type;
+}
+
 gboolean
 tf_simple_func_prepare(LogTemplateFunction *self, gpointer s, LogTemplate *parent, gint argc, gchar *argv[],
                        GError **error)
@@ -46,6 +91,7 @@ tf_simple_func_prepare(LogTemplateFunction *self, gpointer s, LogTemplate *paren
 
   g_return_val_if_fail(error == NULL || *error == NULL, FALSE);
   state->argv_templates = g_malloc(sizeof(LogTemplate *) * (argc - 1));
+  state->argv_literals = g_new0(GString *, argc - 1);
 
   /* NOTE: the argv argument contains the function name as argv[0],
    * but the LogTemplate array doesn't. Thus the index is shifted by
@@ -58,24 +104,72 @@ tf_simple_func_prepare(LogTemplateFunction *self, gpointer s, LogTemplate *paren
           state->argc = i + 1;
           goto error;
         }
+      if (log_template_is_literal_string(state->argv_templates[i]))
+        state->argv_literals[i] = _render_literal_argument(state->argv_templates[i]);
     }
   state->argc = argc - 1;
+
+  if ((self->flags & LTF_PURE) && state->argc <= TEMPLATE_INVOKE_MAX_ARGS && _are_all_arguments_literal(state))
+    _fold_constant_call(self, state);
   return TRUE;
 error:
   return FALSE;
 }
 
+/* single value arguments are passed as a view into the message, as long as
+ * they are rendered as they are stored */
+static gboolean
+_borrow_value_argument(LogTemplate *template, LogTemplateInvokeArgs *args, GString *view)
+{
+  if (!log_template_is_trivial(template) || log_template_is_literal_string(template))
+    return FALSE;
+
+  LogTemplateElem *e = (LogTemplateElem *) template->compiled_template->data;
+  if (e->default_value)
+    return FALSE;
+
+  NVHandle handle = log_template_get_trivial_value_handle(template);
+  LogMessageValueType type;
+  gssize value_len;
+  const gchar *value = log_msg_get_value_with_type(args->messages[args->num_messages - 1], handle,
+                                                   &value_len, &type);
+
+  /* binary values are not rendered without a type-hint, and indirect
+   * values are not NUL terminated */
+  if (type == LM_VT_BYTES || type == LM_VT_PROTOBUF || value[value_len] != 0)
+    return FALSE;
+
+  view->str = (gchar *) value;
+  view->len = value_len;
+  view->allocated_len = value_len + 1;
+  return TRUE;
+}
+
 void
 tf_simple_func_eval(LogTemplateFunction *self, gpointer s, LogTemplateInvokeArgs *args)
 {
   TFSimpleFuncState *state = (TFSimpleFuncState *) s;
   gint i;
 
+  if (state->folded_result)
+    return;
+
   g_assert(state->argc <= TEMPLATE_INVOKE_MAX_ARGS);
   for (i = 0; i < state->argc; i++)
     {
-      args->argv[i] = scratch_buffers_alloc();
-      log_template_append_format_recursive(state->argv_templates[i], args, args->argv[i]);
+      if (state->argv_literals && state->argv_literals[i])
+        {
+          args->argv[i] = state->argv_literals[i];
+        }
+      else if (_borrow_value_argument(state->argv_templates[i], args, &args->argv_views[i]))
+        {
+          args->argv[i] = &args->argv_views[i];
+        }
+      else
+        {
+          args->argv[i] = scratch_buffers_alloc();
+          log_template_append_format_recursive(state->argv_templates[i], args, args->argv[i]);
+        }
     }
 }
 
@@ -86,6 +180,12 @@ tf_simple_func_call(LogTemplateFunction *self, gpointer s, const LogTemplateInvo
   TFSimpleFunc simple_func = (TFSimpleFunc) self->arg;
   TFSimpleFuncState *state = (TFSimpleFuncState *) s;
 
+  if (state->folded_result)
+    {
+      g_string_append_len(result, state->folded_result->str, state->folded_result->len);
+      *type = state->folded_type;
+      return;
+    }
   simple_func(args->messages[args->num_messages-1], state->argc, (GString **) args->argv, result, type);
 }
 
@@ -99,6 +199,11 @@ tf_simple_func_free_state(gpointer s)
     {
       if (state->argv_templates[i])
         log_template_unref(state->argv_templates[i]);
+      if (state->argv_literals && state->argv_literals[i])
+        g_string_free(state->argv_literals[i], TRUE);
     }
   g_free(state->argv_templates);
+  g_free(state->argv_literals);
+  if (state->folded_result)
+    g_string_free(state->folded_result, TRUE);
 }
@@ -33,6 +33,14 @@ typedef struct _TFSimpleFuncState
 {
   gint argc;
   LogTemplate **argv_templates;
+
+  /* the values of literal arguments, rendered at compile time, NULL for
+   * the arguments that need to be evaluated */
+  GString **argv_literals;
+
+  /* the result of LTF_PURE functions if all of their arguments are literals */
+  GString *folded_result;
+  LogMessageValueType folded_type;
 } TFSimpleFuncState;
 
 typedef void (*TFSimpleFunc)(LogMessage *msg, gint argc, GString *argv[], GString *result, LogMessageValueType *type);
@@ -46,4 +54,7 @@ void tf_simple_func_free_state(gpointer state);
 
 #define TEMPLATE_FUNCTION_SIMPLE(x) TEMPLATE_FUNCTION(TFSimpleFuncState, x, tf_simple_func_prepare, tf_simple_func_eval, tf_simple_func_call, tf_simple_func_free_state, x)
 
+/* simple functions that only depend on their arguments, see LTF_PURE */
+#define TEMPLATE_FUNCTION_SIMPLE_PURE(x) TEMPLATE_FUNCTION_WITH_FLAGS(TFSimpleFuncState, x, tf_simple_func_prepare, tf_simple_func_eval, tf_simple_func_call, tf_simple_func_free_state, x, LTF_PURE)
+
 #endif
@@ -184,6 +184,8 @@ _calculate_if_trivial(LogTemplate *self)
 static void
 log_template_reset_compiled(LogTemplate *self)
 {
+  log_template_program_free(self->program);
+  self->program = NULL;
   log_template_elem_free_list(self->compiled_template);
   self->compiled_template = NULL;
   self->trivial = FALSE;
@@ -205,6 +207,7 @@ log_template_compile(LogTemplate *self, const gchar *template, GError **error)
   log_template_compiler_init(&compiler, self);
   result = log_template_compiler_compile(&compiler, &self->compiled_template, error);
   log_template_compiler_clear(&compiler);
+  self->program = log_template_program_new(self->compiled_template);
 
   self->literal = _calculate_if_literal(self);
   self->trivial = _calculate_if_trivial(self);
@@ -284,6 +287,7 @@ log_template_compile_literal_string(LogTemplate *self, const gchar *literal)
   self->template_str = g_strdup(literal);
   self->compiled_template = g_list_append(self->compiled_template,
                                           log_template_elem_new_macro(literal, M_NONE, NULL, 0));
+  self->program = log_template_program_new(self->compiled_template);
 
   /* double check that the representation here is actually considered trivial. It should be. */
   g_assert(_calculate_if_trivial(self));
@@ -298,6 +302,12 @@ log_template_set_escape(LogTemplate *self, gboolean enable)
   self->escape = enable;
 }
 
+void
+log_template_set_cache_results(LogTemplate *self, gboolean enable)
+{
+  self->cache_results = enable;
+}
+
 gboolean
 log_template_set_type_hint(LogTemplate *self, const gchar *type_hint, GError **error)
 {
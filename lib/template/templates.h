@@ -58,8 +58,10 @@ struct _LogTemplate
   gchar *name;
   gchar *template_str;
   GList *compiled_template;
+  /* the flattened form of compiled_template, this is what gets evaluated */
+  LogTemplateProgram *program;
   GlobalConfig *cfg;
-  guint top_level:1, escape:1, def_inline:1, trivial:1, literal:1;
+  guint top_level:1, escape:1, def_inline:1, trivial:1, literal:1, cache_results:1;
 
   /* This value stores the type-hint the user _explicitly_ specified.  If
    * this is an automatic cast to string (in compat mode), this would be
@@ -76,6 +78,7 @@ struct _LogTemplate
 /* appends the formatted output into result */
 
 void log_template_set_escape(LogTemplate *self, gboolean enable);
+void log_template_set_cache_results(LogTemplate *self, gboolean enable);
 gboolean log_template_set_type_hint(LogTemplate *self, const gchar *hint, GError **error);
 gboolean log_template_compile(LogTemplate *self, const gchar *template_str, GError **error);
 gboolean log_template_compile_with_type_hint(LogTemplate *self, const gchar *template_and_typehint, GError **error);
@@ -0,0 +1,166 @@
+/*
+ * Copyright (c) 2024 One Identity LLC.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#include <criterion/criterion.h>
+
+#include "template/templates.h"
+#include "template/simple-function.h"
+#include "logmsg/logmsg.h"
+#include "apphook.h"
+#include "cfg.h"
+#include "plugin.h"
+
+static gint num_calls;
+static const gchar *last_argv0;
+
+static void
+join_args(LogMessage *msg, gint argc, GString *argv[], GString *result, LogMessageValueType *type)
+{
+  num_calls++;
+  last_argv0 = argc > 0 ? argv[0]->str : NULL;
+  for (gint i = 0; i < argc; i++)
+    {
+      if (i > 0)
+        g_string_append_c(result, '+');
+      g_string_append_len(result, argv[i]->str, argv[i]->len);
+    }
+  *type = LM_VT_STRING;
+}
+
+static void
+pure_join_args(LogMessage *msg, gint argc, GString *argv[], GString *result, LogMessageValueType *type)
+{
+  join_args(msg, argc, argv, result, type);
+}
+
+TEMPLATE_FUNCTION_SIMPLE(join_args);
+TEMPLATE_FUNCTION_SIMPLE_PURE(pure_join_args);
+
+static Plugin join_args_plugins[] =
+{
+  TEMPLATE_FUNCTION_PLUGIN(join_args, "join"),
+  TEMPLATE_FUNCTION_PLUGIN(pure_join_args, "pure-join"),
+};
+
+static GlobalConfig *cfg;
+
+static LogTemplate *
+_compile_template(const gchar *template_str)
+{
+  LogTemplate *template = log_template_new(cfg, NULL);
+
+  cr_assert(log_template_compile(template, template_str, NULL));
+  return template;
+}
+
+static void
+assert_template_format(LogTemplate *template, LogMessage *msg, const gchar *expected)
+{
+  GString *result = g_string_new("");
+
+  log_template_format(template, msg, &DEFAULT_TEMPLATE_EVAL_OPTIONS, result);
+  cr_assert_str_eq(result->str, expected);
+  g_string_free(result, TRUE);
+}
+
+static LogMessage *
+_create_message(void)
+{
+  LogMessage *msg = log_msg_new_empty();
+
+  log_msg_set_value(msg, LM_V_MESSAGE, "message", -1);
+  log_msg_set_value(msg, LM_V_HOST, "host", -1);
+  return msg;
+}
+
+Test(simple_function, test_pure_functions_with_literal_arguments_are_evaluated_at_compile_time)
+{
+  LogMessage *msg = _create_message();
+  LogTemplate *template = _compile_template("$(pure-join foo bar)");
+
+  cr_assert_eq(num_calls, 1);
+  assert_template_format(template, msg, "foo+bar");
+  assert_template_format(template, msg, "foo+bar");
+  cr_assert_eq(num_calls, 1);
+  log_template_unref(template);
+
+  template = _compile_template("$(join foo bar)");
+  cr_assert_eq(num_calls, 1);
+  assert_template_format(template, msg, "foo+bar");
+  assert_template_format(template, msg, "foo+bar");
+  cr_assert_eq(num_calls, 3);
+  log_template_unref(template);
+
+  template = _compile_template("$(pure-join foo $HOST)");
+  assert_template_format(template, msg, "foo+host");
+  assert_template_format(template, msg, "foo+host");
+  cr_assert_eq(num_calls, 5);
+  log_template_unref(template);
+
+  log_msg_unref(msg);
+}
+
+Test(simple_function, test_single_value_arguments_point_into_the_message)
+{
+  LogMessage *msg = _create_message();
+  LogTemplate *template = _compile_template("$(join $MSG $HOST)");
+
+  assert_template_format(template, msg, "message+host");
+  cr_assert_eq(last_argv0, log_msg_get_value(msg, LM_V_MESSAGE, NULL));
+  log_template_unref(template);
+
+  /* anything else is formatted into a buffer */
+  template = _compile_template("$(join ${MESSAGE}x $HOST)");
+  assert_template_format(template, msg, "messagex+host");
+  cr_assert_neq(last_argv0, log_msg_get_value(msg, LM_V_MESSAGE, NULL));
+  log_template_unref(template);
+
+  template = _compile_template("$(join ${unset:-default} $HOST)");
+  assert_template_format(template, msg, "default+host");
+  log_template_unref(template);
+
+  log_msg_set_value_indirect(msg, log_msg_get_value_handle("indirect"), LM_V_MESSAGE, 0, 4);
+  template = _compile_template("$(join ${indirect} $HOST)");
+  assert_template_format(template, msg, "mess+host");
+  log_template_unref(template);
+
+  log_msg_unref(msg);
+}
+
+static void
+setup(void)
+{
+  app_startup();
+  cfg = cfg_new_snippet();
+  plugin_register(&cfg->plugin_context, join_args_plugins, G_N_ELEMENTS(join_args_plugins));
+  num_calls = 0;
+}
+
+static void
+teardown(void)
+{
+  cfg_free(cfg);
+  app_shutdown();
+}
+
+TestSuite(simple_function, .init = setup, .fini = teardown);
@@ -853,3 +853,210 @@ Test(template, test_bytes_and_protobuf_types_are_rendered_when_necessary)
   log_msg_unref(msg);
   g_string_free(formatted_value, TRUE);
 }
+
+Test(template, test_typed_evaluation_of_trivial_templates_points_into_the_message)
+{
+  LogMessage *msg = create_sample_message();
+  GString *buffer = g_string_sized_new(64);
+  LogTemplateTypedValue value;
+
+  cfg_set_version_without_validation(configuration, VERSION_VALUE_4_0);
+
+  LogTemplate *template = compile_template("${number1}");
+  log_template_eval_typed(template, msg, &DEFAULT_TEMPLATE_EVAL_OPTIONS, buffer, &value);
+  cr_assert_eq(value.str, log_msg_get_value_by_name(msg, "number1", NULL));
+  cr_assert_eq(value.str_len, 3);
+  cr_assert_eq(value.type, LM_VT_INTEGER);
+  cr_assert_eq(gn_as_int64(&value.as.number), 123);
+  cr_assert_eq(buffer->len, 0);
+  log_template_unref(template);
+
+  template = compile_template("literal");
+  log_template_eval_typed(template, msg, &DEFAULT_TEMPLATE_EVAL_OPTIONS, buffer, &value);
+  cr_assert_str_eq(value.str, "literal");
+  cr_assert_eq(value.type, LM_VT_STRING);
+  cr_assert_eq(buffer->len, 0);
+  log_template_unref(template);
+
+  /* indirect values are not NUL terminated, so they are copied */
+  log_msg_set_value_indirect(msg, log_msg_get_value_handle("indirect"), LM_V_HOST, 1, 3);
+  template = compile_template("$indirect");
+  log_template_eval_typed(template, msg, &DEFAULT_TEMPLATE_EVAL_OPTIONS, buffer, &value);
+  cr_assert_str_eq(value.str, "zor");
+  cr_assert_eq(value.str, buffer->str);
+  log_template_unref(template);
+
+  g_string_free(buffer, TRUE);
+  log_msg_unref(msg);
+}
+
+Test(template, test_typed_evaluation_keeps_the_default_of_trivial_templates)
+{
+  LogMessage *msg = create_sample_message();
+  GString *buffer = g_string_sized_new(64);
+  LogTemplateTypedValue value;
+
+  LogTemplate *template = compile_template("${nonexistent:-fallback}");
+  log_template_eval_typed(template, msg, &DEFAULT_TEMPLATE_EVAL_OPTIONS, buffer, &value);
+  cr_assert_eq(value.str_len, 8);
+  cr_assert_eq(memcmp(value.str, "fallback", 8), 0);
+  log_template_unref(template);
+
+  template = compile_template("${HOST:-fallback}");
+  log_template_eval_typed(template, msg, &DEFAULT_TEMPLATE_EVAL_OPTIONS, buffer, &value);
+  cr_assert_eq(value.str_len, 5);
+  cr_assert_eq(memcmp(value.str, "bzorp", 5), 0);
+  log_template_unref(template);
+
+  g_string_free(buffer, TRUE);
+  log_msg_unref(msg);
+}
+
+Test(template, test_typed_evaluation_parses_numbers_and_booleans)
+{
+  LogMessage *msg = create_sample_message();
+  GString *buffer = g_string_sized_new(64);
+  LogTemplateTypedValue value;
+  GenericNumber number;
+
+  cfg_set_version_without_validation(configuration, VERSION_VALUE_4_0);
+
+  LogTemplate *template = compile_template("$(+ ${number1} ${number2})");
+  log_template_eval_typed(template, msg, &DEFAULT_TEMPLATE_EVAL_OPTIONS, buffer, &value);
+  cr_assert_str_eq(value.str, "579");
+  cr_assert_eq(value.str, buffer->str);
+  cr_assert_eq(value.type, LM_VT_INTEGER);
+  cr_assert_eq(gn_as_int64(&value.as.number), 579);
+  cr_assert(log_template_typed_value_as_number(&value, &number));
+  cr_assert_eq(gn_as_int64(&number), 579);
+  log_template_unref(template);
+
+  template = log_template_new(configuration, NULL);
+  cr_assert(log_template_compile_with_type_hint(template, "boolean(true)", NULL));
+  log_template_eval_typed(template, msg, &DEFAULT_TEMPLATE_EVAL_OPTIONS, buffer, &value);
+  cr_assert_eq(value.type, LM_VT_BOOLEAN);
+  cr_assert(value.as.boolean);
+  cr_assert_not(log_template_typed_value_as_number(&value, &number));
+  log_template_unref(template);
+
+  template = compile_template("${APP.VALUE}");
+  log_template_eval_typed(template, msg, &DEFAULT_TEMPLATE_EVAL_OPTIONS, buffer, &value);
+  cr_assert_eq(value.type, LM_VT_STRING);
+  cr_assert_not(log_template_typed_value_as_number(&value, &number));
+  log_template_unref(template);
+
+  g_string_free(buffer, TRUE);
+  log_msg_unref(msg);
+}
+
+Test(template, test_typed_evaluation_uses_numbers_stored_in_binary_form)
+{
+  LogMessage *msg = create_sample_message();
+  GString *buffer = g_string_sized_new(64);
+  LogTemplateTypedValue value;
+
+  cfg_set_version_without_validation(configuration, VERSION_VALUE_4_0);
+
+  /* the stored number deliberately differs from the string to show the
+   * string is not parsed */
+  log_msg_set_value_with_number(msg, log_msg_get_value_handle("binint"), "10", -1, LM_VT_INTEGER,
+                                &(NVNumericValue) { .as_int64 = 11 });
+  log_msg_set_value_with_number(msg, log_msg_get_value_handle("bindouble"), "1.5", -1, LM_VT_DOUBLE,
+                                &(NVNumericValue) { .as_double = 2.5 });
+  log_msg_set_value_with_number(msg, log_msg_get_value_handle("binbool"), "false", -1, LM_VT_BOOLEAN,
+                                &(NVNumericValue) { .as_int64 = 1 });
+
+  LogTemplate *template = compile_template("$binint");
+  log_template_eval_typed(template, msg, &DEFAULT_TEMPLATE_EVAL_OPTIONS, buffer, &value);
+  cr_assert_str_eq(value.str, "10");
+  cr_assert_eq(value.type, LM_VT_INTEGER);
+  cr_assert_eq(gn_as_int64(&value.as.number), 11);
+  log_template_unref(template);
+
+  template = compile_template("$bindouble");
+  log_template_eval_typed(template, msg, &DEFAULT_TEMPLATE_EVAL_OPTIONS, buffer, &value);
+  cr_assert_eq(value.type, LM_VT_DOUBLE);
+  cr_assert_float_eq(gn_as_double(&value.as.number), 2.5, 1e-9);
+  log_template_unref(template);
+
+  template = compile_template("$binbool");
+  log_template_eval_typed(template, msg, &DEFAULT_TEMPLATE_EVAL_OPTIONS, buffer, &value);
+  cr_assert_eq(value.type, LM_VT_BOOLEAN);
+  cr_assert(value.as.boolean);
+  log_template_unref(template);
+
+  /* a type-hint that changes the type makes the string authoritative */
+  template = log_template_new(configuration, NULL);
+  cr_assert(log_template_compile_with_type_hint(template, "double($binint)", NULL));
+  log_template_eval_typed(template, msg, &DEFAULT_TEMPLATE_EVAL_OPTIONS, buffer, &value);
+  cr_assert_eq(value.type, LM_VT_DOUBLE);
+  cr_assert_eq(gn_as_int64(&value.as.number), 10);
+  log_template_unref(template);
+
+  /* setting the value again without a number drops the stored one */
+  log_msg_set_value_with_type(msg, log_msg_get_value_handle("binint"), "12", -1, LM_VT_INTEGER);
+  template = compile_template("$binint");
+  log_template_eval_typed(template, msg, &DEFAULT_TEMPLATE_EVAL_OPTIONS, buffer, &value);
+  cr_assert_eq(gn_as_int64(&value.as.number), 12);
+  log_template_unref(template);
+
+  g_string_free(buffer, TRUE);
+  log_msg_unref(msg);
+}
+
+static void
+assert_template_format_batch(const gchar *template_code, LogMessage **msgs, const gint32 *seq_nums, gint num_msgs,
+                             const gchar **expected)
+{
+  LogTemplate *template = compile_template(template_code);
+  GString *result = g_string_new("prefix");
+  gsize offsets[num_msgs + 1];
+
+  log_template_append_format_batch(template, msgs, seq_nums, num_msgs, &DEFAULT_TEMPLATE_EVAL_OPTIONS, result,
+                                   offsets);
+  cr_assert_eq(offsets[0], strlen("prefix"), "template: %s", template_code);
+  for (gint i = 0; i < num_msgs; i++)
+    {
+      gsize len = offsets[i + 1] - offsets[i];
+
+      cr_assert_eq(len, strlen(expected[i]), "template: %s, message %d", template_code, i);
+      cr_assert_eq(memcmp(result->str + offsets[i], expected[i], len), 0, "template: %s, message %d",
+                   template_code, i);
+    }
+  cr_assert_eq(offsets[num_msgs], result->len);
+
+  log_template_format_batch(template, msgs, seq_nums, num_msgs, &DEFAULT_TEMPLATE_EVAL_OPTIONS, result, offsets);
+  cr_assert_eq(offsets[0], 0, "template: %s", template_code);
+  cr_assert_eq(offsets[num_msgs], result->len);
+
+  g_string_free(result, TRUE);
+  log_template_unref(template);
+}
+
+Test(template, test_format_batch_renders_each_message_separately)
+{
+  LogMessage *msgs[3];
+  const gint32 seq_nums[3] = { 10, 11, 15 };
+
+  for (gint i = 0; i < G_N_ELEMENTS(msgs); i++)
+    {
+      gchar value[16];
+
+      msgs[i] = create_sample_message();
+      g_snprintf(value, sizeof(value), "value%d", i);
+      log_msg_set_value_by_name(msgs[i], "batch", value, -1);
+    }
+  log_msg_unset_value_by_name(msgs[1], "batch");
+
+  assert_template_format_batch("${batch}", msgs, NULL, 3, (const gchar *[]) { "value0", "", "value2" });
+  assert_template_format_batch("${batch:-default}", msgs, NULL, 3, (const gchar *[]) { "value0", "default", "value2" });
+  assert_template_format_batch("literal", msgs, NULL, 3, (const gchar *[]) { "literal", "literal", "literal" });
+  assert_template_format_batch("$HOST: ${batch}", msgs, NULL, 3,
+                               (const gchar *[]) { "bzorp: value0", "bzorp: ", "bzorp: value2" });
+  assert_template_format_batch("", msgs, NULL, 3, (const gchar *[]) { "", "", "" });
+  assert_template_format_batch("$SEQNUM ${batch}", msgs, seq_nums, 3,
+                               (const gchar *[]) { "10 value0", "11 ", "15 value2" });
+
+  for (gint i = 0; i < G_N_ELEMENTS(msgs); i++)
+    log_msg_unref(msgs[i]);
+}
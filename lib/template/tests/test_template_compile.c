@@ -377,6 +377,47 @@ Test(template_compile, test_unknown_function)
                            type = LTE_MACRO, msg_ref = 0);
 }
 
+static void
+assert_program_literal(const LogTemplateOp *op, const gchar *expected)
+{
+  cr_assert_eq(op->type, LTO_LITERAL);
+  cr_assert_eq(op->literal.text_len, strlen(expected));
+  cr_assert(strncmp(op->literal.text, expected, op->literal.text_len) == 0,
+            "Bad literal in program: %.*s, expected: %s", (gint) op->literal.text_len, op->literal.text, expected);
+}
+
+Test(template_compile, test_program_is_flattened_from_the_compiled_elements)
+{
+  assert_template_compile("foo $MSG bar${HOST:-default}@1$(hello) baz");
+
+  LogTemplateProgram *program = template->program;
+  cr_assert_not_null(program);
+  cr_assert_eq(program->num_ops, 6);
+
+  assert_program_literal(&program->ops[0], "foo ");
+  cr_assert_eq(program->ops[1].type, LTO_MACRO);
+  cr_assert_eq(program->ops[1].macro.id, M_MESSAGE);
+  assert_program_literal(&program->ops[2], " bar");
+  cr_assert_eq(program->ops[3].type, LTO_MACRO);
+  cr_assert_eq(program->ops[3].macro.id, M_HOST);
+  cr_assert_str_eq(program->ops[3].macro.default_value, "default");
+  cr_assert_eq(program->ops[3].msg_ref, 2);
+  cr_assert_eq(program->ops[4].type, LTO_FUNC);
+  cr_assert_eq(program->ops[4].func->type, LTE_FUNC);
+  /* the trailing literal becomes a plain literal, without an element after it */
+  assert_program_literal(&program->ops[5], " baz");
+}
+
+Test(template_compile, test_program_of_empty_and_literal_templates)
+{
+  cr_assert(log_template_compile(template, "", NULL));
+  cr_assert_null(template->program);
+
+  log_template_compile_literal_string(template, "literal");
+  cr_assert_eq(template->program->num_ops, 1);
+  assert_program_literal(&template->program->ops[0], "literal");
+}
+
 static void
 setup(void)
 {
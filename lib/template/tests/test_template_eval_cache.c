@@ -0,0 +1,192 @@
+/*
+ * Copyright (c) 2024 One Identity LLC.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#include <criterion/criterion.h>
+
+#include "template/eval-cache.h"
+#include "template/templates.h"
+#include "template/simple-function.h"
+#include "logmsg/logmsg.h"
+#include "logpipe.h"
+#include "apphook.h"
+#include "cfg.h"
+#include "plugin.h"
+
+static gint num_calls;
+
+static void
+count_calls(LogMessage *msg, gint argc, GString *argv[], GString *result, LogMessageValueType *type)
+{
+  num_calls++;
+  g_string_append_printf(result, "%d", num_calls);
+  *type = LM_VT_STRING;
+}
+
+TEMPLATE_FUNCTION_SIMPLE(count_calls);
+Plugin count_calls_plugin = TEMPLATE_FUNCTION_PLUGIN(count_calls, "count-calls");
+
+static GlobalConfig *cfg;
+
+static LogTemplate *
+_compile_template(const gchar *template_str, gboolean cache_results)
+{
+  LogTemplate *template = log_template_new(cfg, NULL);
+
+  cr_assert(log_template_compile(template, template_str, NULL));
+  log_template_set_cache_results(template, cache_results);
+  return template;
+}
+
+static void
+assert_template_format(LogTemplate *template, LogMessage *msg, LogTemplateEvalOptions *options,
+                       const gchar *expected)
+{
+  GString *result = g_string_new("prefix:");
+
+  log_template_append_format(template, msg, options, result);
+  cr_assert_str_eq(result->str + strlen("prefix:"), expected);
+  g_string_free(result, TRUE);
+}
+
+static LogMessage *
+_create_write_protected_message(void)
+{
+  LogMessage *msg = log_msg_new_empty();
+
+  log_msg_set_value(msg, LM_V_MESSAGE, "message", -1);
+  log_msg_write_protect(msg);
+  return msg;
+}
+
+Test(template_eval_cache, test_results_are_reused_for_write_protected_messages)
+{
+  LogTemplate *template = _compile_template("$MSG $(count-calls)", TRUE);
+  LogMessage *msg = _create_write_protected_message();
+  LogTemplateEvalOptions options = DEFAULT_TEMPLATE_EVAL_OPTIONS;
+
+  assert_template_format(template, msg, &options, "message 1");
+  assert_template_format(template, msg, &options, "message 1");
+  cr_assert_eq(num_calls, 1);
+
+  /* a clone starts with an empty cache */
+  LogPathOptions path_options = LOG_PATH_OPTIONS_INIT;
+  LogMessage *clone = log_msg_clone_cow(msg, &path_options);
+
+  assert_template_format(template, clone, &options, "message 2");
+  log_msg_write_protect(clone);
+  assert_template_format(template, clone, &options, "message 3");
+  assert_template_format(template, clone, &options, "message 3");
+  cr_assert_eq(num_calls, 3);
+
+  log_msg_unref(clone);
+  log_msg_unref(msg);
+  log_template_unref(template);
+}
+
+Test(template_eval_cache, test_results_are_keyed_by_template_and_eval_options)
+{
+  LogTemplate *template = _compile_template("$(count-calls)", TRUE);
+  LogTemplate *other_template = _compile_template("$(count-calls)", TRUE);
+  LogMessage *msg = _create_write_protected_message();
+  LogTemplateEvalOptions options = DEFAULT_TEMPLATE_EVAL_OPTIONS;
+  LogTemplateEvalOptions other_options = DEFAULT_TEMPLATE_EVAL_OPTIONS;
+
+  other_options.seq_num = 5;
+
+  assert_template_format(template, msg, &options, "1");
+  assert_template_format(other_template, msg, &options, "2");
+  assert_template_format(template, msg, &other_options, "3");
+
+  assert_template_format(template, msg, &options, "1");
+  assert_template_format(other_template, msg, &options, "2");
+  assert_template_format(template, msg, &other_options, "3");
+  cr_assert_eq(num_calls, 3);
+
+  log_msg_unref(msg);
+  log_template_unref(other_template);
+  log_template_unref(template);
+}
+
+Test(template_eval_cache, test_nothing_is_cached_unless_enabled_and_write_protected)
+{
+  LogTemplate *template = _compile_template("$(count-calls)", FALSE);
+  LogTemplate *cached_template = _compile_template("$(count-calls)", TRUE);
+  LogMessage *msg = _create_write_protected_message();
+  LogMessage *writable_msg = log_msg_new_empty();
+  LogTemplateEvalOptions options = DEFAULT_TEMPLATE_EVAL_OPTIONS;
+
+  assert_template_format(template, msg, &options, "1");
+  assert_template_format(template, msg, &options, "2");
+  assert_template_format(cached_template, writable_msg, &options, "3");
+  assert_template_format(cached_template, writable_msg, &options, "4");
+  cr_assert_null(msg->template_cache);
+  cr_assert_null(writable_msg->template_cache);
+
+  log_msg_unref(writable_msg);
+  log_msg_unref(msg);
+  log_template_unref(cached_template);
+  log_template_unref(template);
+}
+
+Test(template_eval_cache, test_results_are_not_cached_once_the_table_is_full)
+{
+  LogTemplate *templates[LOG_TEMPLATE_EVAL_CACHE_SIZE + 1];
+  LogMessage *msg = _create_write_protected_message();
+  LogTemplateEvalOptions options = DEFAULT_TEMPLATE_EVAL_OPTIONS;
+
+  for (gint i = 0; i < G_N_ELEMENTS(templates); i++)
+    {
+      templates[i] = _compile_template("$(count-calls)", TRUE);
+      assert_template_format(templates[i], msg, &options, (gchar[]) {'1' + i, 0});
+    }
+
+  /* all but the last one fit into the cache */
+  for (gint i = 0; i < LOG_TEMPLATE_EVAL_CACHE_SIZE; i++)
+    assert_template_format(templates[i], msg, &options, (gchar[]) {'1' + i, 0});
+  assert_template_format(templates[LOG_TEMPLATE_EVAL_CACHE_SIZE], msg, &options, "6");
+  cr_assert_eq(num_calls, LOG_TEMPLATE_EVAL_CACHE_SIZE + 2);
+
+  log_msg_unref(msg);
+  for (gint i = 0; i < G_N_ELEMENTS(templates); i++)
+    log_template_unref(templates[i]);
+}
+
+static void
+setup(void)
+{
+  app_startup();
+  app_running();
+
+  cfg = cfg_new_snippet();
+  plugin_register(&cfg->plugin_context, &count_calls_plugin, 1);
+  num_calls = 0;
+}
+
+static void
+teardown(void)
+{
+  cfg_free(cfg);
+  app_shutdown();
+}
+
+TestSuite(template_eval_cache, .init = setup, .fini = teardown);
@@ -239,3 +239,24 @@ Test(dnscache, test_lru_lists)
   _fill_dns_cache(cache, cache_size);
   dns_cache_free(cache);
 }
+
+Test(dnscache, test_shared_cache_tracks_pending_resolves)
+{
+  guint32 ni = htonl(0x0a000001);
+  const gchar *hn;
+  gsize hn_len;
+  gboolean positive, refresh_needed;
+
+  cr_assert_not(dns_caching_lookup(AF_INET, (void *) &ni, &hn, &hn_len, &positive, &refresh_needed));
+  cr_assert(dns_caching_begin_resolve(AF_INET, (void *) &ni));
+  cr_assert_not(dns_caching_begin_resolve(AF_INET, (void *) &ni), "the address should only be resolved once");
+
+  dns_caching_store(AF_INET, (void *) &ni, "host.example.com", TRUE);
+  cr_assert(dns_caching_lookup(AF_INET, (void *) &ni, &hn, &hn_len, &positive, &refresh_needed));
+  cr_assert_str_eq(hn, "host.example.com");
+  cr_assert_eq(hn_len, strlen("host.example.com"));
+  cr_assert(positive);
+  cr_assert_not(refresh_needed, "a freshly resolved entry should not be refreshed");
+
+  cr_assert(dns_caching_begin_resolve(AF_INET, (void *) &ni), "storing the result should clear the pending state");
+}
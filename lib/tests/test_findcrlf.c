@@ -26,6 +26,7 @@
 #include "find-crlf.h"
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 struct findcrlf_params
 {
@@ -165,3 +166,70 @@ ParameterizedTest(struct findcrlf_params *params, findcrlf, test)
                 "EOM is at wrong location. msg=%s, eom_ofs=%d, eom=%s\n",
                 params->msg, (gint) params->eom_ofs, eom);
 }
+
+static const gchar *implementations[] = { "avx2", "sse2", "neon", "scalar" };
+
+static const gchar *
+_find_first_of_reference(const gchar *s, gsize n, const gchar *chars, gsize chars_len)
+{
+  for (gsize i = 0; i < n; i++)
+    {
+      if (memchr(chars, s[i], chars_len))
+        return s + i;
+    }
+  return NULL;
+}
+
+static void
+_assert_all_positions_found(const gchar *chars, gsize chars_len)
+{
+  gchar buffer[256 + 64];
+
+  for (gsize len = 0; len < 256; len++)
+    {
+      for (gsize ofs = 0; ofs < 64; ofs += 7)
+        {
+          gchar *s = buffer + ofs;
+
+          memset(buffer, 'x', sizeof(buffer));
+          cr_assert_null(find_first_of(s, len, chars, chars_len));
+
+          for (gsize pos = 0; pos < len; pos++)
+            {
+              s[pos] = chars[pos % chars_len];
+              cr_assert_eq(find_first_of(s, len, chars, chars_len), _find_first_of_reference(s, len, chars, chars_len),
+                           "implementation=%s, len=%d, ofs=%d, pos=%d", find_crlf_get_implementation(),
+                           (gint) len, (gint) ofs, (gint) pos);
+              s[pos] = 'x';
+            }
+        }
+    }
+}
+
+Test(findcrlf, test_all_implementations)
+{
+  const gchar *original = find_crlf_get_implementation();
+
+  for (gint i = 0; i < G_N_ELEMENTS(implementations); i++)
+    {
+      if (!find_crlf_set_implementation(implementations[i]))
+        continue;
+
+      gchar msg[] = "0123456789abcdefghijklmnopqrstuvwxyz0123456789\r\n";
+      cr_assert_eq(find_cr_or_lf_or_nul(msg, sizeof(msg) - 1), msg + 46);
+      cr_assert_eq(find_lf_or_nul((guchar *) msg, sizeof(msg) - 1), (guchar *) msg + 47);
+
+      _assert_all_positions_found("\n", 1);
+      _assert_all_positions_found("\r\n", 2);
+      _assert_all_positions_found("\r\n\0", 3);
+      _assert_all_positions_found("\xff" "a;", 3);
+      _assert_all_positions_found("\t ,;|", 5);
+    }
+
+  cr_assert(find_crlf_set_implementation(original));
+}
+
+Test(findcrlf, test_unknown_implementation_is_rejected)
+{
+  cr_assert_not(find_crlf_set_implementation("mmx"));
+}
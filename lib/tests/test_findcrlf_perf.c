@@ -0,0 +1,96 @@
+/*
+ * Copyright (c) 2024 One Identity LLC.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#include <criterion/criterion.h>
+
+#include "find-crlf.h"
+
+#include <stdio.h>
+#include <string.h>
+
+/*
+ * Microbenchmark of the line splitting implementations: a buffer full of
+ * newline terminated lines is split the same way LogProtoTextServer does,
+ * once with short (typical syslog) lines and once with long ones.
+ */
+
+#define BUFFER_SIZE (4 * 1024 * 1024)
+#define ITERATIONS 16
+
+static const gchar *implementations[] = { "scalar", "sse2", "neon", "avx2" };
+
+static gchar *
+_generate_lines(gsize line_length)
+{
+  gchar *buffer = g_malloc(BUFFER_SIZE);
+
+  for (gsize i = 0; i < BUFFER_SIZE; i++)
+    buffer[i] = ((i + 1) % line_length) == 0 ? '\n' : 'a' + (i % 26);
+  return buffer;
+}
+
+static gsize
+_split_lines(const gchar *buffer)
+{
+  const guchar *p = (const guchar *) buffer;
+  const guchar *end = p + BUFFER_SIZE;
+  gsize lines = 0;
+
+  while ((p = find_lf_or_nul(p, end - p)))
+    {
+      lines++;
+      p++;
+    }
+  return lines;
+}
+
+static void
+_run_benchmark(gsize line_length)
+{
+  gchar *buffer = _generate_lines(line_length);
+
+  for (gint i = 0; i < G_N_ELEMENTS(implementations); i++)
+    {
+      if (!find_crlf_set_implementation(implementations[i]))
+        continue;
+
+      gint64 start = g_get_monotonic_time();
+      for (gint j = 0; j < ITERATIONS; j++)
+        cr_assert_eq(_split_lines(buffer), BUFFER_SIZE / line_length);
+      gint64 end = g_get_monotonic_time();
+
+      printf("      %-8s %5" G_GSIZE_FORMAT " byte lines, speed: %12.3f MB/sec\n", implementations[i], line_length,
+             (gdouble) BUFFER_SIZE * ITERATIONS / (end - start));
+    }
+  g_free(buffer);
+}
+
+Test(findcrlf_perf, short_lines)
+{
+  _run_benchmark(100);
+}
+
+Test(findcrlf_perf, long_lines)
+{
+  _run_benchmark(4096);
+}
@@ -0,0 +1,192 @@
+/*
+ * Copyright (c) 2024 One Identity LLC.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#include <criterion/criterion.h>
+
+#include "libtest/mock-logpipe.h"
+#include "logdispatch.h"
+#include "logmsg/logmsg.h"
+#include "apphook.h"
+#include "cfg.h"
+
+static GlobalConfig *cfg;
+
+static GPtrArray *
+_keys(const gchar *first_key, ...)
+{
+  GPtrArray *keys = g_ptr_array_new_with_free_func(g_free);
+  va_list va;
+
+  va_start(va, first_key);
+  for (const gchar *key = first_key; key; key = va_arg(va, const gchar *))
+    g_ptr_array_add(keys, g_strdup(key));
+  va_end(va);
+  return keys;
+}
+
+static LogPipeMock *
+_add_branch(LogDispatcher *dispatcher, GPtrArray *keys)
+{
+  LogPipeMock *branch = log_pipe_mock_new(cfg);
+
+  log_dispatcher_add_branch(dispatcher, &branch->super, keys);
+  if (keys)
+    g_ptr_array_unref(keys);
+  return branch;
+}
+
+static gboolean
+_queue_with_program(LogDispatcher *dispatcher, const gchar *program)
+{
+  LogMessage *msg = log_msg_new_empty();
+  LogPathOptions path_options = LOG_PATH_OPTIONS_INIT;
+  gboolean matched = TRUE;
+
+  path_options.matched = &matched;
+  log_msg_set_value(msg, LM_V_PROGRAM, program, -1);
+  log_pipe_queue(&dispatcher->super, msg, &path_options);
+  return matched;
+}
+
+static void
+_dropping_queue(LogPipe *s, LogMessage *msg, const LogPathOptions *path_options)
+{
+  *path_options->matched = FALSE;
+  log_msg_drop(msg, path_options, AT_PROCESSED);
+}
+
+Test(logdispatch, messages_are_routed_to_the_branch_of_their_value)
+{
+  LogDispatcher *dispatcher = log_dispatcher_new(cfg, LM_V_PROGRAM);
+  LogPipeMock *sshd = _add_branch(dispatcher, _keys("sshd", NULL));
+  LogPipeMock *cron = _add_branch(dispatcher, _keys("cron", "crond", "sshd", NULL));
+  LogPipeMock *others = log_pipe_mock_new(cfg);
+
+  log_dispatcher_set_default_branch(dispatcher, &others->super);
+  cr_assert(log_pipe_init(&dispatcher->super));
+
+  cr_assert(_queue_with_program(dispatcher, "sshd"));
+  cr_assert(_queue_with_program(dispatcher, "crond"));
+  cr_assert(_queue_with_program(dispatcher, "cron"));
+  cr_assert(_queue_with_program(dispatcher, "cro"));
+  cr_assert(_queue_with_program(dispatcher, ""));
+
+  /* the first branch wins if a key is listed more than once */
+  cr_assert_eq(sshd->captured_messages->len, 1);
+  cr_assert_eq(cron->captured_messages->len, 2);
+  cr_assert_eq(others->captured_messages->len, 2);
+  cr_assert_str_eq(log_msg_get_value(log_pipe_mock_get_message(others, 0), LM_V_PROGRAM, NULL), "cro");
+
+  log_pipe_deinit(&dispatcher->super);
+  log_pipe_unref(&dispatcher->super);
+  log_pipe_unref(&sshd->super);
+  log_pipe_unref(&cron->super);
+  log_pipe_unref(&others->super);
+}
+
+Test(logdispatch, dropping_the_message_in_the_default_branch_is_propagated)
+{
+  LogDispatcher *dispatcher = log_dispatcher_new(cfg, LM_V_PROGRAM);
+  LogPipeMock *sshd = _add_branch(dispatcher, _keys("sshd", NULL));
+  LogPipe *dropping = log_pipe_new(cfg);
+
+  dropping->queue = _dropping_queue;
+  log_dispatcher_set_default_branch(dispatcher, dropping);
+  cr_assert(log_pipe_init(&dispatcher->super));
+
+  cr_assert(_queue_with_program(dispatcher, "sshd"));
+  cr_assert_not(_queue_with_program(dispatcher, "httpd"));
+  cr_assert_eq(sshd->captured_messages->len, 1);
+
+  log_pipe_deinit(&dispatcher->super);
+  log_pipe_unref(&dispatcher->super);
+  log_pipe_unref(&sshd->super);
+  log_pipe_unref(dropping);
+}
+
+static void
+_add_matcher(LogMultiMatcher *multi_matcher, gint branch, const gchar *type, const gchar *pattern)
+{
+  LogMatcherOptions options;
+
+  log_matcher_options_defaults(&options);
+  cr_assert(log_matcher_options_set_type(&options, type));
+
+  LogMatcher *matcher = log_matcher_new(&options);
+  cr_assert(log_matcher_compile(matcher, pattern, NULL));
+  log_multi_matcher_add(multi_matcher, matcher, branch);
+  log_matcher_unref(matcher);
+  log_matcher_options_destroy(&options);
+}
+
+Test(logdispatch, messages_are_routed_to_the_first_branch_with_a_matching_pattern)
+{
+  LogDispatcher *dispatcher = log_dispatcher_new(cfg, LM_V_PROGRAM);
+  LogMultiMatcher *multi_matcher = log_multi_matcher_new();
+
+  _add_matcher(multi_matcher, 0, "pcre", "^ssh");
+  _add_matcher(multi_matcher, 1, "pcre", "cron");
+  _add_matcher(multi_matcher, 1, "string", "atd");
+  log_multi_matcher_compile(multi_matcher);
+  log_dispatcher_set_matcher(dispatcher, multi_matcher);
+
+  LogPipeMock *ssh = _add_branch(dispatcher, NULL);
+  LogPipeMock *cron = _add_branch(dispatcher, NULL);
+  LogPipeMock *others = log_pipe_mock_new(cfg);
+
+  log_dispatcher_set_default_branch(dispatcher, &others->super);
+  cr_assert(log_pipe_init(&dispatcher->super));
+
+  cr_assert(_queue_with_program(dispatcher, "sshd"));
+  cr_assert(_queue_with_program(dispatcher, "sshcron"));
+  cr_assert(_queue_with_program(dispatcher, "anacron"));
+  cr_assert(_queue_with_program(dispatcher, "atd"));
+  cr_assert(_queue_with_program(dispatcher, "openssh"));
+
+  cr_assert_eq(ssh->captured_messages->len, 2);
+  cr_assert_eq(cron->captured_messages->len, 2);
+  cr_assert_eq(others->captured_messages->len, 1);
+  cr_assert_str_eq(log_msg_get_value(log_pipe_mock_get_message(others, 0), LM_V_PROGRAM, NULL), "openssh");
+
+  log_pipe_deinit(&dispatcher->super);
+  log_pipe_unref(&dispatcher->super);
+  log_pipe_unref(&ssh->super);
+  log_pipe_unref(&cron->super);
+  log_pipe_unref(&others->super);
+}
+
+static void
+setup(void)
+{
+  app_startup();
+  cfg = cfg_new_snippet();
+}
+
+static void
+teardown(void)
+{
+  cfg_free(cfg);
+  app_shutdown();
+}
+
+TestSuite(logdispatch, .init = setup, .fini = teardown);
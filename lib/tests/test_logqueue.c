@@ -28,6 +28,8 @@
 
 #include "logqueue.h"
 #include "logqueue-fifo.h"
+#include "logqueue-ring.h"
+#include "logqueue-priority.h"
 #include "logpipe.h"
 #include "apphook.h"
 #include "plugin.h"
@@ -429,3 +431,461 @@ Test(logqueue, log_queue_fifo_multiple_queues)
 
   stats_cluster_key_builder_free(driver_sck_builder);
 }
+
+static LogQueue *
+_construct_ring_queue(gint fifo_size)
+{
+  StatsClusterKeyBuilder *driver_sck_builder = stats_cluster_key_builder_new();
+  StatsClusterKeyBuilder *queue_sck_builder = stats_cluster_key_builder_new();
+  LogQueue *q = log_queue_ring_new(fifo_size, NULL, STATS_LEVEL0, driver_sck_builder, queue_sck_builder);
+  stats_cluster_key_builder_free(driver_sck_builder);
+  stats_cluster_key_builder_free(queue_sck_builder);
+
+  return q;
+}
+
+Test(logqueue, log_queue_ring_acks_and_memory_usage)
+{
+  LogQueue *q = _construct_ring_queue(OVERFLOW_SIZE);
+
+  fed_messages = 0;
+  acked_messages = 0;
+  feed_some_messages(q, 1);
+  cr_assert_eq(stats_counter_get(q->metrics.shared.queued_messages), 1);
+  gint size_when_single_msg = stats_counter_get(q->metrics.shared.memory_usage);
+  cr_assert_neq(size_when_single_msg, 0);
+
+  feed_some_messages(q, 99);
+  cr_assert_eq(log_queue_get_length(q), 100);
+  cr_assert_eq(stats_counter_get(q->metrics.shared.queued_messages), 100);
+  cr_assert_eq(stats_counter_get(q->metrics.shared.memory_usage), 100 * size_when_single_msg);
+
+  send_some_messages(q, 10, FALSE);
+  cr_assert_eq(stats_counter_get(q->metrics.shared.memory_usage), 90 * size_when_single_msg);
+  log_queue_rewind_backlog_all(q);
+  cr_assert_eq(log_queue_get_length(q), 100);
+  cr_assert_eq(stats_counter_get(q->metrics.shared.memory_usage), 100 * size_when_single_msg);
+
+  send_some_messages(q, fed_messages, TRUE);
+  cr_assert(log_queue_is_empty_racy(q));
+  cr_assert_eq(fed_messages, acked_messages,
+               "did not receive enough acknowledgements: fed_messages=%d, acked_messages=%d",
+               fed_messages, acked_messages);
+
+  log_queue_unref(q);
+}
+
+Test(logqueue, log_queue_ring_should_drop_only_non_flow_controlled_messages,
+     .description = "Flow-controlled messages should never be dropped")
+{
+  LogPathOptions flow_controlled_path = LOG_PATH_OPTIONS_INIT;
+  flow_controlled_path.flow_control_requested = TRUE;
+
+  LogPathOptions non_flow_controlled_path = LOG_PATH_OPTIONS_INIT;
+  non_flow_controlled_path.flow_control_requested = FALSE;
+
+  gint fifo_size = 5;
+  LogQueue *q = _construct_ring_queue(fifo_size);
+
+  fed_messages = 0;
+  acked_messages = 0;
+  feed_empty_messages(q, &flow_controlled_path, fifo_size);
+  feed_empty_messages(q, &non_flow_controlled_path, fifo_size);
+
+  feed_empty_messages(q, &non_flow_controlled_path, 1);
+  feed_empty_messages(q, &flow_controlled_path, fifo_size);
+  feed_empty_messages(q, &non_flow_controlled_path, 2);
+  feed_empty_messages(q, &flow_controlled_path, fifo_size);
+
+  cr_assert_eq(stats_counter_get(q->metrics.shared.dropped_messages), 3);
+
+  gint queued_messages = stats_counter_get(q->metrics.shared.queued_messages);
+  send_some_messages(q, queued_messages, TRUE);
+
+  cr_assert_eq(fed_messages, acked_messages,
+               "did not receive enough acknowledgements: fed_messages=%d, acked_messages=%d",
+               fed_messages, acked_messages);
+
+  log_queue_unref(q);
+}
+
+static void
+_feed_numbered_messages(LogQueue *q, gint from, gint to)
+{
+  LogPathOptions path_options = LOG_PATH_OPTIONS_INIT;
+  path_options.flow_control_requested = TRUE;
+
+  for (gint i = from; i < to; i++)
+    {
+      LogMessage *msg = log_msg_new_empty();
+      gchar seq[16];
+
+      g_snprintf(seq, sizeof(seq), "%d", i);
+      log_msg_set_value(msg, LM_V_MESSAGE, seq, -1);
+      log_queue_push_tail(q, msg, &path_options);
+    }
+}
+
+static void
+_assert_numbered_messages(LogQueue *q, gint from, gint to)
+{
+  LogPathOptions path_options = LOG_PATH_OPTIONS_INIT;
+
+  for (gint i = from; i < to; i++)
+    {
+      LogMessage *msg = log_queue_pop_head(q, &path_options);
+
+      cr_assert_not_null(msg, "Message %d is missing from the queue", i);
+      cr_assert_eq(atoi(log_msg_get_value(msg, LM_V_MESSAGE, NULL)), i, "Messages are out of order");
+      log_msg_unref(msg);
+    }
+}
+
+Test(logqueue, log_queue_ring_keeps_the_order_of_messages_when_the_ring_overflows)
+{
+  /* the ring has 64 slots, flow-controlled messages go to the overflow list */
+  LogQueue *q = _construct_ring_queue(1);
+
+  _feed_numbered_messages(q, 0, 200);
+  cr_assert_eq(log_queue_get_length(q), 200);
+
+  _assert_numbered_messages(q, 0, 50);
+
+  /* the overflow list is still in use, these must not overtake it */
+  _feed_numbered_messages(q, 200, 220);
+
+  log_queue_rewind_backlog(q, 10);
+  _assert_numbered_messages(q, 40, 220);
+
+  LogPathOptions path_options = LOG_PATH_OPTIONS_INIT;
+  cr_assert_null(log_queue_pop_head(q, &path_options));
+
+  log_queue_ack_backlog(q, 220);
+  cr_assert_not(log_queue_keep_on_reload(q));
+  log_queue_unref(q);
+}
+
+Test(logqueue, log_queue_ring_with_threads)
+{
+  LogQueue *q;
+  GThread *thread_feed[FEEDERS], *thread_consume;
+  GThread *other_threads[FEEDERS];
+  gint j;
+
+  main_loop_worker_allocate_thread_space(FEEDERS * 2);
+  main_loop_worker_finalize_thread_space();
+
+  q = log_queue_ring_new(MESSAGES_SUM, NULL, STATS_LEVEL0, NULL, NULL);
+  for (j = 0; j < FEEDERS; j++)
+    {
+      other_threads[j] = g_thread_new(NULL, _output_thread, NULL);
+      thread_feed[j] = g_thread_new(NULL, _threaded_feed, q);
+    }
+
+  thread_consume = g_thread_new(NULL, _threaded_consume, q);
+
+  for (j = 0; j < FEEDERS; j++)
+    {
+      g_thread_join(thread_feed[j]);
+      g_thread_join(other_threads[j]);
+    }
+  cr_assert_null(g_thread_join(thread_consume), "The consumer did not receive all messages");
+
+  log_queue_unref(q);
+}
+
+static void
+_assert_batch_push_and_pop(LogQueue *q)
+{
+  fed_messages = 0;
+  acked_messages = 0;
+  feed_some_messages(q, 1);
+  gint size_when_single_msg = stats_counter_get(q->metrics.shared.memory_usage);
+  send_some_messages(q, 1, TRUE);
+
+  feed_some_messages_in_batch(q, 100);
+  cr_assert_eq(log_queue_get_length(q), 100);
+  cr_assert_eq(stats_counter_get(q->metrics.shared.queued_messages), 100);
+  cr_assert_eq(stats_counter_get(q->metrics.shared.memory_usage), 100 * size_when_single_msg);
+
+  send_some_messages_in_batch(q, 30, 16, FALSE);
+  cr_assert_eq(stats_counter_get(q->metrics.shared.queued_messages), 70);
+  cr_assert_eq(stats_counter_get(q->metrics.shared.memory_usage), 70 * size_when_single_msg);
+
+  log_queue_rewind_backlog(q, 10);
+  cr_assert_eq(stats_counter_get(q->metrics.shared.queued_messages), 80);
+  log_queue_ack_backlog(q, 20);
+
+  send_some_messages_in_batch(q, 80, 64, TRUE);
+  cr_assert(log_queue_is_empty_racy(q));
+  cr_assert_eq(stats_counter_get(q->metrics.shared.queued_messages), 0);
+  cr_assert_eq(stats_counter_get(q->metrics.shared.memory_usage), 0);
+
+  LogMessage *msg;
+  LogPathOptions path_options = LOG_PATH_OPTIONS_INIT;
+  cr_assert_eq(log_queue_pop_head_batch(q, &msg, &path_options, 1), 0);
+
+  cr_assert_eq(fed_messages, acked_messages,
+               "did not receive enough acknowledgements: fed_messages=%d, acked_messages=%d",
+               fed_messages, acked_messages);
+}
+
+Test(logqueue, log_queue_fifo_batch_push_and_pop)
+{
+  StatsClusterKeyBuilder *driver_sck_builder = stats_cluster_key_builder_new();
+  StatsClusterKeyBuilder *queue_sck_builder = stats_cluster_key_builder_new();
+  LogQueue *q = log_queue_fifo_new(OVERFLOW_SIZE, NULL, STATS_LEVEL0, driver_sck_builder, queue_sck_builder);
+  stats_cluster_key_builder_free(driver_sck_builder);
+  stats_cluster_key_builder_free(queue_sck_builder);
+
+  _assert_batch_push_and_pop(q);
+
+  log_queue_unref(q);
+}
+
+Test(logqueue, log_queue_ring_batch_push_and_pop)
+{
+  LogQueue *q = _construct_ring_queue(OVERFLOW_SIZE);
+
+  _assert_batch_push_and_pop(q);
+
+  log_queue_unref(q);
+}
+
+Test(logqueue, log_queue_batch_pop_respects_throttle)
+{
+  LogQueue *q = log_queue_fifo_new(OVERFLOW_SIZE, NULL, STATS_LEVEL0, NULL, NULL);
+  LogMessage *msgs[10];
+  LogPathOptions path_options[10];
+
+  fed_messages = 0;
+  acked_messages = 0;
+  feed_some_messages_in_batch(q, 10);
+
+  log_queue_set_throttle(q, 4);
+  cr_assert_eq(log_queue_pop_head_batch(q, msgs, path_options, 10), 4);
+  cr_assert_eq(log_queue_pop_head_batch(q, &msgs[4], &path_options[4], 10), 0);
+  cr_assert_eq(log_queue_pop_head_batch_ignore_throttle(q, &msgs[4], &path_options[4], 10), 6);
+
+  for (gint i = 0; i < 10; i++)
+    {
+      log_msg_ack(msgs[i], &path_options[i], AT_PROCESSED);
+      log_msg_unref(msgs[i]);
+    }
+  log_queue_ack_backlog(q, 10);
+  cr_assert_eq(fed_messages, acked_messages);
+
+  log_queue_unref(q);
+}
+
+Test(logqueue, log_queue_refund_throttle_gives_back_the_buckets_of_rewound_messages)
+{
+  LogQueue *q = log_queue_fifo_new(OVERFLOW_SIZE, NULL, STATS_LEVEL0, NULL, NULL);
+  LogMessage *msgs[10];
+  LogPathOptions path_options[10];
+
+  fed_messages = 0;
+  acked_messages = 0;
+  feed_some_messages_in_batch(q, 10);
+
+  log_queue_set_throttle(q, 4);
+  cr_assert_eq(log_queue_pop_head_batch(q, msgs, path_options, 10), 4);
+
+  /* only the first message was sent, the rest of the batch is rewound */
+  log_queue_rewind_backlog(q, 3);
+  log_queue_refund_throttle(q, 3);
+  for (gint i = 1; i < 4; i++)
+    log_msg_unref(msgs[i]);
+  cr_assert_eq(q->throttle_buckets, 3);
+
+  cr_assert_eq(log_queue_pop_head_batch(q, &msgs[1], &path_options[1], 10), 3);
+
+  /* buckets are never refunded above the throttle */
+  log_queue_refund_throttle(q, 10);
+  cr_assert_eq(q->throttle_buckets, 4);
+
+  cr_assert_eq(log_queue_pop_head_batch(q, &msgs[4], &path_options[4], 10), 4);
+  cr_assert_eq(log_queue_pop_head_batch_ignore_throttle(q, &msgs[8], &path_options[8], 10), 2);
+
+  for (gint i = 0; i < 10; i++)
+    {
+      log_msg_ack(msgs[i], &path_options[i], AT_PROCESSED);
+      log_msg_unref(msgs[i]);
+    }
+  log_queue_ack_backlog(q, 10);
+  cr_assert_eq(fed_messages, acked_messages);
+
+  log_queue_unref(q);
+}
+
+Test(logqueue, log_queue_fifo_steal_tail_batch_moves_the_newest_messages)
+{
+  LogQueue *victim = log_queue_fifo_new(OVERFLOW_SIZE, NULL, STATS_LEVEL0, NULL, NULL);
+  LogQueue *thief = log_queue_fifo_new(OVERFLOW_SIZE, NULL, STATS_LEVEL0, NULL, NULL);
+  LogMessage *msgs[10];
+  LogPathOptions path_options[10];
+
+  fed_messages = 0;
+  acked_messages = 0;
+  for (gint i = 0; i < 10; i++)
+    {
+      path_options[i] = (LogPathOptions) LOG_PATH_OPTIONS_INIT;
+      path_options[i].ack_needed = TRUE;
+      path_options[i].flow_control_requested = TRUE;
+
+      gchar seq[2] = { '0' + i, 0 };
+
+      msgs[i] = log_msg_new_empty();
+      log_msg_set_value_by_name(msgs[i], "SEQ", seq, -1);
+      log_msg_add_ack(msgs[i], &path_options[i]);
+      msgs[i]->ack_func = test_ack;
+      fed_messages++;
+    }
+  log_queue_push_tail_batch(victim, msgs, path_options, 10);
+
+  /* messages in the backlog are never stolen */
+  send_some_messages_in_batch(victim, 2, 2, FALSE);
+
+  cr_assert_eq(log_queue_steal_tail_batch(victim, msgs, path_options, 0), 0);
+  cr_assert_eq(log_queue_steal_tail_batch(victim, msgs, path_options, 4), 4);
+  cr_assert_eq(log_queue_get_length(victim), 4);
+
+  for (gint i = 0; i < 4; i++)
+    {
+      gchar seq[2] = { '6' + i, 0 };
+
+      cr_assert(path_options[i].ack_needed);
+      cr_assert(path_options[i].flow_control_requested);
+      cr_assert_str_eq(log_msg_get_value_by_name(msgs[i], "SEQ", NULL), seq);
+    }
+
+  log_queue_push_tail_batch(thief, msgs, path_options, 4);
+  cr_assert_eq(log_queue_get_length(thief), 4);
+
+  send_some_messages_in_batch(thief, 4, 4, TRUE);
+  send_some_messages_in_batch(victim, 4, 4, FALSE);
+  log_queue_ack_backlog(victim, 6);
+
+  cr_assert(log_queue_is_empty_racy(victim));
+  cr_assert_eq(fed_messages, acked_messages,
+               "did not receive enough acknowledgements: fed_messages=%d, acked_messages=%d",
+               fed_messages, acked_messages);
+
+  log_queue_unref(thief);
+  log_queue_unref(victim);
+}
+
+Test(logqueue, log_queue_fifo_drops_non_flow_controlled_messages_over_the_global_memory_budget)
+{
+  LogPathOptions flow_controlled_path = LOG_PATH_OPTIONS_INIT;
+  flow_controlled_path.flow_control_requested = TRUE;
+
+  LogPathOptions non_flow_controlled_path = LOG_PATH_OPTIONS_INIT;
+  non_flow_controlled_path.flow_control_requested = FALSE;
+
+  LogQueue *queue_1 = log_queue_fifo_new(OVERFLOW_SIZE, NULL, STATS_LEVEL0, NULL, NULL);
+  LogQueue *queue_2 = log_queue_fifo_new(OVERFLOW_SIZE, NULL, STATS_LEVEL0, NULL, NULL);
+
+  fed_messages = 0;
+  acked_messages = 0;
+  feed_empty_messages(queue_1, &non_flow_controlled_path, 1);
+  gsize msg_size = log_queue_get_global_memory_usage();
+  cr_assert_gt(msg_size, 0);
+
+  log_queue_set_global_memory_budget(3 * msg_size);
+  feed_empty_messages(queue_1, &non_flow_controlled_path, 1);
+  feed_empty_messages(queue_2, &non_flow_controlled_path, 5);
+  cr_assert(log_queue_is_global_memory_budget_exhausted());
+  cr_assert_eq(log_queue_get_length(queue_1), 2);
+  cr_assert_eq(log_queue_get_length(queue_2), 1);
+
+  feed_empty_messages(queue_2, &flow_controlled_path, 2);
+  cr_assert_eq(log_queue_get_length(queue_2), 3);
+
+  send_some_messages(queue_2, 3, TRUE);
+  cr_assert_not(log_queue_is_global_memory_budget_exhausted());
+  feed_empty_messages(queue_1, &non_flow_controlled_path, 1);
+  cr_assert_eq(log_queue_get_length(queue_1), 3);
+
+  send_some_messages(queue_1, 3, TRUE);
+  cr_assert_eq(log_queue_get_global_memory_usage(), 0);
+  cr_assert_eq(fed_messages, acked_messages);
+
+  log_queue_unref(queue_1);
+  log_queue_unref(queue_2);
+  log_queue_set_global_memory_budget(0);
+}
+
+static void
+_feed_message_to_lane(LogQueue *q, const gchar *lane, gint seq)
+{
+  LogPathOptions path_options = LOG_PATH_OPTIONS_INIT;
+  LogMessage *msg = log_msg_new_empty();
+  gchar seq_str[16];
+
+  g_snprintf(seq_str, sizeof(seq_str), "%d", seq);
+  log_msg_set_value(msg, LM_V_HOST, lane, -1);
+  log_msg_set_value(msg, LM_V_MESSAGE, seq_str, -1);
+  log_queue_push_tail(q, msg, &path_options);
+}
+
+static void
+_assert_popped_sequence(LogQueue *q, const gint *expected, gint n)
+{
+  LogPathOptions path_options = LOG_PATH_OPTIONS_INIT;
+
+  for (gint i = 0; i < n; i++)
+    {
+      LogMessage *msg = log_queue_pop_head(q, &path_options);
+
+      cr_assert_not_null(msg, "Message %d is missing from the queue", expected[i]);
+      cr_assert_eq(atoi(log_msg_get_value(msg, LM_V_MESSAGE, NULL)), expected[i],
+                   "Unexpected message at position %d", i);
+      log_msg_unref(msg);
+    }
+}
+
+Test(logqueue, log_queue_priority_drains_lanes_with_weighted_round_robin)
+{
+  LogTemplate *lane_key = log_template_new(configuration, NULL);
+  cr_assert(log_template_compile(lane_key, "$HOST", NULL));
+
+  LogQueuePriorityLaneOptions *high = log_queue_priority_lane_options_new();
+  LogQueuePriorityLaneOptions *low = log_queue_priority_lane_options_new();
+  high->weight = 2;
+  GList *lanes = g_list_append(g_list_append(NULL, high), low);
+
+  LogQueue *q = log_queue_priority_new(lane_key, lanes, OVERFLOW_SIZE, NULL, STATS_LEVEL0, NULL, NULL);
+  log_template_unref(lane_key);
+  g_list_free_full(lanes, (GDestroyNotify) log_queue_priority_lane_options_free);
+
+  for (gint i = 0; i < 4; i++)
+    _feed_message_to_lane(q, "1", i);
+  for (gint i = 4; i < 8; i++)
+    _feed_message_to_lane(q, "0", i);
+  /* unknown lanes go to the last one */
+  _feed_message_to_lane(q, "bulk", 8);
+  cr_assert_eq(log_queue_get_length(q), 9);
+
+  const gint first_round[] = { 4, 5, 0 };
+  _assert_popped_sequence(q, first_round, G_N_ELEMENTS(first_round));
+
+  log_queue_rewind_backlog(q, 1);
+  const gint rest[] = { 6, 7, 0, 1, 2, 3, 8 };
+  _assert_popped_sequence(q, rest, G_N_ELEMENTS(rest));
+
+  LogPathOptions path_options = LOG_PATH_OPTIONS_INIT;
+  cr_assert_null(log_queue_pop_head(q, &path_options));
+
+  log_queue_rewind_backlog_all(q);
+  cr_assert_eq(log_queue_get_length(q), 9);
+
+  LogMessage *msg;
+  while ((msg = log_queue_pop_head(q, &path_options)))
+    log_msg_unref(msg);
+  log_queue_ack_backlog(q, 9);
+  cr_assert_eq(log_queue_get_length(q), 0);
+  cr_assert_not(log_queue_keep_on_reload(q));
+
+  log_queue_unref(q);
+}
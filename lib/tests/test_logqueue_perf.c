@@ -0,0 +1,137 @@
+/*
+ * Copyright (c) 2024 One Identity LLC.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#include <criterion/criterion.h>
+
+#include "logqueue.h"
+#include "logqueue-fifo.h"
+#include "logqueue-ring.h"
+#include "apphook.h"
+#include "mainloop-worker.h"
+
+#include <stdio.h>
+
+/*
+ * Microbenchmark of the memory queue implementations: a number of input
+ * threads feeding a single output thread, similarly to a lot of sources
+ * sending to a single file destination.
+ */
+
+#define FEEDERS 4
+#define MESSAGES_PER_FEEDER 250000
+#define MESSAGES_SUM (FEEDERS * MESSAGES_PER_FEEDER)
+#define FEED_BATCH 100
+#define ACK_BATCH 100
+
+typedef LogQueue *(*LogQueueConstructor)(gint log_fifo_size, const gchar *persist_name, gint stats_level,
+                                         StatsClusterKeyBuilder *driver_sck_builder,
+                                         StatsClusterKeyBuilder *queue_sck_builder);
+
+static gpointer
+_feed_thread(gpointer args)
+{
+  LogQueue *q = args;
+  LogPathOptions path_options = LOG_PATH_OPTIONS_INIT;
+  path_options.flow_control_requested = TRUE;
+
+  main_loop_worker_thread_start(MLW_ASYNC_WORKER);
+
+  LogMessage *tmpl = log_msg_new_empty();
+  for (gint i = 0; i < MESSAGES_PER_FEEDER; i++)
+    {
+      log_queue_push_tail(q, log_msg_clone_cow(tmpl, &path_options), &path_options);
+
+      if ((i % FEED_BATCH) == 0)
+        main_loop_worker_invoke_batch_callbacks();
+    }
+  main_loop_worker_invoke_batch_callbacks();
+  log_msg_unref(tmpl);
+
+  main_loop_worker_thread_stop();
+  return NULL;
+}
+
+static gpointer
+_consume_thread(gpointer args)
+{
+  LogQueue *q = args;
+  LogPathOptions path_options = LOG_PATH_OPTIONS_INIT;
+  gint msg_count = 0;
+
+  while (msg_count < MESSAGES_SUM)
+    {
+      LogMessage *msg = log_queue_pop_head(q, &path_options);
+
+      if (!msg)
+        {
+          g_thread_yield();
+          continue;
+        }
+
+      log_msg_unref(msg);
+      msg_count++;
+      if ((msg_count % ACK_BATCH) == 0)
+        log_queue_ack_backlog(q, ACK_BATCH);
+    }
+  return NULL;
+}
+
+static void
+_run_benchmark(const gchar *name, LogQueueConstructor construct)
+{
+  GThread *feeders[FEEDERS];
+
+  LogQueue *q = construct(MESSAGES_SUM, NULL, STATS_LEVEL0, NULL, NULL);
+
+  gint64 start = g_get_monotonic_time();
+  GThread *consumer = g_thread_new(NULL, _consume_thread, q);
+  for (gint i = 0; i < FEEDERS; i++)
+    feeders[i] = g_thread_new(NULL, _feed_thread, q);
+
+  for (gint i = 0; i < FEEDERS; i++)
+    g_thread_join(feeders[i]);
+  g_thread_join(consumer);
+  gint64 end = g_get_monotonic_time();
+
+  cr_assert_eq(log_queue_get_length(q), 0);
+  log_queue_unref(q);
+
+  printf("      %-8s %d feeders -> 1 consumer, speed: %12.3f msg/sec\n", name, FEEDERS,
+         MESSAGES_SUM * 1e6 / (end - start));
+}
+
+Test(logqueue_perf, fifo_vs_ring)
+{
+  _run_benchmark("fifo", log_queue_fifo_new);
+  _run_benchmark("ring", log_queue_ring_new);
+}
+
+static void
+setup(void)
+{
+  app_startup();
+  main_loop_worker_allocate_thread_space(FEEDERS);
+  main_loop_worker_finalize_thread_space();
+}
+
+TestSuite(logqueue_perf, .init = setup, .fini = app_shutdown);
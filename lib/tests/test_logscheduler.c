@@ -23,7 +23,9 @@
 #include <criterion/criterion.h>
 #include "libtest/cr_template.h"
 
-#include "logscheduler.h"
+#include "logscheduler.c"
+#include "mainloop.h"
+#include "mainloop-worker.h"
 #include "apphook.h"
 
 typedef struct TestPipe
@@ -31,6 +33,7 @@ typedef struct TestPipe
   LogPipe super;
   GMutex lock;
   GQueue *messages;
+  GQueue *threads;
   gsize messages_count;
 } TestPipe;
 
@@ -41,6 +44,7 @@ test_pipe_queue(LogPipe *s, LogMessage *msg, const LogPathOptions *path_options)
 
   g_mutex_lock(&self->lock);
   g_queue_push_tail(self->messages, msg);
+  g_queue_push_tail(self->threads, g_thread_self());
   self->messages_count++;
   g_mutex_unlock(&self->lock);
 }
@@ -51,6 +55,7 @@ test_pipe_free(LogPipe *s)
   TestPipe *self = (TestPipe *) s;
 
   g_queue_free_full(self->messages, (GDestroyNotify) log_msg_unref);
+  g_queue_free(self->threads);
   g_mutex_clear(&self->lock);
   log_pipe_free_method(s);
 }
@@ -64,6 +69,7 @@ test_pipe_new(GlobalConfig *cfg)
   self->super.queue = test_pipe_queue;
   self->super.free_fn = test_pipe_free;
   self->messages = g_queue_new();
+  self->threads = g_queue_new();
   g_mutex_init(&self->lock);
   return self;
 }
@@ -106,6 +112,219 @@ Test(logscheduler, test_log_scheduler_can_be_constructed)
   _destroy_test_pipe(test_pipe);
 }
 
+Test(logscheduler, test_resequence_outside_of_partitions_is_a_noop)
+{
+  LogSchedulerOptions options;
+  TestPipe *test_pipe = _construct_test_pipe();
+  LogScheduler *s;
+
+  log_scheduler_options_defaults(&options);
+  options.preserve_order = TRUE;
+  log_scheduler_options_init(&options, configuration);
+  s = log_scheduler_new(&options, &test_pipe->super);
+
+  LogMessage *msg = create_sample_message();
+  LogPathOptions path_options = LOG_PATH_OPTIONS_INIT;
+  log_scheduler_push(s, msg, &path_options);
+  cr_assert(test_pipe->messages_count == 1);
+
+  msg = create_sample_message();
+  cr_assert_not(log_scheduler_resequence(&test_pipe->super, msg, &path_options));
+  log_msg_unref(msg);
+
+  log_scheduler_free(s);
+  _destroy_test_pipe(test_pipe);
+}
+
+#if SYSLOG_NG_HAVE_IV_WORK_POOL_SUBMIT_CONTINUATION
+
+static gint acked_messages;
+
+static void
+_count_acks(LogMessage *msg, AckType ack_type)
+{
+  acked_messages++;
+}
+
+static LogMessageQueueNode *
+_create_queue_node(gint seq)
+{
+  LogPathOptions path_options = LOG_PATH_OPTIONS_INIT;
+  LogMessage *msg = create_empty_message();
+  gchar value[16];
+
+  g_snprintf(value, sizeof(value), "%d", seq);
+  log_msg_set_value_by_name(msg, "SEQ", value, -1);
+
+  path_options.ack_needed = TRUE;
+  log_msg_add_ack(msg, &path_options);
+  msg->ack_func = _count_acks;
+
+  LogMessageQueueNode *node = log_msg_alloc_queue_node(msg, &path_options);
+  log_msg_unref(msg);
+  return node;
+}
+
+static void
+_assert_forwarded_sequence(TestPipe *test_pipe, const gint *expected, gint expected_len)
+{
+  cr_assert_eq(test_pipe->messages_count, expected_len);
+
+  gint i = 0;
+  for (GList *l = test_pipe->messages->head; l; l = l->next, i++)
+    {
+      LogMessage *msg = (LogMessage *) l->data;
+      cr_assert_eq(atoi(log_msg_get_value_by_name(msg, "SEQ", NULL)), expected[i],
+                   "messages must be forwarded in the order of their sequence numbers, index: %d", i);
+    }
+}
+
+Test(logscheduler, test_reorder_buffer_releases_out_of_order_completions_in_sequence)
+{
+  TestPipe *test_pipe = _construct_test_pipe();
+  LogSchedulerReorderBuffer reorder;
+
+  _reorder_buffer_init(&reorder);
+  for (gint seq = 0; seq < 5; seq++)
+    _reorder_buffer_add(&reorder, seq, &test_pipe->super, _create_queue_node(seq));
+
+  _reorder_buffer_complete(&reorder, 2);
+  _reorder_buffer_complete(&reorder, 4);
+  _assert_forwarded_sequence(test_pipe, NULL, 0);
+
+  _reorder_buffer_complete(&reorder, 0);
+  _assert_forwarded_sequence(test_pipe, (gint[]) { 0 }, 1);
+
+  _reorder_buffer_complete(&reorder, 1);
+  _assert_forwarded_sequence(test_pipe, (gint[]) { 0, 1, 2 }, 3);
+
+  _reorder_buffer_complete(&reorder, 3);
+  _assert_forwarded_sequence(test_pipe, (gint[]) { 0, 1, 2, 3, 4 }, 5);
+
+  _reorder_buffer_clear(&reorder);
+  _destroy_test_pipe(test_pipe);
+}
+
+Test(logscheduler, test_reorder_buffer_is_not_wedged_by_messages_dropped_on_the_way)
+{
+  TestPipe *test_pipe = _construct_test_pipe();
+  LogSchedulerReorderBuffer reorder;
+
+  _reorder_buffer_init(&reorder);
+
+  /* 1 and 3 never reach resequence(), e.g. they were filtered out, but
+   * their processing still completes */
+  _reorder_buffer_add(&reorder, 0, &test_pipe->super, _create_queue_node(0));
+  _reorder_buffer_add(&reorder, 2, &test_pipe->super, _create_queue_node(2));
+  _reorder_buffer_add(&reorder, 4, &test_pipe->super, _create_queue_node(4));
+
+  _reorder_buffer_complete(&reorder, 3);
+  _reorder_buffer_complete(&reorder, 2);
+  _reorder_buffer_complete(&reorder, 1);
+  _assert_forwarded_sequence(test_pipe, NULL, 0);
+
+  _reorder_buffer_complete(&reorder, 0);
+  _assert_forwarded_sequence(test_pipe, (gint[]) { 0, 2 }, 2);
+
+  _reorder_buffer_complete(&reorder, 4);
+  _assert_forwarded_sequence(test_pipe, (gint[]) { 0, 2, 4 }, 3);
+
+  /* the buffer continues with the next sequence number */
+  _reorder_buffer_add(&reorder, 5, &test_pipe->super, _create_queue_node(5));
+  _reorder_buffer_complete(&reorder, 5);
+  _assert_forwarded_sequence(test_pipe, (gint[]) { 0, 2, 4, 5 }, 4);
+
+  _reorder_buffer_clear(&reorder);
+  _destroy_test_pipe(test_pipe);
+}
+
+Test(logscheduler, test_reorder_buffer_drops_and_acks_the_pending_messages_when_cleared)
+{
+  TestPipe *test_pipe = _construct_test_pipe();
+  LogSchedulerReorderBuffer reorder;
+
+  acked_messages = 0;
+  _reorder_buffer_init(&reorder);
+  for (gint seq = 0; seq < 4; seq++)
+    _reorder_buffer_add(&reorder, seq, &test_pipe->super, _create_queue_node(seq));
+
+  /* 0 is stuck, everything else is waiting behind it */
+  _reorder_buffer_complete(&reorder, 1);
+  _reorder_buffer_complete(&reorder, 3);
+  cr_assert_eq(acked_messages, 0);
+
+  _reorder_buffer_clear(&reorder);
+  _assert_forwarded_sequence(test_pipe, NULL, 0);
+  cr_assert_eq(acked_messages, 4, "pending messages must be acked when the buffer is cleared, acked: %d",
+               acked_messages);
+
+  _destroy_test_pipe(test_pipe);
+}
+
+typedef struct _ResequencePipe
+{
+  LogPipe super;
+  LogPipe *next_pipe;
+} ResequencePipe;
+
+static void
+resequence_pipe_queue(LogPipe *s, LogMessage *msg, const LogPathOptions *path_options)
+{
+  ResequencePipe *self = (ResequencePipe *) s;
+
+  if (!log_scheduler_resequence(self->next_pipe, msg, path_options))
+    log_pipe_queue(self->next_pipe, msg, path_options);
+}
+
+static LogSchedulerBatch *
+_create_batch(LogSchedulerReorderBuffer *reorder, const gint *seqs, gint num_seqs)
+{
+  struct iv_list_head elements = IV_LIST_HEAD_INIT(elements);
+  GArray *sequence = g_array_new(FALSE, FALSE, sizeof(guint64));
+
+  for (gint i = 0; i < num_seqs; i++)
+    {
+      guint64 seq = seqs[i];
+
+      iv_list_add_tail(&_create_queue_node(seqs[i])->list, &elements);
+      g_array_append_val(sequence, seq);
+    }
+
+  LogSchedulerBatch *batch = _batch_new(&elements);
+  batch->reorder_buffer = reorder;
+  batch->sequence = sequence;
+  return batch;
+}
+
+Test(logscheduler, test_resequence_restores_the_order_across_partitions)
+{
+  TestPipe *test_pipe = _construct_test_pipe();
+  ResequencePipe resequence_pipe;
+  LogSchedulerReorderBuffer reorder;
+
+  log_pipe_init_instance(&resequence_pipe.super, configuration);
+  resequence_pipe.super.queue = resequence_pipe_queue;
+  resequence_pipe.next_pipe = &test_pipe->super;
+
+  LogSchedulerPartition partition = { .front_pipe = &resequence_pipe.super };
+
+  _reorder_buffer_init(&reorder);
+
+  /* the second partition finishes first */
+  _process_batch(&partition, _create_batch(&reorder, (gint[]) { 1, 3 }, 2));
+  _assert_forwarded_sequence(test_pipe, NULL, 0);
+
+  _process_batch(&partition, _create_batch(&reorder, (gint[]) { 0, 2, 4 }, 3));
+  _assert_forwarded_sequence(test_pipe, (gint[]) { 0, 1, 2, 3, 4 }, 5);
+
+  cr_assert_null(current_reorder_buffer, "the reorder buffer must not leak out of the partition");
+
+  _reorder_buffer_clear(&reorder);
+  _destroy_test_pipe(test_pipe);
+}
+
+#endif
+
 static void
 setup(void)
 {
@@ -121,3 +340,145 @@ teardown(void)
 }
 
 TestSuite(logscheduler, .init = setup, .fini = teardown);
+
+#if SYSLOG_NG_HAVE_IV_WORK_POOL_SUBMIT_CONTINUATION
+
+#define NUM_PARTITIONS 4
+#define NUM_KEYS 16
+#define NUM_MESSAGES 1000
+
+static MainLoopOptions main_loop_options;
+
+typedef struct _TestFeeder
+{
+  LogScheduler *scheduler;
+  GThread *thread;
+} TestFeeder;
+
+static gpointer
+_feed_messages(gpointer user_data)
+{
+  TestFeeder *feeder = (TestFeeder *) user_data;
+  LogPathOptions path_options = LOG_PATH_OPTIONS_INIT;
+
+  main_loop_worker_thread_start(MLW_ASYNC_WORKER);
+  feeder->thread = g_thread_self();
+  for (gint i = 0; i < NUM_MESSAGES; i++)
+    {
+      LogMessage *msg = create_empty_message();
+      gchar value[32];
+
+      g_snprintf(value, sizeof(value), "host-%d", i % NUM_KEYS);
+      log_msg_set_value(msg, LM_V_HOST, value, -1);
+      g_snprintf(value, sizeof(value), "%d", i);
+      log_msg_set_value_by_name(msg, "SEQ", value, -1);
+
+      log_scheduler_push(feeder->scheduler, msg, &path_options);
+      if ((i % 16) == 0)
+        main_loop_worker_invoke_batch_callbacks();
+    }
+  main_loop_worker_invoke_batch_callbacks();
+  main_loop_worker_thread_stop();
+  return NULL;
+}
+
+static gint
+_get_partition_of_message(LogTemplate *partition_key, LogMessage *msg)
+{
+  LogTemplateEvalOptions options = DEFAULT_TEMPLATE_EVAL_OPTIONS;
+
+  return log_template_hash(partition_key, msg, &options) % NUM_PARTITIONS;
+}
+
+Test(logscheduler_partition_threads, test_partitions_are_bound_to_dedicated_threads_and_keep_the_order_of_keys)
+{
+  LogSchedulerOptions options;
+  TestPipe *test_pipe = _construct_test_pipe();
+
+  log_scheduler_options_defaults(&options);
+  options.num_partitions = NUM_PARTITIONS;
+  options.partition_threads = TRUE;
+  log_scheduler_options_set_partition_key_ref(&options, compile_template("$HOST"));
+  cr_assert(log_scheduler_options_init(&options, configuration));
+  cr_assert_eq(log_scheduler_options_get_num_partition_threads(&options), NUM_PARTITIONS);
+
+  LogScheduler *s = log_scheduler_new(&options, &test_pipe->super);
+  cr_assert(log_scheduler_init(s));
+  cr_assert(log_scheduler_start_threads(s));
+
+  TestFeeder feeder = { .scheduler = s };
+  GThread *feeder_thread = g_thread_new(NULL, _feed_messages, &feeder);
+  g_thread_join(feeder_thread);
+
+  /* asks the partition threads to exit, they drain their rings before doing so */
+  main_loop_sync_worker_startup_and_teardown();
+  log_scheduler_deinit(s);
+
+  cr_assert_eq(test_pipe->messages_count, NUM_MESSAGES);
+
+  GThread *thread_by_partition[NUM_PARTITIONS] = { 0 };
+  gint last_seq_by_key[NUM_KEYS];
+  for (gint i = 0; i < NUM_KEYS; i++)
+    last_seq_by_key[i] = -1;
+
+  GList *t = test_pipe->threads->head;
+  for (GList *l = test_pipe->messages->head; l; l = l->next, t = t->next)
+    {
+      LogMessage *msg = (LogMessage *) l->data;
+      GThread *thread = (GThread *) t->data;
+
+      cr_assert_neq(thread, feeder.thread, "messages must be processed in the partition threads");
+      cr_assert_neq(thread, g_thread_self(), "messages must be processed in the partition threads");
+
+      gint partition = _get_partition_of_message(options.partition_key, msg);
+      if (!thread_by_partition[partition])
+        thread_by_partition[partition] = thread;
+      cr_assert_eq(thread, thread_by_partition[partition],
+                   "all messages of a partition must be processed by the same thread");
+
+      gint seq = atoi(log_msg_get_value_by_name(msg, "SEQ", NULL));
+      gint key = seq % NUM_KEYS;
+      cr_assert_gt(seq, last_seq_by_key[key], "messages with the same key must keep their order, "
+                   "seq: %d, previous seq: %d", seq, last_seq_by_key[key]);
+      last_seq_by_key[key] = seq;
+    }
+
+  for (gint i = 0; i < NUM_PARTITIONS; i++)
+    {
+      for (gint j = i + 1; j < NUM_PARTITIONS; j++)
+        {
+          if (thread_by_partition[i] && thread_by_partition[j])
+            cr_assert_neq(thread_by_partition[i], thread_by_partition[j],
+                          "partitions must not share their threads, partitions: %d, %d", i, j);
+        }
+    }
+
+  log_scheduler_free(s);
+  log_scheduler_options_destroy(&options);
+  _destroy_test_pipe(test_pipe);
+}
+
+static void
+setup_partition_threads(void)
+{
+  app_startup();
+  main_loop_init(main_loop_get_instance(), &main_loop_options);
+  configuration = cfg_new_snippet();
+  cr_assert(cfg_init(configuration));
+
+  /* the partition threads and the feeder thread */
+  main_loop_worker_allocate_thread_space(NUM_PARTITIONS + 1);
+  main_loop_worker_finalize_thread_space();
+}
+
+static void
+teardown_partition_threads(void)
+{
+  cfg_free(configuration);
+  main_loop_deinit(main_loop_get_instance());
+  app_shutdown();
+}
+
+TestSuite(logscheduler_partition_threads, .init = setup_partition_threads, .fini = teardown_partition_threads);
+
+#endif
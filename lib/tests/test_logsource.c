@@ -31,6 +31,13 @@
 #include "cfg.h"
 #include "apphook.h"
 #include "dynamic-window-pool.h"
+#include "stats/stats.h"
+#include "stats/stats-registry.h"
+#include "stats/stats-cluster-single.h"
+#include "ack-tracker/ack_tracker.h"
+#include "ack-tracker/ack_tracker_factory.h"
+#include "logqueue-fifo.h"
+#include "mainloop-worker.h"
 
 #include <syslog.h>
 #include <string.h>
@@ -71,11 +78,14 @@ test_source_wakeup(LogSource *s)
 }
 
 LogSource *
-test_source_init(LogSourceOptions *options)
+test_source_init_with_ack_tracker(LogSourceOptions *options, AckTrackerFactory *ack_tracker_factory)
 {
   TestSource *source = g_new0(TestSource, 1);
   log_source_init_instance(&source->super, cfg);
   source->super.wakeup = test_source_wakeup;
+  source->super.schedule_dynamic_window_realloc = log_source_dynamic_window_realloc;
+  if (ack_tracker_factory)
+    log_source_set_ack_tracker_factory(&source->super, ack_tracker_factory);
 
   log_source_options_init(options, cfg, TEST_SOURCE_GROUP);
   log_source_set_options(&source->super, options, TEST_STATS_ID, NULL, TRUE, NULL);
@@ -83,6 +93,12 @@ test_source_init(LogSourceOptions *options)
   return &source->super;
 }
 
+LogSource *
+test_source_init(LogSourceOptions *options)
+{
+  return test_source_init_with_ack_tracker(options, NULL);
+}
+
 void
 test_source_destroy(LogSource *source)
 {
@@ -308,6 +324,39 @@ Test(log_source, test_suspend)
   test_source_destroy(source);
 }
 
+Test(log_source, test_post_batch)
+{
+  source_options.init_window_size = 5;
+
+  LogSource *source = test_source_init(&source_options);
+  TestPipe *next_pipe = test_pipe_init();
+  log_pipe_append(&source->super, &next_pipe->super);
+
+  cr_assert_eq(log_source_get_free_window(source), 5);
+
+  LogMessage *msgs[3];
+  for (gint i = 0; i < G_N_ELEMENTS(msgs); i++)
+    msgs[i] = log_msg_new_empty();
+  log_source_post_batch(source, msgs, NULL, G_N_ELEMENTS(msgs));
+
+  cr_assert_eq(next_pipe->messages_count, 3);
+  cr_assert_eq(g_queue_peek_nth(next_pipe->messages, 2), msgs[2]);
+  cr_assert_eq(log_source_get_free_window(source), 2);
+  cr_assert(log_source_free_to_send(source));
+
+  for (gint i = 0; i < 2; i++)
+    msgs[i] = log_msg_new_empty();
+  log_source_post_batch(source, msgs, NULL, 2);
+  cr_assert_eq(log_source_get_free_window(source), 0);
+  cr_assert_not(log_source_free_to_send(source));
+
+  test_pipe_ack_messages(next_pipe, 5);
+  cr_assert_eq(log_source_get_free_window(source), 5);
+
+  test_pipe_destroy(next_pipe);
+  test_source_destroy(source);
+}
+
 Test(log_source, test_wakeup)
 {
   source_options.init_window_size = 3;
@@ -332,6 +381,46 @@ Test(log_source, test_wakeup)
   test_source_destroy(source);
 }
 
+static void
+_post_messages_of_size(LogSource *source, gsize messages_to_send, gsize size)
+{
+  for (gsize i = 0; i < messages_to_send; ++i)
+    {
+      LogMessage *msg = log_msg_new_empty();
+      log_msg_set_recvd_rawmsg_size(msg, size);
+      log_source_post(source, msg);
+    }
+}
+
+Test(log_source, test_window_bytes)
+{
+  source_options.init_window_size = 100;
+  source_options.init_window_bytes = 1000;
+
+  LogSource *source = test_source_init(&source_options);
+  TestPipe *next_pipe = test_pipe_init();
+  log_pipe_append(&source->super, &next_pipe->super);
+
+  _post_messages_of_size(source, 2, 400);
+  cr_assert(log_source_free_to_send(source));
+  cr_assert_eq(log_source_get_free_window(source), 98);
+
+  _post_messages_of_size(source, 1, 400);
+  cr_assert_not(log_source_free_to_send(source), "the source should stop once the byte window is used up");
+  cr_assert_eq(log_source_get_free_window(source), 0);
+
+  test_pipe_ack_messages(next_pipe, 1);
+  cr_assert(log_source_free_to_send(source));
+  cr_assert_eq(((TestSource *) source)->wakeup_count, 1);
+
+  test_pipe_ack_messages(next_pipe, 2);
+  cr_assert(log_source_free_to_send(source));
+  cr_assert_eq(((TestSource *) source)->wakeup_count, 1);
+
+  test_pipe_destroy(next_pipe);
+  test_source_destroy(source);
+}
+
 Test(log_source, test_forced_suspend_and_wakeup)
 {
   LogSource *source = test_source_init(&source_options);
@@ -498,4 +587,350 @@ Test(log_source, test_dynamic_window_reclaim)
   test_source_destroy(source);
 }
 
+Test(log_source, test_dynamic_window_shift)
+{
+  source_options.init_window_size = 1;
+  LogSource *source = test_source_init(&source_options);
+
+  const gsize pool_size = 100;
+  DynamicWindowPool *pool = test_dynamic_window_pool_init(pool_size);
+  dynamic_window_pool_set_connection_limits(pool, 10, 60);
+  log_source_enable_dynamic_window(source, pool);
+
+  pool->balanced_window = 20;
+  log_source_dynamic_window_realloc(source);
+  cr_assert_eq(pool->free_window, 80);
+  cr_assert_eq(log_source_dynamic_window_get_headroom(source), 40);
+
+  log_source_dynamic_window_shift(source, 30);
+  cr_assert_eq(pool->free_window, 50);
+  cr_assert_eq(log_source_dynamic_window_get_headroom(source), 10);
+
+  log_source_dynamic_window_shift(source, 30);
+  cr_assert_eq(pool->free_window, 40, "The dynamic window should not grow above the per-connection maximum");
+
+  log_source_dynamic_window_shift(source, -100);
+  cr_assert_eq(pool->free_window, 90, "The dynamic window should not shrink below the per-connection minimum");
+
+  dynamic_window_reset_demand(&source->dynamic_window);
+  log_source_dynamic_window_realloc(source);
+  cr_assert_eq(pool->free_window, 80, "The next realloc should return to the balanced window");
+
+  dynamic_window_pool_unref(pool);
+  test_source_destroy(source);
+}
+
+Test(log_source, test_dynamic_window_starvation)
+{
+  source_options.init_window_size = 1;
+  LogSource *source = test_source_init(&source_options);
+  TestPipe *next_pipe = test_pipe_init();
+  log_pipe_append(&source->super, &next_pipe->super);
+
+  const gsize pool_size = 10;
+  DynamicWindowPool *pool = test_dynamic_window_pool_init(pool_size);
+  log_source_enable_dynamic_window(source, pool);
+  log_source_dynamic_window_realloc(source);
+
+  log_source_dynamic_window_update_statistics(source);
+  cr_assert_not(log_source_dynamic_window_is_starving(source));
+  cr_assert_eq(log_source_dynamic_window_get_surplus(source), pool_size / 2);
+
+  const gsize num_of_pending_messages = pool->pool_size + source_options.init_window_size;
+  _post_messages(source, num_of_pending_messages);
+  log_source_dynamic_window_update_statistics(source);
+  cr_assert(log_source_dynamic_window_is_starving(source));
+  cr_assert_eq(log_source_dynamic_window_get_surplus(source), 0, "A starving connection has nothing to give away");
+
+  test_pipe_ack_messages(next_pipe, num_of_pending_messages);
+  log_source_dynamic_window_update_statistics(source);
+  cr_assert_not(log_source_dynamic_window_is_starving(source));
+
+  dynamic_window_pool_unref(pool);
+  test_pipe_destroy(next_pipe);
+  test_source_destroy(source);
+}
+
+Test(log_source, test_event_memory_accounting)
+{
+  cfg->stats_options.level = STATS_LEVEL1;
+  stats_reinit(&cfg->stats_options);
+
+  LogSource *source = test_source_init(&source_options);
+  TestPipe *next_pipe = test_pipe_init();
+  log_pipe_append(&source->super, &next_pipe->super);
+
+  LogMessage *msg = log_msg_new_empty();
+  log_msg_set_value(msg, LM_V_MESSAGE, "a short message", -1);
+  LogMessageMemoryUsage usage;
+  log_msg_get_memory_usage(msg, &usage);
+
+  log_source_post(source, msg);
+
+  cr_assert_eq(stats_counter_get(source->metrics.event_memory.header), usage.header);
+  cr_assert_gt(stats_counter_get(source->metrics.event_memory.payload_used), 0);
+  cr_assert_gt(stats_counter_get(source->metrics.event_memory.tags), 0,
+               "the source group tag should have been accounted for");
+
+  gsize events = 0;
+  for (gint i = 0; i < LOG_SOURCE_EVENT_SIZE_BUCKETS; i++)
+    events += stats_counter_get(source->metrics.event_memory.size_buckets[i]);
+  cr_assert_eq(events, 1, "each message should be counted in exactly one size bucket");
+
+  test_pipe_ack_messages(next_pipe, 1);
+  test_pipe_destroy(next_pipe);
+  test_source_destroy(source);
+}
+
+Test(log_source, test_lazy_counter_registration)
+{
+  cfg->stats_options.level = STATS_LEVEL1;
+  cfg->stats_options.lazy_registration = TRUE;
+  stats_reinit(&cfg->stats_options);
+
+  LogSource *source = test_source_init(&source_options);
+  TestPipe *next_pipe = test_pipe_init();
+  log_pipe_append(&source->super, &next_pipe->super);
+
+  cr_assert_null(source->metrics.recvd_messages, "counters should not be registered before the first message");
+
+  log_source_post(source, log_msg_new_empty());
+  cr_assert_not_null(source->metrics.recvd_messages);
+  cr_assert_eq(stats_counter_get(source->metrics.recvd_messages), 1);
+
+  test_pipe_ack_messages(next_pipe, 1);
+  test_pipe_destroy(next_pipe);
+  test_source_destroy(source);
+}
+
+/*
+ * Acks in worker threads are summed up per source and applied when the
+ * worker invokes its batch callbacks.  The workers below play a threaded
+ * destination, running in a thread of their own.
+ */
+
+#define NUM_COALESCING_BATCHES 3
+
+typedef struct _AckCoalescingWorker
+{
+  LogSource *source;
+  LogQueue *queue;
+  TestPipe *pipe;
+  gsize window_before_callbacks[NUM_COALESCING_BATCHES];
+  gsize window_after_callbacks[NUM_COALESCING_BATCHES];
+  gsize wakeups_after_callbacks[NUM_COALESCING_BATCHES];
+} AckCoalescingWorker;
+
+typedef struct _QueuePipe
+{
+  LogPipe super;
+  LogQueue *queue;
+} QueuePipe;
+
+static void
+_queue_pipe_queue(LogPipe *s, LogMessage *msg, const LogPathOptions *path_options)
+{
+  QueuePipe *self = (QueuePipe *) s;
+  LogPathOptions local_path_options = *path_options;
+
+  /* as if it was a flow-controlled destination, messages are acked when they leave the queue */
+  local_path_options.flow_control_requested = TRUE;
+  log_queue_push_tail(self->queue, msg, &local_path_options);
+}
+
+static QueuePipe *
+_queue_pipe_new(LogQueue *queue)
+{
+  QueuePipe *self = g_new0(QueuePipe, 1);
+
+  log_pipe_init_instance(&self->super, cfg);
+  self->super.queue = _queue_pipe_queue;
+  self->queue = queue;
+  return self;
+}
+
+static void
+_finish_worker_batch(AckCoalescingWorker *self, gint batch)
+{
+  self->window_before_callbacks[batch] = log_source_get_free_window(self->source);
+  main_loop_worker_invoke_batch_callbacks();
+  self->window_after_callbacks[batch] = log_source_get_free_window(self->source);
+  self->wakeups_after_callbacks[batch] = ((TestSource *) self->source)->wakeup_count;
+}
+
+static void
+_pop_messages(LogQueue *queue, gint count)
+{
+  for (gint i = 0; i < count; i++)
+    {
+      LogPathOptions path_options = LOG_PATH_OPTIONS_INIT;
+      LogMessage *msg = log_queue_pop_head(queue, &path_options);
+
+      g_assert(msg);
+      log_msg_unref(msg);
+    }
+}
+
+static gpointer
+_ack_with_rewinds(gpointer user_data)
+{
+  AckCoalescingWorker *self = (AckCoalescingWorker *) user_data;
+
+  main_loop_worker_thread_start(MLW_THREADED_OUTPUT_WORKER);
+
+  /* the last two messages of the batch fail, they are rewound */
+  _pop_messages(self->queue, 4);
+  log_queue_rewind_backlog(self->queue, 2);
+  log_queue_ack_backlog(self->queue, 2);
+  _finish_worker_batch(self, 0);
+
+  /* the rewound messages are sent again, and fail again */
+  _pop_messages(self->queue, 2);
+  log_queue_rewind_backlog_all(self->queue);
+  _finish_worker_batch(self, 1);
+
+  _pop_messages(self->queue, 4);
+  log_queue_ack_backlog(self->queue, 4);
+  _finish_worker_batch(self, 2);
+
+  main_loop_worker_thread_stop();
+  return NULL;
+}
+
+static gsize
+_get_coalesced_window_updates(void)
+{
+  StatsClusterKey sc_key;
+  gsize value = 0;
+
+  stats_cluster_single_key_set(&sc_key, "source_coalesced_window_updates_total", NULL, 0);
+  stats_lock();
+  StatsCounterItem *counter = stats_get_counter(&sc_key, SC_TYPE_SINGLE_VALUE);
+  if (counter)
+    value = stats_counter_get(counter);
+  stats_unlock();
+  return value;
+}
+
+static void
+_run_worker(GThreadFunc func, AckCoalescingWorker *worker)
+{
+  GThread *thread = g_thread_new("ack-worker", func, worker);
+  g_thread_join(thread);
+}
+
+static void
+_allocate_worker_thread(void)
+{
+  /* the per-thread slots of the sources are sized at init */
+  main_loop_worker_allocate_thread_space(1);
+  main_loop_worker_finalize_thread_space();
+}
+
+Test(log_source, test_coalesced_acks_are_counted_exactly_once_across_rewinds)
+{
+  cfg->stats_options.level = STATS_LEVEL1;
+  stats_reinit(&cfg->stats_options);
+  app_running();
+
+  _allocate_worker_thread();
+  source_options.init_window_size = 8;
+  LogSource *source = test_source_init(&source_options);
+  LogQueue *queue = log_queue_fifo_new(100, NULL, STATS_LEVEL0, NULL, NULL);
+  QueuePipe *next_pipe = _queue_pipe_new(queue);
+  log_pipe_append(&source->super, &next_pipe->super);
+
+  _post_messages(source, 6);
+  cr_assert_eq(log_source_get_free_window(source), 2);
+
+  AckCoalescingWorker worker = { .source = source, .queue = queue };
+  _run_worker(_ack_with_rewinds, &worker);
+
+  /* acks are held back until the end of the batch, then applied at once */
+  cr_assert_eq(worker.window_before_callbacks[0], 2);
+  cr_assert_eq(worker.window_after_callbacks[0], 4);
+
+  /* rewound messages are not acked */
+  cr_assert_eq(worker.window_before_callbacks[1], 4);
+  cr_assert_eq(worker.window_after_callbacks[1], 4);
+
+  cr_assert_eq(worker.window_before_callbacks[2], 4);
+  cr_assert_eq(worker.window_after_callbacks[2], 8, "every message is acked exactly once");
+  cr_assert_eq(log_source_get_free_window(source), 8);
+
+  /* one window update per batch instead of one per message: 2 + 4 acks in 2 updates */
+  cr_assert_eq(_get_coalesced_window_updates(), 4);
+
+  log_pipe_unref(&next_pipe->super);
+  log_queue_unref(queue);
+  test_source_destroy(source);
+}
+
+static void
+_ack_nth_message(TestPipe *pipe, gint n)
+{
+  LogMessage *msg = g_queue_pop_nth(pipe->messages, n);
+
+  g_assert(msg);
+  pipe->messages_count--;
+
+  LogPathOptions path_options = { .ack_needed = TRUE };
+  log_msg_drop(msg, &path_options, AT_PROCESSED);
+}
+
+static gpointer
+_ack_out_of_order(gpointer user_data)
+{
+  AckCoalescingWorker *self = (AckCoalescingWorker *) user_data;
+
+  main_loop_worker_thread_start(MLW_THREADED_OUTPUT_WORKER);
+
+  /* the messages #1 and #2, the first one (#0) was rewound */
+  _ack_nth_message(self->pipe, 1);
+  _ack_nth_message(self->pipe, 1);
+  _finish_worker_batch(self, 0);
+
+  /* #0, which releases the whole range, and #3 */
+  _ack_nth_message(self->pipe, 0);
+  _finish_worker_batch(self, 1);
+  _ack_nth_message(self->pipe, 0);
+  _finish_worker_batch(self, 2);
+
+  main_loop_worker_thread_stop();
+  return NULL;
+}
+
+Test(log_source, test_coalesced_acks_keep_the_order_of_the_ack_tracker)
+{
+  _allocate_worker_thread();
+  source_options.init_window_size = 4;
+  LogSource *source = test_source_init_with_ack_tracker(&source_options, consecutive_ack_tracker_factory_new());
+  TestPipe *next_pipe = test_pipe_init();
+  log_pipe_append(&source->super, &next_pipe->super);
+
+  for (gint i = 0; i < 4; i++)
+    {
+      cr_assert(ack_tracker_request_bookmark(source->ack_tracker));
+      log_source_post(source, log_msg_new_empty());
+    }
+  cr_assert_not(log_source_free_to_send(source));
+
+  AckCoalescingWorker worker = { .source = source, .pipe = next_pipe };
+  _run_worker(_ack_out_of_order, &worker);
+
+  /* only a consecutive range of acks gives back window */
+  cr_assert_eq(worker.window_after_callbacks[0], 0);
+  cr_assert_eq(worker.wakeups_after_callbacks[0], 0);
+
+  cr_assert_eq(worker.window_before_callbacks[1], 0);
+  cr_assert_eq(worker.window_after_callbacks[1], 3);
+  cr_assert_eq(worker.wakeups_after_callbacks[1], 1, "a coalesced update wakes up the source once");
+
+  cr_assert_eq(worker.window_after_callbacks[2], 4);
+  cr_assert_eq(worker.wakeups_after_callbacks[2], 1);
+
+  test_pipe_destroy(next_pipe);
+  test_source_destroy(source);
+}
+
 TestSuite(log_source, .init = setup, .fini = teardown);
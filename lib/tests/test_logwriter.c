@@ -232,3 +232,129 @@ Test(logwriter, test_logwriter)
   iv_deinit();
   cfg_free(configuration);
 }
+
+static void
+_assert_raw_relay_output(const gchar *input, guint writer_flags, const gchar *expected)
+{
+  LogWriterOptions opt = {0};
+  GString *result_msg = g_string_sized_new(128);
+
+  log_writer_options_defaults(&opt);
+  log_writer_options_init(&opt, configuration, LWO_NO_STATS | LWO_RAW_RELAY);
+
+  LogMessage *msg = msg_format_parse(&parse_options, (const guchar *) input, strlen(input));
+  LogQueue *queue = log_queue_fifo_new(1000, NULL, STATS_LEVEL0, NULL, NULL);
+  LogWriter *writer = log_writer_new(writer_flags, configuration);
+
+  log_writer_set_options(writer, NULL, &opt, NULL, NULL);
+  log_writer_set_queue(writer, queue);
+  cr_assert(log_pipe_init((LogPipe *)writer), "LogWriter initialization failed");
+
+  log_writer_format_log(writer, msg, result_msg);
+  cr_assert_str_eq(result_msg->str, expected);
+
+  _tear_down(writer, msg, queue, result_msg, &opt);
+}
+
+Test(logwriter, test_logwriter_raw_relay)
+{
+  configuration = cfg_new_snippet();
+  app_startup();
+
+  msg_format_options_defaults(&parse_options);
+  parse_options.flags |= LP_RAW_RELAY;
+  msg_format_options_init(&parse_options, configuration);
+
+  LogMessage *msg = msg_format_parse(&parse_options, (const guchar *) MSG_BSD_STR, strlen(MSG_BSD_STR));
+  cr_assert_str_eq(log_msg_get_value_by_name(msg, "RAWMSG", NULL), MSG_BSD_STR);
+  cr_assert_str_eq(log_msg_get_value(msg, LM_V_MESSAGE, NULL), MSG_BSD_STR);
+  cr_assert_str_eq(log_msg_get_value(msg, LM_V_HOST, NULL), "", "raw-relay messages should not be parsed");
+  log_msg_unref(msg);
+
+  /* newline terminated transports get their terminator back, framed ones are written unchanged */
+  _assert_raw_relay_output(MSG_BSD_STR, LW_FORMAT_PROTO, "<155>2006-02-11T10:34:56+01:00 bzorp syslog-ng[23323]:árvíztűrőtükörfúrógép\n");
+  _assert_raw_relay_output(MSG_SYSLOG_STR, LW_SYSLOG_PROTOCOL, MSG_SYSLOG_STR);
+  _assert_raw_relay_output("foo\n", LW_FORMAT_PROTO, "foo\n");
+
+  msg_format_options_destroy(&parse_options);
+  app_shutdown();
+  iv_deinit();
+  cfg_free(configuration);
+}
+
+static LogWriter *
+_create_writer(LogWriterOptions *opt, guint writer_flags, guint32 writer_options, LogQueue *queue)
+{
+  log_writer_options_defaults(opt);
+  log_writer_options_init(opt, configuration, writer_options);
+
+  LogWriter *writer = log_writer_new(writer_flags, configuration);
+
+  log_writer_set_options(writer, NULL, opt, NULL, NULL);
+  log_writer_set_queue(writer, queue);
+  cr_assert(log_pipe_init((LogPipe *)writer), "LogWriter initialization failed");
+  return writer;
+}
+
+static void
+_destroy_writer(LogWriter *writer, LogWriterOptions *opt)
+{
+  cr_expect(log_pipe_deinit((LogPipe *)writer));
+  log_pipe_unref((LogPipe *) writer);
+  log_writer_options_destroy(opt);
+}
+
+Test(logwriter, test_logwriter_format_cache_is_shared_between_writers)
+{
+  configuration = cfg_new_snippet();
+  app_startup();
+  setenv("TZ", "MET-1METDST", TRUE);
+  tzset();
+
+  cfg_load_module(configuration, "syslogformat");
+  msg_format_options_defaults(&parse_options);
+  msg_format_options_init(&parse_options, configuration);
+
+  LogWriterOptions opt1 = {0}, opt2 = {0}, opt3 = {0};
+  LogQueue *queue = log_queue_fifo_new(1000, NULL, STATS_LEVEL0, NULL, NULL);
+  LogWriter *writer1 = _create_writer(&opt1, LW_FORMAT_PROTO, LWO_NO_STATS | LWO_FORMAT_CACHE, queue);
+  LogWriter *writer2 = _create_writer(&opt2, LW_FORMAT_PROTO, LWO_NO_STATS | LWO_FORMAT_CACHE, queue);
+  LogWriter *writer3 = _create_writer(&opt3, LW_FORMAT_FILE, LWO_NO_STATS | LWO_FORMAT_CACHE, queue);
+  GString *result = g_string_new("");
+
+  opt2.truncate_size = strlen(EXPECTED_MSG_BSD_TO_PROTO_STR_TRUNCATE);
+
+  LogMessage *msg = init_msg(MSG_BSD_STR, FALSE);
+
+  /* writable messages are not cached */
+  log_writer_format_log(writer1, msg, result);
+  cr_assert_str_eq(result->str, EXPECTED_MSG_BSD_TO_PROTO_STR);
+  cr_assert_null(msg->format_cache);
+
+  log_msg_write_protect(msg);
+  log_writer_format_log(writer1, msg, result);
+  cr_assert_str_eq(result->str, EXPECTED_MSG_BSD_TO_PROTO_STR);
+  cr_assert_not_null(msg->format_cache);
+
+  /* truncation is applied per writer, on top of the shared line */
+  log_writer_format_log(writer2, msg, result);
+  cr_assert_str_eq(result->str, EXPECTED_MSG_BSD_TO_PROTO_STR_TRUNCATE);
+  log_writer_format_log(writer1, msg, result);
+  cr_assert_str_eq(result->str, EXPECTED_MSG_BSD_TO_PROTO_STR);
+
+  /* different format, different entry */
+  log_writer_format_log(writer3, msg, result);
+  cr_assert_str_eq(result->str, EXPECTED_MSG_BSD_STR);
+
+  log_msg_unref(msg);
+  g_string_free(result, TRUE);
+  _destroy_writer(writer1, &opt1);
+  _destroy_writer(writer2, &opt2);
+  _destroy_writer(writer3, &opt3);
+  log_queue_unref(queue);
+
+  msg_format_options_destroy(&parse_options);
+  app_shutdown();
+  iv_deinit();
+  cfg_free(configuration);
+}
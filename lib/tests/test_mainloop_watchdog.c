@@ -0,0 +1,126 @@
+/*
+ * Copyright (c) 2024 One Identity LLC.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+
+#include <criterion/criterion.h>
+#include "libtest/grab-logging.h"
+
+#include "mainloop-watchdog.c"
+#include "apphook.h"
+
+#define TEST_STALL_THRESHOLD_MSEC 50
+
+static void
+_blocking_callback(void)
+{
+  g_usleep(10 * TEST_STALL_THRESHOLD_MSEC * 1000);
+}
+
+/* the heartbeat timer can't fire while the test is blocking the main thread */
+static void
+_fire_heartbeat(void)
+{
+  iv_timer_unregister(&heartbeat_timer);
+  _heartbeat(NULL);
+}
+
+Test(mainloop_watchdog, backtrace_capture_is_bounded_by_the_number_of_frames)
+{
+#if SIGNAL_BACKTRACE_SUPPORTED
+  gpointer frames[WATCHDOG_MAX_DEPTH];
+
+  cr_assert_eq(signal_backtrace_capture(frames, 0), 0);
+  cr_assert_eq(signal_backtrace_capture(frames, 1), 1);
+  cr_assert_gt(signal_backtrace_capture(frames, WATCHDOG_MAX_DEPTH), 0);
+#else
+  cr_skip_test("backtraces are not supported");
+#endif
+}
+
+Test(mainloop_watchdog, blocked_main_thread_is_reported_with_its_backtrace)
+{
+  main_loop_watchdog_start();
+  cr_assert(watchdog_running);
+
+  main_loop_watchdog_callback_begin("test", _blocking_callback);
+  _blocking_callback();
+  main_loop_watchdog_callback_end();
+
+  cr_assert_eq(stats_counter_get(main_metrics.stalls), 0, "the stall is accounted once the main loop resumes");
+  _fire_heartbeat();
+  cr_assert_eq(stats_counter_get(main_metrics.stalls), 1);
+  cr_assert_geq(stats_counter_get(main_metrics.max_stall), TEST_STALL_THRESHOLD_MSEC);
+
+  main_loop_watchdog_stop();
+  cr_assert_not(watchdog_running);
+
+  cr_assert(find_grabbed_message("A callback has been blocking its thread for too long"));
+  cr_assert(find_grabbed_message("thread='main'"));
+  cr_assert(find_grabbed_message("kind='test'"));
+#if SIGNAL_BACKTRACE_SUPPORTED
+  cr_assert_not(find_grabbed_message("backtrace='unavailable'"), "the blocked thread should report its backtrace");
+#endif
+  cr_assert(find_grabbed_message("The main loop has been blocked"));
+}
+
+Test(mainloop_watchdog, callbacks_below_the_threshold_are_not_reported)
+{
+  main_loop_watchdog_start();
+
+  main_loop_watchdog_callback_begin("test", _blocking_callback);
+  g_usleep(TEST_STALL_THRESHOLD_MSEC / 5 * 1000);
+  main_loop_watchdog_callback_end();
+  _fire_heartbeat();
+  g_usleep(2 * _check_interval_msec() * 1000);
+
+  main_loop_watchdog_stop();
+
+  cr_assert_not(find_grabbed_message("A callback has been blocking its thread for too long"));
+  cr_assert_not(find_grabbed_message("The main loop has been blocked"));
+}
+
+Test(mainloop_watchdog, zero_threshold_disables_the_watchdog)
+{
+  stall_threshold_msec = 0;
+  main_loop_watchdog_start();
+  cr_assert_not(watchdog_running);
+  main_loop_watchdog_stop();
+}
+
+static void
+setup(void)
+{
+  app_startup();
+  start_grabbing_messages();
+  stall_threshold_msec = TEST_STALL_THRESHOLD_MSEC;
+}
+
+static void
+teardown(void)
+{
+  stop_grabbing_messages();
+  reset_grabbed_messages();
+  app_shutdown();
+}
+
+TestSuite(mainloop_watchdog, .init = setup, .fini = teardown);
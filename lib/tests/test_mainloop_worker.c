@@ -0,0 +1,156 @@
+/*
+ * Copyright (c) 2024 One Identity LLC.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#include <criterion/criterion.h>
+
+/* the parsed CPU list is checked from the inside */
+#include "mainloop-worker.c"
+#include "apphook.h"
+
+#if SYSLOG_NG_HAVE_PTHREAD_SETAFFINITY_NP
+
+static void
+_assert_cpus(const gint *expected, gint n)
+{
+  cr_assert_eq(main_loop_worker_num_cpus, n, "unexpected number of CPUs: %d, expected: %d",
+               main_loop_worker_num_cpus, n);
+  for (gint i = 0; i < n; i++)
+    cr_assert_eq(main_loop_worker_cpus[i], expected[i], "CPU #%d is %d, expected: %d",
+                 i, main_loop_worker_cpus[i], expected[i]);
+}
+
+static void
+_assert_cpu_list_rejected(const gchar *cpu_list)
+{
+  GError *error = NULL;
+
+  cr_assert_not(main_loop_worker_set_cpu_list(cpu_list, &error), "CPU list is accepted: %s", cpu_list);
+  cr_assert_not_null(error);
+  cr_assert_eq(main_loop_worker_num_cpus, 0, "a rejected CPU list is kept: %s", cpu_list);
+  g_clear_error(&error);
+}
+
+Test(mainloop_worker, test_cpu_list_is_parsed_in_taskset_format)
+{
+  cr_assert(main_loop_worker_set_cpu_list("0-3,8,10-11", NULL));
+  _assert_cpus((const gint[]) { 0, 1, 2, 3, 8, 10, 11 }, 7);
+
+  /* a new list replaces the previous one */
+  cr_assert(main_loop_worker_set_cpu_list("5", NULL));
+  _assert_cpus((const gint[]) { 5 }, 1);
+}
+
+Test(mainloop_worker, test_invalid_cpu_lists_are_rejected)
+{
+  _assert_cpu_list_rejected("0,");
+  _assert_cpu_list_rejected("a");
+  _assert_cpu_list_rejected("1-");
+  _assert_cpu_list_rejected("3-1");
+  _assert_cpu_list_rejected("-1");
+  _assert_cpu_list_rejected("0-3x");
+
+  gchar *too_large = g_strdup_printf("%d", CPU_SETSIZE);
+  _assert_cpu_list_rejected(too_large);
+  g_free(too_large);
+
+  gchar *too_many = g_strdup_printf("0-%d", MAIN_LOOP_MAX_WORKER_THREADS);
+  _assert_cpu_list_rejected(too_many);
+  g_free(too_many);
+}
+
+typedef struct _WorkerAffinity
+{
+  gint thread_index;
+  gint rc;
+  cpu_set_t cpu_set;
+} WorkerAffinity;
+
+static gpointer
+_get_worker_affinity(gpointer user_data)
+{
+  WorkerAffinity *affinity = (WorkerAffinity *) user_data;
+
+  main_loop_worker_thread_start(MLW_THREADED_OUTPUT_WORKER);
+  affinity->thread_index = main_loop_worker_get_thread_index();
+  affinity->rc = pthread_getaffinity_np(pthread_self(), sizeof(affinity->cpu_set), &affinity->cpu_set);
+  main_loop_worker_thread_stop();
+  return NULL;
+}
+
+Test(mainloop_worker, test_worker_threads_are_pinned_to_the_listed_cpus)
+{
+  cpu_set_t allowed;
+  WorkerAffinity pinned;
+
+  /* the test may be confined to a subset of the CPUs, pick one of those */
+  cr_assert_eq(sched_getaffinity(0, sizeof(allowed), &allowed), 0);
+  gint cpu = 0;
+  while (!CPU_ISSET(cpu, &allowed))
+    cpu++;
+
+  gchar *cpu_list = g_strdup_printf("%d", cpu);
+  cr_assert(main_loop_worker_set_cpu_list(cpu_list, NULL));
+  g_free(cpu_list);
+
+  main_loop_worker_allocate_thread_space(1);
+  main_loop_worker_finalize_thread_space();
+
+  GThread *thread = g_thread_new("worker", _get_worker_affinity, &pinned);
+  g_thread_join(thread);
+
+  cr_assert_eq(pinned.thread_index, 0);
+  cr_assert_eq(pinned.rc, 0);
+  cr_assert_eq(CPU_COUNT(&pinned.cpu_set), 1, "the worker is not pinned to a single CPU");
+  cr_assert(CPU_ISSET(cpu, &pinned.cpu_set), "the worker is not pinned to CPU %d", cpu);
+}
+
+#else
+
+Test(mainloop_worker, test_cpu_list_is_rejected_without_affinity_support)
+{
+  GError *error = NULL;
+
+  cr_assert_not(main_loop_worker_set_cpu_list("0", &error));
+  cr_assert_not_null(error);
+  g_clear_error(&error);
+}
+
+#endif
+
+static void
+setup(void)
+{
+  app_startup();
+}
+
+static void
+teardown(void)
+{
+#if SYSLOG_NG_HAVE_PTHREAD_SETAFFINITY_NP
+  main_loop_worker_num_cpus = 0;
+#endif
+  main_loop_worker_finalize_thread_space();
+  app_shutdown();
+}
+
+TestSuite(mainloop_worker, .init = setup, .fini = teardown);
@@ -25,6 +25,7 @@
 #include "libtest/cr_template.h"
 
 #include "logmatcher.h"
+#include "logmatcher-multi.h"
 #include "apphook.h"
 #include "plugin.h"
 #include "cfg.h"
@@ -193,6 +194,81 @@ Test(matcher, disable_jit)
                    "favíz", "favíztűrőtükörfúrógép", _construct_matcher(LMF_DISABLE_JIT, log_matcher_pcre_re_new));
 }
 
+Test(matcher, pcre_literal_patterns_are_matched_without_regexp_engine)
+{
+  testcase_match("sshd[1234]: accepted", "accepted", TRUE, _construct_matcher(0, log_matcher_pcre_re_new));
+  testcase_match("sshd[1234]: accepted", "rejected", FALSE, _construct_matcher(0, log_matcher_pcre_re_new));
+  testcase_match("sshd[1234]: accepted", "sshd\\[1234\\]", TRUE, _construct_matcher(0, log_matcher_pcre_re_new));
+  testcase_match("sshd[1234]: accepted", "sshd\\[4321\\]", FALSE, _construct_matcher(0, log_matcher_pcre_re_new));
+  testcase_match("sshd[1234]: accepted", "ACCEPTED", FALSE, _construct_matcher(0, log_matcher_pcre_re_new));
+  testcase_match("sshd[1234]: accepted", "ACCEPTED", TRUE, _construct_matcher(LMF_ICASE, log_matcher_pcre_re_new));
+  testcase_match("sshd[1234]: accepted", "ACCEPTED", TRUE,
+                 _construct_matcher(LMF_ICASE | LMF_UTF8, log_matcher_pcre_re_new));
+}
+
+static void
+_assert_match_of_buffer_prefix(const gchar *buffer, gssize prefix_len, const gchar *pattern, gboolean expected_result)
+{
+  LogMatcher *m = _construct_matcher(0, log_matcher_pcre_re_new);
+  LogMessage *msg = log_msg_new_empty();
+
+  log_matcher_compile(m, pattern, NULL);
+  cr_assert_eq(log_matcher_match_buffer(m, msg, buffer, prefix_len), expected_result,
+               "pattern=%s, value=%.*s, expected=%d", pattern, (gint) prefix_len, buffer, expected_result);
+
+  log_msg_unref(msg);
+  log_matcher_unref(m);
+}
+
+Test(matcher, pcre_literal_patterns_do_not_match_past_the_end_of_the_value)
+{
+  /* only the "sshd[1234]: accepted" prefix is the value, it is not NUL terminated */
+  const gchar *buffer = "sshd[1234]: acceptedAAA";
+  gssize value_len = strlen("sshd[1234]: accepted");
+
+  _assert_match_of_buffer_prefix(buffer, value_len, "accepted", TRUE);
+  _assert_match_of_buffer_prefix(buffer, value_len, "acceptedA", FALSE);
+  _assert_match_of_buffer_prefix(buffer, value_len, "acceptedAAA", FALSE);
+  _assert_match_of_buffer_prefix(buffer, value_len, "accepted.*AAA", FALSE);
+  _assert_match_of_buffer_prefix(buffer, 4, "sshd", TRUE);
+  _assert_match_of_buffer_prefix(buffer, 3, "sshd", FALSE);
+}
+
+Test(matcher, pcre_required_literals_prefilter_values_before_matching)
+{
+  testcase_match("Failed password for root from 10.0.0.1", "Failed password for .* from", TRUE,
+                 _construct_matcher(0, log_matcher_pcre_re_new));
+  testcase_match("Failed password for root", "Failed password for .* from", FALSE,
+                 _construct_matcher(0, log_matcher_pcre_re_new));
+  testcase_match("sshd[1234]: accepted", "^sshd\\[\\d+\\]: acc", TRUE, _construct_matcher(0, log_matcher_pcre_re_new));
+  testcase_match("sshd[1234]: accepted", "^sshd\\[\\d+\\]: rej", FALSE, _construct_matcher(0, log_matcher_pcre_re_new));
+  testcase_match("sshd[1234]: accepted", "(accepted|rejected)", TRUE, _construct_matcher(0, log_matcher_pcre_re_new));
+  testcase_match("sshd[1234]: accepted", "sshd|foobar", TRUE, _construct_matcher(0, log_matcher_pcre_re_new));
+  testcase_match("sshd[1234]: accepted", "sshx?d\\[", TRUE, _construct_matcher(0, log_matcher_pcre_re_new));
+  testcase_match("sshd[1234]: accepted", "(?i)SSHD\\[", TRUE, _construct_matcher(0, log_matcher_pcre_re_new));
+  testcase_match("sshd[1234]: accepted", "SSHD\\[\\d", TRUE, _construct_matcher(LMF_ICASE, log_matcher_pcre_re_new));
+  testcase_match("árvztűrő", "árví?ztűrő", TRUE, _construct_matcher(LMF_UTF8, log_matcher_pcre_re_new));
+  testcase_match("árvíztűrő", "árví+ztűrő", TRUE, _construct_matcher(LMF_UTF8, log_matcher_pcre_re_new));
+
+  testcase_replace("sshd[1234]: accepted", "\\d+\\]: acc", "1]: exc", "sshd[1]: excepted",
+                   _construct_matcher(0, log_matcher_pcre_re_new));
+  testcase_replace("sshd[1234]: accepted", "\\d+\\]: rej", "1]: exc", "sshd[1234]: accepted",
+                   _construct_matcher(0, log_matcher_pcre_re_new));
+}
+
+Test(matcher, pcre_replacements_referencing_groups_are_expanded_from_the_match)
+{
+  testcase_replace("foo bar baz", "(\\w+) (\\w+)", "$2 $1", "bar foo baz",
+                   _construct_matcher(0, log_matcher_pcre_re_new));
+  testcase_replace("a=1 b=2", "(\\w)=(\\d)", "$2:$1", "1:a 2:b",
+                   _construct_matcher(LMF_GLOBAL, log_matcher_pcre_re_new));
+  testcase_replace("a=1 b=2", "\\w=\\d", "<$0$3>", "<a=1> <b=2>",
+                   _construct_matcher(LMF_GLOBAL, log_matcher_pcre_re_new));
+
+  /* groups that did not participate in the match */
+  testcase_replace("b", "(a)|(b)", "<$1$2>", "<b>", _construct_matcher(0, log_matcher_pcre_re_new));
+}
+
 Test(matcher, string_match)
 {
   testcase_replace("árvíztűrőtükörfúrógép", "árvíz",
@@ -558,3 +634,60 @@ Test(matcher, test_replace_works_correctly_if_input_is_a_match_value_that_gets_t
   log_matcher_unref(m);
   log_msg_unref(msg);
 }
+
+static void
+_add_compiled_matcher(LogMultiMatcher *multi_matcher, gint id, gint flags,
+                      LogMatcher *(*construct)(const LogMatcherOptions *options), const gchar *pattern)
+{
+  LogMatcher *m = _construct_matcher(flags, construct);
+
+  cr_assert(log_matcher_compile(m, pattern, NULL));
+  log_multi_matcher_add(multi_matcher, m, id);
+  log_matcher_unref(m);
+}
+
+static gint
+_match_first(LogMultiMatcher *multi_matcher, const gchar *value)
+{
+  LogMessage *msg = log_msg_new_empty();
+  gint result = log_multi_matcher_match_first(multi_matcher, msg, LM_V_MESSAGE, value, -1);
+
+  log_msg_unref(msg);
+  return result;
+}
+
+Test(matcher, multi_matcher_returns_the_first_matching_id)
+{
+  LogMultiMatcher *multi_matcher = log_multi_matcher_new();
+
+  _add_compiled_matcher(multi_matcher, 0, 0, log_matcher_pcre_re_new, "Failed password for .* from");
+  _add_compiled_matcher(multi_matcher, 1, LMF_ICASE, log_matcher_pcre_re_new, "^session (opened|closed)");
+  _add_compiled_matcher(multi_matcher, 2, 0, log_matcher_string_new, "sshd");
+  _add_compiled_matcher(multi_matcher, 2, 0, log_matcher_glob_new, "*cron*");
+  _add_compiled_matcher(multi_matcher, 3, 0, log_matcher_pcre_re_new, "(a)\\1");
+  _add_compiled_matcher(multi_matcher, 4, LMF_UTF8, log_matcher_pcre_re_new, "árvíz");
+  _add_compiled_matcher(multi_matcher, 5, 0, log_matcher_pcre_re_new, "from \\d+\\.\\d+");
+  log_multi_matcher_compile(multi_matcher);
+
+#if SYSLOG_NG_ENABLE_HYPERSCAN
+  /* backreferences are not supported by Hyperscan, utf8 patterns are left to PCRE */
+  cr_assert_eq(log_multi_matcher_get_compiled_count(multi_matcher), 3);
+#else
+  cr_assert_eq(log_multi_matcher_get_compiled_count(multi_matcher), 0);
+#endif
+
+  cr_assert_eq(_match_first(multi_matcher, "Failed password for root from 10.0.0.1"), 0);
+  cr_assert_eq(_match_first(multi_matcher, "Failed password for root at 10.0.0.1"), -1);
+  cr_assert_eq(_match_first(multi_matcher, "SESSION closed for user root"), 1);
+  cr_assert_eq(_match_first(multi_matcher, "user root: session closed"), -1);
+  cr_assert_eq(_match_first(multi_matcher, "sshd"), 2);
+  cr_assert_eq(_match_first(multi_matcher, "sshd2"), -1);
+  cr_assert_eq(_match_first(multi_matcher, "anacron started"), 2);
+  cr_assert_eq(_match_first(multi_matcher, "baac"), 3);
+  cr_assert_eq(_match_first(multi_matcher, "árvíztűrő tükörfúrógép from 10.0"), 4);
+  cr_assert_eq(_match_first(multi_matcher, "connection from 10.0"), 5);
+  cr_assert_eq(_match_first(multi_matcher, "anacron connection from 10.0"), 2);
+  cr_assert_eq(_match_first(multi_matcher, ""), -1);
+
+  log_multi_matcher_free(multi_matcher);
+}
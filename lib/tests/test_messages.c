@@ -75,6 +75,69 @@ Test(test_messages, test_errno_capture)
   msg_error("test errno capture", (errno=10, evt_tag_error("error")));
 }
 
+static GPtrArray *posted_messages;
+
+static void
+collect_posted_messages(LogMessage *msg)
+{
+  g_ptr_array_add(posted_messages, g_strdup(log_msg_get_value_by_name(msg, "MESSAGE", NULL)));
+  log_msg_unref(msg);
+}
+
+static void
+start_collecting_posted_messages(void)
+{
+  posted_messages = g_ptr_array_new_with_free_func(g_free);
+  msg_set_post_func(collect_posted_messages);
+}
+
+Test(test_messages, repeated_messages_are_formatted_in_the_reused_buffer)
+{
+  start_collecting_posted_messages();
+  for (gint i = 0; i < 3; i++)
+    msg_error("reused buffer", evt_tag_int("i", i), evt_tag_str("long", "0123456789012345678901234567890123456789"
+                                                                 "0123456789012345678901234567890123456789"
+                                                                 "0123456789012345678901234567890123456789"));
+
+  cr_assert_eq(posted_messages->len, 3);
+  cr_assert(g_str_has_prefix(g_ptr_array_index(posted_messages, 2), "reused buffer; i='2', long='0123"));
+  g_ptr_array_unref(posted_messages);
+}
+
+Test(test_messages, identical_messages_are_coalesced_when_enabled)
+{
+  start_collecting_posted_messages();
+  msg_set_coalesce_repeated_messages(TRUE);
+
+  msg_error("repeated message", evt_tag_str("key", "value"));
+  msg_error("repeated message", evt_tag_str("key", "value"));
+  msg_error("repeated message", evt_tag_str("key", "value"));
+  msg_error("another message");
+  msg_error("another message");
+  msg_warning("another message");
+
+  cr_assert_eq(posted_messages->len, 5);
+  cr_assert_str_eq(g_ptr_array_index(posted_messages, 0), "repeated message; key='value'");
+  cr_assert_str_eq(g_ptr_array_index(posted_messages, 1), "Last message repeated; count='2'");
+  cr_assert_str_eq(g_ptr_array_index(posted_messages, 2), "another message;");
+  cr_assert_str_eq(g_ptr_array_index(posted_messages, 3), "Last message repeated; count='1'");
+  cr_assert_str_eq(g_ptr_array_index(posted_messages, 4), "another message;");
+
+  msg_set_coalesce_repeated_messages(FALSE);
+  g_ptr_array_unref(posted_messages);
+}
+
+Test(test_messages, identical_messages_are_posted_when_coalescing_is_disabled)
+{
+  start_collecting_posted_messages();
+
+  msg_error("repeated message");
+  msg_error("repeated message");
+
+  cr_assert_eq(posted_messages->len, 2);
+  g_ptr_array_unref(posted_messages);
+}
+
 Test(test_messages, test_msg_set_log_level_sets_flags_correctly)
 {
   verbose_flag = FALSE;
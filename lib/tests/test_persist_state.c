@@ -329,6 +329,80 @@ Test(persist_state, test_values)
   cancel_and_destroy_persist_state(state);
 }
 
+Test(persist_state, test_persist_state_grows_while_an_entry_is_mapped)
+{
+  PersistState *state = clean_and_create_persist_state_for_test("test_grow_while_mapped.persist");
+
+  PersistEntryHandle handle = persist_state_alloc_entry(state, "mapped", sizeof(TestState));
+  TestState *test_state = (TestState *) persist_state_map_entry(state, handle);
+  test_state->value = 0xDEADBEEF;
+
+  /* this grows the file several times, the mapped entry stays in place */
+  for (gint i = 0; i < 1000; i++)
+    {
+      gchar key[16];
+
+      g_snprintf(key, sizeof(key), "testkey%d", i);
+      cr_assert(persist_state_alloc_entry(state, key, 128));
+    }
+
+  cr_assert_eq(test_state->value, 0xDEADBEEF);
+  test_state->value = 0xCAFEBABE;
+  persist_state_unmap_entry(state, handle);
+
+  state = restart_persist_state(state);
+
+  gsize size;
+  guint8 version;
+  handle = persist_state_lookup_entry(state, "mapped", &size, &version);
+  cr_assert(handle);
+  test_state = (TestState *) persist_state_map_entry(state, handle);
+  cr_assert_eq(test_state->value, 0xCAFEBABE);
+  persist_state_unmap_entry(state, handle);
+
+  cancel_and_destroy_persist_state(state);
+}
+
+Test(persist_state, test_persist_state_grows_beyond_its_reserved_address_range)
+{
+  PersistState *state = clean_and_create_persist_state_for_test("test_grow_beyond_reserved.persist");
+
+  PersistEntryHandle handle = persist_state_alloc_entry(state, "mapped", sizeof(TestState));
+  TestState *test_state = (TestState *) persist_state_map_entry(state, handle);
+  test_state->value = 0xDEADBEEF;
+  persist_state_unmap_entry(state, handle);
+
+  /* pretend that the reserved range is used up, the next growth falls back to remapping */
+  cr_assert(state->reserved_size);
+  state->reserved_size = state->current_size;
+
+  for (gint i = 0; i < 1000; i++)
+    {
+      gchar key[16];
+
+      g_snprintf(key, sizeof(key), "testkey%d", i);
+      cr_assert(persist_state_alloc_entry(state, key, 128));
+    }
+  cr_assert_eq(state->reserved_size, 0);
+
+  test_state = (TestState *) persist_state_map_entry(state, handle);
+  cr_assert_eq(test_state->value, 0xDEADBEEF);
+  test_state->value = 0xCAFEBABE;
+  persist_state_unmap_entry(state, handle);
+
+  state = restart_persist_state(state);
+
+  gsize size;
+  guint8 version;
+  handle = persist_state_lookup_entry(state, "mapped", &size, &version);
+  cr_assert(handle);
+  test_state = (TestState *) persist_state_map_entry(state, handle);
+  cr_assert_eq(test_state->value, 0xCAFEBABE);
+  persist_state_unmap_entry(state, handle);
+
+  cancel_and_destroy_persist_state(state);
+}
+
 Test(persist_state, test_persist_state_temp_file_cleanup_on_cancel)
 {
   PersistState *state = clean_and_create_persist_state_for_test("test_persist_state_temp_file_cleanup_on_cancel.persist");
@@ -0,0 +1,174 @@
+/*
+ * Copyright (c) 2024 One Identity LLC.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#include <criterion/criterion.h>
+
+/* the module cache is checked from the inside */
+#include "plugin.c"
+#include "apphook.h"
+#include "cfg-grammar.h"
+
+#include <unistd.h>
+
+#define TEST_CACHE_FILENAME "test_plugin_module_cache.modules"
+#define TEST_MODULE_FILENAME "test_plugin_module_cache_fake" G_MODULE_SUFFIX
+
+/* not a real shared object, it can only be found through the cache */
+static struct stat
+_create_fake_module(const gchar *content)
+{
+  struct stat st;
+
+  cr_assert(g_file_set_contents(TEST_MODULE_FILENAME, content, -1, NULL));
+  cr_assert_eq(stat(TEST_MODULE_FILENAME, &st), 0);
+  return st;
+}
+
+static void
+_init_module_cache(void)
+{
+  module_cache = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, (GDestroyNotify) _module_cache_entry_free);
+}
+
+static ModuleCacheEntry *
+_cache_fake_module(struct stat *st)
+{
+  ModuleCacheEntry *entry = g_new0(ModuleCacheEntry, 1);
+
+  _module_cache_entry_set_stat(entry, st);
+  entry->plugins = g_list_append(entry->plugins, plugin_candidate_new(LL_CONTEXT_SOURCE, "fake-source", NULL));
+  entry->plugins = g_list_append(entry->plugins, plugin_candidate_new(LL_CONTEXT_DESTINATION, "fake-dest", NULL));
+  g_hash_table_insert(module_cache, g_strdup(TEST_MODULE_FILENAME), entry);
+  module_cache_dirty = TRUE;
+  return entry;
+}
+
+static void
+_assert_plugin(GList *l, gint type, const gchar *name)
+{
+  cr_assert_not_null(l);
+
+  PluginCandidate *pc = (PluginCandidate *) l->data;
+  cr_assert_eq(pc->super.type, type);
+  cr_assert_str_eq(pc->super.name, name);
+}
+
+Test(plugin_module_cache, test_cached_modules_are_not_opened_again)
+{
+  struct stat st = _create_fake_module("not-a-module");
+
+  _init_module_cache();
+  ModuleCacheEntry *entry = _cache_fake_module(&st);
+
+  cr_assert_eq(_module_cache_lookup(TEST_MODULE_FILENAME, "fake"), entry);
+}
+
+Test(plugin_module_cache, test_modified_modules_are_opened_again)
+{
+  struct stat st = _create_fake_module("not-a-module");
+
+  _init_module_cache();
+  _cache_fake_module(&st);
+  _create_fake_module("not-a-module, modified");
+
+  /* opening the fake module fails, which is not cached */
+  module_cache_dirty = FALSE;
+  cr_assert_null(_module_cache_lookup(TEST_MODULE_FILENAME, "fake"));
+  cr_assert_not(module_cache_dirty);
+}
+
+Test(plugin_module_cache, test_the_cache_survives_a_restart)
+{
+  struct stat st = _create_fake_module("not-a-module");
+
+  _init_module_cache();
+  _cache_fake_module(&st);
+  _module_cache_save(TEST_CACHE_FILENAME);
+  cr_assert_not(module_cache_dirty);
+  plugin_global_deinit();
+
+  _init_module_cache();
+  _module_cache_load(TEST_CACHE_FILENAME);
+
+  ModuleCacheEntry *entry = g_hash_table_lookup(module_cache, TEST_MODULE_FILENAME);
+  cr_assert_not_null(entry, "the module is not loaded from the cache file");
+  cr_assert(_module_cache_entry_matches(entry, &st));
+  cr_assert_eq(g_list_length(entry->plugins), 2);
+  _assert_plugin(entry->plugins, LL_CONTEXT_SOURCE, "fake-source");
+  _assert_plugin(entry->plugins->next, LL_CONTEXT_DESTINATION, "fake-dest");
+}
+
+Test(plugin_module_cache, test_cache_of_a_different_build_is_ignored)
+{
+  _create_fake_module("not-a-module");
+  gchar *line = g_strdup_printf("%s\t1\t2\t3\t4\t5\t%d:fake-source\n", TEST_MODULE_FILENAME, LL_CONTEXT_SOURCE);
+  gchar *contents = g_strconcat("# syslog-ng module cache 3.0.0 0000000\n", line, NULL);
+
+  cr_assert(g_file_set_contents(TEST_CACHE_FILENAME, contents, -1, NULL));
+  _init_module_cache();
+  _module_cache_load(TEST_CACHE_FILENAME);
+  cr_assert_eq(g_hash_table_size(module_cache), 0);
+
+  g_free(contents);
+  g_free(line);
+}
+
+Test(plugin_module_cache, test_malformed_lines_are_skipped)
+{
+  gchar *path = NULL;
+  gchar line[] = "fake" G_MODULE_SUFFIX "\t1\t2\t3\t4\t5";
+
+  cr_assert_null(_module_cache_parse_line(line, &path));
+  cr_assert_null(path);
+
+  gchar *valid = g_strdup_printf("fake" G_MODULE_SUFFIX "\t1\t2\t3\t4\t5\t%d:fake-source broken %d:",
+                                 LL_CONTEXT_SOURCE, LL_CONTEXT_DESTINATION);
+  ModuleCacheEntry *entry = _module_cache_parse_line(valid, &path);
+  cr_assert_not_null(entry);
+  cr_assert_str_eq(path, "fake" G_MODULE_SUFFIX);
+
+  /* the plugins that can not be parsed are dropped, the rest of the entry is kept */
+  cr_assert_eq(g_list_length(entry->plugins), 1);
+  _assert_plugin(entry->plugins, LL_CONTEXT_SOURCE, "fake-source");
+
+  _module_cache_entry_free(entry);
+  g_free(path);
+  g_free(valid);
+}
+
+static void
+setup(void)
+{
+  app_startup();
+}
+
+static void
+teardown(void)
+{
+  plugin_global_deinit();
+  unlink(TEST_MODULE_FILENAME);
+  unlink(TEST_CACHE_FILENAME);
+  app_shutdown();
+}
+
+TestSuite(plugin_module_cache, .init = setup, .fini = teardown);
@@ -43,8 +43,8 @@ setup_persist_id_test(const gchar *persist_file)
 static void
 teardown_persist_id_test(PersistState *state)
 {
-  commit_and_destroy_persist_state(state);
   rcptid_deinit();
+  commit_and_destroy_persist_state(state);
 }
 
 static void
@@ -70,9 +70,8 @@ Test(rcptid, test_rcptid_is_persistent_across_persist_backend_reinits)
   rcptid = rcptid_generate_id();
   cr_assert_eq(rcptid, 0xFFFFFFFFFFFFFFFE, "Rcptid initialization to specific value failed!");
 
-  state = restart_persist_state(state);
-
   rcptid_deinit();
+  state = restart_persist_state(state);
   rcptid_init(state, TRUE);
 
   rcptid = rcptid_generate_id();
@@ -92,6 +91,27 @@ Test(rcptid, test_rcptid_overflows_at_64bits_and_is_reset_to_one)
   teardown_persist_id_test(state);
 }
 
+Test(rcptid, test_rcptid_blocks_are_reserved_from_the_persisted_counter)
+{
+  PersistState *state = setup_persist_id_test("test_values.blocks");
+  rcptid_set_id(100);
+  cr_assert_eq(rcptid_generate_id(), 100);
+  cr_assert_eq(rcptid_generate_id(), 101);
+
+  /* the persisted counter is already past the reserved block */
+  gsize size;
+  guint8 version;
+  PersistEntryHandle handle = persist_state_lookup_entry(state, "next.rcptid", &size, &version);
+  RcptidState *data = persist_state_map_entry(state, handle);
+  cr_assert_gt(data->g_rcptid, 101);
+  persist_state_unmap_entry(state, handle);
+
+  /* changing the counter invalidates the reserved block */
+  rcptid_set_id(5);
+  cr_assert_eq(rcptid_generate_id(), 5);
+  teardown_persist_id_test(state);
+}
+
 Test(rcptid, test_rcptid_is_formatted_as_a_number_when_nonzero)
 {
   PersistState *state = setup_persist_id_test("test_values.nonzero");
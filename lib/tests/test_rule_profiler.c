@@ -0,0 +1,106 @@
+/*
+ * Copyright (c) 2024 One Identity LLC.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#include <criterion/criterion.h>
+
+#include "rule-profiler.h"
+#include "apphook.h"
+#include "cfg.h"
+
+#include <string.h>
+
+static GlobalConfig *cfg;
+
+static void
+_call(RuleProfile *profile, gboolean matched)
+{
+  RuleProfileSample sample;
+
+  rule_profile_begin(profile, &sample);
+  rule_profile_end(profile, &sample, matched);
+}
+
+Test(rule_profiler, instances_of_the_same_rule_share_their_profile)
+{
+  LogPipe *pipe = log_pipe_new(cfg);
+  RuleProfile *profile = rule_profile_get("filter", "f_sshd", pipe);
+  RuleProfile *clone_profile = rule_profile_get("filter", "f_sshd", pipe);
+  RuleProfile *other_profile = rule_profile_get("parser", "f_sshd", pipe);
+
+  cr_assert_eq(profile, clone_profile);
+  cr_assert_neq(profile, other_profile);
+
+  rule_profile_unref(clone_profile);
+  rule_profile_unref(other_profile);
+  rule_profile_unref(profile);
+  log_pipe_unref(pipe);
+}
+
+Test(rule_profiler, calls_are_only_counted_while_enabled)
+{
+  LogPipe *pipe = log_pipe_new(cfg);
+  RuleProfile *profile = rule_profile_get("filter", "f_sshd", pipe);
+
+  _call(profile, TRUE);
+  cr_assert_eq(atomic_gssize_get(&profile->calls), 0);
+
+  rule_profiler_enable(2);
+  _call(profile, TRUE);
+  _call(profile, FALSE);
+  _call(profile, TRUE);
+  _call(profile, FALSE);
+  rule_profiler_disable();
+  _call(profile, TRUE);
+
+  cr_assert_eq(atomic_gssize_get(&profile->calls), 4);
+  cr_assert_eq(atomic_gssize_get(&profile->matches), 2);
+  cr_assert_eq(atomic_gssize_get(&profile->timed_calls), 2);
+
+  GString *csv = g_string_new("");
+  rule_profiler_format_csv(csv);
+  cr_assert(strstr(csv->str, "filter;f_sshd;#unknown;4;2;2;"), "%s", csv->str);
+  g_string_free(csv, TRUE);
+
+  rule_profiler_reset();
+  cr_assert_eq(atomic_gssize_get(&profile->calls), 0);
+  cr_assert_eq(atomic_gssize_get(&profile->timed_nsec), 0);
+
+  rule_profile_unref(profile);
+  log_pipe_unref(pipe);
+}
+
+static void
+setup(void)
+{
+  app_startup();
+  cfg = cfg_new_snippet();
+}
+
+static void
+teardown(void)
+{
+  cfg_free(cfg);
+  app_shutdown();
+}
+
+TestSuite(rule_profiler, .init = setup, .fini = teardown);
@@ -27,6 +27,7 @@
 #include "stats/stats-registry.h"
 
 #include <iv.h>
+#include <string.h>
 
 #define ITERATIONS 10
 #define DEFAULT_ALLOC_SIZE 256L
@@ -125,6 +126,56 @@ Test(scratch_buffers, local_usage_metrics_measure_allocs)
   cr_assert_eq(scratch_buffers_get_local_allocation_bytes(), 2*DEFAULT_ALLOC_SIZE);
 }
 
+Test(scratch_buffers, arena_allocations_are_aligned_and_reclaimed_with_marks)
+{
+  ScratchBuffersMarker marker;
+
+  gchar *first = scratch_buffers_strdup("foo");
+  cr_assert_str_eq(first, "foo");
+
+  scratch_buffers_mark(&marker);
+  gpointer prev = NULL;
+  for (gint i = 0; i < 1000; i++)
+    {
+      gpointer p = scratch_buffers_alloc_bytes(i + 1);
+
+      cr_assert_eq(GPOINTER_TO_SIZE(p) % sizeof(guint64), 0);
+      cr_assert_neq(p, prev);
+      memset(p, 'x', i + 1);
+      prev = p;
+    }
+  gssize bytes = scratch_buffers_get_local_allocation_bytes();
+  scratch_buffers_reclaim_marked(marker);
+
+  /* the same memory is handed out again after reclaim */
+  gchar *second = scratch_buffers_strndup("barbaz", 3);
+  cr_assert_str_eq(second, "bar");
+  cr_assert_str_eq(first, "foo");
+  cr_assert_eq(second, first + sizeof(guint64));
+  cr_assert_eq(scratch_buffers_get_local_allocation_bytes(), bytes);
+}
+
+Test(scratch_buffers, trim_frees_buffers_above_the_high_water_mark)
+{
+  for (gint i = 0; i < ITERATIONS; i++)
+    scratch_buffers_alloc();
+  GString *large = scratch_buffers_alloc();
+  g_string_set_size(large, 1024 * 1024);
+  scratch_buffers_reclaim_allocations();
+
+  /* the burst is still within the high-water mark of this period, only the
+   * oversized buffer is replaced */
+  scratch_buffers_trim();
+  cr_assert_eq(scratch_buffers_get_local_allocation_count(), ITERATIONS + 1);
+  cr_assert_eq(scratch_buffers_get_local_allocation_bytes(), (ITERATIONS + 1) * DEFAULT_ALLOC_SIZE);
+
+  /* the next period did not need them at all */
+  scratch_buffers_alloc();
+  scratch_buffers_reclaim_allocations();
+  scratch_buffers_trim();
+  cr_assert_eq(scratch_buffers_get_local_allocation_count(), 1);
+}
+
 /* not published via the header */
 extern StatsCounterItem *stats_scratch_buffers_count;
 extern StatsCounterItem *stats_scratch_buffers_bytes;
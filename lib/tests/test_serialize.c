@@ -56,3 +56,40 @@ Test(serialize, test_serialize)
   serialize_read_string(a, value);
   cr_assert_str_eq(value->str, "tarkabarka");
 }
+
+Test(serialize, test_serialize_varint)
+{
+  GString *stream = g_string_new("");
+  guint64 unsigned_values[] = { 0, 1, 127, 128, 16383, 16384, G_MAXUINT32, G_MAXUINT64 };
+  gint64 signed_values[] = { 0, -1, 1, -64, 64, G_MININT64, G_MAXINT64 };
+  guint64 num;
+  gint64 snum;
+
+  SerializeArchive *a = serialize_string_archive_new(stream);
+
+  for (gint i = 0; i < G_N_ELEMENTS(unsigned_values); i++)
+    serialize_write_varint(a, unsigned_values[i]);
+  for (gint i = 0; i < G_N_ELEMENTS(signed_values); i++)
+    serialize_write_varint_signed(a, signed_values[i]);
+  serialize_archive_free(a);
+
+  /* small values take a single byte */
+  cr_assert_eq(stream->str[0], 0);
+  cr_assert_eq(stream->str[1], 1);
+  cr_assert_eq(stream->str[2], 127);
+
+  a = serialize_string_archive_new(stream);
+  for (gint i = 0; i < G_N_ELEMENTS(unsigned_values); i++)
+    {
+      cr_assert(serialize_read_varint(a, &num));
+      cr_assert_eq(num, unsigned_values[i]);
+    }
+  for (gint i = 0; i < G_N_ELEMENTS(signed_values); i++)
+    {
+      cr_assert(serialize_read_varint_signed(a, &snum));
+      cr_assert_eq(snum, signed_values[i]);
+    }
+  cr_assert_not(serialize_read_varint(a, &num), "reading past the end of the stream should fail");
+  serialize_archive_free(a);
+  g_string_free(stream, TRUE);
+}
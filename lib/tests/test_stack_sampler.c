@@ -0,0 +1,119 @@
+/*
+ * Copyright (c) 2024 One Identity LLC.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+
+#include <criterion/criterion.h>
+
+#include "stack-sampler.h"
+#include "logpipe.h"
+#include "cfg-tree.h"
+#include "apphook.h"
+#include "cfg.h"
+
+#include <string.h>
+#include <time.h>
+
+static GlobalConfig *cfg;
+
+static void
+_burn_cpu(glong msec)
+{
+  clock_t end = clock() + msec * CLOCKS_PER_SEC / 1000;
+  volatile guint64 counter = 0;
+
+  while (clock() < end)
+    counter++;
+}
+
+Test(stack_sampler, invalid_frequency_is_rejected)
+{
+  GError *error = NULL;
+
+  cr_assert_not(stack_sampler_start(0, &error));
+  cr_assert(error);
+  g_clear_error(&error);
+
+  cr_assert_not(stack_sampler_start(100000, &error));
+  cr_assert(error);
+  g_clear_error(&error);
+
+  cr_assert_not(stack_sampler_running);
+  cr_assert_not(stack_sampler_stop(NULL));
+}
+
+Test(stack_sampler, samples_are_tagged_with_the_enclosing_rule)
+{
+  GError *error = NULL;
+  LogPipe *pipe = log_pipe_new(cfg);
+  LogPipe *unnamed_pipe = log_pipe_new(cfg);
+  LogExprNode *rule = log_expr_node_new_parser("p_test", log_expr_node_new_pipe(pipe, NULL), NULL);
+
+  pipe->expr_node = rule->children;
+
+  if (!stack_sampler_start(1000, &error))
+    {
+      cr_log_warn("%s", error->message);
+      g_clear_error(&error);
+      cr_skip_test("stack sampling is not supported");
+    }
+  cr_assert(stack_sampler_running);
+  cr_assert_not(stack_sampler_start(1000, &error), "the sampler should not be started twice");
+  g_clear_error(&error);
+
+  const gchar *saved_tag = stack_sampler_enter_pipe(pipe);
+  /* pipes without a named rule keep the tag of the caller */
+  const gchar *saved_parser_tag = stack_sampler_enter_pipe(unnamed_pipe);
+  _burn_cpu(300);
+  stack_sampler_leave_pipe(saved_parser_tag);
+  stack_sampler_leave_pipe(saved_tag);
+
+  GString *collapsed_stacks = g_string_new("");
+  cr_assert(stack_sampler_stop(collapsed_stacks));
+  cr_assert_not(stack_sampler_running);
+
+  cr_assert_str_eq(pipe->sampler_tag, "parser:p_test");
+  cr_assert_str_eq(unnamed_pipe->sampler_tag, "");
+  cr_assert(g_str_has_prefix(collapsed_stacks->str, "parser:p_test;") ||
+            strstr(collapsed_stacks->str, "\nparser:p_test;"), "%s", collapsed_stacks->str);
+  cr_assert(g_str_has_suffix(collapsed_stacks->str, "\n"));
+
+  g_string_free(collapsed_stacks, TRUE);
+  log_expr_node_unref(rule);
+  log_pipe_unref(unnamed_pipe);
+}
+
+static void
+setup(void)
+{
+  app_startup();
+  cfg = cfg_new_snippet();
+}
+
+static void
+teardown(void)
+{
+  cfg_free(cfg);
+  app_shutdown();
+}
+
+TestSuite(stack_sampler, .init = setup, .fini = teardown);
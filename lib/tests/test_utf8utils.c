@@ -55,6 +55,21 @@ ParameterizedTestParameters(test_utf8utils, test_escaped_binary)
     {"\"text\"", "\\\"te\\xt\\\"", "\"x", -1},
     {"\xc3""\xa1 non zero terminated", "\\xc3", NULL, 1},
     {"\xc3""\xa1 non zero terminated", "á", NULL, 2},
+    /* long enough for the word-at-a-time scanning of plain ASCII runs */
+    {
+      "a longer line of plain text with \"quotes\"\tand a tab\\",
+      "a longer line of plain text with \\\"quotes\\\"\\tand a tab\\\\", "\"", -1
+    },
+    {"0123456789abcdef\x7f""0123456789abcdef\x01", "0123456789abcdef\x7f""0123456789abcdef\\x01", NULL, -1},
+    {"plain text, up to the length limit", "plain text, up to", NULL, 17},
+    {"0123456789abcdefxyz0123456789", "0123456789abcdef\\x\\yz0123456789", "xy", -1},
+    /* multi-byte sequences are validated without decoding them */
+    {"\"árvíztűrőtükörfúrógép\" – €100 𝄞", "\\\"árvíztűrőtükörfúrógép\\\" – €100 𝄞", "\"", -1},
+    {"overlong: \xc0\xaf \xe0\x80\xaf", "overlong: \\xc0\\xaf \\xe0\\x80\\xaf", NULL, -1},
+    {"surrogate: \xed\xa0\x80", "surrogate: \\xed\\xa0\\x80", NULL, -1},
+    {"above U+10FFFF: \xf4\x90\x80\x80", "above U+10FFFF: \\xf4\\x90\\x80\\x80", NULL, -1},
+    {"truncated at the end: \xe2\x82", "truncated at the end: \\xe2\\x82", NULL, -1},
+    {"truncated by the length: €", "truncated by the length: \\xe2\\x82", NULL, 27},
   };
 
   return cr_make_param_array(StringValueList, string_value_list,
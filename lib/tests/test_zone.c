@@ -802,3 +802,38 @@ Test(zone, test_logstamp_format)
 
   g_string_free(target, TRUE);
 }
+
+Test(zone, test_logstamp_format_uses_the_cached_prefix_correctly)
+{
+  UnixTime stamp = UNIX_TIME_INIT;
+  GString *target = g_string_sized_new(32);
+  struct
+  {
+    gint64 ut_sec;
+    guint32 ut_usec;
+    TimestampFormatTestCase c;
+  } test_cases[] =
+  {
+    /* the same second twice, only the fraction differs */
+    {1129319257, 123456, {TS_FMT_ISO, 3600, 3, "2005-10-14T20:47:37.123+01:00"}},
+    {1129319257, 987654, {TS_FMT_ISO, 3600, 6, "2005-10-14T20:47:37.987654+01:00"}},
+    {1129319257, 987654, {TS_FMT_BSD, 3600, 0, "Oct 14 20:47:37"}},
+    /* the same wall clock time in a different zone */
+    {1129322857, 0, {TS_FMT_ISO, 0, 0, "2005-10-14T20:47:37+00:00"}},
+    {1129322857, 0, {TS_FMT_BSD, 0, 0, "Oct 14 20:47:37"}},
+    /* the next second and one that maps to the same cache slot */
+    {1129322858, 0, {TS_FMT_ISO, 0, 0, "2005-10-14T20:47:38+00:00"}},
+    {1129322862, 0, {TS_FMT_ISO, 0, 0, "2005-10-14T20:47:42+00:00"}},
+    {1129322862, 987654, {TS_FMT_FULL, 0, 1, "2005 Oct 14 20:47:42.9"}},
+  };
+
+  for (gint i = 0; i < G_N_ELEMENTS(test_cases); i++)
+    {
+      stamp.ut_sec = test_cases[i].ut_sec;
+      stamp.ut_usec = test_cases[i].ut_usec;
+      stamp.ut_gmtoff = 0;
+      assert_timestamp_format(target, &stamp, test_cases[i].c);
+    }
+
+  g_string_free(target, TRUE);
+}
@@ -25,7 +25,41 @@
 #include "timeutils/cache.h"
 #include "timeutils/names.h"
 #include "timeutils/conv.h"
+#include "timeutils/misc.h"
 #include "str-format.h"
+#include "tls-support.h"
+
+#include <string.h>
+
+/*
+ * Most messages formatted by a thread share the same second, so the part
+ * of BSD, ISO and FULL timestamps that only depends on the second (and the
+ * zone offset) is cached per thread, only the fractional digits are
+ * formatted for every call.  The cache is indexed by the timestamp format
+ * and a few bits of the second, to cope with a couple of different
+ * timestamps/zones being formatted in parallel (e.g. $S_ISODATE and
+ * $R_ISODATE).
+ */
+#define FORMAT_CACHE_FORMATS  3
+#define FORMAT_CACHE_SLOTS    4
+
+typedef struct _FormattedStampCacheEntry
+{
+  gint64 wall_sec;
+  glong gmtoff;
+  gboolean valid;
+  guint8 prefix_len, suffix_len;
+  gchar prefix[32];
+  gchar suffix[8];
+} FormattedStampCacheEntry;
+
+TLS_BLOCK_START
+{
+  FormattedStampCacheEntry formatted_stamp_cache[FORMAT_CACHE_FORMATS][FORMAT_CACHE_SLOTS];
+}
+TLS_BLOCK_END;
+
+#define formatted_stamp_cache __tls_deref(formatted_stamp_cache)
 
 static void
 _append_frac_digits(glong usecs, GString *target, gint frac_digits)
@@ -55,45 +89,9 @@ append_format_zone_info(GString *target, glong gmtoff)
   format_uint32_padded(target, 2, '0', 10, ((gmtoff < 0 ? -gmtoff : gmtoff) % 3600) / 60);
 }
 
-void
-append_format_unix_time(const UnixTime *ut, GString *target, gint ts_format, glong zone_offset, gint frac_digits)
-{
-  WallClockTime wct = WALL_CLOCK_TIME_INIT;
-
-  if (ts_format == TS_FMT_UNIX)
-    {
-      format_uint32_padded(target, 0, 0, 10, (int) ut->ut_sec);
-      _append_frac_digits(ut->ut_usec, target, frac_digits);
-    }
-  else
-    {
-      convert_unix_time_to_wall_clock_time_with_tz_override(ut, &wct, zone_offset);
-      append_format_wall_clock_time(&wct, target, ts_format, frac_digits);
-    }
-}
-
-void
-format_unix_time(const UnixTime *stamp, GString *target, gint ts_format, glong zone_offset, gint frac_digits)
-{
-  g_string_truncate(target, 0);
-  append_format_unix_time(stamp, target, ts_format, zone_offset, frac_digits);
-}
-
-/**
- * unix_time_format:
- * @stamp: Timestamp to format
- * @target: Target storage for formatted timestamp
- * @ts_format: Specifies basic timestamp format (TS_FMT_BSD, TS_FMT_ISO)
- * @zone_offset: Specifies custom zone offset if @tz_convert == TZ_CNV_CUSTOM
- *
- * Emits the formatted version of @stamp into @target as specified by
- * @ts_format and @tz_convert.
- **/
-void
-append_format_wall_clock_time(const WallClockTime *wct, GString *target, gint ts_format, gint frac_digits)
+static void
+_append_format_prefix(const WallClockTime *wct, GString *target, gint ts_format)
 {
-  UnixTime ut = UNIX_TIME_INIT;
-
   switch (ts_format)
     {
     case TS_FMT_BSD:
@@ -106,7 +104,6 @@ append_format_wall_clock_time(const WallClockTime *wct, GString *target, gint ts
       format_uint32_padded(target, 2, '0', 10, wct->wct_min);
       g_string_append_c(target, ':');
       format_uint32_padded(target, 2, '0', 10, wct->wct_sec);
-      _append_frac_digits(wct->wct_usec, target, frac_digits);
       break;
     case TS_FMT_ISO:
       format_uint32_padded(target, 0, 0, 10, wct->wct_year + 1900);
@@ -120,9 +117,6 @@ append_format_wall_clock_time(const WallClockTime *wct, GString *target, gint ts
       format_uint32_padded(target, 2, '0', 10, wct->wct_min);
       g_string_append_c(target, ':');
       format_uint32_padded(target, 2, '0', 10, wct->wct_sec);
-
-      _append_frac_digits(wct->wct_usec, target, frac_digits);
-      append_format_zone_info(target, wct->wct_gmtoff);
       break;
     case TS_FMT_FULL:
       format_uint32_padded(target, 0, 0, 10, wct->wct_year + 1900);
@@ -136,8 +130,120 @@ append_format_wall_clock_time(const WallClockTime *wct, GString *target, gint ts
       format_uint32_padded(target, 2, '0', 10, wct->wct_min);
       g_string_append_c(target, ':');
       format_uint32_padded(target, 2, '0', 10, wct->wct_sec);
+      break;
+    default:
+      g_assert_not_reached();
+      break;
+    }
+}
+
+static void
+_append_format_suffix(const WallClockTime *wct, GString *target, gint ts_format)
+{
+  if (ts_format == TS_FMT_ISO)
+    append_format_zone_info(target, wct->wct_gmtoff);
+}
 
+static void
+_fill_cache_entry(FormattedStampCacheEntry *entry, const UnixTime *ut, glong gmtoff,
+                  const gchar *prefix, gsize prefix_len, const gchar *suffix, gsize suffix_len)
+{
+  entry->valid = FALSE;
+  if (prefix_len > sizeof(entry->prefix) || suffix_len > sizeof(entry->suffix))
+    return;
+
+  entry->wall_sec = ut->ut_sec + gmtoff;
+  entry->gmtoff = gmtoff;
+  memcpy(entry->prefix, prefix, prefix_len);
+  entry->prefix_len = prefix_len;
+  memcpy(entry->suffix, suffix, suffix_len);
+  entry->suffix_len = suffix_len;
+  entry->valid = TRUE;
+}
+
+static void
+_append_format_unix_time_cached(const UnixTime *ut, GString *target, gint ts_format, glong zone_offset,
+                                gint frac_digits)
+{
+  /* same as convert_unix_time_to_wall_clock_time_with_tz_override() */
+  glong gmtoff = zone_offset;
+  if (gmtoff == -1)
+    gmtoff = ut->ut_gmtoff;
+  if (gmtoff == -1)
+    gmtoff = get_local_timezone_ofs(ut->ut_sec);
+
+  gint64 wall_sec = ut->ut_sec + gmtoff;
+  FormattedStampCacheEntry *entry = &formatted_stamp_cache[ts_format][wall_sec & (FORMAT_CACHE_SLOTS - 1)];
+
+  if (entry->valid && entry->wall_sec == wall_sec && entry->gmtoff == gmtoff)
+    {
+      g_string_append_len(target, entry->prefix, entry->prefix_len);
+      _append_frac_digits(ut->ut_usec, target, frac_digits);
+      g_string_append_len(target, entry->suffix, entry->suffix_len);
+      return;
+    }
+
+  WallClockTime wct = WALL_CLOCK_TIME_INIT;
+  convert_unix_time_to_wall_clock_time_with_tz_override(ut, &wct, gmtoff);
+
+  gsize prefix_start = target->len;
+  _append_format_prefix(&wct, target, ts_format);
+  gsize prefix_len = target->len - prefix_start;
+
+  _append_frac_digits(ut->ut_usec, target, frac_digits);
+
+  gsize suffix_start = target->len;
+  _append_format_suffix(&wct, target, ts_format);
+
+  _fill_cache_entry(entry, ut, gmtoff, target->str + prefix_start, prefix_len,
+                    target->str + suffix_start, target->len - suffix_start);
+}
+
+void
+append_format_unix_time(const UnixTime *ut, GString *target, gint ts_format, glong zone_offset, gint frac_digits)
+{
+  if (ts_format == TS_FMT_UNIX)
+    {
+      format_uint32_padded(target, 0, 0, 10, (int) ut->ut_sec);
+      _append_frac_digits(ut->ut_usec, target, frac_digits);
+    }
+  else
+    {
+      g_assert(ts_format < FORMAT_CACHE_FORMATS);
+      _append_format_unix_time_cached(ut, target, ts_format, zone_offset, frac_digits);
+    }
+}
+
+void
+format_unix_time(const UnixTime *stamp, GString *target, gint ts_format, glong zone_offset, gint frac_digits)
+{
+  g_string_truncate(target, 0);
+  append_format_unix_time(stamp, target, ts_format, zone_offset, frac_digits);
+}
+
+/**
+ * unix_time_format:
+ * @stamp: Timestamp to format
+ * @target: Target storage for formatted timestamp
+ * @ts_format: Specifies basic timestamp format (TS_FMT_BSD, TS_FMT_ISO)
+ * @zone_offset: Specifies custom zone offset if @tz_convert == TZ_CNV_CUSTOM
+ *
+ * Emits the formatted version of @stamp into @target as specified by
+ * @ts_format and @tz_convert.
+ **/
+void
+append_format_wall_clock_time(const WallClockTime *wct, GString *target, gint ts_format, gint frac_digits)
+{
+  UnixTime ut = UNIX_TIME_INIT;
+
+  switch (ts_format)
+    {
+    case TS_FMT_BSD:
+    case TS_FMT_ISO:
+    case TS_FMT_FULL:
+      _append_format_prefix(wct, target, ts_format);
       _append_frac_digits(wct->wct_usec, target, frac_digits);
+      _append_format_suffix(wct, target, ts_format);
       break;
     case TS_FMT_UNIX:
       convert_wall_clock_time_to_unix_time(wct, &ut);
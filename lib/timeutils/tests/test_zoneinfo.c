@@ -0,0 +1,88 @@
+/*
+ * Copyright (c) 2024 One Identity LLC.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+#include <criterion/criterion.h>
+
+#include "timeutils/zoneinfo.h"
+
+/* EST5EDT switched to DST at Mar 10 2019 07:00:00 UTC and back at Nov 3
+ * 2019 06:00:00 UTC */
+#define DST_START 1552201200
+#define DST_END   1572760800
+
+static void
+_assert_offset(TimeZoneInfo *tz, time_t stamp, gint32 expected)
+{
+  gint32 offset = time_zone_info_get_offset(tz, stamp);
+
+  cr_assert_eq(offset, expected, "unexpected offset, stamp=%ld, offset=%d, expected=%d", (long) stamp, offset,
+               expected);
+}
+
+Test(zoneinfo, offset_follows_transitions)
+{
+  TimeZoneInfo *tz = time_zone_info_new("EST5EDT");
+  cr_assert(tz);
+
+  _assert_offset(tz, DST_START - 1, -5 * 3600);
+  _assert_offset(tz, DST_START, -4 * 3600);
+  _assert_offset(tz, DST_START - 3600, -5 * 3600);
+  _assert_offset(tz, DST_END - 1, -4 * 3600);
+  _assert_offset(tz, DST_END, -5 * 3600);
+  _assert_offset(tz, DST_START + 1, -4 * 3600);
+  _assert_offset(tz, DST_END + 86400, -5 * 3600);
+  _assert_offset(tz, DST_START - 86400, -5 * 3600);
+
+  time_zone_info_free(tz);
+}
+
+Test(zoneinfo, offsets_of_different_zones_are_not_mixed_up)
+{
+  TimeZoneInfo *zones[6];
+
+  for (gsize i = 0; i < G_N_ELEMENTS(zones); i++)
+    {
+      zones[i] = time_zone_info_new(i % 2 ? "EST5EDT" : "Europe/Budapest");
+      cr_assert(zones[i]);
+    }
+
+  for (gint round = 0; round < 2; round++)
+    {
+      for (gsize i = 0; i < G_N_ELEMENTS(zones); i++)
+        {
+          _assert_offset(zones[i], DST_START, i % 2 ? -4 * 3600 : 3600);
+          _assert_offset(zones[i], DST_END, i % 2 ? -5 * 3600 : 3600);
+        }
+    }
+
+  for (gsize i = 0; i < G_N_ELEMENTS(zones); i++)
+    time_zone_info_free(zones[i]);
+}
+
+Test(zoneinfo, fixed_offset)
+{
+  TimeZoneInfo *tz = time_zone_info_new("+05:30");
+  cr_assert(tz);
+
+  _assert_offset(tz, DST_START, 5 * 3600 + 30 * 60);
+  time_zone_info_free(tz);
+}
@@ -25,6 +25,7 @@
 #include "timeutils/zonedb.h"
 #include "reloc.h"
 #include "messages.h"
+#include "tls-support.h"
 
 #include <ctype.h>
 #include <string.h>
@@ -93,7 +94,7 @@ struct _ZoneInfo
 {
   Transition *transitions;
   gint64 timecnt;
-  gint32 last_transitions_index;
+  guint32 id;
 };
 
 struct _TimeZoneInfo
@@ -186,6 +187,11 @@ readchar(unsigned char **input)
   return c;
 }
 
+/* ZoneInfo instances are shared between threads, the offset cache below
+ * is per-thread and identifies them using a unique id, as the address of
+ * a freed instance may be reused by another zone after a reload */
+static gint zone_info_last_id;
+
 static ZoneInfo *
 zone_info_new(gint64 timecnt)
 {
@@ -193,7 +199,7 @@ zone_info_new(gint64 timecnt)
 
   self->transitions = g_new0(Transition, timecnt);
   self->timecnt = timecnt;
-  self->last_transitions_index = -1;
+  self->id = (guint32) g_atomic_int_add(&zone_info_last_id, 1) + 1;
   return self;
 }
 
@@ -440,32 +446,80 @@ error:
   return info;
 }
 
-static gint64
-zone_info_get_offset(ZoneInfo *self, gint64 timestamp)
+/* The offset of a zone does not change between two transitions, so each
+ * thread remembers the window [start, end) of the last transition it
+ * looked up for a handful of zones.  Timestamps of consecutive messages
+ * tend to fall into the same window, so in the common case this is a
+ * couple of comparisons instead of a search.  */
+typedef struct _ZoneOffsetCacheEntry
 {
-  gint32 i = 0;
+  guint32 zone_id;
+  gint64 start;
+  gint64 end;
+  gint32 gmtoffset;
+} ZoneOffsetCacheEntry;
 
-  if (self->transitions == NULL)
-    return 0;
+TLS_BLOCK_START
+{
+  ZoneOffsetCacheEntry zone_offset_cache[TZCACHE_SIZE];
+}
+TLS_BLOCK_END;
+
+#define zone_offset_cache __tls_deref(zone_offset_cache)
 
-  if (self->last_transitions_index != -1 &&
-      self->last_transitions_index < (self->timecnt - 1) &&
-      self->transitions[self->last_transitions_index].time <= timestamp &&
-      self->transitions[self->last_transitions_index + 1].time > timestamp)
+/* Returns the index of the transition in effect at timestamp, along with
+ * the window it is in effect for.  Timestamps outside of the
+ * [first, last] transition range use the last transition. */
+static gint64
+zone_info_find_transition(ZoneInfo *self, gint64 timestamp, gint64 *start, gint64 *end)
+{
+  gint64 last = self->timecnt - 1;
+
+  if (timestamp >= self->transitions[last].time)
     {
-      return  self->transitions[ self->last_transitions_index ].gmtoffset;
+      *start = self->transitions[last].time;
+      *end = G_MAXINT64;
+      return last;
     }
-  else
+  if (timestamp < self->transitions[0].time)
     {
-      for (i = 0; i < (self->timecnt - 1); i++)
-        if (self->transitions[i].time <= timestamp &&
-            self->transitions[i+1].time > timestamp)
-          break;
+      *start = G_MININT64;
+      *end = self->transitions[0].time;
+      return last;
+    }
 
-      self->last_transitions_index  = i;
+  /* transitions[lo].time <= timestamp < transitions[hi].time */
+  gint64 lo = 0, hi = last;
+  while (hi - lo > 1)
+    {
+      gint64 mid = lo + (hi - lo) / 2;
+
+      if (self->transitions[mid].time <= timestamp)
+        lo = mid;
+      else
+        hi = mid;
     }
 
-  return self->transitions[self->last_transitions_index].gmtoffset;
+  *start = self->transitions[lo].time;
+  *end = self->transitions[hi].time;
+  return lo;
+}
+
+static gint64
+zone_info_get_offset(ZoneInfo *self, gint64 timestamp)
+{
+  if (self->transitions == NULL)
+    return 0;
+
+  ZoneOffsetCacheEntry *entry = &zone_offset_cache[self->id & TZCACHE_SIZE_MASK];
+
+  if (entry->zone_id == self->id && entry->start <= timestamp && timestamp < entry->end)
+    return entry->gmtoffset;
+
+  gint64 i = zone_info_find_transition(self, timestamp, &entry->start, &entry->end);
+  entry->zone_id = self->id;
+  entry->gmtoffset = self->transitions[i].gmtoffset;
+  return entry->gmtoffset;
 }
 
 static gboolean
@@ -26,6 +26,51 @@
 #include "messages.h"
 
 #include <unistd.h>
+#include <string.h>
+#include <errno.h>
+
+/*
+ * Used for transports without a writev() implementation (e.g. TLS): the
+ * buffers are copied into a single one, so that they are still sent with a
+ * single write() call.  Transports where a write() is not partial (like
+ * SSL_write()) rely on this to write the whole batch or nothing.
+ */
+gssize
+log_transport_writev_coalesced(LogTransport *self, struct iovec *iov, gint iov_count)
+{
+  if (iov_count == 1)
+    return log_transport_write(self, iov[0].iov_base, iov[0].iov_len);
+
+  gsize total = 0;
+  for (gint i = 0; i < iov_count; i++)
+    total += iov[i].iov_len;
+
+  guchar *buf = g_malloc(total);
+  gsize pos = 0;
+  for (gint i = 0; i < iov_count; i++)
+    {
+      memcpy(buf + pos, iov[i].iov_base, iov[i].iov_len);
+      pos += iov[i].iov_len;
+    }
+
+  gssize rc = log_transport_write(self, buf, total);
+  gint saved_errno = errno;
+  g_free(buf);
+  errno = saved_errno;
+  return rc;
+}
+
+gssize
+log_transport_writev_and_sync(LogTransport *self, struct iovec *iov, gint iov_count)
+{
+  if (self->writev_and_sync)
+    return self->writev_and_sync(self, iov, iov_count);
+
+  gssize rc = log_transport_writev(self, iov, iov_count);
+  if (rc > 0)
+    fsync(self->fd);
+  return rc;
+}
 
 void
 log_transport_free_method(LogTransport *s)
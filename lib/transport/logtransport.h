@@ -38,6 +38,12 @@ struct _LogTransport
   gssize (*read)(LogTransport *self, gpointer buf, gsize count, LogTransportAuxData *aux);
   gssize (*write)(LogTransport *self, const gpointer buf, gsize count);
   gssize (*writev)(LogTransport *self, struct iovec *iov, gint iov_count);
+  /* optional, writev() followed by fsync(), submitted to the kernel together */
+  gssize (*writev_and_sync)(LogTransport *self, struct iovec *iov, gint iov_count);
+  /* optional, sends each iovec as a separate datagram, returns the number of datagrams sent */
+  gint (*write_datagrams)(LogTransport *self, struct iovec *datagrams, gint count);
+  /* optional, TRUE if data was already received and is queued within the transport */
+  gboolean (*has_pending_input)(LogTransport *self);
   void (*free_fn)(LogTransport *self);
 };
 
@@ -47,18 +53,41 @@ log_transport_write(LogTransport *self, const gpointer buf, gsize count)
   return self->write(self, buf, count);
 }
 
+gssize log_transport_writev_coalesced(LogTransport *self, struct iovec *iov, gint iov_count);
+
 static inline gssize
 log_transport_writev(LogTransport *self, struct iovec *iov, gint iov_count)
 {
+  if (!self->writev)
+    return log_transport_writev_coalesced(self, iov, iov_count);
   return self->writev(self, iov, iov_count);
 }
 
+static inline gint
+log_transport_write_datagrams(LogTransport *self, struct iovec *datagrams, gint count)
+{
+  if (self->write_datagrams)
+    return self->write_datagrams(self, datagrams, count);
+
+  if (log_transport_write(self, datagrams[0].iov_base, datagrams[0].iov_len) < 0)
+    return -1;
+  return 1;
+}
+
 static inline gssize
 log_transport_read(LogTransport *self, gpointer buf, gsize count, LogTransportAuxData *aux)
 {
   return self->read(self, buf, count, aux);
 }
 
+static inline gboolean
+log_transport_has_pending_input(LogTransport *self)
+{
+  return self->has_pending_input && self->has_pending_input(self);
+}
+
+gssize log_transport_writev_and_sync(LogTransport *self, struct iovec *iov, gint iov_count);
+
 void log_transport_init_instance(LogTransport *s, gint fd);
 void log_transport_free_method(LogTransport *s);
 void log_transport_free(LogTransport *s);
@@ -0,0 +1,252 @@
+/*
+ * Copyright (c) 2024 One Identity LLC.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+
+#include <criterion/criterion.h>
+
+#include "transport/tls-context.h"
+#include "transport/tls-session.h"
+#include "persist-state.h"
+#include "apphook.h"
+
+#include <unistd.h>
+#include <string.h>
+
+static guint8 ticket_keys[TLS_SESSION_TICKET_KEYS_LEN];
+
+static TLSContext *
+_create_server_context_with_ticket_key_file(const gchar *ticket_key_file, gsize keys_length)
+{
+  for (gsize i = 0; i < sizeof(ticket_keys); i++)
+    ticket_keys[i] = (guint8) i;
+  cr_assert(g_file_set_contents(ticket_key_file, (const gchar *) ticket_keys, keys_length, NULL));
+
+  TLSContext *context = tls_context_new(TM_SERVER, "test-location");
+  tls_context_set_session_tickets(context, TRUE);
+  tls_context_set_session_ticket_key_file(context, ticket_key_file);
+  return context;
+}
+
+Test(tls_context, ticket_keys_are_loaded_from_the_key_file)
+{
+  const gchar *ticket_key_file = "test_tls_context_ticket.key";
+  TLSContext *context = _create_server_context_with_ticket_key_file(ticket_key_file, TLS_SESSION_TICKET_KEYS_LEN);
+
+  cr_assert(tls_context_load_session_ticket_keys(context, NULL, NULL));
+  cr_assert(context->resumption.ticket_keys_loaded);
+  cr_assert_arr_eq(context->resumption.ticket_keys, ticket_keys, TLS_SESSION_TICKET_KEYS_LEN);
+
+  tls_context_unref(context);
+  unlink(ticket_key_file);
+}
+
+Test(tls_context, ticket_key_file_of_invalid_length_is_rejected)
+{
+  const gchar *ticket_key_file = "test_tls_context_short_ticket.key";
+  TLSContext *context = _create_server_context_with_ticket_key_file(ticket_key_file, TLS_SESSION_TICKET_KEYS_LEN - 1);
+
+  cr_assert_not(tls_context_load_session_ticket_keys(context, NULL, NULL));
+  cr_assert_not(context->resumption.ticket_keys_loaded);
+
+  tls_context_unref(context);
+  unlink(ticket_key_file);
+}
+
+static TLSContext *
+_create_server_context_with_session_tickets(gint rotation)
+{
+  TLSContext *context = tls_context_new(TM_SERVER, "test-location");
+  tls_context_set_session_tickets(context, TRUE);
+  tls_context_set_session_ticket_key_rotation(context, rotation);
+  return context;
+}
+
+Test(tls_context, generated_ticket_keys_are_kept_in_the_persist_file)
+{
+  const gchar *persist_file = "test_tls_context_ticket.persist";
+  unlink(persist_file);
+
+  PersistState *state = persist_state_new(persist_file);
+  cr_assert(persist_state_start(state));
+
+  TLSContext *context = _create_server_context_with_session_tickets(3600);
+  cr_assert(tls_context_load_session_ticket_keys(context, state, "test.session_ticket_keys"));
+  cr_assert(context->resumption.ticket_keys_loaded);
+
+  TLSContext *other_context = _create_server_context_with_session_tickets(3600);
+  cr_assert(tls_context_load_session_ticket_keys(other_context, state, "test.session_ticket_keys"));
+  cr_assert_arr_eq(context->resumption.ticket_keys, other_context->resumption.ticket_keys,
+                   TLS_SESSION_TICKET_KEYS_LEN);
+
+  tls_context_unref(other_context);
+  tls_context_unref(context);
+  persist_state_free(state);
+  unlink(persist_file);
+}
+
+Test(tls_context, ticket_keys_are_not_persisted_without_session_tickets)
+{
+  const gchar *persist_file = "test_tls_context_no_ticket.persist";
+  unlink(persist_file);
+
+  PersistState *state = persist_state_new(persist_file);
+  cr_assert(persist_state_start(state));
+
+  TLSContext *context = tls_context_new(TM_SERVER, "test-location");
+  cr_assert(tls_context_load_session_ticket_keys(context, state, "test.session_ticket_keys"));
+  cr_assert_not(context->resumption.ticket_keys_loaded);
+
+  gsize size;
+  guint8 version;
+  cr_assert_eq(persist_state_lookup_entry(state, "test.session_ticket_keys", &size, &version), 0);
+
+  tls_context_unref(context);
+  persist_state_free(state);
+  unlink(persist_file);
+}
+
+Test(tls_context, expired_ticket_keys_are_rotated_and_the_previous_ones_are_persisted)
+{
+  const gchar *persist_file = "test_tls_context_rotated_ticket.persist";
+  unlink(persist_file);
+
+  PersistState *state = persist_state_new(persist_file);
+  cr_assert(persist_state_start(state));
+
+  TLSContext *context = _create_server_context_with_session_tickets(3600);
+  cr_assert(tls_context_load_session_ticket_keys(context, state, "test.session_ticket_keys"));
+  cr_assert_not(context->resumption.previous_ticket_keys_valid);
+
+  guint8 first_keys[TLS_SESSION_TICKET_KEYS_LEN];
+  memcpy(first_keys, context->resumption.ticket_keys, sizeof(first_keys));
+
+  /* pretend that the keys were created one interval ago */
+  context->resumption.ticket_keys_created -= 3600;
+  tls_context_save_session_ticket_keys(context, state, "test.session_ticket_keys");
+
+  TLSContext *reloaded_context = _create_server_context_with_session_tickets(3600);
+  cr_assert(tls_context_load_session_ticket_keys(reloaded_context, state, "test.session_ticket_keys"));
+  cr_assert(reloaded_context->resumption.previous_ticket_keys_valid);
+  cr_assert_arr_eq(reloaded_context->resumption.previous_ticket_keys, first_keys, TLS_SESSION_TICKET_KEYS_LEN);
+  cr_assert_arr_neq(reloaded_context->resumption.ticket_keys, first_keys, TLS_SESSION_TICKET_KEYS_LEN);
+
+  /* the rotated keys were written back */
+  TLSContext *restarted_context = _create_server_context_with_session_tickets(3600);
+  cr_assert(tls_context_load_session_ticket_keys(restarted_context, state, "test.session_ticket_keys"));
+  cr_assert_arr_eq(restarted_context->resumption.ticket_keys, reloaded_context->resumption.ticket_keys,
+                   TLS_SESSION_TICKET_KEYS_LEN);
+  cr_assert_arr_eq(restarted_context->resumption.previous_ticket_keys, first_keys, TLS_SESSION_TICKET_KEYS_LEN);
+
+  tls_context_unref(restarted_context);
+  tls_context_unref(reloaded_context);
+  tls_context_unref(context);
+  persist_state_free(state);
+  unlink(persist_file);
+}
+
+Test(tls_context, ktls_is_disabled_by_default)
+{
+  TLSContext *context = tls_context_new(TM_CLIENT, "test-location");
+
+  cr_assert_not(context->ktls);
+  cr_assert_eq(tls_context_setup_context(context), TLS_CONTEXT_SETUP_OK);
+#ifdef SSL_OP_ENABLE_KTLS
+  cr_assert_not(SSL_CTX_get_options(context->ssl_ctx) & SSL_OP_ENABLE_KTLS);
+#endif
+
+  tls_context_unref(context);
+}
+
+#ifdef SSL_OP_ENABLE_KTLS
+
+Test(tls_context, ktls_is_enabled_on_the_context_and_its_sessions)
+{
+  TLSContext *context = tls_context_new(TM_CLIENT, "test-location");
+
+  cr_assert(tls_context_set_ktls(context, TRUE, NULL));
+  cr_assert_eq(tls_context_setup_context(context), TLS_CONTEXT_SETUP_OK);
+  cr_assert(SSL_CTX_get_options(context->ssl_ctx) & SSL_OP_ENABLE_KTLS);
+
+  TLSSession *session = tls_context_setup_session(context);
+  cr_assert_not_null(session);
+  cr_assert(SSL_get_options(session->ssl) & SSL_OP_ENABLE_KTLS);
+
+  /* offload is only recorded when the handshake completes */
+  cr_assert_not(tls_session_is_ktls_active(session));
+
+  tls_session_free(session);
+  tls_context_unref(context);
+}
+
+#else
+
+Test(tls_context, ktls_is_rejected_without_openssl_support)
+{
+  TLSContext *context = tls_context_new(TM_CLIENT, "test-location");
+  GError *error = NULL;
+
+  cr_assert(tls_context_set_ktls(context, FALSE, &error));
+  cr_assert_null(error);
+
+  cr_assert_not(tls_context_set_ktls(context, TRUE, &error));
+  cr_assert(g_error_matches(error, TLSCONTEXT_ERROR, TLSCONTEXT_UNSUPPORTED));
+  cr_assert_not(context->ktls);
+
+  g_clear_error(&error);
+  tls_context_unref(context);
+}
+
+#endif
+
+#if OPENSSL_VERSION_NUMBER >= 0x10101000L
+
+Test(tls_context, keylog_file_keeps_the_resumption_state)
+{
+  const gchar *ticket_key_file = "test_tls_context_keylog_ticket.key";
+  TLSContext *context = _create_server_context_with_ticket_key_file(ticket_key_file, TLS_SESSION_TICKET_KEYS_LEN);
+  cr_assert(tls_context_load_session_ticket_keys(context, NULL, NULL));
+
+  cr_assert(tls_context_set_keylog_file(context, "test_tls_context.keylog", NULL));
+  cr_assert_str_eq(context->resumption.ticket_key_file, ticket_key_file);
+  cr_assert_arr_eq(context->resumption.ticket_keys, ticket_keys, TLS_SESSION_TICKET_KEYS_LEN);
+
+  tls_context_unref(context);
+  unlink(ticket_key_file);
+}
+
+Test(tls_context, keylog_file_keeps_the_client_session_to_resume)
+{
+  TLSContext *context = tls_context_new(TM_CLIENT, "test-location");
+  SSL_SESSION *session = SSL_SESSION_new();
+  context->resumption.client_session = session;
+
+  cr_assert(tls_context_set_keylog_file(context, "test_tls_context.keylog", NULL));
+  cr_assert_eq(context->resumption.client_session, session);
+
+  /* the session is freed along with the context */
+  tls_context_unref(context);
+}
+
+#endif
+
+TestSuite(tls_context, .init = app_startup, .fini = app_shutdown);
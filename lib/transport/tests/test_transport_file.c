@@ -0,0 +1,102 @@
+/*
+ * Copyright (c) 2024 One Identity LLC.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#include <criterion/criterion.h>
+
+#include "transport/transport-file.h"
+#include "apphook.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+
+static gchar filename[] = "test_transport_file.XXXXXX";
+
+static LogTransportFile *
+_open_file_of_size(gsize size)
+{
+  gchar *contents = g_malloc0(size);
+  gint fd = mkstemp(filename);
+
+  cr_assert_geq(fd, 0);
+  cr_assert_eq(write(fd, contents, size), size);
+  lseek(fd, 0, SEEK_SET);
+  g_free(contents);
+
+  return (LogTransportFile *) log_transport_file_new(fd);
+}
+
+static void
+_close_file(LogTransportFile *transport)
+{
+  log_transport_free(&transport->super);
+  unlink(filename);
+}
+
+Test(transport_file, test_reading_far_behind_eof_catches_up_until_eof)
+{
+  LogTransportFile *transport = _open_file_of_size(8192);
+  gchar buf[4096];
+
+  log_transport_file_set_catch_up_threshold(&transport->super, 4096);
+
+  cr_assert_eq(log_transport_read(&transport->super, buf, 1024, NULL), 1024);
+  cr_assert(transport->catch_up.active);
+  cr_assert_eq(transport->catch_up.pos, 1024);
+  cr_assert_eq(transport->catch_up.end, 8192);
+
+  cr_assert_eq(log_transport_read(&transport->super, buf, sizeof(buf), NULL), 4096);
+  cr_assert(transport->catch_up.active);
+  cr_assert_eq(log_transport_read(&transport->super, buf, sizeof(buf), NULL), 3072);
+  cr_assert_not(transport->catch_up.active);
+
+  _close_file(transport);
+}
+
+Test(transport_file, test_reading_close_to_eof_does_not_catch_up)
+{
+  LogTransportFile *transport = _open_file_of_size(8192);
+  gchar buf[4096];
+
+  log_transport_file_set_catch_up_threshold(&transport->super, 4096);
+  lseek(transport->super.fd, 6144, SEEK_SET);
+
+  cr_assert_eq(log_transport_read(&transport->super, buf, 1024, NULL), 1024);
+  cr_assert_not(transport->catch_up.active);
+
+  _close_file(transport);
+}
+
+Test(transport_file, test_catch_up_is_disabled_by_default)
+{
+  LogTransportFile *transport = _open_file_of_size(8192);
+  gchar buf[1024];
+
+  cr_assert_eq(log_transport_read(&transport->super, buf, sizeof(buf), NULL), 1024);
+  cr_assert_not(transport->catch_up.active);
+
+  _close_file(transport);
+}
+
+TestSuite(transport_file, .init = app_startup, .fini = app_shutdown);
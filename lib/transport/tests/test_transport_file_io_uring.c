@@ -0,0 +1,93 @@
+/*
+ * Copyright (c) 2024 One Identity LLC.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#include <criterion/criterion.h>
+
+#include "transport/transport-file-io-uring.h"
+#include "apphook.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+
+static gchar filename[] = "test_transport_file_io_uring.XXXXXX";
+
+static LogTransport *
+_construct_transport(gint fd)
+{
+  LogTransport *transport = log_transport_file_io_uring_new(fd);
+
+  /* io_uring might be missing from the build or refused by the kernel */
+  if (!transport)
+    transport = log_transport_file_new(fd);
+  return transport;
+}
+
+static void
+_assert_file_contents(const gchar *expected)
+{
+  gchar *contents = NULL;
+
+  cr_assert(g_file_get_contents(filename, &contents, NULL, NULL));
+  cr_assert_str_eq(contents, expected);
+  g_free(contents);
+}
+
+Test(transport_file_io_uring, test_writev_and_sync_appends_to_the_file)
+{
+  gint fd = mkstemp(filename);
+  cr_assert_geq(fd, 0);
+  close(fd);
+
+  fd = open(filename, O_WRONLY | O_APPEND);
+  LogTransport *transport = _construct_transport(fd);
+
+  struct iovec iov[] =
+  {
+    { .iov_base = (gchar *) "foo\n", .iov_len = 4 },
+    { .iov_base = (gchar *) "bar\n", .iov_len = 4 },
+  };
+
+  cr_assert_eq(log_transport_writev_and_sync(transport, iov, G_N_ELEMENTS(iov)), 8);
+  cr_assert_eq(log_transport_writev_and_sync(transport, iov, 1), 4);
+  _assert_file_contents("foo\nbar\nfoo\n");
+
+  log_transport_free(transport);
+  unlink(filename);
+}
+
+Test(transport_file_io_uring, test_write_errors_are_reported_through_errno)
+{
+  gint fd = open("/dev/null", O_RDONLY);
+  LogTransport *transport = _construct_transport(fd);
+  struct iovec iov = { .iov_base = (gchar *) "foo\n", .iov_len = 4 };
+
+  cr_assert_eq(log_transport_writev_and_sync(transport, &iov, 1), -1);
+  cr_assert_eq(errno, EBADF);
+
+  log_transport_free(transport);
+}
+
+TestSuite(transport_file_io_uring, .init = app_startup, .fini = app_shutdown);
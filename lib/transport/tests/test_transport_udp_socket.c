@@ -0,0 +1,213 @@
+/*
+ * Copyright (c) 2024 One Identity LLC.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#include <criterion/criterion.h>
+
+#include "transport/transport-udp-socket.h"
+#include "gsockaddr.h"
+#include "fdhelpers.h"
+#include "apphook.h"
+
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <errno.h>
+#include <unistd.h>
+
+static gint server_fd = -1;
+static gint client_fd = -1;
+
+static void
+_send_datagram(const gchar *payload)
+{
+  cr_assert_eq(send(client_fd, payload, strlen(payload), 0), strlen(payload));
+}
+
+static gchar *
+_read_datagram(LogTransport *transport, LogTransportAuxData *aux)
+{
+  gchar buf[128];
+  gssize rc = log_transport_read(transport, buf, sizeof(buf), aux);
+
+  if (rc < 0)
+    return NULL;
+  return g_strndup(buf, rc);
+}
+
+static void
+_assert_datagram(LogTransport *transport, const gchar *expected)
+{
+  LogTransportAuxData aux;
+
+  log_transport_aux_data_init(&aux);
+  gchar *datagram = _read_datagram(transport, &aux);
+
+  cr_assert_str_eq(datagram, expected);
+  cr_assert_not_null(aux.peer_addr, "peer address is not extracted for queued datagrams");
+  g_free(datagram);
+  log_transport_aux_data_destroy(&aux);
+}
+
+static void
+_assert_no_more_datagrams(LogTransport *transport)
+{
+  gchar buf[128];
+
+  cr_assert_not(log_transport_has_pending_input(transport));
+  cr_assert_eq(log_transport_read(transport, buf, sizeof(buf), NULL), -1);
+  cr_assert_eq(errno, EAGAIN);
+}
+
+Test(transport_udp_socket, test_datagrams_are_returned_one_by_one)
+{
+  LogTransport *transport = log_transport_udp_socket_new(server_fd);
+
+  _send_datagram("foo");
+  _send_datagram("bar");
+
+  _assert_datagram(transport, "foo");
+  _assert_datagram(transport, "bar");
+  _assert_no_more_datagrams(transport);
+  log_transport_free(transport);
+}
+
+#ifdef SYSLOG_NG_HAVE_RECVMMSG
+
+Test(transport_udp_socket, test_batched_datagrams_are_queued_within_the_transport)
+{
+  LogTransport *transport = log_transport_udp_socket_new(server_fd);
+  log_transport_udp_socket_set_receive_batch_size(transport, 4);
+
+  _send_datagram("msg1");
+  _send_datagram("msg2");
+  _send_datagram("");
+  _send_datagram("msg3");
+  _send_datagram("msg4");
+  _send_datagram("msg5");
+
+  _assert_datagram(transport, "msg1");
+  cr_assert(log_transport_has_pending_input(transport));
+  _assert_datagram(transport, "msg2");
+  _assert_datagram(transport, "msg3");
+  cr_assert_not(log_transport_has_pending_input(transport));
+
+  _assert_datagram(transport, "msg4");
+  _assert_datagram(transport, "msg5");
+  _assert_no_more_datagrams(transport);
+  log_transport_free(transport);
+}
+
+Test(transport_udp_socket, test_queued_datagrams_are_truncated_to_the_read_buffer)
+{
+  LogTransport *transport = log_transport_udp_socket_new(server_fd);
+  log_transport_udp_socket_set_receive_batch_size(transport, 4);
+
+  _send_datagram("0123456789");
+  _send_datagram("0123456789");
+
+  gchar buf[4];
+  cr_assert_eq(log_transport_read(transport, buf, 4, NULL), 4);
+  cr_assert_eq(log_transport_read(transport, buf, 2, NULL), 2);
+  cr_assert(memcmp(buf, "01", 2) == 0);
+  _assert_no_more_datagrams(transport);
+  log_transport_free(transport);
+}
+
+#endif
+
+#ifdef SYSLOG_NG_HAVE_SENDMMSG
+
+static void
+_assert_received_datagram(const gchar *expected)
+{
+  gchar buf[128];
+  gssize len = recv(server_fd, buf, sizeof(buf), 0);
+
+  cr_assert_eq(len, strlen(expected));
+  cr_assert(memcmp(buf, expected, len) == 0);
+}
+
+Test(transport_udp_socket, test_write_datagrams_sends_each_iovec_as_a_separate_datagram)
+{
+  LogTransport *transport = log_transport_udp_socket_new(dup(client_fd));
+  struct iovec datagrams[] =
+  {
+    { .iov_base = (gchar *) "foo1", .iov_len = 4 },
+    { .iov_base = (gchar *) "foo2", .iov_len = 4 },
+    { .iov_base = (gchar *) "foo3", .iov_len = 4 },
+    { .iov_base = (gchar *) "bar", .iov_len = 3 },
+    { .iov_base = (gchar *) "foo4", .iov_len = 4 },
+  };
+  gint sent = 0;
+
+  while (sent < G_N_ELEMENTS(datagrams))
+    {
+      gint rc = log_transport_write_datagrams(transport, &datagrams[sent], G_N_ELEMENTS(datagrams) - sent);
+      cr_assert_gt(rc, 0);
+      sent += rc;
+    }
+
+  g_fd_set_nonblock(server_fd, FALSE);
+  _assert_received_datagram("foo1");
+  _assert_received_datagram("foo2");
+  _assert_received_datagram("foo3");
+  _assert_received_datagram("bar");
+  _assert_received_datagram("foo4");
+
+  close(server_fd);
+  log_transport_free(transport);
+}
+
+#endif
+
+static void
+setup(void)
+{
+  app_startup();
+
+  GSockAddr *addr = g_sockaddr_inet_new("127.0.0.1", 0);
+
+  server_fd = socket(AF_INET, SOCK_DGRAM, 0);
+  cr_assert_geq(server_fd, 0);
+  cr_assert_eq(bind(server_fd, &addr->sa, addr->salen), 0);
+  g_sockaddr_unref(addr);
+
+  struct sockaddr_in sin;
+  socklen_t sin_len = sizeof(sin);
+  cr_assert_eq(getsockname(server_fd, (struct sockaddr *) &sin, &sin_len), 0);
+
+  client_fd = socket(AF_INET, SOCK_DGRAM, 0);
+  cr_assert_geq(client_fd, 0);
+  cr_assert_eq(connect(client_fd, (struct sockaddr *) &sin, sin_len), 0);
+
+  g_fd_set_nonblock(server_fd, TRUE);
+}
+
+static void
+teardown(void)
+{
+  close(client_fd);
+  app_shutdown();
+}
+
+TestSuite(transport_udp_socket, .init = setup, .fini = teardown);
@@ -25,6 +25,8 @@
 #include "messages.h"
 #include "compat/openssl_support.h"
 #include "secret-storage/secret-storage.h"
+#include "persistable-state-header.h"
+#include "timeutils/cache.h"
 
 #include <sys/socket.h>
 #include <arpa/inet.h>
@@ -36,6 +38,10 @@
 #include <openssl/rand.h>
 #include <openssl/pkcs12.h>
 #include <openssl/ocsp.h>
+#include <openssl/hmac.h>
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+#include <openssl/core_names.h>
+#endif
 
 typedef enum
 {
@@ -148,10 +154,328 @@ _setup_keylog_file(TLSContext *self)
 
 #endif
 
+#define TLS_SESSION_TICKET_KEY_NAME_LEN 16
+#define TLS_SESSION_TICKET_HMAC_KEY(keys) ((keys) + TLS_SESSION_TICKET_KEY_NAME_LEN)
+#define TLS_SESSION_TICKET_HMAC_KEY_LEN 32
+#define TLS_SESSION_TICKET_AES_KEY(keys) ((keys) + TLS_SESSION_TICKET_KEY_NAME_LEN + TLS_SESSION_TICKET_HMAC_KEY_LEN)
+
+#define TLS_SESSION_TICKET_KEYS_STATE_VERSION 1
+
+typedef struct _TLSSessionTicketKeysState
+{
+  PersistableStateHeader header;
+  guint8 current[TLS_SESSION_TICKET_KEYS_LEN];
+  guint8 previous[TLS_SESSION_TICKET_KEYS_LEN];
+  guint8 previous_valid;
+  gint64 created;
+} TLSSessionTicketKeysState;
+
+static gboolean
+_load_session_ticket_keys_from_file(TLSContext *self)
+{
+  gchar *contents;
+  gsize length;
+  GError *error = NULL;
+
+  if (!g_file_get_contents(self->resumption.ticket_key_file, &contents, &length, &error))
+    {
+      msg_error("Error reading session-ticket-key-file()",
+                evt_tag_str(EVT_TAG_FILENAME, self->resumption.ticket_key_file),
+                evt_tag_str("error", error->message),
+                tls_context_format_location_tag(self));
+      g_error_free(error);
+      return FALSE;
+    }
+
+  if (length != TLS_SESSION_TICKET_KEYS_LEN)
+    {
+      msg_error("Invalid session-ticket-key-file(), it must contain exactly 80 bytes of random data",
+                evt_tag_str(EVT_TAG_FILENAME, self->resumption.ticket_key_file),
+                evt_tag_long("length", length),
+                tls_context_format_location_tag(self));
+      g_free(contents);
+      return FALSE;
+    }
+
+  memcpy(self->resumption.ticket_keys, contents, TLS_SESSION_TICKET_KEYS_LEN);
+  memset(contents, 0, length);
+  g_free(contents);
+  return TRUE;
+}
+
+/*
+ * Keys read from session-ticket-key-file() are shared with other servers,
+ * they are never rotated by us.
+ */
+static gboolean
+_rotate_session_ticket_keys(TLSContext *self, gint64 now)
+{
+  if (self->resumption.ticket_key_file || self->resumption.ticket_key_rotation <= 0)
+    return TRUE;
+
+  gint64 age = now - self->resumption.ticket_keys_created;
+  if (age < self->resumption.ticket_key_rotation)
+    return TRUE;
+
+  guint8 new_keys[TLS_SESSION_TICKET_KEYS_LEN];
+  if (RAND_bytes(new_keys, sizeof(new_keys)) != 1)
+    return FALSE;
+
+  /* after a long downtime the previous keys would have expired as well */
+  self->resumption.previous_ticket_keys_valid = age < 2 * (gint64) self->resumption.ticket_key_rotation;
+  memcpy(self->resumption.previous_ticket_keys, self->resumption.ticket_keys, TLS_SESSION_TICKET_KEYS_LEN);
+  memcpy(self->resumption.ticket_keys, new_keys, TLS_SESSION_TICKET_KEYS_LEN);
+  OPENSSL_cleanse(new_keys, sizeof(new_keys));
+  self->resumption.ticket_keys_created = now;
+  return TRUE;
+}
+
+static gboolean
+_load_session_ticket_keys_from_persist_state(TLSContext *self, PersistState *state, const gchar *persist_name)
+{
+  gsize size;
+  guint8 version;
+  PersistEntryHandle handle = persist_state_lookup_entry(state, persist_name, &size, &version);
+
+  if (handle && size == sizeof(TLSSessionTicketKeysState))
+    {
+      TLSSessionTicketKeysState *keys_state = persist_state_map_entry(state, handle);
+      if (keys_state->header.version == TLS_SESSION_TICKET_KEYS_STATE_VERSION)
+        {
+          memcpy(self->resumption.ticket_keys, keys_state->current, TLS_SESSION_TICKET_KEYS_LEN);
+          memcpy(self->resumption.previous_ticket_keys, keys_state->previous, TLS_SESSION_TICKET_KEYS_LEN);
+          self->resumption.previous_ticket_keys_valid = keys_state->previous_valid;
+          self->resumption.ticket_keys_created = keys_state->created;
+          persist_state_unmap_entry(state, handle);
+          return _rotate_session_ticket_keys(self, cached_g_current_time_sec());
+        }
+      persist_state_unmap_entry(state, handle);
+    }
+
+  self->resumption.previous_ticket_keys_valid = FALSE;
+  self->resumption.ticket_keys_created = cached_g_current_time_sec();
+  return RAND_bytes(self->resumption.ticket_keys, TLS_SESSION_TICKET_KEYS_LEN) == 1;
+}
+
+static gboolean
+_are_session_ticket_keys_persisted(TLSContext *self)
+{
+  return self->resumption.ticket_keys_loaded && !self->resumption.ticket_key_file;
+}
+
+/*
+ * Tickets are only encrypted with keys that we manage when TLS 1.3 tickets
+ * are enabled with session-tickets(yes), or when the keys are read from
+ * session-ticket-key-file() (so that a group of servers can share them).
+ * Otherwise OpenSSL generates its own keys, which are lost on reload.
+ *
+ * Managed keys (but not the ones read from the file) are rotated every
+ * session-ticket-key-rotation() seconds, the previous keys are still
+ * accepted until the next rotation, so tickets are renewed instead of
+ * being rejected.  Both are stored in the persist file (in plaintext, just
+ * like the rest of the persist file), so they survive reloads and restarts.
+ */
+gboolean
+tls_context_load_session_ticket_keys(TLSContext *self, PersistState *state, const gchar *persist_name)
+{
+  if (self->mode != TM_SERVER)
+    return TRUE;
+
+  gboolean loaded;
+  if (self->resumption.ticket_key_file)
+    loaded = _load_session_ticket_keys_from_file(self);
+  else if (state && self->resumption.session_tickets)
+    loaded = _load_session_ticket_keys_from_persist_state(self, state, persist_name);
+  else
+    return TRUE;
+
+  g_mutex_lock(&self->resumption.ticket_keys_lock);
+  self->resumption.ticket_keys_loaded = loaded;
+  g_mutex_unlock(&self->resumption.ticket_keys_lock);
+
+  if (!loaded)
+    return FALSE;
+
+  tls_context_save_session_ticket_keys(self, state, persist_name);
+  return TRUE;
+}
+
+/* the keys may have been rotated since they were loaded */
+void
+tls_context_save_session_ticket_keys(TLSContext *self, PersistState *state, const gchar *persist_name)
+{
+  if (!state || !_are_session_ticket_keys_persisted(self))
+    return;
+
+  PersistEntryHandle handle = persist_state_alloc_entry(state, persist_name, sizeof(TLSSessionTicketKeysState));
+  if (!handle)
+    {
+      msg_error("Error storing TLS session ticket keys in the persist file",
+                tls_context_format_location_tag(self));
+      return;
+    }
+
+  TLSSessionTicketKeysState *keys_state = persist_state_map_entry(state, handle);
+  keys_state->header.version = TLS_SESSION_TICKET_KEYS_STATE_VERSION;
+
+  g_mutex_lock(&self->resumption.ticket_keys_lock);
+  memcpy(keys_state->current, self->resumption.ticket_keys, TLS_SESSION_TICKET_KEYS_LEN);
+  memcpy(keys_state->previous, self->resumption.previous_ticket_keys, TLS_SESSION_TICKET_KEYS_LEN);
+  keys_state->previous_valid = self->resumption.previous_ticket_keys_valid;
+  keys_state->created = self->resumption.ticket_keys_created;
+  g_mutex_unlock(&self->resumption.ticket_keys_lock);
+
+  persist_state_unmap_entry(state, handle);
+}
+
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+
+typedef EVP_MAC_CTX TLSSessionTicketHMACContext;
+
+static gboolean
+_init_session_ticket_hmac(TLSSessionTicketHMACContext *hmac_ctx, const guint8 *keys)
+{
+  OSSL_PARAM params[] =
+  {
+    OSSL_PARAM_construct_octet_string(OSSL_MAC_PARAM_KEY, (void *) TLS_SESSION_TICKET_HMAC_KEY(keys),
+                                      TLS_SESSION_TICKET_HMAC_KEY_LEN),
+    OSSL_PARAM_construct_utf8_string(OSSL_MAC_PARAM_DIGEST, "SHA256", 0),
+    OSSL_PARAM_construct_end()
+  };
+
+  return EVP_MAC_CTX_set_params(hmac_ctx, params) == 1;
+}
+
+#else
+
+typedef HMAC_CTX TLSSessionTicketHMACContext;
+
+static gboolean
+_init_session_ticket_hmac(TLSSessionTicketHMACContext *hmac_ctx, const guint8 *keys)
+{
+  return HMAC_Init_ex(hmac_ctx, TLS_SESSION_TICKET_HMAC_KEY(keys), TLS_SESSION_TICKET_HMAC_KEY_LEN,
+                      EVP_sha256(), NULL) == 1;
+}
+
+#endif
+
+/*
+ * Returns the keys to use for the ticket: 1 with the current keys, 2 with
+ * the previous ones (the client gets a new ticket) and 0 if the ticket was
+ * encrypted with unknown keys, which means a full handshake.
+ */
+static int
+_select_session_ticket_keys(TLSContext *self, const guint8 *key_name, gboolean enc, guint8 *keys)
+{
+  int result = 0;
+
+  g_mutex_lock(&self->resumption.ticket_keys_lock);
+  if (!self->resumption.ticket_keys_loaded)
+    goto exit;
+
+  if (enc)
+    {
+      /* a failed rotation keeps the current keys, they are still better than no tickets at all */
+      _rotate_session_ticket_keys(self, cached_g_current_time_sec());
+      memcpy(keys, self->resumption.ticket_keys, TLS_SESSION_TICKET_KEYS_LEN);
+      result = 1;
+    }
+  else if (memcmp(key_name, self->resumption.ticket_keys, TLS_SESSION_TICKET_KEY_NAME_LEN) == 0)
+    {
+      memcpy(keys, self->resumption.ticket_keys, TLS_SESSION_TICKET_KEYS_LEN);
+      result = 1;
+    }
+  else if (self->resumption.previous_ticket_keys_valid &&
+           memcmp(key_name, self->resumption.previous_ticket_keys, TLS_SESSION_TICKET_KEY_NAME_LEN) == 0)
+    {
+      memcpy(keys, self->resumption.previous_ticket_keys, TLS_SESSION_TICKET_KEYS_LEN);
+      result = 2;
+    }
+
+exit:
+  g_mutex_unlock(&self->resumption.ticket_keys_lock);
+  return result;
+}
+
+static int
+_session_ticket_key_callback(SSL *ssl, unsigned char *key_name, unsigned char *iv, EVP_CIPHER_CTX *cipher_ctx,
+                             TLSSessionTicketHMACContext *hmac_ctx, int enc)
+{
+  TLSContext *self = SSL_CTX_get_app_data(SSL_get_SSL_CTX(ssl));
+  guint8 keys[TLS_SESSION_TICKET_KEYS_LEN];
+  const EVP_CIPHER *cipher = EVP_aes_256_cbc();
+
+  int result = _select_session_ticket_keys(self, key_name, enc, keys);
+  if (result == 0)
+    return 0;
+
+  gboolean success;
+  if (enc)
+    {
+      memcpy(key_name, keys, TLS_SESSION_TICKET_KEY_NAME_LEN);
+      success = RAND_bytes(iv, EVP_CIPHER_iv_length(cipher)) == 1
+                && EVP_EncryptInit_ex(cipher_ctx, cipher, NULL, TLS_SESSION_TICKET_AES_KEY(keys), iv) == 1;
+    }
+  else
+    {
+      success = EVP_DecryptInit_ex(cipher_ctx, cipher, NULL, TLS_SESSION_TICKET_AES_KEY(keys), iv) == 1;
+    }
+
+  success = success && _init_session_ticket_hmac(hmac_ctx, keys);
+  OPENSSL_cleanse(keys, sizeof(keys));
+
+  return success ? result : -1;
+}
+
 static void
 tls_context_setup_session_tickets(TLSContext *self)
 {
-  openssl_ctx_setup_session_tickets(self->ssl_ctx);
+  /* TLS 1.3 tickets are sent after the handshake, see the workaround in openssl_ctx_setup_session_tickets() */
+  if (!self->resumption.session_tickets)
+    openssl_ctx_setup_session_tickets(self->ssl_ctx);
+
+  if (self->resumption.session_tickets || self->resumption.ticket_key_file)
+    {
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+      SSL_CTX_set_tlsext_ticket_key_evp_cb(self->ssl_ctx, _session_ticket_key_callback);
+#else
+      SSL_CTX_set_tlsext_ticket_key_cb(self->ssl_ctx, _session_ticket_key_callback);
+#endif
+    }
+
+  if (self->resumption.session_cache_size >= 0)
+    SSL_CTX_sess_set_cache_size(self->ssl_ctx, self->resumption.session_cache_size);
+}
+
+static int
+_store_client_session(SSL *ssl, SSL_SESSION *session)
+{
+  TLSContext *self = SSL_CTX_get_app_data(SSL_get_SSL_CTX(ssl));
+
+  g_mutex_lock(&self->resumption.client_session_lock);
+  if (self->resumption.client_session)
+    SSL_SESSION_free(self->resumption.client_session);
+  self->resumption.client_session = session;
+  g_mutex_unlock(&self->resumption.client_session_lock);
+
+  /* we took over the reference */
+  return 1;
+}
+
+static void
+tls_context_setup_client_session_cache(TLSContext *self)
+{
+  SSL_CTX_set_session_cache_mode(self->ssl_ctx, SSL_SESS_CACHE_CLIENT | SSL_SESS_CACHE_NO_INTERNAL_STORE);
+  SSL_CTX_sess_set_new_cb(self->ssl_ctx, _store_client_session);
+}
+
+void
+tls_context_resume_client_session(TLSContext *self, TLSSession *session)
+{
+  g_mutex_lock(&self->resumption.client_session_lock);
+  if (self->resumption.client_session)
+    SSL_set_session(session->ssl, self->resumption.client_session);
+  g_mutex_unlock(&self->resumption.client_session_lock);
 }
 
 static void
@@ -239,6 +563,22 @@ tls_context_setup_ssl_options(TLSContext *self)
     }
 }
 
+/*
+ * With kernel TLS enabled, OpenSSL installs the negotiated session keys to
+ * the socket using setsockopt(SOL_TLS) once the handshake is complete and
+ * SSL_read()/SSL_write() become plain socket I/O, with record encryption
+ * done by the kernel.  If the kernel does not support the negotiated cipher,
+ * OpenSSL silently keeps doing the crypto in userspace.
+ */
+static void
+tls_context_setup_ktls(TLSContext *self)
+{
+#ifdef SSL_OP_ENABLE_KTLS
+  if (self->ktls)
+    SSL_CTX_set_options(self->ssl_ctx, SSL_OP_ENABLE_KTLS);
+#endif
+}
+
 static gboolean
 _set_optional_ecdh_curve_list(SSL_CTX *ctx, const gchar *ecdh_curve_list)
 {
@@ -583,11 +923,14 @@ tls_context_setup_context(TLSContext *self)
 
   if (self->mode == TM_SERVER)
     tls_context_setup_session_tickets(self);
+  else
+    tls_context_setup_client_session_cache(self);
 
   tls_context_setup_verify_mode(self);
   tls_context_setup_ocsp_stapling(self);
 
   tls_context_setup_ssl_options(self);
+  tls_context_setup_ktls(self);
   if (!tls_context_setup_ecdh(self))
     goto error_no_print;
 
@@ -904,6 +1247,47 @@ tls_context_set_ocsp_stapling_verify(TLSContext *self, gboolean ocsp_stapling_ve
   self->ocsp_stapling_verify = ocsp_stapling_verify;
 }
 
+void
+tls_context_set_session_tickets(TLSContext *self, gboolean session_tickets)
+{
+  self->resumption.session_tickets = session_tickets;
+}
+
+void
+tls_context_set_session_cache_size(TLSContext *self, gint session_cache_size)
+{
+  self->resumption.session_cache_size = session_cache_size;
+}
+
+void
+tls_context_set_session_ticket_key_rotation(TLSContext *self, gint ticket_key_rotation)
+{
+  self->resumption.ticket_key_rotation = ticket_key_rotation;
+}
+
+void
+tls_context_set_session_ticket_key_file(TLSContext *self, const gchar *ticket_key_file)
+{
+  g_free(self->resumption.ticket_key_file);
+  self->resumption.ticket_key_file = g_strdup(ticket_key_file);
+}
+
+gboolean
+tls_context_set_ktls(TLSContext *self, gboolean ktls, GError **error)
+{
+#ifdef SSL_OP_ENABLE_KTLS
+  self->ktls = ktls;
+  return TRUE;
+#else
+  if (!ktls)
+    return TRUE;
+
+  g_set_error(error, TLSCONTEXT_ERROR, TLSCONTEXT_UNSUPPORTED,
+              "Kernel TLS is not supported with the OpenSSL version syslog-ng was compiled with");
+  return FALSE;
+#endif
+}
+
 /* NOTE: location is a string description where this tls context was defined, e.g. the location in the config */
 TLSContext *
 tls_context_new(TLSMode mode, const gchar *location)
@@ -914,6 +1298,10 @@ tls_context_new(TLSMode mode, const gchar *location)
   self->mode = mode;
   self->verify_mode = TVM_REQUIRED | TVM_TRUSTED;
   self->ssl_options = TSO_NOSSLv2;
+  self->resumption.session_cache_size = -1;
+  self->resumption.ticket_key_rotation = TLS_SESSION_TICKET_KEY_ROTATION_DEFAULT;
+  g_mutex_init(&self->resumption.ticket_keys_lock);
+  g_mutex_init(&self->resumption.client_session_lock);
   self->location = g_strdup(location ? : "n/a");
 
   if (self->mode == TM_CLIENT)
@@ -954,6 +1342,14 @@ _tls_context_free(TLSContext *self)
   if(self->keylog_file)
     fclose(self->keylog_file);
 
+  g_free(self->resumption.ticket_key_file);
+  OPENSSL_cleanse(self->resumption.ticket_keys, sizeof(self->resumption.ticket_keys));
+  OPENSSL_cleanse(self->resumption.previous_ticket_keys, sizeof(self->resumption.previous_ticket_keys));
+  g_mutex_clear(&self->resumption.ticket_keys_lock);
+  if (self->resumption.client_session)
+    SSL_SESSION_free(self->resumption.client_session);
+  g_mutex_clear(&self->resumption.client_session_lock);
+
   g_free(self);
 }
 
@@ -27,6 +27,7 @@
 #include "transport/tls-verifier.h"
 #include "transport/tls-session.h"
 #include "messages.h"
+#include "persist-state.h"
 
 typedef enum
 {
@@ -58,6 +59,10 @@ typedef enum
   TSO_IGNORE_VALIDITY_PERIOD=0x0100,
 } TLSSslOptions;
 
+/* key name (16 bytes), HMAC secret (32 bytes), AES key (32 bytes) as expected by OpenSSL */
+#define TLS_SESSION_TICKET_KEYS_LEN 80
+#define TLS_SESSION_TICKET_KEY_ROTATION_DEFAULT (12 * 60 * 60)
+
 typedef enum
 {
   TLS_CONTEXT_SETUP_OK,
@@ -90,6 +95,26 @@ struct _TLSContext
   gchar *ecdh_curve_list;
   gchar *sni;
   gboolean ocsp_stapling_verify;
+  gboolean ktls;
+  struct
+  {
+    gboolean session_tickets;
+    gint session_cache_size;
+    gchar *ticket_key_file;
+    gint ticket_key_rotation;
+
+    /* tickets are issued with the current keys, the previous ones are only accepted until the next rotation */
+    GMutex ticket_keys_lock;
+    gboolean ticket_keys_loaded;
+    guint8 ticket_keys[TLS_SESSION_TICKET_KEYS_LEN];
+    gboolean previous_ticket_keys_valid;
+    guint8 previous_ticket_keys[TLS_SESSION_TICKET_KEYS_LEN];
+    gint64 ticket_keys_created;
+
+    /* client side: the last session negotiated with the server, to be resumed by new connections */
+    SSL_SESSION *client_session;
+    GMutex client_session_lock;
+  } resumption;
 
   SSL_CTX *ssl_ctx;
   GList *conf_cmds_list;
@@ -136,6 +161,14 @@ void tls_context_set_ecdh_curve_list(TLSContext *self, const gchar *ecdh_curve_l
 void tls_context_set_dhparam_file(TLSContext *self, const gchar *dhparam_file);
 void tls_context_set_sni(TLSContext *self, const gchar *sni);
 void tls_context_set_ocsp_stapling_verify(TLSContext *self, gboolean ocsp_stapling_verify);
+gboolean tls_context_set_ktls(TLSContext *self, gboolean ktls, GError **error);
+void tls_context_set_session_tickets(TLSContext *self, gboolean session_tickets);
+void tls_context_set_session_cache_size(TLSContext *self, gint session_cache_size);
+void tls_context_set_session_ticket_key_file(TLSContext *self, const gchar *ticket_key_file);
+void tls_context_set_session_ticket_key_rotation(TLSContext *self, gint ticket_key_rotation);
+gboolean tls_context_load_session_ticket_keys(TLSContext *self, PersistState *state, const gchar *persist_name);
+void tls_context_save_session_ticket_keys(TLSContext *self, PersistState *state, const gchar *persist_name);
+void tls_context_resume_client_session(TLSContext *self, TLSSession *session);
 const gchar *tls_context_get_key_file(TLSContext *self);
 EVTTAG *tls_context_format_tls_error_tag(TLSContext *self);
 EVTTAG *tls_context_format_location_tag(TLSContext *self);
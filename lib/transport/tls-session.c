@@ -519,10 +519,34 @@ tls_session_set_verifier(TLSSession *self, TLSVerifier *verifier)
   self->verifier = verifier ? tls_verifier_ref(verifier) : NULL;
 }
 
+static void
+tls_session_check_ktls(TLSSession *self)
+{
+  if (!self->ctx->ktls)
+    return;
+
+#ifdef BIO_get_ktls_send
+  self->ktls.send = BIO_get_ktls_send(SSL_get_wbio(self->ssl));
+  self->ktls.recv = BIO_get_ktls_recv(SSL_get_rbio(self->ssl));
+#endif
+
+  msg_verbose("TLS handshake completed, checking kernel TLS offload",
+              evt_tag_str("ktls_send", self->ktls.send ? "active" : "inactive"),
+              evt_tag_str("ktls_recv", self->ktls.recv ? "active" : "inactive"),
+              evt_tag_str("cipher", SSL_get_cipher_name(self->ssl)),
+              tls_context_format_location_tag(self->ctx));
+}
+
 void
 tls_session_info_callback(const SSL *ssl, int where, int ret)
 {
   TLSSession *self = (TLSSession *)SSL_get_app_data(ssl);
+
+#ifdef SSL_CB_HANDSHAKE_DONE
+  if (where & SSL_CB_HANDSHAKE_DONE)
+    tls_session_check_ktls(self);
+#endif
+
   if( !self->peer_info.found && where == (SSL_ST_ACCEPT|SSL_CB_LOOP) )
     {
       X509 *cert = SSL_get_peer_certificate(ssl);
@@ -42,6 +42,11 @@ typedef struct _TLSSession
     gchar ou[X509_MAX_OU_LEN];
     gchar cn[X509_MAX_CN_LEN];
   } peer_info;
+  struct
+  {
+    gboolean send;
+    gboolean recv;
+  } ktls;
 } TLSSession;
 
 void tls_session_configure_allow_compress(TLSSession *tls_session, gboolean allow_compress);
@@ -49,6 +54,12 @@ void tls_session_set_trusted_fingerprints(TLSContext *self, GList *fingerprints)
 void tls_session_set_trusted_dn(TLSContext *self, GList *dns);
 void tls_session_set_verifier(TLSSession *self, TLSVerifier *verifier);
 
+static inline gboolean
+tls_session_is_ktls_active(TLSSession *self)
+{
+  return self->ktls.send || self->ktls.recv;
+}
+
 int tls_session_verify_callback(int ok, X509_STORE_CTX *ctx);
 int tls_session_ocsp_client_verify_callback(SSL *ssl, void *user_data);
 
@@ -41,6 +41,9 @@ _construct_transport(const TransportFactory *s, gint fd)
 
   tls_session_set_verifier(tls_session, self->tls_verifier);
 
+  if (self->tls_context->mode == TM_CLIENT)
+    tls_context_resume_client_session(self->tls_context, tls_session);
+
   return log_transport_tls_new(tls_session, fd);
 }
 
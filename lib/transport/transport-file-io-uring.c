@@ -0,0 +1,149 @@
+/*
+ * Copyright (c) 2024 One Identity LLC.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#include "transport-file-io-uring.h"
+#include "messages.h"
+
+#if SYSLOG_NG_ENABLE_IO_URING
+
+#include <liburing.h>
+#include <errno.h>
+#include <string.h>
+
+/* a writev and the linked fsync */
+#define IO_URING_QUEUE_DEPTH 2
+
+typedef struct _LogTransportFileIOUring
+{
+  LogTransportFile super;
+  struct io_uring ring;
+} LogTransportFileIOUring;
+
+static gint
+_wait_for_completions(LogTransportFileIOUring *self, gint num_requests, gssize *write_result)
+{
+  for (gint i = 0; i < num_requests; i++)
+    {
+      struct io_uring_cqe *cqe;
+      gint rc;
+
+      do
+        {
+          rc = io_uring_wait_cqe(&self->ring, &cqe);
+        }
+      while (rc == -EINTR);
+
+      if (rc < 0)
+        return rc;
+
+      /* only the writev request carries user data, the result of fsync()
+       * is ignored just like in the non-io_uring code path */
+      if (io_uring_cqe_get_data(cqe))
+        *write_result = cqe->res;
+      io_uring_cqe_seen(&self->ring, cqe);
+    }
+  return 0;
+}
+
+static gssize
+log_transport_file_io_uring_writev_and_sync_method(LogTransport *s, struct iovec *iov, gint iov_count)
+{
+  LogTransportFileIOUring *self = (LogTransportFileIOUring *) s;
+  struct io_uring_sqe *sqe;
+  gssize write_result = -ECANCELED;
+  gint rc;
+
+  /* an offset of -1 means the current file position, as with writev() */
+  sqe = io_uring_get_sqe(&self->ring);
+  io_uring_prep_writev(sqe, s->fd, iov, iov_count, -1);
+  io_uring_sqe_set_data(sqe, self);
+  sqe->flags |= IOSQE_IO_LINK;
+
+  /* a short write breaks the link, in which case fsync() is cancelled and
+   * will be done along with the write of the remaining data */
+  sqe = io_uring_get_sqe(&self->ring);
+  io_uring_prep_fsync(sqe, s->fd, 0);
+  io_uring_sqe_set_data(sqe, NULL);
+
+  do
+    {
+      rc = io_uring_submit_and_wait(&self->ring, 2);
+    }
+  while (rc == -EINTR);
+
+  if (rc >= 0)
+    rc = _wait_for_completions(self, 2, &write_result);
+
+  if (rc < 0)
+    {
+      errno = -rc;
+      return -1;
+    }
+
+  if (write_result < 0)
+    {
+      errno = -write_result;
+      return -1;
+    }
+  return write_result;
+}
+
+static void
+log_transport_file_io_uring_free_method(LogTransport *s)
+{
+  LogTransportFileIOUring *self = (LogTransportFileIOUring *) s;
+
+  io_uring_queue_exit(&self->ring);
+  log_transport_free_method(s);
+}
+
+LogTransport *
+log_transport_file_io_uring_new(gint fd)
+{
+  LogTransportFileIOUring *self = g_new0(LogTransportFileIOUring, 1);
+
+  gint rc = io_uring_queue_init(IO_URING_QUEUE_DEPTH, &self->ring, 0);
+  if (rc < 0)
+    {
+      msg_debug("io_uring is not available, using plain file writes",
+                evt_tag_int("fd", fd),
+                evt_tag_str("error", g_strerror(-rc)));
+      g_free(self);
+      return NULL;
+    }
+
+  log_transport_file_init_instance(&self->super, fd);
+  self->super.super.writev_and_sync = log_transport_file_io_uring_writev_and_sync_method;
+  self->super.super.free_fn = log_transport_file_io_uring_free_method;
+  return &self->super.super;
+}
+
+#else
+
+LogTransport *
+log_transport_file_io_uring_new(gint fd)
+{
+  return NULL;
+}
+
+#endif
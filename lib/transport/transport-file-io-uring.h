@@ -0,0 +1,37 @@
+/*
+ * Copyright (c) 2024 One Identity LLC.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#ifndef TRANSPORT_TRANSPORT_FILE_IO_URING_H_INCLUDED
+#define TRANSPORT_TRANSPORT_FILE_IO_URING_H_INCLUDED 1
+
+#include "transport/transport-file.h"
+
+/*
+ * File transport that submits the write and the subsequent fsync() as a
+ * single linked io_uring request.  Returns NULL if io_uring is not
+ * available (not compiled in, or refused by the kernel), the caller is
+ * expected to fall back to log_transport_file_new() in that case.
+ */
+LogTransport *log_transport_file_io_uring_new(gint fd);
+
+#endif
@@ -22,21 +22,157 @@
  */
 
 #include "transport-file.h"
+#include "stats/stats-registry.h"
 
 #include <errno.h>
+#include <fcntl.h>
 #include <unistd.h>
+#include <sys/stat.h>
 #include <sys/uio.h>
 
+/* the kernel is asked to read this much ahead of us while catching up */
+#define CATCH_UP_READAHEAD_WINDOW (4 * 1024 * 1024)
+/* pages behind the read position are dropped in chunks of this size */
+#define CATCH_UP_DROP_CHUNK (1024 * 1024)
+
+static struct
+{
+  GMutex lock;
+  StatsCounterItem *files;
+  StatsCounterItem *remaining_bytes;
+} catch_up_metrics;
+
+static void
+_register_catch_up_metrics(void)
+{
+  StatsClusterKey sc_key;
+
+  g_mutex_lock(&catch_up_metrics.lock);
+  if (!catch_up_metrics.files)
+    {
+      stats_lock();
+      stats_cluster_single_key_set(&sc_key, "input_files_catching_up", NULL, 0);
+      stats_register_counter(STATS_LEVEL1, &sc_key, SC_TYPE_SINGLE_VALUE, &catch_up_metrics.files);
+
+      stats_cluster_single_key_set(&sc_key, "input_files_catch_up_remaining_bytes", NULL, 0);
+      stats_register_counter(STATS_LEVEL1, &sc_key, SC_TYPE_SINGLE_VALUE, &catch_up_metrics.remaining_bytes);
+      stats_unlock();
+    }
+  g_mutex_unlock(&catch_up_metrics.lock);
+}
+
+#if SYSLOG_NG_HAVE_POSIX_FADVISE
+static inline void
+_advise(LogTransportFile *self, off_t offset, off_t len, gint advice)
+{
+  posix_fadvise(self->super.fd, offset, len, advice);
+}
+#endif
+
+static void
+_catch_up_finish(LogTransportFile *self)
+{
+  self->catch_up.active = FALSE;
+  stats_counter_dec(catch_up_metrics.files);
+  stats_counter_sub(catch_up_metrics.remaining_bytes, MAX(self->catch_up.end - self->catch_up.pos, 0));
+
+#if SYSLOG_NG_HAVE_POSIX_FADVISE
+  _advise(self, 0, 0, POSIX_FADV_NORMAL);
+#endif
+}
+
+/* called after the first read following EOF, with the number of bytes it returned */
+static void
+_catch_up_probe(LogTransportFile *self, gssize rc)
+{
+  struct stat st;
+  off_t pos;
+
+  self->catch_up.probe = FALSE;
+
+  pos = lseek(self->super.fd, 0, SEEK_CUR);
+  if (pos < 0 || fstat(self->super.fd, &st) < 0 || !S_ISREG(st.st_mode))
+    return;
+
+  if (st.st_size - (pos - rc) < self->catch_up.threshold)
+    return;
+
+  _register_catch_up_metrics();
+
+  self->catch_up.active = TRUE;
+  self->catch_up.pos = pos;
+  self->catch_up.end = st.st_size;
+  self->catch_up.advised_until = pos;
+  self->catch_up.dropped_until = pos - rc;
+  stats_counter_inc(catch_up_metrics.files);
+  stats_counter_add(catch_up_metrics.remaining_bytes, MAX(st.st_size - pos, 0));
+
+#if SYSLOG_NG_HAVE_POSIX_FADVISE
+  _advise(self, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+}
+
+static void
+_catch_up_advance(LogTransportFile *self, gssize rc)
+{
+  stats_counter_sub(catch_up_metrics.remaining_bytes, MIN(rc, self->catch_up.end - self->catch_up.pos));
+  self->catch_up.pos += rc;
+  if (self->catch_up.pos >= self->catch_up.end)
+    {
+      _catch_up_finish(self);
+      return;
+    }
+
+#if SYSLOG_NG_HAVE_POSIX_FADVISE
+  if (self->catch_up.advised_until - self->catch_up.pos < CATCH_UP_READAHEAD_WINDOW / 2)
+    {
+      off_t start = MAX(self->catch_up.advised_until, self->catch_up.pos);
+
+      _advise(self, start, CATCH_UP_READAHEAD_WINDOW, POSIX_FADV_WILLNEED);
+      self->catch_up.advised_until = start + CATCH_UP_READAHEAD_WINDOW;
+    }
+
+  if (self->catch_up.pos - self->catch_up.dropped_until >= CATCH_UP_DROP_CHUNK)
+    {
+      _advise(self, self->catch_up.dropped_until, self->catch_up.pos - self->catch_up.dropped_until,
+              POSIX_FADV_DONTNEED);
+      self->catch_up.dropped_until = self->catch_up.pos;
+    }
+#endif
+}
+
+static void
+_catch_up_track_read(LogTransportFile *self, gssize rc)
+{
+  if (rc == 0)
+    {
+      /* somebody truncated the file under us, or we are done */
+      if (self->catch_up.active)
+        _catch_up_finish(self);
+      self->catch_up.probe = TRUE;
+      return;
+    }
+
+  if (self->catch_up.probe)
+    _catch_up_probe(self, rc);
+  else if (self->catch_up.active)
+    _catch_up_advance(self, rc);
+}
+
 gssize
-log_transport_file_read_method(LogTransport *self, gpointer buf, gsize buflen, LogTransportAuxData *aux)
+log_transport_file_read_method(LogTransport *s, gpointer buf, gsize buflen, LogTransportAuxData *aux)
 {
+  LogTransportFile *self = (LogTransportFile *) s;
   gint rc;
 
   do
     {
-      rc = read(self->fd, buf, buflen);
+      rc = read(self->super.fd, buf, buflen);
     }
   while (rc == -1 && errno == EINTR);
+
+  if (self->catch_up.threshold && rc >= 0)
+    _catch_up_track_read(self, rc);
   return rc;
 }
 
@@ -80,6 +216,27 @@ log_transport_file_writev_method(LogTransport *self, struct iovec *iov, gint iov
   return rc;
 }
 
+static void
+log_transport_file_free_method(LogTransport *s)
+{
+  LogTransportFile *self = (LogTransportFile *) s;
+
+  if (self->catch_up.active)
+    _catch_up_finish(self);
+  log_transport_free_method(s);
+}
+
+/* the first read, or the first read after reaching EOF, checks how far
+ * behind the end of the file we are and starts catching up accordingly */
+void
+log_transport_file_set_catch_up_threshold(LogTransport *s, gsize threshold)
+{
+  LogTransportFile *self = (LogTransportFile *) s;
+
+  self->catch_up.threshold = threshold;
+  self->catch_up.probe = TRUE;
+}
+
 void
 log_transport_file_init_instance(LogTransportFile *self, gint fd)
 {
@@ -87,7 +244,7 @@ log_transport_file_init_instance(LogTransportFile *self, gint fd)
   self->super.read = log_transport_file_read_method;
   self->super.write = log_transport_file_write_method;
   self->super.writev = log_transport_file_writev_method;
-  self->super.free_fn = log_transport_free_method;
+  self->super.free_fn = log_transport_file_free_method;
 }
 
 LogTransport *
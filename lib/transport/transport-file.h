@@ -27,11 +27,31 @@
 
 #include "transport/logtransport.h"
 
+#include <sys/types.h>
+
+/* the default distance from EOF that makes a source file catch up */
+#define LOG_TRANSPORT_FILE_CATCH_UP_THRESHOLD (16 * 1024 * 1024)
+
 /* log transport that simply sends messages to an fd */
 typedef struct _LogTransportFile LogTransportFile;
 struct _LogTransportFile
 {
   LogTransport super;
+
+  /* Catch-up mode: a regular file read from far behind its end is read
+   * ahead by the kernel and the pages behind our read position are
+   * dropped from the page cache, so replaying a backlog does not evict
+   * everything else from it.  Disabled if threshold is 0. */
+  struct
+  {
+    gsize threshold;
+    gboolean probe;
+    gboolean active;
+    off_t pos;
+    off_t end;
+    off_t advised_until;
+    off_t dropped_until;
+  } catch_up;
 };
 
 gssize log_transport_file_read_method(LogTransport *self, gpointer buf, gsize buflen, LogTransportAuxData *aux);
@@ -39,6 +59,8 @@ gssize log_transport_file_read_and_ignore_eof_method(LogTransport *self, gpointe
                                                      LogTransportAuxData *aux);
 gssize log_transport_file_write_method(LogTransport *self, const gpointer buf, gsize buflen);
 
+void log_transport_file_set_catch_up_threshold(LogTransport *s, gsize threshold);
+
 void log_transport_file_init_instance(LogTransportFile *self, gint fd);
 LogTransport *log_transport_file_new(gint fd);
 
@@ -22,10 +22,14 @@
  */
 
 #include "transport-socket.h"
+#include "messages.h"
 
+#include <netinet/in.h>
+#include <netinet/udp.h>
 #include <errno.h>
 #include <string.h>
 #include <unistd.h>
+#include <sys/uio.h>
 
 static gint
 _determine_address_family(gint fd)
@@ -141,8 +145,8 @@ _parse_cmsg_to_aux(LogTransportSocket *self, struct msghdr *msg, LogTransportAux
 #define _parse_cmsg_to_aux(s, m, a)
 #endif
 
-static void
-_extract_from_msghdr_method(LogTransportSocket *self, struct msghdr *msg, LogTransportAuxData *aux)
+void
+log_transport_socket_extract_from_msghdr(LogTransportSocket *self, struct msghdr *msg, LogTransportAuxData *aux)
 {
   if (msg->msg_namelen && aux)
     log_transport_aux_data_set_peer_addr_ref(aux, g_sockaddr_new((struct sockaddr *) msg->msg_name, msg->msg_namelen));
@@ -179,7 +183,7 @@ log_transport_socket_read_method(LogTransport *s, gpointer buf, gsize buflen, Lo
   while (rc == -1 && errno == EINTR);
 
   if (rc > 0)
-    _extract_from_msghdr_method(self, &msg, aux);
+    log_transport_socket_extract_from_msghdr(self, &msg, aux);
 
   return rc;
 }
@@ -245,12 +249,134 @@ log_transport_dgram_socket_write_method(LogTransport *s, const gpointer buf, gsi
   return rc;
 }
 
+#ifdef SYSLOG_NG_HAVE_SENDMMSG
+
+#define DGRAM_SOCKET_MAX_MSGS_PER_SEND 64
+
+#ifdef UDP_SEGMENT
+
+/* GSO refuses segments that don't fit into the MTU of the path, larger
+ * datagrams are sent one by one (and are fragmented by the IP layer) */
+#define UDP_GSO_MAX_SEGMENT_SIZE 1400
+#define UDP_GSO_MAX_SEGMENTS 64
+#define UDP_GSO_MAX_BYTES 65507
+
+typedef union
+{
+  gchar buf[CMSG_SPACE(sizeof(guint16))];
+  struct cmsghdr align;
+} UDPGSOControl;
+
+static gint
+_count_udp_gso_segments(LogTransportSocket *self, struct iovec *datagrams, gint count)
+{
+  gsize segment_size = datagrams[0].iov_len;
+
+  if (!self->udp_gso || segment_size > UDP_GSO_MAX_SEGMENT_SIZE)
+    return 1;
+
+  gint segments = 1;
+  while (segments < count &&
+         segments < UDP_GSO_MAX_SEGMENTS &&
+         datagrams[segments].iov_len == segment_size &&
+         (segments + 1) * segment_size <= UDP_GSO_MAX_BYTES)
+    segments++;
+  return segments;
+}
+
+static void
+_setup_udp_gso_cmsg(struct msghdr *msg, UDPGSOControl *control, gsize segment_size)
+{
+  msg->msg_control = control->buf;
+  msg->msg_controllen = sizeof(control->buf);
+
+  struct cmsghdr *cmsg = CMSG_FIRSTHDR(msg);
+  cmsg->cmsg_level = IPPROTO_UDP;
+  cmsg->cmsg_type = UDP_SEGMENT;
+  cmsg->cmsg_len = CMSG_LEN(sizeof(guint16));
+
+  guint16 gso_size = segment_size;
+  memcpy(CMSG_DATA(cmsg), &gso_size, sizeof(gso_size));
+}
+
+#else
+
+#define _count_udp_gso_segments(self, datagrams, count) 1
+
+#endif
+
+static gint
+log_transport_dgram_socket_write_datagrams_method(LogTransport *s, struct iovec *datagrams, gint count)
+{
+  LogTransportSocket *self = (LogTransportSocket *) s;
+  struct mmsghdr msgs[DGRAM_SOCKET_MAX_MSGS_PER_SEND];
+  gint segments[DGRAM_SOCKET_MAX_MSGS_PER_SEND];
+#ifdef UDP_SEGMENT
+  UDPGSOControl gso_controls[DGRAM_SOCKET_MAX_MSGS_PER_SEND];
+#endif
+  gint num_msgs = 0;
+  gint num_datagrams = 0;
+  gint rc;
+
+  while (num_datagrams < count && num_msgs < DGRAM_SOCKET_MAX_MSGS_PER_SEND)
+    {
+      struct msghdr *msg = &msgs[num_msgs].msg_hdr;
+      gint n = _count_udp_gso_segments(self, &datagrams[num_datagrams], count - num_datagrams);
+
+      memset(msg, 0, sizeof(*msg));
+      msg->msg_iov = &datagrams[num_datagrams];
+      msg->msg_iovlen = n;
+#ifdef UDP_SEGMENT
+      if (n > 1)
+        _setup_udp_gso_cmsg(msg, &gso_controls[num_msgs], datagrams[num_datagrams].iov_len);
+#endif
+      segments[num_msgs++] = n;
+      num_datagrams += n;
+    }
+
+  do
+    {
+      rc = sendmmsg(self->super.fd, msgs, num_msgs, 0);
+    }
+  while (rc == -1 && errno == EINTR);
+
+  if (rc < 0)
+    {
+      /* see log_transport_dgram_socket_write_method() for the reasoning */
+      if (errno == ENOBUFS)
+        return segments[0];
+
+      if (segments[0] > 1 && (errno == EIO || errno == EINVAL))
+        {
+          msg_debug("UDP GSO is not supported for this destination, sending datagrams one by one",
+                    evt_tag_int("fd", self->super.fd),
+                    evt_tag_error(EVT_TAG_OSERROR));
+          self->udp_gso = FALSE;
+          return log_transport_dgram_socket_write_datagrams_method(s, datagrams, count);
+        }
+      return -1;
+    }
+
+  num_datagrams = 0;
+  for (gint i = 0; i < rc; i++)
+    num_datagrams += segments[i];
+  return num_datagrams;
+}
+
+#endif
+
 void
 log_transport_dgram_socket_init_instance(LogTransportSocket *self, gint fd)
 {
   log_transport_socket_init_instance(self, fd);
   self->super.read = log_transport_dgram_socket_read_method;
   self->super.write = log_transport_dgram_socket_write_method;
+#ifdef SYSLOG_NG_HAVE_SENDMMSG
+  self->super.write_datagrams = log_transport_dgram_socket_write_datagrams_method;
+#endif
+#ifdef UDP_SEGMENT
+  self->udp_gso = (self->proto == IPPROTO_UDP);
+#endif
 }
 
 LogTransport *
@@ -270,10 +396,24 @@ log_transport_stream_socket_free_method(LogTransport *s)
   log_transport_free_method(s);
 }
 
+static gssize
+log_transport_stream_socket_writev_method(LogTransport *s, struct iovec *iov, gint iov_count)
+{
+  gssize rc;
+
+  do
+    {
+      rc = writev(s->fd, iov, iov_count);
+    }
+  while (rc == -1 && errno == EINTR);
+  return rc;
+}
+
 void
 log_transport_stream_socket_init_instance(LogTransportSocket *self, gint fd)
 {
   log_transport_socket_init_instance(self, fd);
+  self->super.writev = log_transport_stream_socket_writev_method;
   self->super.free_fn = log_transport_stream_socket_free_method;
 }
 
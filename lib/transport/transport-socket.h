@@ -33,10 +33,13 @@ struct _LogTransportSocket
   LogTransport super;
   gint address_family;
   gint proto;
+  /* coalesce same-sized datagrams with UDP_SEGMENT when sending a batch */
+  gboolean udp_gso;
   void (*parse_cmsg)(LogTransportSocket *self, struct cmsghdr *cmsg, LogTransportAuxData *aux);
 };
 
 void log_transport_socket_parse_cmsg_method(LogTransportSocket *s, struct cmsghdr *cmsg, LogTransportAuxData *aux);
+void log_transport_socket_extract_from_msghdr(LogTransportSocket *self, struct msghdr *msg, LogTransportAuxData *aux);
 
 void log_transport_dgram_socket_init_instance(LogTransportSocket *self, gint fd);
 LogTransport *log_transport_dgram_socket_new(gint fd);
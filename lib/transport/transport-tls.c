@@ -149,7 +149,13 @@ log_transport_tls_read_method(LogTransport *s, gpointer buf, gsize buflen, LogTr
   while (rc == -1 && errno == EINTR);
 
   if (rc > 0)
-    self->super.super.cond = 0;
+    {
+      self->super.super.cond = 0;
+
+      /* the handshake might have been completed by this very SSL_read() */
+      if (self->tls_session->ctx->ktls)
+        log_transport_aux_data_add_nv_pair(aux, ".tls.ktls", tls_session_is_ktls_active(self->tls_session) ? "1" : "0");
+    }
 
   return rc;
 tls_error:
@@ -239,10 +245,14 @@ log_transport_tls_new(TLSSession *tls_session, gint fd)
   self->super.super.cond = 0;
   self->super.super.read = log_transport_tls_read_method;
   self->super.super.write = log_transport_tls_write_method;
+  /* batches are coalesced and sent with a single SSL_write() */
+  self->super.super.writev = NULL;
   self->super.super.free_fn = log_transport_tls_free_method;
   self->tls_session = tls_session;
 
   SSL_set_fd(self->tls_session->ssl, fd);
+  /* a retried write is coalesced again, possibly at a different address */
+  SSL_set_mode(self->tls_session->ssl, SSL_MODE_ACCEPT_MOVING_WRITE_BUFFER);
   return &self->super.super;
 }
 
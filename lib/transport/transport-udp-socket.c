@@ -26,6 +26,8 @@
 #include "gsocket.h"
 #include "scratch-buffers.h"
 #include "str-format.h"
+#include "stats/stats-registry.h"
+#include "stats/stats-cluster-single.h"
 
 #include <sys/types.h>
 #include <sys/socket.h>
@@ -34,11 +36,27 @@
 #include <errno.h>
 #include <string.h>
 
+typedef struct _UDPReceiveBatchSlot UDPReceiveBatchSlot;
 typedef struct _LogTransportUDP LogTransportUDP;
 struct _LogTransportUDP
 {
   LogTransportSocket super;
   GSockAddr *bind_addr;
+
+  /* datagrams received by a single recvmmsg() call, delivered one by one
+   * to the LogProto layer by subsequent read() calls */
+  struct
+  {
+    gint size;
+    gint received;
+    gint next;
+    gsize slot_size;
+    gchar *buffer;
+    struct mmsghdr *msgs;
+    UDPReceiveBatchSlot *slots;
+    StatsCounterItem *batches;
+    StatsCounterItem *datagrams;
+  } receive_batch;
 };
 
 #if defined(__FreeBSD__) || defined(__OpenBSD__)
@@ -159,10 +177,222 @@ _setup_fd(LogTransportUDP *self, gint fd)
 
 }
 
+#ifdef SYSLOG_NG_HAVE_RECVMMSG
+
+struct _UDPReceiveBatchSlot
+{
+  struct iovec iov;
+  struct sockaddr_storage peer_addr;
+#if defined(SYSLOG_NG_HAVE_CTRLBUF_IN_MSGHDR)
+  gchar ctlbuf[64];
+#endif
+};
+
+static void
+_receive_batch_alloc_buffer(LogTransportUDP *self, gsize buflen)
+{
+  if (self->receive_batch.slot_size >= buflen)
+    return;
+
+  g_free(self->receive_batch.buffer);
+  self->receive_batch.buffer = g_malloc(self->receive_batch.size * buflen);
+  self->receive_batch.slot_size = buflen;
+}
+
+static void
+_receive_batch_setup_msgs(LogTransportUDP *self)
+{
+  for (gint i = 0; i < self->receive_batch.size; i++)
+    {
+      UDPReceiveBatchSlot *slot = &self->receive_batch.slots[i];
+      struct msghdr *msg = &self->receive_batch.msgs[i].msg_hdr;
+
+      slot->iov.iov_base = self->receive_batch.buffer + i * self->receive_batch.slot_size;
+      slot->iov.iov_len = self->receive_batch.slot_size;
+
+      msg->msg_name = (struct sockaddr *) &slot->peer_addr;
+      msg->msg_namelen = sizeof(slot->peer_addr);
+      msg->msg_iov = &slot->iov;
+      msg->msg_iovlen = 1;
+#if defined(SYSLOG_NG_HAVE_CTRLBUF_IN_MSGHDR)
+      msg->msg_control = slot->ctlbuf;
+      msg->msg_controllen = sizeof(slot->ctlbuf);
+#endif
+      msg->msg_flags = 0;
+    }
+}
+
+static gint
+_receive_batch_fill(LogTransportUDP *self, gsize buflen)
+{
+  gint rc;
+
+  _receive_batch_alloc_buffer(self, buflen);
+  _receive_batch_setup_msgs(self);
+
+  do
+    {
+      rc = recvmmsg(self->super.super.fd, self->receive_batch.msgs, self->receive_batch.size, MSG_DONTWAIT, NULL);
+    }
+  while (rc == -1 && errno == EINTR);
+
+  if (rc <= 0)
+    return rc;
+
+  self->receive_batch.received = rc;
+  self->receive_batch.next = 0;
+  stats_counter_inc(self->receive_batch.batches);
+  stats_counter_add(self->receive_batch.datagrams, rc);
+  return rc;
+}
+
+static gboolean
+log_transport_udp_socket_has_pending_input(LogTransport *s)
+{
+  LogTransportUDP *self = (LogTransportUDP *) s;
+
+  return self->receive_batch.next < self->receive_batch.received;
+}
+
+static gssize
+_receive_batch_pop(LogTransportUDP *self, gpointer buf, gsize buflen, LogTransportAuxData *aux)
+{
+  struct mmsghdr *mmsg = &self->receive_batch.msgs[self->receive_batch.next++];
+  gsize len = MIN(mmsg->msg_len, buflen);
+
+  memcpy(buf, mmsg->msg_hdr.msg_iov->iov_base, len);
+  log_transport_socket_extract_from_msghdr(&self->super, &mmsg->msg_hdr, aux);
+  return len;
+}
+
+static gssize
+log_transport_udp_socket_read_batch_method(LogTransport *s, gpointer buf, gsize buflen, LogTransportAuxData *aux)
+{
+  LogTransportUDP *self = (LogTransportUDP *) s;
+  gssize rc;
+
+  do
+    {
+      if (!log_transport_udp_socket_has_pending_input(s))
+        {
+          rc = _receive_batch_fill(self, buflen);
+          if (rc <= 0)
+            {
+              /* DGRAM sockets should never return EOF, they just need to be read again */
+              if (rc == 0)
+                errno = EAGAIN;
+              return -1;
+            }
+        }
+
+      /* empty datagrams carry no message, skip them */
+      rc = _receive_batch_pop(self, buf, buflen, aux);
+    }
+  while (rc == 0);
+
+  return rc;
+}
+
+static void
+_receive_batch_register_stats(LogTransportUDP *self)
+{
+  gchar addr[256];
+  g_sockaddr_format(self->bind_addr, addr, sizeof(addr), GSA_FULL);
+
+  StatsClusterLabel labels[] =
+  {
+    stats_cluster_label("transport", "udp"),
+    stats_cluster_label("address", addr),
+    stats_cluster_label("direction", "input"),
+  };
+  StatsClusterKey sc_key;
+
+  stats_lock();
+  stats_cluster_single_key_set(&sc_key, "socket_receive_batches_total", labels, G_N_ELEMENTS(labels));
+  stats_register_counter(STATS_LEVEL1, &sc_key, SC_TYPE_SINGLE_VALUE, &self->receive_batch.batches);
+
+  stats_cluster_single_key_set(&sc_key, "socket_receive_batched_datagrams_total", labels, G_N_ELEMENTS(labels));
+  stats_register_counter(STATS_LEVEL1, &sc_key, SC_TYPE_SINGLE_VALUE, &self->receive_batch.datagrams);
+  stats_unlock();
+}
+
+static void
+_receive_batch_unregister_stats(LogTransportUDP *self)
+{
+  gchar addr[256];
+  g_sockaddr_format(self->bind_addr, addr, sizeof(addr), GSA_FULL);
+
+  StatsClusterLabel labels[] =
+  {
+    stats_cluster_label("transport", "udp"),
+    stats_cluster_label("address", addr),
+    stats_cluster_label("direction", "input"),
+  };
+  StatsClusterKey sc_key;
+
+  stats_lock();
+  stats_cluster_single_key_set(&sc_key, "socket_receive_batches_total", labels, G_N_ELEMENTS(labels));
+  stats_unregister_counter(&sc_key, SC_TYPE_SINGLE_VALUE, &self->receive_batch.batches);
+
+  stats_cluster_single_key_set(&sc_key, "socket_receive_batched_datagrams_total", labels, G_N_ELEMENTS(labels));
+  stats_unregister_counter(&sc_key, SC_TYPE_SINGLE_VALUE, &self->receive_batch.datagrams);
+  stats_unlock();
+}
+
+/*
+ * Switch the transport to receive up to @batch_size datagrams with a
+ * single recvmmsg() call.  The datagrams are queued within the transport
+ * (the buffer is batch_size * the read buffer size of the LogProto layer)
+ * and are returned by subsequent reads without any further syscalls.
+ *
+ * Must be called before the first read.
+ */
+void
+log_transport_udp_socket_set_receive_batch_size(LogTransport *s, gint batch_size)
+{
+  LogTransportUDP *self = (LogTransportUDP *) s;
+
+  g_assert(!self->receive_batch.size);
+  if (batch_size <= 1)
+    return;
+
+  self->receive_batch.size = batch_size;
+  self->receive_batch.msgs = g_new0(struct mmsghdr, batch_size);
+  self->receive_batch.slots = g_new0(UDPReceiveBatchSlot, batch_size);
+
+  self->super.super.read = log_transport_udp_socket_read_batch_method;
+  self->super.super.has_pending_input = log_transport_udp_socket_has_pending_input;
+  _receive_batch_register_stats(self);
+}
+
+static void
+_receive_batch_free(LogTransportUDP *self)
+{
+  if (!self->receive_batch.size)
+    return;
+
+  _receive_batch_unregister_stats(self);
+  g_free(self->receive_batch.buffer);
+  g_free(self->receive_batch.msgs);
+  g_free(self->receive_batch.slots);
+}
+
+#else
+
+void
+log_transport_udp_socket_set_receive_batch_size(LogTransport *s, gint batch_size)
+{
+}
+
+#define _receive_batch_free(self)
+
+#endif
+
 static void
 log_transport_udp_socket_free(LogTransport *s)
 {
   LogTransportUDP *self = (LogTransportUDP *)s;
+  _receive_batch_free(self);
   g_sockaddr_unref(self->bind_addr);
   log_transport_free_method(s);
 }
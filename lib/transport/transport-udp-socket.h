@@ -27,6 +27,7 @@
 #include "transport/logtransport.h"
 
 LogTransport *log_transport_udp_socket_new(gint fd);
+void log_transport_udp_socket_set_receive_batch_size(LogTransport *s, gint batch_size);
 
 
 #endif
@@ -109,6 +109,103 @@ _append_escaped_utf8_character(GString *escaped_output, const gchar **raw,
   return *raw - char_ptr;
 }
 
+/*
+ * Most of the input is printable ASCII or valid UTF-8 that needs no
+ * escaping, these helpers find the length of such runs, so they can be
+ * appended in one go instead of decoding and re-encoding them character
+ * by character.  ASCII is checked eight bytes at a time (see the swar_*
+ * helpers in str-utils.h), multi-byte sequences are validated in place.
+ */
+
+static inline gboolean
+_is_ascii_safe(guint8 c, const gchar *unsafe_chars)
+{
+  return c >= 32 && c != '\\' && !_is_character_unsafe(c, unsafe_chars);
+}
+
+static inline gboolean
+_is_continuation_byte(guint8 c)
+{
+  return (c & 0xC0) == 0x80;
+}
+
+/* returns the length of the well-formed UTF-8 sequence at p (as per table
+ * 3-7 of the Unicode standard: no overlong forms, no surrogates, nothing
+ * above U+10FFFF), or 0 if it is invalid or truncated */
+static inline gsize
+_get_utf8_sequence_length(const guint8 *p, gsize len)
+{
+  guint8 c = p[0];
+
+  if (c >= 0xC2 && c <= 0xDF)
+    return (len >= 2 && _is_continuation_byte(p[1])) ? 2 : 0;
+
+  if (c >= 0xE0 && c <= 0xEF)
+    {
+      if (len < 3 || !_is_continuation_byte(p[1]) || !_is_continuation_byte(p[2]))
+        return 0;
+      if ((c == 0xE0 && p[1] < 0xA0) || (c == 0xED && p[1] > 0x9F))
+        return 0;
+      return 3;
+    }
+
+  if (c >= 0xF0 && c <= 0xF4)
+    {
+      if (len < 4 || !_is_continuation_byte(p[1]) || !_is_continuation_byte(p[2]) || !_is_continuation_byte(p[3]))
+        return 0;
+      if ((c == 0xF0 && p[1] < 0x90) || (c == 0xF4 && p[1] > 0x8F))
+        return 0;
+      return 4;
+    }
+  return 0;
+}
+
+static gsize
+_find_safe_run(const gchar *raw, gsize raw_len, const gchar *unsafe_chars)
+{
+  /* the word-at-a-time check handles a single unsafe character, which is
+   * the common case (e.g. the double quote for JSON), with more than that
+   * we only use the byte-by-byte loop */
+  gboolean use_swar = !unsafe_chars || !unsafe_chars[0] || !unsafe_chars[1];
+  guint8 unsafe_char = unsafe_chars ? unsafe_chars[0] : '\\';
+  gsize run = 0;
+
+  while (run < raw_len)
+    {
+      while (use_swar && run + sizeof(guint64) <= raw_len)
+        {
+          guint64 word = swar_load(raw + run);
+
+          if (swar_has_non_ascii(word) ||
+              swar_has_byte_less_than(word, 32) ||
+              swar_has_byte_equal_to(word, '\\') ||
+              swar_has_byte_equal_to(word, unsafe_char))
+            break;
+          run += sizeof(word);
+        }
+
+      if (run >= raw_len)
+        break;
+
+      guint8 c = raw[run];
+      if (c < 0x80)
+        {
+          if (!_is_ascii_safe(c, unsafe_chars))
+            break;
+          run++;
+          continue;
+        }
+
+      gsize seq_len = _get_utf8_sequence_length((const guint8 *) raw + run, raw_len - run);
+
+      /* U+0080-U+00FF are checked against unsafe_chars by the slow path */
+      if (seq_len == 0 || (unsafe_chars && c <= 0xC3))
+        break;
+      run += seq_len;
+    }
+  return run;
+}
+
 static void
 _append_unsafe_utf8_as_escaped_with_specific_length(GString *escaped_output, const gchar *raw,
                                                     gsize raw_len,
@@ -119,8 +216,18 @@ _append_unsafe_utf8_as_escaped_with_specific_length(GString *escaped_output, con
   const gchar *raw_end = raw + raw_len;
 
   while (raw < raw_end)
-    _append_escaped_utf8_character(escaped_output, &raw, raw_end - raw, unsafe_chars,
-                                   control_format, invalid_format);
+    {
+      gsize run = _find_safe_run(raw, raw_end - raw, unsafe_chars);
+
+      if (run > 0)
+        {
+          g_string_append_len(escaped_output, raw, run);
+          raw += run;
+          continue;
+        }
+      _append_escaped_utf8_character(escaped_output, &raw, raw_end - raw, unsafe_chars,
+                                     control_format, invalid_format);
+    }
 }
 
 static void
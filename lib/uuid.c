@@ -23,6 +23,7 @@
  */
 
 #include "uuid.h"
+#include "tls-support.h"
 
 #include <openssl/rand.h>
 #include <arpa/inet.h>
@@ -58,3 +59,93 @@ uuid_gen_random(gchar *buf, gsize buflen)
              uuid.node[3], uuid.node[4], uuid.node[5]);
 
 }
+
+/*
+ * UUIDv7 (RFC 9562): 48 bits of Unix time in milliseconds, followed by a
+ * 12 bit per-thread sequence number that keeps IDs generated by the same
+ * thread within the same millisecond monotonic, and 62 bits of randomness.
+ *
+ * The random part comes from a per-thread xorshift64* generator seeded
+ * from RAND_bytes(), so generating an ID needs neither locking nor a call
+ * into OpenSSL.  These IDs are unique but not unpredictable, use
+ * uuid_gen_random() where that matters.
+ */
+TLS_BLOCK_START
+{
+  guint64 uuid_v7_last_msec;
+  guint32 uuid_v7_seq;
+  guint64 uuid_v7_rng;
+}
+TLS_BLOCK_END;
+
+#define uuid_v7_last_msec  __tls_deref(uuid_v7_last_msec)
+#define uuid_v7_seq        __tls_deref(uuid_v7_seq)
+#define uuid_v7_rng        __tls_deref(uuid_v7_rng)
+
+#define UUID_V7_SEQ_MAX 0xFFF
+
+static guint64
+_uuid_v7_random(void)
+{
+  while (G_UNLIKELY(uuid_v7_rng == 0))
+    RAND_bytes((guchar *) &uuid_v7_rng, sizeof(uuid_v7_rng));
+
+  uuid_v7_rng ^= uuid_v7_rng >> 12;
+  uuid_v7_rng ^= uuid_v7_rng << 25;
+  uuid_v7_rng ^= uuid_v7_rng >> 27;
+  return uuid_v7_rng * G_GUINT64_CONSTANT(0x2545F4914F6CDD1D);
+}
+
+static void
+_uuid_v7_next_timestamp(guint64 *msec, guint32 *seq)
+{
+  guint64 now = g_get_real_time() / 1000;
+
+  /* the clock stepping backwards must not break monotonicity either */
+  if (now > uuid_v7_last_msec)
+    {
+      uuid_v7_last_msec = now;
+      uuid_v7_seq = 0;
+    }
+  else if (++uuid_v7_seq > UUID_V7_SEQ_MAX)
+    {
+      uuid_v7_last_msec++;
+      uuid_v7_seq = 0;
+    }
+
+  *msec = uuid_v7_last_msec;
+  *seq = uuid_v7_seq;
+}
+
+void
+uuid_gen_v7(gchar *buf, gsize buflen)
+{
+  static const gchar hex_digits[] = "0123456789abcdef";
+  guchar uuid[16];
+  guint64 msec;
+  guint32 seq;
+
+  /* 36 characters and the terminating NUL */
+  g_assert(buflen >= 37);
+
+  _uuid_v7_next_timestamp(&msec, &seq);
+  guint64 rnd = _uuid_v7_random();
+
+  for (gint i = 0; i < 6; i++)
+    uuid[i] = (msec >> (40 - i * 8)) & 0xFF;
+  uuid[6] = 0x70 | ((seq >> 8) & 0x0F);
+  uuid[7] = seq & 0xFF;
+  uuid[8] = 0x80 | ((rnd >> 56) & 0x3F);
+  for (gint i = 9; i < 16; i++)
+    uuid[i] = (rnd >> ((15 - i) * 8)) & 0xFF;
+
+  gchar *p = buf;
+  for (gint i = 0; i < 16; i++)
+    {
+      if (i == 4 || i == 6 || i == 8 || i == 10)
+        *p++ = '-';
+      *p++ = hex_digits[uuid[i] >> 4];
+      *p++ = hex_digits[uuid[i] & 0x0F];
+    }
+  *p = 0;
+}
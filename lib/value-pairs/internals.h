@@ -28,6 +28,8 @@
 #include "syslog-ng.h"
 #include "atomic.h"
 
+typedef struct _VPHandleDecisions VPHandleDecisions;
+
 struct _ValuePairs
 {
   GAtomicCounter ref_cnt;
@@ -47,6 +49,21 @@ struct _ValuePairs
    * strings to avoid leaking type information to callers */
   gboolean cast_to_strings;
   gboolean explicit_cast_to_strings;
+
+  /* the include/exclude decisions of the name-value pairs seen so far,
+   * indexed by NVHandle, replaced by a larger copy as new handles show up.
+   * The copies replaced are kept until the next reset, as other threads
+   * may still be using them. */
+  VPHandleDecisions *handle_decisions;
+  GList *retired_handle_decisions;
+  GMutex handle_decisions_lock;
+
+  /* the transformed names of builtins and explicit pairs, indexed by
+   * static_keys, see vp_update_static_keys() */
+  GHashTable *static_keys;
+  GPtrArray *static_key_names;
+  GArray *builtin_keys;
+  GArray *vpair_keys;
 };
 
 
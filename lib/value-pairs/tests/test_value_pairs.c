@@ -309,6 +309,60 @@ Test(value_pairs, test_transformer_upper)
   g_ptr_array_free(transformers, TRUE);
 }
 
+static gboolean
+_count_keys_foreach(const gchar *name, LogMessageValueType type, const gchar *value,
+                    gsize value_len, gpointer user_data)
+{
+  gint *count = (gint *) user_data;
+
+  if (strncmp(name, "dyn.", 4) == 0)
+    (*count)++;
+  return FALSE;
+}
+
+static gint
+_count_dynamic_keys(ValuePairs *vp, LogMessage *msg)
+{
+  LogTemplateEvalOptions options = {&template_options, LTZ_LOCAL, 11, NULL, LM_VT_STRING};
+  gint count = 0;
+
+  value_pairs_foreach(vp, _count_keys_foreach, msg, &options, &count);
+  return count;
+}
+
+Test(value_pairs, test_decisions_are_remembered_for_many_handles)
+{
+  ValuePairs *vp = value_pairs_new(configuration);
+  LogMessage *msg = log_msg_new_empty();
+  LogMessage *other_msg = log_msg_new_empty();
+
+  value_pairs_add_scope(vp, "nv-pairs");
+  value_pairs_add_glob_pattern(vp, "dyn.*7", FALSE);
+
+  /* enough names to grow the decision bitmap a couple of times */
+  for (gint i = 0; i < 5000; i++)
+    {
+      gchar name[32];
+
+      g_snprintf(name, sizeof(name), "dyn.%d", i);
+      log_msg_set_value_by_name(msg, name, "value", -1);
+      if (i % 2 == 0)
+        log_msg_set_value_by_name(other_msg, name, "value", -1);
+    }
+
+  cr_assert_eq(_count_dynamic_keys(vp, msg), 4500);
+  cr_assert_eq(_count_dynamic_keys(vp, msg), 4500);
+  cr_assert_eq(_count_dynamic_keys(vp, other_msg), 2500);
+
+  /* changing the configuration forgets the decisions made so far */
+  value_pairs_add_glob_pattern(vp, "dyn.*", FALSE);
+  cr_assert_eq(_count_dynamic_keys(vp, msg), 0);
+
+  log_msg_unref(other_msg);
+  log_msg_unref(msg);
+  value_pairs_unref(vp);
+}
+
 static ValuePairs *
 _create_value_pairs_for_include_bytes_tc(void)
 {
@@ -52,7 +52,7 @@ typedef struct
   /* we don't own any of the fields here, it is assumed that allocations are
    * managed by the caller */
 
-  GString *name;
+  const gchar *name;
   GString *value;
   LogMessageValueType type_hint;
 } VPResultValue;
@@ -181,7 +181,7 @@ vp_pair_conf_free(VPPairConf *vpc)
 }
 
 static void
-vp_result_value_init(VPResultValue *rv, GString *name, LogMessageValueType type_hint, GString *value)
+vp_result_value_init(VPResultValue *rv, const gchar *name, LogMessageValueType type_hint, GString *value)
 {
   rv->type_hint = type_hint;
   rv->name = name;
@@ -203,8 +203,9 @@ vp_results_deinit(VPResults *results)
   g_array_free(results->values, TRUE);
 }
 
+/* name must stay valid until the results are deinitialized, it is not copied */
 static void
-vp_results_insert(VPResults *results, GString *name, LogMessageValueType type_hint, GString *value)
+vp_results_insert(VPResults *results, const gchar *name, LogMessageValueType type_hint, GString *value)
 {
   VPResultValue *rv;
   gint ndx = results->values->len;
@@ -212,21 +213,22 @@ vp_results_insert(VPResults *results, GString *name, LogMessageValueType type_hi
   g_array_set_size(results->values, ndx + 1);
   rv = &g_array_index(results->values, VPResultValue, ndx);
   vp_result_value_init(rv, name, type_hint, value);
-  /* GTree takes over ownership of name */
-  g_tree_insert(results->result_tree, name->str, GINT_TO_POINTER(ndx));
+  g_tree_insert(results->result_tree, (gchar *) name, GINT_TO_POINTER(ndx));
 }
 
-static GString *
+/* returns key itself if there are no transformations, otherwise the
+ * transformed name in a scratch buffer */
+static const gchar *
 vp_transform_apply (ValuePairs *vp, const gchar *key)
 {
   gint i;
-  GString *result = scratch_buffers_alloc();
-
-  g_string_assign(result, key);
 
   if (vp->transforms->len == 0)
-    return result;
+    return key;
+
+  GString *result = scratch_buffers_alloc();
 
+  g_string_assign(result, key);
   for (i = 0; i < vp->transforms->len; i++)
     {
       ValuePairsTransformSet *t = (ValuePairsTransformSet *) g_ptr_array_index(vp->transforms, i);
@@ -234,7 +236,114 @@ vp_transform_apply (ValuePairs *vp, const gchar *key)
       value_pairs_transform_set_apply(t, result);
     }
 
-  return result;
+  return result->str;
+}
+
+/*
+ * Cache of include/exclude decisions
+ *
+ * Whether a name-value pair is included depends on its name only, so the
+ * globs are evaluated once for each NVHandle, the result is stored in a
+ * bitmap: two bits per handle, one recording whether the handle was
+ * evaluated already, the other one its result.  Bits are only ever set,
+ * so concurrent updates are merged with an atomic OR.
+ */
+
+#define VP_DECISION_KNOWN          0x1
+#define VP_DECISION_INCLUDE        0x2
+#define VP_DECISION_BITS           2
+#define VP_DECISIONS_PER_WORD      (32 / VP_DECISION_BITS)
+#define VP_DECISIONS_INITIAL_WORDS 64
+
+struct _VPHandleDecisions
+{
+  guint num_words;
+  gint words[];
+};
+
+static guint
+vp_handle_decision_lookup(ValuePairs *vp, NVHandle handle)
+{
+  VPHandleDecisions *decisions = g_atomic_pointer_get(&vp->handle_decisions);
+  guint ndx = handle / VP_DECISIONS_PER_WORD;
+
+  if (!decisions || ndx >= decisions->num_words)
+    return 0;
+
+  guint word = g_atomic_int_get(&decisions->words[ndx]);
+  return (word >> ((handle % VP_DECISIONS_PER_WORD) * VP_DECISION_BITS)) & (VP_DECISION_KNOWN | VP_DECISION_INCLUDE);
+}
+
+static VPHandleDecisions *
+vp_handle_decisions_grow(ValuePairs *vp, guint min_words)
+{
+  g_mutex_lock(&vp->handle_decisions_lock);
+
+  VPHandleDecisions *old_decisions = vp->handle_decisions;
+  if (old_decisions && old_decisions->num_words >= min_words)
+    {
+      /* someone else was faster */
+      g_mutex_unlock(&vp->handle_decisions_lock);
+      return old_decisions;
+    }
+
+  guint num_words = old_decisions ? old_decisions->num_words : VP_DECISIONS_INITIAL_WORDS;
+  while (num_words < min_words)
+    num_words *= 2;
+
+  VPHandleDecisions *decisions = g_malloc0(sizeof(VPHandleDecisions) + num_words * sizeof(decisions->words[0]));
+  decisions->num_words = num_words;
+  if (old_decisions)
+    {
+      /* decisions stored concurrently into the old copy may be lost, they
+       * are simply evaluated again */
+      for (guint i = 0; i < old_decisions->num_words; i++)
+        decisions->words[i] = g_atomic_int_get(&old_decisions->words[i]);
+      vp->retired_handle_decisions = g_list_prepend(vp->retired_handle_decisions, old_decisions);
+    }
+  g_atomic_pointer_set(&vp->handle_decisions, decisions);
+
+  g_mutex_unlock(&vp->handle_decisions_lock);
+  return decisions;
+}
+
+static void
+vp_handle_decision_store(ValuePairs *vp, NVHandle handle, gboolean include)
+{
+  VPHandleDecisions *decisions = g_atomic_pointer_get(&vp->handle_decisions);
+  guint ndx = handle / VP_DECISIONS_PER_WORD;
+  guint bits = VP_DECISION_KNOWN | (include ? VP_DECISION_INCLUDE : 0);
+
+  if (!decisions || ndx >= decisions->num_words)
+    decisions = vp_handle_decisions_grow(vp, ndx + 1);
+
+  g_atomic_int_or((guint *) &decisions->words[ndx], bits << ((handle % VP_DECISIONS_PER_WORD) * VP_DECISION_BITS));
+}
+
+/* the configuration changed, forget everything, only called at init time */
+static void
+vp_handle_decisions_reset(ValuePairs *vp)
+{
+  g_list_free_full(vp->retired_handle_decisions, g_free);
+  vp->retired_handle_decisions = NULL;
+  g_free(vp->handle_decisions);
+  vp->handle_decisions = NULL;
+}
+
+/* formats a pair requested by the user, returns FALSE if it is to be omitted */
+static gboolean
+vp_pair_conf_format(ValuePairs *vp, VPPairConf *vpc, LogMessage *msg, LogTemplateEvalOptions *options,
+                    GString *sb, LogMessageValueType *type)
+{
+  log_template_append_format_value_and_type((LogTemplate *)vpc->template, msg, options, sb, type);
+
+  if (vp->omit_empty_values && sb->len == 0)
+    return FALSE;
+  if (!vp->include_bytes && (*type == LM_VT_BYTES || *type == LM_VT_PROTOBUF))
+    return FALSE;
+  if (vp->cast_to_strings && vpc->template->explicit_type_hint == LM_VT_NONE)
+    *type = LM_VT_STRING;
+  return TRUE;
 }
 
 /* runs over the name-value pairs requested by the user (e.g. with value_pairs_add_pair) */
@@ -249,34 +358,16 @@ vp_pairs_foreach(gpointer data, gpointer user_data)
   VPPairConf *vpc = (VPPairConf *)data;
   LogMessageValueType type;
 
-  log_template_append_format_value_and_type((LogTemplate *)vpc->template, msg, options, sb, &type);
-
-  if (vp->omit_empty_values && sb->len == 0)
+  if (!vp_pair_conf_format(vp, vpc, msg, options, sb, &type))
     return;
-  if (!vp->include_bytes && (type == LM_VT_BYTES || type == LM_VT_PROTOBUF))
-    return;
-  if (vp->cast_to_strings && vpc->template->explicit_type_hint == LM_VT_NONE)
-    type = LM_VT_STRING;
   vp_results_insert(results, vp_transform_apply(vp, vpc->name), type, sb);
 }
 
-/* runs over the LogMessage nv-pairs, and inserts them unless excluded */
 static gboolean
-vp_msg_nvpairs_foreach(NVHandle handle, const gchar *name,
-                       const gchar *value, gssize value_len,
-                       LogMessageValueType type, gpointer user_data)
+vp_eval_nvpair_inclusion(ValuePairs *vp, NVHandle handle, const gchar *name)
 {
-  ValuePairs *vp = ((gpointer *)user_data)[0];
-  VPResults *results = ((gpointer *)user_data)[5];
   guint j;
   gboolean inc;
-  GString *sb;
-
-  if (vp->omit_empty_values && value_len == 0)
-    return FALSE;
-
-  if ((type == LM_VT_BYTES || type == LM_VT_PROTOBUF) && !vp->include_bytes)
-    return FALSE;
 
   inc = (name[0] == '.' && (vp->scopes & VPS_DOT_NV_PAIRS)) ||
         (name[0] != '.' && (vp->scopes & VPS_NV_PAIRS)) ||
@@ -288,8 +379,45 @@ vp_msg_nvpairs_foreach(NVHandle handle, const gchar *name,
       if (vp_pattern_spec_eval(vps, name))
         inc = vps->include;
     }
+  return inc;
+}
+
+static gboolean
+vp_is_nvpair_included(ValuePairs *vp, NVHandle handle, const gchar *name)
+{
+  guint decision = vp_handle_decision_lookup(vp, handle);
+
+  if (decision & VP_DECISION_KNOWN)
+    return !!(decision & VP_DECISION_INCLUDE);
+
+  gboolean inc = vp_eval_nvpair_inclusion(vp, handle, name);
+  vp_handle_decision_store(vp, handle, inc);
+  return inc;
+}
+
+static gboolean
+vp_is_nvpair_selected(ValuePairs *vp, NVHandle handle, const gchar *name, gssize value_len, LogMessageValueType type)
+{
+  if (vp->omit_empty_values && value_len == 0)
+    return FALSE;
+
+  if ((type == LM_VT_BYTES || type == LM_VT_PROTOBUF) && !vp->include_bytes)
+    return FALSE;
+
+  return vp_is_nvpair_included(vp, handle, name);
+}
+
+/* runs over the LogMessage nv-pairs, and inserts them unless excluded */
+static gboolean
+vp_msg_nvpairs_foreach(NVHandle handle, const gchar *name,
+                       const gchar *value, gssize value_len,
+                       LogMessageValueType type, gpointer user_data)
+{
+  ValuePairs *vp = ((gpointer *)user_data)[0];
+  VPResults *results = ((gpointer *)user_data)[5];
+  GString *sb;
 
-  if (!inc)
+  if (!vp_is_nvpair_selected(vp, handle, name, value_len, type))
     return FALSE;
 
   sb = scratch_buffers_alloc();
@@ -350,9 +478,64 @@ vp_merge_set(ValuePairs *vp, ValuePairSpec *set)
 }
 
 
+/*
+ * Keys of the builtins and the explicit pairs
+ *
+ * These are known in advance, so their names are transformed once, and
+ * each distinct name gets an index.  value_pairs_foreach_unsorted() uses
+ * these to find the values overridden by others of the same name.
+ */
+
+static gint
+vp_static_keys_add(ValuePairs *vp, const gchar *name)
+{
+  GString *key = g_string_new(name);
+  gpointer ndx;
+
+  for (gint i = 0; i < vp->transforms->len; i++)
+    value_pairs_transform_set_apply(g_ptr_array_index(vp->transforms, i), key);
+
+  if (g_hash_table_lookup_extended(vp->static_keys, key->str, NULL, &ndx))
+    {
+      g_string_free(key, TRUE);
+      return GPOINTER_TO_INT(ndx);
+    }
+
+  g_ptr_array_add(vp->static_key_names, g_string_free(key, FALSE));
+  gint new_ndx = vp->static_key_names->len - 1;
+  g_hash_table_insert(vp->static_keys, g_ptr_array_index(vp->static_key_names, new_ndx), GINT_TO_POINTER(new_ndx));
+  return new_ndx;
+}
+
+static void
+vp_update_static_keys(ValuePairs *vp)
+{
+  g_hash_table_remove_all(vp->static_keys);
+  g_ptr_array_set_size(vp->static_key_names, 0);
+  g_array_set_size(vp->builtin_keys, 0);
+  g_array_set_size(vp->vpair_keys, 0);
+
+  for (gint i = 0; i < vp->builtins->len; i++)
+    {
+      ValuePairSpec *spec = (ValuePairSpec *) g_ptr_array_index(vp->builtins, i);
+      gint ndx = vp_static_keys_add(vp, spec->name);
+
+      g_array_append_val(vp->builtin_keys, ndx);
+    }
+
+  for (gint i = 0; i < vp->vpairs->len; i++)
+    {
+      VPPairConf *vpc = (VPPairConf *) g_ptr_array_index(vp->vpairs, i);
+      gint ndx = vp_static_keys_add(vp, vpc->name);
+
+      g_array_append_val(vp->vpair_keys, ndx);
+    }
+}
+
 static void
 vp_update_builtin_list_of_values(ValuePairs *vp)
 {
+  vp_handle_decisions_reset(vp);
   g_ptr_array_set_size(vp->builtins, 0);
 
   if (vp->patterns->len > 0)
@@ -369,6 +552,39 @@ vp_update_builtin_list_of_values(ValuePairs *vp)
 
   if (vp->scopes & VPS_ALL_MACROS)
     vp_merge_set(vp, all_macros);
+
+  vp_update_static_keys(vp);
+}
+
+/* formats a builtin value, returns FALSE if it is empty */
+static gboolean
+vp_builtin_format(ValuePairs *vp, ValuePairSpec *spec, LogMessage *msg, LogTemplateEvalOptions *options,
+                  GString *sb, LogMessageValueType *type)
+{
+  switch (spec->type)
+    {
+    case VPT_MACRO:
+      log_macro_expand(spec->id, options, msg, sb, type);
+      break;
+    case VPT_NVPAIR:
+    {
+      const gchar *nv;
+      gssize len;
+
+      nv = log_msg_get_value_with_type(msg, (NVHandle) spec->id, &len, type);
+      g_string_append_len(sb, nv, len);
+      break;
+    }
+    default:
+      g_assert_not_reached();
+    }
+
+  if (sb->len == 0)
+    return FALSE;
+
+  if (vp->cast_to_strings)
+    *type = LM_VT_STRING;
+  return TRUE;
 }
 
 static void
@@ -383,32 +599,8 @@ vp_merge_builtins(ValuePairs *vp, VPResults *results, LogMessage *msg, LogTempla
       LogMessageValueType type;
 
       sb = scratch_buffers_alloc();
-
-      switch (spec->type)
-        {
-        case VPT_MACRO:
-          log_macro_expand(spec->id, options, msg, sb, &type);
-          break;
-        case VPT_NVPAIR:
-        {
-          const gchar *nv;
-          gssize len;
-
-          nv = log_msg_get_value_with_type(msg, (NVHandle) spec->id, &len, &type);
-          g_string_append_len(sb, nv, len);
-          break;
-        }
-        default:
-          g_assert_not_reached();
-        }
-
-      if (sb->len == 0)
-        {
-          continue;
-        }
-
-      if (vp->cast_to_strings)
-        type = LM_VT_STRING;
+      if (!vp_builtin_format(vp, spec, msg, options, sb, &type))
+        continue;
 
       vp_results_insert(results, vp_transform_apply(vp, spec->name), type, sb);
     }
@@ -477,6 +669,118 @@ value_pairs_foreach_sorted (ValuePairs *vp, VPForeachFunc func,
   return result;
 }
 
+typedef struct
+{
+  ValuePairs *vp;
+  VPForeachFunc func;
+  gpointer user_data;
+
+  /* one byte for each static key, set if it was emitted already */
+  guint8 *emitted;
+  gboolean success;
+} VPStreamState;
+
+static gboolean
+vp_stream_emit(VPStreamState *state, const gchar *name, LogMessageValueType type,
+               const gchar *value, gsize value_len)
+{
+  if (state->func(name, type, value, value_len, state->user_data))
+    {
+      msg_trace("value_pairs_foreach: callback indicates failure",
+                evt_tag_str("name", name),
+                evt_tag_mem("value", value, value_len),
+                evt_tag_int("type", type));
+      state->success = FALSE;
+    }
+  return state->success;
+}
+
+static gboolean
+vp_stream_nvpair(NVHandle handle, const gchar *name,
+                 const gchar *value, gssize value_len,
+                 LogMessageValueType type, gpointer user_data)
+{
+  VPStreamState *state = (VPStreamState *) user_data;
+  ValuePairs *vp = state->vp;
+  gpointer ndx;
+
+  if (!vp_is_nvpair_selected(vp, handle, name, value_len, type))
+    return FALSE;
+
+  name = vp_transform_apply(vp, name);
+  if (g_hash_table_lookup_extended(vp->static_keys, name, NULL, &ndx) && state->emitted[GPOINTER_TO_INT(ndx)])
+    return FALSE;
+
+  if (vp->cast_to_strings)
+    type = LM_VT_STRING;
+
+  return !vp_stream_emit(state, name, type, value, value_len);
+}
+
+/*
+ * Same as value_pairs_foreach(), but without collecting and sorting the
+ * results first: values are passed to func as they are found, in no
+ * particular order.  Just like with the sorted variant, explicit pairs
+ * override builtins, which in turn override name-value pairs of the same
+ * name, but name-value pairs renamed to the same key by transformations
+ * are all passed to func.
+ */
+gboolean
+value_pairs_foreach_unsorted(ValuePairs *vp, VPForeachFunc func,
+                             LogMessage *msg, LogTemplateEvalOptions *options,
+                             gpointer user_data)
+{
+  ScratchBuffersMarker mark;
+  GString *emitted = scratch_buffers_alloc_and_mark(&mark);
+  VPStreamState state =
+  {
+    .vp = vp,
+    .func = func,
+    .user_data = user_data,
+    .success = TRUE,
+  };
+
+  g_string_set_size(emitted, vp->static_key_names->len);
+  memset(emitted->str, 0, emitted->len);
+  state.emitted = (guint8 *) emitted->str;
+
+  /* later pairs override earlier ones */
+  for (gint i = vp->vpairs->len - 1; i >= 0 && state.success; i--)
+    {
+      VPPairConf *vpc = (VPPairConf *) g_ptr_array_index(vp->vpairs, i);
+      gint ndx = g_array_index(vp->vpair_keys, gint, i);
+      GString *sb = scratch_buffers_alloc();
+      LogMessageValueType type;
+
+      if (state.emitted[ndx] || !vp_pair_conf_format(vp, vpc, msg, options, sb, &type))
+        continue;
+
+      state.emitted[ndx] = TRUE;
+      vp_stream_emit(&state, g_ptr_array_index(vp->static_key_names, ndx), type, sb->str, sb->len);
+    }
+
+  for (gint i = 0; i < vp->builtins->len && state.success; i++)
+    {
+      ValuePairSpec *spec = (ValuePairSpec *) g_ptr_array_index(vp->builtins, i);
+      gint ndx = g_array_index(vp->builtin_keys, gint, i);
+      GString *sb = scratch_buffers_alloc();
+      LogMessageValueType type;
+
+      if (state.emitted[ndx] || !vp_builtin_format(vp, spec, msg, options, sb, &type))
+        continue;
+
+      state.emitted[ndx] = TRUE;
+      vp_stream_emit(&state, g_ptr_array_index(vp->static_key_names, ndx), type, sb->str, sb->len);
+    }
+
+  if (state.success &&
+      (vp->scopes & (VPS_NV_PAIRS + VPS_DOT_NV_PAIRS + VPS_SDATA + VPS_RFC5424) || vp->patterns->len > 0))
+    log_msg_values_foreach(msg, vp_stream_nvpair, &state);
+
+  scratch_buffers_reclaim_marked(mark);
+  return state.success;
+}
+
 gboolean
 value_pairs_foreach(ValuePairs *vp, VPForeachFunc func,
                     LogMessage *msg, LogTemplateEvalOptions *options,
@@ -664,7 +968,7 @@ vp_walker_skip_sdata_enterprise_id(const gchar *name)
 static void
 _extract_token(vp_walk_state_t *state, const gchar *token_start, gsize token_len)
 {
-  g_ptr_array_add(state->tokens, g_strndup(token_start, token_len));
+  g_ptr_array_add(state->tokens, scratch_buffers_strndup(token_start, token_len));
 }
 
 static void
@@ -760,7 +1064,7 @@ _extract_tokens_with_custom_delimiter(vp_walk_state_t *state, const gchar *name)
 static GPtrArray *
 vp_walker_split_name_to_tokens(vp_walk_state_t *state, const gchar *name)
 {
-  state->tokens = g_ptr_array_sized_new(VP_STACK_INITIAL_SIZE);
+  g_ptr_array_set_size(state->tokens, 0);
 
   if (state->key_delimiter == '.')
     _extract_tokens_with_default_delimiter(state, name);
@@ -768,10 +1072,7 @@ vp_walker_split_name_to_tokens(vp_walk_state_t *state, const gchar *name)
     _extract_tokens_with_custom_delimiter(state, name);
 
   if (state->tokens->len == 0)
-    {
-      g_ptr_array_free(state->tokens, TRUE);
-      return NULL;
-    }
+    return NULL;
 
   return state->tokens;
 }
@@ -823,13 +1124,9 @@ vp_walker_start_containers_for_name(vp_walk_state_t *state,
                          NULL, NULL, state->user_data);
     }
 
-  /* The last token is the key (well, second to last, last being
-     NULL), so treat that normally. */
+  /* The last token is the key, so treat that normally.  Tokens are
+     scratch allocations, valid while the value is processed. */
   key = g_ptr_array_index(tokens, tokens->len - 1);
-  g_ptr_array_index(tokens, tokens->len - 1) = NULL;
-
-  g_ptr_array_foreach(tokens, (GFunc)g_free, NULL);
-  g_ptr_array_free(tokens, TRUE);
 
   return key;
 }
@@ -858,8 +1155,6 @@ value_pairs_walker(const gchar *name, LogMessageValueType type, const gchar *val
                                   NULL,
                                   state->user_data);
 
-  g_free(key);
-
   return result;
 }
 
@@ -889,6 +1184,7 @@ value_pairs_walk(ValuePairs *vp,
   state.obj_end = obj_end_func;
   state.process_value = process_value_func;
   state.key_delimiter = key_delimiter ? : '.';
+  state.tokens = g_ptr_array_sized_new(VP_STACK_INITIAL_SIZE);
   vp_stack_init(&state.stack);
 
   state.obj_start(NULL, NULL, NULL, NULL, NULL, user_data);
@@ -898,6 +1194,7 @@ value_pairs_walk(ValuePairs *vp,
   vp_walker_stack_unwind_all_containers(&state);
   state.obj_end(NULL, NULL, NULL, NULL, NULL, user_data);
   vp_stack_destroy(&state.stack);
+  g_ptr_array_free(state.tokens, TRUE);
 
   return result;
 }
@@ -996,6 +1293,11 @@ value_pairs_new(GlobalConfig *cfg)
   vp->patterns = g_ptr_array_new();
   vp->transforms = g_ptr_array_new();
   vp->cfg = cfg;
+  vp->static_keys = g_hash_table_new(g_str_hash, g_str_equal);
+  vp->static_key_names = g_ptr_array_new_with_free_func(g_free);
+  vp->builtin_keys = g_array_new(FALSE, FALSE, sizeof(gint));
+  vp->vpair_keys = g_array_new(FALSE, FALSE, sizeof(gint));
+  g_mutex_init(&vp->handle_decisions_lock);
 
   if (cfg_is_config_version_older(cfg, VERSION_VALUE_4_0))
     {
@@ -1045,6 +1347,12 @@ value_pairs_free (ValuePairs *vp)
     }
   g_ptr_array_free(vp->transforms, TRUE);
   g_ptr_array_free(vp->builtins, TRUE);
+  g_hash_table_destroy(vp->static_keys);
+  g_ptr_array_free(vp->static_key_names, TRUE);
+  g_array_free(vp->builtin_keys, TRUE);
+  g_array_free(vp->vpair_keys, TRUE);
+  vp_handle_decisions_reset(vp);
+  g_mutex_clear(&vp->handle_decisions_lock);
   g_free(vp);
 }
 
@@ -66,6 +66,9 @@ gboolean value_pairs_foreach_sorted(ValuePairs *vp, VPForeachFunc func,
 gboolean value_pairs_foreach(ValuePairs *vp, VPForeachFunc func,
                              LogMessage *msg, LogTemplateEvalOptions *options,
                              gpointer user_data);
+gboolean value_pairs_foreach_unsorted(ValuePairs *vp, VPForeachFunc func,
+                                      LogMessage *msg, LogTemplateEvalOptions *options,
+                                      gpointer user_data);
 
 gboolean value_pairs_walk(ValuePairs *vp,
                           VPWalkCallbackFunc obj_start_func,
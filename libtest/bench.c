@@ -0,0 +1,230 @@
+/*
+ * Copyright (c) 2024 One Identity LLC.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+
+#include "bench.h"
+#include "syslog-ng-config.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define BENCH_DEFAULT_ROUNDS 7
+#define BENCH_DEFAULT_MIN_TIME_MSEC 100
+#define BENCH_MAX_ITERATIONS (G_GUINT64_CONSTANT(1) << 40)
+
+static struct
+{
+  gchar *filter;
+  gchar *output;
+  gint rounds;
+  gint min_time_msec;
+  gboolean list;
+  GString *results;
+} bench =
+{
+  .rounds = BENCH_DEFAULT_ROUNDS,
+  .min_time_msec = BENCH_DEFAULT_MIN_TIME_MSEC,
+};
+
+gboolean
+bench_init(gint *argc, gchar ***argv)
+{
+  GError *error = NULL;
+  GOptionEntry options[] =
+  {
+    { "filter", 'f', 0, G_OPTION_ARG_STRING, &bench.filter, "Only run benchmarks matching a glob pattern", "PATTERN" },
+    { "output", 'o', 0, G_OPTION_ARG_FILENAME, &bench.output, "Write the JSON results to this file", "FILE" },
+    { "rounds", 'r', 0, G_OPTION_ARG_INT, &bench.rounds, "Number of measured rounds", "N" },
+    { "min-time", 't', 0, G_OPTION_ARG_INT, &bench.min_time_msec, "Minimum duration of a round", "MSEC" },
+    { "list", 'l', 0, G_OPTION_ARG_NONE, &bench.list, "List benchmarks instead of running them", NULL },
+    { NULL }
+  };
+
+  GOptionContext *ctx = g_option_context_new("- syslog-ng microbenchmarks");
+  g_option_context_add_main_entries(ctx, options, NULL);
+  if (!g_option_context_parse(ctx, argc, argv, &error))
+    {
+      fprintf(stderr, "Error parsing command line arguments: %s\n", error->message);
+      g_clear_error(&error);
+      g_option_context_free(ctx);
+      return FALSE;
+    }
+  g_option_context_free(ctx);
+
+  if (bench.rounds < 1 || bench.min_time_msec < 1)
+    {
+      fprintf(stderr, "--rounds and --min-time must be positive\n");
+      return FALSE;
+    }
+
+  bench.results = g_string_new("");
+  return TRUE;
+}
+
+gboolean
+bench_is_enabled(const gchar *name)
+{
+  return !bench.filter || g_pattern_match_simple(bench.filter, name);
+}
+
+static gint64
+_run_round(BenchFunc func, gpointer user_data, guint64 iterations)
+{
+  gint64 start = g_get_monotonic_time();
+  func(user_data, iterations);
+  return g_get_monotonic_time() - start;
+}
+
+/* the calibration rounds also serve as warm-up */
+static guint64
+_calibrate(BenchFunc func, gpointer user_data)
+{
+  gint64 min_time_usec = bench.min_time_msec * 1000;
+  guint64 iterations = 1;
+
+  while (iterations < BENCH_MAX_ITERATIONS)
+    {
+      gint64 elapsed = _run_round(func, user_data, iterations);
+
+      if (elapsed >= min_time_usec)
+        break;
+
+      /* aim a bit higher than the minimum, but never grow more than 100x at once */
+      guint64 factor = elapsed > 0 ? (min_time_usec * 5 / 4) / elapsed + 1 : 100;
+      iterations *= CLAMP(factor, 2, 100);
+    }
+  return iterations;
+}
+
+static gint
+_compare_doubles(gconstpointer a, gconstpointer b)
+{
+  gdouble x = *(const gdouble *) a;
+  gdouble y = *(const gdouble *) b;
+
+  return (x > y) - (x < y);
+}
+
+static void
+_append_separator(void)
+{
+  if (bench.results->len > 0)
+    g_string_append(bench.results, ",\n");
+  g_string_append(bench.results, "    ");
+}
+
+static void
+_append_double(GString *result, gdouble value)
+{
+  gchar buf[G_ASCII_DTOSTR_BUF_SIZE];
+
+  g_string_append(result, g_ascii_formatd(buf, sizeof(buf), "%.3f", value));
+}
+
+void
+bench_run(const gchar *name, BenchFunc func, gpointer user_data)
+{
+  if (!bench_is_enabled(name))
+    return;
+
+  if (bench.list)
+    {
+      printf("%s\n", name);
+      return;
+    }
+
+  guint64 iterations = _calibrate(func, user_data);
+  gdouble *ns_per_op = g_new(gdouble, bench.rounds);
+
+  for (gint i = 0; i < bench.rounds; i++)
+    ns_per_op[i] = _run_round(func, user_data, iterations) * 1000.0 / iterations;
+  qsort(ns_per_op, bench.rounds, sizeof(ns_per_op[0]), _compare_doubles);
+
+  gdouble median = ns_per_op[bench.rounds / 2];
+  if (bench.rounds % 2 == 0)
+    median = (median + ns_per_op[bench.rounds / 2 - 1]) / 2;
+
+  fprintf(stderr, "  %-32s %12.1f ns/op %14.0f ops/sec  (min %.1f, max %.1f, %" G_GUINT64_FORMAT " iterations)\n",
+          name, median, median > 0 ? 1e9 / median : 0, ns_per_op[0], ns_per_op[bench.rounds - 1], iterations);
+
+  _append_separator();
+  g_string_append_printf(bench.results, "{\"name\": \"%s\", \"iterations\": %" G_GUINT64_FORMAT ", \"rounds\": %d, ",
+                         name, iterations, bench.rounds);
+  g_string_append(bench.results, "\"ns_per_op\": {\"median\": ");
+  _append_double(bench.results, median);
+  g_string_append(bench.results, ", \"min\": ");
+  _append_double(bench.results, ns_per_op[0]);
+  g_string_append(bench.results, ", \"max\": ");
+  _append_double(bench.results, ns_per_op[bench.rounds - 1]);
+  g_string_append(bench.results, "}, \"ops_per_sec\": ");
+  _append_double(bench.results, median > 0 ? 1e9 / median : 0);
+  g_string_append(bench.results, "}");
+
+  g_free(ns_per_op);
+}
+
+void
+bench_skip(const gchar *name, const gchar *reason)
+{
+  if (!bench_is_enabled(name) || bench.list)
+    return;
+
+  fprintf(stderr, "  %-32s skipped: %s\n", name, reason);
+  _append_separator();
+  g_string_append_printf(bench.results, "{\"name\": \"%s\", \"skipped\": \"%s\"}", name, reason);
+}
+
+gint
+bench_finish(void)
+{
+  FILE *out = stdout;
+  gint rc = 0;
+
+  if (bench.list)
+    goto exit;
+
+  if (bench.output)
+    {
+      out = fopen(bench.output, "w");
+      if (!out)
+        {
+          fprintf(stderr, "Error opening output file: %s, error: %s\n", bench.output, g_strerror(errno));
+          rc = 1;
+          goto exit;
+        }
+    }
+
+  fprintf(out, "{\n  \"version\": \"%s\",\n  \"rounds\": %d,\n  \"min_time_msec\": %d,\n", SYSLOG_NG_VERSION,
+          bench.rounds, bench.min_time_msec);
+  fprintf(out, "  \"benchmarks\": [\n%s\n  ]\n}\n", bench.results->str);
+
+  if (out != stdout)
+    fclose(out);
+
+exit:
+  g_string_free(bench.results, TRUE);
+  g_free(bench.filter);
+  g_free(bench.output);
+  return rc;
+}
@@ -0,0 +1,47 @@
+/*
+ * Copyright (c) 2024 One Identity LLC.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+
+#ifndef LIBTEST_BENCH_H_INCLUDED
+#define LIBTEST_BENCH_H_INCLUDED 1
+
+#include <glib.h>
+
+/*
+ * Minimal microbenchmark harness.
+ *
+ * A benchmark is a function running its operation @iterations times.  The
+ * harness calibrates the number of iterations so that a round takes at
+ * least the configured minimum time, runs a warm-up round and then a
+ * number of measured rounds, and reports the median, minimum and maximum
+ * time per operation.  Results are emitted as a single JSON document.
+ */
+typedef void (*BenchFunc)(gpointer user_data, guint64 iterations);
+
+gboolean bench_init(gint *argc, gchar ***argv);
+gboolean bench_is_enabled(const gchar *name);
+void bench_run(const gchar *name, BenchFunc func, gpointer user_data);
+void bench_skip(const gchar *name, const gchar *reason);
+gint bench_finish(void);
+
+#endif
@@ -70,6 +70,17 @@ struct _LogTransportMock
   gpointer user_data;
 };
 
+/* binary safe, but still NUL terminated, as tests look at the chunks as strings */
+static gchar *
+_copy_written_chunk(gconstpointer data, gsize len)
+{
+  gchar *chunk = g_malloc(len + 1);
+
+  memcpy(chunk, data, len);
+  chunk[len] = 0;
+  return chunk;
+}
+
 static void
 destroy_write_buffer_element(gpointer d)
 {
@@ -256,7 +267,7 @@ log_transport_mock_write_method(LogTransport *s, const gpointer buf, gsize count
     count = self->write_chunk_limit;
 
   data.type = DATA_STRING;
-  data.iov.iov_base = g_strndup(buf, count);
+  data.iov.iov_base = _copy_written_chunk(buf, count);
   data.iov.iov_len = count;
   g_array_append_val(self->write_buffer, data);
 
@@ -280,7 +291,7 @@ log_transport_mock_writev_method(LogTransport *s, struct iovec *iov, gint iov_co
           sum + iov[i].iov_len > self->write_chunk_limit)
         value.iov.iov_len = self->write_chunk_limit - sum;
 
-      value.iov.iov_base = g_strndup(iov[i].iov_base, value.iov.iov_len);
+      value.iov.iov_base = _copy_written_chunk(iov[i].iov_base, value.iov.iov_len);
 
       g_array_append_val(self->write_buffer, value);
       sum += value.iov.iov_len;
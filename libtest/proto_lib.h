@@ -30,6 +30,7 @@
 extern LogProtoServerOptions proto_server_options;
 
 void assert_proto_server_status(LogProtoServer *proto, LogProtoStatus status, LogProtoStatus expected_status);
+LogProtoStatus proto_server_fetch(LogProtoServer *proto, const guchar **msg, gsize *msg_len);
 void assert_proto_server_fetch(LogProtoServer *proto, const gchar *expected_msg, gssize expected_msg_len);
 void assert_proto_server_fetch_single_read(LogProtoServer *proto, const gchar *expected_msg, gssize expected_msg_len);
 void assert_proto_server_fetch_failure(LogProtoServer *proto, LogProtoStatus expected_status,
@@ -101,3 +101,54 @@ send_some_messages(LogQueue *q, gint n, gboolean remove_from_backlog)
       log_msg_unref(msg);
     }
 }
+
+/* same as feed_some_messages(), but pushes them with a single log_queue_push_tail_batch() call */
+void
+feed_some_messages_in_batch(LogQueue *q, gint n)
+{
+  LogMessage **msgs = g_new(LogMessage *, n);
+  LogPathOptions *path_options = g_new(LogPathOptions, n);
+
+  for (gint i = 0; i < n; i++)
+    {
+      path_options[i] = (LogPathOptions) LOG_PATH_OPTIONS_INIT;
+      path_options[i].ack_needed = TRUE;
+      path_options[i].flow_control_requested = TRUE;
+
+      msgs[i] = log_msg_new_empty();
+      log_msg_add_ack(msgs[i], &path_options[i]);
+      msgs[i]->ack_func = test_ack;
+      fed_messages++;
+    }
+  log_queue_push_tail_batch(q, msgs, path_options, n);
+
+  g_free(path_options);
+  g_free(msgs);
+}
+
+/* same as send_some_messages(), but pops them with log_queue_pop_head_batch(), batch_size at a time */
+void
+send_some_messages_in_batch(LogQueue *q, gint n, gint batch_size, gboolean remove_from_backlog)
+{
+  LogMessage **msgs = g_new(LogMessage *, batch_size);
+  LogPathOptions *path_options = g_new(LogPathOptions, batch_size);
+
+  while (n > 0)
+    {
+      gint num_msgs = log_queue_pop_head_batch(q, msgs, path_options, MIN(n, batch_size));
+      cr_assert_gt(num_msgs, 0);
+
+      for (gint i = 0; i < num_msgs; i++)
+        {
+          if (path_options[i].ack_needed)
+            log_msg_ack(msgs[i], &path_options[i], AT_PROCESSED);
+          log_msg_unref(msgs[i]);
+        }
+      if (remove_from_backlog)
+        log_queue_ack_backlog(q, num_msgs);
+      n -= num_msgs;
+    }
+
+  g_free(path_options);
+  g_free(msgs);
+}
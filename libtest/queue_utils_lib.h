@@ -37,5 +37,8 @@ void feed_some_messages(LogQueue *q, int n);
 
 void send_some_messages(LogQueue *q, gint n, gboolean remove_from_backlog);
 
+void feed_some_messages_in_batch(LogQueue *q, gint n);
+void send_some_messages_in_batch(LogQueue *q, gint n, gint batch_size, gboolean remove_from_backlog);
+
 gsize get_one_message_serialized_size(void);
 #endif
@@ -32,10 +32,21 @@
 #include "context-info-db.h"
 #include "pathutils.h"
 #include "scratch-buffers.h"
+#include "module-config.h"
 
 #include <stdio.h>
 #include <string.h>
 
+#define MODULE_CONFIG_KEY "add-contextual-data"
+
+/* databases loaded by a configuration, shared by every parser that loads
+ * the same file with the same settings, not just by clones of one parser */
+typedef struct _ContextualDataConfig
+{
+  ModuleConfig super;
+  GHashTable *databases;
+} ContextualDataConfig;
+
 typedef struct AddContextualData
 {
   LogParser super;
@@ -261,6 +272,37 @@ error:
   return result;
 }
 
+static void
+_contextual_data_config_free(ModuleConfig *s)
+{
+  ContextualDataConfig *self = (ContextualDataConfig *) s;
+
+  g_hash_table_unref(self->databases);
+  module_config_free_method(s);
+}
+
+static ContextualDataConfig *
+_contextual_data_config_get(GlobalConfig *cfg)
+{
+  ContextualDataConfig *self = g_hash_table_lookup(cfg->module_config, MODULE_CONFIG_KEY);
+
+  if (!self)
+    {
+      self = g_new0(ContextualDataConfig, 1);
+      self->super.free_fn = _contextual_data_config_free;
+      self->databases = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+                                              (GDestroyNotify) context_info_db_unref);
+      g_hash_table_insert(cfg->module_config, g_strdup(MODULE_CONFIG_KEY), self);
+    }
+  return self;
+}
+
+static gchar *
+_format_database_key(AddContextualData *self, gboolean ordering_required)
+{
+  return g_strdup_printf("%s;%s;%d;%d", self->filename, self->prefix ? : "", self->ignore_case, ordering_required);
+}
+
 static gboolean
 _init_context_info_db(AddContextualData *self)
 {
@@ -276,12 +318,33 @@ _init_context_info_db(AddContextualData *self)
       return FALSE;
     }
 
+  gboolean ordering_required = self->selector && add_contextual_data_selector_is_ordering_required(self->selector);
+  ContextualDataConfig *config = _contextual_data_config_get(log_pipe_get_config(&self->super.super));
+  gchar *key = _format_database_key(self, ordering_required);
+
+  ContextInfoDB *shared_db = g_hash_table_lookup(config->databases, key);
+  if (shared_db)
+    {
+      msg_debug("add-contextual-data(): reusing database loaded by another parser",
+                evt_tag_str("filename", self->filename));
+      self->context_info_db = context_info_db_ref(shared_db);
+      g_free(key);
+      return TRUE;
+    }
+
   self->context_info_db = context_info_db_new(self->ignore_case);
 
-  if (self->selector && add_contextual_data_selector_is_ordering_required(self->selector))
+  if (ordering_required)
     context_info_db_enable_ordering(self->context_info_db);
 
-  return _load_context_info_db(self);
+  if (!_load_context_info_db(self))
+    {
+      g_free(key);
+      return FALSE;
+    }
+
+  g_hash_table_insert(config->databases, key, context_info_db_ref(self->context_info_db));
+  return TRUE;
 }
 
 static gboolean
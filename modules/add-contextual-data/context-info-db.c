@@ -30,23 +30,31 @@
 #include <stdio.h>
 #include <sys/types.h>
 
+/* The records are kept in a single array sorted by selector, the index is
+ * an open addressing hash table (linear probing) of the ranges that share
+ * the same selector.  Compared to a GHashTable of individually allocated
+ * ranges this is a single flat allocation, which matters with enrichment
+ * files of millions of rows.
+ */
+typedef struct _element_range
+{
+  guint32 hash;
+  guint32 offset;
+  guint32 length;
+} element_range;
+
 struct _ContextInfoDB
 {
   GAtomicCounter ref_cnt;
   GArray *data;
-  GHashTable *index;
+  element_range *index;
+  guint32 index_mask;
   gboolean is_data_indexed;
   gboolean is_ordering_enabled;
   GList *ordered_selectors;
   gboolean ignore_case;
 };
 
-typedef struct _element_range
-{
-  gsize offset;
-  gsize length;
-} element_range;
-
 static gint
 _contextual_data_record_cmp(gconstpointer k1, gconstpointer k2)
 {
@@ -70,6 +78,71 @@ _g_strcasecmp(gconstpointer a, gconstpointer b)
   return g_ascii_strcasecmp((const gchar *)a, (const gchar *)b);
 }
 
+static guint
+_str_case_insensitive_djb2_hash(const gchar *str)
+{
+  guint hash = 5381;
+  int c;
+
+  while ((c = *str++))
+    hash = ((hash << 5) + hash) + g_ascii_toupper(c);
+
+  return hash;
+}
+
+static guint32
+_selector_hash(ContextInfoDB *self, const gchar *selector)
+{
+  return self->ignore_case ? _str_case_insensitive_djb2_hash(selector) : g_str_hash(selector);
+}
+
+static gboolean
+_selector_eq(ContextInfoDB *self, const gchar *a, const gchar *b)
+{
+  return self->ignore_case ? _g_strcasecmp(a, b) == 0 : strcmp(a, b) == 0;
+}
+
+static const gchar *
+_range_selector(ContextInfoDB *self, const element_range *range)
+{
+  return g_array_index(self->data, ContextualDataRecord, range->offset).selector;
+}
+
+static void
+_index_clear(ContextInfoDB *self)
+{
+  g_free(self->index);
+  self->index = NULL;
+  self->index_mask = 0;
+}
+
+static void
+_index_alloc(ContextInfoDB *self, guint32 number_of_ranges)
+{
+  guint32 capacity = 16;
+
+  /* keep the load factor at or below 50% so probe sequences stay short */
+  while (capacity < number_of_ranges * 2)
+    capacity <<= 1;
+
+  self->index = g_new0(element_range, capacity);
+  self->index_mask = capacity - 1;
+}
+
+static void
+_index_add_range(ContextInfoDB *self, guint32 offset, guint32 length)
+{
+  guint32 hash = _selector_hash(self, g_array_index(self->data, ContextualDataRecord, offset).selector);
+  guint32 slot = hash & self->index_mask;
+
+  while (self->index[slot].length != 0)
+    slot = (slot + 1) & self->index_mask;
+
+  self->index[slot].hash = hash;
+  self->index[slot].offset = offset;
+  self->index[slot].length = length;
+}
+
 static gint
 _contextual_data_record_case_cmp(gconstpointer k1, gconstpointer k2)
 {
@@ -96,39 +169,32 @@ context_info_db_index(ContextInfoDB *self)
 {
   GCompareFunc record_cmp = self->ignore_case ? _contextual_data_record_case_cmp : _contextual_data_record_cmp;
 
+  _index_clear(self);
   if (self->data->len > 0)
     {
       g_array_sort(self->data, record_cmp);
-      gsize range_start = 0;
-      ContextualDataRecord *range_start_record =
-        &g_array_index(self->data, ContextualDataRecord, 0);
 
-      for (gsize i = 1; i < self->data->len; ++i)
+      guint32 number_of_ranges = 1;
+      for (guint32 i = 1; i < self->data->len; ++i)
         {
-          ContextualDataRecord *current_record =
-            &g_array_index(self->data, ContextualDataRecord, i);
+          if (record_cmp(&g_array_index(self->data, ContextualDataRecord, i - 1),
+                         &g_array_index(self->data, ContextualDataRecord, i)))
+            number_of_ranges++;
+        }
+      _index_alloc(self, number_of_ranges);
 
-          if (record_cmp(range_start_record, current_record))
+      guint32 range_start = 0;
+      for (guint32 i = 1; i < self->data->len; ++i)
+        {
+          if (record_cmp(&g_array_index(self->data, ContextualDataRecord, range_start),
+                         &g_array_index(self->data, ContextualDataRecord, i)))
             {
-              element_range *current_range = g_new(element_range, 1);
-              current_range->offset = range_start;
-              current_range->length = i - range_start;
-
-              g_hash_table_insert(self->index, range_start_record->selector,
-                                  current_range);
-
-              range_start_record = current_record;
+              _index_add_range(self, range_start, i - range_start);
               range_start = i;
             }
         }
+      _index_add_range(self, range_start, self->data->len - range_start);
 
-      {
-        element_range *last_range = g_new(element_range, 1);
-        last_range->offset = range_start;
-        last_range->length = self->data->len - range_start;
-        g_hash_table_insert(self->index, range_start_record->selector,
-                            last_range);
-      }
       self->is_data_indexed = TRUE;
     }
 }
@@ -147,30 +213,6 @@ _record_free(gpointer p)
   contextual_data_record_clean(rec);
 }
 
-static gboolean
-_strcase_eq(gconstpointer a, gconstpointer b)
-{
-  return _g_strcasecmp(a, b) == 0;
-}
-
-static guint
-_str_case_insensitive_djb2_hash(const gchar *str)
-{
-  guint hash = 5381;
-  int c;
-
-  while ((c = *str++))
-    hash = ((hash << 5) + hash) + g_ascii_toupper(c);
-
-  return hash;
-}
-
-static guint
-_strcase_hash(gconstpointer value)
-{
-  return _str_case_insensitive_djb2_hash((const gchar *)value);
-}
-
 static void
 _free_array(GArray *array)
 {
@@ -186,10 +228,7 @@ _free_array(GArray *array)
 static void
 _free(ContextInfoDB *self)
 {
-  if (self->index)
-    {
-      g_hash_table_unref(self->index);
-    }
+  _index_clear(self);
   if (self->data)
     {
       _free_array(self->data);
@@ -205,13 +244,24 @@ static element_range *
 _get_range_of_records(ContextInfoDB *self, const gchar *selector)
 {
   _ensure_indexed_db(self);
-  return (element_range *) g_hash_table_lookup(self->index, selector);
+  if (!self->index)
+    return NULL;
+
+  guint32 hash = _selector_hash(self, selector);
+  for (guint32 slot = hash & self->index_mask; self->index[slot].length != 0; slot = (slot + 1) & self->index_mask)
+    {
+      element_range *range = &self->index[slot];
+
+      if (range->hash == hash && _selector_eq(self, _range_selector(self, range), selector))
+        return range;
+    }
+  return NULL;
 }
 
 void
 context_info_db_purge(ContextInfoDB *self)
 {
-  g_hash_table_remove_all(self->index);
+  _index_clear(self);
   if (self->data->len > 0)
     self->data = g_array_remove_range(self->data, 0, self->data->len);
 }
@@ -287,8 +337,15 @@ context_info_db_is_loaded(const ContextInfoDB *self)
 GList *
 context_info_db_get_selectors(ContextInfoDB *self)
 {
+  GList *selectors = NULL;
+
   _ensure_indexed_db(self);
-  return g_hash_table_get_keys(self->index);
+  for (guint32 slot = 0; self->index && slot <= self->index_mask; slot++)
+    {
+      if (self->index[slot].length != 0)
+        selectors = g_list_prepend(selectors, (gpointer) _range_selector(self, &self->index[slot]));
+    }
+  return selectors;
 }
 
 static void
@@ -360,10 +417,7 @@ context_info_db_new(gboolean ignore_case)
   g_atomic_counter_set(&self->ref_cnt, 1);
 
   self->ignore_case = ignore_case;
-  GEqualFunc str_eq = self->ignore_case ? _strcase_eq : g_str_equal;
-  GHashFunc str_hash = self->ignore_case ? _strcase_hash : g_str_hash;
   self->data = g_array_new(FALSE, FALSE, sizeof(ContextualDataRecord));
-  self->index = g_hash_table_new_full(str_hash, str_eq, NULL, g_free);
   return self;
 }
 
@@ -159,6 +159,31 @@ Test(add_contextual_data, test_get_selectors)
   g_list_free(selectors);
 }
 
+Test(add_contextual_data, test_index_with_many_selectors)
+{
+  ContextInfoDB *context_info_db = context_info_db_new(FALSE);
+
+  _fill_context_info_db(context_info_db, "selector", "name", "value", 1000, 3);
+  context_info_db_index(context_info_db);
+
+  for (gint i = 0; i < 1000; i++)
+    {
+      gchar selector[32];
+
+      g_snprintf(selector, sizeof(selector), "selector-%d", i);
+      cr_assert(context_info_db_contains(context_info_db, selector), "missing selector: %s", selector);
+      cr_assert_eq(context_info_db_number_of_records(context_info_db, selector), 3);
+    }
+  cr_assert_not(context_info_db_contains(context_info_db, "selector-1000"));
+  cr_assert_not(context_info_db_contains(context_info_db, "selector"));
+
+  GList *selectors = context_info_db_get_selectors(context_info_db);
+  cr_assert_eq(g_list_length(selectors), 1000);
+  g_list_free(selectors);
+
+  context_info_db_unref(context_info_db);
+}
+
 typedef struct _TestNVPair
 {
   const gchar *name;
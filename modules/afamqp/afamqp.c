@@ -37,6 +37,11 @@
 #include <amqp_tcp_socket.h>
 #include <amqp_ssl_socket.h>
 
+/* the time we wait for the broker to confirm a batch, in seconds */
+#define AMQP_CONFIRM_TIMEOUT 10
+/* batch size used with publisher-confirms(yes), if batch-lines() is not set */
+#define AMQP_DEFAULT_CONFIRM_BATCH_LINES 100
+
 typedef struct
 {
   LogThreadedDestDriver super;
@@ -49,6 +54,7 @@ typedef struct
 
   gboolean declare;
   gint persistent;
+  gboolean publisher_confirms;
 
   gchar *vhost;
   gchar *host;
@@ -72,6 +78,17 @@ typedef struct
   amqp_socket_t *sockfd;
   amqp_table_entry_t *entries;
   gint32 max_entries;
+  /* storage behind the header table, reused between messages */
+  GPtrArray *entry_buffers;
+
+  /* publisher confirms: delivery tags are counted from 1 on the channel,
+   * confirm_base is the tag of the first message of the current batch,
+   * confirmed[i] is set when the tag confirm_base + i was acked */
+  guint64 next_delivery_tag;
+  guint64 confirm_base;
+  GByteArray *confirmed;
+  gint num_confirmed;
+  gboolean confirm_failed;
 
   /* SSL props */
   gchar *ca_file;
@@ -198,6 +215,14 @@ afamqp_dd_set_persistent(LogDriver *s, gboolean persistent)
     self->persistent = 1;
 }
 
+void
+afamqp_dd_set_publisher_confirms(LogDriver *d, gboolean publisher_confirms)
+{
+  AMQPDestDriver *self = (AMQPDestDriver *) d;
+
+  self->publisher_confirms = publisher_confirms;
+}
+
 void
 afamqp_dd_set_value_pairs(LogDriver *d, ValuePairs *vp)
 {
@@ -529,6 +554,82 @@ afamqp_dd_login(AMQPDestDriver *self)
   return afamqp_is_ok(self, "Error during AMQP login", ret);
 }
 
+static void
+_reset_confirms(AMQPDestDriver *self)
+{
+  self->confirm_base = self->next_delivery_tag;
+  g_byte_array_set_size(self->confirmed, 0);
+  self->num_confirmed = 0;
+  self->confirm_failed = FALSE;
+}
+
+static void
+_confirm_delivery_tag(AMQPDestDriver *self, guint64 delivery_tag)
+{
+  /* confirms of an earlier, already rewound batch */
+  if (delivery_tag < self->confirm_base || delivery_tag - self->confirm_base >= self->confirmed->len)
+    return;
+
+  guint64 index = delivery_tag - self->confirm_base;
+  if (!self->confirmed->data[index])
+    {
+      self->confirmed->data[index] = TRUE;
+      self->num_confirmed++;
+    }
+}
+
+static void
+_confirm_delivery_tags(AMQPDestDriver *self, guint64 delivery_tag, gboolean multiple)
+{
+  if (!multiple)
+    {
+      _confirm_delivery_tag(self, delivery_tag);
+      return;
+    }
+
+  guint64 last = MIN(delivery_tag, self->confirm_base + self->confirmed->len - 1);
+  for (guint64 tag = self->confirm_base; tag <= last; tag++)
+    _confirm_delivery_tag(self, tag);
+}
+
+/* returns FALSE if the frame means that the channel is unusable */
+static gboolean
+_process_frame(AMQPDestDriver *self, amqp_frame_t *frame)
+{
+  if (frame->frame_type != AMQP_FRAME_METHOD)
+    return TRUE;
+
+  switch (frame->payload.method.id)
+    {
+    case AMQP_BASIC_ACK_METHOD:
+    {
+      amqp_basic_ack_t *ack = (amqp_basic_ack_t *) frame->payload.method.decoded;
+      _confirm_delivery_tags(self, ack->delivery_tag, ack->multiple);
+      return TRUE;
+    }
+    case AMQP_BASIC_NACK_METHOD:
+    {
+      amqp_basic_nack_t *nack = (amqp_basic_nack_t *) frame->payload.method.decoded;
+      if (nack->delivery_tag < self->confirm_base)
+        return TRUE;
+
+      msg_error("AMQP server rejected published messages",
+                evt_tag_str("driver", self->super.super.super.id),
+                evt_tag_long("delivery_tag", nack->delivery_tag),
+                evt_tag_int("multiple", nack->multiple));
+      self->confirm_failed = TRUE;
+      return TRUE;
+    }
+    case AMQP_CHANNEL_CLOSE_METHOD:
+    case AMQP_CONNECTION_CLOSE_METHOD:
+      msg_error("AMQP server closed the channel",
+                evt_tag_str("driver", self->super.super.super.id));
+      return FALSE;
+    default:
+      return TRUE;
+    }
+}
+
 static gboolean
 afamqp_dd_connect(AMQPDestDriver *self)
 {
@@ -578,6 +679,21 @@ afamqp_dd_connect(AMQPDestDriver *self)
       goto exception_amqp_dd_connect_failed_channel;
     }
 
+  if (self->publisher_confirms)
+    {
+      amqp_confirm_select(self->conn, 1);
+      ret = amqp_get_rpc_reply(self->conn);
+      if (!afamqp_is_ok(self, "Error enabling publisher confirms on the AMQP channel", ret))
+        {
+          goto exception_amqp_dd_connect_failed_exchange;
+        }
+      /* messages of the current batch sent on the previous channel will never be confirmed */
+      gboolean unconfirmed = self->confirmed->len > 0;
+      self->next_delivery_tag = 1;
+      _reset_confirms(self);
+      self->confirm_failed = unconfirmed;
+    }
+
   if (self->declare)
     {
       amqp_exchange_declare(self->conn, 1, amqp_cstring_bytes(self->exchange),
@@ -624,20 +740,27 @@ afamqp_vp_foreach(const gchar *name,
                   LogMessageValueType type, const gchar *value, gsize value_len,
                   gpointer user_data)
 {
-  amqp_table_entry_t **entries = (amqp_table_entry_t **) ((gpointer *)user_data)[0];
+  AMQPDestDriver *self = (AMQPDestDriver *) ((gpointer *)user_data)[0];
   gint *pos = (gint *) ((gpointer *)user_data)[1];
-  gint32 *max_size = (gint32 *) ((gpointer *)user_data)[2];
 
-  if (*pos == *max_size)
+  if (*pos == self->max_entries)
     {
-      *max_size *= 2;
-      *entries = g_renew(amqp_table_entry_t, *entries, *max_size);
+      self->max_entries *= 2;
+      self->entries = g_renew(amqp_table_entry_t, self->entries, self->max_entries);
     }
 
-  (*entries)[*pos].key = amqp_cstring_bytes(strdup(name));
-  (*entries)[*pos].value.kind = AMQP_FIELD_KIND_UTF8;
+  /* two buffers per entry, the key and the value, kept allocated across messages */
+  while ((gint) self->entry_buffers->len < (*pos + 1) * 2)
+    g_ptr_array_add(self->entry_buffers, g_string_sized_new(64));
+
+  GString *key = g_ptr_array_index(self->entry_buffers, *pos * 2);
+  GString *val = g_ptr_array_index(self->entry_buffers, *pos * 2 + 1);
+  g_string_assign(key, name);
+  g_string_assign(val, value);
 
-  (*entries)[*pos].value.value.bytes = amqp_cstring_bytes(strdup(value));
+  self->entries[*pos].key = amqp_cstring_bytes(key->str);
+  self->entries[*pos].value.kind = AMQP_FIELD_KIND_UTF8;
+  self->entries[*pos].value.value.bytes = amqp_cstring_bytes(val->str);
 
   (*pos)++;
 
@@ -668,7 +791,7 @@ afamqp_worker_publish(AMQPDestDriver *self, LogMessage *msg)
   GString *body = scratch_buffers_alloc();
   amqp_bytes_t body_bytes = amqp_cstring_bytes("");
 
-  gpointer user_data[] = { &self->entries, &pos, &self->max_entries };
+  gpointer user_data[] = { self, &pos };
 
   LogTemplateEvalOptions options = {&self->template_options,
                                     LTZ_SEND, self->super.worker.instance.seq_num, NULL, LM_VT_STRING
@@ -707,12 +830,6 @@ afamqp_worker_publish(AMQPDestDriver *self, LogMessage *msg)
                 evt_tag_int("time_reopen", self->super.time_reopen));
     }
 
-  while (--pos >= 0)
-    {
-      amqp_bytes_free(self->entries[pos].key);
-      amqp_bytes_free(self->entries[pos].value.value.bytes);
-    }
-
   return map_amqp_result_to_log_threaded_result(amqp_result);
 }
 
@@ -724,7 +841,73 @@ afamqp_worker_insert(LogThreadedDestDriver *s, LogMessage *msg)
   if (!afamqp_dd_connect(self))
     return LTR_NOT_CONNECTED;
 
-  return afamqp_worker_publish(self, msg);
+  LogThreadedResult result = afamqp_worker_publish(self, msg);
+  if (!self->publisher_confirms)
+    return result;
+
+  if (result != LTR_SUCCESS)
+    {
+      /* the batch is rewound, confirms of its messages are ignored from now on */
+      self->next_delivery_tag++;
+      _reset_confirms(self);
+      return result;
+    }
+
+  self->next_delivery_tag++;
+  g_byte_array_append(self->confirmed, (const guint8 *) "\0", 1);
+  return LTR_QUEUED;
+}
+
+/*
+ * The batch is acknowledged once the broker confirmed every message
+ * published since the last flush.  The broker may confirm them one by
+ * one or several at once (multiple=true), a nack fails the whole batch.
+ */
+static LogThreadedResult
+afamqp_worker_flush(LogThreadedDestDriver *s)
+{
+  AMQPDestDriver *self = (AMQPDestDriver *)s;
+  LogThreadedResult result = LTR_SUCCESS;
+
+  if (!self->publisher_confirms || self->confirmed->len == 0)
+    return LTR_SUCCESS;
+
+  gint64 deadline = g_get_monotonic_time() + AMQP_CONFIRM_TIMEOUT * G_USEC_PER_SEC;
+  while (!self->confirm_failed && self->num_confirmed < (gint) self->confirmed->len)
+    {
+      gint64 remaining = deadline - g_get_monotonic_time();
+      if (remaining <= 0)
+        {
+          msg_error("Timeout while waiting for AMQP publisher confirms",
+                    evt_tag_str("driver", self->super.super.super.id),
+                    evt_tag_int("confirmed", self->num_confirmed),
+                    evt_tag_int("published", self->confirmed->len));
+          result = LTR_ERROR;
+          break;
+        }
+
+      amqp_frame_t frame;
+      struct timeval tv = { remaining / G_USEC_PER_SEC, remaining % G_USEC_PER_SEC };
+      gint status = amqp_simple_wait_frame_noblock(self->conn, &frame, &tv);
+      if (status == AMQP_STATUS_TIMEOUT)
+        continue;
+
+      if (status != AMQP_STATUS_OK || !_process_frame(self, &frame))
+        {
+          msg_error("Error while waiting for AMQP publisher confirms",
+                    evt_tag_str("driver", self->super.super.super.id),
+                    evt_tag_str("error", amqp_error_string2(status)),
+                    evt_tag_int("time_reopen", self->super.time_reopen));
+          result = LTR_NOT_CONNECTED;
+          break;
+        }
+    }
+
+  if (result == LTR_SUCCESS && self->confirm_failed)
+    result = LTR_ERROR;
+
+  _reset_confirms(self);
+  return result;
 }
 
 static void
@@ -735,7 +918,15 @@ _handle_heartbeat(void *cookie)
   amqp_frame_t frame;
   struct timeval tv = {0, 0};
   gint status;
-  while (AMQP_STATUS_OK == (status = amqp_simple_wait_frame_noblock(self->conn, &frame, &tv)));
+  while (AMQP_STATUS_OK == (status = amqp_simple_wait_frame_noblock(self->conn, &frame, &tv)))
+    {
+      /* confirms arriving between two flushes are recorded here */
+      if (!_process_frame(self, &frame))
+        {
+          status = AMQP_STATUS_CONNECTION_CLOSED;
+          break;
+        }
+    }
   if (AMQP_STATUS_TIMEOUT != status)
     {
       msg_error("Unexpected error while reading from amqp server",
@@ -769,6 +960,9 @@ afamqp_dd_init(LogPipe *s)
       return FALSE;
     }
 
+  if (self->publisher_confirms && self->super.batch_lines == -1)
+    self->super.batch_lines = AMQP_DEFAULT_CONFIRM_BATCH_LINES;
+
   if (!log_threaded_dest_driver_init_method(s))
     return FALSE;
 
@@ -800,6 +994,8 @@ afamqp_dd_free(LogPipe *d)
   g_free(self->host);
   g_free(self->vhost);
   g_free(self->entries);
+  g_ptr_array_free(self->entry_buffers, TRUE);
+  g_byte_array_free(self->confirmed, TRUE);
   value_pairs_unref(self->vp);
   g_free(self->ca_file);
   g_free(self->key_file);
@@ -815,6 +1011,12 @@ afamqp_dd_worker_connect(LogThreadedDestDriver *s)
   return afamqp_dd_connect(self);
 }
 
+static void
+_free_entry_buffer(GString *buffer)
+{
+  g_string_free(buffer, TRUE);
+}
+
 /*
  * Plugin glue.
  */
@@ -833,6 +1035,7 @@ afamqp_dd_new(GlobalConfig *cfg)
   self->super.worker.connect = afamqp_dd_worker_connect;
   self->super.worker.disconnect = afamqp_dd_disconnect;
   self->super.worker.insert = afamqp_worker_insert;
+  self->super.worker.flush = afamqp_worker_flush;
 
   self->super.format_stats_key = afamqp_dd_format_stats_key;
   self->super.stats_source = stats_register_type("amqp");
@@ -854,6 +1057,8 @@ afamqp_dd_new(GlobalConfig *cfg)
 
   self->max_entries = 256;
   self->entries = g_new(amqp_table_entry_t, self->max_entries);
+  self->entry_buffers = g_ptr_array_new_with_free_func((GDestroyNotify) _free_entry_buffer);
+  self->confirmed = g_byte_array_new();
 
   log_template_options_defaults(&self->template_options);
   afamqp_dd_set_value_pairs(&self->super.super.super, value_pairs_new_default(cfg));
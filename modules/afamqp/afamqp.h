@@ -39,6 +39,7 @@ void afamqp_dd_set_vhost(LogDriver *d, const gchar *vhost);
 void afamqp_dd_set_routing_key(LogDriver *d, LogTemplate *routing_key_template);
 void afamqp_dd_set_body(LogDriver *d, LogTemplate *body_template);
 void afamqp_dd_set_persistent(LogDriver *d, gboolean persistent);
+void afamqp_dd_set_publisher_confirms(LogDriver *d, gboolean publisher_confirms);
 gboolean afamqp_dd_set_auth_method(LogDriver *d, const gchar *auth_method);
 void afamqp_dd_set_user(LogDriver *d, const gchar *user);
 void afamqp_dd_set_password(LogDriver *d, const gchar *password);
@@ -0,0 +1,373 @@
+/*
+ * Copyright (c) 2024 One Identity LLC.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#include <criterion/criterion.h>
+#include "libtest/cr_template.h"
+#include "libtest/grab-logging.h"
+
+#include <amqp.h>
+#include <amqp_framing.h>
+
+/*
+ * No broker is involved: the connection is a fake one, the publishes are
+ * recorded by the mocks below, and the frames read while waiting for the
+ * confirms come from a script.  Reading past the end of the script is a
+ * socket error.
+ */
+
+#define MAX_SCRIPTED_FRAMES 16
+
+typedef struct _ScriptedFrame
+{
+  amqp_frame_t frame;
+  union
+  {
+    amqp_basic_ack_t ack;
+    amqp_basic_nack_t nack;
+  } method;
+} ScriptedFrame;
+
+static ScriptedFrame scripted_frames[MAX_SCRIPTED_FRAMES];
+static gint num_scripted_frames;
+static gint next_scripted_frame;
+
+static GPtrArray *published;
+static gint publish_status;
+
+static amqp_rpc_reply_t
+_mock_amqp_get_rpc_reply(amqp_connection_state_t state)
+{
+  amqp_rpc_reply_t reply = { .reply_type = AMQP_RESPONSE_NORMAL };
+
+  return reply;
+}
+
+static int
+_mock_amqp_basic_publish(amqp_connection_state_t state, amqp_channel_t channel, amqp_bytes_t exchange,
+                         amqp_bytes_t routing_key, amqp_boolean_t mandatory, amqp_boolean_t immediate,
+                         const amqp_basic_properties_t *properties, amqp_bytes_t body)
+{
+  if (publish_status != AMQP_STATUS_OK)
+    return publish_status;
+
+  GString *record = g_string_new("");
+
+  for (gint i = 0; i < properties->headers.num_entries; i++)
+    {
+      amqp_table_entry_t *entry = &properties->headers.entries[i];
+
+      g_string_append_printf(record, "%.*s=%.*s;",
+                             (gint) entry->key.len, (const gchar *) entry->key.bytes,
+                             (gint) entry->value.value.bytes.len, (const gchar *) entry->value.value.bytes.bytes);
+    }
+  g_string_append_printf(record, "%.*s", (gint) body.len, (const gchar *) body.bytes);
+
+  g_ptr_array_add(published, g_string_free(record, FALSE));
+  return AMQP_STATUS_OK;
+}
+
+static int
+_mock_amqp_simple_wait_frame_noblock(amqp_connection_state_t state, amqp_frame_t *frame, struct timeval *tv)
+{
+  if (next_scripted_frame == num_scripted_frames)
+    return AMQP_STATUS_SOCKET_ERROR;
+
+  *frame = scripted_frames[next_scripted_frame++].frame;
+  return AMQP_STATUS_OK;
+}
+
+#define amqp_get_rpc_reply _mock_amqp_get_rpc_reply
+#define amqp_basic_publish _mock_amqp_basic_publish
+#define amqp_simple_wait_frame_noblock _mock_amqp_simple_wait_frame_noblock
+#include "afamqp.c"
+#undef amqp_get_rpc_reply
+#undef amqp_basic_publish
+#undef amqp_simple_wait_frame_noblock
+
+#include "apphook.h"
+
+static AMQPDestDriver *driver;
+
+static ScriptedFrame *
+_script_method(amqp_method_number_t id)
+{
+  cr_assert_lt(num_scripted_frames, MAX_SCRIPTED_FRAMES);
+
+  ScriptedFrame *scripted = &scripted_frames[num_scripted_frames++];
+  memset(scripted, 0, sizeof(*scripted));
+  scripted->frame.frame_type = AMQP_FRAME_METHOD;
+  scripted->frame.channel = 1;
+  scripted->frame.payload.method.id = id;
+  scripted->frame.payload.method.decoded = &scripted->method;
+  return scripted;
+}
+
+static ScriptedFrame *
+_script_ack(guint64 delivery_tag, gboolean multiple)
+{
+  ScriptedFrame *scripted = _script_method(AMQP_BASIC_ACK_METHOD);
+
+  scripted->method.ack.delivery_tag = delivery_tag;
+  scripted->method.ack.multiple = multiple;
+  return scripted;
+}
+
+static void
+_script_nack(guint64 delivery_tag, gboolean multiple)
+{
+  ScriptedFrame *scripted = _script_method(AMQP_BASIC_NACK_METHOD);
+
+  scripted->method.nack.delivery_tag = delivery_tag;
+  scripted->method.nack.multiple = multiple;
+}
+
+static void
+_setup_driver(gboolean publisher_confirms)
+{
+  driver = (AMQPDestDriver *) afamqp_dd_new(configuration);
+
+  afamqp_dd_set_body(&driver->super.super.super, compile_template("$MSG"));
+  afamqp_dd_set_publisher_confirms(&driver->super.super.super, publisher_confirms);
+  log_template_options_init(&driver->template_options, configuration);
+
+  ValuePairs *vp = value_pairs_new(configuration);
+  value_pairs_add_pair(vp, "host", compile_template("$HOST"));
+  value_pairs_add_pair(vp, "seq", compile_template("$SEQ"));
+  afamqp_dd_set_value_pairs(&driver->super.super.super, vp);
+
+  /* never dereferenced, the calls using it are mocked */
+  driver->conn = (amqp_connection_state_t) GINT_TO_POINTER(1);
+  driver->next_delivery_tag = 1;
+}
+
+static LogThreadedResult
+_insert(gint seq)
+{
+  LogMessage *msg = log_msg_new_empty();
+  gchar seq_str[16];
+
+  g_snprintf(seq_str, sizeof(seq_str), "%d", seq);
+  log_msg_set_value(msg, LM_V_HOST, "host", -1);
+  log_msg_set_value_by_name(msg, "SEQ", seq_str, -1);
+  log_msg_set_value(msg, LM_V_MESSAGE, "message", -1);
+
+  LogThreadedResult result = afamqp_worker_insert(&driver->super, msg);
+  log_msg_unref(msg);
+  return result;
+}
+
+static LogThreadedResult
+_flush(void)
+{
+  return afamqp_worker_flush(&driver->super);
+}
+
+static void
+_insert_batch(gint num_messages)
+{
+  for (gint i = 0; i < num_messages; i++)
+    cr_assert_eq(_insert(i), LTR_QUEUED, "message #%d is not queued until its confirm", i);
+}
+
+Test(afamqp_confirms, test_batch_is_acknowledged_once_every_message_is_confirmed)
+{
+  _setup_driver(TRUE);
+  _insert_batch(3);
+
+  _script_ack(1, FALSE);
+  _script_ack(3, FALSE);
+  _script_ack(2, FALSE);
+
+  cr_assert_eq(_flush(), LTR_SUCCESS);
+  cr_assert_eq(next_scripted_frame, 3);
+  cr_assert_eq(published->len, 3);
+  cr_assert_eq(driver->confirmed->len, 0);
+}
+
+Test(afamqp_confirms, test_multiple_ack_confirms_every_tag_up_to_it)
+{
+  _setup_driver(TRUE);
+  _insert_batch(4);
+
+  _script_ack(2, TRUE);
+  _script_ack(4, TRUE);
+
+  cr_assert_eq(_flush(), LTR_SUCCESS);
+  cr_assert_eq(next_scripted_frame, 2);
+}
+
+Test(afamqp_confirms, test_duplicate_acks_are_not_counted_twice)
+{
+  _setup_driver(TRUE);
+  _insert_batch(2);
+
+  _script_ack(1, FALSE);
+  _script_ack(1, TRUE);
+
+  start_grabbing_messages();
+  cr_assert_eq(_flush(), LTR_NOT_CONNECTED, "the batch is acknowledged without the confirm of its last message");
+  assert_grabbed_log_contains("Error while waiting for AMQP publisher confirms");
+  stop_grabbing_messages();
+}
+
+Test(afamqp_confirms, test_nack_fails_the_batch)
+{
+  _setup_driver(TRUE);
+  _insert_batch(3);
+
+  _script_ack(1, FALSE);
+  _script_nack(2, FALSE);
+  _script_ack(3, FALSE);
+
+  start_grabbing_messages();
+  cr_assert_eq(_flush(), LTR_ERROR);
+  assert_grabbed_log_contains("AMQP server rejected published messages");
+  stop_grabbing_messages();
+
+  /* the rest of the confirms are not waited for */
+  cr_assert_eq(next_scripted_frame, 2);
+  cr_assert_eq(driver->confirmed->len, 0);
+  cr_assert_not(driver->confirm_failed);
+}
+
+Test(afamqp_confirms, test_confirms_of_a_rewound_batch_are_ignored)
+{
+  _setup_driver(TRUE);
+  _insert_batch(2);
+  _script_nack(1, FALSE);
+
+  start_grabbing_messages();
+  cr_assert_eq(_flush(), LTR_ERROR);
+
+  /* the resent batch gets the tags 3 and 4, the late confirms of 1 and 2 must not count */
+  _insert_batch(2);
+  cr_assert_eq(driver->confirm_base, 3);
+  _script_ack(2, TRUE);
+  _script_nack(2, FALSE);
+  _script_ack(4, FALSE);
+
+  cr_assert_eq(_flush(), LTR_NOT_CONNECTED, "a confirm of the rewound batch acknowledged the resent one");
+  stop_grabbing_messages();
+}
+
+Test(afamqp_confirms, test_failed_publish_rewinds_the_batch)
+{
+  _setup_driver(TRUE);
+  _insert_batch(1);
+
+  publish_status = AMQP_STATUS_SOCKET_ERROR;
+  start_grabbing_messages();
+  cr_assert_eq(_insert(1), LTR_ERROR);
+  assert_grabbed_log_contains("Network error while inserting into AMQP server");
+  stop_grabbing_messages();
+  cr_assert_eq(driver->confirmed->len, 0);
+
+  /* the failed publish used up its tag on the channel */
+  publish_status = AMQP_STATUS_OK;
+  _insert_batch(1);
+  cr_assert_eq(driver->confirm_base, 3);
+  _script_ack(1, FALSE);
+  _script_ack(3, FALSE);
+
+  cr_assert_eq(_flush(), LTR_SUCCESS);
+}
+
+Test(afamqp_confirms, test_confirms_received_between_flushes_are_counted)
+{
+  _setup_driver(TRUE);
+  _insert_batch(2);
+
+  /* as the heartbeat handler processes them */
+  cr_assert(_process_frame(driver, &_script_ack(2, TRUE)->frame));
+  next_scripted_frame = num_scripted_frames;
+
+  /* nothing is read from the connection */
+  cr_assert_eq(_flush(), LTR_SUCCESS);
+}
+
+Test(afamqp_confirms, test_channel_close_fails_the_batch)
+{
+  _setup_driver(TRUE);
+  _insert_batch(2);
+
+  _script_ack(1, FALSE);
+  _script_method(AMQP_CHANNEL_CLOSE_METHOD);
+
+  start_grabbing_messages();
+  cr_assert_eq(_flush(), LTR_NOT_CONNECTED);
+  assert_grabbed_log_contains("AMQP server closed the channel");
+  stop_grabbing_messages();
+}
+
+Test(afamqp_confirms, test_without_confirms_messages_are_not_batched)
+{
+  _setup_driver(FALSE);
+
+  cr_assert_eq(_insert(0), LTR_SUCCESS);
+  cr_assert_eq(_insert(1), LTR_SUCCESS);
+  cr_assert_eq(_flush(), LTR_SUCCESS);
+  cr_assert_eq(next_scripted_frame, 0);
+  cr_assert_eq(published->len, 2);
+}
+
+Test(afamqp_confirms, test_header_table_buffers_are_reused)
+{
+  _setup_driver(FALSE);
+
+  cr_assert_eq(_insert(7), LTR_SUCCESS);
+  cr_assert_eq(_insert(12345), LTR_SUCCESS);
+
+  cr_assert_str_eq(g_ptr_array_index(published, 0), "host=host;seq=7;message");
+  cr_assert_str_eq(g_ptr_array_index(published, 1), "host=host;seq=12345;message");
+
+  /* a key and a value buffer per header */
+  cr_assert_eq(driver->entry_buffers->len, 4);
+}
+
+static void
+setup(void)
+{
+  app_startup();
+  configuration = cfg_new_snippet();
+
+  published = g_ptr_array_new_with_free_func(g_free);
+  publish_status = AMQP_STATUS_OK;
+  num_scripted_frames = 0;
+  next_scripted_frame = 0;
+}
+
+static void
+teardown(void)
+{
+  if (driver)
+    {
+      driver->conn = NULL;
+      log_pipe_unref(&driver->super.super.super.super);
+      driver = NULL;
+    }
+
+  g_ptr_array_free(published, TRUE);
+  cfg_free(configuration);
+  app_shutdown();
+}
+
+TestSuite(afamqp_confirms, .init = setup, .fini = teardown);
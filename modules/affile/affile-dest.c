@@ -28,6 +28,7 @@
 #include "gprocess.h"
 #include "stats/stats-registry.h"
 #include "mainloop-call.h"
+#include "mainloop-io-worker.h"
 #include "transport/transport-file.h"
 #include "logproto-file-writer.h"
 #include "transport/transport-file.h"
@@ -35,7 +36,9 @@
 #include "logwriter.h"
 #include "affile-dest-internal-queue-filter.h"
 #include "file-specializations.h"
+#include "file-sync-scheduler.h"
 #include "apphook.h"
+#include "tls-support.h"
 #include "timeutils/cache.h"
 #include "timeutils/misc.h"
 
@@ -60,9 +63,16 @@
  *   - if the message is to be written to a not-yet-opened file, a new gets
  *     opened and stored in the writer_hash hashtable (initiated from queue,
  *     but performed in the main thread, but more on that later)
+ *   - with async-open(yes), the file itself is opened (including the
+ *     creation of its directories) by an I/O worker, messages are held in
+ *     the queue of the writer until it finishes
  *   - currently opened destination files are checked regularly and closed
  *     if they are idle for a given amount of time (time_reap) (this is done
  *     in the main thread)
+ *   - if max-open-files() is set, the least recently used writer is closed
+ *     when a new one would exceed the limit (in the main thread), recency
+ *     is approximated with a second chance (CLOCK) scheme, so that source
+ *     threads only need to set a flag on the writers they use
  *
  * Some of these operations have to be performed in the main thread, others
  * are done in the queue call.
@@ -75,18 +85,36 @@
  * syslog-ng is running.
  *
  * AFFileDestWriter instances are created dynamically when a new file is
- * opened. A reference is stored in the writer_hash hashtable. This is then:
+ * opened. A reference is stored in the writer_hash hashtable, which is only
+ * ever accessed from the main thread and is what we pass on to the next
+ * configuration on reload.  The same writer is also indexed in one of the
+ * writer_shards, selected by the hash of the filename.  This is then:
  *    - looked up in _queue() (in the source thread)
  *    - cleaned up in reap callback (in the main thread)
  *
- * writer_hash is locked (currently a simple mutex) using
- * AFFileDestDriver->lock.  The "queue" method cannot hold the lock while
- * forwarding it to the next pipe, thus a reference is taken under the
- * protection of the lock, keeping a the next pipe alive, even if that would
- * go away in a parallel reaper process.
+ * Each shard is locked by its own mutex, so source threads writing to
+ * different files rarely contend.  The "queue" method cannot hold the lock
+ * while forwarding it to the next pipe, thus a reference is taken and
+ * queue_pending is incremented under the protection of the lock, keeping
+ * the next pipe alive, even if that would go away in a parallel reaper
+ * process.
+ *
+ * On top of that, every source thread remembers the writer it used last
+ * (holding a reference to it).  If the next message goes to the same file,
+ * which is the common case, no lock is taken at all: the thread increments
+ * queue_pending and then checks the reaping flag of the writer, while the
+ * reaper sets the reaping flag and then checks queue_pending, so at least
+ * one of them notices the other.  A thread that loses falls back to the
+ * shard lookup.
+ *
+ * The threads outlive the configuration, so deinitializing a driver bumps
+ * cached_writers_generation, and each thread releases its cached writer
+ * (and the old driver it keeps alive) the next time it looks at it, or
+ * when it exits.
  */
 
 static GList *affile_dest_drivers = NULL;
+static gint cached_writers_generation;
 
 struct _AFFileDestWriter
 {
@@ -97,9 +125,33 @@ struct _AFFileDestWriter
   LogWriter *writer;
   time_t last_msg_stamp;
   time_t last_open_stamp;
-  gboolean reopen_pending, queue_pending;
+  gboolean reopen_pending;
+
+  /* number of messages being queued, the writer cannot be reaped while non-zero */
+  gint queue_pending;
+  gint reaping;
+
+  /* asynchronous opens, the job keeps a reference to the owner it was started with */
+  MainLoopIOWorkerJob open_job;
+  AFFileDestDriver *open_owner;
+  LogProtoClient *opened_proto;
+  gboolean reopen_requested;
+
+  /* our position in owner->lru_writers, lru_referenced is set whenever we are used */
+  GList lru_link;
+  gint lru_referenced;
 };
 
+TLS_BLOCK_START
+{
+  AFFileDestWriter *last_writer;
+  gint last_writer_generation;
+}
+TLS_BLOCK_END;
+
+#define last_writer __tls_deref(last_writer)
+#define last_writer_generation __tls_deref(last_writer_generation)
+
 static gchar *
 affile_dw_format_persist_name(AFFileDestWriter *self)
 {
@@ -111,70 +163,156 @@ affile_dw_format_persist_name(AFFileDestWriter *self)
   return persist_name;
 }
 
-static void affile_dd_reap_writer(AFFileDestDriver *self, AFFileDestWriter *dw);
+static gboolean affile_dd_try_reap_writer(AFFileDestDriver *self, AFFileDestWriter *dw, const gchar *reason);
+
+/*
+ * Returns TRUE if @self is idle and marks it as being reaped, so that
+ * threads holding @self in their cache do not queue to it anymore.  The
+ * caller must hold the lock that protects lookups of @self.
+ */
+static gboolean
+affile_dw_try_begin_reap(AFFileDestWriter *self)
+{
+  g_atomic_int_set(&self->reaping, TRUE);
+  if (g_atomic_int_get(&self->queue_pending) == 0 && !log_writer_has_pending_writes(self->writer))
+    return TRUE;
+
+  g_atomic_int_set(&self->reaping, FALSE);
+  return FALSE;
+}
 
 static void
 affile_dw_reap(AFFileDestWriter *self)
 {
-  AFFileDestDriver *owner = self->owner;
-
   main_loop_assert_main_thread();
 
-  g_mutex_lock(&owner->lock);
-  if (!log_writer_has_pending_writes((LogWriter *) self->writer) && !self->queue_pending)
-    {
-      msg_verbose("Destination timed out, reaping",
-                  evt_tag_str("template", self->owner->filename_template->template_str),
-                  evt_tag_str("filename", self->filename));
-      affile_dd_reap_writer(self->owner, self);
-    }
-  g_mutex_unlock(&owner->lock);
+  affile_dd_try_reap_writer(self->owner, self, "Destination timed out, reaping");
 }
 
-static gboolean
-affile_dw_reopen(AFFileDestWriter *self)
+/* NOTE: may run in an I/O worker, so only @owner may be used for anything else than our filename */
+static FileOpenerResult
+affile_dw_open_proto(AFFileDestWriter *self, AFFileDestDriver *owner, LogProtoClient **proto)
 {
   int fd;
   struct stat st;
-  LogProtoClient *proto = NULL;
-
-  msg_verbose("Initializing destination file writer",
-              evt_tag_str("template", self->owner->filename_template->template_str),
-              evt_tag_str("filename", self->filename),
-              evt_tag_str("symlink_as", self->owner->symlink_as));
 
-  self->last_open_stamp = self->last_msg_stamp;
-  if (self->owner->overwrite_if_older > 0 &&
+  *proto = NULL;
+  if (owner->overwrite_if_older > 0 &&
       stat(self->filename, &st) == 0 &&
-      st.st_mtime < time(NULL) - self->owner->overwrite_if_older)
+      st.st_mtime < time(NULL) - owner->overwrite_if_older)
     {
       msg_info("Destination file is older than overwrite_if_older(), overwriting",
                evt_tag_str("filename", self->filename),
-               evt_tag_int("overwrite_if_older", self->owner->overwrite_if_older));
+               evt_tag_int("overwrite_if_older", owner->overwrite_if_older));
       unlink(self->filename);
     }
 
-  FileOpenerResult open_result = file_opener_open_fd(self->owner->file_opener, self->filename, AFFILE_DIR_WRITE, &fd);
+  FileOpenerResult open_result = file_opener_open_fd(owner->file_opener, self->filename, AFFILE_DIR_WRITE, &fd);
   if (open_result == FILE_OPENER_RESULT_SUCCESS)
     {
-      if (self->owner->symlink_as != NULL)
-        file_opener_symlink(self->owner->file_opener, self->owner->symlink_as, self->filename);
+      if (owner->symlink_as != NULL)
+        file_opener_symlink(owner->file_opener, owner->symlink_as, self->filename);
 
-      LogTransport *transport = file_opener_construct_transport(self->owner->file_opener, fd);
+      LogTransport *transport = file_opener_construct_transport(owner->file_opener, fd);
 
-      proto = file_opener_construct_dst_proto(self->owner->file_opener, transport,
-                                              &self->owner->writer_options.proto_options.super);
-    }
-  else if (open_result == FILE_OPENER_RESULT_ERROR_PERMANENT)
-    {
-      return FALSE;
+      *proto = file_opener_construct_dst_proto(owner->file_opener, transport,
+                                               &owner->writer_options.proto_options.super);
     }
-  else
+  else if (open_result == FILE_OPENER_RESULT_ERROR_TRANSIENT)
     {
       msg_error("Error opening file for writing",
                 evt_tag_str("filename", self->filename),
                 evt_tag_error(EVT_TAG_OSERROR));
     }
+  return open_result;
+}
+
+static void
+affile_dw_open_job_engage(AFFileDestWriter *self)
+{
+  log_pipe_ref(&self->super);
+  self->open_owner = self->owner;
+  log_pipe_ref(&self->open_owner->super.super.super);
+}
+
+static void
+affile_dw_open_job_release(AFFileDestWriter *self)
+{
+  AFFileDestDriver *open_owner = self->open_owner;
+
+  self->open_owner = NULL;
+  log_pipe_unref(&open_owner->super.super.super);
+  log_pipe_unref(&self->super);
+}
+
+/* NOTE: runs in an I/O worker */
+static void
+affile_dw_open_job_perform(AFFileDestWriter *self, gpointer arg)
+{
+  affile_dw_open_proto(self, self->open_owner, &self->opened_proto);
+}
+
+/* NOTE: runs in the main thread */
+static void
+affile_dw_open_job_finished(AFFileDestWriter *self, gpointer arg)
+{
+  LogProtoClient *proto = self->opened_proto;
+
+  self->opened_proto = NULL;
+  if (self->reopen_requested)
+    {
+      /* somebody asked for a reopen while we were working, the result is stale */
+      self->reopen_requested = FALSE;
+      if (proto)
+        log_proto_client_free(proto);
+      main_loop_io_worker_job_submit(&self->open_job, NULL);
+      return;
+    }
+
+  if (!(self->super.flags & PIF_INITIALIZED) || !self->writer)
+    {
+      if (proto)
+        log_proto_client_free(proto);
+      return;
+    }
+
+  /* when the open failed, the writer keeps queueing until the next reopen attempt */
+  log_writer_reopen(self->writer, proto);
+}
+
+static gpointer
+affile_dw_submit_open_job(AFFileDestWriter *self)
+{
+  if (self->open_job.working)
+    self->reopen_requested = TRUE;
+  else
+    main_loop_io_worker_job_submit(&self->open_job, NULL);
+
+  log_pipe_unref(&self->super);
+  return NULL;
+}
+
+static gboolean
+affile_dw_reopen(AFFileDestWriter *self)
+{
+  LogProtoClient *proto = NULL;
+
+  msg_verbose("Initializing destination file writer",
+              evt_tag_str("template", self->owner->filename_template->template_str),
+              evt_tag_str("filename", self->filename),
+              evt_tag_str("symlink_as", self->owner->symlink_as));
+
+  self->last_open_stamp = self->last_msg_stamp;
+  if (self->owner->async_open)
+    {
+      /* jobs can only be submitted from the main thread */
+      log_pipe_ref(&self->super);
+      main_loop_call((MainLoopTaskFunc) affile_dw_submit_open_job, self, FALSE);
+      return TRUE;
+    }
+
+  if (affile_dw_open_proto(self, self->owner, &proto) == FILE_OPENER_RESULT_ERROR_PERMANENT)
+    return FALSE;
 
   log_writer_reopen(self->writer, proto);
 
@@ -250,6 +388,7 @@ affile_dw_init(LogPipe *s)
       goto error;
     }
 
+  g_atomic_int_set(&self->reaping, FALSE);
   return TRUE;
 
 error:
@@ -264,6 +403,8 @@ affile_dw_deinit(LogPipe *s)
   AFFileDestWriter *self = (AFFileDestWriter *) s;
 
   main_loop_assert_main_thread();
+  /* keep cached references in source threads away until we are initialized again */
+  g_atomic_int_set(&self->reaping, TRUE);
   if (self->writer)
     {
       log_pipe_deinit((LogPipe *) self->writer);
@@ -387,6 +528,14 @@ affile_dw_new(const gchar *filename, GlobalConfig *cfg)
      This avoids a move of the filename. */
   self->filename = g_strdup(filename);
   g_mutex_init(&self->lock);
+  self->lru_link.data = self;
+
+  main_loop_io_worker_job_init(&self->open_job);
+  self->open_job.user_data = self;
+  self->open_job.work = (void (*)(void *, void *)) affile_dw_open_job_perform;
+  self->open_job.completion = (void (*)(void *, void *)) affile_dw_open_job_finished;
+  self->open_job.engage = (void (*)(void *)) affile_dw_open_job_engage;
+  self->open_job.release = (void (*)(void *)) affile_dw_open_job_release;
   return self;
 }
 
@@ -413,6 +562,20 @@ affile_dd_register_reopen_hook(gint hook_type, gpointer user_data)
   g_list_foreach(affile_dest_drivers, affile_dd_reopen_all_writers, NULL);
 }
 
+void
+affile_dd_set_io_uring(LogDriver *s, gboolean io_uring)
+{
+  AFFileDestDriver *self = (AFFileDestDriver *) s;
+
+#if !SYSLOG_NG_ENABLE_IO_URING
+  if (io_uring)
+    msg_warning("WARNING: io-uring() was requested, but syslog-ng was compiled without io_uring support, "
+                "using plain file writes",
+                log_pipe_location_tag(&s->super));
+#endif
+  self->file_opener_options.io_uring = io_uring;
+}
+
 void
 affile_dd_set_create_dirs(LogDriver *s, gboolean create_dirs)
 {
@@ -446,6 +609,39 @@ affile_dd_set_fsync(LogDriver *s, gboolean use_fsync)
   self->use_fsync = use_fsync;
 }
 
+void
+affile_dd_set_fsync_max_delay(LogDriver *s, gint fsync_max_delay)
+{
+  AFFileDestDriver *self = (AFFileDestDriver *) s;
+
+  self->fsync_max_delay = fsync_max_delay;
+}
+
+gboolean
+affile_dd_set_compression(LogDriver *s, const gchar *method, gint level)
+{
+  AFFileDestDriver *self = (AFFileDestDriver *) s;
+
+  return file_compression_options_set_method(&self->compression, method) &&
+         file_compression_options_set_level(&self->compression, level);
+}
+
+void
+affile_dd_set_max_open_files(LogDriver *s, gint max_open_files)
+{
+  AFFileDestDriver *self = (AFFileDestDriver *) s;
+
+  self->max_open_files = max_open_files;
+}
+
+void
+affile_dd_set_async_open(LogDriver *s, gboolean async_open)
+{
+  AFFileDestDriver *self = (AFFileDestDriver *) s;
+
+  self->async_open = async_open;
+}
+
 void
 affile_dd_set_time_reap(LogDriver *s, gint time_reap)
 {
@@ -475,7 +671,23 @@ affile_dd_format_persist_name(const LogPipe *s)
   return persist_name;
 }
 
-/* DestDriver lock must be held before calling this function */
+static inline AFFileDestWriterShard *
+affile_dd_get_writer_shard(AFFileDestDriver *self, const gchar *filename)
+{
+  return &self->writer_shards[g_str_hash(filename) % AFFILE_DD_WRITER_SHARDS];
+}
+
+static void
+affile_dd_index_writer(AFFileDestDriver *self, AFFileDestWriter *dw)
+{
+  AFFileDestWriterShard *shard = affile_dd_get_writer_shard(self, dw->filename);
+
+  g_mutex_lock(&shard->lock);
+  g_hash_table_insert(shard->writers, dw->filename, dw);
+  g_mutex_unlock(&shard->lock);
+}
+
+/* the writer must have been removed from its shard (or single_writer) before calling this function */
 static void
 affile_dd_reap_writer(AFFileDestDriver *self, AFFileDestWriter *dw)
 {
@@ -487,11 +699,7 @@ affile_dd_reap_writer(AFFileDestDriver *self, AFFileDestWriter *dw)
     {
       /* remove from hash table */
       g_hash_table_remove(self->writer_hash, dw->filename);
-    }
-  else
-    {
-      g_assert(dw == self->single_writer);
-      self->single_writer = NULL;
+      g_queue_unlink(&self->lru_writers, &dw->lru_link);
     }
 
   LogQueue *queue = log_writer_get_queue(writer);
@@ -500,6 +708,159 @@ affile_dd_reap_writer(AFFileDestDriver *self, AFFileDestWriter *dw)
   log_pipe_unref(&dw->super);
 }
 
+/*
+ * Reaps @dw unless it is in use.  Lookups of @dw are excluded by taking the
+ * lock of its shard (or the driver lock for single_writer), the lock-free
+ * lookups of the per-thread cache are excluded by the reaping flag.
+ */
+static gboolean
+affile_dd_try_reap_writer(AFFileDestDriver *self, AFFileDestWriter *dw, const gchar *reason)
+{
+  AFFileDestWriterShard *shard = NULL;
+  gboolean reapable;
+
+  main_loop_assert_main_thread();
+
+  if (self->filename_is_a_template)
+    {
+      shard = affile_dd_get_writer_shard(self, dw->filename);
+      g_mutex_lock(&shard->lock);
+    }
+  else
+    {
+      g_mutex_lock(&self->lock);
+    }
+
+  reapable = affile_dw_try_begin_reap(dw);
+  if (reapable)
+    {
+      if (shard)
+        g_hash_table_remove(shard->writers, dw->filename);
+      else
+        {
+          g_assert(dw == self->single_writer);
+          self->single_writer = NULL;
+        }
+    }
+
+  g_mutex_unlock(shard ? &shard->lock : &self->lock);
+
+  if (!reapable)
+    return FALSE;
+
+  msg_verbose(reason,
+              evt_tag_str("template", self->filename_template->template_str),
+              evt_tag_str("filename", dw->filename));
+  affile_dd_reap_writer(self, dw);
+  return TRUE;
+}
+
+static void
+affile_dd_reap_least_recently_used_writers(AFFileDestDriver *self)
+{
+  guint scan_budget = 2 * g_queue_get_length(&self->lru_writers);
+
+  main_loop_assert_main_thread();
+
+  /* second chance: writers used since the last scan, or busy ones are
+   * moved to the head instead of being closed */
+  while (self->lru_writers.tail && scan_budget-- > 0 &&
+         g_hash_table_size(self->writer_hash) > self->max_open_files)
+    {
+      GList *l = self->lru_writers.tail;
+      AFFileDestWriter *dw = (AFFileDestWriter *) l->data;
+
+      if (g_atomic_int_compare_and_exchange(&dw->lru_referenced, TRUE, FALSE) ||
+          !affile_dd_try_reap_writer(self, dw,
+                                     "Number of open destination files reached max-open-files(), "
+                                     "closing the least recently used one"))
+        {
+          g_queue_unlink(&self->lru_writers, l);
+          g_queue_push_head_link(&self->lru_writers, l);
+        }
+    }
+}
+
+/* releases the writer cached by the current thread, see the threading notes above */
+static void
+affile_dd_release_cached_writer(gpointer user_data)
+{
+  if (last_writer)
+    {
+      log_pipe_unref(&last_writer->super);
+      last_writer = NULL;
+    }
+}
+
+/* makes every thread drop its cached writer, as it may belong to a driver being deinitialized */
+static void
+affile_dd_invalidate_cached_writers(void)
+{
+  g_atomic_int_inc(&cached_writers_generation);
+  affile_dd_release_cached_writer(NULL);
+}
+
+static void
+affile_dd_cache_writer(AFFileDestWriter *dw)
+{
+  gint generation = g_atomic_int_get(&cached_writers_generation);
+
+  if (last_writer == dw && last_writer_generation == generation)
+    return;
+
+  affile_dd_release_cached_writer(NULL);
+  last_writer = (AFFileDestWriter *) log_pipe_ref(&dw->super);
+  last_writer_generation = generation;
+}
+
+/* the lock-free fast path of _queue(), returns a reference to the writer of @filename if cached */
+static AFFileDestWriter *
+affile_dd_lookup_cached_writer(AFFileDestDriver *self, const gchar *filename)
+{
+  AFFileDestWriter *dw = last_writer;
+
+  if (!dw)
+    return NULL;
+
+  if (last_writer_generation != g_atomic_int_get(&cached_writers_generation))
+    {
+      affile_dd_release_cached_writer(NULL);
+      return NULL;
+    }
+
+  if (dw->owner != self || strcmp(dw->filename, filename) != 0)
+    return NULL;
+
+  g_atomic_int_inc(&dw->queue_pending);
+  if (g_atomic_int_get(&dw->reaping))
+    {
+      g_atomic_int_add(&dw->queue_pending, -1);
+      return NULL;
+    }
+
+  log_pipe_ref(&dw->super);
+  g_atomic_int_set(&dw->lru_referenced, TRUE);
+  return dw;
+}
+
+static AFFileDestWriter *
+affile_dd_lookup_writer(AFFileDestDriver *self, const gchar *filename)
+{
+  AFFileDestWriterShard *shard = affile_dd_get_writer_shard(self, filename);
+  AFFileDestWriter *dw;
+
+  g_mutex_lock(&shard->lock);
+  dw = g_hash_table_lookup(shard->writers, filename);
+  if (dw)
+    {
+      log_pipe_ref(&dw->super);
+      g_atomic_int_inc(&dw->queue_pending);
+      g_atomic_int_set(&dw->lru_referenced, TRUE);
+    }
+  g_mutex_unlock(&shard->lock);
+  return dw;
+}
+
 
 /**
  * affile_dd_reuse_writer:
@@ -522,7 +883,10 @@ affile_dd_reuse_writer(gpointer key, gpointer value, gpointer user_data)
       affile_dw_set_owner(writer, NULL);
       log_pipe_unref(&writer->super);
       g_hash_table_remove(self->writer_hash, key);
+      return;
     }
+  g_queue_push_tail_link(&self->lru_writers, &writer->lru_link);
+  affile_dd_index_writer(self, writer);
 }
 
 
@@ -632,11 +996,16 @@ affile_dd_deinit(LogPipe *s)
     {
       g_assert(self->single_writer == NULL);
 
+      for (gint i = 0; i < AFFILE_DD_WRITER_SHARDS; i++)
+        g_hash_table_remove_all(self->writer_shards[i].writers);
       g_hash_table_foreach(self->writer_hash, affile_dd_deinit_writer, NULL);
       cfg_persist_config_add(cfg, affile_dd_format_persist_name(s), self->writer_hash,
                              affile_dd_destroy_writer_hash);
       self->writer_hash = NULL;
+      /* the links are embedded into the writers, the next owner rebuilds the list */
+      g_queue_init(&self->lru_writers);
     }
+  affile_dd_invalidate_cached_writers();
 
   if (!log_dest_driver_deinit_method(s))
     return FALSE;
@@ -690,10 +1059,9 @@ affile_dd_open_writer(gpointer args[])
       if (!self->writer_hash)
         self->writer_hash = g_hash_table_new(g_str_hash, g_str_equal);
 
-      /* we don't need to lock the hashtable as it is only written in
-       * the main thread, which we're running right now.  lookups in
-       * other threads must be locked. writers must be locked even in
-       * this thread to exclude lookups in other threads.  */
+      /* we don't need to lock writer_hash as it is only used in the main
+       * thread, which we're running right now.  the shards are looked up
+       * in other threads, so they are locked even in this thread.  */
 
       next = g_hash_table_lookup(self->writer_hash, filename->str);
       if (!next)
@@ -707,21 +1075,27 @@ affile_dd_open_writer(gpointer args[])
             }
           else
             {
-              log_pipe_ref(&next->super);
-              g_mutex_lock(&self->lock);
               g_hash_table_insert(self->writer_hash, next->filename, next);
-              g_mutex_unlock(&self->lock);
+              g_queue_push_head_link(&self->lru_writers, &next->lru_link);
+              affile_dd_index_writer(self, next);
             }
         }
-      else
+
+      if (next)
         {
           log_pipe_ref(&next->super);
+          g_atomic_int_inc(&next->queue_pending);
+          if (self->max_open_files > 0)
+            affile_dd_reap_least_recently_used_writers(self);
+          /* we're returning a reference */
+          return &next->super;
         }
+      return NULL;
     }
 
   if (next)
     {
-      next->queue_pending = TRUE;
+      g_atomic_int_inc(&next->queue_pending);
       /* we're returning a reference */
       return &next->super;
     }
@@ -750,7 +1124,7 @@ affile_dd_queue(LogPipe *s, LogMessage *msg, const LogPathOptions *path_options)
       else
         {
           next = self->single_writer;
-          next->queue_pending = TRUE;
+          g_atomic_int_inc(&next->queue_pending);
           log_pipe_ref(&next->super);
           g_mutex_unlock(&self->lock);
         }
@@ -763,31 +1137,24 @@ affile_dd_queue(LogPipe *s, LogMessage *msg, const LogPathOptions *path_options)
       LogTemplateEvalOptions options = {&self->writer_options.template_options, LTZ_LOCAL, 0, NULL, LM_VT_STRING};
       log_template_format(self->filename_template, msg, &options, filename);
 
-      g_mutex_lock(&self->lock);
-      if (self->writer_hash)
-        next = g_hash_table_lookup(self->writer_hash, filename->str);
-      else
-        next = NULL;
+      next = affile_dd_lookup_cached_writer(self, filename->str);
+      if (!next)
+        next = affile_dd_lookup_writer(self, filename->str);
 
-      if (next)
-        {
-          log_pipe_ref(&next->super);
-          next->queue_pending = TRUE;
-          g_mutex_unlock(&self->lock);
-        }
-      else
+      if (!next)
         {
-          g_mutex_unlock(&self->lock);
           args[1] = filename;
           next = main_loop_call((void *(*)(void *)) affile_dd_open_writer, args, TRUE);
         }
+      if (next)
+        affile_dd_cache_writer(next);
       g_string_free(filename, TRUE);
     }
   if (next)
     {
       log_msg_add_ack(msg, path_options);
       log_pipe_queue(&next->super, log_msg_ref(msg), path_options);
-      next->queue_pending = FALSE;
+      g_atomic_int_add(&next->queue_pending, -1);
       log_pipe_unref(&next->super);
     }
 
@@ -800,6 +1167,11 @@ affile_dd_free(LogPipe *s)
   AFFileDestDriver *self = (AFFileDestDriver *) s;
 
   g_mutex_clear(&self->lock);
+  for (gint i = 0; i < AFFILE_DD_WRITER_SHARDS; i++)
+    {
+      g_mutex_clear(&self->writer_shards[i].lock);
+      g_hash_table_destroy(self->writer_shards[i].writers);
+    }
   affile_dest_drivers = g_list_remove(affile_dest_drivers, self);
 
   /* NOTE: this must be NULL as deinit has freed it, otherwise we'd have circular references */
@@ -835,6 +1207,13 @@ affile_dd_new_instance(LogTemplate *filename_template, GlobalConfig *cfg)
       self->filename_is_a_template = TRUE;
     }
   file_opener_options_defaults(&self->file_opener_options);
+  self->compression.level = -1;
+  g_queue_init(&self->lru_writers);
+  for (gint i = 0; i < AFFILE_DD_WRITER_SHARDS; i++)
+    {
+      g_mutex_init(&self->writer_shards[i].lock);
+      self->writer_shards[i].writers = g_hash_table_new(g_str_hash, g_str_equal);
+    }
 
   affile_dd_set_time_reap(&self->super.super, self->filename_is_a_template ? -1 : 0);
   g_mutex_init(&self->lock);
@@ -851,7 +1230,8 @@ affile_dd_new(LogTemplate *filename_template, GlobalConfig *cfg)
 
   self->writer_flags |= LW_SOFT_FLOW_CONTROL;
   self->writer_options.stats_source = stats_register_type("file");
-  self->file_opener = file_opener_for_regular_dest_files_new(&self->writer_options, &self->use_fsync);
+  self->file_opener = file_opener_for_regular_dest_files_new(&self->writer_options, &self->use_fsync,
+                                                              &self->fsync_max_delay, &self->compression);
   return &self->super.super;
 }
 
@@ -863,6 +1243,8 @@ affile_dd_global_init(void)
   if (!initialized)
     {
       register_application_hook(AH_REOPEN_FILES, affile_dd_register_reopen_hook, NULL, AHM_RUN_REPEAT);
+      register_application_thread_deinit_hook(affile_dd_release_cached_writer, NULL);
+      file_sync_scheduler_global_init();
       initialized = TRUE;
     }
 }
@@ -27,9 +27,18 @@
 #include "driver.h"
 #include "logwriter.h"
 #include "file-opener.h"
+#include "file-compressor.h"
 
 typedef struct _AFFileDestWriter AFFileDestWriter;
 
+#define AFFILE_DD_WRITER_SHARDS 16
+
+typedef struct _AFFileDestWriterShard
+{
+  GMutex lock;
+  GHashTable *writers;
+} AFFileDestWriterShard;
+
 typedef struct _AFFileDestDriver
 {
   LogDestDriver super;
@@ -39,12 +48,20 @@ typedef struct _AFFileDestDriver
   gboolean filename_is_a_template;
   gboolean template_escape;
   gboolean use_fsync;
+  gint fsync_max_delay;
+  FileCompressionOptions compression;
   FileOpenerOptions file_opener_options;
   FileOpener *file_opener;
   TimeZoneInfo *local_time_zone_info;
   LogWriterOptions writer_options;
   guint32 writer_flags;
   GHashTable *writer_hash;
+  AFFileDestWriterShard writer_shards[AFFILE_DD_WRITER_SHARDS];
+
+  /* writers of templated file names, the most recently used first */
+  GQueue lru_writers;
+  gint max_open_files;
+  gboolean async_open;
 
   gint overwrite_if_older;
   gchar *symlink_as;
@@ -55,11 +72,16 @@ AFFileDestDriver *affile_dd_new_instance(LogTemplate *filename_template, GlobalC
 LogDriver *affile_dd_new(LogTemplate *filename_template, GlobalConfig *cfg);
 
 void affile_dd_set_create_dirs(LogDriver *s, gboolean create_dirs);
+void affile_dd_set_io_uring(LogDriver *s, gboolean io_uring);
 void affile_dd_set_fsync(LogDriver *s, gboolean enable);
+void affile_dd_set_fsync_max_delay(LogDriver *s, gint fsync_max_delay);
+gboolean affile_dd_set_compression(LogDriver *s, const gchar *method, gint level);
 void affile_dd_set_overwrite_if_older(LogDriver *s, gint overwrite_if_older);
 void affile_dd_set_symlink_as(LogDriver *s, const gchar *symlink_as);
 void affile_dd_set_local_time_zone(LogDriver *s, const gchar *local_time_zone);
 void affile_dd_set_time_reap(LogDriver *s, gint time_reap);
+void affile_dd_set_max_open_files(LogDriver *s, gint max_open_files);
+void affile_dd_set_async_open(LogDriver *s, gboolean async_open);
 void affile_dd_global_init(void);
 
 #endif
@@ -42,16 +42,21 @@ static CfgLexerKeyword affile_keywords[] =
   { "filename_pattern",   KW_FILENAME_PATTERN },
   { "recursive",          KW_RECURSIVE },
   { "max_files",          KW_MAX_FILES },
+  { "max_concurrent_readers", KW_MAX_CONCURRENT_READERS },
   { "monitor_method",     KW_MONITOR_METHOD },
   { "force_directory_polling", KW_FORCE_DIRECTORY_POLLING, KWS_OBSOLETE, "Use wildcard-file(monitor-method())" },
 
   { "fsync",              KW_FSYNC },
+  { "fsync_max_delay",    KW_FSYNC_MAX_DELAY },
+  { "compression",        KW_COMPRESSION },
   { "remove_if_older",    KW_OVERWRITE_IF_OLDER, KWS_OBSOLETE, "overwrite_if_older" },
   { "overwrite_if_older", KW_OVERWRITE_IF_OLDER },
   { "symlink_as",         KW_SYMLINK_AS },
   { "follow_freq",        KW_FOLLOW_FREQ },
   { "multi_line_timeout", KW_MULTI_LINE_TIMEOUT },
   { "time_reap",          KW_TIME_REAP },
+  { "max_open_files",     KW_MAX_OPEN_FILES },
+  { "async_open",         KW_ASYNC_OPEN },
   { NULL }
 };
 
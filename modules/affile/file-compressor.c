@@ -0,0 +1,388 @@
+/*
+ * Copyright (c) 2024 One Identity LLC.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#include "file-compressor.h"
+#include "stats/stats-registry.h"
+#include "messages.h"
+
+#include <string.h>
+
+#ifdef SYSLOG_NG_HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+#if SYSLOG_NG_ENABLE_ZSTD
+#include <zstd.h>
+#endif
+
+/* the output buffer is grown by this much while a call is producing output */
+#define FILE_COMPRESSOR_OUTPUT_CHUNK (16 * 1024)
+
+static struct
+{
+  GMutex lock;
+  StatsCounterItem *saved_bytes[FILE_COMPRESSION_ZSTD + 1];
+} compression_metrics;
+
+static const gchar *
+_method_name(FileCompressionMethod method)
+{
+  switch (method)
+    {
+    case FILE_COMPRESSION_GZIP:
+      return "gzip";
+    case FILE_COMPRESSION_ZSTD:
+      return "zstd";
+    default:
+      return "none";
+    }
+}
+
+static StatsCounterItem *
+_get_saved_bytes_counter(FileCompressionMethod method)
+{
+  g_mutex_lock(&compression_metrics.lock);
+  if (!compression_metrics.saved_bytes[method])
+    {
+      StatsClusterKey sc_key;
+      StatsClusterLabel labels[] = { stats_cluster_label("method", _method_name(method)) };
+
+      stats_lock();
+      stats_cluster_single_key_set(&sc_key, "output_file_compression_saved_bytes", labels, G_N_ELEMENTS(labels));
+      stats_register_counter(STATS_LEVEL1, &sc_key, SC_TYPE_SINGLE_VALUE, &compression_metrics.saved_bytes[method]);
+      stats_unlock();
+    }
+  g_mutex_unlock(&compression_metrics.lock);
+  return compression_metrics.saved_bytes[method];
+}
+
+static inline guchar *
+_reserve_output(GString *output, gsize *pos)
+{
+  *pos = output->len;
+  g_string_set_size(output, *pos + FILE_COMPRESSOR_OUTPUT_CHUNK);
+  return (guchar *) output->str + *pos;
+}
+
+/****************************************************************************
+ * gzip
+ ****************************************************************************/
+
+#ifdef SYSLOG_NG_HAVE_ZLIB
+
+typedef struct _GzipFileCompressor
+{
+  FileCompressor super;
+  z_stream stream;
+} GzipFileCompressor;
+
+static gboolean
+_gzip_deflate(GzipFileCompressor *self, const guchar *data, gsize len, gint flush, GString *output)
+{
+  gint rc;
+
+  self->stream.next_in = (Bytef *) data;
+  self->stream.avail_in = len;
+  do
+    {
+      gsize pos;
+
+      self->stream.next_out = _reserve_output(output, &pos);
+      self->stream.avail_out = FILE_COMPRESSOR_OUTPUT_CHUNK;
+      rc = deflate(&self->stream, flush);
+      g_string_set_size(output, pos + FILE_COMPRESSOR_OUTPUT_CHUNK - self->stream.avail_out);
+
+      if (rc == Z_STREAM_ERROR)
+        return FALSE;
+    }
+  while (self->stream.avail_out == 0);
+
+  return TRUE;
+}
+
+static gboolean
+_gzip_compress(FileCompressor *s, const struct iovec *iov, gint iov_count, GString *output)
+{
+  GzipFileCompressor *self = (GzipFileCompressor *) s;
+
+  for (gint i = 0; i < iov_count; i++)
+    {
+      if (!_gzip_deflate(self, iov[i].iov_base, iov[i].iov_len, Z_NO_FLUSH, output))
+        return FALSE;
+    }
+  return TRUE;
+}
+
+static gboolean
+_gzip_flush(FileCompressor *s, GString *output)
+{
+  GzipFileCompressor *self = (GzipFileCompressor *) s;
+
+  return _gzip_deflate(self, NULL, 0, Z_SYNC_FLUSH, output);
+}
+
+static gboolean
+_gzip_end_frame(FileCompressor *s, GString *output)
+{
+  GzipFileCompressor *self = (GzipFileCompressor *) s;
+
+  /* nothing was written to this member yet */
+  if (self->stream.total_in == 0)
+    return TRUE;
+
+  if (!_gzip_deflate(self, NULL, 0, Z_FINISH, output))
+    return FALSE;
+  return deflateReset(&self->stream) == Z_OK;
+}
+
+static void
+_gzip_free(FileCompressor *s)
+{
+  GzipFileCompressor *self = (GzipFileCompressor *) s;
+
+  deflateEnd(&self->stream);
+}
+
+static FileCompressor *
+_gzip_compressor_new(gint level)
+{
+  GzipFileCompressor *self = g_new0(GzipFileCompressor, 1);
+
+  /* 15 + 16: the largest window with a gzip header and trailer */
+  if (deflateInit2(&self->stream, level < 0 ? Z_DEFAULT_COMPRESSION : level,
+                   Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+    {
+      g_free(self);
+      return NULL;
+    }
+
+  self->super.compress = _gzip_compress;
+  self->super.flush = _gzip_flush;
+  self->super.end_frame = _gzip_end_frame;
+  self->super.free_fn = _gzip_free;
+  return &self->super;
+}
+
+#endif
+
+/****************************************************************************
+ * zstd
+ ****************************************************************************/
+
+#if SYSLOG_NG_ENABLE_ZSTD
+
+typedef struct _ZstdFileCompressor
+{
+  FileCompressor super;
+  ZSTD_CCtx *cctx;
+  gboolean in_frame;
+} ZstdFileCompressor;
+
+static gboolean
+_zstd_compress_stream(ZstdFileCompressor *self, ZSTD_inBuffer *input, ZSTD_EndDirective mode, GString *output)
+{
+  gsize remaining;
+
+  do
+    {
+      gsize pos;
+      ZSTD_outBuffer out = { .dst = _reserve_output(output, &pos), .size = FILE_COMPRESSOR_OUTPUT_CHUNK };
+
+      remaining = ZSTD_compressStream2(self->cctx, &out, input, mode);
+      g_string_set_size(output, pos + out.pos);
+
+      if (ZSTD_isError(remaining))
+        {
+          msg_error("Error compressing destination file",
+                    evt_tag_str("method", "zstd"),
+                    evt_tag_str("error", ZSTD_getErrorName(remaining)));
+          return FALSE;
+        }
+    }
+  while (mode == ZSTD_e_continue ? input->pos < input->size : remaining != 0);
+
+  return TRUE;
+}
+
+static gboolean
+_zstd_compress(FileCompressor *s, const struct iovec *iov, gint iov_count, GString *output)
+{
+  ZstdFileCompressor *self = (ZstdFileCompressor *) s;
+
+  for (gint i = 0; i < iov_count; i++)
+    {
+      ZSTD_inBuffer input = { .src = iov[i].iov_base, .size = iov[i].iov_len };
+
+      if (!_zstd_compress_stream(self, &input, ZSTD_e_continue, output))
+        return FALSE;
+      self->in_frame = TRUE;
+    }
+  return TRUE;
+}
+
+static gboolean
+_zstd_flush(FileCompressor *s, GString *output)
+{
+  ZstdFileCompressor *self = (ZstdFileCompressor *) s;
+  ZSTD_inBuffer input = { 0 };
+
+  return _zstd_compress_stream(self, &input, ZSTD_e_flush, output);
+}
+
+static gboolean
+_zstd_end_frame(FileCompressor *s, GString *output)
+{
+  ZstdFileCompressor *self = (ZstdFileCompressor *) s;
+  ZSTD_inBuffer input = { 0 };
+
+  if (!self->in_frame)
+    return TRUE;
+
+  self->in_frame = FALSE;
+  return _zstd_compress_stream(self, &input, ZSTD_e_end, output);
+}
+
+static void
+_zstd_free(FileCompressor *s)
+{
+  ZstdFileCompressor *self = (ZstdFileCompressor *) s;
+
+  ZSTD_freeCCtx(self->cctx);
+}
+
+static FileCompressor *
+_zstd_compressor_new(gint level)
+{
+  ZstdFileCompressor *self = g_new0(ZstdFileCompressor, 1);
+
+  self->cctx = ZSTD_createCCtx();
+  if (!self->cctx)
+    {
+      g_free(self);
+      return NULL;
+    }
+  ZSTD_CCtx_setParameter(self->cctx, ZSTD_c_compressionLevel, level < 0 ? ZSTD_CLEVEL_DEFAULT : level);
+  ZSTD_CCtx_setParameter(self->cctx, ZSTD_c_checksumFlag, 1);
+
+  self->super.compress = _zstd_compress;
+  self->super.flush = _zstd_flush;
+  self->super.end_frame = _zstd_end_frame;
+  self->super.free_fn = _zstd_free;
+  return &self->super;
+}
+
+#endif
+
+gboolean
+file_compression_options_set_method(FileCompressionOptions *self, const gchar *method)
+{
+  if (strcmp(method, "none") == 0)
+    self->method = FILE_COMPRESSION_NONE;
+#ifdef SYSLOG_NG_HAVE_ZLIB
+  else if (strcmp(method, "gzip") == 0)
+    self->method = FILE_COMPRESSION_GZIP;
+#endif
+#if SYSLOG_NG_ENABLE_ZSTD
+  else if (strcmp(method, "zstd") == 0)
+    self->method = FILE_COMPRESSION_ZSTD;
+#endif
+  else
+    return FALSE;
+
+  return TRUE;
+}
+
+gboolean
+file_compression_options_set_level(FileCompressionOptions *self, gint level)
+{
+  switch (self->method)
+    {
+    case FILE_COMPRESSION_GZIP:
+      if (level > 9)
+        return FALSE;
+      break;
+#if SYSLOG_NG_ENABLE_ZSTD
+    case FILE_COMPRESSION_ZSTD:
+      if (level < 1 || level > ZSTD_maxCLevel())
+        return FALSE;
+      break;
+#endif
+    default:
+      break;
+    }
+
+  self->level = level;
+  return TRUE;
+}
+
+FileCompressor *
+file_compressor_new(const FileCompressionOptions *options)
+{
+  FileCompressor *self = NULL;
+
+  switch (options->method)
+    {
+#ifdef SYSLOG_NG_HAVE_ZLIB
+    case FILE_COMPRESSION_GZIP:
+      self = _gzip_compressor_new(options->level);
+      break;
+#endif
+#if SYSLOG_NG_ENABLE_ZSTD
+    case FILE_COMPRESSION_ZSTD:
+      self = _zstd_compressor_new(options->level);
+      break;
+#endif
+    default:
+      return NULL;
+    }
+
+  if (!self)
+    {
+      msg_error("Error initializing the compression of destination file",
+                evt_tag_str("method", _method_name(options->method)));
+      return NULL;
+    }
+
+  self->method = options->method;
+  return self;
+}
+
+/* adds the bytes saved since the last call to output_file_compression_saved_bytes */
+void
+file_compressor_update_stats(FileCompressor *self)
+{
+  gssize saved_bytes = (gssize) self->input_bytes - (gssize) self->output_bytes;
+
+  if (saved_bytes == self->reported_saved_bytes)
+    return;
+
+  stats_counter_add(_get_saved_bytes_counter(self->method), saved_bytes - self->reported_saved_bytes);
+  self->reported_saved_bytes = saved_bytes;
+}
+
+void
+file_compressor_free(FileCompressor *self)
+{
+  if (self->free_fn)
+    self->free_fn(self);
+  g_free(self);
+}
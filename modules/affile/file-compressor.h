@@ -0,0 +1,104 @@
+/*
+ * Copyright (c) 2024 One Identity LLC.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#ifndef FILE_COMPRESSOR_H_INCLUDED
+#define FILE_COMPRESSOR_H_INCLUDED
+
+#include "syslog-ng.h"
+
+#include <sys/uio.h>
+
+typedef enum
+{
+  FILE_COMPRESSION_NONE,
+  FILE_COMPRESSION_GZIP,
+  FILE_COMPRESSION_ZSTD,
+} FileCompressionMethod;
+
+typedef struct _FileCompressionOptions
+{
+  FileCompressionMethod method;
+  /* -1 means the default of the method */
+  gint level;
+} FileCompressionOptions;
+
+/*
+ * Streaming compressor of file destinations.  The output is a sequence of
+ * gzip members or zstd frames, both of which are valid when concatenated.
+ */
+typedef struct _FileCompressor FileCompressor;
+
+struct _FileCompressor
+{
+  FileCompressionMethod method;
+  gsize input_bytes, output_bytes;
+  gssize reported_saved_bytes;
+
+  /* appends the compressed form of @iov to @output, some of it may be held back until the next flush */
+  gboolean (*compress)(FileCompressor *self, const struct iovec *iov, gint iov_count, GString *output);
+  /* appends everything held back, so that @output can be decompressed up to this point */
+  gboolean (*flush)(FileCompressor *self, GString *output);
+  /* finishes the current frame, the next compress() starts a new one */
+  gboolean (*end_frame)(FileCompressor *self, GString *output);
+  void (*free_fn)(FileCompressor *self);
+};
+
+static inline gboolean
+file_compressor_compress(FileCompressor *self, const struct iovec *iov, gint iov_count, GString *output)
+{
+  gsize output_len = output->len;
+  gboolean success = self->compress(self, iov, iov_count, output);
+
+  for (gint i = 0; i < iov_count; i++)
+    self->input_bytes += iov[i].iov_len;
+  self->output_bytes += output->len - output_len;
+  return success;
+}
+
+static inline gboolean
+file_compressor_flush(FileCompressor *self, GString *output)
+{
+  gsize output_len = output->len;
+  gboolean success = self->flush(self, output);
+
+  self->output_bytes += output->len - output_len;
+  return success;
+}
+
+static inline gboolean
+file_compressor_end_frame(FileCompressor *self, GString *output)
+{
+  gsize output_len = output->len;
+  gboolean success = self->end_frame(self, output);
+
+  self->output_bytes += output->len - output_len;
+  return success;
+}
+
+gboolean file_compression_options_set_method(FileCompressionOptions *self, const gchar *method);
+gboolean file_compression_options_set_level(FileCompressionOptions *self, gint level);
+
+FileCompressor *file_compressor_new(const FileCompressionOptions *options);
+void file_compressor_update_stats(FileCompressor *self);
+void file_compressor_free(FileCompressor *self);
+
+#endif
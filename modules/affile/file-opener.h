@@ -45,6 +45,7 @@ typedef struct _FileOpenerOptions
   FilePermOptions file_perm_options;
   guint needs_privileges:1;
   gint create_dirs;
+  gint io_uring;
 } FileOpenerOptions;
 
 typedef enum
@@ -33,8 +33,10 @@
 #include "poll-fd-events.h"
 #include "poll-file-changes.h"
 #include "poll-multiline-file-changes.h"
+#include "poll-file-inotify.h"
 #include "ack-tracker/ack_tracker_factory.h"
 #include "stats/stats-cluster-key-builder.h"
+#include "mainloop-io-worker.h"
 
 #include <sys/types.h>
 #include <sys/stat.h>
@@ -100,7 +102,10 @@ _construct_poll_events(FileReader *self, gint fd)
     {
       LogProtoFileReaderOptions *proto_opts = file_reader_options_get_log_proto_options(self->options);
 
-      if (proto_opts->multi_line_options.mode == MLM_NONE)
+      if (proto_opts->multi_line_options.mode == MLM_NONE && self->inotify && poll_file_inotify_is_reliable(fd))
+        return poll_file_inotify_new(fd, self->filename->str, self->options->follow_freq, &self->super,
+                                     self->inotify);
+      else if (proto_opts->multi_line_options.mode == MLM_NONE)
         return poll_file_changes_new(fd, self->filename->str, self->options->follow_freq, &self->super);
       else
         return poll_multiline_file_changes_new(fd, self->filename->str, self->options->follow_freq,
@@ -152,6 +157,60 @@ _deinit_sd_logreader(FileReader *self)
   log_pipe_deinit((LogPipe *) self->reader);
   log_pipe_unref((LogPipe *) self->reader);
   self->reader = NULL;
+  self->fd = -1;
+}
+
+static void
+_lag_key_set(FileReader *self, StatsClusterKey *sc_key, StatsClusterLabel *labels)
+{
+  labels[0] = stats_cluster_label("driver", "file");
+  labels[1] = stats_cluster_label("id", self->owner->super.id);
+  labels[2] = stats_cluster_label("filename", self->filename->str);
+  stats_cluster_single_key_set(sc_key, "input_file_lag_bytes", labels, 3);
+}
+
+static void
+_register_lag_counter(FileReader *self)
+{
+  StatsClusterKey sc_key;
+  StatsClusterLabel labels[3];
+
+  _lag_key_set(self, &sc_key, labels);
+  stats_lock();
+  stats_register_counter(STATS_LEVEL2, &sc_key, SC_TYPE_SINGLE_VALUE, &self->lag_bytes);
+  stats_unlock();
+}
+
+static void
+_unregister_lag_counter(FileReader *self)
+{
+  StatsClusterKey sc_key;
+  StatsClusterLabel labels[3];
+
+  if (!self->lag_bytes)
+    return;
+
+  _lag_key_set(self, &sc_key, labels);
+  stats_lock();
+  stats_unregister_counter(&sc_key, SC_TYPE_SINGLE_VALUE, &self->lag_bytes);
+  stats_unlock();
+}
+
+/* the number of bytes between our read position and the end of the file */
+void
+file_reader_update_lag(FileReader *self)
+{
+  struct stat st;
+  off_t pos;
+
+  if (!self->lag_bytes || self->fd < 0)
+    return;
+
+  pos = lseek(self->fd, 0, SEEK_CUR);
+  if (pos < 0 || fstat(self->fd, &st) < 0 || !S_ISREG(st.st_mode))
+    return;
+
+  stats_counter_set(self->lag_bytes, st.st_size > pos ? st.st_size - pos : 0);
 }
 
 static void
@@ -162,6 +221,7 @@ _setup_logreader(LogPipe *s, PollEvents *poll_events, LogProtoServer *proto, gbo
   self->reader = log_reader_new(log_pipe_get_config(s));
   log_pipe_set_options(&self->reader->super.super, &self->super.options);
   log_reader_open(self->reader, proto, poll_events);
+  log_reader_set_scheduler(self->reader, self->reader_scheduler);
 
   StatsClusterKeyBuilder *kb = stats_cluster_key_builder_new();
   stats_cluster_key_builder_add_label(kb, stats_cluster_label("driver", "file"));
@@ -192,14 +252,11 @@ _is_immediate_check_needed(gboolean file_opened, gboolean open_deferred)
 }
 
 static gboolean
-_reader_open_file(LogPipe *s, gboolean recover_state)
+_reader_setup_opened_file(LogPipe *s, FileOpenerResult res, gint fd, gboolean recover_state)
 {
   FileReader *self = (FileReader *) s;
   GlobalConfig *cfg = log_pipe_get_config(s);
-  gint fd;
   gboolean open_deferred = FALSE;
-
-  FileOpenerResult res = file_opener_open_fd(self->opener, self->filename->str, AFFILE_DIR_READ, &fd);
   gboolean file_opened =  res == FILE_OPENER_RESULT_SUCCESS;
 
   if (!file_opened && self->options->follow_freq > 0)
@@ -223,6 +280,7 @@ _reader_open_file(LogPipe *s, gboolean recover_state)
           return FALSE;
         }
       proto = _construct_proto(self, fd);
+      self->fd = fd;
 
       check_immediately = _is_immediate_check_needed(file_opened, open_deferred);
       _setup_logreader(s, poll_events, proto, check_immediately);
@@ -232,6 +290,7 @@ _reader_open_file(LogPipe *s, gboolean recover_state)
                     evt_tag_int("fd", fd));
           log_pipe_unref((LogPipe *) self->reader);
           self->reader = NULL;
+          self->fd = -1;
           close(fd);
           return FALSE;
         }
@@ -249,6 +308,96 @@ _reader_open_file(LogPipe *s, gboolean recover_state)
 
 }
 
+static gboolean
+_reader_open_file(LogPipe *s, gboolean recover_state)
+{
+  FileReader *self = (FileReader *) s;
+  gint fd;
+
+  FileOpenerResult res = file_opener_open_fd(self->opener, self->filename->str, AFFILE_DIR_READ, &fd);
+  return _reader_setup_opened_file(s, res, fd, recover_state);
+}
+
+/*
+ * async-open(yes): the file is opened by an I/O worker, so that starting
+ * up with thousands of files does not stall the main thread, each reader
+ * becomes live as soon as its own file is open.  The rest of the setup
+ * (the persisted position, the poll events and the LogReader itself)
+ * happens in the main thread, once the job is finished.
+ */
+static void
+_open_job_engage(FileReader *self)
+{
+  log_pipe_ref(&self->super);
+  self->open_owner = self->owner;
+  log_pipe_ref(&self->open_owner->super.super);
+}
+
+static void
+_open_job_release(FileReader *self)
+{
+  LogSrcDriver *open_owner = self->open_owner;
+
+  self->open_owner = NULL;
+  log_pipe_unref(&open_owner->super.super);
+  log_pipe_unref(&self->super);
+}
+
+/* NOTE: runs in an I/O worker */
+static void
+_open_job_perform(FileReader *self, gpointer arg)
+{
+  self->open_result = file_opener_open_fd(self->opener, self->filename->str, AFFILE_DIR_READ, &self->opened_fd);
+  self->open_errno = errno;
+}
+
+static void
+_discard_opened_fd(FileReader *self)
+{
+  if (self->open_result == FILE_OPENER_RESULT_SUCCESS)
+    close(self->opened_fd);
+  self->opened_fd = -1;
+}
+
+/* NOTE: runs in the main thread */
+static void
+_open_job_finished(FileReader *self, gpointer arg)
+{
+  if (self->reopen_requested)
+    {
+      /* we were deinitialized and initialized again while working, the result is stale */
+      self->reopen_requested = FALSE;
+      _discard_opened_fd(self);
+      main_loop_io_worker_job_submit(&self->open_job, NULL);
+      return;
+    }
+
+  if (!(self->super.flags & PIF_INITIALIZED) || self->reader)
+    {
+      _discard_opened_fd(self);
+      return;
+    }
+
+  gint fd = self->opened_fd;
+  self->opened_fd = -1;
+
+  errno = self->open_errno;
+  if (!_reader_setup_opened_file(&self->super, self->open_result, fd, TRUE))
+    {
+      msg_error("Error setting up file reader, the file is not followed until it is reopened",
+                evt_tag_str("filename", self->filename->str));
+    }
+}
+
+static void
+_submit_open_job(FileReader *self)
+{
+  if (self->open_job.working)
+    self->reopen_requested = TRUE;
+  else
+    main_loop_io_worker_job_submit(&self->open_job, NULL);
+}
+
 static void
 _reopen_on_notify(LogPipe *s, gboolean recover_state)
 {
@@ -283,6 +432,10 @@ file_reader_notify_method(LogPipe *s, gint notify_code, gpointer user_data)
       _reopen_on_notify(s, FALSE);
       break;
 
+    case NC_FILE_EOF:
+      file_reader_update_lag(self);
+      break;
+
     default:
       break;
     }
@@ -304,13 +457,24 @@ file_reader_queue_method(LogPipe *s, LogMessage *msg, const LogPathOptions *path
 gboolean
 file_reader_init_method(LogPipe *s)
 {
-  return _reader_open_file(s, TRUE);
+  FileReader *self = (FileReader *)s;
+
+  if (self->options->async_open)
+    _submit_open_job(self);
+  else if (!_reader_open_file(s, TRUE))
+    return FALSE;
+
+  _register_lag_counter(self);
+  return TRUE;
 }
 
 gboolean
 file_reader_deinit_method(LogPipe *s)
 {
   FileReader *self = (FileReader *)s;
+
+  _unregister_lag_counter(self);
+  self->reopen_requested = FALSE;
   if (self->reader)
     _deinit_sd_logreader(self);
   return TRUE;
@@ -323,6 +487,20 @@ file_reader_free_method(LogPipe *s)
 
   g_assert(!self->reader);
   g_string_free(self->filename, TRUE);
+  shared_inotify_unref(self->inotify);
+}
+
+void
+file_reader_set_inotify(FileReader *self, SharedInotify *inotify)
+{
+  shared_inotify_unref(self->inotify);
+  self->inotify = shared_inotify_ref(inotify);
+}
+
+void
+file_reader_set_reader_scheduler(FileReader *self, LogReaderScheduler *scheduler)
+{
+  self->reader_scheduler = scheduler;
 }
 
 void
@@ -343,6 +521,7 @@ file_reader_stop_follow_file(FileReader *self)
 {
   log_reader_disable_bookmark_saving(self->reader);
   log_reader_close_proto(self->reader);
+  self->fd = -1;
 }
 
 void
@@ -365,10 +544,19 @@ file_reader_init_instance (FileReader *self, const gchar *filename,
   self->super.free_fn = file_reader_free_method;
   self->super.generate_persist_name = _format_persist_name;
   self->filename = g_string_new (filename);
+  self->fd = -1;
   self->options = options;
   self->opener = opener;
   self->owner = owner;
   self->super.expr_node = owner->super.super.expr_node;
+
+  self->opened_fd = -1;
+  main_loop_io_worker_job_init(&self->open_job);
+  self->open_job.user_data = self;
+  self->open_job.work = (void (*)(void *, void *)) _open_job_perform;
+  self->open_job.completion = (void (*)(void *, void *)) _open_job_finished;
+  self->open_job.engage = (void (*)(void *)) _open_job_engage;
+  self->open_job.release = (void (*)(void *)) _open_job_release;
 }
 
 FileReader *
@@ -393,6 +581,12 @@ file_reader_options_set_multi_line_timeout(FileReaderOptions *options, gint mult
   options->multi_line_timeout = multi_line_timeout;
 }
 
+void
+file_reader_options_set_async_open(FileReaderOptions *options, gboolean async_open)
+{
+  options->async_open = async_open;
+}
+
 void
 file_reader_options_defaults(FileReaderOptions *options)
 {
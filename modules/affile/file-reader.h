@@ -25,6 +25,8 @@
 #include "driver.h"
 #include "logreader.h"
 #include "file-opener.h"
+#include "poll-file-inotify.h"
+#include "mainloop-io-worker.h"
 
 typedef struct _FileReaderOptions
 {
@@ -33,6 +35,8 @@ typedef struct _FileReaderOptions
   gboolean restore_state;
   LogReaderOptions reader_options;
   gboolean exit_on_eof;
+  /* open the files on I/O workers instead of the main thread */
+  gboolean async_open;
 } FileReaderOptions;
 
 typedef struct _FileReader
@@ -43,6 +47,21 @@ typedef struct _FileReader
   FileReaderOptions *options;
   FileOpener *opener;
   LogReader *reader;
+  /* if set, regular files are followed by inotify instead of polling */
+  SharedInotify *inotify;
+  /* if set, the read turns of our LogReader are granted by this scheduler */
+  LogReaderScheduler *reader_scheduler;
+  /* the fd of the followed file, -1 if the file is not open */
+  gint fd;
+  StatsCounterItem *lag_bytes;
+
+  /* asynchronous opens, the job keeps a reference to the owner it was started with */
+  MainLoopIOWorkerJob open_job;
+  LogSrcDriver *open_owner;
+  FileOpenerResult open_result;
+  gint opened_fd;
+  gint open_errno;
+  gboolean reopen_requested;
 } FileReader;
 
 static inline LogProtoFileReaderOptions *
@@ -67,9 +86,13 @@ void file_reader_notify_method(LogPipe *s, gint notify_code, gpointer user_data)
 void file_reader_remove_persist_state(FileReader *self);
 void file_reader_stop_follow_file(FileReader *self);
 void file_reader_cue_buffer_flush(FileReader *self);
+void file_reader_set_inotify(FileReader *self, SharedInotify *inotify);
+void file_reader_set_reader_scheduler(FileReader *self, LogReaderScheduler *scheduler);
+void file_reader_update_lag(FileReader *self);
 
 void file_reader_options_set_follow_freq(FileReaderOptions *options, gint follow_freq);
 void file_reader_options_set_multi_line_timeout(FileReaderOptions *options, gint multi_line_timeout);
+void file_reader_options_set_async_open(FileReaderOptions *options, gboolean async_open);
 
 void file_reader_options_defaults(FileReaderOptions *options);
 gboolean file_reader_options_init(FileReaderOptions *options, GlobalConfig *cfg, const gchar *group);
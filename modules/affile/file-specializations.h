@@ -26,9 +26,12 @@
 
 #include "file-opener.h"
 #include "logwriter.h"
+#include "file-compressor.h"
 
 FileOpener *file_opener_for_regular_source_files_new(void);
-FileOpener *file_opener_for_regular_dest_files_new(const LogWriterOptions *writer_options, gboolean *use_fsync);
+FileOpener *file_opener_for_regular_dest_files_new(const LogWriterOptions *writer_options, gboolean *use_fsync,
+                                                   gint *fsync_max_delay,
+                                                   const FileCompressionOptions *compression);
 FileOpener *file_opener_for_devkmsg_new(void);
 FileOpener *file_opener_for_prockmsg_new(void);
 
@@ -0,0 +1,285 @@
+/*
+ * Copyright (c) 2024 One Identity LLC.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#include "file-sync-scheduler.h"
+#include "apphook.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <errno.h>
+
+/*
+ * Group commit for file destinations with fsync(yes)
+ *
+ * Instead of syncing each file separately, writers hand their fd over to a
+ * dedicated thread and wait until a sync covering their writes completes.
+ * The thread collects requests for at most max_delay milliseconds (the
+ * smallest of the ones requested), then syncs every file of the batch once.
+ * If a batch contains many files on the same filesystem, a single syncfs()
+ * is issued for them instead.
+ *
+ * Requests that arrive while a batch is being synced go into the next one,
+ * so concurrent syncs are coalesced even with a zero delay.
+ */
+
+typedef struct _FileSyncRequest
+{
+  gint fd;
+  dev_t dev;
+  gint error;
+  gboolean done;
+} FileSyncRequest;
+
+typedef struct _FileSyncScheduler
+{
+  GMutex lock;
+  GCond request_cond;
+  GCond done_cond;
+  GThread *thread;
+  GPtrArray *pending;
+  gint64 deadline;
+  gboolean quit;
+} FileSyncScheduler;
+
+static FileSyncScheduler scheduler;
+
+static gint
+_sync_file(gint fd)
+{
+#if SYSLOG_NG_HAVE_FDATASYNC
+  return fdatasync(fd);
+#else
+  return fsync(fd);
+#endif
+}
+
+static gint
+_compare_requests(gconstpointer a, gconstpointer b)
+{
+  const FileSyncRequest *ra = *(const FileSyncRequest **) a;
+  const FileSyncRequest *rb = *(const FileSyncRequest **) b;
+
+  if (ra->dev != rb->dev)
+    return ra->dev < rb->dev ? -1 : 1;
+  return ra->fd - rb->fd;
+}
+
+static inline FileSyncRequest *
+_batch_request(GPtrArray *batch, guint i)
+{
+  return (FileSyncRequest *) g_ptr_array_index(batch, i);
+}
+
+#if SYSLOG_NG_HAVE_SYNCFS
+static gboolean
+_sync_filesystem(GPtrArray *batch, guint start, guint end)
+{
+  guint files = 0;
+
+  for (guint i = start; i < end; i++)
+    {
+      if (i == start || _batch_request(batch, i)->fd != _batch_request(batch, i - 1)->fd)
+        files++;
+    }
+
+  if (files < FILE_SYNC_SCHEDULER_SYNCFS_THRESHOLD)
+    return FALSE;
+
+  /* fall back to syncing the files one by one if this fails */
+  return syncfs(_batch_request(batch, start)->fd) == 0;
+}
+#endif
+
+/* requests in [start, end) are sorted by fd and refer to files on the same device */
+static void
+_sync_device(GPtrArray *batch, guint start, guint end)
+{
+  gint error = 0;
+
+#if SYSLOG_NG_HAVE_SYNCFS
+  if (_sync_filesystem(batch, start, end))
+    return;
+#endif
+
+  for (guint i = start; i < end; i++)
+    {
+      FileSyncRequest *request = _batch_request(batch, i);
+
+      if (i == start || request->fd != _batch_request(batch, i - 1)->fd)
+        error = _sync_file(request->fd) < 0 ? errno : 0;
+      request->error = error;
+    }
+}
+
+static void
+_sync_batch(GPtrArray *batch)
+{
+  guint start = 0;
+
+  g_ptr_array_sort(batch, _compare_requests);
+  for (guint i = 1; i <= batch->len; i++)
+    {
+      if (i == batch->len || _batch_request(batch, i)->dev != _batch_request(batch, start)->dev)
+        {
+          _sync_device(batch, start, i);
+          start = i;
+        }
+    }
+}
+
+static gpointer
+_sync_thread_func(gpointer user_data)
+{
+  GPtrArray *batch = g_ptr_array_new();
+
+  app_thread_start();
+
+  g_mutex_lock(&scheduler.lock);
+  while (TRUE)
+    {
+      while (scheduler.pending->len == 0 && !scheduler.quit)
+        g_cond_wait(&scheduler.request_cond, &scheduler.lock);
+
+      /* requests are served even when quitting, we only stop once there are none */
+      if (scheduler.pending->len == 0)
+        break;
+
+      while (!scheduler.quit && g_get_monotonic_time() < scheduler.deadline)
+        g_cond_wait_until(&scheduler.request_cond, &scheduler.lock, scheduler.deadline);
+
+      GPtrArray *collected = scheduler.pending;
+      scheduler.pending = batch;
+      batch = collected;
+      scheduler.deadline = G_MAXINT64;
+      g_mutex_unlock(&scheduler.lock);
+
+      _sync_batch(batch);
+
+      g_mutex_lock(&scheduler.lock);
+      for (guint i = 0; i < batch->len; i++)
+        _batch_request(batch, i)->done = TRUE;
+      g_ptr_array_set_size(batch, 0);
+      g_cond_broadcast(&scheduler.done_cond);
+    }
+  g_mutex_unlock(&scheduler.lock);
+
+  g_ptr_array_free(batch, TRUE);
+  app_thread_stop();
+  return NULL;
+}
+
+/*
+ * Starts writing back the dirty pages of @fd without waiting for it, so
+ * that there is less to do for the sync that follows.
+ */
+void
+file_sync_scheduler_start_writeback(gint fd)
+{
+#if SYSLOG_NG_HAVE_SYNC_FILE_RANGE
+  sync_file_range(fd, 0, 0, SYNC_FILE_RANGE_WRITE);
+#endif
+}
+
+/*
+ * Returns once everything written to @fd so far has reached the disk,
+ * waiting at most @max_delay milliseconds for other files to share the
+ * sync with.  On failure, errno is set and FALSE is returned.
+ */
+gboolean
+file_sync_scheduler_sync(gint fd, gint max_delay)
+{
+  FileSyncRequest request = { .fd = fd };
+  struct stat st;
+
+  if (fstat(fd, &st) == 0)
+    request.dev = st.st_dev;
+
+  g_mutex_lock(&scheduler.lock);
+  if (scheduler.quit || !scheduler.pending)
+    {
+      g_mutex_unlock(&scheduler.lock);
+      return _sync_file(fd) == 0;
+    }
+
+  if (!scheduler.thread)
+    scheduler.thread = g_thread_new("file-sync", _sync_thread_func, NULL);
+
+  g_ptr_array_add(scheduler.pending, &request);
+  scheduler.deadline = MIN(scheduler.deadline, g_get_monotonic_time() + max_delay * G_TIME_SPAN_MILLISECOND);
+  g_cond_signal(&scheduler.request_cond);
+
+  while (!request.done)
+    g_cond_wait(&scheduler.done_cond, &scheduler.lock);
+  g_mutex_unlock(&scheduler.lock);
+
+  if (request.error)
+    {
+      errno = request.error;
+      return FALSE;
+    }
+  return TRUE;
+}
+
+static void
+_stop_sync_thread(gint type, gpointer user_data)
+{
+  file_sync_scheduler_global_deinit();
+}
+
+void
+file_sync_scheduler_global_init(void)
+{
+  g_mutex_lock(&scheduler.lock);
+  if (!scheduler.pending)
+    {
+      scheduler.pending = g_ptr_array_new();
+      scheduler.deadline = G_MAXINT64;
+      scheduler.quit = FALSE;
+      register_application_hook(AH_SHUTDOWN, _stop_sync_thread, NULL, AHM_RUN_ONCE);
+    }
+  g_mutex_unlock(&scheduler.lock);
+}
+
+void
+file_sync_scheduler_global_deinit(void)
+{
+  GThread *thread;
+
+  g_mutex_lock(&scheduler.lock);
+  scheduler.quit = TRUE;
+  thread = scheduler.thread;
+  scheduler.thread = NULL;
+  g_cond_signal(&scheduler.request_cond);
+  g_mutex_unlock(&scheduler.lock);
+
+  if (thread)
+    g_thread_join(thread);
+
+  g_mutex_lock(&scheduler.lock);
+  if (scheduler.pending)
+    {
+      g_ptr_array_free(scheduler.pending, TRUE);
+      scheduler.pending = NULL;
+    }
+  g_mutex_unlock(&scheduler.lock);
+}
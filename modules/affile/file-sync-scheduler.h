@@ -0,0 +1,37 @@
+/*
+ * Copyright (c) 2024 One Identity LLC.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#ifndef FILE_SYNC_SCHEDULER_H_INCLUDED
+#define FILE_SYNC_SCHEDULER_H_INCLUDED
+
+#include "syslog-ng.h"
+
+/* with at least this many files on the same filesystem, a batch is synced using a single syncfs() */
+#define FILE_SYNC_SCHEDULER_SYNCFS_THRESHOLD 8
+
+void file_sync_scheduler_start_writeback(gint fd);
+gboolean file_sync_scheduler_sync(gint fd, gint max_delay);
+
+void file_sync_scheduler_global_init(void);
+void file_sync_scheduler_global_deinit(void);
+
+#endif
@@ -22,12 +22,12 @@
  */
 
 #include "logproto-file-writer.h"
+#include "file-sync-scheduler.h"
 #include "messages.h"
 
 #include <string.h>
 #include <errno.h>
 #include <sys/uio.h>
-#include <unistd.h>
 
 typedef struct _LogProtoFileWriter
 {
@@ -37,34 +37,111 @@ typedef struct _LogProtoFileWriter
   gint partial_messages;
   gint buf_size;
   gint buf_count;
-  gint fd;
   gint sum_len;
   gboolean fsync;
+
+  /* fsync(yes) without a transport level writev_and_sync(): the messages
+   * written are acknowledged after a group sync at the end of the flush */
+  gboolean group_sync;
+  gint fsync_max_delay;
+  gint unsynced_messages;
+
+  /* compression(), messages held back by the compressor are acknowledged
+   * once they are flushed out at the end of the flush */
+  FileCompressor *compressor;
+  gint compressed_messages;
   struct iovec buffer[0];
 } LogProtoFileWriter;
 
+static gssize
+_write_buffer(LogProtoFileWriter *self, struct iovec *iov, gint iov_count)
+{
+  if (self->group_sync)
+    {
+      gssize rc = log_transport_writev(self->super.transport, iov, iov_count);
+      if (rc > 0)
+        file_sync_scheduler_start_writeback(self->super.transport->fd);
+      return rc;
+    }
+  if (self->fsync)
+    return log_transport_writev_and_sync(self->super.transport, iov, iov_count);
+  return log_transport_writev(self->super.transport, iov, iov_count);
+}
+
+static void
+_ack_written(LogProtoFileWriter *self, gint num_msg_written)
+{
+  if (self->group_sync)
+    self->unsynced_messages += num_msg_written;
+  else
+    log_proto_client_msg_ack(&self->super, num_msg_written);
+}
+
+static void
+_sync_written(LogProtoFileWriter *self)
+{
+  if (self->unsynced_messages == 0)
+    return;
+
+  if (!file_sync_scheduler_sync(self->super.transport->fd, self->fsync_max_delay))
+    {
+      msg_error("Error syncing destination file",
+                evt_tag_int("fd", self->super.transport->fd),
+                evt_tag_error(EVT_TAG_OSERROR));
+    }
+  log_proto_client_msg_ack(&self->super, self->unsynced_messages);
+  self->unsynced_messages = 0;
+}
+
 /*
- * log_proto_file_writer_flush:
+ * Only the messages after the ones already written are rewound.  With
+ * compression() nothing is rewound: the compressor has already consumed
+ * the messages, so feeding them again would duplicate them in the
+ * compressed stream.  The compressed output is kept in partial instead,
+ * and is written once the writer resumes after the error.
+ */
+static LogProtoStatus
+_write_error(LogProtoFileWriter *self)
+{
+  gint saved_errno = errno;
+
+  _sync_written(self);
+  errno = saved_errno;
+  if (!self->compressor)
+    log_proto_client_msg_rewind(&self->super);
+  msg_error("I/O error occurred while writing",
+            evt_tag_int("fd", self->super.transport->fd),
+            evt_tag_error(EVT_TAG_OSERROR));
+  return LPS_ERROR;
+}
+
+static LogProtoStatus log_proto_file_writer_flush_compressed(LogProtoFileWriter *self, gboolean flush_compressor);
+
+/*
+ * log_proto_file_writer_flush_buffer:
  *
  * this function flushes the file output buffer
  * it is called either form log_proto_file_writer_post (normal mode: the buffer is full)
  * or from log_proto_flush (foced flush: flush time, exit, etc)
+ * in the latter case flush_compressor is set, see log_proto_file_writer_flush_compressed()
  *
  */
 static LogProtoStatus
-log_proto_file_writer_flush(LogProtoClient *s)
+log_proto_file_writer_flush_buffer(LogProtoFileWriter *self, gboolean flush_compressor)
 {
-  LogProtoFileWriter *self = (LogProtoFileWriter *)s;
   gint rc, i, i0, sum, ofs, pos;
 
   if (self->partial)
     {
       /* there is still some data from the previous file writing process */
       gint len = self->partial_len - self->partial_pos;
+      struct iovec partial_iov =
+      {
+        .iov_base = self->partial + self->partial_pos,
+        .iov_len = len
+      };
 
-      rc = log_transport_write(self->super.transport, self->partial + self->partial_pos, len);
-      if (rc > 0 && self->fsync)
-        fsync(self->fd);
+      rc = _write_buffer(self, &partial_iov, 1);
       if (rc < 0)
         {
           goto write_error;
@@ -76,19 +153,20 @@ log_proto_file_writer_flush(LogProtoClient *s)
         }
       else
         {
-          log_proto_client_msg_ack(&self->super, self->partial_messages);
+          _ack_written(self, self->partial_messages);
           g_free(self->partial);
           self->partial = NULL;
         }
     }
 
+  if (self->compressor)
+    return log_proto_file_writer_flush_compressed(self, flush_compressor);
+
   /* we might be called from log_writer_deinit() without having a buffer at all */
   if (self->buf_count == 0)
     return LPS_SUCCESS;
 
-  rc = log_transport_writev(self->super.transport, self->buffer, self->buf_count);
-  if (rc > 0 && self->fsync)
-    fsync(self->fd);
+  rc = _write_buffer(self, self->buffer, self->buf_count);
 
   if (rc < 0)
     {
@@ -125,7 +203,7 @@ log_proto_file_writer_flush(LogProtoClient *s)
     }
   else
     {
-      log_proto_client_msg_ack(&self->super, self->buf_count);
+      _ack_written(self, self->buf_count);
     }
 
   /* free the previous message strings (the remaining part has been copied to the partial buffer) */
@@ -138,16 +216,134 @@ log_proto_file_writer_flush(LogProtoClient *s)
 
 write_error:
   if (errno != EINTR && errno != EAGAIN)
+    return _write_error(self);
+
+  return LPS_SUCCESS;
+
+}
+
+/*
+ * The compressor state already covers the bytes of @compressed, so if
+ * they cannot be written at once, they are kept as they are in partial,
+ * even if the write failed.
+ */
+static LogProtoStatus
+_write_compressed(LogProtoFileWriter *self, GString *compressed, gint num_msg_written)
+{
+  struct iovec iov =
+  {
+    .iov_base = compressed->str,
+    .iov_len = compressed->len
+  };
+  gssize rc = compressed->len > 0 ? _write_buffer(self, &iov, 1) : 0;
+  gint saved_errno = errno;
+  gboolean write_error = rc < 0 && errno != EINTR && errno != EAGAIN;
+
+  if (rc < 0)
+    rc = 0;
+
+  if ((gsize) rc < compressed->len)
+    {
+      self->partial_len = compressed->len;
+      self->partial_pos = rc;
+      self->partial_messages = num_msg_written;
+      self->partial = (guchar *) g_string_free(compressed, FALSE);
+
+      errno = saved_errno;
+      return write_error ? _write_error(self) : LPS_SUCCESS;
+    }
+
+  _ack_written(self, num_msg_written);
+  g_string_free(compressed, TRUE);
+  return LPS_SUCCESS;
+}
+
+static LogProtoStatus
+log_proto_file_writer_flush_compressed(LogProtoFileWriter *self, gboolean flush_compressor)
+{
+  GString *compressed = g_string_sized_new(self->sum_len / 2 + 64);
+  gboolean success = file_compressor_compress(self->compressor, self->buffer, self->buf_count, compressed);
+  gint num_msg_written = 0;
+
+  for (gint i = 0; i < self->buf_count; ++i)
+    g_free(self->buffer[i].iov_base);
+  self->compressed_messages += self->buf_count;
+  self->buf_count = 0;
+  self->sum_len = 0;
+
+  if (success && flush_compressor && self->compressed_messages > 0)
     {
+      success = file_compressor_flush(self->compressor, compressed);
+      num_msg_written = self->compressed_messages;
+      self->compressed_messages = 0;
+    }
+
+  if (!success)
+    {
+      g_string_free(compressed, TRUE);
+      _sync_written(self);
+      self->compressed_messages = 0;
       log_proto_client_msg_rewind(&self->super);
-      msg_error("I/O error occurred while writing",
-                evt_tag_int("fd", self->super.transport->fd),
-                evt_tag_error(EVT_TAG_OSERROR));
+      msg_error("Error compressing messages written to file",
+                evt_tag_int("fd", self->super.transport->fd));
       return LPS_ERROR;
     }
 
-  return LPS_SUCCESS;
+  file_compressor_update_stats(self->compressor);
+  return _write_compressed(self, compressed, num_msg_written);
+}
+
+static void
+_write_all(LogProtoFileWriter *self, const guchar *data, gsize len)
+{
+  while (len > 0)
+    {
+      gssize rc = log_transport_write(self->super.transport, (const gpointer) data, len);
 
+      if (rc < 0 && errno == EINTR)
+        continue;
+      if (rc <= 0)
+        {
+          msg_error("I/O error occurred while finishing compressed file",
+                    evt_tag_int("fd", self->super.transport->fd),
+                    evt_tag_error(EVT_TAG_OSERROR));
+          return;
+        }
+      data += rc;
+      len -= rc;
+    }
+}
+
+/*
+ * Finishes the current gzip member or zstd frame when the file is closed
+ * (reaped, reopened or at exit), so that the file is valid as it is.
+ * Messages not acknowledged yet are written again to the next file.
+ */
+static void
+_end_compressed_frame(LogProtoFileWriter *self)
+{
+  GString *trailer = g_string_new(NULL);
+
+  if (self->partial)
+    _write_all(self, self->partial + self->partial_pos, self->partial_len - self->partial_pos);
+
+  if (file_compressor_end_frame(self->compressor, trailer))
+    _write_all(self, (const guchar *) trailer->str, trailer->len);
+
+  file_compressor_update_stats(self->compressor);
+  g_string_free(trailer, TRUE);
+}
+
+/* messages written by the flush are only acknowledged once they are on disk, see _sync_written() */
+static LogProtoStatus
+log_proto_file_writer_flush(LogProtoClient *s)
+{
+  LogProtoFileWriter *self = (LogProtoFileWriter *)s;
+  LogProtoStatus status = log_proto_file_writer_flush_buffer(self, TRUE);
+
+  if (status != LPS_ERROR)
+    _sync_written(self);
+  return status;
 }
 
 /*
@@ -170,7 +366,7 @@ log_proto_file_writer_post(LogProtoClient *s, LogMessage *logmsg, guchar *msg, g
   *consumed = FALSE;
   if (self->buf_count >= self->buf_size || self->partial)
     {
-      result = log_proto_file_writer_flush(s);
+      result = log_proto_file_writer_flush_buffer(self, FALSE);
       if (result != LPS_SUCCESS || self->buf_count >= self->buf_size || self->partial)
         {
           /* don't consume a new message if flush failed OR if we couldn't
@@ -192,7 +388,7 @@ log_proto_file_writer_post(LogProtoClient *s, LogMessage *logmsg, guchar *msg, g
   if (self->buf_count == self->buf_size)
     {
       /* we have reached the max buffer size -> we need to write the messages */
-      return log_proto_file_writer_flush(s);
+      return log_proto_file_writer_flush_buffer(self, FALSE);
     }
 
   return LPS_SUCCESS;
@@ -217,6 +413,20 @@ log_proto_file_writer_prepare(LogProtoClient *s, gint *fd, GIOCondition *cond, g
   return pending_write;
 }
 
+static void
+log_proto_file_writer_free(LogProtoClient *s)
+{
+  LogProtoFileWriter *self = (LogProtoFileWriter *) s;
+
+  if (self->compressor)
+    {
+      _end_compressed_frame(self);
+      file_compressor_free(self->compressor);
+    }
+  g_free(self->partial);
+  log_proto_client_free_method(s);
+}
+
 LogProtoClient *
 log_proto_file_writer_new(LogTransport *transport, const LogProtoClientOptions *options, gint flush_lines, gint fsync_)
 {
@@ -234,11 +444,30 @@ log_proto_file_writer_new(LogTransport *transport, const LogProtoClientOptions *
       struct iovec)*flush_lines);
 
   log_proto_client_init(&self->super, transport, options);
-  self->fd = transport->fd;
   self->buf_size = flush_lines;
   self->fsync = fsync_;
+  self->group_sync = fsync_ && !transport->writev_and_sync;
   self->super.prepare = log_proto_file_writer_prepare;
   self->super.post = log_proto_file_writer_post;
   self->super.flush = log_proto_file_writer_flush;
+  self->super.free_fn = log_proto_file_writer_free;
   return &self->super;
 }
+
+void
+log_proto_file_writer_set_fsync_max_delay(LogProtoClient *s, gint fsync_max_delay)
+{
+  LogProtoFileWriter *self = (LogProtoFileWriter *) s;
+
+  self->fsync_max_delay = fsync_max_delay;
+}
+
+void
+log_proto_file_writer_set_compression(LogProtoClient *s, const FileCompressionOptions *options)
+{
+  LogProtoFileWriter *self = (LogProtoFileWriter *) s;
+
+  g_assert(!self->compressor);
+  if (options->method != FILE_COMPRESSION_NONE)
+    self->compressor = file_compressor_new(options);
+}
@@ -25,8 +25,11 @@
 #define LOG_PROTO_FILE_WRITER_H_INCLUDED
 
 #include "logproto/logproto-client.h"
+#include "file-compressor.h"
 
 LogProtoClient *log_proto_file_writer_new(LogTransport *transport, const LogProtoClientOptions *options,
                                           gint flush_lines, gboolean fsync);
+void log_proto_file_writer_set_fsync_max_delay(LogProtoClient *s, gint fsync_max_delay);
+void log_proto_file_writer_set_compression(LogProtoClient *s, const FileCompressionOptions *options);
 
 #endif
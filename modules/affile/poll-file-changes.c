@@ -66,7 +66,7 @@ poll_file_changes_on_eof(PollFileChanges *self)
 
 /* follow timer callback. Check if the file has new content, or deleted or
  * moved.  Ran every follow_freq seconds.  */
-static void
+void
 poll_file_changes_check_file(gpointer s)
 {
   PollFileChanges *self = (PollFileChanges *) s;
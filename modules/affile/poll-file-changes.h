@@ -48,6 +48,7 @@ PollEvents *poll_file_changes_new(gint fd, const gchar *follow_filename, gint fo
 
 void poll_file_changes_init_instance(PollFileChanges *self, gint fd, const gchar *follow_filename, gint follow_freq,
                                      LogPipe *control);
+void poll_file_changes_check_file(gpointer s);
 void poll_file_changes_update_watches(PollEvents *s, GIOCondition cond);
 void poll_file_changes_stop_watches(PollEvents *s);
 void poll_file_changes_free(PollEvents *s);
@@ -0,0 +1,309 @@
+/*
+ * Copyright (c) 2024 One Identity LLC.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+#include "poll-file-inotify.h"
+#include "messages.h"
+
+#if SYSLOG_NG_HAVE_INOTIFY
+
+#include <sys/stat.h>
+#include <sys/vfs.h>
+#include <unistd.h>
+#include <errno.h>
+#include <iv_inotify.h>
+
+/*
+ * Event driven variant of PollFileChanges: instead of checking the file
+ * every follow-freq() milliseconds, it waits for inotify events once the
+ * end of the file is reached.  The checks themselves (new data,
+ * truncation, rotation) are the ones of PollFileChanges.
+ *
+ * Once the followed file is moved or deleted, the inode watch does not
+ * tell us when a new file appears under the same name, so we fall back to
+ * polling until the reader reopens the file.
+ */
+
+struct _SharedInotify
+{
+  GAtomicCounter ref_cnt;
+  struct iv_inotify inotify;
+};
+
+typedef struct _PollFileInotify
+{
+  PollFileChanges super;
+  SharedInotify *inotify;
+  struct iv_inotify_watch watch;
+  gboolean watch_registered;
+  /* waiting for an inotify event */
+  gboolean armed;
+  gboolean polling;
+  struct iv_task check_task;
+} PollFileInotify;
+
+/* network and FUSE filesystems do not report changes made by other hosts */
+static const glong unreliable_filesystems[] =
+{
+  0x6969,       /* NFS */
+  0x517B,       /* SMB */
+  0xFF534D42,   /* CIFS */
+  0xFE534D42,   /* SMB2 */
+  0x65735546,   /* FUSE */
+  0x01021997,   /* 9P */
+  0x47504653,   /* GPFS */
+  0x00C36400,   /* CEPH */
+};
+
+gboolean
+poll_file_inotify_is_reliable(gint fd)
+{
+  struct statfs st;
+
+  if (fd < 0 || fstatfs(fd, &st) < 0)
+    return FALSE;
+
+  for (gint i = 0; i < G_N_ELEMENTS(unreliable_filesystems); i++)
+    {
+      if ((glong) st.f_type == unreliable_filesystems[i])
+        return FALSE;
+    }
+  return TRUE;
+}
+
+static void
+_schedule_check(PollFileInotify *self)
+{
+  self->armed = FALSE;
+  if (!iv_task_registered(&self->check_task))
+    iv_task_register(&self->check_task);
+}
+
+static void
+_fall_back_to_polling(PollFileInotify *self)
+{
+  msg_debug("poll-file-inotify: followed file was moved or deleted, falling back to polling",
+            evt_tag_str("follow_filename", self->super.follow_filename));
+  self->polling = TRUE;
+}
+
+static gboolean
+_is_file_deleted(PollFileInotify *self)
+{
+  struct stat st;
+
+  return fstat(self->super.fd, &st) == 0 && st.st_nlink == 0;
+}
+
+static void
+_handle_event(gpointer s, struct inotify_event *event)
+{
+  PollFileInotify *self = (PollFileInotify *) s;
+
+  /* the kernel has removed the watch and ivykis has already forgotten it,
+   * it must not be unregistered again */
+  if (event->mask & IN_IGNORED)
+    self->watch_registered = FALSE;
+
+  if ((event->mask & (IN_MOVE_SELF | IN_DELETE_SELF | IN_IGNORED)) ||
+      ((event->mask & IN_ATTRIB) && _is_file_deleted(self)))
+    _fall_back_to_polling(self);
+
+  /* while not armed, update_watches() checks the file anyway */
+  if (self->armed)
+    _schedule_check(self);
+}
+
+static void
+_check_file(gpointer s)
+{
+  PollFileInotify *self = (PollFileInotify *) s;
+
+  poll_file_changes_check_file(&self->super);
+}
+
+static void
+_stop_watches(PollEvents *s)
+{
+  PollFileInotify *self = (PollFileInotify *) s;
+
+  self->armed = FALSE;
+  if (iv_task_registered(&self->check_task))
+    iv_task_unregister(&self->check_task);
+  poll_file_changes_stop_watches(s);
+}
+
+static gboolean
+_is_at_eof(PollFileInotify *self)
+{
+  struct stat st;
+  off_t pos = lseek(self->super.fd, 0, SEEK_CUR);
+
+  return pos != (off_t) -1 && fstat(self->super.fd, &st) == 0 && pos >= st.st_size;
+}
+
+static void
+_update_watches(PollEvents *s, GIOCondition cond)
+{
+  PollFileInotify *self = (PollFileInotify *) s;
+
+  if (self->polling)
+    {
+      _stop_watches(s);
+      poll_file_changes_update_watches(s, cond);
+      return;
+    }
+
+  _stop_watches(s);
+
+  if (!_is_at_eof(self))
+    {
+      _schedule_check(self);
+      return;
+    }
+
+  msg_trace("End of file, waiting for inotify events",
+            evt_tag_str("follow_filename", self->super.follow_filename));
+  gboolean check_again = TRUE;
+  if (self->super.on_eof)
+    check_again = self->super.on_eof(&self->super);
+  log_pipe_notify(self->super.control, NC_FILE_EOF, self);
+
+  if (check_again)
+    self->armed = TRUE;
+}
+
+static void
+_free(PollEvents *s)
+{
+  PollFileInotify *self = (PollFileInotify *) s;
+
+  if (self->watch_registered)
+    iv_inotify_watch_unregister(&self->watch);
+  shared_inotify_unref(self->inotify);
+  poll_file_changes_free(s);
+}
+
+PollEvents *
+poll_file_inotify_new(gint fd, const gchar *follow_filename, gint follow_freq, LogPipe *control,
+                      SharedInotify *inotify)
+{
+  PollFileInotify *self = g_new0(PollFileInotify, 1);
+
+  poll_file_changes_init_instance(&self->super, fd, follow_filename, follow_freq, control);
+  self->super.super.stop_watches = _stop_watches;
+  self->super.super.update_watches = _update_watches;
+  self->super.super.free_fn = _free;
+  self->inotify = shared_inotify_ref(inotify);
+
+  IV_TASK_INIT(&self->check_task);
+  self->check_task.cookie = self;
+  self->check_task.handler = _check_file;
+
+  IV_INOTIFY_WATCH_INIT(&self->watch);
+  self->watch.inotify = &inotify->inotify;
+  self->watch.pathname = self->super.follow_filename;
+  self->watch.mask = IN_MODIFY | IN_ATTRIB | IN_MOVE_SELF | IN_DELETE_SELF;
+  self->watch.cookie = self;
+  self->watch.handler = _handle_event;
+
+  if (iv_inotify_watch_register(&self->watch) == 0)
+    {
+      self->watch_registered = TRUE;
+    }
+  else
+    {
+      msg_debug("poll-file-inotify: unable to watch file, falling back to polling",
+                evt_tag_str("follow_filename", follow_filename),
+                evt_tag_error("error"));
+      self->polling = TRUE;
+    }
+
+  return &self->super.super;
+}
+
+SharedInotify *
+shared_inotify_new(void)
+{
+  SharedInotify *self = g_new0(SharedInotify, 1);
+
+  g_atomic_counter_set(&self->ref_cnt, 1);
+  IV_INOTIFY_INIT(&self->inotify);
+  if (iv_inotify_register(&self->inotify) != 0)
+    {
+      msg_warning("poll-file-inotify: could not create inotify object, following files by polling",
+                  evt_tag_error("error"));
+      g_free(self);
+      return NULL;
+    }
+  return self;
+}
+
+SharedInotify *
+shared_inotify_ref(SharedInotify *self)
+{
+  if (self)
+    g_atomic_counter_inc(&self->ref_cnt);
+  return self;
+}
+
+void
+shared_inotify_unref(SharedInotify *self)
+{
+  if (self && g_atomic_counter_dec_and_test(&self->ref_cnt))
+    {
+      iv_inotify_unregister(&self->inotify);
+      g_free(self);
+    }
+}
+
+#else
+
+SharedInotify *
+shared_inotify_new(void)
+{
+  return NULL;
+}
+
+SharedInotify *
+shared_inotify_ref(SharedInotify *self)
+{
+  return self;
+}
+
+void
+shared_inotify_unref(SharedInotify *self)
+{
+}
+
+gboolean
+poll_file_inotify_is_reliable(gint fd)
+{
+  return FALSE;
+}
+
+PollEvents *
+poll_file_inotify_new(gint fd, const gchar *follow_filename, gint follow_freq, LogPipe *control,
+                      SharedInotify *inotify)
+{
+  g_assert_not_reached();
+}
+
+#endif
@@ -0,0 +1,38 @@
+/*
+ * Copyright (c) 2024 One Identity LLC.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+#ifndef POLL_FILE_INOTIFY_H_INCLUDED
+#define POLL_FILE_INOTIFY_H_INCLUDED
+
+#include "poll-file-changes.h"
+
+/* an inotify instance shared by the followed files of a source driver */
+typedef struct _SharedInotify SharedInotify;
+
+SharedInotify *shared_inotify_new(void);
+SharedInotify *shared_inotify_ref(SharedInotify *self);
+void shared_inotify_unref(SharedInotify *self);
+
+gboolean poll_file_inotify_is_reliable(gint fd);
+PollEvents *poll_file_inotify_new(gint fd, const gchar *follow_filename, gint follow_freq, LogPipe *control,
+                                  SharedInotify *inotify);
+
+#endif
@@ -22,6 +22,7 @@
  */
 #include "file-specializations.h"
 #include "transport/transport-file.h"
+#include "transport/transport-file-io-uring.h"
 #include "logproto-file-writer.h"
 #include "messages.h"
 #include "ack-tracker/ack_tracker_factory.h"
@@ -55,6 +56,7 @@ _construct_src_transport(FileOpener *self, gint fd)
   LogTransport *transport = log_transport_file_new(fd);
 
   transport->read = log_transport_file_read_and_ignore_eof_method;
+  log_transport_file_set_catch_up_threshold(transport, LOG_TRANSPORT_FILE_CATCH_UP_THRESHOLD);
   return transport;
 }
 
@@ -82,6 +84,8 @@ typedef struct _FileOpenerRegularDestFiles
   FileOpener super;
   const LogWriterOptions *writer_options;
   gboolean *use_fsync;
+  gint *fsync_max_delay;
+  const FileCompressionOptions *compression;
 } FileOpenerRegularDestFiles;
 
 static LogProtoClient *
@@ -89,19 +93,30 @@ _construct_dst_proto(FileOpener *s, LogTransport *transport, LogProtoClientOptio
 {
   FileOpenerRegularDestFiles *self = (FileOpenerRegularDestFiles *) s;
 
-  return log_proto_file_writer_new(transport, proto_options,
-                                   self->writer_options->flush_lines,
-                                   *self->use_fsync);
+  LogProtoClient *proto = log_proto_file_writer_new(transport, proto_options,
+                                                    self->writer_options->flush_lines,
+                                                    *self->use_fsync);
+
+  log_proto_file_writer_set_fsync_max_delay(proto, *self->fsync_max_delay);
+  log_proto_file_writer_set_compression(proto, self->compression);
+  return proto;
 }
 
 static LogTransport *
 _construct_transport(FileOpener *s, gint fd)
 {
+  if (s->options->io_uring)
+    {
+      LogTransport *transport = log_transport_file_io_uring_new(fd);
+      if (transport)
+        return transport;
+    }
   return log_transport_file_new(fd);
 }
 
 FileOpener *
-file_opener_for_regular_dest_files_new(const LogWriterOptions *writer_options, gboolean *use_fsync)
+file_opener_for_regular_dest_files_new(const LogWriterOptions *writer_options, gboolean *use_fsync,
+                                       gint *fsync_max_delay, const FileCompressionOptions *compression)
 {
   FileOpenerRegularDestFiles *self = g_new0(FileOpenerRegularDestFiles, 1);
 
@@ -110,5 +125,7 @@ file_opener_for_regular_dest_files_new(const LogWriterOptions *writer_options, g
   self->super.construct_dst_proto = _construct_dst_proto;
   self->writer_options = writer_options;
   self->use_fsync = use_fsync;
+  self->fsync_max_delay = fsync_max_delay;
+  self->compression = compression;
   return &self->super;
 }
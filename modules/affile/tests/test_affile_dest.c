@@ -0,0 +1,354 @@
+/*
+ * Copyright (c) 2024 One Identity LLC.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+#include <criterion/criterion.h>
+
+#include "mainloop-io-worker.h"
+
+/*
+ * async-open() jobs are not run by the I/O workers, they are started
+ * from the tests one by one, see _run_open_job().
+ */
+static gint submitted_open_jobs;
+
+static gboolean
+_mock_main_loop_io_worker_job_submit(MainLoopIOWorkerJob *job, gpointer arg)
+{
+  cr_assert_not(job->working, "the job is submitted while it is still working");
+
+  job->engage(job->user_data);
+  job->working = TRUE;
+  job->arg = arg;
+  submitted_open_jobs++;
+  return TRUE;
+}
+
+#define main_loop_io_worker_job_submit _mock_main_loop_io_worker_job_submit
+#include "affile-dest.c"
+#undef main_loop_io_worker_job_submit
+
+#include "apphook.h"
+#include "cfg.h"
+
+static GlobalConfig *cfg;
+static AFFileDestDriver *driver;
+
+static AFFileDestWriter *
+_create_writer(const gchar *filename)
+{
+  AFFileDestWriter *dw = affile_dw_new(filename, cfg);
+
+  dw->owner = (AFFileDestDriver *) log_pipe_ref(&driver->super.super.super);
+  return dw;
+}
+
+static gint
+_ref_cnt(AFFileDestWriter *dw)
+{
+  return g_atomic_counter_get(&dw->super.ref_cnt);
+}
+
+static gboolean
+_lookup_cached_writer(const gchar *filename)
+{
+  AFFileDestWriter *dw = affile_dd_lookup_cached_writer(driver, filename);
+
+  if (!dw)
+    return FALSE;
+
+  g_atomic_int_add(&dw->queue_pending, -1);
+  log_pipe_unref(&dw->super);
+  return TRUE;
+}
+
+Test(affile_dest, cached_writer_is_found_without_a_lookup)
+{
+  AFFileDestWriter *dw = _create_writer("/tmp/test_affile_dest.log");
+
+  cr_assert_not(_lookup_cached_writer("/tmp/test_affile_dest.log"));
+
+  affile_dd_cache_writer(dw);
+  cr_assert_eq(_ref_cnt(dw), 2, "the cache should hold a reference");
+  cr_assert(_lookup_cached_writer("/tmp/test_affile_dest.log"));
+  cr_assert_not(_lookup_cached_writer("/tmp/other.log"));
+
+  g_atomic_int_set(&dw->reaping, TRUE);
+  cr_assert_not(_lookup_cached_writer("/tmp/test_affile_dest.log"), "a writer being reaped should not be used");
+  cr_assert_eq(dw->queue_pending, 0);
+
+  affile_dd_release_cached_writer(NULL);
+  cr_assert_eq(_ref_cnt(dw), 1);
+  log_pipe_unref(&dw->super);
+}
+
+typedef struct _CachingThread
+{
+  AFFileDestWriter *dw;
+  GAsyncQueue *cached;
+  GAsyncQueue *invalidated;
+  gboolean found_after_invalidation;
+} CachingThread;
+
+static gpointer
+_caching_thread_func(gpointer user_data)
+{
+  CachingThread *thread = (CachingThread *) user_data;
+
+  affile_dd_cache_writer(thread->dw);
+  g_async_queue_push(thread->cached, GINT_TO_POINTER(TRUE));
+
+  g_async_queue_pop(thread->invalidated);
+  thread->found_after_invalidation = _lookup_cached_writer(thread->dw->filename);
+  return NULL;
+}
+
+Test(affile_dest, writers_cached_by_other_threads_are_released_after_a_deinit)
+{
+  CachingThread thread =
+  {
+    .dw = _create_writer("/tmp/test_affile_dest.log"),
+    .cached = g_async_queue_new(),
+    .invalidated = g_async_queue_new(),
+  };
+  GThread *t = g_thread_new(NULL, _caching_thread_func, &thread);
+
+  g_async_queue_pop(thread.cached);
+  cr_assert_eq(_ref_cnt(thread.dw), 2);
+
+  /* as done by affile_dd_deinit() in the main thread */
+  affile_dd_invalidate_cached_writers();
+  cr_assert_eq(_ref_cnt(thread.dw), 2, "the writer is released by the thread caching it");
+
+  g_async_queue_push(thread.invalidated, GINT_TO_POINTER(TRUE));
+  g_thread_join(t);
+
+  cr_assert_not(thread.found_after_invalidation);
+  cr_assert_eq(_ref_cnt(thread.dw), 1);
+
+  log_pipe_unref(&thread.dw->super);
+  g_async_queue_unref(thread.cached);
+  g_async_queue_unref(thread.invalidated);
+}
+
+Test(affile_dest, writer_is_cached_again_after_a_deinit)
+{
+  AFFileDestWriter *dw = _create_writer("/tmp/test_affile_dest.log");
+
+  affile_dd_cache_writer(dw);
+  affile_dd_invalidate_cached_writers();
+  cr_assert_null(last_writer);
+  cr_assert_eq(_ref_cnt(dw), 1);
+
+  affile_dd_cache_writer(dw);
+  cr_assert(_lookup_cached_writer("/tmp/test_affile_dest.log"));
+
+  affile_dd_release_cached_writer(NULL);
+  log_pipe_unref(&dw->super);
+}
+
+#define LRU_FILENAME(name) "/tmp/test_affile_dest-lru-" name ".log"
+
+static const gchar *lru_filenames[] = { LRU_FILENAME("a"), LRU_FILENAME("b"), LRU_FILENAME("c") };
+
+/* opens the writer of @filename as affile_dd_queue() would, without keeping it busy */
+static AFFileDestWriter *
+_open_writer(const gchar *filename)
+{
+  GString *name = g_string_new(filename);
+  gpointer args[] = { driver, name };
+  AFFileDestWriter *dw = (AFFileDestWriter *) affile_dd_open_writer(args);
+
+  cr_assert_not_null(dw, "opening the writer of %s failed", filename);
+  g_atomic_int_add(&dw->queue_pending, -1);
+  log_pipe_unref(&dw->super);
+  g_string_free(name, TRUE);
+  return dw;
+}
+
+static gboolean
+_writer_is_open(const gchar *filename)
+{
+  return g_hash_table_lookup(driver->writer_hash, filename) != NULL;
+}
+
+static void
+_init_driver(gint max_open_files, gboolean async_open)
+{
+  affile_dd_set_max_open_files(&driver->super.super, max_open_files);
+  affile_dd_set_async_open(&driver->super.super, async_open);
+  cr_assert(log_pipe_init(&driver->super.super.super));
+}
+
+static void
+_deinit_driver(void)
+{
+  cr_assert(log_pipe_deinit(&driver->super.super.super));
+  for (gint i = 0; i < G_N_ELEMENTS(lru_filenames); i++)
+    unlink(lru_filenames[i]);
+}
+
+Test(affile_dest, least_recently_used_writer_is_closed_over_max_open_files)
+{
+  _init_driver(2, FALSE);
+
+  _open_writer(LRU_FILENAME("a"));
+  _open_writer(LRU_FILENAME("b"));
+  cr_assert_eq(g_hash_table_size(driver->writer_hash), 2);
+
+  _open_writer(LRU_FILENAME("c"));
+  cr_assert_eq(g_hash_table_size(driver->writer_hash), 2);
+  cr_assert_eq(g_queue_get_length(&driver->lru_writers), 2);
+  cr_assert_not(_writer_is_open(LRU_FILENAME("a")));
+  cr_assert(_writer_is_open(LRU_FILENAME("b")));
+  cr_assert(_writer_is_open(LRU_FILENAME("c")));
+
+  _deinit_driver();
+}
+
+Test(affile_dest, recently_used_writer_gets_a_second_chance)
+{
+  _init_driver(2, FALSE);
+
+  AFFileDestWriter *a = _open_writer(LRU_FILENAME("a"));
+  _open_writer(LRU_FILENAME("b"));
+
+  /* a message is queued to the oldest writer */
+  cr_assert_eq(affile_dd_lookup_writer(driver, LRU_FILENAME("a")), a);
+  g_atomic_int_add(&a->queue_pending, -1);
+  log_pipe_unref(&a->super);
+
+  _open_writer(LRU_FILENAME("c"));
+  cr_assert(_writer_is_open(LRU_FILENAME("a")));
+  cr_assert_not(_writer_is_open(LRU_FILENAME("b")));
+  cr_assert_not(a->lru_referenced, "the second chance is used up");
+  cr_assert_eq(driver->lru_writers.head->data, a, "the writer is not moved to the head");
+
+  _deinit_driver();
+}
+
+Test(affile_dest, busy_writer_is_not_closed_over_max_open_files)
+{
+  _init_driver(1, FALSE);
+
+  AFFileDestWriter *a = _open_writer(LRU_FILENAME("a"));
+
+  /* a message is being queued to the writer, the limit is a soft one */
+  g_atomic_int_inc(&a->queue_pending);
+  _open_writer(LRU_FILENAME("b"));
+  cr_assert(_writer_is_open(LRU_FILENAME("a")));
+  cr_assert(_writer_is_open(LRU_FILENAME("b")));
+  cr_assert_not(a->reaping);
+
+  /* the idle writer is closed instead */
+  _open_writer(LRU_FILENAME("c"));
+  cr_assert(_writer_is_open(LRU_FILENAME("a")));
+  cr_assert_not(_writer_is_open(LRU_FILENAME("b")));
+  cr_assert(_writer_is_open(LRU_FILENAME("c")));
+
+  g_atomic_int_add(&a->queue_pending, -1);
+  _deinit_driver();
+}
+
+Test(affile_dest, writers_are_not_closed_without_max_open_files)
+{
+  _init_driver(0, FALSE);
+
+  for (gint i = 0; i < G_N_ELEMENTS(lru_filenames); i++)
+    _open_writer(lru_filenames[i]);
+  cr_assert_eq(g_hash_table_size(driver->writer_hash), 3);
+
+  _deinit_driver();
+}
+
+/* runs a submitted open job, just like an I/O worker and the main loop would */
+static void
+_run_open_job(AFFileDestWriter *dw)
+{
+  MainLoopIOWorkerJob *job = &dw->open_job;
+
+  cr_assert(job->working, "no open job is submitted");
+  job->work(job->user_data, job->arg);
+  job->working = FALSE;
+  job->completion(job->user_data, job->arg);
+  job->release(job->user_data);
+}
+
+Test(affile_dest, async_open_opens_the_file_in_a_job)
+{
+  _init_driver(0, TRUE);
+
+  AFFileDestWriter *dw = _open_writer(LRU_FILENAME("a"));
+  cr_assert_eq(submitted_open_jobs, 1);
+  cr_assert_not(log_writer_opened(dw->writer), "the file is opened in the main thread");
+  cr_assert_not(g_file_test(LRU_FILENAME("a"), G_FILE_TEST_EXISTS));
+  cr_assert_eq(dw->open_owner, driver, "the job does not hold its owner");
+
+  _run_open_job(dw);
+  cr_assert(g_file_test(LRU_FILENAME("a"), G_FILE_TEST_EXISTS));
+  cr_assert(log_writer_opened(dw->writer));
+  cr_assert_null(dw->open_owner);
+
+  _deinit_driver();
+}
+
+Test(affile_dest, async_open_drops_results_of_a_stale_open)
+{
+  _init_driver(0, TRUE);
+
+  AFFileDestWriter *dw = _open_writer(LRU_FILENAME("a"));
+
+  /* a reopen while the first open is still working */
+  cr_assert(affile_dw_reopen(dw));
+  cr_assert(dw->reopen_requested);
+  cr_assert_eq(submitted_open_jobs, 1);
+
+  _run_open_job(dw);
+  cr_assert_not(log_writer_opened(dw->writer), "the result of the stale open is used");
+  cr_assert_not(dw->reopen_requested);
+  cr_assert_eq(submitted_open_jobs, 2, "the open is not restarted");
+
+  _run_open_job(dw);
+  cr_assert(log_writer_opened(dw->writer));
+
+  _deinit_driver();
+}
+
+static void
+setup(void)
+{
+  app_startup();
+  submitted_open_jobs = 0;
+  cfg = cfg_new_snippet();
+
+  LogTemplate *filename = log_template_new(cfg, NULL);
+  cr_assert(log_template_compile(filename, "/tmp/test_affile_dest-$HOST.log", NULL));
+  driver = (AFFileDestDriver *) affile_dd_new(filename, cfg);
+}
+
+static void
+teardown(void)
+{
+  log_pipe_unref(&driver->super.super.super);
+  cfg_free(cfg);
+  app_shutdown();
+}
+
+TestSuite(affile_dest, .init = setup, .fini = teardown);
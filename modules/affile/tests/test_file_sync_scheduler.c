@@ -0,0 +1,124 @@
+/*
+ * Copyright (c) 2024 One Identity LLC.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+
+#include <criterion/criterion.h>
+
+#include "file-sync-scheduler.h"
+#include "apphook.h"
+
+#include <stdio.h>
+#include <unistd.h>
+#include <errno.h>
+
+#define NUM_WRITERS 16
+
+static gint
+_create_temp_file(void)
+{
+  gchar filename[] = "test_file_sync_scheduler.XXXXXX";
+  gint fd = g_mkstemp(filename);
+
+  cr_assert(fd >= 0);
+  unlink(filename);
+  return fd;
+}
+
+static gpointer
+_write_and_sync(gpointer user_data)
+{
+  gint fd = GPOINTER_TO_INT(user_data);
+
+  for (gint i = 0; i < 10; i++)
+    {
+      cr_assert_eq(write(fd, "message\n", 8), 8);
+      file_sync_scheduler_start_writeback(fd);
+      if (!file_sync_scheduler_sync(fd, 5))
+        return GINT_TO_POINTER(FALSE);
+    }
+  return GINT_TO_POINTER(TRUE);
+}
+
+Test(file_sync_scheduler, sync_of_a_single_file)
+{
+  gint fd = _create_temp_file();
+
+  cr_assert_eq(write(fd, "message\n", 8), 8);
+  cr_assert(file_sync_scheduler_sync(fd, 0));
+  cr_assert(file_sync_scheduler_sync(fd, 10));
+  close(fd);
+}
+
+Test(file_sync_scheduler, concurrent_writers_are_all_synced)
+{
+  GThread *threads[NUM_WRITERS];
+  gint fds[NUM_WRITERS];
+
+  for (gint i = 0; i < NUM_WRITERS; i++)
+    {
+      /* every second writer shares its file with the previous one */
+      fds[i] = (i % 2) ? fds[i - 1] : _create_temp_file();
+      threads[i] = g_thread_new(NULL, _write_and_sync, GINT_TO_POINTER(fds[i]));
+    }
+
+  for (gint i = 0; i < NUM_WRITERS; i++)
+    cr_assert(GPOINTER_TO_INT(g_thread_join(threads[i])), "writer %d failed to sync", i);
+
+  for (gint i = 0; i < NUM_WRITERS; i += 2)
+    close(fds[i]);
+}
+
+Test(file_sync_scheduler, failed_syncs_are_reported)
+{
+  gint fd = _create_temp_file();
+
+  close(fd);
+  errno = 0;
+  cr_assert_not(file_sync_scheduler_sync(fd, 0));
+  cr_assert_eq(errno, EBADF);
+}
+
+Test(file_sync_scheduler, files_are_synced_directly_after_deinit)
+{
+  gint fd = _create_temp_file();
+
+  file_sync_scheduler_global_deinit();
+  cr_assert_eq(write(fd, "message\n", 8), 8);
+  cr_assert(file_sync_scheduler_sync(fd, 1000));
+  close(fd);
+}
+
+static void
+setup(void)
+{
+  app_startup();
+  file_sync_scheduler_global_init();
+}
+
+static void
+teardown(void)
+{
+  file_sync_scheduler_global_deinit();
+  app_shutdown();
+}
+
+TestSuite(file_sync_scheduler, .init = setup, .fini = teardown);
@@ -27,8 +27,15 @@
 #include "logmsg/logmsg.h"
 #include "apphook.h"
 
+#include <errno.h>
+
+#ifdef SYSLOG_NG_HAVE_ZLIB
+#include <zlib.h>
+#endif
+
 
 static void _ack_callback(gint num_acked, gpointer user_data);
+static void _rewind_callback(gpointer user_data);
 
 /* helper variables used by all testcases below */
 
@@ -38,10 +45,12 @@ static LogTransport *transport;
 static LogProtoClientFlowControlFuncs flow_control_funcs =
 {
   .ack_callback = _ack_callback,
+  .rewind_callback = _rewind_callback,
 };
 static gchar output_buffer[8192];
 static LogProtoStatus status;
 static gint messages_acked = 0;
+static gint rewinds = 0;
 static gboolean consumed;
 static const gchar *payload = "PAYLOAD";
 static gssize count;
@@ -52,6 +61,12 @@ _ack_callback(gint num_acked, gpointer user_data)
   messages_acked += num_acked;
 }
 
+static void
+_rewind_callback(gpointer user_data)
+{
+  rewinds++;
+}
+
 Test(file_writer, write_single_message_and_flush_is_expected_to_dump_the_payload_to_the_output)
 {
   LogProtoClient *fw = log_proto_file_writer_new(transport, &options, 100, FALSE);
@@ -162,6 +177,163 @@ Test(file_writer, batches_of_messages_are_flushed_even_if_the_underlying_transpo
   log_proto_client_free(fw);
 }
 
+#ifdef SYSLOG_NG_HAVE_ZLIB
+
+static gsize
+_inflate_output(const gchar *compressed, gsize compressed_len, gchar *output, gsize output_size)
+{
+  z_stream stream = { 0 };
+
+  /* 15 + 32: automatic gzip header detection */
+  cr_assert_eq(inflateInit2(&stream, 15 + 32), Z_OK);
+  stream.next_in = (Bytef *) compressed;
+  stream.avail_in = compressed_len;
+  stream.next_out = (Bytef *) output;
+  stream.avail_out = output_size;
+
+  /* the member is not finished yet, but everything flushed must be decompressible */
+  gint rc = inflate(&stream, Z_SYNC_FLUSH);
+  cr_assert(rc == Z_OK || rc == Z_STREAM_END, "inflate() failed, rc=%d", rc);
+  cr_assert_eq(stream.avail_in, 0);
+
+  gsize output_len = stream.total_out;
+  inflateEnd(&stream);
+  return output_len;
+}
+
+static void
+_assert_compressed_payloads(gint message_count)
+{
+  gchar compressed[8192];
+  gchar decompressed[8192];
+
+  count = log_transport_mock_read_from_write_buffer((LogTransportMock *) transport, compressed, sizeof(compressed));
+  cr_assert_gt(count, 0);
+
+  gsize decompressed_len = _inflate_output(compressed, count, decompressed, sizeof(decompressed));
+  cr_assert_eq(decompressed_len, message_count * (strlen(payload) + 1));
+  for (gint i = 0; i < message_count; i++)
+    cr_assert_str_eq(decompressed + i * (strlen(payload) + 1), "PAYLOAD");
+}
+
+Test(file_writer, compressed_messages_are_acked_once_the_compressor_is_flushed)
+{
+  const gint BATCH_SIZE = 10;
+  const gint MESSAGE_COUNT = BATCH_SIZE * 3;
+  FileCompressionOptions compression = { .method = FILE_COMPRESSION_GZIP, .level = -1 };
+  LogProtoClient *fw = log_proto_file_writer_new(transport, &options, BATCH_SIZE, FALSE);
+
+  log_proto_file_writer_set_compression(fw, &compression);
+  log_proto_client_set_client_flow_control(fw, &flow_control_funcs);
+  for (gint i = 0; i < MESSAGE_COUNT; i++)
+    {
+      status = log_proto_client_post(fw, msg, (guchar *) g_strdup(payload), strlen(payload) + 1, &consumed);
+      cr_assert(status == LPS_SUCCESS);
+      cr_assert(consumed == TRUE);
+    }
+  /* the compressor holds these back until the end of the flush */
+  cr_assert_eq(messages_acked, 0);
+
+  status = log_proto_client_flush(fw);
+  cr_assert(status == LPS_SUCCESS);
+  cr_assert_eq(messages_acked, MESSAGE_COUNT);
+
+  _assert_compressed_payloads(MESSAGE_COUNT);
+  log_proto_client_free(fw);
+}
+
+Test(file_writer, compressed_output_is_written_completely_even_if_the_transport_accepts_a_few_bytes_per_write)
+{
+  const gint BATCH_SIZE = 10;
+  FileCompressionOptions compression = { .method = FILE_COMPRESSION_GZIP, .level = 9 };
+  LogProtoClient *fw = log_proto_file_writer_new(transport, &options, BATCH_SIZE, FALSE);
+
+  log_proto_file_writer_set_compression(fw, &compression);
+  log_transport_mock_set_write_chunk_limit((LogTransportMock *) transport, 2);
+  log_proto_client_set_client_flow_control(fw, &flow_control_funcs);
+  for (gint i = 0; i < BATCH_SIZE - 1; i++)
+    {
+      status = log_proto_client_post(fw, msg, (guchar *) g_strdup(payload), strlen(payload) + 1, &consumed);
+      cr_assert(status == LPS_SUCCESS, "status=%d", status);
+      cr_assert(consumed == TRUE);
+    }
+
+  /* the remaining compressed bytes are kept as a partial write, each flush pushes out a few more of them */
+  for (gint attempts = 0; messages_acked < BATCH_SIZE - 1 && attempts < 10000; attempts++)
+    {
+      status = log_proto_client_flush(fw);
+      cr_assert(status == LPS_SUCCESS || status == LPS_PARTIAL, "status=%d", status);
+    }
+  cr_assert_eq(messages_acked, BATCH_SIZE - 1);
+
+  _assert_compressed_payloads(BATCH_SIZE - 1);
+  log_proto_client_free(fw);
+}
+
+static gssize (*mock_writev)(LogTransport *self, struct iovec *iov, gint iov_count);
+static gboolean writes_fail;
+
+static gssize
+_failing_writev(LogTransport *s, struct iovec *iov, gint iov_count)
+{
+  if (writes_fail)
+    {
+      errno = EIO;
+      return -1;
+    }
+  return mock_writev(s, iov, iov_count);
+}
+
+static void
+_inject_write_errors(gboolean fail)
+{
+  if (!mock_writev)
+    {
+      mock_writev = transport->writev;
+      transport->writev = _failing_writev;
+    }
+  writes_fail = fail;
+}
+
+Test(file_writer, compressed_output_is_kept_pending_instead_of_rewinding_after_a_write_error)
+{
+  const gint BATCH_SIZE = 10;
+  FileCompressionOptions compression = { .method = FILE_COMPRESSION_GZIP, .level = -1 };
+  LogProtoClient *fw = log_proto_file_writer_new(transport, &options, BATCH_SIZE, FALSE);
+
+  log_proto_file_writer_set_compression(fw, &compression);
+  log_proto_client_set_client_flow_control(fw, &flow_control_funcs);
+  for (gint i = 0; i < BATCH_SIZE - 1; i++)
+    {
+      status = log_proto_client_post(fw, msg, (guchar *) g_strdup(payload), strlen(payload) + 1, &consumed);
+      cr_assert(status == LPS_SUCCESS);
+      cr_assert(consumed == TRUE);
+    }
+
+  /* some of the compressed bytes get written before the error */
+  log_transport_mock_set_write_chunk_limit((LogTransportMock *) transport, 4);
+  status = log_proto_client_flush(fw);
+  cr_assert(status == LPS_SUCCESS || status == LPS_PARTIAL, "status=%d", status);
+
+  _inject_write_errors(TRUE);
+  status = log_proto_client_flush(fw);
+  cr_assert_eq(status, LPS_ERROR);
+  cr_assert_eq(rewinds, 0, "the messages already consumed by the compressor should not be rewound");
+  cr_assert_eq(messages_acked, 0);
+
+  /* the writer resumes with the same LogProtoClient once the error suspend elapsed */
+  _inject_write_errors(FALSE);
+  log_transport_mock_set_write_chunk_limit((LogTransportMock *) transport, 0);
+  status = log_proto_client_flush(fw);
+  cr_assert_eq(status, LPS_SUCCESS);
+  cr_assert_eq(messages_acked, BATCH_SIZE - 1);
+
+  _assert_compressed_payloads(BATCH_SIZE - 1);
+  log_proto_client_free(fw);
+}
+
+#endif
+
 static void
 startup(void)
 {
@@ -0,0 +1,252 @@
+/*
+ * Copyright (c) 2024 One Identity LLC.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#include <criterion/criterion.h>
+
+/* the state of the watches is checked from the inside */
+#include "poll-file-inotify.c"
+#include "apphook.h"
+#include "cfg.h"
+
+#include <fcntl.h>
+
+#if SYSLOG_NG_HAVE_INOTIFY
+
+#define TEST_FILENAME "test_poll_file_inotify.log"
+
+static GlobalConfig *cfg;
+static LogPipe *control;
+static gint eof_notifications;
+static SharedInotify *inotify;
+static gint fd = -1;
+
+static void
+_count_eof_notifications(LogPipe *s, gint notify_code, gpointer user_data)
+{
+  if (notify_code == NC_FILE_EOF)
+    eof_notifications++;
+}
+
+static PollFileInotify *
+_follow_file(const gchar *content)
+{
+  cr_assert(g_file_set_contents(TEST_FILENAME, content, -1, NULL));
+  fd = open(TEST_FILENAME, O_RDONLY);
+  cr_assert_geq(fd, 0);
+
+  return (PollFileInotify *) poll_file_inotify_new(fd, TEST_FILENAME, 1000, control, inotify);
+}
+
+static void
+_send_event(PollFileInotify *self, guint32 mask)
+{
+  struct inotify_event event = { .wd = self->watch.wd, .mask = mask };
+
+  _handle_event(self, &event);
+}
+
+static void
+_read_to_the_end(void)
+{
+  cr_assert_neq(lseek(fd, 0, SEEK_END), (off_t) -1);
+}
+
+Test(poll_file_inotify, test_regular_files_are_reliable)
+{
+  PollFileInotify *self = _follow_file("");
+
+  cr_assert(poll_file_inotify_is_reliable(fd));
+  cr_assert_not(poll_file_inotify_is_reliable(-1));
+  poll_events_free(&self->super.super);
+}
+
+Test(poll_file_inotify, test_unread_data_is_checked_right_away)
+{
+  PollFileInotify *self = _follow_file("line\n");
+
+  cr_assert(self->watch_registered);
+  poll_events_update_watches(&self->super.super, G_IO_IN);
+
+  cr_assert(iv_task_registered(&self->check_task));
+  cr_assert_not(self->armed);
+  cr_assert_eq(eof_notifications, 0);
+  cr_assert_not(iv_timer_registered(&self->super.follow_timer), "a watched file is polled");
+
+  poll_events_stop_watches(&self->super.super);
+  cr_assert_not(iv_task_registered(&self->check_task));
+  poll_events_free(&self->super.super);
+}
+
+Test(poll_file_inotify, test_waiting_for_events_at_the_end_of_the_file)
+{
+  PollFileInotify *self = _follow_file("line\n");
+
+  _read_to_the_end();
+  poll_events_update_watches(&self->super.super, G_IO_IN);
+  cr_assert(self->armed);
+  cr_assert_not(iv_task_registered(&self->check_task));
+  cr_assert_not(iv_timer_registered(&self->super.follow_timer));
+  cr_assert_eq(eof_notifications, 1);
+
+  /* a write wakes the reader up, further events are not queued until it rearms */
+  _send_event(self, IN_MODIFY);
+  cr_assert(iv_task_registered(&self->check_task));
+  cr_assert_not(self->armed);
+
+  iv_task_unregister(&self->check_task);
+  _send_event(self, IN_MODIFY);
+  cr_assert_not(iv_task_registered(&self->check_task));
+  cr_assert_not(self->polling);
+
+  poll_events_free(&self->super.super);
+}
+
+Test(poll_file_inotify, test_moved_file_falls_back_to_polling)
+{
+  PollFileInotify *self = _follow_file("line\n");
+
+  _read_to_the_end();
+  poll_events_update_watches(&self->super.super, G_IO_IN);
+  _send_event(self, IN_MOVE_SELF);
+  cr_assert(self->polling);
+
+  /* the reader still gets a check to notice the rotation */
+  cr_assert(iv_task_registered(&self->check_task));
+
+  poll_events_update_watches(&self->super.super, G_IO_IN);
+  cr_assert(iv_timer_registered(&self->super.follow_timer));
+  cr_assert_not(iv_task_registered(&self->check_task));
+  cr_assert_not(self->armed);
+
+  poll_events_stop_watches(&self->super.super);
+  poll_events_free(&self->super.super);
+}
+
+Test(poll_file_inotify, test_deleted_file_falls_back_to_polling)
+{
+  PollFileInotify *self = _follow_file("line\n");
+
+  _read_to_the_end();
+  poll_events_update_watches(&self->super.super, G_IO_IN);
+
+  /* changing the attributes of a file that is still linked is not a deletion */
+  _send_event(self, IN_ATTRIB);
+  cr_assert_not(self->polling);
+
+  poll_events_update_watches(&self->super.super, G_IO_IN);
+  unlink(TEST_FILENAME);
+  _send_event(self, IN_ATTRIB);
+  cr_assert(self->polling);
+
+  poll_events_stop_watches(&self->super.super);
+  poll_events_free(&self->super.super);
+}
+
+/* delivers the events queued by the kernel, just like the main loop would */
+static void
+_process_inotify_events(void)
+{
+  inotify->inotify.fd.handler_in(inotify->inotify.fd.cookie);
+}
+
+Test(poll_file_inotify, test_removed_watch_is_not_unregistered_again)
+{
+  PollFileInotify *self = _follow_file("line\n");
+
+  _read_to_the_end();
+  poll_events_update_watches(&self->super.super, G_IO_IN);
+
+  /* the inode is only freed, and the watch removed, when the last fd is closed */
+  unlink(TEST_FILENAME);
+  close(fd);
+  fd = -1;
+  _process_inotify_events();
+
+  cr_assert(self->polling);
+  cr_assert_not(self->watch_registered, "the watch removed by the kernel is still considered registered");
+
+  poll_events_stop_watches(&self->super.super);
+  poll_events_free(&self->super.super);
+}
+
+Test(poll_file_inotify, test_unwatchable_file_is_polled)
+{
+  PollFileInotify *self = _follow_file("line\n");
+  poll_events_free(&self->super.super);
+
+  self = (PollFileInotify *) poll_file_inotify_new(fd, "test_poll_file_inotify_non_existent.log", 1000, control,
+                                                   inotify);
+  cr_assert_not(self->watch_registered);
+  cr_assert(self->polling);
+
+  _read_to_the_end();
+  poll_events_update_watches(&self->super.super, G_IO_IN);
+  cr_assert(iv_timer_registered(&self->super.follow_timer));
+  cr_assert_eq(eof_notifications, 1);
+
+  poll_events_stop_watches(&self->super.super);
+  poll_events_free(&self->super.super);
+}
+
+Test(poll_file_inotify, test_followed_files_keep_the_shared_inotify_alive)
+{
+  PollFileInotify *self = _follow_file("");
+
+  cr_assert_eq(self->inotify, inotify);
+  cr_assert_eq(g_atomic_counter_get(&inotify->ref_cnt), 2);
+
+  /* the watch is unregistered from the instance it was registered to */
+  shared_inotify_unref(inotify);
+  inotify = NULL;
+  cr_assert_eq(g_atomic_counter_get(&self->inotify->ref_cnt), 1);
+  poll_events_free(&self->super.super);
+}
+
+static void
+setup(void)
+{
+  app_startup();
+  cfg = cfg_new_snippet();
+  control = log_pipe_new(cfg);
+  control->notify = _count_eof_notifications;
+  eof_notifications = 0;
+  inotify = shared_inotify_new();
+  cr_assert_not_null(inotify);
+}
+
+static void
+teardown(void)
+{
+  shared_inotify_unref(inotify);
+  inotify = NULL;
+  if (fd >= 0)
+    close(fd);
+  fd = -1;
+  unlink(TEST_FILENAME);
+  log_pipe_unref(control);
+  cfg_free(cfg);
+  app_shutdown();
+}
+
+TestSuite(poll_file_inotify, .init = setup, .fini = teardown);
+
+#endif
@@ -0,0 +1,220 @@
+/*
+ * Copyright (c) 2024 One Identity LLC.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#include <criterion/criterion.h>
+
+#include "logreader.h"
+#include "file-reader.h"
+
+/*
+ * The turns granted by the scheduler are recorded instead of running them,
+ * a turn lasts until the test releases the reader.
+ */
+
+static GPtrArray *turns;
+static gint lag_updates;
+
+static void
+_mock_log_reader_run_turn(LogReader *reader)
+{
+  g_ptr_array_add(turns, reader);
+}
+
+static void
+_mock_file_reader_update_lag(FileReader *reader)
+{
+  lag_updates++;
+}
+
+#define log_reader_run_turn _mock_log_reader_run_turn
+#define file_reader_update_lag _mock_file_reader_update_lag
+#include "wildcard-source.c"
+#undef log_reader_run_turn
+#undef file_reader_update_lag
+
+#include "apphook.h"
+#include "cfg.h"
+
+#define NUM_READERS 3
+
+static GlobalConfig *cfg;
+static WildcardReaderScheduler scheduler;
+static LogReader *readers[NUM_READERS];
+
+static void
+_schedule(gint index)
+{
+  scheduler.super.schedule(&scheduler.super, readers[index]);
+}
+
+static void
+_release(gint index)
+{
+  scheduler.super.release(&scheduler.super, readers[index]);
+}
+
+/* runs the pending dispatch, just like the main loop would */
+static void
+_dispatch(void)
+{
+  if (!iv_task_registered(&scheduler.dispatch_task))
+    return;
+
+  iv_task_unregister(&scheduler.dispatch_task);
+  scheduler.dispatch_task.handler(scheduler.dispatch_task.cookie);
+}
+
+static void
+_assert_turns(const gint *expected, guint n)
+{
+  cr_assert_eq(turns->len, n, "unexpected number of turns: %u, expected: %u", turns->len, n);
+  for (guint i = 0; i < n; i++)
+    cr_assert_eq(g_ptr_array_index(turns, i), readers[expected[i]], "turn #%u was granted out of order", i);
+}
+
+Test(wildcard_reader_scheduler, test_turns_are_granted_in_the_order_they_were_asked_for)
+{
+  scheduler.max_running = 1;
+
+  _schedule(2);
+  _schedule(0);
+  _schedule(1);
+  cr_assert(iv_task_registered(&scheduler.dispatch_task), "scheduling does not wake up the dispatcher");
+
+  _dispatch();
+  _assert_turns((const gint[]) { 2 }, 1);
+
+  _release(2);
+  _dispatch();
+  _release(0);
+  _dispatch();
+  _assert_turns((const gint[]) { 2, 0, 1 }, 3);
+
+  _release(1);
+  cr_assert_not(iv_task_registered(&scheduler.dispatch_task), "nobody waits for a turn");
+  cr_assert_eq(lag_updates, 3);
+}
+
+Test(wildcard_reader_scheduler, test_the_number_of_concurrent_turns_is_limited)
+{
+  scheduler.max_running = 2;
+
+  for (gint i = 0; i < NUM_READERS; i++)
+    _schedule(i);
+  _dispatch();
+  _assert_turns((const gint[]) { 0, 1 }, 2);
+  cr_assert_eq(g_hash_table_size(scheduler.running), 2);
+
+  /* the last reader waits for one of the running turns to end */
+  _dispatch();
+  cr_assert_eq(turns->len, 2);
+
+  _release(1);
+  _dispatch();
+  _assert_turns((const gint[]) { 0, 1, 2 }, 3);
+
+  _release(0);
+  _release(2);
+}
+
+Test(wildcard_reader_scheduler, test_a_reader_asking_again_queues_at_the_tail)
+{
+  scheduler.max_running = 1;
+
+  _schedule(0);
+  _dispatch();
+  _schedule(1);
+
+  /* reached log-fetch-limit(), asks for another turn from the restart task */
+  _release(0);
+  _schedule(0);
+  _dispatch();
+  _release(1);
+  _dispatch();
+  _assert_turns((const gint[]) { 0, 1, 0 }, 3);
+
+  _release(0);
+}
+
+Test(wildcard_reader_scheduler, test_a_waiting_reader_is_queued_only_once)
+{
+  scheduler.max_running = 1;
+
+  _schedule(0);
+  _schedule(0);
+  cr_assert_eq(g_queue_get_length(&scheduler.waiting), 1);
+
+  _dispatch();
+  _release(0);
+  _dispatch();
+  _assert_turns((const gint[]) { 0 }, 1);
+}
+
+Test(wildcard_reader_scheduler, test_releasing_a_waiting_reader_drops_it_from_the_queue)
+{
+  scheduler.max_running = 1;
+
+  _schedule(0);
+  _schedule(1);
+  _schedule(2);
+
+  /* deinitialized while waiting for its turn */
+  _release(1);
+  cr_assert_eq(g_queue_get_length(&scheduler.waiting), 2);
+  cr_assert_eq(g_atomic_counter_get(&readers[1]->super.super.ref_cnt), 1, "the queue keeps the reader referenced");
+
+  _dispatch();
+  _release(0);
+  _dispatch();
+  _release(2);
+  _assert_turns((const gint[]) { 0, 2 }, 2);
+
+  /* the lag is only updated at the end of a turn */
+  cr_assert_eq(lag_updates, 2);
+}
+
+static void
+setup(void)
+{
+  app_startup();
+  cfg = cfg_new_snippet();
+
+  turns = g_ptr_array_new();
+  lag_updates = 0;
+  _scheduler_init_instance(&scheduler);
+  for (gint i = 0; i < NUM_READERS; i++)
+    readers[i] = log_reader_new(cfg);
+}
+
+static void
+teardown(void)
+{
+  _scheduler_stop(&scheduler);
+  _scheduler_destroy(&scheduler);
+  for (gint i = 0; i < NUM_READERS; i++)
+    log_pipe_unref(&readers[i]->super.super);
+  g_ptr_array_free(turns, TRUE);
+  cfg_free(cfg);
+  app_shutdown();
+}
+
+TestSuite(wildcard_reader_scheduler, .init = setup, .fini = teardown);
@@ -30,6 +30,10 @@
 #include "cfg-grammar.h"
 #include "plugin.h"
 #include "wildcard-source.h"
+#include "mainloop-worker.h"
+
+#include <fcntl.h>
+#include <unistd.h>
 
 
 static void
@@ -114,6 +118,81 @@ Test(wildcard_source, test_option_inheritance_padded)
   cr_assert_eq(file_reader_options_get_log_proto_options(&driver->file_reader_options)->pad_size, 5);
 }
 
+Test(wildcard_source, test_followed_files_share_an_inotify_instance)
+{
+  WildcardSourceDriver *driver = _create_wildcard_filesource("base-dir(/test_non_existent_dir)"
+                                                             "filename-pattern(*.log)");
+#if SYSLOG_NG_HAVE_INOTIFY
+  cr_assert_not_null(driver->inotify);
+#else
+  cr_assert_null(driver->inotify);
+#endif
+}
+
+Test(wildcard_source, test_monitor_method_poll_does_not_use_inotify)
+{
+  WildcardSourceDriver *driver = _create_wildcard_filesource("base-dir(/test_non_existent_dir)"
+                                                             "filename-pattern(*.log)"
+                                                             "monitor-method(poll)");
+  cr_assert_null(driver->inotify);
+}
+
+Test(wildcard_source, test_max_concurrent_readers)
+{
+  WildcardSourceDriver *driver = _create_wildcard_filesource("base-dir(/test_non_existent_dir)"
+                                                             "filename-pattern(*.log)"
+                                                             "max-concurrent-readers(3)");
+  cr_assert_eq(driver->max_concurrent_readers, 3);
+  cr_assert_eq(driver->scheduler.max_running, 3);
+}
+
+Test(wildcard_source, test_concurrent_readers_default_to_the_number_of_worker_threads)
+{
+  WildcardSourceDriver *driver = _create_wildcard_filesource("base-dir(/test_non_existent_dir)"
+                                                             "filename-pattern(*.log)");
+  cr_assert_eq(driver->max_concurrent_readers, 0);
+  cr_assert_eq(driver->scheduler.max_running, MAX(main_loop_worker_get_max_number_of_threads(), 1));
+}
+
+Test(wildcard_source, test_file_lag_is_the_unread_part_of_the_file)
+{
+  const gchar *filename = "test_wildcard_source_lag.log";
+  StatsCounterItem lag = { 0 };
+
+  cr_assert(g_file_set_contents(filename, "0123456789", -1, NULL));
+  gint fd = open(filename, O_RDONLY);
+  cr_assert_geq(fd, 0);
+
+  FileReader reader = { .fd = fd, .lag_bytes = &lag };
+  file_reader_update_lag(&reader);
+  cr_assert_eq(stats_counter_get(&lag), 10);
+
+  cr_assert_eq(lseek(fd, 4, SEEK_SET), 4);
+  file_reader_update_lag(&reader);
+  cr_assert_eq(stats_counter_get(&lag), 6);
+
+  cr_assert_eq(lseek(fd, 0, SEEK_END), 10);
+  file_reader_update_lag(&reader);
+  cr_assert_eq(stats_counter_get(&lag), 0);
+
+  /* the last value is kept while the file is not open */
+  cr_assert_eq(lseek(fd, 4, SEEK_SET), 4);
+  reader.fd = -1;
+  file_reader_update_lag(&reader);
+  cr_assert_eq(stats_counter_get(&lag), 0);
+
+  close(fd);
+  unlink(filename);
+}
+
+Test(wildcard_source, test_async_open)
+{
+  WildcardSourceDriver *driver = _create_wildcard_filesource("base-dir(/test_non_existent_dir)"
+                                                             "filename-pattern(*.log)"
+                                                             "async-open(yes)");
+  cr_assert(driver->file_reader_options.async_open);
+}
+
 Test(wildcard_source, test_option_duplication)
 {
   WildcardSourceDriver *driver = _create_wildcard_filesource("base-dir(/tmp)"
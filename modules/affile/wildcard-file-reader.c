@@ -101,6 +101,7 @@ _notify(LogPipe *s, gint notify_code, gpointer user_data)
       _set_deleted(self);
       break;
     case NC_FILE_EOF:
+      file_reader_update_lag(&self->super);
       _set_eof(self);
       break;
     default:
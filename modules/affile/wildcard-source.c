@@ -25,6 +25,7 @@
 #include "messages.h"
 #include "file-specializations.h"
 #include "mainloop.h"
+#include "mainloop-worker.h"
 
 #include <fcntl.h>
 
@@ -36,6 +37,98 @@ static DirectoryMonitor *_add_directory_monitor(WildcardSourceDriver *self, cons
 
 static void _create_file_reader(WildcardSourceDriver *self, const gchar *full_path);
 
+static void
+_scheduler_kick(WildcardReaderScheduler *self)
+{
+  if (!iv_task_registered(&self->dispatch_task))
+    iv_task_register(&self->dispatch_task);
+}
+
+static void
+_scheduler_dispatch(gpointer s)
+{
+  WildcardReaderScheduler *self = (WildcardReaderScheduler *) s;
+
+  /* turns of non-threaded readers run synchronously and are released
+   * before log_reader_run_turn() returns */
+  while (g_hash_table_size(self->running) < self->max_running && !g_queue_is_empty(&self->waiting))
+    {
+      LogReader *reader = g_queue_pop_head(&self->waiting);
+
+      g_hash_table_remove(self->waiting_links, reader);
+      g_hash_table_add(self->running, reader);
+      log_reader_run_turn(reader);
+      log_pipe_unref(&reader->super.super);
+    }
+}
+
+static void
+_scheduler_schedule(LogReaderScheduler *s, LogReader *reader)
+{
+  WildcardReaderScheduler *self = (WildcardReaderScheduler *) s;
+
+  if (g_hash_table_contains(self->waiting_links, reader))
+    return;
+
+  log_pipe_ref(&reader->super.super);
+  g_queue_push_tail(&self->waiting, reader);
+  g_hash_table_insert(self->waiting_links, reader, g_queue_peek_tail_link(&self->waiting));
+  _scheduler_kick(self);
+}
+
+static void
+_scheduler_release(LogReaderScheduler *s, LogReader *reader)
+{
+  WildcardReaderScheduler *self = (WildcardReaderScheduler *) s;
+  GList *link = g_hash_table_lookup(self->waiting_links, reader);
+
+  if (link)
+    {
+      g_queue_delete_link(&self->waiting, link);
+      g_hash_table_remove(self->waiting_links, reader);
+      log_pipe_unref(&reader->super.super);
+      return;
+    }
+
+  if (g_hash_table_remove(self->running, reader))
+    {
+      file_reader_update_lag((FileReader *) reader->control);
+      if (!g_queue_is_empty(&self->waiting))
+        _scheduler_kick(self);
+    }
+}
+
+static void
+_scheduler_init_instance(WildcardReaderScheduler *self)
+{
+  self->super.schedule = _scheduler_schedule;
+  self->super.release = _scheduler_release;
+  g_queue_init(&self->waiting);
+  self->waiting_links = g_hash_table_new(g_direct_hash, g_direct_equal);
+  self->running = g_hash_table_new(g_direct_hash, g_direct_equal);
+
+  IV_TASK_INIT(&self->dispatch_task);
+  self->dispatch_task.cookie = self;
+  self->dispatch_task.handler = _scheduler_dispatch;
+}
+
+static void
+_scheduler_stop(WildcardReaderScheduler *self)
+{
+  /* the readers are deinitialized by now, which released all of them */
+  g_assert(g_queue_is_empty(&self->waiting));
+
+  if (iv_task_registered(&self->dispatch_task))
+    iv_task_unregister(&self->dispatch_task);
+}
+
+static void
+_scheduler_destroy(WildcardReaderScheduler *self)
+{
+  g_hash_table_unref(self->waiting_links);
+  g_hash_table_unref(self->running);
+}
+
 static gboolean
 _check_required_options(WildcardSourceDriver *self)
 {
@@ -116,6 +209,8 @@ _create_file_reader(WildcardSourceDriver *self, const gchar *full_path)
                                     &self->super,
                                     cfg);
   log_pipe_set_options(&reader->super.super, &self->super.super.super.options);
+  file_reader_set_inotify(&reader->super, self->inotify);
+  file_reader_set_reader_scheduler(&reader->super, &self->scheduler.super);
 
   wildcard_file_reader_on_deleted_file_eof(reader, _remove_file_reader, self);
 
@@ -339,6 +434,11 @@ _init(LogPipe *s)
 
   _init_opener_options(self, cfg);
 
+  if (self->monitor_method != MM_POLL && !self->inotify)
+    self->inotify = shared_inotify_new();
+
+  self->scheduler.max_running = self->max_concurrent_readers ? : MAX(main_loop_worker_get_max_number_of_threads(), 1);
+
   if (!_add_directory_monitor(self, self->base_dir))
     return FALSE;
 
@@ -360,6 +460,9 @@ _deinit(LogPipe *s)
 
   g_pattern_spec_free(self->compiled_pattern);
   g_hash_table_foreach(self->file_readers, _deinit_reader, NULL);
+  _scheduler_stop(&self->scheduler);
+  shared_inotify_unref(self->inotify);
+  self->inotify = NULL;
   return TRUE;
 }
 
@@ -413,6 +516,14 @@ wildcard_sd_set_max_files(LogDriver *s, guint32 max_files)
   self->max_files = max_files;
 }
 
+void
+wildcard_sd_set_max_concurrent_readers(LogDriver *s, gint max_concurrent_readers)
+{
+  WildcardSourceDriver *self = (WildcardSourceDriver *)s;
+
+  self->max_concurrent_readers = max_concurrent_readers;
+}
+
 static void
 _free(LogPipe *s)
 {
@@ -423,6 +534,7 @@ _free(LogPipe *s)
   g_free(self->filename_pattern);
   g_hash_table_unref(self->file_readers);
   g_hash_table_unref(self->directory_monitors);
+  _scheduler_destroy(&self->scheduler);
   file_reader_options_deinit(&self->file_reader_options);
   file_opener_options_deinit(&self->file_opener_options);
   pending_file_list_free(self->waiting_list);
@@ -445,6 +557,7 @@ wildcard_sd_new(GlobalConfig *cfg)
                                                    (GDestroyNotify)directory_monitor_stop_and_destroy);
 
   self->monitor_method = MM_AUTO;
+  _scheduler_init_instance(&self->scheduler);
 
   file_reader_options_defaults(&self->file_reader_options);
   file_opener_options_defaults_dont_change_permissions(&self->file_opener_options);
@@ -29,8 +29,24 @@
 #include "directory-monitor.h"
 #include "directory-monitor-factory.h"
 
+#include <iv.h>
+
 #define DEFAULT_MAX_FILES 100
 
+/* Grants read turns to the file readers of a wildcard-file() source in the
+ * order they asked for one, so that a file growing quickly gets no more
+ * than a turn of log-fetch-limit() messages before the others get theirs. */
+typedef struct _WildcardReaderScheduler
+{
+  LogReaderScheduler super;
+  /* readers waiting for a turn, the one waiting the longest first */
+  GQueue waiting;
+  GHashTable *waiting_links;
+  GHashTable *running;
+  gint max_running;
+  struct iv_task dispatch_task;
+} WildcardReaderScheduler;
+
 typedef struct _WildcardSourceDriver
 {
   LogSrcDriver super;
@@ -38,6 +54,7 @@ typedef struct _WildcardSourceDriver
   gchar *filename_pattern;
   MonitorMethod monitor_method;
   guint32 max_files;
+  gint max_concurrent_readers;
 
   gboolean window_size_initialized;
   gboolean recursive;
@@ -49,6 +66,9 @@ typedef struct _WildcardSourceDriver
   GHashTable *file_readers;
   GHashTable *directory_monitors;
   FileOpener *file_opener;
+  /* shared by the file readers, NULL if files are followed by polling */
+  SharedInotify *inotify;
+  WildcardReaderScheduler scheduler;
 
   PendingFileList *waiting_list;
 } WildcardSourceDriver;
@@ -60,6 +80,7 @@ void wildcard_sd_set_filename_pattern(LogDriver *s, const gchar *filename_patter
 void wildcard_sd_set_recursive(LogDriver *s, gboolean recursive);
 gboolean wildcard_sd_set_monitor_method(LogDriver *s, const gchar *method);
 void wildcard_sd_set_max_files(LogDriver *s, guint32 max_files);
+void wildcard_sd_set_max_concurrent_readers(LogDriver *s, gint max_concurrent_readers);
 
 gboolean affile_is_legacy_wildcard_source(const gchar *filename);
 LogDriver *wildcard_sd_legacy_new(const gchar *filename, GlobalConfig *cfg);
@@ -30,8 +30,20 @@
 #include "value-pairs/value-pairs.h"
 #include "scanner/list-scanner/list-scanner.h"
 
+/* the collection handles are dropped once this many templated collections were used */
+#define MONGODB_MAX_CACHED_COLLECTIONS 256
+
 static LogThreadedResult _do_bulk_flush(MongoDBDestWorker *self);
 
+static void
+_collection_free(MongoDBDestCollection *self)
+{
+  if (self->bulk_op)
+    mongoc_bulk_operation_destroy(self->bulk_op);
+  mongoc_collection_destroy(self->coll_obj);
+  g_free(self);
+}
+
 static void
 _compose_bulk_op_options(MongoDBDestWorker *self)
 {
@@ -90,17 +102,8 @@ _worker_disconnect(LogThreadedDestWorker *s)
   MongoDBDestWorker *self = (MongoDBDestWorker *)s;
   MongoDBDestDriver *owner = (MongoDBDestDriver *) self->super.owner;
 
-  if (self->bulk_op)
-    {
-      mongoc_bulk_operation_destroy(self->bulk_op);
-      self->bulk_op = NULL;
-    }
-
-  if (self->coll_obj)
-    {
-      mongoc_collection_destroy(self->coll_obj);
-      self->coll_obj = NULL;
-    }
+  g_hash_table_remove_all(self->collections);
+  self->current_collection = NULL;
 
   if (self->client)
     {
@@ -109,17 +112,20 @@ _worker_disconnect(LogThreadedDestWorker *s)
     }
 }
 
-static const gchar *
-_format_collection_template(MongoDBDestWorker *self, LogMessage *msg)
+static void
+_format_collection_template(MongoDBDestWorker *self, LogMessage *msg, GString *collection)
 {
   MongoDBDestDriver *owner = (MongoDBDestDriver *) self->super.owner;
 
   LogTemplateEvalOptions options = { &owner->template_options, LTZ_SEND, self->super.seq_num, NULL, LM_VT_STRING };
-  log_template_format(owner->collection_template, msg, &options, self->collection);
-
-  return self->collection->str;
+  log_template_format(owner->collection_template, msg, &options, collection);
 }
 
+/*
+ * Collection handles are cached, and each of them carries its own bulk
+ * operation, so messages of interleaving collections do not cut the
+ * batch into small bulks.
+ */
 static gboolean
 _switch_collection(MongoDBDestWorker *self, const gchar *collection)
 {
@@ -128,15 +134,24 @@ _switch_collection(MongoDBDestWorker *self, const gchar *collection)
   if (!self->client)
     return FALSE;
 
-  if (self->bulk_op && _do_bulk_flush(self) != LTR_SUCCESS)
-    return FALSE;
+  MongoDBDestCollection *entry = g_hash_table_lookup(self->collections, collection);
+  if (entry)
+    {
+      self->current_collection = entry;
+      return TRUE;
+    }
 
-  if (self->coll_obj)
-    mongoc_collection_destroy(self->coll_obj);
+  if (g_hash_table_size(self->collections) >= MONGODB_MAX_CACHED_COLLECTIONS)
+    {
+      if (_do_bulk_flush(self) != LTR_SUCCESS)
+        return FALSE;
+      g_hash_table_remove_all(self->collections);
+      self->current_collection = NULL;
+    }
 
-  self->coll_obj = mongoc_client_get_collection(self->client, owner->const_db, collection);
+  mongoc_collection_t *coll_obj = mongoc_client_get_collection(self->client, owner->const_db, collection);
 
-  if (!self->coll_obj)
+  if (!coll_obj)
     {
       msg_error("Error getting specified MongoDB collection",
                 evt_tag_str("collection", collection),
@@ -145,6 +160,11 @@ _switch_collection(MongoDBDestWorker *self, const gchar *collection)
       return FALSE;
     }
 
+  entry = g_new0(MongoDBDestCollection, 1);
+  entry->coll_obj = coll_obj;
+  g_hash_table_insert(self->collections, g_strdup(collection), entry);
+  self->current_collection = entry;
+
   msg_debug("Switching MongoDB collection", evt_tag_str("new_collection", collection));
   return TRUE;
 }
@@ -196,7 +216,7 @@ _worker_connect(LogThreadedDestWorker *s)
 
   const mongoc_read_prefs_t *read_prefs = NULL;
 
-  if (owner->collection_is_literal_string && !self->coll_obj)
+  if (owner->collection_is_literal_string && !self->current_collection)
     {
       const gchar *collection = log_template_get_literal_value(owner->collection_template, NULL);
 
@@ -209,7 +229,7 @@ _worker_connect(LogThreadedDestWorker *s)
 
       g_string_assign(self->collection, collection);
 
-      read_prefs = mongoc_collection_get_read_prefs(self->coll_obj);
+      read_prefs = mongoc_collection_get_read_prefs(self->current_collection->coll_obj);
     }
 
   if (!_check_server_status(self, read_prefs))
@@ -224,17 +244,35 @@ _worker_connect(LogThreadedDestWorker *s)
 /*
  * Worker thread
  */
+static bson_t *
+_acquire_child_document(MongoDBDestWorker *self)
+{
+  if (self->bson_depth == self->bson_children->len)
+    g_ptr_array_add(self->bson_children, g_new0(bson_t, 1));
+
+  return g_ptr_array_index(self->bson_children, self->bson_depth++);
+}
+
+/* value_pairs_walk() nests the objects strictly, so they can be built in place in their parent */
 static gboolean
 _vp_obj_start(const gchar *name,
               const gchar *prefix, gpointer *prefix_data,
               const gchar *prev, gpointer *prev_data,
               gpointer user_data)
 {
-  bson_t *o;
+  MongoDBDestWorker *self = (MongoDBDestWorker *) user_data;
+  bson_t *root;
+
+  if (prev_data)
+    root = (bson_t *)*prev_data;
+  else
+    root = self->bson;
 
   if (prefix_data)
     {
-      o = bson_new();
+      bson_t *o = _acquire_child_document(self);
+
+      bson_append_document_begin(root, name, -1, o);
       *prefix_data = o;
     }
   return FALSE;
@@ -258,8 +296,8 @@ _vp_obj_end(const gchar *name,
     {
       bson_t *d = (bson_t *)*prefix_data;
 
-      bson_append_document(root, name, -1, d);
-      bson_destroy(d);
+      bson_append_document_end(root, d);
+      self->bson_depth--;
     }
   return FALSE;
 }
@@ -427,28 +465,39 @@ _do_bulk_flush(MongoDBDestWorker *self)
   /* Take care, _worker_batch_flush -> _do_bulk_flush is called at thread shutdown as well
      at that time not neccessarily we have an inprogress bulk operation
   */
-  if (self->bulk_op)
+  LogThreadedResult result = LTR_SUCCESS;
+  GHashTableIter iter;
+  gpointer key, value;
+
+  g_hash_table_iter_init(&iter, self->collections);
+  while (g_hash_table_iter_next(&iter, &key, &value))
     {
+      MongoDBDestCollection *collection = (MongoDBDestCollection *) value;
+
+      if (!collection->bulk_op)
+        continue;
+
       bson_error_t error;
       bson_t reply;
 
-      int result = mongoc_bulk_operation_execute(self->bulk_op, &reply, &error);
+      int success = mongoc_bulk_operation_execute(collection->bulk_op, &reply, &error);
 
       bson_destroy (&reply);
-      mongoc_bulk_operation_destroy(self->bulk_op);
-      self->bulk_op = NULL;
+      mongoc_bulk_operation_destroy(collection->bulk_op);
+      collection->bulk_op = NULL;
 
-      if (result == 0)
+      if (success == 0)
         {
           MongoDBDestDriver *owner = (MongoDBDestDriver *) self->super.owner;
           msg_error("Error while bulk inserting into MongoDB",
                     evt_tag_int("time_reopen", self->super.time_reopen),
+                    evt_tag_str("collection", (const gchar *) key),
                     evt_tag_str("reason", error.message),
                     evt_tag_str("driver", owner->super.super.super.id));
-          return LTR_ERROR;
+          result = LTR_ERROR;
         }
     }
-  return LTR_SUCCESS;
+  return result;
 }
 
 static LogThreadedResult
@@ -462,19 +511,23 @@ static LogThreadedResult
 _bulk_insert(MongoDBDestWorker *self)
 {
   MongoDBDestDriver *owner = (MongoDBDestDriver *) self->super.owner;
+  MongoDBDestCollection *collection = self->current_collection;
 
-  if (self->bulk_op == NULL)
-    self->bulk_op = mongoc_collection_create_bulk_operation_with_opts(self->coll_obj, self->bson_opts);
-  if (self->bulk_op == NULL)
+  if (collection->bulk_op == NULL)
     {
-      msg_error("Failed to create MongoDB bulk operation",
-                evt_tag_int("time_reopen", self->super.time_reopen),
-                evt_tag_str("driver", owner->super.super.super.id));
-      return LTR_ERROR;
+      collection->bulk_op = mongoc_collection_create_bulk_operation_with_opts(collection->coll_obj, self->bson_opts);
+      if (collection->bulk_op == NULL)
+        {
+          msg_error("Failed to create MongoDB bulk operation",
+                    evt_tag_int("time_reopen", self->super.time_reopen),
+                    evt_tag_str("driver", owner->super.super.super.id));
+          return LTR_ERROR;
+        }
+
+      mongoc_bulk_operation_set_bypass_document_validation(collection->bulk_op, owner->bulk_bypass_validation);
     }
 
-  mongoc_bulk_operation_set_bypass_document_validation(self->bulk_op, owner->bulk_bypass_validation);
-  mongoc_bulk_operation_insert(self->bulk_op, (const bson_t *)self->bson);
+  mongoc_bulk_operation_insert(collection->bulk_op, (const bson_t *)self->bson);
   return LTR_QUEUED;
 }
 
@@ -484,7 +537,7 @@ _single_insert(MongoDBDestWorker *self)
   MongoDBDestDriver *owner = (MongoDBDestDriver *) self->super.owner;
 
   bson_error_t error;
-  bool success = mongoc_collection_insert(self->coll_obj, MONGOC_INSERT_NONE,
+  bool success = mongoc_collection_insert(self->current_collection->coll_obj, MONGOC_INSERT_NONE,
                                           (const bson_t *)self->bson, self->write_concern, &error);
   if (!success)
     {
@@ -520,6 +573,7 @@ _worker_insert(LogThreadedDestWorker *s, LogMessage *msg)
   gboolean drop_silently = owner->template_options.on_error & ON_ERROR_SILENT;
 
   bson_reinit(self->bson);
+  self->bson_depth = 0;
 
   LogTemplateEvalOptions options = {&owner->template_options, LTZ_SEND, self->super.seq_num, NULL, LM_VT_STRING};
   success = value_pairs_walk(owner->vp,
@@ -547,13 +601,19 @@ _worker_insert(LogThreadedDestWorker *s, LogMessage *msg)
   if (!owner->collection_is_literal_string)
     {
       ScratchBuffersMarker mark;
-      GString *last_collection = scratch_buffers_alloc_and_mark(&mark);
-      g_string_assign(last_collection, self->collection->str);
-      const gchar *new_collection = _format_collection_template(self, msg);
-      bool should_switch_collection = (strcmp(last_collection->str, new_collection) != 0);
+      GString *new_collection = scratch_buffers_alloc_and_mark(&mark);
+      gboolean success = TRUE;
+
+      _format_collection_template(self, msg, new_collection);
+      if (!self->current_collection || strcmp(self->collection->str, new_collection->str) != 0)
+        {
+          success = _switch_collection(self, new_collection->str);
+          if (success)
+            g_string_assign(self->collection, new_collection->str);
+        }
       scratch_buffers_reclaim_marked(mark);
 
-      if (should_switch_collection && !_switch_collection(self, new_collection))
+      if (!success)
         return LTR_ERROR;
     }
 
@@ -569,7 +629,9 @@ _worker_init(LogThreadedDestWorker *s)
   MongoDBDestWorker *self = (MongoDBDestWorker *) s;
 
   self->collection = g_string_sized_new(64);
+  self->collections = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, (GDestroyNotify) _collection_free);
   self->bson = bson_sized_new(4096);
+  self->bson_children = g_ptr_array_new_with_free_func(g_free);
   /* NOTE: write concern can be used by _compose_bulk_op_options too, keep the order! */
   _compose_write_concern(self);
   _compose_bulk_op_options(self);
@@ -588,6 +650,11 @@ _worker_deinit(LogThreadedDestWorker *s)
   if (self->bson)
     bson_destroy(self->bson);
   self->bson = NULL;
+  g_ptr_array_free(self->bson_children, TRUE);
+  self->bson_children = NULL;
+
+  g_hash_table_destroy(self->collections);
+  self->collections = NULL;
 
   g_string_free(self->collection, TRUE);
   self->collection = NULL;
@@ -29,6 +29,13 @@
 #include "mongoc.h"
 #include "logthrdest/logthrdestdrv.h"
 
+/* a collection handle and the bulk operation of the current batch on it */
+typedef struct _MongoDBDestCollection
+{
+  mongoc_collection_t *coll_obj;
+  mongoc_bulk_operation_t *bulk_op;
+} MongoDBDestCollection;
+
 typedef struct MongoDBDestWorker
 {
   LogThreadedDestWorker super;
@@ -36,12 +43,16 @@ typedef struct MongoDBDestWorker
   mongoc_client_t *client;
 
   GString *collection;
-  mongoc_collection_t *coll_obj;
-  mongoc_bulk_operation_t *bulk_op;
+  /* collection name -> MongoDBDestCollection, kept while connected */
+  GHashTable *collections;
+  MongoDBDestCollection *current_collection;
   mongoc_write_concern_t *write_concern;
 
   bson_t *bson;
   bson_t *bson_opts;
+  /* storage of the embedded documents, built in place and reused by every message */
+  GPtrArray *bson_children;
+  gint bson_depth;
 } MongoDBDestWorker;
 
 LogThreadedDestWorker *afmongodb_dw_new(LogThreadedDestDriver *owner, gint worker_index);
@@ -0,0 +1,449 @@
+/*
+ * Copyright (c) 2024 One Identity LLC.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#include <criterion/criterion.h>
+#include "libtest/cr_template.h"
+#include "libtest/grab-logging.h"
+
+#include "mongoc.h"
+#include <string.h>
+
+/*
+ * No server is involved: the collection and bulk operation calls of the
+ * worker are replaced with the mocks below, which record the documents
+ * of every bulk operation.  The bulk operations of FAILING_COLLECTION fail.
+ */
+
+#define FAILING_COLLECTION "poison"
+
+typedef struct _FakeCollection
+{
+  gchar *name;
+} FakeCollection;
+
+typedef struct _FakeBulk
+{
+  gchar *collection;
+  GPtrArray *documents;
+  gboolean executed;
+  gboolean destroyed;
+} FakeBulk;
+
+static GPtrArray *bulks;
+static gint fetched_collections;
+
+static void
+_fake_bulk_free(FakeBulk *self)
+{
+  g_free(self->collection);
+  g_ptr_array_free(self->documents, TRUE);
+  g_free(self);
+}
+
+static mongoc_collection_t *
+_mock_mongoc_client_get_collection(mongoc_client_t *client, const char *db, const char *collection)
+{
+  FakeCollection *self = g_new0(FakeCollection, 1);
+
+  self->name = g_strdup(collection);
+  fetched_collections++;
+  return (mongoc_collection_t *) self;
+}
+
+static void
+_mock_mongoc_collection_destroy(mongoc_collection_t *collection)
+{
+  FakeCollection *self = (FakeCollection *) collection;
+
+  g_free(self->name);
+  g_free(self);
+}
+
+static mongoc_bulk_operation_t *
+_mock_mongoc_collection_create_bulk_operation_with_opts(mongoc_collection_t *collection, const bson_t *opts)
+{
+  FakeBulk *self = g_new0(FakeBulk, 1);
+
+  self->collection = g_strdup(((FakeCollection *) collection)->name);
+  self->documents = g_ptr_array_new_with_free_func((GDestroyNotify) bson_destroy);
+  g_ptr_array_add(bulks, self);
+  return (mongoc_bulk_operation_t *) self;
+}
+
+static void
+_mock_mongoc_bulk_operation_set_bypass_document_validation(mongoc_bulk_operation_t *bulk, bool bypass)
+{
+}
+
+static void
+_mock_mongoc_bulk_operation_insert(mongoc_bulk_operation_t *bulk, const bson_t *document)
+{
+  FakeBulk *self = (FakeBulk *) bulk;
+
+  cr_assert_not(self->executed, "document inserted into an already executed bulk operation");
+  g_ptr_array_add(self->documents, bson_copy(document));
+}
+
+static uint32_t
+_mock_mongoc_bulk_operation_execute(mongoc_bulk_operation_t *bulk, bson_t *reply, bson_error_t *error)
+{
+  FakeBulk *self = (FakeBulk *) bulk;
+
+  cr_assert_not(self->executed, "bulk operation executed twice");
+  self->executed = TRUE;
+  bson_init(reply);
+
+  if (strcmp(self->collection, FAILING_COLLECTION) == 0)
+    {
+      memset(error, 0, sizeof(*error));
+      g_strlcpy(error->message, "mock error", sizeof(error->message));
+      return 0;
+    }
+  return 1;
+}
+
+static void
+_mock_mongoc_bulk_operation_destroy(mongoc_bulk_operation_t *bulk)
+{
+  FakeBulk *self = (FakeBulk *) bulk;
+
+  /* kept until the end of the test, so the documents can be checked */
+  self->destroyed = TRUE;
+}
+
+#define mongoc_client_get_collection _mock_mongoc_client_get_collection
+#define mongoc_collection_destroy _mock_mongoc_collection_destroy
+#define mongoc_collection_create_bulk_operation_with_opts _mock_mongoc_collection_create_bulk_operation_with_opts
+#define mongoc_bulk_operation_set_bypass_document_validation _mock_mongoc_bulk_operation_set_bypass_document_validation
+#define mongoc_bulk_operation_insert _mock_mongoc_bulk_operation_insert
+#define mongoc_bulk_operation_execute _mock_mongoc_bulk_operation_execute
+#define mongoc_bulk_operation_destroy _mock_mongoc_bulk_operation_destroy
+#include "afmongodb-worker.c"
+#undef mongoc_client_get_collection
+#undef mongoc_collection_destroy
+#undef mongoc_collection_create_bulk_operation_with_opts
+#undef mongoc_bulk_operation_set_bypass_document_validation
+#undef mongoc_bulk_operation_insert
+#undef mongoc_bulk_operation_execute
+#undef mongoc_bulk_operation_destroy
+
+#include "apphook.h"
+
+static MongoDBDestDriver *driver;
+static MongoDBDestWorker *worker;
+
+static const gchar *
+_format_stats_key(LogThreadedDestDriver *d, StatsClusterKeyBuilder *kb)
+{
+  if (kb)
+    stats_cluster_key_builder_add_legacy_label(kb, stats_cluster_label("driver", "mongodb"));
+  return "mongodb,test";
+}
+
+static void
+_free_driver(LogPipe *s)
+{
+  MongoDBDestDriver *self = (MongoDBDestDriver *) s;
+
+  log_template_options_destroy(&self->template_options);
+  log_template_unref(self->collection_template);
+  value_pairs_unref(self->vp);
+  log_threaded_dest_driver_free(s);
+}
+
+/* the fields of the driver the worker relies on, as afmongodb_dd_new() and its init() would set them */
+static MongoDBDestDriver *
+_create_driver(ValuePairs *vp)
+{
+  MongoDBDestDriver *self = g_new0(MongoDBDestDriver, 1);
+
+  log_threaded_dest_driver_init_instance(&self->super, configuration);
+  self->super.super.super.super.free_fn = _free_driver;
+  self->super.format_stats_key = _format_stats_key;
+
+  self->collection_template = compile_template("$COLL");
+  self->collection_is_literal_string = FALSE;
+  log_template_options_defaults(&self->template_options);
+  log_template_options_init(&self->template_options, configuration);
+  self->vp = vp;
+
+  self->use_bulk = TRUE;
+  self->write_concern_level = MONGOC_WRITE_CONCERN_W_DEFAULT;
+  self->const_db = "syslog";
+  return self;
+}
+
+static ValuePairs *
+_create_value_pairs(void)
+{
+  ValuePairs *vp = value_pairs_new(configuration);
+
+  value_pairs_add_pair(vp, "seq", compile_template("$SEQ"));
+  return vp;
+}
+
+static MongoDBDestWorker *
+_create_worker(MongoDBDestDriver *owner)
+{
+  MongoDBDestWorker *self = (MongoDBDestWorker *) afmongodb_dw_new(&owner->super, 0);
+
+  cr_assert(log_threaded_dest_worker_init(&self->super));
+
+  /* never dereferenced, the calls using it are mocked */
+  self->client = (mongoc_client_t *) GINT_TO_POINTER(1);
+  return self;
+}
+
+static void
+_setup_worker(ValuePairs *vp)
+{
+  driver = _create_driver(vp);
+  worker = _create_worker(driver);
+}
+
+static LogThreadedResult
+_insert(const gchar *collection, gint seq)
+{
+  LogMessage *msg = create_empty_message();
+  gchar seq_str[16];
+
+  g_snprintf(seq_str, sizeof(seq_str), "%d", seq);
+  log_msg_set_value_by_name(msg, "COLL", collection, -1);
+  log_msg_set_value_by_name(msg, "SEQ", seq_str, -1);
+
+  LogThreadedResult result = log_threaded_dest_worker_insert(&worker->super, msg);
+  log_msg_unref(msg);
+  return result;
+}
+
+static LogThreadedResult
+_flush(void)
+{
+  return log_threaded_dest_worker_flush(&worker->super, LTF_FLUSH_NORMAL);
+}
+
+static const gchar *
+_document_string(const bson_t *document, const gchar *dotkey)
+{
+  bson_iter_t iter, child;
+
+  cr_assert(bson_iter_init(&iter, document));
+  cr_assert(bson_iter_find_descendant(&iter, dotkey, &child), "missing key in document; key=%s", dotkey);
+  cr_assert(BSON_ITER_HOLDS_UTF8(&child), "key is not a string; key=%s", dotkey);
+  return bson_iter_utf8(&child, NULL);
+}
+
+static gint
+_count_executed_bulks(void)
+{
+  gint count = 0;
+
+  for (guint i = 0; i < bulks->len; i++)
+    {
+      FakeBulk *bulk = g_ptr_array_index(bulks, i);
+
+      if (bulk->executed)
+        count++;
+    }
+  return count;
+}
+
+static FakeBulk *
+_find_bulk(const gchar *collection, gint nth)
+{
+  for (guint i = 0; i < bulks->len; i++)
+    {
+      FakeBulk *bulk = g_ptr_array_index(bulks, i);
+
+      if (strcmp(bulk->collection, collection) == 0 && nth-- == 0)
+        return bulk;
+    }
+  cr_assert_fail("no such bulk operation; collection=%s", collection);
+  return NULL;
+}
+
+static void
+_assert_bulk_sequence(FakeBulk *bulk, const gchar *expected)
+{
+  GString *sequence = g_string_new("");
+
+  for (guint i = 0; i < bulk->documents->len; i++)
+    {
+      if (i > 0)
+        g_string_append_c(sequence, ',');
+      g_string_append(sequence, _document_string(g_ptr_array_index(bulk->documents, i), "seq"));
+    }
+
+  cr_assert_str_eq(sequence->str, expected, "unexpected documents in the bulk of %s", bulk->collection);
+  g_string_free(sequence, TRUE);
+}
+
+Test(mongodb_worker, test_interleaving_collections_are_batched_into_one_bulk_each)
+{
+  _setup_worker(_create_value_pairs());
+
+  cr_assert_eq(_insert("a", 0), LTR_QUEUED);
+  cr_assert_eq(_insert("b", 1), LTR_QUEUED);
+  cr_assert_eq(_insert("a", 2), LTR_QUEUED);
+  cr_assert_eq(_insert("b", 3), LTR_QUEUED);
+  cr_assert_eq(_insert("a", 4), LTR_QUEUED);
+
+  cr_assert_eq(fetched_collections, 2, "collection handles are not cached");
+  cr_assert_eq(bulks->len, 2);
+  cr_assert_eq(_count_executed_bulks(), 0, "bulk operations are executed before the flush");
+
+  cr_assert_eq(_flush(), LTR_SUCCESS);
+  cr_assert_eq(_count_executed_bulks(), 2);
+  _assert_bulk_sequence(_find_bulk("a", 0), "0,2,4");
+  _assert_bulk_sequence(_find_bulk("b", 0), "1,3");
+
+  /* the handles survive the flush, the next batch gets a new bulk operation */
+  cr_assert_eq(_insert("b", 5), LTR_QUEUED);
+  cr_assert_eq(fetched_collections, 2);
+  cr_assert_eq(bulks->len, 3);
+  cr_assert_eq(_flush(), LTR_SUCCESS);
+  _assert_bulk_sequence(_find_bulk("b", 1), "5");
+
+  /* nothing is pending */
+  cr_assert_eq(_flush(), LTR_SUCCESS);
+  cr_assert_eq(_count_executed_bulks(), 3);
+}
+
+Test(mongodb_worker, test_collection_cache_is_flushed_and_dropped_when_full)
+{
+  _setup_worker(_create_value_pairs());
+
+  for (gint i = 0; i < MONGODB_MAX_CACHED_COLLECTIONS; i++)
+    {
+      gchar collection[32];
+
+      g_snprintf(collection, sizeof(collection), "c%d", i);
+      cr_assert_eq(_insert(collection, i), LTR_QUEUED);
+    }
+  cr_assert_eq(_count_executed_bulks(), 0);
+  cr_assert_eq(g_hash_table_size(worker->collections), MONGODB_MAX_CACHED_COLLECTIONS);
+
+  cr_assert_eq(_insert("overflow", MONGODB_MAX_CACHED_COLLECTIONS), LTR_QUEUED);
+  cr_assert_eq(_count_executed_bulks(), MONGODB_MAX_CACHED_COLLECTIONS,
+               "pending bulk operations are not executed before dropping the handles");
+  cr_assert_eq(g_hash_table_size(worker->collections), 1);
+
+  /* a dropped handle is fetched again */
+  cr_assert_eq(_insert("c0", MONGODB_MAX_CACHED_COLLECTIONS + 1), LTR_QUEUED);
+  cr_assert_eq(fetched_collections, MONGODB_MAX_CACHED_COLLECTIONS + 2);
+
+  cr_assert_eq(_flush(), LTR_SUCCESS);
+  _assert_bulk_sequence(_find_bulk("c0", 0), "0");
+  _assert_bulk_sequence(_find_bulk("c0", 1), "257");
+  _assert_bulk_sequence(_find_bulk("overflow", 0), "256");
+}
+
+Test(mongodb_worker, test_failing_bulk_does_not_prevent_executing_the_others)
+{
+  _setup_worker(_create_value_pairs());
+
+  cr_assert_eq(_insert(FAILING_COLLECTION, 0), LTR_QUEUED);
+  cr_assert_eq(_insert("a", 1), LTR_QUEUED);
+
+  start_grabbing_messages();
+  cr_assert_eq(_flush(), LTR_ERROR);
+  assert_grabbed_log_contains("Error while bulk inserting into MongoDB");
+  stop_grabbing_messages();
+
+  cr_assert_eq(_count_executed_bulks(), 2);
+  cr_assert(_find_bulk(FAILING_COLLECTION, 0)->destroyed);
+  cr_assert(_find_bulk("a", 0)->destroyed);
+
+  /* the failed bulk operation is not retried by itself, the rewound batch is inserted again */
+  cr_assert_eq(_flush(), LTR_SUCCESS);
+  cr_assert_eq(_count_executed_bulks(), 2);
+}
+
+Test(mongodb_worker, test_embedded_documents_are_built_in_place)
+{
+  ValuePairs *vp = _create_value_pairs();
+
+  value_pairs_add_pair(vp, "host.name", compile_template("$HOST"));
+  value_pairs_add_pair(vp, "host.addr.ip", compile_template("10.0.0.$SEQ"));
+  value_pairs_add_pair(vp, "msg", compile_template("message $SEQ"));
+  _setup_worker(vp);
+
+  for (gint i = 0; i < 3; i++)
+    cr_assert_eq(_insert("a", i), LTR_QUEUED);
+
+  /* one child document is stored per nesting level and reused by every message */
+  cr_assert_eq(worker->bson_children->len, 2);
+  cr_assert_eq(worker->bson_depth, 0);
+
+  cr_assert_eq(_flush(), LTR_SUCCESS);
+
+  FakeBulk *bulk = _find_bulk("a", 0);
+  cr_assert_eq(bulk->documents->len, 3);
+  for (gint i = 0; i < 3; i++)
+    {
+      const bson_t *document = g_ptr_array_index(bulk->documents, i);
+      gchar expected[32];
+
+      g_snprintf(expected, sizeof(expected), "%d", i);
+      cr_assert_str_eq(_document_string(document, "seq"), expected);
+      cr_assert_str_eq(_document_string(document, "host.name"), "bzorp");
+
+      g_snprintf(expected, sizeof(expected), "10.0.0.%d", i);
+      cr_assert_str_eq(_document_string(document, "host.addr.ip"), expected);
+
+      g_snprintf(expected, sizeof(expected), "message %d", i);
+      cr_assert_str_eq(_document_string(document, "msg"), expected);
+    }
+}
+
+static void
+setup(void)
+{
+  app_startup();
+  configuration = cfg_new_snippet();
+  bulks = g_ptr_array_new_with_free_func((GDestroyNotify) _fake_bulk_free);
+  fetched_collections = 0;
+}
+
+static void
+teardown(void)
+{
+  if (worker)
+    {
+      /* the client is a fake one, it must not be pushed back to the pool */
+      worker->client = NULL;
+      log_threaded_dest_worker_deinit(&worker->super);
+      log_threaded_dest_worker_free(&worker->super);
+      worker = NULL;
+    }
+  if (driver)
+    {
+      log_pipe_unref(&driver->super.super.super.super);
+      driver = NULL;
+    }
+
+  g_ptr_array_free(bulks, TRUE);
+  cfg_free(configuration);
+  app_shutdown();
+}
+
+TestSuite(mongodb_worker, .init = setup, .fini = teardown);
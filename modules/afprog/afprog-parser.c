@@ -34,6 +34,7 @@ static CfgLexerKeyword afprog_keywords[] =
   { "program",                 KW_PROGRAM },
   { "keep_alive",              KW_KEEP_ALIVE },
   { "inherit_environment",     KW_INHERIT_ENVIRONMENT },
+  { "processes",               KW_PROCESSES },
   { NULL }
 };
 
@@ -33,6 +33,7 @@
 #include "logproto/logproto-text-server.h"
 #include "logproto/logproto-text-client.h"
 #include "poll-fd-events.h"
+#include "template/eval.h"
 
 #include <sys/resource.h>
 #include <sys/types.h>
@@ -381,15 +382,36 @@ afprogram_sd_new(gchar *cmdline, GlobalConfig *cfg)
 
 /* dest driver */
 
+
+/*
+ * With processes(N), each child has its own pipe, LogWriter and queue,
+ * so a slow or restarting child only holds back its own messages.
+ * Child 0 keeps the persist names and metrics of the single process
+ * destination, the others get the child index appended.
+ */
+struct _AFProgramDestProcess
+{
+  AFProgramDestDriver *owner;
+  gint index;
+  gchar index_str[16];
+  AFProgramProcessInfo process_info;
+  LogWriter *writer;
+};
+
 static void afprogram_dd_exit(pid_t pid, int status, gpointer s);
 
 static gchar *
-afprogram_dd_format_queue_persist_name(AFProgramDestDriver *self)
+afprogram_dd_format_queue_persist_name(AFProgramDestProcess *process)
 {
+  AFProgramDestDriver *self = process->owner;
   static gchar persist_name[256];
 
-  g_snprintf(persist_name, sizeof(persist_name),
-             "afprogram_dd_qname(%s,%s)", self->process_info.cmdline->str, self->super.super.id);
+  if (process->index == 0)
+    g_snprintf(persist_name, sizeof(persist_name),
+               "afprogram_dd_qname(%s,%s)", self->process_info.cmdline->str, self->super.super.id);
+  else
+    g_snprintf(persist_name, sizeof(persist_name),
+               "afprogram_dd_qname(%s,%s,%d)", self->process_info.cmdline->str, self->super.super.id, process->index);
 
   return persist_name;
 }
@@ -409,52 +431,82 @@ afprogram_dd_format_persist_name(const LogPipe *s)
   return persist_name;
 }
 
+static const gchar *
+afprogram_dd_format_process_persist_name(AFProgramDestProcess *process)
+{
+  static gchar persist_name[256];
+  const gchar *driver_persist_name = afprogram_dd_format_persist_name(&process->owner->super.super.super);
+
+  if (process->index == 0)
+    return driver_persist_name;
+
+  g_snprintf(persist_name, sizeof(persist_name), "%s.%d", driver_persist_name, process->index);
+  return persist_name;
+}
+
 static void
-afprogram_dd_kill_child(AFProgramDestDriver *self)
+afprogram_dd_kill_child(AFProgramDestProcess *process)
 {
-  if (self->process_info.pid != -1)
+  if (process->process_info.pid != -1)
     {
       msg_verbose("Sending destination program a TERM signal",
-                  evt_tag_str("cmdline", self->process_info.cmdline->str),
-                  evt_tag_int("child_pid", self->process_info.pid));
-      _terminate_process_group_by_pid(self->process_info.pid);
-      self->process_info.pid = -1;
+                  evt_tag_str("cmdline", process->process_info.cmdline->str),
+                  evt_tag_int("child_pid", process->process_info.pid),
+                  evt_tag_int("process", process->index));
+      _terminate_process_group_by_pid(process->process_info.pid);
+      process->process_info.pid = -1;
     }
 }
 
+static void
+afprogram_dd_process_unref_owner(gpointer s)
+{
+  AFProgramDestProcess *process = (AFProgramDestProcess *) s;
+
+  log_pipe_unref(&process->owner->super.super.super);
+}
+
+static void
+afprogram_dd_register_child(AFProgramDestProcess *process)
+{
+  log_pipe_ref(&process->owner->super.super.super);
+  child_manager_register(process->process_info.pid, afprogram_dd_exit, process, afprogram_dd_process_unref_owner);
+}
+
 static inline gboolean
-afprogram_dd_open_program(AFProgramDestDriver *self, int *fd)
+afprogram_dd_open_program(AFProgramDestProcess *process, int *fd)
 {
-  if (self->process_info.pid == -1)
+  if (process->process_info.pid == -1)
     {
       msg_verbose("Starting destination program",
-                  evt_tag_str("cmdline", self->process_info.cmdline->str));
+                  evt_tag_str("cmdline", process->process_info.cmdline->str),
+                  evt_tag_int("process", process->index));
 
-      if (!afprogram_popen(&self->process_info, G_IO_OUT, fd))
+      if (!afprogram_popen(&process->process_info, G_IO_OUT, fd))
         return FALSE;
 
       g_fd_set_nonblock(*fd, TRUE);
     }
 
-  child_manager_register(self->process_info.pid, afprogram_dd_exit, log_pipe_ref(&self->super.super.super),
-                         (GDestroyNotify)log_pipe_unref);
+  afprogram_dd_register_child(process);
 
   return TRUE;
 }
 
 static gboolean
-afprogram_dd_reopen(AFProgramDestDriver *self)
+afprogram_dd_reopen(AFProgramDestProcess *process)
 {
+  AFProgramDestDriver *self = process->owner;
   int fd = -1;
 
-  afprogram_dd_kill_child(self);
+  afprogram_dd_kill_child(process);
 
-  if (!afprogram_dd_open_program(self, &fd) ||
+  if (!afprogram_dd_open_program(process, &fd) ||
       fd < 0)
     return FALSE;
 
-  log_writer_reopen(self->writer, log_proto_text_client_new(log_transport_pipe_new(fd),
-                                                            &self->writer_options.proto_options.super));
+  log_writer_reopen(process->writer, log_proto_text_client_new(log_transport_pipe_new(fd),
+                                                               &self->writer_options.proto_options.super));
   return TRUE;
 }
 
@@ -480,101 +532,118 @@ afprogram_dd_is_command_not_found(int status)
 static void
 afprogram_dd_exit(pid_t pid, int status, gpointer s)
 {
-  AFProgramDestDriver *self = (AFProgramDestDriver *) s;
+  AFProgramDestProcess *process = (AFProgramDestProcess *) s;
 
-  /* Note: self->process_info.pid being -1 means that deinit was called, thus we don't
-   * need to restart the command. self->process_info.pid might change due to EPIPE
+  /* Note: process->process_info.pid being -1 means that deinit was called, thus we don't
+   * need to restart the command. process->process_info.pid might change due to EPIPE
    * handling restarting the command before this handler is run. */
-  if (self->process_info.pid != -1 && self->process_info.pid == pid)
+  if (process->process_info.pid != -1 && process->process_info.pid == pid)
     {
       if (afprogram_dd_is_command_not_found(status))
         {
           msg_error("Child program exited with command not found, stopping the destination.",
-                    evt_tag_str("cmdline", self->process_info.cmdline->str),
+                    evt_tag_str("cmdline", process->process_info.cmdline->str),
+                    evt_tag_int("process", process->index),
                     evt_tag_int("status", status));
 
-          self->process_info.pid = -1;
+          process->process_info.pid = -1;
         }
       else
         {
           msg_info("Child program exited, restarting",
-                   evt_tag_str("cmdline", self->process_info.cmdline->str),
+                   evt_tag_str("cmdline", process->process_info.cmdline->str),
+                   evt_tag_int("process", process->index),
                    evt_tag_int("status", status));
 
-          self->process_info.pid = -1;
-          afprogram_dd_reopen(self);
+          process->process_info.pid = -1;
+          afprogram_dd_reopen(process);
         }
     }
 }
 
 static gboolean
-afprogram_dd_restore_reload_store_item(AFProgramDestDriver *self, GlobalConfig *cfg)
+afprogram_dd_restore_reload_store_item(AFProgramDestProcess *process, GlobalConfig *cfg)
 {
-  const gchar *persist_name = afprogram_dd_format_persist_name((const LogPipe *)self);
+  const gchar *persist_name = afprogram_dd_format_process_persist_name(process);
   AFProgramReloadStoreItem *restored_info =
     (AFProgramReloadStoreItem *)cfg_persist_config_fetch(cfg, persist_name);
 
   if (restored_info)
     {
-      self->process_info.pid = restored_info->pid;
-      self->writer = restored_info->writer;
+      process->process_info.pid = restored_info->pid;
+      process->writer = restored_info->writer;
 
-      child_manager_register(self->process_info.pid, afprogram_dd_exit, log_pipe_ref(&self->super.super.super),
-                             (GDestroyNotify)log_pipe_unref);
+      afprogram_dd_register_child(process);
       g_free(restored_info);
     }
 
-  return !!(self->writer);
+  return !!(process->writer);
+}
+
+static void
+_add_process_label(AFProgramDestProcess *process, StatsClusterKeyBuilder *builder)
+{
+  if (process->owner->num_processes > 1)
+    stats_cluster_key_builder_add_label(builder, stats_cluster_label("process", process->index_str));
 }
 
 static void
-_init_stats_key_builders(AFProgramDestDriver *self, StatsClusterKeyBuilder **writer_sck_builder,
+_init_stats_key_builders(AFProgramDestProcess *process, StatsClusterKeyBuilder **writer_sck_builder,
                          StatsClusterKeyBuilder **driver_sck_builder, StatsClusterKeyBuilder **queue_sck_builder)
 {
+  AFProgramDestDriver *self = process->owner;
+
   *writer_sck_builder = stats_cluster_key_builder_new();
   stats_cluster_key_builder_add_label(*writer_sck_builder, stats_cluster_label("driver", "program"));
+  _add_process_label(process, *writer_sck_builder);
   stats_cluster_key_builder_add_legacy_label(*writer_sck_builder, stats_cluster_label("command",
                                              self->process_info.cmdline->str));
 
   *driver_sck_builder = stats_cluster_key_builder_new();
   stats_cluster_key_builder_add_label(*driver_sck_builder, stats_cluster_label("driver", "program"));
   stats_cluster_key_builder_add_label(*driver_sck_builder, stats_cluster_label("id", self->super.super.id));
+  _add_process_label(process, *driver_sck_builder);
   stats_cluster_key_builder_add_legacy_label(*driver_sck_builder, stats_cluster_label("command",
                                              self->process_info.cmdline->str));
+
+  /* legacy names have no labels, the children other than the first one are told apart by their instance */
+  gchar *legacy_instance = process->index == 0
+                           ? g_strdup(self->process_info.cmdline->str)
+                           : g_strdup_printf("%s#%d", self->process_info.cmdline->str, process->index);
   stats_cluster_key_builder_set_legacy_alias(*driver_sck_builder,
                                              self->writer_options.stats_source | SCS_DESTINATION,
-                                             self->super.super.id, self->process_info.cmdline->str);
+                                             self->super.super.id, legacy_instance);
+  g_free(legacy_instance);
 
   *queue_sck_builder = stats_cluster_key_builder_new();
   stats_cluster_key_builder_add_label(*queue_sck_builder, stats_cluster_label("driver", "program"));
   stats_cluster_key_builder_add_label(*queue_sck_builder, stats_cluster_label("id", self->super.super.id));
+  _add_process_label(process, *queue_sck_builder);
   stats_cluster_key_builder_add_legacy_label(*queue_sck_builder, stats_cluster_label("command",
                                              self->process_info.cmdline->str));
 }
 
 static gboolean
-afprogram_dd_init(LogPipe *s)
+afprogram_dd_init_process(AFProgramDestProcess *process, GlobalConfig *cfg)
 {
-  AFProgramDestDriver *self = (AFProgramDestDriver *) s;
-  GlobalConfig *cfg = log_pipe_get_config(s);
+  AFProgramDestDriver *self = process->owner;
+  LogPipe *s = &self->super.super.super;
 
-  if (!log_dest_driver_init_method(s))
-    return FALSE;
+  process->process_info.cmdline = self->process_info.cmdline;
+  process->process_info.inherit_environment = self->process_info.inherit_environment;
 
-  log_writer_options_init(&self->writer_options, cfg, 0);
-
-  const gboolean restore_successful = afprogram_dd_restore_reload_store_item(self, cfg);
+  const gboolean restore_successful = afprogram_dd_restore_reload_store_item(process, cfg);
 
-  if (!self->writer)
-    self->writer = log_writer_new(LW_FORMAT_FILE, s->cfg);
+  if (!process->writer)
+    process->writer = log_writer_new(LW_FORMAT_FILE, s->cfg);
 
   StatsClusterKeyBuilder *writer_sck_builder;
   StatsClusterKeyBuilder *driver_sck_builder;
   StatsClusterKeyBuilder *queue_sck_builder;
-  _init_stats_key_builders(self, &writer_sck_builder, &driver_sck_builder, &queue_sck_builder);
+  _init_stats_key_builders(process, &writer_sck_builder, &driver_sck_builder, &queue_sck_builder);
 
-  log_pipe_set_options((LogPipe *) self->writer, &self->super.super.super.options);
-  log_writer_set_options(self->writer,
+  log_pipe_set_options((LogPipe *) process->writer, &self->super.super.super.options);
+  log_writer_set_options(process->writer,
                          s,
                          &self->writer_options,
                          self->super.super.id,
@@ -582,69 +651,116 @@ afprogram_dd_init(LogPipe *s)
 
 
   gint stats_level = log_pipe_is_internal(&self->super.super.super) ? STATS_LEVEL3 : self->writer_options.stats_level;
-  LogQueue *queue = log_dest_driver_acquire_queue(&self->super, afprogram_dd_format_queue_persist_name(self),
+  LogQueue *queue = log_dest_driver_acquire_queue(&self->super, afprogram_dd_format_queue_persist_name(process),
                                                   stats_level, driver_sck_builder, queue_sck_builder);
-  log_writer_set_queue(self->writer, queue);
+  log_writer_set_queue(process->writer, queue);
 
   stats_cluster_key_builder_free(queue_sck_builder);
   stats_cluster_key_builder_free(driver_sck_builder);
 
-  if (!log_pipe_init((LogPipe *) self->writer))
+  if (!log_pipe_init((LogPipe *) process->writer))
     {
-      log_pipe_unref((LogPipe *) self->writer);
+      log_pipe_unref((LogPipe *) process->writer);
+      process->writer = NULL;
       return FALSE;
     }
-  log_pipe_append(&self->super.super.super, (LogPipe *) self->writer);
+
+  /* with a single process messages reach the writer through the pipeline as usual */
+  if (self->num_processes == 1)
+    log_pipe_append(&self->super.super.super, (LogPipe *) process->writer);
 
   if (restore_successful)
     {
-      LogProtoClient *proto = log_writer_steal_proto(self->writer);
-      log_writer_reopen(self->writer, proto);
+      LogProtoClient *proto = log_writer_steal_proto(process->writer);
+      log_writer_reopen(process->writer, proto);
       return TRUE;
     }
 
-  return afprogram_dd_reopen(self);
+  return afprogram_dd_reopen(process);
+}
+
+static gboolean
+afprogram_dd_init(LogPipe *s)
+{
+  AFProgramDestDriver *self = (AFProgramDestDriver *) s;
+  GlobalConfig *cfg = log_pipe_get_config(s);
+
+  if (!log_dest_driver_init_method(s))
+    return FALSE;
+
+  log_writer_options_init(&self->writer_options, cfg, 0);
+
+  if (!self->processes)
+    {
+      self->processes = g_new0(AFProgramDestProcess, self->num_processes);
+      for (gint i = 0; i < self->num_processes; i++)
+        {
+          AFProgramDestProcess *process = &self->processes[i];
+
+          process->owner = self;
+          process->index = i;
+          g_snprintf(process->index_str, sizeof(process->index_str), "%d", i);
+          process->process_info.pid = -1;
+        }
+    }
+
+  for (gint i = 0; i < self->num_processes; i++)
+    {
+      if (!afprogram_dd_init_process(&self->processes[i], cfg))
+        return FALSE;
+    }
+
+  return TRUE;
 }
 
 static inline void
-afprogram_dd_store_reload_store_item(AFProgramDestDriver *self, GlobalConfig *cfg)
+afprogram_dd_store_reload_store_item(AFProgramDestProcess *process, GlobalConfig *cfg)
 {
   AFProgramReloadStoreItem *reload_info = g_new0(AFProgramReloadStoreItem, 1);
 
-  reload_info->pid = self->process_info.pid;
-  reload_info->writer = self->writer;
+  reload_info->pid = process->process_info.pid;
+  reload_info->writer = process->writer;
 
-  cfg_persist_config_add(cfg, afprogram_dd_format_persist_name((const LogPipe *)self), reload_info,
+  cfg_persist_config_add(cfg, afprogram_dd_format_process_persist_name(process), reload_info,
                          afprogram_reload_store_item_destroy_notify);
 }
 
-static gboolean
-afprogram_dd_deinit(LogPipe *s)
+static void
+afprogram_dd_deinit_process(AFProgramDestProcess *process, GlobalConfig *cfg)
 {
-  AFProgramDestDriver *self = (AFProgramDestDriver *) s;
-  GlobalConfig *cfg = log_pipe_get_config(&self->super.super.super);
+  AFProgramDestDriver *self = process->owner;
 
-  if (self->writer)
-    log_pipe_deinit((LogPipe *) self->writer);
+  if (process->writer)
+    log_pipe_deinit((LogPipe *) process->writer);
 
-  child_manager_unregister(self->process_info.pid);
+  child_manager_unregister(process->process_info.pid);
 
   if (self->keep_alive)
     {
-      afprogram_dd_store_reload_store_item(self, cfg);
+      afprogram_dd_store_reload_store_item(process, cfg);
     }
   else
     {
-      afprogram_dd_kill_child(self);
+      afprogram_dd_kill_child(process);
 
-      if (self->writer)
-        log_pipe_unref((LogPipe *) self->writer);
+      if (process->writer)
+        log_pipe_unref((LogPipe *) process->writer);
     }
 
-  if (self->writer)
+  if (process->writer)
     {
-      self->writer = NULL;
+      process->writer = NULL;
     }
+}
+
+static gboolean
+afprogram_dd_deinit(LogPipe *s)
+{
+  AFProgramDestDriver *self = (AFProgramDestDriver *) s;
+  GlobalConfig *cfg = log_pipe_get_config(&self->super.super.super);
+
+  for (gint i = 0; self->processes && i < self->num_processes; i++)
+    afprogram_dd_deinit_process(&self->processes[i], cfg);
 
   return log_dest_driver_deinit_method(s);
 }
@@ -654,21 +770,38 @@ afprogram_dd_free(LogPipe *s)
 {
   AFProgramDestDriver *self = (AFProgramDestDriver *) s;
 
-  log_pipe_unref((LogPipe *) self->writer);
+  for (gint i = 0; self->processes && i < self->num_processes; i++)
+    log_pipe_unref((LogPipe *) self->processes[i].writer);
+  g_free(self->processes);
+  log_template_unref(self->partition_key);
   g_string_free(self->process_info.cmdline, TRUE);
   log_writer_options_destroy(&self->writer_options);
   log_dest_driver_free(s);
 }
 
+static AFProgramDestProcess *
+afprogram_dd_lookup_process(AFProgramDestDriver *self, LogWriter *writer)
+{
+  for (gint i = 0; self->processes && i < self->num_processes; i++)
+    {
+      if (self->processes[i].writer == writer)
+        return &self->processes[i];
+    }
+  return NULL;
+}
+
 static void
 afprogram_dd_notify(LogPipe *s, gint notify_code, gpointer user_data)
 {
   AFProgramDestDriver *self = (AFProgramDestDriver *) s;
+  AFProgramDestProcess *process;
 
   switch (notify_code)
     {
     case NC_CLOSE:
-      afprogram_dd_reopen(self);
+      process = afprogram_dd_lookup_process(self, (LogWriter *) user_data);
+      if (process)
+        afprogram_dd_reopen(process);
       break;
     case NC_WRITE_ERROR:
       /* We let this fall through, to be handled by the child manager. We do
@@ -680,6 +813,43 @@ afprogram_dd_notify(LogPipe *s, gint notify_code, gpointer user_data)
     }
 }
 
+/*
+ * Messages with the same partition-key() go to the same child, in the
+ * order they were received, the rest are distributed round robin.
+ */
+static AFProgramDestProcess *
+afprogram_dd_choose_process(AFProgramDestDriver *self, LogMessage *msg)
+{
+  if (self->partition_key)
+    {
+      LogTemplateEvalOptions options = DEFAULT_TEMPLATE_EVAL_OPTIONS;
+
+      return &self->processes[log_template_hash(self->partition_key, msg, &options) % self->num_processes];
+    }
+
+  guint index = (guint) g_atomic_int_add(&self->last_process, 1);
+  return &self->processes[index % self->num_processes];
+}
+
+static void
+afprogram_dd_queue(LogPipe *s, LogMessage *msg, const LogPathOptions *path_options)
+{
+  AFProgramDestDriver *self = (AFProgramDestDriver *) s;
+
+  if (self->num_processes == 1)
+    {
+      log_dest_driver_queue_method(s, msg, path_options);
+      return;
+    }
+
+  AFProgramDestProcess *process = afprogram_dd_choose_process(self, msg);
+
+  /* same accounting as log_dest_driver_queue_method(), but there is no single next pipe */
+  stats_counter_inc(self->super.super.processed_group_messages);
+  stats_counter_inc(self->super.queued_global_messages);
+  log_pipe_queue((LogPipe *) process->writer, msg, path_options);
+}
+
 LogDriver *
 afprogram_dd_new(gchar *cmdline, GlobalConfig *cfg)
 {
@@ -690,9 +860,11 @@ afprogram_dd_new(gchar *cmdline, GlobalConfig *cfg)
   self->super.super.super.deinit = afprogram_dd_deinit;
   self->super.super.super.free_fn = afprogram_dd_free;
   self->super.super.super.notify = afprogram_dd_notify;
+  self->super.super.super.queue = afprogram_dd_queue;
   self->super.super.super.generate_persist_name = afprogram_dd_format_persist_name;
   self->process_info.cmdline = g_string_new(cmdline);
   self->process_info.pid = -1;
+  self->num_processes = 1;
   afprogram_set_inherit_environment(&self->process_info, TRUE);
   log_writer_options_defaults(&self->writer_options);
   self->writer_options.stats_level = STATS_LEVEL0;
@@ -706,6 +878,19 @@ afprogram_dd_set_keep_alive(AFProgramDestDriver *self, gboolean keep_alive)
   self->keep_alive = keep_alive;
 }
 
+void
+afprogram_dd_set_processes(AFProgramDestDriver *self, gint num_processes)
+{
+  self->num_processes = num_processes;
+}
+
+void
+afprogram_dd_set_partition_key_ref(AFProgramDestDriver *self, LogTemplate *partition_key)
+{
+  log_template_unref(self->partition_key);
+  self->partition_key = partition_key;
+}
+
 void
 afprogram_set_inherit_environment(AFProgramProcessInfo *self, gboolean inherit_environment)
 {
@@ -43,11 +43,16 @@ typedef struct _AFProgramSourceDriver
   LogReaderOptions reader_options;
 } AFProgramSourceDriver;
 
+typedef struct _AFProgramDestProcess AFProgramDestProcess;
+
 typedef struct _AFProgramDestDriver
 {
   LogDestDriver super;
   AFProgramProcessInfo process_info;
-  LogWriter *writer;
+  gint num_processes;
+  AFProgramDestProcess *processes;
+  gint last_process;
+  LogTemplate *partition_key;
   gboolean keep_alive;
   LogWriterOptions writer_options;
 } AFProgramDestDriver;
@@ -56,6 +61,8 @@ LogDriver *afprogram_sd_new(gchar *cmdline, GlobalConfig *cfg);
 LogDriver *afprogram_dd_new(gchar *cmdline, GlobalConfig *cfg);
 
 void afprogram_dd_set_keep_alive(AFProgramDestDriver *self, gboolean keep_alive);
+void afprogram_dd_set_processes(AFProgramDestDriver *self, gint num_processes);
+void afprogram_dd_set_partition_key_ref(AFProgramDestDriver *self, LogTemplate *partition_key);
 void afprogram_set_inherit_environment(AFProgramProcessInfo *self, gboolean inherit_environment);
 
 #endif
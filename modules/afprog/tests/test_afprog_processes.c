@@ -0,0 +1,335 @@
+/*
+ * Copyright (c) 2024 One Identity LLC.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#include <criterion/criterion.h>
+#include "libtest/cr_template.h"
+#include "libtest/grab-logging.h"
+
+#include "afprog.c"
+#include "apphook.h"
+#include "cfg.h"
+
+#include <sys/wait.h>
+#include <signal.h>
+#include <stdlib.h>
+
+#define NUM_PROCESSES 3
+
+static AFProgramDestDriver *driver;
+
+static AFProgramDestDriver *
+_create_driver(gint num_processes)
+{
+  AFProgramDestDriver *self = (AFProgramDestDriver *) afprogram_dd_new("cat >/dev/null", configuration);
+
+  self->super.super.id = g_strdup("d_prog");
+  afprogram_dd_set_processes(self, num_processes);
+  return self;
+}
+
+static pid_t
+_pid_of(gint index)
+{
+  return driver->processes[index].process_info.pid;
+}
+
+static gboolean
+_is_running(pid_t pid)
+{
+  return pid > 0 && kill(pid, 0) == 0;
+}
+
+/* the main loop is not running, so the children are reaped here */
+static gint
+_kill_and_reap(pid_t pid)
+{
+  gint status;
+
+  cr_assert_eq(kill(pid, SIGKILL), 0);
+  cr_assert_eq(waitpid(pid, &status, 0), pid);
+  return status;
+}
+
+static void
+_reap_terminated(pid_t *pids, gint num_pids)
+{
+  for (gint i = 0; i < num_pids; i++)
+    {
+      if (pids[i] > 0)
+        waitpid(pids[i], NULL, 0);
+    }
+}
+
+Test(afprog_processes, test_each_child_is_spawned_with_a_writer_of_its_own)
+{
+  driver = _create_driver(NUM_PROCESSES);
+  cr_assert(log_pipe_init(&driver->super.super.super));
+
+  pid_t pids[NUM_PROCESSES];
+  for (gint i = 0; i < NUM_PROCESSES; i++)
+    {
+      pids[i] = _pid_of(i);
+      cr_assert(_is_running(pids[i]), "process #%d is not running", i);
+      cr_assert_not_null(driver->processes[i].writer);
+      for (gint j = 0; j < i; j++)
+        {
+          cr_assert_neq(pids[i], pids[j], "processes #%d and #%d share a child", i, j);
+          cr_assert_neq(driver->processes[i].writer, driver->processes[j].writer);
+        }
+    }
+  cr_assert_null(driver->super.super.super.pipe_next, "messages are routed by the driver, not by the pipeline");
+
+  cr_assert(log_pipe_deinit(&driver->super.super.super));
+  for (gint i = 0; i < NUM_PROCESSES; i++)
+    cr_assert_eq(_pid_of(i), -1, "process #%d is not stopped at deinit", i);
+  _reap_terminated(pids, NUM_PROCESSES);
+}
+
+Test(afprog_processes, test_single_process_is_part_of_the_pipeline)
+{
+  driver = _create_driver(1);
+  cr_assert(log_pipe_init(&driver->super.super.super));
+
+  pid_t pid = _pid_of(0);
+  cr_assert(_is_running(pid));
+  cr_assert_eq(driver->super.super.super.pipe_next, (LogPipe *) driver->processes[0].writer);
+
+  cr_assert(log_pipe_deinit(&driver->super.super.super));
+  _reap_terminated(&pid, 1);
+}
+
+Test(afprog_processes, test_exited_child_is_restarted_alone)
+{
+  driver = _create_driver(NUM_PROCESSES);
+  cr_assert(log_pipe_init(&driver->super.super.super));
+
+  pid_t pids[NUM_PROCESSES] = { _pid_of(0), _pid_of(1), _pid_of(2) };
+  LogWriter *writer = driver->processes[1].writer;
+
+  start_grabbing_messages();
+  child_manager_sigchild(pids[1], _kill_and_reap(pids[1]));
+  assert_grabbed_log_contains("Child program exited, restarting");
+  stop_grabbing_messages();
+
+  cr_assert(_is_running(_pid_of(1)), "the exited child is not restarted");
+  cr_assert_neq(_pid_of(1), pids[1]);
+  cr_assert_eq(driver->processes[1].writer, writer, "the restarted child must keep its writer and queue");
+  cr_assert_eq(_pid_of(0), pids[0]);
+  cr_assert_eq(_pid_of(2), pids[2]);
+
+  /* a late exit notification of the replaced child must not restart it again */
+  pid_t restarted = _pid_of(1);
+  afprogram_dd_exit(pids[1], 0, &driver->processes[1]);
+  cr_assert_eq(_pid_of(1), restarted);
+
+  pids[1] = restarted;
+  cr_assert(log_pipe_deinit(&driver->super.super.super));
+  _reap_terminated(pids, NUM_PROCESSES);
+}
+
+Test(afprog_processes, test_command_not_found_only_stops_its_own_child)
+{
+  driver = _create_driver(NUM_PROCESSES);
+  cr_assert(log_pipe_init(&driver->super.super.super));
+
+  pid_t pids[NUM_PROCESSES] = { _pid_of(0), _pid_of(1), _pid_of(2) };
+  _kill_and_reap(pids[2]);
+
+  start_grabbing_messages();
+  child_manager_sigchild(pids[2], 127 << 8);
+  assert_grabbed_log_contains("Child program exited with command not found, stopping the destination.");
+  stop_grabbing_messages();
+
+  cr_assert_eq(_pid_of(2), -1);
+  cr_assert(_is_running(_pid_of(0)));
+  cr_assert(_is_running(_pid_of(1)));
+
+  pids[2] = -1;
+  cr_assert(log_pipe_deinit(&driver->super.super.super));
+  _reap_terminated(pids, NUM_PROCESSES);
+}
+
+Test(afprog_processes, test_first_child_keeps_the_persist_names_of_a_single_process)
+{
+  driver = _create_driver(NUM_PROCESSES);
+  driver->processes = g_new0(AFProgramDestProcess, NUM_PROCESSES);
+  for (gint i = 0; i < NUM_PROCESSES; i++)
+    {
+      driver->processes[i].owner = driver;
+      driver->processes[i].index = i;
+    }
+
+  cr_assert_str_eq(afprogram_dd_format_queue_persist_name(&driver->processes[0]),
+                   "afprogram_dd_qname(cat >/dev/null,d_prog)");
+  cr_assert_str_eq(afprogram_dd_format_queue_persist_name(&driver->processes[2]),
+                   "afprogram_dd_qname(cat >/dev/null,d_prog,2)");
+
+  cr_assert_str_eq(afprogram_dd_format_process_persist_name(&driver->processes[0]),
+                   "afprogram_dd_name(cat >/dev/null,d_prog)");
+  cr_assert_str_eq(afprogram_dd_format_process_persist_name(&driver->processes[1]),
+                   "afprogram_dd_name(cat >/dev/null,d_prog).1");
+}
+
+/* stands in for the writer of a child, collecting the messages routed to it */
+typedef struct _CapturePipe
+{
+  LogPipe super;
+  GPtrArray *messages;
+} CapturePipe;
+
+static void
+_capture_pipe_queue(LogPipe *s, LogMessage *msg, const LogPathOptions *path_options)
+{
+  CapturePipe *self = (CapturePipe *) s;
+
+  g_ptr_array_add(self->messages, msg);
+}
+
+static void
+_capture_pipe_free(LogPipe *s)
+{
+  CapturePipe *self = (CapturePipe *) s;
+
+  g_ptr_array_free(self->messages, TRUE);
+  log_pipe_free_method(s);
+}
+
+static void
+_setup_capturing_processes(void)
+{
+  driver->processes = g_new0(AFProgramDestProcess, driver->num_processes);
+  for (gint i = 0; i < driver->num_processes; i++)
+    {
+      CapturePipe *capture = g_new0(CapturePipe, 1);
+
+      log_pipe_init_instance(&capture->super, configuration);
+      capture->super.queue = _capture_pipe_queue;
+      capture->super.free_fn = _capture_pipe_free;
+      capture->messages = g_ptr_array_new_with_free_func((GDestroyNotify) log_msg_unref);
+
+      driver->processes[i].owner = driver;
+      driver->processes[i].index = i;
+      driver->processes[i].writer = (LogWriter *) capture;
+    }
+}
+
+static GPtrArray *
+_messages_of(gint index)
+{
+  return ((CapturePipe *) driver->processes[index].writer)->messages;
+}
+
+static void
+_send_message(const gchar *host, gint seq)
+{
+  LogMessage *msg = log_msg_new_empty();
+  gchar text[16];
+  LogPathOptions path_options = LOG_PATH_OPTIONS_INIT;
+
+  g_snprintf(text, sizeof(text), "%d", seq);
+  log_msg_set_value(msg, LM_V_HOST, host, -1);
+  log_msg_set_value(msg, LM_V_MESSAGE, text, -1);
+  log_pipe_queue(&driver->super.super.super, msg, &path_options);
+}
+
+static gint
+_seq_of(LogMessage *msg)
+{
+  return atoi(log_msg_get_value(msg, LM_V_MESSAGE, NULL));
+}
+
+Test(afprog_processes, test_messages_are_distributed_round_robin)
+{
+  driver = _create_driver(NUM_PROCESSES);
+  _setup_capturing_processes();
+
+  for (gint i = 0; i < 3 * NUM_PROCESSES; i++)
+    _send_message("host", i);
+
+  for (gint i = 0; i < NUM_PROCESSES; i++)
+    {
+      GPtrArray *messages = _messages_of(i);
+
+      cr_assert_eq(messages->len, 3, "process #%d got %u messages", i, messages->len);
+      for (guint j = 0; j < messages->len; j++)
+        cr_assert_eq(_seq_of(g_ptr_array_index(messages, j)), j * NUM_PROCESSES + i);
+    }
+}
+
+Test(afprog_processes, test_same_partition_key_is_sent_to_the_same_child_in_order)
+{
+  const gchar *hosts[] = { "alpha", "beta", "gamma", "delta", "epsilon" };
+
+  driver = _create_driver(NUM_PROCESSES);
+  afprogram_dd_set_partition_key_ref(driver, compile_template("$HOST"));
+  _setup_capturing_processes();
+
+  for (gint i = 0; i < 50; i++)
+    _send_message(hosts[i % G_N_ELEMENTS(hosts)], i);
+
+  GHashTable *process_of_host = g_hash_table_new(g_str_hash, g_str_equal);
+  guint total = 0;
+  for (gint i = 0; i < NUM_PROCESSES; i++)
+    {
+      GPtrArray *messages = _messages_of(i);
+      gint last_seq = -1;
+
+      total += messages->len;
+      for (guint j = 0; j < messages->len; j++)
+        {
+          LogMessage *msg = g_ptr_array_index(messages, j);
+          const gchar *host = log_msg_get_value(msg, LM_V_HOST, NULL);
+          gpointer process = g_hash_table_lookup(process_of_host, host);
+
+          cr_assert(!process || GPOINTER_TO_INT(process) == i + 1, "messages of %s are sent to several children", host);
+          g_hash_table_insert(process_of_host, (gpointer) host, GINT_TO_POINTER(i + 1));
+
+          cr_assert_gt(_seq_of(msg), last_seq, "messages are reordered within a child");
+          last_seq = _seq_of(msg);
+        }
+    }
+
+  cr_assert_eq(total, 50);
+  cr_assert_eq(g_hash_table_size(process_of_host), G_N_ELEMENTS(hosts));
+  g_hash_table_destroy(process_of_host);
+}
+
+static void
+setup(void)
+{
+  app_startup();
+  configuration = cfg_new_snippet();
+}
+
+static void
+teardown(void)
+{
+  if (driver)
+    {
+      log_pipe_unref(&driver->super.super.super);
+      driver = NULL;
+    }
+  cfg_free(configuration);
+  app_shutdown();
+}
+
+TestSuite(afprog_processes, .init = setup, .fini = teardown);
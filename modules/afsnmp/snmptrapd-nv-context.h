@@ -31,6 +31,7 @@ struct _SnmpTrapdNVContext
   GString *generated_message;
 
   void (*add_name_value)(SnmpTrapdNVContext *nv_context, const gchar *key, const gchar *value, gsize value_length);
+  gpointer user_data;
 };
 
 static inline void
@@ -27,13 +27,29 @@
 #include "utf8utils.h"
 #include "str-utils.h"
 
+/* upper limit of the distinct varbind names cached, the cache is emptied
+ * once it is reached, as instance suffixes make the names unbounded */
+#define SNMPTRAPD_PARSER_KEY_CACHE_MAX_SIZE 4096
+
 typedef struct _SnmpTrapdParser
 {
   LogParser super;
   GString *prefix;
   gboolean set_message_macro;
+
+  /* varbind/header name -> NVHandle of the prefixed and normalized name */
+  GRWLock key_cache_lock;
+  GHashTable *key_cache;
 } SnmpTrapdParser;
 
+static void
+_clear_key_cache(SnmpTrapdParser *self)
+{
+  g_rw_lock_writer_lock(&self->key_cache_lock);
+  g_hash_table_remove_all(self->key_cache);
+  g_rw_lock_writer_unlock(&self->key_cache_lock);
+}
+
 void
 snmptrapd_parser_set_prefix(LogParser *s, const gchar *prefix)
 {
@@ -43,6 +59,8 @@ snmptrapd_parser_set_prefix(LogParser *s, const gchar *prefix)
     g_string_truncate(self->prefix, 0);
   else
     g_string_assign(self->prefix, prefix);
+
+  _clear_key_cache(self);
 }
 
 void
@@ -119,32 +137,50 @@ static void
 _append_name_value_to_generated_message(GString *generated_message, const gchar *key,
                                         const gchar *value, gsize value_length)
 {
-  ScratchBuffersMarker marker;
-  GString *escaped_value = scratch_buffers_alloc_and_mark(&marker);
-
   if (generated_message->len > 0)
-    g_string_append(generated_message, ", ");
+    g_string_append_len(generated_message, ", ", 2);
+
+  g_string_append(generated_message, key);
+  g_string_append_len(generated_message, "='", 2);
+  append_unsafe_utf8_as_escaped_text(generated_message, value, value_length, "'");
+  g_string_append_c(generated_message, '\'');
+}
 
-  append_unsafe_utf8_as_escaped_text(escaped_value, value, value_length, "'");
-  g_string_append_printf(generated_message, "%s='%s'", key, escaped_value->str);
+static NVHandle
+_lookup_key_handle(SnmpTrapdParser *self, const gchar *key)
+{
+  g_rw_lock_reader_lock(&self->key_cache_lock);
+  NVHandle handle = GPOINTER_TO_UINT(g_hash_table_lookup(self->key_cache, key));
+  g_rw_lock_reader_unlock(&self->key_cache_lock);
+
+  if (handle)
+    return handle;
+
+  ScratchBuffersMarker marker;
+  GString *formatted_key = scratch_buffers_alloc_and_mark(&marker);
 
+  handle = log_msg_get_value_handle(_get_formatted_key(key, self->prefix, formatted_key));
   scratch_buffers_reclaim_marked(marker);
+
+  g_rw_lock_writer_lock(&self->key_cache_lock);
+  if (g_hash_table_size(self->key_cache) >= SNMPTRAPD_PARSER_KEY_CACHE_MAX_SIZE)
+    g_hash_table_remove_all(self->key_cache);
+  g_hash_table_insert(self->key_cache, g_strdup(key), GUINT_TO_POINTER(handle));
+  g_rw_lock_writer_unlock(&self->key_cache_lock);
+
+  return handle;
 }
 
 static void
 _add_name_value(SnmpTrapdNVContext *nv_context, const gchar *key,
                 const gchar *value, gsize value_length)
 {
-  ScratchBuffersMarker marker;
-  GString *formatted_key = scratch_buffers_alloc_and_mark(&marker);
+  SnmpTrapdParser *self = (SnmpTrapdParser *) nv_context->user_data;
 
-  const gchar *prefixed_key = _get_formatted_key(key, nv_context->key_prefix, formatted_key);
-  log_msg_set_value_by_name(nv_context->msg, prefixed_key, value, value_length);
+  log_msg_set_value(nv_context->msg, _lookup_key_handle(self, key), value, value_length);
 
   if (nv_context->generated_message)
     _append_name_value_to_generated_message(nv_context->generated_message, key, value, value_length);
-
-  scratch_buffers_reclaim_marked(marker);
 }
 
 static gboolean
@@ -152,6 +188,7 @@ _parse_varbindlist(SnmpTrapdNVContext *nv_context, const gchar **input, gsize *i
 {
   VarBindListScanner varbindlist_scanner;
   const gchar *key, *value;
+  gsize value_len;
 
   varbindlist_scanner_init(&varbindlist_scanner);
 
@@ -160,8 +197,9 @@ _parse_varbindlist(SnmpTrapdNVContext *nv_context, const gchar **input, gsize *i
     {
       key = varbindlist_scanner_get_current_key(&varbindlist_scanner);
       value = varbindlist_scanner_get_current_value(&varbindlist_scanner);
+      value_len = varbindlist_scanner_get_current_value_len(&varbindlist_scanner);
 
-      snmptrapd_nv_context_add_name_value(nv_context, key, value, -1);
+      snmptrapd_nv_context_add_name_value(nv_context, key, value, value_len);
     }
 
   varbindlist_scanner_deinit(&varbindlist_scanner);
@@ -193,7 +231,8 @@ snmptrapd_parser_process(LogParser *s, LogMessage **pmsg, const LogPathOptions *
     .key_prefix = self->prefix,
     .msg = *pmsg,
     .generated_message = generated_message,
-    .add_name_value = _add_name_value
+    .add_name_value = _add_name_value,
+    .user_data = self,
   };
 
   log_msg_set_value(nv_context.msg, LM_V_PROGRAM, "snmptrapd", -1);
@@ -249,6 +288,8 @@ snmptrapd_parser_free(LogPipe *s)
   SnmpTrapdParser *self = (SnmpTrapdParser *) s;
 
   g_string_free(self->prefix, TRUE);
+  g_hash_table_destroy(self->key_cache);
+  g_rw_lock_clear(&self->key_cache_lock);
 
   log_parser_free_method(s);
 }
@@ -264,6 +305,8 @@ snmptrapd_parser_new(GlobalConfig *cfg)
   self->super.process = snmptrapd_parser_process;
 
   self->prefix = g_string_new(".snmp.");
+  g_rw_lock_init(&self->key_cache_lock);
+  self->key_cache = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
   self->set_message_macro = TRUE;
 
   return &self->super;
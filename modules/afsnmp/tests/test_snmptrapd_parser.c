@@ -334,6 +334,33 @@ Test(snmptrapd_parser, test_v2_key_normalization)
   assert_log_message_name_values(input, expected, SIZE_OF_ARRAY(expected));
 }
 
+Test(snmptrapd_parser, test_v2_key_names_are_cached_across_messages)
+{
+  const gchar *input =
+    "2017-05-13 12:17:32 localhost [UDP: [127.0.0.1]:52407->[127.0.0.1]:162]:  \n "
+    "NET-SNMP-EXAMPLES-MIB::netSnmpColons = STRING: \"Colossus colons\" \t"
+    "NET-SNMP-EXAMPLES-MIB::netSnmpExampleInteger = INTEGER: 1234 \t";
+
+  LogParser *parser = create_parser(NULL);
+
+  for (gint i = 0; i < 3; i++)
+    {
+      LogMessage *msg = parse_str_into_log_message(parser, input);
+
+      assert_log_message_value_by_name(msg, ".snmp.hostname", "localhost");
+      assert_log_message_value_by_name(msg, ".snmp.NET-SNMP-EXAMPLES-MIB_netSnmpColons", "Colossus colons");
+      assert_log_message_value_by_name(msg, ".snmp.NET-SNMP-EXAMPLES-MIB_netSnmpExampleInteger", "1234");
+      log_msg_unref(msg);
+    }
+
+  snmptrapd_parser_set_prefix(parser, ".trap.");
+  LogMessage *msg = parse_str_into_log_message(parser, input);
+  assert_log_message_value_by_name(msg, ".trap.NET-SNMP-EXAMPLES-MIB_netSnmpColons", "Colossus colons");
+  log_msg_unref(msg);
+
+  destroy_parser(parser);
+}
+
 Test(snmptrapd_parser, test_general_v1_message_without_varbindlist)
 {
   const gchar *input =
@@ -48,6 +48,7 @@ _expect_next_key_type_value(VarBindListScanner *scanner, const gchar *key, const
   cr_expect_str_eq(varbindlist_scanner_get_current_key(scanner), key);
   cr_expect_str_eq(varbindlist_scanner_get_current_type(scanner), type);
   cr_expect_str_eq(varbindlist_scanner_get_current_value(scanner), value);
+  cr_expect_eq(varbindlist_scanner_get_current_value_len(scanner), strlen(value));
 }
 
 static VarBindListScanner *
@@ -57,6 +57,12 @@ varbindlist_scanner_get_current_value(VarBindListScanner *self)
   return kv_scanner_get_current_value(&self->super);
 }
 
+static inline gsize
+varbindlist_scanner_get_current_value_len(VarBindListScanner *self)
+{
+  return kv_scanner_get_current_value_len(&self->super);
+}
+
 gboolean varbindlist_scanner_scan_next(VarBindListScanner *self);
 VarBindListScanner *varbindlist_scanner_new(void);
 
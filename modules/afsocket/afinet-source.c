@@ -62,6 +62,19 @@ afinet_sd_set_tls_context(LogDriver *s, TLSContext *tls_context)
   transport_mapper_inet_set_tls_context((TransportMapperInet *) self->super.transport_mapper, tls_context);
 }
 
+void
+afinet_sd_set_receive_batch_size(LogDriver *s, gint batch_size)
+{
+  AFInetSourceDriver *self = (AFInetSourceDriver *) s;
+
+#ifndef SYSLOG_NG_HAVE_RECVMMSG
+  if (batch_size > 1)
+    msg_warning("WARNING: receive-batch-size() is not supported on this platform, datagrams are received one by one",
+                log_pipe_location_tag(&s->super));
+#endif
+  transport_mapper_inet_set_receive_batch_size((TransportMapperInet *) self->super.transport_mapper, batch_size);
+}
+
 static gboolean
 afinet_sd_setup_addresses(AFSocketSourceDriver *s)
 {
@@ -100,13 +113,37 @@ gboolean
 afinet_sd_init(LogPipe *s)
 {
   AFInetSourceDriver *self = (AFInetSourceDriver *) s;
+  GlobalConfig *cfg = log_pipe_get_config(s);
+  TLSContext *tls_context = ((TransportMapperInet *) self->super.transport_mapper)->tls_context;
 
   if (!afsocket_sd_init_method(&self->super.super.super.super))
     return FALSE;
 
+  /* the persist name depends on the bind address, which is only known at this point */
+  if (tls_context && !tls_context_load_session_ticket_keys(tls_context, cfg->state,
+                                                           afsocket_sd_format_session_ticket_keys_name(&self->super)))
+    {
+      afsocket_sd_deinit_method(s);
+      return FALSE;
+    }
+
   return TRUE;
 }
 
+static gboolean
+afinet_sd_deinit(LogPipe *s)
+{
+  AFInetSourceDriver *self = (AFInetSourceDriver *) s;
+  GlobalConfig *cfg = log_pipe_get_config(s);
+  TLSContext *tls_context = ((TransportMapperInet *) self->super.transport_mapper)->tls_context;
+
+  if (tls_context)
+    tls_context_save_session_ticket_keys(tls_context, cfg->state,
+                                         afsocket_sd_format_session_ticket_keys_name(&self->super));
+
+  return afsocket_sd_deinit_method(s);
+}
+
 void
 afinet_sd_free(LogPipe *s)
 {
@@ -127,6 +164,7 @@ afinet_sd_new_instance(TransportMapper *transport_mapper, GlobalConfig *cfg)
                             transport_mapper,
                             cfg);
   self->super.super.super.super.init = afinet_sd_init;
+  self->super.super.super.super.deinit = afinet_sd_deinit;
   self->super.super.super.super.free_fn = afinet_sd_free;
   self->super.setup_addresses = afinet_sd_setup_addresses;
   return self;
@@ -66,6 +66,11 @@ static CfgLexerKeyword afsocket_keywords[] =
   { "sni",                KW_SNI },
   { "allow_compress",     KW_ALLOW_COMPRESS },
   { "ocsp_stapling_verify", KW_OCSP_STAPLING_VERIFY },
+  { "ktls",               KW_KTLS },
+  { "session_tickets",    KW_SESSION_TICKETS },
+  { "session_ticket_key_file", KW_SESSION_TICKET_KEY_FILE },
+  { "session_ticket_key_rotation", KW_SESSION_TICKET_KEY_ROTATION },
+  { "session_cache_size", KW_SESSION_CACHE_SIZE },
   { "openssl_conf_cmds",  KW_CONF_CMDS},
 
   { "localip",            KW_LOCALIP },
@@ -95,6 +100,8 @@ static CfgLexerKeyword afsocket_keywords[] =
   { "ip_protocol",        KW_IP_PROTOCOL },
   { "max_connections",    KW_MAX_CONNECTIONS },
   { "listen_backlog",     KW_LISTEN_BACKLOG },
+  { "listeners",          KW_LISTENERS },
+  { "dedicated_thread_peers", KW_DEDICATED_THREAD_PEERS },
   { "keep_alive",         KW_KEEP_ALIVE },
   { "close_on_input",     KW_CLOSE_ON_INPUT },
   { "systemd_syslog",     KW_SYSTEMD_SYSLOG  },
@@ -107,6 +114,9 @@ static CfgLexerKeyword afsocket_keywords[] =
   { "dynamic_window_size", KW_DYNAMIC_WINDOW_SIZE },
   { "dynamic_window_stats_freq", KW_DYNAMIC_WINDOW_STATS_FREQ },
   { "dynamic_window_realloc_ticks", KW_DYNAMIC_WINDOW_REALLOC_TICKS },
+  { "dynamic_window_connection_min", KW_DYNAMIC_WINDOW_CONNECTION_MIN },
+  { "dynamic_window_connection_max", KW_DYNAMIC_WINDOW_CONNECTION_MAX },
+  { "receive_batch_size", KW_RECEIVE_BATCH_SIZE },
   { NULL }
 };
 
@@ -29,6 +29,7 @@
 #include "stats/stats-cluster-single.h"
 #include "stats/stats-cluster-key-builder.h"
 #include "mainloop.h"
+#include "mainloop-worker.h"
 #include "poll-fd-events.h"
 #include "timeutils/misc.h"
 #include "afsocket-signals.h"
@@ -151,6 +152,18 @@ afsocket_sc_construct_transport(AFSocketSourceConnection *self, gint fd)
   return transport_mapper_construct_log_transport(self->owner->transport_mapper, fd);
 }
 
+static gboolean
+afsocket_sc_is_dedicated_thread_peer(AFSocketSourceConnection *self)
+{
+  gchar buf[MAX_SOCKADDR_STRING];
+
+  if (!self->owner->dedicated_thread_peers || !self->peer_addr)
+    return FALSE;
+
+  g_sockaddr_format(self->peer_addr, buf, sizeof(buf), GSA_ADDRESS_ONLY);
+  return g_list_find_custom(self->owner->dedicated_thread_peers, buf, (GCompareFunc) strcmp) != NULL;
+}
+
 static gboolean
 afsocket_sc_init(LogPipe *s)
 {
@@ -179,6 +192,13 @@ afsocket_sc_init(LogPipe *s)
       log_reader_open(self->reader, proto, poll_fd_events_new(self->sock));
       log_reader_set_peer_addr(self->reader, self->peer_addr);
       log_reader_set_local_addr(self->reader, self->local_addr);
+
+      if (afsocket_sc_is_dedicated_thread_peer(self))
+        {
+          msg_verbose("Reading connection in a dedicated thread",
+                      evt_tag_str("connection", afsocket_sc_format_name(self)));
+          log_reader_set_dedicated_thread(self->reader, TRUE);
+        }
     }
 
   StatsClusterKeyBuilder *kb = stats_cluster_key_builder_new();
@@ -352,6 +372,23 @@ afsocket_sd_set_listen_backlog(LogDriver *s, gint listen_backlog)
   self->listen_backlog = listen_backlog;
 }
 
+void
+afsocket_sd_set_listeners(LogDriver *s, gint num_listeners)
+{
+  AFSocketSourceDriver *self = (AFSocketSourceDriver *) s;
+
+  self->num_listeners = num_listeners;
+}
+
+void
+afsocket_sd_set_dedicated_thread_peers(LogDriver *s, GList *peers)
+{
+  AFSocketSourceDriver *self = (AFSocketSourceDriver *) s;
+
+  g_list_free_full(self->dedicated_thread_peers, g_free);
+  self->dedicated_thread_peers = peers;
+}
+
 void
 afsocket_sd_set_dynamic_window_size(LogDriver *s, gint dynamic_window_size)
 {
@@ -376,6 +413,22 @@ afsocket_sd_set_dynamic_window_realloc_ticks(LogDriver *s, gint realloc_ticks)
   self->dynamic_window_realloc_ticks = realloc_ticks;
 }
 
+void
+afsocket_sd_set_dynamic_window_connection_min(LogDriver *s, gint connection_min)
+{
+  AFSocketSourceDriver *self = (AFSocketSourceDriver *) s;
+
+  self->dynamic_window_connection_min = connection_min;
+}
+
+void
+afsocket_sd_set_dynamic_window_connection_max(LogDriver *s, gint connection_max)
+{
+  AFSocketSourceDriver *self = (AFSocketSourceDriver *) s;
+
+  self->dynamic_window_connection_max = connection_max;
+}
+
 static const gchar *
 afsocket_sd_format_name(const LogPipe *s)
 {
@@ -400,12 +453,16 @@ afsocket_sd_format_name(const LogPipe *s)
 }
 
 static const gchar *
-afsocket_sd_format_listener_name(const AFSocketSourceDriver *self)
+afsocket_sd_format_listener_name(const AFSocketSourceDriver *self, gint index)
 {
   static gchar persist_name[1024];
 
-  g_snprintf(persist_name, sizeof(persist_name), "%s.listen_fd",
-             afsocket_sd_format_name((const LogPipe *)self));
+  if (index == 0)
+    g_snprintf(persist_name, sizeof(persist_name), "%s.listen_fd",
+               afsocket_sd_format_name((const LogPipe *)self));
+  else
+    g_snprintf(persist_name, sizeof(persist_name), "%s.listen_fd.%d",
+               afsocket_sd_format_name((const LogPipe *)self), index);
 
   return persist_name;
 }
@@ -432,6 +489,17 @@ afsocket_sd_format_dynamic_window_pool_name(const AFSocketSourceDriver *self)
   return persist_name;
 }
 
+const gchar *
+afsocket_sd_format_session_ticket_keys_name(const AFSocketSourceDriver *self)
+{
+  static gchar persist_name[1024];
+
+  g_snprintf(persist_name, sizeof(persist_name), "%s.session_ticket_keys",
+             afsocket_sd_format_name((const LogPipe *)self));
+
+  return persist_name;
+}
+
 static gboolean
 afsocket_sd_process_connection(AFSocketSourceDriver *self, GSockAddr *client_addr, GSockAddr *local_addr, gint fd)
 {
@@ -460,7 +528,8 @@ afsocket_sd_process_connection(AFSocketSourceDriver *self, GSockAddr *client_add
 
 #endif
 
-  if (_connections_count_get(self) >= atomic_gssize_get(&self->max_connections))
+  /* max-connections() does not apply to the per listener connections of SOCK_DGRAM sources */
+  if (client_addr && _connections_count_get(self) >= atomic_gssize_get(&self->max_connections))
     {
       msg_error("Number of allowed concurrent connections reached, rejecting connection",
                 evt_tag_str("client", g_sockaddr_format(client_addr, buf, sizeof(buf), GSA_FULL)),
@@ -497,7 +566,8 @@ afsocket_sd_process_connection(AFSocketSourceDriver *self, GSockAddr *client_add
 static void
 afsocket_sd_accept(gpointer s)
 {
-  AFSocketSourceDriver *self = (AFSocketSourceDriver *) s;
+  AFSocketListener *listener = (AFSocketListener *) s;
+  AFSocketSourceDriver *self = listener->owner;
   GSockAddr *peer_addr;
   GSockAddr *local_addr;
   gchar buf1[256], buf2[256];
@@ -509,7 +579,7 @@ afsocket_sd_accept(gpointer s)
     {
       GIOStatus status;
 
-      status = g_accept(self->fd, &new_fd, &peer_addr);
+      status = g_accept(listener->fd, &new_fd, &peer_addr);
       if (status == G_IO_STATUS_AGAIN)
         {
           /* no more connections to accept */
@@ -581,26 +651,43 @@ afsocket_sd_close_connection(AFSocketSourceDriver *self, AFSocketSourceConnectio
 static void
 _listen_fd_init(AFSocketSourceDriver *self)
 {
-  IV_FD_INIT(&self->listen_fd);
+  if (self->listeners)
+    return;
+
+  self->listeners = g_new0(AFSocketListener, self->num_listeners);
+  for (gint i = 0; i < self->num_listeners; i++)
+    {
+      AFSocketListener *listener = &self->listeners[i];
+
+      listener->owner = self;
+      listener->fd = -1;
+      IV_FD_INIT(&listener->listen_fd);
 
-  /* the fd is initialized only when the listening socket is opened */
-  self->listen_fd.fd = -1;
-  self->listen_fd.cookie = self;
-  self->listen_fd.handler_in = afsocket_sd_accept;
+      /* the fd is initialized only when the listening socket is opened */
+      listener->listen_fd.fd = -1;
+      listener->listen_fd.cookie = listener;
+      listener->listen_fd.handler_in = afsocket_sd_accept;
+    }
 }
 
 static void
 _listen_fd_start(AFSocketSourceDriver *self)
 {
-  if (self->listen_fd.fd != -1)
-    iv_fd_register(&self->listen_fd);
+  for (gint i = 0; self->listeners && i < self->num_listeners; i++)
+    {
+      if (self->listeners[i].listen_fd.fd != -1)
+        iv_fd_register(&self->listeners[i].listen_fd);
+    }
 }
 
 static void
 _listen_fd_stop(AFSocketSourceDriver *self)
 {
-  if (iv_fd_registered (&self->listen_fd))
-    iv_fd_unregister(&self->listen_fd);
+  for (gint i = 0; self->listeners && i < self->num_listeners; i++)
+    {
+      if (iv_fd_registered(&self->listeners[i].listen_fd))
+        iv_fd_unregister(&self->listeners[i].listen_fd);
+    }
 }
 
 static void
@@ -627,6 +714,7 @@ _dynamic_window_update_stats(AFSocketSourceDriver *self)
 static void
 _dynamic_window_realloc_cb(AFSocketSourceConnection *conn)
 {
+  dynamic_window_reset_demand(&conn->reader->super.dynamic_window);
   log_source_schedule_dynamic_window_realloc(&conn->reader->super);
 }
 
@@ -661,6 +749,70 @@ _dynamic_window_set_balanced_window(AFSocketSourceDriver *self)
   self->dynamic_window_pool->balanced_window = new_balanced_win;
 }
 
+static gsize
+_dynamic_window_get_starving_demand(LogSource *source, gsize step)
+{
+  if (!log_source_dynamic_window_is_starving(source))
+    return 0;
+
+  return MIN(step, log_source_dynamic_window_get_headroom(source));
+}
+
+/* Between two reallocs, connections that ran out of window get window
+ * credits from the free part of the pool first and from connections that
+ * kept their window unused since the last realloc next.  The next realloc
+ * returns every connection to the balanced window. */
+static void
+_dynamic_window_shift_to_starving(AFSocketSourceDriver *self)
+{
+  gsize step = MAX(self->dynamic_window_pool->balanced_window, 1);
+  gsize demand = 0;
+  gint num_starving = 0;
+
+  for (GList *l = self->connections; l; l = l->next)
+    {
+      AFSocketSourceConnection *conn = (AFSocketSourceConnection *) l->data;
+      gsize connection_demand = _dynamic_window_get_starving_demand(&conn->reader->super, step);
+
+      if (connection_demand)
+        {
+          demand += connection_demand;
+          num_starving++;
+        }
+    }
+
+  if (num_starving == 0)
+    return;
+
+  gsize available = self->dynamic_window_pool->free_window;
+  for (GList *l = self->connections; l && available < demand; l = l->next)
+    {
+      AFSocketSourceConnection *conn = (AFSocketSourceConnection *) l->data;
+      gsize surplus = MIN(log_source_dynamic_window_get_surplus(&conn->reader->super), demand - available);
+
+      if (surplus)
+        {
+          log_source_dynamic_window_shift(&conn->reader->super, -(gssize) surplus);
+          available += surplus;
+        }
+    }
+
+  gsize share = available / num_starving;
+  for (GList *l = self->connections; l && share; l = l->next)
+    {
+      AFSocketSourceConnection *conn = (AFSocketSourceConnection *) l->data;
+      gsize grant = MIN(_dynamic_window_get_starving_demand(&conn->reader->super, step), share);
+
+      if (grant)
+        log_source_dynamic_window_shift(&conn->reader->super, grant);
+    }
+
+  msg_trace("Dynamic window shifted to starving connections",
+            evt_tag_int("starving_connections", num_starving),
+            evt_tag_long("demand", demand),
+            evt_tag_long("available", available));
+}
+
 static gboolean
 _is_dynamic_window_realloc_needed(AFSocketSourceDriver *self)
 {
@@ -681,6 +833,7 @@ _on_dynamic_window_timer_elapsed(gpointer cookie)
   else
     {
       _dynamic_window_update_stats(self);
+      _dynamic_window_shift_to_starving(self);
     }
 
   self->dynamic_window_timer_tick++;
@@ -772,6 +925,10 @@ afsocket_sd_dynamic_window_init(AFSocketSourceDriver *self)
 {
   if (!afsocket_sd_restore_dynamic_window_pool(self))
     afsocket_sd_create_dynamic_window_pool(self);
+
+  if (self->dynamic_window_pool)
+    dynamic_window_pool_set_connection_limits(self->dynamic_window_pool, self->dynamic_window_connection_min,
+                                              self->dynamic_window_connection_max);
 }
 
 static void
@@ -1039,7 +1196,6 @@ static void
 afsocket_sd_init_watches(AFSocketSourceDriver *self)
 {
   _dynamic_window_timer_init(self);
-  _listen_fd_init(self);
   _packet_stats_timer_init(self);
 }
 
@@ -1059,25 +1215,45 @@ afsocket_sd_stop_watches(AFSocketSourceDriver *self)
   _listen_fd_stop(self);
 }
 
+static void
+_close_listeners(AFSocketSourceDriver *self)
+{
+  for (gint i = 0; i < self->num_listeners; i++)
+    {
+      AFSocketListener *listener = &self->listeners[i];
+
+      if (listener->fd != -1)
+        close(listener->fd);
+      listener->fd = -1;
+      listener->listen_fd.fd = -1;
+    }
+}
+
 static gboolean
 _sd_open_stream_finalize(gpointer arg)
 {
   AFSocketSourceDriver *self = (AFSocketSourceDriver *)arg;
+
   /* set up listening source */
-  if (listen(self->fd, self->listen_backlog) < 0)
+  for (gint i = 0; i < self->num_listeners; i++)
     {
-      msg_error("Error during listen()",
-                evt_tag_error(EVT_TAG_OSERROR));
-      close(self->fd);
-      self->fd = -1;
-      return FALSE;
+      AFSocketListener *listener = &self->listeners[i];
+
+      if (listen(listener->fd, self->listen_backlog) < 0)
+        {
+          msg_error("Error during listen()",
+                    evt_tag_error(EVT_TAG_OSERROR));
+          _close_listeners(self);
+          return FALSE;
+        }
+      listener->listen_fd.fd = listener->fd;
     }
 
-  self->listen_fd.fd = self->fd;
   afsocket_sd_start_watches(self);
   char buf[256];
   msg_info("Accepting connections",
-           evt_tag_str("addr", g_sockaddr_format(self->bind_addr, buf, sizeof(buf), GSA_FULL)));
+           evt_tag_str("addr", g_sockaddr_format(self->bind_addr, buf, sizeof(buf), GSA_FULL)),
+           evt_tag_int("listeners", self->num_listeners));
   return TRUE;
 }
 
@@ -1095,47 +1271,63 @@ afsocket_sd_open_socket(AFSocketSourceDriver *self, gint *sock)
   return !signal_data.failure;
 }
 
+/* only the first listener can be acquired from the runtime environment */
+static gboolean
+_sd_acquire_or_open_socket(AFSocketSourceDriver *self, gint index, gint *sock)
+{
+  *sock = -1;
+  if (index == 0 && !afsocket_sd_acquire_socket(self, sock))
+    return FALSE;
+  if (*sock == -1 && !afsocket_sd_open_socket(self, sock))
+    return FALSE;
+  return TRUE;
+}
+
 static gboolean
 _sd_open_stream(AFSocketSourceDriver *self)
 {
   GlobalConfig *cfg = log_pipe_get_config(&self->super.super.super);
-  gint sock = -1;
-  if (self->connections_kept_alive_across_reloads)
+
+  _listen_fd_init(self);
+  for (gint i = 0; i < self->num_listeners; i++)
     {
-      /* NOTE: this assumes that fd 0 will never be used for listening fds,
-       * main.c opens fd 0 so this assumption can hold */
-      gpointer config_result = cfg_persist_config_fetch(cfg, afsocket_sd_format_listener_name(self));
-      sock = GPOINTER_TO_UINT(config_result) - 1;
+      gint sock = -1;
 
-    }
+      if (self->connections_kept_alive_across_reloads)
+        {
+          /* NOTE: this assumes that fd 0 will never be used for listening fds,
+           * main.c opens fd 0 so this assumption can hold */
+          gpointer config_result = cfg_persist_config_fetch(cfg, afsocket_sd_format_listener_name(self, i));
+          sock = GPOINTER_TO_UINT(config_result) - 1;
+        }
 
-  if (sock == -1)
-    {
-      if (!afsocket_sd_acquire_socket(self, &sock))
-        return self->super.super.optional;
-      if (sock == -1 && !afsocket_sd_open_socket(self, &sock))
-        return self->super.super.optional;
+      if (sock == -1 && !_sd_acquire_or_open_socket(self, i, &sock))
+        {
+          _close_listeners(self);
+          return self->super.super.optional;
+        }
+      self->listeners[i].fd = sock;
     }
-  self->fd = sock;
   return transport_mapper_async_init(self->transport_mapper, _sd_open_stream_finalize, self);
 }
 
+/*
+ * SOCK_DGRAM sources have a connection (and thus a LogReader) for each of
+ * their listeners, some of which might have been kept alive across reloads.
+ */
 static gboolean
 _sd_open_dgram(AFSocketSourceDriver *self)
 {
-  gint sock = -1;
-  if (!self->connections)
+  for (gint i = g_list_length(self->connections); i < self->num_listeners; i++)
     {
-      if (!afsocket_sd_acquire_socket(self, &sock))
-        return self->super.super.optional;
-      if (sock == -1 && !afsocket_sd_open_socket(self, &sock))
+      gint sock = -1;
+
+      if (!_sd_acquire_or_open_socket(self, i, &sock))
         return self->super.super.optional;
-    }
-  self->fd = -1;
 
-  /* we either have self->connections != NULL, or sock contains a new fd */
-  if (!(self->connections || afsocket_sd_process_connection(self, NULL, self->bind_addr, sock)))
-    return FALSE;
+      if (!afsocket_sd_process_connection(self, NULL, self->bind_addr, sock))
+        return FALSE;
+    }
 
   if (!transport_mapper_init(self->transport_mapper))
     return FALSE;
@@ -1181,22 +1373,32 @@ afsocket_sd_save_listener(AFSocketSourceDriver *self)
   GlobalConfig *cfg = log_pipe_get_config(&self->super.super.super);
 
   afsocket_sd_stop_watches(self);
-  if (self->transport_mapper->sock_type == SOCK_STREAM)
+  if (self->transport_mapper->sock_type != SOCK_STREAM || !self->listeners)
+    return;
+
+  for (gint i = 0; i < self->num_listeners; i++)
     {
+      AFSocketListener *listener = &self->listeners[i];
+
+      if (listener->fd == -1)
+        continue;
+
       if (!self->connections_kept_alive_across_reloads)
         {
           msg_verbose("Closing listener fd",
-                      evt_tag_int("fd", self->fd));
-          close(self->fd);
+                      evt_tag_int("fd", listener->fd));
+          close(listener->fd);
         }
       else
         {
           /* NOTE: the fd is incremented by one when added to persistent config
            * as persist config cannot store NULL */
 
-          cfg_persist_config_add(cfg, afsocket_sd_format_listener_name(self),
-                                 GUINT_TO_POINTER(self->fd + 1), afsocket_sd_close_fd);
+          cfg_persist_config_add(cfg, afsocket_sd_format_listener_name(self, i),
+                                 GUINT_TO_POINTER(listener->fd + 1), afsocket_sd_close_fd);
         }
+      listener->fd = -1;
+      listener->listen_fd.fd = -1;
     }
 }
 
@@ -1310,6 +1512,16 @@ afsocket_sd_unregister_stats(AFSocketSourceDriver *self)
   stats_unlock();
 }
 
+static gboolean
+afsocket_sd_pre_config_init(LogPipe *s)
+{
+  AFSocketSourceDriver *self = (AFSocketSourceDriver *) s;
+
+  /* one thread for each dedicated peer, assuming a single connection per peer */
+  main_loop_worker_allocate_thread_space(g_list_length(self->dedicated_thread_peers));
+  return TRUE;
+}
+
 gboolean
 afsocket_sd_init_method(LogPipe *s)
 {
@@ -1321,6 +1533,12 @@ afsocket_sd_init_method(LogPipe *s)
   if (!afsocket_sd_setup_transport(self) || !afsocket_sd_setup_addresses(self))
     return FALSE;
 
+  if (self->num_listeners > 1)
+    {
+      /* the listeners share the same address, the kernel distributes the load between them */
+      self->socket_options->so_reuseport = TRUE;
+    }
+
   afsocket_sd_register_stats(self);
   afsocket_sd_dynamic_window_init(self);
   afsocket_sd_restore_kept_alive_connections(self);
@@ -1375,6 +1593,8 @@ afsocket_sd_free_method(LogPipe *s)
   socket_options_free(self->socket_options);
   g_sockaddr_unref(self->bind_addr);
   self->bind_addr = NULL;
+  g_free(self->listeners);
+  g_list_free_full(self->dedicated_thread_peers, g_free);
   log_src_driver_free(s);
 }
 
@@ -1386,6 +1606,7 @@ afsocket_sd_init_instance(AFSocketSourceDriver *self,
 {
   log_src_driver_init_instance(&self->super, cfg);
 
+  self->super.super.super.pre_config_init = afsocket_sd_pre_config_init;
   self->super.super.super.init = afsocket_sd_init_method;
   self->super.super.super.deinit = afsocket_sd_deinit_method;
   self->super.super.super.free_fn = afsocket_sd_free_method;
@@ -1396,6 +1617,7 @@ afsocket_sd_init_instance(AFSocketSourceDriver *self,
   self->transport_mapper = transport_mapper;
   atomic_gssize_set(&self->max_connections, 10);
   self->listen_backlog = 255;
+  self->num_listeners = 1;
   self->dynamic_window_stats_freq = DYNAMIC_WINDOW_TIMER_MSECS;
   self->dynamic_window_realloc_ticks = DYNAMIC_WINDOW_REALLOC_TICKS;
   self->connections_kept_alive_across_reloads = TRUE;
@@ -37,19 +37,29 @@
 
 typedef struct _AFSocketSourceDriver AFSocketSourceDriver;
 
+/* a listening socket of a SOCK_STREAM source, there is one per listeners() */
+typedef struct _AFSocketListener
+{
+  AFSocketSourceDriver *owner;
+  struct iv_fd listen_fd;
+  gint fd;
+} AFSocketListener;
+
 struct _AFSocketSourceDriver
 {
   LogSrcDriver super;
   guint32 connections_kept_alive_across_reloads:1,
           window_size_initialized:1,
           activate_listener:1;
-  struct iv_fd listen_fd;
+  AFSocketListener *listeners;
+  gint num_listeners;
   struct iv_timer dynamic_window_timer;
   gsize dynamic_window_size;
   gsize dynamic_window_timer_tick;
   glong dynamic_window_stats_freq;
   gint dynamic_window_realloc_ticks;
-  gint fd;
+  gsize dynamic_window_connection_min;
+  gsize dynamic_window_connection_max;
   LogReaderOptions reader_options;
   DynamicWindowPool *dynamic_window_pool;
   LogProtoServerFactory *proto_factory;
@@ -67,6 +77,8 @@ struct _AFSocketSourceDriver
   atomic_gssize max_connections;
   atomic_gssize num_connections;
   gint listen_backlog;
+  /* connections of these peers are read by threads of their own */
+  GList *dedicated_thread_peers;
   GList *connections;
   SocketOptions *socket_options;
   TransportMapper *transport_mapper;
@@ -90,9 +102,13 @@ struct _AFSocketSourceDriver
 void afsocket_sd_set_keep_alive(LogDriver *self, gint enable);
 void afsocket_sd_set_max_connections(LogDriver *self, gint max_connections);
 void afsocket_sd_set_listen_backlog(LogDriver *self, gint listen_backlog);
+void afsocket_sd_set_listeners(LogDriver *self, gint num_listeners);
+void afsocket_sd_set_dedicated_thread_peers(LogDriver *self, GList *peers);
 void afsocket_sd_set_dynamic_window_size(LogDriver *self, gint dynamic_window_size);
 void afsocket_sd_set_dynamic_window_stats_freq(LogDriver *self, gdouble stats_freq);
 void afsocket_sd_set_dynamic_window_realloc_ticks(LogDriver *self, gint realloc_ticks);
+void afsocket_sd_set_dynamic_window_connection_min(LogDriver *self, gint connection_min);
+void afsocket_sd_set_dynamic_window_connection_max(LogDriver *self, gint connection_max);
 
 static inline gboolean
 afsocket_sd_acquire_socket(AFSocketSourceDriver *s, gint *fd)
@@ -113,6 +129,7 @@ gboolean afsocket_sd_setup_addresses_method(AFSocketSourceDriver *self);
 
 gboolean afsocket_sd_init_method(LogPipe *s);
 gboolean afsocket_sd_deinit_method(LogPipe *s);
+const gchar *afsocket_sd_format_session_ticket_keys_name(const AFSocketSourceDriver *self);
 void afsocket_sd_free_method(LogPipe *self);
 
 void afsocket_sd_init_instance(AFSocketSourceDriver *self, SocketOptions *socket_options,
@@ -123,6 +123,7 @@ afunix_sd_init(LogPipe *s)
   afunix_sd_propagate_legacy_pass_unix_credentials_option(self, cfg);
 
   file_perm_options_inherit_dont_change(&self->file_perm_options);
+  transport_mapper_unix_setup_receive_buffer(self->super.transport_mapper, self->super.socket_options);
 
   return afsocket_sd_init_method(s) &&
          afunix_sd_apply_perms_to_socket(self);
@@ -119,7 +119,7 @@ systemd_syslog_sd_init_method(LogPipe *s)
       socket_options_init_instance(self->super.socket_options);
     }
 
-
+  transport_mapper_unix_setup_receive_buffer(self->super.transport_mapper, self->super.socket_options);
 
   return afsocket_sd_init_method((LogPipe *) &self->super);
 }
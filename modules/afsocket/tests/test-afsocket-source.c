@@ -0,0 +1,335 @@
+/*
+ * Copyright (c) 2024 One Identity LLC.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#include <criterion/criterion.h>
+#include "libtest/cr_template.h"
+#include "libtest/config_parse_lib.h"
+
+/* the listeners and the connections of the driver are checked from the inside */
+#include "afsocket-source.c"
+#include "apphook.h"
+#include "cfg.h"
+#include "mainloop-worker.h"
+
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+static gint port;
+
+/* NOTE: the port is released right away, it is bound again by the listeners */
+static gint
+_find_free_port(gint sock_type)
+{
+  struct sockaddr_in addr = { .sin_family = AF_INET, .sin_addr.s_addr = htonl(INADDR_LOOPBACK) };
+  socklen_t len = sizeof(addr);
+  gint fd = socket(AF_INET, sock_type, 0);
+
+  cr_assert_geq(fd, 0);
+  cr_assert_eq(bind(fd, (struct sockaddr *) &addr, sizeof(addr)), 0);
+  cr_assert_eq(getsockname(fd, (struct sockaddr *) &addr, &len), 0);
+  close(fd);
+  return ntohs(addr.sin_port);
+}
+
+static AFSocketSourceDriver *
+_create_source(const gchar *transport, const gchar *options)
+{
+  AFSocketSourceDriver *driver = NULL;
+  gchar *expr = g_strdup_printf("network(ip(\"127.0.0.1\") port(%d) transport(\"%s\") %s)", port, transport, options);
+
+  cr_assert(parse_config(expr, LL_CONTEXT_SOURCE, NULL, (gpointer *) &driver), "parsing failed: %s", expr);
+  g_free(expr);
+  return driver;
+}
+
+static AFSocketSourceDriver *
+_init_source(const gchar *transport, const gchar *options)
+{
+  AFSocketSourceDriver *driver = _create_source(transport, options);
+
+  cr_assert(log_pipe_init(&driver->super.super.super));
+  return driver;
+}
+
+static void
+_free_source(AFSocketSourceDriver *driver)
+{
+  cr_assert(log_pipe_deinit(&driver->super.super.super));
+  log_pipe_unref(&driver->super.super.super);
+}
+
+static gint
+_get_socket_option(gint fd, gint option)
+{
+  gint value = 0;
+  socklen_t len = sizeof(value);
+
+  cr_assert_eq(getsockopt(fd, SOL_SOCKET, option, &value, &len), 0);
+  return value;
+}
+
+static gint
+_get_local_port(gint fd)
+{
+  struct sockaddr_in addr;
+  socklen_t len = sizeof(addr);
+
+  cr_assert_eq(getsockname(fd, (struct sockaddr *) &addr, &len), 0);
+  return ntohs(addr.sin_port);
+}
+
+static gint
+_get_connection_fd(AFSocketSourceDriver *driver, gint index)
+{
+  AFSocketSourceConnection *sc = g_list_nth_data(driver->connections, index);
+
+  cr_assert_not_null(sc);
+  return sc->sock;
+}
+
+static gboolean
+_has_connection_fd(AFSocketSourceDriver *driver, gint fd)
+{
+  for (GList *l = driver->connections; l; l = l->next)
+    {
+      if (((AFSocketSourceConnection *) l->data)->sock == fd)
+        return TRUE;
+    }
+  return FALSE;
+}
+
+static void
+_assert_shared_socket(gint fd)
+{
+  cr_assert_geq(fd, 0);
+  cr_assert(_get_socket_option(fd, SO_REUSEPORT), "SO_REUSEPORT is not set on fd %d", fd);
+  cr_assert_eq(_get_local_port(fd), port, "the listener is not bound to the shared address");
+}
+
+Test(afsocket_source, test_stream_listeners_share_the_address_with_so_reuseport)
+{
+  port = _find_free_port(SOCK_STREAM);
+  AFSocketSourceDriver *driver = _init_source("tcp", "listeners(3)");
+
+  cr_assert_eq(driver->num_listeners, 3);
+  cr_assert(driver->socket_options->so_reuseport);
+  for (gint i = 0; i < 3; i++)
+    {
+      AFSocketListener *listener = &driver->listeners[i];
+
+      _assert_shared_socket(listener->fd);
+      cr_assert(_get_socket_option(listener->fd, SO_ACCEPTCONN), "listener #%d is not listening", i);
+      cr_assert_eq(listener->listen_fd.fd, listener->fd);
+      cr_assert(iv_fd_registered(&listener->listen_fd), "listener #%d is not watched for connections", i);
+      cr_assert_eq(listener->listen_fd.cookie, listener);
+
+      for (gint j = 0; j < i; j++)
+        cr_assert_neq(listener->fd, driver->listeners[j].fd, "listeners #%d and #%d share a socket", j, i);
+    }
+
+  _free_source(driver);
+}
+
+Test(afsocket_source, test_a_single_listener_does_not_set_so_reuseport)
+{
+  port = _find_free_port(SOCK_STREAM);
+  AFSocketSourceDriver *driver = _init_source("tcp", "");
+
+  cr_assert_eq(driver->num_listeners, 1);
+  cr_assert_not(driver->socket_options->so_reuseport);
+  cr_assert_not(_get_socket_option(driver->listeners[0].fd, SO_REUSEPORT));
+
+  _free_source(driver);
+}
+
+Test(afsocket_source, test_dgram_listeners_get_a_connection_each)
+{
+  port = _find_free_port(SOCK_DGRAM);
+  AFSocketSourceDriver *driver = _init_source("udp", "listeners(3) max-connections(2)");
+
+  /* max-connections() does not limit the per listener connections */
+  cr_assert_eq(g_list_length(driver->connections), 3);
+  for (gint i = 0; i < 3; i++)
+    {
+      _assert_shared_socket(_get_connection_fd(driver, i));
+      for (gint j = 0; j < i; j++)
+        cr_assert_neq(_get_connection_fd(driver, i), _get_connection_fd(driver, j));
+    }
+
+  _free_source(driver);
+}
+
+Test(afsocket_source, test_listener_persist_names_are_indexed)
+{
+  port = _find_free_port(SOCK_STREAM);
+  AFSocketSourceDriver *driver = _create_source("tcp", "listeners(2)");
+  cr_assert(afsocket_sd_setup_transport(driver));
+  cr_assert(afsocket_sd_setup_addresses(driver));
+
+  gchar *first = g_strdup(afsocket_sd_format_listener_name(driver, 0));
+  gchar *expected = g_strdup_printf("%s.listen_fd", afsocket_sd_format_name(&driver->super.super.super));
+
+  /* the first listener keeps the name used before listeners() */
+  cr_assert_str_eq(first, expected);
+  g_free(expected);
+
+  expected = g_strdup_printf("%s.1", first);
+  cr_assert_str_eq(afsocket_sd_format_listener_name(driver, 1), expected);
+  g_free(expected);
+  g_free(first);
+
+  log_pipe_unref(&driver->super.super.super);
+}
+
+Test(afsocket_source, test_stream_listeners_are_kept_across_reloads)
+{
+  port = _find_free_port(SOCK_STREAM);
+  configuration->persist = persist_config_new();
+
+  AFSocketSourceDriver *driver = _init_source("tcp", "listeners(2)");
+  gint fds[] = { driver->listeners[0].fd, driver->listeners[1].fd };
+  _free_source(driver);
+
+  driver = _init_source("tcp", "listeners(2)");
+  for (gint i = 0; i < 2; i++)
+    cr_assert_eq(driver->listeners[i].fd, fds[i], "listener #%d is not restored from the persist config", i);
+  _free_source(driver);
+
+  /* closes the listeners saved by the last deinit */
+  persist_config_free(configuration->persist);
+  configuration->persist = NULL;
+}
+
+Test(afsocket_source, test_dgram_listeners_are_added_to_the_kept_alive_connections)
+{
+  port = _find_free_port(SOCK_DGRAM);
+  configuration->persist = persist_config_new();
+
+  AFSocketSourceDriver *driver = _init_source("udp", "listeners(2)");
+  gint fds[] = { _get_connection_fd(driver, 0), _get_connection_fd(driver, 1) };
+  _free_source(driver);
+
+  driver = _init_source("udp", "listeners(3)");
+  cr_assert_eq(g_list_length(driver->connections), 3);
+  for (gint i = 0; i < 2; i++)
+    cr_assert(_has_connection_fd(driver, fds[i]), "connection #%d is not kept alive", i);
+
+  /* only the missing listener is opened, new connections are prepended */
+  gint new_fd = _get_connection_fd(driver, 0);
+  cr_assert(new_fd != fds[0] && new_fd != fds[1]);
+  _assert_shared_socket(new_fd);
+  _free_source(driver);
+
+  persist_config_free(configuration->persist);
+  configuration->persist = NULL;
+}
+
+static gint
+_connect_client(void)
+{
+  struct sockaddr_in addr =
+  {
+    .sin_family = AF_INET,
+    .sin_addr.s_addr = htonl(INADDR_LOOPBACK),
+    .sin_port = htons(port),
+  };
+  gint fd = socket(AF_INET, SOCK_STREAM, 0);
+
+  cr_assert_geq(fd, 0);
+  cr_assert_eq(connect(fd, (struct sockaddr *) &addr, sizeof(addr)), 0);
+  return fd;
+}
+
+/* accepts a single client, just like the main loop would when the listener becomes readable */
+static LogReader *
+_accept_client(AFSocketSourceDriver *driver, gint client_fd)
+{
+  AFSocketListener *listener = &driver->listeners[0];
+
+  listener->listen_fd.handler_in(listener->listen_fd.cookie);
+  cr_assert_eq(g_list_length(driver->connections), 1, "the client is not accepted");
+
+  AFSocketSourceConnection *sc = driver->connections->data;
+  return sc->reader;
+}
+
+Test(afsocket_source, test_dedicated_thread_peers_reserve_thread_space)
+{
+  port = _find_free_port(SOCK_STREAM);
+  AFSocketSourceDriver *driver = _create_source("tcp", "dedicated-thread-peers(\"127.0.0.1\" \"10.1.2.3\")");
+
+  cr_assert_eq(g_list_length(driver->dedicated_thread_peers), 2);
+
+  main_loop_worker_finalize_thread_space();
+  gint max_threads = main_loop_worker_get_max_number_of_threads();
+
+  cr_assert(log_pipe_pre_config_init(&driver->super.super.super));
+  main_loop_worker_finalize_thread_space();
+  cr_assert_eq(main_loop_worker_get_max_number_of_threads(), max_threads + 2);
+
+  log_pipe_unref(&driver->super.super.super);
+}
+
+Test(afsocket_source, test_connections_of_dedicated_thread_peers_get_a_worker_of_their_own)
+{
+  port = _find_free_port(SOCK_STREAM);
+  AFSocketSourceDriver *driver = _init_source("tcp", "dedicated-thread-peers(\"127.0.0.1\")");
+  gint client_fd = _connect_client();
+
+  LogReader *reader = _accept_client(driver, client_fd);
+  cr_assert(reader->dedicated_thread);
+  cr_assert_not_null(reader->dedicated_worker);
+
+  _free_source(driver);
+  close(client_fd);
+}
+
+Test(afsocket_source, test_connections_of_other_peers_use_the_shared_workers)
+{
+  port = _find_free_port(SOCK_STREAM);
+  AFSocketSourceDriver *driver = _init_source("tcp", "dedicated-thread-peers(\"10.1.2.3\")");
+  gint client_fd = _connect_client();
+
+  LogReader *reader = _accept_client(driver, client_fd);
+  cr_assert_not(reader->dedicated_thread);
+  cr_assert_null(reader->dedicated_worker);
+
+  _free_source(driver);
+  close(client_fd);
+}
+
+static void
+setup(void)
+{
+  app_startup();
+  configuration = cfg_new_snippet();
+  cfg_load_module(configuration, "afsocket");
+}
+
+static void
+teardown(void)
+{
+  cfg_free(configuration);
+  app_shutdown();
+}
+
+TestSuite(afsocket_source, .init = setup, .fini = teardown);
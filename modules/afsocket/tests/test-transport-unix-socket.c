@@ -0,0 +1,162 @@
+/*
+ * Copyright (c) 2024 One Identity LLC.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#include <criterion/criterion.h>
+
+#include "transport-unix-socket.h"
+#include "compat-unix-creds.h"
+#include "fdhelpers.h"
+#include "apphook.h"
+
+#include <sys/socket.h>
+#include <errno.h>
+#include <unistd.h>
+
+static gint server_fd = -1;
+static gint client_fd = -1;
+
+static void
+_send_datagram(const gchar *payload)
+{
+  cr_assert_eq(send(client_fd, payload, strlen(payload), 0), strlen(payload));
+}
+
+static void
+_find_pid(const gchar *name, const gchar *value, gsize value_len, gpointer user_data)
+{
+  gchar **pid = (gchar **) user_data;
+
+  if (strcmp(name, ".unix.pid") == 0)
+    *pid = g_strndup(value, value_len);
+}
+
+static void
+_assert_datagram(LogTransport *transport, const gchar *expected)
+{
+  LogTransportAuxData aux;
+  gchar buf[128];
+
+  log_transport_aux_data_init(&aux);
+  gssize rc = log_transport_read(transport, buf, sizeof(buf), &aux);
+
+  cr_assert_eq(rc, strlen(expected));
+  cr_assert(memcmp(buf, expected, rc) == 0);
+
+#if defined(CRED_PASS_SUPPORTED)
+  gchar *pid = NULL;
+  gchar *expected_pid = g_strdup_printf("%d", (gint) getpid());
+
+  log_transport_aux_data_foreach(&aux, _find_pid, &pid);
+  cr_assert_str_eq(pid, expected_pid, "credentials are not extracted for datagram: %s", expected);
+  g_free(expected_pid);
+  g_free(pid);
+#endif
+  log_transport_aux_data_destroy(&aux);
+}
+
+static void
+_assert_no_more_datagrams(LogTransport *transport)
+{
+  gchar buf[128];
+
+  cr_assert_not(log_transport_has_pending_input(transport));
+  cr_assert_eq(log_transport_read(transport, buf, sizeof(buf), NULL), -1);
+  cr_assert_eq(errno, EAGAIN);
+}
+
+Test(transport_unix_socket, test_dgram_datagrams_are_returned_one_by_one)
+{
+  LogTransport *transport = log_transport_unix_dgram_socket_new(server_fd);
+
+  _send_datagram("foo");
+  _send_datagram("bar");
+
+  _assert_datagram(transport, "foo");
+  _assert_datagram(transport, "bar");
+  _assert_no_more_datagrams(transport);
+  log_transport_free(transport);
+}
+
+#ifdef SYSLOG_NG_HAVE_RECVMMSG
+
+Test(transport_unix_socket, test_batched_datagrams_carry_their_own_credentials)
+{
+  LogTransport *transport = log_transport_unix_dgram_socket_new(server_fd);
+  log_transport_unix_dgram_socket_set_receive_batch_size(transport, 2, 0);
+
+  _send_datagram("msg1");
+  _send_datagram("");
+  _send_datagram("msg2");
+  _send_datagram("msg3");
+
+  _assert_datagram(transport, "msg1");
+  cr_assert(log_transport_has_pending_input(transport));
+  _assert_datagram(transport, "msg2");
+  _assert_datagram(transport, "msg3");
+  _assert_no_more_datagrams(transport);
+  log_transport_free(transport);
+}
+
+Test(transport_unix_socket, test_full_batches_grow_the_receive_buffer)
+{
+  gint rcvbuf = 4096, initial, grown;
+  socklen_t len = sizeof(gint);
+
+  cr_assert_eq(setsockopt(server_fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf)), 0);
+  cr_assert_eq(getsockopt(server_fd, SOL_SOCKET, SO_RCVBUF, &initial, &len), 0);
+
+  LogTransport *transport = log_transport_unix_dgram_socket_new(server_fd);
+  log_transport_unix_dgram_socket_set_receive_batch_size(transport, 2, 1024 * 1024);
+
+  _send_datagram("msg1");
+  _send_datagram("msg2");
+  _assert_datagram(transport, "msg1");
+  _assert_datagram(transport, "msg2");
+
+  cr_assert_eq(getsockopt(server_fd, SOL_SOCKET, SO_RCVBUF, &grown, &len), 0);
+  cr_assert_gt(grown, initial);
+  log_transport_free(transport);
+}
+
+#endif
+
+static void
+setup(void)
+{
+  gint fds[2];
+
+  app_startup();
+  cr_assert_eq(socketpair(AF_UNIX, SOCK_DGRAM, 0, fds), 0);
+  server_fd = fds[0];
+  client_fd = fds[1];
+  g_fd_set_nonblock(server_fd, TRUE);
+  setsockopt_so_passcred(server_fd, TRUE);
+}
+
+static void
+teardown(void)
+{
+  close(client_fd);
+  app_shutdown();
+}
+
+TestSuite(transport_unix_socket, .init = setup, .fini = teardown);
@@ -134,7 +134,12 @@ _construct_plain_tcp_transport(TransportMapperInet *self, gint fd)
     return _construct_multitransport_with_plain_tcp_factory(self, fd);
 
   if (self->super.sock_type == SOCK_DGRAM)
-    return log_transport_udp_socket_new(fd);
+    {
+      LogTransport *transport = log_transport_udp_socket_new(fd);
+
+      log_transport_udp_socket_set_receive_batch_size(transport, self->receive_batch_size);
+      return transport;
+    }
   else
     return log_transport_stream_socket_new(fd);
 }
@@ -39,6 +39,8 @@ typedef struct _TransportMapperInet
   TLSContext *tls_context;
   TLSVerifier *tls_verifier;
   gpointer secret_store_cb_data;
+  /* number of UDP datagrams received with a single recvmmsg() call */
+  gint receive_batch_size;
 } TransportMapperInet;
 
 static inline void
@@ -77,6 +79,12 @@ transport_mapper_inet_set_tls_context(TransportMapperInet *self, TLSContext *tls
   self->tls_context = tls_context;
 }
 
+static inline void
+transport_mapper_inet_set_receive_batch_size(TransportMapperInet *self, gint receive_batch_size)
+{
+  self->receive_batch_size = receive_batch_size;
+}
+
 static inline void
 transport_mapper_inet_set_tls_verifier(TransportMapperInet *self, TLSVerifier *tls_verifier)
 {
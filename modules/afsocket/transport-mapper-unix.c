@@ -23,22 +23,38 @@
 #include "transport-mapper-unix.h"
 #include "transport-unix-socket.h"
 #include "stats/stats-registry.h"
+#include "messages.h"
 
 #include <sys/types.h>
 #include <sys/socket.h>
 #include <sys/un.h>
 
 
+/* the receive buffer of unix-dgram sockets is grown up to this size, unless
+ * so-rcvbuf() is set explicitly */
+#define UNIX_DGRAM_ADAPTIVE_RCVBUF_MAX (8 * 1024 * 1024)
+
 struct _TransportMapperUnix
 {
   TransportMapper super;
+  /* number of datagrams received with a single recvmmsg() call */
+  gint receive_batch_size;
+  gint receive_buffer_max;
 };
 
 static LogTransport *
 _construct_log_transport(TransportMapper *s, gint fd)
 {
+  TransportMapperUnix *self = (TransportMapperUnix *) s;
+
   if (s->sock_type == SOCK_DGRAM)
-    return log_transport_unix_dgram_socket_new(fd);
+    {
+      LogTransport *transport = log_transport_unix_dgram_socket_new(fd);
+
+      log_transport_unix_dgram_socket_set_receive_batch_size(transport, self->receive_batch_size,
+                                                             self->receive_buffer_max);
+      return transport;
+    }
   else
     return log_transport_unix_stream_socket_new(fd);
 }
@@ -55,6 +71,27 @@ transport_mapper_unix_new_instance(const gchar *transport, gint sock_type)
   return self;
 }
 
+void
+transport_mapper_unix_set_receive_batch_size(TransportMapper *s, gint receive_batch_size)
+{
+  TransportMapperUnix *self = (TransportMapperUnix *) s;
+
+#ifndef SYSLOG_NG_HAVE_RECVMMSG
+  if (receive_batch_size > 1)
+    msg_warning("WARNING: receive-batch-size() is not supported on this platform, datagrams are received one by one");
+#endif
+  self->receive_batch_size = receive_batch_size;
+}
+
+/* grow SO_RCVBUF on demand, unless the user has sized it */
+void
+transport_mapper_unix_setup_receive_buffer(TransportMapper *s, SocketOptions *socket_options)
+{
+  TransportMapperUnix *self = (TransportMapperUnix *) s;
+
+  self->receive_buffer_max = socket_options->so_rcvbuf ? 0 : UNIX_DGRAM_ADAPTIVE_RCVBUF_MAX;
+}
+
 TransportMapper *
 transport_mapper_unix_dgram_new(void)
 {
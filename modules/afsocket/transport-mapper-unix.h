@@ -30,4 +30,7 @@ typedef struct _TransportMapperUnix TransportMapperUnix;
 TransportMapper *transport_mapper_unix_dgram_new(void);
 TransportMapper *transport_mapper_unix_stream_new(void);
 
+void transport_mapper_unix_set_receive_batch_size(TransportMapper *s, gint receive_batch_size);
+void transport_mapper_unix_setup_receive_buffer(TransportMapper *s, SocketOptions *socket_options);
+
 #endif
@@ -26,6 +26,8 @@
 #include "scratch-buffers.h"
 #include "str-format.h"
 #include "compat-unix-creds.h"
+#include "timeutils/cache.h"
+#include "messages.h"
 
 #include <sys/types.h>
 #include <sys/stat.h>
@@ -101,9 +103,8 @@ _read_text_file_content_without_trailing_newline(const gchar *filename, gchar *b
 }
 
 
-static void G_GNUC_UNUSED
-_add_nv_pair_proc_read_unless_unset(LogTransportAuxData *aux, const gchar *name, pid_t pid, const gchar *proc_file,
-                                    const gchar *unset_value)
+static gchar * G_GNUC_UNUSED
+_proc_read_unless_unset(pid_t pid, const gchar *proc_file, const gchar *unset_value)
 {
   gchar filename[64];
   gchar content[4096];
@@ -112,11 +113,12 @@ _add_nv_pair_proc_read_unless_unset(LogTransportAuxData *aux, const gchar *name,
   _format_proc_file_name(filename, sizeof(filename), pid, proc_file);
   content_len = _read_text_file_content_without_trailing_newline(filename, content, sizeof(content));
   if (content_len > 0 && (!unset_value || strcmp(content, unset_value) != 0))
-    log_transport_aux_data_add_nv_pair(aux, name, content);
+    return g_strdup(content);
+  return NULL;
 }
 
-static void G_GNUC_UNUSED
-_add_nv_pair_proc_read_argv(LogTransportAuxData *aux, const gchar *name, pid_t pid, const gchar *proc_file)
+static gchar * G_GNUC_UNUSED
+_proc_read_argv(pid_t pid, const gchar *proc_file)
 {
   gchar filename[64];
   gchar content[4096];
@@ -132,11 +134,12 @@ _add_nv_pair_proc_read_argv(LogTransportAuxData *aux, const gchar *name, pid_t p
         content[i] = ' ';
     }
   if (content_len > 0)
-    log_transport_aux_data_add_nv_pair(aux, name, content);
+    return g_strdup(content);
+  return NULL;
 }
 
-static void G_GNUC_UNUSED
-_add_nv_pair_proc_readlink(LogTransportAuxData *aux, const gchar *name, pid_t pid, const gchar *proc_file)
+static gchar * G_GNUC_UNUSED
+_proc_readlink(pid_t pid, const gchar *proc_file)
 {
   gchar filename[64];
   gchar content[4096];
@@ -149,10 +152,76 @@ _add_nv_pair_proc_readlink(LogTransportAuxData *aux, const gchar *name, pid_t pi
       if (content_len == sizeof(content))
         content_len--;
       content[content_len] = 0;
-      log_transport_aux_data_add_nv_pair(aux, name, content);
+      return g_strdup(content);
     }
+  return NULL;
+}
+
+/*
+ * The /proc based information of the sending process (4 files on Linux)
+ * is cached by PID, as local senders usually emit bursts of messages.  The
+ * entries expire after UNIX_PROC_INFO_TTL seconds, which bounds the time
+ * a recycled PID or an exec() in the sender can produce stale values.
+ */
+#define UNIX_PROC_INFO_TTL 1
+#define UNIX_PROC_INFO_CACHE_MAX 1024
+
+typedef struct _UnixProcInfo
+{
+  time_t fetched;
+  gchar *cmdline;
+  gchar *exe;
+  gchar *auid;
+  gchar *ses;
+} UnixProcInfo;
+
+static void
+_proc_info_free(UnixProcInfo *self)
+{
+  g_free(self->cmdline);
+  g_free(self->exe);
+  g_free(self->auid);
+  g_free(self->ses);
+  g_free(self);
 }
 
+#define UNIX_RECEIVE_BATCH_CTLBUF_SIZE 64
+
+typedef struct _UnixReceiveBatchSlot
+{
+  struct iovec iov;
+  struct sockaddr_storage peer_addr;
+#if defined(SYSLOG_NG_HAVE_CTRLBUF_IN_MSGHDR)
+  gchar ctlbuf[UNIX_RECEIVE_BATCH_CTLBUF_SIZE];
+#endif
+} UnixReceiveBatchSlot;
+
+typedef struct _LogTransportUnix
+{
+  LogTransportSocket super;
+  GHashTable *proc_info_cache;
+
+  /* datagrams received by a single recvmmsg() call, delivered one by one
+   * to the LogProto layer by subsequent read() calls */
+  struct
+  {
+    gint size;
+    gint received;
+    gint next;
+    gsize slot_size;
+    gchar *buffer;
+    struct mmsghdr *msgs;
+    UnixReceiveBatchSlot *slots;
+  } receive_batch;
+
+  /* SO_RCVBUF is doubled (up to max) whenever a batch comes back full */
+  struct
+  {
+    gint current;
+    gint max;
+  } receive_buffer;
+} LogTransportUnix;
+
 #if defined (CRED_PASS_SUPPORTED)
 static void
 _feed_aux_from_ucred(LogTransportAuxData *aux, cred_t *uc)
@@ -165,27 +234,71 @@ _feed_aux_from_ucred(LogTransportAuxData *aux, cred_t *uc)
 
 #if defined(__linux__) && defined(CRED_PASS_SUPPORTED)
 static void
-_feed_aux_from_procfs(LogTransportAuxData *aux, pid_t pid)
+_proc_info_fetch(UnixProcInfo *info, pid_t pid)
 {
-  _add_nv_pair_proc_read_argv(aux, ".unix.cmdline", pid, "cmdline");
-  _add_nv_pair_proc_readlink(aux, ".unix.exe", pid, "exe");
+  info->cmdline = _proc_read_argv(pid, "cmdline");
+  info->exe = _proc_readlink(pid, "exe");
   /* NOTE: we use the names the audit subsystem does, so if in the future we'd be
    * processing audit records, the nvpair names would match up. */
-  _add_nv_pair_proc_read_unless_unset(aux, ".audit.auid", pid, "loginuid", "4294967295");
-  _add_nv_pair_proc_read_unless_unset(aux, ".audit.ses", pid, "sessionid", "4294967295");
+  info->auid = _proc_read_unless_unset(pid, "loginuid", "4294967295");
+  info->ses = _proc_read_unless_unset(pid, "sessionid", "4294967295");
 }
 
 #elif defined(__FreeBSD__) && defined(CRED_PASS_SUPPORTED)
 static void
-_feed_aux_from_procfs(LogTransportAuxData *aux, pid_t pid)
+_proc_info_fetch(UnixProcInfo *info, pid_t pid)
+{
+  info->cmdline = _proc_read_argv(pid, "cmdline");
+  info->exe = _proc_readlink(pid, "file");
+}
+#endif
+
+#if defined(CRED_PASS_SUPPORTED)
+static UnixProcInfo *
+_lookup_proc_info(LogTransportUnix *self, pid_t pid)
+{
+  time_t now = cached_g_current_time_sec();
+  UnixProcInfo *info;
+
+  if (!self->proc_info_cache)
+    self->proc_info_cache = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL,
+                                                  (GDestroyNotify) _proc_info_free);
+
+  info = g_hash_table_lookup(self->proc_info_cache, GINT_TO_POINTER(pid));
+  if (info && now - info->fetched < UNIX_PROC_INFO_TTL)
+    return info;
+
+  if (!info && g_hash_table_size(self->proc_info_cache) >= UNIX_PROC_INFO_CACHE_MAX)
+    g_hash_table_remove_all(self->proc_info_cache);
+
+  info = g_new0(UnixProcInfo, 1);
+  info->fetched = now;
+  _proc_info_fetch(info, pid);
+  g_hash_table_replace(self->proc_info_cache, GINT_TO_POINTER(pid), info);
+  return info;
+}
+
+static void
+_add_nv_pair_unless_null(LogTransportAuxData *aux, const gchar *name, const gchar *value)
+{
+  if (value)
+    log_transport_aux_data_add_nv_pair(aux, name, value);
+}
+
+static void
+_feed_aux_from_procfs(LogTransportUnix *self, LogTransportAuxData *aux, pid_t pid)
 {
-  _add_nv_pair_proc_read_argv(aux, ".unix.cmdline", pid, "cmdline");
-  _add_nv_pair_proc_readlink(aux, ".unix.exe", pid, "file");
+  UnixProcInfo *info = _lookup_proc_info(self, pid);
+
+  _add_nv_pair_unless_null(aux, ".unix.cmdline", info->cmdline);
+  _add_nv_pair_unless_null(aux, ".unix.exe", info->exe);
+  _add_nv_pair_unless_null(aux, ".audit.auid", info->auid);
+  _add_nv_pair_unless_null(aux, ".audit.ses", info->ses);
 }
 #endif
 
 static void
-_feed_credentials_from_cmsg(LogTransportAuxData *aux, struct msghdr *msg)
+_feed_credentials_from_cmsg(LogTransportUnix *self, LogTransportAuxData *aux, struct msghdr *msg)
 {
 #if defined(CRED_PASS_SUPPORTED)
   struct cmsghdr *cmsg;
@@ -197,7 +310,7 @@ _feed_credentials_from_cmsg(LogTransportAuxData *aux, struct msghdr *msg)
         {
           memcpy(&uc, CMSG_DATA(cmsg), sizeof(uc));
 
-          _feed_aux_from_procfs(aux, cred_get(&uc, pid));
+          _feed_aux_from_procfs(self, aux, cred_get(&uc, pid));
           _feed_aux_from_ucred(aux, &uc);
           break;
         }
@@ -206,13 +319,20 @@ _feed_credentials_from_cmsg(LogTransportAuxData *aux, struct msghdr *msg)
 }
 
 static void
-_feed_aux_from_cmsg(LogTransportAuxData *aux, struct msghdr *msg)
+_feed_aux_from_msghdr(LogTransportUnix *self, LogTransportAuxData *aux, struct msghdr *msg)
 {
-  _feed_credentials_from_cmsg(aux, msg);
+  /* nobody is interested in the results, skip the /proc lookups */
+  if (!aux)
+    return;
+
+  if (msg->msg_namelen)
+    log_transport_aux_data_set_peer_addr_ref(aux, g_sockaddr_new((struct sockaddr *) msg->msg_name, msg->msg_namelen));
+
+  _feed_credentials_from_cmsg(self, aux, msg);
 }
 
 static gssize
-_unix_socket_read(gint fd, gpointer buf, gsize buflen, LogTransportAuxData *aux)
+_unix_socket_read(LogTransportUnix *self, gpointer buf, gsize buflen, LogTransportAuxData *aux)
 {
   gint rc;
   struct msghdr msg;
@@ -234,17 +354,12 @@ _unix_socket_read(gint fd, gpointer buf, gsize buflen, LogTransportAuxData *aux)
   iov[0].iov_len = buflen;
   do
     {
-      rc = recvmsg(fd, &msg, 0);
+      rc = recvmsg(self->super.super.fd, &msg, 0);
     }
   while (rc == -1 && errno == EINTR);
 
   if (rc >= 0)
-    {
-      if (msg.msg_namelen && aux)
-        log_transport_aux_data_set_peer_addr_ref(aux, g_sockaddr_new((struct sockaddr *) &ss, msg.msg_namelen));
-
-      _feed_aux_from_cmsg(aux, &msg);
-    }
+    _feed_aux_from_msghdr(self, aux, &msg);
 
   return rc;
 }
@@ -252,9 +367,10 @@ _unix_socket_read(gint fd, gpointer buf, gsize buflen, LogTransportAuxData *aux)
 static gssize
 log_transport_unix_dgram_socket_read_method(LogTransport *s, gpointer buf, gsize buflen, LogTransportAuxData *aux)
 {
+  LogTransportUnix *self = (LogTransportUnix *) s;
   gint rc;
 
-  rc = _unix_socket_read(s->fd, buf, buflen, aux);
+  rc = _unix_socket_read(self, buf, buflen, aux);
   if (rc == 0)
     {
       /* DGRAM sockets should never return EOF, they just need to be read again */
@@ -264,30 +380,247 @@ log_transport_unix_dgram_socket_read_method(LogTransport *s, gpointer buf, gsize
   return rc;
 }
 
+#ifdef SYSLOG_NG_HAVE_RECVMMSG
+
+static void
+_receive_buffer_grow(LogTransportUnix *self)
+{
+  gint fd = self->super.super.fd;
+  gint requested, actual;
+  socklen_t len = sizeof(actual);
+
+  if (self->receive_buffer.current >= self->receive_buffer.max)
+    return;
+
+  requested = MIN((gint64) self->receive_buffer.current * 2, self->receive_buffer.max);
+  if (setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &requested, sizeof(requested)) < 0 ||
+      getsockopt(fd, SOL_SOCKET, SO_RCVBUF, &actual, &len) < 0 ||
+      actual <= self->receive_buffer.current)
+    {
+      /* capped by the kernel (net.core.rmem_max on Linux), stop trying */
+      self->receive_buffer.max = 0;
+      return;
+    }
+
+  msg_debug("unix-dgram: receive batch is full, increasing the socket receive buffer",
+            evt_tag_int("fd", fd),
+            evt_tag_int("so_rcvbuf", actual));
+  self->receive_buffer.current = actual;
+}
+
+static void
+_receive_batch_alloc_buffer(LogTransportUnix *self, gsize buflen)
+{
+  if (self->receive_batch.slot_size >= buflen)
+    return;
+
+  g_free(self->receive_batch.buffer);
+  self->receive_batch.buffer = g_malloc(self->receive_batch.size * buflen);
+  self->receive_batch.slot_size = buflen;
+}
+
+static void
+_receive_batch_setup_msgs(LogTransportUnix *self)
+{
+  for (gint i = 0; i < self->receive_batch.size; i++)
+    {
+      UnixReceiveBatchSlot *slot = &self->receive_batch.slots[i];
+      struct msghdr *msg = &self->receive_batch.msgs[i].msg_hdr;
+
+      slot->iov.iov_base = self->receive_batch.buffer + i * self->receive_batch.slot_size;
+      slot->iov.iov_len = self->receive_batch.slot_size;
+
+      msg->msg_name = (struct sockaddr *) &slot->peer_addr;
+      msg->msg_namelen = sizeof(slot->peer_addr);
+      msg->msg_iov = &slot->iov;
+      msg->msg_iovlen = 1;
+#if defined(SYSLOG_NG_HAVE_CTRLBUF_IN_MSGHDR)
+      msg->msg_control = slot->ctlbuf;
+      msg->msg_controllen = sizeof(slot->ctlbuf);
+#endif
+      msg->msg_flags = 0;
+    }
+}
+
+static gint
+_receive_batch_fill(LogTransportUnix *self, gsize buflen)
+{
+  gint rc;
+
+  _receive_batch_alloc_buffer(self, buflen);
+  _receive_batch_setup_msgs(self);
+
+  do
+    {
+      rc = recvmmsg(self->super.super.fd, self->receive_batch.msgs, self->receive_batch.size, MSG_DONTWAIT, NULL);
+    }
+  while (rc == -1 && errno == EINTR);
+
+  if (rc <= 0)
+    return rc;
+
+  /* the socket had at least a full batch queued, senders are probably
+   * about to block on /dev/log */
+  if (rc == self->receive_batch.size)
+    _receive_buffer_grow(self);
+
+  self->receive_batch.received = rc;
+  self->receive_batch.next = 0;
+  return rc;
+}
+
+static gboolean
+log_transport_unix_dgram_socket_has_pending_input(LogTransport *s)
+{
+  LogTransportUnix *self = (LogTransportUnix *) s;
+
+  return self->receive_batch.next < self->receive_batch.received;
+}
+
+static gssize
+_receive_batch_pop(LogTransportUnix *self, gpointer buf, gsize buflen, LogTransportAuxData *aux)
+{
+  struct mmsghdr *mmsg = &self->receive_batch.msgs[self->receive_batch.next++];
+  gsize len = MIN(mmsg->msg_len, buflen);
+
+  memcpy(buf, mmsg->msg_hdr.msg_iov->iov_base, len);
+  _feed_aux_from_msghdr(self, aux, &mmsg->msg_hdr);
+  return len;
+}
+
+static gssize
+log_transport_unix_dgram_socket_read_batch_method(LogTransport *s, gpointer buf, gsize buflen,
+                                                  LogTransportAuxData *aux)
+{
+  LogTransportUnix *self = (LogTransportUnix *) s;
+  gssize rc;
+
+  do
+    {
+      if (!log_transport_unix_dgram_socket_has_pending_input(s))
+        {
+          rc = _receive_batch_fill(self, buflen);
+          if (rc <= 0)
+            {
+              /* DGRAM sockets should never return EOF, they just need to be read again */
+              if (rc == 0)
+                errno = EAGAIN;
+              return -1;
+            }
+        }
+
+      /* empty datagrams carry no message, skip them */
+      rc = _receive_batch_pop(self, buf, buflen, aux);
+    }
+  while (rc == 0);
+
+  return rc;
+}
+
+/*
+ * Switch the transport to receive up to @batch_size datagrams with a
+ * single recvmmsg() call, see log_transport_udp_socket_set_receive_batch_size().
+ *
+ * If @receive_buffer_max is non-zero, SO_RCVBUF of the socket is doubled
+ * every time a batch comes back full, until it reaches @receive_buffer_max
+ * or the limit imposed by the kernel.
+ *
+ * Must be called before the first read.
+ */
+void
+log_transport_unix_dgram_socket_set_receive_batch_size(LogTransport *s, gint batch_size, gint receive_buffer_max)
+{
+  LogTransportUnix *self = (LogTransportUnix *) s;
+  socklen_t len = sizeof(self->receive_buffer.current);
+
+  g_assert(!self->receive_batch.size);
+  if (batch_size <= 1)
+    return;
+
+  self->receive_batch.size = batch_size;
+  self->receive_batch.msgs = g_new0(struct mmsghdr, batch_size);
+  self->receive_batch.slots = g_new0(UnixReceiveBatchSlot, batch_size);
+
+  if (receive_buffer_max > 0 &&
+      getsockopt(s->fd, SOL_SOCKET, SO_RCVBUF, &self->receive_buffer.current, &len) == 0)
+    self->receive_buffer.max = receive_buffer_max;
+
+  self->super.super.read = log_transport_unix_dgram_socket_read_batch_method;
+  self->super.super.has_pending_input = log_transport_unix_dgram_socket_has_pending_input;
+}
+
+static void
+_receive_batch_free(LogTransportUnix *self)
+{
+  if (!self->receive_batch.size)
+    return;
+
+  g_free(self->receive_batch.buffer);
+  g_free(self->receive_batch.msgs);
+  g_free(self->receive_batch.slots);
+}
+
+#else
+
+void
+log_transport_unix_dgram_socket_set_receive_batch_size(LogTransport *s, gint batch_size, gint receive_buffer_max)
+{
+}
+
+#define _receive_batch_free(self)
+
+#endif
+
+static void
+log_transport_unix_socket_free(LogTransportUnix *self)
+{
+  if (self->proc_info_cache)
+    g_hash_table_destroy(self->proc_info_cache);
+}
+
+static void
+log_transport_unix_dgram_socket_free(LogTransport *s)
+{
+  LogTransportUnix *self = (LogTransportUnix *) s;
+
+  _receive_batch_free(self);
+  log_transport_unix_socket_free(self);
+  log_transport_free_method(s);
+}
+
 LogTransport *
 log_transport_unix_dgram_socket_new(gint fd)
 {
-  LogTransportSocket *self = g_new0(LogTransportSocket, 1);
+  LogTransportUnix *self = g_new0(LogTransportUnix, 1);
 
-  log_transport_dgram_socket_init_instance(self, fd);
-  self->super.read = log_transport_unix_dgram_socket_read_method;
+  log_transport_dgram_socket_init_instance(&self->super, fd);
+  self->super.super.read = log_transport_unix_dgram_socket_read_method;
+  self->super.super.free_fn = log_transport_unix_dgram_socket_free;
 
-  return &self->super;
+  return &self->super.super;
 }
 
 static gssize
 log_transport_unix_stream_socket_read_method(LogTransport *s, gpointer buf, gsize buflen, LogTransportAuxData *aux)
 {
-  return _unix_socket_read(s->fd, buf, buflen, aux);
+  return _unix_socket_read((LogTransportUnix *) s, buf, buflen, aux);
+}
+
+static void
+log_transport_unix_stream_socket_free(LogTransport *s)
+{
+  log_transport_unix_socket_free((LogTransportUnix *) s);
+  log_transport_stream_socket_free_method(s);
 }
 
 LogTransport *
 log_transport_unix_stream_socket_new(gint fd)
 {
-  LogTransportSocket *self = g_new0(LogTransportSocket, 1);
+  LogTransportUnix *self = g_new0(LogTransportUnix, 1);
 
-  log_transport_stream_socket_init_instance(self, fd);
-  self->super.read = log_transport_unix_stream_socket_read_method;
+  log_transport_stream_socket_init_instance(&self->super, fd);
+  self->super.super.read = log_transport_unix_stream_socket_read_method;
+  self->super.super.free_fn = log_transport_unix_stream_socket_free;
 
-  return &self->super;
+  return &self->super.super;
 }
@@ -28,5 +28,7 @@
 LogTransport *log_transport_unix_dgram_socket_new(gint fd);
 LogTransport *log_transport_unix_stream_socket_new(gint fd);
 
+void log_transport_unix_dgram_socket_set_receive_batch_size(LogTransport *s, gint batch_size, gint receive_buffer_max);
+
 
 #endif
@@ -45,6 +45,11 @@ static const char *s_freetds = "freetds";
 static dbi_inst dbi_instance;
 static const gint DEFAULT_SQL_TX_SIZE = 100;
 
+/* MSSQL refuses more than 1000 rows in a single VALUES list, MySQL is
+ * limited by max_allowed_packet */
+#define AFSQL_BULK_INSERT_MAX_ROWS 1000
+#define AFSQL_BULK_INSERT_MAX_STATEMENT_SIZE (1024 * 1024)
+
 #define MAX_FAILED_ATTEMPTS 3
 
 void
@@ -768,6 +773,14 @@ afsql_dd_connect(LogThreadedDestDriver *s)
   return TRUE;
 }
 
+static void
+afsql_dd_reset_bulk_insert(AFSqlDestDriver *self)
+{
+  g_string_truncate(self->bulk.table, 0);
+  g_string_truncate(self->bulk.statement, 0);
+  self->bulk.rows = 0;
+}
+
 static void
 afsql_dd_disconnect(LogThreadedDestDriver *s)
 {
@@ -775,6 +788,9 @@ afsql_dd_disconnect(LogThreadedDestDriver *s)
 
   dbi_conn_close(self->dbi_ctx);
   self->dbi_ctx = NULL;
+
+  /* the rows are rewound by the caller */
+  afsql_dd_reset_bulk_insert(self);
 }
 
 static GString *
@@ -903,63 +919,83 @@ afsql_dd_append_value_to_be_inserted(AFSqlDestDriver *self,
   return TRUE;
 }
 
-static GString *
-afsql_dd_build_insert_command(AFSqlDestDriver *self, LogMessage *msg, GString *table)
+static inline gboolean
+_is_field_inserted(const AFSqlField *field)
 {
-  GString *insert_command = g_string_sized_new(256);
-  GString *value = g_string_sized_new(512);
-  gint i, j;
+  return (field->flags & AFSQL_FF_DEFAULT) == 0 && field->value != NULL;
+}
 
-  g_string_printf(insert_command, "INSERT INTO %s%s%s (", self->quote_as_string, table->str, self->quote_as_string);
+/* the column list only depends on the table, so it is formatted once per table */
+static const gchar *
+afsql_dd_lookup_insert_prefix(AFSqlDestDriver *self, GString *table)
+{
+  gchar *prefix = g_hash_table_lookup(self->insert_prefixes, table->str);
 
-  for (i = 0; i < self->fields_len; i++)
-    {
-      if ((self->fields[i].flags & AFSQL_FF_DEFAULT) == 0 && self->fields[i].value != NULL)
-        {
-          g_string_append(insert_command, self->fields[i].name);
+  if (prefix)
+    return prefix;
 
-          j = i + 1;
-          while (j < self->fields_len && (self->fields[j].flags & AFSQL_FF_DEFAULT) == AFSQL_FF_DEFAULT)
-            j++;
+  GString *insert_prefix = g_string_sized_new(256);
+  gboolean comma_needed = FALSE;
 
-          if (j < self->fields_len)
-            g_string_append(insert_command, ", ");
-        }
+  g_string_printf(insert_prefix, "INSERT INTO %s%s%s (", self->quote_as_string, table->str, self->quote_as_string);
+  for (gint i = 0; i < self->fields_len; i++)
+    {
+      if (!_is_field_inserted(&self->fields[i]))
+        continue;
+
+      if (comma_needed)
+        g_string_append(insert_prefix, ", ");
+      g_string_append(insert_prefix, self->fields[i].name);
+      comma_needed = TRUE;
     }
+  g_string_append(insert_prefix, ") VALUES ");
 
-  g_string_append(insert_command, ") VALUES (");
+  prefix = g_string_free(insert_prefix, FALSE);
+  g_hash_table_insert(self->insert_prefixes, g_strdup(table->str), prefix);
+  return prefix;
+}
 
-  for (i = 0; i < self->fields_len; i++)
+static gboolean
+afsql_dd_append_row_values(AFSqlDestDriver *self, LogMessage *msg, GString *insert_command)
+{
+  GString *value = g_string_sized_new(512);
+  gboolean comma_needed = FALSE;
+  gboolean success = TRUE;
+
+  g_string_append_c(insert_command, '(');
+  for (gint i = 0; i < self->fields_len && success; i++)
     {
-      if ((self->fields[i].flags & AFSQL_FF_DEFAULT) == 0 && self->fields[i].value != NULL)
-        {
-          LogTemplateEvalOptions options = {&self->template_options, LTZ_SEND, self->super.worker.instance.seq_num, NULL, LM_VT_STRING};
-          LogMessageValueType type;
+      if (!_is_field_inserted(&self->fields[i]))
+        continue;
 
-          log_template_format_value_and_type(self->fields[i].value, msg, &options, value, &type);
+      LogTemplateEvalOptions options = {&self->template_options, LTZ_SEND, self->super.worker.instance.seq_num, NULL, LM_VT_STRING};
+      LogMessageValueType type;
 
-          if (!afsql_dd_append_value_to_be_inserted(self,
-                                                    &self->fields[i], value, type,
-                                                    insert_command))
-            goto drop;
+      log_template_format_value_and_type(self->fields[i].value, msg, &options, value, &type);
 
-          j = i + 1;
-          while (j < self->fields_len && (self->fields[j].flags & AFSQL_FF_DEFAULT) == AFSQL_FF_DEFAULT)
-            j++;
-          if (j < self->fields_len)
-            g_string_append(insert_command, ", ");
-        }
+      if (comma_needed)
+        g_string_append(insert_command, ", ");
+      success = afsql_dd_append_value_to_be_inserted(self, &self->fields[i], value, type, insert_command);
+      comma_needed = TRUE;
     }
+  g_string_append_c(insert_command, ')');
 
-  g_string_append(insert_command, ")");
   g_string_free(value, TRUE);
+  return success;
+}
 
-  return insert_command;
+static GString *
+afsql_dd_build_insert_command(AFSqlDestDriver *self, LogMessage *msg, GString *table)
+{
+  GString *insert_command = g_string_new(afsql_dd_lookup_insert_prefix(self, table));
 
-drop:
-  g_string_free(value, TRUE);
-  g_string_free(insert_command, TRUE);
-  return NULL;
+  if (!afsql_dd_append_row_values(self, msg, insert_command))
+    {
+      g_string_free(insert_command, TRUE);
+      return NULL;
+    }
+
+  return insert_command;
 }
 
 static inline gboolean
@@ -1015,20 +1051,113 @@ afsql_dd_handle_insert_row_error_depending_on_connection_availability(AFSqlDestD
   return LTR_ERROR;
 }
 
+static inline gboolean
+afsql_dd_is_bulk_insert_enabled(const AFSqlDestDriver *self)
+{
+  return !!(self->flags & AFSQL_DDF_BULK_INSERT);
+}
+
+static gboolean
+afsql_dd_flush_bulk_insert(AFSqlDestDriver *self)
+{
+  if (self->bulk.rows == 0)
+    return TRUE;
+
+  msg_debug("Running SQL bulk insert",
+            evt_tag_str("table", self->bulk.table->str),
+            evt_tag_int("rows", self->bulk.rows));
+
+  gboolean success = afsql_dd_run_query(self, self->bulk.statement->str, FALSE, NULL);
+  if (!success)
+    {
+      msg_warning("SQL bulk insert failed, inserting the rows of the batch one by one",
+                  evt_tag_str("table", self->bulk.table->str),
+                  evt_tag_int("rows", self->bulk.rows));
+      self->bulk.single_rows = TRUE;
+    }
+
+  afsql_dd_reset_bulk_insert(self);
+  return success;
+}
+
+static void
+afsql_dd_log_format_error(AFSqlDestDriver *self)
+{
+  if (self->template_options.on_error & ON_ERROR_SILENT)
+    return;
+
+  msg_error("Failed to format message for SQL, dropping message",
+            evt_tag_str("type", self->type),
+            evt_tag_str("host", self->host),
+            evt_tag_str("port", self->port),
+            evt_tag_str("username", self->user),
+            evt_tag_str("database", self->database),
+            evt_tag_str("error", "error converting name-value pair to the requested type"));
+}
+
+/*
+ * flags(bulk-insert): the rows of a batch are collected into a single
+ * multi-row INSERT per table, which is run when the batch is flushed, the
+ * table changes or the statement grows too large.  If a bulk insert fails,
+ * the batch is rewound and retried row by row, so a single bad row does
+ * not keep failing the whole batch.
+ */
+static LogThreadedResult
+afsql_dd_queue_bulk_insert_row(AFSqlDestDriver *self, GString *table, LogMessage *msg)
+{
+  if (self->bulk.rows > 0 && strcmp(self->bulk.table->str, table->str) != 0 &&
+      !afsql_dd_flush_bulk_insert(self))
+    return afsql_dd_handle_insert_row_error_depending_on_connection_availability(self);
+
+  gsize statement_len = self->bulk.statement->len;
+
+  if (self->bulk.rows == 0)
+    {
+      g_string_assign(self->bulk.table, table->str);
+      g_string_assign(self->bulk.statement, afsql_dd_lookup_insert_prefix(self, table));
+    }
+  else
+    {
+      g_string_append(self->bulk.statement, ", ");
+    }
+
+  if (!afsql_dd_append_row_values(self, msg, self->bulk.statement))
+    {
+      g_string_truncate(self->bulk.statement, statement_len);
+      afsql_dd_log_format_error(self);
+      return LTR_DROP;
+    }
+  self->bulk.rows++;
+
+  if ((self->bulk.rows >= AFSQL_BULK_INSERT_MAX_ROWS ||
+       self->bulk.statement->len >= AFSQL_BULK_INSERT_MAX_STATEMENT_SIZE) &&
+      !afsql_dd_flush_bulk_insert(self))
+    return afsql_dd_handle_insert_row_error_depending_on_connection_availability(self);
+
+  return LTR_QUEUED;
+}
+
 static LogThreadedResult
 afsql_dd_flush(LogThreadedDestDriver *s)
 {
   AFSqlDestDriver *self = (AFSqlDestDriver *) s;
 
-  if (!afsql_dd_is_transaction_handling_enabled(self))
-    return LTR_SUCCESS;
+  if (afsql_dd_is_bulk_insert_enabled(self) && !afsql_dd_flush_bulk_insert(self))
+    {
+      LogThreadedResult result = afsql_dd_handle_insert_row_error_depending_on_connection_availability(self);
+      afsql_dd_rollback_transaction(self);
+      return result;
+    }
 
-  if (!afsql_dd_commit_transaction(self))
+  if (afsql_dd_is_transaction_handling_enabled(self) && !afsql_dd_commit_transaction(self))
     {
       /* Assuming that in case of error, the queue is rewound by afsql_dd_commit_transaction() */
       afsql_dd_rollback_transaction(self);
       return LTR_ERROR;
     }
+
+  /* the batch went through, the next one is tried in bulk again */
+  self->bulk.single_rows = FALSE;
   return LTR_SUCCESS;
 }
 
@@ -1036,7 +1165,6 @@ static LogThreadedResult
 afsql_dd_run_insert_query(AFSqlDestDriver *self, GString *table, LogMessage *msg)
 {
   GString *insert_command;
-  gboolean drop_silently = self->template_options.on_error & ON_ERROR_SILENT;
 
   insert_command = afsql_dd_build_insert_command(self, msg, table);
   if (insert_command)
@@ -1052,16 +1180,7 @@ afsql_dd_run_insert_query(AFSqlDestDriver *self, GString *table, LogMessage *msg
     }
   else
     {
-      if (!drop_silently)
-        {
-          msg_error("Failed to format message for SQL, dropping message",
-                    evt_tag_str("type", self->type),
-                    evt_tag_str("host", self->host),
-                    evt_tag_str("port", self->port),
-                    evt_tag_str("username", self->user),
-                    evt_tag_str("database", self->database),
-                    evt_tag_str("error", "error converting name-value pair to the requested type"));
-        }
+      afsql_dd_log_format_error(self);
       return LTR_DROP;
     }
 }
@@ -1088,7 +1207,10 @@ afsql_dd_insert(LogThreadedDestDriver *s, LogMessage *msg)
   if (afsql_dd_should_begin_new_transaction(self) && !afsql_dd_begin_transaction(self))
     goto error;
 
-  retval = afsql_dd_run_insert_query(self, table, msg);
+  if (afsql_dd_is_bulk_insert_enabled(self) && !self->bulk.single_rows)
+    retval = afsql_dd_queue_bulk_insert_row(self, table, msg);
+  else
+    retval = afsql_dd_run_insert_query(self, table, msg);
 
 error:
   if (table != NULL)
@@ -1154,6 +1276,29 @@ _update_legacy_persist_name_if_exists(AFSqlDestDriver *self)
   return persist_state_move_entry(cfg->state, legacy_persist_name, current_persist_name);
 }
 
+/*
+ * The tables found or made conform survive reloads, as long as the
+ * database, the columns and the indexes stay the same.
+ */
+static const gchar *
+_format_conform_tables_persist_name(AFSqlDestDriver *self)
+{
+  static gchar persist_name[512];
+  GString *signature = g_string_sized_new(256);
+
+  for (gint i = 0; i < self->fields_len; i++)
+    g_string_append_printf(signature, "%s %s,", self->fields[i].name, self->fields[i].type);
+  for (GList *l = self->indexes; l; l = l->next)
+    g_string_append_printf(signature, "%s,", (gchar *) l->data);
+  g_string_append(signature, self->create_statement_append ? : "");
+
+  g_snprintf(persist_name, sizeof(persist_name), "%s.conform_tables(%08x)",
+             afsql_dd_format_persist_name(&self->super.super.super.super), g_str_hash(signature->str));
+  g_string_free(signature, TRUE);
+
+  return persist_name;
+}
+
 static gboolean
 _init_fields_from_columns_and_values(AFSqlDestDriver *self)
 {
@@ -1272,14 +1417,44 @@ afsql_dd_init(LogPipe *s)
   if (!_init_fields_from_columns_and_values(self))
     return FALSE;
 
+  if (afsql_dd_is_bulk_insert_enabled(self) && strcmp(self->type, s_oracle) == 0)
+    {
+      msg_warning("WARNING: flags(bulk-insert) is not supported with Oracle, inserting rows one by one",
+                  log_pipe_location_tag(s));
+      self->flags &= ~AFSQL_DDF_BULK_INSERT;
+    }
+
   if (!log_threaded_dest_driver_init_method(s))
     return FALSE;
 
   log_template_options_init(&self->template_options, cfg);
 
-  if (afsql_dd_is_transaction_handling_enabled(self))
+  if (afsql_dd_is_transaction_handling_enabled(self) || afsql_dd_is_bulk_insert_enabled(self))
     log_threaded_dest_driver_set_batch_lines((LogDriver *)self, _batch_lines(self));
 
+  GHashTable *conform_tables = cfg_persist_config_fetch(cfg, _format_conform_tables_persist_name(self));
+  if (conform_tables)
+    {
+      g_hash_table_destroy(self->syslogng_conform_tables);
+      self->syslogng_conform_tables = conform_tables;
+    }
+
+  return TRUE;
+}
+
+static gboolean
+afsql_dd_deinit(LogPipe *s)
+{
+  AFSqlDestDriver *self = (AFSqlDestDriver *) s;
+  GlobalConfig *cfg = log_pipe_get_config(s);
+
+  if (!log_threaded_dest_driver_deinit_method(s))
+    return FALSE;
+
+  cfg_persist_config_add(cfg, _format_conform_tables_persist_name(self), self->syslogng_conform_tables,
+                         (GDestroyNotify) g_hash_table_destroy);
+  self->syslogng_conform_tables = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+
   return TRUE;
 }
 
@@ -1313,6 +1488,9 @@ afsql_dd_free(LogPipe *s)
   g_list_free_full(self->values, (GDestroyNotify)log_template_unref);
   log_template_unref(self->table);
   g_hash_table_destroy(self->syslogng_conform_tables);
+  g_hash_table_destroy(self->insert_prefixes);
+  g_string_free(self->bulk.table, TRUE);
+  g_string_free(self->bulk.statement, TRUE);
   g_hash_table_destroy(self->dbd_options);
   g_hash_table_destroy(self->dbd_options_numeric);
   g_free(self->dbi_driver_dir);
@@ -1329,6 +1507,7 @@ afsql_dd_new(GlobalConfig *cfg)
   log_threaded_dest_driver_init_instance(&self->super, cfg);
 
   self->super.super.super.super.init = afsql_dd_init;
+  self->super.super.super.super.deinit = afsql_dd_deinit;
   self->super.super.super.super.free_fn = afsql_dd_free;
   self->super.super.super.super.generate_persist_name = afsql_dd_format_persist_name;
   self->super.format_stats_key = afsql_dd_format_stats_key;
@@ -1355,6 +1534,9 @@ afsql_dd_new(GlobalConfig *cfg)
   self->session_statements = NULL;
 
   self->syslogng_conform_tables = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+  self->insert_prefixes = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
+  self->bulk.table = g_string_sized_new(32);
+  self->bulk.statement = g_string_sized_new(4096);
   self->dbd_options = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
   self->dbd_options_numeric = g_hash_table_new_full(g_str_hash, g_int_equal, g_free, NULL);
   self->dbi_driver_dir = NULL;
@@ -1372,6 +1554,8 @@ afsql_dd_lookup_flag(const gchar *flag)
     return AFSQL_DDF_EXPLICIT_COMMITS;
   else if (strcmp(flag, "dont-create-tables") == 0)
     return AFSQL_DDF_DONT_CREATE_TABLES;
+  else if (strcmp(flag, "bulk-insert") == 0)
+    return AFSQL_DDF_BULK_INSERT;
   else
     msg_warning("Unknown SQL flag",
                 evt_tag_str("flag", flag));
@@ -41,6 +41,7 @@ enum
 {
   AFSQL_DDF_EXPLICIT_COMMITS = 0x0001,
   AFSQL_DDF_DONT_CREATE_TABLES = 0x0002,
+  AFSQL_DDF_BULK_INSERT = 0x0004,
 };
 
 typedef struct _AFSqlField
@@ -95,8 +96,21 @@ typedef struct _AFSqlDestDriver
   dbi_conn dbi_ctx;
   gchar *dbi_driver_dir;
   GHashTable *syslogng_conform_tables;
+  /* table -> "INSERT INTO table (columns) VALUES " */
+  GHashTable *insert_prefixes;
   guint32 failed_message_counter;
   gboolean transaction_active;
+
+  /* flags(bulk-insert): a multi-row INSERT statement being built */
+  struct
+  {
+    GString *table;
+    GString *statement;
+    gint rows;
+    /* the last bulk insert failed, the rewound batch is inserted row by
+     * row, so that only the failing rows are retried */
+    gboolean single_rows;
+  } bulk;
 } AFSqlDestDriver;
 
 
@@ -0,0 +1,266 @@
+/*
+ * Copyright (c) 2024 One Identity LLC.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+
+#include <criterion/criterion.h>
+#include "libtest/cr_template.h"
+
+#include <dbi.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * The queries are not sent to a database: the libdbi calls of the insert
+ * path are replaced with the mocks below, which record the queries and
+ * fail the ones mentioning FAILING_VALUE.
+ */
+
+#define FAILING_VALUE "poison"
+
+static GPtrArray *queries;
+
+static dbi_result
+_mock_dbi_conn_query(dbi_conn conn, const char *query)
+{
+  g_ptr_array_add(queries, g_strdup(query));
+
+  if (strstr(query, FAILING_VALUE))
+    return NULL;
+  return (dbi_result) GINT_TO_POINTER(1);
+}
+
+static int
+_mock_dbi_result_free(dbi_result result)
+{
+  return 0;
+}
+
+static int
+_mock_dbi_conn_ping(dbi_conn conn)
+{
+  return 1;
+}
+
+static int
+_mock_dbi_conn_error(dbi_conn conn, const char **errmsg_dest)
+{
+  *errmsg_dest = "mock error";
+  return -1;
+}
+
+static size_t
+_mock_dbi_conn_quote_string_copy(dbi_conn conn, const char *orig, char **newstr)
+{
+  gchar *quoted = g_strdup_printf("'%s'", orig);
+
+  *newstr = strdup(quoted);
+  g_free(quoted);
+  return strlen(*newstr);
+}
+
+#define dbi_conn_query _mock_dbi_conn_query
+#define dbi_result_free _mock_dbi_result_free
+#define dbi_conn_ping _mock_dbi_conn_ping
+#define dbi_conn_error _mock_dbi_conn_error
+#define dbi_conn_quote_string_copy _mock_dbi_conn_quote_string_copy
+#include "afsql.c"
+#undef dbi_conn_query
+#undef dbi_result_free
+#undef dbi_conn_ping
+#undef dbi_conn_error
+#undef dbi_conn_quote_string_copy
+
+#include "apphook.h"
+
+static AFSqlDestDriver *
+_create_driver(gint flags)
+{
+  AFSqlDestDriver *self = (AFSqlDestDriver *) afsql_dd_new(configuration);
+
+  afsql_dd_set_table(&self->super.super.super, compile_template("$TABLE"));
+  afsql_dd_set_columns(&self->super.super.super, g_list_append(g_list_append(NULL, g_strdup("seq")),
+                       g_strdup("msg")));
+  afsql_dd_set_values(&self->super.super.super, g_list_append(g_list_append(NULL, compile_template("$SEQ")),
+                      compile_template("$MSG")));
+  afsql_dd_set_flags(&self->super.super.super, flags | AFSQL_DDF_DONT_CREATE_TABLES);
+  cr_assert(_init_fields_from_columns_and_values(self));
+
+  /* the connection itself is never used by the mocks */
+  self->dbi_ctx = (dbi_conn) GINT_TO_POINTER(1);
+  return self;
+}
+
+static void
+_free_driver(AFSqlDestDriver *self)
+{
+  self->dbi_ctx = NULL;
+  log_pipe_unref(&self->super.super.super.super);
+}
+
+static LogThreadedResult
+_insert(AFSqlDestDriver *self, const gchar *table, gint seq, const gchar *text)
+{
+  LogMessage *msg = create_empty_message();
+  gchar seq_str[16];
+
+  g_snprintf(seq_str, sizeof(seq_str), "%d", seq);
+  log_msg_set_value_by_name(msg, "TABLE", table, -1);
+  log_msg_set_value_by_name(msg, "SEQ", seq_str, -1);
+  log_msg_set_value(msg, LM_V_MESSAGE, text, -1);
+
+  LogThreadedResult result = afsql_dd_insert(&self->super, msg);
+  log_msg_unref(msg);
+  return result;
+}
+
+static const gchar *
+_query(guint index)
+{
+  cr_assert_lt(index, queries->len, "query #%u has not been run, queries: %u", index, queries->len);
+  return g_ptr_array_index(queries, index);
+}
+
+static gint
+_count_rows(const gchar *query)
+{
+  gint rows = 1;
+
+  for (const gchar *p = strstr(query, "), ("); p; p = strstr(p + 1, "), ("))
+    rows++;
+  return rows;
+}
+
+Test(afsql_bulk_insert, rows_of_a_batch_are_inserted_in_a_single_statement)
+{
+  AFSqlDestDriver *self = _create_driver(AFSQL_DDF_BULK_INSERT);
+
+  cr_assert_eq(_insert(self, "messages", 0, "first"), LTR_QUEUED);
+  cr_assert_eq(_insert(self, "messages", 1, "second"), LTR_QUEUED);
+  cr_assert_eq(_insert(self, "messages", 2, "third"), LTR_QUEUED);
+  cr_assert_eq(queries->len, 0, "nothing should be sent before the flush");
+
+  cr_assert_eq(afsql_dd_flush(&self->super), LTR_SUCCESS);
+  cr_assert_eq(queries->len, 1);
+  cr_assert_str_eq(_query(0), "INSERT INTO messages (seq, msg) VALUES "
+                   "('0', 'first'), ('1', 'second'), ('2', 'third')");
+
+  cr_assert_eq(afsql_dd_flush(&self->super), LTR_SUCCESS);
+  cr_assert_eq(queries->len, 1, "an empty batch should not be sent");
+
+  _free_driver(self);
+}
+
+Test(afsql_bulk_insert, changing_the_table_runs_the_statement_of_the_previous_one)
+{
+  AFSqlDestDriver *self = _create_driver(AFSQL_DDF_BULK_INSERT);
+
+  cr_assert_eq(_insert(self, "messages", 0, "first"), LTR_QUEUED);
+  cr_assert_eq(_insert(self, "messages", 1, "second"), LTR_QUEUED);
+  cr_assert_eq(_insert(self, "other", 2, "third"), LTR_QUEUED);
+
+  cr_assert_eq(queries->len, 1);
+  cr_assert_str_eq(_query(0), "INSERT INTO messages (seq, msg) VALUES ('0', 'first'), ('1', 'second')");
+
+  cr_assert_eq(afsql_dd_flush(&self->super), LTR_SUCCESS);
+  cr_assert_eq(queries->len, 2);
+  cr_assert_str_eq(_query(1), "INSERT INTO other (seq, msg) VALUES ('2', 'third')");
+
+  _free_driver(self);
+}
+
+Test(afsql_bulk_insert, statements_are_limited_in_the_number_of_rows)
+{
+  AFSqlDestDriver *self = _create_driver(AFSQL_DDF_BULK_INSERT);
+
+  for (gint i = 0; i < AFSQL_BULK_INSERT_MAX_ROWS; i++)
+    cr_assert_eq(_insert(self, "messages", i, "message"), LTR_QUEUED);
+
+  cr_assert_eq(queries->len, 1, "the statement should be run once it reaches the row limit");
+  cr_assert_eq(_count_rows(_query(0)), AFSQL_BULK_INSERT_MAX_ROWS);
+
+  cr_assert_eq(_insert(self, "messages", AFSQL_BULK_INSERT_MAX_ROWS, "message"), LTR_QUEUED);
+  cr_assert_eq(afsql_dd_flush(&self->super), LTR_SUCCESS);
+  cr_assert_eq(queries->len, 2);
+  cr_assert_str_eq(_query(1), "INSERT INTO messages (seq, msg) VALUES ('1000', 'message')");
+
+  _free_driver(self);
+}
+
+Test(afsql_bulk_insert, failed_bulk_insert_is_retried_row_by_row)
+{
+  AFSqlDestDriver *self = _create_driver(AFSQL_DDF_BULK_INSERT);
+
+  cr_assert_eq(_insert(self, "messages", 0, "first"), LTR_QUEUED);
+  cr_assert_eq(_insert(self, "messages", 1, FAILING_VALUE), LTR_QUEUED);
+  cr_assert_eq(_insert(self, "messages", 2, "third"), LTR_QUEUED);
+  cr_assert_eq(afsql_dd_flush(&self->super), LTR_ERROR, "the batch should be rewound");
+  cr_assert_eq(queries->len, 1);
+
+  /* the rewound batch */
+  cr_assert_eq(_insert(self, "messages", 0, "first"), LTR_SUCCESS);
+  cr_assert_eq(_insert(self, "messages", 1, FAILING_VALUE), LTR_ERROR, "only the failing row should fail");
+  cr_assert_eq(_insert(self, "messages", 2, "third"), LTR_SUCCESS);
+  cr_assert_eq(afsql_dd_flush(&self->super), LTR_SUCCESS);
+
+  cr_assert_eq(queries->len, 4);
+  cr_assert_str_eq(_query(1), "INSERT INTO messages (seq, msg) VALUES ('0', 'first')");
+  cr_assert_str_eq(_query(3), "INSERT INTO messages (seq, msg) VALUES ('2', 'third')");
+
+  /* the next batch is inserted in bulk again */
+  cr_assert_eq(_insert(self, "messages", 3, "fourth"), LTR_QUEUED);
+  cr_assert_eq(_insert(self, "messages", 4, "fifth"), LTR_QUEUED);
+  cr_assert_eq(afsql_dd_flush(&self->super), LTR_SUCCESS);
+  cr_assert_eq(queries->len, 5);
+  cr_assert_eq(_count_rows(_query(4)), 2);
+
+  _free_driver(self);
+}
+
+Test(afsql_bulk_insert, rows_are_inserted_one_by_one_without_bulk_insert)
+{
+  AFSqlDestDriver *self = _create_driver(0);
+
+  cr_assert_eq(_insert(self, "messages", 0, "first"), LTR_SUCCESS);
+  cr_assert_eq(_insert(self, "messages", 1, "second"), LTR_SUCCESS);
+  cr_assert_eq(queries->len, 2);
+  cr_assert_str_eq(_query(1), "INSERT INTO messages (seq, msg) VALUES ('1', 'second')");
+
+  _free_driver(self);
+}
+
+static void
+setup(void)
+{
+  app_startup();
+  configuration = cfg_new_snippet();
+  queries = g_ptr_array_new_with_free_func(g_free);
+}
+
+static void
+teardown(void)
+{
+  g_ptr_array_free(queries, TRUE);
+  cfg_free(configuration);
+  app_shutdown();
+}
+
+TestSuite(afsql_bulk_insert, .init = setup, .fini = teardown);
@@ -0,0 +1,257 @@
+/*
+ * Copyright (c) 2024 One Identity LLC.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+
+#include "app-dispatcher.h"
+#include "str-utils.h"
+
+#include <string.h>
+
+/*
+ * app-dispatcher() is generated by app-parser() in front of the
+ * applications of a topic.  It looks up $PROGRAM in a hash table built
+ * from the program() and program-prefix() discriminators of the
+ * applications and tags the message with the candidates, so the channel
+ * of every other discriminated application is skipped by a tag check
+ * instead of evaluating its filter.
+ */
+
+typedef struct _AppDispatcherRule
+{
+  gchar *key;
+  gchar *app_name;
+  gboolean prefix;
+} AppDispatcherRule;
+
+typedef struct _AppDispatcher
+{
+  LogParser super;
+  GList *rules;
+
+  /* key -> GArray of LogTagId, built from rules in init() */
+  GHashTable *programs;
+  GHashTable *program_prefixes;
+  /* the distinct key lengths in program_prefixes */
+  GArray *prefix_lengths;
+} AppDispatcher;
+
+static void
+_rule_free(AppDispatcherRule *rule)
+{
+  g_free(rule->key);
+  g_free(rule->app_name);
+  g_free(rule);
+}
+
+static void
+_add_rule(AppDispatcher *self, const gchar *key, const gchar *app_name, gboolean prefix)
+{
+  AppDispatcherRule *rule = g_new0(AppDispatcherRule, 1);
+
+  rule->key = g_strdup(key);
+  rule->app_name = g_strdup(app_name);
+  rule->prefix = prefix;
+  self->rules = g_list_append(self->rules, rule);
+}
+
+void
+app_dispatcher_add_program(LogParser *s, const gchar *program, const gchar *app_name)
+{
+  _add_rule((AppDispatcher *) s, program, app_name, FALSE);
+}
+
+void
+app_dispatcher_add_program_prefix(LogParser *s, const gchar *prefix, const gchar *app_name)
+{
+  _add_rule((AppDispatcher *) s, prefix, app_name, TRUE);
+}
+
+static void
+_set_candidates(LogMessage **pmsg, const LogPathOptions *path_options, GArray *candidates)
+{
+  LogMessage *msg = log_msg_make_writable(pmsg, path_options);
+
+  for (gint i = 0; i < candidates->len; i++)
+    log_msg_set_tag_by_id(msg, g_array_index(candidates, LogTagId, i));
+}
+
+/* prefixes are matched against this many leading characters of $PROGRAM at most */
+#define APP_DISPATCHER_MAX_PREFIX_LEN 255
+
+static void
+_lookup_program_prefixes(AppDispatcher *self, LogMessage **pmsg, const LogPathOptions *path_options,
+                         const gchar *program, gsize program_len)
+{
+  gchar buf[APP_DISPATCHER_MAX_PREFIX_LEN + 1];
+  gsize buf_len = MIN(program_len, APP_DISPATCHER_MAX_PREFIX_LEN);
+
+  memcpy(buf, program, buf_len);
+  for (gint i = 0; i < self->prefix_lengths->len; i++)
+    {
+      gsize prefix_len = g_array_index(self->prefix_lengths, gsize, i);
+
+      if (prefix_len > buf_len)
+        continue;
+
+      gchar saved = buf[prefix_len];
+      buf[prefix_len] = 0;
+
+      GArray *candidates = g_hash_table_lookup(self->program_prefixes, buf);
+      if (candidates)
+        _set_candidates(pmsg, path_options, candidates);
+      buf[prefix_len] = saved;
+    }
+}
+
+static gboolean
+_process(LogParser *s, LogMessage **pmsg, const LogPathOptions *path_options, const gchar *input, gsize input_len)
+{
+  AppDispatcher *self = (AppDispatcher *) s;
+  gssize program_len;
+  const gchar *program = log_msg_get_value(*pmsg, LM_V_PROGRAM, &program_len);
+
+  APPEND_ZERO(program, program, program_len);
+
+  GArray *candidates = g_hash_table_lookup(self->programs, program);
+  if (candidates)
+    _set_candidates(pmsg, path_options, candidates);
+
+  if (self->prefix_lengths->len > 0)
+    _lookup_program_prefixes(self, pmsg, path_options, program, program_len);
+
+  return TRUE;
+}
+
+static void
+_add_prefix_length(AppDispatcher *self, gsize prefix_len)
+{
+  for (gint i = 0; i < self->prefix_lengths->len; i++)
+    {
+      if (g_array_index(self->prefix_lengths, gsize, i) == prefix_len)
+        return;
+    }
+  g_array_append_val(self->prefix_lengths, prefix_len);
+}
+
+static void
+_add_candidate(GHashTable *table, const gchar *key, const gchar *app_name)
+{
+  GArray *candidates = g_hash_table_lookup(table, key);
+
+  if (!candidates)
+    {
+      candidates = g_array_new(FALSE, FALSE, sizeof(LogTagId));
+      g_hash_table_insert(table, g_strdup(key), candidates);
+    }
+
+  gchar *tag_name = g_strdup_printf(APP_DISPATCHER_CANDIDATE_TAG_PREFIX "%s", app_name);
+  LogTagId tag = log_tags_get_by_name(tag_name);
+  g_array_append_val(candidates, tag);
+  g_free(tag_name);
+}
+
+static void
+_free_tables(AppDispatcher *self)
+{
+  if (!self->programs)
+    return;
+
+  g_hash_table_unref(self->programs);
+  g_hash_table_unref(self->program_prefixes);
+  g_array_free(self->prefix_lengths, TRUE);
+  self->programs = NULL;
+  self->program_prefixes = NULL;
+  self->prefix_lengths = NULL;
+}
+
+static void
+_build_tables(AppDispatcher *self)
+{
+  _free_tables(self);
+  self->programs = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, (GDestroyNotify) g_array_unref);
+  self->program_prefixes = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, (GDestroyNotify) g_array_unref);
+  self->prefix_lengths = g_array_new(FALSE, FALSE, sizeof(gsize));
+
+  for (GList *l = self->rules; l; l = l->next)
+    {
+      AppDispatcherRule *rule = (AppDispatcherRule *) l->data;
+
+      if (rule->prefix)
+        {
+          _add_candidate(self->program_prefixes, rule->key, rule->app_name);
+          _add_prefix_length(self, strlen(rule->key));
+        }
+      else
+        {
+          _add_candidate(self->programs, rule->key, rule->app_name);
+        }
+    }
+}
+
+static gboolean
+_init(LogPipe *s)
+{
+  AppDispatcher *self = (AppDispatcher *) s;
+
+  _build_tables(self);
+  return log_parser_init_method(s);
+}
+
+static LogPipe *
+_clone(LogPipe *s)
+{
+  AppDispatcher *self = (AppDispatcher *) s;
+  AppDispatcher *cloned = (AppDispatcher *) app_dispatcher_new(s->cfg);
+
+  log_parser_clone_settings(&self->super, &cloned->super);
+  for (GList *l = self->rules; l; l = l->next)
+    {
+      AppDispatcherRule *rule = (AppDispatcherRule *) l->data;
+
+      _add_rule(cloned, rule->key, rule->app_name, rule->prefix);
+    }
+  return &cloned->super.super;
+}
+
+static void
+_free(LogPipe *s)
+{
+  AppDispatcher *self = (AppDispatcher *) s;
+
+  _free_tables(self);
+  g_list_free_full(self->rules, (GDestroyNotify) _rule_free);
+  log_parser_free_method(s);
+}
+
+LogParser *
+app_dispatcher_new(GlobalConfig *cfg)
+{
+  AppDispatcher *self = g_new0(AppDispatcher, 1);
+
+  log_parser_init_instance(&self->super, cfg);
+  self->super.super.init = _init;
+  self->super.super.clone = _clone;
+  self->super.super.free_fn = _free;
+  self->super.process = _process;
+  return &self->super;
+}
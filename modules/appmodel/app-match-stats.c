@@ -0,0 +1,214 @@
+/*
+ * Copyright (c) 2024 One Identity LLC.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+
+#include "app-match-stats.h"
+#include "app-dispatcher.h"
+#include "stats/stats-cluster-single.h"
+#include "str-utils.h"
+
+/*
+ * app-match-stats() is generated by app-parser() after the junction of the
+ * applications, which only lets through messages that matched one of
+ * them.  It counts the matches per application, based on ${.app.name},
+ * and removes the candidate tags set by app-dispatcher().
+ *
+ *   app_parser_matched_messages_total{topic="syslog",application="sudo"}
+ */
+
+typedef struct _AppMatchStats
+{
+  LogParser super;
+  gchar *topic;
+  GList *app_names;
+
+  /* app name -> StatsCounterItem, read-only while processing */
+  GHashTable *counters;
+  GArray *candidate_tags;
+  NVHandle app_name_handle;
+} AppMatchStats;
+
+void
+app_match_stats_set_topic(LogParser *s, const gchar *topic)
+{
+  AppMatchStats *self = (AppMatchStats *) s;
+
+  g_free(self->topic);
+  self->topic = g_strdup(topic);
+}
+
+void
+app_match_stats_add_application(LogParser *s, const gchar *app_name)
+{
+  AppMatchStats *self = (AppMatchStats *) s;
+
+  self->app_names = g_list_append(self->app_names, g_strdup(app_name));
+}
+
+static gboolean
+_process(LogParser *s, LogMessage **pmsg, const LogPathOptions *path_options, const gchar *input, gsize input_len)
+{
+  AppMatchStats *self = (AppMatchStats *) s;
+
+  for (gint i = 0; i < self->candidate_tags->len; i++)
+    {
+      LogTagId tag = g_array_index(self->candidate_tags, LogTagId, i);
+
+      if (log_msg_is_tag_by_id(*pmsg, tag))
+        log_msg_clear_tag_by_id(log_msg_make_writable(pmsg, path_options), tag);
+    }
+
+  gssize app_name_len;
+  const gchar *app_name = log_msg_get_value(*pmsg, self->app_name_handle, &app_name_len);
+
+  APPEND_ZERO(app_name, app_name, app_name_len);
+  stats_counter_inc(g_hash_table_lookup(self->counters, app_name));
+  return TRUE;
+}
+
+static void
+_set_stats_key(AppMatchStats *self, StatsClusterKey *sc_key, StatsClusterLabel *labels, const gchar *app_name)
+{
+  labels[0] = stats_cluster_label("topic", self->topic);
+  labels[1] = stats_cluster_label("application", app_name);
+  stats_cluster_single_key_set(sc_key, "app_parser_matched_messages_total", labels, 2);
+}
+
+static void
+_lookup_candidate_tags(AppMatchStats *self)
+{
+  g_array_set_size(self->candidate_tags, 0);
+  for (GList *l = self->app_names; l; l = l->next)
+    {
+      gchar *tag_name = g_strdup_printf(APP_DISPATCHER_CANDIDATE_TAG_PREFIX "%s", (const gchar *) l->data);
+      LogTagId tag = log_tags_get_by_name(tag_name);
+
+      g_array_append_val(self->candidate_tags, tag);
+      g_free(tag_name);
+    }
+}
+
+static void
+_register_counters(AppMatchStats *self)
+{
+  stats_lock();
+  for (GList *l = self->app_names; l; l = l->next)
+    {
+      const gchar *app_name = (const gchar *) l->data;
+      StatsClusterLabel labels[2];
+      StatsClusterKey sc_key;
+      StatsCounterItem *counter = NULL;
+
+      _set_stats_key(self, &sc_key, labels, app_name);
+      stats_register_counter(STATS_LEVEL1, &sc_key, SC_TYPE_SINGLE_VALUE, &counter);
+      g_hash_table_insert(self->counters, (gpointer) app_name, counter);
+    }
+  stats_unlock();
+}
+
+static void
+_unregister_counters(AppMatchStats *self)
+{
+  stats_lock();
+  for (GList *l = self->app_names; l; l = l->next)
+    {
+      const gchar *app_name = (const gchar *) l->data;
+      StatsClusterLabel labels[2];
+      StatsClusterKey sc_key;
+      StatsCounterItem *counter = g_hash_table_lookup(self->counters, app_name);
+
+      _set_stats_key(self, &sc_key, labels, app_name);
+      stats_unregister_counter(&sc_key, SC_TYPE_SINGLE_VALUE, &counter);
+    }
+  stats_unlock();
+  g_hash_table_remove_all(self->counters);
+}
+
+static gboolean
+_init(LogPipe *s)
+{
+  AppMatchStats *self = (AppMatchStats *) s;
+
+  if (!self->topic)
+    {
+      msg_error("app-match-stats() requires a topic() option",
+                log_pipe_location_tag(s));
+      return FALSE;
+    }
+
+  _lookup_candidate_tags(self);
+  _register_counters(self);
+  return log_parser_init_method(s);
+}
+
+static gboolean
+_deinit(LogPipe *s)
+{
+  AppMatchStats *self = (AppMatchStats *) s;
+
+  _unregister_counters(self);
+  return log_parser_deinit_method(s);
+}
+
+static LogPipe *
+_clone(LogPipe *s)
+{
+  AppMatchStats *self = (AppMatchStats *) s;
+  LogParser *cloned = app_match_stats_new(s->cfg);
+
+  log_parser_clone_settings(&self->super, cloned);
+  app_match_stats_set_topic(cloned, self->topic);
+  for (GList *l = self->app_names; l; l = l->next)
+    app_match_stats_add_application(cloned, (const gchar *) l->data);
+  return &cloned->super;
+}
+
+static void
+_free(LogPipe *s)
+{
+  AppMatchStats *self = (AppMatchStats *) s;
+
+  g_hash_table_destroy(self->counters);
+  g_array_free(self->candidate_tags, TRUE);
+  g_list_free_full(self->app_names, g_free);
+  g_free(self->topic);
+  log_parser_free_method(s);
+}
+
+LogParser *
+app_match_stats_new(GlobalConfig *cfg)
+{
+  AppMatchStats *self = g_new0(AppMatchStats, 1);
+
+  log_parser_init_instance(&self->super, cfg);
+  self->super.super.init = _init;
+  self->super.super.deinit = _deinit;
+  self->super.super.clone = _clone;
+  self->super.super.free_fn = _free;
+  self->super.process = _process;
+
+  self->counters = g_hash_table_new(g_str_hash, g_str_equal);
+  self->candidate_tags = g_array_new(FALSE, FALSE, sizeof(LogTagId));
+  self->app_name_handle = log_msg_get_value_handle(".app.name");
+  return &self->super;
+}
@@ -23,6 +23,7 @@
  */
 
 #include "app-parser-generator.h"
+#include "app-dispatcher.h"
 #include "appmodel.h"
 
 #include <string.h>
@@ -35,8 +36,16 @@ typedef struct _AppParserGenerator
   const gchar *included_apps;
   const gchar *excluded_apps;
   gboolean is_parsing_enabled;
+  /* the applications of the topic to be generated, as AppParserCandidate */
+  GArray *candidates;
 } AppParserGenerator;
 
+typedef struct _AppParserCandidate
+{
+  Application *app;
+  Application *base_app;
+} AppParserCandidate;
+
 static const gchar *
 _get_filter_expr(Application *app, Application *base_app)
 {
@@ -57,6 +66,41 @@ _get_parser_expr(Application *app, Application *base_app)
   return NULL;
 }
 
+static const gchar *
+_get_program(Application *app, Application *base_app)
+{
+  if (app->program)
+    return app->program;
+  if (base_app)
+    return base_app->program;
+  return NULL;
+}
+
+static const gchar *
+_get_program_prefix(Application *app, Application *base_app)
+{
+  if (app->program_prefix)
+    return app->program_prefix;
+  if (base_app)
+    return base_app->program_prefix;
+  return NULL;
+}
+
+static gboolean
+_is_discriminated(AppParserCandidate *candidate)
+{
+  return _get_program(candidate->app, candidate->base_app) ||
+         _get_program_prefix(candidate->app, candidate->base_app);
+}
+
+static void
+_generate_dispatch_gate(AppParserGenerator *self, AppParserCandidate *candidate)
+{
+  if (_is_discriminated(candidate))
+    g_string_append_printf(self->block, "    filter { tags('" APP_DISPATCHER_CANDIDATE_TAG_PREFIX "%s'); };\n",
+                           candidate->app->name);
+}
+
 static void
 _generate_filter(AppParserGenerator *self, const gchar *filter_expr)
 {
@@ -101,7 +145,7 @@ _is_application_excluded(AppParserGenerator *self, Application *app)
 }
 
 static void
-_generate_application(Application *app, Application *base_app, gpointer user_data)
+_collect_application(Application *app, Application *base_app, gpointer user_data)
 {
   AppParserGenerator *self = (AppParserGenerator *) user_data;
 
@@ -114,8 +158,19 @@ _generate_application(Application *app, Application *base_app, gpointer user_dat
   if (_is_application_excluded(self, app))
     return;
 
+  AppParserCandidate candidate = { .app = app, .base_app = base_app };
+  g_array_append_val(self->candidates, candidate);
+}
+
+static void
+_generate_application(AppParserGenerator *self, AppParserCandidate *candidate)
+{
+  Application *app = candidate->app;
+  Application *base_app = candidate->base_app;
+
   g_string_append_printf(self->block, "\n#Start Application %s\n", app->name);
   g_string_append(self->block, "channel {\n");
+  _generate_dispatch_gate(self, candidate);
   _generate_filter(self, _get_filter_expr(app, base_app));
   _generate_parser(self, _get_parser_expr(app, base_app));
   _generate_action(self, app);
@@ -125,9 +180,54 @@ _generate_application(Application *app, Application *base_app, gpointer user_dat
 }
 
 static void
-_generate_applications(AppParserGenerator *self, AppModelContext *appmodel)
+_generate_applications(AppParserGenerator *self)
 {
-  appmodel_context_iter_applications(appmodel, _generate_application, self);
+  for (gint i = 0; i < self->candidates->len; i++)
+    _generate_application(self, &g_array_index(self->candidates, AppParserCandidate, i));
+}
+
+/*
+ * Applications with a program() or program-prefix() discriminator are
+ * looked up by $PROGRAM once per message, their channels only run for the
+ * candidates returned by the lookup.  The rest are tried in order, as
+ * before.
+ */
+static void
+_generate_dispatcher(AppParserGenerator *self)
+{
+  GString *rules = g_string_new("");
+
+  for (gint i = 0; i < self->candidates->len; i++)
+    {
+      AppParserCandidate *candidate = &g_array_index(self->candidates, AppParserCandidate, i);
+      const gchar *program = _get_program(candidate->app, candidate->base_app);
+      const gchar *program_prefix = _get_program_prefix(candidate->app, candidate->base_app);
+
+      if (program)
+        g_string_append_printf(rules, "        program('%s' '%s')\n", program, candidate->app->name);
+      if (program_prefix)
+        g_string_append_printf(rules, "        program-prefix('%s' '%s')\n", program_prefix, candidate->app->name);
+    }
+
+  if (rules->len > 0)
+    g_string_append_printf(self->block, "    parser {\n      app-dispatcher(\n%s      );\n    };\n", rules->str);
+  g_string_free(rules, TRUE);
+}
+
+static void
+_generate_match_stats(AppParserGenerator *self)
+{
+  if (self->candidates->len == 0)
+    return;
+
+  g_string_append_printf(self->block, "    parser { app-match-stats(topic('%s') applications(", self->topic);
+  for (gint i = 0; i < self->candidates->len; i++)
+    {
+      AppParserCandidate *candidate = &g_array_index(self->candidates, AppParserCandidate, i);
+
+      g_string_append_printf(self->block, "%s'%s'", i > 0 ? " " : "", candidate->app->name);
+    }
+  g_string_append(self->block, ")); };\n");
 }
 
 
@@ -140,13 +240,16 @@ _generate_empty_frame(AppParserGenerator *self)
 static void
 _generate_framing(AppParserGenerator *self, AppModelContext *appmodel)
 {
-  g_string_append(self->block,
-                  "\nchannel {\n"
-                  "    junction {\n");
+  appmodel_context_iter_applications(appmodel, _collect_application, self);
+
+  g_string_append(self->block, "\nchannel {\n");
+  _generate_dispatcher(self);
+  g_string_append(self->block, "    junction {\n");
 
-  _generate_applications(self, appmodel);
+  _generate_applications(self);
   _generate_empty_frame(self);
   g_string_append(self->block, "    };\n");
+  _generate_match_stats(self);
   g_string_append(self->block, "}");
 }
 
@@ -223,10 +326,13 @@ _generate(CfgBlockGenerator *s, GlobalConfig *cfg, gpointer args, GString *resul
     return FALSE;
 
   self->block = result;
+  self->candidates = g_array_new(FALSE, FALSE, sizeof(AppParserCandidate));
   if (self->is_parsing_enabled)
     _generate_framing(self, appmodel);
   else
     _generate_empty_frame(self);
+  g_array_free(self->candidates, TRUE);
+  self->candidates = NULL;
   self->block = NULL;
 
   return TRUE;
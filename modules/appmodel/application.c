@@ -37,6 +37,20 @@ application_set_parser(Application *self, const gchar *parser_expr)
   self->parser_expr = g_strdup(parser_expr);
 }
 
+void
+application_set_program(Application *self, const gchar *program)
+{
+  g_free(self->program);
+  self->program = g_strdup(program);
+}
+
+void
+application_set_program_prefix(Application *self, const gchar *program_prefix)
+{
+  g_free(self->program_prefix);
+  self->program_prefix = g_strdup(program_prefix);
+}
+
 Application *
 application_new(const gchar *name, const gchar *topic)
 {
@@ -54,5 +68,7 @@ application_free(Application *self)
   g_free(self->topic);
   g_free(self->filter_expr);
   g_free(self->parser_expr);
+  g_free(self->program);
+  g_free(self->program_prefix);
   g_free(self);
 }
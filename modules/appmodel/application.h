@@ -32,10 +32,15 @@ typedef struct _Application
   gchar *topic;
   gchar *filter_expr;
   gchar *parser_expr;
+  /* optional $PROGRAM discriminators, used by app-parser() to dispatch */
+  gchar *program;
+  gchar *program_prefix;
 } Application;
 
 void application_set_filter(Application *self, const gchar *filter_expr);
 void application_set_parser(Application *self, const gchar *parser_expr);
+void application_set_program(Application *self, const gchar *program);
+void application_set_program_prefix(Application *self, const gchar *program_prefix);
 
 Application *application_new(const gchar *name, const gchar *topic);
 void application_free(Application *s);
@@ -32,6 +32,12 @@ int appmodel_parse(CfgLexer *lexer, gpointer *instance, gpointer arg);
 static CfgLexerKeyword appmodel_keywords[] =
 {
   { "application",  KW_APPLICATION },
+  { "program",      KW_PROGRAM },
+  { "program_prefix", KW_PROGRAM_PREFIX },
+  { "app_dispatcher", KW_APP_DISPATCHER },
+  { "app_match_stats", KW_APP_MATCH_STATS },
+  { "topic",        KW_TOPIC },
+  { "applications", KW_APPLICATIONS },
   { NULL }
 };
 
@@ -48,7 +48,17 @@ static Plugin appmodel_plugins[] =
     .name = "app-parser",
     .construct = app_parser_construct,
     .parser = &block_ref_parser
-  }
+  },
+  {
+    .type = LL_CONTEXT_PARSER,
+    .name = "app-dispatcher",
+    .parser = &appmodel_parser,
+  },
+  {
+    .type = LL_CONTEXT_PARSER,
+    .name = "app-match-stats",
+    .parser = &appmodel_parser,
+  },
 };
 
 gboolean
@@ -299,5 +299,39 @@ Test(app_parser_generator, app_parser_includes_and_excludes_apps)
   _assert_snippet_is_not_present("program('baz')");
 }
 
+Test(app_parser_generator, app_parser_dispatches_discriminated_apps_by_program)
+{
+  _register_application("application foo[port514] {\n"
+                        "    program('foo');\n"
+                        "    parser { kv-parser(prefix('foo.')); };\n"
+                        "};");
+  _register_application("application bar[*] {\n"
+                        "    program-prefix('bar');\n"
+                        "};");
+  _register_application("application bar[port514] {\n"
+                        "    filter { message('bar'); };\n"
+                        "};");
+  _register_sample_application("baz", "port514");
+
+  _app_parser_generate("port514");
+  _assert_parser_framing_is_present();
+  _assert_snippet_is_present("program('foo' 'foo')");
+  _assert_snippet_is_present("program-prefix('bar' 'bar')");
+  _assert_snippet_is_present("tags('.app.candidate.foo')");
+  _assert_snippet_is_present("tags('.app.candidate.bar')");
+  _assert_snippet_is_not_present("tags('.app.candidate.baz')");
+  _assert_snippet_is_present("app-match-stats(topic('port514') applications('foo' 'bar' 'baz'))");
+  _assert_config_is_valid("port514", NULL);
+}
+
+Test(app_parser_generator, app_parser_without_discriminators_does_not_generate_a_dispatcher)
+{
+  _register_sample_application("foo", "port514");
+
+  _app_parser_generate("port514");
+  _assert_parser_framing_is_present();
+  _assert_snippet_is_not_present("app-dispatcher(");
+  _assert_snippet_is_not_present(".app.candidate.");
+}
 
 TestSuite(app_parser_generator, .init = startup, .fini = teardown);
@@ -100,6 +100,21 @@ Test(appmodel, parser_expressions_can_be_specified_with_a_parser_keyword)
   cr_assert_str_eq(app->parser_expr, " kv-parser(); ");
 }
 
+Test(appmodel, program_discriminators_can_be_specified)
+{
+  Application *app;
+
+  app = _parse_application(
+          "application name[port514] {"
+          "  program(\"sudo\");"
+          "  program-prefix(\"1,\");"
+          "};",
+          "name", "port514");
+  cr_assert(app != NULL);
+  cr_assert_str_eq(app->program, "sudo");
+  cr_assert_str_eq(app->program_prefix, "1,");
+}
+
 static void
 setup(void)
 {
@@ -71,6 +71,38 @@ tf_cond_free_state(gpointer s)
   tf_simple_func_free_state(&state->super);
 }
 
+/*
+ * Evaluates the filter for each message of the context independently (as
+ * opposed to the context as a whole), in batches, and stores the indexes
+ * of the matching messages in @matches, up to --max-count.  Returns the
+ * number of matches.  Filters that modify the message are evaluated one
+ * message at a time, so that no message beyond --max-count is touched.
+ */
+static gint
+tf_grep_find_matches(TFCondState *state, LogMessage **messages, gint num_messages, gint *matches)
+{
+  gint batch_max = state->filter->modify ? 1 : FILTER_EXPR_BATCH_MAX;
+  gint count = 0;
+
+  for (gint batch_start = 0; batch_start < num_messages; batch_start += batch_max)
+    {
+      gint batch_len = MIN(num_messages - batch_start, batch_max);
+      FilterExprBatchMask result = filter_expr_eval_batch(state->filter, &messages[batch_start], batch_len,
+                                                          &DEFAULT_TEMPLATE_EVAL_OPTIONS);
+
+      for (gint i = 0; i < batch_len; i++)
+        {
+          if (!(result & FILTER_EXPR_BATCH_BIT(i)))
+            continue;
+
+          matches[count++] = batch_start + i;
+          if (state->grep_max_count && count >= state->grep_max_count)
+            return count;
+        }
+    }
+  return count;
+}
+
 gboolean
 tf_grep_prepare(LogTemplateFunction *self, gpointer s, LogTemplate *parent, gint argc, gchar *argv[], GError **error)
 {
@@ -115,33 +147,29 @@ void
 tf_grep_call(LogTemplateFunction *self, gpointer s, const LogTemplateInvokeArgs *args, GString *result,
              LogMessageValueType *type)
 {
-  gint i, msg_ndx;
+  gint i, match_ndx;
   gboolean first = TRUE;
   TFCondState *state = (TFCondState *) s;
-  gint count = 0;
+  gint *matches = g_new(gint, args->num_messages);
+  gint count = tf_grep_find_matches(state, args->messages, args->num_messages, matches);
 
   *type = LM_VT_STRING;
-  for (msg_ndx = 0; msg_ndx < args->num_messages; msg_ndx++)
+  for (match_ndx = 0; match_ndx < count; match_ndx++)
     {
-      LogMessage *msg = args->messages[msg_ndx];
+      LogMessage *msg = args->messages[matches[match_ndx]];
 
-      if (filter_expr_eval(state->filter, msg))
+      for (i = 0; i < state->super.argc; i++)
         {
-          count++;
-          for (i = 0; i < state->super.argc; i++)
-            {
-              if (!first)
-                g_string_append_c(result, ',');
-
-              /* NOTE: not recursive, as the message context is just one message */
-              log_template_append_format(state->super.argv_templates[i], msg,
-                                         args->options, result);
-              first = FALSE;
-            }
-          if (state->grep_max_count && count >= state->grep_max_count)
-            break;
+          if (!first)
+            g_string_append_c(result, ',');
+
+          /* NOTE: not recursive, as the message context is just one message */
+          log_template_append_format(state->super.argv_templates[i], msg,
+                                     args->options, result);
+          first = FALSE;
         }
     }
+  g_free(matches);
 }
 
 TEMPLATE_FUNCTION(TFCondState, tf_grep, tf_grep_prepare, NULL, tf_grep_call, tf_cond_free_state, NULL);
@@ -197,4 +225,4 @@ tf_or (LogMessage *msg, gint argc, GString *argv[], GString *result, LogMessageV
     }
 }
 
-TEMPLATE_FUNCTION_SIMPLE(tf_or);
+TEMPLATE_FUNCTION_SIMPLE_PURE(tf_or);
@@ -60,32 +60,28 @@ tf_context_lookup_call(LogTemplateFunction *self, gpointer s, const LogTemplateI
 {
   gboolean first = TRUE;
   TFCondState *state = (TFCondState *) s;
-  gint count = 0;
   GString *buf = g_string_sized_new(64);
+  gint *matches = g_new(gint, args->num_messages);
+  gint count = tf_grep_find_matches(state, args->messages, args->num_messages, matches);
 
   *type = LM_VT_LIST;
-  for (gint msg_ndx = 0; msg_ndx < args->num_messages; msg_ndx++)
+  for (gint match_ndx = 0; match_ndx < count; match_ndx++)
     {
-      LogMessage *msg = args->messages[msg_ndx];
+      LogMessage *msg = args->messages[matches[match_ndx]];
 
-      if (filter_expr_eval(state->filter, msg))
+      for (gint i = 0; i < state->super.argc; i++)
         {
-          count++;
-          for (gint i = 0; i < state->super.argc; i++)
-            {
-              if (!first)
-                g_string_append_c(result, ',');
-
-              /* NOTE: not recursive, as the message context is just one message */
-              log_template_format(state->super.argv_templates[i], msg, args->options, buf);
-              str_repr_encode_append(result, buf->str, buf->len, ",");
-
-              first = FALSE;
-            }
-          if (state->grep_max_count && count >= state->grep_max_count)
-            break;
+          if (!first)
+            g_string_append_c(result, ',');
+
+          /* NOTE: not recursive, as the message context is just one message */
+          log_template_format(state->super.argv_templates[i], msg, args->options, buf);
+          str_repr_encode_append(result, buf->str, buf->len, ",");
+
+          first = FALSE;
         }
     }
+  g_free(matches);
   g_string_free(buf, TRUE);
 }
 
@@ -42,7 +42,7 @@ tf_ipv4_to_int(LogMessage *msg, gint argc, GString *argv[], GString *result, Log
     }
 }
 
-TEMPLATE_FUNCTION_SIMPLE(tf_ipv4_to_int);
+TEMPLATE_FUNCTION_SIMPLE_PURE(tf_ipv4_to_int);
 
 typedef struct _DnsResolveIpState
 {
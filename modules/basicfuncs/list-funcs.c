@@ -53,7 +53,7 @@ tf_list_concat(LogMessage *msg, gint argc, GString *argv[], GString *result, Log
   list_scanner_deinit(&scanner);
 }
 
-TEMPLATE_FUNCTION_SIMPLE(tf_list_concat);
+TEMPLATE_FUNCTION_SIMPLE_PURE(tf_list_concat);
 
 static void
 tf_list_append(LogMessage *msg, gint argc, GString *argv[], GString *result, LogMessageValueType *type)
@@ -71,7 +71,7 @@ tf_list_append(LogMessage *msg, gint argc, GString *argv[], GString *result, Log
     }
 }
 
-TEMPLATE_FUNCTION_SIMPLE(tf_list_append);
+TEMPLATE_FUNCTION_SIMPLE_PURE(tf_list_append);
 
 static gint
 _list_count(gint argc, GString *argv[])
@@ -190,7 +190,7 @@ tf_list_head(LogMessage *msg, gint argc, GString *argv[], GString *result, LogMe
   _list_nth(argc, argv, result, 0);
 }
 
-TEMPLATE_FUNCTION_SIMPLE(tf_list_head);
+TEMPLATE_FUNCTION_SIMPLE_PURE(tf_list_head);
 
 static void
 tf_list_nth(LogMessage *msg, gint argc, GString *argv[], GString *result, LogMessageValueType *type)
@@ -214,7 +214,7 @@ tf_list_nth(LogMessage *msg, gint argc, GString *argv[], GString *result, LogMes
   _list_nth(argc - 1, &argv[1], result, ndx);
 }
 
-TEMPLATE_FUNCTION_SIMPLE(tf_list_nth);
+TEMPLATE_FUNCTION_SIMPLE_PURE(tf_list_nth);
 
 static void
 tf_list_tail(LogMessage *msg, gint argc, GString *argv[], GString *result, LogMessageValueType *type)
@@ -226,7 +226,7 @@ tf_list_tail(LogMessage *msg, gint argc, GString *argv[], GString *result, LogMe
   _list_slice(argc, argv, result, 1, INT_MAX);
 }
 
-TEMPLATE_FUNCTION_SIMPLE(tf_list_tail);
+TEMPLATE_FUNCTION_SIMPLE_PURE(tf_list_tail);
 
 static void
 tf_list_count(LogMessage *msg, gint argc, GString *argv[], GString *result, LogMessageValueType *type)
@@ -237,7 +237,7 @@ tf_list_count(LogMessage *msg, gint argc, GString *argv[], GString *result, LogM
   format_uint32_padded(result, -1, ' ', 10, count);
 }
 
-TEMPLATE_FUNCTION_SIMPLE(tf_list_count);
+TEMPLATE_FUNCTION_SIMPLE_PURE(tf_list_count);
 
 /* $(list-slice FIRST:LAST list ...) */
 static void
@@ -283,7 +283,7 @@ tf_list_slice(LogMessage *msg, gint argc, GString *argv[], GString *result, LogM
               (gint) first_ndx, (gint) last_ndx);
 }
 
-TEMPLATE_FUNCTION_SIMPLE(tf_list_slice);
+TEMPLATE_FUNCTION_SIMPLE_PURE(tf_list_slice);
 
 static void
 tf_explode(LogMessage *msg, gint argc, GString *argv[], GString *result, LogMessageValueType *type)
@@ -310,7 +310,7 @@ tf_explode(LogMessage *msg, gint argc, GString *argv[], GString *result, LogMess
     }
 }
 
-TEMPLATE_FUNCTION_SIMPLE(tf_explode);
+TEMPLATE_FUNCTION_SIMPLE_PURE(tf_explode);
 
 static void
 tf_implode(LogMessage *msg, gint argc, GString *argv[], GString *result, LogMessageValueType *type)
@@ -338,7 +338,7 @@ tf_implode(LogMessage *msg, gint argc, GString *argv[], GString *result, LogMess
   list_scanner_deinit(&scanner);
 }
 
-TEMPLATE_FUNCTION_SIMPLE(tf_implode);
+TEMPLATE_FUNCTION_SIMPLE_PURE(tf_implode);
 
 typedef enum _StringMatchMode
 {
@@ -100,7 +100,7 @@ tf_num_plus(LogMessage *msg, gint argc, GString *argv[], GString *result, LogMes
   format_number(result, type, &res);
 }
 
-TEMPLATE_FUNCTION_SIMPLE(tf_num_plus);
+TEMPLATE_FUNCTION_SIMPLE_PURE(tf_num_plus);
 
 static void
 tf_num_minus(LogMessage *msg, gint argc, GString *argv[], GString *result, LogMessageValueType *type)
@@ -125,7 +125,7 @@ tf_num_minus(LogMessage *msg, gint argc, GString *argv[], GString *result, LogMe
   format_number(result, type, &res);
 }
 
-TEMPLATE_FUNCTION_SIMPLE(tf_num_minus);
+TEMPLATE_FUNCTION_SIMPLE_PURE(tf_num_minus);
 
 static void
 tf_num_multi(LogMessage *msg, gint argc, GString *argv[], GString *result, LogMessageValueType *type)
@@ -150,7 +150,7 @@ tf_num_multi(LogMessage *msg, gint argc, GString *argv[], GString *result, LogMe
   format_number(result, type, &res);
 }
 
-TEMPLATE_FUNCTION_SIMPLE(tf_num_multi);
+TEMPLATE_FUNCTION_SIMPLE_PURE(tf_num_multi);
 
 static void
 tf_num_div(LogMessage *msg, gint argc, GString *argv[], GString *result, LogMessageValueType *type)
@@ -175,7 +175,7 @@ tf_num_div(LogMessage *msg, gint argc, GString *argv[], GString *result, LogMess
   format_number(result, type, &res);
 }
 
-TEMPLATE_FUNCTION_SIMPLE(tf_num_div);
+TEMPLATE_FUNCTION_SIMPLE_PURE(tf_num_div);
 
 static void
 tf_num_mod(LogMessage *msg, gint argc, GString *argv[], GString *result, LogMessageValueType *type)
@@ -200,7 +200,7 @@ tf_num_mod(LogMessage *msg, gint argc, GString *argv[], GString *result, LogMess
   format_number(result, type, &res);
 }
 
-TEMPLATE_FUNCTION_SIMPLE(tf_num_mod);
+TEMPLATE_FUNCTION_SIMPLE_PURE(tf_num_mod);
 
 static void
 tf_num_round(LogMessage *msg, gint argc, GString *argv[], GString *result, LogMessageValueType *type)
@@ -258,7 +258,7 @@ tf_num_round(LogMessage *msg, gint argc, GString *argv[], GString *result, LogMe
   format_number(result, type, &n);
 }
 
-TEMPLATE_FUNCTION_SIMPLE(tf_num_round);
+TEMPLATE_FUNCTION_SIMPLE_PURE(tf_num_round);
 
 static void
 tf_num_ceil(LogMessage *msg, gint argc, GString *argv[], GString *result, LogMessageValueType *type)
@@ -289,7 +289,7 @@ tf_num_ceil(LogMessage *msg, gint argc, GString *argv[], GString *result, LogMes
   format_number(result, type, &n);
 }
 
-TEMPLATE_FUNCTION_SIMPLE(tf_num_ceil);
+TEMPLATE_FUNCTION_SIMPLE_PURE(tf_num_ceil);
 
 static void
 tf_num_floor(LogMessage *msg, gint argc, GString *argv[], GString *result, LogMessageValueType *type)
@@ -320,7 +320,7 @@ tf_num_floor(LogMessage *msg, gint argc, GString *argv[], GString *result, LogMe
   format_number(result, type, &n);
 }
 
-TEMPLATE_FUNCTION_SIMPLE(tf_num_floor);
+TEMPLATE_FUNCTION_SIMPLE_PURE(tf_num_floor);
 
 static gboolean
 _tf_num_parse_arg_with_message(const TFSimpleFuncState *state,
@@ -330,14 +330,21 @@ _tf_num_parse_arg_with_message(const TFSimpleFuncState *state,
 {
   GString *formatted_template = scratch_buffers_alloc();
   gint on_error = args->options->opts->on_error;
+  LogTemplateTypedValue value;
 
-  log_template_format(state->argv_templates[0], message, args->options, formatted_template);
+  log_template_eval_typed(state->argv_templates[0], message, args->options, formatted_template, &value);
 
-  if (!parse_int64(formatted_template->str, number))
+  if (value.type == LM_VT_INTEGER && value.as.number.type == GN_INT64)
+    {
+      *number = gn_as_int64(&value.as.number);
+      return TRUE;
+    }
+
+  if (!parse_int64(value.str, number))
     {
       if (!(on_error & ON_ERROR_SILENT))
         msg_error("Parsing failed, template function's argument is not a number",
-                  evt_tag_str("arg", formatted_template->str));
+                  evt_tag_str("arg", value.str));
       return FALSE;
     }
 
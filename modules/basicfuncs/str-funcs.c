@@ -32,7 +32,7 @@ tf_echo(LogMessage *msg, gint argc, GString *argv[], GString *result, LogMessage
   _append_args_with_separator(argc, argv, result, ' ');
 }
 
-TEMPLATE_FUNCTION_SIMPLE(tf_echo);
+TEMPLATE_FUNCTION_SIMPLE_PURE(tf_echo);
 
 static void
 tf_length(LogMessage *msg, gint argc, GString *argv[], GString *result, LogMessageValueType *type)
@@ -48,7 +48,7 @@ tf_length(LogMessage *msg, gint argc, GString *argv[], GString *result, LogMessa
     }
 }
 
-TEMPLATE_FUNCTION_SIMPLE(tf_length);
+TEMPLATE_FUNCTION_SIMPLE_PURE(tf_length);
 
 /*
  * $(substr $arg START [LEN])
@@ -161,7 +161,7 @@ tf_substr(LogMessage *msg, gint argc, GString *argv[], GString *result, LogMessa
   g_string_append_len(result, argv[0]->str + start, len);
 }
 
-TEMPLATE_FUNCTION_SIMPLE(tf_substr);
+TEMPLATE_FUNCTION_SIMPLE_PURE(tf_substr);
 
 /*
  * $(strip $arg1 $arg2 ...)
@@ -196,7 +196,7 @@ tf_strip(LogMessage *msg, gint argc, GString *argv[], GString *result, LogMessag
     }
 }
 
-TEMPLATE_FUNCTION_SIMPLE(tf_strip);
+TEMPLATE_FUNCTION_SIMPLE_PURE(tf_strip);
 
 /*
  * $(sanitize [opts] $arg1 $arg2 ...)
@@ -325,7 +325,7 @@ tf_indent_multi_line(LogMessage *msg, gint argc, GString *argv[], GString *text,
     }
 }
 
-TEMPLATE_FUNCTION_SIMPLE(tf_indent_multi_line);
+TEMPLATE_FUNCTION_SIMPLE_PURE(tf_indent_multi_line);
 
 void
 tf_lowercase(LogMessage *msg, gint argc, GString *argv[], GString *result, LogMessageValueType *type)
@@ -345,7 +345,7 @@ tf_lowercase(LogMessage *msg, gint argc, GString *argv[], GString *result, LogMe
     }
 }
 
-TEMPLATE_FUNCTION_SIMPLE(tf_lowercase);
+TEMPLATE_FUNCTION_SIMPLE_PURE(tf_lowercase);
 
 void
 tf_uppercase(LogMessage *msg, gint argc, GString *argv[], GString *result, LogMessageValueType *type)
@@ -365,7 +365,7 @@ tf_uppercase(LogMessage *msg, gint argc, GString *argv[], GString *result, LogMe
     }
 }
 
-TEMPLATE_FUNCTION_SIMPLE(tf_uppercase);
+TEMPLATE_FUNCTION_SIMPLE_PURE(tf_uppercase);
 
 void
 tf_replace_delimiter(LogMessage *msg, gint argc, GString *argv[], GString *result, LogMessageValueType *type)
@@ -388,7 +388,7 @@ tf_replace_delimiter(LogMessage *msg, gint argc, GString *argv[], GString *resul
   g_free(haystack);
 }
 
-TEMPLATE_FUNCTION_SIMPLE(tf_replace_delimiter);
+TEMPLATE_FUNCTION_SIMPLE_PURE(tf_replace_delimiter);
 
 typedef struct _TFStringPaddingState
 {
@@ -630,4 +630,4 @@ tf_base64encode(LogMessage *msg, gint argc, GString *argv[], GString *result, Lo
   g_string_set_size(result, init_len + out_len);
 };
 
-TEMPLATE_FUNCTION_SIMPLE(tf_base64encode);
+TEMPLATE_FUNCTION_SIMPLE_PURE(tf_base64encode);
@@ -548,6 +548,35 @@ Test(basicfuncs, test_context_funcs)
                                       "\"value,with,a,comma\",\"value,with,a,comma\"");
 }
 
+Test(basicfuncs, test_grep_evaluates_large_contexts_in_batches)
+{
+  /* more than the 64 messages evaluated in one batch */
+  LogMessage *msgs[70];
+
+  for (gint i = 0; i < G_N_ELEMENTS(msgs); i++)
+    {
+      gchar pid[16];
+
+      msgs[i] = log_msg_new_empty();
+      /* every 10th message is local3.err, the others are user.info */
+      msgs[i]->pri = (i % 10 == 0) ? 155 : 14;
+      g_snprintf(pid, sizeof(pid), "%d", i);
+      log_msg_set_value(msgs[i], LM_V_PID, pid, -1);
+    }
+
+  assert_template_format_with_context_msgs("$(grep 'facility(local3) and level(err)' $PID)",
+                                           "0,10,20,30,40,50,60", msgs, G_N_ELEMENTS(msgs));
+  assert_template_format_with_context_msgs("$(grep -m 2 'facility(local3)' $PID)",
+                                           "0,10", msgs, G_N_ELEMENTS(msgs));
+  assert_template_format_with_context_msgs("$(grep 'not level(info)' $PID)",
+                                           "0,10,20,30,40,50,60", msgs, G_N_ELEMENTS(msgs));
+  assert_template_format_with_context_msgs("$(context-lookup -m 6 'facility(local3) or program(nomatch)' $PID)",
+                                           "0,10,20,30,40,50", msgs, G_N_ELEMENTS(msgs));
+
+  for (gint i = 0; i < G_N_ELEMENTS(msgs); i++)
+    log_msg_unref(msgs[i]);
+}
+
 Test(basicfuncs, test_vp_funcs)
 {
   assert_template_format_with_context("$(values .unix.*)", "command,1000,1000");
@@ -36,7 +36,7 @@ tf_urlencode(LogMessage *msg, gint argc, GString *argv[], GString *result, LogMe
     }
 }
 
-TEMPLATE_FUNCTION_SIMPLE(tf_urlencode);
+TEMPLATE_FUNCTION_SIMPLE_PURE(tf_urlencode);
 
 static void
 tf_urldecode(LogMessage *msg, gint argc, GString *argv[], GString *result, LogMessageValueType *type)
@@ -60,4 +60,4 @@ tf_urldecode(LogMessage *msg, gint argc, GString *argv[], GString *result, LogMe
     }
 }
 
-TEMPLATE_FUNCTION_SIMPLE(tf_urldecode);
+TEMPLATE_FUNCTION_SIMPLE_PURE(tf_urldecode);
@@ -26,6 +26,7 @@
 static Plugin cef_plugins[] =
 {
   TEMPLATE_FUNCTION_PLUGIN(tf_cef, "format-cef-extension"),
+  TEMPLATE_FUNCTION_PLUGIN(tf_cef, "format-leef"),
 };
 
 gboolean
@@ -39,7 +40,7 @@ const ModuleInfo module_info =
 {
   .canonical_name = "cef",
   .version = SYSLOG_NG_VERSION,
-  .description = "The CEF module provides CEF formatting support for syslog-ng.",
+  .description = "The CEF module provides CEF and LEEF formatting support for syslog-ng.",
   .core_revision = SYSLOG_NG_SOURCE_REVISION,
   .plugins = cef_plugins,
   .plugins_len = G_N_ELEMENTS(cef_plugins),
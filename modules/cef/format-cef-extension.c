@@ -28,10 +28,86 @@
 #include "str-utils.h"
 #include "format-cef-extension.h"
 
+/*
+ * $(format-cef-extension) and $(format-leef) share the same engine, they
+ * only differ in the pair separator and the set of characters escaped in
+ * values.  Each byte value is mapped to an escaping action up front, so
+ * values are escaped in a single pass, copying runs of plain characters
+ * with one append.
+ */
+enum
+{
+  CEF_ESCAPE_NONE = 0,
+  /* prefix the character with a backslash */
+  CEF_ESCAPE_BACKSLASH,
+  CEF_ESCAPE_LF,
+  CEF_ESCAPE_CR,
+  CEF_ESCAPE_TAB,
+  /* \uXXXX */
+  CEF_ESCAPE_CONTROL,
+  /* non-ASCII or NUL, needs UTF-8 validation */
+  CEF_ESCAPE_UTF8,
+};
+
+typedef struct _CefFormat
+{
+  const gchar *name;
+  gchar separator;
+  const gchar *backslash_escaped_chars;
+  gboolean escape_tab;
+  gsize initialized;
+  guint8 escape_table[256];
+  gboolean valid_key_chars[256];
+} CefFormat;
+
+static CefFormat cef_format =
+{
+  .name = "format-cef-extension",
+  .separator = ' ',
+  .backslash_escaped_chars = "=\\",
+};
+
+static CefFormat leef_format =
+{
+  .name = "format-leef",
+  .separator = '\t',
+  .backslash_escaped_chars = "=\\",
+  .escape_tab = TRUE,
+};
+
+static void
+tf_cef_format_init(CefFormat *format)
+{
+  if (!g_once_init_enter(&format->initialized))
+    return;
+
+  for (gint c = 0; c < 256; c++)
+    {
+      if (c == 0 || c >= 0x80)
+        format->escape_table[c] = CEF_ESCAPE_UTF8;
+      else if (c == '\n')
+        format->escape_table[c] = CEF_ESCAPE_LF;
+      else if (c == '\r')
+        format->escape_table[c] = CEF_ESCAPE_CR;
+      else if (c == '\t' && format->escape_tab)
+        format->escape_table[c] = CEF_ESCAPE_TAB;
+      else if (c < 32)
+        format->escape_table[c] = CEF_ESCAPE_CONTROL;
+      else if (strchr(format->backslash_escaped_chars, c))
+        format->escape_table[c] = CEF_ESCAPE_BACKSLASH;
+      else
+        format->escape_table[c] = CEF_ESCAPE_NONE;
+
+      format->valid_key_chars[c] = g_ascii_isalnum(c);
+    }
+  g_once_init_leave(&format->initialized, TRUE);
+}
+
 typedef struct _TFCefState
 {
   TFSimpleFuncState super;
   ValuePairs *vp;
+  CefFormat *format;
 } TFCefState;
 
 static gboolean
@@ -41,6 +117,9 @@ tf_cef_prepare(LogTemplateFunction *self, gpointer s, LogTemplate *parent,
 {
   TFCefState *state = (TFCefState *)s;
 
+  state->format = strcmp(argv[0], leef_format.name) == 0 ? &leef_format : &cef_format;
+  tf_cef_format_init(state->format);
+
   state->vp = value_pairs_new_from_cmdline(parent->cfg, &argc, &argv, NULL, NULL, error);
   if (!state->vp)
     return FALSE;
@@ -53,57 +132,84 @@ typedef struct
   gboolean need_separator;
   GString *buffer;
   const LogTemplateOptions *template_options;
+  const CefFormat *format;
 } CefWalkerState;
 
 static gboolean
-tf_cef_is_valid_key(const gchar *str)
+tf_cef_is_valid_key(const CefFormat *format, const gchar *str)
 {
-  size_t end = strspn(str, "0123456789"
-                      "abcdefghijklmnopqrstuvwxyz"
-                      "ABCDEFGHIJKLMNOPQRSTUVWXYZ");
-  return str[end] == '\0';
+  for (; *str; str++)
+    {
+      if (!format->valid_key_chars[(guchar) *str])
+        return FALSE;
+    }
+  return TRUE;
 }
 
 static inline void
-tf_cef_append_escaped(GString *escaped_string, const gchar *str, gsize str_len)
+tf_cef_append_hex_escape(GString *escaped_string, const gchar *prefix, guint8 c)
 {
-  const gchar *char_ptr;
-  gunichar uchar;
+  static const gchar hex_digits[] = "0123456789abcdef";
+
+  g_string_append(escaped_string, prefix);
+  g_string_append_c(escaped_string, hex_digits[c >> 4]);
+  g_string_append_c(escaped_string, hex_digits[c & 0x0F]);
+}
 
+static inline void
+tf_cef_append_escaped(const CefFormat *format, GString *escaped_string, const gchar *str, gsize str_len)
+{
   while (str_len)
     {
-      uchar = g_utf8_get_char_validated(str, str_len);
+      gsize plain_len = 0;
+
+      while (plain_len < str_len && format->escape_table[(guchar) str[plain_len]] == CEF_ESCAPE_NONE)
+        plain_len++;
 
-      switch (uchar)
+      g_string_append_len(escaped_string, str, plain_len);
+      str += plain_len;
+      str_len -= plain_len;
+      if (!str_len)
+        break;
+
+      gsize consumed = 1;
+      switch (format->escape_table[(guchar) *str])
         {
-        case (gunichar) -1:
-        case (gunichar) -2:
-          g_string_append_printf(escaped_string, "\\x%02x", *(guint8 *) str++);
-          str_len--;
-          continue;
+        case CEF_ESCAPE_BACKSLASH:
+          g_string_append_c(escaped_string, '\\');
+          g_string_append_c(escaped_string, *str);
           break;
-        case '=':
-          g_string_append(escaped_string, "\\=");
+        case CEF_ESCAPE_LF:
+          g_string_append_len(escaped_string, "\\n", 2);
           break;
-        case '\n':
-          g_string_append(escaped_string, "\\n");
+        case CEF_ESCAPE_CR:
+          g_string_append_len(escaped_string, "\\r", 2);
           break;
-        case '\r':
-          g_string_append(escaped_string, "\\r");
+        case CEF_ESCAPE_TAB:
+          g_string_append_len(escaped_string, "\\t", 2);
           break;
-        case '\\':
-          g_string_append(escaped_string, "\\\\");
+        case CEF_ESCAPE_CONTROL:
+          tf_cef_append_hex_escape(escaped_string, "\\u00", *str);
           break;
-        default:
-          if (uchar < 32)
-            g_string_append_printf(escaped_string, "\\u%04x", uchar);
-          else
-            g_string_append_unichar_optimized(escaped_string, uchar);
+        case CEF_ESCAPE_UTF8:
+        {
+          gunichar uchar = g_utf8_get_char_validated(str, str_len);
+
+          if (uchar == (gunichar) -1 || uchar == (gunichar) -2)
+            {
+              tf_cef_append_hex_escape(escaped_string, "\\x", *str);
+              break;
+            }
+          /* valid multi-byte sequences are copied as they are */
+          consumed = g_utf8_next_char(str) - str;
+          g_string_append_len(escaped_string, str, consumed);
           break;
         }
-      char_ptr = g_utf8_next_char(str);
-      str_len -= char_ptr - str;
-      str = char_ptr;
+        default:
+          g_assert_not_reached();
+        }
+      str += consumed;
+      str_len -= consumed;
     }
 }
 
@@ -112,13 +218,13 @@ tf_cef_append_value(const gchar *name, const gchar *value, gsize value_len,
                     CefWalkerState *state)
 {
   if (state->need_separator)
-    g_string_append_c(state->buffer, ' ');
+    g_string_append_c(state->buffer, state->format->separator);
 
   g_string_append(state->buffer, name);
 
   g_string_append_c(state->buffer, '=');
 
-  tf_cef_append_escaped(state->buffer, value, value_len);
+  tf_cef_append_escaped(state->format, state->buffer, value, value_len);
 
   return TRUE;
 }
@@ -136,12 +242,13 @@ tf_cef_walker(const gchar *name, LogMessageValueType type, const gchar *value, g
   CefWalkerState *state = (CefWalkerState *)user_data;
   gint on_error = state->template_options->on_error;
 
-  if (!tf_cef_is_valid_key(name))
+  if (!tf_cef_is_valid_key(state->format, name))
     {
       if (!(on_error & ON_ERROR_SILENT))
         {
           msg_error("Invalid CEF key",
-                    evt_tag_str("key", name));
+                    evt_tag_str("key", name),
+                    evt_tag_str("function", state->format->name));
         }
       return !!(on_error & ON_ERROR_DROP_MESSAGE);
     }
@@ -154,15 +261,16 @@ tf_cef_walker(const gchar *name, LogMessageValueType type, const gchar *value, g
 }
 
 static gboolean
-tf_cef_append(GString *result, ValuePairs *vp, LogMessage *msg, LogTemplateEvalOptions *options)
+tf_cef_append(GString *result, TFCefState *s, LogMessage *msg, LogTemplateEvalOptions *options)
 {
   CefWalkerState state;
 
   state.need_separator = FALSE;
   state.buffer = result;
   state.template_options = options->opts;
+  state.format = s->format;
 
-  return value_pairs_foreach_sorted(vp, tf_cef_walker,
+  return value_pairs_foreach_sorted(s->vp, tf_cef_walker,
                                     (GCompareFunc) tf_cef_walk_cmp, msg,
                                     options, &state);
 }
@@ -178,7 +286,7 @@ tf_cef_call(LogTemplateFunction *self, gpointer s,
 
   *type = LM_VT_STRING;
   for (i = 0; i < args->num_messages; i++)
-    r &= tf_cef_append(result, state->vp, args->messages[i], args->options);
+    r &= tf_cef_append(result, state, args->messages[i], args->options);
 
   if (!r && (args->options->opts->on_error & ON_ERROR_DROP_MESSAGE))
     g_string_set_size(result, orig_size);
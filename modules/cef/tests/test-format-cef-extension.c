@@ -223,3 +223,18 @@ Test(format_cef, test_macro_parity)
   _EXPECT_SKIP_BAD_PROPERTY("");
   _EXPECT_SKIP_BAD_PROPERTY("", "k");
 }
+
+Test(format_cef, test_leef)
+{
+  _EXPECT_CEF_RESULT_FORMAT("$(format-leef --subkeys .cef.)", "k=v\tx=y", ".cef.k", "v", ".cef.x", "y");
+  _EXPECT_CEF_RESULT_FORMAT("$(format-leef --subkeys .cef.)", "act=blocked a ping", ".cef.act", "blocked a ping");
+  _EXPECT_CEF_RESULT_FORMAT("$(format-leef --subkeys .cef.)", "act=a\\tb\\=c\\\\d\\n", ".cef.act", "a\tb=c\\d\n");
+  _EXPECT_CEF_RESULT_FORMAT("$(format-leef --subkeys .cef.)", "k=\\u0001\\xff", ".cef.k", "\x01\xff");
+  _EXPECT_CEF_RESULT_FORMAT("$(format-leef --subkeys .cef.)", "", ".cef.k w", "v");
+}
+
+Test(format_cef, test_long_value_with_mixed_escapes)
+{
+  _EXPECT_CEF_RESULT("msg=plain text \\= árvíztűrő \\\\ tükör\\nfúrógép\\u0009end",
+                     ".cef.msg", "plain text = árvíztűrő \\ tükör\nfúrógép\tend");
+}
@@ -22,6 +22,7 @@
  */
 #include "correlation-context.h"
 #include "logmsg/logmsg.h"
+#include "logmsg/logmsg-serialize.h"
 #include "scratch-buffers.h"
 #include <string.h>
 
@@ -77,6 +78,53 @@ correlation_context_sort(CorrelationContext *self, LogTemplate *sort_key)
     g_ptr_array_sort_with_data(self->messages, _compare_messages_with_nontrivial_template, sort_key);
 }
 
+/* The messages are written as a count followed by the messages in the
+ * compact encoding.  Contexts restored from a snapshot keep this
+ * representation until they are used, and are written back as they are.  */
+void
+correlation_context_serialize_messages(CorrelationContext *self, SerializeArchive *sa)
+{
+  if (self->serialized_messages)
+    {
+      serialize_write_blob(sa, self->serialized_messages->str, self->serialized_messages->len);
+      return;
+    }
+
+  serialize_write_varint(sa, self->messages->len);
+  for (guint i = 0; i < self->messages->len; i++)
+    log_msg_serialize((LogMessage *) g_ptr_array_index(self->messages, i), sa, LMSF_COMPACT_ENCODING);
+}
+
+gboolean
+correlation_context_restore_messages(CorrelationContext *self)
+{
+  GString *serialized = self->serialized_messages;
+
+  if (!serialized)
+    return TRUE;
+
+  self->serialized_messages = NULL;
+
+  SerializeArchive *sa = serialize_buffer_archive_new(serialized->str, serialized->len);
+  guint64 num_messages;
+  gboolean success = serialize_read_varint(sa, &num_messages);
+
+  for (guint64 i = 0; success && i < num_messages; i++)
+    {
+      LogMessage *msg = log_msg_new_empty();
+
+      success = log_msg_deserialize(msg, sa);
+      if (success)
+        g_ptr_array_add(self->messages, msg);
+      else
+        log_msg_unref(msg);
+    }
+
+  serialize_archive_free(sa);
+  g_string_free(serialized, TRUE);
+  return success;
+}
+
 void
 correlation_context_init(CorrelationContext *self, const CorrelationKey *key)
 {
@@ -103,6 +151,12 @@ correlation_context_clear_method(CorrelationContext *self)
       log_msg_unref((LogMessage *) g_ptr_array_index(self->messages, i));
     }
   g_ptr_array_set_size(self->messages, 0);
+
+  if (self->serialized_messages)
+    {
+      g_string_free(self->serialized_messages, TRUE);
+      self->serialized_messages = NULL;
+    }
 }
 
 void
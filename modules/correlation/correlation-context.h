@@ -27,6 +27,7 @@
 #include "correlation-key.h"
 #include "timerwheel.h"
 #include "logmsg/logmsg.h"
+#include "serialize.h"
 #include "template/templates.h"
 
 /* This class encapsulates a correlation context, keyed by CorrelationKey, type == PSK_RULE. */
@@ -39,6 +40,8 @@ struct _CorrelationContext
   TWEntry *timer;
   /* messages belonging to this context */
   GPtrArray *messages;
+  /* messages restored from a snapshot, deserialized into messages on first use */
+  GString *serialized_messages;
   gint ref_cnt;
   void (*clear)(CorrelationContext *s);
   void (*free_fn)(CorrelationContext *s);
@@ -61,6 +64,8 @@ void correlation_context_init(CorrelationContext *self, const CorrelationKey *ke
 void correlation_context_clear_method(CorrelationContext *self);
 void correlation_context_free_method(CorrelationContext *self);
 void correlation_context_sort(CorrelationContext *self, LogTemplate *sort_key);
+void correlation_context_serialize_messages(CorrelationContext *self, SerializeArchive *sa);
+gboolean correlation_context_restore_messages(CorrelationContext *self);
 CorrelationContext *correlation_context_new(CorrelationKey *key);
 CorrelationContext *correlation_context_ref(CorrelationContext *self);
 void correlation_context_unref(CorrelationContext *self);
@@ -42,6 +42,8 @@ static CfgLexerKeyword correlation_keywords[] =
   { "sort_key",           KW_SORT_KEY },
   { "scope",              KW_SCOPE },
   { "timeout",            KW_TIMEOUT },
+  { "max_expirations_per_tick", KW_MAX_EXPIRATIONS_PER_TICK },
+  { "persist_contexts",   KW_PERSIST_CONTEXTS },
   { "aggregate",          KW_AGGREGATE },
   { "inherit_mode",       KW_INHERIT_MODE },
   { "where",              KW_WHERE },
@@ -49,12 +51,14 @@ static CfgLexerKeyword correlation_keywords[] =
   { "trigger",            KW_TRIGGER },
   { "value",              KW_VALUE },
   { "prefix",             KW_PREFIX },
+  { "cache_dir",          KW_CACHE_DIR },
   { "program_template",   KW_PROGRAM_TEMPLATE },
   { "message_template",   KW_MESSAGE_TEMPLATE },
 
   /* group lines */
   { "group_lines",        KW_GROUP_LINES },
   { "line_separator",     KW_LINE_SEPARATOR },
+  { "max_memory",         KW_MAX_MEMORY },
   { NULL }
 };
 
@@ -0,0 +1,423 @@
+/*
+ * Copyright (c) 2024 One Identity LLC.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+#include "correlation-snapshot.h"
+#include "correlation-context.h"
+#include "messages.h"
+
+#include <string.h>
+#include <unistd.h>
+
+/*
+ * Snapshots of the correlation state
+ *
+ * The contexts of a CorrelationState are saved into a file next to the
+ * persist file when syslog-ng stops and are restored when it starts again,
+ * so that in-flight sessions survive restarts.  The layout of the file:
+ *
+ *    blob        magic ("SCS1")
+ *    uint64      the time of the correlation state
+ *    varint      number of contexts
+ *    context[]   scope (uint8), the host, program and pid as required by
+ *                the scope and the session id (cstrings), the remaining
+ *                timeout (varint), the length of the messages (varint) and
+ *                the messages
+ *
+ * The messages are written by correlation_context_serialize_messages() and
+ * are only deserialized once the restored context is looked up or expires,
+ * so a large snapshot does not delay startup.
+ *
+ * The size of the file and the time it was saved are recorded in
+ * persist-state.  The time syslog-ng was not running is added to the time
+ * of the correlation state upon restore, so timeouts are measured in wall
+ * clock time.  The snapshot is removed after it was restored, the same
+ * contexts are never restored twice, even if syslog-ng crashes later.
+ */
+
+#define CORRELATION_SNAPSHOT_MAGIC "SCS1"
+#define CORRELATION_SNAPSHOT_MAGIC_LEN 4
+#define CORRELATION_SNAPSHOT_STATE_VERSION 0
+
+static gchar *
+_format_persist_key(const gchar *persist_name)
+{
+  return g_strdup_printf("%s.snapshot", persist_name);
+}
+
+gchar *
+correlation_snapshot_format_filename(PersistState *persist_state, const gchar *persist_name)
+{
+  return g_strdup_printf("%s.correlation-%08x", persist_state_get_filename(persist_state), g_str_hash(persist_name));
+}
+
+static inline gboolean
+_is_context_saved(CorrelationContext *context)
+{
+  return context->messages->len > 0 || context->serialized_messages;
+}
+
+static void
+_write_key(SerializeArchive *sa, CorrelationKey *key)
+{
+  serialize_write_uint8(sa, key->scope);
+  switch (key->scope)
+    {
+    case RCS_PROCESS:
+      serialize_write_cstring(sa, key->pid, -1);
+    case RCS_PROGRAM:
+      serialize_write_cstring(sa, key->program, -1);
+    case RCS_HOST:
+      serialize_write_cstring(sa, key->host, -1);
+    case RCS_GLOBAL:
+      break;
+    default:
+      g_assert_not_reached();
+      break;
+    }
+  serialize_write_cstring(sa, key->session_id, -1);
+}
+
+static void
+_write_context(SerializeArchive *sa, CorrelationShard *shard, CorrelationContext *context, GString *messages)
+{
+  guint64 expires = timer_wheel_get_timer_expiration(shard->timer_wheel, context->timer);
+  guint64 now = timer_wheel_get_time(shard->timer_wheel);
+
+  g_string_truncate(messages, 0);
+  SerializeArchive *messages_sa = serialize_string_archive_new(messages);
+  correlation_context_serialize_messages(context, messages_sa);
+  serialize_archive_free(messages_sa);
+
+  _write_key(sa, &context->key);
+  serialize_write_varint(sa, expires > now ? expires - now : 0);
+  serialize_write_varint(sa, messages->len);
+  serialize_write_blob(sa, messages->str, messages->len);
+}
+
+static guint32
+_count_contexts(CorrelationState *self)
+{
+  guint32 num_contexts = 0;
+
+  for (gint i = 0; i < self->num_shards; i++)
+    {
+      GHashTableIter iter;
+      gpointer context;
+
+      g_hash_table_iter_init(&iter, self->shards[i].state);
+      while (g_hash_table_iter_next(&iter, NULL, &context))
+        num_contexts += _is_context_saved((CorrelationContext *) context);
+    }
+  return num_contexts;
+}
+
+static void
+_write_contexts(CorrelationState *self, SerializeArchive *sa)
+{
+  GString *messages = g_string_sized_new(1024);
+
+  for (gint i = 0; i < self->num_shards; i++)
+    {
+      CorrelationShard *shard = &self->shards[i];
+      GHashTableIter iter;
+      gpointer context;
+
+      g_hash_table_iter_init(&iter, shard->state);
+      while (g_hash_table_iter_next(&iter, NULL, &context))
+        {
+          if (_is_context_saved((CorrelationContext *) context))
+            _write_context(sa, shard, (CorrelationContext *) context, messages);
+        }
+    }
+  g_string_free(messages, TRUE);
+}
+
+static gboolean
+_store_snapshot_state(PersistState *persist_state, const gchar *persist_key, guint32 num_contexts, gsize size)
+{
+  PersistEntryHandle handle = persist_state_alloc_entry(persist_state, persist_key, sizeof(CorrelationSnapshotState));
+
+  if (!handle)
+    return FALSE;
+
+  CorrelationSnapshotState *state = persist_state_map_entry(persist_state, handle);
+  state->header.version = CORRELATION_SNAPSHOT_STATE_VERSION;
+  state->header.big_endian = (G_BYTE_ORDER == G_BIG_ENDIAN);
+  state->num_contexts = num_contexts;
+  state->size = size;
+  state->saved_at = g_get_real_time() / G_USEC_PER_SEC;
+  persist_state_unmap_entry(persist_state, handle);
+  return TRUE;
+}
+
+static gboolean
+_load_snapshot_state(PersistState *persist_state, const gchar *persist_key, CorrelationSnapshotState *snapshot_state)
+{
+  gsize size;
+  guint8 version;
+  PersistEntryHandle handle = persist_state_lookup_entry(persist_state, persist_key, &size, &version);
+
+  if (!handle || size < sizeof(*snapshot_state))
+    return FALSE;
+
+  CorrelationSnapshotState *state = persist_state_map_entry(persist_state, handle);
+  *snapshot_state = *state;
+  persist_state_unmap_entry(persist_state, handle);
+
+  return snapshot_state->header.version == CORRELATION_SNAPSHOT_STATE_VERSION &&
+         snapshot_state->header.big_endian == (G_BYTE_ORDER == G_BIG_ENDIAN) &&
+         snapshot_state->size > 0;
+}
+
+static void
+_remove_snapshot(PersistState *persist_state, const gchar *persist_key, const gchar *filename)
+{
+  gsize size;
+  guint8 version;
+  PersistEntryHandle handle = persist_state_lookup_entry(persist_state, persist_key, &size, &version);
+
+  /* removed entries are only dropped from the persist file upon the next
+   * start, the metadata is invalidated until then */
+  if (handle && size >= sizeof(CorrelationSnapshotState))
+    {
+      CorrelationSnapshotState *state = persist_state_map_entry(persist_state, handle);
+      state->size = 0;
+      persist_state_unmap_entry(persist_state, handle);
+      persist_state_remove_entry(persist_state, persist_key);
+    }
+  unlink(filename);
+}
+
+/* NOTE: the caller has to make sure that no messages are processed while
+ * the snapshot is written, e.g.  call it from deinit() */
+gboolean
+correlation_state_save_snapshot(CorrelationState *self, PersistState *persist_state, const gchar *persist_name)
+{
+  gchar *persist_key = _format_persist_key(persist_name);
+  gchar *filename = correlation_snapshot_format_filename(persist_state, persist_name);
+  GString *snapshot = g_string_sized_new(4096);
+  gboolean success = TRUE;
+  GError *error = NULL;
+
+  correlation_state_tx_begin(self);
+  guint32 num_contexts = _count_contexts(self);
+  if (num_contexts > 0)
+    {
+      SerializeArchive *sa = serialize_string_archive_new(snapshot);
+
+      serialize_write_blob(sa, CORRELATION_SNAPSHOT_MAGIC, CORRELATION_SNAPSHOT_MAGIC_LEN);
+      serialize_write_uint64(sa, correlation_state_get_time(self));
+      serialize_write_varint(sa, num_contexts);
+      _write_contexts(self, sa);
+      serialize_archive_free(sa);
+    }
+  correlation_state_tx_end(self);
+
+  if (num_contexts == 0)
+    {
+      _remove_snapshot(persist_state, persist_key, filename);
+      goto exit;
+    }
+
+  if (!g_file_set_contents(filename, snapshot->str, snapshot->len, &error))
+    {
+      msg_error("correlation: Error writing the snapshot of correlation contexts",
+                evt_tag_str("filename", filename),
+                evt_tag_str("error", error->message));
+      g_clear_error(&error);
+      success = FALSE;
+      goto exit;
+    }
+
+  if (!_store_snapshot_state(persist_state, persist_key, num_contexts, snapshot->len))
+    {
+      msg_error("correlation: Error storing the snapshot of correlation contexts in the persist file",
+                evt_tag_str("filename", filename));
+      unlink(filename);
+      success = FALSE;
+      goto exit;
+    }
+
+  msg_debug("correlation: Correlation contexts saved",
+            evt_tag_str("filename", filename),
+            evt_tag_int("num_contexts", num_contexts),
+            evt_tag_long("size", snapshot->len));
+
+exit:
+  g_string_free(snapshot, TRUE);
+  g_free(filename);
+  g_free(persist_key);
+  return success;
+}
+
+static gboolean
+_read_key(SerializeArchive *sa, CorrelationKey *key, gchar **host, gchar **program, gchar **pid)
+{
+  guint8 scope;
+
+  memset(key, 0, sizeof(*key));
+  if (!serialize_read_uint8(sa, &scope) || scope > RCS_PROCESS)
+    return FALSE;
+
+  key->scope = scope;
+  switch (scope)
+    {
+    case RCS_PROCESS:
+      if (!serialize_read_cstring(sa, pid, NULL))
+        return FALSE;
+      key->pid = *pid;
+    case RCS_PROGRAM:
+      if (!serialize_read_cstring(sa, program, NULL))
+        return FALSE;
+      key->program = *program;
+    case RCS_HOST:
+      if (!serialize_read_cstring(sa, host, NULL))
+        return FALSE;
+      key->host = *host;
+    case RCS_GLOBAL:
+      break;
+    default:
+      g_assert_not_reached();
+      break;
+    }
+  return serialize_read_cstring(sa, &key->session_id, NULL);
+}
+
+static gboolean
+_restore_context(CorrelationState *self, SerializeArchive *sa, guint64 downtime,
+                 CorrelationSnapshotConstructFunc construct, gpointer user_data)
+{
+  CorrelationKey key;
+  CorrelationContext *context;
+  gchar *host = NULL, *program = NULL, *pid = NULL;
+  guint64 timeout, messages_len;
+  GString *messages = NULL;
+  gboolean success = FALSE;
+
+  if (!_read_key(sa, &key, &host, &program, &pid) ||
+      !serialize_read_varint(sa, &timeout) ||
+      !serialize_read_varint(sa, &messages_len) ||
+      messages_len > G_MAXUINT32)
+    goto exit;
+
+  messages = g_string_sized_new(messages_len);
+  g_string_set_size(messages, messages_len);
+  if (!serialize_read_blob(sa, messages->str, messages_len))
+    goto exit;
+
+  /* the context takes over the session_id and copies the rest of the key */
+  context = construct(&key, user_data);
+  key.session_id = NULL;
+  context->serialized_messages = messages;
+  messages = NULL;
+
+  timeout = timeout > downtime ? MIN(timeout - downtime, G_MAXINT) : 1;
+  correlation_state_tx_begin_for_key(self, &context->key);
+  correlation_state_tx_store_context(self, context, (gint) timeout);
+  correlation_state_tx_end_for_key(self, &context->key);
+  success = TRUE;
+
+exit:
+  if (messages)
+    g_string_free(messages, TRUE);
+  g_free(key.session_id);
+  g_free(host);
+  g_free(program);
+  g_free(pid);
+  return success;
+}
+
+static gboolean
+_restore_contexts(CorrelationState *self, SerializeArchive *sa, CorrelationSnapshotState *snapshot_state,
+                  CorrelationSnapshotConstructFunc construct, gpointer user_data)
+{
+  gchar magic[CORRELATION_SNAPSHOT_MAGIC_LEN];
+  guint64 now, num_contexts;
+
+  if (!serialize_read_blob(sa, magic, sizeof(magic)) ||
+      memcmp(magic, CORRELATION_SNAPSHOT_MAGIC, sizeof(magic)) != 0 ||
+      !serialize_read_uint64(sa, &now) ||
+      !serialize_read_varint(sa, &num_contexts) ||
+      num_contexts != snapshot_state->num_contexts)
+    return FALSE;
+
+  gint64 downtime = MAX(g_get_real_time() / G_USEC_PER_SEC - snapshot_state->saved_at, 0);
+  correlation_state_set_time(self, now + downtime, NULL);
+
+  for (guint64 i = 0; i < num_contexts; i++)
+    {
+      if (!_restore_context(self, sa, downtime, construct, user_data))
+        return FALSE;
+    }
+  return TRUE;
+}
+
+/* NOTE: should be called before the first message is processed, e.g.  from
+ * init() */
+gboolean
+correlation_state_restore_snapshot(CorrelationState *self, PersistState *persist_state, const gchar *persist_name,
+                                   CorrelationSnapshotConstructFunc construct, gpointer user_data)
+{
+  gchar *persist_key = _format_persist_key(persist_name);
+  gchar *filename = correlation_snapshot_format_filename(persist_state, persist_name);
+  CorrelationSnapshotState snapshot_state;
+  SerializeArchive *sa;
+  gchar *snapshot = NULL;
+  gsize snapshot_len;
+  gboolean success = TRUE;
+  GError *error = NULL;
+
+  if (!_load_snapshot_state(persist_state, persist_key, &snapshot_state))
+    goto exit;
+
+  if (!g_file_get_contents(filename, &snapshot, &snapshot_len, &error))
+    {
+      msg_error("correlation: Error reading the snapshot of correlation contexts",
+                evt_tag_str("filename", filename),
+                evt_tag_str("error", error->message));
+      g_clear_error(&error);
+      success = FALSE;
+      goto exit;
+    }
+
+  sa = serialize_buffer_archive_new(snapshot, snapshot_len);
+  success = snapshot_len == snapshot_state.size &&
+            _restore_contexts(self, sa, &snapshot_state, construct, user_data);
+  serialize_archive_free(sa);
+
+  if (!success)
+    {
+      msg_error("correlation: The snapshot of correlation contexts is corrupted, contexts were not fully restored",
+                evt_tag_str("filename", filename));
+      goto exit;
+    }
+
+  msg_info("correlation: Correlation contexts restored",
+           evt_tag_str("filename", filename),
+           evt_tag_int("num_contexts", snapshot_state.num_contexts));
+
+exit:
+  _remove_snapshot(persist_state, persist_key, filename);
+  g_free(snapshot);
+  g_free(filename);
+  g_free(persist_key);
+  return success;
+}
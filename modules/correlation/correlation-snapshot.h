@@ -0,0 +1,47 @@
+/*
+ * Copyright (c) 2024 One Identity LLC.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+#ifndef CORRELATION_SNAPSHOT_H_INCLUDED
+#define CORRELATION_SNAPSHOT_H_INCLUDED
+
+#include "correlation.h"
+#include "persist-state.h"
+#include "persistable-state-header.h"
+
+/* metadata of the snapshot file, stored in persist-state */
+typedef struct _CorrelationSnapshotState
+{
+  PersistableStateHeader header;
+  guint32 num_contexts;
+  guint64 size;
+  gint64 saved_at;
+} CorrelationSnapshotState;
+
+typedef CorrelationContext *(*CorrelationSnapshotConstructFunc)(CorrelationKey *key, gpointer user_data);
+
+gchar *correlation_snapshot_format_filename(PersistState *persist_state, const gchar *persist_name);
+gboolean correlation_state_save_snapshot(CorrelationState *self, PersistState *persist_state,
+                                         const gchar *persist_name);
+gboolean correlation_state_restore_snapshot(CorrelationState *self, PersistState *persist_state,
+                                            const gchar *persist_name, CorrelationSnapshotConstructFunc construct,
+                                            gpointer user_data);
+
+#endif
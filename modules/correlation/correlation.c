@@ -26,43 +26,146 @@
 #include "timeutils/cache.h"
 #include "timeutils/misc.h"
 
+static inline CorrelationShard *
+_get_shard(CorrelationState *self, const CorrelationKey *key)
+{
+  if (self->num_shards == 1)
+    return &self->shards[0];
+  return &self->shards[correlation_key_hash(key) % self->num_shards];
+}
+
+/* Batched expiry
+ *
+ * In batched mode expired contexts are only collected while the shard is
+ * locked (and removed from the state), the expire callback is invoked for
+ * them once the lock is released.  This keeps the aggregation of large
+ * contexts from blocking the processing of other messages in the same
+ * shard.  */
+typedef struct _CorrelationExpiryBatch
+{
+  CorrelationState *state;
+  GPtrArray *expired_contexts;
+  guint64 now;
+} CorrelationExpiryBatch;
+
+static void
+_collect_expired_context(TimerWheel *wheel, guint64 now, gpointer user_data, gpointer caller_context)
+{
+  CorrelationContext *context = user_data;
+  CorrelationExpiryBatch *batch = caller_context;
+
+  if (!batch->expired_contexts)
+    batch->expired_contexts = g_ptr_array_new();
+
+  context->timer = NULL;
+  g_ptr_array_add(batch->expired_contexts, correlation_context_ref(context));
+  g_hash_table_remove(_get_shard(batch->state, &context->key)->state, &context->key);
+  batch->now = now;
+}
+
+static inline gpointer
+_get_expiry_context(CorrelationState *self, CorrelationExpiryBatch *batch, gpointer caller_context)
+{
+  return self->batched_expiry ? batch : caller_context;
+}
+
+/* NOTE: called without the shard lock */
+static void
+_deliver_expired_contexts(CorrelationState *self, CorrelationShard *shard, CorrelationExpiryBatch *batch,
+                          gpointer caller_context)
+{
+  if (!batch->expired_contexts)
+    return;
+
+  for (guint i = 0; i < batch->expired_contexts->len; i++)
+    {
+      CorrelationContext *context = g_ptr_array_index(batch->expired_contexts, i);
+
+      self->expire_callback(shard->timer_wheel, batch->now, context, caller_context);
+      correlation_context_unref(context);
+    }
+  g_ptr_array_free(batch->expired_contexts, TRUE);
+}
+
+/* NOTE: the shard is locked on entry and unlocked on return */
+static gboolean
+_shard_catch_up_and_unlock(CorrelationState *self, CorrelationShard *shard, gpointer caller_context)
+{
+  CorrelationExpiryBatch batch = { .state = self };
+  gboolean caught_up;
+
+  caught_up = timer_wheel_set_time_with_budget(shard->timer_wheel, shard->target_time, self->max_expirations,
+                                               _get_expiry_context(self, &batch, caller_context));
+  g_mutex_unlock(&shard->lock);
+
+  _deliver_expired_contexts(self, shard, &batch, caller_context);
+  return caught_up;
+}
+
+static inline void
+_shard_advance_target_time(CorrelationShard *shard, guint64 delta)
+{
+  shard->target_time = MAX(shard->target_time, timer_wheel_get_time(shard->timer_wheel)) + delta;
+}
+
 void
 correlation_state_tx_begin(CorrelationState *self)
 {
-  g_mutex_lock(&self->lock);
+  /* always in the same order, so this can't deadlock with another
+   * transaction spanning all shards */
+  for (gint i = 0; i < self->num_shards; i++)
+    g_mutex_lock(&self->shards[i].lock);
 }
 
 void
 correlation_state_tx_end(CorrelationState *self)
 {
-  g_mutex_unlock(&self->lock);
+  for (gint i = self->num_shards - 1; i >= 0; i--)
+    g_mutex_unlock(&self->shards[i].lock);
+}
+
+void
+correlation_state_tx_begin_for_key(CorrelationState *self, const CorrelationKey *key)
+{
+  g_mutex_lock(&_get_shard(self, key)->lock);
+}
+
+void
+correlation_state_tx_end_for_key(CorrelationState *self, const CorrelationKey *key)
+{
+  g_mutex_unlock(&_get_shard(self, key)->lock);
 }
 
 CorrelationContext *
 correlation_state_tx_lookup_context(CorrelationState *self, const CorrelationKey *key)
 {
-  return g_hash_table_lookup(self->state, key);
+  return g_hash_table_lookup(_get_shard(self, key)->state, key);
 }
 
 void
 correlation_state_tx_store_context(CorrelationState *self, CorrelationContext *context, gint timeout)
 {
+  CorrelationShard *shard = _get_shard(self, &context->key);
+
   g_assert(context->timer == NULL);
 
-  g_hash_table_insert(self->state, &context->key, context);
-  context->timer = timer_wheel_add_timer(self->timer_wheel, timeout, self->expire_callback,
+  g_hash_table_insert(shard->state, &context->key, context);
+  context->timer = timer_wheel_add_timer(shard->timer_wheel, timeout,
+                                         self->batched_expiry ? _collect_expired_context : self->expire_callback,
                                          correlation_context_ref(context), (GDestroyNotify) correlation_context_unref);
 }
 
 void
 correlation_state_tx_remove_context(CorrelationState *self, CorrelationContext *context)
 {
+  CorrelationShard *shard = _get_shard(self, &context->key);
+
   /* NOTE: in expire callbacks our timer is already deleted and thus it is
    * set to NULL in which case we don't need to remove it again.  */
 
   if (context->timer)
-    timer_wheel_del_timer(self->timer_wheel, context->timer);
-  g_hash_table_remove(self->state, &context->key);
+    timer_wheel_del_timer(shard->timer_wheel, context->timer);
+  g_hash_table_remove(shard->state, &context->key);
 }
 
 void
@@ -70,30 +173,40 @@ correlation_state_tx_update_context(CorrelationState *self, CorrelationContext *
 {
   g_assert(context->timer != NULL);
 
-  timer_wheel_mod_timer(self->timer_wheel, context->timer, timeout);
+  timer_wheel_mod_timer(_get_shard(self, &context->key)->timer_wheel, context->timer, timeout);
 }
 
 void
 correlation_state_expire_all(CorrelationState *self, gpointer caller_context)
 {
-  g_mutex_lock(&self->lock);
-  timer_wheel_expire_all(self->timer_wheel, caller_context);
-  g_mutex_unlock(&self->lock);
+  for (gint i = 0; i < self->num_shards; i++)
+    {
+      CorrelationShard *shard = &self->shards[i];
+      CorrelationExpiryBatch batch = { .state = self };
+
+      g_mutex_lock(&shard->lock);
+      timer_wheel_expire_all(shard->timer_wheel, _get_expiry_context(self, &batch, caller_context));
+      g_mutex_unlock(&shard->lock);
+
+      _deliver_expired_contexts(self, shard, &batch, caller_context);
+    }
 }
 
 void
 correlation_state_advance_time(CorrelationState *self, gint timeout, gpointer caller_context)
 {
-  guint64  new_time;
+  for (gint i = 0; i < self->num_shards; i++)
+    {
+      CorrelationShard *shard = &self->shards[i];
 
-  g_mutex_lock(&self->lock);
-  new_time = timer_wheel_get_time(self->timer_wheel) + timeout;
-  timer_wheel_set_time(self->timer_wheel, new_time, caller_context);
-  g_mutex_unlock(&self->lock);
+      g_mutex_lock(&shard->lock);
+      _shard_advance_target_time(shard, timeout);
+      _shard_catch_up_and_unlock(self, shard, caller_context);
+    }
 }
 
-void
-correlation_state_set_time(CorrelationState *self, guint64 sec, gpointer caller_context)
+static void
+_shard_set_time(CorrelationState *self, CorrelationShard *shard, guint64 sec, gpointer caller_context)
 {
   GTimeVal now;
 
@@ -103,42 +216,64 @@ correlation_state_set_time(CorrelationState *self, guint64 sec, gpointer caller_
    * correlation engine too much. */
 
   cached_g_current_time(&now);
-  self->last_tick = now;
+
+  g_mutex_lock(&shard->lock);
+  shard->last_tick = now;
 
   if (sec < now.tv_sec)
     now.tv_sec = sec;
 
-  g_mutex_lock(&self->lock);
-  timer_wheel_set_time(self->timer_wheel, now.tv_sec, caller_context);
-  g_mutex_unlock(&self->lock);
+  shard->target_time = MAX(shard->target_time, now.tv_sec);
+  _shard_catch_up_and_unlock(self, shard, caller_context);
+}
+
+void
+correlation_state_set_time(CorrelationState *self, guint64 sec, gpointer caller_context)
+{
+  for (gint i = 0; i < self->num_shards; i++)
+    _shard_set_time(self, &self->shards[i], sec, caller_context);
+}
+
+/* Only the shard of the key is moved forward, the rest of the shards are
+ * advanced by their own messages or by correlation_state_timer_tick().  */
+void
+correlation_state_set_time_for_key(CorrelationState *self, const CorrelationKey *key, guint64 sec,
+                                   gpointer caller_context)
+{
+  _shard_set_time(self, _get_shard(self, key), sec, caller_context);
 }
 
+/* the time of the shard that is the furthest ahead */
 guint64
 correlation_state_get_time(CorrelationState *self)
 {
-  return timer_wheel_get_time(self->timer_wheel);
+  guint64 now = 0;
+
+  for (gint i = 0; i < self->num_shards; i++)
+    now = MAX(now, timer_wheel_get_time(self->shards[i].timer_wheel));
+  return now;
 }
 
-gboolean
-correlation_state_timer_tick(CorrelationState *self, gpointer caller_context)
+static gboolean
+_shard_timer_tick(CorrelationState *self, CorrelationShard *shard, gpointer caller_context)
 {
   GTimeVal now;
   glong diff;
   gboolean updated = FALSE;
 
-  g_mutex_lock(&self->lock);
+  g_mutex_lock(&shard->lock);
   cached_g_current_time(&now);
-  diff = g_time_val_diff(&now, &self->last_tick);
+  diff = g_time_val_diff(&now, &shard->last_tick);
 
   if (diff > 1e6)
     {
       glong diff_sec = (glong)(diff / 1e6);
 
-      timer_wheel_set_time(self->timer_wheel, timer_wheel_get_time(self->timer_wheel) + diff_sec, caller_context);
+      _shard_advance_target_time(shard, diff_sec);
       /* update last_tick, take the fraction of the seconds not calculated into this update into account */
 
-      self->last_tick = now;
-      g_time_val_add(&self->last_tick, - (glong)(diff - diff_sec * 1e6));
+      shard->last_tick = now;
+      g_time_val_add(&shard->last_tick, - (glong)(diff - diff_sec * 1e6));
       updated = TRUE;
     }
   else if (diff < 0)
@@ -147,35 +282,126 @@ correlation_state_timer_tick(CorrelationState *self, gpointer caller_context)
        * is changed.  We don't update patterndb's idea of the time now, wait
        * another tick instead to update that instead.
        */
-      self->last_tick = now;
+      shard->last_tick = now;
     }
-  g_mutex_unlock(&self->lock);
+
+  /* continues an expiry that was cut short by the budget, even if no time
+   * has passed */
+  _shard_catch_up_and_unlock(self, shard, caller_context);
+  return updated;
+}
+
+gboolean
+correlation_state_timer_tick(CorrelationState *self, gpointer caller_context)
+{
+  gboolean updated = FALSE;
+
+  for (gint i = 0; i < self->num_shards; i++)
+    updated |= _shard_timer_tick(self, &self->shards[i], caller_context);
   return updated;
 }
 
+gboolean
+correlation_state_is_expiry_pending(CorrelationState *self)
+{
+  gboolean pending = FALSE;
+
+  for (gint i = 0; i < self->num_shards && !pending; i++)
+    {
+      CorrelationShard *shard = &self->shards[i];
+
+      g_mutex_lock(&shard->lock);
+      pending = timer_wheel_get_time(shard->timer_wheel) < shard->target_time;
+      g_mutex_unlock(&shard->lock);
+    }
+  return pending;
+}
+
+/* If set, the time of a shard may fall behind when a lot of contexts
+ * expire at once, the rest of the contexts are expired by subsequent time
+ * updates and timer ticks. */
+void
+correlation_state_set_expiry_budget(CorrelationState *self, gint max_expirations)
+{
+  self->max_expirations = max_expirations;
+}
+
+/* NOTE: has to be called before the first context is stored.  In batched
+ * mode the expire callback is invoked without holding any locks and the
+ * context is already removed from the state. */
+void
+correlation_state_enable_batched_expiry(CorrelationState *self)
+{
+  for (gint i = 0; i < self->num_shards; i++)
+    g_assert(g_hash_table_size(self->shards[i].state) == 0);
+
+  self->batched_expiry = TRUE;
+}
+
+/* The associated data is shared by the timer wheels of all shards, but it
+ * is owned by the CorrelationState.  */
+void
+correlation_state_set_associated_data(CorrelationState *self, gpointer assoc_data, GDestroyNotify assoc_data_free)
+{
+  if (self->assoc_data_free)
+    self->assoc_data_free(self->assoc_data);
+  self->assoc_data = assoc_data;
+  self->assoc_data_free = assoc_data_free;
+
+  for (gint i = 0; i < self->num_shards; i++)
+    timer_wheel_set_associated_data(self->shards[i].timer_wheel, assoc_data, NULL);
+}
+
+static void
+_shard_init(CorrelationShard *shard)
+{
+  g_mutex_init(&shard->lock);
+  shard->state = g_hash_table_new_full(correlation_key_hash, correlation_key_equal, NULL,
+                                       (GDestroyNotify) correlation_context_unref);
+  shard->timer_wheel = timer_wheel_new();
+  cached_g_current_time(&shard->last_tick);
+}
+
+static void
+_shard_deinit(CorrelationShard *shard)
+{
+  if (shard->state)
+    g_hash_table_destroy(shard->state);
+  timer_wheel_free(shard->timer_wheel);
+  g_mutex_clear(&shard->lock);
+}
 
 CorrelationState *
-correlation_state_new(TWCallbackFunc expire_callback)
+correlation_state_new_sharded(TWCallbackFunc expire_callback, gint num_shards)
 {
   CorrelationState *self = g_new0(CorrelationState, 1);
 
-  g_mutex_init(&self->lock);
-  self->state = g_hash_table_new_full(correlation_key_hash, correlation_key_equal, NULL,
-                                      (GDestroyNotify) correlation_context_unref);
-  self->timer_wheel = timer_wheel_new();
-  cached_g_current_time(&self->last_tick);
+  g_assert(num_shards > 0);
+
+  self->num_shards = num_shards;
+  self->shards = g_new0(CorrelationShard, num_shards);
+  for (gint i = 0; i < num_shards; i++)
+    _shard_init(&self->shards[i]);
+
   g_atomic_counter_set(&self->ref_cnt, 1);
   self->expire_callback = expire_callback;
   return self;
 }
 
+CorrelationState *
+correlation_state_new(TWCallbackFunc expire_callback)
+{
+  return correlation_state_new_sharded(expire_callback, 1);
+}
+
 void
 _free(CorrelationState *self)
 {
-  if (self->state)
-    g_hash_table_destroy(self->state);
-  timer_wheel_free(self->timer_wheel);
-  g_mutex_clear(&self->lock);
+  for (gint i = 0; i < self->num_shards; i++)
+    _shard_deinit(&self->shards[i]);
+  g_free(self->shards);
+  if (self->assoc_data_free)
+    self->assoc_data_free(self->assoc_data);
   g_free(self);
 }
 
@@ -29,32 +29,62 @@
 #include "timerwheel.h"
 #include "timeutils/unixtime.h"
 
-typedef struct _CorrelationState
+/* The correlation state is split into shards by the hash of the
+ * CorrelationKey, each with its own lock and timer wheel, so that
+ * unrelated contexts can be updated and expired in parallel.  */
+typedef struct _CorrelationShard
 {
-  GAtomicCounter ref_cnt;
   GMutex lock;
   GHashTable *state;
   TimerWheel *timer_wheel;
-  TWCallbackFunc expire_callback;
   GTimeVal last_tick;
+  /* the time the timer wheel is moving towards, it is behind this if the
+   * expiry budget was exhausted */
+  guint64 target_time;
+} CorrelationShard;
+
+typedef struct _CorrelationState
+{
+  GAtomicCounter ref_cnt;
+  TWCallbackFunc expire_callback;
+  gpointer assoc_data;
+  GDestroyNotify assoc_data_free;
+  /* maximum number of contexts expired in a shard at once, 0 is unlimited */
+  gint max_expirations;
+  gboolean batched_expiry;
+  gint num_shards;
+  CorrelationShard *shards;
 } CorrelationState;
 
+/* transactions spanning all shards */
 void correlation_state_tx_begin(CorrelationState *self);
 void correlation_state_tx_end(CorrelationState *self);
+/* transactions limited to the shard of a single key */
+void correlation_state_tx_begin_for_key(CorrelationState *self, const CorrelationKey *key);
+void correlation_state_tx_end_for_key(CorrelationState *self, const CorrelationKey *key);
+
 CorrelationContext *correlation_state_tx_lookup_context(CorrelationState *self, const CorrelationKey *key);
 void correlation_state_tx_store_context(CorrelationState *self, CorrelationContext *context, gint timeout);
 void correlation_state_tx_remove_context(CorrelationState *self, CorrelationContext *context);
 void correlation_state_tx_update_context(CorrelationState *self, CorrelationContext *context, gint timeout);
 
 void correlation_state_set_time(CorrelationState *self, guint64 sec, gpointer caller_context);
+void correlation_state_set_time_for_key(CorrelationState *self, const CorrelationKey *key, guint64 sec,
+                                        gpointer caller_context);
 guint64 correlation_state_get_time(CorrelationState *self);
 gboolean correlation_state_timer_tick(CorrelationState *self, gpointer caller_context);
 void correlation_state_expire_all(CorrelationState *self, gpointer caller_context);
 void correlation_state_advance_time(CorrelationState *self, gint timeout, gpointer caller_context);
+gboolean correlation_state_is_expiry_pending(CorrelationState *self);
+
+void correlation_state_set_expiry_budget(CorrelationState *self, gint max_expirations);
+void correlation_state_enable_batched_expiry(CorrelationState *self);
+
+void correlation_state_set_associated_data(CorrelationState *self, gpointer assoc_data,
+                                           GDestroyNotify assoc_data_free);
 
-void correlation_state_init_instance(CorrelationState *self);
-void correlation_state_deinit_instance(CorrelationState *self);
 CorrelationState *correlation_state_new(TWCallbackFunc expire);
+CorrelationState *correlation_state_new_sharded(TWCallbackFunc expire, gint num_shards);
 CorrelationState *correlation_state_ref(CorrelationState *self);
 void correlation_state_unref(CorrelationState *self);
 
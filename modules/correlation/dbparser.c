@@ -41,6 +41,7 @@ struct _LogDBParser
   PatternDB *db;
   gchar *db_file;
   gchar *prefix;
+  gchar *cache_dir;
   time_t db_file_last_check;
   ino_t db_file_inode;
   time_t db_file_mtime;
@@ -132,6 +133,7 @@ log_db_parser_init(LogPipe *s)
   if (!self->db)
     self->db = pattern_db_new(self->prefix);
 
+  pattern_db_set_cache_dir(self->db, self->cache_dir);
   log_db_parser_reload_database(self);
   if (self->db)
     {
@@ -230,10 +232,18 @@ log_db_parser_set_db_file(LogDBParser *self, const gchar *db_file)
   self->db_file = g_strdup(db_file);
 }
 
+void
+log_db_parser_set_cache_dir(LogDBParser *self, const gchar *cache_dir)
+{
+  g_free(self->cache_dir);
+  self->cache_dir = g_strdup(cache_dir);
+}
+
 void
 log_db_parser_set_prefix(LogDBParser *self, const gchar *prefix)
 {
   g_free(self->prefix);
+  g_free(self->cache_dir);
   self->prefix = g_strdup(prefix);
 }
 
@@ -256,6 +266,7 @@ log_db_parser_clone(LogPipe *s)
   stateful_parser_clone_settings(&self->super, &cloned->super);
   log_db_parser_set_db_file(cloned, self->db_file);
   log_db_parser_set_prefix(cloned, self->prefix);
+  log_db_parser_set_cache_dir(cloned, self->cache_dir);
   log_db_parser_set_drop_unmatched(cloned, self->drop_unmatched);
   log_db_parser_set_program_template_ref(&cloned->super.super, log_template_ref(self->program_template));
   return &cloned->super.super.super;
@@ -29,16 +29,127 @@
 #include "messages.h"
 #include "grouping-parser.h"
 #include "id-counter.h"
+#include "stats/stats-registry.h"
+#include "stats/stats-cluster-single.h"
 
 #include <iv.h>
 
+/* line buffers larger than this are released when the context is cleared,
+ * as an idle stream would keep them allocated until it times out */
+#define GROUP_LINES_RETAINED_BUFFER_SIZE 1024
+
+/*
+ * Memory accounting of the contexts of a group-lines() instance.
+ *
+ * It lives as long as the contexts referencing it, it is carried over
+ * across reloads together with the CorrelationState.  Contexts are kept in
+ * least recently updated order, so that max-memory() can flush the oldest
+ * ones first.  The counters are only set while a parser instance is
+ * attached.
+ */
+typedef struct _GroupLinesAccounting
+{
+  GAtomicCounter ref_cnt;
+  GMutex lock;
+  GQueue contexts;
+  gsize memory_usage;
+  StatsCounterItem *active_contexts;
+  StatsCounterItem *memory_bytes;
+} GroupLinesAccounting;
+
+static GroupLinesAccounting *
+group_lines_accounting_new(void)
+{
+  GroupLinesAccounting *self = g_new0(GroupLinesAccounting, 1);
+
+  g_atomic_counter_set(&self->ref_cnt, 1);
+  g_mutex_init(&self->lock);
+  g_queue_init(&self->contexts);
+  return self;
+}
+
+static GroupLinesAccounting *
+group_lines_accounting_ref(GroupLinesAccounting *self)
+{
+  g_atomic_counter_inc(&self->ref_cnt);
+  return self;
+}
+
+static void
+group_lines_accounting_unref(GroupLinesAccounting *self)
+{
+  if (self && g_atomic_counter_dec_and_test(&self->ref_cnt))
+    {
+      g_assert(g_queue_is_empty(&self->contexts));
+      g_mutex_clear(&self->lock);
+      g_free(self);
+    }
+}
+
+/* NOTE: the lock has to be held */
+static void
+group_lines_accounting_update_counters(GroupLinesAccounting *self)
+{
+  stats_counter_set(self->active_contexts, self->contexts.length);
+  stats_counter_set(self->memory_bytes, self->memory_usage);
+}
+
+static void
+group_lines_accounting_set_counters(GroupLinesAccounting *self, StatsCounterItem *active_contexts,
+                                    StatsCounterItem *memory_bytes)
+{
+  g_mutex_lock(&self->lock);
+  self->active_contexts = active_contexts;
+  self->memory_bytes = memory_bytes;
+  group_lines_accounting_update_counters(self);
+  g_mutex_unlock(&self->lock);
+}
+
+static gsize
+group_lines_accounting_get_memory_usage(GroupLinesAccounting *self)
+{
+  g_mutex_lock(&self->lock);
+  gsize memory_usage = self->memory_usage;
+  g_mutex_unlock(&self->lock);
+
+  return memory_usage;
+}
+
 typedef struct _GroupLinesContext
 {
   CorrelationContext super;
   MultiLineLogic *multi_line;
   GString *line_buffer;
+  GroupLinesAccounting *accounting;
+  GList lru_link;
+  gsize accounted_size;
 } GroupLinesContext;
 
+static gsize
+group_lines_context_get_size(GroupLinesContext *self)
+{
+  return sizeof(*self) + strlen(self->super.key.session_id) + self->line_buffer->allocated_len;
+}
+
+/* NOTE: the shard of the context has to be locked */
+static void
+group_lines_context_account(GroupLinesContext *self, gboolean touched)
+{
+  GroupLinesAccounting *accounting = self->accounting;
+  gsize size = group_lines_context_get_size(self);
+
+  g_mutex_lock(&accounting->lock);
+  accounting->memory_usage = accounting->memory_usage - self->accounted_size + size;
+  self->accounted_size = size;
+  if (touched)
+    {
+      g_queue_unlink(&accounting->contexts, &self->lru_link);
+      g_queue_push_tail_link(&accounting->contexts, &self->lru_link);
+    }
+  group_lines_accounting_update_counters(accounting);
+  g_mutex_unlock(&accounting->lock);
+}
+
 static void
 group_lines_context_update(GroupLinesContext *self, LogMessage *msg)
 {
@@ -58,7 +169,14 @@ group_lines_context_clear(CorrelationContext *s)
 {
   GroupLinesContext *self = (GroupLinesContext *) s;
 
-  g_string_truncate(self->line_buffer, 0);
+  if (self->line_buffer->allocated_len > GROUP_LINES_RETAINED_BUFFER_SIZE)
+    {
+      g_string_free(self->line_buffer, TRUE);
+      self->line_buffer = g_string_new(NULL);
+      group_lines_context_account(self, FALSE);
+    }
+  else
+    g_string_truncate(self->line_buffer, 0);
   correlation_context_clear_method(s);
 }
 
@@ -66,21 +184,39 @@ static void
 group_lines_context_free(CorrelationContext *s)
 {
   GroupLinesContext *self = (GroupLinesContext *) s;
+  GroupLinesAccounting *accounting = self->accounting;
 
+  /* correlation_context_free_method() clears the context, which still uses
+   * the line buffer and the accounting */
+  correlation_context_free_method(&self->super);
   multi_line_logic_free(self->multi_line);
   g_string_free(self->line_buffer, TRUE);
-  correlation_context_free_method(&self->super);
+
+  g_mutex_lock(&accounting->lock);
+  g_queue_unlink(&accounting->contexts, &self->lru_link);
+  accounting->memory_usage -= self->accounted_size;
+  group_lines_accounting_update_counters(accounting);
+  g_mutex_unlock(&accounting->lock);
+  group_lines_accounting_unref(accounting);
 }
 
 GroupLinesContext *
-group_lines_context_new(const CorrelationKey *key, MultiLineLogic *multi_line)
+group_lines_context_new(const CorrelationKey *key, MultiLineLogic *multi_line, GroupLinesAccounting *accounting)
 {
   GroupLinesContext *self = g_new0(GroupLinesContext, 1);
   correlation_context_init(&self->super, key);
   self->super.free_fn = group_lines_context_free;
   self->super.clear = group_lines_context_clear;
-  self->line_buffer = g_string_sized_new(1024);
+  /* most streams are short lived, the buffer grows with the first fragments */
+  self->line_buffer = g_string_new(NULL);
   self->multi_line = multi_line;
+  self->accounting = group_lines_accounting_ref(accounting);
+  self->lru_link.data = self;
+
+  g_mutex_lock(&accounting->lock);
+  g_queue_push_tail_link(&accounting->contexts, &self->lru_link);
+  g_mutex_unlock(&accounting->lock);
+  group_lines_context_account(self, FALSE);
   return self;
 }
 
@@ -92,6 +228,11 @@ typedef struct _GroupLines
   gchar *separator;
   gsize separator_len;
   MultiLineOptions multi_line_options;
+  gsize max_memory;
+  GroupLinesAccounting *accounting;
+  StatsCounterItem *active_contexts;
+  StatsCounterItem *memory_bytes;
+  StatsCounterItem *forced_flushes;
 } GroupLines;
 
 /* public functions */
@@ -114,12 +255,21 @@ group_lines_set_separator(LogParser *s, const gchar *separator)
   self->separator_len = strlen(self->separator);
 }
 
+void
+group_lines_set_max_memory(LogParser *s, gsize max_memory)
+{
+  GroupLines *self = (GroupLines *) s;
+
+  self->max_memory = max_memory;
+}
+
 static CorrelationContext *
 _construct_context(GroupingParser *s, CorrelationKey *key)
 {
   GroupLines *self = (GroupLines *) s;
 
-  return &group_lines_context_new(key, multi_line_factory_construct(&self->multi_line_options))->super;
+  return &group_lines_context_new(key, multi_line_factory_construct(&self->multi_line_options),
+                                  self->accounting)->super;
 }
 
 static void
@@ -135,6 +285,7 @@ _update_context_add_message(GroupLines *self, GroupLinesContext *context, LogMes
   if (context->line_buffer->len)
     g_string_append_len(context->line_buffer, self->separator, self->separator_len);
   g_string_append_len(context->line_buffer, line, line_len);
+  group_lines_context_account(context, TRUE);
 }
 
 static const gchar *
@@ -228,6 +379,196 @@ _aggregate_context(GroupingParser *s, CorrelationContext *c)
   return msg;
 }
 
+/* the key of a context is owned by the context, this copy survives it */
+static void
+_copy_key(CorrelationKey *dst, const CorrelationKey *src)
+{
+  *dst = *src;
+  dst->host = g_strdup(src->host);
+  dst->program = g_strdup(src->program);
+  dst->pid = g_strdup(src->pid);
+  dst->session_id = g_strdup(src->session_id);
+}
+
+static void
+_free_key(CorrelationKey *key)
+{
+  g_free((gchar *) key->host);
+  g_free((gchar *) key->program);
+  g_free((gchar *) key->pid);
+  g_free(key->session_id);
+}
+
+static gboolean
+_copy_least_recently_updated_key(GroupLines *self, CorrelationKey *key)
+{
+  GroupLinesAccounting *accounting = self->accounting;
+  gboolean found = FALSE;
+
+  g_mutex_lock(&accounting->lock);
+  GroupLinesContext *context = g_queue_peek_head(&accounting->contexts);
+  if (context)
+    {
+      _copy_key(key, &context->super.key);
+      found = TRUE;
+    }
+  g_mutex_unlock(&accounting->lock);
+
+  return found;
+}
+
+/* NOTE: called without holding any of the shard locks, the accounting lock
+ * is never held while taking a shard lock */
+static gboolean
+_flush_least_recently_updated_context(GroupLines *self, StatefulParserEmittedMessages *emitted_messages)
+{
+  CorrelationState *correlation = self->super.correlation;
+  CorrelationKey key;
+
+  if (!_copy_least_recently_updated_key(self, &key))
+    return FALSE;
+
+  correlation_state_tx_begin_for_key(correlation, &key);
+  CorrelationContext *context = correlation_state_tx_lookup_context(correlation, &key);
+  if (context)
+    {
+      correlation_context_ref(context);
+      correlation_state_tx_remove_context(correlation, context);
+    }
+  correlation_state_tx_end_for_key(correlation, &key);
+
+  if (context)
+    {
+      msg_debug("group-lines: memory limit reached, flushing the least recently updated context",
+                evt_tag_str("key", key.session_id),
+                evt_tag_long("max_memory", self->max_memory),
+                log_pipe_location_tag(&self->super.super.super.super));
+
+      LogMessage *msg = grouping_parser_aggregate_context(&self->super, context);
+      correlation_context_unref(context);
+      stats_counter_inc(self->forced_flushes);
+
+      if (msg)
+        {
+          stateful_parser_emitted_messages_add(emitted_messages, msg);
+          log_msg_unref(msg);
+        }
+    }
+  _free_key(&key);
+
+  /* the oldest context may be on its way out through expiration, we retry
+   * with the next message in that case */
+  return context != NULL;
+}
+
+static void
+_enforce_memory_limit(GroupLines *self, StatefulParserEmittedMessages *emitted_messages)
+{
+  if (!self->max_memory)
+    return;
+
+  while (group_lines_accounting_get_memory_usage(self->accounting) > self->max_memory)
+    {
+      if (!_flush_least_recently_updated_context(self, emitted_messages))
+        break;
+    }
+}
+
+static gboolean
+_process(LogParser *s, LogMessage **pmsg, const LogPathOptions *path_options, const char *input, gsize input_len)
+{
+  GroupLines *self = (GroupLines *) s;
+  StatefulParserEmittedMessages emitted_messages = STATEFUL_PARSER_EMITTED_MESSAGES_INIT;
+
+  grouping_parser_perform_grouping(&self->super, *pmsg, &emitted_messages);
+  _enforce_memory_limit(self, &emitted_messages);
+  stateful_parser_emitted_messages_flush(&emitted_messages, &self->super.super);
+
+  return (self->super.super.inject_mode != LDBP_IM_AGGREGATE_ONLY);
+}
+
+static void
+_init_stats_key(GroupLines *self, StatsClusterKey *sc_key, const gchar *name, StatsClusterLabel *labels,
+                gchar *clone_str, gsize clone_str_len)
+{
+  const gchar *id = self->super.super.super.name ? : "group-lines";
+
+  g_snprintf(clone_str, clone_str_len, "%u", self->clone_id);
+  labels[0] = stats_cluster_label("id", id);
+  labels[1] = stats_cluster_label("clone", clone_str);
+  stats_cluster_single_key_set(sc_key, name, labels, 2);
+}
+
+static void
+_register_counters(GroupLines *self)
+{
+  gint level = log_pipe_is_internal(&self->super.super.super.super) ? STATS_LEVEL3 : STATS_LEVEL1;
+  StatsClusterLabel labels[2];
+  gchar clone_str[16];
+  StatsClusterKey sc_key;
+
+  stats_lock();
+  _init_stats_key(self, &sc_key, "group_lines_active_contexts", labels, clone_str, sizeof(clone_str));
+  stats_register_counter(level, &sc_key, SC_TYPE_SINGLE_VALUE, &self->active_contexts);
+  _init_stats_key(self, &sc_key, "group_lines_memory_bytes", labels, clone_str, sizeof(clone_str));
+  stats_register_counter(level, &sc_key, SC_TYPE_SINGLE_VALUE, &self->memory_bytes);
+  _init_stats_key(self, &sc_key, "group_lines_forced_flushes_total", labels, clone_str, sizeof(clone_str));
+  stats_register_counter(level, &sc_key, SC_TYPE_SINGLE_VALUE, &self->forced_flushes);
+  stats_unlock();
+
+  group_lines_accounting_set_counters(self->accounting, self->active_contexts, self->memory_bytes);
+}
+
+static void
+_unregister_counters(GroupLines *self)
+{
+  StatsClusterLabel labels[2];
+  gchar clone_str[16];
+  StatsClusterKey sc_key;
+
+  group_lines_accounting_set_counters(self->accounting, NULL, NULL);
+
+  stats_lock();
+  _init_stats_key(self, &sc_key, "group_lines_active_contexts", labels, clone_str, sizeof(clone_str));
+  stats_unregister_counter(&sc_key, SC_TYPE_SINGLE_VALUE, &self->active_contexts);
+  _init_stats_key(self, &sc_key, "group_lines_memory_bytes", labels, clone_str, sizeof(clone_str));
+  stats_unregister_counter(&sc_key, SC_TYPE_SINGLE_VALUE, &self->memory_bytes);
+  _init_stats_key(self, &sc_key, "group_lines_forced_flushes_total", labels, clone_str, sizeof(clone_str));
+  stats_unregister_counter(&sc_key, SC_TYPE_SINGLE_VALUE, &self->forced_flushes);
+  stats_unlock();
+}
+
+static const gchar *
+_format_accounting_persist_name(GroupLines *self)
+{
+  static gchar persist_name[1024];
+
+  g_snprintf(persist_name, sizeof(persist_name), "%s.accounting",
+             log_pipe_get_persist_name(&self->super.super.super.super));
+  return persist_name;
+}
+
+/* the contexts carried over with the CorrelationState keep referencing
+ * the accounting of the previous instance */
+static void
+_load_accounting(GroupLines *self, GlobalConfig *cfg)
+{
+  GroupLinesAccounting *persisted_accounting = cfg_persist_config_fetch(cfg, _format_accounting_persist_name(self));
+
+  if (persisted_accounting)
+    {
+      group_lines_accounting_unref(self->accounting);
+      self->accounting = persisted_accounting;
+    }
+}
+
+static void
+_store_accounting(GroupLines *self, GlobalConfig *cfg)
+{
+  cfg_persist_config_add(cfg, _format_accounting_persist_name(self), group_lines_accounting_ref(self->accounting),
+                         (GDestroyNotify) group_lines_accounting_unref);
+}
+
 static const gchar *
 _format_persist_name(const LogPipe *s)
 {
@@ -266,7 +607,23 @@ _init(LogPipe *s)
 
   if (!multi_line_options_validate(&self->multi_line_options))
     return FALSE;
-  return grouping_parser_init_method(s);
+
+  _load_accounting(self, log_pipe_get_config(s));
+  if (!grouping_parser_init_method(s))
+    return FALSE;
+
+  _register_counters(self);
+  return TRUE;
+}
+
+static gboolean
+_deinit(LogPipe *s)
+{
+  GroupLines *self = (GroupLines *) s;
+
+  _unregister_counters(self);
+  _store_accounting(self, log_pipe_get_config(s));
+  return grouping_parser_deinit_method(s);
 }
 
 static LogPipe *
@@ -278,6 +635,7 @@ _clone(LogPipe *s)
   cloned = (GroupLines *) group_lines_new(s->cfg);
   grouping_parser_clone_settings(&self->super, &cloned->super);
   group_lines_set_separator(&cloned->super.super.super, self->separator);
+  group_lines_set_max_memory(&cloned->super.super.super, self->max_memory);
 
   multi_line_options_copy(&cloned->multi_line_options, &self->multi_line_options);
 
@@ -297,6 +655,7 @@ _free(LogPipe *s)
 
   multi_line_options_destroy(&self->multi_line_options);
   g_free(self->separator);
+  group_lines_accounting_unref(self->accounting);
   grouping_parser_free_method(s);
 }
 
@@ -306,9 +665,11 @@ group_lines_new(GlobalConfig *cfg)
   GroupLines *self = g_new0(GroupLines, 1);
   self->id_counter = id_counter_new();
   self->clone_id = id_counter_get_next_id(self->id_counter);
+  self->accounting = group_lines_accounting_new();
 
   grouping_parser_init_instance(&self->super, cfg);
   self->super.super.super.super.init = _init;
+  self->super.super.super.super.deinit = _deinit;
   self->super.super.super.super.free_fn = _free;
   self->super.super.super.super.clone = _clone;
   self->super.super.super.super.generate_persist_name = _format_persist_name;
@@ -317,6 +678,7 @@ group_lines_new(GlobalConfig *cfg)
   self->super.update_context = _update_context;
   self->super.aggregate_context = _aggregate_context;
   self->super.super.inject_mode = LDBP_IM_AGGREGATE_ONLY;
+  self->super.super.super.process = _process;
   group_lines_set_separator(&self->super.super.super, "\n");
   multi_line_options_defaults(&self->multi_line_options);
   return &self->super.super.super;
@@ -28,6 +28,7 @@
 
 MultiLineOptions *group_lines_get_multi_line_options(LogParser *s);
 void group_lines_set_separator(LogParser *s, const gchar *separator);
+void group_lines_set_max_memory(LogParser *s, gsize max_memory);
 LogParser *group_lines_new(GlobalConfig *cfg);
 
 #endif
@@ -21,6 +21,7 @@
  *
  */
 #include "grouping-parser.h"
+#include "correlation-snapshot.h"
 #include "scratch-buffers.h"
 #include "str-utils.h"
 
@@ -58,6 +59,22 @@ grouping_parser_set_timeout(LogParser *s, gint timeout)
   self->timeout = timeout;
 }
 
+void
+grouping_parser_set_max_expirations_per_tick(LogParser *s, gint max_expirations)
+{
+  GroupingParser *self = (GroupingParser *) s;
+
+  self->max_expirations_per_tick = max_expirations;
+}
+
+void
+grouping_parser_set_persist_contexts(LogParser *s, gboolean persist_contexts)
+{
+  GroupingParser *self = (GroupingParser *) s;
+
+  self->persist_contexts = persist_contexts;
+}
+
 void
 grouping_parser_clone_settings(GroupingParser *self, GroupingParser *cloned)
 {
@@ -65,6 +82,8 @@ grouping_parser_clone_settings(GroupingParser *self, GroupingParser *cloned)
   grouping_parser_set_key_template(&cloned->super.super, self->key_template);
   grouping_parser_set_sort_key_template(&cloned->super.super, self->sort_key_template);
   grouping_parser_set_timeout(&cloned->super.super, self->timeout);
+  grouping_parser_set_max_expirations_per_tick(&cloned->super.super, self->max_expirations_per_tick);
+  grouping_parser_set_persist_contexts(&cloned->super.super, self->persist_contexts);
   grouping_parser_set_scope(&cloned->super.super, self->scope);
 }
 
@@ -98,48 +117,84 @@ _timer_tick(gpointer s)
   _advance_time_by_timer_tick(self);
   iv_validate_now();
   self->tick.expires = iv_now;
-  self->tick.expires.tv_sec++;
+
+  /* if the expiry budget was exhausted, continue expiring as soon as the
+   * main loop has processed the pending events */
+  if (!correlation_state_is_expiry_pending(self->correlation))
+    self->tick.expires.tv_sec++;
   iv_timer_register(&self->tick);
 }
 
-/* NOTE: lock is acquired within correlation_state_set_time() */
-void
-_advance_time_based_on_message(GroupingParser *self, const UnixTime *ls,
+/* NOTE: lock is acquired within correlation_state_set_time_for_key(), only
+ * the shard of the key is advanced */
+static void
+_advance_time_based_on_message(GroupingParser *self, const CorrelationKey *key, const UnixTime *ls,
                                StatefulParserEmittedMessages *emitted_messages)
 {
-  correlation_state_set_time(self->correlation, ls->ut_sec, emitted_messages);
+  correlation_state_set_time_for_key(self->correlation, key, ls->ut_sec, emitted_messages);
   msg_debug("grouping-parser: advancing current time because of an incoming message",
             evt_tag_long("utc", correlation_state_get_time(self->correlation)),
             log_pipe_location_tag(&self->super.super.super));
 }
 
+static CorrelationContext *
+_construct_restored_context(CorrelationKey *key, gpointer user_data)
+{
+  GroupingParser *self = (GroupingParser *) user_data;
+
+  return grouping_parser_construct_context(self, key);
+}
+
 static void
 _load_correlation_state(GroupingParser *self, GlobalConfig *cfg)
 {
-  CorrelationState *persisted_correlation = cfg_persist_config_fetch(cfg,
-                                            log_pipe_get_persist_name(&self->super.super.super));
+  const gchar *persist_name = log_pipe_get_persist_name(&self->super.super.super);
+  CorrelationState *persisted_correlation = cfg_persist_config_fetch(cfg, persist_name);
+
   if (persisted_correlation)
     {
       correlation_state_unref(self->correlation);
       self->correlation = persisted_correlation;
     }
 
-  timer_wheel_set_associated_data(self->correlation->timer_wheel, log_pipe_ref((LogPipe *)self),
-                                  (GDestroyNotify)log_pipe_unref);
+  correlation_state_set_associated_data(self->correlation, log_pipe_ref((LogPipe *)self),
+                                       (GDestroyNotify)log_pipe_unref);
+  correlation_state_set_expiry_budget(self->correlation, self->max_expirations_per_tick);
+
+  /* contexts are kept in memory during reload, the snapshot is only used
+   * after a restart */
+  if (!persisted_correlation && self->persist_contexts && cfg->state)
+    correlation_state_restore_snapshot(self->correlation, cfg->state, persist_name,
+                                       _construct_restored_context, self);
 }
 
 static void
 _store_data_in_persist(GroupingParser *self, GlobalConfig *cfg)
 {
+  /* cfg->persist is only set while reloading, otherwise we are shutting down */
+  if (!cfg->persist && self->persist_contexts && cfg->state)
+    correlation_state_save_snapshot(self->correlation, cfg->state, log_pipe_get_persist_name(&self->super.super.super));
+
   cfg_persist_config_add(cfg, log_pipe_get_persist_name(&self->super.super.super),
                          correlation_state_ref(self->correlation),
                          (GDestroyNotify) correlation_state_unref);
 }
 
+/* contexts restored from a snapshot keep their messages serialized until
+ * they are first used */
+static void
+_restore_messages(GroupingParser *self, CorrelationContext *context)
+{
+  if (!correlation_context_restore_messages(context))
+    msg_error("grouping-parser: Error restoring the messages of a correlation context from the snapshot",
+              evt_tag_str("key", context->key.session_id),
+              log_pipe_location_tag(&self->super.super.super));
+}
 
 LogMessage *
 grouping_parser_aggregate_context(GroupingParser *self, CorrelationContext *context)
 {
+  _restore_messages(self, context);
   if (context->messages->len == 0)
     return NULL;
 
@@ -156,6 +211,8 @@ grouping_parser_aggregate_context(GroupingParser *self, CorrelationContext *cont
   return msg;
 }
 
+/* NOTE: expiry is batched, this is called without holding the lock of the
+ * shard and the context is already removed from the correlation state */
 static void
 _expire_entry(TimerWheel *wheel, guint64 now, gpointer user_data, gpointer caller_context)
 {
@@ -168,9 +225,7 @@ _expire_entry(TimerWheel *wheel, guint64 now, gpointer user_data, gpointer calle
             evt_tag_str("context-id", context->key.session_id),
             log_pipe_location_tag(&self->super.super.super));
 
-  context->timer = NULL;
   LogMessage *msg = grouping_parser_aggregate_context(self, context);
-  correlation_state_tx_remove_context(self->correlation, context);
 
   if (msg)
     {
@@ -180,33 +235,42 @@ _expire_entry(TimerWheel *wheel, guint64 now, gpointer user_data, gpointer calle
 }
 
 
-CorrelationContext *
-grouping_parser_lookup_or_create_context(GroupingParser *self, LogMessage *msg)
+/* the session_id of the key points into the returned scratch buffer */
+static GString *
+_format_key(GroupingParser *self, LogMessage *msg, CorrelationKey *key)
 {
-  CorrelationContext *context;
-  CorrelationKey key;
   GString *buffer = scratch_buffers_alloc();
 
   log_template_format(self->key_template, msg, &DEFAULT_TEMPLATE_EVAL_OPTIONS, buffer);
+  correlation_key_init(key, self->scope, msg, buffer->str);
+  return buffer;
+}
 
-  correlation_key_init(&key, self->scope, msg, buffer->str);
-  context = correlation_state_tx_lookup_context(self->correlation, &key);
+/* NOTE: the shard of the key has to be locked, key_buffer is taken over
+ * by the context if a new one is created */
+CorrelationContext *
+grouping_parser_lookup_or_create_context(GroupingParser *self, CorrelationKey *key, GString *key_buffer)
+{
+  CorrelationContext *context;
+
+  context = correlation_state_tx_lookup_context(self->correlation, key);
   if (!context)
     {
       msg_debug("grouping-parser: Correlation context lookup failure, starting a new context",
-                evt_tag_str("key", key.session_id),
+                evt_tag_str("key", key->session_id),
                 evt_tag_int("timeout", self->timeout),
                 evt_tag_int("expiration", correlation_state_get_time(self->correlation) + self->timeout),
                 log_pipe_location_tag(&self->super.super.super));
 
-      context = grouping_parser_construct_context(self, &key);
+      context = grouping_parser_construct_context(self, key);
       correlation_state_tx_store_context(self->correlation, context, self->timeout);
-      g_string_steal(buffer);
+      g_string_steal(key_buffer);
     }
   else
     {
+      _restore_messages(self, context);
       msg_debug("grouping-parser: Correlation context lookup successful",
-                evt_tag_str("key", key.session_id),
+                evt_tag_str("key", key->session_id),
                 evt_tag_int("timeout", self->timeout),
                 evt_tag_int("expiration", correlation_state_get_time(self->correlation) + self->timeout),
                 evt_tag_int("num_messages", context->messages->len),
@@ -221,7 +285,7 @@ _aggregate_and_emit(GroupingParser *self, CorrelationContext *context, StatefulP
 {
   LogMessage *genmsg = grouping_parser_aggregate_context(self, context);
   correlation_state_tx_update_context(self->correlation, context, self->timeout);
-  correlation_state_tx_end(self->correlation);
+  correlation_state_tx_end_for_key(self->correlation, &context->key);
   if (genmsg)
     {
       stateful_parser_emitted_messages_add(emitted_messages, genmsg);
@@ -232,9 +296,13 @@ _aggregate_and_emit(GroupingParser *self, CorrelationContext *context, StatefulP
 void
 grouping_parser_perform_grouping(GroupingParser *self, LogMessage *msg, StatefulParserEmittedMessages *emitted_messages)
 {
-  correlation_state_tx_begin(self->correlation);
+  CorrelationKey key;
+  GString *key_buffer = _format_key(self, msg, &key);
+
+  _advance_time_based_on_message(self, &key, &msg->timestamps[LM_TS_STAMP], emitted_messages);
+  correlation_state_tx_begin_for_key(self->correlation, &key);
 
-  CorrelationContext *context = grouping_parser_lookup_or_create_context(self, msg);
+  CorrelationContext *context = grouping_parser_lookup_or_create_context(self, &key, key_buffer);
 
   GroupingParserUpdateContextResult r = grouping_parser_update_context(self, context, msg);
 
@@ -246,7 +314,7 @@ grouping_parser_perform_grouping(GroupingParser *self, LogMessage *msg, Stateful
                 evt_tag_int("expiration", correlation_state_get_time(self->correlation) + self->timeout),
                 log_pipe_location_tag(&self->super.super.super));
       correlation_state_tx_update_context(self->correlation, context, self->timeout);
-      correlation_state_tx_end(self->correlation);
+      correlation_state_tx_end_for_key(self->correlation, &context->key);
     }
   else if (r == GP_CONTEXT_COMPLETE)
     {
@@ -281,7 +349,6 @@ grouping_parser_process_method(LogParser *s,
       LogMessage *msg = *pmsg;
 
       StatefulParserEmittedMessages emitted_messages = STATEFUL_PARSER_EMITTED_MESSAGES_INIT;
-      _advance_time_based_on_message(self, &msg->timestamps[LM_TS_STAMP], &emitted_messages);
 
       grouping_parser_perform_grouping(self, msg, &emitted_messages);
       stateful_parser_emitted_messages_flush(&emitted_messages, &self->super);
@@ -346,7 +413,8 @@ grouping_parser_init_instance(GroupingParser *self, GlobalConfig *cfg)
   self->super.super.process = grouping_parser_process_method;
   self->scope = RCS_GLOBAL;
   self->timeout = -1;
-  self->correlation = correlation_state_new(_expire_entry);
+  self->correlation = correlation_state_new_sharded(_expire_entry, GROUPING_PARSER_CORRELATION_SHARDS);
+  correlation_state_enable_batched_expiry(self->correlation);
 }
 
 void
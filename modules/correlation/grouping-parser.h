@@ -27,6 +27,9 @@
 #include "correlation.h"
 #include <iv.h>
 
+/* number of independently locked shards of the correlation state */
+#define GROUPING_PARSER_CORRELATION_SHARDS 16
+
 typedef struct _GroupingParser GroupingParser;
 
 typedef enum
@@ -44,6 +47,8 @@ struct _GroupingParser
   LogTemplate *key_template;
   LogTemplate *sort_key_template;
   gint timeout;
+  gint max_expirations_per_tick;
+  gboolean persist_contexts;
   CorrelationScope scope;
   gboolean (*filter_messages)(GroupingParser *self, LogMessage **pmsg, const LogPathOptions *path_options);
   CorrelationContext *(*construct_context)(GroupingParser *self, CorrelationKey *key);
@@ -79,10 +84,13 @@ void grouping_parser_set_key_template(LogParser *s, LogTemplate *key_template);
 void grouping_parser_set_sort_key_template(LogParser *s, LogTemplate *sort_key);
 void grouping_parser_set_scope(LogParser *s, CorrelationScope scope);
 void grouping_parser_set_timeout(LogParser *s, gint timeout);
+void grouping_parser_set_max_expirations_per_tick(LogParser *s, gint max_expirations);
+void grouping_parser_set_persist_contexts(LogParser *s, gboolean persist_contexts);
 void grouping_parser_clone_settings(GroupingParser *self, GroupingParser *cloned);
 
 
-CorrelationContext *grouping_parser_lookup_or_create_context(GroupingParser *self, LogMessage *msg);
+CorrelationContext *grouping_parser_lookup_or_create_context(GroupingParser *self, CorrelationKey *key,
+                                                             GString *key_buffer);
 void grouping_parser_perform_grouping(GroupingParser *s, LogMessage *msg,
                                       StatefulParserEmittedMessages *emitted_mesages);
 
@@ -36,6 +36,7 @@
 #include "str-utils.h"
 #include "filter/filter-expr-parser.h"
 #include "logpipe.h"
+#include "mainloop-worker.h"
 #include "timeutils/cache.h"
 #include "timeutils/misc.h"
 
@@ -59,16 +60,36 @@ typedef struct _PDBProcessParams
   gint num_emitted_messages;
 } PDBProcessParams;
 
+/*
+ * The ruleset is published through an atomic pointer and looked up without
+ * taking any locks.  Each worker thread has its own epoch counter, which is
+ * odd while the thread is looking up a rule.  When the ruleset is replaced,
+ * the old one is only dropped once all threads that were in the middle of
+ * a lookup at the time of the swap have left it.  Threads that have no
+ * worker index (the main thread for instance) are counted in
+ * ruleset_unindexed_readers instead.
+ */
+typedef union _PatternDBRulesetReader
+{
+  gint epoch;
+  /* keep the epochs of different threads in different cachelines */
+  gchar __padding[64];
+} PatternDBRulesetReader;
+
 struct _PatternDB
 {
+  /* serializes ruleset reloads, lookups don't use it */
   GMutex ruleset_lock;
   PDBRuleSet *ruleset;
+  PatternDBRulesetReader *ruleset_readers;
+  gint ruleset_unindexed_readers;
   CorrelationState *correlation;
   LogTemplate *program_template;
   GHashTable *rate_limits;
   PatternDBEmitFunc emit;
   gpointer emit_data;
   gchar *prefix;
+  gchar *cache_dir;
 };
 
 /* This function is called to populate the emitted_messages array in
@@ -448,26 +469,80 @@ pattern_db_advance_time(PatternDB *self, gint timeout)
   _flush_emitted_messages(self, &process_params);
 }
 
+static PDBRuleSet *
+_ruleset_read_begin(PatternDB *self, gint *reader)
+{
+  *reader = main_loop_worker_get_thread_index();
+
+  if (*reader >= 0 && *reader < MAIN_LOOP_MAX_WORKER_THREADS)
+    {
+      g_atomic_int_inc(&self->ruleset_readers[*reader].epoch);
+    }
+  else
+    {
+      *reader = -1;
+      g_atomic_int_inc(&self->ruleset_unindexed_readers);
+    }
+  return (PDBRuleSet *) g_atomic_pointer_get(&self->ruleset);
+}
+
+static void
+_ruleset_read_end(PatternDB *self, gint reader)
+{
+  if (reader >= 0)
+    g_atomic_int_inc(&self->ruleset_readers[reader].epoch);
+  else
+    g_atomic_int_dec_and_test(&self->ruleset_unindexed_readers);
+}
+
+/* wait until none of the lookups that were running when this function was
+ * called can still reference the previous ruleset */
+static void
+_ruleset_wait_for_readers(PatternDB *self)
+{
+  gint epochs[MAIN_LOOP_MAX_WORKER_THREADS];
+
+  for (gint i = 0; i < MAIN_LOOP_MAX_WORKER_THREADS; i++)
+    epochs[i] = g_atomic_int_get(&self->ruleset_readers[i].epoch);
+
+  for (gint i = 0; i < MAIN_LOOP_MAX_WORKER_THREADS; i++)
+    {
+      if ((epochs[i] & 1) == 0)
+        continue;
+
+      while (g_atomic_int_get(&self->ruleset_readers[i].epoch) == epochs[i])
+        g_thread_yield();
+    }
+
+  while (g_atomic_int_get(&self->ruleset_unindexed_readers) > 0)
+    g_thread_yield();
+}
+
+/* The new ruleset is compiled by the calling thread, while others continue
+ * their lookups against the current one, only the pointer swap is visible to
+ * them.  */
 gboolean
 pattern_db_reload_ruleset(PatternDB *self, GlobalConfig *cfg, const gchar *pdb_file)
 {
-  PDBRuleSet *new_ruleset;
+  PDBRuleSet *new_ruleset, *old_ruleset;
 
   new_ruleset = pdb_rule_set_new(self->prefix);
-  if (!pdb_rule_set_load(new_ruleset, cfg, pdb_file, NULL))
+  if (!pdb_rule_set_load(new_ruleset, cfg, pdb_file, self->cache_dir, NULL))
     {
-      pdb_rule_set_free(new_ruleset);
+      pdb_rule_set_unref(new_ruleset);
       return FALSE;
     }
-  else
-    {
-      g_mutex_lock(&self->ruleset_lock);
-      if (self->ruleset)
-        pdb_rule_set_free(self->ruleset);
-      self->ruleset = new_ruleset;
-      g_mutex_unlock(&self->ruleset_lock);
-      return TRUE;
-    }
+  pdb_rule_set_freeze(new_ruleset);
+
+  g_mutex_lock(&self->ruleset_lock);
+  old_ruleset = self->ruleset;
+  g_atomic_pointer_set(&self->ruleset, new_ruleset);
+  _ruleset_wait_for_readers(self);
+  g_mutex_unlock(&self->ruleset_lock);
+
+  if (old_ruleset)
+    pdb_rule_set_unref(old_ruleset);
+  return TRUE;
 }
 
 
@@ -478,6 +553,14 @@ pattern_db_set_emit_func(PatternDB *self, PatternDBEmitFunc emit, gpointer emit_
   self->emit_data = emit_data;
 }
 
+/* the precompiled cache of the rulesets is only used if this is set, see pdb-cache.h */
+void
+pattern_db_set_cache_dir(PatternDB *self, const gchar *cache_dir)
+{
+  g_free(self->cache_dir);
+  self->cache_dir = g_strdup(cache_dir);
+}
+
 void
 pattern_db_set_program_template(PatternDB *self, LogTemplate *program_template)
 {
@@ -488,25 +571,25 @@ pattern_db_set_program_template(PatternDB *self, LogTemplate *program_template)
 const gchar *
 pattern_db_get_ruleset_pub_date(PatternDB *self)
 {
-  return self->ruleset->pub_date;
+  return ((PDBRuleSet *) g_atomic_pointer_get(&self->ruleset))->pub_date;
 }
 
 const gchar *
 pattern_db_get_ruleset_version(PatternDB *self)
 {
-  return self->ruleset->version;
+  return ((PDBRuleSet *) g_atomic_pointer_get(&self->ruleset))->version;
 }
 
 PDBRuleSet *
 pattern_db_get_ruleset(PatternDB *self)
 {
-  return self->ruleset;
+  return (PDBRuleSet *) g_atomic_pointer_get(&self->ruleset);
 }
 
 static gboolean
-_pattern_db_is_empty(PatternDB *self)
+_pattern_db_is_empty(PDBRuleSet *ruleset)
 {
-  return (G_UNLIKELY(!self->ruleset) || self->ruleset->is_empty);
+  return (G_UNLIKELY(!ruleset) || ruleset->is_empty);
 }
 
 static void
@@ -593,16 +676,17 @@ _pattern_db_process(PatternDB *self, PDBLookupParams *lookup, GArray *dbg_list)
   LogMessage *msg = lookup->msg;
   PDBProcessParams process_params_p = {0};
   PDBProcessParams *process_params = &process_params_p;
+  gint reader;
 
-  g_mutex_lock(&self->ruleset_lock);
-  if (_pattern_db_is_empty(self))
+  PDBRuleSet *ruleset = _ruleset_read_begin(self, &reader);
+  if (_pattern_db_is_empty(ruleset))
     {
-      g_mutex_unlock(&self->ruleset_lock);
+      _ruleset_read_end(self, reader);
       return FALSE;
     }
-  process_params->rule = pdb_ruleset_lookup(self->ruleset, lookup, dbg_list);
+  process_params->rule = pdb_ruleset_lookup(ruleset, lookup, dbg_list);
   process_params->msg = msg;
-  g_mutex_unlock(&self->ruleset_lock);
+  _ruleset_read_end(self, reader);
 
   _pattern_db_advance_time_and_flush_expired(self, msg);
 
@@ -658,7 +742,7 @@ _init_state(PatternDB *self)
   self->rate_limits = g_hash_table_new_full(correlation_key_hash, correlation_key_equal, NULL,
                                             (GDestroyNotify) pdb_rate_limit_free);
   self->correlation = correlation_state_new(pattern_db_expire_entry);
-  timer_wheel_set_associated_data(self->correlation->timer_wheel, self, NULL);
+  correlation_state_set_associated_data(self->correlation, self, NULL);
 }
 
 static void
@@ -686,6 +770,7 @@ pattern_db_new(const gchar *prefix)
 
   self->prefix = g_strdup(prefix);
   self->ruleset = pdb_rule_set_new(self->prefix);
+  self->ruleset_readers = g_new0(PatternDBRulesetReader, MAIN_LOOP_MAX_WORKER_THREADS);
   g_mutex_init(&self->ruleset_lock);
   _init_state(self);
   return self;
@@ -695,9 +780,11 @@ void
 pattern_db_free(PatternDB *self)
 {
   g_free(self->prefix);
+  g_free(self->cache_dir);
   log_template_unref(self->program_template);
   if (self->ruleset)
-    pdb_rule_set_free(self->ruleset);
+    pdb_rule_set_unref(self->ruleset);
+  g_free(self->ruleset_readers);
   _destroy_state(self);
   g_mutex_clear(&self->ruleset_lock);
   g_free(self);
@@ -33,6 +33,7 @@ typedef struct _PatternDB PatternDB;
 typedef void (*PatternDBEmitFunc)(LogMessage *msg, gpointer user_data);
 void pattern_db_set_emit_func(PatternDB *self, PatternDBEmitFunc emit_func, gpointer emit_data);
 void pattern_db_set_program_template(PatternDB *self, LogTemplate *program_template);
+void pattern_db_set_cache_dir(PatternDB *self, const gchar *cache_dir);
 
 PDBRuleSet *pattern_db_get_ruleset(PatternDB *self);
 const gchar *pattern_db_get_ruleset_version(PatternDB *self);
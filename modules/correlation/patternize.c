@@ -96,93 +96,251 @@ ptz_find_frequent_words_remove_key_predicate(gpointer key, gpointer value, gpoin
   return (*((guint *) value) < GPOINTER_TO_UINT(support));
 }
 
-GHashTable *
-ptz_find_frequent_words(GPtrArray *logs, guint support, const gchar *delimiters, gboolean two_pass)
+/*
+ * Worker threads
+ *
+ * The logs are split into contiguous ranges, one for each thread.  The
+ * per-thread results are merged in the order of the ranges, so the outcome
+ * does not depend on the number of threads.
+ */
+typedef void (*PtzWorkerFunc)(GPtrArray *logs, guint start, guint end, gpointer user_data);
+
+typedef struct _PtzWorker
 {
-  int i, j, pass;
-  guint *curr_count;
+  PtzWorkerFunc func;
+  GPtrArray *logs;
+  guint start, end;
+  gpointer user_data;
+} PtzWorker;
+
+static gpointer
+_ptz_worker_thread(gpointer s)
+{
+  PtzWorker *worker = (PtzWorker *) s;
+
+  worker->func(worker->logs, worker->start, worker->end, worker->user_data);
+  return NULL;
+}
+
+static guint
+_ptz_get_num_workers(GPtrArray *logs, guint num_threads)
+{
+  return CLAMP(num_threads, 1, MAX(logs->len, 1));
+}
+
+static void
+_ptz_run_workers(GPtrArray *logs, guint num_workers, PtzWorkerFunc func, gpointer *user_data)
+{
+  PtzWorker *workers = g_new0(PtzWorker, num_workers);
+  GThread **threads = g_new0(GThread *, num_workers);
+  guint i;
+
+  for (i = 0; i < num_workers; i++)
+    {
+      workers[i].func = func;
+      workers[i].logs = logs;
+      workers[i].start = (guint) ((guint64) logs->len * i / num_workers);
+      workers[i].end = (guint) ((guint64) logs->len * (i + 1) / num_workers);
+      workers[i].user_data = user_data[i];
+    }
+
+  /* the first range is processed by the calling thread */
+  for (i = 1; i < num_workers; i++)
+    threads[i] = g_thread_new("patternize", _ptz_worker_thread, &workers[i]);
+  _ptz_worker_thread(&workers[0]);
+  for (i = 1; i < num_workers; i++)
+    g_thread_join(threads[i]);
+
+  g_free(threads);
+  g_free(workers);
+}
+
+/*
+ * Count-min sketch, used as the prefilter of the two pass frequent word
+ * search.  It never underestimates, the exact counts are calculated in the
+ * second pass for the words that pass the filter, so using it does not
+ * change the results, only the memory it requires is bounded.
+ */
+#define PTZ_SKETCH_DEPTH 3
+#define PTZ_SKETCH_MAX_WIDTH (1 << 24)
+
+typedef struct _PtzSketch
+{
+  guint width;
+  guint seeds[PTZ_SKETCH_DEPTH];
+  gint *counters;
+} PtzSketch;
+
+static void
+_ptz_sketch_init(PtzSketch *self, guint width)
+{
+  self->width = CLAMP(width, 1, PTZ_SKETCH_MAX_WIDTH);
+  for (gint i = 0; i < PTZ_SKETCH_DEPTH; i++)
+    self->seeds[i] = rand();
+  self->counters = g_new0(gint, self->width * PTZ_SKETCH_DEPTH);
+}
+
+static void
+_ptz_sketch_add(PtzSketch *self, gchar *key)
+{
+  for (gint i = 0; i < PTZ_SKETCH_DEPTH; i++)
+    g_atomic_int_inc(&self->counters[i * self->width + ptz_str2hash(key, self->width, self->seeds[i])]);
+}
+
+static guint
+_ptz_sketch_estimate(PtzSketch *self, gchar *key)
+{
+  guint estimate = G_MAXUINT;
+
+  for (gint i = 0; i < PTZ_SKETCH_DEPTH; i++)
+    estimate = MIN(estimate, (guint) self->counters[i * self->width + ptz_str2hash(key, self->width, self->seeds[i])]);
+  return estimate;
+}
+
+static void
+_ptz_sketch_destroy(PtzSketch *self)
+{
+  g_free(self->counters);
+}
+
+typedef struct _PtzFrequentWordsState
+{
+  const gchar *delimiters;
+  guint support;
+  /* NULL in the first pass and if the sketch isn't used */
+  PtzSketch *sketch_filter;
+  /* NULL in the first pass */
+  GHashTable *wordlist;
+  PtzSketch *sketch;
+} PtzFrequentWordsState;
+
+static void
+_ptz_count_words(GPtrArray *logs, guint start, guint end, gpointer user_data)
+{
+  PtzFrequentWordsState *state = (PtzFrequentWordsState *) user_data;
+  GString *hash_key = g_string_sized_new(64);
   LogMessage *msg;
   gchar *msgstr;
   gssize msglen;
   gchar **words;
-  GHashTable *wordlist;
-  int *wordlist_cache = NULL;
-  guint cachesize = 0, cacheseed = 0, cacheindex = 0;
-  gchar *hash_key;
-
-  wordlist = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
+  guint *curr_count;
+  guint i, j;
 
-  for (pass = (two_pass ? 1 : 2); pass <= 2; ++pass)
+  for (i = start; i < end; ++i)
     {
-      if (pass == 1)
-        {
-          msg_progress("Finding frequent words",
-                       evt_tag_str("phase", "caching"));
-          srand(time(NULL));
-          cachesize = (guint) ((logs->len * PTZ_WORDLIST_CACHE));
-          cacheseed = rand();
-          wordlist_cache = g_new0(int, cachesize);
-        }
-      else
-        {
-          msg_progress("Finding frequent words",
-                       evt_tag_str("phase", "searching"));
-        }
+      msg = (LogMessage *) g_ptr_array_index(logs, i);
+      msgstr = (gchar *) log_msg_get_value(msg, LM_V_MESSAGE, &msglen);
+
+      words = g_strsplit_set(msgstr, state->delimiters, PTZ_MAXWORDS);
 
-      for (i = 0; i < logs->len; ++i)
+      for (j = 0; words[j]; ++j)
         {
-          msg = (LogMessage *) g_ptr_array_index(logs, i);
-          msgstr = (gchar *) log_msg_get_value(msg, LM_V_MESSAGE, &msglen);
+          /* NOTE: to calculate the key for the hash, we prefix a word with
+           * its position in the row and a space -- as we always split at
+           * spaces, this should not create confusion
+           */
+          g_string_printf(hash_key, "%d %s", j, words[j]);
+
+          if (!state->wordlist)
+            {
+              _ptz_sketch_add(state->sketch, hash_key->str);
+              continue;
+            }
 
-          words = g_strsplit_set(msgstr, delimiters, PTZ_MAXWORDS);
+          if (state->sketch_filter && _ptz_sketch_estimate(state->sketch_filter, hash_key->str) < state->support)
+            continue;
 
-          for (j = 0; words[j]; ++j)
+          curr_count = (guint *) g_hash_table_lookup(state->wordlist, hash_key->str);
+          if (!curr_count)
+            {
+              guint *currcount_ref = g_new(guint, 1);
+              (*currcount_ref) = 1;
+              g_hash_table_insert(state->wordlist, g_strdup(hash_key->str), currcount_ref);
+            }
+          else
             {
-              /* NOTE: to calculate the key for the hash, we prefix a word with
-               * its position in the row and a space -- as we always split at
-               * spaces, this should not create confusion
-               */
-              hash_key = g_strdup_printf("%d %s", j, words[j]);
+              (*curr_count)++;
+            }
+        }
 
-              if (two_pass)
-                cacheindex = ptz_str2hash(hash_key, cachesize, cacheseed);
+      g_strfreev(words);
+    }
+  g_string_free(hash_key, TRUE);
+}
 
-              if (pass == 1)
-                {
-                  wordlist_cache[cacheindex]++;
-                }
-              else if (pass == 2)
-                {
-                  if (!two_pass || wordlist_cache[cacheindex] >= support)
-                    {
-                      curr_count = (guint *) g_hash_table_lookup(wordlist, hash_key);
-                      if (!curr_count)
-                        {
-                          guint *currcount_ref = g_new(guint, 1);
-                          (*currcount_ref) = 1;
-                          g_hash_table_insert(wordlist, g_strdup(hash_key), currcount_ref);
-                        }
-                      else
-                        {
-                          (*curr_count)++;
-                        }
-                    }
-                }
+static gboolean
+_ptz_merge_word_counts(gpointer key, gpointer value, gpointer user_data)
+{
+  GHashTable *target = (GHashTable *) user_data;
+  guint *target_count = (guint *) g_hash_table_lookup(target, key);
+
+  if (!target_count)
+    {
+      g_hash_table_insert(target, key, value);
+      return TRUE;
+    }
 
-              g_free(hash_key);
+  (*target_count) += *(guint *) value;
+  g_free(key);
+  g_free(value);
+  return TRUE;
+}
 
-            }
+GHashTable *
+ptz_find_frequent_words(GPtrArray *logs, guint support, const gchar *delimiters, gboolean two_pass,
+                        guint num_threads)
+{
+  guint num_workers = _ptz_get_num_workers(logs, num_threads);
+  PtzFrequentWordsState *states = g_new0(PtzFrequentWordsState, num_workers);
+  gpointer *user_data = g_new0(gpointer, num_workers);
+  PtzSketch sketch = { 0 };
+  GHashTable *wordlist;
+  guint i;
 
-          g_strfreev(words);
-        }
+  for (i = 0; i < num_workers; i++)
+    {
+      states[i].delimiters = delimiters;
+      states[i].support = support;
+      user_data[i] = &states[i];
+    }
 
-      /* g_hash_table_foreach(wordlist, _ptz_debug_print_word, NULL); */
+  if (two_pass)
+    {
+      msg_progress("Finding frequent words",
+                   evt_tag_str("phase", "caching"));
+      srand(time(NULL));
+      /* same number of counters as the single row cache had */
+      _ptz_sketch_init(&sketch, logs->len * PTZ_WORDLIST_CACHE / PTZ_SKETCH_DEPTH);
+
+      for (i = 0; i < num_workers; i++)
+        states[i].sketch = &sketch;
+      _ptz_run_workers(logs, num_workers, _ptz_count_words, user_data);
+    }
 
-      g_hash_table_foreach_remove(wordlist, ptz_find_frequent_words_remove_key_predicate, GUINT_TO_POINTER(support));
+  msg_progress("Finding frequent words",
+               evt_tag_str("phase", "searching"));
+  for (i = 0; i < num_workers; i++)
+    {
+      states[i].sketch_filter = two_pass ? &sketch : NULL;
+      states[i].wordlist = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
     }
+  _ptz_run_workers(logs, num_workers, _ptz_count_words, user_data);
+
+  wordlist = states[0].wordlist;
+  for (i = 1; i < num_workers; i++)
+    {
+      g_hash_table_foreach_steal(states[i].wordlist, _ptz_merge_word_counts, wordlist);
+      g_hash_table_unref(states[i].wordlist);
+    }
+
+  /* g_hash_table_foreach(wordlist, _ptz_debug_print_word, NULL); */
 
-  if (wordlist_cache)
-    g_free(wordlist_cache);
+  g_hash_table_foreach_remove(wordlist, ptz_find_frequent_words_remove_key_predicate, GUINT_TO_POINTER(support));
+
+  if (two_pass)
+    _ptz_sketch_destroy(&sketch);
+  g_free(user_data);
+  g_free(states);
 
   return wordlist;
 }
@@ -230,56 +388,54 @@ cluster_free(Cluster *cluster)
   g_free(cluster);
 }
 
-GHashTable *
-ptz_find_clusters_slct(GPtrArray *logs, guint support, const gchar *delimiters, guint num_of_samples)
+typedef struct _PtzClusterState
 {
   GHashTable *wordlist;
+  const gchar *delimiters;
+  guint num_of_samples;
   GHashTable *clusters;
-  int i, j;
+} PtzClusterState;
+
+static void
+_ptz_find_cluster_candidates(GPtrArray *logs, guint start, guint end, gpointer user_data)
+{
+  PtzClusterState *state = (PtzClusterState *) user_data;
+  GString *hash_key = g_string_sized_new(64);
+  GString *cluster_key = g_string_sized_new(0);
+  guint i, j;
   LogMessage *msg;
   gchar *msgstr;
   gssize msglen;
   gchar **words;
-  gchar *hash_key;
   gboolean is_candidate;
   Cluster *cluster;
-  GString *cluster_key;
   gchar *msgdelimiters;
 
-  /* get the frequent word list */
-  wordlist = ptz_find_frequent_words(logs, support, delimiters, TRUE);
-  /* g_hash_table_foreach(wordlist, _ptz_debug_print_word, NULL); */
-
-  /* find the cluster candidates */
-  clusters = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, (GDestroyNotify) cluster_free);
-  cluster_key = g_string_sized_new(0);
-  for (i = 0; i < logs->len; ++i)
+  for (i = start; i < end; ++i)
     {
       msg = (LogMessage *) g_ptr_array_index(logs, i);
       msgstr = (gchar *) log_msg_get_value(msg, LM_V_MESSAGE, &msglen);
 
       g_string_truncate(cluster_key, 0);
 
-      words = g_strsplit_set(msgstr, delimiters, PTZ_MAXWORDS);
-      msgdelimiters = ptz_find_delimiters(msgstr, delimiters);
+      words = g_strsplit_set(msgstr, state->delimiters, PTZ_MAXWORDS);
+      msgdelimiters = ptz_find_delimiters(msgstr, state->delimiters);
 
       is_candidate = FALSE;
       for (j = 0; words[j]; ++j)
         {
-          hash_key = g_strdup_printf("%d %s", j, words[j]);
+          g_string_printf(hash_key, "%d %s", j, words[j]);
 
-          if (g_hash_table_lookup(wordlist, hash_key))
+          if (g_hash_table_lookup(state->wordlist, hash_key->str))
             {
               is_candidate = TRUE;
-              g_string_append(cluster_key, hash_key);
+              g_string_append(cluster_key, hash_key->str);
               g_string_append_c(cluster_key, PTZ_SEPARATOR_CHAR);
             }
           else
             {
               g_string_append_printf(cluster_key, "%d %c%c", j, PTZ_PARSER_MARKER_CHAR, PTZ_SEPARATOR_CHAR);
             }
-
-          g_free(hash_key);
         }
 
       /* append the delimiters of the message to the cluster key to assure unicity
@@ -291,13 +447,13 @@ ptz_find_clusters_slct(GPtrArray *logs, guint support, const gchar *delimiters,
 
       if (is_candidate)
         {
-          cluster = (Cluster *) g_hash_table_lookup(clusters, cluster_key->str);
+          cluster = (Cluster *) g_hash_table_lookup(state->clusters, cluster_key->str);
 
           if (!cluster)
             {
               cluster = g_new0(Cluster, 1);
 
-              if (num_of_samples > 0)
+              if (state->num_of_samples > 0)
                 {
                   cluster->samples = g_ptr_array_sized_new(5);
                   g_ptr_array_add(cluster->samples, g_strdup(msgstr));
@@ -306,12 +462,12 @@ ptz_find_clusters_slct(GPtrArray *logs, guint support, const gchar *delimiters,
               g_ptr_array_add(cluster->loglines, (gpointer) msg);
               cluster->words = g_strdupv(words);
 
-              g_hash_table_insert(clusters, g_strdup(cluster_key->str), (gpointer) cluster);
+              g_hash_table_insert(state->clusters, g_strdup(cluster_key->str), (gpointer) cluster);
             }
           else
             {
               g_ptr_array_add(cluster->loglines, (gpointer) msg);
-              if (cluster->samples && cluster->samples->len < num_of_samples)
+              if (cluster->samples && cluster->samples->len < state->num_of_samples)
                 {
                   g_ptr_array_add(cluster->samples, g_strdup(msgstr));
                 }
@@ -322,12 +478,82 @@ ptz_find_clusters_slct(GPtrArray *logs, guint support, const gchar *delimiters,
       g_strfreev(words);
     }
 
+  g_string_free(cluster_key, TRUE);
+  g_string_free(hash_key, TRUE);
+}
+
+/* the source comes from a later range of logs than the target, so the
+ * order of the loglines and the samples are kept */
+static gboolean
+_ptz_merge_cluster_candidates(gpointer key, gpointer value, gpointer user_data)
+{
+  PtzClusterState *target = (PtzClusterState *) user_data;
+  Cluster *source_cluster = (Cluster *) value;
+  Cluster *target_cluster = (Cluster *) g_hash_table_lookup(target->clusters, key);
+  guint i;
+
+  if (!target_cluster)
+    {
+      g_hash_table_insert(target->clusters, key, source_cluster);
+      return TRUE;
+    }
+
+  for (i = 0; i < source_cluster->loglines->len; i++)
+    g_ptr_array_add(target_cluster->loglines, g_ptr_array_index(source_cluster->loglines, i));
+
+  for (i = 0; source_cluster->samples && i < source_cluster->samples->len; i++)
+    {
+      if (target_cluster->samples->len >= target->num_of_samples)
+        break;
+      g_ptr_array_add(target_cluster->samples, g_ptr_array_index(source_cluster->samples, i));
+      g_ptr_array_index(source_cluster->samples, i) = NULL;
+    }
+
+  g_free(key);
+  cluster_free(source_cluster);
+  return TRUE;
+}
+
+GHashTable *
+ptz_find_clusters_slct(GPtrArray *logs, guint support, const gchar *delimiters, guint num_of_samples,
+                       guint num_threads)
+{
+  guint num_workers = _ptz_get_num_workers(logs, num_threads);
+  PtzClusterState *states = g_new0(PtzClusterState, num_workers);
+  gpointer *user_data = g_new0(gpointer, num_workers);
+  GHashTable *wordlist;
+  GHashTable *clusters;
+  guint i;
+
+  /* get the frequent word list */
+  wordlist = ptz_find_frequent_words(logs, support, delimiters, TRUE, num_threads);
+  /* g_hash_table_foreach(wordlist, _ptz_debug_print_word, NULL); */
+
+  /* find the cluster candidates, the wordlist is only read from here on */
+  for (i = 0; i < num_workers; i++)
+    {
+      states[i].wordlist = wordlist;
+      states[i].delimiters = delimiters;
+      states[i].num_of_samples = num_of_samples;
+      states[i].clusters = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, (GDestroyNotify) cluster_free);
+      user_data[i] = &states[i];
+    }
+  _ptz_run_workers(logs, num_workers, _ptz_find_cluster_candidates, user_data);
+
+  clusters = states[0].clusters;
+  for (i = 1; i < num_workers; i++)
+    {
+      g_hash_table_foreach_steal(states[i].clusters, _ptz_merge_cluster_candidates, &states[0]);
+      g_hash_table_unref(states[i].clusters);
+    }
+
   g_hash_table_foreach_remove(clusters, ptz_find_clusters_remove_cluster_predicate, GUINT_TO_POINTER(support));
 
   /* g_hash_table_foreach(clusters, _ptz_debug_print_cluster, NULL); */
 
   g_hash_table_unref(wordlist);
-  g_string_free(cluster_key, TRUE);
+  g_free(user_data);
+  g_free(states);
 
   return clusters;
 }
@@ -350,7 +576,7 @@ ptz_find_clusters_step(Patternizer *self, GPtrArray *logs, guint support, guint
   msg_progress("Searching clusters",
                evt_tag_int("input_lines", logs->len));
   if (self->algo == PTZ_ALGO_SLCT)
-    return ptz_find_clusters_slct(logs, support, self->delimiters, num_of_samples);
+    return ptz_find_clusters_slct(logs, support, self->delimiters, num_of_samples, self->num_threads);
   else
     {
       msg_error("Unknown clustering algorithm",
@@ -639,11 +865,18 @@ ptz_new(gdouble support_treshold, guint algo, guint iterate, guint num_of_sample
   self->num_of_samples = num_of_samples;
   self->delimiters = delimiters;
   self->logs = g_ptr_array_sized_new(PTZ_LOGTABLE_ALLOC_BASE);
+  self->num_threads = 1;
 
   cluster_tag_id = log_tags_get_by_name(".in_patternize_cluster");
   return self;
 }
 
+void
+ptz_set_num_threads(Patternizer *self, guint num_threads)
+{
+  self->num_threads = MAX(num_threads, 1);
+}
+
 void
 ptz_free(Patternizer *self)
 {
@@ -47,6 +47,7 @@ typedef struct _Patternizer
   guint num_of_samples;
   gdouble support_treshold;
   const gchar *delimiters;
+  guint num_threads;
 
   // NOTE: for now, we store all logs read in the memory.
   // This brings in some obvious constraints and should be solved
@@ -63,8 +64,10 @@ typedef struct _Cluster
 } Cluster;
 
 /* only declared for the test program */
-GHashTable *ptz_find_frequent_words(GPtrArray *logs, guint support, const gchar *delimiters, gboolean two_pass);
-GHashTable *ptz_find_clusters_slct(GPtrArray *logs, guint support, const gchar *delimiters, guint num_of_samples);
+GHashTable *ptz_find_frequent_words(GPtrArray *logs, guint support, const gchar *delimiters, gboolean two_pass,
+                                    guint num_threads);
+GHashTable *ptz_find_clusters_slct(GPtrArray *logs, guint support, const gchar *delimiters, guint num_of_samples,
+                                   guint num_threads);
 
 
 GHashTable *ptz_find_clusters(Patternizer *self);
@@ -74,6 +77,7 @@ gboolean ptz_load_file(Patternizer *self, gchar *input_file, gboolean no_parse,
 
 Patternizer *ptz_new(gdouble support_treshold, guint algo, guint iterate, guint num_of_samples,
                      const gchar *delimiters);
+void ptz_set_num_threads(Patternizer *self, guint num_threads);
 void ptz_free(Patternizer *self);
 
 #endif
@@ -0,0 +1,340 @@
+/*
+ * Copyright (c) 2024 One Identity LLC.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#include "pdb-cache.h"
+
+#include <string.h>
+
+/*
+ * File format, all integers are 32 bit in host byte order, as the cache
+ * is only meant to be used on the host that produced it:
+ *
+ *    magic       "PDBCACHE"
+ *    uint32      format version
+ *    string      checksum of the XML file
+ *    event[]     kind (1 byte), line, column, followed by
+ *                'S': element name, number of attributes, attribute names and values
+ *                'E': element name
+ *                'T': text
+ *    kind        '\0' terminating the list of events
+ *
+ * Strings are stored as their length followed by their bytes and a NUL
+ * terminator, so they can be passed to the callbacks straight from the
+ * mapped file.
+ */
+
+#define PDB_CACHE_MAGIC "PDBCACHE"
+#define PDB_CACHE_MAGIC_LEN 8
+#define PDB_CACHE_VERSION 1
+#define PDB_CACHE_SUFFIX ".cache"
+
+#define PDB_CACHE_EVENT_END_OF_EVENTS '\0'
+#define PDB_CACHE_EVENT_START_ELEMENT 'S'
+#define PDB_CACHE_EVENT_END_ELEMENT 'E'
+#define PDB_CACHE_EVENT_TEXT 'T'
+
+struct _PDBCacheWriter
+{
+  GString *buffer;
+};
+
+gchar *
+pdb_cache_get_filename(const gchar *cache_dir, const gchar *pdb_file)
+{
+  gchar *basename = g_path_get_basename(pdb_file);
+  gchar *cache_basename = g_strconcat(basename, PDB_CACHE_SUFFIX, NULL);
+  gchar *cache_file = g_build_filename(cache_dir, cache_basename, NULL);
+
+  g_free(cache_basename);
+  g_free(basename);
+  return cache_file;
+}
+
+gchar *
+pdb_cache_compute_checksum(const gchar *pdb_file)
+{
+  GMappedFile *file = g_mapped_file_new(pdb_file, FALSE, NULL);
+
+  if (!file)
+    return NULL;
+
+  gchar *checksum = g_compute_checksum_for_data(G_CHECKSUM_SHA256,
+                                                (const guchar *) g_mapped_file_get_contents(file),
+                                                g_mapped_file_get_length(file));
+  g_mapped_file_unref(file);
+  return checksum;
+}
+
+/**************************************************************
+ * writing the cache
+ **************************************************************/
+
+static void
+_write_uint32(PDBCacheWriter *self, guint32 value)
+{
+  g_string_append_len(self->buffer, (const gchar *) &value, sizeof(value));
+}
+
+static void
+_write_string(PDBCacheWriter *self, const gchar *str, gsize len)
+{
+  _write_uint32(self, len);
+  g_string_append_len(self->buffer, str, len);
+  g_string_append_c(self->buffer, 0);
+}
+
+static void
+_write_event_header(PDBCacheWriter *self, gchar kind, gint line, gint column)
+{
+  g_string_append_c(self->buffer, kind);
+  _write_uint32(self, line);
+  _write_uint32(self, column);
+}
+
+void
+pdb_cache_writer_start_element(PDBCacheWriter *self, gint line, gint column, const gchar *element_name,
+                               const gchar **attribute_names, const gchar **attribute_values)
+{
+  guint32 num_attributes = g_strv_length((gchar **) attribute_names);
+
+  _write_event_header(self, PDB_CACHE_EVENT_START_ELEMENT, line, column);
+  _write_string(self, element_name, strlen(element_name));
+  _write_uint32(self, num_attributes);
+  for (gint i = 0; i < num_attributes; i++)
+    {
+      _write_string(self, attribute_names[i], strlen(attribute_names[i]));
+      _write_string(self, attribute_values[i], strlen(attribute_values[i]));
+    }
+}
+
+void
+pdb_cache_writer_end_element(PDBCacheWriter *self, gint line, gint column, const gchar *element_name)
+{
+  _write_event_header(self, PDB_CACHE_EVENT_END_ELEMENT, line, column);
+  _write_string(self, element_name, strlen(element_name));
+}
+
+void
+pdb_cache_writer_text(PDBCacheWriter *self, gint line, gint column, const gchar *text, gsize text_len)
+{
+  _write_event_header(self, PDB_CACHE_EVENT_TEXT, line, column);
+  _write_string(self, text, text_len);
+}
+
+gboolean
+pdb_cache_writer_save(PDBCacheWriter *self, const gchar *cache_file, GError **error)
+{
+  g_string_append_c(self->buffer, PDB_CACHE_EVENT_END_OF_EVENTS);
+  return g_file_set_contents(cache_file, self->buffer->str, self->buffer->len, error);
+}
+
+PDBCacheWriter *
+pdb_cache_writer_new(const gchar *checksum)
+{
+  PDBCacheWriter *self = g_new0(PDBCacheWriter, 1);
+
+  self->buffer = g_string_sized_new(65536);
+  g_string_append_len(self->buffer, PDB_CACHE_MAGIC, PDB_CACHE_MAGIC_LEN);
+  _write_uint32(self, PDB_CACHE_VERSION);
+  _write_string(self, checksum, strlen(checksum));
+  return self;
+}
+
+void
+pdb_cache_writer_free(PDBCacheWriter *self)
+{
+  g_string_free(self->buffer, TRUE);
+  g_free(self);
+}
+
+/**************************************************************
+ * loading the cache
+ **************************************************************/
+
+typedef struct _PDBCacheReader
+{
+  const gchar *pos;
+  const gchar *end;
+  GPtrArray *attribute_names;
+  GPtrArray *attribute_values;
+} PDBCacheReader;
+
+static gboolean
+_read_uint32(PDBCacheReader *self, guint32 *value)
+{
+  if (self->end - self->pos < sizeof(*value))
+    return FALSE;
+
+  memcpy(value, self->pos, sizeof(*value));
+  self->pos += sizeof(*value);
+  return TRUE;
+}
+
+static gboolean
+_read_string(PDBCacheReader *self, const gchar **str, gsize *len)
+{
+  guint32 str_len;
+
+  if (!_read_uint32(self, &str_len) || self->end - self->pos <= str_len || self->pos[str_len] != 0)
+    return FALSE;
+
+  *str = self->pos;
+  if (len)
+    *len = str_len;
+  self->pos += str_len + 1;
+  return TRUE;
+}
+
+static gboolean
+_read_header(PDBCacheReader *self, const gchar *checksum)
+{
+  guint32 version;
+  const gchar *stored_checksum;
+
+  if (self->end - self->pos < PDB_CACHE_MAGIC_LEN || memcmp(self->pos, PDB_CACHE_MAGIC, PDB_CACHE_MAGIC_LEN) != 0)
+    return FALSE;
+  self->pos += PDB_CACHE_MAGIC_LEN;
+
+  return _read_uint32(self, &version) &&
+         version == PDB_CACHE_VERSION &&
+         _read_string(self, &stored_checksum, NULL) &&
+         strcmp(stored_checksum, checksum) == 0;
+}
+
+static gboolean
+_read_attributes(PDBCacheReader *self)
+{
+  guint32 num_attributes;
+
+  g_ptr_array_set_size(self->attribute_names, 0);
+  g_ptr_array_set_size(self->attribute_values, 0);
+
+  if (!_read_uint32(self, &num_attributes))
+    return FALSE;
+
+  for (guint32 i = 0; i < num_attributes; i++)
+    {
+      const gchar *name, *value;
+
+      if (!_read_string(self, &name, NULL) || !_read_string(self, &value, NULL))
+        return FALSE;
+      g_ptr_array_add(self->attribute_names, (gpointer) name);
+      g_ptr_array_add(self->attribute_values, (gpointer) value);
+    }
+  g_ptr_array_add(self->attribute_names, NULL);
+  g_ptr_array_add(self->attribute_values, NULL);
+  return TRUE;
+}
+
+/* Walks through the events, invoking the callbacks of parser for each.
+ * Without a parser, it only checks that the events are intact, which is
+ * done before replaying them so that a damaged cache is detected before
+ * any of the callbacks are run.  Returns FALSE if the events are damaged
+ * or a callback failed, the latter is indicated by error being set. */
+static gboolean
+_process_events(PDBCacheReader *self, const GMarkupParser *parser, gpointer user_data,
+                gint *line, gint *column, GError **error)
+{
+  while (self->pos < self->end)
+    {
+      gchar kind = *self->pos++;
+      guint32 event_line, event_column;
+      const gchar *str;
+      gsize len;
+
+      if (kind == PDB_CACHE_EVENT_END_OF_EVENTS)
+        return self->pos == self->end;
+
+      if (!_read_uint32(self, &event_line) || !_read_uint32(self, &event_column) ||
+          !_read_string(self, &str, &len))
+        return FALSE;
+
+      *line = event_line;
+      *column = event_column;
+      switch (kind)
+        {
+        case PDB_CACHE_EVENT_START_ELEMENT:
+          if (!_read_attributes(self))
+            return FALSE;
+          if (parser)
+            parser->start_element(NULL, str,
+                                  (const gchar **) self->attribute_names->pdata,
+                                  (const gchar **) self->attribute_values->pdata,
+                                  user_data, error);
+          break;
+        case PDB_CACHE_EVENT_END_ELEMENT:
+          if (parser)
+            parser->end_element(NULL, str, user_data, error);
+          break;
+        case PDB_CACHE_EVENT_TEXT:
+          if (parser)
+            parser->text(NULL, str, len, user_data, error);
+          break;
+        default:
+          return FALSE;
+        }
+
+      if (error && *error)
+        return FALSE;
+    }
+  return FALSE;
+}
+
+PDBCacheLoadResult
+pdb_cache_load(const gchar *cache_file, const gchar *checksum,
+               const GMarkupParser *parser, gpointer user_data,
+               gint *line, gint *column, GError **error)
+{
+  GMappedFile *file = g_mapped_file_new(cache_file, FALSE, NULL);
+  PDBCacheLoadResult result = PDB_CACHE_UNUSABLE;
+
+  if (!file)
+    return PDB_CACHE_UNUSABLE;
+
+  const gchar *contents = g_mapped_file_get_contents(file);
+  PDBCacheReader reader =
+  {
+    .pos = contents,
+    .end = contents + g_mapped_file_get_length(file),
+    .attribute_names = g_ptr_array_new(),
+    .attribute_values = g_ptr_array_new(),
+  };
+
+  if (!contents || !_read_header(&reader, checksum))
+    goto exit;
+
+  const gchar *events = reader.pos;
+  if (!_process_events(&reader, NULL, NULL, line, column, NULL))
+    goto exit;
+
+  reader.pos = events;
+  if (_process_events(&reader, parser, user_data, line, column, error))
+    result = PDB_CACHE_LOADED;
+  else
+    result = PDB_CACHE_FAILED;
+
+exit:
+  g_ptr_array_free(reader.attribute_names, TRUE);
+  g_ptr_array_free(reader.attribute_values, TRUE);
+  g_mapped_file_unref(file);
+  return result;
+}
@@ -0,0 +1,74 @@
+/*
+ * Copyright (c) 2024 One Identity LLC.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#ifndef CORRELATION_PDB_CACHE_H_INCLUDED
+#define CORRELATION_PDB_CACHE_H_INCLUDED
+
+#include "syslog-ng.h"
+
+/*
+ * Precompiled pattern database cache
+ *
+ * The cache contains the markup events (elements, attributes and text) of
+ * a pattern database XML file along with their positions, in a flat binary
+ * format.  It is replayed into the same GMarkupParser callbacks as the XML
+ * itself, which saves tokenizing, unescaping and validating the XML while
+ * loading.  Everything behind the callbacks still runs: the patterns are
+ * compiled and inserted into the radix trees, templates and filters of the
+ * actions are compiled just like with the XML, so the gain is limited to
+ * the share of the markup parsing in the load time.  The "Pattern database
+ * loaded" debug message reports the load time of both ways.
+ *
+ * The cache is only used if a cache directory is configured, the cache of
+ * <dir>/<file> is stored as <cache-dir>/<file>.cache.  It is keyed by the
+ * checksum of the XML file, so a stale cache or the cache of another file
+ * with the same name is never used, it is overwritten instead.
+ */
+
+typedef struct _PDBCacheWriter PDBCacheWriter;
+
+typedef enum
+{
+  /* the cache was replayed successfully */
+  PDB_CACHE_LOADED,
+  /* the cache is missing, stale or damaged, nothing was replayed */
+  PDB_CACHE_UNUSABLE,
+  /* one of the callbacks failed, the error is returned */
+  PDB_CACHE_FAILED,
+} PDBCacheLoadResult;
+
+gchar *pdb_cache_get_filename(const gchar *cache_dir, const gchar *pdb_file);
+gchar *pdb_cache_compute_checksum(const gchar *pdb_file);
+
+PDBCacheLoadResult pdb_cache_load(const gchar *cache_file, const gchar *checksum,
+                                  const GMarkupParser *parser, gpointer user_data,
+                                  gint *line, gint *column, GError **error);
+
+PDBCacheWriter *pdb_cache_writer_new(const gchar *checksum);
+void pdb_cache_writer_start_element(PDBCacheWriter *self, gint line, gint column, const gchar *element_name,
+                                    const gchar **attribute_names, const gchar **attribute_values);
+void pdb_cache_writer_end_element(PDBCacheWriter *self, gint line, gint column, const gchar *element_name);
+void pdb_cache_writer_text(PDBCacheWriter *self, gint line, gint column, const gchar *text, gsize text_len);
+gboolean pdb_cache_writer_save(PDBCacheWriter *self, const gchar *cache_file, GError **error);
+void pdb_cache_writer_free(PDBCacheWriter *self);
+
+#endif
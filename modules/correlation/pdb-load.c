@@ -27,11 +27,13 @@
 #include "pdb-example.h"
 #include "pdb-ruleset.h"
 #include "pdb-error.h"
+#include "pdb-cache.h"
 
 #include <string.h>
 #include <stdlib.h>
 #include <stdarg.h>
 #include <errno.h>
+#include <unistd.h>
 
 enum PDBLoaderState
 {
@@ -74,6 +76,10 @@ typedef struct _PDBLoader
 {
   const gchar *filename;
   GMarkupParseContext *context;
+  /* position of the current event when replaying the cache */
+  gint line, column;
+  /* records the events of the XML file, if set */
+  PDBCacheWriter *cache_writer;
 
   PDBRuleSet *ruleset;
   PDBProgram *root_program;
@@ -130,12 +136,24 @@ _pdb_state_stack_pop(PDBStateStack *self)
   return self->stack[self->top];
 }
 
+static void
+_get_position(PDBLoader *state, gint *line, gint *column)
+{
+  if (state->context)
+    {
+      g_markup_parse_context_get_position(state->context, line, column);
+      return;
+    }
+  *line = state->line;
+  *column = state->column;
+}
+
 static gchar *
 _pdb_format_location(PDBLoader *state)
 {
   gint line, column;
 
-  g_markup_parse_context_get_position(state->context, &line, &column);
+  _get_position(state, &line, &column);
   return g_strdup_printf("%s:%d:%d", state->filename, line, column);
 }
 
@@ -151,7 +169,7 @@ pdb_loader_set_error(PDBLoader *state, GError **error, const gchar *format, ...)
   error_text = g_strdup_vprintf(format, va);
   va_end(va);
 
-  g_markup_parse_context_get_position(state->context, &line_number, &col_number);
+  _get_position(state, &line_number, &col_number);
   error_location = g_strdup_printf("%s:%d:%d", state->filename, line_number, col_number);
 
   g_set_error(error, PDB_ERROR, PDB_ERROR_FAILED, "%s: %s", error_location, error_text);
@@ -476,6 +494,8 @@ _pdbl_ruleset_pattern_text(PDBLoader *state, const gchar *text, gsize text_len,
           /* create new program specific radix */
           state->current_program = pdb_program_new();
           state->current_program->pdb_location = _pdb_format_location(state);
+          state->current_program->profile = rule_profile_get_by_location("pdb-program", text,
+                                            state->current_program->pdb_location);
           g_hash_table_insert(state->ruleset_patterns, g_strdup(text), state->current_program);
         }
 
@@ -548,6 +568,10 @@ _pdbl_rules_start(PDBLoader *state, const gchar *element_name, const gchar **att
           return;
         }
 
+      gchar *location = _pdb_format_location(state);
+      state->current_rule->profile = rule_profile_get_by_location("pdb-rule", state->current_rule->rule_id, location);
+      g_free(location);
+
       state->current_message = &state->current_rule->msg;
       synthetic_message_set_prefix(state->current_message, state->ruleset->prefix);
       state->action_id = 0;
@@ -985,6 +1009,15 @@ pdb_loader_start_element(GMarkupParseContext *context, const gchar *element_name
 {
   PDBLoader *state = (PDBLoader *) user_data;
 
+  if (state->cache_writer)
+    {
+      gint line, column;
+
+      _get_position(state, &line, &column);
+      pdb_cache_writer_start_element(state->cache_writer, line, column, element_name,
+                                     attribute_names, attribute_values);
+    }
+
   switch (state->current_state)
     {
     case PDBL_INITIAL:
@@ -1037,6 +1070,14 @@ pdb_loader_end_element(GMarkupParseContext *context, const gchar *element_name,
 {
   PDBLoader *state = (PDBLoader *) user_data;
 
+  if (state->cache_writer)
+    {
+      gint line, column;
+
+      _get_position(state, &line, &column);
+      pdb_cache_writer_end_element(state->cache_writer, line, column, element_name);
+    }
+
   switch (state->current_state)
     {
     case PDBL_PATTERNDB:
@@ -1117,6 +1158,14 @@ pdb_loader_text(GMarkupParseContext *context, const gchar *text, gsize text_len,
 {
   PDBLoader *state = (PDBLoader *) user_data;
 
+  if (state->cache_writer)
+    {
+      gint line, column;
+
+      _get_position(state, &line, &column);
+      pdb_cache_writer_text(state->cache_writer, line, column, text, text_len);
+    }
+
   switch (state->current_state)
     {
     case PDBL_RULESET_DESCRIPTION:
@@ -1175,12 +1224,10 @@ GMarkupParser db_parser =
   .error = NULL
 };
 
-gboolean
-pdb_rule_set_load(PDBRuleSet *self, GlobalConfig *cfg, const gchar *config, GList **examples)
+static gboolean
+_load_xml(PDBLoader *state, const gchar *config, GError **error)
 {
-  PDBLoader state;
   GMarkupParseContext *parse_ctx = NULL;
-  GError *error = NULL;
   FILE *dbfile = NULL;
   gint bytes_read;
   gchar buff[4096];
@@ -1194,37 +1241,122 @@ pdb_rule_set_load(PDBRuleSet *self, GlobalConfig *cfg, const gchar *config, GLis
       return FALSE;
     }
 
-  memset(&state, 0x0, sizeof(state));
-
-  state.ruleset = self;
-  state.root_program = pdb_program_new();
-  state.load_examples = !!examples;
-  state.ruleset_patterns = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, (GDestroyNotify) pdb_program_unref);
-  state.cfg = cfg;
-  state.filename = config;
-  state.context = parse_ctx = g_markup_parse_context_new(&db_parser, 0, &state, NULL);
-
-  self->programs = r_new_node("", state.root_program);
+  state->context = parse_ctx = g_markup_parse_context_new(&db_parser, 0, state, NULL);
 
   while ((bytes_read = fread(buff, sizeof(gchar), 4096, dbfile)) != 0)
     {
-      if (!g_markup_parse_context_parse(parse_ctx, buff, bytes_read, &error))
+      if (!g_markup_parse_context_parse(parse_ctx, buff, bytes_read, error))
         {
           msg_error("Error parsing pattern database file",
                     evt_tag_str(EVT_TAG_FILENAME, config),
-                    evt_tag_str("error", error ? error->message : "unknown"));
+                    evt_tag_str("error", *error ? (*error)->message : "unknown"));
           goto error;
         }
     }
   fclose(dbfile);
   dbfile = NULL;
 
-  if (!g_markup_parse_context_end_parse(parse_ctx, &error))
+  if (!g_markup_parse_context_end_parse(parse_ctx, error))
     {
       msg_error("Error parsing pattern database file",
                 evt_tag_str(EVT_TAG_FILENAME, config),
+                evt_tag_str("error", *error ? (*error)->message : "unknown"));
+      goto error;
+    }
+  success = TRUE;
+
+error:
+  if (dbfile)
+    fclose(dbfile);
+  g_markup_parse_context_free(parse_ctx);
+  state->context = NULL;
+  return success;
+}
+
+static void
+_save_cache(PDBLoader *state, const gchar *cache_filename)
+{
+  GError *error = NULL;
+
+  if (!pdb_cache_writer_save(state->cache_writer, cache_filename, &error))
+    {
+      msg_debug("Error writing precompiled pattern database cache",
+                evt_tag_str(EVT_TAG_FILENAME, cache_filename),
+                evt_tag_str("error", error->message));
+      g_clear_error(&error);
+    }
+}
+
+static gboolean
+_is_cache_dir_writable(const gchar *cache_dir)
+{
+  if (access(cache_dir, W_OK) == 0)
+    return TRUE;
+
+  msg_debug("Pattern database cache directory is not writable, the cache is not updated",
+            evt_tag_str("cache_dir", cache_dir),
+            evt_tag_error(EVT_TAG_OSERROR));
+  return FALSE;
+}
+
+/* If a cache directory is set, the precompiled cache in there is used if its
+ * checksum matches the XML, otherwise the XML is parsed and the cache is
+ * regenerated from it, see pdb-cache.h.  The cache is an optimization only,
+ * failing to write it is not an error.  */
+gboolean
+pdb_rule_set_load(PDBRuleSet *self, GlobalConfig *cfg, const gchar *config, const gchar *cache_dir,
+                  GList **examples)
+{
+  gint64 load_start = g_get_monotonic_time();
+  PDBLoader state;
+  GError *error = NULL;
+  gboolean success = FALSE;
+  gchar *checksum = cache_dir ? pdb_cache_compute_checksum(config) : NULL;
+  gchar *cache_filename = checksum ? pdb_cache_get_filename(cache_dir, config) : NULL;
+  PDBCacheLoadResult cache_result = PDB_CACHE_UNUSABLE;
+
+  memset(&state, 0x0, sizeof(state));
+
+  state.ruleset = self;
+  state.root_program = pdb_program_new();
+  state.root_program->profile = rule_profile_get_by_location("pdb-program", NULL, config);
+  state.load_examples = !!examples;
+  state.ruleset_patterns = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, (GDestroyNotify) pdb_program_unref);
+  state.cfg = cfg;
+  state.filename = config;
+
+  self->programs = r_new_node("", state.root_program);
+
+  if (checksum)
+    cache_result = pdb_cache_load(cache_filename, checksum, &db_parser, &state, &state.line, &state.column, &error);
+
+  switch (cache_result)
+    {
+    case PDB_CACHE_LOADED:
+      msg_debug("Pattern database loaded",
+                evt_tag_str(EVT_TAG_FILENAME, config),
+                evt_tag_str("cache", cache_filename),
+                evt_tag_long("load_time_usec", g_get_monotonic_time() - load_start));
+      break;
+    case PDB_CACHE_FAILED:
+      msg_error("Error loading pattern database from precompiled cache",
+                evt_tag_str(EVT_TAG_FILENAME, config),
+                evt_tag_str("cache", cache_filename),
                 evt_tag_str("error", error ? error->message : "unknown"));
       goto error;
+    case PDB_CACHE_UNUSABLE:
+      if (checksum && _is_cache_dir_writable(cache_dir))
+        state.cache_writer = pdb_cache_writer_new(checksum);
+      if (!_load_xml(&state, config, &error))
+        goto error;
+      msg_debug("Pattern database loaded",
+                evt_tag_str(EVT_TAG_FILENAME, config),
+                evt_tag_long("load_time_usec", g_get_monotonic_time() - load_start));
+      if (state.cache_writer)
+        _save_cache(&state, cache_filename);
+      break;
+    default:
+      g_assert_not_reached();
     }
 
   if (state.load_examples)
@@ -1233,12 +1365,12 @@ pdb_rule_set_load(PDBRuleSet *self, GlobalConfig *cfg, const gchar *config, GLis
   success = TRUE;
 
 error:
-  if (dbfile)
-    fclose(dbfile);
-  if (parse_ctx)
-    g_markup_parse_context_free(parse_ctx);
+  if (state.cache_writer)
+    pdb_cache_writer_free(state.cache_writer);
   g_hash_table_unref(state.ruleset_patterns);
   if (error)
     g_error_free(error);
+  g_free(checksum);
+  g_free(cache_filename);
   return success;
 }
@@ -27,6 +27,7 @@
 #include "pdb-ruleset.h"
 #include "cfg.h"
 
-gboolean pdb_rule_set_load(PDBRuleSet *self, GlobalConfig *cfg, const gchar *config, GList **examples);
+gboolean pdb_rule_set_load(PDBRuleSet *self, GlobalConfig *cfg, const gchar *config, const gchar *cache_dir,
+                           GList **examples);
 
 #endif
@@ -25,6 +25,7 @@
 
 #include "syslog-ng.h"
 #include "radix.h"
+#include "rule-profiler.h"
 
 /*
  * This class encapsulates a set of program related rules in the
@@ -37,6 +38,8 @@ typedef struct _PDBProgram
   guint ref_cnt;
   gchar *pdb_location;
   RNode *rules;
+  /* lookups of the rules of the program */
+  RuleProfile *profile;
 } PDBProgram;
 
 PDBProgram *pdb_program_new(void);
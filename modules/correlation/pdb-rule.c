@@ -102,6 +102,7 @@ pdb_rule_unref(PDBRule *self)
       if (self->class)
         g_free(self->class);
 
+      rule_profile_unref(self->profile);
       synthetic_context_deinit(&self->context);
       synthetic_message_deinit(&self->msg);
       g_free(self);
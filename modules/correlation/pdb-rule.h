@@ -25,6 +25,7 @@
 
 #include "syslog-ng.h"
 #include "pdb-action.h"
+#include "rule-profiler.h"
 
 /* this class encapsulates a the verdict of a rule in the pattern
  * database and is stored as the "value" member in the RADIX tree
@@ -39,6 +40,7 @@ struct _PDBRule
   SyntheticMessage msg;
   SyntheticContext context;
   GPtrArray *actions;
+  RuleProfile *profile;
 };
 
 void pdb_rule_set_class(PDBRule *self, const gchar *class);
@@ -25,6 +25,8 @@
 #include "pdb-lookup-params.h"
 #include "scratch-buffers.h"
 
+#include <string.h>
+
 static NVHandle class_handle = 0;
 static NVHandle rule_id_handle = 0;
 static LogTagId system_tag;
@@ -65,6 +67,60 @@ _add_matches_to_message(LogMessage *msg, GArray *matches, NVHandle ref_handle, c
     }
 }
 
+/* key of the program index, it is looked up without copying the program
+ * name of the message */
+typedef struct _PDBProgramName
+{
+  const gchar *name;
+  gsize len;
+} PDBProgramName;
+
+static guint
+_program_name_hash(gconstpointer k)
+{
+  const PDBProgramName *key = (const PDBProgramName *) k;
+  guint hash = 5381;
+
+  for (gsize i = 0; i < key->len; i++)
+    hash = (hash << 5) + hash + (guchar) key->name[i];
+  return hash;
+}
+
+static gboolean
+_program_name_equal(gconstpointer a, gconstpointer b)
+{
+  const PDBProgramName *key_a = (const PDBProgramName *) a;
+  const PDBProgramName *key_b = (const PDBProgramName *) b;
+
+  return key_a->len == key_b->len && memcmp(key_a->name, key_b->name, key_a->len) == 0;
+}
+
+static PDBProgramName *
+_program_name_new(const gchar *name, gsize len)
+{
+  PDBProgramName *self = g_malloc(sizeof(PDBProgramName) + len + 1);
+  gchar *name_copy = (gchar *) (self + 1);
+
+  memcpy(name_copy, name, len);
+  name_copy[len] = 0;
+  self->name = name_copy;
+  self->len = len;
+  return self;
+}
+
+/* A literal program name is always found by the radix lookup as is, as
+ * literals are preferred over parsers, so an exact match in the index
+ * returns the same program without walking the tree. */
+static PDBProgram *
+_lookup_program_in_index(PDBRuleSet *rule_set, const gchar *program_value, gssize program_len)
+{
+  PDBProgramName key = { .name = program_value, .len = program_len };
+
+  if (!rule_set->program_index)
+    return NULL;
+  return (PDBProgram *) g_hash_table_lookup(rule_set->program_index, &key);
+}
+
 const gchar *
 _calculate_program(PDBLookupParams *lookup, LogMessage *msg, gssize *program_len)
 {
@@ -90,26 +146,33 @@ pdb_ruleset_lookup(PDBRuleSet *rule_set, PDBLookupParams *lookup, GArray *dbg_li
   GArray *prg_matches, *matches;
   const gchar *program_value;
   gssize program_len;
+  PDBProgram *program;
 
   if (G_UNLIKELY(!rule_set->programs))
     return FALSE;
 
   program_value = _calculate_program(lookup, msg, &program_len);
-  prg_matches = g_array_new(FALSE, TRUE, sizeof(RParserMatch));
-  node = r_find_node(rule_set->programs, (gchar *) program_value, program_len, prg_matches);
-
-  if (node)
+  program = _lookup_program_in_index(rule_set, program_value, program_len);
+  if (!program)
     {
-      _add_matches_to_message(msg, prg_matches, lookup->program_handle, program_value);
+      prg_matches = g_array_new(FALSE, TRUE, sizeof(RParserMatch));
+      node = r_find_node(rule_set->programs, (gchar *) program_value, program_len, prg_matches);
+      if (node)
+        {
+          _add_matches_to_message(msg, prg_matches, lookup->program_handle, program_value);
+          program = (PDBProgram *) node->value;
+        }
       g_array_free(prg_matches, TRUE);
+    }
 
-      PDBProgram *program = (PDBProgram *) node->value;
-
+  if (program)
+    {
       if (program->rules)
         {
           RNode *msg_node;
           const gchar *message;
           gssize message_len;
+          RuleProfileSample sample;
 
           /* NOTE: We're not using g_array_sized_new as that does not
            * correctly zero-initialize the new items even if clear_ is TRUE
@@ -128,16 +191,20 @@ pdb_ruleset_lookup(PDBRuleSet *rule_set, PDBLookupParams *lookup, GArray *dbg_li
               message_len = lookup->message_len;
             }
 
+          rule_profile_begin(program->profile, &sample);
           if (G_UNLIKELY(dbg_list))
             msg_node = r_find_node_dbg(program->rules, (gchar *) message, message_len, matches, dbg_list);
           else
             msg_node = r_find_node(program->rules, (gchar *) message, message_len, matches);
+          gint64 lookup_nsec = rule_profile_end(program->profile, &sample, msg_node != NULL);
 
           if (msg_node)
             {
               PDBRule *rule = (PDBRule *) msg_node->value;
               GString *buffer = g_string_sized_new(32);
 
+              rule_profile_add_nested_match(rule->profile, &sample, lookup_nsec);
+
               msg_debug("patterndb rule matches",
                         evt_tag_str("rule_id", rule->rule_id));
               log_msg_set_value(msg, class_handle, rule->class ? rule->class : "system", -1);
@@ -163,28 +230,79 @@ pdb_ruleset_lookup(PDBRuleSet *rule_set, PDBLookupParams *lookup, GArray *dbg_li
           g_array_free(matches, TRUE);
         }
     }
-  else
-    {
-      g_array_free(prg_matches, TRUE);
-    }
 
   return NULL;
 
 }
 
 
+static void
+_index_literal_programs(GHashTable *index, RNode *node, GString *name)
+{
+  gsize name_len = name->len;
+
+  if (node->keylen > 0)
+    g_string_append_len(name, node->key, node->keylen);
+
+  PDBProgramName key = { .name = name->str, .len = name->len };
+  if (node->value && !g_hash_table_contains(index, &key))
+    g_hash_table_insert(index, _program_name_new(name->str, name->len), node->value);
+
+  /* names below parser nodes are not literals */
+  for (gint i = 0; i < node->num_children; i++)
+    _index_literal_programs(index, node->children[i], name);
+
+  g_string_truncate(name, name_len);
+}
+
+static void
+_freeze_program_rules(RNode *node)
+{
+  PDBProgram *program = (PDBProgram *) node->value;
+
+  /* the same program may be referenced from multiple nodes */
+  if (program && program->rules && !program->rules->frozen)
+    program->rules = r_freeze_tree(program->rules);
+
+  for (gint i = 0; i < node->num_children; i++)
+    _freeze_program_rules(node->children[i]);
+  for (gint i = 0; i < node->num_pchildren; i++)
+    _freeze_program_rules(node->pchildren[i]);
+}
+
+/* Relayouts the radix trees of a fully loaded ruleset for faster lookups,
+ * see r_freeze_tree().  No rules can be added to the ruleset afterwards. */
+void
+pdb_rule_set_freeze(PDBRuleSet *self)
+{
+  if (!self->programs || self->programs->frozen)
+    return;
+
+  self->programs = r_freeze_tree(self->programs);
+  _freeze_program_rules(self->programs);
+
+  GString *name = g_string_sized_new(64);
+  self->program_index = g_hash_table_new_full(_program_name_hash, _program_name_equal, g_free, NULL);
+  _index_literal_programs(self->program_index, self->programs, name);
+  g_string_free(name, TRUE);
+}
+
 PDBRuleSet *
 pdb_rule_set_new(const gchar *prefix)
 {
   PDBRuleSet *self = g_new0(PDBRuleSet, 1);
+
+  g_atomic_counter_set(&self->ref_cnt, 1);
   self->is_empty = TRUE;
   self->prefix = g_strdup(prefix);
   return self;
 }
 
-void
-pdb_rule_set_free(PDBRuleSet *self)
+static void
+_free(PDBRuleSet *self)
 {
+  if (self->program_index)
+    g_hash_table_unref(self->program_index);
   if (self->programs)
     r_free_node(self->programs, (GDestroyNotify) pdb_program_unref);
   g_free(self->version);
@@ -193,6 +311,20 @@ pdb_rule_set_free(PDBRuleSet *self)
   g_free(self);
 }
 
+PDBRuleSet *
+pdb_rule_set_ref(PDBRuleSet *self)
+{
+  g_atomic_counter_inc(&self->ref_cnt);
+  return self;
+}
+
+void
+pdb_rule_set_unref(PDBRuleSet *self)
+{
+  if (g_atomic_counter_dec_and_test(&self->ref_cnt))
+    _free(self);
+}
+
 void
 pdb_rule_set_global_init(void)
 {
@@ -28,19 +28,26 @@
 #include "pdb-lookup-params.h"
 #include "pdb-rule.h"
 
-/* rules loaded from a pdb file */
+/* rules loaded from a pdb file, the ruleset is not changed once it has
+ * been published to PatternDB, lookups may run in parallel against it */
 typedef struct _PDBRuleSet
 {
+  GAtomicCounter ref_cnt;
   RNode *programs;
   gchar *version;
   gchar *pub_date;
   gchar *prefix;
   gboolean is_empty;
+  /* exact match index of the literal program names, set up by
+   * pdb_rule_set_freeze() */
+  GHashTable *program_index;
 } PDBRuleSet;
 
 PDBRule *pdb_ruleset_lookup(PDBRuleSet *rule_set, PDBLookupParams *lookup, GArray *dbg_list);
 PDBRuleSet *pdb_rule_set_new(const gchar *prefix);
-void pdb_rule_set_free(PDBRuleSet *self);
+void pdb_rule_set_freeze(PDBRuleSet *self);
+PDBRuleSet *pdb_rule_set_ref(PDBRuleSet *self);
+void pdb_rule_set_unref(PDBRuleSet *self);
 
 void pdb_rule_set_global_init(void);
 
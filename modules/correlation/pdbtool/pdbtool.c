@@ -35,6 +35,8 @@
 #include "pdb-program.h"
 #include "pdb-load.h"
 #include "pdb-file.h"
+#include "pdb-cache.h"
+#include "rule-profiler.h"
 #include "apphook.h"
 #include "transport/transport-file.h"
 #include "logproto/logproto-text-server.h"
@@ -335,6 +337,7 @@ static gchar *template_string = NULL;
 static gchar *filter_string = NULL;
 static gboolean debug_pattern = FALSE;
 static gboolean debug_pattern_parse = FALSE;
+static gboolean match_profile = FALSE;
 
 gboolean
 pdbtool_match_values(NVHandle handle, const gchar *name,
@@ -510,6 +513,9 @@ pdbtool_match(int argc, char *argv[])
     {
       dbg_list = g_array_new(FALSE, FALSE, sizeof(RDebugInfo));
     }
+  if (match_profile)
+    rule_profiler_enable(1);
+
   ret = 0;
   while (!eof && (buf || match_message))
     {
@@ -622,6 +628,15 @@ pdbtool_match(int argc, char *argv[])
         }
     }
   pattern_db_expire_state(patterndb);
+
+  if (match_profile)
+    {
+      GString *profiles = g_string_sized_new(4096);
+
+      rule_profiler_format_csv(profiles);
+      fprintf(stderr, "%s", profiles->str);
+      g_string_free(profiles, TRUE);
+    }
 error:
   if (proto)
     log_proto_server_free(proto);
@@ -675,6 +690,10 @@ static GOptionEntry match_options[] =
     "filter", 'F', 0, G_OPTION_ARG_STRING, &filter_string,
     "Only print messages matching the specified syslog-ng filter", "expr"
   },
+  {
+    "profile", 0, 0, G_OPTION_ARG_NONE, &match_profile,
+    "Print the number of hits and the time spent per program, rule and parser type to stderr (CSV)", NULL
+  },
   { NULL, 0, 0, G_OPTION_ARG_NONE, NULL, NULL }
 };
 
@@ -854,7 +873,7 @@ pdbtool_test(int argc, char *argv[])
         }
 
       patterndb = pattern_db_new(NULL);
-      if (!pdb_rule_set_load(pattern_db_get_ruleset(patterndb), configuration, argv[arg_pos], &examples))
+      if (!pdb_rule_set_load(pattern_db_get_ruleset(patterndb), configuration, argv[arg_pos], NULL, &examples))
         {
           failed_to_load = TRUE;
           continue;
@@ -1042,6 +1061,61 @@ static GOptionEntry dump_options[] =
   { NULL, 0, 0, G_OPTION_ARG_NONE, NULL, NULL }
 };
 
+static gchar *cache_dir = NULL;
+
+static gint
+pdbtool_compile(int argc, char *argv[])
+{
+  PatternDB *patterndb;
+  gchar *dir;
+  gchar *cache_filename;
+  gint ret = 0;
+
+  if (!patterndb_file)
+    {
+      fprintf(stderr, "No patterndb file is specified to compile\n");
+      return 1;
+    }
+
+  /* loading the XML regenerates the cache when it is missing or stale */
+  dir = cache_dir ? g_strdup(cache_dir) : g_path_get_dirname(patterndb_file);
+  cache_filename = pdb_cache_get_filename(dir, patterndb_file);
+  unlink(cache_filename);
+
+  patterndb = pattern_db_new(NULL);
+  pattern_db_set_cache_dir(patterndb, dir);
+  if (!pattern_db_reload_ruleset(patterndb, configuration, patterndb_file))
+    {
+      ret = 1;
+      goto exit;
+    }
+
+  if (!g_file_test(cache_filename, G_FILE_TEST_EXISTS))
+    {
+      fprintf(stderr, "Error storing precompiled patterndb; filename='%s'\n", cache_filename);
+      ret = 1;
+    }
+
+exit:
+  pattern_db_free(patterndb);
+  g_free(cache_filename);
+  g_free(dir);
+  return ret;
+}
+
+static GOptionEntry compile_options[] =
+{
+  {
+    "pdb",       'p', 0, G_OPTION_ARG_STRING, &patterndb_file,
+    "Name of the patterndb file", "<patterndb_file>"
+  },
+  {
+    "cache-dir", 0, 0, G_OPTION_ARG_STRING, &cache_dir,
+    "Directory of the precompiled patterndb, defaults to the directory of the patterndb file", "<cache_dir>"
+  },
+  { NULL, 0, 0, G_OPTION_ARG_NONE, NULL, NULL }
+};
+
 static gboolean dictionary_tags = FALSE;
 
 static void
@@ -1114,7 +1188,7 @@ pdbtool_dictionary(int argc, char *argv[])
 
   memset(&rule_set, 0x0, sizeof(PDBRuleSet));
 
-  if (!pdb_rule_set_load(&rule_set, configuration, patterndb_file, NULL))
+  if (!pdb_rule_set_load(&rule_set, configuration, patterndb_file, NULL, NULL))
     return 1;
 
   if (match_program)
@@ -1141,6 +1215,7 @@ static gdouble support_treshold = 4.0;
 static gboolean iterate_outliers = FALSE;
 static gboolean named_parsers = FALSE;
 static gint num_of_samples = 1;
+static gint patternize_threads = 1;
 static const gchar *delimiters = " :&~?![]=,;()'\"";
 
 static gint
@@ -1170,6 +1245,7 @@ pdbtool_patternize(int argc, char *argv[])
     {
       return 1;
     }
+  ptz_set_num_threads(ptz, MAX(patternize_threads, 1));
 
   argv[0] = input_logfile;
   for (i = 0; i < argc; i++)
@@ -1223,6 +1299,10 @@ static GOptionEntry patternize_options[] =
     "samples",           0, 0, G_OPTION_ARG_INT, &num_of_samples,
     "Number of example lines to add for the patterns (default: 1)", "<samples>"
   },
+  {
+    "threads",          'j', 0, G_OPTION_ARG_INT, &patternize_threads,
+    "Number of threads to search for frequent words and clusters with (default: 1)", "<threads>"
+  },
   { NULL, 0, 0, G_OPTION_ARG_NONE, NULL, NULL }
 };
 
@@ -1282,6 +1362,7 @@ static struct
   { "match", match_options, "Match a message against the pattern database", pdbtool_match },
   { "dump", dump_options, "Dump pattern datebase tree", pdbtool_dump },
   { "merge", merge_options, "Merge pattern databases", pdbtool_merge },
+  { "compile", compile_options, "Precompile a pattern database into a cache file", pdbtool_compile },
   { "test", test_options, "Test pattern databases", pdbtool_test },
   { "patternize", patternize_options, "Create a pattern database from logs", pdbtool_patternize },
   { "dictionary", dictionary_options, "Dump pattern dictionary", pdbtool_dictionary },
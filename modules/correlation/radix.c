@@ -28,19 +28,87 @@
 #include <stdlib.h>
 #include <limits.h>
 
+#if defined(__x86_64__) && defined(__GNUC__)
+#define RADIX_SSE2 1
+#include <emmintrin.h>
+#endif
+
 /**************************************************************
  * Parsing nodes.
  **************************************************************/
 
+/*
+ * Character sets of STRING and SET parsers
+ *
+ * The set of accepted characters is compiled into a bitmap when the parser
+ * node is created, so that the input is not matched against the parameter
+ * using strchr() character by character.  NUL is never part of a set.
+ */
+typedef struct _RParserCharSet
+{
+  guint32 bits[256 / 32];
+} RParserCharSet;
+
+static inline gboolean
+_char_set_contains(const RParserCharSet *self, guchar c)
+{
+  return (self->bits[c >> 5] >> (c & 31)) & 1;
+}
+
+static void
+_char_set_init(RParserCharSet *self, const gchar *chars, gboolean alnum)
+{
+  memset(self, 0, sizeof(*self));
+
+  for (gint c = 1; alnum && c < 256; c++)
+    {
+      if (g_ascii_isalnum(c))
+        self->bits[c >> 5] |= 1U << (c & 31);
+    }
+
+  for (const guchar *p = (const guchar *) chars; p && *p; p++)
+    self->bits[*p >> 5] |= 1U << (*p & 31);
+}
+
+static RParserCharSet *
+_char_set_new(const gchar *chars, gboolean alnum)
+{
+  RParserCharSet *self = g_new(RParserCharSet, 1);
+
+  _char_set_init(self, chars, alnum);
+  return self;
+}
+
+static inline gint
+_char_set_span(const RParserCharSet *self, const gchar *str)
+{
+  gint len = 0;
+
+  while (_char_set_contains(self, (guchar) str[len]))
+    len++;
+  return len;
+}
+
+/* parser nodes not created by r_new_pnode() (e.g. in tests) have no
+ * compiled state, in which case the set is compiled on the fly */
+static inline gint
+_match_char_set(gpointer state, const gchar *param, gboolean alnum, const gchar *str)
+{
+  RParserCharSet local_set;
+
+  if (state)
+    return _char_set_span((RParserCharSet *) state, str);
+
+  _char_set_init(&local_set, param, alnum);
+  return _char_set_span(&local_set, str);
+}
+
 /* FIXME: maybe we should return gchar with the result */
 
 gboolean
 r_parser_string(gchar *str, gint *len, const gchar *param, gpointer state, RParserMatch *match)
 {
-  *len = 0;
-
-  while (str[*len] && (g_ascii_isalnum(str[*len]) || (param && strchr(param, str[*len]))))
-    (*len)++;
+  *len = _match_char_set(state, param, TRUE, str);
 
   if (*len > 0)
     {
@@ -107,6 +175,20 @@ r_parser_nlstring(gchar *str, gint *len, const gchar *param, gpointer state, RPa
     return FALSE;
 }
 
+/* The delimiters of ESTRING are short, looking for their first character
+ * with strchr() and comparing the rest in place is cheaper than the
+ * preprocessing strstr() does for every call.  */
+static inline gchar *
+_find_delimiter(gchar *str, const gchar *delimiter, gint delimiter_len)
+{
+  for (gchar *p = strchr(str, delimiter[0]); p; p = strchr(p + 1, delimiter[0]))
+    {
+      if (strncmp(p + 1, delimiter + 1, delimiter_len - 1) == 0)
+        return p;
+    }
+  return NULL;
+}
+
 gboolean
 r_parser_estring(gchar *str, gint *len, const gchar *param, gpointer state, RParserMatch *match)
 {
@@ -115,7 +197,7 @@ r_parser_estring(gchar *str, gint *len, const gchar *param, gpointer state, RPar
   if (!param)
     return FALSE;
 
-  if ((end = strstr(str, param)) != NULL)
+  if ((end = _find_delimiter(str, param, GPOINTER_TO_INT(state))) != NULL)
     {
       *len = (end - str) + GPOINTER_TO_INT(state);
       if (match)
@@ -225,13 +307,13 @@ r_parser_anystring(gchar *str, gint *len, const gchar *param, gpointer state, RP
 gboolean
 r_parser_set(gchar *str, gint *len, const gchar *param, gpointer state, RParserMatch *match)
 {
-  *len = 0;
-
   if (!param)
-    return FALSE;
+    {
+      *len = 0;
+      return FALSE;
+    }
 
-  while (strchr(param, str[*len]))
-    (*len)++;
+  *len = _match_char_set(state, param, FALSE, str);
 
   if (*len > 0)
     {
@@ -397,45 +479,39 @@ r_parser_macaddr(gchar *str, gint *len, const gchar *param, gpointer state, RPar
   return _r_parser_lladdr(str, len, 17, 6, state, match);
 }
 
+/* The digits of an octet are accumulated without a per-character class
+ * check: the unsigned difference from '0' is below 10 for digits only.  The
+ * value saturates at 256, so long runs of digits cannot overflow.  */
 gboolean
 r_parser_ipv4(gchar *str, gint *len, const gchar *param, gpointer state, RParserMatch *match)
 {
-  gint dots = 0;
-  gint octet = -1;
-
-  *len = 0;
+  const guchar *p = (const guchar *) str;
+  gint i = 0;
 
-  while (1)
+  for (gint octets = 0; octets < 4; octets++)
     {
-      if (str[*len] == '.')
+      gint start = i;
+      guint octet = 0;
+      guint digit;
+
+      while ((digit = p[i] - '0') < 10)
         {
-          if (octet > 255 || octet == -1)
-            return FALSE;
+          octet = MIN(octet * 10 + digit, 256);
+          i++;
+        }
 
-          if (G_UNLIKELY(dots == 3))
-            break;
+      if (i == start || octet > 255)
+        return FALSE;
 
-          dots++;
-          octet = -1;
-        }
-      else if (g_ascii_isdigit(str[*len]))
+      if (octets < 3)
         {
-          if (octet == -1)
-            octet = 0;
-          else
-            octet *= 10;
-
-          octet += g_ascii_digit_value(str[*len]);
+          if (p[i] != '.')
+            return FALSE;
+          i++;
         }
-      else
-        break;
-
-      (*len)++;
     }
 
-  if (dots != 3 || octet > 255 || octet == -1)
-    return FALSE;
-
+  *len = i;
   return TRUE;
 }
 
@@ -520,6 +596,40 @@ r_parser_ip(gchar *str, gint *len, const gchar *param, gpointer state, RParserMa
   return r_parser_ipv4(str, len, param, state, match) || r_parser_ipv6(str, len, param, state, match);
 }
 
+#if RADIX_SSE2
+
+/* Bytes are compared 16 at a time.  Aligned loads never cross a page
+ * boundary, so reading past the terminating NUL is safe; the bytes before
+ * the start of the input are masked out.  */
+__attribute__((no_sanitize_address))
+static void
+_scan_digits(gchar *str, gint *len)
+{
+  const __m128i below_zero = _mm_set1_epi8('0' - 1);
+  const __m128i above_nine = _mm_set1_epi8('9' + 1);
+  const gchar *start = str + *len;
+  const gchar *block = (const gchar *) ((guintptr) start & ~(guintptr) 15);
+  guint skip = start - block;
+
+  for (;;)
+    {
+      __m128i v = _mm_load_si128((const __m128i *) block);
+      __m128i digits = _mm_and_si128(_mm_cmpgt_epi8(v, below_zero), _mm_cmplt_epi8(v, above_nine));
+      guint non_digits = ~_mm_movemask_epi8(digits) & 0xffff;
+
+      non_digits &= 0xffff << skip;
+      if (non_digits)
+        {
+          *len = (block + __builtin_ctz(non_digits)) - str;
+          return;
+        }
+      block += 16;
+      skip = 0;
+    }
+}
+
+#else
+
 static inline void
 _scan_digits(gchar *str, gint *len)
 {
@@ -527,6 +637,8 @@ _scan_digits(gchar *str, gint *len)
     (*len)++;
 }
 
+#endif
+
 gboolean
 r_parser_float(gchar *str, gint *len, const gchar *param, gpointer state, RParserMatch *match)
 {
@@ -548,8 +660,7 @@ r_parser_float(gchar *str, gint *len, const gchar *param, gpointer state, RParse
       if (str[*len] == '-')
         (*len)++;
 
-      while (g_ascii_isdigit(str[*len]))
-        (*len)++;
+      _scan_digits(str, len);
     }
 
   if (*len)
@@ -582,8 +693,7 @@ r_parser_number(gchar *str, gint *len, const gchar *param, gpointer state, RPars
           min_len++;
         }
 
-      while (g_ascii_isdigit(str[*len]))
-        (*len)++;
+      _scan_digits(str, len);
     }
 
   if (*len >= min_len)
@@ -651,6 +761,8 @@ r_new_pnode(gchar *key, const gchar *capture_prefix)
     {
       parser_node->parse = r_parser_string;
       parser_node->parser_type = RPT_STRING;
+      parser_node->state = _char_set_new(params_len == 3 ? params[2] : NULL, TRUE);
+      parser_node->free_state = g_free;
     }
   else if (strcmp(params[0], "ESTRING") == 0)
     {
@@ -718,6 +830,8 @@ r_new_pnode(gchar *key, const gchar *capture_prefix)
         {
           parser_node->parse = r_parser_set;
           parser_node->parser_type = RPT_SET;
+          parser_node->state = _char_set_new(params[2], FALSE);
+          parser_node->free_state = g_free;
         }
       else
         {
@@ -733,6 +847,8 @@ r_new_pnode(gchar *key, const gchar *capture_prefix)
         {
           parser_node->parse = r_parser_optionalset;
           parser_node->parser_type = RPT_OPTIONALSET;
+          parser_node->state = _char_set_new(params[2], FALSE);
+          parser_node->free_state = g_free;
         }
       else
         {
@@ -802,6 +918,11 @@ r_new_pnode(gchar *key, const gchar *capture_prefix)
         parser_node->param = g_strdup(params[2]);
     }
 
+  /* parsers of the same type share their profile */
+  if (parser_node)
+    parser_node->profile = rule_profile_get_by_location("radix-parser", r_parser_type_name(parser_node->parser_type),
+                                                         "");
+
 
   g_strfreev(params);
 
@@ -809,8 +930,8 @@ r_new_pnode(gchar *key, const gchar *capture_prefix)
 }
 
 
-void
-r_free_pnode_only(RParserNode *parser)
+static void
+_free_pnode_contents(RParserNode *parser)
 {
   if (parser->param)
     g_free(parser->param);
@@ -818,6 +939,13 @@ r_free_pnode_only(RParserNode *parser)
   if (parser->state && parser->free_state)
     parser->free_state(parser->state);
 
+  rule_profile_unref(parser->profile);
+}
+
+void
+r_free_pnode_only(RParserNode *parser)
+{
+  _free_pnode_contents(parser);
   g_free(parser);
 }
 
@@ -939,6 +1067,9 @@ r_find_child_by_first_character(RNode *root, char key)
   register gint l, u, idx;
   register char k = key;
 
+  if (root->child_index)
+    return root->child_index[(guchar) k];
+
   l = 0;
   u = root->num_children;
 
@@ -966,6 +1097,8 @@ r_insert_node(RNode *root, gchar *key, gpointer value,
   gint nodelen = root->keylen;
   gint i = 0;
 
+  g_assert(!root->frozen);
+
   if (key[0] == '@')
     {
       gchar *end;
@@ -1157,6 +1290,25 @@ r_insert_node(RNode *root, gchar *key, gpointer value,
     }
 }
 
+/* While backtracking, the same parser is often tried at the same position
+ * of the input multiple times, from sibling branches of the tree or in the
+ * second pass of _find_node_with_state().  Parser results are remembered
+ * during a lookup, keyed by the parser, its parameters and the position
+ * (the state of a parser is compiled from its parameters).  Results that
+ * allocated a transformed value are not remembered.  */
+#define R_PARSER_MEMO_SIZE 16
+
+typedef struct _RParserMemoEntry
+{
+  gboolean (*parse)(gchar *str, gint *len, const gchar *param, gpointer state, RParserMatch *match);
+  const gchar *param;
+  const gchar *input;
+  gboolean success;
+  gint len;
+  guint16 match_ofs;
+  guint16 match_len;
+} RParserMemoEntry;
+
 typedef struct _RFindNodeState
 {
   gboolean require_complete_match;
@@ -1165,6 +1317,10 @@ typedef struct _RFindNodeState
   GArray *stored_matches;
   GArray *dbg_list;
   GPtrArray *applicable_nodes;
+  RFindNodeStats stats;
+  RParserMemoEntry parser_memo[R_PARSER_MEMO_SIZE];
+  gint parser_memo_len;
+  gint parser_memo_next;
 } RFindNodeState;
 
 static RNode *_find_node_recursively(RFindNodeState *state, RNode *root, gchar *key, gint keylen);
@@ -1314,16 +1470,77 @@ _is_pnode_matching_initial_character(RParserNode *parser_node, gchar *key)
   return (parser_node->first <= key[0]) && (key[0] <= parser_node->last);
 }
 
+static RParserMemoEntry *
+_lookup_parser_memo(RFindNodeState *state, RParserNode *parser_node, const gchar *key)
+{
+  for (gint i = 0; i < state->parser_memo_len; i++)
+    {
+      RParserMemoEntry *entry = &state->parser_memo[i];
+
+      if (entry->input == key &&
+          entry->parse == parser_node->parse &&
+          g_strcmp0(entry->param, parser_node->param) == 0)
+        return entry;
+    }
+  return NULL;
+}
+
+static void
+_store_parser_memo(RFindNodeState *state, RParserNode *parser_node, const gchar *key, gboolean success,
+                   gint extracted_match_len, RParserMatch *match)
+{
+  RParserMemoEntry *entry;
+
+  if (state->parser_memo_len < R_PARSER_MEMO_SIZE)
+    entry = &state->parser_memo[state->parser_memo_len++];
+  else
+    {
+      entry = &state->parser_memo[state->parser_memo_next];
+      state->parser_memo_next = (state->parser_memo_next + 1) % R_PARSER_MEMO_SIZE;
+    }
+
+  entry->parse = parser_node->parse;
+  entry->param = parser_node->param;
+  entry->input = key;
+  entry->success = success;
+  entry->len = extracted_match_len;
+  entry->match_ofs = match ? match->ofs : 0;
+  entry->match_len = match ? match->len : 0;
+}
+
 static gboolean
-_pnode_try_parse(RParserNode *parser_node, gchar *key, gint *extracted_match_len, RParserMatch *match)
+_pnode_try_parse(RFindNodeState *state, RParserNode *parser_node, gchar *key, gint *extracted_match_len,
+                 RParserMatch *match)
 {
   if (!_is_pnode_matching_initial_character(parser_node, key))
     return FALSE;
 
-  if (!parser_node->parse(key, extracted_match_len, parser_node->param, parser_node->state, match))
-    return FALSE;
+  RParserMemoEntry *memo = _lookup_parser_memo(state, parser_node, key);
+  if (memo)
+    {
+      state->stats.parser_memo_hits++;
+      if (!memo->success)
+        return FALSE;
 
-  return TRUE;
+      *extracted_match_len = memo->len;
+      if (match)
+        {
+          match->ofs = memo->match_ofs;
+          match->len = memo->match_len;
+        }
+      return TRUE;
+    }
+
+  RuleProfileSample sample;
+
+  state->stats.parser_invocations++;
+  rule_profile_begin(parser_node->profile, &sample);
+  gboolean success = parser_node->parse(key, extracted_match_len, parser_node->param, parser_node->state, match);
+  rule_profile_end(parser_node->profile, &sample, success);
+
+  if (!success || !match || !match->match)
+    _store_parser_memo(state, parser_node, key, success, success ? *extracted_match_len : 0, match);
+  return success;
 }
 
 static void
@@ -1368,7 +1585,7 @@ _try_parse_with_a_given_child(RFindNodeState *state, RNode *root, gint parser_nd
 
   match_slot = _clear_match_slot(state, matches_slot_index);
 
-  if (_pnode_try_parse(parser_node, remaining_key, &extracted_match_len, match_slot))
+  if (_pnode_try_parse(state, parser_node, remaining_key, &extracted_match_len, match_slot))
     {
 
       /* FIXME: we don't try to find the longest match in case
@@ -1508,6 +1725,20 @@ r_find_node(RNode *root, gchar *key, gint keylen, GArray *stored_matches)
   return _find_node_with_state(&state, root, key, keylen);
 }
 
+RNode *
+r_find_node_with_stats(RNode *root, gchar *key, gint keylen, GArray *stored_matches, RFindNodeStats *stats)
+{
+  RFindNodeState state =
+  {
+    .whole_key = key,
+    .stored_matches = stored_matches,
+  };
+
+  RNode *ret = _find_node_with_state(&state, root, key, keylen);
+  *stats = state.stats;
+  return ret;
+}
+
 RNode *
 r_find_node_dbg(RNode *root, gchar *key, gint keylen, GArray *stored_matches, GArray *dbg_list)
 {
@@ -1568,11 +1799,205 @@ r_new_node(const gchar *key, gpointer value)
   return node;
 }
 
+/**************************************************************
+ * Frozen trees
+ *
+ * Once a tree is fully built, r_freeze_tree() relocates it into a single
+ * block of memory, laid out breadth first: the child pointer arrays of a
+ * node are followed by its children, each node immediately followed by
+ * its key and its parser.  This way the nodes visited during a lookup are
+ * close to each other, instead of being scattered around the heap.  Nodes
+ * with many literal children also get a 256 entry table indexed by the
+ * first character, replacing the binary search in
+ * r_find_child_by_first_character().
+ *
+ * Lookups work the same way on frozen trees, but they can't be modified
+ * anymore and can only be freed as a whole.
+ **************************************************************/
+
+#define R_NODE_CHILD_INDEX_MIN_CHILDREN 8
+#define R_ARENA_ALIGN(size) (((size) + sizeof(gpointer) - 1) & ~(sizeof(gpointer) - 1))
+
+typedef struct _RArena
+{
+  gchar *base;
+  gsize used;
+} RArena;
+
+static gpointer
+_arena_alloc(RArena *arena, gsize size)
+{
+  gpointer p = arena->base + arena->used;
+
+  arena->used += R_ARENA_ALIGN(size);
+  return p;
+}
+
+static gsize
+_frozen_node_size(RNode *node)
+{
+  gsize size = R_ARENA_ALIGN(sizeof(RNode));
+
+  if (node->key)
+    size += R_ARENA_ALIGN(node->keylen + 1);
+  if (node->parser)
+    size += R_ARENA_ALIGN(sizeof(RParserNode));
+  return size;
+}
+
+static gsize
+_frozen_subtree_size(RNode *node)
+{
+  gsize size = 0;
+
+  size += R_ARENA_ALIGN(node->num_children * sizeof(RNode *));
+  if (node->num_children >= R_NODE_CHILD_INDEX_MIN_CHILDREN)
+    size += R_ARENA_ALIGN(256 * sizeof(RNode *));
+  for (gint i = 0; i < node->num_children; i++)
+    size += _frozen_node_size(node->children[i]) + _frozen_subtree_size(node->children[i]);
+
+  size += R_ARENA_ALIGN(node->num_pchildren * sizeof(RNode *));
+  for (gint i = 0; i < node->num_pchildren; i++)
+    size += _frozen_node_size(node->pchildren[i]) + _frozen_subtree_size(node->pchildren[i]);
+  return size;
+}
+
+/* copies the node along with its key and parser, the children are filled
+ * in by _freeze_children() */
+static RNode *
+_freeze_node(RArena *arena, RNode *node)
+{
+  RNode *frozen = _arena_alloc(arena, sizeof(RNode));
+
+  *frozen = *node;
+  frozen->frozen = TRUE;
+  frozen->children = NULL;
+  frozen->pchildren = NULL;
+
+  if (node->key)
+    {
+      frozen->key = _arena_alloc(arena, node->keylen + 1);
+      memcpy(frozen->key, node->key, node->keylen + 1);
+    }
+  if (node->parser)
+    {
+      frozen->parser = _arena_alloc(arena, sizeof(RParserNode));
+      *frozen->parser = *node->parser;
+    }
+  return frozen;
+}
+
+static void
+_freeze_children(RArena *arena, RNode *node, RNode *frozen, GQueue *pending)
+{
+  if (node->num_children > 0)
+    {
+      frozen->children = _arena_alloc(arena, node->num_children * sizeof(RNode *));
+      if (node->num_children >= R_NODE_CHILD_INDEX_MIN_CHILDREN)
+        frozen->child_index = _arena_alloc(arena, 256 * sizeof(RNode *));
+    }
+  for (gint i = 0; i < node->num_children; i++)
+    {
+      RNode *child = _freeze_node(arena, node->children[i]);
+
+      frozen->children[i] = child;
+      if (frozen->child_index)
+        frozen->child_index[(guchar) child->key[0]] = child;
+      g_queue_push_tail(pending, node->children[i]);
+      g_queue_push_tail(pending, child);
+    }
+
+  if (node->num_pchildren > 0)
+    frozen->pchildren = _arena_alloc(arena, node->num_pchildren * sizeof(RNode *));
+  for (gint i = 0; i < node->num_pchildren; i++)
+    {
+      RNode *child = _freeze_node(arena, node->pchildren[i]);
+
+      frozen->pchildren[i] = child;
+      g_queue_push_tail(pending, node->pchildren[i]);
+      g_queue_push_tail(pending, child);
+    }
+}
+
+/* frees the original nodes after relocation, their values, locations and
+ * parser states are owned by the frozen copy */
+static void
+_free_relocated_node(RNode *node)
+{
+  for (gint i = 0; i < node->num_children; i++)
+    _free_relocated_node(node->children[i]);
+  g_free(node->children);
+
+  for (gint i = 0; i < node->num_pchildren; i++)
+    _free_relocated_node(node->pchildren[i]);
+  g_free(node->pchildren);
+
+  g_free(node->key);
+  g_free(node->parser);
+  g_free(node);
+}
+
+/* returns the relocated tree, root is freed */
+RNode *
+r_freeze_tree(RNode *root)
+{
+  g_assert(!root->frozen);
+
+  gsize size = _frozen_node_size(root) + _frozen_subtree_size(root);
+  RArena arena = { .base = g_malloc0(size) };
+  GQueue pending = G_QUEUE_INIT;
+
+  RNode *frozen_root = _freeze_node(&arena, root);
+  g_queue_push_tail(&pending, root);
+  g_queue_push_tail(&pending, frozen_root);
+
+  while (!g_queue_is_empty(&pending))
+    {
+      RNode *node = g_queue_pop_head(&pending);
+      RNode *frozen = g_queue_pop_head(&pending);
+
+      _freeze_children(&arena, node, frozen, &pending);
+    }
+  g_assert(arena.used == size);
+
+  frozen_root->arena = arena.base;
+  _free_relocated_node(root);
+  return frozen_root;
+}
+
+static void
+_free_frozen_node_contents(RNode *node, void (*free_fn)(gpointer data))
+{
+  for (gint i = 0; i < node->num_children; i++)
+    _free_frozen_node_contents(node->children[i], free_fn);
+
+  for (gint i = 0; i < node->num_pchildren; i++)
+    _free_frozen_node_contents(node->pchildren[i], free_fn);
+
+  if (node->parser)
+    _free_pnode_contents(node->parser);
+
+  g_free(node->pdb_location);
+
+  if (node->value && free_fn)
+    free_fn(node->value);
+}
+
 void
 r_free_node(RNode *node, void (*free_fn)(gpointer data))
 {
   gint i;
 
+  if (node->frozen)
+    {
+      /* only the root of a frozen tree can be freed */
+      g_assert(node->arena);
+
+      _free_frozen_node_contents(node, free_fn);
+      g_free(node->arena);
+      return;
+    }
+
   for (i = 0; i < node->num_children; i++)
     r_free_node(node->children[i], free_fn);
 
@@ -26,6 +26,7 @@
 
 #include "logmsg/logmsg.h"
 #include "messages.h"
+#include "rule-profiler.h"
 
 /* parser types, these are saved in the serialized log message along with
  * the match information thus they have to remain the same in order to keep
@@ -73,6 +74,7 @@ typedef struct _RParserNode
   gchar *param;
   /* internal state of the parser node */
   gpointer state;
+  RuleProfile *profile;
 
   gchar first;
   gchar last;
@@ -100,8 +102,26 @@ struct _RNode
 
   guint num_pchildren;
   RNode **pchildren;
+
+  /* the fields below are only set in trees relocated by r_freeze_tree() */
+
+  /* direct lookup of literal children by their first character, for
+   * nodes with many children */
+  RNode **child_index;
+  /* the memory block holding the whole tree, only set in the root */
+  gpointer arena;
+  gboolean frozen;
 };
 
+/* counters collected during a single lookup, for tuning pattern databases */
+typedef struct _RFindNodeStats
+{
+  /* number of times a parser was actually run */
+  guint parser_invocations;
+  /* number of parser runs saved by reusing the result at the same position */
+  guint parser_memo_hits;
+} RFindNodeStats;
+
 typedef struct _RDebugInfo
 {
   RNode *node;
@@ -148,6 +168,8 @@ r_parser_type_name(guint8 type)
       return "PCRE";
     case RPT_NLSTRING:
       return "NLSTRING";
+    case RPT_OPTIONALSET:
+      return "OPTIONALSET";
     default:
       return "UNKNOWN";
     }
@@ -157,7 +179,9 @@ RNode *r_new_node(const gchar *key, gpointer value);
 void r_free_node(RNode *node, void (*free_fn)(gpointer data));
 void r_insert_node(RNode *root, gchar *key, gpointer value,
                    const gchar *capture_prefix, RNodeGetValueFunc value_func, const gchar *location);
+RNode *r_freeze_tree(RNode *root);
 RNode *r_find_node(RNode *root, gchar *key, gint keylen, GArray *matches);
+RNode *r_find_node_with_stats(RNode *root, gchar *key, gint keylen, GArray *matches, RFindNodeStats *stats);
 RNode *r_find_node_dbg(RNode *root, gchar *key, gint keylen, GArray *matches, GArray *dbg_list);
 gchar **r_find_all_applicable_nodes(RNode *root, gchar *key, gint keylen, RNodeGetValueFunc value_func);
 
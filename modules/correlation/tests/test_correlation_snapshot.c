@@ -0,0 +1,211 @@
+/*
+ * Copyright (c) 2024 One Identity LLC.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+#include <criterion/criterion.h>
+#include "libtest/persist_lib.h"
+
+#include "correlation-snapshot.h"
+#include "correlation-context.h"
+#include "apphook.h"
+
+#include <unistd.h>
+
+#define PERSIST_FILE "test_correlation_snapshot.persist"
+#define PERSIST_NAME "grouping-by(test)"
+
+static void
+_expire_entry(TimerWheel *wheel, guint64 now, gpointer user_data, gpointer caller_context)
+{
+}
+
+static CorrelationContext *
+_construct_context(CorrelationKey *key, gpointer user_data)
+{
+  return correlation_context_new(key);
+}
+
+static LogMessage *
+_create_message(const gchar *host, const gchar *message)
+{
+  LogMessage *msg = log_msg_new_empty();
+
+  log_msg_set_value(msg, LM_V_HOST, host, -1);
+  log_msg_set_value(msg, LM_V_MESSAGE, message, -1);
+  return msg;
+}
+
+static void
+_store_context(CorrelationState *state, const gchar *host, const gchar *session_id, gint num_messages)
+{
+  LogMessage *msg = _create_message(host, "message0");
+  CorrelationKey key;
+
+  correlation_key_init(&key, RCS_HOST, msg, g_strdup(session_id));
+  CorrelationContext *context = correlation_context_new(&key);
+
+  g_ptr_array_add(context->messages, msg);
+  for (gint i = 1; i < num_messages; i++)
+    {
+      gchar message[32];
+
+      g_snprintf(message, sizeof(message), "message%d", i);
+      g_ptr_array_add(context->messages, _create_message(host, message));
+    }
+
+  correlation_state_tx_begin_for_key(state, &key);
+  correlation_state_tx_store_context(state, context, 60);
+  correlation_state_tx_end_for_key(state, &key);
+}
+
+static CorrelationContext *
+_lookup_context(CorrelationState *state, const gchar *host, const gchar *session_id)
+{
+  LogMessage *msg = _create_message(host, "");
+  CorrelationKey key;
+
+  correlation_key_init(&key, RCS_HOST, msg, (gchar *) session_id);
+  correlation_state_tx_begin_for_key(state, &key);
+  CorrelationContext *context = correlation_state_tx_lookup_context(state, &key);
+  correlation_state_tx_end_for_key(state, &key);
+  log_msg_unref(msg);
+  return context;
+}
+
+static PersistState *
+_save_and_restart(CorrelationState *state, PersistState *persist_state)
+{
+  cr_assert(correlation_state_save_snapshot(state, persist_state, PERSIST_NAME));
+  return restart_persist_state(persist_state);
+}
+
+Test(correlation_snapshot, contexts_are_restored_after_a_restart)
+{
+  PersistState *persist_state = clean_and_create_persist_state_for_test(PERSIST_FILE);
+  CorrelationState *state = correlation_state_new_sharded(_expire_entry, 4);
+
+  _store_context(state, "host1", "session1", 3);
+  _store_context(state, "host2", "session1", 1);
+  persist_state = _save_and_restart(state, persist_state);
+  correlation_state_unref(state);
+
+  gchar *filename = correlation_snapshot_format_filename(persist_state, PERSIST_NAME);
+  cr_assert_eq(access(filename, F_OK), 0);
+
+  state = correlation_state_new_sharded(_expire_entry, 4);
+  cr_assert(correlation_state_restore_snapshot(state, persist_state, PERSIST_NAME, _construct_context, NULL));
+
+  CorrelationContext *context = _lookup_context(state, "host1", "session1");
+  cr_assert_not_null(context);
+  cr_assert_not_null(context->serialized_messages, "messages are expected to be restored lazily");
+  cr_assert_eq(context->messages->len, 0);
+
+  cr_assert(correlation_context_restore_messages(context));
+  cr_assert_null(context->serialized_messages);
+  cr_assert_eq(context->messages->len, 3);
+  for (gint i = 0; i < 3; i++)
+    {
+      gchar message[32];
+
+      g_snprintf(message, sizeof(message), "message%d", i);
+      cr_assert_str_eq(log_msg_get_value(g_ptr_array_index(context->messages, i), LM_V_MESSAGE, NULL), message);
+    }
+
+  cr_assert_not_null(_lookup_context(state, "host2", "session1"));
+  cr_assert_null(_lookup_context(state, "host3", "session1"));
+
+  correlation_state_unref(state);
+
+  /* the snapshot is consumed by the restore */
+  cr_assert_neq(access(filename, F_OK), 0);
+  state = correlation_state_new_sharded(_expire_entry, 4);
+  cr_assert(correlation_state_restore_snapshot(state, persist_state, PERSIST_NAME, _construct_context, NULL));
+  cr_assert_null(_lookup_context(state, "host1", "session1"));
+
+  correlation_state_unref(state);
+  g_free(filename);
+  cancel_and_destroy_persist_state(persist_state);
+}
+
+Test(correlation_snapshot, restored_contexts_are_saved_again_without_deserializing_them)
+{
+  PersistState *persist_state = clean_and_create_persist_state_for_test(PERSIST_FILE);
+  CorrelationState *state = correlation_state_new_sharded(_expire_entry, 4);
+
+  _store_context(state, "host1", "session1", 2);
+  persist_state = _save_and_restart(state, persist_state);
+  correlation_state_unref(state);
+
+  state = correlation_state_new_sharded(_expire_entry, 4);
+  cr_assert(correlation_state_restore_snapshot(state, persist_state, PERSIST_NAME, _construct_context, NULL));
+  persist_state = _save_and_restart(state, persist_state);
+  correlation_state_unref(state);
+
+  state = correlation_state_new_sharded(_expire_entry, 4);
+  cr_assert(correlation_state_restore_snapshot(state, persist_state, PERSIST_NAME, _construct_context, NULL));
+
+  CorrelationContext *context = _lookup_context(state, "host1", "session1");
+  cr_assert_not_null(context);
+  cr_assert(correlation_context_restore_messages(context));
+  cr_assert_eq(context->messages->len, 2);
+
+  correlation_state_unref(state);
+  cancel_and_destroy_persist_state(persist_state);
+}
+
+Test(correlation_snapshot, truncated_snapshots_are_dropped)
+{
+  PersistState *persist_state = clean_and_create_persist_state_for_test(PERSIST_FILE);
+  CorrelationState *state = correlation_state_new_sharded(_expire_entry, 4);
+
+  _store_context(state, "host1", "session1", 2);
+  persist_state = _save_and_restart(state, persist_state);
+  correlation_state_unref(state);
+
+  gchar *filename = correlation_snapshot_format_filename(persist_state, PERSIST_NAME);
+  cr_assert_eq(truncate(filename, 16), 0);
+
+  state = correlation_state_new_sharded(_expire_entry, 4);
+  cr_assert_not(correlation_state_restore_snapshot(state, persist_state, PERSIST_NAME, _construct_context, NULL));
+  cr_assert_null(_lookup_context(state, "host1", "session1"));
+  cr_assert_neq(access(filename, F_OK), 0);
+
+  correlation_state_unref(state);
+  g_free(filename);
+  cancel_and_destroy_persist_state(persist_state);
+}
+
+Test(correlation_snapshot, no_snapshot_is_written_without_contexts)
+{
+  PersistState *persist_state = clean_and_create_persist_state_for_test(PERSIST_FILE);
+  CorrelationState *state = correlation_state_new_sharded(_expire_entry, 4);
+
+  cr_assert(correlation_state_save_snapshot(state, persist_state, PERSIST_NAME));
+
+  gchar *filename = correlation_snapshot_format_filename(persist_state, PERSIST_NAME);
+  cr_assert_neq(access(filename, F_OK), 0);
+  cr_assert(correlation_state_restore_snapshot(state, persist_state, PERSIST_NAME, _construct_context, NULL));
+
+  correlation_state_unref(state);
+  g_free(filename);
+  cancel_and_destroy_persist_state(persist_state);
+}
+
+TestSuite(correlation_snapshot, .init = app_startup, .fini = app_shutdown);
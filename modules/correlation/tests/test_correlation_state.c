@@ -0,0 +1,225 @@
+/*
+ * Copyright (c) 2024 One Identity LLC.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#include <criterion/criterion.h>
+
+#include "correlation.h"
+#include "correlation-context.h"
+
+#define NUM_SHARDS 16
+#define NUM_KEYS 64
+
+static gint num_expired;
+
+static void
+_expire_entry(TimerWheel *wheel, guint64 now, gpointer user_data, gpointer caller_context)
+{
+  CorrelationContext *context = (CorrelationContext *) user_data;
+  CorrelationState *state = (CorrelationState *) timer_wheel_get_associated_data(wheel);
+
+  context->timer = NULL;
+  correlation_state_tx_remove_context(state, context);
+  num_expired++;
+}
+
+static void
+_store_context(CorrelationState *state, const gchar *session_id, gint timeout)
+{
+  CorrelationKey key;
+
+  correlation_key_init(&key, RCS_GLOBAL, NULL, g_strdup(session_id));
+  CorrelationContext *context = correlation_context_new(&key);
+
+  correlation_state_tx_begin_for_key(state, &key);
+  correlation_state_tx_store_context(state, context, timeout);
+  correlation_state_tx_end_for_key(state, &key);
+}
+
+static gboolean
+_is_context_stored(CorrelationState *state, const gchar *session_id)
+{
+  CorrelationKey key;
+
+  correlation_key_init(&key, RCS_GLOBAL, NULL, (gchar *) session_id);
+  correlation_state_tx_begin_for_key(state, &key);
+  gboolean found = correlation_state_tx_lookup_context(state, &key) != NULL;
+  correlation_state_tx_end_for_key(state, &key);
+  return found;
+}
+
+static gint
+_get_shard_index(const gchar *session_id)
+{
+  CorrelationKey key;
+
+  correlation_key_init(&key, RCS_GLOBAL, NULL, (gchar *) session_id);
+  return correlation_key_hash(&key) % NUM_SHARDS;
+}
+
+static CorrelationState *
+_create_state(void)
+{
+  CorrelationState *state = correlation_state_new_sharded(_expire_entry, NUM_SHARDS);
+
+  correlation_state_set_associated_data(state, state, NULL);
+  num_expired = 0;
+  return state;
+}
+
+Test(correlation_state, contexts_are_distributed_across_shards)
+{
+  CorrelationState *state = _create_state();
+  gchar session_id[32];
+
+  for (gint i = 0; i < NUM_KEYS; i++)
+    {
+      g_snprintf(session_id, sizeof(session_id), "session%d", i);
+      _store_context(state, session_id, 60);
+    }
+
+  gint num_contexts = 0, num_used_shards = 0;
+  for (gint i = 0; i < state->num_shards; i++)
+    {
+      num_contexts += g_hash_table_size(state->shards[i].state);
+      num_used_shards += g_hash_table_size(state->shards[i].state) > 0;
+    }
+  cr_assert_eq(num_contexts, NUM_KEYS);
+  cr_assert_gt(num_used_shards, 1);
+
+  for (gint i = 0; i < NUM_KEYS; i++)
+    {
+      g_snprintf(session_id, sizeof(session_id), "session%d", i);
+      cr_assert(_is_context_stored(state, session_id), "context not found: %s", session_id);
+    }
+  cr_assert_not(_is_context_stored(state, "no-such-session"));
+
+  correlation_state_unref(state);
+}
+
+Test(correlation_state, time_is_advanced_per_shard)
+{
+  CorrelationState *state = _create_state();
+  gchar other_session_id[32] = "other";
+
+  for (gint i = 0; _get_shard_index(other_session_id) == _get_shard_index("session"); i++)
+    g_snprintf(other_session_id, sizeof(other_session_id), "other%d", i);
+
+  _store_context(state, "session", 10);
+  _store_context(state, other_session_id, 10);
+
+  CorrelationKey key;
+  correlation_key_init(&key, RCS_GLOBAL, NULL, "session");
+  correlation_state_set_time_for_key(state, &key, 100, NULL);
+
+  cr_assert_eq(num_expired, 1);
+  cr_assert_not(_is_context_stored(state, "session"));
+  cr_assert(_is_context_stored(state, other_session_id));
+  cr_assert_eq(correlation_state_get_time(state), 100);
+
+  correlation_state_advance_time(state, 100, NULL);
+  cr_assert_eq(num_expired, 2);
+  cr_assert_not(_is_context_stored(state, other_session_id));
+
+  correlation_state_unref(state);
+}
+
+Test(correlation_state, expire_all_covers_every_shard)
+{
+  CorrelationState *state = _create_state();
+  gchar session_id[32];
+
+  for (gint i = 0; i < NUM_KEYS; i++)
+    {
+      g_snprintf(session_id, sizeof(session_id), "session%d", i);
+      _store_context(state, session_id, 60);
+    }
+
+  correlation_state_expire_all(state, NULL);
+  cr_assert_eq(num_expired, NUM_KEYS);
+
+  correlation_state_unref(state);
+}
+
+Test(correlation_state, expiry_budget_spreads_expiration_over_time_updates)
+{
+  CorrelationState *state = correlation_state_new(_expire_entry);
+  gchar session_id[32];
+
+  correlation_state_set_associated_data(state, state, NULL);
+  correlation_state_set_expiry_budget(state, 10);
+  num_expired = 0;
+
+  for (gint i = 0; i < NUM_KEYS; i++)
+    {
+      g_snprintf(session_id, sizeof(session_id), "session%d", i);
+      _store_context(state, session_id, 10);
+    }
+
+  correlation_state_advance_time(state, 100, NULL);
+  cr_assert_eq(num_expired, 10);
+  cr_assert(correlation_state_is_expiry_pending(state));
+
+  while (correlation_state_is_expiry_pending(state))
+    correlation_state_timer_tick(state, NULL);
+  cr_assert_eq(num_expired, NUM_KEYS);
+  cr_assert_eq(correlation_state_get_time(state), 100);
+
+  correlation_state_unref(state);
+}
+
+static void
+_expire_entry_batched(TimerWheel *wheel, guint64 now, gpointer user_data, gpointer caller_context)
+{
+  CorrelationContext *context = (CorrelationContext *) user_data;
+  CorrelationState *state = (CorrelationState *) timer_wheel_get_associated_data(wheel);
+
+  cr_assert_null(context->timer);
+  cr_assert_not(_is_context_stored(state, context->key.session_id),
+                "expired context is still in the state: %s", context->key.session_id);
+  num_expired++;
+}
+
+Test(correlation_state, batched_expiry_runs_callbacks_without_the_lock)
+{
+  CorrelationState *state = correlation_state_new_sharded(_expire_entry_batched, NUM_SHARDS);
+  gchar session_id[32];
+
+  correlation_state_enable_batched_expiry(state);
+  correlation_state_set_associated_data(state, state, NULL);
+  num_expired = 0;
+
+  for (gint i = 0; i < NUM_KEYS; i++)
+    {
+      g_snprintf(session_id, sizeof(session_id), "session%d", i);
+      _store_context(state, session_id, 10);
+    }
+
+  /* _is_context_stored() would deadlock if the callback was called with the
+   * shard locked */
+  correlation_state_advance_time(state, 100, NULL);
+  cr_assert_eq(num_expired, NUM_KEYS);
+
+  for (gint i = 0; i < state->num_shards; i++)
+    cr_assert_eq(g_hash_table_size(state->shards[i].state), 0);
+
+  correlation_state_unref(state);
+}
@@ -0,0 +1,227 @@
+/*
+ * Copyright (c) 2024 One Identity LLC.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#include <criterion/criterion.h>
+#include "libtest/cr_template.h"
+#include "libtest/msg_parse_lib.h"
+#include "libtest/config_parse_lib.h"
+#include "libtest/mock-logpipe.h"
+
+/* the memory accounting of the contexts is checked from the inside */
+#include "group-lines.c"
+#include "apphook.h"
+#include "cfg.h"
+#include "scratch-buffers.h"
+#include "stats/stats.h"
+
+static LogPipeMock *capture;
+static LogParser *parser;
+
+static void
+_init_group_lines(const gchar *options)
+{
+  gchar *expr = g_strdup_printf("group-lines(key(\"$key\") multi-line-mode(indented) timeout(10) %s);", options);
+
+  cr_assert(parse_config(expr, LL_CONTEXT_PARSER, NULL, (gpointer *) &parser));
+  g_free(expr);
+
+  capture = log_pipe_mock_new(configuration);
+  log_pipe_append(&parser->super, &capture->super);
+  cr_assert(log_pipe_init(&capture->super));
+  cr_assert(log_pipe_init(&parser->super));
+}
+
+static void
+_process_line(const gchar *key, const gchar *line)
+{
+  LogPathOptions path_options = LOG_PATH_OPTIONS_INIT;
+  LogMessage *msg = log_msg_new_empty();
+
+  log_msg_set_value_by_name(msg, "key", key, -1);
+  log_msg_set_value(msg, LM_V_MESSAGE, line, -1);
+  /* NOTE: log_pipe_queue() consumes a reference */
+  log_pipe_queue(&parser->super, msg, &path_options);
+}
+
+static GroupLinesAccounting *
+_accounting(void)
+{
+  return ((GroupLines *) parser)->accounting;
+}
+
+static gsize
+_memory_usage(void)
+{
+  return group_lines_accounting_get_memory_usage(_accounting());
+}
+
+static guint
+_active_contexts(void)
+{
+  return g_queue_get_length(&_accounting()->contexts);
+}
+
+static void
+_assert_captured_groups(const gchar **groups, guint n)
+{
+  cr_assert_eq(capture->captured_messages->len, n, "unexpected number of groups: %u, expected: %u",
+               capture->captured_messages->len, n);
+  for (guint i = 0; i < n; i++)
+    assert_log_message_value(log_pipe_mock_get_message(capture, i), LM_V_MESSAGE, groups[i]);
+}
+
+static void
+_start_three_groups(void)
+{
+  _process_line("a", "a first");
+  _process_line("b", "b first");
+  _process_line("c", "c first");
+
+  /* a becomes the most recently updated group, b the least recently updated one */
+  _process_line("a", "  a more");
+  cr_assert_eq(capture->captured_messages->len, 0);
+  cr_assert_eq(_active_contexts(), 3);
+}
+
+/* long enough for the line buffer to grow */
+#define CONTINUATION "  a continuation line, long enough to grow the buffer of the group"
+
+Test(group_lines, test_exceeding_max_memory_flushes_the_least_recently_updated_group)
+{
+  _init_group_lines("");
+  _start_three_groups();
+
+  group_lines_set_max_memory(&parser->super, _memory_usage());
+  _process_line("c", CONTINUATION);
+
+  /* only b is flushed, its lines are not lost */
+  _assert_captured_groups((const gchar *[]) { "b first" }, 1);
+  cr_assert_eq(_active_contexts(), 2);
+  cr_assert_leq(_memory_usage(), ((GroupLines *) parser)->max_memory);
+
+  /* the groups kept in memory are not affected */
+  _process_line("a", "a second");
+  _process_line("c", "c second");
+  _assert_captured_groups((const gchar *[]) { "b first", "a first\n  a more", "c first\n" CONTINUATION }, 3);
+}
+
+Test(group_lines, test_groups_are_flushed_oldest_first_until_the_limit_is_met)
+{
+  _init_group_lines("");
+  _start_three_groups();
+
+  gsize usage = _memory_usage();
+  group_lines_set_max_memory(&parser->super, usage);
+
+  /* a fragment larger than the limit itself, none of the groups fit next to it */
+  GString *large_line = g_string_new("  ");
+  for (gsize i = 0; i < usage; i++)
+    g_string_append_c(large_line, 'x');
+  _process_line("c", large_line->str);
+
+  cr_assert_eq(capture->captured_messages->len, 3);
+  assert_log_message_value(log_pipe_mock_get_message(capture, 0), LM_V_MESSAGE, "b first");
+  assert_log_message_value(log_pipe_mock_get_message(capture, 1), LM_V_MESSAGE, "a first\n  a more");
+
+  GString *expected = g_string_new("c first\n");
+  g_string_append(expected, large_line->str);
+  assert_log_message_value(log_pipe_mock_get_message(capture, 2), LM_V_MESSAGE, expected->str);
+  g_string_free(expected, TRUE);
+  g_string_free(large_line, TRUE);
+
+  cr_assert_eq(_active_contexts(), 0);
+  cr_assert_eq(_memory_usage(), 0);
+  cr_assert_eq(stats_counter_get(((GroupLines *) parser)->forced_flushes), 3);
+}
+
+Test(group_lines, test_max_memory_is_parsed)
+{
+  _init_group_lines("max-memory(123456)");
+
+  cr_assert_eq(((GroupLines *) parser)->max_memory, 123456);
+}
+
+Test(group_lines, test_without_max_memory_nothing_is_flushed_early)
+{
+  _init_group_lines("");
+
+  for (gint i = 0; i < 100; i++)
+    {
+      gchar key[16];
+
+      g_snprintf(key, sizeof(key), "key%d", i);
+      _process_line(key, "first line");
+      _process_line(key, "  second line");
+    }
+
+  cr_assert_eq(capture->captured_messages->len, 0);
+  cr_assert_eq(_active_contexts(), 100);
+}
+
+Test(group_lines, test_memory_of_large_groups_is_released_when_they_are_emitted)
+{
+  _init_group_lines("");
+  _process_line("a", "a first");
+  gsize initial_usage = _memory_usage();
+
+  for (gint i = 0; i < 200; i++)
+    _process_line("a", "  a continuation line of the group");
+  cr_assert_gt(_memory_usage(), initial_usage + GROUP_LINES_RETAINED_BUFFER_SIZE);
+
+  _process_line("a", "a second");
+  cr_assert_eq(capture->captured_messages->len, 1);
+  cr_assert_lt(_memory_usage(), initial_usage + GROUP_LINES_RETAINED_BUFFER_SIZE,
+               "the buffer of an emitted group is kept allocated");
+  cr_assert_eq(_active_contexts(), 1);
+}
+
+static void
+setup(void)
+{
+  app_startup();
+  configuration = cfg_new_snippet();
+  configuration->stats_options.level = STATS_LEVEL1;
+  stats_reinit(&configuration->stats_options);
+  cfg_load_module(configuration, "correlation");
+}
+
+static void
+teardown(void)
+{
+  if (parser)
+    {
+      log_pipe_deinit(&parser->super);
+      log_pipe_unref(&parser->super);
+      parser = NULL;
+    }
+  if (capture)
+    {
+      log_pipe_deinit(&capture->super);
+      log_pipe_unref(&capture->super);
+      capture = NULL;
+    }
+  scratch_buffers_explicit_gc();
+  cfg_free(configuration);
+  app_shutdown();
+}
+
+TestSuite(group_lines, .init = setup, .fini = teardown);
@@ -31,6 +31,8 @@
 #include "filter/filter-expr.h"
 #include "patterndb.h"
 #include "pdb-file.h"
+#include "pdb-cache.h"
+#include "rule-profiler.h"
 #include "plugin.h"
 #include "cfg.h"
 #include "timerwheel.h"
@@ -312,6 +314,121 @@ Test(pattern_db, test_simple_rule_without_context_or_actions)
   g_free(filename);
 }
 
+static PatternDB *
+_load_pattern_db_with_cache(const gchar *filename, const gchar *cache_dir)
+{
+  PatternDB *patterndb = pattern_db_new(NULL);
+
+  pattern_db_set_emit_func(patterndb, _emit_func, NULL);
+  pattern_db_set_cache_dir(patterndb, cache_dir);
+  cr_assert(pattern_db_reload_ruleset(patterndb, configuration, filename), "Error loading ruleset: %s", filename);
+  cr_assert_str_eq(pattern_db_get_ruleset_pub_date(patterndb), "2010-02-22", "Invalid pubdate");
+  return patterndb;
+}
+
+Test(pattern_db, test_ruleset_is_loaded_from_the_precompiled_cache)
+{
+  gchar *filename;
+  gchar *cache_dir = g_dir_make_tmp("patterndb-cacheXXXXXX", NULL);
+  PatternDB *patterndb = _create_pattern_db(pdb_ruletest_skeleton, &filename);
+  gchar *cache_filename = pdb_cache_get_filename(cache_dir, filename);
+
+  /* the cache is opt-in */
+  cr_assert_not(g_file_test(cache_filename, G_FILE_TEST_EXISTS), "Precompiled cache written without a cache dir");
+  pattern_db_free(patterndb);
+
+  patterndb = _load_pattern_db_with_cache(filename, cache_dir);
+  cr_assert(g_file_test(cache_filename, G_FILE_TEST_EXISTS), "Precompiled cache was not written: %s", cache_filename);
+  pattern_db_free(patterndb);
+
+  /* the second load replays the cache, the outcome must be the same */
+  patterndb = _load_pattern_db_with_cache(filename, cache_dir);
+  assert_msg_matches_and_has_tag(patterndb, "simple-message", ".classifier.system", TRUE);
+  assert_msg_matches_and_nvpair_equals(patterndb, "simple-message", "simple-msg-value-1", "value1");
+
+  _destroy_pattern_db(patterndb, filename);
+  g_unlink(cache_filename);
+  g_rmdir(cache_dir);
+  g_free(cache_filename);
+  g_free(cache_dir);
+  g_free(filename);
+}
+
+Test(pattern_db, test_read_only_cache_dir_is_not_an_error)
+{
+  if (geteuid() == 0)
+    cr_skip_test("the cache dir is writable by root");
+
+  gchar *filename;
+  gchar *cache_dir = g_dir_make_tmp("patterndb-cacheXXXXXX", NULL);
+  PatternDB *patterndb = _create_pattern_db(pdb_ruletest_skeleton, &filename);
+  gchar *cache_filename = pdb_cache_get_filename(cache_dir, filename);
+  pattern_db_free(patterndb);
+
+  cr_assert_eq(g_chmod(cache_dir, 0500), 0);
+  patterndb = _load_pattern_db_with_cache(filename, cache_dir);
+  cr_assert_not(g_file_test(cache_filename, G_FILE_TEST_EXISTS));
+
+  assert_msg_matches_and_has_tag(patterndb, "simple-message", ".classifier.system", TRUE);
+
+  _destroy_pattern_db(patterndb, filename);
+  g_chmod(cache_dir, 0700);
+  g_rmdir(cache_dir);
+  g_free(cache_filename);
+  g_free(cache_dir);
+  g_free(filename);
+}
+
+/* returns the calls and matches columns of a profile line, see rule_profiler_format_csv() */
+static void
+_get_rule_profile(const gchar *kind, const gchar *name, gint *calls, gint *matches)
+{
+  GString *csv = g_string_new("");
+  gchar *prefix = g_strdup_printf("\n%s;%s;", kind, name);
+
+  rule_profiler_format_csv(csv);
+  const gchar *line = strstr(csv->str, prefix);
+  cr_assert_not_null(line, "Profile not found: %s;%s\n%s", kind, name, csv->str);
+
+  /* skip kind, name and location */
+  line = strchr(strchr(strchr(line + 1, ';') + 1, ';') + 1, ';') + 1;
+  cr_assert_eq(sscanf(line, "%d;%d;", calls, matches), 2);
+
+  g_free(prefix);
+  g_string_free(csv, TRUE);
+}
+
+Test(pattern_db, test_rule_profiles_count_the_hits_of_programs_and_rules)
+{
+  gchar *filename;
+  PatternDB *patterndb = _create_pattern_db(pdb_ruletest_skeleton, &filename);
+  gint calls, matches;
+
+  rule_profiler_enable(1);
+
+  /* the second program name of the ruleset is found by the exact match index */
+  LogMessage *msg = _construct_message("prog2", "simple-message");
+  cr_assert(_process(patterndb, msg));
+  log_msg_unref(msg);
+
+  msg = _construct_message("prog2", "no-such-message");
+  _process(patterndb, msg);
+  log_msg_unref(msg);
+
+  _get_rule_profile("pdb-program", "prog1", &calls, &matches);
+  cr_assert_eq(calls, 2);
+  cr_assert_eq(matches, 1);
+
+  _get_rule_profile("pdb-rule", "10", &calls, &matches);
+  cr_assert_eq(calls, 1);
+  cr_assert_eq(matches, 1);
+
+  rule_profiler_disable();
+  rule_profiler_reset();
+  _destroy_pattern_db(patterndb, filename);
+  g_free(filename);
+}
+
 Test(pattern_db, test_correlation_rule_without_actions)
 {
   gchar *filename;
@@ -696,6 +813,58 @@ Test(pattern_db, test_tag_outside_of_rule_skeleton)
   g_free(filename);
 }
 
+typedef struct _ConcurrentLookupState
+{
+  PatternDB *patterndb;
+  gint stop;
+  gint lookups;
+  gint mismatches;
+} ConcurrentLookupState;
+
+static gpointer
+_lookup_thread(gpointer user_data)
+{
+  ConcurrentLookupState *state = (ConcurrentLookupState *) user_data;
+
+  while (!g_atomic_int_get(&state->stop))
+    {
+      LogMessage *msg = _construct_message("prog1", "pattern foobar something else");
+
+      if (!pattern_db_process(state->patterndb, msg) ||
+          strcmp(log_msg_get_value_by_name(msg, ".classifier.rule_id", NULL), "11") != 0)
+        g_atomic_int_inc(&state->mismatches);
+      g_atomic_int_inc(&state->lookups);
+      log_msg_unref(msg);
+    }
+  return NULL;
+}
+
+Test(pattern_db, test_ruleset_reload_while_looking_up_rules)
+{
+  gchar *filename;
+  ConcurrentLookupState state = {0};
+  GThread *threads[4];
+
+  state.patterndb = _create_pattern_db(pdb_conflicting_rules_with_the_same_parsers, &filename);
+  for (gint i = 0; i < G_N_ELEMENTS(threads); i++)
+    threads[i] = g_thread_new(NULL, _lookup_thread, &state);
+
+  for (gint i = 0; i < 20; i++)
+    cr_assert(pattern_db_reload_ruleset(state.patterndb, configuration, filename));
+
+  while (g_atomic_int_get(&state.lookups) < 100)
+    g_thread_yield();
+  g_atomic_int_set(&state.stop, TRUE);
+  for (gint i = 0; i < G_N_ELEMENTS(threads); i++)
+    g_thread_join(threads[i]);
+
+  cr_assert_eq(state.mismatches, 0, "lookups failed while the ruleset was being reloaded");
+  assert_msg_with_program_matches_and_nvpair_equals(state.patterndb, "prog1", "pattern foobar something else",
+                                                    ".classifier.rule_id", "11");
+  _destroy_pattern_db(state.patterndb, filename);
+  g_free(filename);
+}
+
 const gchar *dirs[] =
 {
   "pathutils_get_filenames",
@@ -155,7 +155,7 @@ ParameterizedTestParameters(dbparser, test_frequent_words)
 
 ParameterizedTest(PatternizeParams *param, dbparser, test_frequent_words, .init = setup, .fini = teardown)
 {
-  int i, twopass;
+  int i, run;
   gchar **expecteds;
   GHashTable *wordlist;
   loglinesType *logmessages;
@@ -165,9 +165,11 @@ ParameterizedTest(PatternizeParams *param, dbparser, test_frequent_words, .init
 
   expecteds = g_strsplit(param->expected, ",", 0);
 
-  for (twopass = 1; twopass <= 2; ++twopass)
+  /* single and two pass, each with one and more threads */
+  for (run = 0; run < 4; ++run)
     {
-      wordlist = ptz_find_frequent_words(logmessages->logmessages, param->support, delimiters, twopass == 1);
+      wordlist = ptz_find_frequent_words(logmessages->logmessages, param->support, delimiters, run % 2 == 0,
+                                         run < 2 ? 1 : 4);
 
       for (i = 0; expecteds[i]; ++i)
         {
@@ -373,7 +375,7 @@ ParameterizedTest(PatternizeParams *param, dbparser, test_find_clusters_slct, .i
 
   logmessages = _get_logmessages(param->logs);
 
-  clusters = ptz_find_clusters_slct(logmessages->logmessages, param->support, delimiters, 0);
+  clusters = ptz_find_clusters_slct(logmessages->logmessages, param->support, delimiters, 0, 1);
 
   expecteds = g_strsplit(param->expected, "|", 0);
   for (i = 0; expecteds[i]; ++i)
@@ -416,3 +418,52 @@ ParameterizedTest(PatternizeParams *param, dbparser, test_find_clusters_slct, .i
   g_free(logmessages);
   g_strfreev(expecteds);
 }
+
+static void
+_assert_clusters_equal(gpointer key, gpointer value, gpointer user_data)
+{
+  GHashTable *expected_clusters = (GHashTable *) user_data;
+  Cluster *cluster = (Cluster *) value;
+  Cluster *expected_cluster = (Cluster *) g_hash_table_lookup(expected_clusters, key);
+
+  cr_assert_not_null(expected_cluster, "Unexpected cluster found with multiple threads: %s", (gchar *) key);
+  cr_assert_eq(cluster->loglines->len, expected_cluster->loglines->len);
+  for (guint i = 0; i < cluster->loglines->len; i++)
+    cr_assert_eq(g_ptr_array_index(cluster->loglines, i), g_ptr_array_index(expected_cluster->loglines, i));
+
+  cr_assert_eq(cluster->samples->len, expected_cluster->samples->len);
+  for (guint i = 0; i < cluster->samples->len; i++)
+    cr_assert_str_eq(g_ptr_array_index(cluster->samples, i), g_ptr_array_index(expected_cluster->samples, i));
+}
+
+Test(dbparser, test_find_clusters_slct_with_multiple_threads, .init = setup, .fini = teardown)
+{
+  GString *logs = g_string_new("");
+  gchar *delimiters = " :&~?![]=,;()'\"";
+  loglinesType *logmessages;
+
+  for (gint i = 0; i < 100; i++)
+    {
+      g_string_append_printf(logs, "user%d logged in from host%d\n", i, i % 7);
+      g_string_append_printf(logs, "connection closed by peer %d\n", i);
+      if (i % 3 == 0)
+        g_string_append_printf(logs, "disk %d is full\n", i);
+    }
+  g_string_append(logs, "sallala");
+  logmessages = _get_logmessages(logs->str);
+
+  GHashTable *expected_clusters = ptz_find_clusters_slct(logmessages->logmessages, 10, delimiters, 3, 1);
+  GHashTable *clusters = ptz_find_clusters_slct(logmessages->logmessages, 10, delimiters, 3, 4);
+
+  cr_assert_gt(g_hash_table_size(expected_clusters), 0);
+  cr_assert_eq(g_hash_table_size(clusters), g_hash_table_size(expected_clusters));
+  g_hash_table_foreach(clusters, _assert_clusters_equal, expected_clusters);
+
+  g_hash_table_unref(clusters);
+  g_hash_table_unref(expected_clusters);
+  for (guint i = 0; i < logmessages->num_of_logs; ++i)
+    log_msg_unref((LogMessage *) g_ptr_array_index(logmessages->logmessages, i));
+  g_ptr_array_free(logmessages->logmessages, TRUE);
+  g_free(logmessages);
+  g_string_free(logs, TRUE);
+}
@@ -497,6 +497,16 @@ ParameterizedTestParameters(dbparser, test_radix_search_matches)
       .key = "192.168.1. huhuhu",
       .expected_pattern = {NULL}
     },
+    {
+      .node_to_insert = {"@IPv4:ipv4@", NULL},
+      .key = "192.168.1.256 huhuhu",
+      .expected_pattern = {NULL}
+    },
+    {
+      .node_to_insert = {"@IPv4:ipv4@", NULL},
+      .key = "192.168.1.2560000000000 huhuhu",
+      .expected_pattern = {NULL}
+    },
     {
       .node_to_insert = {"@IPv4:ipv4@", NULL},
       .key = "v12345",
@@ -724,6 +734,11 @@ ParameterizedTestParameters(dbparser, test_radix_search_matches)
       .key = "v12345",
       .expected_pattern = {NULL}
     },
+    {
+      .node_to_insert = {"@NUMBER:number@", NULL},
+      .key = "-1234567890123456789012345678901234 hihihi",
+      .expected_pattern = {"number", "-1234567890123456789012345678901234", NULL}
+    },
     /* test_qstring_matches */
     {
       .node_to_insert = {"@QSTRING:qstring:'@", NULL},
@@ -856,12 +871,22 @@ ParameterizedTestParameters(dbparser, test_radix_search_matches)
       .key = "zzz árvíztűrőtükörfúrógép",
       .expected_pattern = {"test", "árvíztűrőtükörfúró", NULL},
     },
+    {
+      .node_to_insert = {"ddd @ESTRING:estring:-->@", NULL},
+      .key = "ddd a-b--c-->d",
+      .expected_pattern = {"estring", "a-b--c", NULL},
+    },
     /* test_string_matches */
     {
       .node_to_insert = {"@STRING:string@", NULL},
       .key = "string hehehe",
       .expected_pattern = {"string", "string", NULL},
     },
+    {
+      .node_to_insert = {"@STRING:string:._@", NULL},
+      .key = "str_ing.123 hehehe",
+      .expected_pattern = {"string", "str_ing.123", NULL},
+    },
     /* test_float_matches */
     {
       .node_to_insert = {"@FLOAT:float@", NULL},
@@ -1077,6 +1102,62 @@ ParameterizedTest(RadixTestParam *param, dbparser, test_radix_search_matches, .i
     insert_node(root, param->node_to_insert[i]);
 
   test_search_matches(root, param->key, param->expected_pattern);
+
+  root = r_freeze_tree(root);
+  test_search_matches(root, param->key, param->expected_pattern);
+  r_free_node(root, NULL);
+}
+
+Test(dbparser, test_parser_results_are_reused_while_backtracking, .init = test_setup, .fini = test_teardown)
+{
+  RNode *root = r_new_node("", NULL);
+  RFindNodeStats stats;
+
+  insert_node(root, "a@ESTRING:x: @b");
+  insert_node(root, "a@ESTRING:y: @c");
+
+  RNode *ret = r_find_node_with_stats(root, "afoo c", 6, NULL, &stats);
+  cr_assert(ret);
+  cr_assert_str_eq(ret->value, "a@ESTRING:y: @c");
+  cr_assert_eq(stats.parser_invocations, 1);
+  cr_assert_eq(stats.parser_memo_hits, 1);
+
+  const gchar *expected_pattern[] = { "y", "foo", NULL };
+  test_search_matches(root, "afoo c", expected_pattern);
+
+  r_free_node(root, NULL);
+}
+
+Test(dbparser, test_frozen_tree, .init = test_setup, .fini = test_teardown)
+{
+  RNode *root = r_new_node("", NULL);
+  const gchar *literals[] =
+  {
+    "alma", "almafa", "almabor", "korte", "barack", "dinnye", "eper", "fuge",
+    "gesztenye", "hagyma", "ize", "jazmin", "ko", "koros", "korom", "\xe1rpa",
+  };
+
+  for (gint i = 0; i < G_N_ELEMENTS(literals); i++)
+    insert_node(root, literals[i]);
+  insert_node(root, "num@NUMBER:number@ end");
+  insert_node(root, "num@STRING:word@ end");
+
+  root = r_freeze_tree(root);
+  cr_assert(root->frozen);
+  cr_assert(root->child_index, "dense node is expected to have a direct child index");
+
+  for (gint i = 0; i < G_N_ELEMENTS(literals); i++)
+    test_search(root, literals[i], TRUE);
+  test_search_value(root, "almak", "alma");
+  test_search_value(root, "korosabb", "koros");
+  test_search(root, "lo", FALSE);
+  test_search(root, "zab", FALSE);
+  test_search_value(root, "num123 end", "num@NUMBER:number@ end");
+  test_search_value(root, "numabc end", "num@STRING:word@ end");
+
+  const gchar *expected_pattern[] = { "number", "42", NULL };
+  test_search_matches(root, "num42 end", expected_pattern);
+
   r_free_node(root, NULL);
 }
 
@@ -136,3 +136,27 @@ Test(dbparser, test_timer_wheel_current_time)
 {
   test_wheel(time(NULL));
 }
+
+Test(dbparser, test_timer_wheel_expiry_budget)
+{
+  TimerWheel *wheel = timer_wheel_new();
+  guint64 expires = 5;
+
+  num_callbacks = 0;
+  prev_now = 0;
+  for (gint i = 0; i < 10; i++)
+    timer_wheel_add_timer(wheel, 5, timer_callback, g_memdup(&expires, sizeof(expires)), (GDestroyNotify) g_free);
+
+  cr_assert_not(timer_wheel_set_time_with_budget(wheel, 100, 4, NULL));
+  cr_assert_eq(num_callbacks, 4);
+  cr_assert_lt(timer_wheel_get_time(wheel), 100);
+
+  cr_assert_not(timer_wheel_set_time_with_budget(wheel, 100, 4, NULL));
+  cr_assert_eq(num_callbacks, 8);
+
+  cr_assert(timer_wheel_set_time_with_budget(wheel, 100, 4, NULL));
+  cr_assert_eq(num_callbacks, 10);
+  cr_assert_eq(timer_wheel_get_time(wheel), 100);
+
+  timer_wheel_free(wheel);
+}
@@ -292,13 +292,20 @@ timer_wheel_cascade(TimerWheel *self)
 
 /*
  * Main time adjustment function
+ *
+ * At most max_expirations timers are expired in a single call (0 means
+ * unlimited), when the budget is exhausted the wheel stops in the middle
+ * of the current slot and returns FALSE.  The next call continues from
+ * there, so a large time jump can be processed in smaller steps.
  */
-void
-timer_wheel_set_time(TimerWheel *self, guint64 new_now, gpointer caller_context)
+gboolean
+timer_wheel_set_time_with_budget(TimerWheel *self, guint64 new_now, gint max_expirations, gpointer caller_context)
 {
+  gint num_expired = 0;
+
   /* time is not allowed to go backwards */
   if (self->now >= new_now)
-    return;
+    return TRUE;
 
   if (self->num_timers == 0)
     {
@@ -307,7 +314,7 @@ timer_wheel_set_time(TimerWheel *self, guint64 new_now, gpointer caller_context)
 
       self->now = new_now;
       self->base = new_now & ~self->levels[0]->mask;
-      return;
+      return TRUE;
     }
 
   for (; self->now < new_now; self->now++)
@@ -322,12 +329,16 @@ timer_wheel_set_time(TimerWheel *self, guint64 new_now, gpointer caller_context)
       head = &self->levels[0]->slots[slot];
       iv_list_for_each_safe(lh, lh_next, head)
       {
+        if (max_expirations > 0 && num_expired >= max_expirations)
+          return FALSE;
+
         entry = iv_list_entry(lh, TWEntry, list);
 
         tw_entry_unlink(entry);
         entry->callback(self, self->now, entry->user_data, caller_context);
         tw_entry_free(entry);
         self->num_timers--;
+        num_expired++;
       }
 
       if (self->num_timers == 0)
@@ -340,6 +351,13 @@ timer_wheel_set_time(TimerWheel *self, guint64 new_now, gpointer caller_context)
       if (slot == level->num - 1)
         timer_wheel_cascade(self);
     }
+  return TRUE;
+}
+
+void
+timer_wheel_set_time(TimerWheel *self, guint64 new_now, gpointer caller_context)
+{
+  timer_wheel_set_time_with_budget(self, new_now, 0, caller_context);
 }
 
 guint64
@@ -37,6 +37,8 @@ void timer_wheel_mod_timer(TimerWheel *self, TWEntry *entry, gint new_timeout);
 guint64 timer_wheel_get_timer_expiration(TimerWheel *self, TWEntry *entry);
 
 void timer_wheel_set_time(TimerWheel *self, guint64 new_now, gpointer caller_context);
+gboolean timer_wheel_set_time_with_budget(TimerWheel *self, guint64 new_now, gint max_expirations,
+                                          gpointer caller_context);
 guint64 timer_wheel_get_time(TimerWheel *self);
 void timer_wheel_expire_all(TimerWheel *self, gpointer caller_context);
 void timer_wheel_set_associated_data(TimerWheel *self, gpointer assoc_data, GDestroyNotify assoc_data_free);
@@ -30,17 +30,73 @@
 #include "compat/openssl_support.h"
 #include <openssl/evp.h>
 
+/*
+ * $(uuid [opts])
+ *
+ * Returns a random UUID.
+ *
+ * Options:
+ *      --version N, -v N   UUID version to generate, 4 (random, the default) or 7 (time-ordered)
+ */
+typedef struct _TFUuidState
+{
+  TFSimpleFuncState super;
+  gint version;
+} TFUuidState;
+
+static gboolean
+tf_uuid_prepare(LogTemplateFunction *self, gpointer s, LogTemplate *parent, gint argc, gchar *argv[], GError **error)
+{
+  TFUuidState *state = (TFUuidState *) s;
+  GOptionContext *ctx;
+  gint version = 4;
+  GOptionEntry uuid_options[] =
+  {
+    { "version", 'v', 0, G_OPTION_ARG_INT, &version, NULL, NULL },
+    { NULL }
+  };
+
+  ctx = g_option_context_new("uuid");
+  g_option_context_add_main_entries(ctx, uuid_options, NULL);
+
+  if (!g_option_context_parse(ctx, &argc, &argv, error))
+    {
+      g_option_context_free(ctx);
+      return FALSE;
+    }
+  g_option_context_free(ctx);
+
+  if (version != 4 && version != 7)
+    {
+      g_set_error(error, LOG_TEMPLATE_ERROR, LOG_TEMPLATE_ERROR_COMPILE,
+                  "$(uuid) parsing failed, unsupported UUID version, use 4 or 7");
+      return FALSE;
+    }
+
+  if (!tf_simple_func_prepare(self, state, parent, argc, argv, error))
+    return FALSE;
+
+  state->version = version;
+  return TRUE;
+}
+
 static void
-tf_uuid(LogMessage *msg, gint argc, GString *argv[], GString *result, LogMessageValueType *type)
+tf_uuid_call(LogTemplateFunction *self, gpointer s, const LogTemplateInvokeArgs *args, GString *result,
+             LogMessageValueType *type)
 {
-  char uuid_str[37];
+  TFUuidState *state = (TFUuidState *) s;
+  gchar uuid_str[37];
 
   *type = LM_VT_STRING;
-  uuid_gen_random(uuid_str, sizeof(uuid_str));
-  g_string_append (result, uuid_str);
+  if (state->version == 7)
+    uuid_gen_v7(uuid_str, sizeof(uuid_str));
+  else
+    uuid_gen_random(uuid_str, sizeof(uuid_str));
+  g_string_append(result, uuid_str);
 }
 
-TEMPLATE_FUNCTION_SIMPLE(tf_uuid);
+TEMPLATE_FUNCTION(TFUuidState, tf_uuid, tf_uuid_prepare, tf_simple_func_eval, tf_uuid_call, tf_simple_func_free_state,
+                  NULL);
 
 /*
  * $($hash_method [opts] $arg1 $arg2 $arg3...)
@@ -70,3 +70,40 @@ Test(cryptofuncs, test_hash)
   assert_template_format("$(sha1 \"foo bar\")", "3773dea65156909838fa6c22825cafe090ff8030");
   assert_template_format("$(md5 $(sha1 foo) bar)", "196894290a831b2d2755c8de22619a97");
 }
+
+static void
+_format_uuid(const gchar *template_str, gchar *uuid, gsize uuid_len)
+{
+  LogTemplate *template = compile_template(template_str);
+  LogMessage *msg = create_empty_message();
+  GString *result = g_string_new("");
+
+  log_template_format(template, msg, &DEFAULT_TEMPLATE_EVAL_OPTIONS, result);
+  cr_assert_eq(result->len, 36, "unexpected UUID: %s", result->str);
+  g_strlcpy(uuid, result->str, uuid_len);
+
+  g_string_free(result, TRUE);
+  log_msg_unref(msg);
+  log_template_unref(template);
+}
+
+Test(cryptofuncs, test_uuid)
+{
+  gchar uuid[37], prev[37];
+
+  _format_uuid("$(uuid)", uuid, sizeof(uuid));
+  cr_assert_eq(uuid[14], '4');
+
+  _format_uuid("$(uuid --version 7)", prev, sizeof(prev));
+  cr_assert_eq(prev[14], '7');
+  cr_assert(strchr("89ab", prev[19]));
+
+  for (gint i = 0; i < 10000; i++)
+    {
+      _format_uuid("$(uuid -v 7)", uuid, sizeof(uuid));
+      cr_assert(strcmp(prev, uuid) < 0, "UUIDv7 values are not monotonic: %s, %s", prev, uuid);
+      strcpy(prev, uuid);
+    }
+
+  assert_template_failure("$(uuid --version 5)", "$(uuid) parsing failed, unsupported UUID version, use 4 or 7");
+}
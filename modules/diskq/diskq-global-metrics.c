@@ -50,6 +50,10 @@ typedef struct DiskQGlobalMetrics_
 
   GHashTable *dirs;
   gint freq;
+
+  /* bytes read back from disk-buffer files, sampled by the timer */
+  gssize replayed_bytes;
+  gssize last_replayed_bytes;
 } DiskQGlobalMetrics;
 
 static DiskQGlobalMetrics diskq_global_metrics;
@@ -313,6 +317,46 @@ _update_dir_metrics(gpointer key, gpointer value, gpointer user_data)
   stats_unlock();
 }
 
+static void
+_init_replay_sc_key(StatsClusterKey *replay_throughput_sc_key)
+{
+  stats_cluster_single_key_set(replay_throughput_sc_key, "disk_queue_replay_bytes_per_second", NULL, 0);
+}
+
+static void
+_update_replay_metrics(DiskQGlobalMetrics *self)
+{
+  gssize replayed_bytes = g_atomic_pointer_add(&self->replayed_bytes, 0);
+  gssize throughput = (replayed_bytes - self->last_replayed_bytes) / self->freq;
+  self->last_replayed_bytes = replayed_bytes;
+
+  StatsClusterKey replay_throughput_sc_key;
+  _init_replay_sc_key(&replay_throughput_sc_key);
+
+  stats_lock();
+  {
+    StatsCounterItem *counter;
+    StatsCluster *cluster = stats_register_dynamic_counter(STATS_LEVEL1, &replay_throughput_sc_key,
+                                                           SC_TYPE_SINGLE_VALUE, &counter);
+    stats_counter_set(counter, throughput);
+    stats_unregister_dynamic_counter(cluster, SC_TYPE_SINGLE_VALUE, &counter);
+  }
+  stats_unlock();
+}
+
+static void
+_unset_replay_metrics(void)
+{
+  StatsClusterKey replay_throughput_sc_key;
+  _init_replay_sc_key(&replay_throughput_sc_key);
+
+  stats_lock();
+  {
+    stats_remove_cluster(&replay_throughput_sc_key);
+  }
+  stats_unlock();
+}
+
 static void
 _update_all_dir_metrics(gpointer s)
 {
@@ -324,6 +368,7 @@ _update_all_dir_metrics(gpointer s)
   }
   g_mutex_unlock(&self->lock);
 
+  _update_replay_metrics(self);
   _dir_watch_timer_start(self);
 }
 
@@ -391,6 +436,7 @@ _init(gint type, gpointer c)
   if (self->freq == 0)
     return;
 
+  self->last_replayed_bytes = g_atomic_pointer_add(&self->replayed_bytes, 0);
   _update_all_dir_metrics(self);
 }
 
@@ -407,6 +453,8 @@ _deinit(gint type, gpointer c)
     g_hash_table_remove_all(self->dirs);
   }
   g_mutex_unlock(&self->lock);
+
+  _unset_replay_metrics();
 }
 
 static void
@@ -458,6 +506,12 @@ diskq_global_metrics_file_acquired(const gchar *abs_filename)
   g_free(dir);
 }
 
+void
+diskq_global_metrics_replayed_bytes_add(gsize bytes)
+{
+  g_atomic_pointer_add(&diskq_global_metrics.replayed_bytes, bytes);
+}
+
 void
 diskq_global_metrics_file_released(const gchar *abs_filename)
 {
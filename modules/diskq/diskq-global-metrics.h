@@ -28,5 +28,6 @@
 void diskq_global_metrics_init(void);
 void diskq_global_metrics_file_acquired(const gchar *abs_filename);
 void diskq_global_metrics_file_released(const gchar *abs_filename);
+void diskq_global_metrics_replayed_bytes_add(gsize bytes);
 
 #endif /* DISKQ_GLOBAL_METRICS_H_ */
@@ -58,6 +58,24 @@ disk_queue_options_compaction_set(DiskQueueOptions *self, gboolean compaction)
   self->compaction = compaction;
 }
 
+void
+disk_queue_options_compact_encoding_set(DiskQueueOptions *self, gboolean compact_encoding)
+{
+  self->compact_encoding = compact_encoding;
+}
+
+void
+disk_queue_options_compression_set(DiskQueueOptions *self, gboolean compression)
+{
+  self->compression = compression;
+}
+
+void
+disk_queue_options_mmap_replay_set(DiskQueueOptions *self, gboolean mmap_replay)
+{
+  self->mmap_replay = mmap_replay;
+}
+
 void
 disk_queue_options_flow_control_window_bytes_set(DiskQueueOptions *self, gint flow_control_window_bytes)
 {
@@ -82,15 +100,78 @@ disk_queue_options_set_prealloc(DiskQueueOptions *self, gboolean prealloc)
   self->prealloc = prealloc;
 }
 
+void
+disk_queue_options_fsync_interval_set(DiskQueueOptions *self, gint fsync_interval)
+{
+  self->fsync_interval = fsync_interval;
+}
+
+void
+disk_queue_options_fsync_bytes_set(DiskQueueOptions *self, gint fsync_bytes)
+{
+  self->fsync_bytes = fsync_bytes;
+}
+
+void
+disk_queue_options_prefetch_bytes_set(DiskQueueOptions *self, gint64 prefetch_bytes)
+{
+  self->prefetch_bytes = prefetch_bytes;
+}
+
+void
+disk_queue_options_segment_size_set(DiskQueueOptions *self, gint64 segment_size)
+{
+  if (segment_size > 0 && segment_size < MIN_SEGMENT_SIZE)
+    {
+      msg_warning("WARNING: The configured disk buffer segment size is smaller than the minimum allowed",
+                  evt_tag_long("configured_segment_size", segment_size),
+                  evt_tag_long("minimum_allowed_segment_size", MIN_SEGMENT_SIZE),
+                  evt_tag_long("new_segment_size", MIN_SEGMENT_SIZE));
+      segment_size = MIN_SEGMENT_SIZE;
+    }
+  self->segment_size = segment_size;
+}
+
+static void
+_check_segmented_settings(DiskQueueOptions *self)
+{
+  if (self->compression || self->mmap_replay || self->prealloc > 0 || self->prefetch_bytes > 0 ||
+      self->fsync_interval > 0 || self->fsync_bytes > 0)
+    {
+      msg_warning("WARNING: compression(), mmap-replay(), prealloc(), prefetch-bytes(), fsync-interval() and "
+                  "fsync-bytes() parameters were ignored as they are not supported by segmented disk-buffers");
+      self->compression = FALSE;
+      self->mmap_replay = FALSE;
+      self->prefetch_bytes = 0;
+      self->fsync_interval = 0;
+      self->fsync_bytes = 0;
+    }
+  if (self->flow_control_window_bytes > 0 || self->flow_control_window_size > 0 || self->front_cache_size > 0)
+    {
+      msg_warning("WARNING: flow-control-window-bytes(), flow-control-window-size() and front-cache-size() "
+                  "parameters were ignored as segmented disk-buffers keep every message on disk");
+    }
+}
+
 void
 disk_queue_options_check_plugin_settings(DiskQueueOptions *self)
 {
+  if (self->segment_size > 0)
+    {
+      _check_segmented_settings(self);
+      return;
+    }
+
   if (self->reliable)
     {
       if (self->flow_control_window_size > 0)
         {
           msg_warning("WARNING: flow-control-window-size/mem-buf-length parameter was ignored as it is not compatible with reliable queue. Did you mean flow-control-window-bytes?");
         }
+      if (self->fsync_bytes > 0 && self->fsync_interval <= 0)
+        {
+          msg_warning("WARNING: fsync-bytes() parameter was ignored as group commit is only enabled by fsync-interval()");
+        }
     }
   else
     {
@@ -98,7 +179,25 @@ disk_queue_options_check_plugin_settings(DiskQueueOptions *self)
         {
           msg_warning("WARNING: flow-control-window-bytes/mem-buf-size parameter was ignored as it is not compatible with non-reliable queue. Did you mean flow-control-window-size?");
         }
+      if (self->fsync_interval > 0 || self->fsync_bytes > 0)
+        {
+          msg_warning("WARNING: fsync-interval() and fsync-bytes() parameters were ignored as they are only supported by reliable queues");
+        }
+    }
+
+  if (self->prefetch_bytes > 0 && self->read_only)
+    {
+      msg_warning("WARNING: prefetch-bytes() parameter was ignored as it is not supported by read-only queues");
+      self->prefetch_bytes = 0;
+    }
+
+#ifndef SYSLOG_NG_HAVE_ZLIB
+  if (self->compression)
+    {
+      msg_warning("WARNING: compression() parameter was ignored as syslog-ng was compiled without zlib support");
+      self->compression = FALSE;
     }
+#endif
 }
 
 gchar *
@@ -134,6 +233,10 @@ disk_queue_options_set_default_options(DiskQueueOptions *self)
   self->dir = g_strdup(get_installation_path_for(SYSLOG_NG_PATH_LOCALSTATEDIR));
   self->truncate_size_ratio = -1;
   self->prealloc = -1;
+  self->fsync_interval = 0;
+  self->fsync_bytes = 0;
+  self->prefetch_bytes = 0;
+  self->segment_size = 0;
 }
 
 void
@@ -28,6 +28,7 @@
 #include "logmsg/logmsg-serialize.h"
 
 #define MIN_CAPACITY_BYTES 1024*1024
+#define MIN_SEGMENT_SIZE 64*1024
 
 typedef struct _DiskQueueOptions
 {
@@ -36,23 +37,37 @@ typedef struct _DiskQueueOptions
   gboolean read_only;
   gboolean reliable;
   gboolean compaction;
+  gboolean compact_encoding;
+  gboolean compression;
+  gboolean mmap_replay;
   gint flow_control_window_bytes;
   gint flow_control_window_size;
   gchar *dir;
   gdouble truncate_size_ratio;
   gboolean prealloc;
+  gint fsync_interval;
+  gint fsync_bytes;
+  gint64 prefetch_bytes;
+  gint64 segment_size;
 } DiskQueueOptions;
 
 void disk_queue_options_front_cache_size_set(DiskQueueOptions *self, gint front_cache_size);
 void disk_queue_options_capacity_bytes_set(DiskQueueOptions *self, gint64 capacity_bytes);
 void disk_queue_options_reliable_set(DiskQueueOptions *self, gboolean reliable);
 void disk_queue_options_compaction_set(DiskQueueOptions *self, gboolean compaction);
+void disk_queue_options_compact_encoding_set(DiskQueueOptions *self, gboolean compact_encoding);
+void disk_queue_options_compression_set(DiskQueueOptions *self, gboolean compression);
+void disk_queue_options_mmap_replay_set(DiskQueueOptions *self, gboolean mmap_replay);
 void disk_queue_options_flow_control_window_bytes_set(DiskQueueOptions *self, gint flow_control_window_bytes);
 void disk_queue_options_flow_control_window_size_set(DiskQueueOptions *self, gint flow_control_window_size);
 void disk_queue_options_check_plugin_settings(DiskQueueOptions *self);
 void disk_queue_options_set_dir(DiskQueueOptions *self, const gchar *dir);
 void disk_queue_options_set_truncate_size_ratio(DiskQueueOptions *self, gdouble truncate_size_ratio);
 void disk_queue_options_set_prealloc(DiskQueueOptions *self, gboolean prealloc);
+void disk_queue_options_fsync_interval_set(DiskQueueOptions *self, gint fsync_interval);
+void disk_queue_options_fsync_bytes_set(DiskQueueOptions *self, gint fsync_bytes);
+void disk_queue_options_prefetch_bytes_set(DiskQueueOptions *self, gint64 prefetch_bytes);
+void disk_queue_options_segment_size_set(DiskQueueOptions *self, gint64 segment_size);
 void disk_queue_options_set_default_options(DiskQueueOptions *self);
 void disk_queue_options_destroy(DiskQueueOptions *self);
 
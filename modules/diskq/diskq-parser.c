@@ -37,6 +37,9 @@ static CfgLexerKeyword diskq_keywords[] =
   { "capacity_bytes",    KW_CAPACITY_BYTES },
   { "reliable",          KW_RELIABLE },
   { "compaction",        KW_COMPACTION },
+  { "compact_encoding",  KW_COMPACT_ENCODING },
+  { "compression",       KW_COMPRESSION },
+  { "mmap_replay",       KW_MMAP_REPLAY },
   { "mem_buf_size",              KW_FLOW_CONTROL_WINDOW_BYTES },
   { "flow_control_window_bytes", KW_FLOW_CONTROL_WINDOW_BYTES },
   { "qout_size",         KW_FRONT_CACHE_SIZE },
@@ -44,6 +47,10 @@ static CfgLexerKeyword diskq_keywords[] =
   { "dir",               KW_DIR },
   { "truncate_size_ratio", KW_TRUNCATE_SIZE_RATIO },
   { "prealloc",          KW_PREALLOC },
+  { "fsync_interval",    KW_FSYNC_INTERVAL },
+  { "fsync_bytes",       KW_FSYNC_BYTES },
+  { "prefetch_bytes",    KW_PREFETCH_BYTES },
+  { "segment_size",      KW_SEGMENT_SIZE },
   { "stats",             KW_STATS },
   { "freq",              KW_FREQ },
   { NULL }
@@ -32,6 +32,7 @@
 #include "logqueue-disk.h"
 #include "logqueue-disk-reliable.h"
 #include "logqueue-disk-non-reliable.h"
+#include "logqueue-disk-segmented.h"
 #include "persist-state.h"
 
 #define DISKQ_PLUGIN_NAME "diskq"
@@ -52,10 +53,20 @@ log_queue_disk_is_file_in_directory(const gchar *file, const gchar *directory)
   return result;
 }
 
+static inline gboolean
+_is_segmented(DiskQDestPlugin *self)
+{
+  return self->options.segment_size > 0;
+}
+
 static LogQueue *
 _create_disk_queue(DiskQDestPlugin *self, const gchar *filename, const gchar *persist_name, gint stats_level,
                    StatsClusterKeyBuilder *driver_sck_builder, StatsClusterKeyBuilder *queue_sck_builder)
 {
+  if (_is_segmented(self))
+    return log_queue_disk_segmented_new(&self->options, filename, persist_name, stats_level, driver_sck_builder,
+                                        queue_sck_builder);
+
   if (self->options.reliable)
     return log_queue_disk_reliable_new(&self->options, filename, persist_name, stats_level, driver_sck_builder,
                                        queue_sck_builder);
@@ -64,6 +75,57 @@ _create_disk_queue(DiskQDestPlugin *self, const gchar *filename, const gchar *pe
                                          queue_sck_builder);
 }
 
+static gchar *
+_get_next_filename(DiskQDestPlugin *self)
+{
+  if (_is_segmented(self))
+    return qdisk_get_next_segmented_dirname(self->options.dir);
+
+  return qdisk_get_next_filename(self->options.dir, self->options.reliable);
+}
+
+static gboolean
+_start_queue(LogQueue *queue)
+{
+  if (log_queue_has_type(queue, log_queue_disk_segmented_type))
+    return log_queue_disk_segmented_start(queue);
+
+  return log_queue_disk_start(queue);
+}
+
+static void
+_stop_queue(LogQueue *queue)
+{
+  if (log_queue_has_type(queue, log_queue_disk_segmented_type))
+    {
+      log_queue_disk_segmented_stop(queue);
+      return;
+    }
+
+  gboolean persistent;
+  log_queue_disk_stop(queue, &persistent);
+  diskq_global_metrics_file_released(log_queue_disk_get_filename(queue));
+}
+
+static const gchar *
+_get_queue_filename(LogQueue *queue)
+{
+  if (log_queue_has_type(queue, log_queue_disk_segmented_type))
+    return log_queue_disk_segmented_get_dirname(queue);
+
+  return log_queue_disk_get_filename(queue);
+}
+
+/* a segmented disk-buffer is a directory, the others are single files */
+static gboolean
+_has_layout_changed(DiskQDestPlugin *self, const gchar *qfile_name)
+{
+  if (_is_segmented(self))
+    return g_file_test(qfile_name, G_FILE_TEST_IS_REGULAR);
+
+  return g_file_test(qfile_name, G_FILE_TEST_IS_DIR);
+}
+
 static void
 _warn_if_dir_changed(const gchar *qfile_name, const gchar *dir)
 {
@@ -84,25 +146,33 @@ _create_and_start_disk_queue_with_filename_from_persist(DiskQDestPlugin *self, c
   if (!persist_qfile_name)
     return FALSE;
 
+  if (_has_layout_changed(self, persist_qfile_name))
+    {
+      msg_warning("The disk buffer layout (segment-size()) has changed in the configuration, "
+                  "the messages of the old disk buffer are not moved to the new one",
+                  evt_tag_str("qfile", persist_qfile_name));
+      return NULL;
+    }
+
   _warn_if_dir_changed(persist_qfile_name, self->options.dir);
 
   LogQueue *queue = _create_disk_queue(self, persist_qfile_name, persist_name, stats_level, driver_sck_builder,
                                        queue_sck_builder);
-  if (log_queue_disk_start(queue))
+  if (_start_queue(queue))
     return queue;
 
   log_queue_unref(queue);
 
-  gchar *new_qfile_name = qdisk_get_next_filename(self->options.dir, self->options.reliable);
+  gchar *new_qfile_name = _get_next_filename(self);
   if (!new_qfile_name)
     return NULL;
 
   queue = _create_disk_queue(self, persist_qfile_name, persist_name, stats_level, driver_sck_builder, queue_sck_builder);
-  if (log_queue_disk_start(queue))
+  if (_start_queue(queue))
     {
       msg_error("Error opening disk-queue file, a new one started",
                 evt_tag_str("old_filename", persist_qfile_name),
-                evt_tag_str("new_filename", log_queue_disk_get_filename(queue)));
+                evt_tag_str("new_filename", _get_queue_filename(queue)));
       g_free(new_qfile_name);
       return queue;
     }
@@ -125,7 +195,7 @@ _create_and_start_disk_queue_with_new_filename(DiskQDestPlugin *self, const gcha
 
   LogQueue *queue = _create_disk_queue(self, new_qfile_name, persist_name, stats_level, driver_sck_builder,
                                        queue_sck_builder);
-  if (log_queue_disk_start(queue))
+  if (_start_queue(queue))
     return queue;
 
   msg_error("Error initializing log queue");
@@ -152,7 +222,7 @@ _acquire_queue(LogDestDriver *dd, const gchar *persist_name, gint stats_level,
   if (queue)
     goto exit;
 
-  new_qfile_name = qdisk_get_next_filename(self->options.dir, self->options.reliable);
+  new_qfile_name = _get_next_filename(self);
   queue = _create_and_start_disk_queue_with_new_filename(self, new_qfile_name, persist_name, stats_level,
                                                          driver_sck_builder, queue_sck_builder);
 
@@ -161,8 +231,9 @@ exit:
     {
       log_queue_set_throttle(queue, dd->throttle);
 
-      const gchar *qfile_name = log_queue_disk_get_filename(queue);
-      diskq_global_metrics_file_acquired(qfile_name);
+      const gchar *qfile_name = _get_queue_filename(queue);
+      if (!_is_segmented(self))
+        diskq_global_metrics_file_acquired(qfile_name);
       if (persist_name && qfile_name)
         persist_state_alloc_string(cfg->state, persist_name, qfile_name, -1);
     }
@@ -177,10 +248,8 @@ void
 _release_queue(LogDestDriver *dd, LogQueue *queue)
 {
   GlobalConfig *cfg = log_pipe_get_config(&dd->super.super);
-  gboolean persistent;
 
-  log_queue_disk_stop(queue, &persistent);
-  diskq_global_metrics_file_released(log_queue_disk_get_filename(queue));
+  _stop_queue(queue);
 
   if (queue->persist_name)
     {
@@ -279,6 +348,27 @@ _set_truncate_size_ratio_and_prealloc(DiskQDestPlugin *self, LogDestDriver *dd)
   g_assert_not_reached();
 }
 
+static gboolean
+_check_segmented_options(DiskQDestPlugin *self, LogDestDriver *dd)
+{
+  if (self->options.capacity_bytes <= 0)
+    {
+      msg_error("capacity-bytes() must be set for segmented disk buffers",
+                log_pipe_location_tag(&dd->super.super));
+      return FALSE;
+    }
+
+  if (self->options.segment_size > self->options.capacity_bytes)
+    {
+      msg_warning("The value of 'segment-size()' is larger than 'capacity-bytes()', setting it to 'capacity-bytes()'",
+                  evt_tag_long("capacity_bytes", self->options.capacity_bytes),
+                  log_pipe_location_tag(&dd->super.super));
+      self->options.segment_size = self->options.capacity_bytes;
+    }
+
+  return TRUE;
+}
+
 static gboolean
 _attach(LogDriverPlugin *s, LogDriver *d)
 {
@@ -301,7 +391,12 @@ _attach(LogDriverPlugin *s, LogDriver *d)
   if (self->options.front_cache_size < 0)
     self->options.front_cache_size = 1000;
 
-  if (!_set_truncate_size_ratio_and_prealloc(self, dd))
+  if (_is_segmented(self))
+    {
+      if (!_check_segmented_options(self, dd))
+        return FALSE;
+    }
+  else if (!_set_truncate_size_ratio_and_prealloc(self, dd))
     return FALSE;
 
   dd->acquire_queue = _acquire_queue;
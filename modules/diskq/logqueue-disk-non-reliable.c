@@ -82,10 +82,12 @@ _get_length(LogQueue *s)
          + _get_message_number_in_queue(self->flow_control_window);
 }
 
+/* once the global memory budget is exhausted, messages spill to disk instead of front_cache */
 static inline gboolean
 _can_push_to_front_cache(LogQueueDiskNonReliable *self)
 {
-  return HAS_SPACE_IN_QUEUE(self->front_cache) && qdisk_get_length(self->super.qdisk) == 0;
+  return HAS_SPACE_IN_QUEUE(self->front_cache) && qdisk_get_length(self->super.qdisk) == 0
+         && !log_queue_is_global_memory_budget_exhausted();
 }
 
 static inline gboolean
@@ -177,6 +179,54 @@ _move_messages_from_disk_to_front_cache(LogQueueDiskNonReliable *self)
   return TRUE;
 }
 
+/* lock must be held */
+static inline gboolean
+_can_prefetch(LogQueueDiskNonReliable *self)
+{
+  QDisk *qdisk = self->super.qdisk;
+
+  return !qdisk_is_read_only(qdisk) && qdisk_get_length(qdisk) > 0 && HAS_SPACE_IN_QUEUE(self->front_cache);
+}
+
+/*
+ * front_cache only holds messages older than the ones on the disk, so the
+ * prefetcher can append the head of the disk to it.  The head is read
+ * without the lock, and only popped if the consumer has not taken it
+ * meanwhile.
+ *
+ * lock must be held, it is released while reading
+ */
+static gboolean
+_prefetch_message(LogQueueDisk *s)
+{
+  LogQueueDiskNonReliable *self = (LogQueueDiskNonReliable *) s;
+
+  if (!_can_prefetch(self))
+    return FALSE;
+
+  QDiskReadPoint point;
+  LogMessage *msg = log_queue_disk_read_message_unlocked(s, qdisk_get_next_head_position(s->qdisk), &point);
+
+  /* errors are left to the consumer, which reads the same record from the head */
+  if (!msg)
+    return FALSE;
+
+  if (!_can_prefetch(self) || !qdisk_pop_prepared_head(s->qdisk, &point))
+    {
+      log_msg_unref(msg);
+      return TRUE;
+    }
+
+  LogPathOptions path_options = LOG_PATH_OPTIONS_INIT;
+  path_options.ack_needed = FALSE;
+  g_queue_push_tail(self->front_cache, msg);
+  g_queue_push_tail(self->front_cache, LOG_PATH_OPTIONS_TO_POINTER(&path_options));
+  log_queue_memory_usage_add(&s->super, log_msg_get_size(msg));
+  log_queue_disk_update_disk_related_counters(s);
+
+  return TRUE;
+}
+
 static inline gboolean
 _maybe_move_messages_among_queue_segments(LogQueueDiskNonReliable *self)
 {
@@ -185,7 +235,7 @@ _maybe_move_messages_among_queue_segments(LogQueueDiskNonReliable *self)
   if (qdisk_is_read_only(self->super.qdisk))
     return TRUE;
 
-  if (self->front_cache->length == 0 && self->front_cache_size > 0)
+  if (self->front_cache->length == 0 && self->front_cache_size > 0 && !log_queue_is_global_memory_budget_exhausted())
     ret = _move_messages_from_disk_to_front_cache(self);
 
   if (self->flow_control_window->length > 0)
@@ -302,14 +352,11 @@ success:
   return msg;
 }
 
+/* lock must be held, stats_update is set to FALSE if the queued counter must not be updated */
 static LogMessage *
-_pop_head(LogQueue *s, LogPathOptions *path_options)
+_pop_head_unlocked(LogQueueDiskNonReliable *self, LogPathOptions *path_options, gboolean *stats_update)
 {
-  LogQueueDiskNonReliable *self = (LogQueueDiskNonReliable *)s;
   LogMessage *msg = NULL;
-  gboolean stats_update = TRUE;
-
-  g_mutex_lock(&s->lock);
 
   if (self->front_cache->length > 0)
     {
@@ -326,15 +373,27 @@ _pop_head(LogQueue *s, LogPathOptions *path_options)
     msg = _pop_head_flow_control_window(self, path_options);
 
   if (!msg)
-    {
-      g_mutex_unlock(&s->lock);
-      return NULL;
-    }
+    return NULL;
 
 success:
-  if (!_maybe_move_messages_among_queue_segments(self))
+  *stats_update = _maybe_move_messages_among_queue_segments(self);
+  log_queue_disk_wakeup_prefetcher(&self->super);
+  return msg;
+}
+
+static LogMessage *
+_pop_head(LogQueue *s, LogPathOptions *path_options)
+{
+  LogQueueDiskNonReliable *self = (LogQueueDiskNonReliable *)s;
+  gboolean stats_update = TRUE;
+
+  g_mutex_lock(&s->lock);
+
+  LogMessage *msg = _pop_head_unlocked(self, path_options, &stats_update);
+  if (!msg)
     {
-      stats_update = FALSE;
+      g_mutex_unlock(&s->lock);
+      return NULL;
     }
 
   log_queue_disk_update_disk_related_counters(&self->super);
@@ -348,6 +407,45 @@ success:
   return msg;
 }
 
+static gint
+_pop_head_batch(LogQueue *s, LogMessage **msgs, LogPathOptions *path_options, gint max_msgs)
+{
+  LogQueueDiskNonReliable *self = (LogQueueDiskNonReliable *)s;
+  gint num_msgs = 0;
+  gint num_stats_updates = 0;
+
+  g_mutex_lock(&s->lock);
+
+  while (num_msgs < max_msgs)
+    {
+      gboolean stats_update = TRUE;
+      LogMessage *msg = _pop_head_unlocked(self, &path_options[num_msgs], &stats_update);
+
+      if (!msg)
+        break;
+
+      msgs[num_msgs++] = msg;
+      if (stats_update)
+        num_stats_updates++;
+    }
+
+  if (num_msgs == 0)
+    {
+      g_mutex_unlock(&s->lock);
+      return 0;
+    }
+
+  log_queue_disk_update_disk_related_counters(&self->super);
+  g_mutex_unlock(&s->lock);
+
+  for (gint i = 0; i < num_msgs; i++)
+    _push_tail_backlog(self, msgs[i], &path_options[i]);
+
+  log_queue_queued_messages_sub(s, num_stats_updates);
+
+  return num_msgs;
+}
+
 /* _is_msg_serialization_needed_hint() must be called without holding the queue's lock.
  * This can only be used _as a hint_ for performance considerations, because as soon as the lock
  * is released, there will be no guarantee that the result of this function remain correct. */
@@ -424,35 +522,33 @@ _push_tail_disk(LogQueueDiskNonReliable *self, LogMessage *msg, const LogPathOpt
   return result;
 }
 
-static void
-_push_tail(LogQueue *s, LogMessage *msg, const LogPathOptions *path_options)
+static gboolean
+_serialize_msg(LogQueueDiskNonReliable *self, LogMessage *msg, const LogPathOptions *path_options,
+               GString *serialized_msg)
 {
-  LogQueueDiskNonReliable *self = (LogQueueDiskNonReliable *)s;
-
-  ScratchBuffersMarker marker;
-  GString *serialized_msg = NULL;
-
-  if (_is_msg_serialization_needed_hint(self))
+  if (!log_queue_disk_serialize_msg(&self->super, msg, serialized_msg))
     {
-      serialized_msg = scratch_buffers_alloc_and_mark(&marker);
-      if (!log_queue_disk_serialize_msg(&self->super, msg, serialized_msg))
-        {
-          msg_error("Failed to serialize message for non-reliable disk-buffer, dropping message",
-                    evt_tag_str("filename", qdisk_get_filename(self->super.qdisk)),
-                    evt_tag_str("persist_name", s->persist_name));
-          log_queue_disk_drop_message(&self->super, msg, path_options);
-          scratch_buffers_reclaim_marked(marker);
-          return;
-        }
+      msg_error("Failed to serialize message for non-reliable disk-buffer, dropping message",
+                evt_tag_str("filename", qdisk_get_filename(self->super.qdisk)),
+                evt_tag_str("persist_name", self->super.super.persist_name));
+      log_queue_disk_drop_message(&self->super, msg, path_options);
+      return FALSE;
     }
+  return TRUE;
+}
 
-  g_mutex_lock(&s->lock);
+/* lock must be held, returns TRUE if the message got queued */
+static gboolean
+_push_tail_unlocked(LogQueueDiskNonReliable *self, LogMessage *msg, const LogPathOptions *path_options,
+                    GString *serialized_msg)
+{
+  LogQueue *s = &self->super.super;
 
   /* we push messages into queue segments in the following order: flow_control_window, disk, front_cache */
   if (_can_push_to_front_cache(self))
     {
       _push_tail_front_cache(self, msg, path_options);
-      goto queued;
+      return TRUE;
     }
 
   if (self->flow_control_window->length != 0 || !_push_tail_disk(self, msg, path_options, serialized_msg))
@@ -460,7 +556,7 @@ _push_tail(LogQueue *s, LogMessage *msg, const LogPathOptions *path_options)
       if (HAS_SPACE_IN_QUEUE(self->flow_control_window))
         {
           _push_tail_flow_control_window(self, msg, path_options);
-          goto queued;
+          return TRUE;
         }
 
       msg_debug("Destination queue full, dropping message",
@@ -470,11 +566,37 @@ _push_tail(LogQueue *s, LogMessage *msg, const LogPathOptions *path_options)
                 evt_tag_long("capacity_bytes", qdisk_get_maximum_size(self->super.qdisk)),
                 evt_tag_str("persist_name", s->persist_name));
       log_queue_disk_drop_message(&self->super, msg, path_options);
-      goto exit;
+      return FALSE;
     }
 
-queued:
+  return TRUE;
+}
+
+static void
+_push_tail(LogQueue *s, LogMessage *msg, const LogPathOptions *path_options)
+{
+  LogQueueDiskNonReliable *self = (LogQueueDiskNonReliable *)s;
+
+  ScratchBuffersMarker marker;
+  GString *serialized_msg = NULL;
+
+  if (_is_msg_serialization_needed_hint(self))
+    {
+      serialized_msg = scratch_buffers_alloc_and_mark(&marker);
+      if (!_serialize_msg(self, msg, path_options, serialized_msg))
+        {
+          scratch_buffers_reclaim_marked(marker);
+          return;
+        }
+    }
+
+  g_mutex_lock(&s->lock);
+
+  if (!_push_tail_unlocked(self, msg, path_options, serialized_msg))
+    goto exit;
+
   log_queue_queued_messages_inc(s);
+  log_queue_disk_wakeup_prefetcher(&self->super);
 
   /* this releases the queue's lock for a short time, which may violate the
    * consistency of the disk-buffer, so it must be the last call under lock in this function
@@ -487,6 +609,59 @@ exit:
     scratch_buffers_reclaim_marked(marker);
 }
 
+/*
+ * The lock is taken, the counters are updated and the output thread is
+ * notified once per batch.  If the hint says that the messages are going
+ * to be written to disk, they are serialized before taking the lock.
+ */
+static void
+_push_tail_batch(LogQueue *s, LogMessage **msgs, const LogPathOptions *path_options, gint num_msgs)
+{
+  LogQueueDiskNonReliable *self = (LogQueueDiskNonReliable *)s;
+  GString **serialized_msgs = NULL;
+  gint num_queued = 0;
+
+  ScratchBuffersMarker marker;
+  scratch_buffers_mark(&marker);
+
+  if (_is_msg_serialization_needed_hint(self))
+    {
+      serialized_msgs = g_newa(GString *, num_msgs);
+      for (gint i = 0; i < num_msgs; i++)
+        {
+          serialized_msgs[i] = scratch_buffers_alloc();
+          if (!_serialize_msg(self, msgs[i], &path_options[i], serialized_msgs[i]))
+            serialized_msgs[i] = NULL;
+        }
+    }
+
+  g_mutex_lock(&s->lock);
+
+  for (gint i = 0; i < num_msgs; i++)
+    {
+      /* failed to serialize, already dropped */
+      if (serialized_msgs && !serialized_msgs[i])
+        continue;
+
+      if (_push_tail_unlocked(self, msgs[i], &path_options[i], serialized_msgs ? serialized_msgs[i] : NULL))
+        num_queued++;
+    }
+
+  if (num_queued > 0)
+    {
+      log_queue_queued_messages_add(s, num_queued);
+      log_queue_disk_wakeup_prefetcher(&self->super);
+
+      /* this releases the queue's lock for a short time, which may violate the
+       * consistency of the disk-buffer, so it must be the last call under lock in this function
+       */
+      log_queue_push_notify(s);
+    }
+
+  g_mutex_unlock(&s->lock);
+  scratch_buffers_reclaim_marked(marker);
+}
+
 static void
 _empty_queue(LogQueueDiskNonReliable *self, GQueue *q)
 {
@@ -569,8 +744,10 @@ _set_logqueue_virtual_functions(LogQueue *s)
   s->rewind_backlog = _rewind_backlog;
   s->rewind_backlog_all = _rewind_backlog_all;
   s->pop_head = _pop_head;
+  s->pop_head_batch = _pop_head_batch;
   s->peek_head = _peek_head;
   s->push_tail = _push_tail;
+  s->push_tail_batch = _push_tail_batch;
   s->free_fn = _free;
 }
 
@@ -580,6 +757,7 @@ _set_logqueue_disk_virtual_functions(LogQueueDisk *s)
   s->start = _start;
   s->stop = _stop;
   s->stop_corrupted = _stop_corrupted;
+  s->prefetch_message = _prefetch_message;
 }
 
 static inline void
@@ -62,10 +62,181 @@ _peek_memory_queue_head_position(GQueue *queue)
   return *position;
 }
 
+static inline gboolean
+_is_group_commit_enabled(LogQueueDiskReliable *self)
+{
+  return self->sync.interval > 0;
+}
+
+/* lock must be held */
+static void
+_ack_synced_messages(LogQueueDiskReliable *self, GQueue *synced)
+{
+  LogQueue *s = &self->super.super;
+
+  while (!g_queue_is_empty(synced))
+    {
+      gint64 position;
+      LogMessage *msg;
+      LogPathOptions path_options = LOG_PATH_OPTIONS_INIT;
+      _pop_from_memory_queue_head(synced, &position, &msg, &path_options);
+
+      log_queue_memory_usage_sub(s, log_msg_get_size(msg));
+      log_msg_ack(msg, &path_options, AT_PROCESSED);
+      log_msg_unref(msg);
+    }
+}
+
+/*
+ * Messages are acked even if syncing fails: they are already written to
+ * the file, and holding back their acks would stop the source forever.
+ *
+ * lock must be held
+ */
+static void
+_sync_and_ack_unsynced_messages(LogQueueDiskReliable *self)
+{
+  if (g_queue_is_empty(self->unsynced))
+    return;
+
+  qdisk_sync(self->super.qdisk);
+
+  _ack_synced_messages(self, self->unsynced);
+  self->sync.pending_bytes = 0;
+}
+
+/*
+ * Same as above, but the file is synced without holding the lock, so
+ * pushes and pops are not blocked by the I/O.  Only the messages written
+ * before the sync started are acked; the ones pushed meanwhile are left
+ * for the next round.
+ *
+ * lock must be held, it is released while syncing
+ */
+static void
+_sync_and_ack_unsynced_messages_unlocked(LogQueueDiskReliable *self)
+{
+  LogQueue *s = &self->super.super;
+  QDisk *qdisk = self->super.qdisk;
+
+  if (g_queue_is_empty(self->unsynced))
+    return;
+
+  GQueue synced = *self->unsynced;
+  g_queue_init(self->unsynced);
+  gint synced_bytes = self->sync.pending_bytes;
+
+  QDiskSyncPoint sync_point;
+  gboolean started = qdisk_started(qdisk);
+  if (started)
+    qdisk_prepare_sync(qdisk, &sync_point);
+
+  g_mutex_unlock(&s->lock);
+  gboolean data_synced = started && qdisk_sync_data(qdisk, &sync_point);
+  g_mutex_lock(&s->lock);
+
+  if (data_synced && qdisk_write_checkpoint(qdisk, &sync_point))
+    {
+      g_mutex_unlock(&s->lock);
+      gboolean checkpoint_synced = qdisk_sync_checkpoint(qdisk, &sync_point);
+      g_mutex_lock(&s->lock);
+
+      if (checkpoint_synced)
+        qdisk_commit_checkpoint(qdisk, &sync_point);
+    }
+
+  _ack_synced_messages(self, &synced);
+  self->sync.pending_bytes = MAX(0, self->sync.pending_bytes - synced_bytes);
+}
+
+static inline gboolean
+_is_sync_bytes_reached(LogQueueDiskReliable *self)
+{
+  return self->sync.bytes > 0 && self->sync.pending_bytes >= self->sync.bytes;
+}
+
+static gpointer
+_sync_thread(gpointer user_data)
+{
+  LogQueueDiskReliable *self = (LogQueueDiskReliable *) user_data;
+  LogQueue *s = &self->super.super;
+
+  g_mutex_lock(&s->lock);
+  while (!self->sync.exit)
+    {
+      gint64 deadline = g_get_monotonic_time() + self->sync.interval * G_TIME_SPAN_MILLISECOND;
+
+      while (!self->sync.exit && !_is_sync_bytes_reached(self))
+        {
+          if (!g_cond_wait_until(&self->sync.cond, &s->lock, deadline))
+            break;
+        }
+
+      _sync_and_ack_unsynced_messages_unlocked(self);
+    }
+  g_mutex_unlock(&s->lock);
+
+  return NULL;
+}
+
+static void
+_start_sync_thread(LogQueueDiskReliable *self)
+{
+  if (!_is_group_commit_enabled(self) || self->sync.thread)
+    return;
+
+  self->sync.exit = FALSE;
+  self->sync.thread = g_thread_new("diskq-sync", _sync_thread, self);
+}
+
+static void
+_stop_sync_thread(LogQueueDiskReliable *self)
+{
+  LogQueue *s = &self->super.super;
+
+  if (!self->sync.thread)
+    return;
+
+  g_mutex_lock(&s->lock);
+  self->sync.exit = TRUE;
+  g_cond_signal(&self->sync.cond);
+  g_mutex_unlock(&s->lock);
+
+  g_thread_join(self->sync.thread);
+  self->sync.thread = NULL;
+}
+
+/* lock must be held */
+static void
+_ack_when_synced(LogQueueDiskReliable *self, gint64 position, LogMessage *msg, const LogPathOptions *path_options,
+                 gsize record_length)
+{
+  LogQueue *s = &self->super.super;
+
+  if (!_is_group_commit_enabled(self))
+    {
+      log_msg_ack(msg, path_options, AT_PROCESSED);
+      return;
+    }
+
+  _push_to_memory_queue_tail(self->unsynced, position, log_msg_ref(msg), path_options);
+  log_queue_memory_usage_add(s, log_msg_get_size(msg));
+
+  self->sync.pending_bytes += record_length;
+  if (_is_sync_bytes_reached(self))
+    g_cond_signal(&self->sync.cond);
+}
+
 static gboolean
 _start(LogQueueDisk *s)
 {
-  return qdisk_start(s->qdisk, NULL, NULL, NULL);
+  LogQueueDiskReliable *self = (LogQueueDiskReliable *) s;
+
+  if (!qdisk_start(s->qdisk, NULL, NULL, NULL))
+    return FALSE;
+
+  _start_sync_thread(self);
+  return TRUE;
 }
 
 static gboolean
@@ -92,6 +263,75 @@ _empty_queue(LogQueueDiskReliable *self, GQueue *queue)
     }
 }
 
+static gint64
+_get_prefetch_end_position(GQueue *queue)
+{
+  if (queue->length == 0)
+    return -1;
+
+  return _peek_memory_queue_head_position(queue);
+}
+
+/* lock must be held */
+static gboolean
+_is_prefetch_position_reached(LogQueueDiskReliable *self, gint64 position)
+{
+  return position == _get_prefetch_end_position(self->front_cache)
+         || position == _get_prefetch_end_position(self->flow_control_window);
+}
+
+/* lock must be held */
+static gint64
+_get_next_prefetch_position(LogQueueDiskReliable *self)
+{
+  if (self->prefetched->length == 0)
+    return qdisk_get_next_head_position(self->super.qdisk);
+
+  return self->prefetch_position;
+}
+
+/*
+ * The prefetcher reads the records following the read head, until it
+ * reaches the ones already kept in front_cache or flow_control_window.
+ * The record is read without the lock, and only kept if the consumer has
+ * not moved past it and the queue was not rewound meanwhile.
+ *
+ * lock must be held, it is released while reading
+ */
+static gboolean
+_prefetch_message(LogQueueDisk *s)
+{
+  LogQueueDiskReliable *self = (LogQueueDiskReliable *) s;
+
+  gint64 position = _get_next_prefetch_position(self);
+  if (_is_prefetch_position_reached(self, position))
+    return FALSE;
+
+  QDiskReadPoint point;
+  LogMessage *msg = log_queue_disk_read_message_unlocked(s, position, &point);
+
+  /* errors are left to the consumer, which reads the same record from the head */
+  if (!msg)
+    return FALSE;
+
+  gint64 next_position;
+  if (!qdisk_finish_read(s->qdisk, &point, &next_position)
+      || _get_next_prefetch_position(self) != point.position
+      || _is_prefetch_position_reached(self, point.position))
+    {
+      log_msg_unref(msg);
+      return TRUE;
+    }
+
+  LogPathOptions path_options = LOG_PATH_OPTIONS_INIT;
+  path_options.ack_needed = FALSE;
+  _push_to_memory_queue_tail(self->prefetched, point.position, msg, &path_options);
+  log_queue_memory_usage_add(&s->super, log_msg_get_size(msg));
+  self->prefetch_position = next_position;
+
+  return TRUE;
+}
+
 static gint64
 _get_length(LogQueue *s)
 {
@@ -199,6 +439,10 @@ _rewind_backlog(LogQueue *s, guint rewind_count)
 
   log_queue_queued_messages_add(s, rewind_count);
 
+  /* the read head moved back, the prefetcher starts over from there */
+  _empty_queue(self, self->prefetched);
+  log_queue_disk_wakeup_prefetcher(&self->super);
+
   g_mutex_unlock(&s->lock);
 }
 
@@ -226,6 +470,23 @@ _is_next_message_in_front_cache(LogQueueDiskReliable *self)
   return _peek_memory_queue_head_position(self->front_cache) == qdisk_get_next_head_position(self->super.qdisk);
 }
 
+/*
+ * Prefetched messages are only valid while they follow the read head,
+ * anything else left there is dropped.
+ */
+static inline gboolean
+_is_next_message_prefetched(LogQueueDiskReliable *self)
+{
+  if (self->prefetched->length == 0)
+    return FALSE;
+
+  if (_peek_memory_queue_head_position(self->prefetched) == qdisk_get_next_head_position(self->super.qdisk))
+    return TRUE;
+
+  _empty_queue(self, self->prefetched);
+  return FALSE;
+}
+
 static LogMessage *
 _peek_head(LogQueue *s)
 {
@@ -246,6 +507,12 @@ _peek_head(LogQueue *s)
       goto exit;
     }
 
+  if (_is_next_message_prefetched(self))
+    {
+      msg = g_queue_peek_nth(self->prefetched, 1);
+      goto exit;
+    }
+
   msg = log_queue_disk_peek_message(&self->super);
 
 exit:
@@ -253,14 +520,12 @@ exit:
   return msg;
 }
 
+/* lock must be held */
 static LogMessage *
-_pop_head(LogQueue *s, LogPathOptions *path_options)
+_pop_head_unlocked(LogQueueDiskReliable *self, LogPathOptions *path_options, gboolean *qdisk_corrupt)
 {
-  LogQueueDiskReliable *self = (LogQueueDiskReliable *)s;
+  LogQueue *s = &self->super.super;
   LogMessage *msg = NULL;
-  gboolean qdisk_corrupt = FALSE;
-
-  g_mutex_lock(&s->lock);
 
   if (_is_next_message_in_flow_control_window(self))
     {
@@ -269,14 +534,14 @@ _pop_head(LogQueue *s, LogPathOptions *path_options)
       log_queue_memory_usage_sub(s, log_msg_get_size(msg));
 
       if (!_skip_message(&self->super))
-        qdisk_corrupt = TRUE;
+        *qdisk_corrupt = TRUE;
 
       /* push to backlog */
       log_msg_ref(msg);
       _push_to_memory_queue_tail(self->backlog, position, msg, path_options);
       log_queue_memory_usage_add(s, log_msg_get_size(msg));
 
-      goto exit;
+      return msg;
     }
 
   if (_is_next_message_in_front_cache(self))
@@ -289,14 +554,35 @@ _pop_head(LogQueue *s, LogPathOptions *path_options)
       log_queue_memory_usage_sub(s, log_msg_get_size(msg));
 
       if (!_skip_message(&self->super))
-        qdisk_corrupt = TRUE;
+        *qdisk_corrupt = TRUE;
 
-      goto exit;
+      return msg;
     }
 
-  msg = log_queue_disk_read_message(&self->super, path_options);
+  if (_is_next_message_prefetched(self))
+    {
+      gint64 position;
+      _pop_from_memory_queue_head(self->prefetched, &position, &msg, path_options);
+      log_queue_memory_usage_sub(s, log_msg_get_size(msg));
 
-exit:
+      if (!_skip_message(&self->super))
+        *qdisk_corrupt = TRUE;
+
+      return msg;
+    }
+
+  return log_queue_disk_read_message(&self->super, path_options);
+}
+
+static LogMessage *
+_pop_head(LogQueue *s, LogPathOptions *path_options)
+{
+  LogQueueDiskReliable *self = (LogQueueDiskReliable *)s;
+  gboolean qdisk_corrupt = FALSE;
+
+  g_mutex_lock(&s->lock);
+
+  LogMessage *msg = _pop_head_unlocked(self, path_options, &qdisk_corrupt);
   if (!msg)
     {
       g_mutex_unlock(&s->lock);
@@ -305,6 +591,7 @@ exit:
 
   log_queue_disk_update_disk_related_counters(&self->super);
   log_queue_queued_messages_dec(s);
+  log_queue_disk_wakeup_prefetcher(&self->super);
 
   if (qdisk_corrupt)
     log_queue_disk_restart_corrupted(&self->super);
@@ -313,6 +600,41 @@ exit:
   return msg;
 }
 
+static gint
+_pop_head_batch(LogQueue *s, LogMessage **msgs, LogPathOptions *path_options, gint max_msgs)
+{
+  LogQueueDiskReliable *self = (LogQueueDiskReliable *)s;
+  gboolean qdisk_corrupt = FALSE;
+  gint num_msgs = 0;
+
+  g_mutex_lock(&s->lock);
+
+  /* the queue is restarted if it turns out to be corrupted, stop there */
+  while (num_msgs < max_msgs && !qdisk_corrupt)
+    {
+      LogMessage *msg = _pop_head_unlocked(self, &path_options[num_msgs], &qdisk_corrupt);
+      if (!msg)
+        break;
+      msgs[num_msgs++] = msg;
+    }
+
+  if (num_msgs == 0)
+    {
+      g_mutex_unlock(&s->lock);
+      return 0;
+    }
+
+  log_queue_disk_update_disk_related_counters(&self->super);
+  log_queue_queued_messages_sub(s, num_msgs);
+  log_queue_disk_wakeup_prefetcher(&self->super);
+
+  if (qdisk_corrupt)
+    log_queue_disk_restart_corrupted(&self->super);
+
+  g_mutex_unlock(&s->lock);
+  return num_msgs;
+}
+
 static inline gboolean
 _is_reserved_buffer_size_reached(LogQueueDiskReliable *self)
 {
@@ -322,28 +644,34 @@ _is_reserved_buffer_size_reached(LogQueueDiskReliable *self)
 static inline gboolean
 _is_space_available_in_front_cache(LogQueueDiskReliable *self)
 {
+  if (log_queue_is_global_memory_budget_exhausted())
+    return FALSE;
+
   gint num_of_messages_in_front_cache = g_queue_get_length(self->front_cache) / ENTRIES_PER_MSG_IN_MEM_Q;
   return num_of_messages_in_front_cache < self->front_cache_size;
 }
 
-static void
-_push_tail(LogQueue *s, LogMessage *msg, const LogPathOptions *path_options)
+static gboolean
+_serialize_msg(LogQueueDiskReliable *self, LogMessage *msg, const LogPathOptions *path_options,
+               GString *serialized_msg)
 {
-  LogQueueDiskReliable *self = (LogQueueDiskReliable *)s;
-
-  ScratchBuffersMarker marker;
-  GString *serialized_msg = scratch_buffers_alloc_and_mark(&marker);
   if (!log_queue_disk_serialize_msg(&self->super, msg, serialized_msg))
     {
       msg_error("Failed to serialize message for reliable disk-buffer, dropping message",
                 evt_tag_str("filename", qdisk_get_filename(self->super.qdisk)),
-                evt_tag_str("persist_name", s->persist_name));
+                evt_tag_str("persist_name", self->super.super.persist_name));
       log_queue_disk_drop_message(&self->super, msg, path_options);
-      scratch_buffers_reclaim_marked(marker);
-      return;
+      return FALSE;
     }
+  return TRUE;
+}
 
-  g_mutex_lock(&s->lock);
+/* lock must be held, returns TRUE if the message got queued */
+static gboolean
+_push_tail_unlocked(LogQueueDiskReliable *self, LogMessage *msg, const LogPathOptions *path_options,
+                    GString *serialized_msg)
+{
+  LogQueue *s = &self->super.super;
 
   gint64 message_position = qdisk_get_next_tail_position(self->super.qdisk);
   if (!qdisk_push_tail(self->super.qdisk, serialized_msg))
@@ -365,15 +693,11 @@ _push_tail(LogQueue *s, LogMessage *msg, const LogPathOptions *path_options)
                 suggestion);
 
       log_queue_disk_drop_message(&self->super, msg, path_options);
-      scratch_buffers_reclaim_marked(marker);
-      g_mutex_unlock(&s->lock);
-      return;
+      return FALSE;
     }
 
   log_queue_disk_update_disk_related_counters(&self->super);
 
-  scratch_buffers_reclaim_marked(marker);
-
   if (_is_reserved_buffer_size_reached(self))
     {
       /*
@@ -381,10 +705,10 @@ _push_tail(LogQueue *s, LogMessage *msg, const LogPathOptions *path_options)
        */
       _push_to_memory_queue_tail(self->flow_control_window, message_position, msg, path_options);
       log_queue_memory_usage_add(s, log_msg_get_size(msg));
-      goto exit;
+      return TRUE;
     }
 
-  log_msg_ack(msg, path_options, AT_PROCESSED);
+  _ack_when_synced(self, message_position, msg, path_options, serialized_msg->len);
 
   if (_is_space_available_in_front_cache(self))
     {
@@ -396,13 +720,86 @@ _push_tail(LogQueue *s, LogMessage *msg, const LogPathOptions *path_options)
       local_options.ack_needed = FALSE;
       _push_to_memory_queue_tail(self->front_cache, message_position, msg, &local_options);
       log_queue_memory_usage_add(s, log_msg_get_size(msg));
-      goto exit;
+      return TRUE;
     }
 
   log_msg_unref(msg);
+  return TRUE;
+}
+
+static void
+_push_tail(LogQueue *s, LogMessage *msg, const LogPathOptions *path_options)
+{
+  LogQueueDiskReliable *self = (LogQueueDiskReliable *)s;
+
+  ScratchBuffersMarker marker;
+  GString *serialized_msg = scratch_buffers_alloc_and_mark(&marker);
+  if (!_serialize_msg(self, msg, path_options, serialized_msg))
+    {
+      scratch_buffers_reclaim_marked(marker);
+      return;
+    }
+
+  g_mutex_lock(&s->lock);
+
+  gboolean queued = _push_tail_unlocked(self, msg, path_options, serialized_msg);
+  scratch_buffers_reclaim_marked(marker);
+
+  if (!queued)
+    {
+      g_mutex_unlock(&s->lock);
+      return;
+    }
 
-exit:
   log_queue_queued_messages_inc(s);
+  log_queue_disk_wakeup_prefetcher(&self->super);
+
+  /* this releases the queue's lock for a short time, which may violate the
+   * consistency of the disk-buffer, so it must be the last call under lock in this function
+   */
+  log_queue_push_notify(s);
+  g_mutex_unlock(&s->lock);
+}
+
+/*
+ * The messages are serialized before taking the lock, then all of them are
+ * written under a single lock, the counters are updated and the output
+ * thread is notified once per batch.
+ */
+static void
+_push_tail_batch(LogQueue *s, LogMessage **msgs, const LogPathOptions *path_options, gint num_msgs)
+{
+  LogQueueDiskReliable *self = (LogQueueDiskReliable *)s;
+  GString **serialized_msgs = g_newa(GString *, num_msgs);
+  gint num_queued = 0;
+
+  ScratchBuffersMarker marker;
+  scratch_buffers_mark(&marker);
+
+  for (gint i = 0; i < num_msgs; i++)
+    {
+      serialized_msgs[i] = scratch_buffers_alloc();
+      if (!_serialize_msg(self, msgs[i], &path_options[i], serialized_msgs[i]))
+        serialized_msgs[i] = NULL;
+    }
+
+  g_mutex_lock(&s->lock);
+
+  for (gint i = 0; i < num_msgs; i++)
+    {
+      if (serialized_msgs[i] && _push_tail_unlocked(self, msgs[i], &path_options[i], serialized_msgs[i]))
+        num_queued++;
+    }
+  scratch_buffers_reclaim_marked(marker);
+
+  if (num_queued == 0)
+    {
+      g_mutex_unlock(&s->lock);
+      return;
+    }
+
+  log_queue_queued_messages_add(s, num_queued);
+  log_queue_disk_wakeup_prefetcher(&self->super);
 
   /* this releases the queue's lock for a short time, which may violate the
    * consistency of the disk-buffer, so it must be the last call under lock in this function
@@ -416,6 +813,7 @@ _free(LogQueue *s)
 {
   LogQueueDiskReliable *self = (LogQueueDiskReliable *)s;
 
+  _stop_sync_thread(self);
 
   if (self->flow_control_window)
     {
@@ -438,29 +836,61 @@ _free(LogQueue *s)
       self->front_cache = NULL;
     }
 
+  if (self->prefetched)
+    {
+      g_assert(g_queue_is_empty(self->prefetched));
+      g_queue_free(self->prefetched);
+      self->prefetched = NULL;
+    }
+
+  if (self->unsynced)
+    {
+      g_assert(g_queue_is_empty(self->unsynced));
+      g_queue_free(self->unsynced);
+      self->unsynced = NULL;
+    }
+
+  g_cond_clear(&self->sync.cond);
+
   log_queue_disk_free_method(&self->super);
 }
 
 static gboolean
-_stop(LogQueueDisk *s, gboolean *persistent)
+_stop_qdisk(LogQueueDiskReliable *self)
 {
-  LogQueueDiskReliable *self = (LogQueueDiskReliable *) s;
+  _sync_and_ack_unsynced_messages(self);
 
-  gboolean result = FALSE;
-
-  if (qdisk_stop(s->qdisk, NULL, NULL, NULL))
-    {
-      *persistent = TRUE;
-      result = TRUE;
-    }
+  gboolean result = qdisk_stop(self->super.qdisk, NULL, NULL, NULL);
 
   _empty_queue(self, self->flow_control_window);
   _empty_queue(self, self->front_cache);
+  _empty_queue(self, self->prefetched);
   _empty_queue(self, self->backlog);
 
   return result;
 }
 
+static gboolean
+_stop(LogQueueDisk *s, gboolean *persistent)
+{
+  LogQueueDiskReliable *self = (LogQueueDiskReliable *) s;
+
+  _stop_sync_thread(self);
+
+  if (!_stop_qdisk(self))
+    return FALSE;
+
+  *persistent = TRUE;
+  return TRUE;
+}
+
+/* called with the lock held, the sync thread keeps running for the new file */
+static gboolean
+_stop_corrupted(LogQueueDisk *s)
+{
+  return _stop_qdisk((LogQueueDiskReliable *) s);
+}
+
 static inline void
 _set_logqueue_virtual_functions(LogQueue *s)
 {
@@ -469,8 +899,10 @@ _set_logqueue_virtual_functions(LogQueue *s)
   s->rewind_backlog = _rewind_backlog;
   s->rewind_backlog_all = _rewind_backlog_all;
   s->pop_head = _pop_head;
+  s->pop_head_batch = _pop_head_batch;
   s->peek_head = _peek_head;
   s->push_tail = _push_tail;
+  s->push_tail_batch = _push_tail_batch;
   s->free_fn = _free;
 }
 
@@ -479,6 +911,8 @@ _set_logqueue_disk_virtual_functions(LogQueueDisk *s)
 {
   s->start = _start;
   s->stop = _stop;
+  s->stop_corrupted = _stop_corrupted;
+  s->prefetch_message = _prefetch_message;
 }
 
 static inline void
@@ -505,6 +939,11 @@ log_queue_disk_reliable_new(DiskQueueOptions *options, const gchar *filename, co
   self->backlog = g_queue_new();
   self->front_cache = g_queue_new();
   self->front_cache_size = options->front_cache_size;
+  self->prefetched = g_queue_new();
+  self->unsynced = g_queue_new();
+  g_cond_init(&self->sync.cond);
+  self->sync.interval = options->fsync_interval;
+  self->sync.bytes = options->fsync_bytes;
   _set_virtual_functions(self);
   return &self->super.super;
 }
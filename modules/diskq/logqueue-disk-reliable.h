@@ -33,6 +33,22 @@ typedef struct _LogQueueDiskReliable
   GQueue *backlog;
   GQueue *front_cache;
   gint front_cache_size;
+
+  /* messages read ahead from the head of the disk by the prefetcher */
+  GQueue *prefetched;
+  gint64 prefetch_position;
+
+  /* group commit: written messages are acked once a sync covers them */
+  GQueue *unsynced;
+  struct
+  {
+    GThread *thread;
+    GCond cond;
+    gboolean exit;
+    gint interval;
+    gint bytes;
+    gint pending_bytes;
+  } sync;
 } LogQueueDiskReliable;
 
 LogQueue *log_queue_disk_reliable_new(DiskQueueOptions *options, const gchar *filename, const gchar *persist_name,
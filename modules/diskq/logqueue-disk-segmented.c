@@ -0,0 +1,495 @@
+/*
+ * Copyright (c) 2024 One Identity LLC.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#include "logqueue-disk-segmented.h"
+#include "logmsg/logmsg-serialize.h"
+#include "diskq-global-metrics.h"
+#include "messages.h"
+#include "scratch-buffers.h"
+#include "stats/stats-registry.h"
+
+#define B_TO_KiB(x) ((x) / 1024)
+
+/* the number of records read from the segments without holding the lock */
+#define MAX_READ_BATCH 64
+
+QueueType log_queue_disk_segmented_type = "DISK-SEGMENTED";
+
+static void
+_update_disk_related_counters(LogQueueDiskSegmented *self)
+{
+  gint64 used_space = qdisk_segmented_get_used_space(self->qdisk);
+
+  /* segments are not preallocated, the allocated and the used space is the same */
+  stats_counter_set(self->metrics.disk_usage, B_TO_KiB(used_space));
+  stats_counter_set(self->metrics.disk_allocated, B_TO_KiB(used_space));
+}
+
+static gboolean
+_serialize_msg(SerializeArchive *sa, gpointer user_data)
+{
+  LogQueueDiskSegmented *self = ((gpointer *) user_data)[0];
+  LogMessage *msg = ((gpointer *) user_data)[1];
+
+  guint32 flags = 0;
+
+  if (self->compaction)
+    flags |= LMSF_COMPACTION;
+
+  if (self->compact_encoding)
+    flags |= LMSF_COMPACT_ENCODING;
+
+  return log_msg_serialize(msg, sa, flags);
+}
+
+static gboolean
+_serialize(LogQueueDiskSegmented *self, LogMessage *msg, GString *serialized)
+{
+  gpointer user_data[] = { self, msg };
+  GError *error = NULL;
+
+  if (!qdisk_serialize(serialized, _serialize_msg, user_data, &error))
+    {
+      msg_error("Error serializing message for the disk-queue segment",
+                evt_tag_str("error", error->message),
+                evt_tag_str("persist-name", self->super.persist_name));
+      g_error_free(error);
+      return FALSE;
+    }
+
+  return TRUE;
+}
+
+static gboolean
+_deserialize_msg(SerializeArchive *sa, gpointer user_data)
+{
+  LogMessage *msg = user_data;
+
+  return log_msg_deserialize(msg, sa);
+}
+
+static LogMessage *
+_deserialize(LogQueueDiskSegmented *self, GString *serialized)
+{
+  LogMessage *msg = log_msg_new_empty();
+  GError *error = NULL;
+
+  if (!qdisk_deserialize_buffer(serialized->str, serialized->len, _deserialize_msg, msg, &error))
+    {
+      msg_error("Error deserializing message from the disk-queue segment",
+                evt_tag_str("error", error->message),
+                evt_tag_str("persist-name", self->super.persist_name));
+      log_msg_unref(msg);
+      g_error_free(error);
+      return NULL;
+    }
+
+  return msg;
+}
+
+static void
+_drop_message(LogQueueDiskSegmented *self, LogMessage *msg, const LogPathOptions *path_options)
+{
+  log_queue_dropped_messages_inc(&self->super);
+
+  if (path_options->flow_control_requested)
+    log_msg_drop(msg, path_options, AT_SUSPENDED);
+  else
+    log_msg_drop(msg, path_options, AT_PROCESSED);
+}
+
+/* lock must be held */
+static void
+_drop_peeked(LogQueueDiskSegmented *self)
+{
+  if (!self->peeked)
+    return;
+
+  log_msg_unref(self->peeked);
+  self->peeked = NULL;
+}
+
+static gint64
+_get_length(LogQueue *s)
+{
+  LogQueueDiskSegmented *self = (LogQueueDiskSegmented *) s;
+
+  if (!qdisk_segmented_started(self->qdisk))
+    return 0;
+
+  return qdisk_segmented_get_length(self->qdisk);
+}
+
+static gboolean
+_push_tail_unlocked(LogQueueDiskSegmented *self, LogMessage *msg, const LogPathOptions *path_options,
+                    GString *serialized_msg)
+{
+  LogQueue *s = &self->super;
+
+  if (!qdisk_segmented_started(self->qdisk) || !qdisk_segmented_push_tail(self->qdisk, serialized_msg))
+    {
+      msg_error("Destination segmented queue full, dropping message",
+                evt_tag_str("dirname", qdisk_segmented_get_dirname(self->qdisk)),
+                evt_tag_long("queue_len", log_queue_get_length(s)),
+                evt_tag_long("capacity_bytes", qdisk_segmented_get_max_useful_space(self->qdisk)),
+                evt_tag_str("persist_name", s->persist_name));
+
+      _drop_message(self, msg, path_options);
+      return FALSE;
+    }
+
+  _update_disk_related_counters(self);
+
+  log_msg_ack(msg, path_options, AT_PROCESSED);
+  log_msg_unref(msg);
+  return TRUE;
+}
+
+static void
+_push_tail(LogQueue *s, LogMessage *msg, const LogPathOptions *path_options)
+{
+  LogQueueDiskSegmented *self = (LogQueueDiskSegmented *) s;
+
+  ScratchBuffersMarker marker;
+  GString *serialized_msg = scratch_buffers_alloc_and_mark(&marker);
+  if (!_serialize(self, msg, serialized_msg))
+    {
+      _drop_message(self, msg, path_options);
+      scratch_buffers_reclaim_marked(marker);
+      return;
+    }
+
+  g_mutex_lock(&s->lock);
+
+  gboolean queued = _push_tail_unlocked(self, msg, path_options, serialized_msg);
+  scratch_buffers_reclaim_marked(marker);
+
+  if (!queued)
+    {
+      g_mutex_unlock(&s->lock);
+      return;
+    }
+
+  log_queue_queued_messages_inc(s);
+
+  /* this releases the queue's lock for a short time, which may violate the
+   * consistency of the disk-buffer, so it must be the last call under lock in this function
+   */
+  log_queue_push_notify(s);
+  g_mutex_unlock(&s->lock);
+}
+
+static void
+_push_tail_batch(LogQueue *s, LogMessage **msgs, const LogPathOptions *path_options, gint num_msgs)
+{
+  LogQueueDiskSegmented *self = (LogQueueDiskSegmented *) s;
+  GString **serialized_msgs = g_newa(GString *, num_msgs);
+  gint num_queued = 0;
+
+  ScratchBuffersMarker marker;
+  scratch_buffers_mark(&marker);
+
+  for (gint i = 0; i < num_msgs; i++)
+    {
+      serialized_msgs[i] = scratch_buffers_alloc();
+      if (!_serialize(self, msgs[i], serialized_msgs[i]))
+        {
+          _drop_message(self, msgs[i], &path_options[i]);
+          serialized_msgs[i] = NULL;
+        }
+    }
+
+  g_mutex_lock(&s->lock);
+
+  for (gint i = 0; i < num_msgs; i++)
+    {
+      if (serialized_msgs[i] && _push_tail_unlocked(self, msgs[i], &path_options[i], serialized_msgs[i]))
+        num_queued++;
+    }
+  scratch_buffers_reclaim_marked(marker);
+
+  if (num_queued == 0)
+    {
+      g_mutex_unlock(&s->lock);
+      return;
+    }
+
+  log_queue_queued_messages_add(s, num_queued);
+
+  /* this releases the queue's lock for a short time, which may violate the
+   * consistency of the disk-buffer, so it must be the last call under lock in this function
+   */
+  log_queue_push_notify(s);
+  g_mutex_unlock(&s->lock);
+}
+
+/*
+ * The records are reserved with the lock held, then they are read from
+ * their segments and deserialized without it, so neither the writer nor
+ * the other readers of the segments wait for this I/O.  Records that
+ * cannot be read are dropped.
+ */
+static gint
+_read_batch(LogQueueDiskSegmented *self, LogMessage **msgs, LogPathOptions *path_options, gint max_msgs)
+{
+  LogQueue *s = &self->super;
+  QDiskSegmentedReadPoint points[MAX_READ_BATCH];
+  gboolean discarded[MAX_READ_BATCH];
+  gint num_points = 0;
+  gint num_msgs = 0;
+
+  max_msgs = MIN(max_msgs, MAX_READ_BATCH);
+
+  g_mutex_lock(&s->lock);
+  _drop_peeked(self);
+  if (qdisk_segmented_started(self->qdisk))
+    {
+      while (num_points < max_msgs && qdisk_segmented_prepare_read(self->qdisk, &points[num_points]))
+        num_points++;
+    }
+  g_mutex_unlock(&s->lock);
+
+  if (num_points == 0)
+    return -1;
+
+  ScratchBuffersMarker marker;
+  GString *serialized = scratch_buffers_alloc_and_mark(&marker);
+  for (gint i = 0; i < num_points; i++)
+    {
+      LogMessage *msg = NULL;
+
+      if (qdisk_segmented_read_prepared(self->qdisk, &points[i], serialized))
+        {
+          diskq_global_metrics_replayed_bytes_add(points[i].record_length);
+          msg = _deserialize(self, serialized);
+        }
+
+      discarded[i] = (msg == NULL);
+      if (!msg)
+        continue;
+
+      path_options[num_msgs].ack_needed = FALSE;
+      msgs[num_msgs++] = msg;
+    }
+  scratch_buffers_reclaim_marked(marker);
+
+  g_mutex_lock(&s->lock);
+  for (gint i = 0; i < num_points; i++)
+    {
+      if (discarded[i])
+        qdisk_segmented_discard_prepared(self->qdisk, &points[i]);
+      qdisk_segmented_release_read_point(&points[i]);
+    }
+  log_queue_queued_messages_sub(s, num_points);
+  _update_disk_related_counters(self);
+  g_mutex_unlock(&s->lock);
+
+  return num_msgs;
+}
+
+static gint
+_pop_head_batch(LogQueue *s, LogMessage **msgs, LogPathOptions *path_options, gint max_msgs)
+{
+  LogQueueDiskSegmented *self = (LogQueueDiskSegmented *) s;
+  gint num_msgs;
+
+  /* a batch of unreadable records is not the end of the queue */
+  do
+    num_msgs = _read_batch(self, msgs, path_options, max_msgs);
+  while (num_msgs == 0);
+
+  return MAX(num_msgs, 0);
+}
+
+static LogMessage *
+_pop_head(LogQueue *s, LogPathOptions *path_options)
+{
+  LogMessage *msg = NULL;
+
+  if (_pop_head_batch(s, &msg, path_options, 1) == 0)
+    return NULL;
+
+  return msg;
+}
+
+static LogMessage *
+_peek_head(LogQueue *s)
+{
+  LogQueueDiskSegmented *self = (LogQueueDiskSegmented *) s;
+
+  g_mutex_lock(&s->lock);
+
+  if (!self->peeked && qdisk_segmented_started(self->qdisk))
+    {
+      ScratchBuffersMarker marker;
+      GString *serialized = scratch_buffers_alloc_and_mark(&marker);
+
+      if (qdisk_segmented_peek_head(self->qdisk, serialized))
+        self->peeked = _deserialize(self, serialized);
+
+      scratch_buffers_reclaim_marked(marker);
+    }
+  LogMessage *msg = self->peeked;
+
+  g_mutex_unlock(&s->lock);
+  return msg;
+}
+
+static void
+_ack_backlog(LogQueue *s, gint num_msg_to_ack)
+{
+  LogQueueDiskSegmented *self = (LogQueueDiskSegmented *) s;
+
+  g_mutex_lock(&s->lock);
+
+  if (qdisk_segmented_started(self->qdisk))
+    {
+      qdisk_segmented_ack_backlog(self->qdisk, num_msg_to_ack);
+      _update_disk_related_counters(self);
+    }
+
+  g_mutex_unlock(&s->lock);
+}
+
+static void
+_rewind_backlog(LogQueue *s, guint rewind_count)
+{
+  LogQueueDiskSegmented *self = (LogQueueDiskSegmented *) s;
+
+  g_mutex_lock(&s->lock);
+
+  if (qdisk_segmented_started(self->qdisk))
+    {
+      _drop_peeked(self);
+
+      gint64 length = qdisk_segmented_get_length(self->qdisk);
+      qdisk_segmented_rewind_backlog(self->qdisk, rewind_count);
+      log_queue_queued_messages_add(s, qdisk_segmented_get_length(self->qdisk) - length);
+    }
+
+  g_mutex_unlock(&s->lock);
+}
+
+static void
+_rewind_backlog_all(LogQueue *s)
+{
+  _rewind_backlog(s, G_MAXUINT);
+}
+
+gboolean
+log_queue_disk_segmented_start(LogQueue *s)
+{
+  LogQueueDiskSegmented *self = (LogQueueDiskSegmented *) s;
+
+  g_assert(!qdisk_segmented_started(self->qdisk));
+
+  if (!qdisk_segmented_start(self->qdisk))
+    return FALSE;
+
+  log_queue_queued_messages_add(s, qdisk_segmented_get_length(self->qdisk));
+  _update_disk_related_counters(self);
+  stats_counter_set(self->metrics.capacity, B_TO_KiB(qdisk_segmented_get_max_useful_space(self->qdisk)));
+  return TRUE;
+}
+
+void
+log_queue_disk_segmented_stop(LogQueue *s)
+{
+  LogQueueDiskSegmented *self = (LogQueueDiskSegmented *) s;
+
+  g_mutex_lock(&s->lock);
+
+  _drop_peeked(self);
+  if (qdisk_segmented_started(self->qdisk))
+    {
+      log_queue_queued_messages_sub(s, qdisk_segmented_get_length(self->qdisk));
+      qdisk_segmented_stop(self->qdisk);
+    }
+
+  g_mutex_unlock(&s->lock);
+}
+
+const gchar *
+log_queue_disk_segmented_get_dirname(LogQueue *s)
+{
+  LogQueueDiskSegmented *self = (LogQueueDiskSegmented *) s;
+
+  return qdisk_segmented_get_dirname(self->qdisk);
+}
+
+static void
+_free(LogQueue *s)
+{
+  LogQueueDiskSegmented *self = (LogQueueDiskSegmented *) s;
+
+  log_queue_disk_segmented_stop(s);
+  qdisk_segmented_free(self->qdisk);
+
+  log_queue_disk_metrics_unregister(&self->metrics);
+  log_queue_free_method(s);
+}
+
+static void
+_set_virtual_functions(LogQueue *s)
+{
+  s->get_length = _get_length;
+  s->ack_backlog = _ack_backlog;
+  s->rewind_backlog = _rewind_backlog;
+  s->rewind_backlog_all = _rewind_backlog_all;
+  s->pop_head = _pop_head;
+  s->pop_head_batch = _pop_head_batch;
+  s->peek_head = _peek_head;
+  s->push_tail = _push_tail;
+  s->push_tail_batch = _push_tail_batch;
+  s->free_fn = _free;
+}
+
+LogQueue *
+log_queue_disk_segmented_new(DiskQueueOptions *options, const gchar *dirname, const gchar *persist_name,
+                             gint stats_level, StatsClusterKeyBuilder *driver_sck_builder,
+                             StatsClusterKeyBuilder *queue_sck_builder)
+{
+  g_assert(options->segment_size > 0);
+  LogQueueDiskSegmented *self = g_new0(LogQueueDiskSegmented, 1);
+
+  if (queue_sck_builder)
+    {
+      stats_cluster_key_builder_push(queue_sck_builder);
+      stats_cluster_key_builder_set_name_prefix(queue_sck_builder, "disk_queue_");
+      stats_cluster_key_builder_add_label(queue_sck_builder, stats_cluster_label("path", dirname));
+      stats_cluster_key_builder_add_label(queue_sck_builder, stats_cluster_label("reliable", "true"));
+    }
+
+  log_queue_init_instance(&self->super, persist_name, stats_level, driver_sck_builder, queue_sck_builder);
+  self->super.type = log_queue_disk_segmented_type;
+
+  self->compaction = options->compaction;
+  self->compact_encoding = options->compact_encoding;
+  self->qdisk = qdisk_segmented_new(options, dirname);
+  log_queue_disk_metrics_register(&self->metrics, stats_level, queue_sck_builder);
+
+  if (queue_sck_builder)
+    stats_cluster_key_builder_pop(queue_sck_builder);
+
+  _set_virtual_functions(&self->super);
+  return &self->super;
+}
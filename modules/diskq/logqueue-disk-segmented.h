@@ -0,0 +1,56 @@
+/*
+ * Copyright (c) 2024 One Identity LLC.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#ifndef LOGQUEUE_DISK_SEGMENTED_H_
+#define LOGQUEUE_DISK_SEGMENTED_H_
+
+#include "logqueue-disk.h"
+#include "qdisk-segmented.h"
+
+/*
+ * A disk-buffer on top of QDiskSegmented, used if segment-size() is set.
+ * Every message is written to disk and acknowledged right away, there are
+ * no in-memory queues in front of the segments.
+ */
+typedef struct _LogQueueDiskSegmented
+{
+  LogQueue super;
+  QDiskSegmented *qdisk;
+  LogQueueDiskMetrics metrics;
+
+  gboolean compaction;
+  gboolean compact_encoding;
+
+  /* the message returned by peek_head(), owned by the queue until the read head moves */
+  LogMessage *peeked;
+} LogQueueDiskSegmented;
+
+extern QueueType log_queue_disk_segmented_type;
+
+LogQueue *log_queue_disk_segmented_new(DiskQueueOptions *options, const gchar *dirname, const gchar *persist_name,
+                                       gint stats_level, StatsClusterKeyBuilder *driver_sck_builder,
+                                       StatsClusterKeyBuilder *queue_sck_builder);
+gboolean log_queue_disk_segmented_start(LogQueue *s);
+void log_queue_disk_segmented_stop(LogQueue *s);
+const gchar *log_queue_disk_segmented_get_dirname(LogQueue *s);
+
+#endif /* LOGQUEUE_DISK_SEGMENTED_H_ */
@@ -30,7 +30,9 @@
 #include "stats/stats-cluster-single.h"
 #include "reloc.h"
 #include "qdisk.h"
+#include "diskq-global-metrics.h"
 #include "scratch-buffers.h"
+#include "apphook.h"
 
 #include <sys/types.h>
 #include <sys/stat.h>
@@ -46,12 +48,91 @@
 
 QueueType log_queue_disk_type = "DISK";
 
+/* lock must be held */
+static inline gboolean
+_is_prefetch_needed(LogQueueDisk *self)
+{
+  return qdisk_started(self->qdisk)
+         && atomic_gssize_racy_get(&self->super.memory_reserved) < self->prefetch.bytes
+         && !log_queue_is_global_memory_budget_exhausted();
+}
+
+/*
+ * The prefetcher keeps reading messages from the disk into memory as long
+ * as the queue holds less than prefetch-bytes() of messages in memory, so
+ * that the consumer does not have to wait for disk reads and
+ * deserialization.  It is woken up when messages are pushed or popped.
+ */
+static gpointer
+_prefetch_thread(gpointer user_data)
+{
+  LogQueueDisk *self = (LogQueueDisk *) user_data;
+  LogQueue *s = &self->super;
+
+  app_thread_start();
+
+  g_mutex_lock(&s->lock);
+  while (!self->prefetch.exit)
+    {
+      if (_is_prefetch_needed(self) && self->prefetch_message(self))
+        {
+          /* give the producers and the consumer a chance between messages */
+          g_mutex_unlock(&s->lock);
+          g_mutex_lock(&s->lock);
+          continue;
+        }
+
+      g_cond_wait(&self->prefetch.cond, &s->lock);
+    }
+  g_mutex_unlock(&s->lock);
+
+  app_thread_stop();
+  return NULL;
+}
+
+static void
+_start_prefetch_thread(LogQueueDisk *self)
+{
+  if (self->prefetch.bytes <= 0 || !self->prefetch_message || self->prefetch.thread)
+    return;
+
+  self->prefetch.exit = FALSE;
+  self->prefetch.thread = g_thread_new("diskq-prefetch", _prefetch_thread, self);
+}
+
+static void
+_stop_prefetch_thread(LogQueueDisk *self)
+{
+  LogQueue *s = &self->super;
+
+  if (!self->prefetch.thread)
+    return;
+
+  g_mutex_lock(&s->lock);
+  self->prefetch.exit = TRUE;
+  g_cond_signal(&self->prefetch.cond);
+  g_mutex_unlock(&s->lock);
+
+  g_thread_join(self->prefetch.thread);
+  self->prefetch.thread = NULL;
+}
+
+/* lock must be held */
+void
+log_queue_disk_wakeup_prefetcher(LogQueueDisk *self)
+{
+  if (self->prefetch.thread)
+    g_cond_signal(&self->prefetch.cond);
+}
+
 gboolean
 log_queue_disk_stop(LogQueue *s, gboolean *persistent)
 {
   LogQueueDisk *self = (LogQueueDisk *) s;
   g_assert(self->stop);
 
+  _stop_prefetch_thread(self);
+
   if (!qdisk_started(self->qdisk))
     {
       *persistent = FALSE;
@@ -76,6 +157,7 @@ log_queue_disk_start(LogQueue *s)
       log_queue_queued_messages_add(s, log_queue_get_length(s));
       log_queue_disk_update_disk_related_counters(self);
       stats_counter_set(self->metrics.capacity, B_TO_KiB(qdisk_get_max_useful_space(self->qdisk)));
+      _start_prefetch_thread(self);
       return TRUE;
     }
 
@@ -89,33 +171,33 @@ log_queue_disk_get_filename(LogQueue *s)
   return qdisk_get_filename(self->qdisk);
 }
 
-static void
-_unregister_counters(LogQueueDisk *self)
+void
+log_queue_disk_metrics_unregister(LogQueueDiskMetrics *metrics)
 {
   stats_lock();
   {
-    if (self->metrics.capacity_sc_key)
+    if (metrics->capacity_sc_key)
       {
-        stats_unregister_counter(self->metrics.capacity_sc_key, SC_TYPE_SINGLE_VALUE,
-                                 &self->metrics.capacity);
+        stats_unregister_counter(metrics->capacity_sc_key, SC_TYPE_SINGLE_VALUE,
+                                 &metrics->capacity);
 
-        stats_cluster_key_free(self->metrics.capacity_sc_key);
+        stats_cluster_key_free(metrics->capacity_sc_key);
       }
 
-    if (self->metrics.disk_usage_sc_key)
+    if (metrics->disk_usage_sc_key)
       {
-        stats_unregister_counter(self->metrics.disk_usage_sc_key, SC_TYPE_SINGLE_VALUE,
-                                 &self->metrics.disk_usage);
+        stats_unregister_counter(metrics->disk_usage_sc_key, SC_TYPE_SINGLE_VALUE,
+                                 &metrics->disk_usage);
 
-        stats_cluster_key_free(self->metrics.disk_usage_sc_key);
+        stats_cluster_key_free(metrics->disk_usage_sc_key);
       }
 
-    if (self->metrics.disk_allocated_sc_key)
+    if (metrics->disk_allocated_sc_key)
       {
-        stats_unregister_counter(self->metrics.disk_allocated_sc_key, SC_TYPE_SINGLE_VALUE,
-                                 &self->metrics.disk_allocated);
+        stats_unregister_counter(metrics->disk_allocated_sc_key, SC_TYPE_SINGLE_VALUE,
+                                 &metrics->disk_allocated);
 
-        stats_cluster_key_free(self->metrics.disk_allocated_sc_key);
+        stats_cluster_key_free(metrics->disk_allocated_sc_key);
       }
   }
   stats_unlock();
@@ -124,10 +206,13 @@ _unregister_counters(LogQueueDisk *self)
 void
 log_queue_disk_free_method(LogQueueDisk *self)
 {
+  _stop_prefetch_thread(self);
+
   g_assert(!qdisk_started(self->qdisk));
   qdisk_free(self->qdisk);
 
-  _unregister_counters(self);
+  log_queue_disk_metrics_unregister(&self->metrics);
+  g_cond_clear(&self->prefetch.cond);
 
   log_queue_free_method(&self->super);
 }
@@ -139,6 +224,35 @@ log_queue_disk_update_disk_related_counters(LogQueueDisk *self)
   stats_counter_set(self->metrics.disk_allocated, B_TO_KiB(qdisk_get_file_size(self->qdisk)));
 }
 
+static gboolean
+_deserialize_msg(SerializeArchive *sa, gpointer user_data)
+{
+  LogMessage *msg = user_data;
+
+  return log_msg_deserialize(msg, sa);
+}
+
+static gboolean
+_deserialize_msg_from_buffer(LogQueueDisk *self, const gchar *serialized, gsize serialized_len, LogMessage **msg)
+{
+  LogMessage *local_msg = log_msg_new_empty();
+  GError *error = NULL;
+
+  if (!qdisk_deserialize_buffer(serialized, serialized_len, _deserialize_msg, local_msg, &error))
+    {
+      msg_error("Error deserializing message from the disk-queue file",
+                evt_tag_str("error", error->message),
+                evt_tag_str("persist-name", self->super.persist_name));
+      log_msg_unref(local_msg);
+      g_error_free(error);
+      return FALSE;
+    }
+
+  *msg = local_msg;
+
+  return TRUE;
+}
+
 static gboolean
 _pop_disk(LogQueueDisk *self, LogMessage **msg)
 {
@@ -150,7 +264,9 @@ _pop_disk(LogQueueDisk *self, LogMessage **msg)
 
   gint64 read_head = qdisk_get_next_head_position(self->qdisk);
 
-  if (!qdisk_pop_head(self->qdisk, read_serialized))
+  const gchar *record;
+  gsize record_length;
+  if (!qdisk_pop_head_mapped(self->qdisk, read_serialized, &record, &record_length))
     {
       msg_error("Cannot read correct message from disk-queue file",
                 evt_tag_str("filename", qdisk_get_filename(self->qdisk)),
@@ -159,7 +275,9 @@ _pop_disk(LogQueueDisk *self, LogMessage **msg)
       return FALSE;
     }
 
-  if (!log_queue_disk_deserialize_msg(self, read_serialized, msg))
+  diskq_global_metrics_replayed_bytes_add(record_length);
+
+  if (!_deserialize_msg_from_buffer(self, record, record_length, msg))
     {
       msg_error("Cannot read correct message from disk-queue file",
                 evt_tag_str("filename", qdisk_get_filename(self->qdisk)),
@@ -238,6 +356,38 @@ log_queue_disk_read_message(LogQueueDisk *self, LogPathOptions *path_options)
   return msg;
 }
 
+/*
+ * Reads the message at @position for the prefetcher: the disk I/O and the
+ * deserialization happen without the lock.  The read is finished with
+ * qdisk_finish_read() or qdisk_pop_prepared_head() on @point.
+ *
+ * lock must be held, it is released while reading
+ */
+LogMessage *
+log_queue_disk_read_message_unlocked(LogQueueDisk *self, gint64 position, QDiskReadPoint *point)
+{
+  LogQueue *s = &self->super;
+  LogMessage *msg = NULL;
+
+  if (!qdisk_prepare_read(self->qdisk, position, point))
+    return NULL;
+
+  g_mutex_unlock(&s->lock);
+
+  ScratchBuffersMarker marker;
+  GString *serialized = scratch_buffers_alloc_and_mark(&marker);
+  if (qdisk_read_prepared(self->qdisk, point, serialized))
+    {
+      diskq_global_metrics_replayed_bytes_add(point->record_length);
+      if (!_deserialize_msg_from_buffer(self, serialized->str, serialized->len, &msg))
+        msg = NULL;
+    }
+  scratch_buffers_reclaim_marked(marker);
+
+  g_mutex_lock(&s->lock);
+  return msg;
+}
+
 LogMessage *
 log_queue_disk_peek_message(LogQueueDisk *self)
 {
@@ -352,8 +502,8 @@ log_queue_disk_restart_corrupted(LogQueueDisk *self)
   stats_counter_set(self->metrics.capacity, B_TO_KiB(qdisk_get_max_useful_space(self->qdisk)));
 }
 
-static void
-_register_counters(LogQueueDisk *self, gint stats_level, StatsClusterKeyBuilder *builder)
+void
+log_queue_disk_metrics_register(LogQueueDiskMetrics *metrics, gint stats_level, StatsClusterKeyBuilder *builder)
 {
   if (!builder)
     return;
@@ -364,24 +514,24 @@ _register_counters(LogQueueDisk *self, gint stats_level, StatsClusterKeyBuilder
     stats_cluster_key_builder_set_unit(builder, SCU_KIB);
 
     stats_cluster_key_builder_set_name(builder, "capacity_bytes");
-    self->metrics.capacity_sc_key = stats_cluster_key_builder_build_single(builder);
+    metrics->capacity_sc_key = stats_cluster_key_builder_build_single(builder);
 
     stats_cluster_key_builder_set_name(builder, "disk_usage_bytes");
-    self->metrics.disk_usage_sc_key = stats_cluster_key_builder_build_single(builder);
+    metrics->disk_usage_sc_key = stats_cluster_key_builder_build_single(builder);
 
     stats_cluster_key_builder_set_name(builder, "disk_allocated_bytes");
-    self->metrics.disk_allocated_sc_key = stats_cluster_key_builder_build_single(builder);
+    metrics->disk_allocated_sc_key = stats_cluster_key_builder_build_single(builder);
   }
   stats_cluster_key_builder_pop(builder);
 
   stats_lock();
   {
-    stats_register_counter(stats_level, self->metrics.capacity_sc_key, SC_TYPE_SINGLE_VALUE,
-                           &self->metrics.capacity);
-    stats_register_counter(stats_level, self->metrics.disk_usage_sc_key, SC_TYPE_SINGLE_VALUE,
-                           &self->metrics.disk_usage);
-    stats_register_counter(stats_level, self->metrics.disk_allocated_sc_key, SC_TYPE_SINGLE_VALUE,
-                           &self->metrics.disk_allocated);
+    stats_register_counter(stats_level, metrics->capacity_sc_key, SC_TYPE_SINGLE_VALUE,
+                           &metrics->capacity);
+    stats_register_counter(stats_level, metrics->disk_usage_sc_key, SC_TYPE_SINGLE_VALUE,
+                           &metrics->disk_usage);
+    stats_register_counter(stats_level, metrics->disk_allocated_sc_key, SC_TYPE_SINGLE_VALUE,
+                           &metrics->disk_allocated);
   }
   stats_unlock();
 }
@@ -405,9 +555,12 @@ log_queue_disk_init_instance(LogQueueDisk *self, DiskQueueOptions *options, cons
   self->super.type = log_queue_disk_type;
 
   self->compaction = options->compaction;
+  self->compact_encoding = options->compact_encoding;
+  g_cond_init(&self->prefetch.cond);
+  self->prefetch.bytes = options->prefetch_bytes;
 
   self->qdisk = qdisk_new(options, qdisk_file_id, filename);
-  _register_counters(self, stats_level, queue_sck_builder);
+  log_queue_disk_metrics_register(&self->metrics, stats_level, queue_sck_builder);
 
   if (queue_sck_builder)
     stats_cluster_key_builder_pop(queue_sck_builder);
@@ -419,7 +572,16 @@ _serialize_msg(SerializeArchive *sa, gpointer user_data)
   LogQueueDisk *self = ((gpointer *) user_data)[0];
   LogMessage *msg = ((gpointer *) user_data)[1];
 
-  return log_msg_serialize(msg, sa, self->compaction ? LMSF_COMPACTION : 0);
+  guint32 flags = 0;
+
+  if (self->compaction)
+    flags |= LMSF_COMPACTION;
+
+  /* v27 records cannot be read by earlier versions, so it has its own opt-in */
+  if (self->compact_encoding)
+    flags |= LMSF_COMPACT_ENCODING;
+
+  return log_msg_serialize(msg, sa, flags);
 }
 
 gboolean
@@ -440,32 +602,9 @@ log_queue_disk_serialize_msg(LogQueueDisk *self, LogMessage *msg, GString *seria
   return TRUE;
 }
 
-static gboolean
-_deserialize_msg(SerializeArchive *sa, gpointer user_data)
-{
-  LogMessage *msg = user_data;
-
-  return log_msg_deserialize(msg, sa);
-}
-
 gboolean
 log_queue_disk_deserialize_msg(LogQueueDisk *self, GString *serialized, LogMessage **msg)
 {
-  LogMessage *local_msg = log_msg_new_empty();
-  gpointer user_data = local_msg;
-  GError *error = NULL;
-
-  if (!qdisk_deserialize(serialized, _deserialize_msg, user_data, &error))
-    {
-      msg_error("Error deserializing message from the disk-queue file",
-                evt_tag_str("error", error->message),
-                evt_tag_str("persist-name", self->super.persist_name));
-      log_msg_unref(local_msg);
-      g_error_free(error);
-      return FALSE;
-    }
-
-  *msg = local_msg;
-
-  return TRUE;
+  return _deserialize_msg_from_buffer(self, serialized->str, serialized->len, msg);
 }
+
@@ -29,6 +29,17 @@
 #include "qdisk.h"
 #include "logmsg/logmsg-serialize.h"
 
+typedef struct _LogQueueDiskMetrics
+{
+  StatsClusterKey *capacity_sc_key;
+  StatsClusterKey *disk_usage_sc_key;
+  StatsClusterKey *disk_allocated_sc_key;
+
+  StatsCounterItem *capacity;
+  StatsCounterItem *disk_usage;
+  StatsCounterItem *disk_allocated;
+} LogQueueDiskMetrics;
+
 typedef struct _LogQueueDisk LogQueueDisk;
 
 struct _LogQueueDisk
@@ -41,21 +52,29 @@ struct _LogQueueDisk
    * flow_control_window_bytes, etc...
    */
 
+  LogQueueDiskMetrics metrics;
+
+  gboolean compaction;
+  gboolean compact_encoding;
+
+  /* reads messages into memory ahead of the consumer, see prefetch_message() */
   struct
   {
-    StatsClusterKey *capacity_sc_key;
-    StatsClusterKey *disk_usage_sc_key;
-    StatsClusterKey *disk_allocated_sc_key;
+    GThread *thread;
+    GCond cond;
+    gboolean exit;
+    gint64 bytes;
+  } prefetch;
 
-    StatsCounterItem *capacity;
-    StatsCounterItem *disk_usage;
-    StatsCounterItem *disk_allocated;
-  } metrics;
-
-  gboolean compaction;
   gboolean (*start)(LogQueueDisk *s);
   gboolean (*stop)(LogQueueDisk *s, gboolean *persistent);
   gboolean (*stop_corrupted)(LogQueueDisk *s);
+
+  /*
+   * called with the lock held, which it may release while reading, returns
+   * FALSE if there is nothing to prefetch
+   */
+  gboolean (*prefetch_message)(LogQueueDisk *s);
 };
 
 extern QueueType log_queue_disk_type;
@@ -68,10 +87,16 @@ void log_queue_disk_init_instance(LogQueueDisk *self, DiskQueueOptions *options,
                                   StatsClusterKeyBuilder *driver_sck_builder,
                                   StatsClusterKeyBuilder *queue_sck_builder);
 void log_queue_disk_restart_corrupted(LogQueueDisk *self);
+
+void log_queue_disk_metrics_register(LogQueueDiskMetrics *metrics, gint stats_level,
+                                     StatsClusterKeyBuilder *builder);
+void log_queue_disk_metrics_unregister(LogQueueDiskMetrics *metrics);
 void log_queue_disk_free_method(LogQueueDisk *self);
 
 void log_queue_disk_update_disk_related_counters(LogQueueDisk *self);
+void log_queue_disk_wakeup_prefetcher(LogQueueDisk *self);
 LogMessage *log_queue_disk_read_message(LogQueueDisk *self, LogPathOptions *path_options);
+LogMessage *log_queue_disk_read_message_unlocked(LogQueueDisk *self, gint64 position, QDiskReadPoint *point);
 LogMessage *log_queue_disk_peek_message(LogQueueDisk *self);
 void log_queue_disk_drop_message(LogQueueDisk *self, LogMessage *msg, const LogPathOptions *path_options);
 gboolean log_queue_disk_serialize_msg(LogQueueDisk *self, LogMessage *msg, GString *serialized);
@@ -0,0 +1,1078 @@
+/*
+ * Copyright (c) 2024 One Identity LLC.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#include "qdisk-segmented.h"
+#include "messages.h"
+#include "compat/lfs.h"
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <errno.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <string.h>
+
+#define QDISK_SEGMENT_MAGIC "SLSG"
+#define QDISK_MANIFEST_MAGIC "SLSM"
+#define QDISK_SEGMENTED_VERSION 1
+
+#define QDISK_SEGMENT_FILENAME_FMT "%016" G_GINT64_MODIFIER "x.seg"
+#define QDISK_SEGMENT_FILENAME_IDX_LEN 16
+#define QDISK_SEGMENT_FILENAME_EXT ".seg"
+#define QDISK_MANIFEST_FILENAME "manifest"
+
+#define QDISK_SEGMENT_MAX_RECORD_LENGTH (100 * 1024 * 1024)
+
+typedef struct _QDiskSegmentHeader
+{
+  gchar magic[4];
+  guint32 version;
+  guint64 sequence;
+} QDiskSegmentHeader;
+
+G_STATIC_ASSERT(sizeof(QDiskSegmentHeader) == 16);
+
+#define QDISK_SEGMENT_HEADER_SIZE ((gint64) sizeof(QDiskSegmentHeader))
+
+typedef struct _QDiskSegmentedManifest
+{
+  gchar magic[4];
+  guint32 version;
+  guint64 head_sequence;
+  guint64 head_offset;
+} QDiskSegmentedManifest;
+
+struct _QDiskSegment
+{
+  gint ref_cnt;
+  gint64 sequence;
+  gchar *filename;
+  gint fd;
+  gint64 size;
+  gint64 records;
+  /* no more records are written into sealed segments */
+  gboolean sealed;
+};
+
+typedef struct _QDiskSegmentedPosition
+{
+  gint64 sequence;
+  gint64 offset;
+  gint64 index;
+  /* the record could not be read, it is in the backlog only to keep the positions in order */
+  gboolean discarded;
+} QDiskSegmentedPosition;
+
+struct _QDiskSegmented
+{
+  DiskQueueOptions *options;
+  gchar *dirname;
+  gboolean started;
+  /* incremented when stopped, read points prepared earlier are stale */
+  guint64 generation;
+
+  /* QDiskSegment instances ordered by sequence, records are appended to the last one */
+  GQueue *segments;
+
+  /* the next record to read, read_segment is owned by segments */
+  QDiskSegment *read_segment;
+  gint64 read_offset;
+  gint64 read_index;
+
+  /* QDiskSegmentedPosition of the records read, but not acknowledged yet */
+  GQueue *backlog;
+  gint64 backlog_count;
+
+  gint64 length;
+  gint64 used_space;
+};
+
+static gboolean
+_pread_all(gint fd, gpointer buffer, gsize count, gint64 offset)
+{
+  gchar *p = buffer;
+
+  while (count > 0)
+    {
+      gssize rc = pread(fd, p, count, offset);
+      if (rc < 0 && errno == EINTR)
+        continue;
+      if (rc <= 0)
+        return FALSE;
+
+      p += rc;
+      count -= rc;
+      offset += rc;
+    }
+  return TRUE;
+}
+
+static gboolean
+_pwrite_all(gint fd, gconstpointer buffer, gsize count, gint64 offset)
+{
+  const gchar *p = buffer;
+
+  while (count > 0)
+    {
+      gssize rc = pwrite(fd, p, count, offset);
+      if (rc < 0 && errno == EINTR)
+        continue;
+      if (rc <= 0)
+        return FALSE;
+
+      p += rc;
+      count -= rc;
+      offset += rc;
+    }
+  return TRUE;
+}
+
+static gint
+_sync_fd(gint fd)
+{
+#if SYSLOG_NG_HAVE_FDATASYNC
+  return fdatasync(fd);
+#else
+  return fsync(fd);
+#endif
+}
+
+static inline gboolean
+_is_record_length_valid(guint32 record_length)
+{
+  return record_length > 0 && record_length <= QDISK_SEGMENT_MAX_RECORD_LENGTH;
+}
+
+static QDiskSegment *
+_segment_new(gint64 sequence, gchar *filename, gint fd)
+{
+  QDiskSegment *segment = g_new0(QDiskSegment, 1);
+
+  segment->ref_cnt = 1;
+  segment->sequence = sequence;
+  segment->filename = filename;
+  segment->fd = fd;
+  return segment;
+}
+
+static QDiskSegment *
+_segment_ref(QDiskSegment *segment)
+{
+  g_atomic_int_inc(&segment->ref_cnt);
+  return segment;
+}
+
+/* readers may still hold a reference after the segment is unlinked, the fd stays open until they are done */
+static void
+_segment_unref(QDiskSegment *segment)
+{
+  if (!g_atomic_int_dec_and_test(&segment->ref_cnt))
+    return;
+
+  close(segment->fd);
+  g_free(segment->filename);
+  g_free(segment);
+}
+
+static gchar *
+_build_segment_filename(QDiskSegmented *self, gint64 sequence)
+{
+  gchar basename[64];
+  g_snprintf(basename, sizeof(basename), QDISK_SEGMENT_FILENAME_FMT, sequence);
+
+  return g_build_filename(self->dirname, basename, NULL);
+}
+
+static gboolean
+_parse_segment_filename(const gchar *basename, gint64 *sequence)
+{
+  if (strlen(basename) != QDISK_SEGMENT_FILENAME_IDX_LEN + strlen(QDISK_SEGMENT_FILENAME_EXT) ||
+      !g_str_has_suffix(basename, QDISK_SEGMENT_FILENAME_EXT))
+    return FALSE;
+
+  gchar *end;
+  *sequence = (gint64) g_ascii_strtoull(basename, &end, 16);
+  return end == basename + QDISK_SEGMENT_FILENAME_IDX_LEN;
+}
+
+static void
+_sync_dir(QDiskSegmented *self)
+{
+  gint fd = open(self->dirname, O_RDONLY);
+  if (fd < 0)
+    return;
+
+  fsync(fd);
+  close(fd);
+}
+
+static QDiskSegment *
+_create_segment(QDiskSegmented *self, gint64 sequence)
+{
+  gchar *filename = _build_segment_filename(self, sequence);
+
+  gint fd = open(filename, O_RDWR | O_LARGEFILE | O_CREAT | O_EXCL, 0600);
+  if (fd < 0)
+    {
+      msg_error("Error creating disk-queue segment",
+                evt_tag_str("filename", filename),
+                evt_tag_error("error"));
+      g_free(filename);
+      return NULL;
+    }
+
+  QDiskSegmentHeader header = { .version = GUINT32_TO_BE(QDISK_SEGMENTED_VERSION),
+                                .sequence = GUINT64_TO_BE(sequence)
+                              };
+  memcpy(header.magic, QDISK_SEGMENT_MAGIC, sizeof(header.magic));
+
+  if (!_pwrite_all(fd, &header, sizeof(header), 0))
+    {
+      msg_error("Error writing disk-queue segment header",
+                evt_tag_str("filename", filename),
+                evt_tag_error("error"));
+      close(fd);
+      unlink(filename);
+      g_free(filename);
+      return NULL;
+    }
+
+  QDiskSegment *segment = _segment_new(sequence, filename, fd);
+  segment->size = QDISK_SEGMENT_HEADER_SIZE;
+
+  g_queue_push_tail(self->segments, segment);
+  self->used_space += segment->size;
+  return segment;
+}
+
+static void
+_remove_segment(QDiskSegmented *self, QDiskSegment *segment)
+{
+  if (unlink(segment->filename) < 0)
+    {
+      msg_error("Error removing consumed disk-queue segment",
+                evt_tag_str("filename", segment->filename),
+                evt_tag_error("error"));
+    }
+
+  self->used_space -= segment->size;
+  _segment_unref(segment);
+}
+
+static gboolean
+_validate_segment_header(QDiskSegment *segment)
+{
+  QDiskSegmentHeader header;
+
+  if (!_pread_all(segment->fd, &header, sizeof(header), 0))
+    return FALSE;
+
+  return memcmp(header.magic, QDISK_SEGMENT_MAGIC, sizeof(header.magic)) == 0 &&
+         GUINT32_FROM_BE(header.version) == QDISK_SEGMENTED_VERSION &&
+         (gint64) GUINT64_FROM_BE(header.sequence) == segment->sequence;
+}
+
+/*
+ * Counts the records of the segment and cuts off anything after the last
+ * complete record, which is left there by a write interrupted by a crash.
+ * head_index is set to the index of the record starting at head_offset, or
+ * -1 if no record starts there.
+ */
+static gboolean
+_scan_segment(QDiskSegment *segment, gint64 file_size, gint64 head_offset, gint64 *head_index)
+{
+  gint fd = dup(segment->fd);
+  FILE *f = fd >= 0 ? fdopen(fd, "r") : NULL;
+  if (!f || fseeko(f, QDISK_SEGMENT_HEADER_SIZE, SEEK_SET) != 0)
+    {
+      msg_error("Error opening disk-queue segment stream",
+                evt_tag_str("filename", segment->filename),
+                evt_tag_error("error"));
+      if (f)
+        fclose(f);
+      else if (fd >= 0)
+        close(fd);
+      return FALSE;
+    }
+
+  gint64 offset = QDISK_SEGMENT_HEADER_SIZE;
+  gint64 records = 0;
+
+  *head_index = -1;
+  while (offset < file_size)
+    {
+      if (offset == head_offset)
+        *head_index = records;
+
+      guint32 record_length;
+      if (fread(&record_length, sizeof(record_length), 1, f) != 1)
+        break;
+
+      record_length = GUINT32_FROM_BE(record_length);
+      if (!_is_record_length_valid(record_length) || offset + (gint64) sizeof(record_length) + record_length > file_size)
+        break;
+
+      if (fseeko(f, record_length, SEEK_CUR) != 0)
+        break;
+
+      offset += (gint64) sizeof(record_length) + record_length;
+      records++;
+    }
+  if (offset == head_offset)
+    *head_index = records;
+
+  fclose(f);
+
+  if (offset < file_size)
+    {
+      msg_warning("Incomplete record found at the end of a disk-queue segment, truncating",
+                  evt_tag_str("filename", segment->filename),
+                  evt_tag_long("offset", offset),
+                  evt_tag_long("file_size", file_size));
+      if (ftruncate(segment->fd, offset) < 0)
+        {
+          msg_error("Error truncating disk-queue segment",
+                    evt_tag_str("filename", segment->filename),
+                    evt_tag_error("error"));
+          return FALSE;
+        }
+    }
+
+  segment->size = offset;
+  segment->records = records;
+  return TRUE;
+}
+
+static QDiskSegment *
+_open_segment(QDiskSegmented *self, gint64 sequence, gint64 head_offset, gint64 *head_index)
+{
+  gchar *filename = _build_segment_filename(self, sequence);
+
+  gint fd = open(filename, O_RDWR | O_LARGEFILE);
+  if (fd < 0)
+    {
+      msg_error("Error opening disk-queue segment",
+                evt_tag_str("filename", filename),
+                evt_tag_error("error"));
+      g_free(filename);
+      return NULL;
+    }
+
+  QDiskSegment *segment = _segment_new(sequence, filename, fd);
+
+  struct stat st;
+  if (fstat(fd, &st) < 0 || st.st_size < QDISK_SEGMENT_HEADER_SIZE || !_validate_segment_header(segment))
+    {
+      msg_error("Invalid disk-queue segment header",
+                evt_tag_str("filename", filename));
+      _segment_unref(segment);
+      return NULL;
+    }
+
+  if (!_scan_segment(segment, st.st_size, head_offset, head_index))
+    {
+      _segment_unref(segment);
+      return NULL;
+    }
+
+  return segment;
+}
+
+static void
+_move_aside_corrupted_segment(QDiskSegmented *self, gint64 sequence)
+{
+  gchar *filename = _build_segment_filename(self, sequence);
+  gchar *corrupted_filename = g_strdup_printf("%s.corrupted", filename);
+
+  msg_error("Moving corrupted disk-queue segment aside, its messages are lost",
+            evt_tag_str("filename", filename),
+            evt_tag_str("corrupted_filename", corrupted_filename));
+
+  if (rename(filename, corrupted_filename) < 0)
+    {
+      msg_error("Error renaming corrupted disk-queue segment",
+                evt_tag_str("filename", filename),
+                evt_tag_error("error"));
+    }
+
+  g_free(corrupted_filename);
+  g_free(filename);
+}
+
+static gint
+_compare_sequences(gconstpointer a, gconstpointer b)
+{
+  gint64 sa = *(const gint64 *) a;
+  gint64 sb = *(const gint64 *) b;
+
+  return (sa > sb) - (sa < sb);
+}
+
+static GArray *
+_list_segment_sequences(QDiskSegmented *self)
+{
+  GError *error = NULL;
+  GDir *dir = g_dir_open(self->dirname, 0, &error);
+  if (!dir)
+    {
+      msg_error("Error opening segmented disk-queue directory",
+                evt_tag_str("dirname", self->dirname),
+                evt_tag_str("error", error->message));
+      g_error_free(error);
+      return NULL;
+    }
+
+  GArray *sequences = g_array_new(FALSE, FALSE, sizeof(gint64));
+
+  const gchar *basename;
+  while ((basename = g_dir_read_name(dir)))
+    {
+      gint64 sequence;
+      if (_parse_segment_filename(basename, &sequence))
+        g_array_append_val(sequences, sequence);
+    }
+  g_dir_close(dir);
+
+  g_array_sort(sequences, _compare_sequences);
+  return sequences;
+}
+
+static gboolean
+_read_manifest(QDiskSegmented *self, gint64 *head_sequence, gint64 *head_offset)
+{
+  gchar *filename = g_build_filename(self->dirname, QDISK_MANIFEST_FILENAME, NULL);
+  gchar *contents = NULL;
+  gsize length;
+  GError *error = NULL;
+  gboolean result = FALSE;
+
+  if (!g_file_get_contents(filename, &contents, &length, &error))
+    {
+      if (!g_error_matches(error, G_FILE_ERROR, G_FILE_ERROR_NOENT))
+        msg_warning("Error reading disk-queue manifest, replaying every segment",
+                    evt_tag_str("filename", filename),
+                    evt_tag_str("error", error->message));
+      g_error_free(error);
+      g_free(filename);
+      return FALSE;
+    }
+
+  QDiskSegmentedManifest manifest;
+  if (length == sizeof(manifest))
+    {
+      memcpy(&manifest, contents, sizeof(manifest));
+      if (memcmp(manifest.magic, QDISK_MANIFEST_MAGIC, sizeof(manifest.magic)) == 0 &&
+          GUINT32_FROM_BE(manifest.version) == QDISK_SEGMENTED_VERSION)
+        {
+          *head_sequence = GUINT64_FROM_BE(manifest.head_sequence);
+          *head_offset = GUINT64_FROM_BE(manifest.head_offset);
+          result = TRUE;
+        }
+    }
+
+  if (!result)
+    msg_warning("Invalid disk-queue manifest, replaying every segment",
+                evt_tag_str("filename", filename));
+
+  g_free(contents);
+  g_free(filename);
+  return result;
+}
+
+/* written to a temporary file first, so a crash leaves either the old or the new manifest behind */
+static gboolean
+_write_manifest(QDiskSegmented *self, gint64 head_sequence, gint64 head_offset)
+{
+  QDiskSegmentedManifest manifest = { .version = GUINT32_TO_BE(QDISK_SEGMENTED_VERSION),
+                                      .head_sequence = GUINT64_TO_BE(head_sequence),
+                                      .head_offset = GUINT64_TO_BE(head_offset)
+                                    };
+  memcpy(manifest.magic, QDISK_MANIFEST_MAGIC, sizeof(manifest.magic));
+
+  gchar *filename = g_build_filename(self->dirname, QDISK_MANIFEST_FILENAME, NULL);
+  gchar *tmp_filename = g_strdup_printf("%s.tmp", filename);
+
+  gint fd = open(tmp_filename, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+  gboolean result = fd >= 0 && _pwrite_all(fd, &manifest, sizeof(manifest), 0) && fsync(fd) == 0;
+  if (fd >= 0)
+    close(fd);
+
+  result = result && rename(tmp_filename, filename) == 0;
+  if (result)
+    {
+      _sync_dir(self);
+    }
+  else
+    {
+      msg_error("Error writing disk-queue manifest",
+                evt_tag_str("filename", filename),
+                evt_tag_error("error"));
+      unlink(tmp_filename);
+    }
+
+  g_free(tmp_filename);
+  g_free(filename);
+  return result;
+}
+
+static QDiskSegment *
+_find_segment(QDiskSegmented *self, gint64 sequence)
+{
+  for (GList *l = self->segments->head; l; l = l->next)
+    {
+      QDiskSegment *segment = l->data;
+      if (segment->sequence == sequence)
+        return segment;
+    }
+  return NULL;
+}
+
+static void
+_set_read_head(QDiskSegmented *self, QDiskSegment *segment, gint64 offset, gint64 index)
+{
+  self->read_segment = segment;
+  self->read_offset = offset;
+  self->read_index = index;
+}
+
+/* the position of the first record that is not acknowledged yet */
+static void
+_get_ack_head(QDiskSegmented *self, gint64 *sequence, gint64 *offset)
+{
+  QDiskSegmentedPosition *oldest = g_queue_peek_head(self->backlog);
+  if (oldest)
+    {
+      *sequence = oldest->sequence;
+      *offset = oldest->offset;
+      return;
+    }
+
+  *sequence = self->read_segment->sequence;
+  *offset = self->read_offset;
+}
+
+static void
+_reset(QDiskSegmented *self)
+{
+  QDiskSegmentedPosition *position;
+  while ((position = g_queue_pop_head(self->backlog)))
+    g_free(position);
+
+  QDiskSegment *segment;
+  while ((segment = g_queue_pop_head(self->segments)))
+    _segment_unref(segment);
+
+  _set_read_head(self, NULL, 0, 0);
+  self->backlog_count = 0;
+  self->length = 0;
+  self->used_space = 0;
+}
+
+static gboolean
+_load_segments(QDiskSegmented *self)
+{
+  gint64 head_sequence = 0;
+  gint64 head_offset = QDISK_SEGMENT_HEADER_SIZE;
+  gint64 head_index = -1;
+  gboolean has_manifest = _read_manifest(self, &head_sequence, &head_offset);
+
+  GArray *sequences = _list_segment_sequences(self);
+  if (!sequences)
+    return FALSE;
+
+  for (guint i = 0; i < sequences->len; i++)
+    {
+      gint64 sequence = g_array_index(sequences, gint64, i);
+
+      if (has_manifest && sequence < head_sequence)
+        {
+          /* acknowledged before the queue was stopped, but not removed yet */
+          gchar *filename = _build_segment_filename(self, sequence);
+          unlink(filename);
+          g_free(filename);
+          continue;
+        }
+
+      gint64 index;
+      QDiskSegment *segment = _open_segment(self, sequence, sequence == head_sequence ? head_offset : -1, &index);
+      if (!segment)
+        {
+          _move_aside_corrupted_segment(self, sequence);
+          continue;
+        }
+
+      if (has_manifest && sequence == head_sequence)
+        head_index = index;
+
+      g_queue_push_tail(self->segments, segment);
+      self->used_space += segment->size;
+      self->length += segment->records;
+    }
+  g_array_free(sequences, TRUE);
+
+  if (g_queue_is_empty(self->segments) && !_create_segment(self, head_sequence))
+    return FALSE;
+
+  for (GList *l = self->segments->head; l != self->segments->tail; l = l->next)
+    ((QDiskSegment *) l->data)->sealed = TRUE;
+
+  QDiskSegment *first = g_queue_peek_head(self->segments);
+  if (has_manifest && first->sequence == head_sequence && head_index < 0)
+    {
+      msg_warning("The disk-queue manifest does not point to a record, replaying the whole segment",
+                  evt_tag_str("filename", first->filename),
+                  evt_tag_long("offset", head_offset));
+    }
+
+  if (first->sequence == head_sequence && head_index >= 0)
+    _set_read_head(self, first, head_offset, head_index);
+  else
+    _set_read_head(self, first, QDISK_SEGMENT_HEADER_SIZE, 0);
+
+  self->length -= self->read_index;
+  return TRUE;
+}
+
+gboolean
+qdisk_segmented_start(QDiskSegmented *self)
+{
+  g_assert(!self->started);
+
+  if (self->options->capacity_bytes <= 0)
+    {
+      msg_error("Error starting segmented disk-queue, capacity-bytes must be set",
+                evt_tag_str("dirname", self->dirname));
+      return FALSE;
+    }
+
+  if (g_mkdir_with_parents(self->dirname, 0700) < 0)
+    {
+      msg_error("Error creating segmented disk-queue directory",
+                evt_tag_str("dirname", self->dirname),
+                evt_tag_error("error"));
+      return FALSE;
+    }
+
+  if (!_load_segments(self))
+    {
+      _reset(self);
+      return FALSE;
+    }
+
+  msg_info("Segmented disk-queue started",
+           evt_tag_str("dirname", self->dirname),
+           evt_tag_long("segments", g_queue_get_length(self->segments)),
+           evt_tag_long("queue_length", self->length));
+
+  self->started = TRUE;
+  return TRUE;
+}
+
+void
+qdisk_segmented_stop(QDiskSegmented *self)
+{
+  if (!self->started)
+    return;
+
+  gint64 head_sequence, head_offset;
+  _get_ack_head(self, &head_sequence, &head_offset);
+  _write_manifest(self, head_sequence, head_offset);
+
+  QDiskSegment *tail = g_queue_peek_tail(self->segments);
+  if (_sync_fd(tail->fd) < 0)
+    {
+      msg_error("Error syncing disk-queue segment",
+                evt_tag_str("filename", tail->filename),
+                evt_tag_error("error"));
+    }
+
+  _reset(self);
+  self->generation++;
+  self->started = FALSE;
+}
+
+gboolean
+qdisk_segmented_started(QDiskSegmented *self)
+{
+  return self->started;
+}
+
+/* seals the last segment, after which it is only read */
+static QDiskSegment *
+_start_new_segment(QDiskSegmented *self)
+{
+  QDiskSegment *tail = g_queue_peek_tail(self->segments);
+
+  if (_sync_fd(tail->fd) < 0)
+    {
+      msg_error("Error syncing disk-queue segment",
+                evt_tag_str("filename", tail->filename),
+                evt_tag_error("error"));
+    }
+
+  QDiskSegment *segment = _create_segment(self, tail->sequence + 1);
+  if (!segment)
+    return NULL;
+
+  tail->sealed = TRUE;
+  return segment;
+}
+
+static void
+_drop_acked_segments(QDiskSegmented *self)
+{
+  gint64 head_sequence, head_offset;
+  _get_ack_head(self, &head_sequence, &head_offset);
+
+  QDiskSegment *segment;
+  while ((segment = g_queue_peek_head(self->segments)) && segment->sequence < head_sequence)
+    {
+      g_queue_pop_head(self->segments);
+      _remove_segment(self, segment);
+    }
+}
+
+static inline gboolean
+_is_space_avail(QDiskSegmented *self, gint64 at_least)
+{
+  return self->used_space + at_least <= self->options->capacity_bytes;
+}
+
+/*
+ * If every record is acknowledged, the last segment only holds consumed
+ * records, but as it is still written, it cannot be removed.  Before the
+ * next record is written, a new segment is started to make it removable,
+ * if the consumed records take up half a segment or the space is needed.
+ */
+static void
+_recycle_consumed_tail(QDiskSegmented *self, gint64 record_length)
+{
+  QDiskSegment *tail = g_queue_peek_tail(self->segments);
+
+  if (self->length > 0 || !g_queue_is_empty(self->backlog) || tail->size == QDISK_SEGMENT_HEADER_SIZE)
+    return;
+
+  if (tail->size < self->options->segment_size / 2 && _is_space_avail(self, record_length))
+    return;
+
+  QDiskSegment *segment = _start_new_segment(self);
+  if (!segment)
+    return;
+
+  _set_read_head(self, segment, QDISK_SEGMENT_HEADER_SIZE, 0);
+  _drop_acked_segments(self);
+}
+
+gboolean
+qdisk_segmented_push_tail(QDiskSegmented *self, GString *record)
+{
+  _recycle_consumed_tail(self, record->len);
+
+  QDiskSegment *tail = g_queue_peek_tail(self->segments);
+  gboolean needs_new_segment = tail->size > QDISK_SEGMENT_HEADER_SIZE &&
+                               tail->size + (gint64) record->len > self->options->segment_size;
+
+  if (!_is_space_avail(self, record->len + (needs_new_segment ? QDISK_SEGMENT_HEADER_SIZE : 0)))
+    return FALSE;
+
+  if (needs_new_segment)
+    {
+      tail = _start_new_segment(self);
+      if (!tail)
+        return FALSE;
+    }
+
+  if (!_pwrite_all(tail->fd, record->str, record->len, tail->size))
+    {
+      msg_error("Error writing disk-queue segment",
+                evt_tag_str("filename", tail->filename),
+                evt_tag_error("error"));
+
+      /* cut off what was written of the record, so the next one starts at the right position */
+      if (ftruncate(tail->fd, tail->size) < 0)
+        {
+          msg_error("Error truncating disk-queue segment",
+                    evt_tag_str("filename", tail->filename),
+                    evt_tag_error("error"));
+        }
+      return FALSE;
+    }
+
+  tail->size += record->len;
+  tail->records++;
+  self->used_space += record->len;
+  self->length++;
+  return TRUE;
+}
+
+static void
+_move_read_head_to_next_segment(QDiskSegmented *self)
+{
+  GList *link = g_queue_find(self->segments, self->read_segment);
+  g_assert(link && link->next);
+
+  _set_read_head(self, link->next->data, QDISK_SEGMENT_HEADER_SIZE, 0);
+}
+
+/* a record cannot be trusted, and neither can the ones after it in the same segment */
+static void
+_drop_rest_of_segment(QDiskSegmented *self)
+{
+  QDiskSegment *segment = self->read_segment;
+  gint64 lost_records = segment->records - self->read_index;
+
+  msg_error("Cannot read correct record from disk-queue segment, dropping the rest of the segment",
+            evt_tag_str("filename", segment->filename),
+            evt_tag_long("offset", self->read_offset),
+            evt_tag_long("lost_records", lost_records));
+
+  if (ftruncate(segment->fd, self->read_offset) < 0)
+    {
+      msg_error("Error truncating disk-queue segment",
+                evt_tag_str("filename", segment->filename),
+                evt_tag_error("error"));
+    }
+
+  self->length -= lost_records;
+  self->used_space -= segment->size - self->read_offset;
+  segment->records = self->read_index;
+  segment->size = self->read_offset;
+}
+
+/* moves the read head to the next record if it is at the end of a sealed segment */
+static gboolean
+_seek_to_next_record(QDiskSegmented *self, guint32 *record_length)
+{
+  while (self->length > 0)
+    {
+      QDiskSegment *segment = self->read_segment;
+
+      if (self->read_offset >= segment->size)
+        {
+          if (!segment->sealed)
+            return FALSE;
+
+          _move_read_head_to_next_segment(self);
+          continue;
+        }
+
+      guint32 length;
+      if (_pread_all(segment->fd, &length, sizeof(length), self->read_offset))
+        {
+          *record_length = GUINT32_FROM_BE(length);
+          if (_is_record_length_valid(*record_length) &&
+              self->read_offset + (gint64) sizeof(length) + *record_length <= segment->size)
+            return TRUE;
+        }
+
+      _drop_rest_of_segment(self);
+    }
+
+  return FALSE;
+}
+
+gboolean
+qdisk_segmented_peek_head(QDiskSegmented *self, GString *record)
+{
+  guint32 record_length;
+  if (!_seek_to_next_record(self, &record_length))
+    return FALSE;
+
+  g_string_set_size(record, record_length);
+  return _pread_all(self->read_segment->fd, record->str, record_length, self->read_offset + sizeof(guint32));
+}
+
+gboolean
+qdisk_segmented_prepare_read(QDiskSegmented *self, QDiskSegmentedReadPoint *point)
+{
+  guint32 record_length;
+  if (!_seek_to_next_record(self, &record_length))
+    return FALSE;
+
+  QDiskSegmentedPosition *position = g_new0(QDiskSegmentedPosition, 1);
+  position->sequence = self->read_segment->sequence;
+  position->offset = self->read_offset;
+  position->index = self->read_index;
+  g_queue_push_tail(self->backlog, position);
+  self->backlog_count++;
+
+  point->generation = self->generation;
+  point->segment = _segment_ref(self->read_segment);
+  point->backlog_entry = position;
+  point->position = self->read_offset + sizeof(guint32);
+  point->record_length = record_length;
+
+  self->read_offset = point->position + record_length;
+  self->read_index++;
+  self->length--;
+  return TRUE;
+}
+
+gboolean
+qdisk_segmented_read_prepared(QDiskSegmented *self, QDiskSegmentedReadPoint *point, GString *record)
+{
+  g_string_set_size(record, point->record_length);
+  if (!_pread_all(point->segment->fd, record->str, point->record_length, point->position))
+    {
+      msg_error("Error reading disk-queue segment",
+                evt_tag_str("filename", point->segment->filename),
+                evt_tag_long("offset", point->position),
+                evt_tag_error("error"));
+      return FALSE;
+    }
+
+  return TRUE;
+}
+
+void
+qdisk_segmented_discard_prepared(QDiskSegmented *self, QDiskSegmentedReadPoint *point)
+{
+  if (point->generation != self->generation)
+    return;
+
+  QDiskSegmentedPosition *position = point->backlog_entry;
+
+  g_assert(!position->discarded);
+  position->discarded = TRUE;
+  self->backlog_count--;
+}
+
+void
+qdisk_segmented_release_read_point(QDiskSegmentedReadPoint *point)
+{
+  _segment_unref(point->segment);
+  point->segment = NULL;
+  point->backlog_entry = NULL;
+}
+
+/* removes the discarded records from the head of the backlog, they are never acknowledged */
+static void
+_skip_discarded_backlog_head(QDiskSegmented *self)
+{
+  QDiskSegmentedPosition *position;
+  while ((position = g_queue_peek_head(self->backlog)) && position->discarded)
+    g_free(g_queue_pop_head(self->backlog));
+}
+
+void
+qdisk_segmented_ack_backlog(QDiskSegmented *self, guint num_records)
+{
+  for (guint i = 0; i < num_records && self->backlog_count > 0; i++)
+    {
+      _skip_discarded_backlog_head(self);
+      g_free(g_queue_pop_head(self->backlog));
+      self->backlog_count--;
+    }
+  _skip_discarded_backlog_head(self);
+
+  _drop_acked_segments(self);
+}
+
+guint
+qdisk_segmented_rewind_backlog(QDiskSegmented *self, guint num_records)
+{
+  QDiskSegmentedPosition *oldest = NULL;
+  guint rewound = 0;
+  gint64 popped = 0;
+
+  while (rewound < num_records && !g_queue_is_empty(self->backlog))
+    {
+      g_free(oldest);
+      oldest = g_queue_pop_tail(self->backlog);
+      popped++;
+      if (!oldest->discarded)
+        rewound++;
+    }
+
+  if (!oldest)
+    return 0;
+
+  QDiskSegment *segment = _find_segment(self, oldest->sequence);
+  g_assert(segment);
+
+  _set_read_head(self, segment, oldest->offset, oldest->index);
+  self->backlog_count -= rewound;
+  /* discarded records are read, and discarded, again */
+  self->length += popped;
+  g_free(oldest);
+
+  return rewound;
+}
+
+const gchar *
+qdisk_segmented_get_dirname(QDiskSegmented *self)
+{
+  return self->dirname;
+}
+
+gint64
+qdisk_segmented_get_length(QDiskSegmented *self)
+{
+  return self->length;
+}
+
+gint64
+qdisk_segmented_get_backlog_count(QDiskSegmented *self)
+{
+  return self->backlog_count;
+}
+
+gint64
+qdisk_segmented_get_segment_count(QDiskSegmented *self)
+{
+  return g_queue_get_length(self->segments);
+}
+
+gint64
+qdisk_segmented_get_used_space(QDiskSegmented *self)
+{
+  return self->used_space;
+}
+
+gint64
+qdisk_segmented_get_max_useful_space(QDiskSegmented *self)
+{
+  return self->options->capacity_bytes;
+}
+
+QDiskSegmented *
+qdisk_segmented_new(DiskQueueOptions *options, const gchar *dirname)
+{
+  QDiskSegmented *self = g_new0(QDiskSegmented, 1);
+
+  self->options = options;
+  self->dirname = g_strdup(dirname);
+  self->segments = g_queue_new();
+  self->backlog = g_queue_new();
+  return self;
+}
+
+void
+qdisk_segmented_free(QDiskSegmented *self)
+{
+  g_assert(!self->started);
+
+  g_queue_free(self->segments);
+  g_queue_free(self->backlog);
+  g_free(self->dirname);
+  g_free(self);
+}
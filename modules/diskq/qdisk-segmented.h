@@ -0,0 +1,89 @@
+/*
+ * Copyright (c) 2024 One Identity LLC.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#ifndef QDISK_SEGMENTED_H_
+#define QDISK_SEGMENTED_H_
+
+#include "syslog-ng.h"
+#include "diskq-options.h"
+
+/*
+ * A disk-buffer stored as a directory of append-only segment files instead
+ * of a single ring file.  New records are appended to the last segment,
+ * which is sealed once it reaches segment-size(), and a new one is started.
+ * Segments that only contain acknowledged records are unlinked as a whole,
+ * so releasing consumed data never rewrites or truncates a file.
+ *
+ * The "manifest" file stores the position of the first unacknowledged
+ * record, it is written when the queue is stopped.  After a crash the
+ * queue restarts from an older position, so some acknowledged records of
+ * the first segment may be delivered again, but nothing is lost.
+ *
+ * Every function has to be called with the lock of the owning queue held,
+ * except qdisk_segmented_read_prepared(), which reads a record reserved by
+ * qdisk_segmented_prepare_read() without holding it:
+ *
+ *   qdisk_segmented_prepare_read()       lock held, returns FALSE if there is nothing to read
+ *   qdisk_segmented_read_prepared()      without the lock
+ *   qdisk_segmented_discard_prepared()   lock held, only if the record could not be used
+ *   qdisk_segmented_release_read_point() lock held
+ *
+ * The read point is only discarded if the queue was not stopped since it
+ * was prepared.  Reserved records are part of the backlog, they are removed by
+ * qdisk_segmented_ack_backlog() or returned by qdisk_segmented_rewind_backlog().
+ */
+
+typedef struct _QDiskSegmented QDiskSegmented;
+typedef struct _QDiskSegment QDiskSegment;
+
+typedef struct _QDiskSegmentedReadPoint
+{
+  guint64 generation;
+  QDiskSegment *segment;
+  gpointer backlog_entry;
+  gint64 position;
+  guint32 record_length;
+} QDiskSegmentedReadPoint;
+
+QDiskSegmented *qdisk_segmented_new(DiskQueueOptions *options, const gchar *dirname);
+gboolean qdisk_segmented_start(QDiskSegmented *self);
+void qdisk_segmented_stop(QDiskSegmented *self);
+gboolean qdisk_segmented_started(QDiskSegmented *self);
+void qdisk_segmented_free(QDiskSegmented *self);
+
+gboolean qdisk_segmented_push_tail(QDiskSegmented *self, GString *record);
+gboolean qdisk_segmented_peek_head(QDiskSegmented *self, GString *record);
+gboolean qdisk_segmented_prepare_read(QDiskSegmented *self, QDiskSegmentedReadPoint *point);
+gboolean qdisk_segmented_read_prepared(QDiskSegmented *self, QDiskSegmentedReadPoint *point, GString *record);
+void qdisk_segmented_discard_prepared(QDiskSegmented *self, QDiskSegmentedReadPoint *point);
+void qdisk_segmented_release_read_point(QDiskSegmentedReadPoint *point);
+void qdisk_segmented_ack_backlog(QDiskSegmented *self, guint num_records);
+guint qdisk_segmented_rewind_backlog(QDiskSegmented *self, guint num_records);
+
+const gchar *qdisk_segmented_get_dirname(QDiskSegmented *self);
+gint64 qdisk_segmented_get_length(QDiskSegmented *self);
+gint64 qdisk_segmented_get_backlog_count(QDiskSegmented *self);
+gint64 qdisk_segmented_get_segment_count(QDiskSegmented *self);
+gint64 qdisk_segmented_get_used_space(QDiskSegmented *self);
+gint64 qdisk_segmented_get_max_useful_space(QDiskSegmented *self);
+
+#endif /* QDISK_SEGMENTED_H_ */
@@ -41,14 +41,33 @@
 #include <sys/types.h>
 #include <sys/file.h>
 
+#ifdef SYSLOG_NG_HAVE_ZLIB
+#include <zlib.h>
+#endif
+
 /* MADV_RANDOM not defined on legacy Linux systems. Could be removed in the
  * future, when support for Glibc 2.1.X drops.*/
 #ifndef MADV_RANDOM
 #define MADV_RANDOM 1
 #endif
 
+#ifndef MADV_SEQUENTIAL
+#define MADV_SEQUENTIAL 2
+#endif
+
 #define MAX_RECORD_LENGTH 100 * 1024 * 1024
 
+/* The topmost bit of the record length marks records with a compressed
+ * payload, which starts with the uncompressed length of the record.  As it
+ * is above MAX_RECORD_LENGTH, older versions refuse such records instead of
+ * misinterpreting them. */
+#define QDISK_RECORD_COMPRESSED 0x80000000
+#define QDISK_RECORD_LENGTH_MASK (~QDISK_RECORD_COMPRESSED)
+#define QDISK_RECORD_MIN_COMPRESSIBLE_LENGTH 128
+
+/* size of the sliding read-only mapping used by mmap-replay() */
+#define QDISK_READ_MAP_SIZE (64 * 1024 * 1024)
+
 #define PATH_QDISK              PATH_LOCALSTATEDIR
 
 #define QDISK_HDR_VERSION_CURRENT 3
@@ -65,10 +84,30 @@
 #define QDISK_FILENAME_NON_REL_FMT QDISK_FILENAME_PREFIX QDISK_FILENAME_IDX_FMT QDISK_FILENAME_NON_REL_EXT
 #define QDISK_FILENAME_NON_REL_EXAMPLE QDISK_FILENAME_PREFIX QDISK_FILENAME_IDX_EXAMPLE QDISK_FILENAME_NON_REL_EXT
 
+#define QDISK_DIRNAME_SEGMENTED_EXT ".sqd"
+#define QDISK_DIRNAME_SEGMENTED_FMT QDISK_FILENAME_PREFIX QDISK_FILENAME_IDX_FMT QDISK_DIRNAME_SEGMENTED_EXT
+
 #define DIRLOCK_FILENAME "syslog-ng-disk-buffer.dirlock"
 
 static GMutex filename_lock;
 
+/*
+ * Reliable disk-buffers with group commit record the heads of the queue in
+ * one of two checkpoint slots after each successful sync.  The slots are
+ * written alternately, so a torn write can only damage the newer one, which
+ * is then rejected by its checksum.
+ */
+typedef struct _QDiskCheckpoint
+{
+  guint64 sequence;
+  gint64 read_head;
+  gint64 write_head;
+  gint64 length;
+  gint64 backlog_head;
+  gint64 backlog_len;
+  guint32 checksum;
+} QDiskCheckpoint;
+
 typedef union _QDiskFileHeader
 {
   struct
@@ -90,6 +129,10 @@ typedef union _QDiskFileHeader
 
     guint8 use_v1_wrap_condition;
     gint64 capacity_bytes;
+    guint8 compressed_records;
+
+    guint8 unclean_shutdown;
+    QDiskCheckpoint checkpoints[2];
   };
   gchar _pad2[QDISK_RESERVED_SPACE];
 } QDiskFileHeader;
@@ -102,6 +145,18 @@ struct _QDisk
   gint64 cached_file_size;
   QDiskFileHeader *hdr;
   DiskQueueOptions *options;
+
+  /* backlog head of the last checkpoint that reached the disk */
+  gint64 checkpoint_backlog_head;
+  /* changes whenever the heads are reset, invalidating pending sync points */
+  guint64 generation;
+
+  struct
+  {
+    gchar *addr;
+    gint64 offset;
+    gint64 file_size;
+  } read_map;
 };
 
 #define QDISK_ERROR qdisk_error_quark()
@@ -290,6 +345,50 @@ qdisk_get_next_filename(const gchar *dir, gboolean reliable)
   return filename;
 }
 
+gchar *
+qdisk_get_next_segmented_dirname(const gchar *dir)
+{
+  gint dirlock_fd;
+  if (!_grab_dirlock(dir, &dirlock_fd))
+    return NULL;
+
+  gchar *dirname = NULL;
+  for (gint i = 0; i < 10000; i++)
+    {
+      gchar dirname_buffer[256];
+      g_snprintf(dirname_buffer, sizeof(dirname_buffer), QDISK_DIRNAME_SEGMENTED_FMT, i);
+
+      dirname = g_build_path(G_DIR_SEPARATOR_S, dir, dirname_buffer, NULL);
+
+      struct stat st;
+      if (stat(dirname, &st) < 0)
+        break;
+
+      g_free(dirname);
+      dirname = NULL;
+    }
+
+  if (!dirname)
+    {
+      msg_error("Error generating unique queue dirname, not using disk queue");
+      _release_dirlock(dirlock_fd);
+      return NULL;
+    }
+
+  if (mkdir(dirname, 0700) < 0)
+    {
+      msg_error("Error creating segmented disk-queue directory",
+                evt_tag_str("dirname", dirname),
+                evt_tag_error("error"));
+      g_free(dirname);
+      _release_dirlock(dirlock_fd);
+      return NULL;
+    }
+
+  _release_dirlock(dirlock_fd);
+  return dirname;
+}
+
 gboolean
 qdisk_is_file_a_disk_buffer_file(const gchar *filename)
 {
@@ -348,10 +447,30 @@ qdisk_started(QDisk *self)
   return self->fd >= 0;
 }
 
+static inline gboolean
+_are_checkpoints_enabled(QDisk *self)
+{
+  return self->options->reliable && self->options->fsync_interval > 0 && !self->options->read_only;
+}
+
+/*
+ * The space released since the last durable checkpoint is not reused
+ * until the next one, as that checkpoint may still be restored after a
+ * crash and it refers to the records there.
+ */
+static inline gint64
+_get_reusable_space_head(QDisk *self)
+{
+  if (_are_checkpoints_enabled(self))
+    return self->checkpoint_backlog_head;
+
+  return self->hdr->backlog_head;
+}
+
 static inline gboolean
 _does_backlog_head_precede_write_head(QDisk *self)
 {
-  return self->hdr->backlog_head <= self->hdr->write_head;
+  return _get_reusable_space_head(self) <= self->hdr->write_head;
 }
 
 static inline gboolean
@@ -363,21 +482,21 @@ _is_write_head_less_than_max_size(QDisk *self)
 static inline gboolean
 _is_able_to_reset_write_head_to_beginning_of_qdisk(QDisk *self)
 {
-  return self->hdr->backlog_head != QDISK_RESERVED_SPACE;
+  return _get_reusable_space_head(self) != QDISK_RESERVED_SPACE;
 }
 
 static inline gboolean
 _is_free_space_between_write_head_and_backlog_head(QDisk *self, gint msg_len)
 {
   /* this forces 1 byte of empty space between backlog and write */
-  return self->hdr->write_head + msg_len < self->hdr->backlog_head;
+  return self->hdr->write_head + msg_len < _get_reusable_space_head(self);
 }
 
 static inline gboolean
 _is_free_space_at_the_beginning_of_qdisk(QDisk *self, gint msg_len)
 {
   /* this forces 1 byte of empty space between backlog and the beginning */
-  return QDISK_RESERVED_SPACE + msg_len < self->hdr->backlog_head;
+  return QDISK_RESERVED_SPACE + msg_len < _get_reusable_space_head(self);
 }
 
 gboolean
@@ -437,6 +556,7 @@ _maybe_truncate_file(QDisk *self, gint64 expected_size)
   if (ftruncate(self->fd, (off_t) expected_size) == 0)
     {
       self->cached_file_size = expected_size;
+      self->read_map.file_size = MIN(self->read_map.file_size, expected_size);
       return;
     }
 
@@ -555,7 +675,7 @@ gint64
 qdisk_get_empty_space(QDisk *self)
 {
   gint64 wpos = qdisk_get_writer_head(self);
-  gint64 bpos = qdisk_get_backlog_head(self);
+  gint64 bpos = _get_reusable_space_head(self);
   gint64 capacity_bytes = qdisk_get_maximum_size(self);
 
   if (wpos < capacity_bytes && bpos < capacity_bytes)
@@ -687,8 +807,51 @@ qdisk_get_next_tail_position(QDisk *self)
   return self->hdr->write_head;
 }
 
-gboolean
-qdisk_push_tail(QDisk *self, GString *record)
+#ifdef SYSLOG_NG_HAVE_ZLIB
+
+static GString *
+_compress_record(GString *record, GString *compressed_record)
+{
+  const gchar *payload = record->str + sizeof(guint32);
+  uLong payload_len = record->len - sizeof(guint32);
+
+  if (payload_len < QDISK_RECORD_MIN_COMPRESSIBLE_LENGTH)
+    return record;
+
+  uLongf compressed_len = compressBound(payload_len);
+  g_string_set_size(compressed_record, 2 * sizeof(guint32) + compressed_len);
+
+  if (compress2((Bytef *) compressed_record->str + 2 * sizeof(guint32), &compressed_len,
+                (const Bytef *) payload, payload_len, Z_BEST_SPEED) != Z_OK)
+    return record;
+
+  /* not worth it, keep the record as it is */
+  if (compressed_len + sizeof(guint32) >= payload_len)
+    return record;
+
+  guint32 frame[2] =
+  {
+    GUINT32_TO_BE((compressed_len + sizeof(guint32)) | QDISK_RECORD_COMPRESSED),
+    GUINT32_TO_BE(payload_len),
+  };
+  memcpy(compressed_record->str, frame, sizeof(frame));
+  g_string_truncate(compressed_record, sizeof(frame) + compressed_len);
+
+  return compressed_record;
+}
+
+#else
+
+static GString *
+_compress_record(GString *record, GString *compressed_record)
+{
+  return record;
+}
+
+#endif
+
+static gboolean
+_push_tail_record(QDisk *self, GString *record)
 {
   if (!qdisk_started(self))
     return FALSE;
@@ -739,7 +902,7 @@ qdisk_push_tail(QDisk *self, GString *record)
   /* NOTE: if these were equal, that'd mean the queue is empty, so we spoiled something */
   g_assert(self->hdr->write_head != self->hdr->backlog_head);
 
-  if (self->hdr->write_head > MAX(self->hdr->backlog_head, self->hdr->read_head))
+  if (self->hdr->write_head > MAX(_get_reusable_space_head(self), self->hdr->read_head))
     {
       if (self->cached_file_size > self->hdr->write_head)
         {
@@ -768,10 +931,28 @@ qdisk_push_tail(QDisk *self, GString *record)
   return TRUE;
 }
 
+gboolean
+qdisk_push_tail(QDisk *self, GString *record)
+{
+  if (!self->options->compression)
+    return _push_tail_record(self, record);
+
+  ScratchBuffersMarker marker;
+  GString *compressed_record = scratch_buffers_alloc_and_mark(&marker);
+  GString *record_to_write = _compress_record(record, compressed_record);
+
+  gboolean success = _push_tail_record(self, record_to_write);
+  if (success && record_to_write == compressed_record)
+    self->hdr->compressed_records = TRUE;
+
+  scratch_buffers_reclaim_marked(marker);
+  return success;
+}
+
 static inline gssize
-_read_record_length_from_disk(QDisk *self, gint64 position, guint32 *record_length)
+_read_record_length_from_disk(QDisk *self, gint fd, gint64 position, guint32 *record_length)
 {
-  gssize bytes_read = pread(self->fd, (gchar *)record_length, sizeof(guint32), position);
+  gssize bytes_read = pread(fd, (gchar *)record_length, sizeof(guint32), position);
 
   *record_length = GUINT32_FROM_BE(*record_length);
 
@@ -818,10 +999,14 @@ _is_record_length_valid(QDisk *self, gssize bytes_read, guint32 record_length, g
 }
 
 static inline gboolean
-_try_reading_record_length(QDisk *self, gint64 position, guint32 *record_length)
+_try_reading_record_length(QDisk *self, gint fd, gint64 position, guint32 *record_length, gboolean *compressed)
 {
   guint32 read_record_length;
-  gssize bytes_read = _read_record_length_from_disk(self, position, &read_record_length);
+  gssize bytes_read = _read_record_length_from_disk(self, fd, position, &read_record_length);
+
+  if (compressed)
+    *compressed = !!(read_record_length & QDISK_RECORD_COMPRESSED);
+  read_record_length &= QDISK_RECORD_LENGTH_MASK;
 
   if (!_is_record_length_valid(self, bytes_read, read_record_length, position))
     return FALSE;
@@ -831,11 +1016,11 @@ _try_reading_record_length(QDisk *self, gint64 position, guint32 *record_length)
 }
 
 static inline gboolean
-_read_record_from_disk(QDisk *self, GString *record, guint32 record_length)
+_read_raw_record_from_disk(QDisk *self, gint fd, gint64 position, GString *record, guint32 record_length)
 {
   g_string_set_size(record, record_length);
 
-  gssize bytes_read = pread(self->fd, record->str, record_length, self->hdr->read_head + sizeof(record_length));
+  gssize bytes_read = pread(fd, record->str, record_length, position + sizeof(record_length));
   if (bytes_read != record_length)
     {
       msg_error("Error reading disk-queue file",
@@ -849,6 +1034,69 @@ _read_record_from_disk(QDisk *self, GString *record, guint32 record_length)
   return TRUE;
 }
 
+#ifdef SYSLOG_NG_HAVE_ZLIB
+
+static gboolean
+_uncompress_record(QDisk *self, gint64 position, GString *record, GString *compressed_record)
+{
+  guint32 uncompressed_length;
+
+  if (compressed_record->len <= sizeof(uncompressed_length))
+    goto error;
+
+  memcpy(&uncompressed_length, compressed_record->str, sizeof(uncompressed_length));
+  uncompressed_length = GUINT32_FROM_BE(uncompressed_length);
+  if (uncompressed_length == 0 || _is_record_length_reached_hard_limit(uncompressed_length))
+    goto error;
+
+  g_string_set_size(record, uncompressed_length);
+
+  uLongf dest_len = uncompressed_length;
+  if (uncompress((Bytef *) record->str, &dest_len,
+                 (const Bytef *) compressed_record->str + sizeof(uncompressed_length),
+                 compressed_record->len - sizeof(uncompressed_length)) != Z_OK ||
+      dest_len != uncompressed_length)
+    goto error;
+
+  return TRUE;
+
+error:
+  msg_error("Error decompressing disk-queue record",
+            evt_tag_str("filename", self->filename),
+            evt_tag_long("offset", position));
+  return FALSE;
+}
+
+#else
+
+static gboolean
+_uncompress_record(QDisk *self, gint64 position, GString *record, GString *compressed_record)
+{
+  msg_error("Disk-queue file contains compressed records, but syslog-ng was compiled without zlib support",
+            evt_tag_str("filename", self->filename),
+            evt_tag_long("offset", position));
+  return FALSE;
+}
+
+#endif
+
+static gboolean
+_read_record_from_disk(QDisk *self, gint fd, gint64 position, GString *record, guint32 record_length,
+                       gboolean compressed)
+{
+  if (!compressed)
+    return _read_raw_record_from_disk(self, fd, position, record, record_length);
+
+  ScratchBuffersMarker marker;
+  GString *compressed_record = scratch_buffers_alloc_and_mark(&marker);
+
+  gboolean success = _read_raw_record_from_disk(self, fd, position, compressed_record, record_length)
+                     && _uncompress_record(self, position, record, compressed_record);
+
+  scratch_buffers_reclaim_marked(marker);
+  return success;
+}
+
 static inline void
 _maybe_apply_non_reliable_corrections(QDisk *self)
 {
@@ -882,6 +1130,141 @@ qdisk_get_next_head_position(QDisk *self)
   return next_read_head_position;
 }
 
+static void
+_unmap_read_window(QDisk *self)
+{
+  if (!self->read_map.addr)
+    return;
+
+  munmap(self->read_map.addr, QDISK_READ_MAP_SIZE);
+  self->read_map.addr = NULL;
+  self->read_map.offset = 0;
+  self->read_map.file_size = 0;
+}
+
+static gboolean
+_refresh_read_window_file_size(QDisk *self)
+{
+  struct stat st;
+  if (fstat(self->fd, &st) < 0)
+    return FALSE;
+
+  self->read_map.file_size = st.st_size;
+  return TRUE;
+}
+
+static inline gboolean
+_is_in_read_window(QDisk *self, gint64 position, gsize length)
+{
+  return self->read_map.addr &&
+         position >= self->read_map.offset &&
+         position + length <= self->read_map.offset + QDISK_READ_MAP_SIZE;
+}
+
+/*
+ * Accessing the mapping past the end of the file would raise SIGBUS, so
+ * a range is only usable when the file is known to cover it.
+ */
+static gboolean
+_map_read_window(QDisk *self, gint64 position, gsize length)
+{
+  if (!_is_in_read_window(self, position, length))
+    {
+      if (length > QDISK_READ_MAP_SIZE / 2)
+        return FALSE;
+
+      _unmap_read_window(self);
+
+      gint64 offset = position - position % sysconf(_SC_PAGESIZE);
+      gchar *addr = (gchar *) mmap(0, QDISK_READ_MAP_SIZE, PROT_READ, MAP_SHARED, self->fd, (off_t) offset);
+      if (addr == MAP_FAILED)
+        {
+          msg_debug("Error mapping disk-queue file for replay, falling back to regular reads",
+                    evt_tag_str("filename", self->filename),
+                    evt_tag_long("offset", offset),
+                    evt_tag_error("error"));
+          return FALSE;
+        }
+
+      madvise(addr, QDISK_READ_MAP_SIZE, MADV_SEQUENTIAL);
+      self->read_map.addr = addr;
+      self->read_map.offset = offset;
+      if (!_refresh_read_window_file_size(self))
+        return FALSE;
+    }
+
+  if (position + length > self->read_map.file_size &&
+      (!_refresh_read_window_file_size(self) || position + length > self->read_map.file_size))
+    return FALSE;
+
+  return TRUE;
+}
+
+static inline const gchar *
+_get_read_window_ptr(QDisk *self, gint64 position)
+{
+  return self->read_map.addr + (position - self->read_map.offset);
+}
+
+/* Compressed and invalid records are left to the regular read path. */
+static gboolean
+_try_reading_mapped_record(QDisk *self, const gchar **record, guint32 *record_length)
+{
+  gint64 position = self->hdr->read_head;
+  guint32 length;
+
+  if (!_map_read_window(self, position, sizeof(length)))
+    return FALSE;
+
+  memcpy(&length, _get_read_window_ptr(self, position), sizeof(length));
+  length = GUINT32_FROM_BE(length);
+
+  if (length == 0 || _is_record_length_reached_hard_limit(length))
+    return FALSE;
+
+  position += sizeof(length);
+  if (!_map_read_window(self, position, length))
+    return FALSE;
+
+  *record = _get_read_window_ptr(self, position);
+  *record_length = length;
+  return TRUE;
+}
+
+gboolean
+qdisk_pop_head_mapped(QDisk *self, GString *buffer, const gchar **record, gsize *record_length)
+{
+  if (!self->options->mmap_replay)
+    goto fallback;
+
+  if (self->hdr->read_head == self->hdr->write_head)
+    return FALSE;
+
+  if (self->hdr->read_head > self->hdr->write_head)
+    self->hdr->read_head = _correct_position_if_max_size_is_reached(self, self->hdr->read_head);
+
+  guint32 mapped_record_length;
+  if (!_try_reading_mapped_record(self, record, &mapped_record_length))
+    goto fallback;
+
+  *record_length = mapped_record_length;
+
+  _update_position_after_read(self, mapped_record_length, &self->hdr->read_head);
+  self->hdr->length--;
+  self->hdr->backlog_len++;
+
+  _maybe_apply_non_reliable_corrections(self);
+  return TRUE;
+
+fallback:
+  if (!qdisk_pop_head(self, buffer))
+    return FALSE;
+
+  *record = buffer->str;
+  *record_length = buffer->len;
+  return TRUE;
+}
+
 gboolean
 qdisk_peek_head(QDisk *self, GString *record)
 {
@@ -892,10 +1275,11 @@ qdisk_peek_head(QDisk *self, GString *record)
     self->hdr->read_head = _correct_position_if_max_size_is_reached(self, self->hdr->read_head);
 
   guint32 record_length;
-  if (!_try_reading_record_length(self, self->hdr->read_head, &record_length))
+  gboolean compressed;
+  if (!_try_reading_record_length(self, self->fd, self->hdr->read_head, &record_length, &compressed))
     return FALSE;
 
-  if (!_read_record_from_disk(self, record, record_length))
+  if (!_read_record_from_disk(self, self->fd, self->hdr->read_head, record, record_length, compressed))
     return FALSE;
 
   return TRUE;
@@ -911,10 +1295,11 @@ qdisk_pop_head(QDisk *self, GString *record)
     self->hdr->read_head = _correct_position_if_max_size_is_reached(self, self->hdr->read_head);
 
   guint32 record_length;
-  if (!_try_reading_record_length(self, self->hdr->read_head, &record_length))
+  gboolean compressed;
+  if (!_try_reading_record_length(self, self->fd, self->hdr->read_head, &record_length, &compressed))
     return FALSE;
 
-  if (!_read_record_from_disk(self, record, record_length))
+  if (!_read_record_from_disk(self, self->fd, self->hdr->read_head, record, record_length, compressed))
     return FALSE;
 
   _update_position_after_read(self, record_length, &self->hdr->read_head);
@@ -925,6 +1310,77 @@ qdisk_pop_head(QDisk *self, GString *record)
   return TRUE;
 }
 
+/*
+ * Reading ahead of the head does not follow the legacy (v1) wrap
+ * condition, as that is only resolved once the read head itself wraps.
+ */
+gboolean
+qdisk_prepare_read(QDisk *self, gint64 position, QDiskReadPoint *point)
+{
+  if (self->hdr->use_v1_wrap_condition)
+    return FALSE;
+
+  if (position > self->hdr->write_head)
+    position = _correct_position_if_max_size_is_reached(self, position);
+
+  if (position == self->hdr->write_head)
+    return FALSE;
+
+  point->generation = self->generation;
+  point->fd = self->fd;
+  point->position = position;
+  point->record_length = 0;
+  return TRUE;
+}
+
+/*
+ * The records before the write head are not written again until they are
+ * acked, and a reset of the file is detected by qdisk_finish_read(), so
+ * nothing here needs the lock.
+ */
+gboolean
+qdisk_read_prepared(QDisk *self, QDiskReadPoint *point, GString *record)
+{
+  gboolean compressed;
+
+  if (!_try_reading_record_length(self, point->fd, point->position, &point->record_length, &compressed))
+    return FALSE;
+
+  return _read_record_from_disk(self, point->fd, point->position, record, point->record_length, compressed);
+}
+
+static inline gboolean
+_is_read_point_current(QDisk *self, const QDiskReadPoint *point)
+{
+  return qdisk_started(self) && point->generation == self->generation && point->record_length > 0;
+}
+
+gboolean
+qdisk_finish_read(QDisk *self, const QDiskReadPoint *point, gint64 *next_position)
+{
+  if (!_is_read_point_current(self, point))
+    return FALSE;
+
+  *next_position = point->position;
+  _update_position_after_read(self, point->record_length, next_position);
+  return TRUE;
+}
+
+gboolean
+qdisk_pop_prepared_head(QDisk *self, const QDiskReadPoint *point)
+{
+  if (!_is_read_point_current(self, point) || qdisk_get_next_head_position(self) != point->position)
+    return FALSE;
+
+  self->hdr->read_head = point->position;
+  _update_position_after_read(self, point->record_length, &self->hdr->read_head);
+  self->hdr->length--;
+  self->hdr->backlog_len++;
+
+  _maybe_apply_non_reliable_corrections(self);
+  return TRUE;
+}
+
 static gboolean
 _skip_record(QDisk *self, gint64 position, gint64 *new_position)
 {
@@ -937,7 +1393,7 @@ _skip_record(QDisk *self, gint64 position, gint64 *new_position)
   *new_position = position;
 
   guint32 record_length;
-  if (!_try_reading_record_length(self, *new_position, &record_length))
+  if (!_try_reading_record_length(self, self->fd, *new_position, &record_length, NULL))
     return FALSE;
 
   _update_position_after_read(self, record_length, new_position);
@@ -1001,6 +1457,269 @@ qdisk_rewind_backlog(QDisk *self, guint rewind_count)
   return TRUE;
 }
 
+static guint32
+_calculate_checkpoint_checksum(const QDiskCheckpoint *checkpoint)
+{
+  const guint8 *data = (const guint8 *) checkpoint;
+  gsize length = G_STRUCT_OFFSET(QDiskCheckpoint, checksum);
+  guint32 hash = 2166136261U;
+
+  /* FNV-1a */
+  for (gsize i = 0; i < length; i++)
+    {
+      hash ^= data[i];
+      hash *= 16777619U;
+    }
+
+  return hash;
+}
+
+static inline gboolean
+_is_checkpoint_valid(const QDiskCheckpoint *checkpoint)
+{
+  return checkpoint->sequence > 0 && checkpoint->checksum == _calculate_checkpoint_checksum(checkpoint);
+}
+
+static QDiskCheckpoint *
+_get_latest_checkpoint(QDisk *self)
+{
+  QDiskCheckpoint *latest = NULL;
+
+  for (gsize i = 0; i < G_N_ELEMENTS(self->hdr->checkpoints); i++)
+    {
+      QDiskCheckpoint *checkpoint = &self->hdr->checkpoints[i];
+
+      if (_is_checkpoint_valid(checkpoint) && (!latest || checkpoint->sequence > latest->sequence))
+        latest = checkpoint;
+    }
+
+  return latest;
+}
+
+static gboolean
+_msync_header(QDisk *self, gpointer hdr)
+{
+  if (msync(hdr, sizeof(QDiskFileHeader), MS_SYNC) < 0)
+    {
+      msg_error("Error syncing disk-queue file header",
+                evt_tag_str("filename", self->filename),
+                evt_tag_error("error"));
+      return FALSE;
+    }
+
+  return TRUE;
+}
+
+static gboolean
+_sync_header(QDisk *self)
+{
+  return _msync_header(self, self->hdr);
+}
+
+static inline gboolean
+_is_sync_point_current(QDisk *self, const QDiskSyncPoint *point)
+{
+  return qdisk_started(self) && point->generation == self->generation;
+}
+
+void
+qdisk_prepare_sync(QDisk *self, QDiskSyncPoint *point)
+{
+  point->generation = self->generation;
+  point->fd = self->fd;
+  point->hdr = self->hdr;
+  point->read_head = self->hdr->read_head;
+  point->write_head = self->hdr->write_head;
+  point->length = self->hdr->length;
+  point->backlog_head = self->hdr->backlog_head;
+  point->backlog_len = self->hdr->backlog_len;
+}
+
+gboolean
+qdisk_sync_data(QDisk *self, const QDiskSyncPoint *point)
+{
+#if SYSLOG_NG_HAVE_FDATASYNC
+  gint result = fdatasync(point->fd);
+#else
+  gint result = fsync(point->fd);
+#endif
+
+  if (result < 0)
+    {
+      msg_error("Error syncing disk-queue file",
+                evt_tag_str("filename", self->filename),
+                evt_tag_error("error"));
+      return FALSE;
+    }
+
+  return TRUE;
+}
+
+/*
+ * The checkpoint is only written once the records it covers are on the
+ * disk, so it is always safe to restore after a crash.
+ */
+gboolean
+qdisk_write_checkpoint(QDisk *self, const QDiskSyncPoint *point)
+{
+  if (!_are_checkpoints_enabled(self) || !_is_sync_point_current(self, point))
+    return FALSE;
+
+  QDiskCheckpoint *latest = _get_latest_checkpoint(self);
+  guint64 sequence = latest ? latest->sequence + 1 : 1;
+  QDiskCheckpoint *checkpoint = &self->hdr->checkpoints[sequence % G_N_ELEMENTS(self->hdr->checkpoints)];
+
+  checkpoint->sequence = sequence;
+  checkpoint->read_head = point->read_head;
+  checkpoint->write_head = point->write_head;
+  checkpoint->length = point->length;
+  checkpoint->backlog_head = point->backlog_head;
+  checkpoint->backlog_len = point->backlog_len;
+  checkpoint->checksum = _calculate_checkpoint_checksum(checkpoint);
+  return TRUE;
+}
+
+gboolean
+qdisk_sync_checkpoint(QDisk *self, const QDiskSyncPoint *point)
+{
+  return _msync_header(self, point->hdr);
+}
+
+/* the space acked before a checkpoint becomes reusable once the checkpoint is synced */
+void
+qdisk_commit_checkpoint(QDisk *self, const QDiskSyncPoint *point)
+{
+  if (_is_sync_point_current(self, point))
+    self->checkpoint_backlog_head = point->backlog_head;
+}
+
+static void
+_checkpoint(QDisk *self)
+{
+  QDiskSyncPoint point;
+
+  qdisk_prepare_sync(self, &point);
+  if (qdisk_write_checkpoint(self, &point) && qdisk_sync_checkpoint(self, &point))
+    qdisk_commit_checkpoint(self, &point);
+}
+
+/*
+ * The header is mmapped, so after a power loss it may have reached the
+ * disk with heads pointing past the last sync: the records written after
+ * the checkpoint may be missing or partially written.  They are kept only
+ * if every one of them can be read back and they end exactly at the write
+ * head.
+ */
+static gboolean
+_are_records_after_checkpoint_intact(QDisk *self, const QDiskCheckpoint *checkpoint)
+{
+  if (self->hdr->use_v1_wrap_condition)
+    return checkpoint->write_head == self->hdr->write_head;
+
+  ScratchBuffersMarker marker;
+  GString *record = scratch_buffers_alloc_and_mark(&marker);
+  gint64 position = checkpoint->write_head;
+  gboolean wrapped = FALSE;
+  gboolean intact = TRUE;
+
+  while (position != self->hdr->write_head)
+    {
+      if (position > self->hdr->write_head && _has_position_reached_max_size(self, position))
+        {
+          if (wrapped)
+            {
+              intact = FALSE;
+              break;
+            }
+          position = QDISK_RESERVED_SPACE;
+          wrapped = TRUE;
+          continue;
+        }
+
+      guint32 record_length;
+      gboolean compressed;
+      if (!_try_reading_record_length(self, self->fd, position, &record_length, &compressed) ||
+          !_read_record_from_disk(self, self->fd, position, record, record_length, compressed))
+        {
+          intact = FALSE;
+          break;
+        }
+
+      gint64 next_position = position + record_length + sizeof(record_length);
+      if (position < self->hdr->write_head && next_position > self->hdr->write_head)
+        {
+          intact = FALSE;
+          break;
+        }
+      position = next_position;
+    }
+
+  scratch_buffers_reclaim_marked(marker);
+  return intact;
+}
+
+/*
+ * A crash may leave a header behind with damaged heads, or with heads that
+ * refer to records that never reached the disk.  The heads are kept as
+ * long as they are consistent and the records written after the last
+ * checkpoint are intact; otherwise the last checkpoint is restored: the
+ * records it covers were synced, and the space released after it has not
+ * been reused yet.  The messages written after it were not acked yet.
+ */
+static void
+_maybe_restore_checkpoint(QDisk *self)
+{
+  if (!_are_checkpoints_enabled(self) || !self->hdr->unclean_shutdown)
+    return;
+
+  QDiskCheckpoint *checkpoint = _get_latest_checkpoint(self);
+  if (!checkpoint)
+    return;
+
+  if (!qdisk_header_is_inconsistent(self))
+    {
+      if (_are_records_after_checkpoint_intact(self, checkpoint))
+        return;
+
+      msg_warning("Unsynced records are damaged after an unclean shutdown, restoring the last disk-buffer checkpoint",
+                  evt_tag_str("filename", self->filename),
+                  evt_tag_long("write_head", self->hdr->write_head),
+                  evt_tag_long("checkpoint_write_head", checkpoint->write_head));
+    }
+
+  msg_warning("Inconsistent header after an unclean shutdown, restoring the last disk-buffer checkpoint",
+              evt_tag_str("filename", self->filename),
+              evt_tag_long("read_head", checkpoint->read_head),
+              evt_tag_long("write_head", checkpoint->write_head),
+              evt_tag_long("queue_length", checkpoint->length),
+              evt_tag_long("backlog_head", checkpoint->backlog_head),
+              evt_tag_long("backlog_len", checkpoint->backlog_len));
+
+  self->hdr->read_head = checkpoint->read_head;
+  self->hdr->write_head = checkpoint->write_head;
+  self->hdr->length = checkpoint->length;
+  self->hdr->backlog_head = checkpoint->backlog_head;
+  self->hdr->backlog_len = checkpoint->backlog_len;
+}
+
+gboolean
+qdisk_sync(QDisk *self)
+{
+  if (!qdisk_started(self))
+    return FALSE;
+
+  QDiskSyncPoint point;
+  qdisk_prepare_sync(self, &point);
+
+  if (!qdisk_sync_data(self, &point))
+    return FALSE;
+
+  if (qdisk_write_checkpoint(self, &point) && qdisk_sync_checkpoint(self, &point))
+    qdisk_commit_checkpoint(self, &point);
+
+  return TRUE;
+}
+
 void
 qdisk_empty_backlog(QDisk *self)
 {
@@ -1048,6 +1767,19 @@ exit:
   return *error == NULL;
 }
 
+gboolean
+qdisk_deserialize_buffer(const gchar *serialized, gsize serialized_len, QDiskDeSerializeFunc deserialize_func,
+                         gpointer user_data, GError **error)
+{
+  SerializeArchive *sa = serialize_buffer_archive_new((gchar *) serialized, serialized_len);
+
+  if (!deserialize_func(sa, user_data))
+    g_set_error(error, QDISK_ERROR, QDISK_ERROR_DESERIALIZE, "failed to deserialize data");
+
+  serialize_archive_free(sa);
+  return *error == NULL;
+}
+
 gboolean
 qdisk_deserialize(GString *serialized, QDiskDeSerializeFunc deserialize_func, gpointer user_data, GError **error)
 {
@@ -1341,6 +2073,8 @@ _save_state(QDisk *self, GQueue *front_cache, GQueue *backlog, GQueue *flow_cont
 static void
 _close_file(QDisk *self)
 {
+  _unmap_read_window(self);
+
   if (self->hdr)
     {
       if (self->options->read_only)
@@ -1358,6 +2092,7 @@ _close_file(QDisk *self)
     }
 
   self->cached_file_size = 0;
+  self->generation++;
 }
 
 static void
@@ -1382,6 +2117,9 @@ _ensure_header_byte_order(QDisk *self)
       self->hdr->backlog_len = GUINT64_SWAP_LE_BE(self->hdr->backlog_len);
       self->hdr->capacity_bytes = GUINT64_SWAP_LE_BE(self->hdr->capacity_bytes);
       self->hdr->big_endian = (G_BYTE_ORDER == G_BIG_ENDIAN);
+
+      /* checkpoints are only used for crash recovery on the same host */
+      memset(self->hdr->checkpoints, 0, sizeof(self->hdr->checkpoints));
     }
 }
 
@@ -1523,6 +2261,8 @@ _load_header(QDisk *self)
       return FALSE;
     }
 
+  _maybe_restore_checkpoint(self);
+
   if (qdisk_header_is_inconsistent(self))
     {
       msg_error("Inconsistent header data in disk-queue file, ignoring",
@@ -1555,7 +2295,8 @@ _load_state(QDisk *self, GQueue *front_cache, GQueue *backlog, GQueue *flow_cont
 
       msg_info("Disk-buffer state loaded",
                evt_tag_str("filename", self->filename),
-               evt_tag_long("number_of_messages", _number_of_messages(self)));
+               evt_tag_long("number_of_messages", _number_of_messages(self)),
+               evt_tag_int("compressed_records", self->hdr->compressed_records));
 
       msg_debug("Disk-buffer internal state",
                 evt_tag_str("filename", self->filename),
@@ -1576,7 +2317,8 @@ _load_state(QDisk *self, GQueue *front_cache, GQueue *backlog, GQueue *flow_cont
       self->cached_file_size = st.st_size;
       msg_info("Reliable disk-buffer state loaded",
                evt_tag_str("filename", self->filename),
-               evt_tag_long("number_of_messages", _number_of_messages(self)));
+               evt_tag_long("number_of_messages", _number_of_messages(self)),
+               evt_tag_int("compressed_records", self->hdr->compressed_records));
 
       msg_debug("Reliable disk-buffer internal state",
                 evt_tag_str("filename", self->filename),
@@ -1733,14 +2475,23 @@ qdisk_start(QDisk *self, GQueue *front_cache, GQueue *backlog, GQueue *flow_cont
 
   struct stat st;
   gboolean file_exists = stat(self->filename, &st) != -1;
+  gboolean success;
 
   if (!file_exists)
-    return _create_qdisk_file(self);
+    success = _create_qdisk_file(self);
+  else if (st.st_size != 0)
+    success = _load_qdisk_file(self, front_cache, backlog, flow_control_window);
+  else
+    success = _init_qdisk_file_from_empty_file(self);
 
-  if (st.st_size != 0)
-    return _load_qdisk_file(self, front_cache, backlog, flow_control_window);
+  if (success && _are_checkpoints_enabled(self))
+    {
+      self->checkpoint_backlog_head = self->hdr->backlog_head;
+      self->hdr->unclean_shutdown = TRUE;
+      _checkpoint(self);
+    }
 
-  return _init_qdisk_file_from_empty_file(self);
+  return success;
 }
 
 gboolean
@@ -1751,6 +2502,12 @@ qdisk_stop(QDisk *self, GQueue *front_cache, GQueue *backlog, GQueue *flow_contr
   if (!self->options->read_only)
     result = _save_state(self, front_cache, backlog, flow_control_window);
 
+  if (result && _are_checkpoints_enabled(self))
+    {
+      self->hdr->unclean_shutdown = FALSE;
+      _sync_header(self);
+    }
+
   _close_file(self);
 
   return result;
@@ -1762,10 +2519,21 @@ qdisk_reset_file_if_empty(QDisk *self)
   if (!qdisk_is_file_empty(self))
     return;
 
+  gboolean heads_moved = self->hdr->read_head != QDISK_RESERVED_SPACE
+                         || self->hdr->write_head != QDISK_RESERVED_SPACE
+                         || self->hdr->backlog_head != QDISK_RESERVED_SPACE;
+
   self->hdr->read_head = QDISK_RESERVED_SPACE;
   self->hdr->write_head = QDISK_RESERVED_SPACE;
   self->hdr->backlog_head = QDISK_RESERVED_SPACE;
 
+  /* older checkpoints may point into the part of the file that gets truncated */
+  if (heads_moved)
+    {
+      self->generation++;
+      _checkpoint(self);
+    }
+
   _maybe_truncate_file(self, QDISK_RESERVED_SPACE);
 }
 
@@ -54,6 +54,51 @@ QDiskQueuePosition;
 
 typedef struct _QDisk QDisk;
 
+/*
+ * The state of the queue covered by a sync.  Syncing can be split into
+ * steps, so that the I/O does not have to happen with the queue lock held:
+ *
+ *   qdisk_prepare_sync()       lock held
+ *   qdisk_sync_data()          without the lock
+ *   qdisk_write_checkpoint()   lock held, returns FALSE if there is nothing to sync
+ *   qdisk_sync_checkpoint()    without the lock
+ *   qdisk_commit_checkpoint()  lock held
+ *
+ * Once the file is stopped or reset, the pending steps of an earlier sync
+ * point are no-ops.  qdisk_sync() does all of them in one go.
+ */
+typedef struct _QDiskSyncPoint
+{
+  guint64 generation;
+  gint fd;
+  gpointer hdr;
+  gint64 read_head;
+  gint64 write_head;
+  gint64 length;
+  gint64 backlog_head;
+  gint64 backlog_len;
+} QDiskSyncPoint;
+
+/*
+ * A record read ahead of the consumer.  The record is read without the
+ * queue lock held, in the same way as a sync:
+ *
+ *   qdisk_prepare_read()       lock held, returns FALSE if there is no record at the position
+ *   qdisk_read_prepared()      without the lock
+ *   qdisk_finish_read()        lock held, returns the position of the next record
+ *   qdisk_pop_prepared_head()  lock held, or moves the read head past the record
+ *
+ * The last two return FALSE if the file was stopped or reset since the
+ * read was prepared, the record must be thrown away then.
+ */
+typedef struct _QDiskReadPoint
+{
+  guint64 generation;
+  gint fd;
+  gint64 position;
+  guint32 record_length;
+} QDiskReadPoint;
+
 QDisk *qdisk_new(DiskQueueOptions *options, const gchar *file_id, const gchar *filename);
 
 gboolean qdisk_is_space_avail(QDisk *self, gint at_least);
@@ -62,10 +107,21 @@ gint64 qdisk_get_empty_space(QDisk *self);
 gint64 qdisk_get_used_useful_space(QDisk *self);
 gboolean qdisk_push_tail(QDisk *self, GString *record);
 gboolean qdisk_pop_head(QDisk *self, GString *record);
+gboolean qdisk_pop_head_mapped(QDisk *self, GString *buffer, const gchar **record, gsize *record_length);
 gboolean qdisk_peek_head(QDisk *self, GString *record);
 gboolean qdisk_remove_head(QDisk *self);
+gboolean qdisk_prepare_read(QDisk *self, gint64 position, QDiskReadPoint *point);
+gboolean qdisk_read_prepared(QDisk *self, QDiskReadPoint *point, GString *record);
+gboolean qdisk_finish_read(QDisk *self, const QDiskReadPoint *point, gint64 *next_position);
+gboolean qdisk_pop_prepared_head(QDisk *self, const QDiskReadPoint *point);
 gboolean qdisk_ack_backlog(QDisk *self);
 gboolean qdisk_rewind_backlog(QDisk *self, guint rewind_count);
+gboolean qdisk_sync(QDisk *self);
+void qdisk_prepare_sync(QDisk *self, QDiskSyncPoint *point);
+gboolean qdisk_sync_data(QDisk *self, const QDiskSyncPoint *point);
+gboolean qdisk_write_checkpoint(QDisk *self, const QDiskSyncPoint *point);
+gboolean qdisk_sync_checkpoint(QDisk *self, const QDiskSyncPoint *point);
+void qdisk_commit_checkpoint(QDisk *self, const QDiskSyncPoint *point);
 void qdisk_empty_backlog(QDisk *self);
 gint64 qdisk_get_next_tail_position(QDisk *self);
 gint64 qdisk_get_next_head_position(QDisk *self);
@@ -88,11 +144,14 @@ const gchar *qdisk_get_filename(QDisk *self);
 gint64 qdisk_get_file_size(QDisk *self);
 
 gchar *qdisk_get_next_filename(const gchar *dir, gboolean reliable);
+gchar *qdisk_get_next_segmented_dirname(const gchar *dir);
 gboolean qdisk_is_file_a_disk_buffer_file(const gchar *filename);
 gboolean qdisk_is_disk_buffer_file_reliable(const gchar *filename, gboolean *reliable);
 
 gboolean qdisk_serialize(GString *serialized, QDiskSerializeFunc serialize_func, gpointer user_data, GError **error);
 gboolean qdisk_deserialize(GString *serialized, QDiskDeSerializeFunc deserialize_func, gpointer user_data,
                            GError **error);
+gboolean qdisk_deserialize_buffer(const gchar *serialized, gsize serialized_len, QDiskDeSerializeFunc deserialize_func,
+                                  gpointer user_data, GError **error);
 
 #endif /* QDISK_H_ */
@@ -557,6 +557,119 @@ Test(diskq, test_no_next_filename_in_acquire)
   unlink(persist_filename);
 }
 
+static void
+_test_batch_push_and_pop(gboolean reliable, const gchar *filename)
+{
+  DiskQueueOptions options = {0};
+  LogQueue *q;
+
+  _construct_options(&options, 10000000, 100000, reliable);
+  unlink(filename);
+
+  StatsClusterKeyBuilder *driver_sck_builder = stats_cluster_key_builder_new();
+  StatsClusterKeyBuilder *queue_sck_builder = stats_cluster_key_builder_new();
+  if (reliable)
+    q = log_queue_disk_reliable_new(&options, filename, NULL, STATS_LEVEL0, driver_sck_builder, queue_sck_builder);
+  else
+    q = log_queue_disk_non_reliable_new(&options, filename, NULL, STATS_LEVEL0, driver_sck_builder, queue_sck_builder);
+  stats_cluster_key_builder_free(driver_sck_builder);
+  stats_cluster_key_builder_free(queue_sck_builder);
+
+  log_queue_disk_start(q);
+
+  fed_messages = 0;
+  acked_messages = 0;
+  feed_some_messages_in_batch(q, 100);
+  cr_assert_eq(log_queue_get_length(q), 100);
+  cr_assert_eq(stats_counter_get(q->metrics.shared.queued_messages), 100);
+
+  send_some_messages_in_batch(q, 30, 16, FALSE);
+  cr_assert_eq(stats_counter_get(q->metrics.shared.queued_messages), 70);
+  log_queue_rewind_backlog(q, 10);
+  cr_assert_eq(stats_counter_get(q->metrics.shared.queued_messages), 80);
+  log_queue_ack_backlog(q, 20);
+
+  send_some_messages_in_batch(q, 80, 64, TRUE);
+  cr_assert_eq(stats_counter_get(q->metrics.shared.queued_messages), 0);
+  cr_assert_eq(log_queue_get_length(q), 0);
+
+  cr_assert_eq(fed_messages, acked_messages,
+               "did not receive enough acknowledgements: fed_messages=%d, acked_messages=%d",
+               fed_messages, acked_messages);
+
+  gboolean persistent;
+  log_queue_disk_stop(q, &persistent);
+  log_queue_unref(q);
+  unlink(filename);
+  disk_queue_options_destroy(&options);
+}
+
+Test(diskq, testcase_batch_push_and_pop_reliable)
+{
+  _test_batch_push_and_pop(TRUE, "test-batch_reliable.rqf");
+}
+
+Test(diskq, testcase_batch_push_and_pop_non_reliable)
+{
+  _test_batch_push_and_pop(FALSE, "test-batch_non_reliable.qf");
+}
+
+static void
+_test_prefetch(gboolean reliable, const gchar *filename)
+{
+  DiskQueueOptions options = {0};
+  LogQueue *q;
+
+  _construct_options(&options, 10000000, 100000, reliable);
+  options.prefetch_bytes = 1024 * 1024;
+  if (!reliable)
+    options.front_cache_size = 10;
+  unlink(filename);
+
+  if (reliable)
+    q = log_queue_disk_reliable_new(&options, filename, NULL, STATS_LEVEL0, NULL, NULL);
+  else
+    q = log_queue_disk_non_reliable_new(&options, filename, NULL, STATS_LEVEL0, NULL, NULL);
+
+  log_queue_disk_start(q);
+
+  fed_messages = 0;
+  acked_messages = 0;
+  feed_some_messages(q, 100);
+  cr_assert_eq(log_queue_get_length(q), 100);
+
+  /* without a front-cache, only the prefetcher can keep reliable messages in memory */
+  for (gint i = 0; i < 1000 && atomic_gssize_get(&q->memory_reserved) == 0; i++)
+    g_usleep(1000);
+  cr_assert_gt(atomic_gssize_get(&q->memory_reserved), 0);
+
+  send_some_messages(q, 50, FALSE);
+  log_queue_rewind_backlog_all(q);
+  cr_assert_eq(log_queue_get_length(q), 100);
+  send_some_messages(q, 100, TRUE);
+  cr_assert_eq(log_queue_get_length(q), 0);
+
+  cr_assert_eq(fed_messages, acked_messages,
+               "did not receive enough acknowledgements: fed_messages=%d, acked_messages=%d",
+               fed_messages, acked_messages);
+
+  gboolean persistent;
+  log_queue_disk_stop(q, &persistent);
+  log_queue_unref(q);
+  unlink(filename);
+  disk_queue_options_destroy(&options);
+}
+
+Test(diskq, testcase_prefetch_reliable)
+{
+  _test_prefetch(TRUE, "test-prefetch_reliable.rqf");
+}
+
+Test(diskq, testcase_prefetch_non_reliable)
+{
+  _test_prefetch(FALSE, "test-prefetch_non_reliable.qf");
+}
+
 static void
 setup(void)
 {
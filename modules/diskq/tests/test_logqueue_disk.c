@@ -414,6 +414,92 @@ Test(logqueue_disk, restart_corrupted_with_multiple_queues)
   stop_grabbing_messages();
 }
 
+static gboolean
+_wait_for_acked_messages(gint expected)
+{
+  for (gint i = 0; i < 1000 && g_atomic_int_get(&acked_messages) < expected; i++)
+    g_usleep(10000);
+
+  return g_atomic_int_get(&acked_messages) == expected;
+}
+
+Test(logqueue_disk, group_commit_acks_messages_once_they_are_synced)
+{
+  const gchar *filename = "group_commit_reliable.rqf";
+  /* records are framed with their length on disk */
+  gsize record_size = get_one_message_serialized_size() + sizeof(guint32);
+
+  DiskQueueOptions options = {0};
+  disk_queue_options_set_default_options(&options);
+  disk_queue_options_reliable_set(&options, TRUE);
+  disk_queue_options_capacity_bytes_set(&options, MIN_CAPACITY_BYTES);
+  disk_queue_options_flow_control_window_bytes_set(&options, 4096);
+  /* the interval is long enough so that only the byte limit and stopping can trigger a sync */
+  disk_queue_options_fsync_interval_set(&options, 60000);
+  disk_queue_options_fsync_bytes_set(&options, 20 * record_size);
+
+  LogQueue *queue = log_queue_disk_reliable_new(&options, filename, "group_commit_reliable", STATS_LEVEL0,
+                                                NULL, NULL);
+  cr_assert(log_queue_disk_start(queue));
+
+  acked_messages = 0;
+  feed_some_messages(queue, 10);
+  cr_assert_eq(g_atomic_int_get(&acked_messages), 0, "Messages were acked before they got synced");
+
+  feed_some_messages(queue, 10);
+  cr_assert(_wait_for_acked_messages(20), "Messages were not acked after reaching fsync-bytes(), acked: %d",
+            g_atomic_int_get(&acked_messages));
+
+  feed_some_messages(queue, 5);
+  cr_assert_eq(g_atomic_int_get(&acked_messages), 20);
+
+  gboolean persistent;
+  log_queue_disk_stop(queue, &persistent);
+  cr_assert_eq(acked_messages, 25, "Unsynced messages were not acked when stopping the queue");
+
+  log_queue_unref(queue);
+  disk_queue_options_destroy(&options);
+  unlink(filename);
+}
+
+static guint8
+_serialized_version(gboolean compaction, gboolean compact_encoding)
+{
+  const gchar *filename = "serialized_version.qf";
+
+  DiskQueueOptions options = {0};
+  disk_queue_options_set_default_options(&options);
+  disk_queue_options_capacity_bytes_set(&options, MIN_CAPACITY_BYTES);
+  disk_queue_options_compaction_set(&options, compaction);
+  disk_queue_options_compact_encoding_set(&options, compact_encoding);
+
+  LogQueue *queue = log_queue_disk_non_reliable_new(&options, filename, NULL, STATS_LEVEL0, NULL, NULL);
+
+  LogMessage *msg = log_msg_new_empty();
+  GString *serialized = g_string_new(NULL);
+  cr_assert(log_queue_disk_serialize_msg((LogQueueDisk *) queue, msg, serialized));
+
+  /* the version follows the record length */
+  cr_assert_gt(serialized->len, sizeof(guint32));
+  guint8 version = (guint8) serialized->str[sizeof(guint32)];
+
+  g_string_free(serialized, TRUE);
+  log_msg_unref(msg);
+  log_queue_unref(queue);
+  disk_queue_options_destroy(&options);
+  unlink(filename);
+
+  return version;
+}
+
+Test(logqueue_disk, compaction_alone_keeps_the_v26_format)
+{
+  cr_assert_eq(_serialized_version(FALSE, FALSE), LGM_V26);
+  cr_assert_eq(_serialized_version(TRUE, FALSE), LGM_V26);
+  cr_assert_eq(_serialized_version(FALSE, TRUE), LGM_V27);
+  cr_assert_eq(_serialized_version(TRUE, TRUE), LGM_V27);
+}
+
 static void
 setup(void)
 {
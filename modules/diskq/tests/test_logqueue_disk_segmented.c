@@ -0,0 +1,205 @@
+/*
+ * Copyright (c) 2024 One Identity LLC.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#include <criterion/criterion.h>
+#include "libtest/queue_utils_lib.h"
+#include "libtest/grab-logging.h"
+#include "test_diskq_tools.h"
+
+#include <unistd.h>
+#include "apphook.h"
+
+#include "logqueue-disk-segmented.h"
+
+static void
+_remove_dir(const gchar *dirname)
+{
+  GDir *dir = g_dir_open(dirname, 0, NULL);
+  if (!dir)
+    return;
+
+  const gchar *basename;
+  while ((basename = g_dir_read_name(dir)))
+    {
+      gchar *filename = g_build_filename(dirname, basename, NULL);
+      unlink(filename);
+      g_free(filename);
+    }
+  g_dir_close(dir);
+  rmdir(dirname);
+}
+
+static LogQueue *
+_create_and_start_queue(DiskQueueOptions *options, const gchar *dirname)
+{
+  StatsClusterKeyBuilder *driver_sck_builder = stats_cluster_key_builder_new();
+  StatsClusterKeyBuilder *queue_sck_builder = stats_cluster_key_builder_new();
+  LogQueue *queue = log_queue_disk_segmented_new(options, dirname, dirname, STATS_LEVEL0,
+                                                 driver_sck_builder, queue_sck_builder);
+  stats_cluster_key_builder_free(driver_sck_builder);
+  stats_cluster_key_builder_free(queue_sck_builder);
+
+  cr_assert(log_queue_disk_segmented_start(queue));
+  return queue;
+}
+
+static void
+_stop_and_free_queue(LogQueue *queue)
+{
+  log_queue_disk_segmented_stop(queue);
+  log_queue_unref(queue);
+}
+
+static gint64
+_segment_count(LogQueue *queue)
+{
+  return qdisk_segmented_get_segment_count(((LogQueueDiskSegmented *) queue)->qdisk);
+}
+
+static void
+_set_options(DiskQueueOptions *options)
+{
+  disk_queue_options_set_default_options(options);
+  disk_queue_options_capacity_bytes_set(options, MIN_CAPACITY_BYTES);
+  disk_queue_options_segment_size_set(options, MIN_SEGMENT_SIZE);
+}
+
+Test(logqueue_disk_segmented, consumed_segments_are_removed)
+{
+  const gchar *dirname = "consumed_segments_are_removed.sqd";
+  DiskQueueOptions options;
+  _set_options(&options);
+
+  LogQueue *queue = _create_and_start_queue(&options, dirname);
+  gint num_msgs = 4 * MIN_SEGMENT_SIZE / get_one_message_serialized_size();
+
+  fed_messages = 0;
+  acked_messages = 0;
+  feed_some_messages(queue, num_msgs);
+  cr_assert_eq(log_queue_get_length(queue), num_msgs);
+  cr_assert_eq(acked_messages, num_msgs, "messages must be acked once they are written to a segment");
+  cr_assert_geq(_segment_count(queue), 4);
+
+  send_some_messages(queue, num_msgs, TRUE);
+  cr_assert_eq(log_queue_get_length(queue), 0);
+  cr_assert_eq(_segment_count(queue), 1, "every sealed segment must be removed once its messages are acked");
+
+  _stop_and_free_queue(queue);
+  disk_queue_options_destroy(&options);
+  _remove_dir(dirname);
+}
+
+Test(logqueue_disk_segmented, unacked_messages_are_kept_over_restart)
+{
+  const gchar *dirname = "unacked_messages_are_kept_over_restart.sqd";
+  DiskQueueOptions options;
+  _set_options(&options);
+
+  LogQueue *queue = _create_and_start_queue(&options, dirname);
+  gint num_msgs = 2 * MIN_SEGMENT_SIZE / get_one_message_serialized_size();
+
+  feed_some_messages(queue, num_msgs);
+  send_some_messages(queue, 20, FALSE);
+  log_queue_ack_backlog(queue, 10);
+  cr_assert_eq(log_queue_get_length(queue), num_msgs - 20);
+  _stop_and_free_queue(queue);
+
+  queue = _create_and_start_queue(&options, dirname);
+  cr_assert_eq(log_queue_get_length(queue), num_msgs - 10, "the unacked messages must be read again after restart");
+
+  send_some_messages(queue, num_msgs - 10, TRUE);
+  cr_assert_eq(log_queue_get_length(queue), 0);
+
+  _stop_and_free_queue(queue);
+  disk_queue_options_destroy(&options);
+  _remove_dir(dirname);
+}
+
+Test(logqueue_disk_segmented, rewind_reads_the_backlog_again)
+{
+  const gchar *dirname = "rewind_reads_the_backlog_again.sqd";
+  DiskQueueOptions options;
+  _set_options(&options);
+
+  LogQueue *queue = _create_and_start_queue(&options, dirname);
+  gint num_msgs = 2 * MIN_SEGMENT_SIZE / get_one_message_serialized_size();
+
+  feed_some_messages(queue, num_msgs);
+  send_some_messages_in_batch(queue, num_msgs, 16, FALSE);
+  cr_assert_eq(log_queue_get_length(queue), 0);
+
+  log_queue_rewind_backlog(queue, 5);
+  cr_assert_eq(log_queue_get_length(queue), 5);
+
+  log_queue_rewind_backlog_all(queue);
+  cr_assert_eq(log_queue_get_length(queue), num_msgs);
+
+  send_some_messages_in_batch(queue, num_msgs, 16, TRUE);
+  cr_assert_eq(log_queue_get_length(queue), 0);
+  cr_assert_eq(_segment_count(queue), 1);
+
+  _stop_and_free_queue(queue);
+  disk_queue_options_destroy(&options);
+  _remove_dir(dirname);
+}
+
+Test(logqueue_disk_segmented, consumed_last_segment_is_recycled_when_full)
+{
+  const gchar *dirname = "consumed_last_segment_is_recycled_when_full.sqd";
+  DiskQueueOptions options;
+  _set_options(&options);
+  disk_queue_options_segment_size_set(&options, MIN_CAPACITY_BYTES);
+
+  LogQueue *queue = _create_and_start_queue(&options, dirname);
+  gint num_msgs = 3 * (MIN_CAPACITY_BYTES / 4) / get_one_message_serialized_size();
+
+  for (gint i = 0; i < 4; i++)
+    {
+      feed_some_messages(queue, num_msgs);
+      cr_assert_eq(log_queue_get_length(queue), num_msgs, "messages must not be dropped if the queue is consumed");
+      send_some_messages(queue, num_msgs, TRUE);
+    }
+
+  _stop_and_free_queue(queue);
+  disk_queue_options_destroy(&options);
+  _remove_dir(dirname);
+}
+
+static void
+setup(void)
+{
+  app_startup();
+  configuration = cfg_new_snippet();
+  configuration->stats_options.level = STATS_LEVEL1;
+  cfg_init(configuration);
+  start_grabbing_messages();
+}
+
+static void
+teardown(void)
+{
+  stop_grabbing_messages();
+  cfg_free(configuration);
+  app_shutdown();
+}
+
+TestSuite(logqueue_disk_segmented, .init = setup, .fini = teardown);
@@ -29,12 +29,16 @@
 #include "scratch-buffers.h"
 
 #include <unistd.h>
+#include <fcntl.h>
 #include <sys/stat.h>
 #include <errno.h>
 
 /* QDisk-internal: the frame is a 4-byte integer */
 #define FRAME_LENGTH 4
 
+/* QDisk-internal: offset of write_head in the file header */
+#define HEADER_WRITE_HEAD_OFFSET 16
+
 #define DUMMY_RECORD_PATTERN ('z')
 #define MiB(x) (x * 1024 * 1024)
 
@@ -574,6 +578,384 @@ Test(qdisk, get_empty_space_wrapped)
   cleanup_qdisk(filename, qdisk);
 }
 
+static QDisk *
+_create_qdisk_with_checkpoints(const gchar *filename)
+{
+  QDisk *qdisk = create_qdisk(TDISKQ_RELIABLE, filename, MiB(1));
+  disk_queue_options_fsync_interval_set(qdisk_get_options(qdisk), 100);
+  return qdisk;
+}
+
+static void
+_copy_file(const gchar *src, const gchar *dst)
+{
+  gchar *contents;
+  gsize length;
+
+  cr_assert(g_file_get_contents(src, &contents, &length, NULL));
+  cr_assert(g_file_set_contents(dst, contents, length, NULL));
+  g_free(contents);
+}
+
+static void
+_corrupt_write_head(const gchar *filename)
+{
+  gint64 invalid_write_head = 0;
+  gint fd = open(filename, O_WRONLY);
+
+  cr_assert(fd >= 0);
+  cr_assert_eq(pwrite(fd, &invalid_write_head, sizeof(invalid_write_head), HEADER_WRITE_HEAD_OFFSET),
+               sizeof(invalid_write_head));
+  close(fd);
+}
+
+/* the data written after the last sync never reached the disk, but the mmapped header did */
+static void
+_lose_unsynced_data(const gchar *filename, gint64 synced_size)
+{
+  cr_assert_eq(truncate(filename, synced_size), 0);
+}
+
+typedef enum
+{
+  CRASH_KEEPS_ALL_DATA,
+  CRASH_CORRUPTS_HEADER,
+  CRASH_LOSES_UNSYNCED_DATA,
+} CrashKind;
+
+static void
+_assert_crashed_qdisk_length(const gchar *filename, CrashKind crash, gint64 expected_length)
+{
+  QDisk *qdisk = _create_qdisk_with_checkpoints(filename);
+  cr_assert(qdisk_start(qdisk, NULL, NULL, NULL));
+
+  for (gint i = 0; i < 10; ++i)
+    cr_assert(push_dummy_record(qdisk, 1024));
+  cr_assert(qdisk_sync(qdisk));
+  gint64 synced_write_head = qdisk_get_writer_head(qdisk);
+
+  /* not covered by a checkpoint */
+  for (gint i = 0; i < 5; ++i)
+    cr_assert(push_dummy_record(qdisk, 1024));
+
+  const gchar *crashed_filename = "test_qdisk_checkpoint_crashed.rqf";
+  _copy_file(filename, crashed_filename);
+  if (crash == CRASH_CORRUPTS_HEADER)
+    _corrupt_write_head(crashed_filename);
+  else if (crash == CRASH_LOSES_UNSYNCED_DATA)
+    _lose_unsynced_data(crashed_filename, synced_write_head);
+
+  QDisk *crashed_qdisk = _create_qdisk_with_checkpoints(crashed_filename);
+  cr_assert(qdisk_start(crashed_qdisk, NULL, NULL, NULL));
+  cr_assert_eq(qdisk_get_length(crashed_qdisk), expected_length);
+
+  GString *popped_data = g_string_new(NULL);
+  for (gint i = 0; i < expected_length; ++i)
+    {
+      cr_assert(reliable_pop_record_without_backlog(crashed_qdisk, popped_data));
+      assert_dummy_record(popped_data, 1024);
+    }
+  g_string_free(popped_data, TRUE);
+  qdisk_stop(crashed_qdisk, NULL, NULL, NULL);
+  cleanup_qdisk(crashed_filename, crashed_qdisk);
+
+  qdisk_stop(qdisk, NULL, NULL, NULL);
+  cleanup_qdisk(filename, qdisk);
+}
+
+Test(qdisk, unclean_shutdown_keeps_the_heads_of_a_consistent_header)
+{
+  _assert_crashed_qdisk_length("test_qdisk_checkpoint.rqf", CRASH_KEEPS_ALL_DATA, 15);
+}
+
+Test(qdisk, unclean_shutdown_restores_the_last_checkpoint_of_an_inconsistent_header)
+{
+  _assert_crashed_qdisk_length("test_qdisk_checkpoint.rqf", CRASH_CORRUPTS_HEADER, 10);
+}
+
+Test(qdisk, unclean_shutdown_restores_the_last_checkpoint_if_unsynced_records_are_lost)
+{
+  _assert_crashed_qdisk_length("test_qdisk_checkpoint.rqf", CRASH_LOSES_UNSYNCED_DATA, 10);
+}
+
+Test(qdisk, clean_shutdown_keeps_records_not_covered_by_a_checkpoint)
+{
+  const gchar *filename = "test_qdisk_checkpoint.rqf";
+  QDisk *qdisk = _create_qdisk_with_checkpoints(filename);
+  cr_assert(qdisk_start(qdisk, NULL, NULL, NULL));
+
+  for (gint i = 0; i < 10; ++i)
+    cr_assert(push_dummy_record(qdisk, 1024));
+  cr_assert(qdisk_sync(qdisk));
+
+  for (gint i = 0; i < 5; ++i)
+    cr_assert(push_dummy_record(qdisk, 1024));
+
+  DiskQueueOptions *opts = qdisk_get_options(qdisk);
+  qdisk_stop(qdisk, NULL, NULL, NULL);
+  qdisk_free(qdisk);
+  disk_queue_options_destroy(opts);
+  g_free(opts);
+
+  qdisk = _create_qdisk_with_checkpoints(filename);
+  cr_assert(qdisk_start(qdisk, NULL, NULL, NULL));
+  cr_assert_eq(qdisk_get_length(qdisk), 15);
+  qdisk_stop(qdisk, NULL, NULL, NULL);
+  cleanup_qdisk(filename, qdisk);
+}
+
+Test(qdisk, space_released_after_the_last_checkpoint_is_reused_only_after_the_next_one)
+{
+  const gchar *filename = "test_qdisk_checkpoint_space.rqf";
+  QDisk *qdisk = _create_qdisk_with_checkpoints(filename);
+  cr_assert(qdisk_start(qdisk, NULL, NULL, NULL));
+
+  for (gint i = 0; i < 10; ++i)
+    _push_data_to_qdisk(qdisk, 1024);
+  cr_assert(qdisk_sync(qdisk));
+
+  gint64 empty_space = qdisk_get_empty_space(qdisk);
+  for (gint i = 0; i < 5; ++i)
+    _pop_and_ack(qdisk);
+  cr_assert_eq(qdisk_get_empty_space(qdisk), empty_space);
+
+  cr_assert(qdisk_sync(qdisk));
+  cr_assert_eq(qdisk_get_empty_space(qdisk), empty_space + 5 * 1024);
+
+  qdisk_stop(qdisk, NULL, NULL, NULL);
+  cleanup_qdisk(filename, qdisk);
+}
+
+Test(qdisk, sync_point_covers_only_the_records_written_before_it)
+{
+  const gchar *filename = "test_qdisk_sync_point.rqf";
+  const gchar *crashed_filename = "test_qdisk_sync_point_crashed.rqf";
+  QDisk *qdisk = _create_qdisk_with_checkpoints(filename);
+  cr_assert(qdisk_start(qdisk, NULL, NULL, NULL));
+
+  for (gint i = 0; i < 10; ++i)
+    cr_assert(push_dummy_record(qdisk, 1024));
+
+  QDiskSyncPoint sync_point;
+  qdisk_prepare_sync(qdisk, &sync_point);
+
+  /* pushed while the sync is in progress */
+  for (gint i = 0; i < 5; ++i)
+    cr_assert(push_dummy_record(qdisk, 1024));
+
+  cr_assert(qdisk_sync_data(qdisk, &sync_point));
+  cr_assert(qdisk_write_checkpoint(qdisk, &sync_point));
+  cr_assert(qdisk_sync_checkpoint(qdisk, &sync_point));
+  qdisk_commit_checkpoint(qdisk, &sync_point);
+
+  _copy_file(filename, crashed_filename);
+  _corrupt_write_head(crashed_filename);
+
+  QDisk *crashed_qdisk = _create_qdisk_with_checkpoints(crashed_filename);
+  cr_assert(qdisk_start(crashed_qdisk, NULL, NULL, NULL));
+  cr_assert_eq(qdisk_get_length(crashed_qdisk), 10);
+  qdisk_stop(crashed_qdisk, NULL, NULL, NULL);
+  cleanup_qdisk(crashed_filename, crashed_qdisk);
+
+  qdisk_stop(qdisk, NULL, NULL, NULL);
+  cleanup_qdisk(filename, qdisk);
+}
+
+Test(qdisk, sync_point_is_dropped_once_the_file_is_reset)
+{
+  const gchar *filename = "test_qdisk_sync_point_reset.rqf";
+  QDisk *qdisk = _create_qdisk_with_checkpoints(filename);
+  cr_assert(qdisk_start(qdisk, NULL, NULL, NULL));
+
+  _push_data_to_qdisk(qdisk, 1024);
+
+  QDiskSyncPoint sync_point;
+  qdisk_prepare_sync(qdisk, &sync_point);
+
+  _pop_and_ack(qdisk);
+  qdisk_reset_file_if_empty(qdisk);
+
+  cr_assert(qdisk_sync_data(qdisk, &sync_point));
+  cr_assert_not(qdisk_write_checkpoint(qdisk, &sync_point));
+
+  qdisk_commit_checkpoint(qdisk, &sync_point);
+  cr_assert_eq(qdisk_get_empty_space(qdisk), qdisk_get_max_useful_space(qdisk));
+
+  qdisk_stop(qdisk, NULL, NULL, NULL);
+  cleanup_qdisk(filename, qdisk);
+}
+
+Test(qdisk, read_point_reads_ahead_of_the_head)
+{
+  const gchar *filename = "test_qdisk_read_point.rqf";
+  QDisk *qdisk = create_qdisk(TDISKQ_RELIABLE, filename, MiB(1));
+  qdisk_start(qdisk, NULL, NULL, NULL);
+
+  for (gint i = 0; i < 3; ++i)
+    cr_assert(push_dummy_record(qdisk, 128 + i));
+
+  GString *record = g_string_new(NULL);
+  QDiskReadPoint point;
+  gint64 position = qdisk_get_next_head_position(qdisk);
+
+  for (gint i = 0; i < 3; ++i)
+    {
+      cr_assert(qdisk_prepare_read(qdisk, position, &point));
+      cr_assert(qdisk_read_prepared(qdisk, &point, record));
+      cr_assert(qdisk_finish_read(qdisk, &point, &position));
+      assert_dummy_record(record, 128 + i);
+    }
+  cr_assert_not(qdisk_prepare_read(qdisk, position, &point), "there is no record after the write head");
+
+  /* reading ahead does not move the heads */
+  cr_assert_eq(qdisk_get_length(qdisk), 3);
+  cr_assert_eq(qdisk_get_backlog_count(qdisk), 0);
+
+  g_string_free(record, TRUE);
+  qdisk_stop(qdisk, NULL, NULL, NULL);
+  cleanup_qdisk(filename, qdisk);
+}
+
+Test(qdisk, read_point_is_dropped_once_the_head_is_popped_or_the_file_is_reset)
+{
+  const gchar *filename = "test_qdisk_read_point_dropped.qf";
+  QDisk *qdisk = create_qdisk(TDISKQ_NON_RELIABLE, filename, MiB(1));
+  qdisk_start(qdisk, NULL, NULL, NULL);
+
+  cr_assert(push_dummy_record(qdisk, 128));
+  cr_assert(push_dummy_record(qdisk, 129));
+
+  GString *buffer = g_string_new(NULL);
+  QDiskReadPoint point;
+
+  /* the consumer pops the head while it is being read */
+  cr_assert(qdisk_prepare_read(qdisk, qdisk_get_next_head_position(qdisk), &point));
+  cr_assert(qdisk_read_prepared(qdisk, &point, buffer));
+  cr_assert(qdisk_pop_head(qdisk, buffer));
+  cr_assert_not(qdisk_pop_prepared_head(qdisk, &point));
+  cr_assert_eq(qdisk_get_length(qdisk), 1);
+
+  cr_assert(qdisk_prepare_read(qdisk, qdisk_get_next_head_position(qdisk), &point));
+  cr_assert(qdisk_read_prepared(qdisk, &point, buffer));
+  cr_assert(qdisk_pop_prepared_head(qdisk, &point));
+  cr_assert_eq(qdisk_get_length(qdisk), 0);
+
+  /* the pop emptied and reset the file, so an earlier read point is stale */
+  cr_assert(push_dummy_record(qdisk, 130));
+  cr_assert_not(qdisk_pop_prepared_head(qdisk, &point));
+  gint64 next_position;
+  cr_assert_not(qdisk_finish_read(qdisk, &point, &next_position));
+
+  g_string_free(buffer, TRUE);
+  qdisk_stop(qdisk, NULL, NULL, NULL);
+  cleanup_qdisk(filename, qdisk);
+}
+
+static void
+_assert_dummy_record_buffer(const gchar *record, gsize record_length, guint expected_size)
+{
+  GString *copy = g_string_new_len(record, record_length);
+  assert_dummy_record(copy, expected_size);
+  g_string_free(copy, TRUE);
+}
+
+Test(qdisk, mmap_replay_pops_records_from_the_mapping)
+{
+  const gchar *filename = "test_qdisk_mmap_replay.rqf";
+  QDisk *qdisk = create_qdisk(TDISKQ_RELIABLE, filename, MiB(1));
+  disk_queue_options_mmap_replay_set(qdisk_get_options(qdisk), TRUE);
+  qdisk_start(qdisk, NULL, NULL, NULL);
+
+  for (gint i = 0; i < 100; ++i)
+    cr_assert(push_dummy_record(qdisk, 128 + i));
+
+  GString *buffer = g_string_new(NULL);
+  const gchar *record;
+  gsize record_length;
+
+  for (gint i = 0; i < 50; ++i)
+    {
+      cr_assert(qdisk_pop_head_mapped(qdisk, buffer, &record, &record_length));
+      _assert_dummy_record_buffer(record, record_length, 128 + i);
+    }
+
+  /* records written after the file got mapped are visible too */
+  for (gint i = 0; i < 10; ++i)
+    cr_assert(push_dummy_record(qdisk, 4000));
+
+  for (gint i = 50; i < 100; ++i)
+    {
+      cr_assert(qdisk_pop_head_mapped(qdisk, buffer, &record, &record_length));
+      _assert_dummy_record_buffer(record, record_length, 128 + i);
+    }
+  for (gint i = 0; i < 10; ++i)
+    {
+      cr_assert(qdisk_pop_head_mapped(qdisk, buffer, &record, &record_length));
+      _assert_dummy_record_buffer(record, record_length, 4000);
+    }
+
+  cr_assert_not(qdisk_pop_head_mapped(qdisk, buffer, &record, &record_length));
+  cr_assert_eq(qdisk_get_length(qdisk), 0);
+  cr_assert_eq(qdisk_get_backlog_count(qdisk), 110);
+
+  g_string_free(buffer, TRUE);
+  qdisk_stop(qdisk, NULL, NULL, NULL);
+  cleanup_qdisk(filename, qdisk);
+}
+
+#ifdef SYSLOG_NG_HAVE_ZLIB
+
+Test(qdisk, compressed_records_are_smaller_and_survive_rewind)
+{
+  const gchar *filename = "test_qdisk_compressed_records.rqf";
+  QDisk *qdisk = create_qdisk(TDISKQ_RELIABLE, filename, MiB(1));
+  disk_queue_options_compression_set(qdisk_get_options(qdisk), TRUE);
+  qdisk_start(qdisk, NULL, NULL, NULL);
+
+  gsize num_of_records = 100;
+  guint record_len = 1024;
+
+  for (gsize i = 0; i < num_of_records; ++i)
+    cr_assert(push_dummy_record(qdisk, record_len));
+
+  /* too short to compress, stored as it is */
+  cr_assert(push_dummy_record(qdisk, 16));
+
+  gint64 written = qdisk_get_writer_head(qdisk) - QDISK_RESERVED_SPACE;
+  cr_assert_lt(written, num_of_records * (record_len + FRAME_LENGTH) / 4,
+               "Compressed records are not smaller, written: %ld", written);
+
+  GString *popped_data = g_string_new(NULL);
+  for (gsize i = 0; i < num_of_records; ++i)
+    {
+      cr_assert(qdisk_pop_head(qdisk, popped_data));
+      assert_dummy_record(popped_data, record_len);
+    }
+  cr_assert(qdisk_pop_head(qdisk, popped_data));
+  assert_dummy_record(popped_data, 16);
+
+  cr_assert(qdisk_rewind_backlog(qdisk, 11));
+  cr_assert_eq(qdisk_get_length(qdisk), 11);
+
+  for (gsize i = 0; i < 10; ++i)
+    {
+      cr_assert(qdisk_pop_head(qdisk, popped_data));
+      assert_dummy_record(popped_data, record_len);
+    }
+  cr_assert(qdisk_pop_head(qdisk, popped_data));
+  assert_dummy_record(popped_data, 16);
+  g_string_free(popped_data, TRUE);
+
+  for (gsize i = 0; i <= num_of_records; ++i)
+    cr_assert(qdisk_ack_backlog(qdisk));
+  cr_assert_eq(qdisk_get_length(qdisk), 0);
+
+  qdisk_stop(qdisk, NULL, NULL, NULL);
+  cleanup_qdisk(filename, qdisk);
+}
+
+#endif
+
 static void
 setup(void)
 {
@@ -0,0 +1,293 @@
+/*
+ * Copyright (c) 2024 One Identity LLC.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+#include "ebpf-filter.h"
+#include "modules/afsocket/afsocket-signals.h"
+#include "messages.h"
+
+#include <linux/types.h>
+#include <sys/socket.h>
+#include <arpa/inet.h>
+#include <string.h>
+#include <errno.h>
+#include <bpf/bpf.h>
+
+#include "filter.kern.h"
+
+typedef struct _EBPFFilterAddress
+{
+  struct ebpf_filter_address key;
+  gchar *cidr;
+} EBPFFilterAddress;
+
+typedef struct _EBPFFilter
+{
+  LogDriverPlugin super;
+  guint32 facility_mask;
+  guint32 severity_mask;
+  GArray *source_addresses;
+  gchar *program_prefix;
+  gint sample_rate;
+  struct filter_kern *filter;
+} EBPFFilter;
+
+#include "filter.skel.c"
+
+void
+ebpf_filter_set_facility_mask(LogDriverPlugin *s, guint32 facility_mask)
+{
+  EBPFFilter *self = (EBPFFilter *) s;
+  self->facility_mask = facility_mask;
+}
+
+void
+ebpf_filter_set_severity_mask(LogDriverPlugin *s, guint32 severity_mask)
+{
+  EBPFFilter *self = (EBPFFilter *) s;
+  self->severity_mask = severity_mask;
+}
+
+static gboolean
+_parse_cidr(const gchar *cidr, struct ebpf_filter_address *key)
+{
+  gchar **parts = g_strsplit(cidr, "/", 2);
+  gboolean result = FALSE;
+  gint max_prefix, prefix_offset = 0;
+
+  memset(key, 0, sizeof(*key));
+  if (inet_pton(AF_INET, parts[0], &key->addr[12]) == 1)
+    {
+      /* IPv4-mapped, the same way the kernel side looks them up */
+      key->addr[10] = 0xff;
+      key->addr[11] = 0xff;
+      max_prefix = 32;
+      prefix_offset = 96;
+    }
+  else if (inet_pton(AF_INET6, parts[0], key->addr) == 1)
+    {
+      max_prefix = 128;
+    }
+  else
+    goto exit;
+
+  gint64 prefix = max_prefix;
+  if (parts[1])
+    {
+      gchar *end;
+
+      prefix = g_ascii_strtoll(parts[1], &end, 10);
+      if (*parts[1] == '\0' || *end != '\0' || prefix < 0 || prefix > max_prefix)
+        goto exit;
+    }
+
+  key->prefixlen = prefix_offset + prefix;
+  result = TRUE;
+
+exit:
+  g_strfreev(parts);
+  return result;
+}
+
+gboolean
+ebpf_filter_add_source_address(LogDriverPlugin *s, const gchar *cidr)
+{
+  EBPFFilter *self = (EBPFFilter *) s;
+  EBPFFilterAddress address;
+
+  if (self->source_addresses->len >= EBPF_FILTER_MAX_SOURCE_ADDRESSES)
+    return FALSE;
+
+  if (!_parse_cidr(cidr, &address.key))
+    return FALSE;
+
+  address.cidr = g_strdup(cidr);
+  g_array_append_val(self->source_addresses, address);
+  return TRUE;
+}
+
+gboolean
+ebpf_filter_set_program_prefix(LogDriverPlugin *s, const gchar *prefix)
+{
+  EBPFFilter *self = (EBPFFilter *) s;
+
+  if (strlen(prefix) > EBPF_FILTER_MAX_PROGRAM_PREFIX)
+    return FALSE;
+
+  g_free(self->program_prefix);
+  self->program_prefix = g_strdup(prefix);
+  return TRUE;
+}
+
+void
+ebpf_filter_set_sample_rate(LogDriverPlugin *s, gint sample_rate)
+{
+  EBPFFilter *self = (EBPFFilter *) s;
+  self->sample_rate = sample_rate;
+}
+
+/* the payload follows the UDP header, the filter does not see the IP header at this point */
+static gboolean
+_get_payload_offset(gint sock, guint32 *payload_offset)
+{
+  gint type, domain;
+  socklen_t len = sizeof(type);
+
+  if (getsockopt(sock, SOL_SOCKET, SO_TYPE, &type, &len) < 0)
+    return FALSE;
+
+  len = sizeof(domain);
+  if (getsockopt(sock, SOL_SOCKET, SO_DOMAIN, &domain, &len) < 0)
+    return FALSE;
+
+  if (type != SOCK_DGRAM)
+    {
+      msg_error("ebpf-filter(): only datagram sockets are supported, dropping parts of a stream would corrupt it",
+                evt_tag_int("sock", sock));
+      return FALSE;
+    }
+
+  if (domain == AF_INET || domain == AF_INET6)
+    *payload_offset = 8;
+  else
+    *payload_offset = 0;
+  return TRUE;
+}
+
+static void
+_slot_setup_socket(EBPFFilter *self, AFSocketSetupSocketSignalData *data)
+{
+  guint32 payload_offset;
+
+  if (!_get_payload_offset(data->sock, &payload_offset))
+    goto error;
+
+  self->filter->bss->payload_offset = payload_offset;
+
+  int bpf_fd = bpf_program__fd(self->filter->progs.syslog_filter);
+  if (bpf_fd < 0 || setsockopt(data->sock, SOL_SOCKET, SO_ATTACH_BPF, &bpf_fd, sizeof(bpf_fd)) < 0)
+    {
+      msg_error("ebpf-filter(): setsockopt(SO_ATTACH_BPF) returned error",
+                evt_tag_errno("error", errno));
+      goto error;
+    }
+
+  msg_debug("ebpf-filter(): eBPF socket filter applied",
+            evt_tag_int("sock", data->sock));
+  return;
+error:
+  data->failure = TRUE;
+}
+
+static gboolean
+_load_source_addresses(EBPFFilter *self)
+{
+  gint map_fd = bpf_map__fd(self->filter->maps.source_addresses);
+  guint8 value = 1;
+
+  for (guint i = 0; i < self->source_addresses->len; i++)
+    {
+      EBPFFilterAddress *address = &g_array_index(self->source_addresses, EBPFFilterAddress, i);
+
+      if (bpf_map_update_elem(map_fd, &address->key, &value, BPF_ANY) < 0)
+        {
+          msg_error("ebpf-filter(): Unable to add source address to eBPF map",
+                    evt_tag_str("source_address", address->cidr),
+                    evt_tag_errno("error", errno));
+          return FALSE;
+        }
+    }
+  return TRUE;
+}
+
+static gboolean
+_load_program(EBPFFilter *self)
+{
+  self->filter = filter_kern__open_and_load();
+  if (!self->filter)
+    return FALSE;
+
+  self->filter->bss->facility_mask = self->facility_mask;
+  self->filter->bss->severity_mask = self->severity_mask;
+  self->filter->bss->sample_rate = self->sample_rate;
+  self->filter->bss->match_source_addresses = self->source_addresses->len > 0;
+  if (self->program_prefix)
+    {
+      self->filter->bss->program_prefix_length = strlen(self->program_prefix);
+      memcpy(self->filter->bss->program_prefix, self->program_prefix, strlen(self->program_prefix));
+    }
+
+  return _load_source_addresses(self);
+}
+
+static gboolean
+_attach(LogDriverPlugin *s, LogDriver *driver)
+{
+  EBPFFilter *self = (EBPFFilter *)s;
+
+  if (!self->filter && !_load_program(self))
+    {
+      msg_error("ebpf-filter(): Unable to load eBPF program to the kernel");
+      return FALSE;
+    }
+
+  SignalSlotConnector *ssc = driver->super.signal_slot_connector;
+  CONNECT(ssc, signal_afsocket_setup_socket, _slot_setup_socket, self);
+
+  return TRUE;
+}
+
+static void
+_detach(LogDriverPlugin *s, LogDriver *driver)
+{
+  EBPFFilter *self = (EBPFFilter *)s;
+
+  SignalSlotConnector *ssc = driver->super.signal_slot_connector;
+  DISCONNECT(ssc, signal_afsocket_setup_socket, _slot_setup_socket, self);
+}
+
+static void
+_free(LogDriverPlugin *s)
+{
+  EBPFFilter *self = (EBPFFilter *) s;
+
+  if (self->filter)
+    filter_kern__destroy(self->filter);
+  for (guint i = 0; i < self->source_addresses->len; i++)
+    g_free(g_array_index(self->source_addresses, EBPFFilterAddress, i).cidr);
+  g_array_free(self->source_addresses, TRUE);
+  g_free(self->program_prefix);
+  log_driver_plugin_free_method(s);
+}
+
+LogDriverPlugin *
+ebpf_filter_new(void)
+{
+  EBPFFilter *self = g_new0(EBPFFilter, 1);
+  log_driver_plugin_init_instance(&self->super, "ebpf-filter");
+
+  self->super.attach = _attach;
+  self->super.detach = _detach;
+  self->super.free_fn = _free;
+  self->source_addresses = g_array_new(FALSE, TRUE, sizeof(EBPFFilterAddress));
+  self->sample_rate = 1;
+
+  return &self->super;
+}
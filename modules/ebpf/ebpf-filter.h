@@ -0,0 +1,35 @@
+/*
+ * Copyright (c) 2024 One Identity LLC.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#ifndef EBPF_FILTER_H_INCLUDED
+#define EBPF_FILTER_H_INCLUDED
+
+#include "driver.h"
+
+void ebpf_filter_set_facility_mask(LogDriverPlugin *s, guint32 facility_mask);
+void ebpf_filter_set_severity_mask(LogDriverPlugin *s, guint32 severity_mask);
+gboolean ebpf_filter_add_source_address(LogDriverPlugin *s, const gchar *cidr);
+gboolean ebpf_filter_set_program_prefix(LogDriverPlugin *s, const gchar *prefix);
+void ebpf_filter_set_sample_rate(LogDriverPlugin *s, gint sample_rate);
+LogDriverPlugin *ebpf_filter_new(void);
+
+#endif
@@ -33,6 +33,15 @@ static CfgLexerKeyword ebpf_keywords[] =
   { "ebpf", KW_EBPF },
   { "reuseport", KW_REUSEPORT },
   { "sockets", KW_SOCKETS },
+  { "balance", KW_BALANCE },
+  { "rebalance_threshold", KW_REBALANCE_THRESHOLD },
+  { "filter", KW_FILTER },
+  { "facility", KW_FACILITY },
+  { "severity", KW_SEVERITY },
+  { "level", KW_SEVERITY },
+  { "source_address", KW_SOURCE_ADDRESS },
+  { "program_prefix", KW_PROGRAM_PREFIX },
+  { "sample", KW_SAMPLE },
   { NULL }
 };
 
@@ -21,15 +21,58 @@
  */
 #include "ebpf-reuseport.h"
 #include "modules/afsocket/afsocket-signals.h"
+#include "stats/stats-registry.h"
+#include "stats/stats-cluster-single.h"
+#include "timeutils/misc.h"
+#include "messages.h"
+
+#include <iv.h>
+#include <errno.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <linux/sock_diag.h>
+#include <bpf/bpf.h>
+#include <bpf/libbpf.h>
+
+#include "reuseport.kern.h"
+
+/* hit counters and backlogs are synchronized with the kernel this often */
+#define EBPF_REUSEPORT_UPDATE_INTERVAL_MSEC 100
+
+typedef enum
+{
+  EBPF_REUSEPORT_BALANCE_RANDOM,
+  EBPF_REUSEPORT_BALANCE_SOURCE_IP,
+  EBPF_REUSEPORT_BALANCE_SOURCE_IP_PORT,
+} EBPFReusePortBalance;
+
+typedef struct _EBPFReusePortSocket
+{
+  gint fd;
+  gint type;
+} EBPFReusePortSocket;
 
 typedef struct _EBPFReusePort
 {
   LogDriverPlugin super;
+  EBPFReusePortBalance balance;
   struct random_kern *random;
+  struct iphash_kern *iphash;
   gint number_of_sockets;
+  guint32 rebalance_threshold;
+
+  /* sockets in the order they joined the reuseport group, which is the index the program returns */
+  GArray *sockets;
+  gchar *stats_id;
+  gchar **socket_labels;
+  StatsCounterItem **hits;
+  struct iv_timer update_timer;
 } EBPFReusePort;
 
 #include "random.skel.c"
+#include "iphash.skel.c"
 
 void
 ebpf_reuseport_set_sockets(LogDriverPlugin *s, gint number_of_sockets)
@@ -38,10 +81,195 @@ ebpf_reuseport_set_sockets(LogDriverPlugin *s, gint number_of_sockets)
   self->number_of_sockets = number_of_sockets;
 }
 
+gboolean
+ebpf_reuseport_set_balance(LogDriverPlugin *s, const gchar *balance)
+{
+  EBPFReusePort *self = (EBPFReusePort *) s;
+
+  if (strcmp(balance, "random") == 0)
+    self->balance = EBPF_REUSEPORT_BALANCE_RANDOM;
+  else if (strcmp(balance, "source-ip") == 0)
+    self->balance = EBPF_REUSEPORT_BALANCE_SOURCE_IP;
+  else if (strcmp(balance, "source-ip-port") == 0)
+    self->balance = EBPF_REUSEPORT_BALANCE_SOURCE_IP_PORT;
+  else
+    return FALSE;
+  return TRUE;
+}
+
+void
+ebpf_reuseport_set_rebalance_threshold(LogDriverPlugin *s, gint rebalance_threshold)
+{
+  EBPFReusePort *self = (EBPFReusePort *) s;
+  self->rebalance_threshold = rebalance_threshold;
+}
+
+static const gchar *
+_format_balance(EBPFReusePort *self)
+{
+  switch (self->balance)
+    {
+    case EBPF_REUSEPORT_BALANCE_SOURCE_IP:
+      return "source-ip";
+    case EBPF_REUSEPORT_BALANCE_SOURCE_IP_PORT:
+      return "source-ip-port";
+    default:
+      return "random";
+    }
+}
+
+static gboolean
+_is_hashing(EBPFReusePort *self)
+{
+  return self->balance == EBPF_REUSEPORT_BALANCE_SOURCE_IP || self->balance == EBPF_REUSEPORT_BALANCE_SOURCE_IP_PORT;
+}
+
+static int
+_get_program_fd(EBPFReusePort *self)
+{
+  if (_is_hashing(self))
+    return bpf_program__fd(self->iphash->progs.source_ip_hash);
+  return bpf_program__fd(self->random->progs.random_choice);
+}
+
+static int
+_get_hits_map_fd(EBPFReusePort *self)
+{
+  if (_is_hashing(self))
+    return bpf_map__fd(self->iphash->maps.socket_hits);
+  return bpf_map__fd(self->random->maps.socket_hits);
+}
+
+/* pending connections of a listener, or the bytes waiting in the receive buffer of a datagram socket */
+static gboolean
+_get_socket_backlog(EBPFReusePortSocket *sock, guint32 *backlog)
+{
+  if (sock->type == SOCK_STREAM)
+    {
+      struct tcp_info info;
+      socklen_t len = sizeof(info);
+
+      if (getsockopt(sock->fd, IPPROTO_TCP, TCP_INFO, &info, &len) < 0)
+        return FALSE;
+
+      /* for listening sockets this is the length of the accept queue */
+      *backlog = info.tcpi_unacked;
+      return TRUE;
+    }
+
+#if defined(SO_MEMINFO)
+  guint32 meminfo[SK_MEMINFO_VARS];
+  socklen_t len = sizeof(meminfo);
+
+  if (getsockopt(sock->fd, SOL_SOCKET, SO_MEMINFO, meminfo, &len) < 0)
+    return FALSE;
+
+  *backlog = meminfo[SK_MEMINFO_RMEM_ALLOC];
+  return TRUE;
+#else
+  return FALSE;
+#endif
+}
+
+static void
+_update_backlogs(EBPFReusePort *self)
+{
+  gint map_fd = bpf_map__fd(self->iphash->maps.socket_backlog);
+
+  for (guint32 i = 0; i < self->sockets->len && i < EBPF_REUSEPORT_MAX_SOCKETS; i++)
+    {
+      guint32 backlog;
+
+      if (!_get_socket_backlog(&g_array_index(self->sockets, EBPFReusePortSocket, i), &backlog))
+        continue;
+      bpf_map_update_elem(map_fd, &i, &backlog, BPF_ANY);
+    }
+}
+
+static void
+_update_hits(EBPFReusePort *self)
+{
+  gint map_fd = _get_hits_map_fd(self);
+  gint number_of_cpus = libbpf_num_possible_cpus();
+
+  if (number_of_cpus <= 0)
+    return;
+
+  guint64 per_cpu_hits[number_of_cpus];
+  for (guint32 i = 0; i < self->number_of_sockets; i++)
+    {
+      if (bpf_map_lookup_elem(map_fd, &i, per_cpu_hits) < 0)
+        continue;
+
+      guint64 hits = 0;
+      for (gint cpu = 0; cpu < number_of_cpus; cpu++)
+        hits += per_cpu_hits[cpu];
+      stats_counter_set(self->hits[i], hits);
+    }
+}
+
+static void
+_arm_update_timer(EBPFReusePort *self)
+{
+  iv_validate_now();
+  self->update_timer.expires = iv_now;
+  timespec_add_msec(&self->update_timer.expires, EBPF_REUSEPORT_UPDATE_INTERVAL_MSEC);
+  iv_timer_register(&self->update_timer);
+}
+
+static void
+_update(gpointer s)
+{
+  EBPFReusePort *self = (EBPFReusePort *) s;
+
+  if (self->rebalance_threshold && _is_hashing(self))
+    _update_backlogs(self);
+  _update_hits(self);
+  _arm_update_timer(self);
+}
+
+static void
+_hits_key_set(EBPFReusePort *self, StatsClusterKey *key, StatsClusterLabel *labels, gint index)
+{
+  labels[0] = stats_cluster_label("id", self->stats_id);
+  labels[1] = stats_cluster_label("socket", self->socket_labels[index]);
+  stats_cluster_single_key_set(key, "ebpf_reuseport_hits_total", labels, 2);
+}
+
+static void
+_register_counters(EBPFReusePort *self)
+{
+  StatsClusterKey key;
+  StatsClusterLabel labels[2];
+
+  stats_lock();
+  for (gint i = 0; i < self->number_of_sockets; i++)
+    {
+      _hits_key_set(self, &key, labels, i);
+      stats_register_counter(1, &key, SC_TYPE_SINGLE_VALUE, &self->hits[i]);
+    }
+  stats_unlock();
+}
+
+static void
+_unregister_counters(EBPFReusePort *self)
+{
+  StatsClusterKey key;
+  StatsClusterLabel labels[2];
+
+  stats_lock();
+  for (gint i = 0; i < self->number_of_sockets; i++)
+    {
+      _hits_key_set(self, &key, labels, i);
+      stats_unregister_counter(&key, SC_TYPE_SINGLE_VALUE, &self->hits[i]);
+    }
+  stats_unlock();
+}
+
 static void
 _slot_setup_socket(EBPFReusePort *self, AFSocketSetupSocketSignalData *data)
 {
-  int bpf_fd = bpf_program__fd(self->random->progs.random_choice);
+  int bpf_fd = _get_program_fd(self);
   if (bpf_fd < 0)
     {
       msg_error("ebpf-reuseport(): setsockopt(SO_ATTACH_REUSEPORT_EBPF) returned error",
@@ -56,25 +284,65 @@ _slot_setup_socket(EBPFReusePort *self, AFSocketSetupSocketSignalData *data)
       goto error;
     }
 
-  msg_debug("ebpf-reuseport(): eBPF reuseport group randomizer applied",
-            evt_tag_int("sock", data->sock));
+  /* the socket is already bound, so its index in the group is the number of sockets before it */
+  EBPFReusePortSocket sock = { .fd = data->sock, .type = SOCK_DGRAM };
+  socklen_t len = sizeof(sock.type);
+  getsockopt(data->sock, SOL_SOCKET, SO_TYPE, &sock.type, &len);
+  g_array_append_val(self->sockets, sock);
+
+  msg_debug("ebpf-reuseport(): eBPF reuseport group balancer applied",
+            evt_tag_int("sock", data->sock),
+            evt_tag_str("balance", _format_balance(self)));
   return;
 error:
   data->failure = TRUE;
 }
 
 static gboolean
-_attach(LogDriverPlugin *s, LogDriver *driver)
+_load_program(EBPFReusePort *self)
 {
-  EBPFReusePort *self = (EBPFReusePort *)s;
+  if (_is_hashing(self))
+    {
+      self->iphash = iphash_kern__open_and_load();
+      if (!self->iphash)
+        return FALSE;
+      self->iphash->bss->number_of_sockets = self->number_of_sockets;
+      self->iphash->bss->hash_source_port = self->balance == EBPF_REUSEPORT_BALANCE_SOURCE_IP_PORT;
+      self->iphash->bss->rebalance_threshold = self->rebalance_threshold;
+      return TRUE;
+    }
 
   self->random = random_kern__open_and_load();
   if (!self->random)
+    return FALSE;
+  self->random->bss->number_of_sockets = self->number_of_sockets;
+  return TRUE;
+}
+
+static gboolean
+_attach(LogDriverPlugin *s, LogDriver *driver)
+{
+  EBPFReusePort *self = (EBPFReusePort *)s;
+
+  if (!self->random && !self->iphash && !_load_program(self))
     {
       msg_error("ebpf-reuseport(): Unable to load eBPF program to the kernel");
       return FALSE;
     }
-  self->random->bss->number_of_sockets = self->number_of_sockets;
+
+  if (!self->hits)
+    {
+      self->hits = g_new0(StatsCounterItem *, self->number_of_sockets);
+      self->socket_labels = g_new0(gchar *, self->number_of_sockets + 1);
+      for (gint i = 0; i < self->number_of_sockets; i++)
+        self->socket_labels[i] = g_strdup_printf("%d", i);
+    }
+
+  g_array_set_size(self->sockets, 0);
+  g_free(self->stats_id);
+  self->stats_id = g_strdup(driver->id ? driver->id : "");
+  _register_counters(self);
+  _arm_update_timer(self);
 
   SignalSlotConnector *ssc = driver->super.signal_slot_connector;
   CONNECT(ssc, signal_afsocket_setup_socket, _slot_setup_socket, self);
@@ -89,6 +357,11 @@ _detach(LogDriverPlugin *s, LogDriver *driver)
 
   SignalSlotConnector *ssc = driver->super.signal_slot_connector;
   DISCONNECT(ssc, signal_afsocket_setup_socket, _slot_setup_socket, self);
+
+  if (iv_timer_registered(&self->update_timer))
+    iv_timer_unregister(&self->update_timer);
+  _unregister_counters(self);
+  g_array_set_size(self->sockets, 0);
 }
 
 static void
@@ -98,6 +371,12 @@ _free(LogDriverPlugin *s)
 
   if (self->random)
     random_kern__destroy(self->random);
+  if (self->iphash)
+    iphash_kern__destroy(self->iphash);
+  g_array_free(self->sockets, TRUE);
+  g_strfreev(self->socket_labels);
+  g_free(self->hits);
+  g_free(self->stats_id);
   log_driver_plugin_free_method(s);
 }
 
@@ -111,6 +390,12 @@ ebpf_reuseport_new(void)
   self->super.detach = _detach;
   self->super.free_fn = _free;
   self->number_of_sockets = 0;
+  self->balance = EBPF_REUSEPORT_BALANCE_RANDOM;
+  self->sockets = g_array_new(FALSE, TRUE, sizeof(EBPFReusePortSocket));
+
+  IV_TIMER_INIT(&self->update_timer);
+  self->update_timer.cookie = self;
+  self->update_timer.handler = _update;
 
   return &self->super;
 }
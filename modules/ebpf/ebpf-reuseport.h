@@ -26,6 +26,8 @@
 #include "driver.h"
 
 void ebpf_reuseport_set_sockets(LogDriverPlugin *s, gint number_of_sockets);
+gboolean ebpf_reuseport_set_balance(LogDriverPlugin *s, const gchar *balance);
+void ebpf_reuseport_set_rebalance_threshold(LogDriverPlugin *s, gint rebalance_threshold);
 LogDriverPlugin *ebpf_reuseport_new(void);
 
 #endif
@@ -0,0 +1,215 @@
+/*
+ * Copyright (c) 2024 One Identity LLC.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#include "vmlinux.h"
+#include <bpf/bpf_helpers.h>
+#include <bpf/bpf_endian.h>
+
+#include "filter.kern.h"
+
+#define ETH_P_IP 0x0800
+#define ETH_P_IPV6 0x86DD
+
+/* the part of the payload that is looked at, must be a power of 2 */
+#define PAYLOAD_SCAN_SIZE 256
+#define PAYLOAD_SCAN_MASK (PAYLOAD_SCAN_SIZE - 1)
+#define MAX_FIELD_LENGTH 64
+
+/* configuration, set from userspace, a zero value disables the predicate */
+__u32 payload_offset;
+__u32 facility_mask;
+__u32 severity_mask;
+__u32 match_source_addresses;
+__u32 program_prefix_length;
+char program_prefix[EBPF_FILTER_MAX_PROGRAM_PREFIX];
+__u32 sample_rate;
+
+struct
+{
+  __uint(type, BPF_MAP_TYPE_LPM_TRIE);
+  __uint(max_entries, EBPF_FILTER_MAX_SOURCE_ADDRESSES);
+  __type(key, struct ebpf_filter_address);
+  __type(value, __u8);
+  __uint(map_flags, BPF_F_NO_PREALLOC);
+} source_addresses SEC(".maps");
+
+/* scratch buffer for the beginning of the payload, too large for the stack */
+struct
+{
+  __uint(type, BPF_MAP_TYPE_PERCPU_ARRAY);
+  __uint(max_entries, 1);
+  __type(key, __u32);
+  __type(value, char[PAYLOAD_SCAN_SIZE]);
+} payload_buffer SEC(".maps");
+
+#define KEEP(skb) (skb->len)
+#define DROP 0
+
+static __always_inline int
+_source_address_matches(struct __sk_buff *skb)
+{
+  struct ebpf_filter_address key = {0};
+
+  key.prefixlen = 128;
+  if (skb->protocol == bpf_htons(ETH_P_IP))
+    {
+      /* IPv4 addresses are stored as IPv4-mapped IPv6 addresses */
+      key.addr[10] = 0xff;
+      key.addr[11] = 0xff;
+      if (bpf_skb_load_bytes_relative(skb, offsetof(struct iphdr, saddr), &key.addr[12], 4, BPF_HDR_START_NET) < 0)
+        return -1;
+    }
+  else if (skb->protocol == bpf_htons(ETH_P_IPV6))
+    {
+      if (bpf_skb_load_bytes_relative(skb, offsetof(struct ipv6hdr, saddr), key.addr, sizeof(key.addr),
+                                      BPF_HDR_START_NET) < 0)
+        return -1;
+    }
+  else
+    return -1;
+
+  return bpf_map_lookup_elem(&source_addresses, &key) != NULL;
+}
+
+static __always_inline int
+_skip_field(const char *buf, __u32 pos, __u32 len)
+{
+  for (int i = 0; i < MAX_FIELD_LENGTH; i++)
+    {
+      if (pos >= len)
+        return -1;
+      if (buf[pos & PAYLOAD_SCAN_MASK] == ' ')
+        return pos + 1;
+      pos++;
+    }
+  return -1;
+}
+
+static __always_inline int
+_is_digit(char c)
+{
+  return c >= '0' && c <= '9';
+}
+
+/*
+ * Locate the program field with the same heuristics as the syslog parser
+ * uses in the common case: RFC5424 messages have a version number after
+ * the PRI, followed by the timestamp and the hostname. RFC3164 ones have
+ * a "Mmm dd hh:mm:ss " timestamp and a hostname.
+ */
+static __always_inline int
+_find_program(const char *buf, __u32 pos, __u32 len)
+{
+  int next;
+
+  if (pos + 1 < len && _is_digit(buf[pos & PAYLOAD_SCAN_MASK]) && buf[(pos + 1) & PAYLOAD_SCAN_MASK] == ' ')
+    {
+      /* version, timestamp, hostname */
+      next = _skip_field(buf, pos, len);
+      if (next < 0)
+        return -1;
+      next = _skip_field(buf, next, len);
+      if (next < 0)
+        return -1;
+      return _skip_field(buf, next, len);
+    }
+
+  if (pos + 16 > len || buf[(pos + 3) & PAYLOAD_SCAN_MASK] != ' ' || buf[(pos + 9) & PAYLOAD_SCAN_MASK] != ':'
+      || buf[(pos + 15) & PAYLOAD_SCAN_MASK] != ' ')
+    return -1;
+
+  /* hostname */
+  return _skip_field(buf, pos + 16, len);
+}
+
+static __always_inline int
+_program_matches(const char *buf, __u32 pos, __u32 len)
+{
+  int program = _find_program(buf, pos, len);
+
+  if (program < 0)
+    return -1;
+
+  for (int i = 0; i < EBPF_FILTER_MAX_PROGRAM_PREFIX; i++)
+    {
+      if (i >= program_prefix_length)
+        return 1;
+      if (program + i >= len || buf[(program + i) & PAYLOAD_SCAN_MASK] != program_prefix[i])
+        return 0;
+    }
+  return 1;
+}
+
+/*
+ * Datagrams are passed to syslog-ng only if they match all the configured
+ * predicates. Anything that cannot be parsed here is passed, so that
+ * syslog-ng can deal with it as usual.
+ */
+SEC("socket")
+int syslog_filter(struct __sk_buff *skb)
+{
+  __u32 zero = 0;
+  char *buf;
+  __u32 len;
+
+  if (match_source_addresses && _source_address_matches(skb) == 0)
+    return DROP;
+
+  if (facility_mask || severity_mask || program_prefix_length)
+    {
+      if (skb->len <= payload_offset)
+        return KEEP(skb);
+
+      buf = bpf_map_lookup_elem(&payload_buffer, &zero);
+      if (!buf)
+        return KEEP(skb);
+
+      len = skb->len - payload_offset;
+      if (len > PAYLOAD_SCAN_SIZE)
+        len = PAYLOAD_SCAN_SIZE;
+      if (len < 1 || bpf_skb_load_bytes(skb, payload_offset, buf, len) < 0)
+        return KEEP(skb);
+
+      /* <PRI> */
+      __u32 pos = 1;
+      __u32 pri = 0;
+      if (buf[0] != '<')
+        return KEEP(skb);
+      for (int i = 0; i < 3 && pos < len && _is_digit(buf[pos & PAYLOAD_SCAN_MASK]); i++, pos++)
+        pri = pri * 10 + (buf[pos & PAYLOAD_SCAN_MASK] - '0');
+      if (pos == 1 || pos >= len || buf[pos & PAYLOAD_SCAN_MASK] != '>' || pri > 191)
+        return KEEP(skb);
+      pos++;
+
+      if (facility_mask && !(facility_mask & (1U << (pri >> 3))))
+        return DROP;
+      if (severity_mask && !(severity_mask & (1U << (pri & 7))))
+        return DROP;
+      if (program_prefix_length && _program_matches(buf, pos, len) == 0)
+        return DROP;
+    }
+
+  if (sample_rate > 1 && bpf_get_prandom_u32() % sample_rate != 0)
+    return DROP;
+
+  return KEEP(skb);
+}
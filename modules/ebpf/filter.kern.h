@@ -0,0 +1,38 @@
+/*
+ * Copyright (c) 2024 One Identity LLC.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#ifndef EBPF_FILTER_KERN_H_INCLUDED
+#define EBPF_FILTER_KERN_H_INCLUDED
+
+/* shared between filter.kern.c and ebpf-filter.c, the includer provides __u8 and __u32 */
+
+#define EBPF_FILTER_MAX_PROGRAM_PREFIX 32
+#define EBPF_FILTER_MAX_SOURCE_ADDRESSES 1024
+
+/* key of the source address LPM trie, IPv4 addresses are IPv4-mapped */
+struct ebpf_filter_address
+{
+  __u32 prefixlen;
+  __u8 addr[16];
+};
+
+#endif
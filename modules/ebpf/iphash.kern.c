@@ -0,0 +1,129 @@
+/*
+ * Copyright (c) 2024 One Identity LLC.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#include "vmlinux.h"
+#include <bpf/bpf_helpers.h>
+#include <bpf/bpf_endian.h>
+
+#include "reuseport.kern.h"
+
+#define ETH_P_IP 0x0800
+#define ETH_P_IPV6 0x86DD
+
+int number_of_sockets;
+int hash_source_port;
+__u32 rebalance_threshold;
+
+/* receive backlog of each socket of the group, updated by userspace */
+struct
+{
+  __uint(type, BPF_MAP_TYPE_ARRAY);
+  __uint(max_entries, EBPF_REUSEPORT_MAX_SOCKETS);
+  __type(key, __u32);
+  __type(value, __u32);
+} socket_backlog SEC(".maps");
+
+static __always_inline __u32
+_hash(__u32 value)
+{
+  /* multiplicative hashing, folding the better mixed high bits down */
+  value *= 2654435761u;
+  return value ^ (value >> 16);
+}
+
+/* both TCP and UDP start with the source port */
+static __always_inline int
+_load_source_port(struct __sk_buff *skb, __u32 transport_offset, __u16 *port)
+{
+  return bpf_skb_load_bytes_relative(skb, transport_offset, port, sizeof(*port), BPF_HDR_START_NET);
+}
+
+/*
+ * Stickiness is only given up if the socket chosen by the hash has more
+ * than rebalance_threshold in its backlog, in which case the least loaded
+ * socket is used instead.
+ */
+static __always_inline __u32
+_rebalance(__u32 index)
+{
+  __u32 *backlog = bpf_map_lookup_elem(&socket_backlog, &index);
+
+  if (!backlog || *backlog <= rebalance_threshold)
+    return index;
+
+  __u32 best = index;
+  __u32 best_backlog = *backlog;
+  for (__u32 i = 0; i < EBPF_REUSEPORT_MAX_SOCKETS && i < number_of_sockets; i++)
+    {
+      __u32 *candidate = bpf_map_lookup_elem(&socket_backlog, &i);
+
+      if (candidate && *candidate < best_backlog)
+        {
+          best = i;
+          best_backlog = *candidate;
+        }
+    }
+  return best;
+}
+
+/* packets of the same source address always end up in the same socket */
+SEC("socket")
+int source_ip_hash(struct __sk_buff *skb)
+{
+  __u32 saddr[4] = {0};
+  __u16 sport = 0;
+
+  if (number_of_sockets == 0)
+    return -1;
+
+  if (skb->protocol == bpf_htons(ETH_P_IP))
+    {
+      if (bpf_skb_load_bytes_relative(skb, offsetof(struct iphdr, saddr), &saddr[0], sizeof(saddr[0]),
+                                      BPF_HDR_START_NET) < 0)
+        return -1;
+
+      __u8 version_ihl;
+      if (hash_source_port
+          && (bpf_skb_load_bytes_relative(skb, 0, &version_ihl, sizeof(version_ihl), BPF_HDR_START_NET) < 0
+              || _load_source_port(skb, (version_ihl & 0x0f) * 4, &sport) < 0))
+        return -1;
+    }
+  else if (skb->protocol == bpf_htons(ETH_P_IPV6))
+    {
+      if (bpf_skb_load_bytes_relative(skb, offsetof(struct ipv6hdr, saddr), saddr, sizeof(saddr),
+                                      BPF_HDR_START_NET) < 0)
+        return -1;
+
+      /* extension headers are not followed */
+      if (hash_source_port && _load_source_port(skb, sizeof(struct ipv6hdr), &sport) < 0)
+        return -1;
+    }
+  else
+    return -1;
+
+  __u32 index = _hash(saddr[0] ^ saddr[1] ^ saddr[2] ^ saddr[3] ^ sport) % number_of_sockets;
+
+  if (rebalance_threshold)
+    index = _rebalance(index);
+
+  return _count_hit(index);
+}
@@ -23,6 +23,8 @@
 #include "vmlinux.h"
 #include <bpf/bpf_helpers.h>
 
+#include "reuseport.kern.h"
+
 int number_of_sockets;
 
 SEC("socket")
@@ -31,5 +33,5 @@ int random_choice(struct __sk_buff *skb)
   if (number_of_sockets == 0)
     return -1;
 
-  return bpf_get_prandom_u32() % number_of_sockets;
+  return _count_hit(bpf_get_prandom_u32() % number_of_sockets);
 }
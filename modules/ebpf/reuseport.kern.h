@@ -0,0 +1,53 @@
+/*
+ * Copyright (c) 2024 One Identity LLC.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#ifndef EBPF_REUSEPORT_KERN_H_INCLUDED
+#define EBPF_REUSEPORT_KERN_H_INCLUDED
+
+/* shared between the reuseport programs and ebpf-reuseport.c */
+
+#define EBPF_REUSEPORT_MAX_SOCKETS 256
+
+#if defined(__bpf__)
+
+/* number of packets steered to each socket of the group, read by userspace */
+struct
+{
+  __uint(type, BPF_MAP_TYPE_PERCPU_ARRAY);
+  __uint(max_entries, EBPF_REUSEPORT_MAX_SOCKETS);
+  __type(key, __u32);
+  __type(value, __u64);
+} socket_hits SEC(".maps");
+
+static __always_inline int
+_count_hit(__u32 index)
+{
+  __u64 *hits = bpf_map_lookup_elem(&socket_hits, &index);
+
+  if (hits)
+    (*hits)++;
+  return index;
+}
+
+#endif
+
+#endif
@@ -0,0 +1,222 @@
+/*
+ * Copyright (c) 2024 One Identity LLC.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#include <criterion/criterion.h>
+#include "libtest/grab-logging.h"
+
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <unistd.h>
+#include <bpf/bpf.h>
+
+/*
+ * The program itself is not loaded into the kernel: the map updates are
+ * replaced with the mock below, which records the keys of the source
+ * address trie.
+ */
+
+#define SOURCE_ADDRESSES_MAP_FD 42
+
+static GArray *loaded_addresses;
+
+static int
+_mock_bpf_map__fd(const struct bpf_map *map)
+{
+  return SOURCE_ADDRESSES_MAP_FD;
+}
+
+static int
+_mock_bpf_map_update_elem(int fd, const void *key, const void *value, __u64 flags)
+{
+  cr_assert_eq(fd, SOURCE_ADDRESSES_MAP_FD);
+  cr_assert_eq(*(const __u8 *) value, 1);
+  g_array_append_vals(loaded_addresses, key, 1);
+  return 0;
+}
+
+#define bpf_map__fd _mock_bpf_map__fd
+#define bpf_map_update_elem _mock_bpf_map_update_elem
+#include "ebpf-filter.c"
+#undef bpf_map__fd
+#undef bpf_map_update_elem
+
+#include "apphook.h"
+
+static LogDriverPlugin *plugin;
+
+static void
+_assert_ipv4_mapped(const struct ebpf_filter_address *key, const guint8 ipv4[4])
+{
+  static const guint8 prefix[12] = { [10] = 0xff, [11] = 0xff };
+
+  cr_assert_arr_eq(key->addr, prefix, sizeof(prefix), "IPv4 addresses must be IPv4-mapped");
+  cr_assert_arr_eq(&key->addr[12], ipv4, 4);
+}
+
+Test(ebpf_filter, test_ipv4_cidrs_are_mapped_into_the_ipv6_trie)
+{
+  struct ebpf_filter_address key;
+
+  cr_assert(_parse_cidr("10.20.0.0/16", &key));
+  _assert_ipv4_mapped(&key, (guint8[]) { 10, 20, 0, 0 });
+  cr_assert_eq(key.prefixlen, 96 + 16);
+
+  cr_assert(_parse_cidr("192.168.1.1", &key));
+  _assert_ipv4_mapped(&key, (guint8[]) { 192, 168, 1, 1 });
+  cr_assert_eq(key.prefixlen, 128, "an address without a prefix length is a single host");
+
+  cr_assert(_parse_cidr("0.0.0.0/0", &key));
+  cr_assert_eq(key.prefixlen, 96, "0.0.0.0/0 must only match IPv4 addresses");
+}
+
+Test(ebpf_filter, test_ipv6_cidrs)
+{
+  struct ebpf_filter_address key;
+
+  cr_assert(_parse_cidr("2001:db8::/32", &key));
+  cr_assert_arr_eq(key.addr, ((guint8[]) { 0x20, 0x01, 0x0d, 0xb8 }), 4);
+  cr_assert_eq(key.prefixlen, 32);
+
+  cr_assert(_parse_cidr("::1", &key));
+  cr_assert_eq(key.addr[15], 1);
+  cr_assert_eq(key.prefixlen, 128);
+}
+
+Test(ebpf_filter, test_invalid_cidrs_are_rejected)
+{
+  const gchar *invalid_cidrs[] =
+  {
+    "10.0.0.0/33", "10.0.0.0/", "10.0.0.0/8x", "10.0.0.0/-1", "10.0.0/8",
+    "2001:db8::/129", "example.com", "",
+  };
+  struct ebpf_filter_address key;
+
+  for (gsize i = 0; i < G_N_ELEMENTS(invalid_cidrs); i++)
+    cr_assert_not(_parse_cidr(invalid_cidrs[i], &key), "invalid CIDR accepted: %s", invalid_cidrs[i]);
+
+  cr_assert_not(ebpf_filter_add_source_address(plugin, "10.0.0.0/33"));
+  cr_assert_eq(((EBPFFilter *) plugin)->source_addresses->len, 0);
+}
+
+Test(ebpf_filter, test_number_of_source_addresses_is_limited_by_the_trie)
+{
+  for (gint i = 0; i < EBPF_FILTER_MAX_SOURCE_ADDRESSES; i++)
+    {
+      gchar cidr[32];
+
+      g_snprintf(cidr, sizeof(cidr), "10.%d.%d.0/24", i / 256, i % 256);
+      cr_assert(ebpf_filter_add_source_address(plugin, cidr), "unable to add source address #%d", i);
+    }
+
+  cr_assert_not(ebpf_filter_add_source_address(plugin, "192.168.0.0/16"));
+  cr_assert_eq(((EBPFFilter *) plugin)->source_addresses->len, EBPF_FILTER_MAX_SOURCE_ADDRESSES);
+}
+
+Test(ebpf_filter, test_program_prefix_must_fit_into_the_program)
+{
+  EBPFFilter *self = (EBPFFilter *) plugin;
+  gchar longest_prefix[EBPF_FILTER_MAX_PROGRAM_PREFIX + 2];
+
+  memset(longest_prefix, 'p', sizeof(longest_prefix) - 1);
+  longest_prefix[sizeof(longest_prefix) - 1] = '\0';
+  cr_assert_not(ebpf_filter_set_program_prefix(plugin, longest_prefix));
+  cr_assert_null(self->program_prefix);
+
+  longest_prefix[EBPF_FILTER_MAX_PROGRAM_PREFIX] = '\0';
+  cr_assert(ebpf_filter_set_program_prefix(plugin, longest_prefix));
+  cr_assert_str_eq(self->program_prefix, longest_prefix);
+
+  cr_assert_not(ebpf_filter_set_program_prefix(plugin, "a-program-prefix-longer-than-32-bytes"));
+  cr_assert_str_eq(self->program_prefix, longest_prefix, "a rejected prefix must not replace the previous one");
+}
+
+Test(ebpf_filter, test_source_addresses_are_loaded_into_the_map)
+{
+  EBPFFilter *self = (EBPFFilter *) plugin;
+  struct filter_kern filter = { 0 };
+
+  cr_assert(ebpf_filter_add_source_address(plugin, "10.0.0.0/8"));
+  cr_assert(ebpf_filter_add_source_address(plugin, "2001:db8::/32"));
+
+  self->filter = &filter;
+  cr_assert(_load_source_addresses(self));
+  self->filter = NULL;
+
+  cr_assert_eq(loaded_addresses->len, 2);
+  struct ebpf_filter_address *key = &g_array_index(loaded_addresses, struct ebpf_filter_address, 0);
+  _assert_ipv4_mapped(key, (guint8[]) { 10, 0, 0, 0 });
+  cr_assert_eq(key->prefixlen, 96 + 8);
+
+  key = &g_array_index(loaded_addresses, struct ebpf_filter_address, 1);
+  cr_assert_eq(key->addr[0], 0x20);
+  cr_assert_eq(key->prefixlen, 32);
+}
+
+static gboolean
+_get_payload_offset_of_new_socket(gint domain, gint type, guint32 *payload_offset)
+{
+  gint sock = socket(domain, type, 0);
+
+  cr_assert_geq(sock, 0, "unable to create socket: %s", g_strerror(errno));
+  gboolean result = _get_payload_offset(sock, payload_offset);
+  close(sock);
+  return result;
+}
+
+Test(ebpf_filter, test_payload_follows_the_udp_header)
+{
+  guint32 payload_offset = 0;
+
+  cr_assert(_get_payload_offset_of_new_socket(AF_INET, SOCK_DGRAM, &payload_offset));
+  cr_assert_eq(payload_offset, 8);
+
+  cr_assert(_get_payload_offset_of_new_socket(AF_UNIX, SOCK_DGRAM, &payload_offset));
+  cr_assert_eq(payload_offset, 0, "unix datagrams have no header in front of the payload");
+}
+
+Test(ebpf_filter, test_stream_sockets_are_rejected)
+{
+  guint32 payload_offset;
+
+  start_grabbing_messages();
+  cr_assert_not(_get_payload_offset_of_new_socket(AF_INET, SOCK_STREAM, &payload_offset));
+  assert_grabbed_log_contains("only datagram sockets are supported");
+  stop_grabbing_messages();
+}
+
+static void
+setup(void)
+{
+  app_startup();
+  loaded_addresses = g_array_new(FALSE, TRUE, sizeof(struct ebpf_filter_address));
+  plugin = ebpf_filter_new();
+}
+
+static void
+teardown(void)
+{
+  log_driver_plugin_free(plugin);
+  g_array_free(loaded_addresses, TRUE);
+  app_shutdown();
+}
+
+TestSuite(ebpf_filter, .init = setup, .fini = teardown);
@@ -0,0 +1,311 @@
+/*
+ * Copyright (c) 2024 One Identity LLC.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#include <criterion/criterion.h>
+#include "libtest/grab-logging.h"
+
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#include <bpf/bpf.h>
+#include <bpf/libbpf.h>
+
+/*
+ * No program is loaded into the kernel: the maps are identified by fake
+ * file descriptors, the per-CPU hit counters are served from hits_per_cpu
+ * and the backlog updates of userspace are recorded.
+ */
+
+#define HITS_MAP_FD 42
+#define BACKLOG_MAP_FD 43
+#define NUMBER_OF_CPUS 4
+#define NUMBER_OF_SOCKETS 3
+
+static guint64 hits_per_cpu[NUMBER_OF_SOCKETS][NUMBER_OF_CPUS];
+static GHashTable *updated_backlogs;
+
+static int
+_mock_bpf_map__fd(const struct bpf_map *map)
+{
+  return GPOINTER_TO_INT(map);
+}
+
+static int
+_mock_libbpf_num_possible_cpus(void)
+{
+  return NUMBER_OF_CPUS;
+}
+
+static int
+_mock_bpf_map_lookup_elem(int fd, const void *key, void *value)
+{
+  guint32 index = *(const guint32 *) key;
+
+  cr_assert_eq(fd, HITS_MAP_FD);
+  if (index >= NUMBER_OF_SOCKETS)
+    return -1;
+
+  memcpy(value, hits_per_cpu[index], sizeof(hits_per_cpu[index]));
+  return 0;
+}
+
+static int
+_mock_bpf_map_update_elem(int fd, const void *key, const void *value, __u64 flags)
+{
+  cr_assert_eq(fd, BACKLOG_MAP_FD);
+  g_hash_table_insert(updated_backlogs, GUINT_TO_POINTER(*(const guint32 *) key),
+                      GUINT_TO_POINTER(*(const guint32 *) value));
+  return 0;
+}
+
+#define bpf_map__fd _mock_bpf_map__fd
+#define libbpf_num_possible_cpus _mock_libbpf_num_possible_cpus
+#define bpf_map_lookup_elem _mock_bpf_map_lookup_elem
+#define bpf_map_update_elem _mock_bpf_map_update_elem
+#include "ebpf-reuseport.c"
+#undef bpf_map__fd
+#undef libbpf_num_possible_cpus
+#undef bpf_map_lookup_elem
+#undef bpf_map_update_elem
+
+#include "apphook.h"
+#include "stats/stats.h"
+
+static LogDriverPlugin *plugin;
+static struct iphash_kern iphash;
+static GArray *sockets;
+static StatsOptions stats_options;
+
+/* the part of _attach() that does not need the kernel */
+static EBPFReusePort *
+_attach_with_fake_program(const gchar *balance, guint32 rebalance_threshold)
+{
+  EBPFReusePort *self = (EBPFReusePort *) plugin;
+
+  cr_assert(ebpf_reuseport_set_balance(plugin, balance));
+  ebpf_reuseport_set_sockets(plugin, NUMBER_OF_SOCKETS);
+  ebpf_reuseport_set_rebalance_threshold(plugin, rebalance_threshold);
+
+  iphash.maps.socket_hits = (struct bpf_map *) GINT_TO_POINTER(HITS_MAP_FD);
+  iphash.maps.socket_backlog = (struct bpf_map *) GINT_TO_POINTER(BACKLOG_MAP_FD);
+  self->iphash = &iphash;
+
+  self->hits = g_new0(StatsCounterItem *, self->number_of_sockets);
+  self->socket_labels = g_new0(gchar *, self->number_of_sockets + 1);
+  for (gint i = 0; i < self->number_of_sockets; i++)
+    self->socket_labels[i] = g_strdup_printf("%d", i);
+  self->stats_id = g_strdup("s_network");
+  _register_counters(self);
+
+  return self;
+}
+
+static gint
+_new_udp_socket(void)
+{
+  struct sockaddr_in sin = { .sin_family = AF_INET, .sin_addr.s_addr = htonl(INADDR_LOOPBACK) };
+  gint sock = socket(AF_INET, SOCK_DGRAM, 0);
+
+  cr_assert_geq(sock, 0, "unable to create socket: %s", g_strerror(errno));
+  cr_assert_eq(bind(sock, (struct sockaddr *) &sin, sizeof(sin)), 0);
+  g_array_append_val(sockets, sock);
+  return sock;
+}
+
+static void
+_send_datagrams(gint sock, gint num)
+{
+  struct sockaddr_in sin;
+  socklen_t len = sizeof(sin);
+
+  cr_assert_eq(getsockname(sock, (struct sockaddr *) &sin, &len), 0);
+  for (gint i = 0; i < num; i++)
+    cr_assert_eq(sendto(sock, "<13>test", 8, 0, (struct sockaddr *) &sin, len), 8);
+}
+
+static void
+_join_group(EBPFReusePort *self, gint sock, gint type)
+{
+  EBPFReusePortSocket reuseport_socket = { .fd = sock, .type = type };
+
+  g_array_append_val(self->sockets, reuseport_socket);
+}
+
+static gsize
+_get_hits_counter(const gchar *socket_label)
+{
+  StatsClusterKey key;
+  StatsClusterLabel labels[] =
+  {
+    stats_cluster_label("id", "s_network"),
+    stats_cluster_label("socket", socket_label),
+  };
+
+  stats_cluster_single_key_set(&key, "ebpf_reuseport_hits_total", labels, G_N_ELEMENTS(labels));
+  stats_lock();
+  StatsCounterItem *counter = stats_get_counter(&key, SC_TYPE_SINGLE_VALUE);
+  stats_unlock();
+
+  cr_assert_not_null(counter, "hits of socket %s are not exported", socket_label);
+  return stats_counter_get(counter);
+}
+
+Test(ebpf_reuseport, test_balance_modes)
+{
+  EBPFReusePort *self = (EBPFReusePort *) plugin;
+
+  cr_assert_str_eq(_format_balance(self), "random");
+  cr_assert_not(_is_hashing(self));
+
+  cr_assert(ebpf_reuseport_set_balance(plugin, "source-ip"));
+  cr_assert_str_eq(_format_balance(self), "source-ip");
+  cr_assert(_is_hashing(self));
+
+  cr_assert(ebpf_reuseport_set_balance(plugin, "source-ip-port"));
+  cr_assert_str_eq(_format_balance(self), "source-ip-port");
+  cr_assert(_is_hashing(self));
+
+  cr_assert_not(ebpf_reuseport_set_balance(plugin, "round-robin"));
+  cr_assert_str_eq(_format_balance(self), "source-ip-port", "an invalid mode must not change the balance");
+
+  cr_assert(ebpf_reuseport_set_balance(plugin, "random"));
+  cr_assert_not(_is_hashing(self));
+}
+
+Test(ebpf_reuseport, test_hits_are_summed_up_across_cpus_and_exported_per_socket)
+{
+  EBPFReusePort *self = _attach_with_fake_program("source-ip", 0);
+
+  memcpy(hits_per_cpu[0], (guint64[NUMBER_OF_CPUS]) { 1, 2, 3, 4 }, sizeof(hits_per_cpu[0]));
+  memcpy(hits_per_cpu[2], (guint64[NUMBER_OF_CPUS]) { 100, 0, 0, 1 }, sizeof(hits_per_cpu[2]));
+  _update_hits(self);
+
+  cr_assert_eq(_get_hits_counter("0"), 10);
+  cr_assert_eq(_get_hits_counter("1"), 0);
+  cr_assert_eq(_get_hits_counter("2"), 101);
+
+  /* the kernel side counters are cumulative, they are not added up again */
+  hits_per_cpu[0][3] += 5;
+  _update_hits(self);
+  cr_assert_eq(_get_hits_counter("0"), 15);
+  cr_assert_eq(_get_hits_counter("2"), 101);
+}
+
+Test(ebpf_reuseport, test_backlogs_are_published_by_group_index)
+{
+  EBPFReusePort *self = _attach_with_fake_program("source-ip", 1024);
+
+  gint idle = _new_udp_socket();
+  gint busy = _new_udp_socket();
+  _send_datagrams(busy, 3);
+
+  _join_group(self, idle, SOCK_DGRAM);
+  _join_group(self, busy, SOCK_DGRAM);
+  _update_backlogs(self);
+
+  cr_assert_eq(g_hash_table_size(updated_backlogs), 2);
+  cr_assert_eq(GPOINTER_TO_UINT(g_hash_table_lookup(updated_backlogs, GUINT_TO_POINTER(0))), 0);
+  cr_assert_gt(GPOINTER_TO_UINT(g_hash_table_lookup(updated_backlogs, GUINT_TO_POINTER(1))), 0,
+               "queued datagrams are not counted as the backlog of the socket");
+}
+
+Test(ebpf_reuseport, test_accept_queue_is_the_backlog_of_a_listener)
+{
+  EBPFReusePort *self = _attach_with_fake_program("source-ip-port", 1);
+  struct sockaddr_in sin = { .sin_family = AF_INET, .sin_addr.s_addr = htonl(INADDR_LOOPBACK) };
+  socklen_t len = sizeof(sin);
+
+  gint listener = socket(AF_INET, SOCK_STREAM, 0);
+  g_array_append_val(sockets, listener);
+  cr_assert_eq(bind(listener, (struct sockaddr *) &sin, sizeof(sin)), 0);
+  cr_assert_eq(listen(listener, 16), 0);
+  cr_assert_eq(getsockname(listener, (struct sockaddr *) &sin, &len), 0);
+
+  /* the connections are not accepted, they stay in the accept queue */
+  for (gint i = 0; i < 2; i++)
+    {
+      gint client = socket(AF_INET, SOCK_STREAM, 0);
+      g_array_append_val(sockets, client);
+      cr_assert_eq(connect(client, (struct sockaddr *) &sin, len), 0);
+    }
+
+  _join_group(self, listener, SOCK_STREAM);
+  _update_backlogs(self);
+
+  cr_assert_eq(GPOINTER_TO_UINT(g_hash_table_lookup(updated_backlogs, GUINT_TO_POINTER(0))), 2);
+}
+
+Test(ebpf_reuseport, test_backlogs_are_only_published_when_rebalancing)
+{
+  EBPFReusePort *self = _attach_with_fake_program("source-ip", 0);
+
+  gint busy = _new_udp_socket();
+  _send_datagrams(busy, 1);
+  _join_group(self, busy, SOCK_DGRAM);
+
+  _update(self);
+  cr_assert_eq(g_hash_table_size(updated_backlogs), 0);
+  cr_assert(iv_timer_registered(&self->update_timer), "the next update is not scheduled");
+  iv_timer_unregister(&self->update_timer);
+
+  ebpf_reuseport_set_rebalance_threshold(plugin, 1);
+  _update(self);
+  cr_assert_eq(g_hash_table_size(updated_backlogs), 1);
+  iv_timer_unregister(&self->update_timer);
+}
+
+static void
+setup(void)
+{
+  app_startup();
+
+  stats_options_defaults(&stats_options);
+  stats_options.level = STATS_LEVEL1;
+  stats_reinit(&stats_options);
+
+  memset(hits_per_cpu, 0, sizeof(hits_per_cpu));
+  memset(&iphash, 0, sizeof(iphash));
+  updated_backlogs = g_hash_table_new(g_direct_hash, g_direct_equal);
+  sockets = g_array_new(FALSE, FALSE, sizeof(gint));
+  plugin = ebpf_reuseport_new();
+}
+
+static void
+teardown(void)
+{
+  EBPFReusePort *self = (EBPFReusePort *) plugin;
+
+  if (self->hits)
+    _unregister_counters(self);
+  /* nothing was loaded, the program must not be destroyed */
+  self->iphash = NULL;
+  log_driver_plugin_free(plugin);
+
+  for (guint i = 0; i < sockets->len; i++)
+    close(g_array_index(sockets, gint, i));
+  g_array_free(sockets, TRUE);
+  g_hash_table_destroy(updated_backlogs);
+  app_shutdown();
+}
+
+TestSuite(ebpf_reuseport, .init = setup, .fini = teardown);
@@ -0,0 +1,298 @@
+/*
+ * Copyright (c) 2024 One Identity LLC.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#include "geoip-cache.h"
+#include "scratch-buffers.h"
+#include "messages.h"
+#include <iv_list.h>
+
+#define GEOIP_CACHE_MAX_ENTRIES 512
+
+struct _GeoIPDatabase
+{
+  gint ref_cnt;
+  guint id;
+  gchar *path;
+  MMDB_s mmdb;
+};
+
+struct _GeoIPCachedResult
+{
+  struct iv_list_head lru;
+  gchar *key;
+  gboolean found;
+  MMDB_lookup_result_s result;
+
+  /* path -> formatted value, NULL if the path does not lead to a scalar */
+  GHashTable *paths;
+
+  /* name, value pairs of the complete record, decoded on first use */
+  GPtrArray *fields;
+};
+
+typedef struct _GeoIPThreadCache
+{
+  GHashTable *entries;
+  struct iv_list_head lru;
+  GString *key;
+} GeoIPThreadCache;
+
+G_LOCK_DEFINE_STATIC(geoip_databases);
+static GHashTable *geoip_databases;
+static guint geoip_database_next_id;
+
+GeoIPDatabase *
+geoip_database_acquire(const gchar *path)
+{
+  GeoIPDatabase *self;
+
+  G_LOCK(geoip_databases);
+  if (!geoip_databases)
+    geoip_databases = g_hash_table_new(g_str_hash, g_str_equal);
+
+  self = g_hash_table_lookup(geoip_databases, path);
+  if (self)
+    {
+      self->ref_cnt++;
+      goto exit;
+    }
+
+  self = g_new0(GeoIPDatabase, 1);
+  if (!mmdb_open_database(path, &self->mmdb))
+    {
+      g_free(self);
+      self = NULL;
+      goto exit;
+    }
+
+  self->ref_cnt = 1;
+  self->id = ++geoip_database_next_id;
+  self->path = g_strdup(path);
+  g_hash_table_insert(geoip_databases, self->path, self);
+
+exit:
+  G_UNLOCK(geoip_databases);
+  return self;
+}
+
+void
+geoip_database_release(GeoIPDatabase *self)
+{
+  if (!self)
+    return;
+
+  G_LOCK(geoip_databases);
+  if (--self->ref_cnt == 0)
+    {
+      /* entries referring to this instance stay in the per-thread caches
+       * until they are evicted, but they never match again as a reopened
+       * database gets a new id */
+      g_hash_table_remove(geoip_databases, self->path);
+      MMDB_close(&self->mmdb);
+      g_free(self->path);
+      g_free(self);
+    }
+  G_UNLOCK(geoip_databases);
+}
+
+static void
+_cached_result_free(GeoIPCachedResult *self)
+{
+  if (self->paths)
+    g_hash_table_unref(self->paths);
+  if (self->fields)
+    g_ptr_array_free(self->fields, TRUE);
+  g_free(self->key);
+  g_free(self);
+}
+
+static void
+_thread_cache_free(gpointer s)
+{
+  GeoIPThreadCache *self = (GeoIPThreadCache *) s;
+
+  g_hash_table_unref(self->entries);
+  g_string_free(self->key, TRUE);
+  g_free(self);
+}
+
+static GPrivate geoip_thread_cache = G_PRIVATE_INIT(_thread_cache_free);
+
+static GeoIPThreadCache *
+_get_thread_cache(void)
+{
+  GeoIPThreadCache *self = g_private_get(&geoip_thread_cache);
+
+  if (!self)
+    {
+      self = g_new0(GeoIPThreadCache, 1);
+      self->entries = g_hash_table_new_full(g_str_hash, g_str_equal, NULL, (GDestroyNotify) _cached_result_free);
+      INIT_IV_LIST_HEAD(&self->lru);
+      self->key = g_string_sized_new(64);
+      g_private_set(&geoip_thread_cache, self);
+    }
+  return self;
+}
+
+static void
+_thread_cache_evict_oldest(GeoIPThreadCache *self)
+{
+  GeoIPCachedResult *oldest = iv_list_entry(self->lru.prev, GeoIPCachedResult, lru);
+
+  iv_list_del(&oldest->lru);
+  g_hash_table_remove(self->entries, oldest->key);
+}
+
+GeoIPCachedResult *
+geoip_cache_lookup(GeoIPDatabase *db, const gchar *ip, gint *gai_error, gint *mmdb_error)
+{
+  GeoIPThreadCache *cache = _get_thread_cache();
+
+  *gai_error = 0;
+  *mmdb_error = MMDB_SUCCESS;
+
+  g_string_printf(cache->key, "%u/%s", db->id, ip);
+  GeoIPCachedResult *self = g_hash_table_lookup(cache->entries, cache->key->str);
+  if (self)
+    {
+      iv_list_del(&self->lru);
+      iv_list_add(&self->lru, &cache->lru);
+      return self->found ? self : NULL;
+    }
+
+  MMDB_lookup_result_s result = MMDB_lookup_string(&db->mmdb, ip, gai_error, mmdb_error);
+
+  /* invalid input and database errors are not cached, those are reported
+   * by the caller on every occurrence */
+  if (*gai_error != 0 || *mmdb_error != MMDB_SUCCESS)
+    return NULL;
+
+  if (g_hash_table_size(cache->entries) >= GEOIP_CACHE_MAX_ENTRIES)
+    _thread_cache_evict_oldest(cache);
+
+  self = g_new0(GeoIPCachedResult, 1);
+  self->key = g_strdup(cache->key->str);
+  self->found = result.found_entry;
+  self->result = result;
+  iv_list_add(&self->lru, &cache->lru);
+  g_hash_table_insert(cache->entries, self->key, self);
+
+  return self->found ? self : NULL;
+}
+
+static gboolean
+_is_scalar(const MMDB_entry_data_s *entry_data)
+{
+  switch (entry_data->type)
+    {
+    case MMDB_DATA_TYPE_UTF8_STRING:
+    case MMDB_DATA_TYPE_DOUBLE:
+    case MMDB_DATA_TYPE_FLOAT:
+    case MMDB_DATA_TYPE_UINT16:
+    case MMDB_DATA_TYPE_UINT32:
+    case MMDB_DATA_TYPE_INT32:
+    case MMDB_DATA_TYPE_UINT64:
+    case MMDB_DATA_TYPE_BOOLEAN:
+      return TRUE;
+    default:
+      return FALSE;
+    }
+}
+
+const gchar *
+geoip_cached_result_get_path(GeoIPCachedResult *self, const gchar *path, gchar **split_path)
+{
+  gpointer value;
+
+  if (!self->paths)
+    self->paths = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
+  else if (g_hash_table_lookup_extended(self->paths, path, NULL, &value))
+    return value;
+
+  MMDB_entry_data_s entry_data;
+  gchar *formatted = NULL;
+  gint mmdb_error = MMDB_aget_value(&self->result.entry, &entry_data, (const char *const *const) split_path);
+
+  if (mmdb_error == MMDB_SUCCESS && entry_data.has_data && _is_scalar(&entry_data))
+    {
+      GString *buffer = scratch_buffers_alloc();
+
+      append_mmdb_entry_data_to_gstring(buffer, &entry_data);
+      formatted = g_strndup(buffer->str, buffer->len);
+    }
+  else if (mmdb_error != MMDB_SUCCESS)
+    {
+      msg_debug("geoip2: unable to look up path in record",
+                evt_tag_str("path", path),
+                evt_tag_str("error", MMDB_strerror(mmdb_error)));
+    }
+
+  g_hash_table_insert(self->paths, g_strdup(path), formatted);
+  return formatted;
+}
+
+static void
+_collect_field(const gchar *name, const gchar *value, gssize value_len, gpointer user_data)
+{
+  GPtrArray *fields = (GPtrArray *) user_data;
+
+  g_ptr_array_add(fields, g_strdup(name));
+  g_ptr_array_add(fields, g_strndup(value, value_len));
+}
+
+static gboolean
+_load_fields(GeoIPCachedResult *self)
+{
+  MMDB_entry_data_list_s *entry_data_list;
+
+  gint mmdb_error = MMDB_get_entry_data_list(&self->result.entry, &entry_data_list);
+  if (mmdb_error != MMDB_SUCCESS)
+    {
+      msg_debug("geoip2: MMDB_get_entry_data_list",
+                evt_tag_str("error", MMDB_strerror(mmdb_error)));
+      return FALSE;
+    }
+
+  GArray *path = g_array_new(TRUE, FALSE, sizeof(gchar *));
+  gint status = MMDB_SUCCESS;
+
+  self->fields = g_ptr_array_new_with_free_func(g_free);
+  dump_geodata_into_msg(_collect_field, self->fields, entry_data_list, path, &status);
+
+  MMDB_free_entry_data_list(entry_data_list);
+  g_array_free(path, TRUE);
+  return TRUE;
+}
+
+gboolean
+geoip_cached_result_foreach_field(GeoIPCachedResult *self, MMDBDumpFunc func, gpointer user_data)
+{
+  if (!self->fields && !_load_fields(self))
+    return FALSE;
+
+  for (guint i = 0; i + 1 < self->fields->len; i += 2)
+    {
+      const gchar *value = g_ptr_array_index(self->fields, i + 1);
+      func(g_ptr_array_index(self->fields, i), value, strlen(value), user_data);
+    }
+  return TRUE;
+}
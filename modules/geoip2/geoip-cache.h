@@ -0,0 +1,48 @@
+/*
+ * Copyright (c) 2024 One Identity LLC.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#ifndef GEOIP_CACHE_H_INCLUDED
+#define GEOIP_CACHE_H_INCLUDED
+
+#include "maxminddb-helper.h"
+
+/*
+ * The database is opened once per path and shared (read-only, mmap-ed)
+ * between the geoip2() parsers and the $(geoip2) template functions that
+ * refer to it.  Lookups go through a small per-thread LRU keyed by the IP
+ * address, so hot addresses neither walk the search tree nor decode the
+ * record again.
+ */
+typedef struct _GeoIPDatabase GeoIPDatabase;
+typedef struct _GeoIPCachedResult GeoIPCachedResult;
+
+GeoIPDatabase *geoip_database_acquire(const gchar *path);
+void geoip_database_release(GeoIPDatabase *self);
+
+/* the returned result is owned by the calling thread's cache and remains
+ * valid until the next geoip_cache_lookup() call on the same thread */
+GeoIPCachedResult *geoip_cache_lookup(GeoIPDatabase *db, const gchar *ip, gint *gai_error, gint *mmdb_error);
+
+const gchar *geoip_cached_result_get_path(GeoIPCachedResult *self, const gchar *path, gchar **split_path);
+gboolean geoip_cached_result_foreach_field(GeoIPCachedResult *self, MMDBDumpFunc func, gpointer user_data);
+
+#endif
@@ -21,19 +21,35 @@
  */
 
 #include "geoip-parser.h"
-#include "maxminddb-helper.h"
+#include "geoip-cache.h"
+#include "string-list.h"
 
 typedef struct _GeoIPParser GeoIPParser;
 
+typedef struct _GeoIPField
+{
+  gchar *path;
+  gchar **split_path;
+} GeoIPField;
+
 struct _GeoIPParser
 {
   LogParser super;
-  MMDB_s *database;
+  GeoIPDatabase *database;
 
   gchar *database_path;
   gchar *prefix;
+  GList *fields;
+  GArray *field_paths;
 };
 
+typedef struct _GeoIPParserEmitState
+{
+  GeoIPParser *self;
+  LogMessage *msg;
+  GString *name;
+} GeoIPParserEmitState;
+
 void
 geoip_parser_set_prefix(LogParser *s, const gchar *prefix)
 {
@@ -52,14 +68,22 @@ geoip_parser_set_database_path(LogParser *s, const gchar *database_path)
   self->database_path = g_strdup(database_path);
 }
 
-static gboolean
-_mmdb_load_entry_data_list(GeoIPParser *self, const gchar *input, MMDB_entry_data_list_s **entry_data_list)
+void
+geoip_parser_set_fields(LogParser *s, GList *fields)
+{
+  GeoIPParser *self = (GeoIPParser *) s;
+
+  string_list_free(self->fields);
+  self->fields = fields;
+}
+
+static GeoIPCachedResult *
+_lookup(GeoIPParser *self, const gchar *input)
 {
   int _gai_error, mmdb_error;
-  MMDB_lookup_result_s result =
-    MMDB_lookup_string(self->database, input, &_gai_error, &mmdb_error);
+  GeoIPCachedResult *result = geoip_cache_lookup(self->database, input, &_gai_error, &mmdb_error);
 
-  if (!result.found_entry)
+  if (!result)
     {
       if (_gai_error != 0)
         msg_error("geoip2(): getaddrinfo failed",
@@ -72,18 +96,33 @@ _mmdb_load_entry_data_list(GeoIPParser *self, const gchar *input, MMDB_entry_dat
                   evt_tag_str("error", MMDB_strerror(mmdb_error)),
                   evt_tag_str("ip", input),
                   log_pipe_location_tag(&self->super.super));
-
-      return FALSE;
     }
 
-  mmdb_error = MMDB_get_entry_data_list(&result.entry, entry_data_list);
-  if (MMDB_SUCCESS != mmdb_error)
+  return result;
+}
+
+static void
+_set_value(const gchar *name, const gchar *value, gssize value_len, gpointer user_data)
+{
+  GeoIPParserEmitState *state = (GeoIPParserEmitState *) user_data;
+
+  g_string_assign(state->name, state->self->prefix);
+  g_string_append_c(state->name, '.');
+  g_string_append(state->name, name);
+  log_msg_set_value_by_name(state->msg, state->name->str, value, value_len);
+}
+
+static void
+_set_selected_fields(GeoIPParser *self, GeoIPCachedResult *result, GeoIPParserEmitState *state)
+{
+  for (guint i = 0; i < self->field_paths->len; i++)
     {
-      msg_debug("GeoIP2: MMDB_get_entry_data_list",
-                evt_tag_str("error", MMDB_strerror(mmdb_error)));
-      return FALSE;
+      GeoIPField *field = &g_array_index(self->field_paths, GeoIPField, i);
+      const gchar *value = geoip_cached_result_get_path(result, field->path, field->split_path);
+
+      if (value)
+        _set_value(field->path, value, -1, state);
     }
-  return TRUE;
 }
 
 static gboolean
@@ -98,18 +137,16 @@ maxminddb_parser_process(LogParser *s, LogMessage **pmsg,
             evt_tag_str("prefix", self->prefix),
             evt_tag_msg_reference(*pmsg));
 
-  MMDB_entry_data_list_s *entry_data_list;
-  if (!_mmdb_load_entry_data_list(self, input, &entry_data_list))
+  GeoIPCachedResult *result = _lookup(self, input);
+  if (!result)
     return TRUE;
 
-  GArray *path = g_array_new(TRUE, FALSE, sizeof(gchar *));
-  g_array_append_val(path, self->prefix);
-
-  gint status;
-  dump_geodata_into_msg(msg, entry_data_list, path, &status);
+  GeoIPParserEmitState state = { .self = self, .msg = msg, .name = scratch_buffers_alloc() };
 
-  MMDB_free_entry_data_list(entry_data_list);
-  g_array_free(path, TRUE);
+  if (self->field_paths)
+    _set_selected_fields(self, result, &state);
+  else
+    geoip_cached_result_foreach_field(result, _set_value, &state);
 
   return TRUE;
 }
@@ -125,10 +162,46 @@ maxminddb_parser_clone(LogPipe *s)
 
   geoip_parser_set_database_path(&cloned->super, self->database_path);
   geoip_parser_set_prefix(&cloned->super, self->prefix);
+  geoip_parser_set_fields(&cloned->super, string_list_clone(self->fields));
 
   return &cloned->super.super;
 }
 
+static void
+_free_field_paths(GeoIPParser *self)
+{
+  if (!self->field_paths)
+    return;
+
+  for (guint i = 0; i < self->field_paths->len; i++)
+    {
+      GeoIPField *field = &g_array_index(self->field_paths, GeoIPField, i);
+      g_free(field->path);
+      g_strfreev(field->split_path);
+    }
+  g_array_free(self->field_paths, TRUE);
+  self->field_paths = NULL;
+}
+
+static void
+_compile_field_paths(GeoIPParser *self)
+{
+  _free_field_paths(self);
+  if (!self->fields)
+    return;
+
+  self->field_paths = g_array_new(FALSE, FALSE, sizeof(GeoIPField));
+  for (GList *l = self->fields; l; l = l->next)
+    {
+      GeoIPField field =
+      {
+        .path = g_strdup(l->data),
+        .split_path = g_strsplit(l->data, ".", -1),
+      };
+      g_array_append_val(self->field_paths, field);
+    }
+}
+
 static void
 maxminddb_parser_free(LogPipe *s)
 {
@@ -136,11 +209,9 @@ maxminddb_parser_free(LogPipe *s)
 
   g_free(self->database_path);
   g_free(self->prefix);
-  if (self->database)
-    {
-      MMDB_close(self->database);
-      g_free(self->database);
-    }
+  string_list_free(self->fields);
+  _free_field_paths(self);
+  geoip_database_release(self->database);
 
   log_parser_free_method(s);
 }
@@ -171,18 +242,27 @@ maxminddb_parser_init(LogPipe *s)
   if (!self->database_path)
     return FALSE;
 
-  self->database = g_new0(MMDB_s, 1);
+  self->database = geoip_database_acquire(self->database_path);
   if (!self->database)
     return FALSE;
 
-  if (!mmdb_open_database(self->database_path, self->database))
-    return FALSE;
-
   remove_trailing_dot(self->prefix);
+  _compile_field_paths(self);
 
   return log_parser_init_method(s);
 }
 
+static gboolean
+maxminddb_parser_deinit(LogPipe *s)
+{
+  GeoIPParser *self = (GeoIPParser *) s;
+
+  geoip_database_release(self->database);
+  self->database = NULL;
+
+  return log_parser_deinit_method(s);
+}
+
 LogParser *
 maxminddb_parser_new(GlobalConfig *cfg)
 {
@@ -190,6 +270,7 @@ maxminddb_parser_new(GlobalConfig *cfg)
 
   log_parser_init_instance(&self->super, cfg);
   self->super.super.init = maxminddb_parser_init;
+  self->super.super.deinit = maxminddb_parser_deinit;
   self->super.super.free_fn = maxminddb_parser_free;
   self->super.super.clone = maxminddb_parser_clone;
   self->super.process = maxminddb_parser_process;
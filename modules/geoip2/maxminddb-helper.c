@@ -22,7 +22,6 @@
 
 #include "maxminddb-helper.h"
 #include "scratch-buffers.h"
-#include <logmsg/logmsg.h>
 #include <messages.h>
 
 #define return_and_set_error_if(predicate, status)                     \
@@ -181,15 +180,15 @@ mmdb_skip_tree(MMDB_entry_data_list_s *entry_data_list, gint *status)
 }
 
 static void
-_geoip_log_msg_add_value(LogMessage *msg, GArray *path, GString *value)
+_geoip_emit_value(MMDBDumpFunc emit, gpointer user_data, GArray *path, GString *value)
 {
   gchar *path_string = g_strjoinv(".", (gchar **)path->data);
-  log_msg_set_value_by_name(msg, path_string, value->str, value->len);
+  emit(path_string, value->str, value->len, user_data);
   g_free(path_string);
 }
 
 static void
-_print_preferred_string_for_lang(LogMessage *msg, MMDB_entry_data_s *entry_data, GArray *path,
+_print_preferred_string_for_lang(MMDBDumpFunc emit, gpointer user_data, MMDB_entry_data_s *entry_data, GArray *path,
                                  gchar *preferred_language)
 {
   g_array_append_val(path, preferred_language);
@@ -198,19 +197,19 @@ _print_preferred_string_for_lang(LogMessage *msg, MMDB_entry_data_s *entry_data,
   g_string_printf(value, "%.*s",
                   entry_data->data_size,
                   entry_data->utf8_string);
-  _geoip_log_msg_add_value(msg, path, value);
+  _geoip_emit_value(emit, user_data, path, value);
   g_array_remove_index(path, path->len-1);
 }
 
 static MMDB_entry_data_list_s *
-check_language_and_maybe_insert(GString *key, gchar *preferred_language, LogMessage *msg,
+check_language_and_maybe_insert(GString *key, gchar *preferred_language, MMDBDumpFunc emit, gpointer user_data,
                                 MMDB_entry_data_list_s *entry_data_list, GArray *path, gint *status)
 {
   if (!strcmp(key->str, preferred_language))
     {
       return_and_set_error_if(entry_data_list->entry_data.type != MMDB_DATA_TYPE_UTF8_STRING, status);
 
-      _print_preferred_string_for_lang(msg, &entry_data_list->entry_data, path, preferred_language);
+      _print_preferred_string_for_lang(emit, user_data, &entry_data_list->entry_data, path, preferred_language);
       entry_data_list = entry_data_list->next;
     }
   else
@@ -224,7 +223,7 @@ check_language_and_maybe_insert(GString *key, gchar *preferred_language, LogMess
 }
 
 static MMDB_entry_data_list_s *
-select_language(gchar *preferred_language, LogMessage *msg,
+select_language(gchar *preferred_language, MMDBDumpFunc emit, gpointer user_data,
                 MMDB_entry_data_list_s *entry_data_list, GArray *path, gint *status)
 {
 
@@ -243,7 +242,7 @@ select_language(gchar *preferred_language, LogMessage *msg,
                       entry_data_list->entry_data.utf8_string);
 
       entry_data_list = entry_data_list->next;
-      entry_data_list = check_language_and_maybe_insert(key, preferred_language, msg,
+      entry_data_list = check_language_and_maybe_insert(key, preferred_language, emit, user_data,
                                                         entry_data_list, path, status);
       if (MMDB_SUCCESS != *status)
         return NULL;
@@ -260,7 +259,8 @@ _index_array_in_path(GArray *path, guint32 _index, GString *indexer)
 }
 
 MMDB_entry_data_list_s *
-dump_geodata_into_msg_map(LogMessage *msg, MMDB_entry_data_list_s *entry_data_list, GArray *path, gint *status)
+dump_geodata_into_msg_map(MMDBDumpFunc emit, gpointer user_data, MMDB_entry_data_list_s *entry_data_list,
+                          GArray *path, gint *status)
 {
   guint32 size = entry_data_list->entry_data.data_size;
 
@@ -278,9 +278,9 @@ dump_geodata_into_msg_map(LogMessage *msg, MMDB_entry_data_list_s *entry_data_li
       entry_data_list = entry_data_list->next;
 
       if (!strcmp(key->str, "names"))
-        entry_data_list = select_language("en", msg, entry_data_list, path, status);
+        entry_data_list = select_language("en", emit, user_data, entry_data_list, path, status);
       else
-        entry_data_list = dump_geodata_into_msg(msg, entry_data_list, path, status);
+        entry_data_list = dump_geodata_into_msg(emit, user_data, entry_data_list, path, status);
 
       if (MMDB_SUCCESS != *status)
         return NULL;
@@ -292,7 +292,8 @@ dump_geodata_into_msg_map(LogMessage *msg, MMDB_entry_data_list_s *entry_data_li
 }
 
 MMDB_entry_data_list_s *
-dump_geodata_into_msg_array(LogMessage *msg, MMDB_entry_data_list_s *entry_data_list, GArray *path, gint *status)
+dump_geodata_into_msg_array(MMDBDumpFunc emit, gpointer user_data, MMDB_entry_data_list_s *entry_data_list,
+                            GArray *path, gint *status)
 {
   guint32 size = entry_data_list->entry_data.data_size;
   guint32 _index = 0;
@@ -304,7 +305,7 @@ dump_geodata_into_msg_array(LogMessage *msg, MMDB_entry_data_list_s *entry_data_
        _index++)
     {
       _index_array_in_path(path, _index, indexer);
-      entry_data_list = dump_geodata_into_msg(msg, entry_data_list, path, status);
+      entry_data_list = dump_geodata_into_msg(emit, user_data, entry_data_list, path, status);
 
       if (MMDB_SUCCESS != *status)
         return NULL;
@@ -314,8 +315,8 @@ dump_geodata_into_msg_array(LogMessage *msg, MMDB_entry_data_list_s *entry_data_
   return entry_data_list;
 }
 
-static void G_GNUC_PRINTF(3, 4)
-dump_geodata_into_msg_data(LogMessage *msg, GArray *path, gchar *fmt, ...)
+static void G_GNUC_PRINTF(4, 5)
+dump_geodata_into_msg_data(MMDBDumpFunc emit, gpointer user_data, GArray *path, gchar *fmt, ...)
 {
   GString *value = scratch_buffers_alloc();
   va_list va;
@@ -324,16 +325,17 @@ dump_geodata_into_msg_data(LogMessage *msg, GArray *path, gchar *fmt, ...)
   g_string_vprintf(value, fmt, va);
   va_end(va);
 
-  _geoip_log_msg_add_value(msg, path, value);
+  _geoip_emit_value(emit, user_data, path, value);
 }
 
 MMDB_entry_data_list_s *
-dump_geodata_into_msg(LogMessage *msg, MMDB_entry_data_list_s *entry_data_list, GArray *path, gint *status)
+dump_geodata_into_msg(MMDBDumpFunc emit, gpointer user_data, MMDB_entry_data_list_s *entry_data_list,
+                      GArray *path, gint *status)
 {
   switch (entry_data_list->entry_data.type)
     {
     case MMDB_DATA_TYPE_MAP:
-      entry_data_list = dump_geodata_into_msg_map(msg, entry_data_list, path, status);
+      entry_data_list = dump_geodata_into_msg_map(emit, user_data, entry_data_list, path, status);
       if (MMDB_SUCCESS != *status)
         return NULL;
       break;
@@ -343,47 +345,47 @@ dump_geodata_into_msg(LogMessage *msg, MMDB_entry_data_list_s *entry_data_list,
       g_assert_not_reached();
 
     case MMDB_DATA_TYPE_ARRAY:
-      entry_data_list = dump_geodata_into_msg_array(msg, entry_data_list, path, status);
+      entry_data_list = dump_geodata_into_msg_array(emit, user_data, entry_data_list, path, status);
       if (MMDB_SUCCESS != *status)
         return NULL;
       break;
     case MMDB_DATA_TYPE_UTF8_STRING:
-      dump_geodata_into_msg_data(msg, path, "%.*s", entry_data_list->entry_data.data_size,
+      dump_geodata_into_msg_data(emit, user_data, path, "%.*s", entry_data_list->entry_data.data_size,
                                  entry_data_list->entry_data.utf8_string);
       entry_data_list = entry_data_list->next;
       break;
 
     case MMDB_DATA_TYPE_DOUBLE:
-      dump_geodata_into_msg_data(msg, path, "%f", entry_data_list->entry_data.double_value);
+      dump_geodata_into_msg_data(emit, user_data, path, "%f", entry_data_list->entry_data.double_value);
       entry_data_list = entry_data_list->next;
       break;
 
     case MMDB_DATA_TYPE_FLOAT:
-      dump_geodata_into_msg_data(msg, path, "%f", (double)entry_data_list->entry_data.float_value);
+      dump_geodata_into_msg_data(emit, user_data, path, "%f", (double)entry_data_list->entry_data.float_value);
       entry_data_list = entry_data_list->next;
       break;
 
     case MMDB_DATA_TYPE_UINT16:
-      dump_geodata_into_msg_data(msg, path, "%u", entry_data_list->entry_data.uint16);
+      dump_geodata_into_msg_data(emit, user_data, path, "%u", entry_data_list->entry_data.uint16);
       entry_data_list = entry_data_list->next;
       break;
 
     case MMDB_DATA_TYPE_UINT32:
-      dump_geodata_into_msg_data(msg, path, "%u", entry_data_list->entry_data.uint32);
+      dump_geodata_into_msg_data(emit, user_data, path, "%u", entry_data_list->entry_data.uint32);
       entry_data_list = entry_data_list->next;
       break;
 
     case MMDB_DATA_TYPE_UINT64:
-      dump_geodata_into_msg_data(msg, path, "%" PRIu64, entry_data_list->entry_data.uint64);
+      dump_geodata_into_msg_data(emit, user_data, path, "%" PRIu64, entry_data_list->entry_data.uint64);
       entry_data_list = entry_data_list->next;
       break;
 
     case MMDB_DATA_TYPE_INT32:
-      dump_geodata_into_msg_data(msg, path, "%d", entry_data_list->entry_data.int32);
+      dump_geodata_into_msg_data(emit, user_data, path, "%d", entry_data_list->entry_data.int32);
       entry_data_list = entry_data_list->next;
       break;
     case MMDB_DATA_TYPE_BOOLEAN:
-      dump_geodata_into_msg_data(msg, path, "%s", entry_data_list->entry_data.boolean ? "true" : "false");
+      dump_geodata_into_msg_data(emit, user_data, path, "%s", entry_data_list->entry_data.boolean ? "true" : "false");
       entry_data_list = entry_data_list->next;
       break;
     default:
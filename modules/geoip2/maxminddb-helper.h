@@ -28,7 +28,10 @@
 void append_mmdb_entry_data_to_gstring(GString *target, MMDB_entry_data_s *entry_data);
 gchar *mmdb_default_database(void);
 gboolean mmdb_open_database(const gchar *path, MMDB_s *database);
-MMDB_entry_data_list_s *dump_geodata_into_msg(LogMessage *msg,
+
+typedef void (*MMDBDumpFunc)(const gchar *name, const gchar *value, gssize value_len, gpointer user_data);
+
+MMDB_entry_data_list_s *dump_geodata_into_msg(MMDBDumpFunc emit, gpointer user_data,
                                               MMDB_entry_data_list_s *entry_data_list,
                                               GArray *path, gint *status);
 
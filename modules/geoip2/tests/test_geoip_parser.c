@@ -25,6 +25,7 @@
 #include "geoip-parser.h"
 #include "apphook.h"
 #include "scratch-buffers.h"
+#include "string-list.h"
 
 GlobalConfig *cfg;
 LogParser *geoip_parser;
@@ -134,4 +135,37 @@ Test(geoip2, test_basic)
   log_msg_unref(msg);
 }
 
+Test(geoip2, fields_extracts_only_the_selected_paths)
+{
+  LogMessage *msg;
+
+  geoip_parser_set_fields(geoip_parser,
+                          string_vargs_to_list("country.iso_code", "location.latitude", "location", NULL));
+  msg = parse_geoip_into_log_message("2.125.160.216");
+  assert_log_message_value(msg, log_msg_get_value_handle(".geoip2.country.iso_code"), "GB");
+  assert_log_message_value(msg, log_msg_get_value_handle(".geoip2.location.latitude"), "51.750000");
+  assert_log_message_value_unset_by_name(msg, ".geoip2.location.longitude");
+  assert_log_message_value_unset_by_name(msg, ".geoip2.location");
+  log_msg_unref(msg);
+}
+
+Test(geoip2, repeated_lookups_are_served_from_the_cache)
+{
+  LogMessage *msg;
+
+  for (gint i = 0; i < 3; i++)
+    {
+      msg = parse_geoip_into_log_message("2.125.160.216");
+      assert_log_message_value(msg, log_msg_get_value_handle(".geoip2.country.iso_code"), "GB");
+      assert_log_message_value(msg, log_msg_get_value_handle(".geoip2.location.longitude"), "-1.250000");
+      log_msg_unref(msg);
+    }
+
+  geoip_parser_set_fields(geoip_parser, string_vargs_to_list("country.iso_code", NULL));
+  msg = parse_geoip_into_log_message("2.125.160.216");
+  assert_log_message_value(msg, log_msg_get_value_handle(".geoip2.country.iso_code"), "GB");
+  assert_log_message_value_unset_by_name(msg, ".geoip2.location.longitude");
+  log_msg_unref(msg);
+}
+
 TestSuite(geoip2, .init = setup, .fini = teardown);
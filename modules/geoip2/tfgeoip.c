@@ -28,29 +28,23 @@
 
 #include "syslog-ng-config.h"
 #include "maxminddb-helper.h"
+#include "geoip-cache.h"
 #include "geoip-parser.h"
 
 typedef struct
 {
   TFSimpleFuncState super;
-  MMDB_s  *database;
+  GeoIPDatabase *database;
   gchar *database_path;
+  gchar *field;
   gchar **entry_path;
 } TFMaxMindDBState;
 
 static inline gboolean
 tf_maxminddb_init(TFMaxMindDBState *state)
 {
-  state->database = g_new0(MMDB_s, 1);
-
-  if (!mmdb_open_database(state->database_path, state->database))
-    {
-      g_free(state->database);
-      state->database = NULL;
-      return FALSE;
-    }
-
-  return TRUE;
+  state->database = geoip_database_acquire(state->database_path);
+  return state->database != NULL;
 }
 
 static gboolean
@@ -77,6 +71,7 @@ tf_geoip_maxminddb_prepare(LogTemplateFunction *self, gpointer s, LogTemplate *p
       return FALSE;
     }
   g_option_context_free(ctx);
+  state->field = field ? field : g_strdup("country.iso_code");
 
   if (!state->database_path)
     state->database_path = mmdb_default_database();
@@ -88,10 +83,7 @@ tf_geoip_maxminddb_prepare(LogTemplateFunction *self, gpointer s, LogTemplate *p
       goto error;
     }
 
-  if (field)
-    state->entry_path = g_strsplit(field, ".", -1);
-  else
-    state->entry_path = g_strsplit("country.iso_code", ".", -1);
+  state->entry_path = g_strsplit(state->field, ".", -1);
 
   if (!tf_simple_func_prepare(self, state, parent, argc, argv, error))
     {
@@ -114,7 +106,8 @@ error:
   state->database_path = NULL;
   g_strfreev(state->entry_path);
   state->entry_path = NULL;
-  g_free(field);
+  g_free(state->field);
+  state->field = NULL;
   return FALSE;
 
 }
@@ -126,28 +119,19 @@ tf_geoip_maxminddb_call(LogTemplateFunction *self, gpointer s, const LogTemplate
   TFMaxMindDBState *state = (TFMaxMindDBState *) s;
 
   int _gai_error, mmdb_error;
-  MMDB_lookup_result_s mmdb_result =
-    MMDB_lookup_string(state->database, args->argv[0]->str, &_gai_error, &mmdb_error);
+  GeoIPCachedResult *cached_result =
+    geoip_cache_lookup(state->database, args->argv[0]->str, &_gai_error, &mmdb_error);
 
   *type = LM_VT_STRING;
-  if (!mmdb_result.found_entry)
+  if (cached_result)
     {
-      goto error;
-    }
+      const gchar *value = geoip_cached_result_get_path(cached_result, state->field, state->entry_path);
 
-  MMDB_entry_data_s entry_data;
-  mmdb_error = MMDB_aget_value(&mmdb_result.entry, &entry_data, (const char *const* const)state->entry_path);
-  if (mmdb_error != MMDB_SUCCESS)
-    {
-      goto error;
+      if (value)
+        g_string_append(result, value);
+      return;
     }
 
-  if (entry_data.has_data)
-    append_mmdb_entry_data_to_gstring(result, &entry_data);
-
-  return;
-
-error:
   if (_gai_error != 0)
     msg_error("$(geoip2): getaddrinfo failed",
               evt_tag_str("ip", args->argv[0]->str),
@@ -164,7 +148,9 @@ tf_geoip_maxminddb_free_state(gpointer s)
 {
   TFMaxMindDBState *state = (TFMaxMindDBState *) s;
 
+  geoip_database_release(state->database);
   g_free(state->database_path);
+  g_free(state->field);
   g_strfreev(state->entry_path);
   tf_simple_func_free_state(&state->super);
 }
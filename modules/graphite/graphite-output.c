@@ -25,11 +25,15 @@
 #include "logmsg/logmsg.h"
 #include "value-pairs/value-pairs.h"
 #include "value-pairs/cmdline.h"
+#include "logmsg/type-hinting.h"
+#include "stats/aggregator/stats-rollup.h"
 
 typedef struct _TFGraphiteState
 {
   ValuePairs *vp;
   LogTemplate *timestamp_template;
+  gboolean rollup;
+  StatsRollupType rollup_type;
 } TFGraphiteState;
 
 typedef struct _TFGraphiteArgumentsUserData
@@ -56,6 +60,23 @@ tf_graphite_set_timestamp(const gchar *option_name, const gchar *value,
   return TRUE;
 };
 
+static gboolean
+tf_graphite_set_rollup(const gchar *option_name, const gchar *value,
+                       gpointer data, GError **error)
+{
+  TFGraphiteArgumentsUserData *args = (TFGraphiteArgumentsUserData *) data;
+
+  if (!stats_rollup_type_parse(value, &args->state->rollup_type))
+    {
+      g_set_error(error, G_OPTION_ERROR, G_OPTION_ERROR_BAD_VALUE,
+                  "Unknown rollup type, expected counter, gauge or timing: %s", value);
+      return FALSE;
+    }
+
+  args->state->rollup = TRUE;
+  return TRUE;
+}
+
 static gboolean
 tf_graphite_parse_command_line_arguments(TFGraphiteState *self, gint *argc, gchar ***argv, LogTemplate *parent)
 {
@@ -68,6 +89,7 @@ tf_graphite_parse_command_line_arguments(TFGraphiteState *self, gint *argc, gcha
   GOptionEntry graphite_options[] =
   {
     { "timestamp", 't', 0, G_OPTION_ARG_CALLBACK, tf_graphite_set_timestamp, NULL, NULL },
+    { "rollup", 'r', 0, G_OPTION_ARG_CALLBACK, tf_graphite_set_rollup, NULL, NULL },
     { NULL },
   };
 
@@ -157,6 +179,93 @@ tf_graphite_format(GString *result, ValuePairs *vp, LogMessage *msg, LogTemplate
   return return_value;
 }
 
+/*
+ * With --rollup, the metrics of all the messages the function is invoked
+ * with (e.g. the messages of a grouping-by() context in aggregate()) are
+ * summarized into one line per metric name, stamped with the timestamp of
+ * the last message.  Values that are not numbers are skipped.
+ */
+static gboolean
+tf_graphite_rollup_foreach_func(const gchar *name, LogMessageValueType type, const gchar *value,
+                                gsize value_len, gpointer user_data)
+{
+  StatsRollup *rollup = (StatsRollup *) user_data;
+  gdouble d;
+
+  if (type_cast_to_double(value, &d, NULL))
+    stats_rollup_add_data_point(rollup, name, d);
+
+  return FALSE;
+}
+
+typedef struct _TFGraphiteRollupUserData
+{
+  TFGraphiteState *state;
+  GString *formatted_unixtime;
+  GString *result;
+} TFGraphiteRollupUserData;
+
+static void
+tf_graphite_append_rollup_line(TFGraphiteRollupUserData *data, const gchar *name, const gchar *suffix,
+                               gdouble value)
+{
+  gchar buf[G_ASCII_DTOSTR_BUF_SIZE];
+
+  g_string_append(data->result, name);
+  if (suffix)
+    g_string_append(data->result, suffix);
+  g_string_append_c(data->result, ' ');
+  g_string_append(data->result, g_ascii_formatd(buf, sizeof(buf), "%.15g", value));
+  g_string_append_c(data->result, ' ');
+  g_string_append(data->result, data->formatted_unixtime->str);
+  g_string_append_c(data->result, '\n');
+}
+
+static void
+tf_graphite_append_rollup_entry(StatsRollupEntry *entry, gpointer user_data)
+{
+  TFGraphiteRollupUserData *data = (TFGraphiteRollupUserData *) user_data;
+
+  if (data->state->rollup_type != STATS_ROLLUP_TIMING)
+    {
+      tf_graphite_append_rollup_line(data, entry->key, NULL,
+                                     stats_rollup_entry_get_value(entry, data->state->rollup_type));
+      return;
+    }
+
+  tf_graphite_append_rollup_line(data, entry->key, ".count", entry->count);
+  tf_graphite_append_rollup_line(data, entry->key, ".min", entry->min);
+  tf_graphite_append_rollup_line(data, entry->key, ".max", entry->max);
+  tf_graphite_append_rollup_line(data, entry->key, ".mean", stats_rollup_entry_get_mean(entry));
+}
+
+static gboolean
+tf_graphite_format_rollup(GString *result, TFGraphiteState *state, const LogTemplateInvokeArgs *args)
+{
+  StatsRollup *rollup = stats_rollup_new(NULL);
+  gboolean return_value = TRUE;
+
+  for (gint i = 0; i < args->num_messages; i++)
+    return_value &= value_pairs_foreach(state->vp, tf_graphite_rollup_foreach_func, args->messages[i],
+                                        args->options, rollup);
+
+  TFGraphiteRollupUserData userdata =
+  {
+    .state = state,
+    .formatted_unixtime = g_string_new(""),
+    .result = result,
+  };
+  if (args->num_messages > 0)
+    log_template_format(state->timestamp_template, args->messages[args->num_messages - 1],
+                        &DEFAULT_TEMPLATE_EVAL_OPTIONS, userdata.formatted_unixtime);
+
+  stats_rollup_foreach(rollup, tf_graphite_append_rollup_entry, &userdata);
+
+  g_string_free(userdata.formatted_unixtime, TRUE);
+  stats_rollup_free(rollup);
+  return return_value;
+}
+
 static void
 tf_graphite_call(LogTemplateFunction *self, gpointer s,
                  const LogTemplateInvokeArgs *args, GString *result, LogMessageValueType *type)
@@ -167,6 +276,13 @@ tf_graphite_call(LogTemplateFunction *self, gpointer s,
   gsize orig_size = result->len;
 
   *type = LM_VT_STRING;
+  if (state->rollup)
+    {
+      if (!tf_graphite_format_rollup(result, state, args) && (args->options->opts->on_error & ON_ERROR_DROP_MESSAGE))
+        g_string_set_size(result, orig_size);
+      return;
+    }
+
   for (i = 0; i < args->num_messages; i++)
     r &= tf_graphite_format(result, state->vp, args->messages[i], state->timestamp_template, args->options);
 
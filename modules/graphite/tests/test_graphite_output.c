@@ -92,3 +92,38 @@ Test(graphite_output, test_graphite_output_timestamp)
 {
   assert_template_format("$(graphite-output --timestamp 123 x=y)", "x y 123\n");
 }
+
+static LogMessage *
+_create_metric_message(const gchar *value, time_t t)
+{
+  LogMessage *msg = log_msg_new_empty();
+
+  log_msg_set_value_by_name(msg, "metric.latency", value, -1);
+  _log_msg_set_recvd_time(msg, t);
+  return msg;
+}
+
+Test(graphite_output, test_graphite_output_rollup)
+{
+  LogMessage *msgs[] =
+  {
+    _create_metric_message("3", 100),
+    _create_metric_message("1.5", 110),
+    _create_metric_message("not-a-number", 115),
+    _create_metric_message("4.5", 120),
+  };
+  gint num_msgs = G_N_ELEMENTS(msgs);
+
+  assert_template_format_with_context_msgs("$(graphite-output --rollup counter --key metric.*)",
+                                           "metric.latency 9 120\n", msgs, num_msgs);
+  assert_template_format_with_context_msgs("$(graphite-output --rollup gauge --key metric.*)",
+                                           "metric.latency 4.5 120\n", msgs, num_msgs);
+  assert_template_format_with_context_msgs("$(graphite-output --rollup timing --key metric.*)",
+                                           "metric.latency.count 3 120\n"
+                                           "metric.latency.min 1.5 120\n"
+                                           "metric.latency.max 4.5 120\n"
+                                           "metric.latency.mean 3 120\n", msgs, num_msgs);
+
+  for (gint i = 0; i < num_msgs; i++)
+    log_msg_unref(msgs[i]);
+}
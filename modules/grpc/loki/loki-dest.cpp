@@ -45,7 +45,7 @@ struct _LokiDestDriver
 
 DestinationDriver::DestinationDriver(LokiDestDriver *s)
   : super(s), url("localhost:9095"), timestamp(LM_TS_PROCESSED),
-    keepalive_time(-1), keepalive_timeout(-1), keepalive_max_pings_without_data(-1)
+    keepalive_time(-1), keepalive_timeout(-1), keepalive_max_pings_without_data(-1), compression(false)
 {
   log_template_options_defaults(&this->template_options);
   credentials_builder_wrapper.self = &credentials_builder;
@@ -224,6 +224,13 @@ loki_dd_set_keepalive_max_pings(LogDriver *d, gint p)
   self->cpp->set_keepalive_max_pings(p);
 }
 
+void
+loki_dd_set_compression(LogDriver *d, gboolean enable)
+{
+  LokiDestDriver *self = (LokiDestDriver *) d;
+  self->cpp->set_compression(enable);
+}
+
 LogTemplateOptions *
 loki_dd_get_template_options(LogDriver *d)
 {
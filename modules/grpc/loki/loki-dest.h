@@ -45,6 +45,7 @@ GrpcClientCredentialsBuilderW *loki_dd_get_credentials_builder(LogDriver *s);
 void loki_dd_set_keepalive_time(LogDriver *d, gint t);
 void loki_dd_set_keepalive_timeout(LogDriver *d, gint t);
 void loki_dd_set_keepalive_max_pings(LogDriver *d, gint p);
+void loki_dd_set_compression(LogDriver *d, gboolean enable);
 
 LogTemplateOptions *loki_dd_get_template_options(LogDriver *d);
 
@@ -118,6 +118,11 @@ public:
     this->keepalive_max_pings_without_data = p;
   }
 
+  void set_compression(bool enable)
+  {
+    this->compression = enable;
+  }
+
   const std::string &get_url()
   {
     return this->url;
@@ -142,6 +147,8 @@ private:
   int keepalive_time;
   int keepalive_timeout;
   int keepalive_max_pings_without_data;
+
+  bool compression;
 };
 
 
@@ -41,6 +41,7 @@ static CfgLexerKeyword loki_keywords[] =
   { "time", KW_TIME },
   { "timeout", KW_TIMEOUT },
   { "max_pings_without_data", KW_MAX_PINGS_WITHOUT_DATA },
+  { "compression", KW_COMPRESSION },
   { "auth", KW_AUTH },
   { "insecure", KW_INSECURE },
   { "tls", KW_TLS },
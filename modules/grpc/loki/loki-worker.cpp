@@ -34,8 +34,8 @@
 #include "push.grpc.pb.h"
 
 #include <string>
-#include <sstream>
 #include <chrono>
+#include <algorithm>
 #include <sys/time.h>
 
 #include <grpc/grpc.h>
@@ -45,6 +45,7 @@
 
 using syslogng::grpc::loki::DestinationWorker;
 using syslogng::grpc::loki::DestinationDriver;
+using syslogng::grpc::loki::StreamBatch;
 using google::protobuf::FieldDescriptor;
 
 struct _LokiDestWorker
@@ -53,6 +54,51 @@ struct _LokiDestWorker
   DestinationWorker *cpp;
 };
 
+/*
+ * Messages sharing the same label set are sent in the same stream, so
+ * Loki does not have to regroup them and the per-stream rate limits
+ * apply to real streams instead of single entries.
+ */
+logproto::StreamAdapter *
+StreamBatch::lookup_stream(const std::string &labels)
+{
+  auto it = this->stream_indexes.find(labels);
+  if (it != this->stream_indexes.end())
+    return this->request.mutable_streams(it->second);
+
+  logproto::StreamAdapter *stream = this->request.add_streams();
+  stream->set_labels(labels);
+  this->stream_indexes.emplace(labels, this->request.streams_size() - 1);
+
+  return stream;
+}
+
+static bool
+_entry_timestamp_less(const logproto::EntryAdapter *a, const logproto::EntryAdapter *b)
+{
+  return a->timestamp() < b->timestamp();
+}
+
+/* Loki expects the entries of a stream in chronological order */
+void
+StreamBatch::sort_entries()
+{
+  for (logproto::StreamAdapter &stream : *this->request.mutable_streams())
+    {
+      auto *entries = stream.mutable_entries();
+
+      if (!std::is_sorted(entries->pointer_begin(), entries->pointer_end(), _entry_timestamp_less))
+        std::stable_sort(entries->pointer_begin(), entries->pointer_end(), _entry_timestamp_less);
+    }
+}
+
+void
+StreamBatch::clear()
+{
+  this->request.Clear();
+  this->stream_indexes.clear();
+}
+
 DestinationWorker::DestinationWorker(LokiDestWorker *s) : super(s)
 {
 }
@@ -131,15 +177,14 @@ DestinationWorker::disconnect()
 void
 DestinationWorker::prepare_batch()
 {
-  this->current_batch = logproto::PushRequest{};
-  this->current_batch.add_streams();
+  this->current_batch.clear();
 }
 
+/* renders the label set of msg into formatted_labels, the buffer is kept around to avoid reallocations */
 void
-DestinationWorker::set_labels(LogMessage *msg)
+DestinationWorker::format_labels(LogMessage *msg)
 {
   DestinationDriver *owner = this->get_owner();
-  logproto::StreamAdapter *stream = this->current_batch.mutable_streams(0);
 
   LogTemplateEvalOptions options = {&owner->template_options, LTZ_SEND, this->super->super.seq_num, NULL, LM_VT_STRING};
 
@@ -147,26 +192,33 @@ DestinationWorker::set_labels(LogMessage *msg)
   GString *buf = scratch_buffers_alloc_and_mark(&m);
   GString *sanitized_value = scratch_buffers_alloc();
 
-  std::stringstream formatted_labels;
+  this->formatted_labels.assign("{");
   bool comma_needed = false;
-  formatted_labels << "{";
   for (const auto &label : owner->labels)
     {
       if (comma_needed)
-        formatted_labels << ", ";
+        this->formatted_labels.append(", ");
 
       log_template_format(label.value, msg, &options, buf);
+      g_string_truncate(sanitized_value, 0);
       append_unsafe_utf8_as_escaped_binary(sanitized_value, buf->str, -1, "\"");
-      formatted_labels << label.name << "=\"" << sanitized_value->str << "\"";
+      this->formatted_labels.append(label.name).append("=\"");
+      this->formatted_labels.append(sanitized_value->str, sanitized_value->len).append("\"");
 
       comma_needed = true;
     }
-  formatted_labels << "}";
-  stream->set_labels(formatted_labels.str());
+  this->formatted_labels.append("}");
 
   scratch_buffers_reclaim_marked(m);
 }
 
+logproto::StreamAdapter *
+DestinationWorker::lookup_stream(LogMessage *msg)
+{
+  this->format_labels(msg);
+  return this->current_batch.lookup_stream(this->formatted_labels);
+}
+
 void
 DestinationWorker::set_timestamp(logproto::EntryAdapter *entry, LogMessage *msg)
 {
@@ -187,10 +239,7 @@ LogThreadedResult
 DestinationWorker::insert(LogMessage *msg)
 {
   DestinationDriver *owner = this->get_owner();
-  logproto::StreamAdapter *stream = this->current_batch.mutable_streams(0);
-
-  if (stream->entries_size() == 0)
-    this->set_labels(msg);
+  logproto::StreamAdapter *stream = this->lookup_stream(msg);
 
   logproto::EntryAdapter *entry = stream->add_entries();
 
@@ -219,8 +268,13 @@ DestinationWorker::flush(LogThreadedFlushMode mode)
   LogThreadedResult result;
   logproto::PushResponse response{};
 
+  this->current_batch.sort_entries();
+
   ::grpc::ClientContext ctx;
-  ::grpc::Status status = this->stub->Push(&ctx, this->current_batch, &response);
+  if (this->get_owner()->compression)
+    ctx.set_compression_algorithm(GRPC_COMPRESS_GZIP);
+
+  ::grpc::Status status = this->stub->Push(&ctx, this->current_batch.get_request(), &response);
 
   if (!status.ok())
     {
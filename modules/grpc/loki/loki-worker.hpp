@@ -35,6 +35,7 @@
 
 #include <string>
 #include <memory>
+#include <unordered_map>
 
 #include "push.grpc.pb.h"
 
@@ -42,6 +43,29 @@ namespace syslogng {
 namespace grpc {
 namespace loki {
 
+/*
+ * The push request being built, with messages sharing the same label set
+ * grouped into the same stream.
+ */
+class StreamBatch final
+{
+public:
+  logproto::StreamAdapter *lookup_stream(const std::string &labels);
+  void sort_entries();
+  void clear();
+
+  const logproto::PushRequest &get_request() const
+  {
+    return this->request;
+  }
+
+private:
+  logproto::PushRequest request;
+
+  /* rendered label set -> index of its stream within request */
+  std::unordered_map<std::string, int> stream_indexes;
+};
+
 class DestinationWorker final
 {
 public:
@@ -57,7 +81,8 @@ public:
 
 private:
   void prepare_batch();
-  void set_labels(LogMessage *msg);
+  void format_labels(LogMessage *msg);
+  logproto::StreamAdapter *lookup_stream(LogMessage *msg);
   void set_timestamp(logproto::EntryAdapter *entry, LogMessage *msg);
   DestinationDriver *get_owner();
 
@@ -68,7 +93,8 @@ private:
 
   std::shared_ptr<::grpc::Channel> channel;
   std::unique_ptr<logproto::Pusher::Stub> stub;
-  logproto::PushRequest current_batch;
+  StreamBatch current_batch;
+  std::string formatted_labels;
 };
 
 }
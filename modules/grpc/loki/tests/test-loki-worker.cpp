@@ -0,0 +1,129 @@
+/*
+ * Copyright (c) 2024 One Identity LLC.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#include "loki-worker.hpp"
+
+#include "compat/cpp-start.h"
+#include "apphook.h"
+#include "compat/cpp-end.h"
+
+#include <criterion/criterion.h>
+
+#include <string>
+#include <vector>
+
+using namespace syslogng::grpc::loki;
+
+static void
+_add_entry(StreamBatch &batch, const std::string &labels, const std::string &line, gint64 timestamp)
+{
+  logproto::EntryAdapter *entry = batch.lookup_stream(labels)->add_entries();
+
+  entry->mutable_timestamp()->set_seconds(timestamp);
+  entry->set_line(line);
+}
+
+static void
+_assert_entries(const logproto::StreamAdapter &stream, const std::vector<std::string> &expected_lines)
+{
+  cr_assert_eq(stream.entries_size(), (int) expected_lines.size(), "unexpected number of entries in stream %s",
+               stream.labels().c_str());
+
+  for (size_t i = 0; i < expected_lines.size(); i++)
+    cr_assert_str_eq(stream.entries(i).line().c_str(), expected_lines[i].c_str(),
+                     "unexpected entry in stream %s, index: %zu", stream.labels().c_str(), i);
+}
+
+Test(loki_stream_batch, messages_with_the_same_label_set_share_a_stream)
+{
+  StreamBatch batch;
+
+  _add_entry(batch, "{app=\"a\"}", "a-1", 1);
+  _add_entry(batch, "{app=\"b\"}", "b-1", 2);
+  _add_entry(batch, "{app=\"a\"}", "a-2", 3);
+  _add_entry(batch, "{app=\"a\", host=\"h\"}", "ah-1", 4);
+  _add_entry(batch, "{app=\"b\"}", "b-2", 5);
+
+  const logproto::PushRequest &request = batch.get_request();
+  cr_assert_eq(request.streams_size(), 3);
+
+  /* streams are created in the order of their first message */
+  cr_assert_str_eq(request.streams(0).labels().c_str(), "{app=\"a\"}");
+  cr_assert_str_eq(request.streams(1).labels().c_str(), "{app=\"b\"}");
+  cr_assert_str_eq(request.streams(2).labels().c_str(), "{app=\"a\", host=\"h\"}");
+
+  _assert_entries(request.streams(0), {"a-1", "a-2"});
+  _assert_entries(request.streams(1), {"b-1", "b-2"});
+  _assert_entries(request.streams(2), {"ah-1"});
+}
+
+Test(loki_stream_batch, entries_are_sorted_by_timestamp_within_their_stream)
+{
+  StreamBatch batch;
+
+  _add_entry(batch, "{app=\"a\"}", "a-3", 30);
+  _add_entry(batch, "{app=\"b\"}", "b-1", 5);
+  _add_entry(batch, "{app=\"a\"}", "a-1", 10);
+  _add_entry(batch, "{app=\"a\"}", "a-2-first", 20);
+  _add_entry(batch, "{app=\"b\"}", "b-2", 50);
+  _add_entry(batch, "{app=\"a\"}", "a-2-second", 20);
+
+  batch.sort_entries();
+
+  const logproto::PushRequest &request = batch.get_request();
+  cr_assert_eq(request.streams_size(), 2);
+
+  /* entries with the same timestamp keep the order they were received in */
+  _assert_entries(request.streams(0), {"a-1", "a-2-first", "a-2-second", "a-3"});
+  _assert_entries(request.streams(1), {"b-1", "b-2"});
+}
+
+Test(loki_stream_batch, clear_starts_a_new_batch)
+{
+  StreamBatch batch;
+
+  _add_entry(batch, "{app=\"a\"}", "a-1", 1);
+  _add_entry(batch, "{app=\"b\"}", "b-1", 1);
+  batch.clear();
+  cr_assert_eq(batch.get_request().streams_size(), 0);
+
+  _add_entry(batch, "{app=\"b\"}", "b-2", 2);
+
+  const logproto::PushRequest &request = batch.get_request();
+  cr_assert_eq(request.streams_size(), 1);
+  cr_assert_str_eq(request.streams(0).labels().c_str(), "{app=\"b\"}");
+  _assert_entries(request.streams(0), {"b-2"});
+}
+
+static void
+setup(void)
+{
+  app_startup();
+}
+
+static void
+teardown(void)
+{
+  app_shutdown();
+}
+
+TestSuite(loki_stream_batch, .init = setup, .fini = teardown);
@@ -40,9 +40,43 @@ using namespace opentelemetry::proto::trace::v1;
 
 /* C++ Implementations */
 
+Batch::Batch()
+{
+  create_requests();
+}
+
+void
+Batch::create_requests()
+{
+  logs_service_request = google::protobuf::Arena::CreateMessage<ExportLogsServiceRequest>(&arena);
+  metrics_service_request = google::protobuf::Arena::CreateMessage<ExportMetricsServiceRequest>(&arena);
+  trace_service_request = google::protobuf::Arena::CreateMessage<ExportTraceServiceRequest>(&arena);
+}
+
+void
+Batch::clear()
+{
+  scope_logs.clear();
+  scope_metrics.clear();
+  scope_spans.clear();
+
+  /* frees every message of the batch, but keeps the memory blocks for the next one */
+  arena.Reset();
+  create_requests();
+}
+
+bool
+Batch::empty() const
+{
+  return logs_service_request->resource_logs_size() == 0 &&
+         metrics_service_request->resource_metrics_size() == 0 &&
+         trace_service_request->resource_spans_size() == 0;
+}
+
 DestWorker::DestWorker(OtelDestWorker *s)
   : super(s),
     owner(*((OtelDestDriver *) s->super.owner)->cpp),
+    batch(new Batch()),
     formatter(s->super.owner->super.super.super.cfg)
 {
   channel = ::grpc::CreateChannel(owner.get_url(), owner.credentials_builder.build());
@@ -51,15 +85,45 @@ DestWorker::DestWorker(OtelDestWorker *s)
   trace_service_stub = TraceService::NewStub(channel);
 }
 
+bool
+DestWorker::is_async_flush_enabled() const
+{
+  return super->super.owner->max_inflight_batches > 1;
+}
+
 bool
 DestWorker::init()
 {
+  if (is_async_flush_enabled())
+    {
+      inflight.cq.reset(new ::grpc::CompletionQueue());
+      inflight.completion_thread = std::thread(&DestWorker::process_completions, this);
+    }
+
   return log_threaded_dest_worker_init_method(&super->super);
 }
 
 void
 DestWorker::deinit()
 {
+  if (inflight.cq)
+    {
+      /* the batches still in flight were either waited for or abandoned by now */
+      {
+        std::lock_guard<std::mutex> guard(inflight.lock);
+        for (InflightBatch *inflight_batch : inflight.batches)
+          {
+            inflight_batch->logs_call.context.TryCancel();
+            inflight_batch->metrics_call.context.TryCancel();
+            inflight_batch->trace_call.context.TryCancel();
+          }
+      }
+
+      inflight.cq->Shutdown();
+      inflight.completion_thread.join();
+      inflight.cq.reset();
+    }
+
   log_threaded_dest_worker_deinit_method(&super->super);
 }
 
@@ -94,11 +158,35 @@ DestWorker::get_metadata_for_current_msg(LogMessage *msg)
     }
 }
 
+/* the metadata is only parsed if it cannot be identified without parsing */
+const std::string &
+DestWorker::get_metadata_key_for_current_msg(LogMessage *msg)
+{
+  current_msg_metadata.parsed = false;
+  if (formatter.get_raw_metadata_key(msg, current_msg_metadata.key))
+    return current_msg_metadata.key;
+
+  get_metadata_for_current_msg(msg);
+  current_msg_metadata.parsed = true;
+  ProtobufFormatter::get_metadata_key(current_msg_metadata.resource, current_msg_metadata.resource_schema_url,
+                                      current_msg_metadata.scope, current_msg_metadata.scope_schema_url,
+                                      current_msg_metadata.key);
+  return current_msg_metadata.key;
+}
+
 ScopeLogs *
 DestWorker::lookup_scope_logs(LogMessage *msg)
 {
-  get_metadata_for_current_msg(msg);
+  const std::string &key = get_metadata_key_for_current_msg(msg);
 
+  auto cached = batch->scope_logs.find(key);
+  if (cached != batch->scope_logs.end())
+    return cached->second;
+
+  if (!current_msg_metadata.parsed)
+    get_metadata_for_current_msg(msg);
+
+  ExportLogsServiceRequest &logs_service_request = *batch->logs_service_request;
   ResourceLogs *resource_logs = nullptr;
   for (int i = 0; i < logs_service_request.resource_logs_size(); i++)
     {
@@ -135,14 +223,23 @@ DestWorker::lookup_scope_logs(LogMessage *msg)
       scope_logs->set_schema_url(current_msg_metadata.scope_schema_url);
     }
 
+  batch->scope_logs.emplace(key, scope_logs);
   return scope_logs;
 }
 
 ScopeMetrics *
 DestWorker::lookup_scope_metrics(LogMessage *msg)
 {
-  get_metadata_for_current_msg(msg);
+  const std::string &key = get_metadata_key_for_current_msg(msg);
+
+  auto cached = batch->scope_metrics.find(key);
+  if (cached != batch->scope_metrics.end())
+    return cached->second;
 
+  if (!current_msg_metadata.parsed)
+    get_metadata_for_current_msg(msg);
+
+  ExportMetricsServiceRequest &metrics_service_request = *batch->metrics_service_request;
   ResourceMetrics *resource_metrics = nullptr;
   for (int i = 0; i < metrics_service_request.resource_metrics_size(); i++)
     {
@@ -179,14 +276,23 @@ DestWorker::lookup_scope_metrics(LogMessage *msg)
       scope_metrics->set_schema_url(current_msg_metadata.scope_schema_url);
     }
 
+  batch->scope_metrics.emplace(key, scope_metrics);
   return scope_metrics;
 }
 
 ScopeSpans *
 DestWorker::lookup_scope_spans(LogMessage *msg)
 {
-  get_metadata_for_current_msg(msg);
+  const std::string &key = get_metadata_key_for_current_msg(msg);
+
+  auto cached = batch->scope_spans.find(key);
+  if (cached != batch->scope_spans.end())
+    return cached->second;
 
+  if (!current_msg_metadata.parsed)
+    get_metadata_for_current_msg(msg);
+
+  ExportTraceServiceRequest &trace_service_request = *batch->trace_service_request;
   ResourceSpans *resource_spans = nullptr;
   for (int i = 0; i < trace_service_request.resource_spans_size(); i++)
     {
@@ -223,6 +329,7 @@ DestWorker::lookup_scope_spans(LogMessage *msg)
       scope_spans->set_schema_url(current_msg_metadata.scope_schema_url);
     }
 
+  batch->scope_spans.emplace(key, scope_spans);
   return scope_spans;
 }
 
@@ -333,7 +440,7 @@ DestWorker::flush_log_records()
 {
   ::grpc::ClientContext client_context;
   logs_service_response.Clear();
-  ::grpc::Status status = logs_service_stub->Export(&client_context, logs_service_request,
+  ::grpc::Status status = logs_service_stub->Export(&client_context, *batch->logs_service_request,
                                                     &logs_service_response);
   return _map_grpc_status_to_log_threaded_result(status);
 }
@@ -343,7 +450,7 @@ DestWorker::flush_metrics()
 {
   ::grpc::ClientContext client_context;
   metrics_service_response.Clear();
-  ::grpc::Status status = metrics_service_stub->Export(&client_context, metrics_service_request,
+  ::grpc::Status status = metrics_service_stub->Export(&client_context, *batch->metrics_service_request,
                                                        &metrics_service_response);
   return _map_grpc_status_to_log_threaded_result(status);
 }
@@ -353,7 +460,7 @@ DestWorker::flush_spans()
 {
   ::grpc::ClientContext client_context;
   trace_service_response.Clear();
-  ::grpc::Status status = trace_service_stub->Export(&client_context, trace_service_request,
+  ::grpc::Status status = trace_service_stub->Export(&client_context, *batch->trace_service_request,
                                                      &trace_service_response);
   return _map_grpc_status_to_log_threaded_result(status);
 }
@@ -366,21 +473,21 @@ DestWorker::flush(LogThreadedFlushMode mode)
   if (mode == LTF_FLUSH_EXPEDITE)
     return LTR_RETRY;
 
-  if (logs_service_request.resource_logs_size() > 0)
+  if (batch->logs_service_request->resource_logs_size() > 0)
     {
       result = flush_log_records();
       if (result != LTR_SUCCESS)
         goto exit;
     }
 
-  if (metrics_service_request.resource_metrics_size() > 0)
+  if (batch->metrics_service_request->resource_metrics_size() > 0)
     {
       result = flush_metrics();
       if (result != LTR_SUCCESS)
         goto exit;
     }
 
-  if (trace_service_request.resource_spans_size() > 0)
+  if (batch->trace_service_request->resource_spans_size() > 0)
     {
       result = flush_spans();
       if (result != LTR_SUCCESS)
@@ -388,13 +495,104 @@ DestWorker::flush(LogThreadedFlushMode mode)
     }
 
 exit:
-  logs_service_request.Clear();
-  metrics_service_request.Clear();
-  trace_service_request.Clear();
+  batch->clear();
 
   return result;
 }
 
+template <class Request, class Response, class Stub>
+static void
+_start_export_call(Stub &stub, ::grpc::CompletionQueue *cq, const Request &request,
+                   AsyncExportCall<Response> &call)
+{
+  call.reader = stub.AsyncExport(&call.context, request, cq);
+  call.reader->Finish(&call.response, &call.status, &call);
+}
+
+/* Used instead of flush() with max-inflight-batches().  The Export calls
+ * of the batch are started right away and the batch is completed by the
+ * completion thread, in the meantime the worker formats the next one. */
+LogThreadedResult
+DestWorker::flush_async(LogThreadedFlushMode mode, guint32 batch_id)
+{
+  if (mode == LTF_FLUSH_EXPEDITE)
+    {
+      /* the batch is rewound and formatted again */
+      batch->clear();
+      return LTR_RETRY;
+    }
+
+  if (batch->empty())
+    return LTR_SUCCESS;
+
+  InflightBatch *inflight_batch = new InflightBatch();
+  inflight_batch->batch = std::move(batch);
+  inflight_batch->batch_id = batch_id;
+  inflight_batch->result = LTR_SUCCESS;
+  inflight_batch->logs_call.batch = inflight_batch;
+  inflight_batch->metrics_call.batch = inflight_batch;
+  inflight_batch->trace_call.batch = inflight_batch;
+  batch.reset(new Batch());
+
+  Batch &requests = *inflight_batch->batch;
+  bool send_logs = requests.logs_service_request->resource_logs_size() > 0;
+  bool send_metrics = requests.metrics_service_request->resource_metrics_size() > 0;
+  bool send_spans = requests.trace_service_request->resource_spans_size() > 0;
+
+  /* set before any of the calls is started, as they may finish right away */
+  inflight_batch->pending_calls = send_logs + send_metrics + send_spans;
+
+  {
+    std::lock_guard<std::mutex> guard(inflight.lock);
+    inflight.batches.insert(inflight_batch);
+  }
+
+  if (send_logs)
+    _start_export_call(*logs_service_stub, inflight.cq.get(), *requests.logs_service_request,
+                       inflight_batch->logs_call);
+  if (send_metrics)
+    _start_export_call(*metrics_service_stub, inflight.cq.get(), *requests.metrics_service_request,
+                       inflight_batch->metrics_call);
+  if (send_spans)
+    _start_export_call(*trace_service_stub, inflight.cq.get(), *requests.trace_service_request,
+                       inflight_batch->trace_call);
+
+  return LTR_QUEUED;
+}
+
+/* NOTE: runs in the completion thread */
+void
+DestWorker::complete_export_call(ExportCall *call, bool ok)
+{
+  InflightBatch *inflight_batch = call->batch;
+  LogThreadedResult result = ok ? _map_grpc_status_to_log_threaded_result(call->status) : LTR_NOT_CONNECTED;
+
+  if (inflight_batch->result == LTR_SUCCESS)
+    inflight_batch->result = result;
+
+  if (--inflight_batch->pending_calls > 0)
+    return;
+
+  {
+    std::lock_guard<std::mutex> guard(inflight.lock);
+    inflight.batches.erase(inflight_batch);
+  }
+
+  log_threaded_dest_worker_complete_batch(&super->super, inflight_batch->batch_id, inflight_batch->result);
+  delete inflight_batch;
+}
+
+/* NOTE: runs in the completion thread, until deinit() shuts down the queue */
+void
+DestWorker::process_completions()
+{
+  void *tag;
+  bool ok;
+
+  while (inflight.cq->Next(&tag, &ok))
+    complete_export_call(static_cast<ExportCall *>(tag), ok);
+}
+
 /* C Wrappers */
 
 static gboolean
@@ -433,6 +631,12 @@ _flush(LogThreadedDestWorker *s, LogThreadedFlushMode mode)
   return get_DestWorker(s)->flush(mode);
 }
 
+static LogThreadedResult
+_flush_async(LogThreadedDestWorker *s, LogThreadedFlushMode mode, guint32 batch_id)
+{
+  return get_DestWorker(s)->flush_async(mode, batch_id);
+}
+
 static void
 _free(LogThreadedDestWorker *s)
 {
@@ -451,6 +655,7 @@ otel_dw_init_super(LogThreadedDestWorker *s, LogThreadedDestDriver *o, gint work
   s->disconnect = _disconnect;
   s->insert = _insert;
   s->flush = _flush;
+  s->flush_async = _flush_async;
   s->free_fn = _free;
 }
 
@@ -25,6 +25,14 @@
 
 #include <grpcpp/channel.h>
 #include <grpcpp/client_context.h>
+#include <grpcpp/completion_queue.h>
+#include <google/protobuf/arena.h>
+
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
 
 #include "opentelemetry/proto/collector/logs/v1/logs_service.grpc.pb.h"
 #include "opentelemetry/proto/collector/metrics/v1/metrics_service.grpc.pb.h"
@@ -55,6 +63,62 @@ using opentelemetry::proto::logs::v1::ScopeLogs;
 using opentelemetry::proto::metrics::v1::ScopeMetrics;
 using opentelemetry::proto::trace::v1::ScopeSpans;
 
+/* The requests of a batch.  They are allocated on an arena, which is
+ * reset, instead of freeing the messages one by one, once the batch is sent. */
+class Batch
+{
+public:
+  Batch();
+
+  void clear();
+  bool empty() const;
+
+public:
+  google::protobuf::Arena arena;
+  ExportLogsServiceRequest *logs_service_request;
+  ExportMetricsServiceRequest *metrics_service_request;
+  ExportTraceServiceRequest *trace_service_request;
+
+  /* groups of the requests, by the key of their resource and scope */
+  std::unordered_map<std::string, ScopeLogs *> scope_logs;
+  std::unordered_map<std::string, ScopeMetrics *> scope_metrics;
+  std::unordered_map<std::string, ScopeSpans *> scope_spans;
+
+private:
+  void create_requests();
+};
+
+struct InflightBatch;
+
+/* an Export request being sent by flush_async(), it is the tag of its
+ * completion queue event */
+struct ExportCall
+{
+  InflightBatch *batch;
+  ::grpc::ClientContext context;
+  ::grpc::Status status;
+};
+
+template <class Response>
+struct AsyncExportCall : ExportCall
+{
+  Response response;
+  std::unique_ptr<::grpc::ClientAsyncResponseReader<Response>> reader;
+};
+
+/* a batch sent by flush_async(), completed when all of its Export calls finish */
+struct InflightBatch
+{
+  std::unique_ptr<Batch> batch;
+  guint32 batch_id;
+  int pending_calls;
+  LogThreadedResult result;
+
+  AsyncExportCall<ExportLogsServiceResponse> logs_call;
+  AsyncExportCall<ExportMetricsServiceResponse> metrics_call;
+  AsyncExportCall<ExportTraceServiceResponse> trace_call;
+};
+
 class DestWorker
 {
 public:
@@ -68,10 +132,12 @@ public:
   virtual void disconnect();
   virtual LogThreadedResult insert(LogMessage *msg);
   virtual LogThreadedResult flush(LogThreadedFlushMode mode);
+  virtual LogThreadedResult flush_async(LogThreadedFlushMode mode, guint32 batch_id);
 
 protected:
   void clear_current_msg_metadata();
   void get_metadata_for_current_msg(LogMessage *msg);
+  const std::string &get_metadata_key_for_current_msg(LogMessage *msg);
 
   virtual ScopeLogs *lookup_scope_logs(LogMessage *msg);
   virtual ScopeMetrics *lookup_scope_metrics(LogMessage *msg);
@@ -86,6 +152,10 @@ protected:
   LogThreadedResult flush_metrics();
   LogThreadedResult flush_spans();
 
+  bool is_async_flush_enabled() const;
+  void process_completions();
+  void complete_export_call(ExportCall *call, bool ok);
+
 protected:
   OtelDestWorker *super;
   const DestDriver &owner;
@@ -95,11 +165,9 @@ protected:
   std::unique_ptr<MetricsService::Stub> metrics_service_stub;
   std::unique_ptr<TraceService::Stub> trace_service_stub;
 
-  ExportLogsServiceRequest logs_service_request;
+  std::unique_ptr<Batch> batch;
   ExportLogsServiceResponse logs_service_response;
-  ExportMetricsServiceRequest metrics_service_request;
   ExportMetricsServiceResponse metrics_service_response;
-  ExportTraceServiceRequest trace_service_request;
   ExportTraceServiceResponse trace_service_response;
 
   ProtobufFormatter formatter;
@@ -110,7 +178,18 @@ protected:
     std::string resource_schema_url;
     InstrumentationScope scope;
     std::string scope_schema_url;
+    std::string key;
+    bool parsed;
   } current_msg_metadata;
+
+  /* used by flush_async(), the completion thread processes the finished Export calls */
+  struct
+  {
+    std::unique_ptr<::grpc::CompletionQueue> cq;
+    std::thread completion_thread;
+    std::mutex lock;
+    std::unordered_set<InflightBatch *> batches;
+  } inflight;
 };
 
 }
@@ -385,6 +385,55 @@ ProtobufFormatter::get_metadata(LogMessage *msg, Resource &resource, std::string
          get_scope_and_schema_url(msg, scope, scope_schema_url);
 }
 
+static void
+_append_metadata_key_part(std::string &key, const char *value, size_t len)
+{
+  /* length prefixed, so that the boundaries of the parts are unambiguous */
+  key.append((const char *) &len, sizeof(len));
+  key.append(value, len);
+}
+
+/* identifies the resource and scope, equal metadata gives equal keys */
+void
+ProtobufFormatter::get_metadata_key(const Resource &resource, const std::string &resource_schema_url,
+                                    const InstrumentationScope &scope, const std::string &scope_schema_url,
+                                    std::string &key)
+{
+  std::string serialized;
+
+  key.assign(1, 'p');
+  resource.SerializePartialToString(&serialized);
+  _append_metadata_key_part(key, serialized.data(), serialized.length());
+  _append_metadata_key_part(key, resource_schema_url.data(), resource_schema_url.length());
+  scope.SerializePartialToString(&serialized);
+  _append_metadata_key_part(key, serialized.data(), serialized.length());
+  _append_metadata_key_part(key, scope_schema_url.data(), scope_schema_url.length());
+}
+
+/* same as get_metadata_key(), without parsing the metadata, if it was
+ * received as protobuf.  The two variants produce different keys for the
+ * same metadata. */
+bool
+ProtobufFormatter::get_raw_metadata_key(LogMessage *msg, std::string &key)
+{
+  gssize resource_len, scope_len, len;
+  const gchar *resource = _get_protobuf(msg, ".otel_raw.resource", &resource_len);
+  const gchar *scope = _get_protobuf(msg, ".otel_raw.scope", &scope_len);
+  const gchar *value;
+
+  if (!resource || !scope)
+    return false;
+
+  key.assign(1, 'r');
+  _append_metadata_key_part(key, resource, resource_len);
+  value = _get_string(msg, ".otel_raw.resource_schema_url", &len);
+  _append_metadata_key_part(key, value, len);
+  _append_metadata_key_part(key, scope, scope_len);
+  value = _get_string(msg, ".otel_raw.scope_schema_url", &len);
+  _append_metadata_key_part(key, value, len);
+  return true;
+}
+
 void
 ProtobufFormatter::get_metadata_for_syslog_ng(Resource &resource, std::string &resource_schema_url,
                                               InstrumentationScope &scope, std::string &scope_schema_url)
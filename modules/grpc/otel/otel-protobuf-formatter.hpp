@@ -75,6 +75,10 @@ public:
                                          InstrumentationScope &scope, std::string &scope_schema_url);
   bool get_metadata(LogMessage *msg, Resource &resource, std::string &resource_schema_url,
                     InstrumentationScope &scope, std::string &scope_schema_url);
+  static void get_metadata_key(const Resource &resource, const std::string &resource_schema_url,
+                               const InstrumentationScope &scope, const std::string &scope_schema_url,
+                               std::string &key);
+  bool get_raw_metadata_key(LogMessage *msg, std::string &key);
   bool format(LogMessage *msg, LogRecord &log_record);
   void format_fallback(LogMessage *msg, LogRecord &log_record);
   void format_syslog_ng(LogMessage *msg, LogRecord &log_record);
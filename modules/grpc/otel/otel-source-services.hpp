@@ -33,6 +33,7 @@
 #include "otel-protobuf-parser.hpp"
 
 #include <grpcpp/grpcpp.h>
+#include <google/protobuf/arena.h>
 
 namespace syslogng {
 namespace grpc {
@@ -63,17 +64,23 @@ public:
   void Proceed(bool ok) override;
 
 public:
-  AsyncServiceCall(SourceDriver &driver_, S *service_, ::grpc::ServerCompletionQueue *cq_)
-    : driver(driver_), service(service_), responder(&ctx), cq(cq_), status(PROCESS)
+  AsyncServiceCall(SourceDriver &driver_, LogThreadedSourceWorker *worker_, S *service_,
+                   ::grpc::ServerCompletionQueue *cq_)
+    : driver(driver_), worker(worker_), service(service_), responder(&ctx),
+      request(google::protobuf::Arena::CreateMessage<Req>(&arena)), cq(cq_), status(PROCESS)
   {
-    service->RequestExport(&ctx, &request, &responder, cq, cq, this);
+    service->RequestExport(&ctx, request, &responder, cq, cq, this);
   }
 
 private:
   SourceDriver &driver;
+  LogThreadedSourceWorker *worker;
   S *service;
   ::grpc::ServerAsyncResponseWriter<Res> responder;
-  Req request;
+
+  /* the request is parsed into the arena, which is released in one go with the call */
+  google::protobuf::Arena arena;
+  Req *request;
   Res response;
 
   ::grpc::ServerCompletionQueue *cq;
@@ -96,11 +103,12 @@ syslogng::grpc::otel::TraceServiceCall::Proceed(bool ok)
       return;
     }
 
-  new TraceServiceCall(driver, service, cq);
+  new TraceServiceCall(driver, worker, service, cq);
 
   ::grpc::Status response_status = ::grpc::Status::OK;
+  const std::string peer = ctx.peer();
 
-  for (const ResourceSpans &resource_spans : request.resource_spans())
+  for (const ResourceSpans &resource_spans : request->resource_spans())
     {
       const Resource &resource = resource_spans.resource();
       const std::string &resource_spans_schema_url = resource_spans.schema_url();
@@ -113,10 +121,10 @@ syslogng::grpc::otel::TraceServiceCall::Proceed(bool ok)
           for (const Span &span : scope_spans.spans())
             {
               LogMessage *msg = log_msg_new_empty();
-              ProtobufParser::store_raw_metadata(msg, ctx.peer(), resource, resource_spans_schema_url, scope,
+              ProtobufParser::store_raw_metadata(msg, peer, resource, resource_spans_schema_url, scope,
                                                  scope_spans_schema_url);
               ProtobufParser::store_raw(msg, span);
-              if (!driver.post(msg))
+              if (!driver.post(worker, msg))
                 {
                   response_status = ::grpc::Status(::grpc::StatusCode::UNAVAILABLE, "Server is unavailable");
                   break;
@@ -125,6 +133,8 @@ syslogng::grpc::otel::TraceServiceCall::Proceed(bool ok)
         }
     }
 
+  driver.close_batch();
+
   status = FINISH;
   responder.Finish(response, response_status, this);
 }
@@ -138,11 +148,12 @@ syslogng::grpc::otel::LogsServiceCall::Proceed(bool ok)
       return;
     }
 
-  new LogsServiceCall(driver, service, cq);
+  new LogsServiceCall(driver, worker, service, cq);
 
   ::grpc::Status response_status = ::grpc::Status::OK;
+  const std::string peer = ctx.peer();
 
-  for (const ResourceLogs &resource_logs : request.resource_logs())
+  for (const ResourceLogs &resource_logs : request->resource_logs())
     {
       const Resource &resource = resource_logs.resource();
       const std::string &resource_logs_schema_url = resource_logs.schema_url();
@@ -162,11 +173,11 @@ syslogng::grpc::otel::LogsServiceCall::Proceed(bool ok)
                 }
               else
                 {
-                  ProtobufParser::store_raw_metadata(msg, ctx.peer(), resource, resource_logs_schema_url, scope,
+                  ProtobufParser::store_raw_metadata(msg, peer, resource, resource_logs_schema_url, scope,
                                                      scope_logs_schema_url);
                   ProtobufParser::store_raw(msg, log_record);
                 }
-              if (!driver.post(msg))
+              if (!driver.post(worker, msg))
                 {
                   response_status = ::grpc::Status(::grpc::StatusCode::UNAVAILABLE, "Server is unavailable");
                   break;
@@ -175,6 +186,8 @@ syslogng::grpc::otel::LogsServiceCall::Proceed(bool ok)
         }
     }
 
+  driver.close_batch();
+
   status = FINISH;
   responder.Finish(response, response_status, this);
 }
@@ -188,11 +201,12 @@ syslogng::grpc::otel::MetricsServiceCall::Proceed(bool ok)
       return;
     }
 
-  new MetricsServiceCall(driver, service, cq);
+  new MetricsServiceCall(driver, worker, service, cq);
 
   ::grpc::Status response_status = ::grpc::Status::OK;
+  const std::string peer = ctx.peer();
 
-  for (const ResourceMetrics &resource_metrics : request.resource_metrics())
+  for (const ResourceMetrics &resource_metrics : request->resource_metrics())
     {
       const Resource &resource = resource_metrics.resource();
       const std::string &resource_metrics_schema_url = resource_metrics.schema_url();
@@ -205,10 +219,10 @@ syslogng::grpc::otel::MetricsServiceCall::Proceed(bool ok)
           for (const Metric &metric : scope_metrics.metrics())
             {
               LogMessage *msg = log_msg_new_empty();
-              ProtobufParser::store_raw_metadata(msg, ctx.peer(), resource, resource_metrics_schema_url, scope,
+              ProtobufParser::store_raw_metadata(msg, peer, resource, resource_metrics_schema_url, scope,
                                                  scope_metrics_schema_url);
               ProtobufParser::store_raw(msg, metric);
-              if (!driver.post(msg))
+              if (!driver.post(worker, msg))
                 {
                   response_status = ::grpc::Status(::grpc::StatusCode::UNAVAILABLE, "Server is unavailable");
                   break;
@@ -217,6 +231,8 @@ syslogng::grpc::otel::MetricsServiceCall::Proceed(bool ok)
         }
     }
 
+  driver.close_batch();
+
   status = FINISH;
   responder.Finish(response, response_status, this);
 }
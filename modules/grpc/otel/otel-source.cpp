@@ -45,8 +45,8 @@ syslogng::grpc::otel::SourceDriver::SourceDriver(OtelSourceDriver *s)
   credentials_builder_wrapper.self = &credentials_builder;
 }
 
-void
-syslogng::grpc::otel::SourceDriver::run()
+bool
+syslogng::grpc::otel::SourceDriver::start_server()
 {
   std::string address = std::string("[::]:").append(std::to_string(port));
 
@@ -55,27 +55,50 @@ syslogng::grpc::otel::SourceDriver::run()
   ::grpc::ServerBuilder builder;
   builder.AddListeningPort(address, credentials_builder.build());
 
-  TraceService::AsyncService trace_service;
-  LogsService::AsyncService logs_service;
-  MetricsService::AsyncService metrics_service;
+  trace_service = std::make_unique<TraceService::AsyncService>();
+  logs_service = std::make_unique<LogsService::AsyncService>();
+  metrics_service = std::make_unique<MetricsService::AsyncService>();
 
-  builder.RegisterService(&trace_service);
-  builder.RegisterService(&logs_service);
-  builder.RegisterService(&metrics_service);
+  builder.RegisterService(trace_service.get());
+  builder.RegisterService(logs_service.get());
+  builder.RegisterService(metrics_service.get());
+
+  for (int i = 0; i < super->super.num_workers; i++)
+    cqs.push_back(builder.AddCompletionQueue());
 
-  cq = builder.AddCompletionQueue();
   server = builder.BuildAndStart();
+  server_shut_down = false;
   if (!server)
     {
       msg_error("Failed to start OpenTelemetry server", evt_tag_int("port", port));
-      return;
+      stop_server();
+      return false;
     }
 
-  msg_info("OpenTelemetry server accepting connections", evt_tag_int("port", port));
+  msg_info("OpenTelemetry server accepting connections",
+           evt_tag_int("port", port),
+           evt_tag_int("workers", super->super.num_workers));
+  return true;
+}
 
-  new TraceServiceCall(*this, &trace_service, cq.get());
-  new LogsServiceCall(*this, &logs_service, cq.get());
-  new MetricsServiceCall(*this, &metrics_service, cq.get());
+void
+syslogng::grpc::otel::SourceDriver::stop_server()
+{
+  server.reset();
+  cqs.clear();
+  trace_service.reset();
+  logs_service.reset();
+  metrics_service.reset();
+}
+
+void
+syslogng::grpc::otel::SourceDriver::run(LogThreadedSourceWorker *worker)
+{
+  ::grpc::ServerCompletionQueue *cq = cqs[worker->worker_index].get();
+
+  new TraceServiceCall(*this, worker, trace_service.get(), cq);
+  new LogsServiceCall(*this, worker, logs_service.get(), cq);
+  new MetricsServiceCall(*this, worker, metrics_service.get(), cq);
 
   void *tag;
   bool ok;
@@ -86,10 +109,20 @@ syslogng::grpc::otel::SourceDriver::run()
 }
 
 void
-syslogng::grpc::otel::SourceDriver::request_exit()
+syslogng::grpc::otel::SourceDriver::request_exit(LogThreadedSourceWorker *worker)
 {
-  server->Shutdown();
-  cq->Shutdown();
+  /*
+   * The workers are asked to exit one after the other.  The server must be
+   * shut down before the first completion queue, and the rest of the
+   * workers keep serving their queues until then.
+   */
+  if (!server_shut_down)
+    {
+      server->Shutdown();
+      server_shut_down = true;
+    }
+
+  cqs[worker->worker_index]->Shutdown();
 }
 
 void
@@ -123,25 +156,45 @@ syslogng::grpc::otel::SourceDriver::init()
   if (!credentials_builder.validate())
     return FALSE;
 
-  return log_threaded_source_driver_init_method(&super->super.super.super.super);
+  if (!log_threaded_source_driver_init_method(&super->super.super.super.super))
+    return FALSE;
+
+  if (!start_server())
+    {
+      log_threaded_source_driver_deinit_method(&super->super.super.super.super);
+      return FALSE;
+    }
+
+  return TRUE;
 }
 
 gboolean
 syslogng::grpc::otel::SourceDriver::deinit()
 {
+  stop_server();
   return log_threaded_source_driver_deinit_method(&super->super.super.super.super);
 }
 
 bool
-syslogng::grpc::otel::SourceDriver::post(LogMessage *msg)
+syslogng::grpc::otel::SourceDriver::post(LogThreadedSourceWorker *worker, LogMessage *msg)
 {
-  if (!log_threaded_source_free_to_send(&super->super))
-    return false;
+  if (!log_threaded_source_worker_free_to_send(worker))
+    {
+      log_msg_unref(msg);
+      return false;
+    }
 
-  log_threaded_source_post(&super->super, msg);
+  log_threaded_source_worker_post(worker, msg);
   return true;
 }
 
+/* batches are closed once per Export request instead of once per message */
+void
+syslogng::grpc::otel::SourceDriver::close_batch()
+{
+  log_threaded_source_close_batch(&super->super);
+}
+
 GrpcServerCredentialsBuilderW *
 SourceDriver::get_credentials_builder_wrapper()
 {
@@ -156,6 +209,12 @@ otel_sd_set_port(LogDriver *s, guint64 port)
   get_SourceDriver(s)->port = port;
 }
 
+void
+otel_sd_set_workers(LogDriver *s, gint workers)
+{
+  log_threaded_source_driver_set_num_workers(s, workers);
+}
+
 GrpcServerCredentialsBuilderW *
 otel_sd_get_credentials_builder(LogDriver *s)
 {
@@ -165,15 +224,15 @@ otel_sd_get_credentials_builder(LogDriver *s)
 /* C Wrappers */
 
 static void
-_run(LogThreadedSourceDriver *s)
+_run_worker(LogThreadedSourceDriver *s, LogThreadedSourceWorker *worker)
 {
-  get_SourceDriver(s)->run();
+  get_SourceDriver(s)->run(worker);
 }
 
 static void
-_request_exit(LogThreadedSourceDriver *s)
+_request_worker_exit(LogThreadedSourceDriver *s, LogThreadedSourceWorker *worker)
 {
-  get_SourceDriver(s)->request_exit();
+  get_SourceDriver(s)->request_exit(worker);
 }
 
 static void
@@ -222,8 +281,9 @@ otel_sd_new(GlobalConfig *cfg)
 
   s->super.worker_options.super.stats_source = stats_register_type("opentelemetry");
   s->super.format_stats_key = _format_stats_key;
-  s->super.run = _run;
-  s->super.request_exit = _request_exit;
+  s->super.run_worker = _run_worker;
+  s->super.request_worker_exit = _request_worker_exit;
+  s->super.auto_close_batches = FALSE;
 
   return &s->super.super.super;
 }
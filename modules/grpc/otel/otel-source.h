@@ -32,6 +32,7 @@ typedef struct OtelSourceDriver_ OtelSourceDriver;
 
 LogDriver *otel_sd_new(GlobalConfig *cfg);
 void otel_sd_set_port(LogDriver *s, guint64 port);
+void otel_sd_set_workers(LogDriver *s, gint workers);
 GrpcServerCredentialsBuilderW *otel_sd_get_credentials_builder(LogDriver *s);
 
 #include "compat/cpp-end.h"
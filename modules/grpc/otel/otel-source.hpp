@@ -25,6 +25,9 @@
 
 #include <grpcpp/server.h>
 
+#include <memory>
+#include <vector>
+
 #include "compat/cpp-start.h"
 #include "logthrsource/logthrsourcedrv.h"
 #include "compat/cpp-end.h"
@@ -43,8 +46,8 @@ class SourceDriver
 public:
   SourceDriver(OtelSourceDriver *s);
 
-  void run();
-  void request_exit();
+  void run(LogThreadedSourceWorker *worker);
+  void request_exit(LogThreadedSourceWorker *worker);
   void format_stats_key(StatsClusterKeyBuilder *kb);
   const char *generate_persist_name();
   gboolean init();
@@ -53,7 +56,10 @@ public:
   GrpcServerCredentialsBuilderW *get_credentials_builder_wrapper();
 
 private:
-  bool post(LogMessage *msg);
+  bool start_server();
+  void stop_server();
+  bool post(LogThreadedSourceWorker *worker, LogMessage *msg);
+  void close_batch();
 
   friend TraceServiceCall;
   friend LogsServiceCall;
@@ -66,8 +72,13 @@ public:
 private:
   OtelSourceDriver *super;
   GrpcServerCredentialsBuilderW credentials_builder_wrapper;
+  std::unique_ptr<TraceService::AsyncService> trace_service;
+  std::unique_ptr<LogsService::AsyncService> logs_service;
+  std::unique_ptr<MetricsService::AsyncService> metrics_service;
+  /* one completion queue per worker, each of them served by its own thread */
+  std::vector<std::unique_ptr<::grpc::ServerCompletionQueue>> cqs;
   std::unique_ptr<::grpc::Server> server;
-  std::unique_ptr<::grpc::ServerCompletionQueue> cq;
+  bool server_shut_down = false;
 };
 
 }
@@ -39,6 +39,8 @@ SyslogNgDestWorker::construct(LogThreadedDestDriver *o, gint worker_index)
 ScopeLogs *
 SyslogNgDestWorker::lookup_scope_logs(LogMessage *msg)
 {
+  ExportLogsServiceRequest &logs_service_request = *batch->logs_service_request;
+
   if (logs_service_request.resource_logs_size() > 0)
     return logs_service_request.mutable_resource_logs(0)->mutable_scope_logs(0);
 
@@ -146,6 +146,53 @@ Test(otel_protobuf_formatter, get_metadata)
                                    scope_schema_url_from_raw);
 }
 
+Test(otel_protobuf_formatter, get_metadata_key)
+{
+  ProtobufFormatter formatter(configuration);
+  LogMessage *msg = _create_log_msg_with_dummy_resource_and_scope();
+
+  Resource resource;
+  std::string resource_schema_url;
+  InstrumentationScope scope;
+  std::string scope_schema_url;
+  cr_assert(formatter.get_metadata(msg, resource, resource_schema_url, scope, scope_schema_url));
+
+  std::string key;
+  cr_assert_not(formatter.get_raw_metadata_key(msg, key), "metadata is not available as protobuf");
+  log_msg_unref(msg);
+
+  ProtobufFormatter::get_metadata_key(resource, resource_schema_url, scope, scope_schema_url, key);
+
+  std::string same_key;
+  ProtobufFormatter::get_metadata_key(resource, resource_schema_url, scope, scope_schema_url, same_key);
+  cr_assert(key == same_key);
+
+  std::string other_key;
+  ProtobufFormatter::get_metadata_key(resource, scope_schema_url, scope, resource_schema_url, other_key);
+  cr_assert(key != other_key);
+
+  /* Raw */
+  msg = _create_log_msg_with_dummy_resource_and_scope();
+  ProtobufParser::store_raw_metadata(msg, "", resource, resource_schema_url, scope, scope_schema_url);
+
+  std::string raw_key;
+  cr_assert(formatter.get_raw_metadata_key(msg, raw_key));
+  cr_assert(raw_key != key);
+
+  std::string same_raw_key;
+  cr_assert(formatter.get_raw_metadata_key(msg, same_raw_key));
+  cr_assert(raw_key == same_raw_key);
+  log_msg_unref(msg);
+
+  scope.set_name("other_scope");
+  msg = _create_log_msg_with_dummy_resource_and_scope();
+  ProtobufParser::store_raw_metadata(msg, "", resource, resource_schema_url, scope, scope_schema_url);
+
+  cr_assert(formatter.get_raw_metadata_key(msg, other_key));
+  cr_assert(raw_key != other_key);
+  log_msg_unref(msg);
+}
+
 static void
 _log_record_tc_asserts(const LogRecord &log_record)
 {
@@ -54,6 +54,9 @@ http_dd_check_curl_compression(const gchar *type)
 struct Compressor
 {
   gboolean (*compress) (Compressor *, GString *, const GString *);
+  gboolean (*stream_begin) (Compressor *self, GString *compressed);
+  gboolean (*stream_append) (Compressor *self, const gchar *data, gsize len);
+  gboolean (*stream_finish) (Compressor *self);
   void (*free_fn) (Compressor *self);
 };
 
@@ -63,6 +66,29 @@ compressor_compress(Compressor *self, GString *compressed, const GString *messag
   return self->compress(self, compressed, message);
 }
 
+/* Streaming compression: the data appended between begin() and finish()
+ * is compressed into @compressed as it arrives, so that the uncompressed
+ * data does not need to be kept around.  Once a call fails, the stream is
+ * broken until the next begin(), @compressed is emptied and the remaining
+ * calls fail as well. */
+gboolean
+compressor_stream_begin(Compressor *self, GString *compressed)
+{
+  return self->stream_begin(self, compressed);
+}
+
+gboolean
+compressor_stream_append(Compressor *self, const gchar *data, gsize len)
+{
+  return self->stream_append(self, data, len);
+}
+
+gboolean
+compressor_stream_finish(Compressor *self)
+{
+  return self->stream_finish(self);
+}
+
 void
 compressor_free(Compressor *self)
 {
@@ -243,9 +269,102 @@ _deflate_type_compression(GString *compressed, const GString *message,
   return _deflate_type_compression_method(compressed, &_compress_stream, _wbits);
 }
 
+/* the minimum amount of room made in the output for each deflate() call */
+#define _DEFLATE_STREAM_OUTPUT_CHUNK 16384
+
+/* the z_stream is kept between batches and is reset instead of being
+ * reinitialized for each of them */
+typedef struct _DeflateTypeStream
+{
+  z_stream stream;
+  gint wbits;
+  gboolean initialized;
+  gboolean failed;
+  GString *compressed;
+} DeflateTypeStream;
+
+static gboolean
+_deflate_type_stream_fail(DeflateTypeStream *self, gint z_err)
+{
+  self->failed = TRUE;
+  return _raise_compression_status(self->compressed, _error_code_swap_zlib(z_err));
+}
+
+static gboolean
+_deflate_type_stream_begin(DeflateTypeStream *self, GString *compressed)
+{
+  gint err;
+
+  self->compressed = compressed;
+  self->failed = FALSE;
+  g_string_truncate(compressed, 0);
+
+  if (self->initialized)
+    err = deflateReset(&self->stream);
+  else
+    err = deflateInit2(&self->stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, self->wbits, MAX_MEM_LEVEL,
+                       Z_DEFAULT_STRATEGY);
+
+  if (err != Z_OK)
+    return _deflate_type_stream_fail(self, err);
+
+  self->initialized = TRUE;
+  self->stream.data_type = Z_TEXT;
+  return TRUE;
+}
+
+static gboolean
+_deflate_type_stream_write(DeflateTypeStream *self, const gchar *data, gsize len, gint flush)
+{
+  z_stream *stream = &self->stream;
+  GString *compressed = self->compressed;
+  gint err;
+
+  if (self->failed)
+    return FALSE;
+
+  stream->next_in = (Bytef *) data;
+  stream->avail_in = len;
+
+  do
+    {
+      gsize used = compressed->len;
+      gsize room = MAX(len, _DEFLATE_STREAM_OUTPUT_CHUNK);
+
+      g_string_set_size(compressed, used + room);
+      stream->next_out = (Bytef *) compressed->str + used;
+      stream->avail_out = room;
+
+      err = deflate(stream, flush);
+      g_string_set_size(compressed, used + room - stream->avail_out);
+
+      /* Z_BUF_ERROR only means that no progress was possible */
+      if (err != Z_OK && err != Z_STREAM_END && err != Z_BUF_ERROR)
+        return _deflate_type_stream_fail(self, err);
+    }
+  while (stream->avail_out == 0 || (flush == Z_FINISH && err != Z_STREAM_END));
+
+  return TRUE;
+}
+
+static void
+_deflate_type_stream_init(DeflateTypeStream *self, gint deflate_algorithm_type)
+{
+  self->wbits = _set_deflate_type_wbit(deflate_algorithm_type);
+}
+
+static void
+_deflate_type_stream_deinit(DeflateTypeStream *self)
+{
+  if (self->initialized)
+    deflateEnd(&self->stream);
+  self->initialized = FALSE;
+}
+
 struct GzipCompressor
 {
   Compressor super;
+  DeflateTypeStream stream;
 };
 
 gboolean
@@ -255,18 +374,56 @@ _gzip_compressor_compress(Compressor *self, GString *compressed, const GString *
   return _raise_compression_status(compressed, err);
 }
 
+static gboolean
+_gzip_compressor_stream_begin(Compressor *s, GString *compressed)
+{
+  GzipCompressor *self = (GzipCompressor *) s;
+
+  return _deflate_type_stream_begin(&self->stream, compressed);
+}
+
+static gboolean
+_gzip_compressor_stream_append(Compressor *s, const gchar *data, gsize len)
+{
+  GzipCompressor *self = (GzipCompressor *) s;
+
+  return _deflate_type_stream_write(&self->stream, data, len, Z_NO_FLUSH);
+}
+
+static gboolean
+_gzip_compressor_stream_finish(Compressor *s)
+{
+  GzipCompressor *self = (GzipCompressor *) s;
+
+  return _deflate_type_stream_write(&self->stream, NULL, 0, Z_FINISH);
+}
+
+static void
+_gzip_compressor_free(Compressor *s)
+{
+  GzipCompressor *self = (GzipCompressor *) s;
+
+  _deflate_type_stream_deinit(&self->stream);
+}
+
 Compressor *
 gzip_compressor_new(void)
 {
   GzipCompressor *rval = g_new0(struct GzipCompressor, 1);
   compressor_init_instance(&rval->super);
   rval->super.compress = _gzip_compressor_compress;
+  rval->super.stream_begin = _gzip_compressor_stream_begin;
+  rval->super.stream_append = _gzip_compressor_stream_append;
+  rval->super.stream_finish = _gzip_compressor_stream_finish;
+  rval->super.free_fn = _gzip_compressor_free;
+  _deflate_type_stream_init(&rval->stream, DEFLATE_TYPE_GZIP);
   return &rval->super;
 }
 
 struct DeflateCompressor
 {
   Compressor super;
+  DeflateTypeStream stream;
 };
 
 gboolean
@@ -276,11 +433,48 @@ _deflate_compressor_compress(Compressor *self, GString *compressed, const GStrin
   return _raise_compression_status(compressed, err);
 }
 
+static gboolean
+_deflate_compressor_stream_begin(Compressor *s, GString *compressed)
+{
+  DeflateCompressor *self = (DeflateCompressor *) s;
+
+  return _deflate_type_stream_begin(&self->stream, compressed);
+}
+
+static gboolean
+_deflate_compressor_stream_append(Compressor *s, const gchar *data, gsize len)
+{
+  DeflateCompressor *self = (DeflateCompressor *) s;
+
+  return _deflate_type_stream_write(&self->stream, data, len, Z_NO_FLUSH);
+}
+
+static gboolean
+_deflate_compressor_stream_finish(Compressor *s)
+{
+  DeflateCompressor *self = (DeflateCompressor *) s;
+
+  return _deflate_type_stream_write(&self->stream, NULL, 0, Z_FINISH);
+}
+
+static void
+_deflate_compressor_free(Compressor *s)
+{
+  DeflateCompressor *self = (DeflateCompressor *) s;
+
+  _deflate_type_stream_deinit(&self->stream);
+}
+
 Compressor *
 deflate_compressor_new(void)
 {
   DeflateCompressor *rval = g_new0(struct DeflateCompressor, 1);
   compressor_init_instance(&rval->super);
   rval->super.compress = _deflate_compressor_compress;
+  rval->super.stream_begin = _deflate_compressor_stream_begin;
+  rval->super.stream_append = _deflate_compressor_stream_append;
+  rval->super.stream_finish = _deflate_compressor_stream_finish;
+  rval->super.free_fn = _deflate_compressor_free;
+  _deflate_type_stream_init(&rval->stream, DEFLATE_TYPE_DEFLATE);
   return &rval->super;
 }
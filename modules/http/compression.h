@@ -47,6 +47,10 @@ void compressor_init_instance(Compressor *self);
 
 gboolean compressor_compress(Compressor *self, GString *compressed, const GString *message);
 
+gboolean compressor_stream_begin(Compressor *self, GString *compressed);
+gboolean compressor_stream_append(Compressor *self, const gchar *data, gsize len);
+gboolean compressor_stream_finish(Compressor *self);
+
 void compressor_free(Compressor *self);
 
 void compressor_free_method(Compressor *self);
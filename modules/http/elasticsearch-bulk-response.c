@@ -0,0 +1,322 @@
+/*
+ * Copyright (c) 2024 One Identity LLC.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#include "elasticsearch-bulk-response.h"
+
+#include <string.h>
+
+/* deeper documents are not expected in bulk responses */
+#define MAX_NESTING_DEPTH 64
+
+typedef struct
+{
+  const gchar *pos;
+  const gchar *end;
+} JSONScanner;
+
+static void
+_skip_whitespace(JSONScanner *self)
+{
+  while (self->pos < self->end && g_ascii_isspace(*self->pos))
+    self->pos++;
+}
+
+static gboolean
+_peek(JSONScanner *self, gchar c)
+{
+  _skip_whitespace(self);
+  return self->pos < self->end && *self->pos == c;
+}
+
+static gboolean
+_consume(JSONScanner *self, gchar c)
+{
+  if (!_peek(self, c))
+    return FALSE;
+
+  self->pos++;
+  return TRUE;
+}
+
+/* escapes are validated but not decoded, the keys we look for have none */
+static gboolean
+_scan_string(JSONScanner *self, const gchar **str, gsize *len)
+{
+  if (!_consume(self, '"'))
+    return FALSE;
+
+  const gchar *start = self->pos;
+  while (self->pos < self->end && *self->pos != '"')
+    {
+      if (*self->pos == '\\')
+        self->pos++;
+      self->pos++;
+    }
+
+  if (self->pos >= self->end)
+    return FALSE;
+
+  *str = start;
+  *len = self->pos - start;
+  self->pos++;
+  return TRUE;
+}
+
+static gboolean
+_scan_key(JSONScanner *self, const gchar **key, gsize *key_len)
+{
+  return _scan_string(self, key, key_len) && _consume(self, ':');
+}
+
+static gboolean
+_key_equals(const gchar *key, gsize key_len, const gchar *expected)
+{
+  return key_len == strlen(expected) && memcmp(key, expected, key_len) == 0;
+}
+
+/* numbers, true, false and null */
+static gboolean
+_scan_scalar(JSONScanner *self, const gchar **value, gsize *value_len)
+{
+  _skip_whitespace(self);
+
+  const gchar *start = self->pos;
+  while (self->pos < self->end && (g_ascii_isalnum(*self->pos) || (*self->pos && strchr("+-.", *self->pos))))
+    self->pos++;
+
+  *value = start;
+  *value_len = self->pos - start;
+  return *value_len > 0;
+}
+
+static gboolean _skip_value(JSONScanner *self, gint depth);
+
+static gboolean
+_skip_container(JSONScanner *self, gchar closing, gboolean has_keys, gint depth)
+{
+  if (depth > MAX_NESTING_DEPTH)
+    return FALSE;
+
+  self->pos++;
+  if (_consume(self, closing))
+    return TRUE;
+
+  do
+    {
+      const gchar *key;
+      gsize key_len;
+
+      if (has_keys && !_scan_key(self, &key, &key_len))
+        return FALSE;
+      if (!_skip_value(self, depth + 1))
+        return FALSE;
+    }
+  while (_consume(self, ','));
+
+  return _consume(self, closing);
+}
+
+static gboolean
+_skip_value(JSONScanner *self, gint depth)
+{
+  const gchar *value;
+  gsize value_len;
+
+  _skip_whitespace(self);
+  if (self->pos >= self->end)
+    return FALSE;
+
+  switch (*self->pos)
+    {
+    case '"':
+      return _scan_string(self, &value, &value_len);
+    case '{':
+      return _skip_container(self, '}', TRUE, depth);
+    case '[':
+      return _skip_container(self, ']', FALSE, depth);
+    default:
+      return _scan_scalar(self, &value, &value_len);
+    }
+}
+
+static gboolean
+_scan_integer(JSONScanner *self, gint *number)
+{
+  const gchar *value;
+  gsize value_len;
+
+  if (!_scan_scalar(self, &value, &value_len))
+    return FALSE;
+
+  gchar buffer[16];
+  if (value_len >= sizeof(buffer))
+    return FALSE;
+
+  memcpy(buffer, value, value_len);
+  buffer[value_len] = 0;
+
+  gchar *end;
+  *number = (gint) strtol(buffer, &end, 10);
+  return *end == 0;
+}
+
+static gboolean
+_scan_boolean(JSONScanner *self, gboolean *b)
+{
+  const gchar *value;
+  gsize value_len;
+
+  if (!_scan_scalar(self, &value, &value_len))
+    return FALSE;
+
+  if (_key_equals(value, value_len, "true"))
+    *b = TRUE;
+  else if (_key_equals(value, value_len, "false"))
+    *b = FALSE;
+  else
+    return FALSE;
+  return TRUE;
+}
+
+/* {"_index":"...","status":201,...} */
+static gboolean
+_parse_action_result(JSONScanner *self, gint *status)
+{
+  if (!_consume(self, '{'))
+    return FALSE;
+  if (_consume(self, '}'))
+    return TRUE;
+
+  do
+    {
+      const gchar *key;
+      gsize key_len;
+
+      if (!_scan_key(self, &key, &key_len))
+        return FALSE;
+
+      if (_key_equals(key, key_len, "status"))
+        {
+          if (!_scan_integer(self, status))
+            return FALSE;
+        }
+      else if (!_skip_value(self, 2))
+        return FALSE;
+    }
+  while (_consume(self, ','));
+
+  return _consume(self, '}');
+}
+
+/* {"index":{...}}, the key is the action of the request */
+static gboolean
+_parse_item(JSONScanner *self, GArray *statuses)
+{
+  gint status = -1;
+
+  if (!_consume(self, '{'))
+    return FALSE;
+
+  if (!_peek(self, '}'))
+    {
+      do
+        {
+          const gchar *key;
+          gsize key_len;
+
+          if (!_scan_key(self, &key, &key_len))
+            return FALSE;
+
+          if (_peek(self, '{'))
+            {
+              if (!_parse_action_result(self, &status))
+                return FALSE;
+            }
+          else if (!_skip_value(self, 1))
+            return FALSE;
+        }
+      while (_consume(self, ','));
+    }
+
+  if (!_consume(self, '}') || status < 0)
+    return FALSE;
+
+  g_array_append_val(statuses, status);
+  return TRUE;
+}
+
+static gboolean
+_parse_items(JSONScanner *self, GArray *statuses)
+{
+  if (!_consume(self, '['))
+    return FALSE;
+  if (_consume(self, ']'))
+    return TRUE;
+
+  do
+    {
+      if (!_parse_item(self, statuses))
+        return FALSE;
+    }
+  while (_consume(self, ','));
+
+  return _consume(self, ']');
+}
+
+gboolean
+elasticsearch_parse_bulk_response(const gchar *response, gsize len, gboolean *errors, GArray *statuses)
+{
+  JSONScanner scanner = { .pos = response, .end = response + len };
+  gboolean items_found = FALSE;
+
+  *errors = FALSE;
+  if (!_consume(&scanner, '{'))
+    return FALSE;
+  if (_consume(&scanner, '}'))
+    return FALSE;
+
+  do
+    {
+      const gchar *key;
+      gsize key_len;
+
+      if (!_scan_key(&scanner, &key, &key_len))
+        return FALSE;
+
+      if (_key_equals(key, key_len, "errors"))
+        {
+          if (!_scan_boolean(&scanner, errors))
+            return FALSE;
+        }
+      else if (_key_equals(key, key_len, "items"))
+        {
+          if (!_parse_items(&scanner, statuses))
+            return FALSE;
+          items_found = TRUE;
+        }
+      else if (!_skip_value(&scanner, 1))
+        return FALSE;
+    }
+  while (_consume(&scanner, ','));
+
+  return _consume(&scanner, '}') && items_found;
+}
@@ -0,0 +1,40 @@
+/*
+ * Copyright (c) 2024 One Identity LLC.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#ifndef ELASTICSEARCH_BULK_RESPONSE_H_INCLUDED
+#define ELASTICSEARCH_BULK_RESPONSE_H_INCLUDED 1
+
+#include "syslog-ng.h"
+
+/*
+ * Parses the response of the _bulk API:
+ *
+ *   {"took":3,"errors":true,"items":[{"index":{"_id":"1","status":201}},
+ *                                    {"index":{"_id":"2","status":429,"error":{...}}}]}
+ *
+ * Only the "errors" flag and the status of each item are extracted.  The
+ * statuses are appended to @statuses (an array of gint) in the order of
+ * the items, which is the order of the documents in the request.
+ */
+gboolean elasticsearch_parse_bulk_response(const gchar *response, gsize len, gboolean *errors, GArray *statuses);
+
+#endif
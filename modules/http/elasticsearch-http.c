@@ -0,0 +1,345 @@
+/*
+ * Copyright (c) 2024 One Identity LLC.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#include "elasticsearch-http.h"
+#include "elasticsearch-bulk-response.h"
+#include "http-worker.h"
+#include "scratch-buffers.h"
+#include "utf8utils.h"
+#include "messages.h"
+
+#define ELASTICSEARCH_DEFAULT_TEMPLATE \
+  "$(format-json --scope rfc5424 --exclude DATE --key ISODATE @timestamp=${ISODATE})"
+
+/*
+ * The destination formats the _bulk request itself: an action line
+ * followed by the document for each message.  The response tells the
+ * outcome of each document, so instead of retrying the whole batch, only
+ * the documents rejected with a temporary error are put back to the queue,
+ * the ones rejected permanently are dropped.
+ */
+
+typedef struct
+{
+  HTTPDestinationWorker super;
+
+  /* the messages of the current batch, in the order of the request */
+  GPtrArray *batch_messages;
+  GArray *item_statuses;
+} ElasticsearchDestinationWorker;
+
+static void
+_append_json_string(GString *buffer, const gchar *str, gssize len)
+{
+  g_string_append_c(buffer, '"');
+  append_unsafe_utf8_as_escaped(buffer, str, len, "\"", "\\u%04x", "\\\\x%02x");
+  g_string_append_c(buffer, '"');
+}
+
+static void
+_append_action_field(ElasticsearchDestinationWorker *self, LogMessage *msg, const gchar *name,
+                     LogTemplate *template, gboolean *first)
+{
+  ElasticsearchDestinationDriver *owner = (ElasticsearchDestinationDriver *) self->super.super.owner;
+
+  if (!template)
+    return;
+
+  GString *value = scratch_buffers_alloc();
+  LogTemplateEvalOptions options = {&owner->super.template_options, LTZ_SEND,
+                                    self->super.super.seq_num, NULL, LM_VT_STRING
+                                   };
+  log_template_format(template, msg, &options, value);
+
+  /* just like format-json --omit-empty-values */
+  if (value->len == 0)
+    return;
+
+  GString *body = self->super.request_body;
+  if (!*first)
+    g_string_append_c(body, ',');
+  *first = FALSE;
+
+  _append_json_string(body, name, -1);
+  g_string_append_c(body, ':');
+  _append_json_string(body, value->str, value->len);
+}
+
+static LogThreadedResult
+_insert(LogThreadedDestWorker *s, LogMessage *msg)
+{
+  ElasticsearchDestinationWorker *self = (ElasticsearchDestinationWorker *) s;
+  ElasticsearchDestinationDriver *owner = (ElasticsearchDestinationDriver *) s->owner;
+  GString *body = self->super.request_body;
+  gsize orig_len = body->len;
+  gboolean first = TRUE;
+
+  g_string_append(body, "{\"index\":{");
+  _append_action_field(self, msg, "_index", owner->index, &first);
+  _append_action_field(self, msg, "_type", owner->type, &first);
+  _append_action_field(self, msg, "_id", owner->custom_id, &first);
+  g_string_append(body, "}}\n");
+
+  LogTemplateEvalOptions options = {&owner->super.template_options, LTZ_SEND,
+                                    self->super.super.seq_num, NULL, LM_VT_STRING
+                                   };
+  log_template_append_format(owner->super.body_template, msg, &options, body);
+  g_string_append_c(body, '\n');
+
+  g_ptr_array_add(self->batch_messages, log_msg_ref(msg));
+  http_dw_message_added(&self->super, body->len - orig_len);
+
+  return LTR_QUEUED;
+}
+
+static gboolean
+_is_item_status_retriable(gint status)
+{
+  return status == 429 || status / 100 == 5;
+}
+
+/* The copy on the backlog is acked right after this, the new one keeps the
+ * message (and the window of its source) reserved until it is delivered. */
+static void
+_requeue_message(ElasticsearchDestinationWorker *self, LogMessage *msg)
+{
+  LogPathOptions path_options = LOG_PATH_OPTIONS_INIT;
+
+  /* not subject to the limits of the queue, the message was already admitted */
+  path_options.flow_control_requested = TRUE;
+
+  log_msg_add_ack(msg, &path_options);
+  log_queue_push_tail(self->super.super.queue, log_msg_ref(msg), &path_options);
+}
+
+static LogThreadedResult
+_process_bulk_response(ElasticsearchDestinationWorker *self)
+{
+  ElasticsearchDestinationDriver *owner = (ElasticsearchDestinationDriver *) self->super.super.owner;
+  LogThreadedDestWorker *worker = &self->super.super;
+  GString *response = self->super.response_body;
+  gboolean errors;
+
+  g_array_set_size(self->item_statuses, 0);
+  if (!elasticsearch_parse_bulk_response(response->str, response->len, &errors, self->item_statuses))
+    {
+      msg_error("elasticsearch-http: unable to parse the response of the _bulk request, retrying the batch",
+                evt_tag_int("worker_index", worker->worker_index),
+                evt_tag_str("driver", owner->super.super.super.super.id),
+                log_pipe_location_tag(&owner->super.super.super.super.super));
+      return LTR_ERROR;
+    }
+
+  if (!errors)
+    return LTR_SUCCESS;
+
+  if (self->item_statuses->len != self->batch_messages->len)
+    {
+      msg_error("elasticsearch-http: the number of items in the _bulk response does not match the request, "
+                "retrying the batch",
+                evt_tag_int("items", self->item_statuses->len),
+                evt_tag_int("batch_size", self->batch_messages->len),
+                evt_tag_int("worker_index", worker->worker_index),
+                evt_tag_str("driver", owner->super.super.super.super.id),
+                log_pipe_location_tag(&owner->super.super.super.super.super));
+      return LTR_ERROR;
+    }
+
+  gint succeeded = 0, retried = 0, dropped = 0;
+  for (guint i = 0; i < self->item_statuses->len; i++)
+    {
+      gint status = g_array_index(self->item_statuses, gint, i);
+
+      if (status / 100 == 2)
+        {
+          succeeded++;
+        }
+      else if (_is_item_status_retriable(status))
+        {
+          _requeue_message(self, g_ptr_array_index(self->batch_messages, i));
+          retried++;
+        }
+      else
+        {
+          msg_debug("elasticsearch-http: document rejected, dropping it",
+                    evt_tag_int("status", status),
+                    evt_tag_int("worker_index", worker->worker_index),
+                    evt_tag_str("driver", owner->super.super.super.super.id));
+          dropped++;
+        }
+    }
+
+  msg_notice("elasticsearch-http: some documents of the batch were not indexed",
+             evt_tag_int("indexed", succeeded),
+             evt_tag_int("retried", retried),
+             evt_tag_int("dropped", dropped),
+             evt_tag_int("worker_index", worker->worker_index),
+             evt_tag_str("driver", owner->super.super.super.super.id),
+             log_pipe_location_tag(&owner->super.super.super.super.super));
+
+  log_threaded_dest_worker_ack_messages(worker, succeeded);
+  log_threaded_dest_worker_drop_messages(worker, dropped);
+
+  /* neither written, nor dropped: they have been put back to the queue */
+  log_queue_ack_backlog(worker->queue, retried);
+  worker->batch_size -= retried;
+
+  return LTR_EXPLICIT_ACK_MGMT;
+}
+
+static LogThreadedResult
+_flush(LogThreadedDestWorker *s, LogThreadedFlushMode mode)
+{
+  ElasticsearchDestinationWorker *self = (ElasticsearchDestinationWorker *) s;
+
+  g_string_truncate(self->super.response_body, 0);
+
+  LogThreadedResult result = http_dw_flush(s, mode);
+  if (result == LTR_SUCCESS && self->batch_messages->len > 0)
+    result = _process_bulk_response(self);
+
+  g_ptr_array_set_size(self->batch_messages, 0);
+  return result;
+}
+
+static void
+_worker_free(LogThreadedDestWorker *s)
+{
+  ElasticsearchDestinationWorker *self = (ElasticsearchDestinationWorker *) s;
+
+  g_ptr_array_free(self->batch_messages, TRUE);
+  g_array_free(self->item_statuses, TRUE);
+  g_string_free(self->super.response_body, TRUE);
+
+  http_dw_free(s);
+}
+
+static LogThreadedDestWorker *
+_construct_worker(LogThreadedDestDriver *o, gint worker_index)
+{
+  ElasticsearchDestinationWorker *self = g_new0(ElasticsearchDestinationWorker, 1);
+
+  http_dw_init_instance(&self->super, o, worker_index);
+  self->super.super.insert = _insert;
+  self->super.super.flush = _flush;
+  self->super.super.flush_async = NULL;
+  self->super.super.free_fn = _worker_free;
+
+  self->super.response_body = g_string_sized_new(4096);
+  self->batch_messages = g_ptr_array_new_with_free_func((GDestroyNotify) log_msg_unref);
+  self->item_statuses = g_array_new(FALSE, FALSE, sizeof(gint));
+
+  return &self->super.super;
+}
+
+void
+elasticsearch_dd_set_index(LogDriver *d, LogTemplate *index)
+{
+  ElasticsearchDestinationDriver *self = (ElasticsearchDestinationDriver *) d;
+
+  log_template_unref(self->index);
+  self->index = index;
+}
+
+void
+elasticsearch_dd_set_type(LogDriver *d, LogTemplate *type)
+{
+  ElasticsearchDestinationDriver *self = (ElasticsearchDestinationDriver *) d;
+
+  log_template_unref(self->type);
+  self->type = type;
+}
+
+void
+elasticsearch_dd_set_custom_id(LogDriver *d, LogTemplate *custom_id)
+{
+  ElasticsearchDestinationDriver *self = (ElasticsearchDestinationDriver *) d;
+
+  log_template_unref(self->custom_id);
+  self->custom_id = custom_id;
+}
+
+static gboolean
+_init(LogPipe *s)
+{
+  ElasticsearchDestinationDriver *self = (ElasticsearchDestinationDriver *) s;
+
+  if (!self->index)
+    {
+      msg_error("elasticsearch-http: the index() option is required",
+                log_pipe_location_tag(s));
+      return FALSE;
+    }
+
+  if (self->super.super.max_inflight_batches > 1)
+    {
+      msg_warning("WARNING: elasticsearch-http() does not support max-inflight-batches(), "
+                  "batches are sent one at a time",
+                  log_pipe_location_tag(s));
+    }
+
+  /* per-index batches: the whole batch goes to the same index */
+  if (self->super.super.flush_on_key_change && !self->super.super.worker_partition_key)
+    log_threaded_dest_driver_set_worker_partition_key_ref(&self->super.super.super.super,
+                                                          log_template_ref(self->index));
+
+  return http_dd_init(s);
+}
+
+static void
+_free(LogPipe *s)
+{
+  ElasticsearchDestinationDriver *self = (ElasticsearchDestinationDriver *) s;
+
+  log_template_unref(self->index);
+  log_template_unref(self->type);
+  log_template_unref(self->custom_id);
+
+  http_dd_free(s);
+}
+
+LogDriver *
+elasticsearch_dd_new(GlobalConfig *cfg)
+{
+  ElasticsearchDestinationDriver *self = g_new0(ElasticsearchDestinationDriver, 1);
+
+  http_dd_init_instance(&self->super, cfg);
+  self->super.super.super.super.super.init = _init;
+  self->super.super.super.super.super.free_fn = _free;
+  self->super.super.worker.construct = _construct_worker;
+
+  LogDriver *driver = &self->super.super.super.super;
+  log_threaded_dest_driver_set_num_workers(driver, 4);
+  log_threaded_dest_driver_set_batch_lines(driver, 100);
+  http_dd_set_timeout(driver, 10);
+
+  GList *headers = g_list_append(NULL, "Content-Type: application/x-ndjson");
+  http_dd_set_headers(driver, headers);
+  g_list_free(headers);
+
+  LogTemplate *template = log_template_new(cfg, NULL);
+  log_template_compile(template, ELASTICSEARCH_DEFAULT_TEMPLATE, NULL);
+  http_dd_set_body(driver, template);
+  log_template_unref(template);
+
+  return driver;
+}
@@ -0,0 +1,42 @@
+/*
+ * Copyright (c) 2024 One Identity LLC.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#ifndef ELASTICSEARCH_HTTP_H_INCLUDED
+#define ELASTICSEARCH_HTTP_H_INCLUDED 1
+
+#include "http.h"
+
+typedef struct
+{
+  HTTPDestinationDriver super;
+  LogTemplate *index;
+  LogTemplate *type;
+  LogTemplate *custom_id;
+} ElasticsearchDestinationDriver;
+
+LogDriver *elasticsearch_dd_new(GlobalConfig *cfg);
+
+void elasticsearch_dd_set_index(LogDriver *d, LogTemplate *index);
+void elasticsearch_dd_set_type(LogDriver *d, LogTemplate *type);
+void elasticsearch_dd_set_custom_id(LogDriver *d, LogTemplate *custom_id);
+
+#endif
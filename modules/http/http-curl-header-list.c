@@ -96,3 +96,14 @@ http_curl_header_list_as_slist(List *s)
   return self->list;
 }
 
+
+/* the list becomes empty, the caller takes over the returned slist */
+struct curl_slist *
+http_curl_header_list_steal_slist(List *s)
+{
+  HttpCurlHeaderList *self = (HttpCurlHeaderList *)s;
+  struct curl_slist *list = self->list;
+
+  self->list = NULL;
+  return list;
+}
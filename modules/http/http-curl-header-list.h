@@ -32,5 +32,6 @@
 
 List *http_curl_header_list_new(void);
 struct curl_slist *http_curl_header_list_as_slist(List *list);
+struct curl_slist *http_curl_header_list_steal_slist(List *list);
 
 #endif
@@ -23,8 +23,17 @@
 
 #include "http-loadbalancer.h"
 #include "messages.h"
+#include "stats/stats-registry.h"
 #include <string.h>
 
+/* weight of the latest sample in the moving averages of latency-aware balancing */
+#define HTTP_LB_EWMA_ALPHA 0.2
+/* a target returning only 429/503 costs this many times more than a healthy one */
+#define HTTP_LB_THROTTLE_PENALTY 4.0
+/* clients only move to another target if it is at least this much cheaper,
+ * so that they keep reusing their connection otherwise */
+#define HTTP_LB_SWITCH_THRESHOLD 0.8
+
 /* HTTPLoadBalancerTarget */
 
 void
@@ -172,9 +181,56 @@ _locate_target(HTTPLoadBalancer *self, HTTPLoadBalancerClient *lbc)
   return _recover_a_failed_target(self);
 }
 
+/* self->lock must be held */
+static gdouble
+_get_target_cost(HTTPLoadBalancerTarget *target)
+{
+  /* targets without a measured response time are tried right away */
+  gdouble response_time = MAX(target->avg_response_time, 1.0);
+
+  return (target->outstanding_requests + 1) * response_time * (1.0 + HTTP_LB_THROTTLE_PENALTY * target->throttle_rate);
+}
+
+static HTTPLoadBalancerTarget *
+_locate_cheapest_target(HTTPLoadBalancer *self, HTTPLoadBalancerClient *lbc)
+{
+  HTTPLoadBalancerTarget *cheapest = NULL;
+  gdouble cheapest_cost = 0;
+
+  for (gint i = 0; i < self->num_targets; i++)
+    {
+      HTTPLoadBalancerTarget *target = &self->targets[i];
+
+      if (target->state != HTTP_TARGET_OPERATIONAL)
+        continue;
+
+      gdouble cost = _get_target_cost(target);
+      if (!cheapest || cost < cheapest_cost)
+        {
+          cheapest = target;
+          cheapest_cost = cost;
+        }
+    }
+
+  if (!cheapest)
+    return _recover_a_failed_target(self);
+
+  if (lbc->target && lbc->target != cheapest && lbc->target->state == HTTP_TARGET_OPERATIONAL &&
+      cheapest_cost >= _get_target_cost(lbc->target) * HTTP_LB_SWITCH_THRESHOLD)
+    return lbc->target;
+
+  return cheapest;
+}
+
 static gboolean
 _check_rebalance(HTTPLoadBalancer *self, HTTPLoadBalancerClient *lbc, HTTPLoadBalancerTarget **new_target)
 {
+  if (self->mode == HTTP_LB_LATENCY)
+    {
+      *new_target = _locate_cheapest_target(self, lbc);
+      return TRUE;
+    }
+
   /* Are we misbalanced? */
   if (lbc->target == NULL ||
       lbc->target->state != HTTP_TARGET_OPERATIONAL ||
@@ -259,12 +315,105 @@ http_load_balancer_set_target_successful(HTTPLoadBalancer *self, HTTPLoadBalance
   g_mutex_unlock(&self->lock);
 }
 
+void
+http_load_balancer_request_started(HTTPLoadBalancer *self, HTTPLoadBalancerTarget *target)
+{
+  g_mutex_lock(&self->lock);
+  target->outstanding_requests++;
+  stats_counter_set(target->metrics.outstanding_requests, target->outstanding_requests);
+  g_mutex_unlock(&self->lock);
+}
+
+/* response_time is in microseconds, negative if no response was received */
+void
+http_load_balancer_request_finished(HTTPLoadBalancer *self, HTTPLoadBalancerTarget *target,
+                                    gint64 response_time, gboolean throttled)
+{
+  g_mutex_lock(&self->lock);
+  if (target->outstanding_requests > 0)
+    target->outstanding_requests--;
+  stats_counter_set(target->metrics.outstanding_requests, target->outstanding_requests);
+
+  if (response_time >= 0)
+    {
+      if (target->avg_response_time == 0)
+        target->avg_response_time = response_time;
+      else
+        target->avg_response_time += HTTP_LB_EWMA_ALPHA * (response_time - target->avg_response_time);
+      target->throttle_rate += HTTP_LB_EWMA_ALPHA * ((throttled ? 1.0 : 0.0) - target->throttle_rate);
+
+      stats_counter_set(target->metrics.response_time, (gsize) (target->avg_response_time / 1000));
+    }
+  g_mutex_unlock(&self->lock);
+}
+
+void
+http_load_balancer_register_stats(HTTPLoadBalancer *self, StatsClusterKeyBuilder *kb, gint level)
+{
+  stats_lock();
+  for (gint i = 0; i < self->num_targets; i++)
+    {
+      HTTPLoadBalancerTarget *target = &self->targets[i];
+
+      stats_cluster_key_builder_push(kb);
+      stats_cluster_key_builder_add_label(kb, stats_cluster_label("url", target->url));
+
+      stats_cluster_key_builder_set_name(kb, "output_http_target_response_time_milliseconds");
+      stats_cluster_key_builder_set_unit(kb, SCU_MILLISECONDS);
+      target->metrics.response_time_sc_key = stats_cluster_key_builder_build_single(kb);
+      stats_register_counter(level, target->metrics.response_time_sc_key, SC_TYPE_SINGLE_VALUE,
+                             &target->metrics.response_time);
+
+      stats_cluster_key_builder_set_name(kb, "output_http_target_inflight_requests");
+      stats_cluster_key_builder_set_unit(kb, SCU_NONE);
+      target->metrics.outstanding_requests_sc_key = stats_cluster_key_builder_build_single(kb);
+      stats_register_counter(level, target->metrics.outstanding_requests_sc_key, SC_TYPE_SINGLE_VALUE,
+                             &target->metrics.outstanding_requests);
+
+      stats_cluster_key_builder_pop(kb);
+    }
+  stats_unlock();
+}
+
+void
+http_load_balancer_unregister_stats(HTTPLoadBalancer *self)
+{
+  stats_lock();
+  for (gint i = 0; i < self->num_targets; i++)
+    {
+      HTTPLoadBalancerTarget *target = &self->targets[i];
+
+      if (target->metrics.response_time_sc_key)
+        {
+          stats_unregister_counter(target->metrics.response_time_sc_key, SC_TYPE_SINGLE_VALUE,
+                                   &target->metrics.response_time);
+          stats_cluster_key_free(target->metrics.response_time_sc_key);
+          target->metrics.response_time_sc_key = NULL;
+        }
+
+      if (target->metrics.outstanding_requests_sc_key)
+        {
+          stats_unregister_counter(target->metrics.outstanding_requests_sc_key, SC_TYPE_SINGLE_VALUE,
+                                   &target->metrics.outstanding_requests);
+          stats_cluster_key_free(target->metrics.outstanding_requests_sc_key);
+          target->metrics.outstanding_requests_sc_key = NULL;
+        }
+    }
+  stats_unlock();
+}
+
 void
 http_load_balancer_set_recovery_timeout(HTTPLoadBalancer *self, gint recovery_timeout)
 {
   self->recovery_timeout = recovery_timeout;
 }
 
+void
+http_load_balancer_set_mode(HTTPLoadBalancer *self, HTTPLoadBalancingMode mode)
+{
+  self->mode = mode;
+}
+
 HTTPLoadBalancer *
 http_load_balancer_new(void)
 {
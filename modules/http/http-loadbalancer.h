@@ -25,6 +25,8 @@
 #define HTTP_LOADBALANCER_H_INCLUDED 1
 
 #include "syslog-ng.h"
+#include "stats/stats-cluster-key-builder.h"
+#include "stats/stats-counter.h"
 
 typedef enum
 {
@@ -32,6 +34,15 @@ typedef enum
   HTTP_TARGET_FAILED
 } HTTPLoadBalancerTargetState;
 
+typedef enum
+{
+  /* clients are spread evenly and stay on their target until it fails */
+  HTTP_LB_STATIC,
+  /* each request goes to the target with the least outstanding requests
+   * weighted by its response time and throttling rate */
+  HTTP_LB_LATENCY
+} HTTPLoadBalancingMode;
+
 typedef struct _HTTPLoadBalancerTarget HTTPLoadBalancerTarget;
 typedef struct _HTTPLoadBalancerClient HTTPLoadBalancerClient;
 typedef struct _HTTPLoadBalancer HTTPLoadBalancer;
@@ -53,6 +64,21 @@ struct _HTTPLoadBalancerTarget
   gint number_of_clients;
   gint max_clients;
   time_t last_failure_time;
+
+  /* read-write data used by latency-aware balancing, locking must be in effect */
+  gint outstanding_requests;
+  /* EWMA of the response time in microseconds, 0 if not measured yet */
+  gdouble avg_response_time;
+  /* EWMA of the ratio of 429 and 503 responses */
+  gdouble throttle_rate;
+
+  struct
+  {
+    StatsClusterKey *response_time_sc_key;
+    StatsClusterKey *outstanding_requests_sc_key;
+    StatsCounterItem *response_time;
+    StatsCounterItem *outstanding_requests;
+  } metrics;
 };
 
 struct _HTTPLoadBalancerClient
@@ -72,6 +98,7 @@ struct _HTTPLoadBalancer
   gint num_failed_targets;
   gint recovery_timeout;
   time_t last_recovery_attempt;
+  HTTPLoadBalancingMode mode;
 };
 
 HTTPLoadBalancerTarget *http_load_balancer_choose_target(HTTPLoadBalancer *self, HTTPLoadBalancerClient *lbc);
@@ -80,8 +107,15 @@ void http_load_balancer_drop_all_targets(HTTPLoadBalancer *self);
 void http_load_balancer_track_client(HTTPLoadBalancer *self, HTTPLoadBalancerClient *lbc);
 void http_load_balancer_set_target_failed(HTTPLoadBalancer *self, HTTPLoadBalancerTarget *target);
 void http_load_balancer_set_target_successful(HTTPLoadBalancer *self, HTTPLoadBalancerTarget *target);
+void http_load_balancer_request_started(HTTPLoadBalancer *self, HTTPLoadBalancerTarget *target);
+void http_load_balancer_request_finished(HTTPLoadBalancer *self, HTTPLoadBalancerTarget *target,
+                                         gint64 response_time, gboolean throttled);
+
+void http_load_balancer_register_stats(HTTPLoadBalancer *self, StatsClusterKeyBuilder *kb, gint level);
+void http_load_balancer_unregister_stats(HTTPLoadBalancer *self);
 
 void http_load_balancer_set_recovery_timeout(HTTPLoadBalancer *self, gint recovery_timeout);
+void http_load_balancer_set_mode(HTTPLoadBalancer *self, HTTPLoadBalancingMode mode);
 HTTPLoadBalancer *http_load_balancer_new(void);
 void http_load_balancer_free(HTTPLoadBalancer *self);
 
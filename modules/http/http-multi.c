@@ -0,0 +1,307 @@
+/*
+ * Copyright (c) 2024 One Identity LLC.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#include "http-multi.h"
+#include "messages.h"
+
+#include <glib-unix.h>
+#include <unistd.h>
+#include <errno.h>
+
+/* the sender thread wakes up at least this often */
+#define HTTP_MULTI_MAX_WAIT_MSEC 1000
+
+struct _HTTPMulti
+{
+  CURLM *multi;
+  GThread *thread;
+  gint wakeup_fds[2];
+
+  GMutex lock;
+  /* all requests, either idle, submitted or in flight */
+  GPtrArray *requests;
+  GQueue idle_requests;
+  /* submitted, but not yet added to the multi handle */
+  GQueue submitted_requests;
+  gboolean exit_requested;
+
+  HTTPMultiSetupFunc setup;
+  HTTPMultiCompletionFunc completion;
+  gpointer user_data;
+};
+
+static HTTPMultiRequest *
+_request_new(HTTPMulti *self)
+{
+  CURL *curl = curl_easy_init();
+
+  if (!curl)
+    return NULL;
+
+  HTTPMultiRequest *request = g_new0(HTTPMultiRequest, 1);
+  request->curl = curl;
+  request->body = g_string_new(NULL);
+
+  self->setup(curl, self->user_data);
+  curl_easy_setopt(curl, CURLOPT_PRIVATE, request);
+  return request;
+}
+
+static void
+_request_free(HTTPMultiRequest *request)
+{
+  curl_slist_free_all(request->headers);
+  curl_easy_cleanup(request->curl);
+  g_string_free(request->body, TRUE);
+  g_free(request);
+}
+
+/* NOTE: the pool grows if a request is acquired before the completed ones
+ * are returned to it, its size is limited by the number of batches that
+ * may be in flight */
+HTTPMultiRequest *
+http_multi_acquire_request(HTTPMulti *self)
+{
+  g_mutex_lock(&self->lock);
+  HTTPMultiRequest *request = g_queue_pop_head(&self->idle_requests);
+  g_mutex_unlock(&self->lock);
+
+  if (request)
+    return request;
+
+  request = _request_new(self);
+  if (!request)
+    return NULL;
+
+  g_mutex_lock(&self->lock);
+  g_ptr_array_add(self->requests, request);
+  g_mutex_unlock(&self->lock);
+  return request;
+}
+
+static void
+_release_request(HTTPMulti *self, HTTPMultiRequest *request)
+{
+  curl_slist_free_all(request->headers);
+  request->headers = NULL;
+  request->target = NULL;
+
+  g_mutex_lock(&self->lock);
+  g_queue_push_tail(&self->idle_requests, request);
+  g_mutex_unlock(&self->lock);
+}
+
+static void
+_wakeup(HTTPMulti *self)
+{
+  gchar c = 0;
+
+  /* a full pipe means that a wakeup is already pending */
+  if (write(self->wakeup_fds[1], &c, 1) < 0 && errno != EAGAIN)
+    msg_error("http: error waking up the sender thread",
+              evt_tag_error("error"));
+}
+
+static void
+_drain_wakeup_pipe(HTTPMulti *self)
+{
+  gchar buf[64];
+
+  while (read(self->wakeup_fds[0], buf, sizeof(buf)) > 0)
+    ;
+}
+
+/* can be called from any thread, the request must not be touched once submitted */
+void
+http_multi_submit_request(HTTPMulti *self, HTTPMultiRequest *request)
+{
+  g_mutex_lock(&self->lock);
+  g_queue_push_tail(&self->submitted_requests, request);
+  g_mutex_unlock(&self->lock);
+
+  _wakeup(self);
+}
+
+/* NOTE: runs in the sender thread, returns FALSE if the thread should exit */
+static gboolean
+_add_submitted_requests(HTTPMulti *self)
+{
+  HTTPMultiRequest *request;
+  gboolean exit_requested;
+
+  g_mutex_lock(&self->lock);
+  while ((request = g_queue_pop_head(&self->submitted_requests)))
+    curl_multi_add_handle(self->multi, request->curl);
+  exit_requested = self->exit_requested;
+  g_mutex_unlock(&self->lock);
+
+  return !exit_requested;
+}
+
+/* NOTE: runs in the sender thread */
+static void
+_process_finished_transfers(HTTPMulti *self)
+{
+  CURLMsg *msg;
+  gint msgs_left;
+
+  while ((msg = curl_multi_info_read(self->multi, &msgs_left)))
+    {
+      if (msg->msg != CURLMSG_DONE)
+        continue;
+
+      /* msg is invalidated by curl_multi_remove_handle() */
+      CURL *curl = msg->easy_handle;
+      CURLcode code = msg->data.result;
+      gchar *private_data = NULL;
+
+      curl_easy_getinfo(curl, CURLINFO_PRIVATE, &private_data);
+      curl_multi_remove_handle(self->multi, curl);
+
+      HTTPMultiRequest *request = (HTTPMultiRequest *) private_data;
+      self->completion(request, code, self->user_data);
+      _release_request(self, request);
+    }
+}
+
+static gpointer
+_sender_thread(gpointer user_data)
+{
+  HTTPMulti *self = (HTTPMulti *) user_data;
+  gint running_handles = 0;
+
+  while (_add_submitted_requests(self))
+    {
+      curl_multi_perform(self->multi, &running_handles);
+      _process_finished_transfers(self);
+
+      struct curl_waitfd wakeup_fd =
+      {
+        .fd = self->wakeup_fds[0],
+        .events = CURL_WAIT_POLLIN,
+      };
+
+      curl_multi_wait(self->multi, &wakeup_fd, 1, HTTP_MULTI_MAX_WAIT_MSEC, NULL);
+      if (wakeup_fd.revents)
+        _drain_wakeup_pipe(self);
+    }
+
+  return NULL;
+}
+
+gboolean
+http_multi_start(HTTPMulti *self)
+{
+  GError *error = NULL;
+
+  if (!g_unix_open_pipe(self->wakeup_fds, FD_CLOEXEC, &error))
+    {
+      msg_error("http: error creating wakeup pipe",
+                evt_tag_str("error", error->message));
+      g_clear_error(&error);
+      return FALSE;
+    }
+  g_unix_set_fd_nonblocking(self->wakeup_fds[0], TRUE, NULL);
+  g_unix_set_fd_nonblocking(self->wakeup_fds[1], TRUE, NULL);
+
+  if (!(self->multi = curl_multi_init()))
+    {
+      msg_error("curl: cannot initialize libcurl multi handle");
+      goto error;
+    }
+
+#if SYSLOG_NG_HAVE_DECL_CURL_HTTP_VERSION_2TLS
+  curl_multi_setopt(self->multi, CURLMOPT_PIPELINING, CURLPIPE_MULTIPLEX);
+#endif
+
+  self->exit_requested = FALSE;
+  self->thread = g_thread_new("http-multi", _sender_thread, self);
+  return TRUE;
+
+error:
+  close(self->wakeup_fds[0]);
+  close(self->wakeup_fds[1]);
+  self->wakeup_fds[0] = self->wakeup_fds[1] = -1;
+  return FALSE;
+}
+
+/* transfers still in flight are aborted, their completion is not reported */
+void
+http_multi_stop(HTTPMulti *self)
+{
+  if (!self->thread)
+    return;
+
+  g_mutex_lock(&self->lock);
+  self->exit_requested = TRUE;
+  g_mutex_unlock(&self->lock);
+  _wakeup(self);
+
+  g_thread_join(self->thread);
+  self->thread = NULL;
+
+  g_mutex_lock(&self->lock);
+  g_queue_clear(&self->submitted_requests);
+  g_queue_clear(&self->idle_requests);
+  for (guint i = 0; i < self->requests->len; i++)
+    {
+      HTTPMultiRequest *request = g_ptr_array_index(self->requests, i);
+
+      curl_multi_remove_handle(self->multi, request->curl);
+      g_queue_push_tail(&self->idle_requests, request);
+    }
+  g_mutex_unlock(&self->lock);
+
+  curl_multi_cleanup(self->multi);
+  self->multi = NULL;
+  close(self->wakeup_fds[0]);
+  close(self->wakeup_fds[1]);
+  self->wakeup_fds[0] = self->wakeup_fds[1] = -1;
+}
+
+HTTPMulti *
+http_multi_new(HTTPMultiSetupFunc setup, HTTPMultiCompletionFunc completion, gpointer user_data)
+{
+  HTTPMulti *self = g_new0(HTTPMulti, 1);
+
+  g_mutex_init(&self->lock);
+  self->requests = g_ptr_array_new_with_free_func((GDestroyNotify) _request_free);
+  g_queue_init(&self->idle_requests);
+  g_queue_init(&self->submitted_requests);
+  self->wakeup_fds[0] = self->wakeup_fds[1] = -1;
+
+  self->setup = setup;
+  self->completion = completion;
+  self->user_data = user_data;
+  return self;
+}
+
+void
+http_multi_free(HTTPMulti *self)
+{
+  http_multi_stop(self);
+
+  g_queue_clear(&self->idle_requests);
+  g_ptr_array_free(self->requests, TRUE);
+  g_mutex_clear(&self->lock);
+  g_free(self);
+}
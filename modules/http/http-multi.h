@@ -0,0 +1,73 @@
+/*
+ * Copyright (c) 2024 One Identity LLC.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#ifndef HTTP_MULTI_H_INCLUDED
+#define HTTP_MULTI_H_INCLUDED 1
+
+#include "syslog-ng.h"
+#include "http-loadbalancer.h"
+
+#define CURL_NO_OLDIES 1
+#include <curl/curl.h>
+
+/*
+ * HTTPMulti keeps several HTTP requests in flight using a curl multi
+ * handle, which is driven by a thread of its own.  Requests are taken from
+ * a pool of easy handles, filled by the caller and submitted, their
+ * completion is reported by calling the completion callback from the
+ * sender thread.  The request is returned to the pool after the callback
+ * returns.
+ *
+ * As all the easy handles share the connection cache of the multi handle,
+ * requests to the same server are multiplexed over a single HTTP/2
+ * connection, if the server supports it.
+ */
+
+typedef struct _HTTPMulti HTTPMulti;
+
+typedef struct _HTTPMultiRequest
+{
+  CURL *curl;
+  GString *body;
+  struct curl_slist *headers;
+  HTTPLoadBalancerTarget *target;
+  guint32 batch_id;
+  gint batch_size;
+  /* the size of the request body before compression */
+  gsize body_size;
+} HTTPMultiRequest;
+
+/* sets up the options of a newly created easy handle */
+typedef void (*HTTPMultiSetupFunc)(CURL *curl, gpointer user_data);
+/* runs in the sender thread */
+typedef void (*HTTPMultiCompletionFunc)(HTTPMultiRequest *request, CURLcode code, gpointer user_data);
+
+HTTPMultiRequest *http_multi_acquire_request(HTTPMulti *self);
+void http_multi_submit_request(HTTPMulti *self, HTTPMultiRequest *request);
+
+gboolean http_multi_start(HTTPMulti *self);
+void http_multi_stop(HTTPMulti *self);
+
+HTTPMulti *http_multi_new(HTTPMultiSetupFunc setup, HTTPMultiCompletionFunc completion, gpointer user_data);
+void http_multi_free(HTTPMulti *self);
+
+#endif
@@ -60,7 +60,6 @@ static CfgLexerKeyword http_keywords[] =
   { "timeout",          KW_TIMEOUT },
   { "tls",              KW_TLS },
   { "flush_bytes",      KW_BATCH_BYTES, KWS_OBSOLETE, "The flush-bytes option is deprecated. Use batch-bytes instead." },
-  { "batch_bytes",      KW_BATCH_BYTES },
   { "flush_lines",      KW_BATCH_LINES, KWS_OBSOLETE, "The flush-lines option is deprecated. Use batch-lines instead."},
   { "flush_timeout",    KW_BATCH_TIMEOUT, KWS_OBSOLETE, "The flush-timeout option is deprecated. Use batch-timeout instead."},
   { "flush_on_worker_key_change", KW_FLUSH_ON_WORKER_KEY_CHANGE },
@@ -69,6 +68,10 @@ static CfgLexerKeyword http_keywords[] =
   { "delimiter",        KW_DELIMITER },
   { "accept_encoding",  KW_ACCEPT_ENCODING },
   { "content_compression",    KW_CONTENT_COMPRESSION },
+  { "load_balancing",   KW_LOAD_BALANCING },
+  { "elasticsearch_http", KW_ELASTICSEARCH_HTTP },
+  { "index",            KW_INDEX },
+  { "custom_id",        KW_CUSTOM_ID },
   { NULL }
 };
 
@@ -31,6 +31,11 @@ static Plugin http_plugins[] =
     .name = "http",
     .parser = &http_parser,
   },
+  {
+    .type = LL_CONTEXT_DESTINATION,
+    .name = "elasticsearch-http",
+    .parser = &http_parser,
+  },
 };
 
 gboolean
@@ -93,7 +93,11 @@ _curl_debug_function(CURL *handle, curl_infotype type,
 static size_t
 _curl_write_function(char *ptr, size_t size, size_t nmemb, void *userdata)
 {
-  // Discard response content
+  HTTPDestinationWorker *self = (HTTPDestinationWorker *) userdata;
+
+  // Discard response content, unless the driver is interested in it
+  if (self->response_body)
+    g_string_append_len(self->response_body, ptr, nmemb * size);
   return nmemb * size;
 }
 
@@ -101,78 +105,95 @@ _curl_write_function(char *ptr, size_t size, size_t nmemb, void *userdata)
  * request specific options will be set separately
  */
 static void
-_setup_static_options_in_curl(HTTPDestinationWorker *self)
+_setup_static_options_in_curl(HTTPDestinationWorker *self, CURL *curl)
 {
   HTTPDestinationDriver *owner = (HTTPDestinationDriver *) self->super.owner;
 
-  curl_easy_reset(self->curl);
+  curl_easy_reset(curl);
 
-  curl_easy_setopt(self->curl, CURLOPT_WRITEFUNCTION, _curl_write_function);
+  curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, _curl_write_function);
+  curl_easy_setopt(curl, CURLOPT_WRITEDATA, self);
 
-  curl_easy_setopt(self->curl, CURLOPT_URL, owner->url);
+  curl_easy_setopt(curl, CURLOPT_URL, owner->url);
 
   if (owner->user)
-    curl_easy_setopt(self->curl, CURLOPT_USERNAME, owner->user);
+    curl_easy_setopt(curl, CURLOPT_USERNAME, owner->user);
 
   if (owner->password)
-    curl_easy_setopt(self->curl, CURLOPT_PASSWORD, owner->password);
+    curl_easy_setopt(curl, CURLOPT_PASSWORD, owner->password);
 
   if (owner->user_agent)
-    curl_easy_setopt(self->curl, CURLOPT_USERAGENT, owner->user_agent);
+    curl_easy_setopt(curl, CURLOPT_USERAGENT, owner->user_agent);
 
   if (owner->ca_dir)
-    curl_easy_setopt(self->curl, CURLOPT_CAPATH, owner->ca_dir);
+    curl_easy_setopt(curl, CURLOPT_CAPATH, owner->ca_dir);
 
   if (owner->ca_file)
-    curl_easy_setopt(self->curl, CURLOPT_CAINFO, owner->ca_file);
+    curl_easy_setopt(curl, CURLOPT_CAINFO, owner->ca_file);
 
   if (owner->cert_file)
-    curl_easy_setopt(self->curl, CURLOPT_SSLCERT, owner->cert_file);
+    curl_easy_setopt(curl, CURLOPT_SSLCERT, owner->cert_file);
 
   if (owner->key_file)
-    curl_easy_setopt(self->curl, CURLOPT_SSLKEY, owner->key_file);
+    curl_easy_setopt(curl, CURLOPT_SSLKEY, owner->key_file);
 
   if (owner->ciphers)
-    curl_easy_setopt(self->curl, CURLOPT_SSL_CIPHER_LIST, owner->ciphers);
+    curl_easy_setopt(curl, CURLOPT_SSL_CIPHER_LIST, owner->ciphers);
 
 #if SYSLOG_NG_HAVE_DECL_CURLOPT_TLS13_CIPHERS
   if (owner->tls13_ciphers)
-    curl_easy_setopt(self->curl, CURLOPT_TLS13_CIPHERS, owner->tls13_ciphers);
+    curl_easy_setopt(curl, CURLOPT_TLS13_CIPHERS, owner->tls13_ciphers);
 #endif
 
 #if SYSLOG_NG_HAVE_DECL_CURLOPT_SSL_VERIFYSTATUS
   if (owner->ocsp_stapling_verify)
-    curl_easy_setopt(self->curl, CURLOPT_SSL_VERIFYSTATUS, 1L);
+    curl_easy_setopt(curl, CURLOPT_SSL_VERIFYSTATUS, 1L);
 #endif
 
   if (owner->proxy)
-    curl_easy_setopt(self->curl, CURLOPT_PROXY, owner->proxy);
+    curl_easy_setopt(curl, CURLOPT_PROXY, owner->proxy);
 
-  curl_easy_setopt(self->curl, CURLOPT_SSLVERSION, owner->ssl_version);
-  curl_easy_setopt(self->curl, CURLOPT_SSL_VERIFYHOST, owner->peer_verify ? 2L : 0L);
-  curl_easy_setopt(self->curl, CURLOPT_SSL_VERIFYPEER, owner->peer_verify ? 1L : 0L);
+  curl_easy_setopt(curl, CURLOPT_SSLVERSION, owner->ssl_version);
+  curl_easy_setopt(curl, CURLOPT_SSL_VERIFYHOST, owner->peer_verify ? 2L : 0L);
+  curl_easy_setopt(curl, CURLOPT_SSL_VERIFYPEER, owner->peer_verify ? 1L : 0L);
 
-  curl_easy_setopt(self->curl, CURLOPT_DEBUGFUNCTION, _curl_debug_function);
-  curl_easy_setopt(self->curl, CURLOPT_DEBUGDATA, self);
-  curl_easy_setopt(self->curl, CURLOPT_VERBOSE, 1L);
+  curl_easy_setopt(curl, CURLOPT_DEBUGFUNCTION, _curl_debug_function);
+  curl_easy_setopt(curl, CURLOPT_DEBUGDATA, self);
+  curl_easy_setopt(curl, CURLOPT_VERBOSE, 1L);
 
   if (owner->accept_redirects)
     {
-      curl_easy_setopt(self->curl, CURLOPT_FOLLOWLOCATION, 1);
-      curl_easy_setopt(self->curl, CURLOPT_POSTREDIR, CURL_REDIR_POST_ALL);
+      curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1);
+      curl_easy_setopt(curl, CURLOPT_POSTREDIR, CURL_REDIR_POST_ALL);
 #if SYSLOG_NG_HAVE_DECL_CURLOPT_REDIR_PROTOCOLS_STR
-      curl_easy_setopt(self->curl, CURLOPT_REDIR_PROTOCOLS_STR, "http,https");
+      curl_easy_setopt(curl, CURLOPT_REDIR_PROTOCOLS_STR, "http,https");
 #else
-      curl_easy_setopt(self->curl, CURLOPT_REDIR_PROTOCOLS, CURLPROTO_HTTP | CURLPROTO_HTTPS);
+      curl_easy_setopt(curl, CURLOPT_REDIR_PROTOCOLS, CURLPROTO_HTTP | CURLPROTO_HTTPS);
 #endif
-      curl_easy_setopt(self->curl, CURLOPT_MAXREDIRS, 3);
+      curl_easy_setopt(curl, CURLOPT_MAXREDIRS, 3);
     }
-  curl_easy_setopt(self->curl, CURLOPT_TIMEOUT, owner->timeout);
+  curl_easy_setopt(curl, CURLOPT_TIMEOUT, owner->timeout);
 
   if (owner->method_type == METHOD_TYPE_PUT)
-    curl_easy_setopt(self->curl, CURLOPT_CUSTOMREQUEST, "PUT");
+    curl_easy_setopt(curl, CURLOPT_CUSTOMREQUEST, "PUT");
 
-  curl_easy_setopt(self->curl, CURLOPT_ACCEPT_ENCODING, owner->accept_encoding->str);
+  curl_easy_setopt(curl, CURLOPT_ACCEPT_ENCODING, owner->accept_encoding->str);
+}
+
+static void
+_setup_multi_request_options_in_curl(CURL *curl, gpointer user_data)
+{
+  HTTPDestinationWorker *self = (HTTPDestinationWorker *) user_data;
+
+  _setup_static_options_in_curl(self, curl);
+
+#if SYSLOG_NG_HAVE_DECL_CURL_HTTP_VERSION_2TLS
+  /* use HTTP/2 if the server supports it, and wait for the connection of
+   * the requests already in flight instead of opening a new one, so that
+   * the requests are multiplexed over the same connection */
+  curl_easy_setopt(curl, CURLOPT_HTTP_VERSION, CURL_HTTP_VERSION_2TLS);
+  curl_easy_setopt(curl, CURLOPT_PIPEWAIT, 1L);
+#endif
 }
 
 
@@ -276,6 +297,26 @@ _try_format_request_headers(HTTPDestinationWorker *self, GError **error)
   return (*error == NULL);
 }
 
+/* with streaming compression, request_body only holds the data that was
+ * not fed to the compressor yet */
+static void
+_stream_request_body(HTTPDestinationWorker *self)
+{
+  if (!self->stream_compression || self->request_body->len == 0)
+    return;
+
+  compressor_stream_append(self->compressor, self->request_body->str, self->request_body->len);
+  self->request_body_streamed += self->request_body->len;
+  g_string_truncate(self->request_body, 0);
+}
+
+/* the size of the request body before compression */
+static inline gsize
+_get_request_body_size(HTTPDestinationWorker *self)
+{
+  return self->request_body_streamed + self->request_body->len;
+}
+
 static void
 _add_message_to_batch(HTTPDestinationWorker *self, LogMessage *msg)
 {
@@ -285,6 +326,7 @@ _add_message_to_batch(HTTPDestinationWorker *self, LogMessage *msg)
     {
       g_string_append_len(self->request_body, owner->delimiter->str, owner->delimiter->len);
     }
+  self->request_body_messages++;
   if (owner->body_template)
     {
       LogTemplateEvalOptions options = {&owner->template_options, LTZ_SEND,
@@ -296,6 +338,17 @@ _add_message_to_batch(HTTPDestinationWorker *self, LogMessage *msg)
     {
       g_string_append(self->request_body, log_msg_get_value(msg, LM_V_MESSAGE, NULL));
     }
+  _stream_request_body(self);
+}
+
+void
+http_dw_message_added(HTTPDestinationWorker *self, gsize message_len)
+{
+  self->request_body_messages++;
+  _stream_request_body(self);
+
+  log_threaded_dest_driver_insert_msg_length_stats(self->super.owner, message_len);
+  log_threaded_dest_worker_batch_bytes_add(&self->super, message_len);
 }
 
 static gboolean
@@ -424,38 +477,51 @@ _reinit_request_body(HTTPDestinationWorker *self)
   HTTPDestinationDriver *owner = (HTTPDestinationDriver *) self->super.owner;
 
   g_string_truncate(self->request_body, 0);
+  self->request_body_messages = 0;
+  self->request_body_streamed = 0;
   if (self->request_body_compressed != NULL)
     g_string_truncate(self->request_body_compressed, 0);
 
+  if (self->stream_compression)
+    compressor_stream_begin(self->compressor, self->request_body_compressed);
+
   if (owner->body_prefix->len > 0)
     g_string_append_len(self->request_body, owner->body_prefix->str, owner->body_prefix->len);
-
+  _stream_request_body(self);
 }
 
-static void
+/* returns FALSE if the compressed body could not be completed */
+static gboolean
 _finish_request_body(HTTPDestinationWorker *self)
 {
   HTTPDestinationDriver *owner = (HTTPDestinationDriver *) self->super.owner;
 
   if (owner->body_suffix->len > 0)
     g_string_append_len(self->request_body, owner->body_suffix->str, owner->body_suffix->len);
+
+  if (!self->stream_compression)
+    return TRUE;
+
+  _stream_request_body(self);
+  return compressor_stream_finish(self->compressor);
 }
 
 static void
-_debug_response_info(HTTPDestinationWorker *self, HTTPLoadBalancerTarget *target, glong http_code)
+_debug_response_info(HTTPDestinationWorker *self, CURL *curl, HTTPLoadBalancerTarget *target, glong http_code,
+                     gsize body_size, gint batch_size)
 {
   HTTPDestinationDriver *owner = (HTTPDestinationDriver *) self->super.owner;
 
   gdouble total_time = 0;
   glong redirect_count = 0;
 
-  curl_easy_getinfo(self->curl, CURLINFO_TOTAL_TIME, &total_time);
-  curl_easy_getinfo(self->curl, CURLINFO_REDIRECT_COUNT, &redirect_count);
+  curl_easy_getinfo(curl, CURLINFO_TOTAL_TIME, &total_time);
+  curl_easy_getinfo(curl, CURLINFO_REDIRECT_COUNT, &redirect_count);
   msg_debug("curl: HTTP response received",
             evt_tag_str("url", target->url),
             evt_tag_int("status_code", http_code),
-            evt_tag_int("body_size", self->request_body->len),
-            evt_tag_int("batch_size", self->super.batch_size),
+            evt_tag_int("body_size", body_size),
+            evt_tag_int("batch_size", batch_size),
             evt_tag_int("redirected", redirect_count != 0),
             evt_tag_printf("total_time", "%.3f", total_time),
             evt_tag_int("worker_index", self->super.worker_index),
@@ -516,6 +582,19 @@ _custom_map_http_result(HTTPDestinationWorker *self, const gchar *url, HttpRespo
   return LTR_MAX;
 }
 
+static void
+_report_curl_error(HTTPDestinationWorker *self, HTTPLoadBalancerTarget *target, CURLcode ret)
+{
+  HTTPDestinationDriver *owner = (HTTPDestinationDriver *) self->super.owner;
+
+  msg_error("curl: error sending HTTP request",
+            evt_tag_str("url", target->url),
+            evt_tag_str("error", curl_easy_strerror(ret)),
+            evt_tag_int("worker_index", self->super.worker_index),
+            evt_tag_str("driver", owner->super.super.super.id),
+            log_pipe_location_tag(&owner->super.super.super.super));
+}
+
 static gboolean
 _curl_perform_request(HTTPDestinationWorker *self, HTTPLoadBalancerTarget *target)
 {
@@ -525,7 +604,12 @@ _curl_perform_request(HTTPDestinationWorker *self, HTTPLoadBalancerTarget *targe
             evt_tag_str("url", target->url));
 
   curl_easy_setopt(self->curl, CURLOPT_URL, target->url);
-  if (owner->message_compression != CURL_COMPRESSION_UNCOMPRESSED)
+  if (self->stream_compression)
+    {
+      curl_easy_setopt(self->curl, CURLOPT_POSTFIELDS, self->request_body_compressed->str);
+      curl_easy_setopt(self->curl, CURLOPT_POSTFIELDSIZE, self->request_body_compressed->len);
+    }
+  else if (owner->message_compression != CURL_COMPRESSION_UNCOMPRESSED)
     {
       if (compressor_compress(self->compressor, self->request_body_compressed, self->request_body))
         {
@@ -546,12 +630,7 @@ _curl_perform_request(HTTPDestinationWorker *self, HTTPLoadBalancerTarget *targe
   CURLcode ret = curl_easy_perform(self->curl);
   if (ret != CURLE_OK)
     {
-      msg_error("curl: error sending HTTP request",
-                evt_tag_str("url", target->url),
-                evt_tag_str("error", curl_easy_strerror(ret)),
-                evt_tag_int("worker_index", self->super.worker_index),
-                evt_tag_str("driver", owner->super.super.super.id),
-                log_pipe_location_tag(&owner->super.super.super.super));
+      _report_curl_error(self, target, ret);
       return FALSE;
     }
 
@@ -559,10 +638,10 @@ _curl_perform_request(HTTPDestinationWorker *self, HTTPLoadBalancerTarget *targe
 }
 
 static gboolean
-_curl_get_status_code(HTTPDestinationWorker *self, HTTPLoadBalancerTarget *target, glong *http_code)
+_curl_get_status_code(HTTPDestinationWorker *self, CURL *curl, HTTPLoadBalancerTarget *target, glong *http_code)
 {
   HTTPDestinationDriver *owner = (HTTPDestinationDriver *) self->super.owner;
-  CURLcode ret = curl_easy_getinfo(self->curl, CURLINFO_RESPONSE_CODE, http_code);
+  CURLcode ret = curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, http_code);
 
   if (ret != CURLE_OK)
     {
@@ -602,21 +681,37 @@ _map_http_status_code(HTTPDestinationWorker *self, const gchar *url, glong http_
   return default_map_http_status_to_worker_status(self, url, http_code);
 }
 
-static LogThreadedResult
-_flush_on_target(HTTPDestinationWorker *self, HTTPLoadBalancerTarget *target)
+/* feeds the latency-aware load balancing, http_code is 0 if no response was received */
+static void
+_track_request_finished(HTTPDestinationWorker *self, CURL *curl, HTTPLoadBalancerTarget *target, glong http_code)
 {
   HTTPDestinationDriver *owner = (HTTPDestinationDriver *) self->super.owner;
+  gdouble total_time = 0;
 
-  if (!_curl_perform_request(self, target))
-    return LTR_NOT_CONNECTED;
+  if (http_code == 0 || curl_easy_getinfo(curl, CURLINFO_TOTAL_TIME, &total_time) != CURLE_OK)
+    {
+      http_load_balancer_request_finished(owner->load_balancer, target, -1, FALSE);
+      return;
+    }
 
+  http_load_balancer_request_finished(owner->load_balancer, target, (gint64) (total_time * G_USEC_PER_SEC),
+                                      http_code == 429 || http_code == 503);
+}
+
+static LogThreadedResult
+_map_response(HTTPDestinationWorker *self, CURL *curl, HTTPLoadBalancerTarget *target,
+              gsize body_size, gint batch_size)
+{
+  HTTPDestinationDriver *owner = (HTTPDestinationDriver *) self->super.owner;
   glong http_code = 0;
 
-  if (!_curl_get_status_code(self, target, &http_code))
+  gboolean status_code_available = _curl_get_status_code(self, curl, target, &http_code);
+  _track_request_finished(self, curl, target, http_code);
+  if (!status_code_available)
     return LTR_NOT_CONNECTED;
 
   if (debug_flag)
-    _debug_response_info(self, target, http_code);
+    _debug_response_info(self, curl, target, http_code, body_size, batch_size);
 
   HttpResponseReceivedSignalData signal_data =
   {
@@ -636,6 +731,21 @@ _flush_on_target(HTTPDestinationWorker *self, HTTPLoadBalancerTarget *target)
   return _map_http_status_code(self, target->url, http_code);
 }
 
+static LogThreadedResult
+_flush_on_target(HTTPDestinationWorker *self, HTTPLoadBalancerTarget *target)
+{
+  HTTPDestinationDriver *owner = (HTTPDestinationDriver *) self->super.owner;
+
+  http_load_balancer_request_started(owner->load_balancer, target);
+  if (!_curl_perform_request(self, target))
+    {
+      _track_request_finished(self, self->curl, target, 0);
+      return LTR_NOT_CONNECTED;
+    }
+
+  return _map_response(self, self->curl, target, _get_request_body_size(self), self->super.batch_size);
+}
+
 static gboolean
 _format_request_headers_error_is_critical(GError *error)
 {
@@ -675,8 +785,8 @@ _format_request_headers_catch_error(GError **error)
  *   1) we reach batch_size,
  *   2) the message queue becomes empty
  */
-static LogThreadedResult
-_flush(LogThreadedDestWorker *s, LogThreadedFlushMode mode)
+LogThreadedResult
+http_dw_flush(LogThreadedDestWorker *s, LogThreadedFlushMode mode)
 {
   HTTPDestinationWorker *self = (HTTPDestinationWorker *) s;
   HTTPDestinationDriver *owner = (HTTPDestinationDriver *) s->owner;
@@ -691,12 +801,16 @@ _flush(LogThreadedDestWorker *s, LogThreadedFlushMode mode)
   if (mode == LTF_FLUSH_EXPEDITE)
     return LTR_RETRY;
 
-  _finish_request_body(self);
+  if (!_finish_request_body(self))
+    {
+      retval = LTR_ERROR;
+      goto exit;
+    }
 
   if (!_try_format_request_headers(self, &error))
     {
       if (!_format_request_headers_catch_error(&error))
-        return LTR_NOT_CONNECTED;
+        goto exit;
     }
 
   target = http_load_balancer_choose_target(owner->load_balancer, &self->lbc);
@@ -706,7 +820,7 @@ _flush(LogThreadedDestWorker *s, LogThreadedFlushMode mode)
       retval = _flush_on_target(self, target);
       if (retval == LTR_SUCCESS)
         {
-          gsize msg_length = self->request_body->len;
+          gsize msg_length = _get_request_body_size(self);
           log_threaded_dest_worker_written_bytes_add(&self->super, msg_length);
           log_threaded_dest_driver_insert_batch_length_stats(self->super.owner, msg_length);
 
@@ -736,18 +850,144 @@ _flush(LogThreadedDestWorker *s, LogThreadedFlushMode mode)
       target = alt_target;
     }
 
+exit:
   _reinit_request_headers(self);
   _reinit_request_body(self);
 
   return retval;
 }
 
+/* NOTE: runs in the sender thread of self->multi */
+static void
+_multi_request_completed(HTTPMultiRequest *request, CURLcode code, gpointer user_data)
+{
+  HTTPDestinationWorker *self = (HTTPDestinationWorker *) user_data;
+  HTTPDestinationDriver *owner = (HTTPDestinationDriver *) self->super.owner;
+  LogThreadedResult result = LTR_NOT_CONNECTED;
+
+  if (code != CURLE_OK)
+    {
+      _report_curl_error(self, request->target, code);
+      _track_request_finished(self, request->curl, request->target, 0);
+    }
+  else
+    result = _map_response(self, request->curl, request->target, request->body_size, request->batch_size);
+
+  if (result == LTR_SUCCESS)
+    {
+      log_threaded_dest_worker_written_bytes_add(&self->super, request->body_size);
+      log_threaded_dest_driver_insert_batch_length_stats(self->super.owner, request->body_size);
+
+      http_load_balancer_set_target_successful(owner->load_balancer, request->target);
+    }
+  else
+    {
+      /* the batch is retried, possibly on another target */
+      http_load_balancer_set_target_failed(owner->load_balancer, request->target);
+    }
+
+  log_threaded_dest_worker_complete_batch(&self->super, request->batch_id, result);
+}
+
+/* hands the body over to the request, so that the next batch can be
+ * formatted while this one is in flight */
+static void
+_move_request_body(HTTPDestinationWorker *self, HTTPMultiRequest *request)
+{
+  HTTPDestinationDriver *owner = (HTTPDestinationDriver *) self->super.owner;
+  GString *body = request->body;
+
+  if (self->stream_compression)
+    {
+      request->body = self->request_body_compressed;
+      self->request_body_compressed = body;
+      return;
+    }
+
+  if (owner->message_compression != CURL_COMPRESSION_UNCOMPRESSED)
+    {
+      if (compressor_compress(self->compressor, request->body, self->request_body))
+        return;
+
+      msg_warning("http-worker", evt_tag_error("Compression failed, sending uncompressed data."));
+    }
+
+  request->body = self->request_body;
+  self->request_body = body;
+}
+
+/* used instead of http_dw_flush() with max-inflight-batches(), the request is
+ * sent by self->multi and its outcome is reported by
+ * _multi_request_completed() */
+static LogThreadedResult
+_flush_async(LogThreadedDestWorker *s, LogThreadedFlushMode mode, guint32 batch_id)
+{
+  HTTPDestinationWorker *self = (HTTPDestinationWorker *) s;
+  HTTPDestinationDriver *owner = (HTTPDestinationDriver *) s->owner;
+  LogThreadedResult result = LTR_NOT_CONNECTED;
+  HTTPMultiRequest *request;
+  GError *error = NULL;
+
+  if (mode == LTF_FLUSH_EXPEDITE)
+    {
+      result = LTR_RETRY;
+      goto exit;
+    }
+
+  if (!_finish_request_body(self))
+    {
+      result = LTR_ERROR;
+      goto exit;
+    }
+
+  if (!_try_format_request_headers(self, &error))
+    {
+      if (!_format_request_headers_catch_error(&error))
+        goto exit;
+    }
+
+  if (!(request = http_multi_acquire_request(self->multi)))
+    {
+      msg_error("curl: cannot initialize libcurl",
+                evt_tag_int("worker_index", self->super.worker_index),
+                evt_tag_str("driver", owner->super.super.super.id),
+                log_pipe_location_tag(&owner->super.super.super.super));
+      goto exit;
+    }
+
+  request->target = http_load_balancer_choose_target(owner->load_balancer, &self->lbc);
+  request->batch_id = batch_id;
+  request->batch_size = self->request_body_messages;
+  request->body_size = _get_request_body_size(self);
+  request->headers = http_curl_header_list_steal_slist(self->request_headers);
+  _move_request_body(self, request);
+
+  curl_easy_setopt(request->curl, CURLOPT_URL, request->target->url);
+  curl_easy_setopt(request->curl, CURLOPT_POSTFIELDS, request->body->str);
+  curl_easy_setopt(request->curl, CURLOPT_POSTFIELDSIZE, (long) request->body->len);
+  curl_easy_setopt(request->curl, CURLOPT_HTTPHEADER, request->headers);
+
+  msg_trace("Sending HTTP request",
+            evt_tag_str("url", request->target->url),
+            evt_tag_int("batch_id", batch_id));
+
+  http_load_balancer_request_started(owner->load_balancer, request->target);
+  http_multi_submit_request(self->multi, request);
+  result = LTR_QUEUED;
+
+exit:
+  _reinit_request_headers(self);
+  _reinit_request_body(self);
+  return result;
+}
+
 static gboolean
 _should_initiate_flush(HTTPDestinationWorker *self)
 {
   HTTPDestinationDriver *owner = (HTTPDestinationDriver *) self->super.owner;
 
-  return (owner->batch_bytes && self->request_body->len + owner->body_suffix->len >= owner->batch_bytes);
+  return (owner->super.batch_bytes
+          && _get_request_body_size(self) + owner->body_suffix->len >= owner->super.batch_bytes);
 
 }
 
@@ -756,12 +996,14 @@ _insert_batched(LogThreadedDestWorker *s, LogMessage *msg)
 {
   HTTPDestinationWorker *self = (HTTPDestinationWorker *) s;
 
-  gsize orig_msg_len = self->request_body->len;
+  gsize orig_msg_len = _get_request_body_size(self);
   _add_message_to_batch(self, msg);
-  gsize diff_msg_len = self->request_body->len - orig_msg_len;
+  gsize diff_msg_len = _get_request_body_size(self) - orig_msg_len;
   log_threaded_dest_driver_insert_msg_length_stats(self->super.owner, diff_msg_len);
+  log_threaded_dest_worker_batch_bytes_add(&self->super, diff_msg_len);
 
-  if (_should_initiate_flush(self))
+  /* with max-inflight-batches(), batch-bytes() is enforced by LogThreadedDestDriver */
+  if (!self->multi && _should_initiate_flush(self))
     {
       return log_threaded_dest_worker_flush(&self->super, LTF_FLUSH_NORMAL);
     }
@@ -773,9 +1015,9 @@ _insert_single(LogThreadedDestWorker *s, LogMessage *msg)
 {
   HTTPDestinationWorker *self = (HTTPDestinationWorker *) s;
 
-  gsize orig_msg_len = self->request_body->len;
+  gsize orig_msg_len = _get_request_body_size(self);
   _add_message_to_batch(self, msg);
-  gsize diff_msg_len = self->request_body->len - orig_msg_len;
+  gsize diff_msg_len = _get_request_body_size(self) - orig_msg_len;
   log_threaded_dest_driver_insert_msg_length_stats(self->super.owner, diff_msg_len);
 
   _add_msg_specific_headers(self, msg);
@@ -806,6 +1048,11 @@ _init(LogThreadedDestWorker *s)
         }
       gchar *buffer = g_strdup_printf("Content-Encoding: %s", curl_compression_types[owner->message_compression]);
       owner->headers= g_list_append(owner->headers,  buffer);
+
+      /* header plugins get the uncompressed body, which is not kept around
+       * with streaming compression */
+      SignalSlotConnector *ssc = owner->super.super.super.super.signal_slot_connector;
+      self->stream_compression = !signal_slot_is_connected(ssc, signal_http_header_request);
     }
   self->request_headers = http_curl_header_list_new();
   if (!(self->curl = curl_easy_init()))
@@ -816,9 +1063,20 @@ _init(LogThreadedDestWorker *s)
                 log_pipe_location_tag(&owner->super.super.super.super));
       return FALSE;
     }
-  _setup_static_options_in_curl(self);
+  _setup_static_options_in_curl(self, self->curl);
   _reinit_request_headers(self);
   _reinit_request_body(self);
+
+  if (self->super.flush_async)
+    {
+      self->multi = http_multi_new(_setup_multi_request_options_in_curl, _multi_request_completed, self);
+      if (!http_multi_start(self->multi))
+        {
+          http_multi_free(self->multi);
+          self->multi = NULL;
+          return FALSE;
+        }
+    }
   return log_threaded_dest_worker_init_method(s);
 }
 
@@ -828,6 +1086,12 @@ _deinit(LogThreadedDestWorker *s)
   HTTPDestinationWorker *self = (HTTPDestinationWorker *) s;
   HTTPDestinationDriver *owner = (HTTPDestinationDriver *) self->super.owner;
 
+  if (self->multi)
+    {
+      http_multi_free(self->multi);
+      self->multi = NULL;
+    }
+
   g_string_free(self->request_body, TRUE);
   if (self->request_body_compressed)
     g_string_free(self->request_body_compressed, TRUE);
@@ -839,7 +1103,7 @@ _deinit(LogThreadedDestWorker *s)
   log_threaded_dest_worker_deinit_method(s);
 }
 
-static void
+void
 http_dw_free(LogThreadedDestWorker *s)
 {
   HTTPDestinationWorker *self = (HTTPDestinationWorker *) s;
@@ -848,23 +1112,34 @@ http_dw_free(LogThreadedDestWorker *s)
   log_threaded_dest_worker_free_method(s);
 }
 
-LogThreadedDestWorker *
-http_dw_new(LogThreadedDestDriver *o, gint worker_index)
+void
+http_dw_init_instance(HTTPDestinationWorker *self, LogThreadedDestDriver *o, gint worker_index)
 {
-  HTTPDestinationWorker *self = g_new0(HTTPDestinationWorker, 1);
   HTTPDestinationDriver *owner = (HTTPDestinationDriver *) o;
 
   log_threaded_dest_worker_init_instance(&self->super, o, worker_index);
   self->super.init = _init;
   self->super.deinit = _deinit;
-  self->super.flush = _flush;
+  self->super.flush = http_dw_flush;
   self->super.free_fn = http_dw_free;
 
-  if (owner->super.batch_lines > 0 || owner->batch_bytes > 0)
-    self->super.insert = _insert_batched;
+  if (owner->super.batch_lines > 0 || owner->super.batch_bytes > 0)
+    {
+      self->super.insert = _insert_batched;
+      if (owner->super.max_inflight_batches > 1)
+        self->super.flush_async = _flush_async;
+    }
   else
     self->super.insert = _insert_single;
 
   http_lb_client_init(&self->lbc, owner->load_balancer);
+}
+
+LogThreadedDestWorker *
+http_dw_new(LogThreadedDestDriver *o, gint worker_index)
+{
+  HTTPDestinationWorker *self = g_new0(HTTPDestinationWorker, 1);
+
+  http_dw_init_instance(self, o, worker_index);
   return &self->super;
 }
@@ -29,6 +29,7 @@
 #include "http-loadbalancer.h"
 #include "http-curl-header-list.h"
 #include "compression.h"
+#include "http-multi.h"
 
 typedef struct _HTTPDestinationWorker
 {
@@ -36,13 +37,29 @@ typedef struct _HTTPDestinationWorker
   HTTPLoadBalancerClient lbc;
   CURL *curl;
   GString *request_body;
+  gint request_body_messages;
   GString *request_body_compressed;
   Compressor *compressor;
+  /* messages are compressed as they are added to the batch */
+  gboolean stream_compression;
+  gsize request_body_streamed;
   List *request_headers;
+  /* used with max-inflight-batches() */
+  HTTPMulti *multi;
+  /* if set, the body of the response is collected here, not supported
+   * with max-inflight-batches() */
+  GString *response_body;
 } HTTPDestinationWorker;
 
 LogThreadedResult default_map_http_status_to_worker_status(HTTPDestinationWorker *self, const gchar *url,
                                                            glong http_code);
+
+/* for drivers formatting request_body on their own, instead of using body() */
+void http_dw_message_added(HTTPDestinationWorker *self, gsize message_len);
+LogThreadedResult http_dw_flush(LogThreadedDestWorker *s, LogThreadedFlushMode mode);
+void http_dw_free(LogThreadedDestWorker *s);
+
+void http_dw_init_instance(HTTPDestinationWorker *self, LogThreadedDestDriver *owner, gint worker_index);
 LogThreadedDestWorker *http_dw_new(LogThreadedDestDriver *owner, gint worker_index);
 
 #endif
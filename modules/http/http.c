@@ -277,6 +277,21 @@ http_dd_set_accept_encoding(LogDriver *d, const gchar *encoding)
     self->accept_encoding = g_string_new(encoding);
 }
 
+gboolean
+http_dd_set_load_balancing(LogDriver *d, const gchar *mode)
+{
+  HTTPDestinationDriver *self = (HTTPDestinationDriver *) d;
+
+  if (strcmp(mode, "static") == 0)
+    http_load_balancer_set_mode(self->load_balancer, HTTP_LB_STATIC);
+  else if (strcmp(mode, "latency") == 0)
+    http_load_balancer_set_mode(self->load_balancer, HTTP_LB_LATENCY);
+  else
+    return FALSE;
+
+  return TRUE;
+}
+
 void
 http_dd_set_message_compression(LogDriver *d, const gchar *encoding)
 {
@@ -336,14 +351,6 @@ http_dd_set_timeout(LogDriver *d, glong timeout)
   self->timeout = timeout;
 }
 
-void
-http_dd_set_batch_bytes(LogDriver *d, glong batch_bytes)
-{
-  HTTPDestinationDriver *self = (HTTPDestinationDriver *) d;
-
-  self->batch_bytes = batch_bytes;
-}
-
 void
 http_dd_set_body_prefix(LogDriver *d, const gchar *body_prefix)
 {
@@ -385,11 +392,23 @@ _format_stats_key(LogThreadedDestDriver *s, StatsClusterKeyBuilder *kb)
   return NULL;
 }
 
+static void
+_register_load_balancer_stats(HTTPDestinationDriver *self)
+{
+  gint level = log_pipe_is_internal(&self->super.super.super.super) ? STATS_LEVEL3 : STATS_LEVEL1;
+  StatsClusterKeyBuilder *kb = stats_cluster_key_builder_new();
+
+  stats_cluster_key_builder_add_label(kb, stats_cluster_label("id", self->super.super.super.id));
+  http_load_balancer_register_stats(self->load_balancer, kb, level);
+  stats_cluster_key_builder_free(kb);
+}
+
 gboolean
 http_dd_deinit(LogPipe *s)
 {
   HTTPDestinationDriver *self = (HTTPDestinationDriver *)s;
   log_threaded_dest_driver_unregister_aggregated_stats(&self->super);
+  http_load_balancer_unregister_stats(self->load_balancer);
   return log_threaded_dest_driver_deinit_method(s);
 }
 
@@ -431,10 +450,11 @@ http_dd_init(LogPipe *s)
   http_load_balancer_set_recovery_timeout(self->load_balancer, self->super.time_reopen);
 
   log_threaded_dest_driver_register_aggregated_stats(&self->super);
+  _register_load_balancer_stats(self);
   return TRUE;
 }
 
-static void
+void
 http_dd_free(LogPipe *s)
 {
   HTTPDestinationDriver *self = (HTTPDestinationDriver *)s;
@@ -466,11 +486,9 @@ http_dd_free(LogPipe *s)
   log_threaded_dest_driver_free(s);
 }
 
-LogDriver *
-http_dd_new(GlobalConfig *cfg)
+void
+http_dd_init_instance(HTTPDestinationDriver *self, GlobalConfig *cfg)
 {
-  HTTPDestinationDriver *self = g_new0(HTTPDestinationDriver, 1);
-
   log_threaded_dest_driver_init_instance(&self->super, cfg);
   log_template_options_defaults(&self->template_options);
 
@@ -489,7 +507,6 @@ http_dd_new(GlobalConfig *cfg)
   self->peer_verify = TRUE;
   /* disable batching even if the global batch_lines is specified */
   self->super.batch_lines = 0;
-  self->batch_bytes = 0;
   self->body_prefix = g_string_new("");
   self->body_suffix = g_string_new("");
   self->delimiter = g_string_new("\n");
@@ -501,6 +518,13 @@ http_dd_new(GlobalConfig *cfg)
                                        SYSLOG_NG_VERSION, curl_info->version);
 
   self->response_handlers = http_response_handlers_new();
+}
+
+LogDriver *
+http_dd_new(GlobalConfig *cfg)
+{
+  HTTPDestinationDriver *self = g_new0(HTTPDestinationDriver, 1);
 
+  http_dd_init_instance(self, cfg);
   return &self->super.super.super;
 }
@@ -63,7 +63,6 @@ typedef struct
   gboolean accept_redirects;
   short int method_type;
   glong timeout;
-  glong batch_bytes;
   LogTemplate *body_template;
   LogTemplateOptions template_options;
   HttpResponseHandlers *response_handlers;
@@ -71,6 +70,8 @@ typedef struct
 
 gboolean http_dd_init(LogPipe *s);
 gboolean http_dd_deinit(LogPipe *s);
+void http_dd_free(LogPipe *s);
+void http_dd_init_instance(HTTPDestinationDriver *self, GlobalConfig *cfg);
 LogDriver *http_dd_new(GlobalConfig *cfg);
 
 void http_dd_set_urls(LogDriver *d, GList *urls);
@@ -92,7 +93,6 @@ gboolean http_dd_set_ssl_version(LogDriver *d, const gchar *value);
 void http_dd_set_peer_verify(LogDriver *d, gboolean verify);
 gboolean http_dd_set_ocsp_stapling_verify(LogDriver *d, gboolean verify);
 void http_dd_set_timeout(LogDriver *d, glong timeout);
-void http_dd_set_batch_bytes(LogDriver *d, glong batch_bytes);
 void http_dd_set_body_prefix(LogDriver *d, const gchar *body_prefix);
 void http_dd_set_body_suffix(LogDriver *d, const gchar *body_suffix);
 void http_dd_set_delimiter(LogDriver *d, const gchar *delimiter);
@@ -100,5 +100,6 @@ void http_dd_insert_response_handler(LogDriver *d, HttpResponseHandler *response
 LogTemplateOptions *http_dd_get_template_options(LogDriver *d);
 void http_dd_set_accept_encoding(LogDriver *d, const gchar *encoding);
 void http_dd_set_message_compression(LogDriver *d, const gchar *encoding);
+gboolean http_dd_set_load_balancing(LogDriver *d, const gchar *mode);
 
 #endif
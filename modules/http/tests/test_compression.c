@@ -158,4 +158,48 @@ Test(compression, compressor_deflate_compression)
   compressor_free(compressor);
   g_string_free(result, TRUE);
 }
+
+static void
+_stream_compress_in_chunks(Compressor *stream_compressor, GString *compressed)
+{
+  gsize chunk_len = input->len / 3;
+
+  cr_assert(compressor_stream_begin(stream_compressor, compressed));
+  cr_assert(compressor_stream_append(stream_compressor, input->str, chunk_len));
+  cr_assert(compressor_stream_append(stream_compressor, input->str + chunk_len, chunk_len));
+  cr_assert(compressor_stream_append(stream_compressor, input->str + 2 * chunk_len, input->len - 2 * chunk_len));
+  cr_assert(compressor_stream_finish(stream_compressor));
+}
+
+Test(compression, compressor_gzip_stream_compression)
+{
+  replace_gzip_header_os_id(test_message_gzipped_bytes);
+  compressor = gzip_compressor_new();
+  result = g_string_new("");
+
+  /* the second round reuses the stream of the first one */
+  for (gint i = 0; i < 2; i++)
+    {
+      _stream_compress_in_chunks(compressor, result);
+      test_compression_results(result, test_message_gzipped_bytes, test_message_gzipped_length);
+    }
+
+  compressor_free(compressor);
+  g_string_free(result, TRUE);
+}
+
+Test(compression, compressor_deflate_stream_compression)
+{
+  compressor = deflate_compressor_new();
+  result = g_string_new("");
+
+  for (gint i = 0; i < 2; i++)
+    {
+      _stream_compress_in_chunks(compressor, result);
+      test_compression_results(result, test_message_deflated_bytes, test_message_deflated_length);
+    }
+
+  compressor_free(compressor);
+  g_string_free(result, TRUE);
+}
 #endif
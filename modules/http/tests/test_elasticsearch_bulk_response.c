@@ -0,0 +1,113 @@
+/*
+ * Copyright (c) 2024 One Identity LLC.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#include <criterion/criterion.h>
+#include "elasticsearch-bulk-response.h"
+
+#include <string.h>
+
+static GArray *statuses;
+
+static gboolean
+_parse(const gchar *response, gboolean *errors)
+{
+  return elasticsearch_parse_bulk_response(response, strlen(response), errors, statuses);
+}
+
+static void
+_assert_statuses(gint expected[], gint num_expected)
+{
+  cr_assert_eq(statuses->len, num_expected);
+  for (gint i = 0; i < num_expected; i++)
+    cr_assert_eq(g_array_index(statuses, gint, i), expected[i], "status mismatch at item %d", i);
+}
+
+Test(elasticsearch_bulk_response, successful_batch)
+{
+  gboolean errors = TRUE;
+
+  cr_assert(_parse("{\"took\":30,\"errors\":false,\"items\":["
+                   "{\"index\":{\"_index\":\"test\",\"_id\":\"1\",\"_version\":1,\"result\":\"created\","
+                   "\"_shards\":{\"total\":2,\"successful\":1,\"failed\":0},\"status\":201,\"_seq_no\":0}},"
+                   "{\"index\":{\"_index\":\"test\",\"_id\":\"2\",\"status\":200}}]}", &errors));
+
+  cr_assert_not(errors);
+  _assert_statuses((gint[]) { 201, 200 }, 2);
+}
+
+Test(elasticsearch_bulk_response, partially_failed_batch)
+{
+  gboolean errors = FALSE;
+
+  cr_assert(_parse("{\n"
+                   "  \"took\": 486,\n"
+                   "  \"errors\": true,\n"
+                   "  \"items\": [\n"
+                   "    { \"index\": { \"_index\": \"test\", \"status\": 201 } },\n"
+                   "    { \"index\": { \"_index\": \"test\", \"status\": 429,\n"
+                   "        \"error\": { \"type\": \"es_rejected_execution_exception\",\n"
+                   "                     \"reason\": \"rejected \\\"execution\\\" [x]\" } } },\n"
+                   "    { \"index\": { \"_index\": \"test\", \"status\": 400,\n"
+                   "        \"error\": { \"type\": \"mapper_parsing_exception\",\n"
+                   "                     \"caused_by\": [ { \"a\": null } ] } } }\n"
+                   "  ]\n"
+                   "}\n", &errors));
+
+  cr_assert(errors);
+  _assert_statuses((gint[]) { 201, 429, 400 }, 3);
+}
+
+Test(elasticsearch_bulk_response, empty_items)
+{
+  gboolean errors = TRUE;
+
+  cr_assert(_parse("{\"took\":0,\"errors\":false,\"items\":[]}", &errors));
+  cr_assert_not(errors);
+  cr_assert_eq(statuses->len, 0);
+}
+
+Test(elasticsearch_bulk_response, invalid_responses)
+{
+  gboolean errors;
+
+  cr_assert_not(_parse("", &errors));
+  cr_assert_not(_parse("{}", &errors));
+  cr_assert_not(_parse("{\"error\":{\"type\":\"illegal_argument_exception\"},\"status\":400}", &errors));
+  cr_assert_not(_parse("{\"errors\":false,\"items\":[{\"index\":{\"_id\":\"1\"}}]}", &errors));
+  cr_assert_not(_parse("{\"errors\":true,\"items\":[{\"index\":{\"status\":201}}", &errors));
+  cr_assert_not(_parse("{\"errors\":maybe,\"items\":[]}", &errors));
+  cr_assert_not(_parse("{\"errors\":false,\"items\":[{\"index\":{\"status\":\"201\"}}]}", &errors));
+}
+
+static void
+setup(void)
+{
+  statuses = g_array_new(FALSE, FALSE, sizeof(gint));
+}
+
+static void
+teardown(void)
+{
+  g_array_free(statuses, TRUE);
+}
+
+TestSuite(elasticsearch_bulk_response, .init = setup, .fini = teardown);
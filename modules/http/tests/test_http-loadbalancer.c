@@ -326,6 +326,112 @@ Test(http_loadbalancer, drop_targets_resets_the_target_list)
   http_load_balancer_free(lb);
 }
 
+static HTTPLoadBalancer *
+_construct_latency_load_balancer(void)
+{
+  HTTPLoadBalancer *lb = _construct_load_balancer();
+
+  http_load_balancer_set_mode(lb, HTTP_LB_LATENCY);
+  for (gint i = 0; i < lb->num_targets; i++)
+    {
+      http_load_balancer_request_started(lb, &lb->targets[i]);
+      http_load_balancer_request_finished(lb, &lb->targets[i], 100000, FALSE);
+    }
+  return lb;
+}
+
+Test(http_loadbalancer, outstanding_requests_are_tracked_per_target)
+{
+  HTTPLoadBalancer *lb = _construct_load_balancer();
+  HTTPLoadBalancerTarget *target = &lb->targets[0];
+
+  http_load_balancer_request_started(lb, target);
+  http_load_balancer_request_started(lb, target);
+  cr_assert(target->outstanding_requests == 2);
+
+  http_load_balancer_request_finished(lb, target, 1000, FALSE);
+  cr_assert(target->outstanding_requests == 1);
+  cr_assert(target->avg_response_time == 1000);
+
+  http_load_balancer_request_finished(lb, target, -1, FALSE);
+  cr_assert(target->outstanding_requests == 0);
+  cr_assert(target->avg_response_time == 1000, "requests without a response must not affect the response time");
+
+  http_load_balancer_free(lb);
+}
+
+Test(http_loadbalancer, latency_mode_prefers_the_fastest_target)
+{
+  HTTPLoadBalancer *lb = _construct_latency_load_balancer();
+  HTTPLoadBalancerClient lbc;
+
+  http_lb_client_init(&lbc, lb);
+  http_load_balancer_request_started(lb, &lb->targets[3]);
+  http_load_balancer_request_finished(lb, &lb->targets[3], 0, FALSE);
+
+  cr_assert(http_load_balancer_choose_target(lb, &lbc) == &lb->targets[3]);
+
+  http_lb_client_deinit(&lbc);
+  http_load_balancer_free(lb);
+}
+
+Test(http_loadbalancer, latency_mode_spreads_outstanding_requests)
+{
+  HTTPLoadBalancer *lb = _construct_latency_load_balancer();
+  HTTPLoadBalancerClient lbc[NUM_TARGETS];
+
+  _setup_lb_clients(lb, lbc, G_N_ELEMENTS(lbc));
+
+  for (gint i = 0; i < G_N_ELEMENTS(lbc); i++)
+    {
+      HTTPLoadBalancerTarget *target = http_load_balancer_choose_target(lb, &lbc[i]);
+
+      cr_assert(target->outstanding_requests == 0);
+      http_load_balancer_request_started(lb, target);
+    }
+
+  _teardown_lb_clients(lb, lbc, G_N_ELEMENTS(lbc));
+  http_load_balancer_free(lb);
+}
+
+Test(http_loadbalancer, latency_mode_avoids_throttling_targets)
+{
+  HTTPLoadBalancer *lb = _construct_latency_load_balancer();
+  HTTPLoadBalancerClient lbc;
+
+  http_lb_client_init(&lbc, lb);
+  HTTPLoadBalancerTarget *target = http_load_balancer_choose_target(lb, &lbc);
+
+  for (gint i = 0; i < 5; i++)
+    {
+      http_load_balancer_request_started(lb, target);
+      http_load_balancer_request_finished(lb, target, 100000, TRUE);
+    }
+
+  cr_assert(target->throttle_rate > 0);
+  cr_assert(http_load_balancer_choose_target(lb, &lbc) != target);
+
+  http_lb_client_deinit(&lbc);
+  http_load_balancer_free(lb);
+}
+
+Test(http_loadbalancer, latency_mode_sticks_to_the_current_target_if_others_are_not_much_faster)
+{
+  HTTPLoadBalancer *lb = _construct_latency_load_balancer();
+  HTTPLoadBalancerClient lbc;
+
+  http_lb_client_init(&lbc, lb);
+  HTTPLoadBalancerTarget *target = http_load_balancer_choose_target(lb, &lbc);
+
+  http_load_balancer_request_started(lb, target);
+  http_load_balancer_request_finished(lb, target, 110000, FALSE);
+
+  cr_assert(http_load_balancer_choose_target(lb, &lbc) == target);
+
+  http_lb_client_deinit(&lbc);
+  http_load_balancer_free(lb);
+}
+
 void
 setup(void)
 {
@@ -0,0 +1,154 @@
+/*
+ * Copyright (c) 2024 One Identity LLC.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#include <criterion/criterion.h>
+#include "http-multi.h"
+#include "apphook.h"
+
+#include <string.h>
+
+#define TEST_MAX_WAIT_SEC 10
+
+typedef struct _TestState
+{
+  GMutex lock;
+  GCond cond;
+  const gchar *url;
+  gint num_completed;
+  gint num_failed;
+  guint32 batch_id_sum;
+} TestState;
+
+static TestState state;
+
+static void
+_setup(CURL *curl, gpointer user_data)
+{
+  TestState *s = (TestState *) user_data;
+
+  curl_easy_setopt(curl, CURLOPT_URL, s->url);
+}
+
+static void
+_completed(HTTPMultiRequest *request, CURLcode code, gpointer user_data)
+{
+  TestState *s = (TestState *) user_data;
+
+  g_mutex_lock(&s->lock);
+  s->num_completed++;
+  if (code != CURLE_OK)
+    s->num_failed++;
+  s->batch_id_sum += request->batch_id;
+  g_cond_signal(&s->cond);
+  g_mutex_unlock(&s->lock);
+}
+
+static void
+_submit_requests(HTTPMulti *multi, gint num)
+{
+  for (gint i = 1; i <= num; i++)
+    {
+      HTTPMultiRequest *request = http_multi_acquire_request(multi);
+
+      cr_assert(request);
+      request->batch_id = i;
+      http_multi_submit_request(multi, request);
+    }
+}
+
+static void
+_wait_for_completions(gint num)
+{
+  gint64 end_time = g_get_monotonic_time() + TEST_MAX_WAIT_SEC * G_TIME_SPAN_SECOND;
+
+  g_mutex_lock(&state.lock);
+  while (state.num_completed < num)
+    {
+      if (!g_cond_wait_until(&state.cond, &state.lock, end_time))
+        break;
+    }
+  g_mutex_unlock(&state.lock);
+
+  cr_assert_eq(state.num_completed, num, "not all requests completed: %d of %d", state.num_completed, num);
+}
+
+Test(http_multi, requests_in_flight_are_completed_independently)
+{
+  state.url = "file:///dev/null";
+
+  HTTPMulti *multi = http_multi_new(_setup, _completed, &state);
+  cr_assert(http_multi_start(multi));
+
+  _submit_requests(multi, 8);
+  _wait_for_completions(8);
+  cr_assert_eq(state.num_failed, 0);
+  cr_assert_eq(state.batch_id_sum, 8 * 9 / 2);
+
+  /* completed requests are reused */
+  _submit_requests(multi, 8);
+  _wait_for_completions(16);
+  cr_assert_eq(state.num_failed, 0);
+
+  http_multi_free(multi);
+}
+
+Test(http_multi, transfer_errors_are_reported)
+{
+  state.url = "file:///nonexistent/file";
+
+  HTTPMulti *multi = http_multi_new(_setup, _completed, &state);
+  cr_assert(http_multi_start(multi));
+
+  _submit_requests(multi, 2);
+  _wait_for_completions(2);
+  cr_assert_eq(state.num_failed, 2);
+
+  http_multi_free(multi);
+}
+
+Test(http_multi, stop_without_requests)
+{
+  HTTPMulti *multi = http_multi_new(_setup, _completed, &state);
+
+  cr_assert(http_multi_start(multi));
+  http_multi_stop(multi);
+  http_multi_free(multi);
+}
+
+static void
+setup(void)
+{
+  app_startup();
+  memset(&state, 0, sizeof(state));
+  g_mutex_init(&state.lock);
+  g_cond_init(&state.cond);
+}
+
+static void
+teardown(void)
+{
+  g_cond_clear(&state.cond);
+  g_mutex_clear(&state.lock);
+  app_shutdown();
+}
+
+TestSuite(http_multi, .init = setup, .fini = teardown);
@@ -0,0 +1,165 @@
+/*
+ * Copyright (c) 2024 One Identity LLC.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+package org.syslog_ng.test;
+
+import java.nio.ByteBuffer;
+import java.nio.charset.StandardCharsets;
+import java.util.ArrayList;
+import java.util.List;
+
+import org.junit.Before;
+import org.junit.Test;
+import org.syslog_ng.BatchTextLogDestination;
+
+import static org.junit.Assert.*;
+
+public class TestBatchTextLogDestination {
+
+	/* collects the messages of the batches, as a destination would send them */
+	private static class MockBatchTextLogDestination extends BatchTextLogDestination {
+		public static final int RESULT_SUCCESS = SUCCESS;
+		public static final int RESULT_ERROR = ERROR;
+		public static final int RESULT_RETRY = RETRY;
+
+		public List<String> messages = new ArrayList<String>();
+		public int result = SUCCESS;
+		public RuntimeException exception;
+		public Exception reportedException;
+
+		public MockBatchTextLogDestination() {
+			super(0);
+		}
+
+		@Override
+		protected int sendBatch(ByteBuffer buffer, int[] offsets, int count) {
+			if (exception != null)
+				throw exception;
+
+			for (int i = 0; i < count; i++) {
+				byte[] message = new byte[offsets[i + 1] - offsets[i]];
+
+				buffer.position(offsets[i]);
+				buffer.get(message);
+				messages.add(new String(message, StandardCharsets.UTF_8));
+			}
+			return result;
+		}
+
+		/* the native InternalMessageSender is not available in unit tests */
+		@Override
+		protected void sendExceptionMessage(Exception e) {
+			reportedException = e;
+		}
+
+		@Override
+		protected boolean open() {
+			return true;
+		}
+
+		@Override
+		protected void close() {
+		}
+
+		@Override
+		protected boolean isOpened() {
+			return true;
+		}
+
+		@Override
+		protected String getNameByUniqOptions() {
+			return "Dummy";
+		}
+
+		@Override
+		protected boolean init() {
+			return true;
+		}
+
+		@Override
+		protected void deinit() {
+		}
+	}
+
+	private MockBatchTextLogDestination destination;
+	private ByteBuffer buffer;
+	private List<Integer> offsets;
+
+	@Before
+	public void setUp() {
+		destination = new MockBatchTextLogDestination();
+
+		/* the buffer maps the whole native allocation, which is larger than the batch */
+		buffer = ByteBuffer.allocateDirect(1024);
+		offsets = new ArrayList<Integer>();
+		offsets.add(0);
+	}
+
+	private void queue(String message) {
+		buffer.put(message.getBytes(StandardCharsets.UTF_8));
+		offsets.add(buffer.position());
+	}
+
+	private int sendBatch() {
+		int[] offsetsArray = new int[offsets.size() + 4];
+
+		/* the offsets array is reused across batches, it can be longer than needed */
+		for (int i = 0; i < offsets.size(); i++)
+			offsetsArray[i] = offsets.get(i);
+		return destination.sendBatchProxy(buffer, offsetsArray, offsets.size() - 1);
+	}
+
+	@Test
+	public void testMessagesAreDelimitedByTheOffsets() {
+		queue("first message");
+		queue("");
+		/* multi-byte characters, the offsets are in bytes */
+		queue("\u00e1rv\u00edzt\u0171r\u0151");
+
+		assertEquals(MockBatchTextLogDestination.RESULT_SUCCESS, sendBatch());
+		assertEquals(3, destination.messages.size());
+		assertEquals("first message", destination.messages.get(0));
+		assertEquals("", destination.messages.get(1));
+		assertEquals("\u00e1rv\u00edzt\u0171r\u0151", destination.messages.get(2));
+	}
+
+	@Test
+	public void testResultAppliesToTheWholeBatch() {
+		queue("first message");
+		queue("second message");
+		destination.result = MockBatchTextLogDestination.RESULT_RETRY;
+
+		assertEquals(MockBatchTextLogDestination.RESULT_RETRY, sendBatch());
+		assertEquals(2, destination.messages.size());
+	}
+
+	@Test
+	public void testExceptionFailsTheBatch() {
+		queue("first message");
+		destination.exception = new IllegalStateException("connection lost");
+
+		assertEquals(MockBatchTextLogDestination.RESULT_ERROR, sendBatch());
+		assertSame(destination.exception, destination.reportedException);
+		assertTrue(destination.messages.isEmpty());
+	}
+}
@@ -188,6 +188,21 @@ java_dd_send_to_object(JavaDestDriver *self, LogMessage *msg)
   return result;
 }
 
+static gint
+java_dd_send_batch_to_object(JavaDestDriver *self)
+{
+  gint result = java_destination_proxy_send_batch(self->proxy);
+  if (result < 0 || result >= LTR_MAX || result == LTR_QUEUED || result == LTR_EXPLICIT_ACK_MGMT)
+    {
+      msg_error("java_destination: worker batch result out of range. Retrying batch later",
+                log_pipe_location_tag((LogPipe *)self),
+                evt_tag_int("result", result));
+      return LTR_ERROR;
+    }
+
+  return result;
+}
+
 gboolean
 java_dd_open(LogThreadedDestDriver *s)
 {
@@ -216,9 +231,19 @@ java_worker_insert(LogThreadedDestDriver *s, LogMessage *msg)
 
   if (!java_dd_open(s))
     {
+      /* the core rewinds the messages queued so far */
+      java_destination_proxy_reset_batch(self->proxy);
       return LTR_NOT_CONNECTED;
     }
 
+  /* BatchTextLogDestination: format into the batch buffer, the whole
+   * batch crosses into Java at once in flush() */
+  if (java_destination_proxy_is_batched(self->proxy))
+    {
+      java_destination_proxy_queue(self->proxy, msg);
+      return LTR_QUEUED;
+    }
+
   return java_dd_send_to_object(self, msg);
 }
 
@@ -226,6 +251,14 @@ static LogThreadedResult
 java_worker_flush(LogThreadedDestDriver *d)
 {
   JavaDestDriver *self = (JavaDestDriver *)d;
+
+  if (java_destination_proxy_is_batched(self->proxy))
+    {
+      LogThreadedResult result = java_dd_send_batch_to_object(self);
+      if (result != LTR_SUCCESS)
+        return result;
+    }
+
   return java_destination_proxy_flush(self->proxy);
 }
 
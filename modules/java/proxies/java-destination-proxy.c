@@ -39,6 +39,7 @@ typedef struct _JavaDestinationImpl
   jmethodID mi_deinit;
   jmethodID mi_send;
   jmethodID mi_send_msg;
+  jmethodID mi_send_batch;
   jmethodID mi_open;
   jmethodID mi_close;
   jmethodID mi_is_opened;
@@ -56,6 +57,17 @@ struct _JavaDestinationProxy
   GString *formatted_message;
   JavaLogMessageProxy *msg_builder;
   gchar *name_by_uniq_options;
+
+  /* formatted messages of the current batch stored back to back and the
+   * offsets delimiting them, exposed to Java without copying */
+  struct
+  {
+    GString *buffer;
+    GArray *offsets;
+    jobject byte_buffer;
+    jintArray offsets_array;
+    gsize offsets_array_len;
+  } batch;
 };
 
 static gboolean
@@ -101,11 +113,17 @@ __load_destination_object(JavaDestinationProxy *self, const gchar *class_name, c
   self->dest_impl.mi_send_msg = CALL_JAVA_FUNCTION(java_env, GetMethodID, self->loaded_class, "sendProxy",
                                                    "(Lorg/syslog_ng/LogMessage;)I");
 
-  if (!self->dest_impl.mi_send_msg && !self->dest_impl.mi_send)
+  self->dest_impl.mi_send_batch = CALL_JAVA_FUNCTION(java_env, GetMethodID, self->loaded_class, "sendBatchProxy",
+                                                     "(Ljava/nio/ByteBuffer;[II)I");
+  /* the lookups above leave a pending NoSuchMethodError behind */
+  CALL_JAVA_FUNCTION_VOID(java_env, ExceptionClear);
+
+  if (!self->dest_impl.mi_send_msg && !self->dest_impl.mi_send && !self->dest_impl.mi_send_batch)
     {
       msg_error("Can't find any queue method in class",
                 evt_tag_str("class_name", class_name),
-                evt_tag_str("method", "int sendProxy(String) or int sendProxy(LogMessage)"));
+                evt_tag_str("method", "int sendProxy(String), int sendProxy(LogMessage) or "
+                            "int sendBatchProxy(ByteBuffer, int[], int)"));
     }
 
   self->dest_impl.flush = CALL_JAVA_FUNCTION(java_env, GetMethodID, self->loaded_class,
@@ -190,6 +208,18 @@ java_destination_proxy_free(JavaDestinationProxy *self)
     {
       java_log_message_proxy_free(self->msg_builder);
     }
+
+  if (self->batch.byte_buffer)
+    {
+      CALL_JAVA_FUNCTION(env, DeleteGlobalRef, self->batch.byte_buffer);
+    }
+
+  if (self->batch.offsets_array)
+    {
+      CALL_JAVA_FUNCTION(env, DeleteGlobalRef, self->batch.offsets_array);
+    }
+  g_string_free(self->batch.buffer, TRUE);
+  g_array_free(self->batch.offsets, TRUE);
   java_machine_unref(self->java_machine);
   g_string_free(self->formatted_message, TRUE);
   g_free(self->name_by_uniq_options);
@@ -206,6 +236,9 @@ java_destination_proxy_new(const gchar *class_name, const gchar *class_path, gpo
   self->formatted_message = g_string_sized_new(1024);
   self->template = log_template_ref(template);
   self->seq_num = seq_num;
+  self->batch.buffer = g_string_sized_new(1024);
+  self->batch.offsets = g_array_new(FALSE, FALSE, sizeof(jint));
+  java_destination_proxy_reset_batch(self);
 
   if (!java_machine_start(self->java_machine, jvm_options))
     goto error;
@@ -267,6 +300,111 @@ java_destination_proxy_send(JavaDestinationProxy *self, LogMessage *msg)
     }
 }
 
+gboolean
+java_destination_proxy_is_batched(JavaDestinationProxy *self)
+{
+  return self->dest_impl.mi_send_batch != 0;
+}
+
+void
+java_destination_proxy_reset_batch(JavaDestinationProxy *self)
+{
+  const jint start = 0;
+
+  g_string_truncate(self->batch.buffer, 0);
+  g_array_set_size(self->batch.offsets, 0);
+  g_array_append_val(self->batch.offsets, start);
+}
+
+void
+java_destination_proxy_queue(JavaDestinationProxy *self, LogMessage *msg)
+{
+  LogTemplateEvalOptions options = {NULL, LTZ_SEND, *self->seq_num, NULL, LM_VT_STRING};
+  log_template_append_format(self->template, msg, &options, self->batch.buffer);
+
+  jint end = self->batch.buffer->len;
+  g_array_append_val(self->batch.offsets, end);
+}
+
+/* The direct ByteBuffer maps the whole allocation of the batch buffer, it
+ * only has to be recreated when the GString is reallocated, which stops
+ * happening once the buffer has grown to the typical batch size. */
+static jobject
+__get_batch_byte_buffer(JavaDestinationProxy *self, JNIEnv *env)
+{
+  GString *buffer = self->batch.buffer;
+
+  if (self->batch.byte_buffer &&
+      CALL_JAVA_FUNCTION(env, GetDirectBufferAddress, self->batch.byte_buffer) == buffer->str &&
+      (gsize) CALL_JAVA_FUNCTION(env, GetDirectBufferCapacity, self->batch.byte_buffer) == buffer->allocated_len)
+    return self->batch.byte_buffer;
+
+  if (self->batch.byte_buffer)
+    CALL_JAVA_FUNCTION(env, DeleteGlobalRef, self->batch.byte_buffer);
+
+  jobject byte_buffer = CALL_JAVA_FUNCTION(env, NewDirectByteBuffer, buffer->str, buffer->allocated_len);
+  if (!byte_buffer)
+    {
+      self->batch.byte_buffer = NULL;
+      return NULL;
+    }
+  self->batch.byte_buffer = CALL_JAVA_FUNCTION(env, NewGlobalRef, byte_buffer);
+  CALL_JAVA_FUNCTION(env, DeleteLocalRef, byte_buffer);
+  return self->batch.byte_buffer;
+}
+
+static jintArray
+__get_batch_offsets_array(JavaDestinationProxy *self, JNIEnv *env)
+{
+  GArray *offsets = self->batch.offsets;
+
+  if (!self->batch.offsets_array || self->batch.offsets_array_len < offsets->len)
+    {
+      if (self->batch.offsets_array)
+        CALL_JAVA_FUNCTION(env, DeleteGlobalRef, self->batch.offsets_array);
+
+      self->batch.offsets_array = NULL;
+      self->batch.offsets_array_len = 0;
+
+      jintArray offsets_array = CALL_JAVA_FUNCTION(env, NewIntArray, offsets->len);
+      if (!offsets_array)
+        return NULL;
+      self->batch.offsets_array = CALL_JAVA_FUNCTION(env, NewGlobalRef, offsets_array);
+      self->batch.offsets_array_len = offsets->len;
+      CALL_JAVA_FUNCTION(env, DeleteLocalRef, offsets_array);
+    }
+
+  CALL_JAVA_FUNCTION(env, SetIntArrayRegion, self->batch.offsets_array, 0, offsets->len,
+                     (const jint *) offsets->data);
+  return self->batch.offsets_array;
+}
+
+gint
+java_destination_proxy_send_batch(JavaDestinationProxy *self)
+{
+  JNIEnv *env = java_machine_get_env(self->java_machine);
+  gint count = self->batch.offsets->len - 1;
+
+  if (count == 0)
+    return LTR_SUCCESS;
+
+  jobject byte_buffer = __get_batch_byte_buffer(self, env);
+  jintArray offsets_array = __get_batch_offsets_array(self, env);
+  if (!byte_buffer || !offsets_array)
+    {
+      CALL_JAVA_FUNCTION_VOID(env, ExceptionClear);
+      msg_error("java_destination: error allocating batch buffers, retrying batch later",
+                evt_tag_int("batch_size", count));
+      java_destination_proxy_reset_batch(self);
+      return LTR_ERROR;
+    }
+
+  jint res = CALL_JAVA_FUNCTION(env, CallIntMethod, self->dest_impl.dest_object, self->dest_impl.mi_send_batch,
+                                byte_buffer, offsets_array, count);
+  java_destination_proxy_reset_batch(self);
+  return res;
+}
+
 gchar *
 java_destination_proxy_get_name_by_uniq_options(JavaDestinationProxy *self)
 {
@@ -41,6 +41,10 @@ void java_destination_proxy_deinit(JavaDestinationProxy *self);
 gint java_destination_proxy_flush(JavaDestinationProxy *self);
 gchar *java_destination_proxy_get_name_by_uniq_options(JavaDestinationProxy *self);
 gboolean java_destination_proxy_send(JavaDestinationProxy *self, LogMessage *msg);
+gboolean java_destination_proxy_is_batched(JavaDestinationProxy *self);
+void java_destination_proxy_queue(JavaDestinationProxy *self, LogMessage *msg);
+gint java_destination_proxy_send_batch(JavaDestinationProxy *self);
+void java_destination_proxy_reset_batch(JavaDestinationProxy *self);
 gboolean java_destination_proxy_open(JavaDestinationProxy *self);
 void java_destination_proxy_close(JavaDestinationProxy *self);
 gboolean java_destination_proxy_is_opened(JavaDestinationProxy *self);
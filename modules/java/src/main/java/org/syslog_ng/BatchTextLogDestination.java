@@ -0,0 +1,52 @@
+/*
+ * Copyright (c) 2024 One Identity LLC.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+package org.syslog_ng;
+
+import java.nio.ByteBuffer;
+
+/*
+ * Destinations deriving from this class receive formatted messages a batch
+ * at a time.  The messages are stored back to back in a direct ByteBuffer
+ * that maps the native formatting buffer, message i occupies the bytes
+ * between offsets[i] and offsets[i + 1], encoded as UTF-8.  The buffer is
+ * only valid during the sendBatch() call and must not be retained.
+ *
+ * The return value applies to the whole batch, as with flush().
+ */
+public abstract class BatchTextLogDestination extends LogDestination {
+	public BatchTextLogDestination(long handle) {
+		super(handle);
+	}
+
+	protected abstract int sendBatch(ByteBuffer messages, int[] offsets, int count);
+	public int sendBatchProxy(ByteBuffer messages, int[] offsets, int count) {
+		try {
+			return sendBatch(messages, offsets, count);
+		}
+		catch (Exception e) {
+			sendExceptionMessage(e);
+			return ERROR;
+		}
+	}
+}
@@ -39,6 +39,7 @@ typedef struct _TFJsonState
   TFSimpleFuncState super;
   ValuePairs *vp;
   gchar key_delimiter;
+  gboolean unsorted;
 } TFJsonState;
 
 static gboolean
@@ -61,11 +62,8 @@ _parse_key_delimiter(const gchar *option_name,
 }
 
 static gboolean
-tf_json_prepare(LogTemplateFunction *self, gpointer s, LogTemplate *parent,
-                gint argc, gchar *argv[],
-                GError **error)
+_prepare(TFJsonState *state, LogTemplate *parent, gint argc, gchar *argv[], gboolean flat, GError **error)
 {
-  TFJsonState *state = (TFJsonState *)s;
   ValuePairsTransformSet *vpts;
   gboolean transform_initial_dot = TRUE;
 
@@ -74,6 +72,8 @@ tf_json_prepare(LogTemplateFunction *self, gpointer s, LogTemplate *parent,
   {
     { "leave-initial-dot", 0, G_OPTION_FLAG_REVERSE, G_OPTION_ARG_NONE, &transform_initial_dot, NULL, NULL },
     { "key-delimiter", 0, 0, G_OPTION_ARG_CALLBACK, _parse_key_delimiter, NULL, NULL },
+    /* only the flat output can be streamed, nesting needs the keys sorted */
+    { flat ? "unsorted" : NULL, 0, 0, G_OPTION_ARG_NONE, &state->unsorted, NULL, NULL },
     { NULL },
   };
 
@@ -116,6 +116,22 @@ tf_json_prepare(LogTemplateFunction *self, gpointer s, LogTemplate *parent,
   return TRUE;
 }
 
+static gboolean
+tf_json_prepare(LogTemplateFunction *self, gpointer s, LogTemplate *parent,
+                gint argc, gchar *argv[],
+                GError **error)
+{
+  return _prepare((TFJsonState *) s, parent, argc, argv, FALSE, error);
+}
+
+static gboolean
+tf_flat_json_prepare(LogTemplateFunction *self, gpointer s, LogTemplate *parent,
+                     gint argc, gchar *argv[],
+                     GError **error)
+{
+  return _prepare((TFJsonState *) s, parent, argc, argv, TRUE, error);
+}
+
 typedef struct
 {
   gboolean need_comma;
@@ -472,10 +488,14 @@ tf_flat_json_append(TFJsonState *state, GString *result, LogMessage *msg, LogTem
 
   g_string_append_c(invocation_state.buffer, '{');
 
-  gboolean success = value_pairs_foreach_sorted(state->vp,
-                                                tf_flat_json_value,
-                                                (GCompareFunc) tf_flat_value_pairs_sort, msg, options,
-                                                &invocation_state);
+  gboolean success;
+  if (state->unsorted)
+    success = value_pairs_foreach_unsorted(state->vp, tf_flat_json_value, msg, options, &invocation_state);
+  else
+    success = value_pairs_foreach_sorted(state->vp,
+                                         tf_flat_json_value,
+                                         (GCompareFunc) tf_flat_value_pairs_sort, msg, options,
+                                         &invocation_state);
 
   g_string_append_c(invocation_state.buffer, '}');
 
@@ -519,5 +539,5 @@ tf_json_free_state(gpointer s)
 TEMPLATE_FUNCTION(TFJsonState, tf_json, tf_json_prepare, NULL, tf_json_call,
                   tf_json_free_state, NULL);
 
-TEMPLATE_FUNCTION(TFJsonState, tf_flat_json, tf_json_prepare, NULL, tf_flat_json_call,
+TEMPLATE_FUNCTION(TFJsonState, tf_flat_json, tf_flat_json_prepare, NULL, tf_flat_json_call,
                   tf_json_free_state, NULL);
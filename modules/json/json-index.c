@@ -0,0 +1,419 @@
+/*
+ * Copyright (c) 2024 One Identity LLC.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#include "json-index.h"
+
+#include <string.h>
+
+#define JSON_INDEX_MAX_DEPTH 16
+#define JSON_INDEX_MAX_INTEGER_DIGITS 18
+
+typedef struct _JSONIndexScanner
+{
+  JSONIndex *index;
+  const gchar *p;
+  const gchar *end;
+} JSONIndexScanner;
+
+static gboolean _scan_value(JSONIndexScanner *s, gint depth);
+
+static inline void
+_skip_whitespace(JSONIndexScanner *s)
+{
+  while (s->p < s->end && (*s->p == ' ' || *s->p == '\t' || *s->p == '\n' || *s->p == '\r'))
+    s->p++;
+}
+
+static inline gboolean
+_next_char_is(JSONIndexScanner *s, gchar c)
+{
+  return s->p < s->end && *s->p == c;
+}
+
+static inline gboolean
+_next_char_is_digit(JSONIndexScanner *s)
+{
+  return s->p < s->end && g_ascii_isdigit(*s->p);
+}
+
+static guint32
+_add_token(JSONIndexScanner *s, JSONIndexTokenType type, const gchar *value, gsize value_len)
+{
+  JSONIndexToken token =
+  {
+    .type = type,
+    .value = value,
+    .value_len = value_len,
+  };
+
+  g_array_append_val(s->index->tokens, token);
+  return s->index->tokens->len - 1;
+}
+
+static inline JSONIndexToken *
+_get_token(JSONIndexScanner *s, guint32 index_)
+{
+  return &g_array_index(s->index->tokens, JSONIndexToken, index_);
+}
+
+static gboolean
+_scan_string(JSONIndexScanner *s, const gchar **value, gsize *value_len, gboolean *escaped)
+{
+  if (!_next_char_is(s, '"'))
+    return FALSE;
+
+  const gchar *start = ++s->p;
+
+  *escaped = FALSE;
+  while (s->p < s->end)
+    {
+      guchar c = *s->p;
+
+      if (c == '"')
+        {
+          *value = start;
+          *value_len = s->p - start;
+          s->p++;
+          return TRUE;
+        }
+      else if (c == '\\')
+        {
+          /* \uXXXX sequences are left to the complete parser */
+          if (s->p + 1 >= s->end || !s->p[1] || !strchr("\"\\/bfnrt", s->p[1]))
+            return FALSE;
+          *escaped = TRUE;
+          s->p += 2;
+        }
+      else if (c < 0x20)
+        return FALSE;
+      else
+        s->p++;
+    }
+  return FALSE;
+}
+
+static gboolean
+_scan_digits(JSONIndexScanner *s)
+{
+  if (!_next_char_is_digit(s))
+    return FALSE;
+  while (_next_char_is_digit(s))
+    s->p++;
+  return TRUE;
+}
+
+static gboolean
+_scan_number(JSONIndexScanner *s)
+{
+  const gchar *start = s->p;
+  gboolean is_double = FALSE;
+
+  if (_next_char_is(s, '-'))
+    s->p++;
+  const gchar *digits = s->p;
+
+  if (_next_char_is(s, '0'))
+    s->p++;
+  else if (!_scan_digits(s))
+    return FALSE;
+
+  if (s->p - digits > JSON_INDEX_MAX_INTEGER_DIGITS)
+    return FALSE;
+
+  if (_next_char_is(s, '.'))
+    {
+      s->p++;
+      if (!_scan_digits(s))
+        return FALSE;
+      is_double = TRUE;
+    }
+  if (_next_char_is(s, 'e') || _next_char_is(s, 'E'))
+    {
+      s->p++;
+      if (_next_char_is(s, '+') || _next_char_is(s, '-'))
+        s->p++;
+      if (!_scan_digits(s))
+        return FALSE;
+      is_double = TRUE;
+    }
+
+  _add_token(s, is_double ? JSON_INDEX_DOUBLE : JSON_INDEX_INTEGER, start, s->p - start);
+  return TRUE;
+}
+
+static gboolean
+_scan_literal(JSONIndexScanner *s, const gchar *literal, gsize literal_len, JSONIndexTokenType type)
+{
+  if ((gsize)(s->end - s->p) < literal_len || memcmp(s->p, literal, literal_len) != 0)
+    return FALSE;
+
+  _add_token(s, type, s->p, literal_len);
+  s->p += literal_len;
+  return TRUE;
+}
+
+static gboolean
+_is_member_name_repeated(JSONIndexScanner *s, guint first_name, const gchar *name, gsize name_len)
+{
+  GArray *member_names = s->index->member_names;
+
+  for (guint i = first_name; i < member_names->len; i++)
+    {
+      JSONIndexToken *token = _get_token(s, g_array_index(member_names, guint32, i));
+
+      if (token->value_len == name_len && memcmp(token->value, name, name_len) == 0)
+        return TRUE;
+    }
+  return FALSE;
+}
+
+static gboolean
+_scan_member(JSONIndexScanner *s, guint first_name, gint depth)
+{
+  const gchar *name;
+  gsize name_len;
+  gboolean escaped;
+
+  if (!_scan_string(s, &name, &name_len, &escaped) || escaped)
+    return FALSE;
+  if (_is_member_name_repeated(s, first_name, name, name_len))
+    return FALSE;
+
+  guint32 name_token = _add_token(s, JSON_INDEX_STRING, name, name_len);
+  g_array_append_val(s->index->member_names, name_token);
+
+  _skip_whitespace(s);
+  if (!_next_char_is(s, ':'))
+    return FALSE;
+  s->p++;
+  return _scan_value(s, depth);
+}
+
+static gboolean
+_scan_object(JSONIndexScanner *s, gint depth)
+{
+  if (depth > JSON_INDEX_MAX_DEPTH)
+    return FALSE;
+
+  guint32 object = _add_token(s, JSON_INDEX_OBJECT, s->p, 0);
+  guint first_name = s->index->member_names->len;
+
+  s->p++;
+  _skip_whitespace(s);
+  if (_next_char_is(s, '}'))
+    s->p++;
+  else
+    {
+      while (TRUE)
+        {
+          _skip_whitespace(s);
+          if (!_scan_member(s, first_name, depth))
+            return FALSE;
+
+          _skip_whitespace(s);
+          if (_next_char_is(s, '}'))
+            {
+              s->p++;
+              break;
+            }
+          if (!_next_char_is(s, ','))
+            return FALSE;
+          s->p++;
+        }
+    }
+
+  g_array_set_size(s->index->member_names, first_name);
+  _get_token(s, object)->next = s->index->tokens->len;
+  return TRUE;
+}
+
+static gboolean
+_scan_array(JSONIndexScanner *s, gint depth)
+{
+  if (depth > JSON_INDEX_MAX_DEPTH)
+    return FALSE;
+
+  guint32 array = _add_token(s, JSON_INDEX_ARRAY, s->p, 0);
+
+  s->p++;
+  _skip_whitespace(s);
+  if (_next_char_is(s, ']'))
+    s->p++;
+  else
+    {
+      while (TRUE)
+        {
+          const gchar *value;
+          gsize value_len;
+          gboolean escaped;
+
+          _skip_whitespace(s);
+          if (!_scan_string(s, &value, &value_len, &escaped))
+            return FALSE;
+          _get_token(s, _add_token(s, JSON_INDEX_STRING, value, value_len))->escaped = escaped;
+
+          _skip_whitespace(s);
+          if (_next_char_is(s, ']'))
+            {
+              s->p++;
+              break;
+            }
+          if (!_next_char_is(s, ','))
+            return FALSE;
+          s->p++;
+        }
+    }
+
+  _get_token(s, array)->next = s->index->tokens->len;
+  return TRUE;
+}
+
+static gboolean
+_scan_value(JSONIndexScanner *s, gint depth)
+{
+  const gchar *value;
+  gsize value_len;
+  gboolean escaped;
+
+  _skip_whitespace(s);
+  if (s->p >= s->end)
+    return FALSE;
+
+  switch (*s->p)
+    {
+    case '{':
+      return _scan_object(s, depth + 1);
+    case '[':
+      return _scan_array(s, depth + 1);
+    case '"':
+      if (!_scan_string(s, &value, &value_len, &escaped))
+        return FALSE;
+      _get_token(s, _add_token(s, JSON_INDEX_STRING, value, value_len))->escaped = escaped;
+      return TRUE;
+    case 't':
+      return _scan_literal(s, "true", 4, JSON_INDEX_TRUE);
+    case 'f':
+      return _scan_literal(s, "false", 5, JSON_INDEX_FALSE);
+    case 'n':
+      return _scan_literal(s, "null", 4, JSON_INDEX_NULL);
+    default:
+      return _scan_number(s);
+    }
+}
+
+/*
+ * Builds the index of the JSON object at the beginning of @input, trailing
+ * characters after the object are ignored.  Returns FALSE if the input is
+ * not valid JSON or if it is outside of the supported subset.
+ */
+gboolean
+json_index_build(JSONIndex *self, const gchar *input, gsize input_len)
+{
+  JSONIndexScanner s =
+  {
+    .index = self,
+    .p = input,
+    .end = input + input_len,
+  };
+
+  g_array_set_size(self->tokens, 0);
+  g_array_set_size(self->member_names, 0);
+
+  _skip_whitespace(&s);
+  if (!_next_char_is(&s, '{'))
+    return FALSE;
+  return _scan_object(&s, 1);
+}
+
+gint
+json_index_lookup_member(JSONIndex *self, guint32 object, const gchar *name)
+{
+  const JSONIndexToken *token = json_index_get_token(self, object);
+  gsize name_len = strlen(name);
+
+  g_assert(token->type == JSON_INDEX_OBJECT);
+  for (guint32 i = object + 1; i < token->next; i = json_index_skip_value(self, i + 1))
+    {
+      const JSONIndexToken *member_name = json_index_get_token(self, i);
+
+      if (member_name->value_len == name_len && memcmp(member_name->value, name, name_len) == 0)
+        return i + 1;
+    }
+  return -1;
+}
+
+void
+json_index_append_unescaped(GString *result, const JSONIndexToken *token)
+{
+  const gchar *p = token->value;
+  const gchar *end = token->value + token->value_len;
+
+  while (p < end)
+    {
+      const gchar *backslash = memchr(p, '\\', end - p);
+
+      if (!backslash)
+        {
+          g_string_append_len(result, p, end - p);
+          break;
+        }
+      g_string_append_len(result, p, backslash - p);
+
+      /* validated by the scanner, the escape sequence is always complete */
+      switch (backslash[1])
+        {
+        case 'b':
+          g_string_append_c(result, '\b');
+          break;
+        case 'f':
+          g_string_append_c(result, '\f');
+          break;
+        case 'n':
+          g_string_append_c(result, '\n');
+          break;
+        case 'r':
+          g_string_append_c(result, '\r');
+          break;
+        case 't':
+          g_string_append_c(result, '\t');
+          break;
+        default:
+          g_string_append_c(result, backslash[1]);
+          break;
+        }
+      p = backslash + 2;
+    }
+}
+
+void
+json_index_init(JSONIndex *self)
+{
+  self->tokens = g_array_sized_new(FALSE, FALSE, sizeof(JSONIndexToken), 64);
+  self->member_names = g_array_sized_new(FALSE, FALSE, sizeof(guint32), 16);
+}
+
+void
+json_index_destroy(JSONIndex *self)
+{
+  g_array_free(self->tokens, TRUE);
+  g_array_free(self->member_names, TRUE);
+}
@@ -0,0 +1,94 @@
+/*
+ * Copyright (c) 2024 One Identity LLC.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#ifndef JSON_INDEX_H_INCLUDED
+#define JSON_INDEX_H_INCLUDED
+
+#include "syslog-ng.h"
+
+/*
+ * Structural index of a JSON document
+ *
+ * The document is validated in a single pass and every value is recorded
+ * as a token pointing back into the input, so that strings and numbers can
+ * be used without copying.  Objects and arrays are followed by their
+ * members, object members are a name token followed by the value's tokens.
+ *
+ * Only the commonly used subset of JSON is accepted: the top level must be
+ * an object, strings may only contain the simple escape sequences, members
+ * names can't be escaped or repeated, arrays can only contain strings and
+ * integers must fit into 64 bits.  Anything else is rejected, callers are
+ * expected to fall back to a complete JSON parser in that case.
+ */
+
+typedef enum
+{
+  JSON_INDEX_OBJECT,
+  JSON_INDEX_ARRAY,
+  JSON_INDEX_STRING,
+  JSON_INDEX_INTEGER,
+  JSON_INDEX_DOUBLE,
+  JSON_INDEX_TRUE,
+  JSON_INDEX_FALSE,
+  JSON_INDEX_NULL,
+} JSONIndexTokenType;
+
+typedef struct _JSONIndexToken
+{
+  guint8 type;
+  gboolean escaped;
+  const gchar *value;
+  gsize value_len;
+  /* objects and arrays: the index of the first token following their members */
+  guint32 next;
+} JSONIndexToken;
+
+typedef struct _JSONIndex
+{
+  GArray *tokens;
+  GArray *member_names;
+} JSONIndex;
+
+void json_index_init(JSONIndex *self);
+void json_index_destroy(JSONIndex *self);
+gboolean json_index_build(JSONIndex *self, const gchar *input, gsize input_len);
+gint json_index_lookup_member(JSONIndex *self, guint32 object, const gchar *name);
+void json_index_append_unescaped(GString *result, const JSONIndexToken *token);
+
+static inline const JSONIndexToken *
+json_index_get_token(JSONIndex *self, guint32 index_)
+{
+  return &g_array_index(self->tokens, JSONIndexToken, index_);
+}
+
+/* the index of the token following the value at @index_, skipping its members */
+static inline guint32
+json_index_skip_value(JSONIndex *self, guint32 index_)
+{
+  const JSONIndexToken *token = json_index_get_token(self, index_);
+
+  if (token->type == JSON_INDEX_OBJECT || token->type == JSON_INDEX_ARRAY)
+    return token->next;
+  return index_ + 1;
+}
+
+#endif
@@ -24,8 +24,10 @@
 
 #include "json-parser.h"
 #include "dot-notation.h"
+#include "json-index.h"
 #include "scratch-buffers.h"
 #include "str-repr/encode.h"
+#include "parse-number.h"
 
 #include <string.h>
 #include <ctype.h>
@@ -43,6 +45,8 @@ typedef struct _JSONParser
   gchar *marker;
   gint marker_len;
   gchar *extract_prefix;
+  /* extract_prefix() as a list of member names, NULL if it needs json_extract() */
+  gchar **extract_path;
   gchar key_delimiter;
 } JSONParser;
 
@@ -72,6 +76,27 @@ json_parser_set_extract_prefix(LogParser *s, const gchar *extract_prefix)
 
   g_free(self->extract_prefix);
   self->extract_prefix = g_strdup(extract_prefix);
+
+  g_strfreev(self->extract_path);
+  self->extract_path = NULL;
+  if (!extract_prefix)
+    return;
+
+  /* only member references can be looked up in the structural index */
+  gchar **levels = g_strsplit(extract_prefix[0] == '.' ? extract_prefix + 1 : extract_prefix, ".", -1);
+  for (gint i = 0; levels[i]; i++)
+    {
+      const gchar *p = levels[i];
+
+      while (g_ascii_isprint(*p) && *p != '[' && *p != ']')
+        p++;
+      if (*p || !levels[i][0])
+        {
+          g_strfreev(levels);
+          return;
+        }
+    }
+  self->extract_path = levels;
 }
 
 void
@@ -86,7 +111,7 @@ static void
 json_parser_store_value(JSONParser *self,
                         const gchar *prefix, const gchar *obj_key,
                         GString *value, LogMessageValueType type,
-                        LogMessage *msg)
+                        const NVNumericValue *number, LogMessage *msg)
 {
   GString *key;
 
@@ -95,10 +120,10 @@ json_parser_store_value(JSONParser *self,
     {
       g_string_assign(key, prefix);
       g_string_append(key, obj_key);
-      log_msg_set_value_by_name_with_type(msg, key->str, value->str, value->len, type);
+      log_msg_set_value_by_name_with_number(msg, key->str, value->str, value->len, type, number);
     }
   else
-    log_msg_set_value_by_name_with_type(msg, obj_key, value->str, value->len, type);
+    log_msg_set_value_by_name_with_number(msg, obj_key, value->str, value->len, type, number);
 }
 
 static void
@@ -162,6 +187,28 @@ json_parser_extract_string_from_simple_json_object(JSONParser *self,
   return FALSE;
 }
 
+/* numbers are stored in binary form too, so consumers don't need to parse
+ * them again */
+static const NVNumericValue *
+json_parser_get_number_of_simple_json_object(struct json_object *jso, GString *value, LogMessageValueType type,
+                                             NVNumericValue *number)
+{
+  switch (type)
+    {
+    case LM_VT_BOOLEAN:
+      number->as_int64 = !!json_object_get_boolean(jso);
+      return number;
+    case LM_VT_INTEGER:
+      number->as_int64 = json_object_get_int64(jso);
+      return number;
+    case LM_VT_DOUBLE:
+      /* the string is rounded by "%f", the number has to match it */
+      return parse_double(value->str, &number->as_double) ? number : NULL;
+    default:
+      return NULL;
+    }
+}
+
 static gboolean
 json_parser_extract_value_from_simple_json_object(JSONParser *self,
                                                   struct json_object *jso,
@@ -171,9 +218,12 @@ json_parser_extract_value_from_simple_json_object(JSONParser *self,
   GString *value = scratch_buffers_alloc();
   LogMessageValueType type = LM_VT_STRING;
 
+  NVNumericValue number;
+
   if (!json_parser_extract_string_from_simple_json_object(self, jso, value, &type))
     return FALSE;
-  json_parser_store_value(self, prefix, obj_key, value, type, msg);
+  json_parser_store_value(self, prefix, obj_key, value, type,
+                          json_parser_get_number_of_simple_json_object(jso, value, type, &number), msg);
   return TRUE;
 }
 
@@ -221,7 +271,7 @@ json_parser_extract_values_from_complex_json_object(JSONParser *self,
             }
         }
 
-      json_parser_store_value(self, prefix, obj_key, value, type, msg);
+      json_parser_store_value(self, prefix, obj_key, value, type, NULL, msg);
       return TRUE;
     }
     default:
@@ -317,6 +367,173 @@ json_parser_extract(JSONParser *self, struct json_object *jso, LogMessage *msg)
   return FALSE;
 }
 
+/*
+ * Fast path: the subset of JSON covered by JSONIndex is extracted directly
+ * from the input buffer, without building the json-c object tree.  It
+ * produces the same name-value pairs as the json-c based code above.
+ */
+
+static void
+json_parser_extract_indexed_object(JSONParser *self, JSONIndex *index, guint32 object, GString *key,
+                                   LogMessage *msg);
+
+static void
+json_parser_extract_indexed_array(JSONParser *self, JSONIndex *index, guint32 array, GString *key,
+                                  LogMessage *msg)
+{
+  const JSONIndexToken *token = json_index_get_token(index, array);
+  GString *value = scratch_buffers_alloc();
+  GString *element_value = scratch_buffers_alloc();
+
+  for (guint32 i = array + 1; i < token->next; i++)
+    {
+      const JSONIndexToken *element = json_index_get_token(index, i);
+
+      if (i != array + 1)
+        g_string_append_c(value, ',');
+
+      if (!element->escaped)
+        {
+          str_repr_encode_append(value, element->value, element->value_len, NULL);
+          continue;
+        }
+      g_string_truncate(element_value, 0);
+      json_index_append_unescaped(element_value, element);
+      str_repr_encode_append(value, element_value->str, element_value->len, NULL);
+    }
+  log_msg_set_value_by_name_with_type(msg, key->str, value->str, value->len, LM_VT_LIST);
+}
+
+static void
+json_parser_extract_indexed_double(JSONParser *self, const JSONIndexToken *token, GString *key, LogMessage *msg)
+{
+  GString *value = scratch_buffers_alloc();
+
+  g_string_append_len(value, token->value, token->value_len);
+  g_string_printf(value, "%f", g_ascii_strtod(value->str, NULL));
+  log_msg_set_value_by_name_with_type(msg, key->str, value->str, value->len, LM_VT_DOUBLE);
+}
+
+static void
+json_parser_extract_indexed_value(JSONParser *self, JSONIndex *index, guint32 value_index, GString *key,
+                                  LogMessage *msg)
+{
+  const JSONIndexToken *token = json_index_get_token(index, value_index);
+
+  switch (token->type)
+    {
+    case JSON_INDEX_OBJECT:
+      g_string_append_c(key, self->key_delimiter);
+      json_parser_extract_indexed_object(self, index, value_index, key, msg);
+      break;
+    case JSON_INDEX_ARRAY:
+      json_parser_extract_indexed_array(self, index, value_index, key, msg);
+      break;
+    case JSON_INDEX_STRING:
+      if (token->escaped)
+        {
+          GString *value = scratch_buffers_alloc();
+
+          json_index_append_unescaped(value, token);
+          log_msg_set_value_by_name_with_type(msg, key->str, value->str, value->len, LM_VT_STRING);
+        }
+      else
+        log_msg_set_value_by_name_with_type(msg, key->str, token->value, token->value_len, LM_VT_STRING);
+      break;
+    case JSON_INDEX_INTEGER:
+      /* json-c formats the parsed integer, which normalizes -0 */
+      if (token->value_len == 2 && memcmp(token->value, "-0", 2) == 0)
+        log_msg_set_value_by_name_with_type(msg, key->str, "0", 1, LM_VT_INTEGER);
+      else
+        log_msg_set_value_by_name_with_type(msg, key->str, token->value, token->value_len, LM_VT_INTEGER);
+      break;
+    case JSON_INDEX_DOUBLE:
+      json_parser_extract_indexed_double(self, token, key, msg);
+      break;
+    case JSON_INDEX_TRUE:
+      log_msg_set_value_by_name_with_type(msg, key->str, "true", 4, LM_VT_BOOLEAN);
+      break;
+    case JSON_INDEX_FALSE:
+      log_msg_set_value_by_name_with_type(msg, key->str, "false", 5, LM_VT_BOOLEAN);
+      break;
+    case JSON_INDEX_NULL:
+      log_msg_set_value_by_name_with_type(msg, key->str, "", 0, LM_VT_NULL);
+      break;
+    default:
+      g_assert_not_reached();
+    }
+}
+
+static void
+json_parser_extract_indexed_object(JSONParser *self, JSONIndex *index, guint32 object, GString *key,
+                                   LogMessage *msg)
+{
+  const JSONIndexToken *token = json_index_get_token(index, object);
+  gsize prefix_len = key->len;
+
+  for (guint32 i = object + 1; i < token->next; i = json_index_skip_value(index, i + 1))
+    {
+      const JSONIndexToken *name = json_index_get_token(index, i);
+      ScratchBuffersMarker marker;
+
+      g_string_truncate(key, prefix_len);
+      g_string_append_len(key, name->value, name->value_len);
+
+      scratch_buffers_mark(&marker);
+      json_parser_extract_indexed_value(self, index, i + 1, key, msg);
+      scratch_buffers_reclaim_marked(marker);
+    }
+}
+
+static gboolean
+json_parser_lookup_indexed_root(JSONParser *self, JSONIndex *index, guint32 *root)
+{
+  *root = 0;
+  if (!self->extract_prefix)
+    return TRUE;
+  if (!self->extract_path)
+    return FALSE;
+
+  for (gint i = 0; self->extract_path[i]; i++)
+    {
+      gint member = json_index_lookup_member(index, *root, self->extract_path[i]);
+
+      /* missing members and non-object values are left to the json-c code path */
+      if (member < 0 || json_index_get_token(index, member)->type != JSON_INDEX_OBJECT)
+        return FALSE;
+      *root = member;
+    }
+  return TRUE;
+}
+
+static gboolean
+json_parser_process_indexed(JSONParser *self, LogMessage **pmsg, const LogPathOptions *path_options,
+                            const gchar *input, gsize input_len)
+{
+  JSONIndex index;
+  guint32 root;
+
+  json_index_init(&index);
+  if (!json_index_build(&index, input, input_len) ||
+      !json_parser_lookup_indexed_root(self, &index, &root))
+    {
+      json_index_destroy(&index);
+      return FALSE;
+    }
+
+  log_msg_make_writable(pmsg, path_options);
+
+  ScratchBuffersMarker marker;
+  GString *key = scratch_buffers_alloc_and_mark(&marker);
+
+  g_string_assign(key, self->prefix ? : "");
+  json_parser_extract_indexed_object(self, &index, root, key, *pmsg);
+  scratch_buffers_reclaim_marked(marker);
+
+  json_index_destroy(&index);
+  return TRUE;
+}
+
 #ifndef JSON_C_VERSION
 const char *
 json_tokener_error_desc(enum json_tokener_error err)
@@ -330,6 +547,7 @@ json_parser_process(LogParser *s, LogMessage **pmsg, const LogPathOptions *path_
                     gsize input_len)
 {
   JSONParser *self = (JSONParser *) s;
+  const gchar *input_end = input + input_len;
   struct json_object *jso;
   struct json_tokener *tok;
 
@@ -353,6 +571,9 @@ json_parser_process(LogParser *s, LogMessage **pmsg, const LogPathOptions *path_
         input++;
     }
 
+  if (input < input_end && json_parser_process_indexed(self, pmsg, path_options, input, input_end - input))
+    return TRUE;
+
   tok = json_tokener_new();
   jso = json_tokener_parse_ex(tok, input, input_len);
   if (tok->err != json_tokener_success || !jso)
@@ -403,6 +624,7 @@ json_parser_free(LogPipe *s)
   g_free(self->prefix);
   g_free(self->marker);
   g_free(self->extract_prefix);
+  g_strfreev(self->extract_path);
   log_parser_free_method(s);
 }
 
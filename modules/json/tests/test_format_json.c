@@ -410,6 +410,25 @@ Test(format_json, test_format_flat_json_direct)
   log_msg_unref(msg);
 }
 
+Test(format_json, test_format_flat_json_unsorted)
+{
+  assert_template_format("$(format-flat-json --unsorted a=b)", "{\"a\":\"b\"}");
+  assert_template_format("$(format-flat-json --unsorted a=b a=c)", "{\"a\":\"c\"}");
+  assert_template_format("$(format-flat-json --unsorted --scope none --key PROGRAM)",
+                         "{\"PROGRAM\":\"syslog-ng\"}");
+  assert_template_format("$(format-flat-json --unsorted --scope none --key PROGRAM PROGRAM=override)",
+                         "{\"PROGRAM\":\"override\"}");
+  assert_template_format("$(format-flat-json --unsorted --scope none --key PROGRAM --rekey PROGRAM --add-prefix p.)",
+                         "{\"p.PROGRAM\":\"syslog-ng\"}");
+  assert_template_format("$(format-flat-json --unsorted i=int32(1234) b=boolean(TRUE))",
+                         "{\"b\":true,\"i\":1234}");
+}
+
+Test(format_json, test_format_json_does_not_accept_unsorted)
+{
+  assert_template_failure("$(format-json --unsorted a=b)", "Unknown option --unsorted");
+}
+
 Test(format_json, test_format_flat_json_with_type_hints)
 {
   assert_template_format("$(format-flat-json i32=int32(1234))",
@@ -161,6 +161,52 @@ Test(json_parser, test_json_parser_validate_type_representation)
   log_pipe_unref(&json_parser->super);
 }
 
+Test(json_parser, test_json_parser_strict_json_produces_the_same_values_and_types)
+{
+  LogMessage *msg;
+  LogParser *json_parser = json_parser_new(NULL);
+
+  json_parser_set_prefix(json_parser, ".prefix.");
+  msg = parse_json_into_log_message("{\"int\": 123, \"negzero\": -0, \"booltrue\": true, \"boolfalse\": false,"
+                                    " \"double\": 1.23, \"exp\": 1e6,"
+                                    " \"object\": {\"member1\": \"foo\", \"member2\": {\"member3\": \"bar\"}},"
+                                    " \"array\": [\"1\", \"2\", \"a,b\"], \"null\": null,"
+                                    " \"escaped\": \"quote\\\" backslash\\\\ newline\\n\"}",
+                                    json_parser);
+  assert_log_message_value_and_type_by_name(msg, ".prefix.int", "123", LM_VT_INTEGER);
+  assert_log_message_value_and_type_by_name(msg, ".prefix.negzero", "0", LM_VT_INTEGER);
+  assert_log_message_value_and_type_by_name(msg, ".prefix.booltrue", "true", LM_VT_BOOLEAN);
+  assert_log_message_value_and_type_by_name(msg, ".prefix.boolfalse", "false", LM_VT_BOOLEAN);
+  assert_log_message_value_and_type_by_name(msg, ".prefix.double", "1.230000", LM_VT_DOUBLE);
+  assert_log_message_value_and_type_by_name(msg, ".prefix.exp", "1000000.000000", LM_VT_DOUBLE);
+  assert_log_message_value_and_type_by_name(msg, ".prefix.object.member1", "foo", LM_VT_STRING);
+  assert_log_message_value_and_type_by_name(msg, ".prefix.object.member2.member3", "bar", LM_VT_STRING);
+  assert_log_message_value_and_type_by_name(msg, ".prefix.array", "1,2,\"a,b\"", LM_VT_LIST);
+  assert_log_message_value_and_type_by_name(msg, ".prefix.null", "", LM_VT_NULL);
+  assert_log_message_value_and_type_by_name(msg, ".prefix.escaped", "quote\" backslash\\ newline\n", LM_VT_STRING);
+  log_msg_unref(msg);
+  log_pipe_unref(&json_parser->super);
+}
+
+Test(json_parser, test_json_parser_strict_json_outside_of_the_fast_path_is_still_parsed)
+{
+  LogMessage *msg;
+  LogParser *json_parser = json_parser_new(NULL);
+
+  msg = parse_json_into_log_message("{\"dup\": \"first\", \"dup\": \"second\", \"unicode\": \"\\u0041\","
+                                    " \"big\": 9223372036854775807, \"ints\": [1, 2]}",
+                                    json_parser);
+  assert_log_message_value_and_type_by_name(msg, "dup", "second", LM_VT_STRING);
+  assert_log_message_value_and_type_by_name(msg, "unicode", "A", LM_VT_STRING);
+  assert_log_message_value_and_type_by_name(msg, "big", "9223372036854775807", LM_VT_INTEGER);
+  assert_log_message_value_and_type_by_name(msg, "ints", "[1,2]", LM_VT_JSON);
+  log_msg_unref(msg);
+
+  assert_json_parser_fails("{\"foo\": \"bar\"", json_parser);
+  assert_json_parser_fails("{\"foo\": 01}", json_parser);
+  log_pipe_unref(&json_parser->super);
+}
+
 Test(json_parser, test_json_parser_different_type_arrays)
 {
   LogMessage *msg;
@@ -251,6 +297,23 @@ Test(json_parser, test_json_parser_extracts_subobjects_if_extract_prefix_is_spec
   log_pipe_unref(&json_parser->super);
 }
 
+Test(json_parser, test_json_parser_extracts_nested_members_if_extract_prefix_is_specified)
+{
+  LogMessage *msg;
+  LogParser *json_parser = json_parser_new(NULL);
+
+  json_parser_set_extract_prefix(json_parser, "foo.bar");
+  msg = parse_json_into_log_message("{\"foo\": {\"baz\": 1, \"bar\": {\"key\": \"value\"}}, \"other\": \"x\"}",
+                                    json_parser);
+  assert_log_message_value_and_type_by_name(msg, "key", "value", LM_VT_STRING);
+  assert_log_message_value_unset_by_name(msg, "other");
+  log_msg_unref(msg);
+
+  assert_json_parser_fails("{\"foo\": {\"bar\": \"not-an-object\"}}", json_parser);
+  assert_json_parser_fails("{\"foo\": {}}", json_parser);
+  log_pipe_unref(&json_parser->super);
+}
+
 Test(json_parser, test_json_parser_extracts_top_level_array_elements_into_matches)
 {
   LogMessage *msg;
@@ -311,6 +311,46 @@ _kafka_delivery_report_cb(rd_kafka_t *rk,
                 evt_tag_str("driver", self->super.super.super.id),
                 log_pipe_location_tag(&self->super.super.super.super));
     }
+
+  /* messages produced in batches point into the arena of their batch */
+  if (msg_opaque)
+    kafka_batch_arena_report_delivery((KafkaBatchArena *) msg_opaque, err);
+}
+
+/* upper bound of the time the delivery report thread needs to notice a deinit */
+#define KAFKA_DELIVERY_REPORT_POLL_MSEC_MIN 10
+
+static gpointer
+_delivery_report_thread(gpointer user_data)
+{
+  KafkaDestDriver *self = (KafkaDestDriver *) user_data;
+  gint timeout_ms = MAX(self->poll_timeout, KAFKA_DELIVERY_REPORT_POLL_MSEC_MIN);
+
+  while (!g_atomic_int_get(&self->delivery_reports.exit))
+    rd_kafka_poll(self->kafka, timeout_ms);
+
+  return NULL;
+}
+
+static void
+_start_delivery_report_thread(KafkaDestDriver *self)
+{
+  g_assert(!self->delivery_reports.thread);
+
+  g_atomic_int_set(&self->delivery_reports.exit, FALSE);
+  self->delivery_reports.thread = g_thread_new("kafka-dr", _delivery_report_thread, self);
+}
+
+static void
+_stop_delivery_report_thread(KafkaDestDriver *self)
+{
+  if (!self->delivery_reports.thread)
+    return;
+
+  g_atomic_int_set(&self->delivery_reports.exit, TRUE);
+  rd_kafka_yield(self->kafka);
+  g_thread_join(self->delivery_reports.thread);
+  self->delivery_reports.thread = NULL;
 }
 
 static gboolean
@@ -543,8 +583,11 @@ _destroy_kafka(LogDriver *s)
 
   if (self->topics)
     g_hash_table_unref(self->topics);
+  self->topics = NULL;
   if (self->topic)
     rd_kafka_topic_destroy(self->topic);
+  self->topic = NULL;
+  g_atomic_int_inc(&self->topics_generation);
 
   if (self->kafka)
     rd_kafka_destroy(self->kafka);
@@ -618,9 +661,18 @@ kafka_dd_init(LogPipe *s)
         }
 
     }
+  else
+    {
+      /* the client is never reopened without transactions, so the thread
+       * can keep polling it until deinit */
+      _start_delivery_report_thread(self);
+    }
 
   if (!log_threaded_dest_driver_init_method(s))
-    return FALSE;
+    {
+      _stop_delivery_report_thread(self);
+      return FALSE;
+    }
 
   if (self->message == NULL)
     {
@@ -670,6 +722,7 @@ kafka_dd_deinit(LogPipe *s)
 {
   KafkaDestDriver *self = (KafkaDestDriver *)s;
 
+  _stop_delivery_report_thread(self);
   kafka_dd_shutdown(&self->super);
   _check_for_remaining_messages(self);
 
@@ -38,6 +38,8 @@ typedef struct
   LogTemplate *topic_name;
   GHashTable *topics;
   GMutex topics_lock;
+  /* incremented whenever the topic handles are destroyed */
+  gint topics_generation;
 
   gboolean transaction_commit;
   GList *config;
@@ -49,6 +51,14 @@ typedef struct
   gint flush_timeout_on_reload;
   gint poll_timeout;
   gboolean transaction_inited;
+
+  /* serves the delivery reports unless transaction_commit is set, in
+   * which case the first worker polls the kafka client */
+  struct
+  {
+    GThread *thread;
+    gint exit;
+  } delivery_reports;
 } KafkaDestDriver;
 
 #define TOPIC_NAME_ERROR topic_name_error_quark()
@@ -27,11 +27,62 @@
 #include "str-utils.h"
 #include "timeutils/misc.h"
 #include <zlib.h>
+#include <string.h>
 
+/* attempts to enqueue a batch while the local librdkafka queue is full */
+#define KAFKA_PRODUCE_BATCH_MAX_ATTEMPTS 10
+#define KAFKA_PRODUCE_BATCH_RETRY_WAIT_MSEC 100
+
+static KafkaBatchArena *
+kafka_batch_arena_new(gsize size_hint)
+{
+  KafkaBatchArena *self = g_new0(KafkaBatchArena, 1);
+
+  self->ref_cnt = 1;
+  self->buffer = g_string_sized_new(size_hint);
+  self->result = LTR_SUCCESS;
+  return self;
+}
+
+static void
+kafka_batch_arena_ref_n(KafkaBatchArena *self, gint n)
+{
+  g_atomic_int_add(&self->ref_cnt, n);
+}
+
+/* NOTE: can be called from any thread, the last reference of a batch is
+ * usually dropped by the delivery report callback */
+void
+kafka_batch_arena_unref(KafkaBatchArena *self)
+{
+  if (g_atomic_int_dec_and_test(&self->ref_cnt))
+    {
+      /* the last reference is dropped once every message of the batch is
+       * either delivered, failed or could not be enqueued at all */
+      if (self->worker)
+        log_threaded_dest_worker_complete_batch(self->worker, self->batch_id, g_atomic_int_get(&self->result));
+
+      g_string_free(self->buffer, TRUE);
+      g_free(self);
+    }
+}
+
+void
+kafka_batch_arena_report_delivery(KafkaBatchArena *self, rd_kafka_resp_err_t err)
+{
+  if (err != RD_KAFKA_RESP_ERR_NO_ERROR)
+    g_atomic_int_set(&self->result, LTR_ERROR);
+  kafka_batch_arena_unref(self);
+}
+
+/* without transactions, delivery reports are served by the delivery
+ * report thread of the driver instead */
 static gboolean
 _is_poller_thread(KafkaDestWorker *self)
 {
-  return (self->super.worker_index == 0);
+  KafkaDestDriver *owner = (KafkaDestDriver *) self->super.owner;
+
+  return owner->transaction_commit && self->super.worker_index == 0;
 }
 
 static void
@@ -70,14 +121,67 @@ kafka_dest_worker_resolve_template_topic_name(KafkaDestWorker *self, LogMessage
   return owner->fallback_topic_name;
 }
 
+static void
+_topic_cache_clear(KafkaDestWorker *self)
+{
+  for (gint i = 0; i < self->topic_cache_len; i++)
+    g_free(self->topic_cache[i].name);
+  self->topic_cache_len = 0;
+}
+
+/* the topic handles are owned by the driver, we only cache them for the
+ * lifetime of the kafka client they belong to */
+static rd_kafka_topic_t *
+_topic_cache_lookup(KafkaDestWorker *self, const gchar *name)
+{
+  KafkaDestDriver *owner = (KafkaDestDriver *) self->super.owner;
+  gint generation = g_atomic_int_get(&owner->topics_generation);
+
+  if (self->topic_cache_generation != generation)
+    {
+      _topic_cache_clear(self);
+      self->topic_cache_generation = generation;
+    }
+
+  for (gint i = 0; i < self->topic_cache_len; i++)
+    {
+      if (strcmp(self->topic_cache[i].name, name) != 0)
+        continue;
+
+      KafkaTopicCacheEntry entry = self->topic_cache[i];
+      memmove(&self->topic_cache[1], &self->topic_cache[0], i * sizeof(entry));
+      self->topic_cache[0] = entry;
+      return entry.topic;
+    }
+  return NULL;
+}
+
+static void
+_topic_cache_insert(KafkaDestWorker *self, const gchar *name, rd_kafka_topic_t *topic)
+{
+  if (self->topic_cache_len == KAFKA_TOPIC_CACHE_SIZE)
+    g_free(self->topic_cache[--self->topic_cache_len].name);
+
+  memmove(&self->topic_cache[1], &self->topic_cache[0], self->topic_cache_len * sizeof(self->topic_cache[0]));
+  self->topic_cache[0].name = g_strdup(name);
+  self->topic_cache[0].topic = topic;
+  self->topic_cache_len++;
+}
+
 rd_kafka_topic_t *
 kafka_dest_worker_calculate_topic_from_template(KafkaDestWorker *self, LogMessage *msg)
 {
   KafkaDestDriver *owner = (KafkaDestDriver *) self->super.owner;
-  rd_kafka_topic_t *topic = kafka_dd_query_insert_topic(owner, kafka_dest_worker_resolve_template_topic_name(self, msg));
+  const gchar *name = kafka_dest_worker_resolve_template_topic_name(self, msg);
+  rd_kafka_topic_t *topic = _topic_cache_lookup(self, name);
+
+  if (topic)
+    return topic;
 
+  topic = kafka_dd_query_insert_topic(owner, name);
   g_assert(topic);
 
+  _topic_cache_insert(self, name, topic);
   return topic;
 }
 
@@ -241,6 +345,258 @@ _publish_message(KafkaDestWorker *self, LogMessage *msg)
   return TRUE;
 }
 
+static void
+_queue_message(KafkaDestWorker *self, LogMessage *msg)
+{
+  KafkaDestDriver *owner = (KafkaDestDriver *) self->super.owner;
+  LogTemplateEvalOptions options = {&owner->template_options, LTZ_SEND, self->super.seq_num, NULL, LM_VT_STRING};
+  KafkaPendingMessage pending = { 0 };
+
+  if (!self->arena)
+    self->arena = kafka_batch_arena_new(self->last_arena_size);
+
+  GString *buffer = self->arena->buffer;
+
+  pending.topic = kafka_dest_worker_calculate_topic(self, msg);
+
+  if (self->format_at_flush)
+    {
+      pending.msg = log_msg_ref(msg);
+      pending.seq_num = self->super.seq_num;
+      g_array_append_val(self->pending_messages, pending);
+      return;
+    }
+
+  pending.payload_offset = buffer->len;
+  log_template_append_format(owner->message, msg, &options, buffer);
+  pending.payload_len = buffer->len - pending.payload_offset;
+
+  if (owner->key)
+    {
+      pending.key_offset = buffer->len;
+      log_template_append_format(owner->key, msg, &options, buffer);
+      pending.key_len = buffer->len - pending.key_offset;
+    }
+
+  g_array_append_val(self->pending_messages, pending);
+  log_threaded_dest_worker_batch_bytes_add(&self->super, buffer->len - pending.payload_offset);
+}
+
+static void
+_clear_pending_message(KafkaPendingMessage *pending)
+{
+  if (pending->msg)
+    log_msg_unref(pending->msg);
+}
+
+/* formats the payloads (and the keys) of the messages queued with
+ * format_at_flush, one template at a time for the whole batch */
+static void
+_format_pending_messages(KafkaDestWorker *self, KafkaBatchArena *arena)
+{
+  KafkaDestDriver *owner = (KafkaDestDriver *) self->super.owner;
+  LogTemplateEvalOptions options = {&owner->template_options, LTZ_SEND, 0, NULL, LM_VT_STRING};
+  guint num_messages = self->pending_messages->len;
+  LogMessage **msgs = g_new(LogMessage *, num_messages);
+  gint32 *seq_nums = g_new(gint32, num_messages);
+  gsize *offsets = g_new(gsize, num_messages + 1);
+
+  for (guint i = 0; i < num_messages; i++)
+    {
+      KafkaPendingMessage *pending = &g_array_index(self->pending_messages, KafkaPendingMessage, i);
+
+      msgs[i] = pending->msg;
+      seq_nums[i] = pending->seq_num;
+    }
+
+  log_template_append_format_batch(owner->message, msgs, seq_nums, num_messages, &options, arena->buffer, offsets);
+  for (guint i = 0; i < num_messages; i++)
+    {
+      KafkaPendingMessage *pending = &g_array_index(self->pending_messages, KafkaPendingMessage, i);
+
+      pending->payload_offset = offsets[i];
+      pending->payload_len = offsets[i + 1] - offsets[i];
+    }
+
+  if (owner->key)
+    {
+      log_template_append_format_batch(owner->key, msgs, seq_nums, num_messages, &options, arena->buffer, offsets);
+      for (guint i = 0; i < num_messages; i++)
+        {
+          KafkaPendingMessage *pending = &g_array_index(self->pending_messages, KafkaPendingMessage, i);
+
+          pending->key_offset = offsets[i];
+          pending->key_len = offsets[i + 1] - offsets[i];
+        }
+    }
+
+  g_free(offsets);
+  g_free(seq_nums);
+  g_free(msgs);
+}
+
+static void
+_add_to_topic_group(GHashTable *groups, GPtrArray *group_order, KafkaBatchArena *arena,
+                    KafkaPendingMessage *pending)
+{
+  GArray *group = g_hash_table_lookup(groups, pending->topic);
+
+  if (!group)
+    {
+      group = g_array_new(FALSE, TRUE, sizeof(rd_kafka_message_t));
+      g_hash_table_insert(groups, pending->topic, group);
+      g_ptr_array_add(group_order, pending->topic);
+    }
+
+  rd_kafka_message_t rkmessage = { 0 };
+
+  rkmessage.partition = RD_KAFKA_PARTITION_UA;
+  rkmessage.payload = arena->buffer->str + pending->payload_offset;
+  rkmessage.len = pending->payload_len;
+  rkmessage.key = pending->key_len ? arena->buffer->str + pending->key_offset : NULL;
+  rkmessage.key_len = pending->key_len;
+  /* msg_opaque of the delivery report */
+  rkmessage._private = arena;
+  g_array_append_val(group, rkmessage);
+}
+
+static void
+_wait_for_queue_space(KafkaDestWorker *self)
+{
+  KafkaDestDriver *owner = (KafkaDestDriver *) self->super.owner;
+
+  /* the queue only shrinks as delivery reports are served, which is
+   * our job in the poller thread */
+  if (_is_poller_thread(self))
+    rd_kafka_poll(owner->kafka, KAFKA_PRODUCE_BATCH_RETRY_WAIT_MSEC);
+  else
+    g_usleep(KAFKA_PRODUCE_BATCH_RETRY_WAIT_MSEC * 1000);
+}
+
+/* enqueues the messages of a topic without copying them, returns FALSE if
+ * some of them could not be enqueued */
+static gboolean
+_produce_topic_group(KafkaDestWorker *self, rd_kafka_topic_t *topic, GArray *group, KafkaBatchArena *arena)
+{
+  KafkaDestDriver *owner = (KafkaDestDriver *) self->super.owner;
+  rd_kafka_message_t *rkmessages = (rd_kafka_message_t *) group->data;
+  gint remaining = group->len;
+  rd_kafka_resp_err_t err = RD_KAFKA_RESP_ERR_NO_ERROR;
+
+  for (gint attempt = 0; attempt < KAFKA_PRODUCE_BATCH_MAX_ATTEMPTS && remaining > 0; attempt++)
+    {
+      if (attempt > 0)
+        _wait_for_queue_space(self);
+
+      /* each message enqueued holds a reference until its delivery report */
+      kafka_batch_arena_ref_n(arena, remaining);
+      /* neither RD_KAFKA_MSG_F_COPY nor RD_KAFKA_MSG_F_FREE: librdkafka uses the arena directly */
+      rd_kafka_produce_batch(topic, RD_KAFKA_PARTITION_UA, 0, rkmessages, remaining);
+
+      gint failed = 0;
+      gboolean fatal = FALSE;
+      for (gint i = 0; i < remaining; i++)
+        {
+          if (rkmessages[i].err == RD_KAFKA_RESP_ERR_NO_ERROR)
+            continue;
+
+          kafka_batch_arena_unref(arena);
+          err = rkmessages[i].err;
+          if (err != RD_KAFKA_RESP_ERR__QUEUE_FULL)
+            fatal = TRUE;
+
+          rkmessages[failed] = rkmessages[i];
+          rkmessages[failed].err = RD_KAFKA_RESP_ERR_NO_ERROR;
+          failed++;
+        }
+      remaining = failed;
+      if (fatal)
+        break;
+    }
+
+  if (remaining == 0)
+    {
+      msg_debug("kafka: batch published",
+                evt_tag_str("topic", rd_kafka_topic_name(topic)),
+                evt_tag_int("batch_size", group->len),
+                evt_tag_str("driver", owner->super.super.super.id),
+                log_pipe_location_tag(&owner->super.super.super.super));
+      return TRUE;
+    }
+
+  msg_error("kafka: failed to publish message",
+            evt_tag_str("topic", rd_kafka_topic_name(topic)),
+            evt_tag_str("error", rd_kafka_err2str(err)),
+            evt_tag_str("driver", owner->super.super.super.id),
+            log_pipe_location_tag(&owner->super.super.super.super));
+  return FALSE;
+}
+
+/* enqueues the current batch, whose arena is passed over by the caller
+ *
+ * NOTE: if a part of the batch cannot be enqueued the whole batch is
+ * retried, so messages enqueued before the failure are sent again */
+static gboolean
+_produce_batch(KafkaDestWorker *self, KafkaBatchArena *arena)
+{
+  gboolean success = TRUE;
+
+  GHashTable *groups = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, (GDestroyNotify) g_array_unref);
+  GPtrArray *group_order = g_ptr_array_new();
+
+  if (self->format_at_flush)
+    _format_pending_messages(self, arena);
+
+  for (guint i = 0; i < self->pending_messages->len; i++)
+    _add_to_topic_group(groups, group_order, arena,
+                        &g_array_index(self->pending_messages, KafkaPendingMessage, i));
+
+  for (guint i = 0; i < group_order->len && success; i++)
+    {
+      rd_kafka_topic_t *topic = g_ptr_array_index(group_order, i);
+      success = _produce_topic_group(self, topic, g_hash_table_lookup(groups, topic), arena);
+    }
+
+  g_ptr_array_free(group_order, TRUE);
+  g_hash_table_unref(groups);
+
+  self->last_arena_size = arena->buffer->len;
+  g_array_set_size(self->pending_messages, 0);
+
+  return success;
+}
+
+static KafkaBatchArena *
+_steal_batch_arena(KafkaDestWorker *self)
+{
+  KafkaBatchArena *arena = self->arena;
+
+  self->arena = NULL;
+  return arena;
+}
+
+static gboolean
+_produce_batch_and_release(KafkaDestWorker *self)
+{
+  KafkaBatchArena *arena = _steal_batch_arena(self);
+
+  if (!arena)
+    return TRUE;
+
+  gboolean success = _produce_batch(self, arena);
+  kafka_batch_arena_unref(arena);
+  return success;
+}
+
+static void
+_drop_pending_messages(KafkaDestWorker *self)
+{
+  g_array_set_size(self->pending_messages, 0);
+  if (self->arena)
+    kafka_batch_arena_unref(self->arena);
+  self->arena = NULL;
+}
+
 static void
 _update_drain_timer(KafkaDestWorker *self)
 {
@@ -327,6 +683,49 @@ kafka_dest_worker_transactional_insert(LogThreadedDestWorker *s, LogMessage *msg
   return LTR_SUCCESS;
 }
 
+static LogThreadedResult
+kafka_dest_worker_batch_insert(LogThreadedDestWorker *s, LogMessage *msg)
+{
+  KafkaDestWorker *self = (KafkaDestWorker *)s;
+
+  _queue_message(self, msg);
+  return LTR_QUEUED;
+}
+
+static LogThreadedResult
+kafka_dest_worker_batch_flush(LogThreadedDestWorker *s, LogThreadedFlushMode expedite)
+{
+  KafkaDestWorker *self = (KafkaDestWorker *)s;
+
+  if (!_produce_batch_and_release(self))
+    return LTR_RETRY;
+
+  _drain_responses(self);
+  return LTR_SUCCESS;
+}
+
+/* used instead of kafka_dest_worker_batch_flush() with
+ * max-inflight-batches(), the batch is acknowledged once the delivery
+ * reports of all of its messages are received */
+static LogThreadedResult
+kafka_dest_worker_batch_flush_async(LogThreadedDestWorker *s, LogThreadedFlushMode expedite, guint32 batch_id)
+{
+  KafkaDestWorker *self = (KafkaDestWorker *)s;
+  KafkaBatchArena *arena = _steal_batch_arena(self);
+
+  if (!arena)
+    return LTR_SUCCESS;
+
+  arena->worker = s;
+  arena->batch_id = batch_id;
+  if (!_produce_batch(self, arena))
+    g_atomic_int_set(&arena->result, LTR_RETRY);
+  kafka_batch_arena_unref(arena);
+
+  _drain_responses(self);
+  return LTR_QUEUED;
+}
+
 static LogThreadedResult
 kafka_dest_worker_batch_transactional_insert(LogThreadedDestWorker *s, LogMessage *msg)
 {
@@ -341,10 +740,7 @@ kafka_dest_worker_batch_transactional_insert(LogThreadedDestWorker *s, LogMessag
         return LTR_RETRY;
     }
 
-  LogThreadedResult result = kafka_dest_worker_insert(s, msg);
-  if (result != LTR_SUCCESS)
-    return result;
-
+  _queue_message(self, msg);
   return LTR_QUEUED;
 }
 
@@ -356,6 +752,11 @@ kafka_dest_worker_transactional_flush(LogThreadedDestWorker *s, LogThreadedFlush
   if (self->super.batch_size == 0)
     return LTR_SUCCESS;
 
+  if (!_produce_batch_and_release(self))
+    return LTR_RETRY;
+
+  _drain_responses(self);
+
   LogThreadedResult result = _transaction_commit(self);
   if (result != LTR_SUCCESS)
     return result;
@@ -367,6 +768,9 @@ static void
 kafka_dest_worker_free(LogThreadedDestWorker *s)
 {
   KafkaDestWorker *self = (KafkaDestWorker *)s;
+  _drop_pending_messages(self);
+  g_array_free(self->pending_messages, TRUE);
+  _topic_cache_clear(self);
   g_string_free(self->key, TRUE);
   g_string_free(self->message, TRUE);
   g_string_free(self->topic_name_buffer, TRUE);
@@ -436,6 +840,12 @@ _set_methods(KafkaDestWorker *self)
           self->super.insert = kafka_dest_worker_transactional_insert;
         }
     }
+  else if (owner->super.batch_lines > 0)
+    {
+      self->super.insert = kafka_dest_worker_batch_insert;
+      self->super.flush = kafka_dest_worker_batch_flush;
+      self->super.flush_async = kafka_dest_worker_batch_flush_async;
+    }
   else
     {
       self->super.insert = kafka_dest_worker_insert;
@@ -458,6 +868,9 @@ kafka_dest_worker_new(LogThreadedDestDriver *o, gint worker_index)
   self->key = g_string_sized_new(0);
   self->message = g_string_sized_new(1024);
   self->topic_name_buffer = g_string_sized_new(256);
+  self->pending_messages = g_array_new(FALSE, FALSE, sizeof(KafkaPendingMessage));
+  g_array_set_clear_func(self->pending_messages, (GDestroyNotify) _clear_pending_message);
+  self->format_at_flush = ((KafkaDestDriver *) o)->super.batch_bytes <= 0;
 
   return &self->super;
 }
@@ -26,6 +26,43 @@
 #define KAFKA_DEST_WORKER_H_INCLUDED
 
 #include "logthrdest/logthrdestdrv.h"
+#include <librdkafka/rdkafka.h>
+
+#define KAFKA_TOPIC_CACHE_SIZE 16
+
+/* holds the formatted payloads and keys of a batch, librdkafka points into
+ * it until the delivery reports of all messages are served */
+typedef struct _KafkaBatchArena
+{
+  gint ref_cnt;
+  GString *buffer;
+
+  /* set if the batch was submitted using flush_async(), the batch is
+   * completed with result when the last reference is dropped */
+  LogThreadedDestWorker *worker;
+  guint32 batch_id;
+  gint result;
+} KafkaBatchArena;
+
+typedef struct _KafkaPendingMessage
+{
+  rd_kafka_topic_t *topic;
+  gsize payload_offset;
+  gsize payload_len;
+  gsize key_offset;
+  gsize key_len;
+
+  /* set until the payload and the key are formatted by the flush, see
+   * KafkaDestWorker.format_at_flush */
+  LogMessage *msg;
+  gint32 seq_num;
+} KafkaPendingMessage;
+
+typedef struct _KafkaTopicCacheEntry
+{
+  gchar *name;
+  rd_kafka_topic_t *topic;
+} KafkaTopicCacheEntry;
 
 typedef struct _KafkaDestWorker
 {
@@ -34,8 +71,25 @@ typedef struct _KafkaDestWorker
   GString *key;
   GString *message;
   GString *topic_name_buffer;
+
+  /* messages of the current batch, produced by the flush callback */
+  KafkaBatchArena *arena;
+  GArray *pending_messages;
+  gsize last_arena_size;
+  /* without batch-bytes(), the size of the formatted messages is not
+   * needed before the flush, so they are formatted there in one go */
+  gboolean format_at_flush;
+
+  /* topic handles of templated topic names, the most recently used first,
+   * invalidated when the generation of the driver's topics changes */
+  KafkaTopicCacheEntry topic_cache[KAFKA_TOPIC_CACHE_SIZE];
+  gint topic_cache_len;
+  gint topic_cache_generation;
 } KafkaDestWorker;
 
+void kafka_batch_arena_unref(KafkaBatchArena *self);
+void kafka_batch_arena_report_delivery(KafkaBatchArena *self, rd_kafka_resp_err_t err);
+
 LogThreadedDestWorker *kafka_dest_worker_new(LogThreadedDestDriver *owner, gint worker_index);
 
 #endif
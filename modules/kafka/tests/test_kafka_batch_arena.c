@@ -0,0 +1,224 @@
+/*
+ * Copyright (c) 2024 One Identity LLC.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#include <criterion/criterion.h>
+#include "libtest/cr_template.h"
+
+#include "logthrdest/logthrdestdrv.h"
+
+/* batches completed by the arenas are recorded instead of acknowledging them */
+static gint completed_batches;
+static guint32 completed_batch_id;
+static LogThreadedResult completed_batch_result;
+
+static void
+_mock_log_threaded_dest_worker_complete_batch(LogThreadedDestWorker *self, guint32 batch_id,
+                                              LogThreadedResult result)
+{
+  completed_batches++;
+  completed_batch_id = batch_id;
+  completed_batch_result = result;
+}
+
+#define log_threaded_dest_worker_complete_batch _mock_log_threaded_dest_worker_complete_batch
+#include "kafka-dest-worker.c"
+#undef log_threaded_dest_worker_complete_batch
+
+#include "apphook.h"
+
+#define TEST_BATCH_ID 42
+
+static LogDriver *driver;
+static LogThreadedDestWorker *worker;
+
+static void
+_create_worker(gboolean transaction_commit, gint batch_lines)
+{
+  kafka_dd_set_transaction_commit(driver, transaction_commit);
+  log_threaded_dest_driver_set_batch_lines(driver, batch_lines);
+  worker = kafka_dest_worker_new((LogThreadedDestDriver *) driver, 0);
+}
+
+/* an arena of an async flush, referenced by the flush and by each of its messages */
+static KafkaBatchArena *
+_create_async_arena(gint num_messages)
+{
+  KafkaBatchArena *arena = kafka_batch_arena_new(0);
+
+  _create_worker(FALSE, num_messages + 1);
+  kafka_batch_arena_ref_n(arena, num_messages);
+  arena->worker = worker;
+  arena->batch_id = TEST_BATCH_ID;
+  return arena;
+}
+
+Test(kafka_batch_arena, test_batch_is_completed_by_the_last_delivery_report)
+{
+  KafkaBatchArena *arena = _create_async_arena(2);
+
+  kafka_batch_arena_report_delivery(arena, RD_KAFKA_RESP_ERR_NO_ERROR);
+  kafka_batch_arena_unref(arena);
+  cr_assert_eq(completed_batches, 0, "the batch is completed with a delivery outstanding");
+
+  kafka_batch_arena_report_delivery(arena, RD_KAFKA_RESP_ERR_NO_ERROR);
+  cr_assert_eq(completed_batches, 1);
+  cr_assert_eq(completed_batch_id, TEST_BATCH_ID);
+  cr_assert_eq(completed_batch_result, LTR_SUCCESS);
+}
+
+Test(kafka_batch_arena, test_a_failed_delivery_fails_the_batch)
+{
+  KafkaBatchArena *arena = _create_async_arena(3);
+
+  kafka_batch_arena_report_delivery(arena, RD_KAFKA_RESP_ERR_NO_ERROR);
+  kafka_batch_arena_report_delivery(arena, RD_KAFKA_RESP_ERR__MSG_TIMED_OUT);
+  kafka_batch_arena_report_delivery(arena, RD_KAFKA_RESP_ERR_NO_ERROR);
+  cr_assert_eq(completed_batches, 0);
+
+  /* the flush drops its reference last, after enqueueing every message */
+  kafka_batch_arena_unref(arena);
+  cr_assert_eq(completed_batches, 1);
+  cr_assert_eq(completed_batch_result, LTR_ERROR);
+}
+
+Test(kafka_batch_arena, test_batch_without_deliveries_is_completed_by_the_flush)
+{
+  KafkaBatchArena *arena = _create_async_arena(0);
+
+  /* none of the messages could be enqueued */
+  g_atomic_int_set(&arena->result, LTR_RETRY);
+  kafka_batch_arena_unref(arena);
+  cr_assert_eq(completed_batches, 1);
+  cr_assert_eq(completed_batch_result, LTR_RETRY);
+}
+
+Test(kafka_batch_arena, test_batch_of_a_sync_flush_is_not_completed)
+{
+  KafkaBatchArena *arena = kafka_batch_arena_new(0);
+
+  kafka_batch_arena_ref_n(arena, 1);
+  kafka_batch_arena_unref(arena);
+  kafka_batch_arena_report_delivery(arena, RD_KAFKA_RESP_ERR__MSG_TIMED_OUT);
+  cr_assert_eq(completed_batches, 0);
+}
+
+Test(kafka_batch_arena, test_batches_are_flushed_asynchronously_without_transactions)
+{
+  _create_worker(FALSE, 10);
+
+  cr_assert_eq(worker->flush_async, kafka_dest_worker_batch_flush_async);
+  cr_assert_not(_is_poller_thread((KafkaDestWorker *) worker), "the delivery reports are polled by the worker");
+}
+
+Test(kafka_batch_arena, test_transactional_batches_are_flushed_synchronously)
+{
+  _create_worker(TRUE, 10);
+
+  cr_assert_null(worker->flush_async);
+  cr_assert(_is_poller_thread((KafkaDestWorker *) worker));
+}
+
+Test(kafka_batch_arena, test_single_messages_are_not_flushed_asynchronously)
+{
+  _create_worker(FALSE, 0);
+
+  cr_assert_null(worker->flush_async);
+}
+
+static void
+_queue_pending_message(const gchar *value, gint32 seq_num)
+{
+  KafkaDestWorker *self = (KafkaDestWorker *) worker;
+  KafkaPendingMessage pending = { 0 };
+
+  pending.msg = create_sample_message();
+  log_msg_set_value_by_name(pending.msg, "value", value, -1);
+  pending.seq_num = seq_num;
+  g_array_append_val(self->pending_messages, pending);
+}
+
+static void
+_assert_pending_message(KafkaBatchArena *arena, gint index, const gchar *payload, const gchar *key)
+{
+  KafkaDestWorker *self = (KafkaDestWorker *) worker;
+  KafkaPendingMessage *pending = &g_array_index(self->pending_messages, KafkaPendingMessage, index);
+
+  cr_assert_eq(pending->payload_len, strlen(payload), "message %d", index);
+  cr_assert_eq(memcmp(arena->buffer->str + pending->payload_offset, payload, pending->payload_len), 0,
+               "message %d", index);
+  cr_assert_eq(pending->key_len, strlen(key), "message %d", index);
+  cr_assert_eq(memcmp(arena->buffer->str + pending->key_offset, key, pending->key_len), 0, "message %d", index);
+}
+
+Test(kafka_batch_arena, test_batch_is_formatted_by_the_flush_without_batch_bytes)
+{
+  kafka_dd_set_message_ref(driver, compile_template("$SEQNUM ${value}"));
+  kafka_dd_set_key_ref(driver, compile_template("key-${value}"));
+  _create_worker(FALSE, 10);
+  cr_assert(((KafkaDestWorker *) worker)->format_at_flush);
+
+  KafkaBatchArena *arena = kafka_batch_arena_new(0);
+
+  _queue_pending_message("foo", 1);
+  _queue_pending_message("", 2);
+  _queue_pending_message("bar", 5);
+  _format_pending_messages((KafkaDestWorker *) worker, arena);
+
+  _assert_pending_message(arena, 0, "1 foo", "key-foo");
+  _assert_pending_message(arena, 1, "2 ", "key-");
+  _assert_pending_message(arena, 2, "5 bar", "key-bar");
+
+  kafka_batch_arena_unref(arena);
+}
+
+Test(kafka_batch_arena, test_batch_is_formatted_on_insert_with_batch_bytes)
+{
+  log_threaded_dest_driver_set_batch_bytes(driver, 1024 * 1024);
+  _create_worker(FALSE, 10);
+
+  cr_assert_not(((KafkaDestWorker *) worker)->format_at_flush,
+                "batch-bytes() needs the size of the formatted messages on insert");
+}
+
+static void
+setup(void)
+{
+  app_startup();
+  configuration = cfg_new_snippet();
+  driver = kafka_dd_new(configuration);
+  completed_batches = 0;
+}
+
+static void
+teardown(void)
+{
+  if (worker)
+    {
+      log_threaded_dest_worker_free(worker);
+      worker = NULL;
+    }
+  log_pipe_unref(&driver->super);
+  cfg_free(configuration);
+  app_shutdown();
+}
+
+TestSuite(kafka_batch_arena, .init = setup, .fini = teardown);
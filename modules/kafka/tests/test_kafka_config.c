@@ -73,6 +73,21 @@ Test(kafka_config, test_mandatory_options)
   log_pipe_unref(&driver->super);
 }
 
+Test(kafka_config, test_delivery_reports_are_served_by_a_thread_of_the_driver)
+{
+  LogDriver *driver = kafka_dd_new(configuration);
+  _setup_topic(driver, "default-test-topic");
+  kafka_dd_set_bootstrap_servers(driver, "test-host:9092");
+  cr_assert(kafka_dd_init(&driver->super));
+
+  KafkaDestDriver *kafka_driver = (KafkaDestDriver *) driver;
+  cr_assert_not_null(kafka_driver->delivery_reports.thread);
+
+  log_pipe_deinit(&driver->super);
+  cr_assert_null(kafka_driver->delivery_reports.thread, "the thread is not stopped by deinit");
+  log_pipe_unref(&driver->super);
+}
+
 static void
 _setup_kafka_property(LogDriver *driver, const gchar *name, const gchar *value)
 {
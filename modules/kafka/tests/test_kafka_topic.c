@@ -261,3 +261,48 @@ Test(kafka_topic, test_calculate_topic)
   log_pipe_unref(&driver->super);
   cfg_free(configuration);
 }
+
+Test(kafka_topic, test_templated_topics_are_cached_per_worker)
+{
+  configuration = cfg_new_snippet();
+  LogDriver *driver = kafka_dd_new(configuration);
+
+  kafka_dd_set_bootstrap_servers(driver, "test-server:9092");
+  _init_topic_names(driver, "$kafka_topic", "fallbackhere");
+
+  cr_assert(log_pipe_init((LogPipe *) driver));
+
+  KafkaDestDriver *kafka_driver = (KafkaDestDriver *) driver;
+
+  KafkaDestWorker *worker = (KafkaDestWorker *) kafka_dest_worker_new(&kafka_driver->super, 0);
+
+  LogMessage *msg = log_msg_new_empty();
+
+  log_msg_set_value_by_name(msg, "kafka_topic", "cachedtopic", -1);
+  rd_kafka_topic_t *topic = kafka_dest_worker_calculate_topic(worker, msg);
+  cr_assert_eq(worker->topic_cache_len, 1);
+  cr_assert_eq(kafka_dest_worker_calculate_topic(worker, msg), topic);
+  cr_assert_eq(worker->topic_cache_len, 1);
+
+  for (gint i = 0; i < KAFKA_TOPIC_CACHE_SIZE + 1; i++)
+    {
+      gchar name[32];
+
+      g_snprintf(name, sizeof(name), "topic%d", i);
+      log_msg_set_value_by_name(msg, "kafka_topic", name, -1);
+      cr_assert_str_eq(rd_kafka_topic_name(kafka_dest_worker_calculate_topic(worker, msg)), name);
+    }
+  cr_assert_eq(worker->topic_cache_len, KAFKA_TOPIC_CACHE_SIZE);
+
+  log_msg_set_value_by_name(msg, "kafka_topic", "cachedtopic", -1);
+  cr_assert_eq(kafka_dest_worker_calculate_topic(worker, msg), topic,
+               "evicted topics are looked up in the driver again");
+  cr_assert_str_eq(worker->topic_cache[0].name, "cachedtopic");
+
+  log_msg_unref(msg);
+
+  log_threaded_dest_worker_free(&worker->super);
+  log_pipe_deinit(&driver->super);
+  log_pipe_unref(&driver->super);
+  cfg_free(configuration);
+}
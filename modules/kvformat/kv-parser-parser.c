@@ -35,6 +35,7 @@ static CfgLexerKeyword kv_parser_keywords[] =
   { "value_separator",               KW_VALUE_SEPARATOR,  },
   { "pair_separator",                KW_PAIR_SEPARATOR,  },
   { "extract_stray_words_into",      KW_EXTRACT_STRAY_WORDS_INTO,  },
+  { "extract_only",                  KW_EXTRACT_ONLY,  },
   {
     "allow_pair_separator_in_value", KW_ALLOW_PAIR_SEPARATOR_OPTION,
     .kw_status = KWS_OBSOLETE,
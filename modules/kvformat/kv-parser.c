@@ -22,6 +22,7 @@
 #include "kv-parser.h"
 #include "scanner/kv-scanner/kv-scanner.h"
 #include "scratch-buffers.h"
+#include "string-list.h"
 
 gboolean
 kv_parser_is_valid_separator_character(char c)
@@ -75,6 +76,24 @@ kv_parser_set_stray_words_value_name(LogParser *s, const gchar *value_name)
   self->stray_words_value_name = g_strdup(value_name);
 }
 
+void
+kv_parser_set_extract_only(LogParser *s, GList *keys)
+{
+  KVParser *self = (KVParser *) s;
+
+  if (self->extract_only_keys)
+    g_hash_table_unref(self->extract_only_keys);
+  self->extract_only_keys = NULL;
+  string_list_free(self->extract_only);
+  self->extract_only = keys;
+  if (!keys)
+    return;
+
+  self->extract_only_keys = g_hash_table_new(g_str_hash, g_str_equal);
+  for (GList *l = keys; l; l = l->next)
+    g_hash_table_add(self->extract_only_keys, l->data);
+}
+
 static const gchar *
 _get_formatted_key_with_prefix(KVParser *self, const gchar *key, GString *formatted_key)
 {
@@ -98,6 +117,7 @@ void
 kv_parser_init_scanner_method(KVParser *self, KVScanner *kv_scanner)
 {
   kv_scanner_init(kv_scanner, self->value_separator, self->pair_separator, self->stray_words_value_name != NULL);
+  kv_scanner_set_extract_only(kv_scanner, self->extract_only_keys);
 }
 
 static gboolean
@@ -141,6 +161,7 @@ kv_parser_clone_method(KVParser *dst, KVParser *src)
   kv_parser_set_value_separator(&dst->super, src->value_separator);
   kv_parser_set_pair_separator(&dst->super, src->pair_separator);
   kv_parser_set_stray_words_value_name(&dst->super, src->stray_words_value_name);
+  kv_parser_set_extract_only(&dst->super, string_list_clone(src->extract_only));
 
   return &dst->super.super;
 }
@@ -162,6 +183,7 @@ _free(LogPipe *s)
   g_free(self->prefix);
   g_free(self->pair_separator);
   g_free(self->stray_words_value_name);
+  kv_parser_set_extract_only(&self->super, NULL);
   log_parser_free_method(s);
 }
 
@@ -35,6 +35,8 @@ struct _KVParser
   gchar *prefix;
   gchar *stray_words_value_name;
   gsize prefix_len;
+  GList *extract_only;
+  GHashTable *extract_only_keys;
   void (*init_scanner)(KVParser *self, KVScanner *kv_scanner);
 };
 
@@ -48,6 +50,7 @@ void kv_parser_set_prefix(LogParser *p, const gchar *prefix);
 void kv_parser_set_value_separator(LogParser *p, gchar value_separator);
 void kv_parser_set_pair_separator(LogParser *p, const gchar *pair_separator);
 void kv_parser_set_stray_words_value_name(LogParser *s, const gchar *value_name);
+void kv_parser_set_extract_only(LogParser *s, GList *keys);
 gboolean kv_parser_is_valid_separator_character(gchar c);
 
 void kv_parser_init_scanner_method(KVParser *self, KVScanner *kv_scanner);
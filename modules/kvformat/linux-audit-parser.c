@@ -25,6 +25,8 @@
 #include <string.h>
 #include <ctype.h>
 
+/* fields the kernel logs with audit_log_untrustedstring(), used if the
+ * record type is unknown */
 const gchar *hexcoded_fields[] =
 {
   "name",
@@ -39,6 +41,53 @@ const gchar *hexcoded_fields[] =
   NULL
 };
 
+typedef struct _LinuxAuditRecordType
+{
+  const gchar *name;
+  const gchar *id;
+  gboolean hexcoded_arguments;
+  const gchar *hexcoded_fields[4];
+} LinuxAuditRecordType;
+
+/* The fields that may be hex-encoded, per record type.  Everything else is
+ * left alone, even if it looks like a hex string (e.g. the syscall
+ * arguments a0-a3 in SYSCALL). */
+static const LinuxAuditRecordType record_types[] =
+{
+  { "SYSCALL",          "1300", FALSE, { "comm", "exe", "key", NULL } },
+  { "PATH",             "1302", FALSE, { "name", NULL } },
+  { "CONFIG_CHANGE",    "1305", FALSE, { "key", NULL } },
+  { "SOCKADDR",         "1306", FALSE, { NULL } },
+  { "CWD",              "1307", FALSE, { "cwd", NULL } },
+  { "EXECVE",           "1309", TRUE,  { NULL } },
+  { "OBJ_PID",          "1318", FALSE, { "ocomm", NULL } },
+  { "TTY",              "1319", FALSE, { "data", NULL } },
+  { "EOE",              "1320", FALSE, { NULL } },
+  { "BPRM_FCAPS",       "1321", FALSE, { NULL } },
+  { "CAPSET",           "1322", FALSE, { NULL } },
+  { "MMAP",             "1323", FALSE, { NULL } },
+  { "SECCOMP",          "1326", FALSE, { "comm", "exe", NULL } },
+  { "PROCTITLE",        "1327", FALSE, { "proctitle", NULL } },
+  { "FEATURE_CHANGE",   "1328", FALSE, { "comm", "exe", NULL } },
+  { "KERN_MODULE",      "1330", FALSE, { "name", NULL } },
+  { "AVC",              "1400", FALSE, { "comm", "name", "path", NULL } },
+  { "ANOM_PROMISCUOUS", "1700", FALSE, { "comm", "exe", NULL } },
+  { "ANOM_ABEND",       "1701", FALSE, { "comm", "exe", NULL } },
+  { "ANOM_LINK",        "1702", FALSE, { "comm", "exe", NULL } },
+};
+
+static const LinuxAuditRecordType *
+_lookup_record_type(const gchar *type)
+{
+  for (gsize i = 0; i < G_N_ELEMENTS(record_types); i++)
+    {
+      if (strcmp(record_types[i].name, type) == 0 ||
+          strcmp(record_types[i].id, type) == 0)
+        return &record_types[i];
+    }
+  return NULL;
+}
+
 static gint
 _decode_xdigit(gchar xdigit)
 {
@@ -98,29 +147,68 @@ _parse_linux_audit_hexstring(GString *decoded_value, const gchar *value, gsize l
   return TRUE;
 }
 
+/* EXECVE arguments: a0, a1, ... or a1[0], a1[1], ... for long ones, but not a1_len */
 static gboolean
-_is_field_hex_encoded(const gchar *field)
+_is_execve_argument(const gchar *field)
 {
-  gint i;
+  const gchar *p = field + 1;
 
-  if (field[0] == 'a' && isdigit(field[1]))
-    return TRUE;
+  if (field[0] != 'a' || !isdigit(*p))
+    return FALSE;
+
+  while (isdigit(*p))
+    p++;
+
+  if (*p == '[')
+    {
+      p++;
+      if (!isdigit(*p))
+        return FALSE;
+      while (isdigit(*p))
+        p++;
+      if (*p != ']')
+        return FALSE;
+      p++;
+    }
+  return *p == 0;
+}
 
-  for (i = 0; hexcoded_fields[i]; i++)
+static gboolean
+_is_field_in_list(const gchar *const *fields, const gchar *field)
+{
+  for (gint i = 0; fields[i]; i++)
     {
-      if (strcmp(hexcoded_fields[i], field) == 0)
+      if (strcmp(fields[i], field) == 0)
         return TRUE;
     }
   return FALSE;
 }
 
+static gboolean
+_is_field_hex_encoded(const LinuxAuditRecordType *record_type, const gchar *field)
+{
+  if (!record_type)
+    return _is_execve_argument(field) || _is_field_in_list(hexcoded_fields, field);
+
+  if (record_type->hexcoded_arguments && _is_execve_argument(field))
+    return TRUE;
+
+  return _is_field_in_list(record_type->hexcoded_fields, field);
+}
+
 gboolean
 parse_linux_audit_style_hexdump(KVScanner *self)
 {
+  if (strcmp(self->key->str, "type") == 0)
+    {
+      self->input_state = (gpointer) _lookup_record_type(self->value->str);
+      return FALSE;
+    }
+
   if (!self->value_was_quoted &&
       (self->value->len % 2) == 0 &&
       isxdigit(self->value->str[0]) &&
-      _is_field_hex_encoded(self->key->str))
+      _is_field_hex_encoded((const LinuxAuditRecordType *) self->input_state, self->key->str))
     {
       if (!_parse_linux_audit_hexstring(self->decoded_value, self->value->str, self->value->len))
         return FALSE;
@@ -25,6 +25,7 @@
 #include "kv-parser.h"
 #include "apphook.h"
 #include "scratch-buffers.h"
+#include "string-list.h"
 
 
 GlobalConfig *cfg;
@@ -162,3 +163,19 @@ Test(kv_parser, test_extract_stray_words)
 }
 
 TestSuite(kv_parser, .init = setup, .fini = teardown);
+
+Test(kv_parser, test_extract_only)
+{
+  LogMessage *msg;
+  const gchar *keys[] = { "src", "dst", NULL };
+
+  kv_parser_set_extract_only(kv_parser, string_array_to_list(keys));
+  kv_parser_set_prefix(kv_parser, ".fw.");
+  msg = parse_kv_into_log_message("action=accept src=10.0.0.1 proto=\"tcp udp\" dst=10.0.0.2 len=60");
+  assert_log_message_value_by_name(msg, ".fw.src", "10.0.0.1");
+  assert_log_message_value_by_name(msg, ".fw.dst", "10.0.0.2");
+  assert_log_message_value_unset_by_name(msg, ".fw.action");
+  assert_log_message_value_unset_by_name(msg, ".fw.proto");
+  assert_log_message_value_unset_by_name(msg, ".fw.len");
+  log_msg_unref(msg);
+}
@@ -122,4 +122,33 @@ Test(linux_audit_scanner, test_audit_style_hex_dump_is_not_decoded_odd, .descrip
   assert_no_more_tokens();
 }
 
+Test(linux_audit_scanner, test_audit_style_hex_dump_depends_on_record_type)
+{
+  kv_scanner_input(&kv_scanner, "type=SYSCALL a1=0a0b comm=412042 name=412042");
+  assert_next_kv_is("type", "SYSCALL");
+  assert_next_kv_is("a1", "0a0b");
+  assert_next_kv_is("comm", "A B");
+  assert_next_kv_is("name", "412042");
+  assert_no_more_tokens();
+
+  kv_scanner_input(&kv_scanner, "type=1302 name=412042 comm=412042");
+  assert_next_kv_is("type", "1302");
+  assert_next_kv_is("name", "A B");
+  assert_next_kv_is("comm", "412042");
+  assert_no_more_tokens();
+
+  kv_scanner_input(&kv_scanner, "type=EXECVE argc=2 a0=412042 a1_len=1000 a1[0]=412042");
+  assert_next_kv_is("type", "EXECVE");
+  assert_next_kv_is("argc", "2");
+  assert_next_kv_is("a0", "A B");
+  assert_next_kv_is("a1_len", "1000");
+  assert_next_kv_is("a1[0]", "A B");
+  assert_no_more_tokens();
+
+  kv_scanner_input(&kv_scanner, "type=UNKNOWN_RECORD name=412042");
+  assert_next_kv_is("type", "UNKNOWN_RECORD");
+  assert_next_kv_is("name", "A B");
+  assert_no_more_tokens();
+}
+
 TestSuite(linux_audit_scanner, .init = setup, .fini = teardown);
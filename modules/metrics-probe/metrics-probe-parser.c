@@ -35,6 +35,10 @@ static CfgLexerKeyword metrics_probe_keywords[] =
   { "labels",                      KW_LABELS },
   { "increment",                   KW_INCREMENT },
   { "level",                       KW_LEVEL },
+  { "value",                       KW_VALUE },
+  { "pre_aggregate",               KW_PRE_AGGREGATE },
+  { "max_series",                  KW_MAX_SERIES },
+  { "histogram_buckets",           KW_HISTOGRAM_BUCKETS },
   { NULL }
 };
 
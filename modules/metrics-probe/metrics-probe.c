@@ -23,9 +23,11 @@
 #include "metrics-probe.h"
 #include "label-template.h"
 #include "stats/stats-cluster-single.h"
+#include "stats/stats-histogram.h"
 #include "scratch-buffers.h"
 #include "apphook.h"
 #include "tls-support.h"
+#include "mainloop-worker.h"
 
 typedef struct _MetricsProbe
 {
@@ -35,19 +37,51 @@ typedef struct _MetricsProbe
   GList *label_templates;
   LogTemplate *increment_template;
   gint level;
+  gboolean pre_aggregate;
+  gint max_series;
+
+  /* histogram mode, enabled by histogram-buckets() */
+  LogTemplate *value_template;
+  gdouble histogram_buckets[STATS_HISTOGRAM_MAX_BUCKETS];
+  gint num_histogram_buckets;
 
   LogTemplateOptions template_options;
   ValuePairs *vp;
 } MetricsProbe;
 
+/* a counter with the increments accumulated by the current thread */
+typedef struct _MetricsProbeSeries
+{
+  StatsCluster *cluster;
+  gssize pending;
+  /* incremented since the previous flush, it is on active_series */
+  gboolean active;
+} MetricsProbeSeries;
+
+typedef struct _MetricsProbeHistogram
+{
+  StatsClusterKey key;
+  StatsHistogram histogram;
+} MetricsProbeHistogram;
+
 TLS_BLOCK_START
 {
   GHashTable *clusters;
+  GHashTable *histograms;
+  GHashTable *series;
+  GPtrArray *active_series;
+  WorkerBatchCallback flush_series_cb;
+  gboolean flush_series_cb_registered;
   GArray *label_buffers;
 }
 TLS_BLOCK_END;
 
 #define clusters __tls_deref(clusters)
+#define histograms __tls_deref(histograms)
+#define series __tls_deref(series)
+#define active_series __tls_deref(active_series)
+#define flush_series_cb __tls_deref(flush_series_cb)
+#define flush_series_cb_registered __tls_deref(flush_series_cb_registered)
 #define label_buffers __tls_deref(label_buffers)
 
 static StatsCluster *
@@ -76,6 +110,70 @@ _unregister_single_cluster_locked(StatsCluster *cluster)
   stats_unlock();
 }
 
+static void
+_series_flush(MetricsProbeSeries *self)
+{
+  if (self->pending == 0)
+    return;
+
+  stats_counter_add(stats_cluster_single_get_counter(self->cluster), self->pending);
+  self->pending = 0;
+}
+
+static void
+_series_free(MetricsProbeSeries *self)
+{
+  _series_flush(self);
+  _unregister_single_cluster_locked(self->cluster);
+  g_free(self);
+}
+
+static void
+_flush_series(gpointer user_data)
+{
+  flush_series_cb_registered = FALSE;
+
+  for (guint i = 0; i < active_series->len; i++)
+    {
+      MetricsProbeSeries *entry = g_ptr_array_index(active_series, i);
+
+      _series_flush(entry);
+      entry->active = FALSE;
+    }
+  g_ptr_array_set_size(active_series, 0);
+}
+
+static gboolean
+_is_series_idle(gpointer key, gpointer value, gpointer user_data)
+{
+  MetricsProbeSeries *entry = (MetricsProbeSeries *) value;
+
+  return !entry->active;
+}
+
+static MetricsProbeHistogram *
+_histogram_new(const StatsClusterKey *key, gint stats_level, const gdouble *bounds, gint num_bounds)
+{
+  MetricsProbeHistogram *self = g_new0(MetricsProbeHistogram, 1);
+  stats_cluster_key_clone(&self->key, key);
+
+  StatsClusterKeyBuilder *kb = stats_cluster_key_builder_new();
+  for (gsize i = 0; i < key->labels_len; i++)
+    stats_cluster_key_builder_add_label(kb, key->labels[i]);
+  stats_histogram_init_dynamic(&self->histogram, kb, key->name, stats_level, bounds, num_bounds);
+  stats_cluster_key_builder_free(kb);
+
+  return self;
+}
+
+static void
+_histogram_free(MetricsProbeHistogram *self)
+{
+  stats_histogram_deinit(&self->histogram);
+  stats_cluster_key_cloned_free(&self->key);
+  g_free(self);
+}
+
 void
 metrics_probe_set_key(LogParser *s, const gchar *key)
 {
@@ -102,6 +200,54 @@ metrics_probe_set_increment_template(LogParser *s, LogTemplate *increment_templa
   self->increment_template = log_template_ref(increment_template);
 }
 
+void
+metrics_probe_set_value_template(LogParser *s, LogTemplate *value_template)
+{
+  MetricsProbe *self = (MetricsProbe *) s;
+
+  log_template_unref(self->value_template);
+  self->value_template = log_template_ref(value_template);
+}
+
+gboolean
+metrics_probe_add_histogram_bucket(LogParser *s, gdouble bound)
+{
+  MetricsProbe *self = (MetricsProbe *) s;
+
+  if (self->num_histogram_buckets == STATS_HISTOGRAM_MAX_BUCKETS)
+    return FALSE;
+
+  if (self->num_histogram_buckets > 0 && self->histogram_buckets[self->num_histogram_buckets - 1] >= bound)
+    return FALSE;
+
+  self->histogram_buckets[self->num_histogram_buckets++] = bound;
+  return TRUE;
+}
+
+void
+metrics_probe_clear_histogram_buckets(LogParser *s)
+{
+  MetricsProbe *self = (MetricsProbe *) s;
+
+  self->num_histogram_buckets = 0;
+}
+
+void
+metrics_probe_set_pre_aggregate(LogParser *s, gboolean pre_aggregate)
+{
+  MetricsProbe *self = (MetricsProbe *) s;
+
+  self->pre_aggregate = pre_aggregate;
+}
+
+void
+metrics_probe_set_max_series(LogParser *s, gint max_series)
+{
+  MetricsProbe *self = (MetricsProbe *) s;
+
+  self->max_series = max_series;
+}
+
 void
 metrics_probe_set_level(LogParser *s, gint level)
 {
@@ -194,19 +340,89 @@ _lookup_stats_counter(MetricsProbe *self, LogMessage *msg)
   return stats_cluster_single_get_counter(cluster);
 }
 
-static const gchar *
-_format_increment_template(MetricsProbe *self, LogMessage *msg, GString *buffer)
+/*
+ * Series are per thread: the same label set has a separate series (but
+ * the same registered counter) in each thread.  When max-series() is
+ * reached, the series that were idle since the previous flush are
+ * evicted, if there are none, the increment is dropped instead of
+ * registering yet another counter.
+ */
+static MetricsProbeSeries *
+_lookup_series(MetricsProbe *self, LogMessage *msg)
+{
+  StatsClusterKey key;
+  ScratchBuffersMarker marker;
+
+  scratch_buffers_mark(&marker);
+  _calculate_stats_cluster_key(self, msg, &key);
+
+  MetricsProbeSeries *entry = g_hash_table_lookup(series, &key);
+  if (!entry)
+    {
+      if (self->max_series > 0 && g_hash_table_size(series) >= self->max_series)
+        g_hash_table_foreach_remove(series, _is_series_idle, NULL);
+
+      if (self->max_series > 0 && g_hash_table_size(series) >= self->max_series)
+        {
+          msg_debug("metrics-probe: max-series() reached, dropping increment",
+                    evt_tag_str("key", self->key),
+                    evt_tag_int("max_series", self->max_series));
+          goto exit;
+        }
+
+      StatsCluster *cluster = _register_single_cluster_locked(&key, self->level);
+      if (!cluster)
+        goto exit;
+
+      entry = g_new0(MetricsProbeSeries, 1);
+      entry->cluster = cluster;
+      g_hash_table_insert(series, &cluster->key, entry);
+    }
+
+exit:
+  scratch_buffers_reclaim_marked(marker);
+  return entry;
+}
+
+static StatsHistogram *
+_lookup_histogram(MetricsProbe *self, LogMessage *msg)
 {
-  if (log_template_is_trivial(self->increment_template))
+  StatsClusterKey key;
+  ScratchBuffersMarker marker;
+
+  scratch_buffers_mark(&marker);
+  _calculate_stats_cluster_key(self, msg, &key);
+
+  MetricsProbeHistogram *histogram = g_hash_table_lookup(histograms, &key);
+  if (!histogram)
     {
-      gssize len;
-      return log_template_get_trivial_value(self->increment_template, msg, &len);
+      histogram = _histogram_new(&key, self->level, self->histogram_buckets, self->num_histogram_buckets);
+      g_hash_table_insert(histograms, &histogram->key, histogram);
     }
 
+  scratch_buffers_reclaim_marked(marker);
+
+  return &histogram->histogram;
+}
+
+static gint64
+_evaluate_integer_template(MetricsProbe *self, LogTemplate *template, LogMessage *msg)
+{
+  ScratchBuffersMarker marker;
+  GString *buffer = scratch_buffers_alloc_and_mark(&marker);
   LogTemplateEvalOptions template_eval_options = { &self->template_options, LTZ_SEND, 0, NULL, LM_VT_STRING };
-  log_template_format(self->increment_template, msg, &template_eval_options, buffer);
+  LogTemplateTypedValue value;
+  gint64 result;
 
-  return buffer->str;
+  log_template_eval_typed(template, msg, &template_eval_options, buffer, &value);
+  if (value.type == LM_VT_INTEGER && !gn_is_nan(&value.as.number))
+    result = gn_as_int64(&value.as.number);
+  else
+    result = strtoll(value.str, NULL, 10);
+
+  scratch_buffers_reclaim_marked(marker);
+
+  return result;
 }
 
 static gssize
@@ -215,15 +431,29 @@ _calculate_increment(MetricsProbe *self, LogMessage *msg)
   if (!self->increment_template)
     return 1;
 
-  ScratchBuffersMarker marker;
-  GString *increment_buffer = scratch_buffers_alloc_and_mark(&marker);
+  return _evaluate_integer_template(self, self->increment_template, msg);
+}
 
-  const gchar *increment_str = _format_increment_template(self, msg, increment_buffer);
-  gssize increment = strtoll(increment_str, NULL, 10);
+/* increments are accumulated in the series and added to the counters at the end of the batch */
+static void
+_aggregate_increment(MetricsProbe *self, LogMessage *msg)
+{
+  MetricsProbeSeries *entry = _lookup_series(self, msg);
+  if (!entry)
+    return;
 
-  scratch_buffers_reclaim_marked(marker);
+  entry->pending += _calculate_increment(self, msg);
+  if (!entry->active)
+    {
+      entry->active = TRUE;
+      g_ptr_array_add(active_series, entry);
+    }
 
-  return increment;
+  if (!flush_series_cb_registered)
+    {
+      main_loop_worker_register_batch_callback(&flush_series_cb);
+      flush_series_cb_registered = TRUE;
+    }
 }
 
 static gboolean
@@ -238,6 +468,20 @@ _process(LogParser *s, LogMessage **pmsg, const LogPathOptions *path_options, co
   if (!stats_check_level(self->level))
     return TRUE;
 
+  if (self->num_histogram_buckets > 0)
+    {
+      StatsHistogram *histogram = _lookup_histogram(self, *pmsg);
+      stats_histogram_observe_value(histogram, _evaluate_integer_template(self, self->value_template, *pmsg));
+      return TRUE;
+    }
+
+  /* only worker threads invoke batch callbacks */
+  if (self->pre_aggregate && main_loop_worker_get_thread_index() >= 0)
+    {
+      _aggregate_increment(self, *pmsg);
+      return TRUE;
+    }
+
   StatsCounterItem *counter = _lookup_stats_counter(self, *pmsg);
   gssize increment = _calculate_increment(self, *pmsg);
   stats_counter_add(counter, increment);
@@ -257,12 +501,23 @@ _add_default_label_template(MetricsProbe *self, const gchar *label, const gchar
 static void
 _init_tls_clusters_map_thread_init_hook(gpointer user_data)
 {
-  g_assert(!clusters && !label_buffers);
+  g_assert(!clusters && !histograms && !series && !active_series && !label_buffers);
 
   clusters = g_hash_table_new_full((GHashFunc) stats_cluster_key_hash,
                                    (GEqualFunc) stats_cluster_key_equal,
                                    NULL,
                                    (GDestroyNotify) _unregister_single_cluster_locked);
+  histograms = g_hash_table_new_full((GHashFunc) stats_cluster_key_hash,
+                                     (GEqualFunc) stats_cluster_key_equal,
+                                     NULL,
+                                     (GDestroyNotify) _histogram_free);
+  series = g_hash_table_new_full((GHashFunc) stats_cluster_key_hash,
+                                 (GEqualFunc) stats_cluster_key_equal,
+                                 NULL,
+                                 (GDestroyNotify) _series_free);
+  active_series = g_ptr_array_new();
+  worker_batch_callback_init(&flush_series_cb);
+  flush_series_cb.func = _flush_series;
   label_buffers = g_array_new(FALSE, FALSE, sizeof(StatsClusterLabel));
 }
 
@@ -270,6 +525,15 @@ static void
 _deinit_tls_clusters_map_thread_init_hook(gpointer user_data)
 {
   g_hash_table_destroy(clusters);
+  g_hash_table_destroy(histograms);
+
+  if (flush_series_cb_registered)
+    {
+      iv_list_del_init(&flush_series_cb.list);
+      flush_series_cb_registered = FALSE;
+    }
+  g_hash_table_destroy(series);
+  g_ptr_array_free(active_series, TRUE);
   g_array_free(label_buffers, TRUE);
 }
 
@@ -325,6 +589,23 @@ _init(LogPipe *s)
       return FALSE;
     }
 
+  if (self->num_histogram_buckets > 0)
+    {
+      if (!self->value_template)
+        {
+          msg_error("metrics-probe: value() is mandatory when histogram-buckets() is set",
+                    log_pipe_location_tag(s));
+          return FALSE;
+        }
+
+      if (self->increment_template)
+        {
+          msg_error("metrics-probe: increment() cannot be used together with histogram-buckets()",
+                    log_pipe_location_tag(s));
+          return FALSE;
+        }
+    }
+
   self->label_templates = g_list_sort(self->label_templates, (GCompareFunc) label_template_compare);
 
   _register_global_initializers();
@@ -349,6 +630,11 @@ _clone(LogPipe *s)
 
   metrics_probe_set_increment_template(&cloned->super, self->increment_template);
   metrics_probe_set_level(&cloned->super, self->level);
+  metrics_probe_set_pre_aggregate(&cloned->super, self->pre_aggregate);
+  metrics_probe_set_max_series(&cloned->super, self->max_series);
+  metrics_probe_set_value_template(&cloned->super, self->value_template);
+  for (gint i = 0; i < self->num_histogram_buckets; i++)
+    metrics_probe_add_histogram_bucket(&cloned->super, self->histogram_buckets[i]);
   log_template_options_clone(&self->template_options, &cloned->template_options);
   cloned->vp = value_pairs_ref(self->vp);
 
@@ -363,6 +649,7 @@ _free(LogPipe *s)
   g_free(self->key);
   g_list_free_full(self->label_templates, (GDestroyNotify) label_template_free);
   log_template_unref(self->increment_template);
+  log_template_unref(self->value_template);
   log_template_options_destroy(&self->template_options);
   value_pairs_unref(self->vp);
 
@@ -33,6 +33,11 @@ void metrics_probe_set_key(LogParser *s, const gchar *key);
 void metrics_probe_add_label_template(LogParser *s, const gchar *label, LogTemplate *value_template);
 void metrics_probe_set_increment_template(LogParser *s, LogTemplate *increment_template);
 void metrics_probe_set_level(LogParser *s, gint level);
+void metrics_probe_set_pre_aggregate(LogParser *s, gboolean pre_aggregate);
+void metrics_probe_set_max_series(LogParser *s, gint max_series);
+void metrics_probe_set_value_template(LogParser *s, LogTemplate *value_template);
+gboolean metrics_probe_add_histogram_bucket(LogParser *s, gdouble bound);
+void metrics_probe_clear_histogram_buckets(LogParser *s);
 
 LogTemplateOptions *metrics_probe_get_template_options(LogParser *s);
 ValuePairs *metrics_probe_get_value_pairs(LogParser *s);
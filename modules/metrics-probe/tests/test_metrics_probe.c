@@ -24,7 +24,11 @@
 
 #include "metrics-probe.h"
 #include "apphook.h"
+#include "mainloop-worker.h"
 #include "stats/stats-cluster-single.h"
+#include "stats/stats-prometheus.h"
+
+#include <string.h>
 
 static void
 _add_label(LogParser *s, const gchar *label, const gchar *value_template_str)
@@ -419,6 +423,187 @@ Test(metrics_probe, test_metrics_probe_dynamic_labels)
   log_pipe_unref(&metrics_probe->super);
 }
 
+typedef void (*WorkerFunc)(LogParser *metrics_probe);
+
+static gpointer
+_worker_thread(gpointer user_data)
+{
+  gpointer *args = (gpointer *) user_data;
+  WorkerFunc func = args[0];
+
+  main_loop_worker_thread_start(MLW_THREADED_INPUT_WORKER);
+  func((LogParser *) args[1]);
+  main_loop_worker_thread_stop();
+
+  return NULL;
+}
+
+/* pre-aggregation only happens in worker threads, the main thread updates the counters directly */
+static void
+_run_in_worker_thread(WorkerFunc func, LogParser *metrics_probe)
+{
+  gpointer args[] = { func, metrics_probe };
+
+  main_loop_worker_allocate_thread_space(1);
+  main_loop_worker_finalize_thread_space();
+
+  GThread *thread = g_thread_new(NULL, _worker_thread, args);
+  g_thread_join(thread);
+}
+
+static void
+_process_pre_aggregated(LogParser *metrics_probe)
+{
+  StatsClusterLabel expected_labels[] = {};
+  LogMessage *msg = log_msg_new_empty();
+
+  cr_assert(log_parser_process(metrics_probe, &msg, NULL, "", -1), "Failed to apply metrics-probe");
+  cr_assert(log_parser_process(metrics_probe, &msg, NULL, "", -1), "Failed to apply metrics-probe");
+  _assert_counter_value("custom_key", expected_labels, G_N_ELEMENTS(expected_labels), 0);
+
+  main_loop_worker_invoke_batch_callbacks();
+  _assert_counter_value("custom_key", expected_labels, G_N_ELEMENTS(expected_labels), 2);
+
+  cr_assert(log_parser_process(metrics_probe, &msg, NULL, "", -1), "Failed to apply metrics-probe");
+  main_loop_worker_invoke_batch_callbacks();
+  _assert_counter_value("custom_key", expected_labels, G_N_ELEMENTS(expected_labels), 3);
+
+  /* left pending, it is flushed when the thread stops */
+  cr_assert(log_parser_process(metrics_probe, &msg, NULL, "", -1), "Failed to apply metrics-probe");
+
+  log_msg_unref(msg);
+}
+
+Test(metrics_probe, test_metrics_probe_pre_aggregate)
+{
+  LogParser *tmp_metrics_probe = metrics_probe_new(configuration);
+  metrics_probe_set_key(tmp_metrics_probe, "custom_key");
+  metrics_probe_set_pre_aggregate(tmp_metrics_probe, TRUE);
+
+  LogParser *metrics_probe = (LogParser *) log_pipe_clone(&tmp_metrics_probe->super);
+  log_pipe_unref(&tmp_metrics_probe->super);
+  cr_assert(log_pipe_init(&metrics_probe->super), "Failed to init metrics-probe");
+
+  _run_in_worker_thread(_process_pre_aggregated, metrics_probe);
+
+  StatsClusterLabel expected_labels[] = {};
+  _assert_counter_value("custom_key", expected_labels, G_N_ELEMENTS(expected_labels), 4);
+
+  log_pipe_deinit(&metrics_probe->super);
+  log_pipe_unref(&metrics_probe->super);
+}
+
+static void
+_process_with_max_series(LogParser *metrics_probe)
+{
+  StatsClusterLabel labels_1[] = { stats_cluster_label("test_label", "value_1") };
+  StatsClusterLabel labels_2[] = { stats_cluster_label("test_label", "value_2") };
+  StatsClusterLabel labels_3[] = { stats_cluster_label("test_label", "value_3") };
+  LogMessage *msg = log_msg_new_empty();
+
+  log_msg_set_value_by_name(msg, "test_field", "value_1", -1);
+  cr_assert(log_parser_process(metrics_probe, &msg, NULL, "", -1), "Failed to apply metrics-probe");
+
+  /* value_1 is still active, value_2 is dropped */
+  log_msg_set_value_by_name(msg, "test_field", "value_2", -1);
+  cr_assert(log_parser_process(metrics_probe, &msg, NULL, "", -1), "Failed to apply metrics-probe");
+  main_loop_worker_invoke_batch_callbacks();
+
+  _assert_counter_value("custom_key", labels_1, G_N_ELEMENTS(labels_1), 1);
+  cr_assert_not(_stats_cluster_exists("custom_key", labels_2, G_N_ELEMENTS(labels_2)));
+
+  /* value_1 was idle since the flush, it is evicted */
+  log_msg_set_value_by_name(msg, "test_field", "value_3", -1);
+  cr_assert(log_parser_process(metrics_probe, &msg, NULL, "", -1), "Failed to apply metrics-probe");
+  main_loop_worker_invoke_batch_callbacks();
+
+  _assert_counter_value("custom_key", labels_3, G_N_ELEMENTS(labels_3), 1);
+  _assert_counter_value("custom_key", labels_1, G_N_ELEMENTS(labels_1), 1);
+
+  log_msg_unref(msg);
+}
+
+Test(metrics_probe, test_metrics_probe_max_series_evicts_idle_series)
+{
+  LogParser *tmp_metrics_probe = metrics_probe_new(configuration);
+  metrics_probe_set_key(tmp_metrics_probe, "custom_key");
+  _add_label(tmp_metrics_probe, "test_label", "${test_field}");
+  metrics_probe_set_pre_aggregate(tmp_metrics_probe, TRUE);
+  metrics_probe_set_max_series(tmp_metrics_probe, 1);
+
+  LogParser *metrics_probe = (LogParser *) log_pipe_clone(&tmp_metrics_probe->super);
+  log_pipe_unref(&tmp_metrics_probe->super);
+  cr_assert(log_pipe_init(&metrics_probe->super), "Failed to init metrics-probe");
+
+  _run_in_worker_thread(_process_with_max_series, metrics_probe);
+
+  log_pipe_deinit(&metrics_probe->super);
+  log_pipe_unref(&metrics_probe->super);
+}
+
+static void
+_append_record(const gchar *record, gpointer user_data)
+{
+  g_string_append((GString *) user_data, record);
+}
+
+Test(metrics_probe, test_metrics_probe_histogram)
+{
+  LogParser *tmp_metrics_probe = metrics_probe_new(configuration);
+  metrics_probe_set_key(tmp_metrics_probe, "custom_size");
+  _add_label(tmp_metrics_probe, "test_label", "${test_field}");
+  LogTemplate *value_template = log_template_new(tmp_metrics_probe->super.cfg, NULL);
+  log_template_compile(value_template, "${custom_value}", NULL);
+  metrics_probe_set_value_template(tmp_metrics_probe, value_template);
+  log_template_unref(value_template);
+  cr_assert(metrics_probe_add_histogram_bucket(tmp_metrics_probe, 10));
+  cr_assert(metrics_probe_add_histogram_bucket(tmp_metrics_probe, 100));
+  cr_assert_not(metrics_probe_add_histogram_bucket(tmp_metrics_probe, 50));
+
+  LogParser *metrics_probe = (LogParser *) log_pipe_clone(&tmp_metrics_probe->super);
+  log_pipe_unref(&tmp_metrics_probe->super);
+  cr_assert(log_pipe_init(&metrics_probe->super), "Failed to init metrics-probe");
+
+  const gchar *values[] = { "5", "50", "500" };
+  for (gsize i = 0; i < G_N_ELEMENTS(values); i++)
+    {
+      LogMessage *msg = log_msg_new_empty();
+      log_msg_set_value_by_name(msg, "test_field", "test_field_value", -1);
+      log_msg_set_value_by_name(msg, "custom_value", values[i], -1);
+      cr_assert(log_parser_process(metrics_probe, &msg, NULL, "", -1), "Failed to apply metrics-probe");
+      log_msg_unref(msg);
+    }
+
+  GString *output = g_string_new("");
+  stats_generate_prometheus(_append_record, output, FALSE, NULL);
+
+  const gchar *expected_records[] =
+  {
+    "syslogng_custom_size_bucket{test_label=\"test_field_value\",le=\"10\"} 1\n",
+    "syslogng_custom_size_bucket{test_label=\"test_field_value\",le=\"100\"} 2\n",
+    "syslogng_custom_size_bucket{test_label=\"test_field_value\",le=\"+Inf\"} 3\n",
+    "syslogng_custom_size_sum{test_label=\"test_field_value\"} 555\n",
+    "syslogng_custom_size_count{test_label=\"test_field_value\"} 3\n",
+  };
+  for (gsize i = 0; i < G_N_ELEMENTS(expected_records); i++)
+    cr_assert(strstr(output->str, expected_records[i]), "missing record: %s, output: %s",
+              expected_records[i], output->str);
+
+  g_string_free(output, TRUE);
+  log_pipe_deinit(&metrics_probe->super);
+  log_pipe_unref(&metrics_probe->super);
+}
+
+Test(metrics_probe, test_metrics_probe_histogram_requires_value)
+{
+  LogParser *metrics_probe = metrics_probe_new(configuration);
+  metrics_probe_set_key(metrics_probe, "custom_size");
+  cr_assert(metrics_probe_add_histogram_bucket(metrics_probe, 10));
+
+  cr_assert_not(log_pipe_init(&metrics_probe->super));
+  log_pipe_unref(&metrics_probe->super);
+}
+
 void setup(void)
 {
   app_startup();
@@ -64,6 +64,14 @@ mqtt_dd_set_fallback_topic(LogDriver *d, const gchar *fallback_topic)
   self->fallback_topic = g_strdup(fallback_topic);
 }
 
+void
+mqtt_dd_set_max_inflight_messages(LogDriver *d, gint max_inflight_messages)
+{
+  MQTTDestinationDriver *self = (MQTTDestinationDriver *)d;
+
+  self->max_inflight_messages = max_inflight_messages;
+}
+
 void
 mqtt_dd_set_message_template_ref(LogDriver *d, LogTemplate *message)
 {
@@ -126,6 +134,7 @@ _set_default_value(MQTTDestinationDriver *self, GlobalConfig *cfg)
   log_template_compile(self->message, DEFAULT_MESSAGE_TEMPLATE, NULL);
 
   log_template_options_defaults(&self->template_options);
+  self->max_inflight_messages = 1;
 }
 
 static gboolean
@@ -171,7 +180,23 @@ _init(LogPipe *d)
       return FALSE;
     }
 
-  if (self->super.batch_lines != -1 || self->super.batch_timeout != -1)
+  if (self->max_inflight_messages > 1)
+    {
+      /* a batch is the set of publishes waited for together, it has to fit in the window */
+      if (self->super.batch_lines == -1)
+        self->super.batch_lines = self->max_inflight_messages;
+
+      if (self->super.batch_lines > self->max_inflight_messages)
+        {
+          msg_error("mqtt: batch-lines() must not be larger than max-inflight-messages()",
+                    evt_tag_int("batch_lines", self->super.batch_lines),
+                    evt_tag_int("max_inflight_messages", self->max_inflight_messages),
+                    evt_tag_str("driver", self->super.super.super.id),
+                    log_pipe_location_tag(&self->super.super.super.super));
+          return FALSE;
+        }
+    }
+  else if (self->super.batch_lines != -1 || self->super.batch_timeout != -1)
     {
       msg_error("The mqtt destination does not support the batching of messages, so none of the batching related parameters can be set (batch-timeout, batch-lines)",
                 evt_tag_str("driver", self->super.super.super.id),
@@ -36,6 +36,7 @@ typedef struct
   LogTemplateOptions template_options;
   LogTemplate *topic_name;
   gchar *fallback_topic;
+  gint max_inflight_messages;
 
   MQTTClientOptions options;
 } MQTTDestinationDriver;
@@ -54,6 +55,7 @@ LogDriver *mqtt_dd_new(GlobalConfig *cfg);
 void mqtt_dd_set_topic_template(LogDriver *d, LogTemplate *topic);
 void mqtt_dd_set_fallback_topic(LogDriver *d, const gchar *fallback_topic);
 void mqtt_dd_set_message_template_ref(LogDriver *d, LogTemplate *message);
+void mqtt_dd_set_max_inflight_messages(LogDriver *d, gint max_inflight_messages);
 
 
 gboolean mqtt_dd_validate_topic_name(const gchar *name, GError **error);
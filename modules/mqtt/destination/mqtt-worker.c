@@ -144,9 +144,46 @@ _mqtt_send(LogThreadedDestWorker *s, gchar *msg, const gchar *topic)
   if (result != LTR_SUCCESS)
     return result;
 
+  if (owner->max_inflight_messages > 1)
+    {
+      self->inflight_tokens[self->inflight_len] = token;
+      self->inflight_publish_times[self->inflight_len] = g_get_monotonic_time();
+      self->inflight_len++;
+      return LTR_QUEUED;
+    }
+
+  gint64 publish_time = g_get_monotonic_time();
   rc = MQTTClient_waitForCompletion(self->client, token, PUBLISH_TIMEOUT);
   result = _wait_result_evaluation(&self->super, rc);
 
+  if (result == LTR_SUCCESS)
+    stats_histogram_observe(&self->publish_latency, g_get_monotonic_time() - publish_time);
+
+  return result;
+}
+
+/*
+ * Wait for the delivery of every publish of the batch, in the order they
+ * were sent.  The batch is only acknowledged if all of them got through,
+ * otherwise the whole batch is rewound and sent again.
+ */
+static LogThreadedResult
+_flush(LogThreadedDestWorker *s, LogThreadedFlushMode mode)
+{
+  MQTTDestinationWorker *self = (MQTTDestinationWorker *)s;
+  LogThreadedResult result = LTR_SUCCESS;
+
+  for (gint i = 0; i < self->inflight_len; i++)
+    {
+      gint rc = MQTTClient_waitForCompletion(self->client, self->inflight_tokens[i], PUBLISH_TIMEOUT);
+      result = _wait_result_evaluation(&self->super, rc);
+      if (result != LTR_SUCCESS)
+        break;
+
+      stats_histogram_observe(&self->publish_latency, g_get_monotonic_time() - self->inflight_publish_times[i]);
+    }
+
+  self->inflight_len = 0;
   return result;
 }
 
@@ -171,6 +208,10 @@ _insert(LogThreadedDestWorker *s, LogMessage *msg)
 
   result = _mqtt_send(s, self->string_to_write->str, mqtt_dest_worker_resolve_template_topic_name(self, msg));
 
+  /* the batch is going to be rewound, the pending deliveries are not waited for */
+  if (result != LTR_QUEUED && result != LTR_SUCCESS)
+    self->inflight_len = 0;
+
   return result;
   /*
    * LTR_DROP,
@@ -194,6 +235,12 @@ _connect(LogThreadedDestWorker *s)
   MQTTClient_SSLOptions ssl_opts;
   mqtt_client_options_to_mqtt_client_connection_option(&owner->options, &conn_opts, &ssl_opts);
 
+  if (owner->max_inflight_messages > 1)
+    {
+      conn_opts.reliable = 0;
+      conn_opts.maxInflightMessages = owner->max_inflight_messages;
+    }
+
   if ((rc = MQTTClient_connect(self->client, &conn_opts)) != MQTTCLIENT_SUCCESS)
     {
       msg_error("Error connecting mqtt client",
@@ -212,6 +259,25 @@ _disconnect(LogThreadedDestWorker *s)
   MQTTDestinationWorker *self = (MQTTDestinationWorker *)s;
 
   MQTTClient_disconnect(self->client, MQTT_DISCONNECT_TIMEOUT);
+  self->inflight_len = 0;
+}
+
+static void
+_register_stats(MQTTDestinationWorker *self)
+{
+  LogThreadedDestDriver *owner = self->super.owner;
+  gint level = log_pipe_is_internal(&owner->super.super.super) ? STATS_LEVEL3 : STATS_LEVEL2;
+
+  StatsClusterKeyBuilder *kb = stats_cluster_key_builder_new();
+  stats_cluster_key_builder_add_label(kb, stats_cluster_label("id", owner->super.super.id ? : ""));
+  owner->format_stats_key(owner, kb);
+
+  gchar worker_index_str[8];
+  g_snprintf(worker_index_str, sizeof(worker_index_str), "%d", self->super.worker_index);
+  stats_cluster_key_builder_add_label(kb, stats_cluster_label("worker", worker_index_str));
+
+  stats_histogram_init(&self->publish_latency, kb, "output_mqtt_publish_latency_seconds", level);
+  stats_cluster_key_builder_free(kb);
 }
 
 static gboolean
@@ -234,6 +300,15 @@ _init(LogThreadedDestWorker *s)
       return FALSE;
     }
 
+  if (owner->max_inflight_messages > 1)
+    {
+      self->inflight_tokens = g_new0(MQTTClient_deliveryToken, owner->max_inflight_messages);
+      self->inflight_publish_times = g_new0(gint64, owner->max_inflight_messages);
+    }
+  self->inflight_len = 0;
+
+  _register_stats(self);
+
   return log_threaded_dest_worker_init_method(s);
 }
 
@@ -244,6 +319,10 @@ _deinit(LogThreadedDestWorker *s)
 
   MQTTClient_destroy(&self->client);
 
+  stats_histogram_deinit(&self->publish_latency);
+  g_clear_pointer(&self->inflight_tokens, g_free);
+  g_clear_pointer(&self->inflight_publish_times, g_free);
+
   log_threaded_dest_worker_deinit_method(s);
 }
 
@@ -271,6 +350,7 @@ mqtt_dw_new(LogThreadedDestDriver *o, gint worker_index)
   self->super.init = _init;
   self->super.deinit = _deinit;
   self->super.insert = _insert;
+  self->super.flush = _flush;
   self->super.free_fn = _free;
   self->super.connect = _connect;
   self->super.disconnect = _disconnect;
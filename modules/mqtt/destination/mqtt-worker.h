@@ -25,6 +25,7 @@
 
 #include "logthrdest/logthrdestdrv.h"
 #include "thread-utils.h"
+#include "stats/stats-histogram.h"
 
 #include <MQTTClient.h>
 
@@ -36,6 +37,13 @@ typedef struct _MQTTDestinationWorker
 
   GString *string_to_write;
   GString *topic_name_buffer;
+
+  /* publishes of the current batch whose delivery is not confirmed yet */
+  MQTTClient_deliveryToken *inflight_tokens;
+  gint64 *inflight_publish_times;
+  gint inflight_len;
+
+  StatsHistogram publish_latency;
 } MQTTDestinationWorker;
 
 LogThreadedDestWorker *mqtt_dw_new(LogThreadedDestDriver *o, gint worker_index);
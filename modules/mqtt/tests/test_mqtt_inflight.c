@@ -0,0 +1,276 @@
+/*
+ * Copyright (c) 2024 One Identity LLC.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#include <criterion/criterion.h>
+#include "libtest/cr_template.h"
+#include "libtest/grab-logging.h"
+
+#include <MQTTClient.h>
+
+/*
+ * No broker is involved: the client calls of the worker are replaced with
+ * the mocks below.  Every publish gets the next delivery token, and the
+ * tokens waited for are recorded.
+ */
+
+static GPtrArray *published;
+static GArray *waited_tokens;
+static MQTTClient_deliveryToken last_token;
+static gint publish_rc;
+static MQTTClient_deliveryToken failing_token;
+
+static int
+_mock_MQTTClient_create(MQTTClient *handle, const char *server_uri, const char *client_id,
+                        int persistence_type, void *persistence_context)
+{
+  *handle = (MQTTClient) GINT_TO_POINTER(1);
+  return MQTTCLIENT_SUCCESS;
+}
+
+static void
+_mock_MQTTClient_destroy(MQTTClient *handle)
+{
+  *handle = NULL;
+}
+
+static int
+_mock_MQTTClient_publishMessage(MQTTClient handle, const char *topic, MQTTClient_message *msg,
+                                MQTTClient_deliveryToken *token)
+{
+  if (publish_rc != MQTTCLIENT_SUCCESS)
+    return publish_rc;
+
+  g_ptr_array_add(published, g_strdup_printf("%s:%.*s", topic, msg->payloadlen, (const gchar *) msg->payload));
+  *token = ++last_token;
+  return MQTTCLIENT_SUCCESS;
+}
+
+static int
+_mock_MQTTClient_waitForCompletion(MQTTClient handle, MQTTClient_deliveryToken token, unsigned long timeout)
+{
+  g_array_append_val(waited_tokens, token);
+
+  if (token == failing_token)
+    return MQTTCLIENT_FAILURE;
+  return MQTTCLIENT_SUCCESS;
+}
+
+#define MQTTClient_create _mock_MQTTClient_create
+#define MQTTClient_destroy _mock_MQTTClient_destroy
+#define MQTTClient_publishMessage _mock_MQTTClient_publishMessage
+#define MQTTClient_waitForCompletion _mock_MQTTClient_waitForCompletion
+#include "mqtt-worker.c"
+#undef MQTTClient_create
+#undef MQTTClient_destroy
+#undef MQTTClient_publishMessage
+#undef MQTTClient_waitForCompletion
+
+#include "apphook.h"
+
+static LogDriver *driver;
+static MQTTDestinationWorker *worker;
+
+static LogDriver *
+_create_driver(gint max_inflight_messages)
+{
+  LogDriver *d = mqtt_dd_new(configuration);
+
+  mqtt_dd_set_topic_template(d, compile_template("test/topic"));
+  mqtt_dd_set_message_template_ref(d, compile_template("$MSG"));
+  mqtt_dd_set_max_inflight_messages(d, max_inflight_messages);
+  mqtt_client_options_set_qos(mqtt_dd_get_options(d), 1);
+  return d;
+}
+
+static void
+_setup_worker(gint max_inflight_messages)
+{
+  driver = _create_driver(max_inflight_messages);
+  worker = (MQTTDestinationWorker *) mqtt_dw_new((LogThreadedDestDriver *) driver, 0);
+  cr_assert(log_threaded_dest_worker_init(&worker->super));
+}
+
+static LogThreadedResult
+_insert(gint seq)
+{
+  LogMessage *msg = log_msg_new_empty();
+  gchar text[16];
+
+  g_snprintf(text, sizeof(text), "m%d", seq);
+  log_msg_set_value(msg, LM_V_MESSAGE, text, -1);
+
+  LogThreadedResult result = log_threaded_dest_worker_insert(&worker->super, msg);
+  log_msg_unref(msg);
+  return result;
+}
+
+static LogThreadedResult
+_flush(void)
+{
+  return log_threaded_dest_worker_flush(&worker->super, LTF_FLUSH_NORMAL);
+}
+
+static void
+_assert_waited_tokens(const MQTTClient_deliveryToken *expected, guint n)
+{
+  cr_assert_eq(waited_tokens->len, n, "unexpected number of waits: %u, expected: %u", waited_tokens->len, n);
+  for (guint i = 0; i < n; i++)
+    cr_assert_eq(g_array_index(waited_tokens, MQTTClient_deliveryToken, i), expected[i],
+                 "delivery #%u was waited for out of order", i);
+}
+
+Test(mqtt_inflight, test_publishes_of_a_batch_are_waited_for_at_flush_in_order)
+{
+  _setup_worker(4);
+
+  for (gint i = 0; i < 4; i++)
+    cr_assert_eq(_insert(i), LTR_QUEUED);
+
+  cr_assert_eq(published->len, 4, "messages are not published from insert()");
+  cr_assert_str_eq(g_ptr_array_index(published, 0), "test/topic:m0");
+  cr_assert_str_eq(g_ptr_array_index(published, 3), "test/topic:m3");
+  cr_assert_eq(waited_tokens->len, 0, "deliveries are waited for before the flush");
+  cr_assert_eq(worker->inflight_len, 4);
+
+  cr_assert_eq(_flush(), LTR_SUCCESS);
+  _assert_waited_tokens((MQTTClient_deliveryToken[]) { 1, 2, 3, 4 }, 4);
+  cr_assert_eq(worker->inflight_len, 0);
+
+  /* nothing is outstanding */
+  cr_assert_eq(_flush(), LTR_SUCCESS);
+  cr_assert_eq(waited_tokens->len, 4);
+}
+
+Test(mqtt_inflight, test_failed_delivery_fails_the_batch_and_resets_the_window)
+{
+  _setup_worker(4);
+  failing_token = 2;
+
+  for (gint i = 0; i < 3; i++)
+    cr_assert_eq(_insert(i), LTR_QUEUED);
+
+  start_grabbing_messages();
+  cr_assert_eq(_flush(), LTR_ERROR);
+  assert_grabbed_log_contains("Error while waiting the response!");
+  stop_grabbing_messages();
+
+  /* the batch is rewound as a whole, the rest of the deliveries are not waited for */
+  _assert_waited_tokens((MQTTClient_deliveryToken[]) { 1, 2 }, 2);
+  cr_assert_eq(worker->inflight_len, 0);
+
+  /* the resent batch fills the window from its start */
+  for (gint i = 0; i < 3; i++)
+    cr_assert_eq(_insert(i), LTR_QUEUED);
+  cr_assert_eq(worker->inflight_len, 3);
+  cr_assert_eq(_flush(), LTR_SUCCESS);
+  _assert_waited_tokens((MQTTClient_deliveryToken[]) { 1, 2, 4, 5, 6 }, 5);
+}
+
+Test(mqtt_inflight, test_failed_publish_drops_the_pending_deliveries)
+{
+  _setup_worker(4);
+
+  cr_assert_eq(_insert(0), LTR_QUEUED);
+  cr_assert_eq(_insert(1), LTR_QUEUED);
+
+  publish_rc = MQTTCLIENT_DISCONNECTED;
+  start_grabbing_messages();
+  cr_assert_eq(_insert(2), LTR_NOT_CONNECTED);
+  stop_grabbing_messages();
+  cr_assert_eq(worker->inflight_len, 0);
+
+  publish_rc = MQTTCLIENT_SUCCESS;
+  cr_assert_eq(_flush(), LTR_SUCCESS);
+  cr_assert_eq(waited_tokens->len, 0, "deliveries of a rewound batch are waited for");
+}
+
+Test(mqtt_inflight, test_window_of_one_waits_for_every_publish)
+{
+  _setup_worker(1);
+
+  cr_assert_eq(_insert(0), LTR_SUCCESS);
+  _assert_waited_tokens((MQTTClient_deliveryToken[]) { 1 }, 1);
+  cr_assert_eq(_insert(1), LTR_SUCCESS);
+  _assert_waited_tokens((MQTTClient_deliveryToken[]) { 1, 2 }, 2);
+
+  cr_assert_eq(worker->inflight_len, 0);
+  cr_assert_eq(_flush(), LTR_SUCCESS);
+  cr_assert_eq(waited_tokens->len, 2);
+}
+
+Test(mqtt_inflight, test_batch_lines_larger_than_the_window_is_rejected)
+{
+  driver = _create_driver(8);
+  log_threaded_dest_driver_set_batch_lines(driver, 16);
+
+  start_grabbing_messages();
+  cr_assert_not(log_pipe_init(&driver->super));
+  assert_grabbed_log_contains("batch-lines() must not be larger than max-inflight-messages()");
+  stop_grabbing_messages();
+}
+
+Test(mqtt_inflight, test_batching_stays_rejected_without_a_window)
+{
+  driver = _create_driver(1);
+  log_threaded_dest_driver_set_batch_lines(driver, 16);
+
+  start_grabbing_messages();
+  cr_assert_not(log_pipe_init(&driver->super));
+  assert_grabbed_log_contains("The mqtt destination does not support the batching of messages");
+  stop_grabbing_messages();
+}
+
+static void
+setup(void)
+{
+  app_startup();
+  configuration = cfg_new_snippet();
+
+  published = g_ptr_array_new_with_free_func(g_free);
+  waited_tokens = g_array_new(FALSE, FALSE, sizeof(MQTTClient_deliveryToken));
+  last_token = 0;
+  publish_rc = MQTTCLIENT_SUCCESS;
+  failing_token = -1;
+}
+
+static void
+teardown(void)
+{
+  if (worker)
+    {
+      log_threaded_dest_worker_deinit(&worker->super);
+      log_threaded_dest_worker_free(&worker->super);
+      worker = NULL;
+    }
+  if (driver)
+    {
+      log_pipe_unref(&driver->super);
+      driver = NULL;
+    }
+
+  g_ptr_array_free(published, TRUE);
+  g_array_free(waited_tokens, TRUE);
+  cfg_free(configuration);
+  app_shutdown();
+}
+
+TestSuite(mqtt_inflight, .init = setup, .fini = teardown);
@@ -106,3 +106,23 @@ class LogDestination(LogDestination):
             int: one value from the LogDestinationResult enum
         """
         raise NotImplementedError
+
+    # A destination may implement send_batch(self, msgs) instead of send().
+    # In that case messages are collected without taking the GIL and the
+    # whole batch (see batch-lines() and batch-timeout(), batch-lines()
+    # defaults to 100) is passed to send_batch() as a list of LogMessage
+    # objects in a single call.  flush() is not invoked in this mode.
+    #
+    # send_batch() returns either a single LogDestinationResult value
+    # (or bool) that applies to the whole batch, or a list containing one
+    # result per message.  With per-message results, the messages are
+    # acknowledged (SUCCESS) or dropped (DROP) in order, until the first
+    # one that needs to be retried: that result decides the fate of that
+    # message and all subsequent ones, which are sent again later.
+    # QUEUED is not a valid result here.
+    #
+    # With workers(N), every worker thread has its own instance of the
+    # class (the first one being the instance syslog-ng creates for the
+    # driver), init() and deinit() are called on each of them.  Workers
+    # only run Python code in parallel on free-threaded Python builds, but
+    # they overlap whenever the GIL is released, e.g. during network I/O.
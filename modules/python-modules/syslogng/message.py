@@ -60,3 +60,9 @@ except ImportError:
 
         def set_bookmark(self, bookmark):
             self.bookmark = bookmark
+
+        @staticmethod
+        def handle(key):
+            if isinstance(key, str):
+                key = key.encode('utf8')
+            return key
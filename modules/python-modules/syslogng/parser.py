@@ -54,6 +54,12 @@ class LogParser(LogParser):
     def parse(self, msg):
         """This method is called to 'parse' the message
 
+        If the condition() option of the python() parser is set, only
+        messages matching the filter expression are passed to this method,
+        the rest pass through the parser unchanged.  Name-value pairs
+        accessed for every message can be resolved in advance using
+        LogMessage.handle("name") and the result used as the key.
+
         Args:
             msg: LogMessage
                 is a syslog-ng message that allows dict-like access to
@@ -147,6 +147,27 @@ class LogSource(LogSource):
         """
         super().post_message(msg)
 
+    def post_batch(self, msgs):
+        """Post several messages at once
+
+        Equivalent to calling post_message() for each message, but the GIL
+        is released only once and the input batch is closed only once,
+        which is considerably cheaper for sources producing messages in
+        bulk (e.g.  the result of a single HTTP API call).
+
+        In non-blocking mode, messages are posted as long as there is room
+        in the output window, suspend() is invoked when it is full.
+
+        Arguments:
+            msgs: list of LogMessage
+                the log messages to be posted, in order
+
+        Returns:
+            int: the number of messages posted, in non-blocking mode the
+            rest has to be posted again after wakeup()
+        """
+        return super().post_batch(msgs)
+
     def request_exit(self):
         """Request the main loop to exit
 
@@ -220,6 +241,12 @@ class LogFetcher(LogFetcher):
                 status code and a message instance.  Possible status codes
                 are defined as members in the LogFetcher class or as values
                 in the LogFetchrResult enum.
+
+                Instead of a single message, a list of messages can also be
+                returned with SUCCESS.  These are posted one by one, as
+                flow control permits, and fetch() is only called again
+                once all of them were posted.  An empty list is treated as
+                NO_DATA.
         """
         raise NotImplementedError
 
@@ -37,6 +37,8 @@
 #include "messages.h"
 #include "python-persist.h"
 
+#define PYTHON_DEST_DEFAULT_BATCH_LINES 100
+
 typedef struct
 {
   LogThreadedDestDriver super;
@@ -50,15 +52,34 @@ typedef struct
   {
     PyObject *class;
     PyObject *instance;
-    PyObject *is_opened;
-    PyObject *open;
     PyObject *send;
-    PyObject *flush;
+    PyObject *send_batch;
     PyObject *generate_persist_name;
     GPtrArray *_refs_to_clean;
   } py;
 } PythonDestDriver;
 
+/* The first worker uses the instance of the driver, every additional
+ * worker instantiates the Python class for itself, so workers do not share
+ * connections or any other state kept in the object. */
+typedef struct
+{
+  LogThreadedDestWorker super;
+
+  /* messages of the current batch, only used if send_batch() is implemented */
+  GPtrArray *batch;
+
+  struct
+  {
+    PyObject *instance;
+    PyObject *is_opened;
+    PyObject *open;
+    PyObject *send;
+    PyObject *send_batch;
+    PyObject *flush;
+  } py;
+} PythonDestWorker;
+
 typedef struct _PyLogDestination
 {
   PyObject_HEAD
@@ -133,36 +154,52 @@ python_dd_format_persist_name(const LogPipe *s)
   return python_format_persist_name(s, "python", &options);
 }
 
+static PythonDestDriver *
+_dw_get_owner(PythonDestWorker *self)
+{
+  return (PythonDestDriver *) self->super.owner;
+}
+
+static PyObject *
+_dw_py_invoke_function(PythonDestWorker *self, PyObject *func, PyObject *arg)
+{
+  PythonDestDriver *owner = _dw_get_owner(self);
+
+  return _py_invoke_function(func, arg, owner->binding.class, owner->super.super.super.id);
+}
+
 static gboolean
-_dd_py_invoke_bool_function(PythonDestDriver *self, PyObject *func, PyObject *arg)
+_dw_py_invoke_bool_function(PythonDestWorker *self, PyObject *func, PyObject *arg)
 {
-  return _py_invoke_bool_function(func, arg, self->binding.class, self->super.super.super.id);
+  PythonDestDriver *owner = _dw_get_owner(self);
+
+  return _py_invoke_bool_function(func, arg, owner->binding.class, owner->super.super.super.id);
 }
 
 static void
-_dd_py_invoke_void_method_by_name(PythonDestDriver *self, const gchar *method_name)
+_dd_py_invoke_void_method_by_name(PythonDestDriver *self, PyObject *instance, const gchar *method_name)
 {
-  _py_invoke_void_method_by_name(self->py.instance, method_name, self->binding.class, self->super.super.super.id);
+  _py_invoke_void_method_by_name(instance, method_name, self->binding.class, self->super.super.super.id);
 }
 
 static gboolean
-_dd_py_invoke_bool_method_by_name_with_options(PythonDestDriver *self, const gchar *method_name)
+_dd_py_invoke_bool_method_by_name_with_options(PythonDestDriver *self, PyObject *instance, const gchar *method_name)
 {
-  return _py_invoke_bool_method_by_name_with_options(self->py.instance, method_name, self->binding.options,
+  return _py_invoke_bool_method_by_name_with_options(instance, method_name, self->binding.options,
                                                      self->binding.class, self->super.super.super.id);
 }
 
 static gboolean
-_py_invoke_is_opened(PythonDestDriver *self)
+_py_invoke_is_opened(PythonDestWorker *self)
 {
   if (!self->py.is_opened)
     return TRUE;
 
-  return _dd_py_invoke_bool_function(self, self->py.is_opened, NULL);
+  return _dw_py_invoke_bool_function(self, self->py.is_opened, NULL);
 }
 
 static gboolean
-_py_invoke_open(PythonDestDriver *self)
+_py_invoke_open(PythonDestWorker *self)
 {
   if (!self->py.open)
     return TRUE;
@@ -170,14 +207,14 @@ _py_invoke_open(PythonDestDriver *self)
   PyObject *ret;
   gboolean result = FALSE;
 
-  ret = _py_invoke_function(self->py.open, NULL, self->binding.class, self->super.super.super.id);
+  ret = _dw_py_invoke_function(self, self->py.open, NULL);
   if (ret)
     {
       if (ret == Py_None)
         {
           msg_warning_once("python-dest: Since " VERSION_3_25 ", the return value of the open() method "
                            "is used as success/failure indicator. Please use return True or return False explicitly",
-                           evt_tag_str("class", self->binding.class));
+                           evt_tag_str("class", _dw_get_owner(self)->binding.class));
           result = TRUE;
         }
       else
@@ -197,9 +234,9 @@ _py_invoke_open(PythonDestDriver *self)
 }
 
 static void
-_py_invoke_close(PythonDestDriver *self)
+_py_invoke_close(PythonDestWorker *self)
 {
-  _dd_py_invoke_void_method_by_name(self, "close");
+  _dd_py_invoke_void_method_by_name(_dw_get_owner(self), self->py.instance, "close");
 }
 
 static LogThreadedResult
@@ -242,12 +279,12 @@ pyobject_to_worker_insert_result(PyObject *obj)
 }
 
 static LogThreadedResult
-_py_invoke_flush(PythonDestDriver *self)
+_py_invoke_flush(PythonDestWorker *self)
 {
   if (!self->py.flush)
     return LTR_SUCCESS;
 
-  PyObject *ret = _py_invoke_function(self->py.flush, NULL, self->binding.class, self->super.super.super.id);
+  PyObject *ret = _dw_py_invoke_function(self, self->py.flush, NULL);
   if (!ret)
     return LTR_ERROR;
 
@@ -257,10 +294,10 @@ _py_invoke_flush(PythonDestDriver *self)
 }
 
 static LogThreadedResult
-_py_invoke_send(PythonDestDriver *self, PyObject *dict)
+_py_invoke_send(PythonDestWorker *self, PyObject *dict)
 {
   PyObject *ret;
-  ret = _py_invoke_function(self->py.send, dict, self->binding.class, self->super.super.super.id);
+  ret = _dw_py_invoke_function(self, self->py.send, dict);
 
   if (!ret)
     return LTR_ERROR;
@@ -271,15 +308,15 @@ _py_invoke_send(PythonDestDriver *self, PyObject *dict)
 }
 
 static gboolean
-_py_invoke_init(PythonDestDriver *self)
+_py_invoke_init(PythonDestDriver *self, PyObject *instance)
 {
-  return _dd_py_invoke_bool_method_by_name_with_options(self, "init");
+  return _dd_py_invoke_bool_method_by_name_with_options(self, instance, "init");
 }
 
 static void
-_py_invoke_deinit(PythonDestDriver *self)
+_py_invoke_deinit(PythonDestDriver *self, PyObject *instance)
 {
-  _dd_py_invoke_void_method_by_name(self, "deinit");
+  _dd_py_invoke_void_method_by_name(self, instance, "deinit");
 }
 
 static void
@@ -317,6 +354,24 @@ py_get_persist_name(PythonDestDriver *self)
   return py_string_from_string(python_dd_format_persist_name(&self->super.super.super.super), -1);
 }
 
+static PyObject *
+_py_instantiate_class(PythonDestDriver *self)
+{
+  PyObject *instance = _py_invoke_function(self->py.class, NULL, self->binding.class, self->super.super.super.id);
+  if (!instance)
+    {
+      gchar buf1[256], buf2[256];
+
+      msg_error("python-dest: Error instantiating Python driver class",
+                evt_tag_str("driver", self->super.super.super.id),
+                evt_tag_str("class", self->binding.class),
+                evt_tag_str("class-repr", _py_object_repr(self->py.class, buf1, sizeof(buf1))),
+                evt_tag_str("exception", _py_format_exception_text(buf2, sizeof(buf2))));
+      _py_finish_exception_handling();
+    }
+  return instance;
+}
+
 static gboolean
 _py_init_bindings(PythonDestDriver *self)
 {
@@ -343,23 +398,9 @@ _py_init_bindings(PythonDestDriver *self)
   PyObject_SetAttrString(self->py.class, "template_options", py_log_template_options);
   Py_DECREF(py_log_template_options);
 
-  PyObject *py_seqnum = py_integer_pointer_new(&self->super.worker.instance.seq_num);
-  PyObject_SetAttrString(self->py.class, "seqnum", py_seqnum);
-  Py_DECREF(py_seqnum);
-
-  self->py.instance = _py_invoke_function(self->py.class, NULL, self->binding.class, self->super.super.super.id);
+  self->py.instance = _py_instantiate_class(self);
   if (!self->py.instance)
-    {
-      gchar buf1[256], buf2[256];
-
-      msg_error("python-dest: Error instantiating Python driver class",
-                evt_tag_str("driver", self->super.super.super.id),
-                evt_tag_str("class", self->binding.class),
-                evt_tag_str("class-repr", _py_object_repr(self->py.class, buf1, sizeof(buf1))),
-                evt_tag_str("exception", _py_format_exception_text(buf2, sizeof(buf2))));
-      _py_finish_exception_handling();
-      return FALSE;
-    }
+    return FALSE;
 
   if (!_py_is_log_destination(self->py.instance))
     {
@@ -382,15 +423,13 @@ _py_init_bindings(PythonDestDriver *self)
 
     }
 
-  /* these are fast paths, store references to be faster */
-  self->py.is_opened = _py_get_attr_or_null(self->py.instance, "is_opened");
-  self->py.open = _py_get_attr_or_null(self->py.instance, "open");
-  self->py.flush = _py_get_attr_or_null(self->py.instance, "flush");
   self->py.send = _py_get_attr_or_null(self->py.instance, "send");
+  self->py.send_batch = _py_get_attr_or_null(self->py.instance, "send_batch");
   self->py.generate_persist_name = _py_get_attr_or_null(self->py.instance, "generate_persist_name");
-  if (!self->py.send)
+  if (!self->py.send && !self->py.send_batch)
     {
-      msg_error("python-dest: Error initializing Python destination, class does not have a send() method",
+      msg_error("python-dest: Error initializing Python destination, "
+                "class does not have a send() or send_batch() method",
                 evt_tag_str("driver", self->super.super.super.id),
                 evt_tag_str("class", self->binding.class));
       return FALSE;
@@ -402,10 +441,8 @@ _py_init_bindings(PythonDestDriver *self)
 
   g_ptr_array_add(self->py._refs_to_clean, self->py.class);
   g_ptr_array_add(self->py._refs_to_clean, self->py.instance);
-  g_ptr_array_add(self->py._refs_to_clean, self->py.is_opened);
-  g_ptr_array_add(self->py._refs_to_clean, self->py.open);
-  g_ptr_array_add(self->py._refs_to_clean, self->py.flush);
   g_ptr_array_add(self->py._refs_to_clean, self->py.send);
+  g_ptr_array_add(self->py._refs_to_clean, self->py.send_batch);
   g_ptr_array_add(self->py._refs_to_clean, self->py.generate_persist_name);
 
   return TRUE;
@@ -419,9 +456,9 @@ _py_free_bindings(PythonDestDriver *self)
 }
 
 static gboolean
-_py_init_object(PythonDestDriver *self)
+_py_init_object(PythonDestDriver *self, PyObject *instance)
 {
-  if (!_py_get_attr_or_null(self->py.instance, "init"))
+  if (!_py_get_attr_or_null(instance, "init"))
     {
       msg_debug("python-dest: Missing Python method, init()",
                 evt_tag_str("driver", self->super.super.super.id),
@@ -429,7 +466,7 @@ _py_init_object(PythonDestDriver *self)
       return TRUE;
     }
 
-  if (!_py_invoke_init(self))
+  if (!_py_invoke_init(self, instance))
     {
       msg_error("python-dest: Error initializing Python driver object, init() returned FALSE",
                 evt_tag_str("driver", self->super.super.super.id),
@@ -439,18 +476,95 @@ _py_init_object(PythonDestDriver *self)
   return TRUE;
 }
 
+static void
+_py_init_worker_bindings(PythonDestWorker *self, PyObject *instance)
+{
+  self->py.instance = instance;
+
+  /* these are fast paths, store references to be faster */
+  self->py.is_opened = _py_get_attr_or_null(instance, "is_opened");
+  self->py.open = _py_get_attr_or_null(instance, "open");
+  self->py.flush = _py_get_attr_or_null(instance, "flush");
+  self->py.send = _py_get_attr_or_null(instance, "send");
+  self->py.send_batch = _py_get_attr_or_null(instance, "send_batch");
+
+  /* the class attribute refers to the first worker, for compatibility */
+  PyObject *py_seqnum = py_integer_pointer_new(&self->super.seq_num);
+  if (self->super.worker_index == 0)
+    PyObject_SetAttrString(_dw_get_owner(self)->py.class, "seqnum", py_seqnum);
+  else
+    PyObject_SetAttrString(instance, "seqnum", py_seqnum);
+  Py_DECREF(py_seqnum);
+}
+
+static void
+_py_free_worker_bindings(PythonDestWorker *self)
+{
+  Py_CLEAR(self->py.instance);
+  Py_CLEAR(self->py.is_opened);
+  Py_CLEAR(self->py.open);
+  Py_CLEAR(self->py.flush);
+  Py_CLEAR(self->py.send);
+  Py_CLEAR(self->py.send_batch);
+}
+
 static gboolean
-_py_construct_message(PythonDestDriver *self, LogMessage *msg, PyObject **msg_object)
+_py_init_workers(PythonDestDriver *self)
 {
-  GlobalConfig *cfg = log_pipe_get_config(&self->super.super.super.super);
+  for (gint i = 0; i < self->super.num_workers; i++)
+    {
+      PythonDestWorker *worker = (PythonDestWorker *) self->super.workers[i];
+      PyObject *instance;
+
+      if (i == 0)
+        {
+          instance = self->py.instance;
+          Py_INCREF(instance);
+        }
+      else
+        {
+          instance = _py_instantiate_class(self);
+          if (!instance)
+            return FALSE;
+
+          if (!_py_init_object(self, instance))
+            {
+              Py_DECREF(instance);
+              return FALSE;
+            }
+        }
+      _py_init_worker_bindings(worker, instance);
+    }
+  return TRUE;
+}
+
+static void
+_py_deinit_workers(PythonDestDriver *self)
+{
+  for (gint i = 0; i < self->super.created_workers; i++)
+    {
+      PythonDestWorker *worker = (PythonDestWorker *) self->super.workers[i];
+
+      /* the instance of the first worker is deinitialized with the driver */
+      if (i > 0 && worker->py.instance)
+        _py_invoke_deinit(self, worker->py.instance);
+      _py_free_worker_bindings(worker);
+    }
+}
+
+static gboolean
+_py_construct_message(PythonDestWorker *self, LogMessage *msg, PyObject **msg_object)
+{
+  PythonDestDriver *owner = _dw_get_owner(self);
+  GlobalConfig *cfg = log_pipe_get_config(&owner->super.super.super.super);
   gboolean success;
   *msg_object = NULL;
 
-  if (self->vp)
+  if (owner->vp)
     {
-      LogTemplateEvalOptions options = {&self->template_options, LTZ_LOCAL, self->super.worker.instance.seq_num, NULL, LM_VT_STRING};
-      success = py_value_pairs_apply(self->vp, &options, msg, msg_object);
-      if (!success && (self->template_options.on_error & ON_ERROR_DROP_MESSAGE))
+      LogTemplateEvalOptions options = {&owner->template_options, LTZ_LOCAL, self->super.seq_num, NULL, LM_VT_STRING};
+      success = py_value_pairs_apply(owner->vp, &options, msg, msg_object);
+      if (!success && (owner->template_options.on_error & ON_ERROR_DROP_MESSAGE))
         return FALSE;
     }
   else
@@ -461,15 +575,124 @@ _py_construct_message(PythonDestDriver *self, LogMessage *msg, PyObject **msg_ob
   return TRUE;
 }
 
+static LogThreadedResult
+_as_batch_result(PythonDestWorker *self, LogThreadedResult result)
+{
+  /* neither of these makes sense as the outcome of send_batch(), the
+   * messages would linger on the backlog */
+  if (result == LTR_QUEUED || result == LTR_EXPLICIT_ACK_MGMT)
+    {
+      msg_error("python-dest: Invalid result returned by send_batch(), QUEUED can only be used with send(). "
+                "Retrying batch later",
+                evt_tag_str("driver", _dw_get_owner(self)->super.super.super.id),
+                evt_tag_str("class", _dw_get_owner(self)->binding.class));
+      return LTR_ERROR;
+    }
+  return result;
+}
 
+/* Per-message results: the leading run of SUCCESS and DROP results is
+ * acked message by message, as these are the oldest entries on the
+ * backlog.  The first message that needs to be retried decides what
+ * happens to itself and the rest of the batch, those are handled by the
+ * regular result processing, so they are rewound and resent. */
 static LogThreadedResult
-python_dd_insert(LogThreadedDestDriver *d, LogMessage *msg)
+_process_send_batch_results(PythonDestWorker *self, PyObject *results)
 {
-  PythonDestDriver *self = (PythonDestDriver *)d;
+  PyObject *seq = PySequence_Fast(results, "send_batch() must return a sequence");
+  if (!seq)
+    {
+      _py_finish_exception_handling();
+      return LTR_ERROR;
+    }
+
+  LogThreadedResult result = LTR_SUCCESS;
+  Py_ssize_t len = PySequence_Fast_GET_SIZE(seq);
+  if (len != self->batch->len)
+    {
+      msg_error("python-dest: The number of results returned by send_batch() does not match the size of the batch. "
+                "Retrying batch later",
+                evt_tag_str("driver", _dw_get_owner(self)->super.super.super.id),
+                evt_tag_str("class", _dw_get_owner(self)->binding.class),
+                evt_tag_long("results", len),
+                evt_tag_int("batch_size", self->batch->len));
+      result = LTR_ERROR;
+      goto exit;
+    }
+
+  for (Py_ssize_t i = 0; i < len; i++)
+    {
+      result = _as_batch_result(self, pyobject_to_worker_insert_result(PySequence_Fast_GET_ITEM(seq, i)));
+
+      if (result == LTR_SUCCESS)
+        log_threaded_dest_worker_ack_messages(&self->super, 1);
+      else if (result == LTR_DROP)
+        log_threaded_dest_worker_drop_messages(&self->super, 1);
+      else
+        break;
+    }
+
+  /* everything has been acked or dropped explicitly */
+  if (result == LTR_SUCCESS || result == LTR_DROP)
+    result = LTR_EXPLICIT_ACK_MGMT;
+
+exit:
+  Py_DECREF(seq);
+  return result;
+}
+
+static LogThreadedResult
+_py_invoke_send_batch(PythonDestWorker *self)
+{
+  PyObject *py_msgs = PyList_New(self->batch->len);
+  if (!py_msgs)
+    {
+      _py_finish_exception_handling();
+      return LTR_ERROR;
+    }
+
+  for (guint i = 0; i < self->batch->len; i++)
+    {
+      PyObject *msg_object;
+
+      if (!_py_construct_message(self, g_ptr_array_index(self->batch, i), &msg_object) || !msg_object)
+        {
+          Py_DECREF(py_msgs);
+          return LTR_ERROR;
+        }
+      PyList_SET_ITEM(py_msgs, i, msg_object);
+    }
+
+  PyObject *ret = _dw_py_invoke_function(self, self->py.send_batch, py_msgs);
+  Py_DECREF(py_msgs);
+
+  if (!ret)
+    return LTR_ERROR;
+
+  LogThreadedResult result;
+  if (PyList_Check(ret) || PyTuple_Check(ret))
+    result = _process_send_batch_results(self, ret);
+  else
+    result = _as_batch_result(self, pyobject_to_worker_insert_result(ret));
+  Py_DECREF(ret);
+  return result;
+}
+
+static LogThreadedResult
+python_dw_insert(LogThreadedDestWorker *s, LogMessage *msg)
+{
+  PythonDestWorker *self = (PythonDestWorker *)s;
   LogThreadedResult result = LTR_ERROR;
   PyObject *msg_object;
   PyGILState_STATE gstate;
 
+  /* send_batch(): no need for the GIL until the batch is flushed */
+  if (self->py.send_batch)
+    {
+      g_ptr_array_add(self->batch, log_msg_ref(msg));
+      return LTR_QUEUED;
+    }
+
   gstate = PyGILState_Ensure();
   if (self->py.is_opened && !_py_invoke_is_opened(self))
     {
@@ -491,35 +714,63 @@ exit:
   return result;
 }
 
-static gboolean
-python_dd_open(PythonDestDriver *self)
+static LogThreadedResult
+python_dw_flush_batch(PythonDestWorker *self)
 {
+  LogThreadedResult result = LTR_SUCCESS;
   PyGILState_STATE gstate;
 
-  gstate = PyGILState_Ensure();
-  gboolean retval = _py_invoke_open(self);
+  if (self->batch->len == 0)
+    return LTR_SUCCESS;
 
+  gstate = PyGILState_Ensure();
+  if (self->py.is_opened && !_py_invoke_is_opened(self) && !_py_invoke_open(self))
+    result = LTR_NOT_CONNECTED;
+  else
+    result = _py_invoke_send_batch(self);
   PyGILState_Release(gstate);
-  return retval;
+
+  /* whatever is not acked is rewound and will be inserted again */
+  g_ptr_array_set_size(self->batch, 0);
+  return result;
 }
 
 static LogThreadedResult
-python_dd_flush(LogThreadedDestDriver *s)
+python_dw_flush(LogThreadedDestWorker *s, LogThreadedFlushMode mode)
 {
-  PythonDestDriver *self = (PythonDestDriver *)s;
+  PythonDestWorker *self = (PythonDestWorker *)s;
   PyGILState_STATE gstate;
 
+  if (self->py.send_batch)
+    return python_dw_flush_batch(self);
+
   gstate = PyGILState_Ensure();
   LogThreadedResult result = _py_invoke_flush(self);
   PyGILState_Release(gstate);
   return result;
 };
 
+static gboolean
+python_dw_connect(LogThreadedDestWorker *s)
+{
+  PythonDestWorker *self = (PythonDestWorker *) s;
+  PyGILState_STATE gstate;
+
+  gstate = PyGILState_Ensure();
+  gboolean retval = _py_invoke_open(self);
+
+  PyGILState_Release(gstate);
+  return retval;
+}
+
 static void
-python_dd_close(PythonDestDriver *self)
+python_dw_disconnect(LogThreadedDestWorker *s)
 {
+  PythonDestWorker *self = (PythonDestWorker *) s;
   PyGILState_STATE gstate;
 
+  g_ptr_array_set_size(self->batch, 0);
+
   gstate = PyGILState_Ensure();
   if (self->py.is_opened)
     {
@@ -533,20 +784,30 @@ python_dd_close(PythonDestDriver *self)
   PyGILState_Release(gstate);
 }
 
-static gboolean
-python_dd_connect(LogThreadedDestDriver *d)
+static void
+python_dw_free(LogThreadedDestWorker *s)
 {
-  PythonDestDriver *self = (PythonDestDriver *) d;
+  PythonDestWorker *self = (PythonDestWorker *) s;
 
-  return python_dd_open(self);
+  g_ptr_array_free(self->batch, TRUE);
+  log_threaded_dest_worker_free_method(s);
 }
 
-static void
-python_dd_disconnect(LogThreadedDestDriver *d)
+static LogThreadedDestWorker *
+python_dw_new(LogThreadedDestDriver *o, gint worker_index)
 {
-  PythonDestDriver *self = (PythonDestDriver *) d;
+  PythonDestWorker *self = g_new0(PythonDestWorker, 1);
+
+  log_threaded_dest_worker_init_instance(&self->super, o, worker_index);
+  self->super.connect = python_dw_connect;
+  self->super.disconnect = python_dw_disconnect;
+  self->super.insert = python_dw_insert;
+  self->super.flush = python_dw_flush;
+  self->super.free_fn = python_dw_free;
+
+  self->batch = g_ptr_array_new_with_free_func((GDestroyNotify) log_msg_unref);
 
-  python_dd_close(self);
+  return &self->super;
 }
 
 static gboolean
@@ -567,17 +828,23 @@ python_dd_init(LogPipe *d)
     goto fail;
   PyGILState_Release(gstate);
 
+  if (self->py.send_batch && self->super.batch_lines == -1)
+    self->super.batch_lines = PYTHON_DEST_DEFAULT_BATCH_LINES;
+
   if (!log_threaded_dest_driver_init_method(d))
     return FALSE;
 
   gstate = PyGILState_Ensure();
-  if (!_py_init_object(self))
+  if (!_py_init_object(self, self->py.instance))
+    goto fail;
+  if (!_py_init_workers(self))
     goto fail;
   PyGILState_Release(gstate);
 
   msg_verbose("python-dest: Python destination initialized",
               evt_tag_str("driver", self->super.super.super.id),
-              evt_tag_str("class", self->binding.class));
+              evt_tag_str("class", self->binding.class),
+              evt_tag_int("workers", self->super.num_workers));
 
   return TRUE;
 
@@ -593,7 +860,8 @@ python_dd_deinit(LogPipe *d)
   PyGILState_STATE gstate;
 
   gstate = PyGILState_Ensure();
-  _py_invoke_deinit(self);
+  _py_deinit_workers(self);
+  _py_invoke_deinit(self, self->py.instance);
   PyGILState_Release(gstate);
 
   python_binding_deinit(&self->binding);
@@ -632,10 +900,7 @@ python_dd_new(GlobalConfig *cfg)
   self->super.super.super.super.free_fn = python_dd_free;
   self->super.super.super.super.generate_persist_name = python_dd_format_persist_name;
 
-  self->super.worker.connect = python_dd_connect;
-  self->super.worker.disconnect = python_dd_disconnect;
-  self->super.worker.insert = python_dd_insert;
-  self->super.worker.flush = python_dd_flush;
+  self->super.worker.construct = python_dw_new;
 
   self->super.format_stats_key = python_dd_format_stats_key;
   self->super.stats_source = stats_register_type("python");
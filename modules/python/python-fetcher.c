@@ -35,11 +35,22 @@
 
 #include <structmember.h>
 
+/* the rest of a batch returned by fetch(), the bookmark is requested when
+ * the message is actually posted */
+typedef struct _PythonFetcherPendingMessage
+{
+  LogMessage *msg;
+  PyObject *bookmark_data;
+} PythonFetcherPendingMessage;
+
 typedef struct _PythonFetcherDriver
 {
   LogThreadedFetcherDriver super;
   PythonBinding binding;
 
+  GArray *pending;
+  guint pending_pos;
+
   struct
   {
     PyObject *class;
@@ -167,7 +178,13 @@ _py_fetcher_get_ack_tracker(PythonFetcherDriver *self)
 }
 
 static gboolean
-_py_fetcher_fill_bookmark(PythonFetcherDriver *self, PyLogMessage *pymsg)
+_has_bookmark_data(PyLogMessage *pymsg)
+{
+  return pymsg->bookmark_data && pymsg->bookmark_data != Py_None;
+}
+
+static gboolean
+_py_fetcher_fill_bookmark(PythonFetcherDriver *self, PyObject *bookmark_data)
 {
   if (!self->py.ack_tracker_factory)
     {
@@ -185,13 +202,77 @@ _py_fetcher_fill_bookmark(PythonFetcherDriver *self, PyLogMessage *pymsg)
   bookmark = ack_tracker_request_bookmark(ack_tracker);
   Py_END_ALLOW_THREADS
 
-  PyBookmark *py_bookmark = py_bookmark_new(pymsg->bookmark_data, self->py.ack_tracker_factory->ack_callback);
+  PyBookmark *py_bookmark = py_bookmark_new(bookmark_data, self->py.ack_tracker_factory->ack_callback);
   py_bookmark_fill(bookmark, py_bookmark);
   Py_XDECREF(py_bookmark);
 
   return TRUE;
 }
 
+static void
+_clear_pending_messages(PythonFetcherDriver *self)
+{
+  for (guint i = self->pending_pos; i < self->pending->len; i++)
+    {
+      PythonFetcherPendingMessage *pending = &g_array_index(self->pending, PythonFetcherPendingMessage, i);
+
+      log_msg_unref(pending->msg);
+      Py_XDECREF(pending->bookmark_data);
+    }
+  g_array_set_size(self->pending, 0);
+  self->pending_pos = 0;
+}
+
+static gboolean
+_py_take_fetched_message(PythonFetcherDriver *self, PyLogMessage *pymsg, LogMessage **msg)
+{
+  if (_has_bookmark_data(pymsg))
+    {
+      if (!_py_fetcher_fill_bookmark(self, pymsg->bookmark_data))
+        return FALSE;
+    }
+
+  /* keep a reference until the PyLogMessage instance is freed */
+  *msg = log_msg_ref(pymsg->msg);
+  return TRUE;
+}
+
+/* fetch() may return a list of messages: the first one is returned right
+ * away, the rest is posted by subsequent fetches without calling Python */
+static ThreadedFetchResult
+_py_take_fetched_batch(PythonFetcherDriver *self, PyObject *py_msgs, LogMessage **msg)
+{
+  Py_ssize_t len = PySequence_Fast_GET_SIZE(py_msgs);
+  PyObject **items = PySequence_Fast_ITEMS(py_msgs);
+
+  if (len == 0)
+    return THREADED_FETCH_NO_DATA;
+
+  for (Py_ssize_t i = 0; i < len; i++)
+    {
+      if (!py_is_log_message(items[i]))
+        return THREADED_FETCH_ERROR;
+    }
+
+  if (!_py_take_fetched_message(self, (PyLogMessage *) items[0], msg))
+    return THREADED_FETCH_ERROR;
+
+  for (Py_ssize_t i = 1; i < len; i++)
+    {
+      PyLogMessage *pymsg = (PyLogMessage *) items[i];
+      PythonFetcherPendingMessage pending = { log_msg_ref(pymsg->msg), NULL };
+
+      if (_has_bookmark_data(pymsg))
+        {
+          Py_INCREF(pymsg->bookmark_data);
+          pending.bookmark_data = pymsg->bookmark_data;
+        }
+      g_array_append_val(self->pending, pending);
+    }
+
+  return THREADED_FETCH_SUCCESS;
+}
+
 static ThreadedFetchResult
 _py_invoke_fetch(PythonFetcherDriver *self, LogMessage **msg)
 {
@@ -210,21 +291,25 @@ _py_invoke_fetch(PythonFetcherDriver *self, LogMessage **msg)
 
   if (fetch_result == THREADED_FETCH_SUCCESS)
     {
-      PyLogMessage *pymsg = (PyLogMessage *) PyTuple_GetItem(ret, 1);
-      if (!pymsg || !py_is_log_message((PyObject *) pymsg))
+      PyObject *py_msg = PyTuple_GetItem(ret, 1);
+      if (!py_msg)
         goto error;
 
-      if (pymsg->bookmark_data && pymsg->bookmark_data != Py_None)
+      if (PyList_Check(py_msg) || PyTuple_Check(py_msg))
         {
-          if (!_py_fetcher_fill_bookmark(self, pymsg))
-            {
-              Py_XDECREF(ret);
-              return THREADED_FETCH_ERROR;
-            }
+          fetch_result = _py_take_fetched_batch(self, py_msg, msg);
+          if (fetch_result == THREADED_FETCH_ERROR)
+            goto error;
+        }
+      else if (!py_is_log_message(py_msg))
+        {
+          goto error;
+        }
+      else if (!_py_take_fetched_message(self, (PyLogMessage *) py_msg, msg))
+        {
+          Py_XDECREF(ret);
+          return THREADED_FETCH_ERROR;
         }
-
-      /* keep a reference until the PyLogMessage instance is freed */
-      *msg = log_msg_ref(pymsg->msg);
     }
 
   Py_XDECREF(ret);
@@ -232,7 +317,8 @@ _py_invoke_fetch(PythonFetcherDriver *self, LogMessage **msg)
   return fetch_result;
 
 error:
-  msg_error("python-fetcher: Error in Python fetcher, fetch() must return a tuple (FetchResult, LogMessage)",
+  msg_error("python-fetcher: Error in Python fetcher, fetch() must return a tuple (FetchResult, LogMessage) "
+            "or (FetchResult, [LogMessage, ...])",
             evt_tag_str("driver", self->super.super.super.super.id),
             evt_tag_str("class", self->binding.class));
 
@@ -558,12 +644,47 @@ error:
   return FALSE;
 }
 
+static LogThreadedFetchResult
+_fetch_pending_message(PythonFetcherDriver *self)
+{
+  PythonFetcherPendingMessage pending = g_array_index(self->pending, PythonFetcherPendingMessage, self->pending_pos);
+  LogThreadedFetchResult fetch_result = { THREADED_FETCH_SUCCESS, pending.msg };
+
+  self->pending_pos++;
+  if (self->pending_pos == self->pending->len)
+    {
+      g_array_set_size(self->pending, 0);
+      self->pending_pos = 0;
+    }
+
+  /* the GIL is only needed for messages with a bookmark */
+  if (pending.bookmark_data)
+    {
+      PyGILState_STATE gstate = PyGILState_Ensure();
+      if (!_py_fetcher_fill_bookmark(self, pending.bookmark_data))
+        {
+          log_msg_unref(pending.msg);
+          fetch_result = (LogThreadedFetchResult)
+          {
+            THREADED_FETCH_ERROR, NULL
+          };
+        }
+      Py_DECREF(pending.bookmark_data);
+      PyGILState_Release(gstate);
+    }
+
+  return fetch_result;
+}
+
 static LogThreadedFetchResult
 python_fetcher_fetch(LogThreadedFetcherDriver *s)
 {
   PythonFetcherDriver *self = (PythonFetcherDriver *) s;
   LogThreadedFetchResult fetch_result;
 
+  if (self->pending_pos < self->pending->len)
+    return _fetch_pending_message(self);
+
   PyGILState_STATE gstate = PyGILState_Ensure();
   {
     LogMessage *msg = NULL;
@@ -628,6 +749,7 @@ python_fetcher_deinit(LogPipe *s)
   ack_tracker_deinit(ack_tracker);
 
   PyGILState_STATE gstate = PyGILState_Ensure();
+  _clear_pending_messages(self);
   _py_invoke_deinit(self);
   PyGILState_Release(gstate);
 
@@ -645,6 +767,7 @@ python_fetcher_free(LogPipe *s)
   _py_free_bindings(self);
   PyGILState_Release(gstate);
 
+  g_array_free(self->pending, TRUE);
   python_binding_clear(&self->binding);
   log_threaded_fetcher_driver_free_method(s);
 }
@@ -665,6 +788,7 @@ python_fetcher_new(GlobalConfig *cfg)
   self->super.super.worker_options.super.stats_source = stats_register_type("python");
 
   self->super.fetch = python_fetcher_fetch;
+  self->pending = g_array_new(FALSE, FALSE, sizeof(PythonFetcherPendingMessage));
 
   python_binding_init_instance(&self->binding);
 
@@ -38,17 +38,74 @@
 
 #include <datetime.h>
 
+/* NVTable.ref_cnt is a 7 bit field, copy values instead of referencing
+ * tables that are already shared this much */
+#define PY_LOG_MESSAGE_VIEW_MAX_TABLE_REFS 64
+
+/* bytes objects of the name-value pair names and LogMessageHandle
+ * objects, both indexed by NVHandle */
+static GPtrArray *interned_keys;
+static GPtrArray *handles;
+#ifdef Py_GIL_DISABLED
+/* free-threaded Python: the GIL does not serialize access to the caches */
+static GMutex handle_caches_lock;
+#endif
+
+typedef struct _PyLogMessageHandle
+{
+  PyObject_HEAD
+  NVHandle handle;
+} PyLogMessageHandle;
+
+static PyTypeObject py_log_message_handle_type;
+
+typedef struct _PyLogMessagePayload
+{
+  PyObject_HEAD
+  LogMessage *msg;
+  NVTable *table;
+} PyLogMessagePayload;
+
+static PyTypeObject py_log_message_payload_type;
+
 int
 py_is_log_message(PyObject *obj)
 {
   return PyType_IsSubtype(Py_TYPE(obj), &py_log_message_type);
 }
 
+static gboolean
+_is_log_message_handle(PyObject *obj)
+{
+  return PyType_IsSubtype(Py_TYPE(obj), &py_log_message_handle_type);
+}
+
+/* keys are either str/bytes or LogMessageHandle objects, the latter skip
+ * the name-value registry lookup */
+static gboolean
+_resolve_key(PyObject *key, NVHandle *handle, const gchar **name)
+{
+  if (_is_log_message_handle(key))
+    {
+      *handle = ((PyLogMessageHandle *) key)->handle;
+      *name = log_msg_get_value_name(*handle, NULL);
+      return TRUE;
+    }
+
+  if (!py_bytes_or_string_to_string(key, name))
+    {
+      PyErr_Clear();
+      PyErr_SetString(PyExc_TypeError, "key is not a string or LogMessageHandle object");
+      return FALSE;
+    }
+  *handle = log_msg_get_value_handle(*name);
+  return TRUE;
+}
+
 static inline PyObject *
-_get_value(PyLogMessage *self, const gchar *name, gboolean cast_to_bytes, gboolean *error)
+_get_value(PyLogMessage *self, NVHandle handle, const gchar *name, gboolean cast_to_bytes, gboolean *error)
 {
   *error = FALSE;
-  NVHandle handle = log_msg_get_value_handle(name);
   gssize value_len = 0;
   LogMessageValueType type;
   const gchar *value = log_msg_get_value_if_set_with_type(self->msg, handle, &value_len, &type);
@@ -73,18 +130,173 @@ _get_value(PyLogMessage *self, const gchar *name, gboolean cast_to_bytes, gboole
 }
 
 static PyObject *
-_py_log_message_subscript(PyObject *o, PyObject *key)
+_get_interned_key(NVHandle handle, const gchar *name)
 {
-  const gchar *name;
-  if (!py_bytes_or_string_to_string(key, &name))
+#ifdef Py_GIL_DISABLED
+  g_mutex_lock(&handle_caches_lock);
+#endif
+  if (handle >= interned_keys->len)
+    g_ptr_array_set_size(interned_keys, handle + 1);
+
+  PyObject *py_name = g_ptr_array_index(interned_keys, handle);
+  if (!py_name)
     {
-      PyErr_SetString(PyExc_TypeError, "key is not a string object");
-      return NULL;
+      py_name = PyBytes_FromString(name);
+      g_ptr_array_index(interned_keys, handle) = py_name;
+    }
+  Py_XINCREF(py_name);
+#ifdef Py_GIL_DISABLED
+  g_mutex_unlock(&handle_caches_lock);
+#endif
+
+  return py_name;
+}
+
+static PyObject *
+_get_handle_object(NVHandle handle)
+{
+#ifdef Py_GIL_DISABLED
+  g_mutex_lock(&handle_caches_lock);
+#endif
+  if (handle >= handles->len)
+    g_ptr_array_set_size(handles, handle + 1);
+
+  PyLogMessageHandle *py_handle = g_ptr_array_index(handles, handle);
+  if (!py_handle)
+    {
+      py_handle = PyObject_New(PyLogMessageHandle, &py_log_message_handle_type);
+      if (py_handle)
+        {
+          py_handle->handle = handle;
+          g_ptr_array_index(handles, handle) = py_handle;
+        }
+    }
+  Py_XINCREF(py_handle);
+#ifdef Py_GIL_DISABLED
+  g_mutex_unlock(&handle_caches_lock);
+#endif
+
+  return (PyObject *) py_handle;
+}
+
+static PyObject *
+py_log_message_handle_repr(PyLogMessageHandle *self)
+{
+  return PyUnicode_FromFormat("LogMessageHandle(%s)", log_msg_get_value_name(self->handle, NULL));
+}
+
+/* The payload object keeps an NVTable alive (and the LogMessage, in case
+ * the NVTable is allocated together with it) for as long as memoryviews
+ * exported from it exist.  As with parsers in the C code, the reference
+ * makes nv_table_realloc() move the table instead of changing it in place,
+ * so the memory behind a view never goes away.
+ */
+static int
+py_log_message_payload_getbuffer(PyObject *s, Py_buffer *view, int flags)
+{
+  PyLogMessagePayload *self = (PyLogMessagePayload *) s;
+
+  return PyBuffer_FillInfo(view, s, (void *) self->table, self->table->size, TRUE, flags);
+}
+
+static void
+py_log_message_payload_free(PyLogMessagePayload *self)
+{
+  nv_table_unref(self->table);
+  log_msg_unref(self->msg);
+  Py_TYPE(self)->tp_free((PyObject *) self);
+}
+
+static PyObject *
+_py_log_message_payload_view_new(LogMessage *msg, NVTable *table)
+{
+  PyLogMessagePayload *payload = PyObject_New(PyLogMessagePayload, &py_log_message_payload_type);
+  if (!payload)
+    return NULL;
+
+  payload->msg = log_msg_ref(msg);
+  payload->table = nv_table_ref(table);
+
+  PyObject *view = PyMemoryView_FromObject((PyObject *) payload);
+  Py_DECREF(payload);
+  return view;
+}
+
+static gboolean
+_is_value_in_table(NVTable *table, const gchar *value, gssize value_len)
+{
+  const gchar *table_start = (const gchar *) table;
+
+  return value >= table_start && value + value_len <= table_start + table->size;
+}
+
+/* returns a borrowed reference to a memoryview over the NVTable containing
+ * value, or NULL if the value is not stored in an NVTable (e.g. macros) */
+static PyObject *
+_get_payload_view(PyLogMessage *self, const gchar *value, gssize value_len)
+{
+  NVTable *tables[] = { self->msg->payload, self->msg->payload_parent };
+
+  for (guint i = 0; i < G_N_ELEMENTS(tables); i++)
+    {
+      NVTable *table = tables[i];
+
+      if (!table || !_is_value_in_table(table, value, value_len))
+        continue;
+
+      PyObject **view = &self->payload_views[i];
+      if (*view && PyMemoryView_GET_BUFFER(*view)->buf == (void *) table)
+        return *view;
+
+      Py_CLEAR(*view);
+      if (table->ref_cnt >= PY_LOG_MESSAGE_VIEW_MAX_TABLE_REFS)
+        return NULL;
+
+      *view = _py_log_message_payload_view_new(self->msg, table);
+      if (!*view)
+        PyErr_Clear();
+      return *view;
+    }
+  return NULL;
+}
+
+static PyObject *
+_get_value_view(PyLogMessage *self, NVHandle handle)
+{
+  gssize value_len = 0;
+  LogMessageValueType type;
+  const gchar *value = log_msg_get_value_if_set_with_type(self->msg, handle, &value_len, &type);
+
+  if (!value || type == LM_VT_BYTES || type == LM_VT_PROTOBUF)
+    return NULL;
+
+  PyObject *payload_view = _get_payload_view(self, value, value_len);
+  if (!payload_view)
+    {
+      PyObject *copy = PyBytes_FromStringAndSize(value, value_len);
+      if (!copy)
+        return NULL;
+
+      PyObject *view = PyMemoryView_FromObject(copy);
+      Py_DECREF(copy);
+      return view;
     }
 
+  Py_ssize_t offset = value - (const gchar *) PyMemoryView_GET_BUFFER(payload_view)->buf;
+  return PySequence_GetSlice(payload_view, offset, offset + value_len);
+}
+
+static PyObject *
+_py_log_message_subscript(PyObject *o, PyObject *key)
+{
+  const gchar *name;
+  NVHandle handle;
+  if (!_resolve_key(key, &handle, &name))
+    return NULL;
+
   PyLogMessage *py_msg = (PyLogMessage *) o;
   gboolean error;
-  PyObject *value = _get_value(py_msg, name, py_msg->cast_to_bytes, &error);
+  PyObject *value = _get_value(py_msg, handle, name, py_msg->cast_to_bytes, &error);
 
   if (error)
     return NULL;
@@ -104,11 +316,9 @@ static int
 _py_log_message_ass_subscript(PyObject *o, PyObject *key, PyObject *value)
 {
   const gchar *name;
-  if (!py_bytes_or_string_to_string(key, &name))
-    {
-      PyErr_SetString(PyExc_TypeError, "key is not a string object");
-      return -1;
-    }
+  NVHandle handle;
+  if (!_resolve_key(key, &handle, &name))
+    return -1;
 
   PyLogMessage *py_msg = (PyLogMessage *) o;
   LogMessage *msg = py_msg->msg;
@@ -122,8 +332,6 @@ _py_log_message_ass_subscript(PyObject *o, PyObject *key, PyObject *value)
       return -1;
     }
 
-  NVHandle handle = log_msg_get_value_handle(name);
-
   if (!value)
     return -1;
 
@@ -159,6 +367,8 @@ py_log_message_free(PyLogMessage *self)
 {
   log_msg_unref(self->msg);
   Py_CLEAR(self->bookmark_data);
+  Py_CLEAR(self->payload_views[0]);
+  Py_CLEAR(self->payload_views[1]);
   Py_TYPE(self)->tp_free((PyObject *) self);
 }
 
@@ -173,6 +383,7 @@ py_log_message_new(LogMessage *msg, GlobalConfig *cfg)
 
   self->msg = log_msg_ref(msg);
   self->bookmark_data = NULL;
+  self->payload_views[0] = self->payload_views[1] = NULL;
 
   if (cfg_is_config_version_older(cfg, VERSION_VALUE_4_0))
     self->cast_to_bytes = TRUE;
@@ -222,7 +433,7 @@ _collect_nvpair_names_from_logmsg(NVHandle handle, const gchar *name, const gcha
   if (type == LM_VT_BYTES || type == LM_VT_PROTOBUF)
     return FALSE;
 
-  PyObject *py_name = PyBytes_FromString(name);
+  PyObject *py_name = _get_interned_key(handle, name);
   PyList_Append(list, py_name);
   Py_XDECREF(py_name);
 
@@ -244,7 +455,7 @@ _collect_macro_names(gpointer key, gpointer value, gpointer user_data)
 
   if (_is_macro_name_visible_to_user(name, handle))
     {
-      PyObject *py_name = PyBytes_FromString(name);
+      PyObject *py_name = _get_interned_key(handle, name);
       PyList_Append(list, py_name);
       Py_XDECREF(py_name);
     }
@@ -265,16 +476,20 @@ _logmessage_get_keys_method(PyLogMessage *self)
 static PyObject *
 py_log_message_get(PyLogMessage *self, PyObject *args, PyObject *kwrds)
 {
-  const gchar *key = NULL;
-  Py_ssize_t key_len = 0;
+  PyObject *key;
   PyObject *default_value = NULL;
 
   static const gchar *kwlist[] = {"key", "default", NULL};
-  if (!PyArg_ParseTupleAndKeywords(args, kwrds, "z#|O", (gchar **) kwlist, &key, &key_len, &default_value))
+  if (!PyArg_ParseTupleAndKeywords(args, kwrds, "O|O", (gchar **) kwlist, &key, &default_value))
+    return NULL;
+
+  const gchar *name;
+  NVHandle handle;
+  if (!_resolve_key(key, &handle, &name))
     return NULL;
 
   gboolean error;
-  PyObject *value = _get_value(self, key, self->cast_to_bytes, &error);
+  PyObject *value = _get_value(self, handle, name, self->cast_to_bytes, &error);
 
   if (error)
     return NULL;
@@ -289,24 +504,53 @@ py_log_message_get(PyLogMessage *self, PyObject *args, PyObject *kwrds)
   return default_value;
 }
 
+static PyObject *
+py_log_message_get_view(PyLogMessage *self, PyObject *args, PyObject *kwrds)
+{
+  PyObject *key;
+  PyObject *default_value = NULL;
+
+  static const gchar *kwlist[] = {"key", "default", NULL};
+  if (!PyArg_ParseTupleAndKeywords(args, kwrds, "O|O", (gchar **) kwlist, &key, &default_value))
+    return NULL;
+
+  const gchar *name;
+  NVHandle handle;
+  if (!_resolve_key(key, &handle, &name))
+    return NULL;
+
+  PyObject *value = _get_value_view(self, handle);
+
+  if (value || PyErr_Occurred())
+    return value;
+
+  if (!default_value)
+    Py_RETURN_NONE;
+
+  Py_XINCREF(default_value);
+  return default_value;
+}
+
 static PyObject *
 py_log_message_get_as_str(PyLogMessage *self, PyObject *args, PyObject *kwrds)
 {
-  const gchar *key = NULL;
-  Py_ssize_t key_len = 0;
+  PyObject *key;
   PyObject *default_value = NULL;
   const gchar *encoding = "utf-8";
   const gchar *errors = "strict";
   const gchar *repr = "internal";
 
   static const gchar *kwlist[] = {"key", "default", "encoding", "errors", "repr", NULL};
-  if (!PyArg_ParseTupleAndKeywords(args, kwrds, "z#|Osss", (gchar **) kwlist, &key, &key_len, &default_value,
+  if (!PyArg_ParseTupleAndKeywords(args, kwrds, "O|Osss", (gchar **) kwlist, &key, &default_value,
                                    &encoding, &errors, &repr))
     {
       return NULL;
     }
 
-  NVHandle handle = log_msg_get_value_handle(key);
+  const gchar *name;
+  NVHandle handle;
+  if (!_resolve_key(key, &handle, &name))
+    return NULL;
   gssize value_len = 0;
   LogMessageValueType type;
   const gchar *value = log_msg_get_value_if_set_with_type(self->msg, handle, &value_len, &type);
@@ -396,6 +640,23 @@ py_log_message_set_bookmark(PyLogMessage *self, PyObject *args, PyObject *kwrds)
   Py_RETURN_NONE;
 }
 
+static PyObject *
+py_log_message_handle(PyObject *_none, PyObject *args, PyObject *kwrds)
+{
+  PyObject *key;
+
+  static const gchar *kwlist[] = {"key", NULL};
+  if (!PyArg_ParseTupleAndKeywords(args, kwrds, "O", (gchar **) kwlist, &key))
+    return NULL;
+
+  const gchar *name;
+  NVHandle handle;
+  if (!_resolve_key(key, &handle, &name))
+    return NULL;
+
+  return _get_handle_object(handle);
+}
+
 static PyObject *
 py_log_message_parse(PyObject *_none, PyObject *args, PyObject *kwrds)
 {
@@ -431,6 +692,7 @@ py_log_message_parse(PyObject *_none, PyObject *args, PyObject *kwrds)
 
   py_msg->msg = msg_format_parse(parse_options, (const guchar *) raw_msg, raw_msg_length);
   py_msg->bookmark_data = NULL;
+  py_msg->payload_views[0] = py_msg->payload_views[1] = NULL;
 
   return (PyObject *) py_msg;
 }
@@ -440,11 +702,13 @@ static PyMethodDef py_log_message_methods[] =
   { "keys", (PyCFunction)_logmessage_get_keys_method, METH_NOARGS, "Return keys." },
   { "get", (PyCFunction)py_log_message_get, METH_VARARGS | METH_KEYWORDS, "Get value" },
   { "get_as_str", (PyCFunction)py_log_message_get_as_str, METH_VARARGS | METH_KEYWORDS, "Get value as string" },
+  { "get_view", (PyCFunction)py_log_message_get_view, METH_VARARGS | METH_KEYWORDS, "Get value as memoryview" },
   { "set_pri", (PyCFunction)py_log_message_set_pri, METH_VARARGS | METH_KEYWORDS, "Set syslog priority" },
   { "get_pri", (PyCFunction)py_log_message_get_pri, METH_VARARGS | METH_KEYWORDS, "Get syslog priority" },
   { "set_timestamp", (PyCFunction)py_log_message_set_timestamp, METH_VARARGS | METH_KEYWORDS, "Set timestamp" },
   { "get_timestamp", (PyCFunction)py_log_message_get_timestamp, METH_VARARGS | METH_KEYWORDS, "Get timestamp" },
   { "set_bookmark", (PyCFunction)py_log_message_set_bookmark, METH_VARARGS | METH_KEYWORDS, "Set bookmark" },
+  { "handle", (PyCFunction)py_log_message_handle, METH_STATIC|METH_VARARGS|METH_KEYWORDS, "Resolve a key to a handle" },
   { "parse", (PyCFunction)py_log_message_parse, METH_STATIC|METH_VARARGS|METH_KEYWORDS, "Parse and create LogMessage" },
   {NULL}
 };
@@ -464,10 +728,45 @@ PyTypeObject py_log_message_type =
   0,
 };
 
+static PyTypeObject py_log_message_handle_type =
+{
+  PyVarObject_HEAD_INIT(&PyType_Type, 0)
+  .tp_name = "LogMessageHandle",
+  .tp_basicsize = sizeof(PyLogMessageHandle),
+  .tp_dealloc = (destructor) PyObject_Del,
+  .tp_repr = (reprfunc) py_log_message_handle_repr,
+  .tp_flags = Py_TPFLAGS_DEFAULT,
+  .tp_doc = "Pre-resolved name-value pair name, as returned by LogMessage.handle()",
+  0,
+};
+
+static PyBufferProcs py_log_message_payload_buffer =
+{
+  .bf_getbuffer = py_log_message_payload_getbuffer,
+};
+
+static PyTypeObject py_log_message_payload_type =
+{
+  PyVarObject_HEAD_INIT(&PyType_Type, 0)
+  .tp_name = "LogMessagePayload",
+  .tp_basicsize = sizeof(PyLogMessagePayload),
+  .tp_dealloc = (destructor) py_log_message_payload_free,
+  .tp_flags = Py_TPFLAGS_DEFAULT,
+  .tp_doc = "Buffer backing the memoryviews returned by LogMessage.get_view()",
+  .tp_as_buffer = &py_log_message_payload_buffer,
+  0,
+};
+
 void
 py_log_message_global_init(void)
 {
   PyDateTime_IMPORT;
+  if (!interned_keys)
+    interned_keys = g_ptr_array_new();
+  if (!handles)
+    handles = g_ptr_array_new();
+  PyType_Ready(&py_log_message_handle_type);
+  PyType_Ready(&py_log_message_payload_type);
   PyType_Ready(&py_log_message_type);
   PyModule_AddObject(PyImport_AddModule("_syslogng"), "LogMessage", (PyObject *) &py_log_message_type);
 }
@@ -33,6 +33,8 @@ typedef struct _PyLogMessage
   LogMessage *msg;
   PyObject *bookmark_data;
   gboolean cast_to_bytes;
+  /* memoryviews over msg->payload and msg->payload_parent, see get_view() */
+  PyObject *payload_views[2];
 } PyLogMessage;
 
 extern PyTypeObject py_log_message_type;
@@ -32,6 +32,7 @@ typedef struct
   LogParser super;
 
   PythonBinding binding;
+  FilterExprNode *condition;
   struct
   {
     PyObject *class;
@@ -61,6 +62,16 @@ python_parser_get_binding(LogParser *d)
   return &self->binding;
 }
 
+void
+python_parser_set_condition(LogParser *s, FilterExprNode *condition)
+{
+  PythonParser *self = (PythonParser *)s;
+
+  if (self->condition)
+    filter_expr_unref(self->condition);
+  self->condition = condition;
+}
+
 static gboolean
 _pp_py_invoke_bool_function(PythonParser *self, PyObject *func, PyObject *arg)
 {
@@ -196,6 +207,17 @@ python_parser_process(LogParser *s, LogMessage **pmsg, const LogPathOptions *pat
   PyGILState_STATE gstate;
   gboolean result;
 
+  /* evaluate the pre-filter without the GIL, messages that do not match
+   * are passed through unchanged without ever entering Python */
+  if (self->condition && !filter_expr_eval_root(self->condition, pmsg, path_options))
+    {
+      msg_trace("python-parser condition unmatched, skipping parse()",
+                evt_tag_str("parser", self->super.name),
+                evt_tag_str("class", self->binding.class),
+                evt_tag_msg_reference(*pmsg));
+      return TRUE;
+    }
+
   gstate = PyGILState_Ensure();
   {
     LogMessage *msg = log_msg_make_writable(pmsg, path_options);
@@ -225,6 +247,9 @@ python_parser_init(LogPipe *s)
   if (!log_parser_init_method(s))
     return FALSE;
 
+  if (self->condition && !filter_expr_init(self->condition, cfg))
+    return FALSE;
+
   if (!python_binding_init(&self->binding, cfg, self->super.name))
     return FALSE;
 
@@ -270,6 +295,8 @@ python_parser_free(LogPipe *d)
   _py_free_bindings(self);
   PyGILState_Release(gstate);
 
+  if (self->condition)
+    filter_expr_unref(self->condition);
   python_binding_clear(&self->binding);
   log_parser_free_method(d);
 }
@@ -281,6 +308,7 @@ python_parser_clone(LogPipe *s)
   PythonParser *cloned = (PythonParser *) python_parser_new(log_pipe_get_config(s));
   log_parser_clone_settings(&self->super, &cloned->super);
   python_binding_clone(&self->binding, &cloned->binding);
+  cloned->condition = filter_expr_clone(self->condition);
   return &cloned->super.super;
 }
 
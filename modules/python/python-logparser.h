@@ -27,9 +27,11 @@
 #include "python-binding.h"
 #include "parser/parser-expr.h"
 #include "value-pairs/value-pairs.h"
+#include "filter/filter-expr.h"
 
 LogParser *python_parser_new(GlobalConfig *cfg);
 PythonBinding *python_parser_get_binding(LogParser  *s);
+void python_parser_set_condition(LogParser *s, FilterExprNode *condition);
 
 void py_log_parser_global_init(void);
 
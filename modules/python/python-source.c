@@ -44,6 +44,7 @@ struct _PythonSourceDriver
   ThreadId thread_id;
 
   void (*post_message)(PythonSourceDriver *self, LogMessage *msg);
+  gsize (*post_batch)(PythonSourceDriver *self, LogMessage **msgs, gsize len);
 
   struct
   {
@@ -486,6 +487,29 @@ _post_message_blocking(PythonSourceDriver *self, LogMessage *msg)
   PyEval_RestoreThread(state);
 }
 
+static gsize
+_post_batch_non_blocking(PythonSourceDriver *self, LogMessage **msgs, gsize len)
+{
+  PyThreadState *state = PyEval_SaveThread();
+  gsize posted = log_threaded_source_post_batch(&self->super, msgs, len);
+  PyEval_RestoreThread(state);
+
+  if (!log_threaded_source_free_to_send(&self->super))
+    python_sd_suspend(self);
+
+  return posted;
+}
+
+static gsize
+_post_batch_blocking(PythonSourceDriver *self, LogMessage **msgs, gsize len)
+{
+  PyThreadState *state = PyEval_SaveThread();
+  log_threaded_source_blocking_post_batch(&self->super, msgs, len);
+  PyEval_RestoreThread(state);
+
+  return len;
+}
+
 static gboolean
 _py_sd_init(PythonSourceDriver *self)
 {
@@ -596,6 +620,102 @@ py_log_source_post(PyObject *s, PyObject *args, PyObject *kwrds)
   Py_RETURN_NONE;
 }
 
+/* posts the collected messages, drops the references of those that could
+ * not be posted, returns TRUE if all of them were posted */
+static gboolean
+_py_sd_post_batch_segment(PythonSourceDriver *sd, LogMessage **msgs, gsize len, gsize *posted)
+{
+  if (len == 0)
+    return TRUE;
+
+  gsize n = sd->post_batch(sd, msgs, len);
+  for (gsize i = n; i < len; i++)
+    log_msg_unref(msgs[i]);
+
+  *posted += n;
+  return n == len;
+}
+
+static PyObject *
+py_log_source_post_batch(PyObject *s, PyObject *args, PyObject *kwrds)
+{
+  PyLogSource *self = (PyLogSource *) s;
+
+  if (self->driver->thread_id != get_thread_id())
+    {
+      PyErr_Format(PyExc_RuntimeError, "post_batch() must be called from main thread");
+      return NULL;
+    }
+
+  PythonSourceDriver *sd = self->driver;
+  PyObject *py_msgs;
+
+  static const gchar *kwlist[] = {"msgs", NULL};
+  if (!PyArg_ParseTupleAndKeywords(args, kwrds, "O", (gchar **) kwlist, &py_msgs))
+    return NULL;
+
+  PyObject *seq = PySequence_Fast(py_msgs, "post_batch() expects a sequence of LogMessage objects");
+  if (!seq)
+    return NULL;
+
+  Py_ssize_t len = PySequence_Fast_GET_SIZE(seq);
+  PyObject **items = PySequence_Fast_ITEMS(seq);
+  for (Py_ssize_t i = 0; i < len; i++)
+    {
+      if (!py_is_log_message(items[i]))
+        {
+          PyErr_Format(PyExc_TypeError, "LogMessage expected in the batch, got %s at index %zd",
+                       Py_TYPE(items[i])->tp_name, i);
+          Py_DECREF(seq);
+          return NULL;
+        }
+    }
+
+  /* messages carrying a bookmark are posted one by one, as the bookmark
+   * is requested right before posting its message */
+  LogMessage **msgs = g_new(LogMessage *, len);
+  gsize num_msgs = 0;
+  gsize posted = 0;
+  gboolean error = FALSE;
+
+  for (Py_ssize_t i = 0; i < len; i++)
+    {
+      PyLogMessage *pymsg = (PyLogMessage *) items[i];
+
+      if (!pymsg->bookmark_data || pymsg->bookmark_data == Py_None)
+        {
+          msgs[num_msgs++] = log_msg_ref(pymsg->msg);
+          continue;
+        }
+
+      if (!_py_sd_post_batch_segment(sd, msgs, num_msgs, &posted))
+        goto exit;
+      num_msgs = 0;
+
+      if (!log_threaded_source_free_to_send(&sd->super))
+        goto exit;
+
+      if (!_py_sd_fill_bookmark(sd, pymsg))
+        {
+          error = TRUE;
+          goto exit;
+        }
+
+      sd->post_message(sd, log_msg_ref(pymsg->msg));
+      posted++;
+    }
+
+  _py_sd_post_batch_segment(sd, msgs, num_msgs, &posted);
+
+exit:
+  g_free(msgs);
+  Py_DECREF(seq);
+
+  if (error)
+    return NULL;
+  return PyLong_FromSize_t(posted);
+}
+
 static PyObject *
 py_log_source_close_batch(PyObject *s)
 {
@@ -680,6 +800,7 @@ python_sd_init(LogPipe *s)
   if (self->py.suspend_method && self->py.wakeup_method)
     {
       self->post_message = _post_message_non_blocking;
+      self->post_batch = _post_batch_non_blocking;
       self->super.wakeup = python_sd_wakeup;
     }
 
@@ -738,6 +859,7 @@ python_sd_new(GlobalConfig *cfg)
   self->super.run = python_sd_run;
 
   self->post_message = _post_message_blocking;
+  self->post_batch = _post_batch_blocking;
 
   python_binding_init_instance(&self->binding);
 
@@ -748,6 +870,7 @@ python_sd_new(GlobalConfig *cfg)
 static PyMethodDef py_log_source_methods[] =
 {
   { "post_message", (PyCFunction) py_log_source_post, METH_VARARGS | METH_KEYWORDS, "Post message" },
+  { "post_batch", (PyCFunction) py_log_source_post_batch, METH_VARARGS | METH_KEYWORDS, "Post messages" },
   { "close_batch", (PyCFunction) py_log_source_close_batch, METH_NOARGS, "Close input batch" },
   {NULL}
 };
@@ -0,0 +1,406 @@
+/*
+ * Copyright (c) 2024 One Identity LLC.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+/* this has to come first for modules which include the Python.h header */
+#include "python-module.h"
+
+#include <criterion/criterion.h>
+#include "libtest/grab-logging.h"
+
+/* the messages acked or dropped one by one after send_batch() are counted */
+#define log_threaded_dest_worker_ack_messages _mock_ack_messages
+#define log_threaded_dest_worker_drop_messages _mock_drop_messages
+
+/* the Python objects of the workers are checked from the inside */
+#include "python-dest.c"
+
+#undef log_threaded_dest_worker_ack_messages
+#undef log_threaded_dest_worker_drop_messages
+#include "apphook.h"
+#include "python-main.h"
+#include "python-startup.h"
+#include "python-global.h"
+#include "mainloop-worker.h"
+#include "mainloop.h"
+
+MainLoop *main_loop;
+MainLoopOptions main_loop_options = {0};
+
+CFG_LTYPE yyltype;
+GlobalConfig *empty_cfg;
+
+static LogDriver *driver;
+static gint acked_messages;
+static gint dropped_messages;
+
+void
+_mock_ack_messages(LogThreadedDestWorker *self, gint batch_size)
+{
+  acked_messages += batch_size;
+}
+
+void
+_mock_drop_messages(LogThreadedDestWorker *self, gint batch_size)
+{
+  dropped_messages += batch_size;
+}
+
+/* the instances initialized and deinitialized are collected by the class */
+const gchar *python_destination_code = "\n\
+from _syslogng import LogDestination\n\
+class Dest(LogDestination):\n\
+    inits = []\n\
+    deinits = []\n\
+    def init(self, options):\n\
+        Dest.inits.append(self)\n\
+        return True\n\
+    def deinit(self):\n\
+        Dest.deinits.append(self)\n\
+    def send(self, message):\n\
+        return True";
+
+/* the instance of the third worker fails to initialize */
+const gchar *python_failing_destination_code = "\n\
+from _syslogng import LogDestination\n\
+class Dest(LogDestination):\n\
+    inits = []\n\
+    def init(self, options):\n\
+        Dest.inits.append(self)\n\
+        return len(Dest.inits) < 3\n\
+    def send(self, message):\n\
+        return True";
+
+/* the batches are collected by the class, the results are queued up by the test */
+const gchar *python_batch_destination_code = "\n\
+from _syslogng import LogDestination, LogDestinationResult\n\
+class Dest(LogDestination):\n\
+    batches = []\n\
+    results = []\n\
+    def send_batch(self, messages):\n\
+        Dest.batches.append([m['MESSAGE'] for m in messages])\n\
+        return Dest.results.pop(0)";
+
+static void
+_load_code(const gchar *code)
+{
+  PyGILState_STATE gstate;
+  gstate = PyGILState_Ensure();
+  cr_assert(python_evaluate_global_code(empty_cfg, code, &yyltype));
+  PyGILState_Release(gstate);
+}
+
+static PythonDestDriver *
+_create_driver(gint num_workers)
+{
+  driver = python_dd_new(empty_cfg);
+  python_binding_set_class(python_dd_get_binding(driver), "Dest");
+  log_threaded_dest_driver_set_num_workers(driver, num_workers);
+  return (PythonDestDriver *) driver;
+}
+
+/* NOTE: the GIL must be held */
+static Py_ssize_t
+_get_list_length(PythonDestDriver *self, const gchar *name)
+{
+  PyObject *list = PyObject_GetAttrString(self->py.class, name);
+  cr_assert_not_null(list);
+
+  Py_ssize_t len = PyList_Size(list);
+  Py_DECREF(list);
+  return len;
+}
+
+/* NOTE: the GIL must be held */
+static gboolean
+_list_contains(PythonDestDriver *self, const gchar *name, PyObject *item)
+{
+  PyObject *list = PyObject_GetAttrString(self->py.class, name);
+  cr_assert_not_null(list);
+
+  gint contains = PySequence_Contains(list, item);
+  Py_DECREF(list);
+  return contains == 1;
+}
+
+static PythonDestWorker *
+_get_worker(PythonDestDriver *self, gint index)
+{
+  return (PythonDestWorker *) self->super.workers[index];
+}
+
+/* the next call of send_batch() returns the result of this Python expression */
+static void
+_queue_batch_result(PythonDestDriver *self, const gchar *expression)
+{
+  PyGILState_STATE gstate = PyGILState_Ensure();
+
+  PyObject *globals = PyDict_New();
+  PyDict_SetItemString(globals, "__builtins__", PyEval_GetBuiltins());
+  PyObject *module = PyImport_ImportModule("_syslogng");
+  cr_assert_not_null(module);
+  PyObject *result_enum = PyObject_GetAttrString(module, "LogDestinationResult");
+  cr_assert_not_null(result_enum);
+  PyDict_SetItemString(globals, "LogDestinationResult", result_enum);
+
+  PyObject *result = PyRun_String(expression, Py_eval_input, globals, globals);
+  cr_assert_not_null(result, "invalid result expression: %s", expression);
+
+  PyObject *results = PyObject_GetAttrString(self->py.class, "results");
+  PyList_Append(results, result);
+
+  Py_DECREF(results);
+  Py_DECREF(result);
+  Py_DECREF(result_enum);
+  Py_DECREF(module);
+  Py_DECREF(globals);
+  PyGILState_Release(gstate);
+}
+
+static void
+_insert_messages(PythonDestWorker *worker, const gchar **messages)
+{
+  for (gint i = 0; messages[i]; i++)
+    {
+      LogMessage *msg = log_msg_new_empty();
+      log_msg_set_value(msg, LM_V_MESSAGE, messages[i], -1);
+      cr_assert_eq(python_dw_insert(&worker->super, msg), LTR_QUEUED, "send_batch() is not deferred to the flush");
+      log_msg_unref(msg);
+    }
+}
+
+/* NOTE: the GIL must be held */
+static void
+_assert_batch(PythonDestDriver *self, gint index, const gchar **expected)
+{
+  PyObject *batches = PyObject_GetAttrString(self->py.class, "batches");
+  PyObject *batch = PyList_GetItem(batches, index);
+  cr_assert_not_null(batch, "send_batch() is not called for batch #%d", index);
+
+  gint len = 0;
+  for (; expected[len]; len++)
+    {
+      PyObject *message = PyList_GetItem(batch, len);
+      cr_assert_not_null(message, "message #%d is missing from batch #%d", len, index);
+      cr_assert_str_eq(PyBytes_AsString(message), expected[len]);
+    }
+  cr_assert_eq(PyList_Size(batch), len, "batch #%d has unexpected messages", index);
+  Py_DECREF(batches);
+}
+
+Test(python_dest, test_every_worker_has_an_instance_of_its_own)
+{
+  _load_code(python_destination_code);
+  PythonDestDriver *self = _create_driver(3);
+
+  cr_assert(log_pipe_init(&driver->super));
+  main_loop_sync_worker_startup_and_teardown();
+
+  PyGILState_STATE gstate = PyGILState_Ensure();
+  cr_assert_eq(_get_worker(self, 0)->py.instance, self->py.instance, "the first worker uses the driver's instance");
+  for (gint i = 0; i < 3; i++)
+    {
+      PyObject *instance = _get_worker(self, i)->py.instance;
+
+      cr_assert_not_null(_get_worker(self, i)->py.send);
+      cr_assert(_list_contains(self, "inits", instance), "init() is not called for worker #%d", i);
+      for (gint j = 0; j < i; j++)
+        cr_assert_neq(instance, _get_worker(self, j)->py.instance, "workers #%d and #%d share an instance", j, i);
+    }
+  cr_assert_eq(_get_list_length(self, "inits"), 3);
+
+  /* seqnum of the class still belongs to the first worker */
+  PyObject *class_seqnum = PyObject_GetAttrString(self->py.class, "seqnum");
+  PyObject *worker_seqnum = PyObject_GetAttrString(_get_worker(self, 1)->py.instance, "seqnum");
+  cr_assert_neq(class_seqnum, worker_seqnum, "the workers share their sequence numbers");
+  Py_XDECREF(class_seqnum);
+  Py_XDECREF(worker_seqnum);
+  PyGILState_Release(gstate);
+
+  cr_assert(log_pipe_deinit(&driver->super));
+
+  gstate = PyGILState_Ensure();
+  cr_assert_eq(_get_list_length(self, "deinits"), 3, "deinit() is not called for every instance");
+  PyGILState_Release(gstate);
+}
+
+Test(python_dest, test_a_single_worker_uses_the_instance_of_the_driver)
+{
+  _load_code(python_destination_code);
+  PythonDestDriver *self = _create_driver(1);
+
+  cr_assert(log_pipe_init(&driver->super));
+  main_loop_sync_worker_startup_and_teardown();
+
+  PyGILState_STATE gstate = PyGILState_Ensure();
+  cr_assert_eq(_get_worker(self, 0)->py.instance, self->py.instance);
+  cr_assert_eq(_get_list_length(self, "inits"), 1);
+  PyGILState_Release(gstate);
+
+  cr_assert(log_pipe_deinit(&driver->super));
+
+  gstate = PyGILState_Ensure();
+  cr_assert_eq(_get_list_length(self, "deinits"), 1, "the instance is deinitialized more than once");
+  PyGILState_Release(gstate);
+}
+
+Test(python_dest, test_failing_init_of_a_worker_instance_fails_the_driver)
+{
+  _load_code(python_failing_destination_code);
+  PythonDestDriver *self = _create_driver(3);
+
+  cr_assert_not(log_pipe_init(&driver->super));
+  assert_grabbed_log_contains("python-dest: Error initializing Python driver object, init() returned FALSE");
+
+  PyGILState_STATE gstate = PyGILState_Ensure();
+  cr_assert_eq(_get_list_length(self, "inits"), 3);
+  PyGILState_Release(gstate);
+}
+
+Test(python_dest, test_send_batch_receives_the_whole_batch_at_once)
+{
+  _load_code(python_batch_destination_code);
+  PythonDestDriver *self = _create_driver(1);
+
+  cr_assert(log_pipe_init(&driver->super));
+  main_loop_sync_worker_startup_and_teardown();
+  cr_assert_eq(self->super.batch_lines, PYTHON_DEST_DEFAULT_BATCH_LINES, "batching is not enabled by send_batch()");
+
+  PythonDestWorker *worker = _get_worker(self, 0);
+  cr_assert_not_null(worker->py.send_batch);
+
+  _queue_batch_result(self, "True");
+  _insert_messages(worker, (const gchar *[]) { "first", "second", "third", NULL });
+  cr_assert_eq(worker->batch->len, 3);
+
+  cr_assert_eq(python_dw_flush(&worker->super, LTF_FLUSH_NORMAL), LTR_SUCCESS);
+  cr_assert_eq(worker->batch->len, 0, "the batch is not cleared after the flush");
+  cr_assert_eq(acked_messages, 0, "a single result is acked by the threaded destination, not one by one");
+
+  /* nothing to send */
+  cr_assert_eq(python_dw_flush(&worker->super, LTF_FLUSH_NORMAL), LTR_SUCCESS);
+
+  PyGILState_STATE gstate = PyGILState_Ensure();
+  cr_assert_eq(_get_list_length(self, "batches"), 1);
+  _assert_batch(self, 0, (const gchar *[]) { "first", "second", "third", NULL });
+  PyGILState_Release(gstate);
+
+  cr_assert(log_pipe_deinit(&driver->super));
+}
+
+Test(python_dest, test_per_message_results_of_send_batch)
+{
+  _load_code(python_batch_destination_code);
+  PythonDestDriver *self = _create_driver(1);
+
+  cr_assert(log_pipe_init(&driver->super));
+  main_loop_sync_worker_startup_and_teardown();
+  PythonDestWorker *worker = _get_worker(self, 0);
+
+  /* the leading successes and drops are acked, the first failure decides the rest of the batch */
+  _queue_batch_result(self, "[True, LogDestinationResult.DROP, LogDestinationResult.NOT_CONNECTED, True]");
+  _insert_messages(worker, (const gchar *[]) { "first", "second", "third", "fourth", NULL });
+  cr_assert_eq(python_dw_flush(&worker->super, LTF_FLUSH_NORMAL), LTR_NOT_CONNECTED);
+  cr_assert_eq(acked_messages, 1);
+  cr_assert_eq(dropped_messages, 1);
+
+  /* every message is acked or dropped explicitly */
+  _queue_batch_result(self, "(LogDestinationResult.SUCCESS, LogDestinationResult.DROP)");
+  _insert_messages(worker, (const gchar *[]) { "third", "fourth", NULL });
+  cr_assert_eq(python_dw_flush(&worker->super, LTF_FLUSH_NORMAL), LTR_EXPLICIT_ACK_MGMT);
+  cr_assert_eq(acked_messages, 2);
+  cr_assert_eq(dropped_messages, 2);
+
+  /* results that do not add up are not applied to any of the messages */
+  _queue_batch_result(self, "[True]");
+  _insert_messages(worker, (const gchar *[]) { "fifth", "sixth", NULL });
+  cr_assert_eq(python_dw_flush(&worker->super, LTF_FLUSH_NORMAL), LTR_ERROR);
+  assert_grabbed_log_contains("The number of results returned by send_batch() does not match the size of the batch");
+  cr_assert_eq(acked_messages, 2);
+
+  /* messages can not be queued by send_batch(), the threaded destination would never ack them */
+  _queue_batch_result(self, "[LogDestinationResult.QUEUED]");
+  _insert_messages(worker, (const gchar *[]) { "seventh", NULL });
+  cr_assert_eq(python_dw_flush(&worker->super, LTF_FLUSH_NORMAL), LTR_ERROR);
+  assert_grabbed_log_contains("Invalid result returned by send_batch(), QUEUED can only be used with send()");
+
+  PyGILState_STATE gstate = PyGILState_Ensure();
+  cr_assert_eq(_get_list_length(self, "batches"), 4);
+  _assert_batch(self, 1, (const gchar *[]) { "third", "fourth", NULL });
+  PyGILState_Release(gstate);
+
+  cr_assert(log_pipe_deinit(&driver->super));
+}
+
+Test(python_dest, test_messages_are_sent_one_by_one_without_send_batch)
+{
+  _load_code(python_destination_code);
+  PythonDestDriver *self = _create_driver(1);
+
+  cr_assert(log_pipe_init(&driver->super));
+  main_loop_sync_worker_startup_and_teardown();
+  cr_assert_eq(self->super.batch_lines, -1, "batching is enabled without send_batch()");
+
+  PythonDestWorker *worker = _get_worker(self, 0);
+  cr_assert_null(worker->py.send_batch);
+
+  LogMessage *msg = log_msg_new_empty();
+  log_msg_set_value(msg, LM_V_MESSAGE, "message", -1);
+  cr_assert_eq(python_dw_insert(&worker->super, msg), LTR_SUCCESS, "the message is not passed to send()");
+  log_msg_unref(msg);
+
+  cr_assert_eq(worker->batch->len, 0, "the message is batched without send_batch()");
+  cr_assert_eq(python_dw_flush(&worker->super, LTF_FLUSH_NORMAL), LTR_SUCCESS);
+
+  cr_assert(log_pipe_deinit(&driver->super));
+}
+
+static void
+setup(void)
+{
+  app_startup();
+
+  main_loop = main_loop_get_instance();
+  main_loop_init(main_loop, &main_loop_options);
+
+  _py_init_interpreter(FALSE);
+
+  empty_cfg = cfg_new_snippet();
+  start_grabbing_messages();
+}
+
+static void
+teardown(void)
+{
+  stop_grabbing_messages();
+  acked_messages = 0;
+  dropped_messages = 0;
+  if (driver)
+    {
+      log_pipe_unref(&driver->super);
+      driver = NULL;
+    }
+  cfg_free(empty_cfg);
+  main_loop_deinit(main_loop);
+  app_shutdown();
+}
+
+TestSuite(python_dest, .init = setup, .fini = teardown);
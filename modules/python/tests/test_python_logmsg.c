@@ -405,6 +405,82 @@ Test(python_log_message, test_python_logmessage_get_with_default_value)
   PyGILState_Release(gstate);
 }
 
+Test(python_log_message, test_python_logmessage_get_view)
+{
+  LogMessage *msg = log_msg_new_empty();
+  log_msg_set_value_by_name(msg, "field", "value", -1);
+
+  PyGILState_STATE gstate;
+  gstate = PyGILState_Ensure();
+  {
+    cfg_set_version_without_validation(configuration, VERSION_VALUE_4_0);
+    PyObject *msg_object = py_log_message_new(msg, configuration);
+    PyDict_SetItemString(_python_main_dict, "test_msg", msg_object);
+
+    _run_scripts("view = test_msg.get_view('field')");
+    _assert_python_variable_value("type(view)", "memoryview");
+    _assert_python_variable_value("view.readonly", "True");
+    _assert_python_variable_value("bytes(view)", "b'value'");
+
+    /* the view references the payload, which is moved when it grows */
+    for (gint i = 0; i < 64; i++)
+      {
+        gchar name[32];
+
+        g_snprintf(name, sizeof(name), "filler%d", i);
+        log_msg_set_value_by_name(msg, name, "a longer value that does not fit into the original payload", -1);
+      }
+    _assert_python_variable_value("bytes(view)", "b'value'");
+    _assert_python_variable_value("bytes(test_msg.get_view('filler63')[:8])", "b'a longer'");
+
+    /* macros are not stored in the payload, these are copied */
+    _run_scripts("view = test_msg.get_view('PRIORITY')");
+    _assert_python_variable_value("type(view)", "memoryview");
+
+    _run_scripts("result = test_msg.get_view('nonexistent')");
+    _assert_python_variable_value("result", "None");
+
+    _run_scripts("result = test_msg.get_view('nonexistent', default=-1)");
+    _assert_python_variable_value("result", "-1");
+
+    Py_XDECREF(msg_object);
+  }
+  PyGILState_Release(gstate);
+  log_msg_unref(msg);
+}
+
+Test(python_log_message, test_python_logmessage_handle)
+{
+  LogMessage *msg = log_msg_new_empty();
+  log_msg_set_value_by_name(msg, "field", "value", -1);
+
+  PyGILState_STATE gstate;
+  gstate = PyGILState_Ensure();
+  {
+    cfg_set_version_without_validation(configuration, VERSION_VALUE_4_0);
+    PyObject *msg_object = py_log_message_new(msg, configuration);
+    PyDict_SetItemString(_python_main_dict, "test_msg", msg_object);
+
+    _run_scripts("from _syslogng import LogMessage\n"
+                 "field = LogMessage.handle('field')");
+    _assert_python_variable_value("field is LogMessage.handle(b'field')", "True");
+    _assert_python_variable_value("repr(field)", "'LogMessageHandle(field)'");
+
+    _assert_python_variable_value("test_msg[field]", "'value'");
+    _assert_python_variable_value("test_msg.get(field)", "'value'");
+    _assert_python_variable_value("test_msg.get_as_str(field)", "'value'");
+    _assert_python_variable_value("bytes(test_msg.get_view(field))", "b'value'");
+    _assert_python_variable_value("test_msg.get(LogMessage.handle('nonexistent'), -1)", "-1");
+
+    _run_scripts("test_msg[LogMessage.handle('other')] = 'other value'");
+    cr_assert_str_eq(log_msg_get_value_by_name(msg, "other", NULL), "other value");
+
+    Py_XDECREF(msg_object);
+  }
+  PyGILState_Release(gstate);
+  log_msg_unref(msg);
+}
+
 ParameterizedTestParameters(python_log_message, test_python_logmessage_get_as_str)
 {
   static PyLogMessageGetTestParams test_data_list[] =
@@ -793,6 +869,13 @@ Test(python_log_message, test_python_logmessage_keys)
                 || handle == LM_V_PID, "Unexpected key found in PyLogMessage: %s", key);
     }
 
+  PyObject *keys_again = _py_invoke_method_by_name(py_msg, "keys", NULL, "PyLogMessageTest", NULL);
+  cr_assert_not_null(keys_again);
+  cr_assert_eq(PyList_Size(keys), PyList_Size(keys_again));
+  for (Py_ssize_t i = 0; i < PyList_Size(keys); ++i)
+    cr_assert(PyList_GetItem(keys, i) == PyList_GetItem(keys_again, i), "keys are expected to be interned");
+
+  Py_XDECREF(keys_again);
   Py_XDECREF(keys);
   Py_XDECREF(py_msg);
   PyGILState_Release(gstate);
@@ -24,94 +24,224 @@
 #include "timeutils/misc.h"
 #include "scratch-buffers.h"
 #include "str-utils.h"
+#include "atomic-gssize.h"
+#include "messages.h"
+
+#define RATE_LIMIT_SHARDS 16
+#define RATE_LIMIT_SWEEP_INTERVAL_SEC 10
+#define RATE_LIMIT_TOP_DROPPED_KEYS 5
+
+/* The limiters are distributed among shards by the hash of their key, the
+ * shard lock only protects the lookup, the buckets themselves are updated
+ * with atomic operations.
+ *
+ * A bucket holds at most "rate" tokens and is refilled at "rate" tokens
+ * per second, so a limiter that was idle for more than a second is
+ * indistinguishable from a new one: idle limiters are evicted by a
+ * periodic sweep.  Limiters are reference counted: the table holds one
+ * reference, and rate_limit_eval() takes another one under the shard lock
+ * for the duration of the evaluation, so an evicted limiter is freed by
+ * whichever of them lets it go last.
+ */
+typedef struct _RateLimitShard
+{
+  GMutex lock;
+  GHashTable *rate_limits;
+} RateLimitShard;
 
 typedef struct _RateLimit
 {
   FilterExprNode super;
   LogTemplate *key_template;
   gint rate;
-  GMutex map_lock;
-  GHashTable *rate_limits;
+  gint64 epoch;
+  gint next_sweep;
+  RateLimitShard shards[RATE_LIMIT_SHARDS];
 } RateLimit;
 
 typedef struct _RateLimiter
 {
+  gint ref_cnt;
   gint tokens;
   gint rate;
-  GTimeVal last_check;
-  GMutex lock;
+  gint dropped;
+  /* usec since RateLimit->epoch, may wrap around on 32 bit platforms,
+   * which is fine as only the difference of two close values is used */
+  atomic_gssize last_refill;
+
+  /* protected by the shard lock */
+  gint64 last_used;
 } RateLimiter;
 
+typedef struct _RateLimitDroppedKey
+{
+  gchar *key;
+  gint dropped;
+} RateLimitDroppedKey;
+
 static RateLimiter *
-rate_limiter_new(gint rate)
+rate_limiter_new(gint rate, gsize now)
 {
   RateLimiter *self = g_new0(RateLimiter, 1);
 
-  GTimeVal now;
-  g_get_current_time(&now);
-  self->last_check = now;
-  g_mutex_init(&self->lock);
+  self->ref_cnt = 1;
+  atomic_gssize_set(&self->last_refill, now);
   self->rate = rate;
   self->tokens = rate;
 
   return self;
 }
 
+static RateLimiter *
+rate_limiter_ref(RateLimiter *self)
+{
+  g_atomic_int_inc(&self->ref_cnt);
+  return self;
+}
+
 static void
-rate_limiter_free(RateLimiter *self)
+rate_limiter_unref(RateLimiter *self)
 {
-  g_mutex_clear(&self->lock);
-  g_free(self);
+  if (g_atomic_int_dec_and_test(&self->ref_cnt))
+    g_free(self);
 }
 
 static void
-rate_limiter_add_new_tokens(RateLimiter *self)
+rate_limiter_add_new_tokens(RateLimiter *self, gsize now)
 {
-  glong usec_since_last_fill;
+  gsize last_refill = atomic_gssize_get_unsigned(&self->last_refill);
+  gssize usec_since_last_fill = (gssize) (now - last_refill);
   gint num_new_tokens;
-  GTimeVal now;
-  g_get_current_time(&now);
-  g_mutex_lock(&self->lock);
-  {
-    usec_since_last_fill = g_time_val_diff(&now, &self->last_check);
 
-    num_new_tokens = (usec_since_last_fill * self->rate) / G_USEC_PER_SEC;
-    if (num_new_tokens)
-      {
-        self->tokens = MIN(self->rate, self->tokens + num_new_tokens);
-        self->last_check = now;
-      }
-  }
-  g_mutex_unlock(&self->lock);
+  if (usec_since_last_fill <= 0)
+    return;
+
+  if (usec_since_last_fill >= G_USEC_PER_SEC)
+    num_new_tokens = self->rate;
+  else
+    num_new_tokens = ((guint64) usec_since_last_fill * self->rate) / G_USEC_PER_SEC;
+
+  if (!num_new_tokens)
+    return;
+
+  /* the thread moving the timestamp forward is the one adding the tokens */
+  if (!atomic_gssize_compare_and_exchange(&self->last_refill, last_refill, now))
+    return;
+
+  gint tokens = g_atomic_int_get(&self->tokens);
+  while (tokens < self->rate &&
+         !g_atomic_int_compare_and_exchange(&self->tokens, tokens, MIN(self->rate, tokens + num_new_tokens)))
+    tokens = g_atomic_int_get(&self->tokens);
 }
 
 static gboolean
 rate_limiter_try_consume_tokens(RateLimiter *self, gint num_tokens)
 {
-  gboolean within_ratelimit;
-  g_mutex_lock(&self->lock);
-  {
-    if (self->tokens >= num_tokens)
-      {
-        self->tokens -= num_tokens;
-        within_ratelimit = TRUE;
-      }
-    else
-      {
-        within_ratelimit = FALSE;
-      }
-  }
-  g_mutex_unlock(&self->lock);
-  return within_ratelimit;
+  gint tokens = g_atomic_int_get(&self->tokens);
+
+  while (tokens >= num_tokens)
+    {
+      if (g_atomic_int_compare_and_exchange(&self->tokens, tokens, tokens - num_tokens))
+        return TRUE;
+      tokens = g_atomic_int_get(&self->tokens);
+    }
+
+  g_atomic_int_add(&self->dropped, num_tokens);
+  return FALSE;
 }
 
 static gboolean
-rate_limiter_process_new_logs(RateLimiter *self, gint num_new_logs)
+rate_limiter_process_new_logs(RateLimiter *self, gsize now, gint num_new_logs)
 {
-  rate_limiter_add_new_tokens(self);
+  rate_limiter_add_new_tokens(self, now);
   return rate_limiter_try_consume_tokens(self, num_new_logs);
 }
 
+static void
+_record_dropped_key(RateLimitDroppedKey *top, const gchar *key, gint dropped)
+{
+  gint i = RATE_LIMIT_TOP_DROPPED_KEYS - 1;
+
+  if (dropped <= top[i].dropped)
+    return;
+
+  g_free(top[i].key);
+  for (; i > 0 && top[i - 1].dropped < dropped; i--)
+    top[i] = top[i - 1];
+
+  top[i].key = g_strdup(key);
+  top[i].dropped = dropped;
+}
+
+static void
+_report_dropped_keys(RateLimitDroppedKey *top, gint total_dropped)
+{
+  GString *keys = scratch_buffers_alloc();
+
+  for (gint i = 0; i < RATE_LIMIT_TOP_DROPPED_KEYS && top[i].key; i++)
+    {
+      if (keys->len)
+        g_string_append(keys, ", ");
+      g_string_append_printf(keys, "%s=%d", top[i].key, top[i].dropped);
+      g_free(top[i].key);
+    }
+
+  msg_info("rate-limit(): messages dropped since the last report",
+           evt_tag_int("dropped", total_dropped),
+           evt_tag_int("interval", RATE_LIMIT_SWEEP_INTERVAL_SEC),
+           evt_tag_str("top_keys", keys->str));
+}
+
+static gint
+_sweep_shard(RateLimitShard *shard, gint64 idle_threshold, RateLimitDroppedKey *top)
+{
+  GHashTableIter iter;
+  gpointer key, value;
+  gint total_dropped = 0;
+
+  g_mutex_lock(&shard->lock);
+
+  g_hash_table_iter_init(&iter, shard->rate_limits);
+  while (g_hash_table_iter_next(&iter, &key, &value))
+    {
+      RateLimiter *rl = (RateLimiter *) value;
+      gint dropped = g_atomic_int_and(&rl->dropped, 0);
+
+      if (dropped)
+        {
+          total_dropped += dropped;
+          _record_dropped_key(top, key, dropped);
+        }
+
+      if (rl->last_used < idle_threshold)
+        g_hash_table_iter_remove(&iter);
+    }
+
+  g_mutex_unlock(&shard->lock);
+  return total_dropped;
+}
+
+static void
+rate_limit_maybe_sweep(RateLimit *self, gint64 now)
+{
+  gint now_sec = (now - self->epoch) / G_USEC_PER_SEC;
+  gint next_sweep = g_atomic_int_get(&self->next_sweep);
+
+  if (now_sec < next_sweep ||
+      !g_atomic_int_compare_and_exchange(&self->next_sweep, next_sweep, now_sec + RATE_LIMIT_SWEEP_INTERVAL_SEC))
+    return;
+
+  RateLimitDroppedKey top[RATE_LIMIT_TOP_DROPPED_KEYS] = { 0 };
+  gint64 idle_threshold = now - RATE_LIMIT_SWEEP_INTERVAL_SEC * G_USEC_PER_SEC;
+  gint total_dropped = 0;
+
+  for (gint i = 0; i < RATE_LIMIT_SHARDS; i++)
+    total_dropped += _sweep_shard(&self->shards[i], idle_threshold, top);
+
+  if (total_dropped)
+    _report_dropped_keys(top, total_dropped);
+}
+
 static const gchar *
 rate_limit_generate_key(FilterExprNode *s, LogMessage *msg, LogTemplateEvalOptions *options, gssize *len)
 {
@@ -146,21 +276,30 @@ rate_limit_eval(FilterExprNode *s, LogMessage **msgs, gint num_msg, LogTemplateE
   const gchar *key = rate_limit_generate_key(s, msg, options, &len);
   APPEND_ZERO(key, key, len);
 
+  gint64 now = g_get_monotonic_time();
+  gsize relative_now = now - self->epoch;
+  RateLimitShard *shard = &self->shards[g_str_hash(key) % RATE_LIMIT_SHARDS];
   RateLimiter *rl;
 
-  g_mutex_lock(&self->map_lock);
+  g_mutex_lock(&shard->lock);
   {
-    rl = g_hash_table_lookup(self->rate_limits, key);
+    rl = g_hash_table_lookup(shard->rate_limits, key);
 
     if (!rl)
       {
-        rl = rate_limiter_new(self->rate);
-        g_hash_table_insert(self->rate_limits, g_strdup(key), rl);
+        rl = rate_limiter_new(self->rate, relative_now);
+        g_hash_table_insert(shard->rate_limits, g_strdup(key), rl);
       }
+    rl->last_used = now;
+    rate_limiter_ref(rl);
   }
-  g_mutex_unlock(&self->map_lock);
+  g_mutex_unlock(&shard->lock);
+
+  gboolean result = rate_limiter_process_new_logs(rl, relative_now, num_msg);
+  rate_limiter_unref(rl);
 
-  return rate_limiter_process_new_logs(rl, num_msg) ^ s->comp;
+  rate_limit_maybe_sweep(self, now);
+  return result ^ s->comp;
 }
 
 static void
@@ -169,8 +308,13 @@ rate_limit_free(FilterExprNode *s)
   RateLimit *self = (RateLimit *) s;
 
   log_template_unref(self->key_template);
-  g_hash_table_destroy(self->rate_limits);
-  g_mutex_clear(&self->map_lock);
+  for (gint i = 0; i < RATE_LIMIT_SHARDS; i++)
+    {
+      RateLimitShard *shard = &self->shards[i];
+
+      g_hash_table_destroy(shard->rate_limits);
+      g_mutex_clear(&shard->lock);
+    }
 }
 
 static gboolean
@@ -224,8 +368,16 @@ rate_limit_new(void)
   self->super.eval = rate_limit_eval;
   self->super.free_fn = rate_limit_free;
   self->super.clone = rate_limit_clone;
-  g_mutex_init(&self->map_lock);
-  self->rate_limits = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, (GDestroyNotify)rate_limiter_free);
+  self->epoch = g_get_monotonic_time();
+  self->next_sweep = RATE_LIMIT_SWEEP_INTERVAL_SEC;
+  for (gint i = 0; i < RATE_LIMIT_SHARDS; i++)
+    {
+      RateLimitShard *shard = &self->shards[i];
+
+      g_mutex_init(&shard->lock);
+      shard->rate_limits = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+                                                 (GDestroyNotify) rate_limiter_unref);
+    }
 
   return &self->super;
 }
@@ -0,0 +1,180 @@
+/*
+ * Copyright (c) 2024 One Identity LLC.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#include <criterion/criterion.h>
+
+#include "rate-limit.c"
+#include "apphook.h"
+#include "cfg.h"
+
+#define NUM_EVALUATING_THREADS 4
+#define NUM_EVALUATIONS 20000
+#define NUM_HOSTS 64
+
+static FilterExprNode *
+_create_rate_limit(gint rate)
+{
+  FilterExprNode *s = rate_limit_new();
+  LogTemplate *key = log_template_new(configuration, NULL);
+
+  cr_assert(log_template_compile(key, "$HOST", NULL));
+  rate_limit_set_key_template(s, key);
+  rate_limit_set_rate(s, rate);
+  log_template_unref(key);
+
+  cr_assert(filter_expr_init(s, configuration));
+  return s;
+}
+
+static gboolean
+_eval_with_host(FilterExprNode *s, const gchar *host)
+{
+  LogMessage *msg = log_msg_new_empty();
+
+  log_msg_set_value(msg, LM_V_HOST, host, -1);
+  gboolean result = filter_expr_eval(s, msg);
+  log_msg_unref(msg);
+
+  return result;
+}
+
+static RateLimitShard *
+_get_shard(FilterExprNode *s, const gchar *key)
+{
+  RateLimit *self = (RateLimit *) s;
+
+  return &self->shards[g_str_hash(key) % RATE_LIMIT_SHARDS];
+}
+
+static gint
+_sweep_all_shards(FilterExprNode *s, gint64 idle_threshold)
+{
+  RateLimit *self = (RateLimit *) s;
+  RateLimitDroppedKey top[RATE_LIMIT_TOP_DROPPED_KEYS] = { 0 };
+  gint total_dropped = 0;
+
+  for (gint i = 0; i < RATE_LIMIT_SHARDS; i++)
+    total_dropped += _sweep_shard(&self->shards[i], idle_threshold, top);
+
+  for (gint i = 0; i < RATE_LIMIT_TOP_DROPPED_KEYS; i++)
+    g_free(top[i].key);
+
+  return total_dropped;
+}
+
+Test(rate_limit, idle_limiters_are_evicted_by_the_sweep)
+{
+  FilterExprNode *s = _create_rate_limit(1);
+  RateLimitShard *shard = _get_shard(s, "host1");
+
+  cr_assert(_eval_with_host(s, "host1"));
+  cr_assert_not(_eval_with_host(s, "host1"));
+
+  RateLimiter *rl = g_hash_table_lookup(shard->rate_limits, "host1");
+  cr_assert_not_null(rl);
+
+  cr_assert_eq(_sweep_all_shards(s, rl->last_used), 1, "the dropped message should be reported");
+  cr_assert_eq(g_hash_table_lookup(shard->rate_limits, "host1"), rl);
+
+  cr_assert_eq(_sweep_all_shards(s, rl->last_used + 1), 0);
+  cr_assert_null(g_hash_table_lookup(shard->rate_limits, "host1"));
+
+  cr_assert(_eval_with_host(s, "host1"), "an evicted limiter should be recreated with a full bucket");
+
+  filter_expr_unref(s);
+}
+
+Test(rate_limit, a_referenced_limiter_outlives_its_eviction)
+{
+  FilterExprNode *s = _create_rate_limit(2);
+  RateLimitShard *shard = _get_shard(s, "host1");
+
+  cr_assert(_eval_with_host(s, "host1"));
+
+  RateLimiter *rl = rate_limiter_ref(g_hash_table_lookup(shard->rate_limits, "host1"));
+  cr_assert_eq(rl->ref_cnt, 2);
+
+  _sweep_all_shards(s, G_MAXINT64);
+  cr_assert_null(g_hash_table_lookup(shard->rate_limits, "host1"));
+  cr_assert_eq(rl->ref_cnt, 1);
+
+  cr_assert(rate_limiter_process_new_logs(rl, 0, 1));
+  cr_assert_not(rate_limiter_process_new_logs(rl, 0, 1));
+  rate_limiter_unref(rl);
+
+  filter_expr_unref(s);
+}
+
+static gpointer
+_evaluate_thread(gpointer user_data)
+{
+  FilterExprNode *s = (FilterExprNode *) user_data;
+  gchar host[32];
+
+  for (gint i = 0; i < NUM_EVALUATIONS; i++)
+    {
+      g_snprintf(host, sizeof(host), "host%d", i % NUM_HOSTS);
+      if (!_eval_with_host(s, host))
+        return GINT_TO_POINTER(FALSE);
+    }
+
+  return GINT_TO_POINTER(TRUE);
+}
+
+Test(rate_limit, limiters_can_be_evicted_while_being_evaluated)
+{
+  FilterExprNode *s = _create_rate_limit(G_MAXINT / 2);
+  GThread *threads[NUM_EVALUATING_THREADS];
+  RateLimit *self = (RateLimit *) s;
+
+  for (gint i = 0; i < NUM_EVALUATING_THREADS; i++)
+    threads[i] = g_thread_new(NULL, _evaluate_thread, s);
+
+  /* evict every limiter over and over, while the threads keep using them */
+  for (gint i = 0; i < NUM_EVALUATIONS / 10; i++)
+    _sweep_all_shards(s, G_MAXINT64);
+
+  for (gint i = 0; i < NUM_EVALUATING_THREADS; i++)
+    cr_assert(GPOINTER_TO_INT(g_thread_join(threads[i])), "evaluation should not be rate limited");
+
+  _sweep_all_shards(s, G_MAXINT64);
+  for (gint i = 0; i < RATE_LIMIT_SHARDS; i++)
+    cr_assert_eq(g_hash_table_size(self->shards[i].rate_limits), 0);
+
+  filter_expr_unref(s);
+}
+
+static void
+setup(void)
+{
+  app_startup();
+  configuration = cfg_new_snippet();
+}
+
+static void
+teardown(void)
+{
+  cfg_free(configuration);
+  app_shutdown();
+}
+
+TestSuite(rate_limit, .init = setup, .fini = teardown);
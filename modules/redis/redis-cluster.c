@@ -0,0 +1,159 @@
+/*
+ * Copyright (c) 2024 One Identity LLC.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#include "redis-cluster.h"
+#include "messages.h"
+
+#include <string.h>
+
+RedisNode *
+redis_node_new(const gchar *host, gint port)
+{
+  RedisNode *self = g_new0(RedisNode, 1);
+
+  self->host = g_strdup(host);
+  self->port = port;
+
+  return self;
+}
+
+void
+redis_node_disconnect(RedisNode *self)
+{
+  if (self->c)
+    redisFree(self->c);
+  self->c = NULL;
+  self->pending_replies = 0;
+  self->in_transaction = FALSE;
+}
+
+void
+redis_node_free(RedisNode *self)
+{
+  redis_node_disconnect(self);
+  g_free(self->host);
+  g_free(self);
+}
+
+/* CRC16-CCITT (XMODEM), as used by Redis Cluster for key hashing */
+static guint16
+_crc16(const gchar *buf, gsize len)
+{
+  guint16 crc = 0;
+
+  for (gsize i = 0; i < len; i++)
+    {
+      crc ^= ((guint8) buf[i]) << 8;
+      for (gint bit = 0; bit < 8; bit++)
+        crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+    }
+
+  return crc;
+}
+
+/*
+ * Only the part between the first '{' and the following '}' is hashed if
+ * it is not empty (hash tags), so related keys can be kept in one slot.
+ */
+guint16
+redis_cluster_key_slot(const gchar *key, gsize key_len)
+{
+  const gchar *open = memchr(key, '{', key_len);
+
+  if (open)
+    {
+      const gchar *tag = open + 1;
+      const gchar *close = memchr(tag, '}', key_len - (tag - key));
+
+      if (close && close > tag)
+        return _crc16(tag, close - tag) % REDIS_CLUSTER_SLOTS;
+    }
+
+  return _crc16(key, key_len) % REDIS_CLUSTER_SLOTS;
+}
+
+gboolean
+redis_cluster_is_redirection(const redisReply *reply)
+{
+  if (!reply || reply->type != REDIS_REPLY_ERROR)
+    return FALSE;
+
+  return strncmp(reply->str, "MOVED ", 6) == 0 || strncmp(reply->str, "ASK ", 4) == 0;
+}
+
+static gint
+_lookup_or_add_node(GPtrArray *nodes, const gchar *host, gint port)
+{
+  for (guint i = 0; i < nodes->len; i++)
+    {
+      RedisNode *node = g_ptr_array_index(nodes, i);
+
+      if (node->port == port && strcmp(node->host, host) == 0)
+        return i;
+    }
+
+  g_ptr_array_add(nodes, redis_node_new(host, port));
+  return nodes->len - 1;
+}
+
+/*
+ * Processes the reply of CLUSTER SLOTS, each element of which is
+ * [start-slot, end-slot, [master-host, master-port, ...], replicas...].
+ * An empty host means the node we asked, nodes[0].
+ */
+gboolean
+redis_cluster_update_slots(GPtrArray *nodes, gint16 *slots, const redisReply *reply)
+{
+  const RedisNode *seed = g_ptr_array_index(nodes, 0);
+
+  if (!reply || reply->type != REDIS_REPLY_ARRAY)
+    return FALSE;
+
+  for (gint slot = 0; slot < REDIS_CLUSTER_SLOTS; slot++)
+    slots[slot] = -1;
+
+  for (gsize i = 0; i < reply->elements; i++)
+    {
+      const redisReply *range = reply->element[i];
+
+      if (range->type != REDIS_REPLY_ARRAY || range->elements < 3)
+        return FALSE;
+
+      const redisReply *master = range->element[2];
+      if (range->element[0]->type != REDIS_REPLY_INTEGER || range->element[1]->type != REDIS_REPLY_INTEGER ||
+          master->type != REDIS_REPLY_ARRAY || master->elements < 2 ||
+          master->element[0]->type != REDIS_REPLY_STRING || master->element[1]->type != REDIS_REPLY_INTEGER)
+        return FALSE;
+
+      long long start = range->element[0]->integer;
+      long long end = MIN(range->element[1]->integer, REDIS_CLUSTER_SLOTS - 1);
+      const gchar *host = master->element[0]->len > 0 ? master->element[0]->str : seed->host;
+      gint node_index = _lookup_or_add_node(nodes, host, (gint) master->element[1]->integer);
+
+      for (long long slot = MAX(start, 0); slot <= end; slot++)
+        slots[slot] = node_index;
+    }
+
+  msg_debug("REDIS cluster slot map updated",
+            evt_tag_int("nodes", nodes->len));
+  return TRUE;
+}
@@ -0,0 +1,52 @@
+/*
+ * Copyright (c) 2024 One Identity LLC.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#ifndef REDIS_CLUSTER_H_INCLUDED
+#define REDIS_CLUSTER_H_INCLUDED
+
+#include <hiredis/hiredis.h>
+
+#include "syslog-ng.h"
+
+#define REDIS_CLUSTER_SLOTS 16384
+
+/* a single Redis server, either the configured one or a cluster member */
+typedef struct _RedisNode
+{
+  gchar *host;
+  gint port;
+  redisContext *c;
+
+  /* pipelined commands whose replies are not read yet */
+  gint pending_replies;
+  gboolean in_transaction;
+} RedisNode;
+
+RedisNode *redis_node_new(const gchar *host, gint port);
+void redis_node_disconnect(RedisNode *self);
+void redis_node_free(RedisNode *self);
+
+guint16 redis_cluster_key_slot(const gchar *key, gsize key_len);
+gboolean redis_cluster_is_redirection(const redisReply *reply);
+gboolean redis_cluster_update_slots(GPtrArray *nodes, gint16 *slots, const redisReply *reply);
+
+#endif
@@ -36,6 +36,9 @@ static CfgLexerKeyword redis_keywords[] =
   { "port",     KW_PORT },
   { "auth",     KW_AUTH },
   { "timeout",  KW_TIMEOUT },
+  { "transaction", KW_TRANSACTION },
+  { "cluster",  KW_CLUSTER },
+  { "max_pending_replies", KW_MAX_PENDING_REPLIES },
   { NULL }
 };
 
@@ -30,10 +30,260 @@
 #include "utf8utils.h"
 
 
+static inline RedisNode *
+_seed_node(RedisDestWorker *self)
+{
+  return g_ptr_array_index(self->nodes, 0);
+}
+
+static inline void
+_trace_reply_message(redisReply *r)
+{
+  if (trace_flag)
+    {
+      if (r->elements > 0)
+        {
+          msg_trace(">>>>>> REDIS command reply begin",
+                    evt_tag_long("elements", r->elements));
+
+          for (gsize i = 0; i < r->elements; i++)
+            {
+              _trace_reply_message(r->element[i]);
+            }
+
+          msg_trace("<<<<<< REDIS command reply end");
+        }
+      else if (r->type == REDIS_REPLY_STRING || r->type == REDIS_REPLY_STATUS || r->type == REDIS_REPLY_ERROR)
+        {
+          msg_trace("REDIS command reply",
+                    evt_tag_str("str", r->str));
+        }
+      else
+        {
+          msg_trace("REDIS command unhandled reply",
+                    evt_tag_int("type", r->type));
+        }
+    }
+}
+
+static gboolean
+send_redis_command(RedisNode *node, const char *format, ...)
+{
+  va_list ap;
+  va_start(ap, format);
+  redisReply *reply = redisvCommand(node->c, format, ap);
+  va_end(ap);
+
+  gboolean retval = reply && (reply->type != REDIS_REPLY_ERROR);
+  if (reply)
+    {
+      _trace_reply_message(reply);
+      freeReplyObject(reply);
+    }
+  return retval;
+}
+
+static gboolean
+check_connection_to_redis(RedisNode *node)
+{
+  return send_redis_command(node, "ping");
+}
+
+static gboolean
+authenticate_to_redis(RedisNode *node, const gchar *password)
+{
+  return send_redis_command(node, "AUTH %s", password);
+}
+
+static gboolean
+_connect_node(RedisDestWorker *self, RedisNode *node)
+{
+  RedisDriver *owner = (RedisDriver *) self->super.owner;
+
+  if (node->c && check_connection_to_redis(node))
+    return TRUE;
+  else if (node->c)
+    redisReconnect(node->c);
+  else
+    node->c = redisConnectWithTimeout(node->host, node->port, owner->timeout);
+
+  node->pending_replies = 0;
+  node->in_transaction = FALSE;
+
+  if (node->c == NULL || node->c->err)
+    {
+      if (node->c)
+        {
+          msg_error("REDIS server error during connection",
+                    evt_tag_str("driver", owner->super.super.super.id),
+                    evt_tag_str("host", node->host),
+                    evt_tag_int("port", node->port),
+                    evt_tag_str("error", node->c->errstr),
+                    evt_tag_int("time_reopen", self->super.time_reopen));
+        }
+      else
+        {
+          msg_error("REDIS server can't allocate redis context");
+        }
+      return FALSE;
+    }
+
+  if (owner->auth)
+    if (!authenticate_to_redis(node, owner->auth))
+      {
+        msg_error("REDIS: failed to authenticate",
+                  evt_tag_str("driver", owner->super.super.super.id),
+                  evt_tag_str("host", node->host),
+                  evt_tag_int("port", node->port));
+        return FALSE;
+      }
+
+  if (!check_connection_to_redis(node))
+    {
+      msg_error("REDIS: failed to connect",
+                evt_tag_str("driver", owner->super.super.super.id),
+                evt_tag_str("host", node->host),
+                evt_tag_int("port", node->port));
+      return FALSE;
+    }
+
+  if (node->c->err)
+    return FALSE;
+
+  msg_debug("Connecting to REDIS succeeded",
+            evt_tag_str("driver", owner->super.super.super.id),
+            evt_tag_str("host", node->host),
+            evt_tag_int("port", node->port));
+
+  return TRUE;
+}
+
+static inline gboolean
+_ensure_node_connected(RedisDestWorker *self, RedisNode *node)
+{
+  if (node->c && !node->c->err)
+    return TRUE;
+
+  return _connect_node(self, node);
+}
+
+static gboolean
+_refresh_cluster_slots(RedisDestWorker *self)
+{
+  RedisDriver *owner = (RedisDriver *) self->super.owner;
+  RedisNode *seed = _seed_node(self);
+
+  if (!_ensure_node_connected(self, seed))
+    return FALSE;
+
+  redisReply *reply = redisCommand(seed->c, "CLUSTER SLOTS");
+  gboolean success = redis_cluster_update_slots(self->nodes, self->slots, reply);
+
+  if (!success)
+    {
+      msg_error("REDIS: failed to query the slots of the cluster",
+                evt_tag_str("driver", owner->super.super.super.id),
+                evt_tag_str("error", reply && reply->type == REDIS_REPLY_ERROR ? reply->str : seed->c->errstr));
+    }
+
+  if (reply)
+    freeReplyObject(reply);
+
+  self->slots_outdated = !success;
+  return success;
+}
+
+/* commands are routed by the slot of their first argument, the key */
+static RedisNode *
+_lookup_node(RedisDestWorker *self)
+{
+  if (!self->slots || self->argc < 2)
+    return _seed_node(self);
+
+  gint16 node_index = self->slots[redis_cluster_key_slot(self->argv[1], self->argvlen[1])];
+  return g_ptr_array_index(self->nodes, node_index >= 0 ? node_index : 0);
+}
+
+/* drops the pipelined commands of all nodes, without waiting for their replies */
+static void
+_abort_batch(RedisDestWorker *self)
+{
+  for (guint i = 0; i < self->nodes->len; i++)
+    redis_node_disconnect(g_ptr_array_index(self->nodes, i));
+}
+
+static gboolean
+_check_reply(RedisDestWorker *self, redisReply *reply)
+{
+  RedisDriver *owner = (RedisDriver *) self->super.owner;
+
+  _trace_reply_message(reply);
+
+  if (reply->type != REDIS_REPLY_ERROR)
+    return TRUE;
+
+  if (redis_cluster_is_redirection(reply))
+    self->slots_outdated = TRUE;
+
+  msg_error("REDIS server error",
+            evt_tag_str("driver", owner->super.super.super.id),
+            evt_tag_str("error", reply->str));
+  return FALSE;
+}
+
+/*
+ * Errors of individual commands do not fail the batch (the rest of it has
+ * been executed already), except for cluster redirections, where the
+ * batch is resent after the slots are refreshed, and for transactions,
+ * which are resent as a whole if EXEC fails.
+ */
+static LogThreadedResult
+_drain_replies(RedisDestWorker *self, RedisNode *node, gboolean exec_pending)
+{
+  RedisDriver *owner = (RedisDriver *) self->super.owner;
+  LogThreadedResult result = LTR_SUCCESS;
+
+  while (node->pending_replies > 0)
+    {
+      redisReply *reply;
+
+      if (redisGetReply(node->c, (void **) &reply) != REDIS_OK)
+        {
+          msg_error("REDIS server error while reading replies, suspending",
+                    evt_tag_str("driver", owner->super.super.super.id),
+                    evt_tag_str("host", node->host),
+                    evt_tag_int("port", node->port),
+                    evt_tag_str("error", node->c->errstr),
+                    evt_tag_int("time_reopen", self->super.time_reopen));
+          redis_node_disconnect(node);
+          return LTR_NOT_CONNECTED;
+        }
+      node->pending_replies--;
+
+      gboolean exec_reply = exec_pending && node->pending_replies == 0;
+      gboolean redirection = redis_cluster_is_redirection(reply);
+
+      if (!_check_reply(self, reply) && (exec_reply || redirection))
+        result = LTR_ERROR;
+
+      if (exec_reply && reply->type == REDIS_REPLY_NIL)
+        {
+          msg_error("REDIS transaction aborted",
+                    evt_tag_str("driver", owner->super.super.super.id));
+          result = LTR_ERROR;
+        }
+
+      freeReplyObject(reply);
+    }
+
+  return result;
+}
+
 static LogThreadedResult
 _flush(LogThreadedDestWorker *s, LogThreadedFlushMode mode)
 {
   RedisDestWorker *self = (RedisDestWorker *) s;
+  LogThreadedResult result = LTR_SUCCESS;
 
   if(s->batch_size == 0)
     {
@@ -42,28 +292,41 @@ _flush(LogThreadedDestWorker *s, LogThreadedFlushMode mode)
 
   if(mode == LTF_FLUSH_EXPEDITE)
     {
+      _abort_batch(self);
       return LTR_RETRY;
     }
 
-  if(self->c == NULL || self->c->err)
+  for (guint i = 0; i < self->nodes->len; i++)
     {
-      return LTR_ERROR;
-    }
+      RedisNode *node = g_ptr_array_index(self->nodes, i);
+      gboolean exec_pending = FALSE;
 
-  redisReply *reply;
-  for(gint i = s->batch_size; i > 0; i--)
-    {
-      if(redisGetReply(self->c, (void **)&reply) != REDIS_OK)
+      if (node->pending_replies == 0)
+        continue;
+
+      if (node->in_transaction)
         {
-          return LTR_ERROR;
+          if (redisAppendCommand(node->c, "EXEC") != REDIS_OK)
+            {
+              redis_node_disconnect(node);
+              result = LTR_NOT_CONNECTED;
+              continue;
+            }
+          node->pending_replies++;
+          node->in_transaction = FALSE;
+          exec_pending = TRUE;
         }
-      freeReplyObject(reply);
+
+      LogThreadedResult node_result = _drain_replies(self, node, exec_pending);
+      if (node_result == LTR_NOT_CONNECTED || result == LTR_SUCCESS)
+        result = node_result;
     }
-  return LTR_SUCCESS;
+
+  return result;
 }
 
 static inline void
-_fill_template(RedisDestWorker *self, LogMessage *msg, LogTemplate *template, gchar **str,
+_fill_template(RedisDestWorker *self, LogMessage *msg, LogTemplate *template, GString *buffer, gchar **str,
                gsize *size)
 {
   RedisDriver *owner = (RedisDriver *) self->super.owner;
@@ -76,7 +339,6 @@ _fill_template(RedisDestWorker *self, LogMessage *msg, LogTemplate *template, gc
     }
   else
     {
-      GString *buffer = scratch_buffers_alloc();
       LogTemplateEvalOptions options = {&owner->template_options, LTZ_SEND,
                                         self->super.seq_num, NULL, LM_VT_STRING
                                        };
@@ -89,12 +351,8 @@ _fill_template(RedisDestWorker *self, LogMessage *msg, LogTemplate *template, gc
 static void
 _fill_argv_from_template_list(RedisDestWorker *self, LogMessage *msg)
 {
-  RedisDriver *owner = (RedisDriver *) self->super.owner;
   for (gint i = 1; i < self->argc; i++)
-    {
-      LogTemplate *redis_command = g_list_nth_data(owner->arguments, i-1);
-      _fill_template(self, msg, redis_command, &self->argv[i], &self->argvlen[i]);
-    }
+    _fill_template(self, msg, self->templates[i], self->argv_buffers[i], &self->argv[i], &self->argvlen[i]);
 }
 
 static const gchar *
@@ -112,37 +370,76 @@ _argv_to_string(RedisDestWorker *self)
   return full_command->str;
 }
 
+/*
+ * Commands are pipelined, their replies are read in flush(), or earlier
+ * if max-pending-replies() is reached on a node.  With transaction(yes)
+ * the batch is wrapped in MULTI/EXEC on each node it touches.
+ */
 static LogThreadedResult
 redis_worker_insert_batch(LogThreadedDestWorker *s, LogMessage *msg)
 {
   RedisDestWorker *self = (RedisDestWorker *)s;
   RedisDriver *owner = (RedisDriver *) self->super.owner;
+  LogThreadedResult result = LTR_QUEUED;
 
   g_assert(owner->super.batch_lines > 0);
 
+  if (self->slots_outdated && s->batch_size == 0 && !_refresh_cluster_slots(self))
+    return LTR_ERROR;
+
   ScratchBuffersMarker marker;
   scratch_buffers_mark(&marker);
 
   _fill_argv_from_template_list(self, msg);
 
-  int retval = redisAppendCommandArgv(self->c, self->argc, (const gchar **)self->argv, self->argvlen);
+  RedisNode *node = _lookup_node(self);
+  if (!_ensure_node_connected(self, node))
+    {
+      _abort_batch(self);
+      result = LTR_NOT_CONNECTED;
+      goto exit;
+    }
 
-  if(self->c == NULL || self->c->err || retval != REDIS_OK)
+  if (owner->transaction && !node->in_transaction)
     {
-      msg_error("REDIS server error, suspending",
-                evt_tag_str("driver", owner->super.super.super.id),
-                evt_tag_str("command", _argv_to_string(self)),
-                evt_tag_str("error", self->c->errstr),
-                evt_tag_int("time_reopen", self->super.time_reopen));
-      scratch_buffers_reclaim_marked(marker);
-      return LTR_ERROR;
+      if (redisAppendCommand(node->c, "MULTI") != REDIS_OK)
+        goto error;
+      node->pending_replies++;
+      node->in_transaction = TRUE;
     }
+
+  if (redisAppendCommandArgv(node->c, self->argc, (const gchar **)self->argv, self->argvlen) != REDIS_OK
+      || node->c->err)
+    goto error;
+  node->pending_replies++;
+
   msg_debug("REDIS command appended",
             evt_tag_str("driver", owner->super.super.super.id),
             evt_tag_str("command", _argv_to_string(self)));
 
+  if (owner->max_pending_replies > 0 && node->pending_replies >= owner->max_pending_replies)
+    {
+      LogThreadedResult drain_result = _drain_replies(self, node, FALSE);
+      if (drain_result != LTR_SUCCESS)
+        {
+          _abort_batch(self);
+          result = drain_result;
+        }
+    }
+
+exit:
   scratch_buffers_reclaim_marked(marker);
-  return LTR_QUEUED;
+  return result;
+
+error:
+  msg_error("REDIS server error, suspending",
+            evt_tag_str("driver", owner->super.super.super.id),
+            evt_tag_str("command", _argv_to_string(self)),
+            evt_tag_str("error", node->c->errstr),
+            evt_tag_int("time_reopen", self->super.time_reopen));
+  _abort_batch(self);
+  result = LTR_NOT_CONNECTED;
+  goto exit;
 }
 
 static LogThreadedResult
@@ -151,22 +448,30 @@ redis_worker_insert(LogThreadedDestWorker *s, LogMessage *msg)
   RedisDestWorker *self = (RedisDestWorker *)s;
   RedisDriver *owner = (RedisDriver *) self->super.owner;
   LogThreadedResult status = LTR_ERROR;
+  redisReply *reply = NULL;
 
   g_assert(owner->super.batch_lines <= 0);
 
+  if (self->slots_outdated && !_refresh_cluster_slots(self))
+    return LTR_ERROR;
+
   ScratchBuffersMarker marker;
   scratch_buffers_mark(&marker);
 
   _fill_argv_from_template_list(self, msg);
 
-  redisReply *reply = redisCommandArgv(self->c, self->argc, (const gchar **)self->argv, self->argvlen);
+  RedisNode *node = _lookup_node(self);
+  if (!_ensure_node_connected(self, node))
+    goto exit;
+
+  reply = redisCommandArgv(node->c, self->argc, (const gchar **)self->argv, self->argvlen);
 
   if (!reply)
     {
       msg_error("REDIS server error, suspending",
                 evt_tag_str("driver", owner->super.super.super.id),
                 evt_tag_str("command", _argv_to_string(self)),
-                evt_tag_str("error", self->c->errstr),
+                evt_tag_str("error", node->c->errstr),
                 evt_tag_int("time_reopen", self->super.time_reopen));
 
       goto exit;
@@ -174,6 +479,9 @@ redis_worker_insert(LogThreadedDestWorker *s, LogMessage *msg)
 
   if (reply->type == REDIS_REPLY_ERROR)
     {
+      if (redis_cluster_is_redirection(reply))
+        self->slots_outdated = TRUE;
+
       msg_error("REDIS server error, suspending",
                 evt_tag_str("driver", owner->super.super.super.id),
                 evt_tag_str("command", _argv_to_string(self)),
@@ -189,7 +497,8 @@ redis_worker_insert(LogThreadedDestWorker *s, LogMessage *msg)
 
   status = LTR_SUCCESS;
 exit:
-  freeReplyObject(reply);
+  if (reply)
+    freeReplyObject(reply);
   scratch_buffers_reclaim_marked(marker);
   return status;
 }
@@ -202,12 +511,30 @@ redis_worker_init(LogThreadedDestWorker *d)
   RedisDriver *owner = (RedisDriver *) self->super.owner;
 
   self->argc = g_list_length(owner->arguments) + 1;
-  self->argv = g_malloc(self->argc * sizeof(char *));
-  self->argvlen = g_malloc(self->argc * sizeof(size_t));
+  self->argv = g_new0(gchar *, self->argc);
+  self->argvlen = g_new0(size_t, self->argc);
+  self->templates = g_new0(LogTemplate *, self->argc);
+  self->argv_buffers = g_new0(GString *, self->argc);
 
   self->argv[0] = owner->command->str;
   self->argvlen[0] = owner->command->len;
 
+  gint i = 1;
+  for (GList *l = owner->arguments; l; l = l->next, i++)
+    {
+      self->templates[i] = log_template_ref((LogTemplate *) l->data);
+      self->argv_buffers[i] = g_string_sized_new(128);
+    }
+
+  self->nodes = g_ptr_array_new_with_free_func((GDestroyNotify) redis_node_free);
+  g_ptr_array_add(self->nodes, redis_node_new(owner->host, owner->port));
+
+  if (owner->cluster)
+    {
+      self->slots = g_new(gint16, REDIS_CLUSTER_SLOTS);
+      self->slots_outdated = TRUE;
+    }
+
   msg_debug("Worker thread started",
             evt_tag_str("driver", self->super.owner->super.super.id));
 
@@ -222,9 +549,7 @@ redis_worker_disconnect(LogThreadedDestWorker *s)
 {
   RedisDestWorker *self = (RedisDestWorker *)s;
 
-  if (self->c)
-    redisFree(self->c);
-  self->c = NULL;
+  _abort_batch(self);
 }
 
 static void
@@ -232,124 +557,34 @@ redis_worker_deinit(LogThreadedDestWorker *d)
 {
   RedisDestWorker *self = (RedisDestWorker *)d;
 
-  g_free(self->argv);
-  g_free(self->argvlen);
-  redis_worker_disconnect(d);
-
-  log_threaded_dest_worker_deinit_method(d);
-}
-
-static inline void
-_trace_reply_message(redisReply *r)
-{
-  if (trace_flag)
-    {
-      if (r->elements > 0)
-        {
-          msg_trace(">>>>>> REDIS command reply begin",
-                    evt_tag_long("elements", r->elements));
-
-          for (gsize i = 0; i < r->elements; i++)
-            {
-              _trace_reply_message(r->element[i]);
-            }
-
-          msg_trace("<<<<<< REDIS command reply end");
-        }
-      else if (r->type == REDIS_REPLY_STRING || r->type == REDIS_REPLY_STATUS || r->type == REDIS_REPLY_ERROR)
-        {
-          msg_trace("REDIS command reply",
-                    evt_tag_str("str", r->str));
-        }
-      else
-        {
-          msg_trace("REDIS command unhandled reply",
-                    evt_tag_int("type", r->type));
-        }
-    }
-}
-
-
-
-
-static gboolean
-send_redis_command(RedisDestWorker *self, const char *format, ...)
-{
-  va_list ap;
-  va_start(ap, format);
-  redisReply *reply = redisvCommand(self->c, format, ap);
-  va_end(ap);
-
-  gboolean retval = reply && (reply->type != REDIS_REPLY_ERROR);
-  if (reply)
+  for (gint i = 1; i < self->argc; i++)
     {
-      _trace_reply_message(reply);
-      freeReplyObject(reply);
+      log_template_unref(self->templates[i]);
+      g_string_free(self->argv_buffers[i], TRUE);
     }
-  return retval;
-}
+  g_free(self->templates);
+  g_free(self->argv_buffers);
+  g_free(self->argv);
+  g_free(self->argvlen);
 
-static gboolean
-check_connection_to_redis(RedisDestWorker *self)
-{
-  return send_redis_command(self, "ping");
-}
+  g_ptr_array_free(self->nodes, TRUE);
+  self->nodes = NULL;
+  g_free(self->slots);
+  self->slots = NULL;
 
-static gboolean
-authenticate_to_redis(RedisDestWorker *self, const gchar *password)
-{
-  return send_redis_command(self, "AUTH %s", password);
+  log_threaded_dest_worker_deinit_method(d);
 }
 
 static gboolean
 redis_worker_connect(LogThreadedDestWorker *s)
 {
   RedisDestWorker *self = (RedisDestWorker *)s;
-  RedisDriver *owner = (RedisDriver *) self->super.owner;
-
-  if (self->c && check_connection_to_redis(self))
-    return TRUE;
-  else if (self->c)
-    redisReconnect(self->c);
-  else
-    self->c = redisConnectWithTimeout(owner->host, owner->port, owner->timeout);
-
-  if (self->c == NULL || self->c->err)
-    {
-      if (self->c)
-        {
-          msg_error("REDIS server error during connection",
-                    evt_tag_str("driver", owner->super.super.super.id),
-                    evt_tag_str("error", self->c->errstr),
-                    evt_tag_int("time_reopen", self->super.time_reopen));
-        }
-      else
-        {
-          msg_error("REDIS server can't allocate redis context");
-        }
-      return FALSE;
-    }
-
-  if (owner->auth)
-    if (!authenticate_to_redis(self, owner->auth))
-      {
-        msg_error("REDIS: failed to authenticate",
-                  evt_tag_str("driver", owner->super.super.super.id));
-        return FALSE;
-      }
 
-  if (!check_connection_to_redis(self))
-    {
-      msg_error("REDIS: failed to connect",
-                evt_tag_str("driver", owner->super.super.super.id));
-      return FALSE;
-    }
-
-  if (self->c->err)
+  if (!_connect_node(self, _seed_node(self)))
     return FALSE;
 
-  msg_debug("Connecting to REDIS succeeded",
-            evt_tag_str("driver", owner->super.super.super.id));
+  if (self->slots && !_refresh_cluster_slots(self))
+    return FALSE;
 
   return TRUE;
 }
@@ -30,16 +30,26 @@
 
 #include "syslog-ng.h"
 #include "logthrdest/logthrdestdrv.h"
+#include "redis-cluster.h"
 
 
 typedef struct _RedisDestWorker
 {
   LogThreadedDestWorker super;
-  redisContext *c;
+
+  /* RedisNode instances, the first one is the configured server, the rest
+   * are the cluster members discovered with CLUSTER SLOTS */
+  GPtrArray *nodes;
+  /* slot -> index in nodes, only allocated with cluster(yes) */
+  gint16 *slots;
+  gboolean slots_outdated;
+
   gint argc;
   gchar **argv;
   size_t *argvlen;
-
+  /* argument templates and their formatting buffers, reused for every message */
+  LogTemplate **templates;
+  GString **argv_buffers;
 } RedisDestWorker;
 
 LogThreadedDestWorker *redis_worker_new(LogThreadedDestDriver *owner, gint worker_index);
@@ -92,6 +92,30 @@ redis_dd_set_command_ref(LogDriver *d, const gchar *command,
   self->arguments = arguments;
 }
 
+void
+redis_dd_set_transaction(LogDriver *d, gboolean transaction)
+{
+  RedisDriver *self = (RedisDriver *)d;
+
+  self->transaction = transaction;
+}
+
+void
+redis_dd_set_cluster(LogDriver *d, gboolean cluster)
+{
+  RedisDriver *self = (RedisDriver *)d;
+
+  self->cluster = cluster;
+}
+
+void
+redis_dd_set_max_pending_replies(LogDriver *d, gint max_pending_replies)
+{
+  RedisDriver *self = (RedisDriver *)d;
+
+  self->max_pending_replies = max_pending_replies;
+}
+
 LogTemplateOptions *
 redis_dd_get_template_options(LogDriver *d)
 {
@@ -153,6 +177,13 @@ redis_dd_init(LogPipe *s)
       return FALSE;
     }
 
+  if (self->transaction && self->super.batch_lines <= 0)
+    {
+      msg_warning("WARNING: transaction() has no effect without batch-lines(), "
+                  "commands are sent one by one",
+                  log_pipe_location_tag(s));
+    }
+
   if (!log_threaded_dest_driver_init_method(s))
     return FALSE;
 
@@ -161,7 +192,9 @@ redis_dd_init(LogPipe *s)
   msg_verbose("Initializing Redis destination",
               evt_tag_str("driver", self->super.super.super.id),
               evt_tag_str("host", self->host),
-              evt_tag_int("port", self->port));
+              evt_tag_int("port", self->port),
+              evt_tag_int("cluster", self->cluster),
+              evt_tag_int("transaction", self->transaction));
 
   return TRUE;
 }
@@ -41,6 +41,10 @@ typedef struct _RedisDriver
 
   GString *command;
   GList *arguments;
+
+  gboolean transaction;
+  gboolean cluster;
+  gint max_pending_replies;
 } RedisDriver;
 
 
@@ -52,6 +56,9 @@ void redis_dd_set_port(LogDriver *d, gint port);
 void redis_dd_set_auth(LogDriver *d, const gchar *auth);
 void redis_dd_set_command_ref(LogDriver *d, const gchar *command,
                               GList *arguments);
+void redis_dd_set_transaction(LogDriver *d, gboolean transaction);
+void redis_dd_set_cluster(LogDriver *d, gboolean cluster);
+void redis_dd_set_max_pending_replies(LogDriver *d, gint max_pending_replies);
 LogTemplateOptions *redis_dd_get_template_options(LogDriver *d);
 
 #endif
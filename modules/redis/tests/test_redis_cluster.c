@@ -0,0 +1,289 @@
+/*
+ * Copyright (c) 2024 One Identity LLC.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#include <criterion/criterion.h>
+
+#include "redis-cluster.h"
+#include "apphook.h"
+
+#include <string.h>
+
+/* bitwise reference implementation of CRC16-XMODEM */
+static guint16
+_reference_crc16(const gchar *key)
+{
+  guint16 crc = 0;
+
+  for (gsize i = 0; key[i]; i++)
+    {
+      crc ^= ((guint8) key[i]) << 8;
+      for (gint bit = 0; bit < 8; bit++)
+        crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+    }
+  return crc;
+}
+
+static guint16
+_key_slot(const gchar *key)
+{
+  return redis_cluster_key_slot(key, strlen(key));
+}
+
+Test(redis_cluster, key_slots_match_the_reference_crc16_vectors)
+{
+  /* CRC16-XMODEM("123456789") is 0x31C3 */
+  cr_assert_eq(_key_slot("123456789"), 0x31C3);
+  cr_assert_eq(_key_slot("foo"), 12182);
+  cr_assert_eq(_key_slot("bar"), 5061);
+  cr_assert_eq(_key_slot("hello"), 866);
+  cr_assert_eq(_key_slot(""), 0);
+}
+
+Test(redis_cluster, only_the_hash_tag_is_hashed_if_there_is_one)
+{
+  cr_assert_eq(_key_slot("{user1000}.following"), _key_slot("user1000"));
+  cr_assert_eq(_key_slot("{user1000}.followers"), _key_slot("user1000"));
+  cr_assert_eq(_key_slot("prefix-{user1000}"), _key_slot("user1000"));
+
+  /* only the first tag counts */
+  cr_assert_eq(_key_slot("foo{bar}{zap}"), _key_slot("bar"));
+  cr_assert_eq(_key_slot("foo{{bar}}zap"), _key_slot("{bar"));
+}
+
+Test(redis_cluster, the_whole_key_is_hashed_without_a_valid_hash_tag)
+{
+  const gchar *keys[] = { "foo{}{bar}", "foo{bar", "foo}bar{", "}{" };
+
+  for (gsize i = 0; i < G_N_ELEMENTS(keys); i++)
+    cr_assert_eq(_key_slot(keys[i]), _reference_crc16(keys[i]) % REDIS_CLUSTER_SLOTS, "key: %s", keys[i]);
+}
+
+Test(redis_cluster, key_slot_does_not_look_beyond_the_length_of_the_key)
+{
+  /* the closing brace is outside of the key */
+  cr_assert_eq(redis_cluster_key_slot("{foo}", 4), _key_slot("{foo"));
+  cr_assert_eq(redis_cluster_key_slot("{foo}bar", 5), _key_slot("foo"));
+  cr_assert_eq(redis_cluster_key_slot("foobar", 3), _key_slot("foo"));
+}
+
+static redisReply *
+_reply_new(gint type)
+{
+  redisReply *reply = g_new0(redisReply, 1);
+
+  reply->type = type;
+  return reply;
+}
+
+static redisReply *
+_string_reply_new(gint type, const gchar *str)
+{
+  redisReply *reply = _reply_new(type);
+
+  reply->str = g_strdup(str);
+  reply->len = strlen(str);
+  return reply;
+}
+
+static redisReply *
+_integer_reply_new(long long value)
+{
+  redisReply *reply = _reply_new(REDIS_REPLY_INTEGER);
+
+  reply->integer = value;
+  return reply;
+}
+
+static redisReply *
+_array_reply_new(gsize elements, ...)
+{
+  redisReply *reply = _reply_new(REDIS_REPLY_ARRAY);
+  va_list va;
+
+  reply->elements = elements;
+  reply->element = g_new0(redisReply *, elements);
+
+  va_start(va, elements);
+  for (gsize i = 0; i < elements; i++)
+    reply->element[i] = va_arg(va, redisReply *);
+  va_end(va);
+  return reply;
+}
+
+static redisReply *
+_slot_range_reply_new(long long start, long long end, const gchar *host, long long port)
+{
+  return _array_reply_new(3, _integer_reply_new(start), _integer_reply_new(end),
+                          _array_reply_new(3, _string_reply_new(REDIS_REPLY_STRING, host), _integer_reply_new(port),
+                                           _string_reply_new(REDIS_REPLY_STRING, "node-id")));
+}
+
+static void
+_reply_free(redisReply *reply)
+{
+  for (gsize i = 0; i < reply->elements; i++)
+    _reply_free(reply->element[i]);
+  g_free(reply->element);
+  g_free(reply->str);
+  g_free(reply);
+}
+
+Test(redis_cluster, moved_and_ask_errors_are_redirections)
+{
+  const gchar *redirections[] = { "MOVED 3999 127.0.0.1:6381", "ASK 3999 127.0.0.1:6381" };
+  const gchar *other_errors[] = { "ERR MOVED 3999 127.0.0.1:6381", "MOVED", "ASKING", "CLUSTERDOWN", "" };
+
+  for (gsize i = 0; i < G_N_ELEMENTS(redirections); i++)
+    {
+      redisReply *reply = _string_reply_new(REDIS_REPLY_ERROR, redirections[i]);
+      cr_assert(redis_cluster_is_redirection(reply), "reply: %s", redirections[i]);
+      _reply_free(reply);
+    }
+
+  for (gsize i = 0; i < G_N_ELEMENTS(other_errors); i++)
+    {
+      redisReply *reply = _string_reply_new(REDIS_REPLY_ERROR, other_errors[i]);
+      cr_assert_not(redis_cluster_is_redirection(reply), "reply: %s", other_errors[i]);
+      _reply_free(reply);
+    }
+
+  redisReply *reply = _string_reply_new(REDIS_REPLY_STATUS, "MOVED 3999 127.0.0.1:6381");
+  cr_assert_not(redis_cluster_is_redirection(reply), "only errors are redirections");
+  _reply_free(reply);
+
+  cr_assert_not(redis_cluster_is_redirection(NULL));
+}
+
+static GPtrArray *
+_nodes_new(void)
+{
+  GPtrArray *nodes = g_ptr_array_new_with_free_func((GDestroyNotify) redis_node_free);
+
+  g_ptr_array_add(nodes, redis_node_new("seed", 7000));
+  return nodes;
+}
+
+static void
+_assert_node(GPtrArray *nodes, gint index, const gchar *host, gint port)
+{
+  RedisNode *node = g_ptr_array_index(nodes, index);
+
+  cr_assert_str_eq(node->host, host);
+  cr_assert_eq(node->port, port);
+}
+
+Test(redis_cluster, slot_map_is_built_from_cluster_slots)
+{
+  GPtrArray *nodes = _nodes_new();
+  gint16 slots[REDIS_CLUSTER_SLOTS];
+
+  /* an empty host refers to the node we asked */
+  redisReply *reply = _array_reply_new(3,
+                                       _slot_range_reply_new(0, 5460, "", 7000),
+                                       _slot_range_reply_new(5461, 10922, "10.0.0.2", 7001),
+                                       _slot_range_reply_new(10923, 16383, "10.0.0.3", 7002));
+
+  cr_assert(redis_cluster_update_slots(nodes, slots, reply));
+  _reply_free(reply);
+
+  cr_assert_eq(nodes->len, 3);
+  _assert_node(nodes, 0, "seed", 7000);
+  _assert_node(nodes, 1, "10.0.0.2", 7001);
+  _assert_node(nodes, 2, "10.0.0.3", 7002);
+
+  cr_assert_eq(slots[0], 0);
+  cr_assert_eq(slots[5460], 0);
+  cr_assert_eq(slots[5461], 1);
+  cr_assert_eq(slots[10922], 1);
+  cr_assert_eq(slots[10923], 2);
+  cr_assert_eq(slots[REDIS_CLUSTER_SLOTS - 1], 2);
+  cr_assert_eq(slots[_key_slot("foo")], 2);
+
+  g_ptr_array_free(nodes, TRUE);
+}
+
+Test(redis_cluster, slot_map_follows_the_slots_after_a_redirection)
+{
+  GPtrArray *nodes = _nodes_new();
+  gint16 slots[REDIS_CLUSTER_SLOTS];
+
+  redisReply *reply = _array_reply_new(2,
+                                       _slot_range_reply_new(0, 8191, "", 7000),
+                                       _slot_range_reply_new(8192, 16383, "10.0.0.2", 7001));
+  cr_assert(redis_cluster_update_slots(nodes, slots, reply));
+  _reply_free(reply);
+  cr_assert_eq(slots[_key_slot("foo")], 1);
+
+  /* "MOVED 12182 10.0.0.3:7002" made the worker refresh the slots, part of
+   * the second node moved, a slot is not served at all */
+  reply = _array_reply_new(3,
+                           _slot_range_reply_new(0, 8191, "", 7000),
+                           _slot_range_reply_new(8192, 12000, "10.0.0.2", 7001),
+                           _slot_range_reply_new(12001, 16382, "10.0.0.3", 7002));
+  cr_assert(redis_cluster_update_slots(nodes, slots, reply));
+  _reply_free(reply);
+
+  cr_assert_eq(nodes->len, 3, "known nodes should be reused");
+  _assert_node(nodes, 2, "10.0.0.3", 7002);
+  cr_assert_eq(slots[_key_slot("foo")], 2);
+  cr_assert_eq(slots[12000], 1);
+  cr_assert_eq(slots[REDIS_CLUSTER_SLOTS - 1], -1);
+
+  g_ptr_array_free(nodes, TRUE);
+}
+
+Test(redis_cluster, malformed_cluster_slots_replies_are_rejected)
+{
+  GPtrArray *nodes = _nodes_new();
+  gint16 slots[REDIS_CLUSTER_SLOTS];
+
+  redisReply *reply = _string_reply_new(REDIS_REPLY_ERROR, "ERR This instance has cluster support disabled");
+  cr_assert_not(redis_cluster_update_slots(nodes, slots, reply));
+  _reply_free(reply);
+
+  reply = _array_reply_new(1, _array_reply_new(2, _integer_reply_new(0), _integer_reply_new(16383)));
+  cr_assert_not(redis_cluster_update_slots(nodes, slots, reply), "the master node is missing");
+  _reply_free(reply);
+
+  reply = _array_reply_new(1, _array_reply_new(3, _integer_reply_new(0), _integer_reply_new(16383),
+                                               _array_reply_new(1, _string_reply_new(REDIS_REPLY_STRING, "host"))));
+  cr_assert_not(redis_cluster_update_slots(nodes, slots, reply), "the port of the master is missing");
+  _reply_free(reply);
+
+  cr_assert_not(redis_cluster_update_slots(nodes, slots, NULL));
+
+  g_ptr_array_free(nodes, TRUE);
+}
+
+static void
+setup(void)
+{
+  app_startup();
+}
+
+static void
+teardown(void)
+{
+  app_shutdown();
+}
+
+TestSuite(redis_cluster, .init = setup, .fini = teardown);
@@ -55,6 +55,7 @@ static CfgLexerKeyword riemann_keywords[] =
   { "cert",                     KW_CERT_FILE, KWS_OBSOLETE, "The cert() option is deprecated in favour of cert-file()" },
 
   { "tls",                      KW_TLS },
+  { "rollup",                   KW_ROLLUP },
 
   { NULL }
 };
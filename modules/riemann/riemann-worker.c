@@ -83,6 +83,10 @@ riemann_dd_disconnect(LogThreadedDestWorker *s)
   riemann_client_disconnect(self->client);
   riemann_client_free(self->client);
   self->client = NULL;
+
+  /* the current batch is rewound, its messages are going to be rolled up again */
+  if (self->rollup)
+    stats_rollup_reset(self->rollup);
 }
 
 /*
@@ -249,6 +253,48 @@ _append_event(RiemannDestWorker *self, riemann_event_t *event)
   self->event.n++;
 }
 
+static void
+riemann_add_fields_to_event(RiemannDestWorker *self, riemann_event_t *event, LogMessage *msg, GString *str)
+{
+  RiemannDestDriver *owner = (RiemannDestDriver *) self->super.owner;
+
+  riemann_dd_field_string_maybe_add(event, msg, owner->fields.host,
+                                    &owner->template_options,
+                                    RIEMANN_EVENT_FIELD_HOST,
+                                    self->super.seq_num, str);
+  riemann_dd_field_string_maybe_add(event, msg, owner->fields.service,
+                                    &owner->template_options,
+                                    RIEMANN_EVENT_FIELD_SERVICE,
+                                    self->super.seq_num, str);
+  riemann_dd_field_integer_maybe_add(event, msg, owner->fields.event_time,
+                                     &owner->template_options,
+                                     owner->fields.event_time_unit,
+                                     self->super.seq_num, str);
+  riemann_dd_field_string_maybe_add(event, msg, owner->fields.description,
+                                    &owner->template_options,
+                                    RIEMANN_EVENT_FIELD_DESCRIPTION,
+                                    self->super.seq_num, str);
+  riemann_dd_field_string_maybe_add(event, msg, owner->fields.state,
+                                    &owner->template_options,
+                                    RIEMANN_EVENT_FIELD_STATE,
+                                    self->super.seq_num, str);
+
+  if (owner->fields.tags)
+    g_list_foreach(owner->fields.tags, riemann_dd_field_add_tag,
+                   (gpointer)event);
+  else
+    log_msg_tags_foreach(msg, riemann_dd_field_add_msg_tag,
+                         (gpointer)event);
+
+  if (owner->fields.attributes)
+    {
+      LogTemplateEvalOptions options = {&owner->template_options, LTZ_SEND, self->super.seq_num, NULL, LM_VT_STRING};
+      value_pairs_foreach(owner->fields.attributes,
+                          riemann_dd_field_add_attribute_vp,
+                          msg, &options, event);
+    }
+}
+
 static gboolean
 riemann_worker_insert_one(RiemannDestWorker *self, LogMessage *msg)
 {
@@ -273,41 +319,7 @@ riemann_worker_insert_one(RiemannDestWorker *self, LogMessage *msg)
 
   if (success)
     {
-      riemann_dd_field_string_maybe_add(event, msg, owner->fields.host,
-                                        &owner->template_options,
-                                        RIEMANN_EVENT_FIELD_HOST,
-                                        self->super.seq_num, str);
-      riemann_dd_field_string_maybe_add(event, msg, owner->fields.service,
-                                        &owner->template_options,
-                                        RIEMANN_EVENT_FIELD_SERVICE,
-                                        self->super.seq_num, str);
-      riemann_dd_field_integer_maybe_add(event, msg, owner->fields.event_time,
-                                         &owner->template_options,
-                                         owner->fields.event_time_unit,
-                                         self->super.seq_num, str);
-      riemann_dd_field_string_maybe_add(event, msg, owner->fields.description,
-                                        &owner->template_options,
-                                        RIEMANN_EVENT_FIELD_DESCRIPTION,
-                                        self->super.seq_num, str);
-      riemann_dd_field_string_maybe_add(event, msg, owner->fields.state,
-                                        &owner->template_options,
-                                        RIEMANN_EVENT_FIELD_STATE,
-                                        self->super.seq_num, str);
-
-      if (owner->fields.tags)
-        g_list_foreach(owner->fields.tags, riemann_dd_field_add_tag,
-                       (gpointer)event);
-      else
-        log_msg_tags_foreach(msg, riemann_dd_field_add_msg_tag,
-                             (gpointer)event);
-
-      if (owner->fields.attributes)
-        {
-          LogTemplateEvalOptions options = {&owner->template_options, LTZ_SEND, self->super.seq_num, NULL, LM_VT_STRING};
-          value_pairs_foreach(owner->fields.attributes,
-                              riemann_dd_field_add_attribute_vp,
-                              msg, &options, event);
-        }
+      riemann_add_fields_to_event(self, event, msg, str);
       msg_trace("riemann: adding message to Riemann event",
                 evt_tag_str("server", owner->server),
                 evt_tag_int("port", owner->port),
@@ -322,6 +334,104 @@ riemann_worker_insert_one(RiemannDestWorker *self, LogMessage *msg)
   return success;
 }
 
+/*
+ * Rollup
+ *
+ * The messages of a batch are summarized per host and service, the event
+ * of the first message carries the rest of the fields and it gets the
+ * rolled up metric when the batch is flushed.  If the flush fails, the
+ * batch is rewound and inserted again, so the rollup is always reset
+ * together with the batch.
+ */
+
+static void
+_format_rollup_key(RiemannDestWorker *self, LogMessage *msg, GString *key)
+{
+  RiemannDestDriver *owner = (RiemannDestDriver *) self->super.owner;
+  LogTemplateEvalOptions options = {&owner->template_options, LTZ_SEND, self->super.seq_num, NULL, LM_VT_STRING};
+
+  log_template_format(owner->fields.host, msg, &options, key);
+  g_string_append_c(key, '\n');
+  log_template_append_format(owner->fields.service, msg, &options, key);
+}
+
+static gboolean
+riemann_worker_rollup_one(RiemannDestWorker *self, LogMessage *msg)
+{
+  RiemannDestDriver *owner = (RiemannDestDriver *) self->super.owner;
+  GString *str = scratch_buffers_alloc();
+  gdouble value;
+
+  LogTemplateEvalOptions options = {&owner->template_options, LTZ_SEND, self->super.seq_num, NULL, LM_VT_STRING};
+  log_template_format(owner->fields.metric, msg, &options, str);
+
+  /* messages without a metric don't contribute to the rollup */
+  if (str->len == 0)
+    return TRUE;
+
+  if (!type_cast_to_double(str->str, &value, NULL))
+    return !type_cast_drop_helper(owner->template_options.on_error, str->str, "double");
+
+  GString *key = scratch_buffers_alloc();
+  _format_rollup_key(self, msg, key);
+
+  riemann_event_t *event = NULL;
+  if (!stats_rollup_lookup(self->rollup, key->str))
+    {
+      event = riemann_event_new();
+      if (owner->fields.ttl && !riemann_add_ttl_to_event(self, event, msg, str))
+        {
+          riemann_event_free(event);
+          return FALSE;
+        }
+      riemann_add_fields_to_event(self, event, msg, str);
+    }
+
+  StatsRollupEntry *entry = stats_rollup_add_data_point(self->rollup, key->str, value);
+  if (event)
+    entry->user_data = event;
+
+  return TRUE;
+}
+
+static void
+_add_rollup_attribute(riemann_event_t *event, const gchar *name, gdouble value)
+{
+  gchar buf[G_ASCII_DTOSTR_BUF_SIZE];
+  riemann_attribute_t *attrib = riemann_attribute_new();
+
+  riemann_attribute_set(attrib, name, g_ascii_formatd(buf, sizeof(buf), "%.15g", value));
+  riemann_event_attribute_add(event, attrib);
+}
+
+static void
+_append_rollup_event(StatsRollupEntry *entry, gpointer user_data)
+{
+  RiemannDestWorker *self = (RiemannDestWorker *) user_data;
+  RiemannDestDriver *owner = (RiemannDestDriver *) self->super.owner;
+  riemann_event_t *event = (riemann_event_t *) entry->user_data;
+
+  /* the event is sent, and thus freed, with the rest of the batch */
+  entry->user_data = NULL;
+
+  riemann_event_set(event, RIEMANN_EVENT_FIELD_METRIC_D, stats_rollup_entry_get_value(entry, owner->rollup.type),
+                    RIEMANN_EVENT_FIELD_NONE);
+  if (owner->rollup.type == STATS_ROLLUP_TIMING)
+    {
+      _add_rollup_attribute(event, "count", entry->count);
+      _add_rollup_attribute(event, "min", entry->min);
+      _add_rollup_attribute(event, "max", entry->max);
+    }
+  _append_event(self, event);
+}
+
+static void
+riemann_worker_emit_rollup(RiemannDestWorker *self)
+{
+  stats_rollup_foreach(self->rollup, _append_rollup_event, self);
+  stats_rollup_reset(self->rollup);
+}
+
 static LogThreadedResult
 riemann_worker_flush(LogThreadedDestWorker *s, LogThreadedFlushMode mode)
 {
@@ -330,6 +440,9 @@ riemann_worker_flush(LogThreadedDestWorker *s, LogThreadedFlushMode mode)
   riemann_message_t *message;
   riemann_message_t *r;
 
+  if (self->rollup)
+    riemann_worker_emit_rollup(self);
+
   if (self->event.n == 0)
     return LTR_SUCCESS;
 
@@ -410,8 +523,9 @@ static LogThreadedResult
 _insert_batch(RiemannDestWorker *self, LogMessage *msg)
 {
   RiemannDestDriver *owner = (RiemannDestDriver *) self->super.owner;
+  gboolean success = self->rollup ? riemann_worker_rollup_one(self, msg) : riemann_worker_insert_one(self, msg);
 
-  if (!riemann_worker_insert_one(self, msg))
+  if (!success)
     {
       msg_error("riemann: error inserting message to batch, probably a type mismatch. Dropping message",
                 evt_tag_str("server", owner->server),
@@ -448,6 +562,8 @@ riemann_dw_free(LogThreadedDestWorker *s)
   RiemannDestWorker *self = (RiemannDestWorker *) s;
 
   free(self->event.list);
+  if (self->rollup)
+    stats_rollup_free(self->rollup);
   if (self->client)
     riemann_client_free(self->client);
   log_threaded_dest_worker_free_method(s);
@@ -469,5 +585,7 @@ riemann_dw_new(LogThreadedDestDriver *owner, gint worker_index)
   self->super.flush = riemann_worker_flush;
   self->event.list = (riemann_event_t **) malloc(sizeof (riemann_event_t *) *
                                                  MAX(1, owner->batch_lines));
+  if (((RiemannDestDriver *) owner)->rollup.enabled)
+    self->rollup = stats_rollup_new((GDestroyNotify) riemann_event_free);
   return &self->super;
 }
@@ -26,6 +26,7 @@
 #define SNG_RIEMANN_WORKER_H_INCLUDED
 
 #include "logthrdest/logthrdestdrv.h"
+#include "stats/aggregator/stats-rollup.h"
 
 typedef struct
 {
@@ -37,6 +38,10 @@ typedef struct
     riemann_event_t **list;
     gint n;
   } event;
+
+  /* host and service -> StatsRollupEntry, user_data is the event of the
+   * first message of the batch */
+  StatsRollup *rollup;
 } RiemannDestWorker;
 
 LogThreadedDestWorker *riemann_dw_new(LogThreadedDestDriver *owner, gint worker_index);
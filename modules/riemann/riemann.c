@@ -166,6 +166,18 @@ riemann_dd_set_timeout(LogDriver *d, guint timeout)
   self->timeout = timeout;
 }
 
+gboolean
+riemann_dd_set_rollup(LogDriver *d, const gchar *type)
+{
+  RiemannDestDriver *self = (RiemannDestDriver *)d;
+
+  if (!stats_rollup_type_parse(type, &self->rollup.type))
+    return FALSE;
+
+  self->rollup.enabled = TRUE;
+  return TRUE;
+}
+
 void
 riemann_dd_set_tls_cacert(LogDriver *d, const gchar *path)
 {
@@ -264,6 +276,22 @@ riemann_dd_init(LogPipe *s)
   if (self->port == -1)
     self->port = 5555;
 
+  if (self->rollup.enabled && !self->fields.metric)
+    {
+      msg_error("riemann: rollup() requires the metric() option",
+                evt_tag_str("driver", self->super.super.super.id),
+                log_pipe_location_tag(s));
+      return FALSE;
+    }
+
+  if (self->rollup.enabled && self->super.batch_lines <= 1)
+    {
+      msg_error("riemann: rollup() summarizes the metrics of a batch, it requires batch-lines() larger than 1",
+                evt_tag_str("driver", self->super.super.super.id),
+                log_pipe_location_tag(s));
+      return FALSE;
+    }
+
   if (!log_threaded_dest_driver_init_method(s))
     return FALSE;
 
@@ -26,6 +26,7 @@
 
 #include "logthrdest/logthrdestdrv.h"
 #include "value-pairs/value-pairs.h"
+#include "stats/aggregator/stats-rollup.h"
 
 #include <riemann/riemann-client.h>
 
@@ -53,6 +54,14 @@ typedef struct
   } fields;
   LogTemplateOptions template_options;
 
+  /* with rollup(), the metrics of a batch are summarized into one event
+   * per host and service */
+  struct
+  {
+    gboolean enabled;
+    StatsRollupType type;
+  } rollup;
+
   struct
   {
     gchar *cacert;
@@ -84,5 +93,6 @@ void riemann_dd_set_tls_cert(LogDriver *d, const gchar *path);
 void riemann_dd_set_tls_key(LogDriver *d, const gchar *path);
 void riemann_dd_set_timeout(LogDriver *d, guint timeout);
 void riemann_dd_set_event_time_unit(LogDriver *d, gint unit);
+gboolean riemann_dd_set_rollup(LogDriver *d, const gchar *type);
 
 #endif
@@ -0,0 +1,251 @@
+/*
+ * Copyright (c) 2024 One Identity LLC.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#include "s3-compressor.h"
+#include "messages.h"
+
+#include <string.h>
+
+#ifdef SYSLOG_NG_HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+#if SYSLOG_NG_ENABLE_ZSTD
+#include <zstd.h>
+#endif
+
+/* the output is grown by this much while a call is producing output */
+#define S3_COMPRESSOR_OUTPUT_CHUNK (64 * 1024)
+
+struct _S3Compressor
+{
+  S3CompressionMethod method;
+#ifdef SYSLOG_NG_HAVE_ZLIB
+  z_stream gzip;
+#endif
+#if SYSLOG_NG_ENABLE_ZSTD
+  ZSTD_CCtx *zstd;
+#endif
+};
+
+gboolean
+s3_compression_method_parse(const gchar *name, S3CompressionMethod *method)
+{
+  if (strcmp(name, "none") == 0 || strcmp(name, "no") == 0)
+    *method = S3_COMPRESSION_NONE;
+#ifdef SYSLOG_NG_HAVE_ZLIB
+  else if (strcmp(name, "gzip") == 0 || strcmp(name, "yes") == 0)
+    *method = S3_COMPRESSION_GZIP;
+#endif
+#if SYSLOG_NG_ENABLE_ZSTD
+  else if (strcmp(name, "zstd") == 0)
+    *method = S3_COMPRESSION_ZSTD;
+#endif
+  else
+    return FALSE;
+
+  return TRUE;
+}
+
+const gchar *
+s3_compression_method_extension(S3CompressionMethod method)
+{
+  switch (method)
+    {
+    case S3_COMPRESSION_GZIP:
+      return ".gz";
+    case S3_COMPRESSION_ZSTD:
+      return ".zst";
+    default:
+      return "";
+    }
+}
+
+static inline guchar *
+_reserve_output(GString *output, gsize *pos)
+{
+  *pos = output->len;
+  g_string_set_size(output, *pos + S3_COMPRESSOR_OUTPUT_CHUNK);
+  return (guchar *) output->str + *pos;
+}
+
+#ifdef SYSLOG_NG_HAVE_ZLIB
+
+static gboolean
+_gzip_deflate(S3Compressor *self, const gchar *data, gsize len, gint flush, GString *output)
+{
+  gint rc;
+
+  self->gzip.next_in = (Bytef *) data;
+  self->gzip.avail_in = len;
+  do
+    {
+      gsize pos;
+
+      self->gzip.next_out = _reserve_output(output, &pos);
+      self->gzip.avail_out = S3_COMPRESSOR_OUTPUT_CHUNK;
+      rc = deflate(&self->gzip, flush);
+      g_string_set_size(output, pos + S3_COMPRESSOR_OUTPUT_CHUNK - self->gzip.avail_out);
+
+      if (rc == Z_STREAM_ERROR)
+        return FALSE;
+    }
+  while (self->gzip.avail_out == 0 || (flush == Z_FINISH && rc != Z_STREAM_END));
+
+  return TRUE;
+}
+
+#endif
+
+#if SYSLOG_NG_ENABLE_ZSTD
+
+static gboolean
+_zstd_compress_stream(S3Compressor *self, ZSTD_inBuffer *input, ZSTD_EndDirective mode, GString *output)
+{
+  gsize remaining;
+
+  do
+    {
+      gsize pos;
+      ZSTD_outBuffer out = { .dst = _reserve_output(output, &pos), .size = S3_COMPRESSOR_OUTPUT_CHUNK };
+
+      remaining = ZSTD_compressStream2(self->zstd, &out, input, mode);
+      g_string_set_size(output, pos + out.pos);
+
+      if (ZSTD_isError(remaining))
+        {
+          msg_error("Error compressing S3 object",
+                    evt_tag_str("method", "zstd"),
+                    evt_tag_str("error", ZSTD_getErrorName(remaining)));
+          return FALSE;
+        }
+    }
+  while (mode == ZSTD_e_continue ? input->pos < input->size : remaining != 0);
+
+  return TRUE;
+}
+
+#endif
+
+gboolean
+s3_compressor_compress(S3Compressor *self, const gchar *data, gsize len, GString *output)
+{
+  switch (self->method)
+    {
+#ifdef SYSLOG_NG_HAVE_ZLIB
+    case S3_COMPRESSION_GZIP:
+      return _gzip_deflate(self, data, len, Z_NO_FLUSH, output);
+#endif
+#if SYSLOG_NG_ENABLE_ZSTD
+    case S3_COMPRESSION_ZSTD:
+    {
+      ZSTD_inBuffer input = { .src = data, .size = len };
+      return _zstd_compress_stream(self, &input, ZSTD_e_continue, output);
+    }
+#endif
+    default:
+      g_string_append_len(output, data, len);
+      return TRUE;
+    }
+}
+
+/* ends the stream, nothing can be compressed afterwards */
+gboolean
+s3_compressor_finish(S3Compressor *self, GString *output)
+{
+  switch (self->method)
+    {
+#ifdef SYSLOG_NG_HAVE_ZLIB
+    case S3_COMPRESSION_GZIP:
+      return _gzip_deflate(self, NULL, 0, Z_FINISH, output);
+#endif
+#if SYSLOG_NG_ENABLE_ZSTD
+    case S3_COMPRESSION_ZSTD:
+    {
+      ZSTD_inBuffer input = { 0 };
+      return _zstd_compress_stream(self, &input, ZSTD_e_end, output);
+    }
+#endif
+    default:
+      return TRUE;
+    }
+}
+
+S3Compressor *
+s3_compressor_new(S3CompressionMethod method, gint level)
+{
+  S3Compressor *self = g_new0(S3Compressor, 1);
+
+  self->method = method;
+  switch (method)
+    {
+#ifdef SYSLOG_NG_HAVE_ZLIB
+    case S3_COMPRESSION_GZIP:
+      /* 15 + 16: the largest window with a gzip header and trailer */
+      if (deflateInit2(&self->gzip, level < 0 ? Z_DEFAULT_COMPRESSION : level,
+                       Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+        goto error;
+      break;
+#endif
+#if SYSLOG_NG_ENABLE_ZSTD
+    case S3_COMPRESSION_ZSTD:
+      self->zstd = ZSTD_createCCtx();
+      if (!self->zstd)
+        goto error;
+      ZSTD_CCtx_setParameter(self->zstd, ZSTD_c_compressionLevel, level < 0 ? ZSTD_CLEVEL_DEFAULT : level);
+      ZSTD_CCtx_setParameter(self->zstd, ZSTD_c_checksumFlag, 1);
+      break;
+#endif
+    default:
+      break;
+    }
+
+  return self;
+
+#if defined(SYSLOG_NG_HAVE_ZLIB) || SYSLOG_NG_ENABLE_ZSTD
+error:
+  msg_error("Error initializing the compression of S3 object");
+  g_free(self);
+  return NULL;
+#endif
+}
+
+void
+s3_compressor_free(S3Compressor *self)
+{
+  switch (self->method)
+    {
+#ifdef SYSLOG_NG_HAVE_ZLIB
+    case S3_COMPRESSION_GZIP:
+      deflateEnd(&self->gzip);
+      break;
+#endif
+#if SYSLOG_NG_ENABLE_ZSTD
+    case S3_COMPRESSION_ZSTD:
+      ZSTD_freeCCtx(self->zstd);
+      break;
+#endif
+    default:
+      break;
+    }
+  g_free(self);
+}
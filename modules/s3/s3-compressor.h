@@ -0,0 +1,49 @@
+/*
+ * Copyright (c) 2024 One Identity LLC.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#ifndef S3_COMPRESSOR_H_INCLUDED
+#define S3_COMPRESSOR_H_INCLUDED
+
+#include "syslog-ng.h"
+
+typedef enum
+{
+  S3_COMPRESSION_NONE,
+  S3_COMPRESSION_GZIP,
+  S3_COMPRESSION_ZSTD,
+} S3CompressionMethod;
+
+/*
+ * Compresses an object as a single stream, the output may be cut into
+ * parts anywhere, as the parts are concatenated by S3.
+ */
+typedef struct _S3Compressor S3Compressor;
+
+gboolean s3_compression_method_parse(const gchar *name, S3CompressionMethod *method);
+const gchar *s3_compression_method_extension(S3CompressionMethod method);
+
+S3Compressor *s3_compressor_new(S3CompressionMethod method, gint level);
+gboolean s3_compressor_compress(S3Compressor *self, const gchar *data, gsize len, GString *output);
+gboolean s3_compressor_finish(S3Compressor *self, GString *output);
+void s3_compressor_free(S3Compressor *self);
+
+#endif
@@ -0,0 +1,179 @@
+/*
+ * Copyright (c) 2024 One Identity LLC.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#include "s3-object.h"
+#include "s3-uploader.h"
+#include "messages.h"
+
+S3Object *
+s3_object_new(S3Uploader *uploader, const gchar *target_key, const gchar *timestamp,
+              S3CompressionMethod compression, gint compression_level, gsize chunk_size)
+{
+  S3Compressor *compressor = s3_compressor_new(compression, compression_level);
+  if (!compressor)
+    return NULL;
+
+  S3Object *self = g_new0(S3Object, 1);
+
+  g_atomic_counter_set(&self->ref_cnt, 1);
+  self->uploader = uploader;
+  self->target_key = g_strdup(target_key);
+  self->timestamp = g_strdup(timestamp);
+  self->compression = compression;
+  self->chunk_size = chunk_size;
+
+  self->compressor = compressor;
+  self->part = g_string_sized_new(chunk_size + chunk_size / 8);
+  self->modified_at = g_get_monotonic_time();
+
+  g_mutex_init(&self->lock);
+  g_cond_init(&self->cond);
+  self->etags = g_ptr_array_new_with_free_func(g_free);
+  return self;
+}
+
+/* the object continuing @self once it reached max-object-size() */
+S3Object *
+s3_object_new_next(S3Object *self, gint compression_level)
+{
+  S3Object *next = s3_object_new(self->uploader, self->target_key, self->timestamp,
+                                 self->compression, compression_level, self->chunk_size);
+  if (!next)
+    return NULL;
+
+  g_mutex_lock(&self->lock);
+  next->index = self->index + 1;
+  g_mutex_unlock(&self->lock);
+  return next;
+}
+
+void
+s3_object_format_key(S3Object *self, gint index, GString *key)
+{
+  g_string_assign(key, self->target_key);
+  if (self->timestamp[0])
+    g_string_append_printf(key, "-%s", self->timestamp);
+  if (index > 0)
+    g_string_append_printf(key, "-%d", index);
+  g_string_append(key, s3_compression_method_extension(self->compression));
+}
+
+static void
+_submit_part(S3Object *self)
+{
+  GString *part = self->part;
+
+  self->num_parts++;
+  self->part = self->finished ? NULL : g_string_sized_new(self->chunk_size + self->chunk_size / 8);
+  s3_uploader_submit_part(self->uploader, self, self->num_parts, part);
+}
+
+gboolean
+s3_object_write(S3Object *self, const gchar *data, gsize len)
+{
+  g_assert(!self->finished);
+
+  gsize part_len = self->part->len;
+  if (!s3_compressor_compress(self->compressor, data, len, self->part))
+    return FALSE;
+
+  self->size += self->part->len - part_len;
+  self->modified_at = g_get_monotonic_time();
+
+  /* all parts but the last one must be at least 5MiB, so they are cut at chunk-size() */
+  if (self->part->len >= self->chunk_size)
+    _submit_part(self);
+
+  return TRUE;
+}
+
+void
+s3_object_finish(S3Object *self)
+{
+  if (self->finished)
+    return;
+
+  gsize part_len = self->part->len;
+  if (!s3_compressor_finish(self->compressor, self->part))
+    {
+      msg_error("Error finishing the compression of S3 object, its end is likely corrupt",
+                evt_tag_str("target_key", self->target_key));
+    }
+  self->size += self->part->len - part_len;
+  self->finished = TRUE;
+
+  if (self->part->len > 0)
+    _submit_part(self);
+  else
+    {
+      g_string_free(self->part, TRUE);
+      self->part = NULL;
+    }
+
+  s3_compressor_free(self->compressor);
+  self->compressor = NULL;
+
+  s3_uploader_complete_object(self->uploader, self);
+}
+
+gboolean
+s3_object_is_done(S3Object *self)
+{
+  return g_atomic_int_get(&self->done);
+}
+
+void
+s3_object_wait(S3Object *self)
+{
+  g_mutex_lock(&self->lock);
+  while (!self->done)
+    g_cond_wait(&self->cond, &self->lock);
+  g_mutex_unlock(&self->lock);
+}
+
+S3Object *
+s3_object_ref(S3Object *self)
+{
+  g_atomic_counter_inc(&self->ref_cnt);
+  return self;
+}
+
+void
+s3_object_unref(S3Object *self)
+{
+  if (!g_atomic_counter_dec_and_test(&self->ref_cnt))
+    return;
+
+  if (self->compressor)
+    s3_compressor_free(self->compressor);
+  if (self->part)
+    g_string_free(self->part, TRUE);
+
+  g_ptr_array_free(self->etags, TRUE);
+  g_free(self->upload_id);
+  g_free(self->key);
+  g_cond_clear(&self->cond);
+  g_mutex_clear(&self->lock);
+  g_free(self->timestamp);
+  g_free(self->target_key);
+  g_free(self);
+}
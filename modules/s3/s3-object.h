@@ -0,0 +1,86 @@
+/*
+ * Copyright (c) 2024 One Identity LLC.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#ifndef S3_OBJECT_H_INCLUDED
+#define S3_OBJECT_H_INCLUDED
+
+#include "syslog-ng.h"
+#include "s3-compressor.h"
+#include "atomic.h"
+
+typedef struct _S3Uploader S3Uploader;
+typedef struct _S3Object S3Object;
+
+/*
+ * An object being uploaded using a multipart upload.  The worker writes
+ * the compressed messages into the current part, the full parts are
+ * uploaded by the upload threads in parallel.  The multipart upload is
+ * started by the upload of the first part, and completed once the object
+ * is finished and all of its parts are uploaded.
+ */
+struct _S3Object
+{
+  GAtomicCounter ref_cnt;
+  S3Uploader *uploader;
+  gchar *target_key;
+  gchar *timestamp;
+  S3CompressionMethod compression;
+  gsize chunk_size;
+
+  /* used by the worker only */
+  S3Compressor *compressor;
+  GString *part;
+  gint num_parts;
+  guint64 size;
+  gint64 modified_at;
+  gboolean finished;
+
+  /* used by the upload threads, protected by lock */
+  GMutex lock;
+  GCond cond;
+  gint index;
+  gchar *key;
+  gchar *upload_id;
+  /* ETags of the uploaded parts, indexed by part number - 1 */
+  GPtrArray *etags;
+  gint pending_parts;
+  gboolean completion_requested;
+  gboolean failed;
+  /* set under lock, but read atomically, as the lock is held during the start of the upload */
+  gint done;
+};
+
+S3Object *s3_object_new(S3Uploader *uploader, const gchar *target_key, const gchar *timestamp,
+                        S3CompressionMethod compression, gint compression_level, gsize chunk_size);
+S3Object *s3_object_new_next(S3Object *self, gint compression_level);
+
+gboolean s3_object_write(S3Object *self, const gchar *data, gsize len);
+void s3_object_finish(S3Object *self);
+gboolean s3_object_is_done(S3Object *self);
+void s3_object_wait(S3Object *self);
+
+void s3_object_format_key(S3Object *self, gint index, GString *key);
+
+S3Object *s3_object_ref(S3Object *self);
+void s3_object_unref(S3Object *self);
+
+#endif
@@ -0,0 +1,67 @@
+/*
+ * Copyright (c) 2024 One Identity LLC.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#include "s3.h"
+#include "cfg-parser.h"
+#include "s3-grammar.h"
+
+extern int s3_debug;
+int s3_parse(CfgLexer *lexer, LogDriver **instance, gpointer arg);
+
+static CfgLexerKeyword s3_keywords[] =
+{
+  { "s3_native",            KW_S3_NATIVE },
+  { "url",                  KW_URL },
+  { "bucket",               KW_BUCKET },
+  { "access_key",           KW_ACCESS_KEY },
+  { "secret_key",           KW_SECRET_KEY },
+  { "region",               KW_REGION },
+  { "storage_class",        KW_STORAGE_CLASS },
+  { "canned_acl",           KW_CANNED_ACL },
+  { "object_key",           KW_OBJECT_KEY },
+  { "object_key_timestamp", KW_OBJECT_KEY_TIMESTAMP },
+  { "compression",          KW_COMPRESSION },
+  { "compresslevel",        KW_COMPRESSION_LEVEL },
+  { "compression_level",    KW_COMPRESSION_LEVEL },
+  { "chunk_size",           KW_CHUNK_SIZE },
+  { "max_object_size",      KW_MAX_OBJECT_SIZE },
+  { "upload_threads",       KW_UPLOAD_THREADS },
+  { "max_pending_uploads",  KW_MAX_PENDING_UPLOADS },
+  { "max_spilled_uploads",  KW_MAX_SPILLED_UPLOADS },
+  { "upload_retry_timeout", KW_UPLOAD_RETRY_TIMEOUT },
+  { "flush_grace_period",   KW_FLUSH_GRACE_PERIOD },
+  { "spill_dir",            KW_SPILL_DIR },
+  { NULL }
+};
+
+CfgParser s3_parser =
+{
+#if SYSLOG_NG_ENABLE_DEBUG
+  .debug_flag = &s3_debug,
+#endif
+  .name = "s3",
+  .keywords = s3_keywords,
+  .parse = (int (*)(CfgLexer *lexer, gpointer *instance, gpointer)) s3_parse,
+  .cleanup = (void (*)(gpointer)) log_pipe_unref,
+};
+
+CFG_PARSER_IMPLEMENT_LEXER_BINDING(s3_, S3_, LogDriver **)
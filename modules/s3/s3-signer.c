@@ -0,0 +1,129 @@
+/*
+ * Copyright (c) 2024 One Identity LLC.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#include "s3-signer.h"
+
+#include <string.h>
+#include <time.h>
+
+#define S3_SIGNER_ALGORITHM "AWS4-HMAC-SHA256"
+
+static void
+_hmac(const guint8 *key, gsize key_len, const gchar *data, guint8 digest[32])
+{
+  GHmac *hmac = g_hmac_new(G_CHECKSUM_SHA256, key, key_len);
+  gsize digest_len = 32;
+
+  g_hmac_update(hmac, (const guchar *) data, -1);
+  g_hmac_get_digest(hmac, digest, &digest_len);
+  g_hmac_unref(hmac);
+}
+
+static void
+_derive_signing_key(const gchar *secret_key, const gchar *date, const gchar *region, guint8 signing_key[32])
+{
+  gchar *secret = g_strconcat("AWS4", secret_key, NULL);
+  guint8 key[32];
+
+  _hmac((const guint8 *) secret, strlen(secret), date, key);
+  _hmac(key, sizeof(key), region, key);
+  _hmac(key, sizeof(key), "s3", key);
+  _hmac(key, sizeof(key), "aws4_request", signing_key);
+
+  memset(secret, 0, strlen(secret));
+  g_free(secret);
+}
+
+void
+s3_signer_sign(const gchar *access_key, const gchar *secret_key, const gchar *region,
+               const gchar *method, const gchar *uri, const gchar *query,
+               const S3SignedHeader *headers, gint num_headers,
+               const gchar *amz_date, const gchar *payload_hash,
+               GString *authorization)
+{
+  GString *canonical_request = g_string_sized_new(512);
+  GString *signed_headers = g_string_sized_new(128);
+  gchar date[9];
+
+  g_strlcpy(date, amz_date, sizeof(date));
+
+  g_string_append_printf(canonical_request, "%s\n%s\n%s\n", method, uri, query);
+  for (gint i = 0; i < num_headers; i++)
+    {
+      g_string_append_printf(canonical_request, "%s:%s\n", headers[i].name, headers[i].value);
+
+      if (i > 0)
+        g_string_append_c(signed_headers, ';');
+      g_string_append(signed_headers, headers[i].name);
+    }
+  g_string_append_printf(canonical_request, "\n%s\n%s", signed_headers->str, payload_hash);
+
+  gchar *canonical_request_hash = g_compute_checksum_for_string(G_CHECKSUM_SHA256, canonical_request->str,
+                                                                canonical_request->len);
+  gchar *string_to_sign = g_strdup_printf(S3_SIGNER_ALGORITHM "\n%s\n%s/%s/s3/aws4_request\n%s",
+                                          amz_date, date, region, canonical_request_hash);
+
+  guint8 signing_key[32];
+  _derive_signing_key(secret_key, date, region, signing_key);
+
+  GHmac *hmac = g_hmac_new(G_CHECKSUM_SHA256, signing_key, sizeof(signing_key));
+  g_hmac_update(hmac, (const guchar *) string_to_sign, -1);
+
+  g_string_printf(authorization, S3_SIGNER_ALGORITHM " Credential=%s/%s/%s/s3/aws4_request,"
+                  "SignedHeaders=%s,Signature=%s",
+                  access_key, date, region, signed_headers->str, g_hmac_get_string(hmac));
+
+  g_hmac_unref(hmac);
+  memset(signing_key, 0, sizeof(signing_key));
+  g_free(string_to_sign);
+  g_free(canonical_request_hash);
+  g_string_free(signed_headers, TRUE);
+  g_string_free(canonical_request, TRUE);
+}
+
+void
+s3_signer_format_amz_date(time_t t, gchar amz_date[17])
+{
+  struct tm tm;
+
+  gmtime_r(&t, &tm);
+  strftime(amz_date, 17, "%Y%m%dT%H%M%SZ", &tm);
+}
+
+gchar *
+s3_signer_hash_payload(const gchar *data, gsize len)
+{
+  return g_compute_checksum_for_data(G_CHECKSUM_SHA256, (const guchar *) data, len);
+}
+
+/* URI-encodes everything but the unreserved characters of RFC 3986, as required by the canonical request */
+void
+s3_signer_uri_encode(GString *result, const gchar *value, gboolean encode_slash)
+{
+  for (const gchar *p = value; *p; p++)
+    {
+      if (g_ascii_isalnum(*p) || strchr("-_.~", *p) || (*p == '/' && !encode_slash))
+        g_string_append_c(result, *p);
+      else
+        g_string_append_printf(result, "%%%02X", (guchar) *p);
+    }
+}
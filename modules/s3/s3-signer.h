@@ -0,0 +1,50 @@
+/*
+ * Copyright (c) 2024 One Identity LLC.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#ifndef S3_SIGNER_H_INCLUDED
+#define S3_SIGNER_H_INCLUDED
+
+#include "syslog-ng.h"
+
+/* a header covered by the signature, its name must be in lowercase */
+typedef struct _S3SignedHeader
+{
+  const gchar *name;
+  const gchar *value;
+} S3SignedHeader;
+
+/*
+ * AWS Signature Version 4 of the s3 service.  @uri and @query must be in
+ * canonical form (URI-encoded, parameters sorted by name), @headers sorted
+ * by name, and include host, x-amz-content-sha256 and x-amz-date.
+ */
+void s3_signer_sign(const gchar *access_key, const gchar *secret_key, const gchar *region,
+                    const gchar *method, const gchar *uri, const gchar *query,
+                    const S3SignedHeader *headers, gint num_headers,
+                    const gchar *amz_date, const gchar *payload_hash,
+                    GString *authorization);
+
+void s3_signer_format_amz_date(time_t t, gchar amz_date[17]);
+gchar *s3_signer_hash_payload(const gchar *data, gsize len);
+void s3_signer_uri_encode(GString *result, const gchar *value, gboolean encode_slash);
+
+#endif
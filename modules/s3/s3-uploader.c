@@ -0,0 +1,943 @@
+/*
+ * Copyright (c) 2024 One Identity LLC.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#include "s3-uploader.h"
+#include "s3-signer.h"
+#include "messages.h"
+
+#define CURL_NO_OLDIES 1
+#include <curl/curl.h>
+
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+
+/* the wait between the retries doubles up to the maximum */
+#define S3_RETRY_BACKOFF_USEC G_USEC_PER_SEC
+#define S3_MAX_RETRY_BACKOFF_USEC (60 * G_USEC_PER_SEC)
+#define S3_CONNECT_TIMEOUT 30L
+/* a transfer is aborted if it is stuck for this many seconds */
+#define S3_LOW_SPEED_TIME 60L
+
+struct _S3Uploader
+{
+  S3UploaderOptions options;
+  gchar *base_url;
+  gchar *host;
+  GThreadPool *pool;
+
+  GMutex lock;
+  /* keys of the objects being uploaded, they are not visible to HEAD until completed */
+  GHashTable *reserved_keys;
+  gint parts_in_memory;
+  gint spilled_parts;
+  /* set on shutdown, the retries of transient errors are given up */
+  gboolean stopping;
+  GCond stop_cond;
+};
+
+typedef enum
+{
+  S3_REQUEST_SUCCESS,
+  /* the request can not be sent, or S3 could not serve it: it is worth repeating */
+  S3_REQUEST_RETRY,
+  S3_REQUEST_FAILED,
+} S3RequestResult;
+
+typedef struct _S3UploadTask
+{
+  S3Object *object;
+  /* 0 completes the multipart upload of the object */
+  gint part_number;
+  GString *data;
+  gchar *spill_file;
+} S3UploadTask;
+
+typedef struct _S3Response
+{
+  glong status;
+  GString *body;
+  GString *etag;
+} S3Response;
+
+/* each upload thread keeps its handle, so that the connections are reused */
+static GPrivate curl_handle = G_PRIVATE_INIT((GDestroyNotify) curl_easy_cleanup);
+
+static CURL *
+_get_curl_handle(void)
+{
+  CURL *curl = g_private_get(&curl_handle);
+
+  if (curl)
+    {
+      curl_easy_reset(curl);
+      return curl;
+    }
+
+  curl = curl_easy_init();
+  g_private_set(&curl_handle, curl);
+  return curl;
+}
+
+static void
+_response_init(S3Response *self)
+{
+  self->status = 0;
+  self->body = g_string_sized_new(256);
+  self->etag = g_string_sized_new(64);
+}
+
+static void
+_response_clear(S3Response *self)
+{
+  g_string_free(self->body, TRUE);
+  g_string_free(self->etag, TRUE);
+}
+
+static inline gboolean
+_response_is_success(S3Response *self)
+{
+  return self->status >= 200 && self->status < 300;
+}
+
+static S3RequestResult
+_response_classify(gboolean sent, S3Response *self)
+{
+  if (!sent)
+    return S3_REQUEST_RETRY;
+
+  if (_response_is_success(self))
+    return S3_REQUEST_SUCCESS;
+
+  if (self->status >= 500 || self->status == 408 || self->status == 429)
+    return S3_REQUEST_RETRY;
+
+  return S3_REQUEST_FAILED;
+}
+
+static size_t
+_curl_write_function(gchar *ptr, size_t size, size_t nmemb, gpointer userdata)
+{
+  GString *body = (GString *) userdata;
+
+  g_string_append_len(body, ptr, size * nmemb);
+  return size * nmemb;
+}
+
+static size_t
+_curl_header_function(gchar *buffer, size_t size, size_t nitems, gpointer userdata)
+{
+  GString *etag = (GString *) userdata;
+  gsize len = size * nitems;
+
+  if (len > 5 && g_ascii_strncasecmp(buffer, "etag:", 5) == 0)
+    {
+      g_string_truncate(etag, 0);
+      g_string_append_len(etag, buffer + 5, len - 5);
+      g_strstrip(etag->str);
+      g_string_set_size(etag, strlen(etag->str));
+    }
+  return len;
+}
+
+static gint
+_compare_header_names(gconstpointer a, gconstpointer b)
+{
+  return strcmp(((const S3SignedHeader *) a)->name, ((const S3SignedHeader *) b)->name);
+}
+
+static struct curl_slist *
+_format_headers(GArray *headers, const gchar *authorization)
+{
+  struct curl_slist *list = NULL;
+  GString *header = g_string_sized_new(256);
+
+  for (guint i = 0; i < headers->len; i++)
+    {
+      S3SignedHeader *h = &g_array_index(headers, S3SignedHeader, i);
+
+      /* curl sends it in the same form, based on the URL */
+      if (strcmp(h->name, "host") == 0)
+        continue;
+
+      g_string_printf(header, "%s: %s", h->name, h->value);
+      list = curl_slist_append(list, header->str);
+    }
+
+  g_string_printf(header, "Authorization: %s", authorization);
+  list = curl_slist_append(list, header->str);
+  list = curl_slist_append(list, "Expect:");
+  list = curl_slist_append(list, "Content-Type:");
+
+  g_string_free(header, TRUE);
+  return list;
+}
+
+/* sends a signed request to the bucket, or to @key in it */
+static gboolean
+_perform(S3Uploader *self, const gchar *method, const gchar *key, const gchar *query,
+         const gchar *body, gsize body_len, const S3SignedHeader *extra_headers, gint num_extra_headers,
+         S3Response *response)
+{
+  CURL *curl = _get_curl_handle();
+  if (!curl)
+    {
+      msg_error("Error initializing curl for S3 request");
+      return FALSE;
+    }
+
+  GString *uri = g_string_sized_new(256);
+  g_string_append_c(uri, '/');
+  s3_signer_uri_encode(uri, self->options.bucket, TRUE);
+  if (key)
+    {
+      g_string_append_c(uri, '/');
+      s3_signer_uri_encode(uri, key, FALSE);
+    }
+
+  gchar amz_date[17];
+  s3_signer_format_amz_date(time(NULL), amz_date);
+  gchar *payload_hash = s3_signer_hash_payload(body ? body : "", body_len);
+
+  S3SignedHeader common_headers[] =
+  {
+    { "host", self->host },
+    { "x-amz-content-sha256", payload_hash },
+    { "x-amz-date", amz_date },
+  };
+  GArray *headers = g_array_sized_new(FALSE, FALSE, sizeof(S3SignedHeader), 8);
+  g_array_append_vals(headers, common_headers, G_N_ELEMENTS(common_headers));
+  g_array_append_vals(headers, extra_headers, num_extra_headers);
+  g_array_sort(headers, _compare_header_names);
+
+  GString *authorization = g_string_sized_new(256);
+  s3_signer_sign(self->options.access_key, self->options.secret_key, self->options.region,
+                 method, uri->str, query ? query : "",
+                 (const S3SignedHeader *) headers->data, headers->len,
+                 amz_date, payload_hash, authorization);
+  struct curl_slist *header_list = _format_headers(headers, authorization->str);
+
+  GString *url = g_string_new(self->base_url);
+  g_string_append(url, uri->str);
+  if (query && query[0])
+    g_string_append_printf(url, "?%s", query);
+
+  curl_easy_setopt(curl, CURLOPT_URL, url->str);
+  curl_easy_setopt(curl, CURLOPT_HTTPHEADER, header_list);
+  curl_easy_setopt(curl, CURLOPT_NOSIGNAL, 1L);
+  curl_easy_setopt(curl, CURLOPT_CONNECTTIMEOUT, S3_CONNECT_TIMEOUT);
+  curl_easy_setopt(curl, CURLOPT_LOW_SPEED_LIMIT, 1L);
+  curl_easy_setopt(curl, CURLOPT_LOW_SPEED_TIME, S3_LOW_SPEED_TIME);
+  curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, _curl_write_function);
+  curl_easy_setopt(curl, CURLOPT_WRITEDATA, response->body);
+  curl_easy_setopt(curl, CURLOPT_HEADERFUNCTION, _curl_header_function);
+  curl_easy_setopt(curl, CURLOPT_HEADERDATA, response->etag);
+
+  if (strcmp(method, "HEAD") == 0)
+    {
+      curl_easy_setopt(curl, CURLOPT_NOBODY, 1L);
+    }
+  else
+    {
+      curl_easy_setopt(curl, CURLOPT_CUSTOMREQUEST, method);
+      if (body)
+        {
+          curl_easy_setopt(curl, CURLOPT_POSTFIELDS, body);
+          curl_easy_setopt(curl, CURLOPT_POSTFIELDSIZE_LARGE, (curl_off_t) body_len);
+        }
+    }
+
+  CURLcode code = curl_easy_perform(curl);
+  if (code == CURLE_OK)
+    curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &response->status);
+  else
+    msg_error("Error sending S3 request",
+              evt_tag_str("method", method),
+              evt_tag_str("url", url->str),
+              evt_tag_str("error", curl_easy_strerror(code)));
+
+  curl_slist_free_all(header_list);
+  g_string_free(url, TRUE);
+  g_string_free(authorization, TRUE);
+  g_array_free(headers, TRUE);
+  g_free(payload_hash);
+  g_string_free(uri, TRUE);
+
+  return code == CURLE_OK;
+}
+
+static void
+_log_failed_response(const gchar *message, S3Object *object, S3Response *response)
+{
+  msg_error(message,
+            evt_tag_str("key", object->key ? object->key : object->target_key),
+            evt_tag_long("status", response->status),
+            evt_tag_str("response", response->body->str));
+}
+
+static gchar *
+_extract_xml_element(const gchar *xml, const gchar *name)
+{
+  gchar *open_tag = g_strdup_printf("<%s>", name);
+  gchar *close_tag = g_strdup_printf("</%s>", name);
+  gchar *value = NULL;
+
+  const gchar *begin = strstr(xml, open_tag);
+  if (begin)
+    {
+      begin += strlen(open_tag);
+
+      const gchar *end = strstr(begin, close_tag);
+      if (end)
+        value = g_strndup(begin, end - begin);
+    }
+
+  g_free(close_tag);
+  g_free(open_tag);
+  return value;
+}
+
+static void
+_release_key(S3Uploader *self, const gchar *key)
+{
+  g_mutex_lock(&self->lock);
+  g_hash_table_remove(self->reserved_keys, key);
+  g_mutex_unlock(&self->lock);
+}
+
+/*
+ * Waits before the next retry of a transient error, returns FALSE if the
+ * request should be given up, as upload-retry-timeout() has passed since
+ * the first failure, or syslog-ng is shutting down.
+ */
+static gboolean
+_wait_before_retry(S3Uploader *self, gint64 *retry_since, gint64 *backoff)
+{
+  gint64 now = g_get_monotonic_time();
+
+  if (*retry_since == 0)
+    {
+      *retry_since = now;
+      *backoff = S3_RETRY_BACKOFF_USEC;
+    }
+  else
+    {
+      *backoff = MIN(*backoff * 2, S3_MAX_RETRY_BACKOFF_USEC);
+    }
+
+  if (self->options.upload_retry_timeout > 0 &&
+      now - *retry_since >= (gint64) self->options.upload_retry_timeout * G_USEC_PER_SEC)
+    return FALSE;
+
+  g_mutex_lock(&self->lock);
+  gint64 wait_until = now + *backoff;
+  while (!self->stopping && g_cond_wait_until(&self->stop_cond, &self->lock, wait_until))
+    ;
+  gboolean stopping = self->stopping;
+  g_mutex_unlock(&self->lock);
+
+  return !stopping;
+}
+
+/*
+ * Picks the first free index of the object, unused both in the bucket and
+ * by the objects being uploaded, so restarts do not overwrite the objects
+ * of earlier runs.
+ */
+static S3RequestResult
+_reserve_key(S3Uploader *self, S3Object *object)
+{
+  GString *key = g_string_sized_new(128);
+
+  while (TRUE)
+    {
+      s3_object_format_key(object, object->index, key);
+
+      g_mutex_lock(&self->lock);
+      gboolean reserved = g_hash_table_contains(self->reserved_keys, key->str);
+      if (!reserved)
+        g_hash_table_add(self->reserved_keys, g_strdup(key->str));
+      g_mutex_unlock(&self->lock);
+
+      if (reserved)
+        {
+          object->index++;
+          continue;
+        }
+
+      S3Response response;
+      _response_init(&response);
+      gboolean sent = _perform(self, "HEAD", key->str, NULL, NULL, 0, NULL, 0, &response);
+      S3RequestResult result = _response_classify(sent, &response);
+      glong status = response.status;
+      _response_clear(&response);
+
+      if (status == 404)
+        {
+          object->key = g_string_free(key, FALSE);
+          return S3_REQUEST_SUCCESS;
+        }
+
+      _release_key(self, key->str);
+      if (result != S3_REQUEST_SUCCESS)
+        {
+          /* without s3:ListBucket permission missing objects are reported as 403, those are not taken as free */
+          if (status == 403)
+            msg_error("Error checking the existence of S3 object, s3:GetObject and s3:ListBucket permissions "
+                      "are needed not to overwrite existing objects",
+                      evt_tag_str("key", key->str),
+                      evt_tag_long("status", status));
+          else
+            msg_error("Error checking the existence of S3 object",
+                      evt_tag_str("key", key->str),
+                      evt_tag_long("status", status));
+          g_string_free(key, TRUE);
+          return result;
+        }
+      object->index++;
+    }
+}
+
+/* must be called with object->lock held */
+static S3RequestResult
+_start_upload(S3Uploader *self, S3Object *object)
+{
+  if (!object->key)
+    {
+      S3RequestResult result = _reserve_key(self, object);
+      if (result != S3_REQUEST_SUCCESS)
+        return result;
+    }
+
+  S3SignedHeader headers[2];
+  gint num_headers = 0;
+
+  if (self->options.canned_acl[0])
+    headers[num_headers++] = (S3SignedHeader) { "x-amz-acl", self->options.canned_acl };
+  headers[num_headers++] = (S3SignedHeader) { "x-amz-storage-class", self->options.storage_class };
+
+  S3Response response;
+  _response_init(&response);
+  gboolean sent = _perform(self, "POST", object->key, "uploads=", "", 0, headers, num_headers, &response);
+  S3RequestResult result = _response_classify(sent, &response);
+  if (result == S3_REQUEST_SUCCESS)
+    {
+      object->upload_id = _extract_xml_element(response.body->str, "UploadId");
+      if (object->upload_id)
+        msg_debug("S3 multipart upload started",
+                  evt_tag_str("key", object->key),
+                  evt_tag_str("upload_id", object->upload_id));
+      else
+        result = S3_REQUEST_RETRY;
+    }
+  if (sent && result != S3_REQUEST_SUCCESS)
+    _log_failed_response("Error starting S3 multipart upload", object, &response);
+  _response_clear(&response);
+
+  return result;
+}
+
+static gchar *
+_format_upload_id_query(S3Object *object, gint part_number)
+{
+  GString *query = g_string_sized_new(128);
+
+  if (part_number > 0)
+    g_string_append_printf(query, "partNumber=%d&", part_number);
+  g_string_append(query, "uploadId=");
+  s3_signer_uri_encode(query, object->upload_id, TRUE);
+
+  return g_string_free(query, FALSE);
+}
+
+static S3RequestResult
+_send_part(S3Uploader *self, S3Object *object, gint part_number, const gchar *data, gsize len)
+{
+  g_mutex_lock(&object->lock);
+  if (object->failed)
+    {
+      g_mutex_unlock(&object->lock);
+      return S3_REQUEST_FAILED;
+    }
+
+  if (!object->upload_id)
+    {
+      S3RequestResult result = _start_upload(self, object);
+      if (result != S3_REQUEST_SUCCESS)
+        {
+          g_mutex_unlock(&object->lock);
+          return result;
+        }
+    }
+
+  gchar *query = _format_upload_id_query(object, part_number);
+  g_mutex_unlock(&object->lock);
+
+  S3Response response;
+  _response_init(&response);
+  gboolean sent = _perform(self, "PUT", object->key, query, data, len, NULL, 0, &response);
+  S3RequestResult result = _response_classify(sent, &response);
+  if (result == S3_REQUEST_SUCCESS && response.etag->len == 0)
+    result = S3_REQUEST_RETRY;
+
+  if (result == S3_REQUEST_SUCCESS)
+    {
+      g_mutex_lock(&object->lock);
+      if ((gint) object->etags->len < part_number)
+        g_ptr_array_set_size(object->etags, part_number);
+      g_free(g_ptr_array_index(object->etags, part_number - 1));
+      g_ptr_array_index(object->etags, part_number - 1) = g_strdup(response.etag->str);
+      g_mutex_unlock(&object->lock);
+    }
+  else if (sent)
+    {
+      _log_failed_response("Error uploading S3 part", object, &response);
+    }
+  _response_clear(&response);
+  g_free(query);
+
+  return result;
+}
+
+static gboolean
+_load_spilled_part(S3UploadTask *task, gchar **data, gsize *len)
+{
+  GError *error = NULL;
+
+  if (!g_file_get_contents(task->spill_file, data, len, &error))
+    {
+      msg_error("Error reading spilled S3 part",
+                evt_tag_str("filename", task->spill_file),
+                evt_tag_str("error", error->message));
+      g_clear_error(&error);
+      return FALSE;
+    }
+  return TRUE;
+}
+
+static void _complete_upload(S3Uploader *self, S3Object *object);
+
+static void
+_upload_part(S3Uploader *self, S3UploadTask *task)
+{
+  S3Object *object = task->object;
+  gchar *loaded = NULL;
+  const gchar *data;
+  gsize len;
+  S3RequestResult result = S3_REQUEST_FAILED;
+  gint64 retry_since = 0, backoff = 0;
+
+  if (task->spill_file)
+    {
+      if (_load_spilled_part(task, &loaded, &len))
+        data = loaded;
+      else
+        goto exit;
+    }
+  else
+    {
+      data = task->data->str;
+      len = task->data->len;
+    }
+
+  while ((result = _send_part(self, object, task->part_number, data, len)) == S3_REQUEST_RETRY)
+    {
+      if (!_wait_before_retry(self, &retry_since, &backoff))
+        break;
+    }
+
+exit:
+  g_free(loaded);
+
+  g_mutex_lock(&self->lock);
+  if (task->spill_file)
+    self->spilled_parts--;
+  else
+    self->parts_in_memory--;
+  g_mutex_unlock(&self->lock);
+
+  g_mutex_lock(&object->lock);
+  if (result == S3_REQUEST_RETRY)
+    {
+      /* the rest of the parts can still be uploaded, the object is completed without this one */
+      msg_error("Error uploading S3 part, giving up retrying, the messages of the part are lost",
+                evt_tag_str("key", object->key ? object->key : object->target_key),
+                evt_tag_int("part_number", task->part_number));
+    }
+  else if (result == S3_REQUEST_FAILED && !object->failed)
+    {
+      msg_error("Error uploading S3 part, giving up on the object",
+                evt_tag_str("key", object->key ? object->key : object->target_key),
+                evt_tag_int("part_number", task->part_number));
+      object->failed = TRUE;
+    }
+  object->pending_parts--;
+  gboolean complete = object->completion_requested && object->pending_parts == 0;
+  g_mutex_unlock(&object->lock);
+
+  if (complete)
+    _complete_upload(self, object);
+}
+
+/* the parts given up are left out, the part numbers do not have to be consecutive */
+static GString *
+_format_complete_request(S3Object *object, gint *num_parts)
+{
+  GString *body = g_string_sized_new(64 + object->etags->len * 96);
+
+  *num_parts = 0;
+  g_string_append(body, "<CompleteMultipartUpload>");
+  for (guint i = 0; i < object->etags->len; i++)
+    {
+      const gchar *etag = (const gchar *) g_ptr_array_index(object->etags, i);
+      if (!etag)
+        continue;
+
+      g_string_append_printf(body, "<Part><PartNumber>%u</PartNumber>", i + 1);
+      g_string_append(body, "<ETag>");
+      g_string_append(body, etag);
+      g_string_append(body, "</ETag></Part>");
+      (*num_parts)++;
+    }
+  g_string_append(body, "</CompleteMultipartUpload>");
+
+  return body;
+}
+
+static S3RequestResult
+_send_complete(S3Uploader *self, S3Object *object, const gchar *query, GString *body)
+{
+  S3RequestResult result;
+  gint64 retry_since = 0, backoff = 0;
+
+  while (TRUE)
+    {
+      S3Response response;
+      _response_init(&response);
+
+      gboolean sent = _perform(self, "POST", object->key, query, body->str, body->len, NULL, 0, &response);
+      result = _response_classify(sent, &response);
+      /* the request may fail with a 200 response, in which case the body is an <Error> */
+      if (result == S3_REQUEST_SUCCESS && strstr(response.body->str, "<Error>"))
+        result = S3_REQUEST_RETRY;
+      if (sent && result != S3_REQUEST_SUCCESS)
+        _log_failed_response("Error completing S3 multipart upload", object, &response);
+      _response_clear(&response);
+
+      if (result != S3_REQUEST_RETRY || !_wait_before_retry(self, &retry_since, &backoff))
+        return result;
+    }
+}
+
+static void
+_abort_upload(S3Uploader *self, S3Object *object, const gchar *query)
+{
+  S3Response response;
+  _response_init(&response);
+  if (_perform(self, "DELETE", object->key, query, NULL, 0, NULL, 0, &response) && !_response_is_success(&response))
+    _log_failed_response("Error aborting S3 multipart upload", object, &response);
+  _response_clear(&response);
+
+  msg_error("S3 multipart upload aborted, the messages of the object are lost",
+            evt_tag_str("key", object->key));
+}
+
+/*
+ * No part of the object is pending, so it is accessed without the lock,
+ * except for done.  Only permanent errors abort the upload: if the retries
+ * are given up, the already uploaded parts are kept in S3.
+ */
+static void
+_complete_upload(S3Uploader *self, S3Object *object)
+{
+  gboolean left_incomplete = FALSE;
+
+  if (object->upload_id)
+    {
+      gchar *query = _format_upload_id_query(object, 0);
+      gint num_parts;
+      GString *body = _format_complete_request(object, &num_parts);
+      S3RequestResult result = S3_REQUEST_FAILED;
+
+      if (!object->failed && num_parts > 0)
+        result = _send_complete(self, object, query, body);
+
+      if (result == S3_REQUEST_SUCCESS)
+        msg_info("S3 object uploaded",
+                 evt_tag_str("key", object->key),
+                 evt_tag_int("parts", num_parts));
+      else if (result == S3_REQUEST_RETRY)
+        {
+          msg_error("Error completing S3 multipart upload, giving up retrying, the upload is left incomplete",
+                    evt_tag_str("key", object->key),
+                    evt_tag_str("upload_id", object->upload_id));
+          left_incomplete = TRUE;
+        }
+      else
+        _abort_upload(self, object, query);
+
+      g_string_free(body, TRUE);
+      g_free(query);
+    }
+
+  /* the key stays reserved, so that no other object is uploaded over the incomplete upload */
+  if (object->key && !left_incomplete)
+    _release_key(self, object->key);
+
+  g_mutex_lock(&object->lock);
+  g_atomic_int_set(&object->done, TRUE);
+  g_cond_broadcast(&object->cond);
+  g_mutex_unlock(&object->lock);
+}
+
+static void
+_process_task(gpointer data, gpointer user_data)
+{
+  S3UploadTask *task = (S3UploadTask *) data;
+  S3Uploader *self = (S3Uploader *) user_data;
+
+  if (task->part_number > 0)
+    _upload_part(self, task);
+  else
+    _complete_upload(self, task->object);
+
+  if (task->spill_file)
+    {
+      unlink(task->spill_file);
+      g_free(task->spill_file);
+    }
+  if (task->data)
+    g_string_free(task->data, TRUE);
+  s3_object_unref(task->object);
+  g_free(task);
+}
+
+static gchar *
+_spill_part(S3Uploader *self, GString *data)
+{
+  gchar *filename = g_build_filename(self->options.spill_dir, "s3-part-XXXXXX", NULL);
+  gint fd = g_mkstemp_full(filename, O_WRONLY, 0600);
+
+  if (fd < 0)
+    goto error;
+
+  for (gsize written = 0; written < data->len; )
+    {
+      gssize rc = write(fd, data->str + written, data->len - written);
+      if (rc < 0)
+        {
+          if (errno == EINTR)
+            continue;
+          close(fd);
+          unlink(filename);
+          goto error;
+        }
+      written += rc;
+    }
+
+  close(fd);
+  return filename;
+
+error:
+  msg_error("Error spilling S3 part to disk, keeping it in memory",
+            evt_tag_str("filename", filename),
+            evt_tag_error("error"));
+  g_free(filename);
+  return NULL;
+}
+
+void
+s3_uploader_submit_part(S3Uploader *self, S3Object *object, gint part_number, GString *data)
+{
+  S3UploadTask *task = g_new0(S3UploadTask, 1);
+
+  task->object = s3_object_ref(object);
+  task->part_number = part_number;
+
+  g_mutex_lock(&object->lock);
+  object->pending_parts++;
+  g_mutex_unlock(&object->lock);
+
+  g_mutex_lock(&self->lock);
+  gboolean spill = self->options.spill_dir && self->parts_in_memory >= self->options.max_pending_uploads &&
+                   self->spilled_parts < self->options.max_spilled_uploads;
+  g_mutex_unlock(&self->lock);
+
+  if (spill)
+    task->spill_file = _spill_part(self, data);
+
+  g_mutex_lock(&self->lock);
+  if (task->spill_file)
+    self->spilled_parts++;
+  else
+    self->parts_in_memory++;
+  g_mutex_unlock(&self->lock);
+
+  if (task->spill_file)
+    g_string_free(data, TRUE);
+  else
+    task->data = data;
+
+  g_thread_pool_push(self->pool, task, NULL);
+}
+
+/*
+ * The uploads can not keep up: max-pending-uploads() parts are in memory
+ * and max-spilled-uploads() parts are in spill-dir().
+ */
+gboolean
+s3_uploader_is_full(S3Uploader *self)
+{
+  g_mutex_lock(&self->lock);
+  gboolean full = self->parts_in_memory >= self->options.max_pending_uploads &&
+                  (!self->options.spill_dir || self->spilled_parts >= self->options.max_spilled_uploads);
+  g_mutex_unlock(&self->lock);
+
+  return full;
+}
+
+/* the transient errors are not retried any more, called on shutdown */
+void
+s3_uploader_stop(S3Uploader *self)
+{
+  g_mutex_lock(&self->lock);
+  self->stopping = TRUE;
+  g_cond_broadcast(&self->stop_cond);
+  g_mutex_unlock(&self->lock);
+}
+
+void
+s3_uploader_complete_object(S3Uploader *self, S3Object *object)
+{
+  g_mutex_lock(&object->lock);
+  object->completion_requested = TRUE;
+  gboolean complete = object->pending_parts == 0;
+  g_mutex_unlock(&object->lock);
+
+  if (!complete)
+    return;
+
+  S3UploadTask *task = g_new0(S3UploadTask, 1);
+  task->object = s3_object_ref(object);
+  g_thread_pool_push(self->pool, task, NULL);
+}
+
+gboolean
+s3_uploader_check_bucket(S3Uploader *self)
+{
+  S3Response response;
+  gboolean success = FALSE;
+
+  _response_init(&response);
+  if (!_perform(self, "HEAD", NULL, NULL, NULL, 0, NULL, 0, &response))
+    goto exit;
+
+  if (_response_is_success(&response))
+    {
+      success = TRUE;
+      goto exit;
+    }
+
+  if (response.status != 404)
+    {
+      msg_error("Error checking S3 bucket",
+                evt_tag_str("bucket", self->options.bucket),
+                evt_tag_long("status", response.status));
+      goto exit;
+    }
+
+  msg_info("S3 bucket does not exist, trying to create it",
+           evt_tag_str("bucket", self->options.bucket));
+
+  GString *body = g_string_new("");
+  if (strcmp(self->options.region, "us-east-1") != 0)
+    g_string_printf(body, "<CreateBucketConfiguration><LocationConstraint>%s</LocationConstraint>"
+                    "</CreateBucketConfiguration>", self->options.region);
+
+  _response_clear(&response);
+  _response_init(&response);
+  if (_perform(self, "PUT", NULL, NULL, body->str, body->len, NULL, 0, &response))
+    {
+      success = _response_is_success(&response);
+      if (!success)
+        msg_error("Error creating S3 bucket",
+                  evt_tag_str("bucket", self->options.bucket),
+                  evt_tag_long("status", response.status),
+                  evt_tag_str("response", response.body->str));
+    }
+  g_string_free(body, TRUE);
+
+exit:
+  _response_clear(&response);
+  return success;
+}
+
+S3Uploader *
+s3_uploader_new(const S3UploaderOptions *options)
+{
+  const gchar *authority = strstr(options->url, "://");
+  if (!authority)
+    {
+      msg_error("Error parsing S3 url(), it must contain a scheme",
+                evt_tag_str("url", options->url));
+      return NULL;
+    }
+  authority += 3;
+
+  S3Uploader *self = g_new0(S3Uploader, 1);
+  GError *error = NULL;
+
+  self->options = *options;
+  self->host = g_strndup(authority, strcspn(authority, "/"));
+  self->base_url = g_strndup(options->url, authority - options->url + strlen(self->host));
+
+  g_mutex_init(&self->lock);
+  g_cond_init(&self->stop_cond);
+  self->reserved_keys = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+  self->pool = g_thread_pool_new(_process_task, self, options->upload_threads, TRUE, &error);
+  if (!self->pool)
+    {
+      msg_error("Error starting S3 upload threads",
+                evt_tag_str("error", error->message));
+      g_clear_error(&error);
+      s3_uploader_free(self);
+      return NULL;
+    }
+
+  return self;
+}
+
+/* waits for the queued uploads */
+void
+s3_uploader_free(S3Uploader *self)
+{
+  if (self->pool)
+    g_thread_pool_free(self->pool, FALSE, TRUE);
+
+  g_hash_table_destroy(self->reserved_keys);
+  g_cond_clear(&self->stop_cond);
+  g_mutex_clear(&self->lock);
+  g_free(self->base_url);
+  g_free(self->host);
+  g_free(self);
+}
@@ -0,0 +1,62 @@
+/*
+ * Copyright (c) 2024 One Identity LLC.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#ifndef S3_UPLOADER_H_INCLUDED
+#define S3_UPLOADER_H_INCLUDED
+
+#include "syslog-ng.h"
+#include "s3-object.h"
+
+/* the strings are borrowed from the driver, which outlives the uploader */
+typedef struct _S3UploaderOptions
+{
+  const gchar *url;
+  const gchar *bucket;
+  const gchar *access_key;
+  const gchar *secret_key;
+  const gchar *region;
+  const gchar *storage_class;
+  const gchar *canned_acl;
+  const gchar *spill_dir;
+  gint upload_threads;
+  gint max_pending_uploads;
+  gint max_spilled_uploads;
+  /* in seconds, 0 retries the transient errors until shutdown */
+  gint upload_retry_timeout;
+} S3UploaderOptions;
+
+/*
+ * Uploads the parts of the objects on a pool of upload-threads() threads.
+ * At most max-pending-uploads() parts are kept in memory, the rest is
+ * spilled into spill-dir() until an upload thread gets to them.  Transient
+ * errors are retried with an exponential backoff.
+ */
+S3Uploader *s3_uploader_new(const S3UploaderOptions *options);
+void s3_uploader_free(S3Uploader *self);
+
+gboolean s3_uploader_check_bucket(S3Uploader *self);
+void s3_uploader_submit_part(S3Uploader *self, S3Object *object, gint part_number, GString *data);
+void s3_uploader_complete_object(S3Uploader *self, S3Object *object);
+gboolean s3_uploader_is_full(S3Uploader *self);
+void s3_uploader_stop(S3Uploader *self);
+
+#endif
@@ -0,0 +1,338 @@
+/*
+ * Copyright (c) 2024 One Identity LLC.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#include "s3-worker.h"
+#include "s3.h"
+#include "s3-object.h"
+#include "timeutils/misc.h"
+#include "mainloop-worker.h"
+#include "messages.h"
+
+#include <string.h>
+
+/* finished but not yet uploaded objects are also reaped at this pace */
+#define S3_FLUSH_POLL_INTERVAL_MSEC (60 * 1000)
+
+static void
+_finish_object(S3DestWorker *self, S3Object *object)
+{
+  s3_object_finish(object);
+  self->finished_objects = g_list_prepend(self->finished_objects, object);
+}
+
+static void
+_reap_finished_objects(S3DestWorker *self)
+{
+  GList *l = self->finished_objects;
+
+  while (l)
+    {
+      GList *next = l->next;
+      S3Object *object = (S3Object *) l->data;
+
+      if (s3_object_is_done(object))
+        {
+          s3_object_unref(object);
+          self->finished_objects = g_list_delete_link(self->finished_objects, l);
+        }
+      l = next;
+    }
+}
+
+static S3Object *
+_create_object(S3DestWorker *self, const gchar *target_key, const gchar *timestamp)
+{
+  S3DestDriver *owner = (S3DestDriver *) self->super.owner;
+
+  return s3_object_new(owner->uploader, target_key, timestamp,
+                       owner->compression, owner->compression_level, owner->chunk_size);
+}
+
+static S3Object *
+_lookup_backfill_object(S3DestWorker *self, const gchar *target_key, const gchar *timestamp)
+{
+  g_string_assign(self->backfill_key, target_key);
+  g_string_append_c(self->backfill_key, '\n');
+  g_string_append(self->backfill_key, timestamp);
+
+  S3Object *object = g_hash_table_lookup(self->backfill_objects, self->backfill_key->str);
+  if (object)
+    return object;
+
+  object = _create_object(self, target_key, timestamp);
+  if (object)
+    g_hash_table_insert(self->backfill_objects, g_strdup(self->backfill_key->str), object);
+  return object;
+}
+
+/*
+ * Messages of a fresher timestamp finish the object of the target and
+ * start a new one, the ones of older timestamps are backfilled into
+ * separate objects.
+ */
+static S3Object *
+_lookup_object(S3DestWorker *self, const gchar *target_key, const gchar *timestamp)
+{
+  S3Object *object = g_hash_table_lookup(self->objects, target_key);
+
+  if (object)
+    {
+      gint cmp = strcmp(object->timestamp, timestamp);
+
+      if (cmp == 0)
+        return object;
+      if (cmp > 0)
+        return _lookup_backfill_object(self, target_key, timestamp);
+
+      _finish_object(self, s3_object_ref(object));
+      g_hash_table_remove(self->objects, target_key);
+    }
+
+  object = _create_object(self, target_key, timestamp);
+  if (object)
+    g_hash_table_insert(self->objects, g_strdup(target_key), object);
+  return object;
+}
+
+/* continues the object in a new one once it reaches max-object-size() */
+static void
+_rotate_object(S3DestWorker *self, S3Object *object)
+{
+  S3DestDriver *owner = (S3DestDriver *) self->super.owner;
+  GHashTable *objects = self->objects;
+  const gchar *key = object->target_key;
+
+  if (g_hash_table_lookup(self->objects, object->target_key) != object)
+    {
+      objects = self->backfill_objects;
+      key = self->backfill_key->str;
+    }
+
+  S3Object *next = s3_object_new_next(object, owner->compression_level);
+
+  _finish_object(self, s3_object_ref(object));
+  if (next)
+    g_hash_table_insert(objects, g_strdup(key), next);
+  else
+    g_hash_table_remove(objects, key);
+}
+
+static void
+_format(S3DestWorker *self, LogTemplate *template, LogMessage *msg, GString *result)
+{
+  S3DestDriver *owner = (S3DestDriver *) self->super.owner;
+  LogTemplateEvalOptions options = { &owner->template_options, LTZ_SEND, self->super.seq_num, NULL, LM_VT_STRING };
+
+  log_template_format(template, msg, &options, result);
+}
+
+static LogThreadedResult
+s3_worker_insert(LogThreadedDestWorker *s, LogMessage *msg)
+{
+  S3DestWorker *self = (S3DestWorker *) s;
+  S3DestDriver *owner = (S3DestDriver *) self->super.owner;
+
+  if (s3_uploader_is_full(owner->uploader))
+    {
+      msg_debug("S3 uploads can not keep up, suspending the destination",
+                evt_tag_str("driver", owner->super.super.super.id));
+      self->saturated = TRUE;
+      return LTR_NOT_CONNECTED;
+    }
+
+  _format(self, owner->object_key, msg, self->target_key);
+  if (owner->object_key_timestamp)
+    _format(self, owner->object_key_timestamp, msg, self->timestamp);
+  else
+    g_string_truncate(self->timestamp, 0);
+
+  S3Object *object = _lookup_object(self, self->target_key->str, self->timestamp->str);
+  if (!object)
+    return LTR_ERROR;
+
+  _format(self, owner->template, msg, self->formatted_message);
+  if (!s3_object_write(object, self->formatted_message->str, self->formatted_message->len))
+    {
+      msg_error("Error compressing message into S3 object",
+                evt_tag_str("target_key", object->target_key),
+                evt_tag_str("driver", owner->super.super.super.id));
+      return LTR_ERROR;
+    }
+
+  log_threaded_dest_worker_written_bytes_add(&self->super, self->formatted_message->len);
+  log_threaded_dest_worker_batch_bytes_add(&self->super, self->formatted_message->len);
+
+  if (object->size >= owner->max_object_size)
+    _rotate_object(self, object);
+
+  return LTR_SUCCESS;
+}
+
+static void
+_finish_idle_objects_of(S3DestWorker *self, GHashTable *objects, gint64 idle_since)
+{
+  GHashTableIter iter;
+  gpointer key, value;
+
+  g_hash_table_iter_init(&iter, objects);
+  while (g_hash_table_iter_next(&iter, &key, &value))
+    {
+      S3Object *object = (S3Object *) value;
+
+      if (idle_since >= 0 && object->modified_at > idle_since)
+        continue;
+
+      g_hash_table_iter_steal(&iter);
+      g_free(key);
+      _finish_object(self, object);
+    }
+}
+
+/* finishes the objects not written since @idle_since, all of them if it is negative */
+static void
+_finish_idle_objects(S3DestWorker *self, gint64 idle_since)
+{
+  _finish_idle_objects_of(self, self->objects, idle_since);
+  _finish_idle_objects_of(self, self->backfill_objects, idle_since);
+}
+
+static void
+_schedule_flush_timer(S3DestWorker *self)
+{
+  iv_validate_now();
+  self->flush_timer.expires = iv_now;
+  timespec_add_msec(&self->flush_timer.expires, S3_FLUSH_POLL_INTERVAL_MSEC);
+  iv_timer_register(&self->flush_timer);
+}
+
+static void
+_flush_timer_expired(gpointer s)
+{
+  S3DestWorker *self = (S3DestWorker *) s;
+  S3DestDriver *owner = (S3DestDriver *) self->super.owner;
+
+  _finish_idle_objects(self, g_get_monotonic_time() - (gint64) owner->flush_grace_period * 60 * G_USEC_PER_SEC);
+  _reap_finished_objects(self);
+  _schedule_flush_timer(self);
+}
+
+static gboolean
+s3_worker_connect(LogThreadedDestWorker *s)
+{
+  S3DestWorker *self = (S3DestWorker *) s;
+  S3DestDriver *owner = (S3DestDriver *) self->super.owner;
+
+  if (s3_uploader_is_full(owner->uploader))
+    return FALSE;
+
+  if (!s3_uploader_check_bucket(owner->uploader))
+    return FALSE;
+
+  if (!iv_timer_registered(&self->flush_timer))
+    _schedule_flush_timer(self);
+  return TRUE;
+}
+
+/*
+ * Finishes every object and waits for their uploads, unless the worker is
+ * only suspended because the uploads can not keep up.  On shutdown the
+ * transient errors are not retried any more.
+ */
+static void
+s3_worker_disconnect(LogThreadedDestWorker *s)
+{
+  S3DestWorker *self = (S3DestWorker *) s;
+  S3DestDriver *owner = (S3DestDriver *) self->super.owner;
+  gboolean quit = main_loop_worker_job_quit();
+
+  if (self->saturated && !quit)
+    {
+      self->saturated = FALSE;
+      _reap_finished_objects(self);
+      return;
+    }
+  self->saturated = FALSE;
+
+  if (quit)
+    s3_uploader_stop(owner->uploader);
+
+  if (iv_timer_registered(&self->flush_timer))
+    iv_timer_unregister(&self->flush_timer);
+
+  _finish_idle_objects(self, -1);
+  for (GList *l = self->finished_objects; l; l = l->next)
+    s3_object_wait((S3Object *) l->data);
+  _reap_finished_objects(self);
+}
+
+static gboolean
+s3_worker_init(LogThreadedDestWorker *s)
+{
+  S3DestWorker *self = (S3DestWorker *) s;
+
+  self->objects = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, (GDestroyNotify) s3_object_unref);
+  self->backfill_objects = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, (GDestroyNotify) s3_object_unref);
+  self->target_key = g_string_sized_new(128);
+  self->timestamp = g_string_sized_new(32);
+  self->backfill_key = g_string_sized_new(160);
+  self->formatted_message = g_string_sized_new(1024);
+
+  return log_threaded_dest_worker_init_method(s);
+}
+
+static void
+s3_worker_deinit(LogThreadedDestWorker *s)
+{
+  S3DestWorker *self = (S3DestWorker *) s;
+
+  /* disconnect() has finished and waited for everything */
+  g_hash_table_destroy(self->objects);
+  g_hash_table_destroy(self->backfill_objects);
+  g_list_free_full(self->finished_objects, (GDestroyNotify) s3_object_unref);
+  self->finished_objects = NULL;
+
+  g_string_free(self->target_key, TRUE);
+  g_string_free(self->timestamp, TRUE);
+  g_string_free(self->backfill_key, TRUE);
+  g_string_free(self->formatted_message, TRUE);
+
+  log_threaded_dest_worker_deinit_method(s);
+}
+
+LogThreadedDestWorker *
+s3_worker_new(LogThreadedDestDriver *o, gint worker_index)
+{
+  S3DestWorker *self = g_new0(S3DestWorker, 1);
+
+  log_threaded_dest_worker_init_instance(&self->super, o, worker_index);
+  self->super.init = s3_worker_init;
+  self->super.deinit = s3_worker_deinit;
+  self->super.connect = s3_worker_connect;
+  self->super.disconnect = s3_worker_disconnect;
+  self->super.insert = s3_worker_insert;
+
+  IV_TIMER_INIT(&self->flush_timer);
+  self->flush_timer.cookie = self;
+  self->flush_timer.handler = _flush_timer_expired;
+
+  return &self->super;
+}
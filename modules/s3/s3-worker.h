@@ -0,0 +1,54 @@
+/*
+ * Copyright (c) 2024 One Identity LLC.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#ifndef S3_WORKER_H_INCLUDED
+#define S3_WORKER_H_INCLUDED
+
+#include "syslog-ng.h"
+#include "logthrdest/logthrdestdrv.h"
+
+#include <iv.h>
+
+typedef struct _S3DestWorker
+{
+  LogThreadedDestWorker super;
+
+  /* target key -> S3Object of the latest timestamp */
+  GHashTable *objects;
+  /* target key and timestamp -> S3Object of an older timestamp */
+  GHashTable *backfill_objects;
+  /* finished objects, waiting for their uploads */
+  GList *finished_objects;
+
+  GString *target_key;
+  GString *timestamp;
+  GString *backfill_key;
+  GString *formatted_message;
+
+  struct iv_timer flush_timer;
+  /* the worker is suspended until the uploads catch up, its objects are kept */
+  gboolean saturated;
+} S3DestWorker;
+
+LogThreadedDestWorker *s3_worker_new(LogThreadedDestDriver *owner, gint worker_index);
+
+#endif
@@ -0,0 +1,455 @@
+/*
+ * Copyright (c) 2024 One Identity LLC.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#include "s3.h"
+#include "s3-parser.h"
+#include "s3-worker.h"
+#include "plugin.h"
+#include "plugin-types.h"
+#include "stats/stats-registry.h"
+#include "reloc.h"
+#include "messages.h"
+
+#include <string.h>
+
+/*
+ * Configuration
+ */
+
+void
+s3_dd_set_url(LogDriver *d, const gchar *url)
+{
+  S3DestDriver *self = (S3DestDriver *) d;
+
+  g_free(self->url);
+  self->url = g_strdup(url);
+}
+
+void
+s3_dd_set_bucket(LogDriver *d, const gchar *bucket)
+{
+  S3DestDriver *self = (S3DestDriver *) d;
+
+  g_free(self->bucket);
+  self->bucket = g_strdup(bucket);
+}
+
+void
+s3_dd_set_access_key(LogDriver *d, const gchar *access_key)
+{
+  S3DestDriver *self = (S3DestDriver *) d;
+
+  g_free(self->access_key);
+  self->access_key = g_strdup(access_key);
+}
+
+void
+s3_dd_set_secret_key(LogDriver *d, const gchar *secret_key)
+{
+  S3DestDriver *self = (S3DestDriver *) d;
+
+  g_free(self->secret_key);
+  self->secret_key = g_strdup(secret_key);
+}
+
+void
+s3_dd_set_region(LogDriver *d, const gchar *region)
+{
+  S3DestDriver *self = (S3DestDriver *) d;
+
+  g_free(self->region);
+  self->region = g_strdup(region);
+}
+
+void
+s3_dd_set_storage_class(LogDriver *d, const gchar *storage_class)
+{
+  S3DestDriver *self = (S3DestDriver *) d;
+
+  g_free(self->storage_class);
+  self->storage_class = g_ascii_strup(storage_class, -1);
+  g_strdelimit(self->storage_class, "-", '_');
+}
+
+void
+s3_dd_set_canned_acl(LogDriver *d, const gchar *canned_acl)
+{
+  S3DestDriver *self = (S3DestDriver *) d;
+
+  g_free(self->canned_acl);
+  self->canned_acl = g_ascii_strdown(canned_acl, -1);
+  g_strdelimit(self->canned_acl, "_", '-');
+}
+
+void
+s3_dd_set_spill_dir(LogDriver *d, const gchar *spill_dir)
+{
+  S3DestDriver *self = (S3DestDriver *) d;
+
+  g_free(self->spill_dir);
+  self->spill_dir = g_strdup(spill_dir);
+}
+
+void
+s3_dd_set_object_key_ref(LogDriver *d, LogTemplate *object_key)
+{
+  S3DestDriver *self = (S3DestDriver *) d;
+
+  log_template_unref(self->object_key);
+  self->object_key = object_key;
+}
+
+void
+s3_dd_set_object_key_timestamp_ref(LogDriver *d, LogTemplate *object_key_timestamp)
+{
+  S3DestDriver *self = (S3DestDriver *) d;
+
+  log_template_unref(self->object_key_timestamp);
+  self->object_key_timestamp = object_key_timestamp;
+}
+
+void
+s3_dd_set_template_ref(LogDriver *d, LogTemplate *template)
+{
+  S3DestDriver *self = (S3DestDriver *) d;
+
+  log_template_unref(self->template);
+  self->template = template;
+}
+
+gboolean
+s3_dd_set_compression(LogDriver *d, const gchar *compression)
+{
+  S3DestDriver *self = (S3DestDriver *) d;
+
+  return s3_compression_method_parse(compression, &self->compression);
+}
+
+void
+s3_dd_set_compression_level(LogDriver *d, gint compression_level)
+{
+  S3DestDriver *self = (S3DestDriver *) d;
+
+  self->compression_level = compression_level;
+}
+
+void
+s3_dd_set_chunk_size(LogDriver *d, gsize chunk_size)
+{
+  S3DestDriver *self = (S3DestDriver *) d;
+
+  self->chunk_size = chunk_size;
+}
+
+void
+s3_dd_set_max_object_size(LogDriver *d, guint64 max_object_size)
+{
+  S3DestDriver *self = (S3DestDriver *) d;
+
+  self->max_object_size = max_object_size;
+}
+
+void
+s3_dd_set_upload_threads(LogDriver *d, gint upload_threads)
+{
+  S3DestDriver *self = (S3DestDriver *) d;
+
+  self->upload_threads = upload_threads;
+}
+
+void
+s3_dd_set_max_pending_uploads(LogDriver *d, gint max_pending_uploads)
+{
+  S3DestDriver *self = (S3DestDriver *) d;
+
+  self->max_pending_uploads = max_pending_uploads;
+}
+
+void
+s3_dd_set_max_spilled_uploads(LogDriver *d, gint max_spilled_uploads)
+{
+  S3DestDriver *self = (S3DestDriver *) d;
+
+  self->max_spilled_uploads = max_spilled_uploads;
+}
+
+void
+s3_dd_set_upload_retry_timeout(LogDriver *d, gint upload_retry_timeout)
+{
+  S3DestDriver *self = (S3DestDriver *) d;
+
+  self->upload_retry_timeout = upload_retry_timeout;
+}
+
+void
+s3_dd_set_flush_grace_period(LogDriver *d, gint flush_grace_period)
+{
+  S3DestDriver *self = (S3DestDriver *) d;
+
+  self->flush_grace_period = flush_grace_period;
+}
+
+LogTemplateOptions *
+s3_dd_get_template_options(LogDriver *d)
+{
+  S3DestDriver *self = (S3DestDriver *) d;
+
+  return &self->template_options;
+}
+
+/*
+ * Utilities
+ */
+
+static const gchar *
+s3_dd_format_stats_key(LogThreadedDestDriver *d, StatsClusterKeyBuilder *kb)
+{
+  S3DestDriver *self = (S3DestDriver *) d;
+
+  stats_cluster_key_builder_add_legacy_label(kb, stats_cluster_label("driver", "s3"));
+  stats_cluster_key_builder_add_legacy_label(kb, stats_cluster_label("url", self->url));
+  stats_cluster_key_builder_add_legacy_label(kb, stats_cluster_label("bucket", self->bucket));
+
+  return NULL;
+}
+
+static const gchar *
+s3_dd_format_persist_name(const LogPipe *s)
+{
+  const S3DestDriver *self = (const S3DestDriver *) s;
+  static gchar persist_name[1024];
+
+  if (s->persist_name)
+    g_snprintf(persist_name, sizeof(persist_name), "s3-native.%s", s->persist_name);
+  else
+    g_snprintf(persist_name, sizeof(persist_name), "s3-native(%s,%s,%s)", self->url, self->bucket,
+               self->object_key && self->object_key->template_str ? self->object_key->template_str : "");
+
+  return persist_name;
+}
+
+/*
+ * Main thread
+ */
+
+static gboolean
+_check_options(S3DestDriver *self)
+{
+  LogPipe *s = &self->super.super.super.super;
+
+  if (!self->bucket || !self->access_key || !self->secret_key || !self->object_key)
+    {
+      msg_error("Error initializing S3 destination, bucket(), access-key(), secret-key() and object-key() "
+                "must be set",
+                log_pipe_location_tag(s));
+      return FALSE;
+    }
+
+  if (self->chunk_size < S3_MIN_CHUNK_SIZE)
+    {
+      msg_warning("WARNING: chunk-size() must be at least 5MiB, using the minimal value",
+                  log_pipe_location_tag(s));
+      self->chunk_size = S3_MIN_CHUNK_SIZE;
+    }
+
+  if (self->compression == S3_COMPRESSION_GZIP && self->compression_level > 9)
+    {
+      msg_error("Error initializing S3 destination, compression-level() must be between 0 and 9 with gzip",
+                log_pipe_location_tag(s));
+      return FALSE;
+    }
+
+  if (!self->url)
+    self->url = g_strdup_printf("https://s3.%s.amazonaws.com", self->region);
+
+  return TRUE;
+}
+
+static void
+_prepare_spill_dir(S3DestDriver *self)
+{
+  if (!self->spill_dir)
+    self->spill_dir = g_build_filename(get_installation_path_for(SYSLOG_NG_PATH_LOCALSTATEDIR), "s3", NULL);
+
+  if (g_mkdir_with_parents(self->spill_dir, 0700) < 0)
+    msg_warning("WARNING: Error creating spill-dir() for S3 destination, parts are kept in memory",
+                evt_tag_str("spill_dir", self->spill_dir),
+                evt_tag_error("error"),
+                log_pipe_location_tag(&self->super.super.super.super));
+}
+
+static gboolean
+s3_dd_init(LogPipe *s)
+{
+  S3DestDriver *self = (S3DestDriver *) s;
+  GlobalConfig *cfg = log_pipe_get_config(s);
+
+  if (!_check_options(self))
+    return FALSE;
+
+  _prepare_spill_dir(self);
+
+  /* the messages of an object must go through the same worker */
+  if (self->super.num_workers > 1 && !self->super.worker_partition_key)
+    log_threaded_dest_driver_set_worker_partition_key_ref(&self->super.super.super,
+                                                          log_template_ref(self->object_key));
+
+  S3UploaderOptions options =
+  {
+    .url = self->url,
+    .bucket = self->bucket,
+    .access_key = self->access_key,
+    .secret_key = self->secret_key,
+    .region = self->region,
+    .storage_class = self->storage_class,
+    .canned_acl = self->canned_acl,
+    .spill_dir = self->spill_dir,
+    .upload_threads = self->upload_threads,
+    .max_pending_uploads = self->max_pending_uploads,
+    .max_spilled_uploads = self->max_spilled_uploads,
+    .upload_retry_timeout = self->upload_retry_timeout,
+  };
+  self->uploader = s3_uploader_new(&options);
+  if (!self->uploader)
+    return FALSE;
+
+  if (!log_threaded_dest_driver_init_method(s))
+    {
+      s3_uploader_free(self->uploader);
+      self->uploader = NULL;
+      return FALSE;
+    }
+
+  log_template_options_init(&self->template_options, cfg);
+
+  msg_verbose("Initializing S3 destination",
+              evt_tag_str("driver", self->super.super.super.id),
+              evt_tag_str("url", self->url),
+              evt_tag_str("bucket", self->bucket),
+              evt_tag_int("upload_threads", self->upload_threads));
+
+  return TRUE;
+}
+
+static gboolean
+s3_dd_deinit(LogPipe *s)
+{
+  S3DestDriver *self = (S3DestDriver *) s;
+
+  /* stops the workers, which have waited for their objects */
+  gboolean result = log_threaded_dest_driver_deinit_method(s);
+
+  s3_uploader_free(self->uploader);
+  self->uploader = NULL;
+
+  return result;
+}
+
+static void
+s3_dd_free(LogPipe *d)
+{
+  S3DestDriver *self = (S3DestDriver *) d;
+
+  log_template_options_destroy(&self->template_options);
+
+  g_free(self->url);
+  g_free(self->bucket);
+  g_free(self->access_key);
+  g_free(self->secret_key);
+  g_free(self->region);
+  g_free(self->storage_class);
+  g_free(self->canned_acl);
+  g_free(self->spill_dir);
+  log_template_unref(self->object_key);
+  log_template_unref(self->object_key_timestamp);
+  log_template_unref(self->template);
+
+  log_threaded_dest_driver_free(d);
+}
+
+/*
+ * Plugin glue.
+ */
+
+LogDriver *
+s3_dd_new(GlobalConfig *cfg)
+{
+  S3DestDriver *self = g_new0(S3DestDriver, 1);
+
+  log_threaded_dest_driver_init_instance(&self->super, cfg);
+  self->super.super.super.super.init = s3_dd_init;
+  self->super.super.super.super.deinit = s3_dd_deinit;
+  self->super.super.super.super.free_fn = s3_dd_free;
+  self->super.super.super.super.generate_persist_name = s3_dd_format_persist_name;
+
+  self->super.worker.construct = s3_worker_new;
+
+  self->super.format_stats_key = s3_dd_format_stats_key;
+  self->super.stats_source = stats_register_type("s3");
+
+  s3_dd_set_region(&self->super.super.super, "us-east-1");
+  s3_dd_set_storage_class(&self->super.super.super, "STANDARD");
+  s3_dd_set_canned_acl(&self->super.super.super, "");
+
+  LogTemplate *template = log_template_new(cfg, NULL);
+  log_template_compile(template, "${MESSAGE}\n", NULL);
+  s3_dd_set_template_ref(&self->super.super.super, template);
+
+  self->compression = S3_COMPRESSION_NONE;
+  self->compression_level = -1;
+  self->chunk_size = S3_MIN_CHUNK_SIZE;
+  self->max_object_size = G_GUINT64_CONSTANT(5120) * 1024 * 1024 * 1024;
+  self->upload_threads = 8;
+  self->max_pending_uploads = 32;
+  self->max_spilled_uploads = 256;
+  self->upload_retry_timeout = 0;
+  self->flush_grace_period = 60;
+
+  log_template_options_defaults(&self->template_options);
+
+  return &self->super.super.super;
+}
+
+static Plugin s3_plugin =
+{
+  .type = LL_CONTEXT_DESTINATION,
+  .name = "s3_native",
+  .parser = &s3_parser,
+};
+
+gboolean
+s3_module_init(PluginContext *context, CfgArgs *args)
+{
+  plugin_register(context, &s3_plugin, 1);
+
+  return TRUE;
+}
+
+const ModuleInfo module_info =
+{
+  .canonical_name = "s3",
+  .version = SYSLOG_NG_VERSION,
+  .description = "The s3 module provides a native S3 destination using parallel multipart uploads.",
+  .core_revision = SYSLOG_NG_SOURCE_REVISION,
+  .plugins = &s3_plugin,
+  .plugins_len = 1,
+};
@@ -0,0 +1,91 @@
+/*
+ * Copyright (c) 2024 One Identity LLC.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#ifndef S3_H_INCLUDED
+#define S3_H_INCLUDED
+
+#include "driver.h"
+#include "logthrdest/logthrdestdrv.h"
+#include "s3-compressor.h"
+#include "s3-uploader.h"
+
+/* the minimal size of a part, except for the last one */
+#define S3_MIN_CHUNK_SIZE (5 * 1024 * 1024)
+
+typedef struct _S3DestDriver
+{
+  LogThreadedDestDriver super;
+  LogTemplateOptions template_options;
+
+  gchar *url;
+  gchar *bucket;
+  gchar *access_key;
+  gchar *secret_key;
+  gchar *region;
+  gchar *storage_class;
+  gchar *canned_acl;
+  gchar *spill_dir;
+
+  LogTemplate *object_key;
+  LogTemplate *object_key_timestamp;
+  LogTemplate *template;
+
+  S3CompressionMethod compression;
+  gint compression_level;
+  gsize chunk_size;
+  guint64 max_object_size;
+  gint upload_threads;
+  gint max_pending_uploads;
+  gint max_spilled_uploads;
+  /* in seconds */
+  gint upload_retry_timeout;
+  /* in minutes */
+  gint flush_grace_period;
+
+  S3Uploader *uploader;
+} S3DestDriver;
+
+LogDriver *s3_dd_new(GlobalConfig *cfg);
+
+void s3_dd_set_url(LogDriver *d, const gchar *url);
+void s3_dd_set_bucket(LogDriver *d, const gchar *bucket);
+void s3_dd_set_access_key(LogDriver *d, const gchar *access_key);
+void s3_dd_set_secret_key(LogDriver *d, const gchar *secret_key);
+void s3_dd_set_region(LogDriver *d, const gchar *region);
+void s3_dd_set_storage_class(LogDriver *d, const gchar *storage_class);
+void s3_dd_set_canned_acl(LogDriver *d, const gchar *canned_acl);
+void s3_dd_set_spill_dir(LogDriver *d, const gchar *spill_dir);
+void s3_dd_set_object_key_ref(LogDriver *d, LogTemplate *object_key);
+void s3_dd_set_object_key_timestamp_ref(LogDriver *d, LogTemplate *object_key_timestamp);
+void s3_dd_set_template_ref(LogDriver *d, LogTemplate *template);
+gboolean s3_dd_set_compression(LogDriver *d, const gchar *compression);
+void s3_dd_set_compression_level(LogDriver *d, gint compression_level);
+void s3_dd_set_chunk_size(LogDriver *d, gsize chunk_size);
+void s3_dd_set_max_object_size(LogDriver *d, guint64 max_object_size);
+void s3_dd_set_upload_threads(LogDriver *d, gint upload_threads);
+void s3_dd_set_max_pending_uploads(LogDriver *d, gint max_pending_uploads);
+void s3_dd_set_max_spilled_uploads(LogDriver *d, gint max_spilled_uploads);
+void s3_dd_set_upload_retry_timeout(LogDriver *d, gint upload_retry_timeout);
+void s3_dd_set_flush_grace_period(LogDriver *d, gint flush_grace_period);
+LogTemplateOptions *s3_dd_get_template_options(LogDriver *d);
+
+#endif
@@ -0,0 +1,198 @@
+/*
+ * Copyright (c) 2024 One Identity LLC.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#include <criterion/criterion.h>
+
+#include "s3-compressor.h"
+#include "apphook.h"
+
+#include <string.h>
+
+#ifdef SYSLOG_NG_HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+#if SYSLOG_NG_ENABLE_ZSTD
+#include <zstd.h>
+#endif
+
+#define NUM_LINES 20000
+#define PART_SIZE 4096
+
+static GString *
+_generate_input(void)
+{
+  GString *input = g_string_new(NULL);
+
+  for (gint i = 0; i < NUM_LINES; i++)
+    g_string_append_printf(input, "<13>Jan  1 00:00:00 host program[%d]: message number %d\n", i % 100, i);
+
+  return input;
+}
+
+/*
+ * Compresses the input in small writes and cuts the output into parts the
+ * same way S3Object does, returning the concatenation of the parts.
+ */
+static GString *
+_compress_into_parts(S3CompressionMethod method, const GString *input, gint *num_parts)
+{
+  S3Compressor *compressor = s3_compressor_new(method, -1);
+  cr_assert_not_null(compressor);
+
+  GString *concatenated = g_string_new(NULL);
+  GString *part = g_string_new(NULL);
+  *num_parts = 0;
+
+  for (gsize pos = 0; pos < input->len; pos += 1000)
+    {
+      cr_assert(s3_compressor_compress(compressor, input->str + pos, MIN(1000, input->len - pos), part));
+      if (part->len >= PART_SIZE)
+        {
+          g_string_append_len(concatenated, part->str, part->len);
+          g_string_truncate(part, 0);
+          (*num_parts)++;
+        }
+    }
+
+  cr_assert(s3_compressor_finish(compressor, part));
+  cr_assert_gt(part->len, 0, "The end of the stream was not written");
+  g_string_append_len(concatenated, part->str, part->len);
+  (*num_parts)++;
+
+  g_string_free(part, TRUE);
+  s3_compressor_free(compressor);
+  return concatenated;
+}
+
+Test(s3_compressor, test_no_compression_passes_the_data_through)
+{
+  GString *input = _generate_input();
+  gint num_parts;
+  GString *output = _compress_into_parts(S3_COMPRESSION_NONE, input, &num_parts);
+
+  cr_assert_eq(output->len, input->len);
+  cr_assert_arr_eq(output->str, input->str, input->len);
+
+  g_string_free(output, TRUE);
+  g_string_free(input, TRUE);
+}
+
+#ifdef SYSLOG_NG_HAVE_ZLIB
+
+static GString *
+_gunzip(const GString *compressed)
+{
+  GString *output = g_string_new(NULL);
+  z_stream stream = { 0 };
+  gint rc;
+
+  cr_assert_eq(inflateInit2(&stream, 15 + 16), Z_OK);
+  stream.next_in = (Bytef *) compressed->str;
+  stream.avail_in = compressed->len;
+  do
+    {
+      gsize pos = output->len;
+      g_string_set_size(output, pos + 65536);
+      stream.next_out = (Bytef *) output->str + pos;
+      stream.avail_out = 65536;
+      rc = inflate(&stream, Z_NO_FLUSH);
+      g_string_set_size(output, pos + 65536 - stream.avail_out);
+      cr_assert(rc == Z_OK || rc == Z_STREAM_END, "Error decompressing gzip stream: %d", rc);
+    }
+  while (rc != Z_STREAM_END);
+
+  cr_assert_eq(stream.avail_in, 0, "Trailing data after the gzip stream");
+  inflateEnd(&stream);
+  return output;
+}
+
+Test(s3_compressor, test_gzip_parts_concatenate_to_a_single_stream)
+{
+  GString *input = _generate_input();
+  gint num_parts;
+  GString *compressed = _compress_into_parts(S3_COMPRESSION_GZIP, input, &num_parts);
+
+  cr_assert_gt(num_parts, 1);
+  cr_assert_lt(compressed->len, input->len);
+
+  GString *decompressed = _gunzip(compressed);
+  cr_assert_eq(decompressed->len, input->len);
+  cr_assert_arr_eq(decompressed->str, input->str, input->len);
+
+  g_string_free(decompressed, TRUE);
+  g_string_free(compressed, TRUE);
+  g_string_free(input, TRUE);
+}
+
+#endif
+
+#if SYSLOG_NG_ENABLE_ZSTD
+
+Test(s3_compressor, test_zstd_parts_concatenate_to_a_single_stream)
+{
+  GString *input = _generate_input();
+  gint num_parts;
+  GString *compressed = _compress_into_parts(S3_COMPRESSION_ZSTD, input, &num_parts);
+
+  cr_assert_gt(num_parts, 1);
+  cr_assert_lt(compressed->len, input->len);
+
+  GString *decompressed = g_string_sized_new(input->len + 1);
+  gsize decompressed_len = ZSTD_decompress(decompressed->str, input->len + 1, compressed->str, compressed->len);
+  cr_assert_not(ZSTD_isError(decompressed_len), "Error decompressing zstd stream: %s",
+                ZSTD_getErrorName(decompressed_len));
+  g_string_set_size(decompressed, decompressed_len);
+
+  cr_assert_eq(decompressed->len, input->len);
+  cr_assert_arr_eq(decompressed->str, input->str, input->len);
+
+  g_string_free(decompressed, TRUE);
+  g_string_free(compressed, TRUE);
+  g_string_free(input, TRUE);
+}
+
+#endif
+
+Test(s3_compressor, test_method_names_and_extensions)
+{
+  S3CompressionMethod method;
+
+  cr_assert(s3_compression_method_parse("none", &method));
+  cr_assert_eq(method, S3_COMPRESSION_NONE);
+  cr_assert_str_eq(s3_compression_method_extension(method), "");
+  cr_assert_not(s3_compression_method_parse("lz4", &method));
+
+#ifdef SYSLOG_NG_HAVE_ZLIB
+  cr_assert(s3_compression_method_parse("gzip", &method));
+  cr_assert_eq(method, S3_COMPRESSION_GZIP);
+  cr_assert_str_eq(s3_compression_method_extension(method), ".gz");
+#endif
+
+#if SYSLOG_NG_ENABLE_ZSTD
+  cr_assert(s3_compression_method_parse("zstd", &method));
+  cr_assert_eq(method, S3_COMPRESSION_ZSTD);
+  cr_assert_str_eq(s3_compression_method_extension(method), ".zst");
+#endif
+}
+
+TestSuite(s3_compressor, .init = app_startup, .fini = app_shutdown);
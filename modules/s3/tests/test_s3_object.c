@@ -0,0 +1,195 @@
+/*
+ * Copyright (c) 2024 One Identity LLC.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#include <criterion/criterion.h>
+
+#include "s3-uploader.c"
+#include "apphook.h"
+
+/* the parts are queued to an upload thread that only collects them, nothing is sent */
+static GAsyncQueue *collected_tasks;
+
+static void
+_collect_task(gpointer data, gpointer user_data)
+{
+  g_async_queue_push(collected_tasks, data);
+}
+
+static S3Uploader *
+_create_uploader(void)
+{
+  S3UploaderOptions options =
+  {
+    .url = "http://localhost:9000",
+    .bucket = "bucket",
+    .access_key = "access-key",
+    .secret_key = "secret-key",
+    .region = "us-east-1",
+    .storage_class = "STANDARD",
+    .canned_acl = "",
+    .upload_threads = 1,
+    .max_pending_uploads = 100,
+  };
+
+  S3Uploader *self = s3_uploader_new(&options);
+  cr_assert_not_null(self);
+
+  g_thread_pool_free(self->pool, FALSE, TRUE);
+  self->pool = g_thread_pool_new(_collect_task, self, 1, FALSE, NULL);
+  return self;
+}
+
+static S3UploadTask *
+_pop_task(void)
+{
+  S3UploadTask *task = g_async_queue_timeout_pop(collected_tasks, 5 * G_USEC_PER_SEC);
+  cr_assert_not_null(task, "No part was queued for upload");
+  return task;
+}
+
+static void
+_free_task(S3UploadTask *task)
+{
+  if (task->data)
+    g_string_free(task->data, TRUE);
+  s3_object_unref(task->object);
+  g_free(task);
+}
+
+static void
+_assert_key(S3Object *object, gint index, const gchar *expected)
+{
+  GString *key = g_string_new(NULL);
+
+  s3_object_format_key(object, index, key);
+  cr_assert_str_eq(key->str, expected);
+  g_string_free(key, TRUE);
+}
+
+Test(s3_object, test_format_key)
+{
+  S3Uploader *uploader = _create_uploader();
+
+  S3Object *object = s3_object_new(uploader, "logs/app", "20240101", S3_COMPRESSION_NONE, -1, 1024);
+  _assert_key(object, 0, "logs/app-20240101");
+  _assert_key(object, 2, "logs/app-20240101-2");
+  s3_object_unref(object);
+
+  object = s3_object_new(uploader, "logs/app", "", S3_COMPRESSION_NONE, -1, 1024);
+  _assert_key(object, 0, "logs/app");
+  _assert_key(object, 1, "logs/app-1");
+  s3_object_unref(object);
+
+  s3_uploader_free(uploader);
+}
+
+Test(s3_object, test_next_object_continues_with_the_next_index)
+{
+  S3Uploader *uploader = _create_uploader();
+  S3Object *object = s3_object_new(uploader, "logs/app", "", S3_COMPRESSION_NONE, -1, 1024);
+  object->index = 3;
+
+  S3Object *next = s3_object_new_next(object, -1);
+  cr_assert_eq(next->index, 4);
+  cr_assert_str_eq(next->target_key, "logs/app");
+  cr_assert_eq(next->chunk_size, object->chunk_size);
+  cr_assert_eq(next->num_parts, 0);
+
+  s3_object_unref(next);
+  s3_object_unref(object);
+  s3_uploader_free(uploader);
+}
+
+Test(s3_object, test_parts_are_cut_at_chunk_size)
+{
+  S3Uploader *uploader = _create_uploader();
+  S3Object *object = s3_object_new(uploader, "logs/app", "", S3_COMPRESSION_NONE, -1, 1024);
+  gchar line[300];
+  GString *written = g_string_new(NULL);
+
+  for (gint i = 0; i < 10; i++)
+    {
+      memset(line, 'a' + i, sizeof(line));
+      cr_assert(s3_object_write(object, line, sizeof(line)));
+      g_string_append_len(written, line, sizeof(line));
+    }
+  cr_assert_eq(object->num_parts, 2, "Parts should be submitted once they reach chunk-size()");
+
+  s3_object_finish(object);
+  cr_assert(object->finished);
+  cr_assert_eq(object->num_parts, 3);
+  cr_assert_eq(object->size, written->len);
+  cr_assert(object->completion_requested);
+  cr_assert_null(object->part);
+
+  GString *uploaded = g_string_new(NULL);
+  const gsize expected_sizes[] = { 1200, 1200, 600 };
+  for (gint part_number = 1; part_number <= 3; part_number++)
+    {
+      S3UploadTask *task = _pop_task();
+
+      cr_assert_eq(task->part_number, part_number);
+      cr_assert_eq(task->data->len, expected_sizes[part_number - 1]);
+      g_string_append_len(uploaded, task->data->str, task->data->len);
+      _free_task(task);
+    }
+  cr_assert_eq(uploaded->len, written->len);
+  cr_assert_arr_eq(uploaded->str, written->str, written->len);
+
+  g_string_free(uploaded, TRUE);
+  g_string_free(written, TRUE);
+  s3_object_unref(object);
+  s3_uploader_free(uploader);
+}
+
+Test(s3_object, test_empty_last_part_is_not_uploaded)
+{
+  S3Uploader *uploader = _create_uploader();
+  S3Object *object = s3_object_new(uploader, "logs/app", "", S3_COMPRESSION_NONE, -1, 1024);
+  gchar data[1024] = { 0 };
+
+  cr_assert(s3_object_write(object, data, sizeof(data)));
+  s3_object_finish(object);
+  cr_assert_eq(object->num_parts, 1);
+
+  _free_task(_pop_task());
+  cr_assert_null(g_async_queue_try_pop(collected_tasks));
+
+  s3_object_unref(object);
+  s3_uploader_free(uploader);
+}
+
+static void
+setup(void)
+{
+  app_startup();
+  collected_tasks = g_async_queue_new();
+}
+
+static void
+teardown(void)
+{
+  g_async_queue_unref(collected_tasks);
+  app_shutdown();
+}
+
+TestSuite(s3_object, .init = setup, .fini = teardown);
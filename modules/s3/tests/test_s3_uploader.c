@@ -0,0 +1,260 @@
+/*
+ * Copyright (c) 2024 One Identity LLC.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#include <criterion/criterion.h>
+
+#include "s3-uploader.c"
+#include "apphook.h"
+
+#include <glib/gstdio.h>
+
+/* the parts are queued to an upload thread that only collects them, nothing is sent */
+static GAsyncQueue *collected_tasks;
+
+static void
+_collect_task(gpointer data, gpointer user_data)
+{
+  g_async_queue_push(collected_tasks, data);
+}
+
+static S3Uploader *
+_create_uploader(const gchar *spill_dir, gint max_pending_uploads, gint max_spilled_uploads)
+{
+  S3UploaderOptions options =
+  {
+    .url = "http://localhost:9000",
+    .bucket = "bucket",
+    .access_key = "access-key",
+    .secret_key = "secret-key",
+    .region = "us-east-1",
+    .storage_class = "STANDARD",
+    .canned_acl = "",
+    .spill_dir = spill_dir,
+    .upload_threads = 1,
+    .max_pending_uploads = max_pending_uploads,
+    .max_spilled_uploads = max_spilled_uploads,
+  };
+
+  S3Uploader *self = s3_uploader_new(&options);
+  cr_assert_not_null(self);
+
+  g_thread_pool_free(self->pool, FALSE, TRUE);
+  self->pool = g_thread_pool_new(_collect_task, self, 1, FALSE, NULL);
+  return self;
+}
+
+static S3UploadTask *
+_pop_task(void)
+{
+  S3UploadTask *task = g_async_queue_timeout_pop(collected_tasks, 5 * G_USEC_PER_SEC);
+  cr_assert_not_null(task, "No part was queued for upload");
+  return task;
+}
+
+static void
+_free_task(S3UploadTask *task)
+{
+  if (task->spill_file)
+    {
+      unlink(task->spill_file);
+      g_free(task->spill_file);
+    }
+  if (task->data)
+    g_string_free(task->data, TRUE);
+  s3_object_unref(task->object);
+  g_free(task);
+}
+
+static void
+_assert_classified(gboolean sent, glong status, S3RequestResult expected)
+{
+  S3Response response;
+
+  _response_init(&response);
+  response.status = status;
+  cr_assert_eq(_response_classify(sent, &response), expected, "Unexpected result for status %ld (sent: %d)",
+               status, sent);
+  _response_clear(&response);
+}
+
+Test(s3_uploader, test_response_classification)
+{
+  _assert_classified(FALSE, 0, S3_REQUEST_RETRY);
+  _assert_classified(TRUE, 200, S3_REQUEST_SUCCESS);
+  _assert_classified(TRUE, 204, S3_REQUEST_SUCCESS);
+
+  /* timeouts, throttling and server errors are transient */
+  _assert_classified(TRUE, 408, S3_REQUEST_RETRY);
+  _assert_classified(TRUE, 429, S3_REQUEST_RETRY);
+  _assert_classified(TRUE, 500, S3_REQUEST_RETRY);
+  _assert_classified(TRUE, 503, S3_REQUEST_RETRY);
+
+  _assert_classified(TRUE, 400, S3_REQUEST_FAILED);
+  _assert_classified(TRUE, 403, S3_REQUEST_FAILED);
+  _assert_classified(TRUE, 404, S3_REQUEST_FAILED);
+}
+
+static void
+_set_etag(S3Object *object, gint part_number, const gchar *etag)
+{
+  if ((gint) object->etags->len < part_number)
+    g_ptr_array_set_size(object->etags, part_number);
+  g_ptr_array_index(object->etags, part_number - 1) = g_strdup(etag);
+}
+
+Test(s3_uploader, test_complete_request_skips_missing_parts)
+{
+  S3Uploader *uploader = _create_uploader(NULL, 4, 0);
+  S3Object *object = s3_object_new(uploader, "key", "", S3_COMPRESSION_NONE, -1, 1024);
+
+  /* the parts finish out of order, the second one was given up */
+  _set_etag(object, 3, "\"etag-3\"");
+  _set_etag(object, 1, "\"etag-1\"");
+  _set_etag(object, 4, "\"etag-4\"");
+
+  gint num_parts;
+  GString *body = _format_complete_request(object, &num_parts);
+
+  cr_assert_eq(num_parts, 3);
+  cr_assert_str_eq(body->str,
+                   "<CompleteMultipartUpload>"
+                   "<Part><PartNumber>1</PartNumber><ETag>\"etag-1\"</ETag></Part>"
+                   "<Part><PartNumber>3</PartNumber><ETag>\"etag-3\"</ETag></Part>"
+                   "<Part><PartNumber>4</PartNumber><ETag>\"etag-4\"</ETag></Part>"
+                   "</CompleteMultipartUpload>");
+
+  g_string_free(body, TRUE);
+  s3_object_unref(object);
+  s3_uploader_free(uploader);
+}
+
+Test(s3_uploader, test_complete_request_without_parts)
+{
+  S3Uploader *uploader = _create_uploader(NULL, 4, 0);
+  S3Object *object = s3_object_new(uploader, "key", "", S3_COMPRESSION_NONE, -1, 1024);
+
+  gint num_parts;
+  GString *body = _format_complete_request(object, &num_parts);
+
+  cr_assert_eq(num_parts, 0);
+  cr_assert_str_eq(body->str, "<CompleteMultipartUpload></CompleteMultipartUpload>");
+
+  g_string_free(body, TRUE);
+  s3_object_unref(object);
+  s3_uploader_free(uploader);
+}
+
+static void
+_submit_part(S3Uploader *uploader, S3Object *object, gint part_number)
+{
+  GString *data = g_string_new(NULL);
+
+  g_string_printf(data, "part %d", part_number);
+  s3_uploader_submit_part(uploader, object, part_number, data);
+}
+
+Test(s3_uploader, test_is_full_without_spilling)
+{
+  S3Uploader *uploader = _create_uploader(NULL, 2, 0);
+  S3Object *object = s3_object_new(uploader, "key", "", S3_COMPRESSION_NONE, -1, 1024);
+
+  _submit_part(uploader, object, 1);
+  cr_assert_not(s3_uploader_is_full(uploader));
+  _submit_part(uploader, object, 2);
+  cr_assert(s3_uploader_is_full(uploader));
+
+  cr_assert_eq(uploader->parts_in_memory, 2);
+  cr_assert_eq(uploader->spilled_parts, 0);
+  cr_assert_eq(object->pending_parts, 2);
+
+  for (gint i = 0; i < 2; i++)
+    _free_task(_pop_task());
+
+  s3_object_unref(object);
+  s3_uploader_free(uploader);
+}
+
+Test(s3_uploader, test_parts_above_max_pending_uploads_are_spilled)
+{
+  gchar *spill_dir = g_dir_make_tmp("test_s3_spill_XXXXXX", NULL);
+  cr_assert_not_null(spill_dir);
+
+  S3Uploader *uploader = _create_uploader(spill_dir, 1, 2);
+  S3Object *object = s3_object_new(uploader, "key", "", S3_COMPRESSION_NONE, -1, 1024);
+
+  _submit_part(uploader, object, 1);
+  cr_assert_not(s3_uploader_is_full(uploader), "Parts should be spilled once max-pending-uploads() is reached");
+
+  _submit_part(uploader, object, 2);
+  cr_assert_not(s3_uploader_is_full(uploader));
+  _submit_part(uploader, object, 3);
+  cr_assert(s3_uploader_is_full(uploader));
+
+  cr_assert_eq(uploader->parts_in_memory, 1);
+  cr_assert_eq(uploader->spilled_parts, 2);
+
+  S3UploadTask *in_memory = _pop_task();
+  cr_assert_eq(in_memory->part_number, 1);
+  cr_assert_null(in_memory->spill_file);
+  cr_assert_str_eq(in_memory->data->str, "part 1");
+  _free_task(in_memory);
+
+  for (gint part_number = 2; part_number <= 3; part_number++)
+    {
+      S3UploadTask *spilled = _pop_task();
+      cr_assert_eq(spilled->part_number, part_number);
+      cr_assert_null(spilled->data);
+      cr_assert_not_null(spilled->spill_file);
+
+      gchar *contents;
+      gsize len;
+      cr_assert(_load_spilled_part(spilled, &contents, &len));
+      gchar *expected = g_strdup_printf("part %d", part_number);
+      cr_assert_eq(len, strlen(expected));
+      cr_assert_arr_eq(contents, expected, len);
+      g_free(expected);
+      g_free(contents);
+
+      _free_task(spilled);
+    }
+
+  s3_object_unref(object);
+  s3_uploader_free(uploader);
+  g_rmdir(spill_dir);
+  g_free(spill_dir);
+}
+
+static void
+setup(void)
+{
+  app_startup();
+  collected_tasks = g_async_queue_new();
+}
+
+static void
+teardown(void)
+{
+  g_async_queue_unref(collected_tasks);
+  app_shutdown();
+}
+
+TestSuite(s3_uploader, .init = setup, .fini = teardown);
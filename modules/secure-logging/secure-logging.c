@@ -33,6 +33,7 @@
 #include <glib.h>
 
 #include <openssl/rand.h>
+#include <openssl/crypto.h>
 #include <sys/mman.h>
 
 // Secure logging declarations
@@ -54,6 +55,43 @@
  *      -k        Full path to encryption key file
  *      -m        Full path to MAC file
  */
+
+/* number of keys derived ahead of time */
+#define SLOG_KEY_LOOKAHEAD 256
+
+/*
+ * Everything needed to process a log entry with a given key, except the
+ * key itself. The key that follows is evolved from it.
+ */
+typedef struct _SLogKeySet
+{
+  guchar encKey[KEY_LENGTH];
+  guchar MACKey[KEY_LENGTH];
+  guchar nextKey[KEY_LENGTH];
+} SLogKeySet;
+
+/*
+ * Key evolution and sub-key derivation take several CMAC computations per
+ * log entry, which only depend on the key. A helper thread keeps a ring of
+ * key sets ready, so that only the encryption and the aggregated MAC
+ * remain in tf_slog_call(). Key sets are wiped as soon as they are used.
+ */
+typedef struct _SLogKeyPrecomputer
+{
+  GThread *thread;
+  GMutex lock;
+  GCond cond;
+  gboolean quit;
+  gboolean producer_waiting;
+  gboolean consumer_waiting;
+
+  /* the key the helper thread continues with */
+  guchar key[KEY_LENGTH];
+  SLogKeySet sets[SLOG_KEY_LOOKAHEAD];
+  gint head;
+  gint count;
+} SLogKeyPrecomputer;
+
 typedef struct _TFSlogState
 {
   TFSimpleFuncState super;
@@ -65,8 +103,115 @@ typedef struct _TFSlogState
   gboolean badKey;
   guchar key[KEY_LENGTH];
   guchar bigMAC[CMAC_LENGTH];
+  SLogKeyPrecomputer *precomputer;
 } TFSlogState;
 
+static gpointer
+_key_precomputer_run(gpointer data)
+{
+  SLogKeyPrecomputer *self = (SLogKeyPrecomputer *) data;
+  guchar key[KEY_LENGTH];
+  SLogKeySet set;
+
+  g_mutex_lock(&self->lock);
+  while (!self->quit)
+    {
+      if (self->count == SLOG_KEY_LOOKAHEAD)
+        {
+          self->producer_waiting = TRUE;
+          g_cond_wait(&self->cond, &self->lock);
+          self->producer_waiting = FALSE;
+          continue;
+        }
+
+      /* only this thread changes self->key */
+      memcpy(key, self->key, KEY_LENGTH);
+      g_mutex_unlock(&self->lock);
+
+      deriveSubKeys(key, set.encKey, set.MACKey);
+      memcpy(set.nextKey, key, KEY_LENGTH);
+      evolveKey(set.nextKey);
+
+      g_mutex_lock(&self->lock);
+      memcpy(&self->sets[(self->head + self->count) % SLOG_KEY_LOOKAHEAD], &set, sizeof(set));
+      memcpy(self->key, set.nextKey, KEY_LENGTH);
+      self->count++;
+      if (self->consumer_waiting)
+        g_cond_broadcast(&self->cond);
+    }
+  g_mutex_unlock(&self->lock);
+
+  OPENSSL_cleanse(key, sizeof(key));
+  OPENSSL_cleanse(&set, sizeof(set));
+  return NULL;
+}
+
+static SLogKeyPrecomputer *
+_key_precomputer_new(guchar *key)
+{
+  SLogKeyPrecomputer *self = g_new0(SLogKeyPrecomputer, 1);
+
+  if (mlock(self, sizeof(*self)) != 0)
+    msg_warning("[SLOG] WARNING: Unable to acquire memory lock for precomputed keys");
+
+  g_mutex_init(&self->lock);
+  g_cond_init(&self->cond);
+  memcpy(self->key, key, KEY_LENGTH);
+
+  GError *error = NULL;
+  self->thread = g_thread_try_new("slog-keys", _key_precomputer_run, self, &error);
+  if (!self->thread)
+    {
+      msg_warning("[SLOG] WARNING: Unable to start key precomputation thread, deriving keys inline",
+                  evt_tag_str("error", error->message));
+      g_clear_error(&error);
+    }
+
+  return self;
+}
+
+/* the key following the one in set is the state's current key */
+static void
+_key_precomputer_pop(SLogKeyPrecomputer *self, SLogKeySet *set)
+{
+  g_mutex_lock(&self->lock);
+  while (self->count == 0)
+    {
+      self->consumer_waiting = TRUE;
+      g_cond_wait(&self->cond, &self->lock);
+      self->consumer_waiting = FALSE;
+    }
+
+  memcpy(set, &self->sets[self->head], sizeof(*set));
+  OPENSSL_cleanse(&self->sets[self->head], sizeof(*set));
+  self->head = (self->head + 1) % SLOG_KEY_LOOKAHEAD;
+  self->count--;
+
+  /* wake the helper thread only when half of the ring has been used up */
+  if (self->producer_waiting && self->count <= SLOG_KEY_LOOKAHEAD / 2)
+    g_cond_broadcast(&self->cond);
+  g_mutex_unlock(&self->lock);
+}
+
+static void
+_key_precomputer_free(SLogKeyPrecomputer *self)
+{
+  if (self->thread)
+    {
+      g_mutex_lock(&self->lock);
+      self->quit = TRUE;
+      g_cond_broadcast(&self->cond);
+      g_mutex_unlock(&self->lock);
+      g_thread_join(self->thread);
+    }
+
+  g_mutex_clear(&self->lock);
+  g_cond_clear(&self->cond);
+  OPENSSL_cleanse(self, sizeof(*self));
+  munlock(self, sizeof(*self));
+  g_free(self);
+}
+
 /*
  * Initialize the secure logging template
  */
@@ -189,6 +334,13 @@ tf_slog_prepare(LogTemplateFunction *self, gpointer s, LogTemplate *parent, gint
       msg_debug("[SLOG] INFO: Template with key and MAC file successfully initialized.");
     }
 
+  state->precomputer = _key_precomputer_new(state->key);
+  if (!state->precomputer->thread)
+    {
+      _key_precomputer_free(state->precomputer);
+      state->precomputer = NULL;
+    }
+
   return TRUE;
 }
 
@@ -212,24 +364,38 @@ tf_slog_call(LogTemplateFunction *self, gpointer s, const LogTemplateInvokeArgs
 
   // Compute authenticated encryption of input
   guchar outputmacdata[CMAC_LENGTH];
+  GString *text = args->argv[0];
+  GString *errorString = NULL;
 
   // Empty string received? Parsing error?
-  if(args->argv[0]->len==0)
+  if(text->len==0)
     {
       msg_error("[SLOG] ERROR: String of length 0 received");
-      GString *errorString = g_string_new("[SLOG] ERROR: String of length 0 received");
-      sLogEntry(state->numberOfLogEntries, errorString, state->key, state->bigMAC, result, outputmacdata,
-                G_N_ELEMENTS(outputmacdata));
-      g_string_free(errorString, TRUE);
+      errorString = g_string_new("[SLOG] ERROR: String of length 0 received");
+      text = errorString;
+    }
+
+  if (state->precomputer)
+    {
+      SLogKeySet set;
+
+      _key_precomputer_pop(state->precomputer, &set);
+      sLogEntryWithSubKeys(state->numberOfLogEntries, text, set.encKey, set.MACKey, state->bigMAC, result,
+                           outputmacdata, G_N_ELEMENTS(outputmacdata));
+      memcpy(state->key, set.nextKey, KEY_LENGTH);
+      OPENSSL_cleanse(&set, sizeof(set));
     }
   else
     {
-      sLogEntry(state->numberOfLogEntries, args->argv[0], state->key, state->bigMAC, result, outputmacdata,
+      sLogEntry(state->numberOfLogEntries, text, state->key, state->bigMAC, result, outputmacdata,
                 G_N_ELEMENTS(outputmacdata));
+      evolveKey(state->key);
     }
 
+  if (errorString)
+    g_string_free(errorString, TRUE);
+
   memcpy(state->bigMAC, outputmacdata, CMAC_LENGTH);
-  evolveKey(state->key);
   state->numberOfLogEntries++;
 
   int res = writeKey((char *)state->key, state->numberOfLogEntries, state->keypath);
@@ -255,6 +421,9 @@ tf_slog_func_free_state(gpointer s)
 {
   TFSlogState *state = (TFSlogState *) s;
 
+  if (state->precomputer)
+    _key_precomputer_free(state->precomputer);
+
   free(state->keypath);
   free(state->macpath);
 
@@ -31,6 +31,7 @@
 #include <openssl/rand.h>
 #include <openssl/evp.h>
 #include <openssl/sha.h>
+#include <openssl/crypto.h>
 
 #if OPENSSL_VERSION_NUMBER >= 0x30000000L
 #include <openssl/params.h>
@@ -49,6 +50,130 @@ static unsigned char KEYPATTERN[AES_BLOCKSIZE] = { [0 ... (AES_BLOCKSIZE-1) ] =
 static unsigned char MACPATTERN[AES_BLOCKSIZE] = { [0 ... (AES_BLOCKSIZE-1) ] = OPAD };
 static unsigned char GAMMA[AES_BLOCKSIZE] = { [0 ... (AES_BLOCKSIZE-1) ] =  EPAD};
 
+/*
+ * Per-thread OpenSSL contexts
+ *
+ * Setting up an EVP context (and fetching the CMAC implementation with
+ * OpenSSL 3) costs much more than processing a single log entry, so the
+ * contexts are created once per thread and only rekeyed for each
+ * operation. EVP picks the AES-NI/ARMv8 implementations automatically.
+ */
+typedef struct _SLogCryptoContext
+{
+  EVP_CIPHER_CTX *encrypt;
+  EVP_CIPHER_CTX *decrypt;
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+  EVP_MAC_CTX *cmac;
+#else
+  CMAC_CTX *cmac;
+#endif
+} SLogCryptoContext;
+
+static void
+_crypto_context_free(gpointer s)
+{
+  SLogCryptoContext *self = (SLogCryptoContext *) s;
+
+  EVP_CIPHER_CTX_free(self->encrypt);
+  EVP_CIPHER_CTX_free(self->decrypt);
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+  EVP_MAC_CTX_free(self->cmac);
+#else
+  CMAC_CTX_free(self->cmac);
+#endif
+  g_free(self);
+}
+
+static GPrivate crypto_context = G_PRIVATE_INIT(_crypto_context_free);
+
+static EVP_CIPHER_CTX *
+_cipher_context_new(gboolean encrypt)
+{
+  EVP_CIPHER_CTX *ctx = EVP_CIPHER_CTX_new();
+
+  if (!ctx)
+    return NULL;
+
+  if (1 != EVP_CipherInit_ex(ctx, EVP_aes_256_gcm(), NULL, NULL, NULL, encrypt))
+    goto error;
+
+  /* Set IV length if default 12 bytes (96 bits) is not appropriate */
+  if (IV_LENGTH != 12 && 1 != EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_SET_IVLEN, IV_LENGTH, NULL))
+    goto error;
+
+  return ctx;
+
+error:
+  EVP_CIPHER_CTX_free(ctx);
+  return NULL;
+}
+
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+
+static EVP_MAC_CTX *
+_cmac_context_new(void)
+{
+  EVP_MAC *mac = EVP_MAC_fetch(NULL, "CMAC", NULL);
+
+  if (!mac)
+    return NULL;
+
+  /* the context holds its own reference to mac */
+  EVP_MAC_CTX *ctx = EVP_MAC_CTX_new(mac);
+  EVP_MAC_free(mac);
+
+  if (!ctx)
+    return NULL;
+
+  OSSL_PARAM params[] =
+  {
+    OSSL_PARAM_utf8_string("cipher", "aes-256-cbc", 0),
+    OSSL_PARAM_END,
+  };
+
+  if (!EVP_MAC_CTX_set_params(ctx, params))
+    {
+      EVP_MAC_CTX_free(ctx);
+      return NULL;
+    }
+
+  return ctx;
+}
+
+#else
+
+static CMAC_CTX *
+_cmac_context_new(void)
+{
+  return CMAC_CTX_new();
+}
+
+#endif
+
+static SLogCryptoContext *
+_get_crypto_context(void)
+{
+  SLogCryptoContext *self = g_private_get(&crypto_context);
+
+  if (self)
+    return self;
+
+  self = g_new0(SLogCryptoContext, 1);
+  self->encrypt = _cipher_context_new(TRUE);
+  self->decrypt = _cipher_context_new(FALSE);
+  self->cmac = _cmac_context_new();
+
+  if (!self->encrypt || !self->decrypt || !self->cmac)
+    {
+      msg_error("[SLOG] ERROR: Unable to initialize OpenSSL context");
+      _crypto_context_free(self);
+      return NULL;
+    }
+
+  g_private_set(&crypto_context, self);
+  return self;
+}
+
 /*
  * Conditional msg_error output.
  *
@@ -123,36 +248,18 @@ int sLogEncrypt(unsigned char *plaintext, int plaintext_len,
    * https://wiki.openssl.org/index.php/EVP_Authenticated_Encryption_and_Decryption#Authenticated_Encryption_using_GCM_mode
    *
    */
+  SLogCryptoContext *crypto = _get_crypto_context();
   EVP_CIPHER_CTX *ctx;
 
   int len;
   int ciphertext_len;
 
-  /* Create and initialise the context */
-  if(!(ctx = EVP_CIPHER_CTX_new()))
-    {
-      msg_error("[SLOG] ERROR: Unable to initialize OpenSSL context");
-      return 0;
-    }
-
-  /* Initialise the encryption operation. */
-  if(1 != EVP_EncryptInit_ex(ctx, EVP_aes_256_gcm(), NULL, NULL, NULL))
-    {
-      msg_error("[SLOG] ERROR: Unable to initialize OpenSSL context");
-      return 0;
-    }
+  if (!crypto)
+    return 0;
 
-  if (IV_LENGTH!=12)
-    {
-      /* Set IV length if default 12 bytes (96 bits) is not appropriate */
-      if(1 != EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_SET_IVLEN, IV_LENGTH, NULL))
-        {
-          msg_error("[SLOG] ERROR: Unable to set IV length");
-          return 0;
-        }
-    }
+  ctx = crypto->encrypt;
 
-  /* Initialise key and IV */
+  /* Initialise key and IV, the cipher itself was set up when the context was created */
   if(1 != EVP_EncryptInit_ex(ctx, NULL, NULL, key, iv))
     {
       msg_error("[SLOG] ERROR: Unable to initialize encryption key and IV");
@@ -188,9 +295,6 @@ int sLogEncrypt(unsigned char *plaintext, int plaintext_len,
       return 0;
     }
 
-  /* Clean up */
-  EVP_CIPHER_CTX_free(ctx);
-
   return ciphertext_len;
 }
 
@@ -214,36 +318,18 @@ int sLogDecrypt(unsigned char *ciphertext, int ciphertext_len, unsigned char *ta
                 unsigned char *iv,
                 unsigned char *plaintext)
 {
+  SLogCryptoContext *crypto = _get_crypto_context();
   EVP_CIPHER_CTX *ctx;
   int len;
   int plaintext_len;
   int ret;
 
-  /* Create and initialise the context */
-  if(!(ctx = EVP_CIPHER_CTX_new()))
-    {
-      msg_error("[SLOG] ERROR: Unable to initialize OpenSSL context");
-      return 0;
-    }
-
-  /* Initialise the decryption operation. */
-  if(!EVP_DecryptInit_ex(ctx, EVP_aes_256_gcm(), NULL, NULL, NULL))
-    {
-      msg_error("[SLOG] ERROR: Unable initiate decryption operation");
-      return 0;
-    }
+  if (!crypto)
+    return 0;
 
-  if(IV_LENGTH!=12)
-    {
-      /* Set IV length. Not necessary if this is 12 bytes (96 bits) */
-      if(!EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_SET_IVLEN, IV_LENGTH, NULL))
-        {
-          msg_error("[SLOG] ERROR: Unable set IV length");
-          return 0;
-        }
-    }
+  ctx = crypto->decrypt;
 
-  /* Initialise key and IV */
+  /* Initialise key and IV, the cipher itself was set up when the context was created */
   if(!EVP_DecryptInit_ex(ctx, NULL, NULL, key, iv))
     {
       msg_error("[SLOG] ERROR: Unable to initialize key and IV");
@@ -273,8 +359,6 @@ int sLogDecrypt(unsigned char *ciphertext, int ciphertext_len, unsigned char *ta
    */
   ret = EVP_DecryptFinal_ex(ctx, plaintext + len, &len);
 
-  /* Clean up */
-  EVP_CIPHER_CTX_free(ctx);
   if(ret > 0)
     {
       /* Success */
@@ -310,6 +394,29 @@ void sLogEntry(guint64 numberOfLogEntries, GString *text, unsigned char *mainKey
   unsigned char MACKey[KEY_LENGTH];
   deriveSubKeys(mainKey, encKey, MACKey);
 
+  sLogEntryWithSubKeys(numberOfLogEntries, text, encKey, MACKey, inputBigMac, output, outputBigMac,
+                       outputBigMac_capacity);
+
+  OPENSSL_cleanse(encKey, KEY_LENGTH);
+  OPENSSL_cleanse(MACKey, KEY_LENGTH);
+}
+
+/*
+ * Same as sLogEntry(), but with the sub-keys of the current key already derived
+ *
+ * 1. Parameter: Number of log entries (for enumerating the entries in the log file)
+ * 2. Parameter: The original log message
+ * 3. Parameter: The encryption sub-key of the current key
+ * 4. Parameter: The MAC sub-key of the current key
+ * 5. Parameter: The current MAC
+ * 6. Parameter: The resulting encrypted log entry
+ * 7. Parameter: The newly updated MAC
+ * 8. Parameter: The capacity of the newly updated MAC buffer
+*/
+void sLogEntryWithSubKeys(guint64 numberOfLogEntries, GString *text, unsigned char *encKey, unsigned char *MACKey,
+                          unsigned char *inputBigMac, GString *output, unsigned char *outputBigMac,
+                          gsize outputBigMac_capacity)
+{
   // Compute current log entry number
   gchar *counterString = convertToBase64((unsigned char *)&numberOfLogEntries, sizeof(numberOfLogEntries));
 
@@ -426,34 +533,25 @@ gchar *convertToBase64(unsigned char *input, gsize len)
  */
 void cmac(unsigned char *key, const void *input, gsize length, unsigned char *out, gsize *outlen, gsize out_capacity)
 {
-#if OPENSSL_VERSION_NUMBER >= 0x30000000L
-  EVP_MAC *mac = EVP_MAC_fetch(NULL, "CMAC", NULL);
-  OSSL_PARAM params[] =
-  {
-    OSSL_PARAM_utf8_string("cipher", "aes-256-cbc", 0),
-    OSSL_PARAM_END,
-  };
+  SLogCryptoContext *crypto = _get_crypto_context();
+  size_t out_len = 0;
 
-  EVP_MAC_CTX *ctx = EVP_MAC_CTX_new(mac);
-
-  EVP_MAC_init(ctx, key, KEY_LENGTH, params);
-  EVP_MAC_update(ctx, input, length);
-  size_t out_len;
-  EVP_MAC_final(ctx, out, &out_len, out_capacity);
+  *outlen = 0;
+  if (!crypto)
+    return;
 
-  EVP_MAC_CTX_free(ctx);
-  EVP_MAC_free(mac);
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+  if (!EVP_MAC_init(crypto->cmac, key, KEY_LENGTH, NULL)
+      || !EVP_MAC_update(crypto->cmac, input, length)
+      || !EVP_MAC_final(crypto->cmac, out, &out_len, out_capacity))
+    return;
 #else
-  CMAC_CTX *ctx = CMAC_CTX_new();
-
-  CMAC_Init(ctx, key, KEY_LENGTH, EVP_aes_256_cbc(), NULL);
-  CMAC_Update(ctx, input, length);
-
-  size_t out_len;
-  CMAC_Final(ctx, out, &out_len);
-  *outlen = out_len;
-  CMAC_CTX_free(ctx);
+  if (!CMAC_Init(crypto->cmac, key, KEY_LENGTH, EVP_aes_256_cbc(), NULL)
+      || !CMAC_Update(crypto->cmac, input, length)
+      || !CMAC_Final(crypto->cmac, out, &out_len))
+    return;
 #endif
+  *outlen = out_len;
 }
 
 
@@ -1004,12 +1102,118 @@ int writeKey(char *key, guint64 counter, gchar *keypath)
 
 }
 
+// Entries of a buffer are decrypted in parallel if there are at least this many per thread
+#define VERIFY_MIN_ENTRIES_PER_THREAD 64
+
+// State of a single log entry while its buffer is being verified
+typedef struct _VerifyEntry
+{
+  gboolean present;
+  guint64 logEntryOnDisk;
+  // Number of log entries processed before this one, 0 means first aggregated MAC
+  guint64 entryIndex;
+  gboolean outOfOrder;
+  unsigned char mainKey[KEY_LENGTH];
+  unsigned char MACKey[KEY_LENGTH];
+
+  // Ciphertext as in the log file and its binary version (IV + TAG + CT)
+  const char *ct;
+  guchar *binBuf;
+  gsize binLength;
+  unsigned char *pt;
+  int pt_length;
+} VerifyEntry;
+
+typedef struct _VerifyWorker
+{
+  VerifyEntry *entries;
+  guint64 first;
+  guint64 last;
+} VerifyWorker;
+
+/*
+ * Decrypt a range of entries. The keys of the entries have already been
+ * evolved sequentially, so each entry can be decrypted independently.
+ */
+static gpointer
+_decrypt_entries(gpointer user_data)
+{
+  VerifyWorker *worker = (VerifyWorker *) user_data;
+
+  for (guint64 i = worker->first; i < worker->last; i++)
+    {
+      VerifyEntry *entry = &worker->entries[i];
+
+      if (!entry->present)
+        continue;
+
+      entry->binBuf = convertToBin((char *) entry->ct, &entry->binLength);
+
+      // Check whether something weird has happened during conversion
+      if (entry->binLength <= IV_LENGTH + AES_BLOCKSIZE)
+        continue;
+
+      unsigned char encKey[KEY_LENGTH];
+      deriveSubKeys(entry->mainKey, encKey, entry->MACKey);
+
+      entry->pt = g_malloc(entry->binLength - IV_LENGTH - AES_BLOCKSIZE);
+      entry->pt_length = sLogDecrypt(&entry->binBuf[IV_LENGTH + AES_BLOCKSIZE],
+                                     entry->binLength - IV_LENGTH - AES_BLOCKSIZE, &entry->binBuf[IV_LENGTH],
+                                     encKey, entry->binBuf, entry->pt);
+      OPENSSL_cleanse(encKey, KEY_LENGTH);
+    }
+
+  return NULL;
+}
+
+static void
+_decrypt_entries_in_parallel(VerifyEntry *entries, guint64 entriesInBuffer)
+{
+  guint64 numberOfThreads = MIN((guint64) g_get_num_processors(), entriesInBuffer / VERIFY_MIN_ENTRIES_PER_THREAD);
+
+  if (numberOfThreads <= 1)
+    {
+      VerifyWorker worker = { entries, 0, entriesInBuffer };
+      _decrypt_entries(&worker);
+      return;
+    }
+
+  VerifyWorker workers[numberOfThreads];
+  GThread *threads[numberOfThreads];
+  guint64 perThread = (entriesInBuffer + numberOfThreads - 1) / numberOfThreads;
+
+  for (guint64 t = 0; t < numberOfThreads; t++)
+    {
+      workers[t].entries = entries;
+      workers[t].first = MIN(t * perThread, entriesInBuffer);
+      workers[t].last = MIN((t + 1) * perThread, entriesInBuffer);
+
+      // The calling thread takes the first range
+      threads[t] = t == 0 ? NULL : g_thread_new("slog-verify", _decrypt_entries, &workers[t]);
+    }
+
+  _decrypt_entries(&workers[0]);
+
+  for (guint64 t = 1; t < numberOfThreads; t++)
+    g_thread_join(threads[t]);
+}
+
+/*
+ * Verify a buffer of log entries
+ *
+ * This is done in three steps: the key of each entry is determined
+ * sequentially (this follows the counters in the log file), then the
+ * entries are decrypted in parallel, finally the output and the aggregated
+ * MAC, which is a chain over all entries, are computed sequentially.
+ */
 int iterateBuffer(guint64 entriesInBuffer, GString **input, guint64 *nextLogEntry, unsigned char *mainKey,
                   unsigned char *keyZero, guint keyNumber, GString **output, guint64 *numberOfLogEntries, unsigned char *cmac_tag,
                   gsize cmac_tag_capacity, GHashTable *tab)
 {
 
   int ret = 1;
+  VerifyEntry *entries = g_new0(VerifyEntry, entriesInBuffer);
+
   for (guint64 i=0; i<entriesInBuffer; i++)
     {
 
@@ -1040,20 +1244,11 @@ int iterateBuffer(guint64 entriesInBuffer, GString **input, guint64 *nextLogEntr
               g_free(tmp);
             }
 
-          len = len - (COUNTER_LENGTH+1);
+          VerifyEntry *entry = &entries[i];
 
           if (logEntryOnDisk != *nextLogEntry)
             {
-              if (tab != NULL)
-                {
-                  char key[CTR_LEN_SIMPLE+1];
-                  snprintf(key, CTR_LEN_SIMPLE+1, "%"G_GUINT64_FORMAT, logEntryOnDisk);
-                  if(g_hash_table_contains(tab, key) == TRUE)
-                    {
-                      msg_error("[SLOG] ERROR: Duplicate entry detected", evt_tag_long("entry", logEntryOnDisk));
-                      ret = 0;
-                    }
-                }
+              entry->outOfOrder = TRUE;
               if (logEntryOnDisk<(*nextLogEntry))
                 {
                   if (logEntryOnDisk<keyNumber)
@@ -1083,91 +1278,100 @@ int iterateBuffer(guint64 entriesInBuffer, GString **input, guint64 *nextLogEntr
               *nextLogEntry = logEntryOnDisk;
             }
 
-          GString *line = input[i];
+          entry->present = TRUE;
+          entry->logEntryOnDisk = logEntryOnDisk;
+          entry->entryIndex = *numberOfLogEntries;
+          entry->ct = &(input[i]->str)[COUNTER_LENGTH+1];
+          memcpy(entry->mainKey, mainKey, KEY_LENGTH);
 
-          char *ct = &(line->str)[COUNTER_LENGTH+1];
-          gsize outputLength;
+          evolveKey(mainKey);
+          (*numberOfLogEntries)++;
+          (*nextLogEntry)++;
 
-          // binBuf = IV + TAG + CT
-          guchar *binBuf = convertToBin(ct, &outputLength);
-          int pt_length = 0;
+        }
+      else
+        {
+          msg_error("[SLOG] ERROR: Cannot read log entry", evt_tag_long("", *nextLogEntry));
+          ret = 0;
+        }
 
-          // Check whether something weird has happened during conversion
-          if (outputLength>IV_LENGTH+AES_BLOCKSIZE)
-            {
-              unsigned char pt[outputLength - IV_LENGTH - AES_BLOCKSIZE];
+    } // for
 
-              unsigned char encKey[KEY_LENGTH];
-              deriveEncSubKey(mainKey, encKey);
+  _decrypt_entries_in_parallel(entries, entriesInBuffer);
 
-              pt_length = sLogDecrypt(&binBuf[IV_LENGTH+AES_BLOCKSIZE], outputLength - IV_LENGTH - AES_BLOCKSIZE, &binBuf[IV_LENGTH],
-                                      encKey, binBuf, pt);
+  for (guint64 i=0; i<entriesInBuffer; i++)
+    {
+      VerifyEntry *entry = &entries[i];
 
-              if (pt_length>0)
-                {
-                  // Include colon, whitespace, and \0
-                  g_string_append_printf(output[i], "%0*"G_GINT64_MODIFIER"x: %.*s", CTR_LEN_SIMPLE, logEntryOnDisk, pt_length, pt);
+      if (!entry->present)
+        continue;
 
-                  if (tab != NULL)
-                    {
-                      char *key = g_new0(char, CTR_LEN_SIMPLE+1);
-                      snprintf(key, CTR_LEN_SIMPLE+1, "%"G_GUINT64_FORMAT, logEntryOnDisk);
-
-                      if (g_hash_table_insert(tab, key, (gpointer)logEntryOnDisk) == FALSE)
-                        {
-                          msg_warning("[SLOG] WARNING: Unable to process hash table while entering decrypted log entry", evt_tag_long("entry",
-                                      logEntryOnDisk));
-                          ret = 0;
-                        }
-                    }
+      guint64 logEntryOnDisk = entry->logEntryOnDisk;
 
-                  // Update BigHMAC
-                  if ((*numberOfLogEntries) == 0UL)   // First aggregated MAC
-                    {
-                      gsize outlen = 0;
+      if (entry->outOfOrder && tab != NULL)
+        {
+          char key[CTR_LEN_SIMPLE+1];
+          snprintf(key, CTR_LEN_SIMPLE+1, "%"G_GUINT64_FORMAT, logEntryOnDisk);
+          if(g_hash_table_contains(tab, key) == TRUE)
+            {
+              msg_error("[SLOG] ERROR: Duplicate entry detected", evt_tag_long("entry", logEntryOnDisk));
+              ret = 0;
+            }
+        }
 
-                      unsigned char MACKey[KEY_LENGTH];
-                      deriveMACSubKey(mainKey, MACKey);
+      int pt_length = entry->pt_length;
+      guchar *binBuf = entry->binBuf;
 
-                      cmac(MACKey, binBuf, IV_LENGTH+AES_BLOCKSIZE+pt_length, cmac_tag, &outlen, cmac_tag_capacity);
-                    }
-                  else
-                    {
-                      // numberOfEntries > 0
-                      gsize outlen;
-                      unsigned char bigBuf[AES_BLOCKSIZE+IV_LENGTH+AES_BLOCKSIZE+pt_length];
-                      memcpy(bigBuf, cmac_tag, AES_BLOCKSIZE);
-                      memcpy(&bigBuf[AES_BLOCKSIZE], binBuf, IV_LENGTH+AES_BLOCKSIZE+pt_length);
+      if (pt_length>0)
+        {
+          // Include colon, whitespace, and \0
+          g_string_append_printf(output[i], "%0*"G_GINT64_MODIFIER"x: %.*s", CTR_LEN_SIMPLE, logEntryOnDisk, pt_length,
+                                 entry->pt);
 
-                      unsigned char MACKey[KEY_LENGTH];
-                      deriveMACSubKey(mainKey, MACKey);
+          if (tab != NULL)
+            {
+              char *key = g_new0(char, CTR_LEN_SIMPLE+1);
+              snprintf(key, CTR_LEN_SIMPLE+1, "%"G_GUINT64_FORMAT, logEntryOnDisk);
 
-                      cmac(MACKey, bigBuf, AES_BLOCKSIZE+IV_LENGTH+AES_BLOCKSIZE+pt_length, cmac_tag, &outlen, cmac_tag_capacity);
-                    }
+              if (g_hash_table_insert(tab, key, (gpointer)logEntryOnDisk) == FALSE)
+                {
+                  msg_warning("[SLOG] WARNING: Unable to process hash table while entering decrypted log entry", evt_tag_long("entry",
+                              logEntryOnDisk));
+                  ret = 0;
                 }
             }
 
-          if (pt_length<=0)
+          // Update BigHMAC
+          if (entry->entryIndex == 0UL)   // First aggregated MAC
             {
-              msg_warning("[SLOG] WARNING: Decryption not successful",
-                          evt_tag_long("entry", logEntryOnDisk));
-              ret = 0;
-            }
+              gsize outlen = 0;
 
-          g_free(binBuf);
-
-          evolveKey(mainKey);
-          (*numberOfLogEntries)++;
-          (*nextLogEntry)++;
+              cmac(entry->MACKey, binBuf, IV_LENGTH+AES_BLOCKSIZE+pt_length, cmac_tag, &outlen, cmac_tag_capacity);
+            }
+          else
+            {
+              // numberOfEntries > 0
+              gsize outlen;
+              unsigned char bigBuf[AES_BLOCKSIZE+IV_LENGTH+AES_BLOCKSIZE+pt_length];
+              memcpy(bigBuf, cmac_tag, AES_BLOCKSIZE);
+              memcpy(&bigBuf[AES_BLOCKSIZE], binBuf, IV_LENGTH+AES_BLOCKSIZE+pt_length);
 
+              cmac(entry->MACKey, bigBuf, AES_BLOCKSIZE+IV_LENGTH+AES_BLOCKSIZE+pt_length, cmac_tag, &outlen, cmac_tag_capacity);
+            }
         }
       else
         {
-          msg_error("[SLOG] ERROR: Cannot read log entry", evt_tag_long("", *nextLogEntry));
+          msg_warning("[SLOG] WARNING: Decryption not successful",
+                      evt_tag_long("entry", logEntryOnDisk));
           ret = 0;
         }
 
-    } // for
+      g_free(binBuf);
+      g_free(entry->pt);
+    }
+
+  OPENSSL_cleanse(entries, entriesInBuffer * sizeof(VerifyEntry));
+  g_free(entries);
 
   return ret;
 }
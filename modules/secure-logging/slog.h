@@ -154,6 +154,15 @@ void deriveKey(unsigned char *dst, guint64 index, guint64 currentKey);
 void sLogEntry(guint64 numberOfLogEntries, GString *text, unsigned char *key, unsigned char *inputBigMac,
                GString *output, unsigned char *outputBigMac, gsize outputBigMac_capacity);
 
+/*
+ * Same as sLogEntry(), but takes the encryption and MAC sub-keys of the
+ * current key instead of the key itself, so that they can be derived ahead
+ * of time.
+ */
+void sLogEntryWithSubKeys(guint64 numberOfLogEntries, GString *text, unsigned char *encKey, unsigned char *MACKey,
+                          unsigned char *inputBigMac, GString *output, unsigned char *outputBigMac,
+                          gsize outputBigMac_capacity);
+
 /*
  * Generate a master key
  *
@@ -227,6 +236,7 @@ int finalizeVerify(guint64 startingEntry, guint64 entriesInFile, unsigned char *
 int iterativeFileVerify(unsigned char *previousMAC, unsigned char *previousKey, char *inputFileName,
                         unsigned char *currentMAC, char *outputFileName, guint64 entriesInFile, int chunkLength, guint64 keyNumber);
 
+void deriveSubKeys(unsigned char *mainKey, unsigned char *encKey, unsigned char *MACKey);
 void deriveEncSubKey(unsigned char *mainKey, unsigned char *encKey);
 void deriveMACSubKey(unsigned char *mainKey, unsigned char *MACKey);
 void PRF(unsigned char *key, unsigned char *originalInput, guint64 inputLength, unsigned char *output,
@@ -44,6 +44,12 @@
 #define MIN_TEST_MESSAGES 10
 #define PERFORMANCE_COUNTER 100000
 
+// More than three rounds of the keys precomputed by the template
+#define KEY_RING_TEST_MESSAGES 777
+
+// Enough entries for iterateBuffer() to decrypt them on several threads
+#define PARALLEL_VERIFY_MESSAGES 1024
+
 // Local parse options
 static MsgFormatOptions test_parse_options;
 
@@ -700,6 +706,131 @@ void test_slog_performance(void)
   closure(testData);
 }
 
+// Apply the slog template to num newly created messages
+GString **applyTemplateToMessages(LogTemplate *templ, LogMessage **logs, size_t num)
+{
+  GString **output = g_new0(GString *, num);
+
+  createLogMessages(num, logs);
+  for(size_t i = 0; i < num; i++)
+    {
+      output[i] = applyTemplate(templ, logs[i]);
+    }
+
+  return output;
+}
+
+void freeMessagesAndOutput(LogMessage **logs, GString **output, size_t num)
+{
+  for(size_t i = 0; i < num; i++)
+    {
+      log_msg_unref(logs[i]);
+      g_string_free(output[i], TRUE);
+    }
+
+  g_free(output);
+  g_free(logs);
+}
+
+void test_slog_precomputed_key_evolution(void)
+{
+  TestData *testData = initialize("test_slog_precomputed_key_evolution");
+
+  LogTemplate *slog_templ = createTemplate(testData);
+
+  // The keys are derived ahead of time in a ring, wrap around it several times
+  size_t num = KEY_RING_TEST_MESSAGES;
+  LogMessage **logs = g_new0(LogMessage *, num);
+  GString **output = applyTemplateToMessages(slog_templ, logs, num);
+
+  // The key file must hold the host key evolved once per message
+  guchar expectedKey[KEY_LENGTH];
+  memcpy(expectedKey, testData->hostKey, KEY_LENGTH);
+  for(size_t i = 0; i < num; i++)
+    {
+      evolveKey(expectedKey);
+    }
+
+  gchar currentKey[KEY_LENGTH];
+  guint64 counter = 0;
+  int ret = readKey(currentKey, &counter, testData->keyFile->str);
+  cr_assert(ret == 1, "Unable to read key from file %s", testData->keyFile->str);
+  cr_assert(counter == num, "Unexpected key counter: %" G_GUINT64_FORMAT ", expected: %zu", counter, num);
+  cr_assert(memcmp(currentKey, expectedKey, KEY_LENGTH) == 0, "Key file does not contain the evolved key");
+
+  // Each entry must have been encrypted and MACed with its own key
+  verifyMessages(testData->hostKey, testData->macFile->str, output, logs, num);
+
+  freeMessagesAndOutput(logs, output, num);
+  log_template_unref(slog_templ);
+
+  closure(testData);
+}
+
+void test_slog_parallel_verification_detects_corrupted_entry(void)
+{
+  TestData *testData = initialize("test_slog_parallel_verification_detects_corrupted_entry");
+
+  LogTemplate *slog_templ = createTemplate(testData);
+
+  size_t num = PARALLEL_VERIFY_MESSAGES;
+  LogMessage **logs = g_new0(LogMessage *, num);
+  GString **output = applyTemplateToMessages(slog_templ, logs, num);
+
+  // Corrupt the ciphertext of an entry in the middle of the buffer, keeping its counter intact
+  size_t corrupted = num / 2 + 3;
+  g_string_overwrite(output[corrupted], output[corrupted]->len - 8, "AAAAAAAA");
+
+  unsigned char keyZero[KEY_LENGTH];
+  memcpy(keyZero, testData->hostKey, KEY_LENGTH);
+
+  GHashTable *tab = NULL;
+  guint64 next = 0;
+  guint64 start = 0;
+  guint64 numberOfLogEntries = 0UL;
+  unsigned char cmac_tag[CMAC_LENGTH];
+  gchar mac[CMAC_LENGTH];
+
+  int ret = readBigMAC(testData->macFile->str, mac);
+  cr_assert(ret == 1, "Unable to read aggregated MAC from file %s", testData->macFile->str);
+  ret = initVerify(num, testData->hostKey, &next, &start, output, &tab);
+  cr_assert(ret == 1, "initVerify failed");
+
+  // The whole buffer is verified in a single call
+  GString **outputBuffer = g_new0(GString *, num);
+  ret = iterateBuffer(num, output, &next, testData->hostKey, keyZero, 0, outputBuffer, &numberOfLogEntries, cmac_tag,
+                      G_N_ELEMENTS(cmac_tag), tab);
+  cr_assert(ret == 0, "Corrupted entry not detected");
+  cr_assert(numberOfLogEntries == num, "Unexpected number of processed entries: %" G_GUINT64_FORMAT,
+            numberOfLogEntries);
+
+  // Decrypting the other entries is not affected, and they are output in order
+  for (size_t i = 0; i < num; i++)
+    {
+      if (i == corrupted)
+        {
+          cr_assert(outputBuffer[i]->len == 0, "Corrupted entry %zu decrypted", i);
+        }
+      else
+        {
+          char *plaintextMessage = (outputBuffer[i]->str) + CTR_LEN_SIMPLE + COLON + BLANK;
+          cr_assert(outputBuffer[i]->len > CTR_LEN_SIMPLE + COLON + BLANK, "Entry %zu not decrypted", i);
+          cr_assert_str_eq(plaintextMessage, log_msg_get_value_by_name(logs[i], "RAWMSG", NULL),
+                           "Entry %zu decrypted out of order", i);
+        }
+      g_string_free(outputBuffer[i], TRUE);
+    }
+  g_free(outputBuffer);
+
+  ret = finalizeVerify(start, num, (guchar *)mac, cmac_tag, tab);
+  cr_assert(ret == 0, "Aggregated MAC is correct despite the corrupted entry");
+
+  freeMessagesAndOutput(logs, output, num);
+  log_template_unref(slog_templ);
+
+  closure(testData);
+}
+
 Test(secure_logging, test_slog_template_format)
 {
   test_slog_template_format();
@@ -729,3 +860,13 @@ Test(secure_logging, test_slog_malicious_modifications)
 {
   test_slog_malicious_modifications();
 }
+
+Test(secure_logging, test_slog_precomputed_key_evolution)
+{
+  test_slog_precomputed_key_evolution();
+}
+
+Test(secure_logging, test_slog_parallel_verification_detects_corrupted_entry)
+{
+  test_slog_parallel_verification_detects_corrupted_entry();
+}
@@ -33,6 +33,8 @@
 #include "utf8utils.h"
 #include "str-utils.h"
 #include "syslog-names.h"
+#include "stats/stats-registry.h"
+#include "apphook.h"
 
 #include <regex.h>
 #include <ctype.h>
@@ -49,6 +51,11 @@ static struct
   NVHandle cisco_seqid;
 } handles;
 
+/* hostnames that could be determined without the IPv6 heuristics vs the
+ * ones that needed it, registered on stats-level(3) */
+static StatsCounterItem *count_fast_path_hits;
+static StatsCounterItem *count_fast_path_misses;
+
 static inline gboolean
 _skip_char(const guchar **data, gint *left)
 {
@@ -321,6 +328,45 @@ _syslog_format_parse_version(LogMessage *msg, const guchar **data, gint *length)
   return TRUE;
 }
 
+/* character classes used to scan the header fields in bulk */
+enum
+{
+  /* ends hostnames and program names */
+  SFC_HEADER_DELIMITER = 0x01,
+  /* not allowed in hostnames if check-hostname(yes) is set */
+  SFC_INVALID_HOSTNAME = 0x02,
+};
+
+static guint8 char_classes[256];
+
+static void
+_init_char_classes(void)
+{
+  for (gint i = 0; i < 256; i++)
+    {
+      guint8 classes = 0;
+
+      if (i == ' ' || i == '[' || i == ':')
+        classes |= SFC_HEADER_DELIMITER;
+
+      if (!((i >= 'A' && i <= 'Z') ||
+            (i >= 'a' && i <= 'z') ||
+            (i >= '0' && i <= '9') ||
+            i == '-' || i == '_' ||
+            i == '.' || i == ':' ||
+            i == '@' || i == '/'))
+        classes |= SFC_INVALID_HOSTNAME;
+
+      char_classes[i] = classes;
+    }
+}
+
+static inline gboolean
+_is_invalid_hostname_char(guchar c)
+{
+  return char_classes[c] & SFC_INVALID_HOSTNAME;
+}
+
 static void
 _syslog_format_parse_legacy_program_name(LogMessage *msg, const guchar **data, gint *length, guint flags)
 {
@@ -331,9 +377,10 @@ _syslog_format_parse_legacy_program_name(LogMessage *msg, const guchar **data, g
   src = *data;
   left = *length;
   prog_start = src;
-  while (left && *src != ' ' && *src != '[' && *src != ':')
+  while (left && (char_classes[*src] & SFC_HEADER_DELIMITER) == 0)
     {
-      _skip_char(&src, &left);
+      src++;
+      left--;
     }
   log_msg_set_value(msg, LM_V_PROGRAM, (gchar *) prog_start, src - prog_start);
   if (left > 0 && *src == '[')
@@ -368,39 +415,6 @@ _syslog_format_parse_legacy_program_name(LogMessage *msg, const guchar **data, g
   *length = left;
 }
 
-static guint8 invalid_chars[32];
-
-static void
-_init_parse_hostname_invalid_chars(void)
-{
-  if ((invalid_chars[0] & 0x1) == 0)
-    {
-      gint i;
-      /* we use a bit string to represent valid/invalid characters  when check_hostname is enabled */
-
-      /* not yet initialized */
-      for (i = 0; i < 256; i++)
-        {
-          if (!((i >= 'A' && i <= 'Z') ||
-                (i >= 'a' && i <= 'z') ||
-                (i >= '0' && i <= '9') ||
-                i == '-' || i == '_' ||
-                i == '.' || i == ':' ||
-                i == '@' || i == '/'))
-            {
-              invalid_chars[i / 8] |= 1 << (i % 8);
-            }
-        }
-      invalid_chars[0] |= 0x1;
-    }
-}
-
-static inline gboolean
-_is_invalid_hostname_char(guchar c)
-{
-  return invalid_chars[c / 8] & (1 << (c % 8));
-}
-
 typedef struct _IPv6Heuristics
 {
   gint8 current_segment;
@@ -442,6 +456,67 @@ ipv6_heuristics_feed_gchar(IPv6Heuristics *self, gchar c)
   return TRUE;
 }
 
+#define HOSTNAME_MAX_LEN 255
+
+static gint
+_scan_hostname_with_ipv6_heuristics(const guchar *src, gint left, guint flags)
+{
+  IPv6Heuristics ipv6_heuristics = {0};
+  gint len = 0;
+
+  while (len < left && src[len] != ' ' && src[len] != '[' && len < HOSTNAME_MAX_LEN)
+    {
+      ipv6_heuristics_feed_gchar(&ipv6_heuristics, src[len]);
+
+      if (src[len] == ':' && ipv6_heuristics.heuristic_failed)
+        {
+          break;
+        }
+
+      if (G_UNLIKELY((flags & LP_CHECK_HOSTNAME) && _is_invalid_hostname_char(src[len])))
+        {
+          break;
+        }
+      len++;
+    }
+  return len;
+}
+
+/* The IPv6 heuristics only matter once we see a colon, up to that point
+ * the hostname can be scanned with a single lookup per character. */
+static gint
+_scan_hostname(const guchar *src, gint left, guint flags)
+{
+  guint8 stop_classes = SFC_HEADER_DELIMITER;
+  gint max_len = MIN(left, HOSTNAME_MAX_LEN);
+  gint len = 0;
+
+  if (flags & LP_CHECK_HOSTNAME)
+    stop_classes |= SFC_INVALID_HOSTNAME;
+
+  while (len < max_len && (char_classes[src[len]] & stop_classes) == 0)
+    len++;
+
+  if (len < max_len && src[len] == ':')
+    {
+      stats_counter_inc(count_fast_path_misses);
+      return _scan_hostname_with_ipv6_heuristics(src, left, flags);
+    }
+
+  stats_counter_inc(count_fast_path_hits);
+  return len;
+}
+
+static gboolean
+_is_bad_hostname(regex_t *bad_hostname, const guchar *hostname, gint hostname_len)
+{
+  gchar hostname_buf[HOSTNAME_MAX_LEN + 1];
+
+  memcpy(hostname_buf, hostname, hostname_len);
+  hostname_buf[hostname_len] = 0;
+  return regexec(bad_hostname, hostname_buf, 0, NULL, 0) == 0;
+}
+
 static void
 _syslog_format_parse_hostname(LogMessage *msg, const guchar **data, gint *length,
                               const guchar **hostname_start, int *hostname_len,
@@ -450,10 +525,7 @@ _syslog_format_parse_hostname(LogMessage *msg, const guchar **data, gint *length
   /* FIXME: support nil value support  with new protocol*/
   const guchar *src, *oldsrc;
   gint left, oldleft;
-  gchar hostname_buf[256];
-  gint dst = 0;
-
-  IPv6Heuristics ipv6_heuristics = {0};
+  gint len;
 
   src = *data;
   left = *length;
@@ -464,26 +536,12 @@ _syslog_format_parse_hostname(LogMessage *msg, const guchar **data, gint *length
   oldsrc = src;
   oldleft = left;
 
-  while (left && *src != ' ' && *src != '[' && dst < sizeof(hostname_buf) - 1)
-    {
-      ipv6_heuristics_feed_gchar(&ipv6_heuristics, *src);
-
-      if (*src == ':' && ipv6_heuristics.heuristic_failed)
-        {
-          break;
-        }
-
-      if (G_UNLIKELY((flags & LP_CHECK_HOSTNAME) && _is_invalid_hostname_char(*src)))
-        {
-          break;
-        }
-      hostname_buf[dst++] = *src;
-      _skip_char(&src, &left);
-    }
-  hostname_buf[dst] = 0;
+  len = _scan_hostname(src, left, flags);
+  src += len;
+  left -= len;
 
   if (left && *src == ' ' &&
-      (!bad_hostname || regexec(bad_hostname, hostname_buf, 0, NULL, 0)))
+      (!bad_hostname || !_is_bad_hostname(bad_hostname, oldsrc, len)))
     {
       /* This was a hostname. It came from a
          syslog-ng, since syslogd doesn't send
@@ -767,6 +825,92 @@ error:
   return ret;
 }
 
+/* options used to parse lazily stored SDATA blocks, lazy parsing is only
+ * enabled if the source uses the same settings */
+static MsgFormatOptions lazy_sdata_options =
+{
+  .sdata_prefix = (gchar *) logmsg_sd_prefix,
+  .sdata_param_value_max = 65535,
+};
+
+static gboolean
+_syslog_format_is_lazy_sdata_enabled(const MsgFormatOptions *options)
+{
+  return (options->flags & LP_LAZY_SDATA) &&
+         options->sdata_param_value_max == lazy_sdata_options.sdata_param_value_max &&
+         strcmp(options->sdata_prefix, lazy_sdata_options.sdata_prefix) == 0;
+}
+
+/*
+ * Find the end of the SDATA block without parsing it, the block is
+ * validated only when it gets parsed.  Returns FALSE for blocks the full
+ * parser would reject for sure, these are then parsed right away so that
+ * the error is reported the usual way.
+ */
+static gboolean
+_syslog_format_skip_sd(const guchar **data, gint *length)
+{
+  const guchar *src = *data;
+  gint left = *length;
+
+  while (left && *src == '[')
+    {
+      guchar prev = *src;
+
+      _skip_char(&src, &left);
+      while (left && *src != ']')
+        {
+          if (*src == '"' && prev == '=')
+            {
+              /* quoted param value, ']' has to be escaped within */
+              _skip_char(&src, &left);
+              while (left && *src != '"')
+                {
+                  if (*src == '\\' && left > 1)
+                    _skip_char(&src, &left);
+                  else if (*src == ']')
+                    return FALSE;
+                  _skip_char(&src, &left);
+                }
+              if (!left)
+                return FALSE;
+            }
+          prev = *src;
+          _skip_char(&src, &left);
+        }
+      if (!left || prev == '[')
+        return FALSE;
+
+      /* closing bracket */
+      _skip_char(&src, &left);
+    }
+
+  *data = src;
+  *length = left;
+  return TRUE;
+}
+
+static gboolean
+_syslog_format_store_lazy_sd(LogMessage *msg, const guchar **data, gint *length)
+{
+  const guchar *start = *data;
+
+  if (!_syslog_format_skip_sd(data, length))
+    return FALSE;
+
+  log_msg_set_lazy_sdata(msg, (const gchar *) start, *data - start);
+  return TRUE;
+}
+
+static void
+_syslog_format_parse_lazy_sd(LogMessage *msg, const gchar *sdata, gsize sdata_len)
+{
+  const guchar *data = (const guchar *) sdata;
+  gint length = sdata_len;
+
+  _syslog_format_parse_sd(msg, &data, &length, &lazy_sdata_options);
+}
+
 gboolean
 _syslog_format_parse_sd_column(LogMessage *msg, const guchar **data, gint *length, const MsgFormatOptions *options)
 {
@@ -774,6 +918,10 @@ _syslog_format_parse_sd_column(LogMessage *msg, const guchar **data, gint *lengt
     return TRUE;
 
   guchar first_char = (*data)[0];
+  if (first_char == '[' && _syslog_format_is_lazy_sdata_enabled(options) &&
+      _syslog_format_store_lazy_sd(msg, data, length))
+    return TRUE;
+
   if (first_char == '-' || first_char == '[')
     return _syslog_format_parse_sd(msg, data, length, options);
 
@@ -1065,6 +1213,20 @@ syslog_format_handler(const MsgFormatOptions *parse_options,
   return success;
 }
 
+static void
+_register_stats(gint type, gpointer user_data)
+{
+  StatsClusterKey sc_key;
+
+  stats_lock();
+  stats_cluster_single_key_set(&sc_key, "syslog_format_fast_path_hits_total", NULL, 0);
+  stats_register_counter(3, &sc_key, SC_TYPE_SINGLE_VALUE, &count_fast_path_hits);
+
+  stats_cluster_single_key_set(&sc_key, "syslog_format_fast_path_misses_total", NULL, 0);
+  stats_register_counter(3, &sc_key, SC_TYPE_SINGLE_VALUE, &count_fast_path_misses);
+  stats_unlock();
+}
+
 void
 syslog_format_init(void)
 {
@@ -1073,7 +1235,13 @@ syslog_format_init(void)
       handles.is_synced = log_msg_get_value_handle(".SDATA.timeQuality.isSynced");
       handles.cisco_seqid = log_msg_get_value_handle(".SDATA.meta.sequenceId");
       handles.initialized = TRUE;
+
+      /* the stats subsystem may not be operational yet */
+      register_application_hook(AH_RUNNING, _register_stats, NULL, AHM_RUN_ONCE);
     }
 
-  _init_parse_hostname_invalid_chars();
+  lazy_sdata_options.sdata_prefix_len = logmsg_sd_prefix_len;
+  log_msg_set_lazy_sdata_parser(_syslog_format_parse_lazy_sd);
+
+  _init_char_classes();
 }
@@ -28,6 +28,7 @@
 #include "cfg.h"
 #include "syslog-format.h"
 #include "logmsg/logmsg.h"
+#include "logpipe.h"
 #include "msg-format.h"
 #include "scratch-buffers.h"
 
@@ -104,6 +105,35 @@ Test(syslog_format, minimal_non_zero_terminated_numeric_message_is_parsed_as_pro
   log_msg_unref(msg);
 }
 
+static void
+_assert_legacy_header(const gchar *data, guint extra_flags, const gchar *host, const gchar *program)
+{
+  gsize data_length = strlen(data);
+  guint32 flags = parse_options.flags;
+
+  parse_options.flags |= extra_flags;
+  msg_format_options_init(&parse_options, cfg);
+  LogMessage *msg = msg_format_construct_message(&parse_options, (const guchar *) data, data_length);
+
+  gsize problem_position;
+  cr_assert(syslog_format_handler(&parse_options, msg, (const guchar *) data, data_length, &problem_position));
+  assert_log_message_value_by_name(msg, "HOST", host);
+  assert_log_message_value_by_name(msg, "PROGRAM", program);
+
+  msg_format_options_destroy(&parse_options);
+  parse_options.flags = flags;
+  log_msg_unref(msg);
+}
+
+Test(syslog_format, hostnames_with_and_without_colons)
+{
+  _assert_legacy_header("<13>Oct 11 22:14:15 myhost prog[123]: msg", 0, "myhost", "prog");
+  _assert_legacy_header("<13>Oct 11 22:14:15 fe80::1 prog: msg", 0, "fe80::1", "prog");
+  _assert_legacy_header("<13>Oct 11 22:14:15 prog: msg", 0, "", "prog");
+  _assert_legacy_header("<13>Oct 11 22:14:15 my!host prog: msg", 0, "my!host", "prog");
+  _assert_legacy_header("<13>Oct 11 22:14:15 my!host prog: msg", LP_CHECK_HOSTNAME, "", "my!host");
+}
+
 static gboolean
 _extract_sdata_into_message_with_prefix(const gchar *sdata, LogMessage **pmsg, const gchar *sdata_prefix)
 {
@@ -295,3 +325,86 @@ Test(syslog_format, test_long_sdata)
   strcpy(long_sdata + 1 + long_sdata_id, " a=b]");
   cr_expect_not(_extract_sdata_into_message_with_prefix(long_sdata, NULL, sdata_prefix));
 }
+
+static LogMessage *
+_parse_syslog_protocol_message_lazily(const gchar *data)
+{
+  msg_format_options_defaults(&parse_options);
+  parse_options.flags |= LP_SYSLOG_PROTOCOL | LP_LAZY_SDATA;
+  msg_format_options_init(&parse_options, cfg);
+
+  LogMessage *msg = log_msg_new_empty();
+  gsize problem_position;
+  cr_assert(syslog_format_handler(&parse_options, msg, (const guchar *) data, strlen(data), &problem_position));
+  msg_format_options_destroy(&parse_options);
+  return msg;
+}
+
+Test(syslog_format, test_lazy_sdata_is_parsed_upon_first_access)
+{
+  LogMessage *msg = _parse_syslog_protocol_message_lazily(
+                      "<165>1 2003-10-11T22:14:15.003Z host prog - ID47 [foo bar=\"b\\]az\"][chew@1 chow=poke] message");
+
+  cr_assert(msg->flags & LF_LAZY_SDATA);
+  assert_log_message_value_by_name(msg, "PROGRAM", "prog");
+  assert_log_message_value_by_name(msg, "MESSAGE", "message");
+  cr_assert(msg->flags & LF_LAZY_SDATA, "accessing non-SDATA values should not parse the SDATA block");
+
+  assert_log_message_value_by_name(msg, ".SDATA.foo.bar", "b]az");
+  cr_assert_not(msg->flags & LF_LAZY_SDATA);
+  assert_log_message_value_by_name(msg, ".SDATA.chew@1.chow", "poke");
+  assert_log_message_value_by_name(msg, "SDATA", "[foo bar=\"b\\]az\"][chew@1 chow=\"poke\"]");
+  log_msg_unref(msg);
+}
+
+Test(syslog_format, test_lazy_sdata_of_a_write_protected_message_is_parsed_upon_first_access)
+{
+  LogMessage *msg = _parse_syslog_protocol_message_lazily(
+                      "<165>1 2003-10-11T22:14:15.003Z host prog - ID47 [foo bar=\"baz\"] message");
+
+  log_msg_write_protect(msg);
+  cr_assert(msg->flags & LF_LAZY_SDATA, "write protecting the message should not parse the SDATA block");
+  cr_assert_null(msg->lazy_sdata);
+
+  assert_log_message_value_by_name(msg, ".SDATA.foo.bar", "baz");
+  assert_log_message_value_by_name(msg, "SDATA", "[foo bar=\"baz\"]");
+
+  /* the shared payload is left intact, the values are parsed separately */
+  cr_assert(msg->flags & LF_LAZY_SDATA);
+  cr_assert_not_null(msg->lazy_sdata);
+  log_msg_unref(msg);
+}
+
+Test(syslog_format, test_lazy_sdata_is_kept_unparsed_by_clones)
+{
+  LogMessage *msg = _parse_syslog_protocol_message_lazily(
+                      "<165>1 2003-10-11T22:14:15.003Z host prog - ID47 [foo bar=\"baz\"] message");
+  LogPathOptions path_options = LOG_PATH_OPTIONS_INIT_NOACK;
+
+  LogMessage *clone = log_msg_clone_cow(msg, &path_options);
+  cr_assert(clone->flags & LF_LAZY_SDATA);
+
+  /* the clone is writable, so it is parsed in place */
+  assert_log_message_value_by_name(clone, ".SDATA.foo.bar", "baz");
+  cr_assert_not(clone->flags & LF_LAZY_SDATA);
+  cr_assert_null(clone->lazy_sdata);
+  cr_assert(msg->flags & LF_LAZY_SDATA);
+
+  log_msg_unref(clone);
+  log_msg_unref(msg);
+}
+
+Test(syslog_format, test_lazy_sdata_falls_back_to_parsing_invalid_sdata_right_away)
+{
+  msg_format_options_defaults(&parse_options);
+  parse_options.flags |= LP_SYSLOG_PROTOCOL | LP_LAZY_SDATA | LP_NO_RFC3164_FALLBACK;
+  msg_format_options_init(&parse_options, cfg);
+
+  const gchar *data = "<165>1 2003-10-11T22:14:15.003Z host prog - ID47 [foo bar=\"b]az\"] message";
+  LogMessage *msg = log_msg_new_empty();
+  gsize problem_position;
+  cr_assert_not(syslog_format_handler(&parse_options, msg, (const guchar *) data, strlen(data), &problem_position));
+  cr_assert_not(msg->flags & LF_LAZY_SDATA);
+  msg_format_options_destroy(&parse_options);
+  log_msg_unref(msg);
+}
@@ -34,6 +34,7 @@
 #include "journal-reader.h"
 #include "timeutils/misc.h"
 #include "ack-tracker/ack_tracker_factory.h"
+#include "ack-tracker/consecutive_ack_tracker.h"
 #include "string-list.h"
 
 #include <stdlib.h>
@@ -83,6 +84,10 @@ struct _JournalReader
   PersistState *persist_state;
   PersistEntryHandle persist_handle;
   gchar *persist_name;
+
+  /* cursor of a batch that did not end with a checkpoint, saved once
+   * everything is acked, protected by the lock of the ack tracker */
+  gchar *idle_cursor;
 };
 
 static void
@@ -244,6 +249,22 @@ _get_value_from_message(JournalReaderOptions *options, LogMessage *msg,
   return log_msg_get_value_by_name(msg, name_with_prefix, value_length);
 }
 
+static gboolean
+_is_field_stored(JournalReaderOptions *options, const gchar *key, gsize key_len)
+{
+  gchar name[256];
+
+  if (!options->stored_fields)
+    return TRUE;
+
+  if (key_len >= sizeof(name))
+    return FALSE;
+
+  memcpy(name, key, key_len);
+  name[key_len] = 0;
+  return g_hash_table_contains(options->stored_fields, name);
+}
+
 static void
 _handle_data(gchar *key, gsize key_len, gchar *value, gsize value_len, gpointer user_data)
 {
@@ -254,7 +275,8 @@ _handle_data(gchar *key, gsize key_len, gchar *value, gsize value_len, gpointer
   value_len = MIN(value_len, options->max_field_size);
 
   _map_key_value_pairs_to_syslog_macros(msg, key, key_len, value, value_len);
-  _set_value_in_message(options, msg, key, key_len, value, value_len);
+  if (_is_field_stored(options, key, key_len))
+    _set_value_in_message(options, msg, key, key_len, value, value_len);
 }
 
 static void
@@ -502,13 +524,19 @@ _get_cursor(JournalReader *self)
   return cursor;
 }
 
+static void
+_save_cursor(PersistState *persist_state, PersistEntryHandle persist_handle, const gchar *cursor)
+{
+  JournalReaderState *state = persist_state_map_entry(persist_state, persist_handle);
+  g_strlcpy(state->cursor, cursor, sizeof(state->cursor));
+  persist_state_unmap_entry(persist_state, persist_handle);
+}
+
 static void
 _reader_save_state(Bookmark *bookmark)
 {
   JournalBookmarkData *bookmark_data = (JournalBookmarkData *)(&bookmark->container);
-  JournalReaderState *state = persist_state_map_entry(bookmark->persist_state, bookmark_data->persist_handle);
-  strcpy(state->cursor, bookmark_data->cursor);
-  persist_state_unmap_entry(bookmark->persist_state, bookmark_data->persist_handle);
+  _save_cursor(bookmark->persist_state, bookmark_data->persist_handle, bookmark_data->cursor);
 }
 
 static void
@@ -518,30 +546,96 @@ _destroy_bookmark(Bookmark *bookmark)
   free(bookmark_data->cursor);
 }
 
+/* takes ownership of the cursor, bookmarks without one do not save anything */
 static void
-_fill_bookmark(JournalReader *self, Bookmark *bookmark)
+_fill_bookmark(JournalReader *self, Bookmark *bookmark, gchar *cursor)
 {
   JournalBookmarkData *bookmark_data = (JournalBookmarkData *)(&bookmark->container);
-  bookmark_data->cursor = _get_cursor(self);
+  bookmark_data->cursor = cursor;
   bookmark_data->persist_handle = self->persist_handle;
-  bookmark->save = _reader_save_state;
+  bookmark->save = cursor ? _reader_save_state : NULL;
   bookmark->destroy = _destroy_bookmark;
 }
 
+/*
+ * Cursor checkpoints
+ *
+ * Only the last entry of a batch carries a cursor in its bookmark, so the
+ * cursor is persisted once per batch instead of once per entry.  If the
+ * batch was cut short (end of the journal, full window, shutdown), the
+ * last entry we read is not known to be the last one while it is posted;
+ * its cursor is saved instead when all the messages in flight are acked.
+ */
+static void
+_save_idle_cursor(gpointer s)
+{
+  JournalReader *self = (JournalReader *) s;
+
+  if (self->idle_cursor)
+    {
+      _save_cursor(self->persist_state, self->persist_handle, self->idle_cursor);
+      free(self->idle_cursor);
+      self->idle_cursor = NULL;
+    }
+}
+
+/* takes ownership of the cursor */
+static void
+_set_idle_cursor(JournalReader *self, gchar *cursor)
+{
+  AckTracker *ack_tracker = self->super.ack_tracker;
+
+  consecutive_ack_tracker_lock(ack_tracker);
+  {
+    free(self->idle_cursor);
+    self->idle_cursor = cursor;
+    if (consecutive_ack_tracker_is_empty(ack_tracker))
+      _save_idle_cursor(self);
+  }
+  consecutive_ack_tracker_unlock(ack_tracker);
+}
+
+static gint
+_get_batch_size(JournalReader *self)
+{
+  gsize free_window = log_source_get_free_window(&self->super);
+
+  return MAX(1, MIN((gsize) self->options->fetch_limit, free_window));
+}
+
 static gint
 _fetch_log(JournalReader *self)
 {
   gint msg_count = 0;
   gint result = 0;
+  gint batch_size = _get_batch_size(self);
+  gchar *last_cursor = NULL;
+
   self->immediate_check = TRUE;
-  while (msg_count < self->options->fetch_limit && !main_loop_worker_job_quit())
+  while (msg_count < batch_size && !main_loop_worker_job_quit())
     {
       gint rc = sd_journal_next(self->journal);
       if (rc > 0)
         {
+          /* the checkpoints of this batch supersede the cursor of the previous one */
+          if (msg_count == 0)
+            _set_idle_cursor(self, NULL);
+
           Bookmark *bookmark = ack_tracker_request_bookmark(self->super.ack_tracker);
-          _fill_bookmark(self, bookmark);
+
+          free(last_cursor);
+          last_cursor = _get_cursor(self);
           msg_count++;
+          if (msg_count == batch_size)
+            {
+              _fill_bookmark(self, bookmark, last_cursor);
+              last_cursor = NULL;
+            }
+          else
+            {
+              _fill_bookmark(self, bookmark, NULL);
+            }
+
           if (!_handle_message(self))
             {
               break;
@@ -560,6 +654,9 @@ _fetch_log(JournalReader *self)
           break;
         }
     }
+
+  if (last_cursor)
+    _set_idle_cursor(self, last_cursor);
   return result;
 }
 
@@ -781,6 +878,7 @@ _init(LogPipe *s)
 
   if (!log_source_init(s))
     return FALSE;
+  consecutive_ack_tracker_set_on_all_acked(self->super.ack_tracker, _save_idle_cursor, self, NULL);
 
   gint res = _journal_open(self);
   if (res < 0)
@@ -840,6 +938,7 @@ _free(LogPipe *s)
   log_pipe_unref(self->control);
   log_source_free(&self->super.super);
   g_free(self->persist_name);
+  free(self->idle_cursor);
   return;
 }
 
@@ -899,6 +998,19 @@ journal_reader_new(GlobalConfig *cfg)
   return self;
 }
 
+/* the fields $PROGRAM is set from are looked up among the stored values */
+static GHashTable *
+_create_stored_fields(GList *fields)
+{
+  GHashTable *stored_fields = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+
+  for (GList *l = fields; l; l = l->next)
+    g_hash_table_add(stored_fields, g_strdup(l->data));
+  g_hash_table_add(stored_fields, g_strdup("SYSLOG_IDENTIFIER"));
+  g_hash_table_add(stored_fields, g_strdup("_COMM"));
+  return stored_fields;
+}
+
 void
 journal_reader_options_init(JournalReaderOptions *options, GlobalConfig *cfg, const gchar *group_name)
 {
@@ -941,6 +1053,8 @@ journal_reader_options_init(JournalReaderOptions *options, GlobalConfig *cfg, co
       msg_warning("namespace() option on systemd-journal() will have no effect! (systemd < v245)");
     }
 #endif
+  if (options->fields && !options->stored_fields)
+    options->stored_fields = _create_stored_fields(options->fields);
   options->initialized = TRUE;
 }
 
@@ -1009,6 +1123,13 @@ journal_reader_options_set_match_boot(JournalReaderOptions *self, gboolean enabl
   self->match_boot = enable;
 }
 
+void
+journal_reader_options_set_fields(JournalReaderOptions *self, GList *fields)
+{
+  string_list_free(self->fields);
+  self->fields = fields;
+}
+
 void
 journal_reader_options_defaults(JournalReaderOptions *options)
 {
@@ -1047,5 +1168,12 @@ journal_reader_options_destroy(JournalReaderOptions *options)
       options->namespace = NULL;
     }
   string_list_free(options->matches);
+  string_list_free(options->fields);
+  options->fields = NULL;
+  if (options->stored_fields)
+    {
+      g_hash_table_unref(options->stored_fields);
+      options->stored_fields = NULL;
+    }
   options->initialized = FALSE;
 }
@@ -45,6 +45,9 @@ typedef struct _JournalReaderOptions
   gchar *namespace;
   GList *matches;
   gboolean match_boot;
+  /* journal fields stored as name-value pairs, NULL means all of them */
+  GList *fields;
+  GHashTable *stored_fields;
 } JournalReaderOptions;
 
 JournalReader *journal_reader_new(GlobalConfig *cfg);
@@ -61,6 +64,7 @@ void journal_reader_options_set_namespace(JournalReaderOptions *self, gchar *nam
 void journal_reader_options_set_log_fetch_limit(JournalReaderOptions *self, gint log_fetch_limit);
 void journal_reader_options_set_matches(JournalReaderOptions *self, GList *matches);
 void journal_reader_options_set_match_boot(JournalReaderOptions *self, gboolean enable);
+void journal_reader_options_set_fields(JournalReaderOptions *self, GList *fields);
 void journal_reader_options_defaults(JournalReaderOptions *options);
 void journal_reader_options_destroy(JournalReaderOptions *options);
 
@@ -359,6 +359,31 @@ _test_program_field_test(TestCase *self, TestSource *src, LogMessage *msg)
     }
 }
 
+void
+_test_fields_init(TestCase *self, TestSource *src, JournalReader *reader,
+                  JournalReaderOptions *options)
+{
+  GList *fields = g_list_append(NULL, g_strdup("_SYSTEMD_UNIT"));
+  journal_reader_options_set_fields(options, fields);
+
+  MockEntry *entry = __create_real_entry("fields_test");
+  mock_journal_add_entry(entry);
+}
+
+void
+_test_fields_test(TestCase *self, TestSource *src, LogMessage *msg)
+{
+  cr_assert_str_eq(log_msg_get_value(msg, LM_V_MESSAGE, NULL),
+                   "pam_unix(sshd:session): session opened for user foo_user by (uid=0)");
+  cr_assert_str_eq(log_msg_get_value(msg, LM_V_HOST, NULL), "localhost.localdomain");
+  cr_assert_str_eq(log_msg_get_value(msg, LM_V_PROGRAM, NULL), "sshd");
+  cr_assert_str_eq(log_msg_get_value_by_name(msg, ".journald._SYSTEMD_UNIT", NULL), "session-2.scope");
+  cr_assert_str_eq(log_msg_get_value_by_name(msg, ".journald._CMDLINE", NULL), "",
+                   "fields not listed in fields() are not to be stored");
+  cr_assert_str_eq(log_msg_get_value_by_name(msg, ".journald.MESSAGE", NULL), "");
+  test_source_finish_tc(src);
+}
+
 Test(systemd_journal, test_journal_reader)
 {
   const gchar *persist_file = "test_systemd_journal55.persist";
@@ -373,6 +398,7 @@ Test(systemd_journal, test_journal_reader)
   TestCase tc_default_level =  { _test_default_level_init, _test_default_level_test, NULL, GINT_TO_POINTER(LOG_ERR) };
   TestCase tc_default_facility = { _test_default_facility_init, _test_default_facility_test, NULL, GINT_TO_POINTER(LOG_AUTH) };
   TestCase tc_program_field = { _test_program_field_init, _test_program_field_test, NULL, NULL };
+  TestCase tc_fields = { _test_fields_init, _test_fields_test, NULL, NULL };
 
   test_source_add_test_case(src, &tc_default_working);
   test_source_add_test_case(src, &tc_prefix);
@@ -381,6 +407,7 @@ Test(systemd_journal, test_journal_reader)
   test_source_add_test_case(src, &tc_default_level);
   test_source_add_test_case(src, &tc_default_facility);
   test_source_add_test_case(src, &tc_program_field);
+  test_source_add_test_case(src, &tc_fields);
 
   test_source_run_tests(src);
   log_pipe_unref((LogPipe *)src);
@@ -0,0 +1,272 @@
+/*
+ * Copyright (c) 2024 One Identity LLC.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#include "date-format.h"
+
+#include <string.h>
+
+static gboolean
+_consume(const gchar **p, const gchar *s)
+{
+  gsize len = strlen(s);
+
+  if (strncmp(*p, s, len) != 0)
+    return FALSE;
+  *p += len;
+  return TRUE;
+}
+
+static gboolean
+_compile_fixed_layout(DateFormat *self, const gchar *format)
+{
+  const gchar *p = format;
+
+  if (!_consume(&p, "%F") && !_consume(&p, "%Y-%m-%d"))
+    return FALSE;
+
+  if (*p != 'T' && *p != ' ')
+    return FALSE;
+  self->date_time_separator = *p++;
+
+  if (!_consume(&p, "%T") && !_consume(&p, "%H:%M:%S"))
+    return FALSE;
+
+  if ((p[0] == '.' || p[0] == ',') && p[1] == '%' && p[2] == 'f')
+    {
+      self->frac_separator = p[0];
+      p += 3;
+    }
+  self->has_zone = _consume(&p, "%z");
+  return *p == 0;
+}
+
+static void
+_add_first_chars(DateFormat *self, guchar first, guchar last)
+{
+  for (gint c = first; c <= last; c++)
+    self->first_chars[c / 32] |= 1U << (c % 32);
+}
+
+/* only the conversions that are known to fail unless the input starts
+ * with one of the characters we collect here are covered, for anything
+ * else the first character is unknown */
+static gboolean
+_collect_first_chars(DateFormat *self, const gchar *format)
+{
+  if (format[0] != '%')
+    {
+      if (format[0] == 0 || g_ascii_isspace(format[0]))
+        return FALSE;
+      _add_first_chars(self, format[0], format[0]);
+      return TRUE;
+    }
+
+  switch (format[1])
+    {
+    case 'C': case 'd': case 'D': case 'e': case 'f': case 'F':
+    case 'g': case 'H': case 'I': case 'j': case 'k': case 'l':
+    case 'm': case 'M': case 'R': case 's': case 'S': case 'T':
+    case 'u': case 'U': case 'V': case 'w': case 'W': case 'y': case 'Y':
+      _add_first_chars(self, '0', '9');
+      return TRUE;
+    case 'a': case 'A': case 'b': case 'B': case 'h': case 'p':
+      _add_first_chars(self, 'a', 'z');
+      _add_first_chars(self, 'A', 'Z');
+      return TRUE;
+    case '%':
+      _add_first_chars(self, '%', '%');
+      return TRUE;
+    default:
+      return FALSE;
+    }
+}
+
+void
+date_format_compile(DateFormat *self, const gchar *format)
+{
+  memset(self, 0, sizeof(*self));
+  self->format = format;
+  self->fixed_layout = _compile_fixed_layout(self, format);
+  if (!self->fixed_layout)
+    {
+      self->date_time_separator = 0;
+      self->frac_separator = 0;
+      self->has_zone = FALSE;
+    }
+  self->first_chars_known = _collect_first_chars(self, format);
+}
+
+/* Two formats are exclusive if no input can be parsed by both of them,
+ * this makes the order they are tried in irrelevant.  Different fixed
+ * layouts always differ in a separator or in what follows the seconds,
+ * formats with the same fixed layout produce the same result. */
+gboolean
+date_format_is_exclusive_with(const DateFormat *self, const DateFormat *other)
+{
+  if (self->fixed_layout && other->fixed_layout)
+    return TRUE;
+
+  if (!self->first_chars_known || !other->first_chars_known)
+    return FALSE;
+
+  for (gsize i = 0; i < G_N_ELEMENTS(self->first_chars); i++)
+    {
+      if (self->first_chars[i] & other->first_chars[i])
+        return FALSE;
+    }
+  return TRUE;
+}
+
+static inline gboolean
+_parse_digits(const gchar **p, gint digits, gint min_value, gint max_value, gint *value)
+{
+  gint result = 0;
+
+  for (gint i = 0; i < digits; i++)
+    {
+      if (!g_ascii_isdigit((*p)[i]))
+        return FALSE;
+      result = result * 10 + ((*p)[i] - '0');
+    }
+  if (result < min_value || result > max_value)
+    return FALSE;
+
+  *p += digits;
+  *value = result;
+  return TRUE;
+}
+
+static gboolean
+_parse_fraction(const gchar **p, gint *usec)
+{
+  const gchar *s = *p;
+  gint result = 0;
+  gint digits = 0;
+
+  if (!g_ascii_isdigit(*s))
+    return FALSE;
+
+  /* sub-microsecond digits are dropped, just like %f does */
+  for (; g_ascii_isdigit(*s); s++, digits++)
+    {
+      if (digits < 6)
+        result = result * 10 + (*s - '0');
+    }
+  for (; digits < 6; digits++)
+    result *= 10;
+
+  *p = s;
+  *usec = result;
+  return TRUE;
+}
+
+/* Z, [+-]hh, [+-]hhmm and [+-]hh:mm, the rest is left to strptime */
+static gboolean
+_parse_zone(const gchar **p, long *gmtoff)
+{
+  const gchar *s = *p;
+  gint sign, hours, minutes = 0;
+
+  if (*s == 'Z')
+    {
+      *gmtoff = 0;
+      *p = s + 1;
+      return TRUE;
+    }
+
+  if (*s != '+' && *s != '-')
+    return FALSE;
+  sign = *s == '-' ? -1 : 1;
+  s++;
+
+  if (!_parse_digits(&s, 2, 0, 99, &hours))
+    return FALSE;
+
+  if (*s == ':')
+    {
+      s++;
+      if (!_parse_digits(&s, 2, 0, 59, &minutes))
+        return FALSE;
+    }
+  else if (*s && !_parse_digits(&s, 2, 0, 59, &minutes))
+    return FALSE;
+
+  *gmtoff = sign * (hours * 3600 + minutes * 60);
+  *p = s;
+  return TRUE;
+}
+
+/* Accepts a strict subset of what wall_clock_time_strptime() accepts for
+ * the same format and produces the same fields, except for tm_wday and
+ * tm_yday, which are recalculated by mktime() during conversion anyway.
+ * The WallClockTime instance is only touched if the input matches. */
+static gboolean
+_parse_fixed_layout(const DateFormat *self, WallClockTime *wct, const gchar *input)
+{
+  const gchar *p = input;
+  gint year, mon, mday, hour, min, sec, usec = 0;
+  long gmtoff = -1;
+
+  if (!_parse_digits(&p, 4, 0, 9999, &year) || *p++ != '-' ||
+      !_parse_digits(&p, 2, 1, 12, &mon) || *p++ != '-' ||
+      !_parse_digits(&p, 2, 1, 31, &mday) || *p++ != self->date_time_separator ||
+      !_parse_digits(&p, 2, 0, 23, &hour) || *p++ != ':' ||
+      !_parse_digits(&p, 2, 0, 59, &min) || *p++ != ':' ||
+      !_parse_digits(&p, 2, 0, 61, &sec))
+    return FALSE;
+
+  if (self->frac_separator && (*p++ != self->frac_separator || !_parse_fraction(&p, &usec)))
+    return FALSE;
+
+  if (self->has_zone && !_parse_zone(&p, &gmtoff))
+    return FALSE;
+
+  if (*p)
+    return FALSE;
+
+  wct->wct_year = year - 1900;
+  wct->wct_mon = mon - 1;
+  wct->wct_mday = mday;
+  wct->wct_hour = hour;
+  wct->wct_min = min;
+  wct->wct_sec = sec;
+  wct->wct_usec = usec;
+  if (self->has_zone)
+    {
+      wct->wct_isdst = 0;
+      wct->wct_gmtoff = gmtoff;
+      wct->wct_zone = "UTC";
+    }
+  return TRUE;
+}
+
+gboolean
+date_format_parse(const DateFormat *self, WallClockTime *wct, const gchar *input)
+{
+  wall_clock_time_unset(wct);
+
+  if (self->fixed_layout && _parse_fixed_layout(self, wct, input))
+    return TRUE;
+
+  const gchar *remainder = wall_clock_time_strptime(wct, self->format, input);
+  return remainder && !remainder[0];
+}
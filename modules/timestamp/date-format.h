@@ -0,0 +1,57 @@
+/*
+ * Copyright (c) 2024 One Identity LLC.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#ifndef DATE_FORMAT_H_INCLUDED
+#define DATE_FORMAT_H_INCLUDED
+
+#include "syslog-ng.h"
+#include "timeutils/wallclocktime.h"
+
+/*
+ * A date-parser() format, analyzed once at configuration time.
+ *
+ * Formats that describe the fixed layout
+ *
+ *    %Y-%m-%d<T or space>%H:%M:%S[<. or ,>%f][%z]
+ *
+ * (%F and %T are accepted as well) are parsed by a hand-written parser,
+ * falling back to wall_clock_time_strptime() for inputs it does not handle
+ * (e.g. non-numeric timezones), everything else is parsed using strptime.
+ */
+typedef struct _DateFormat
+{
+  const gchar *format;
+  gboolean fixed_layout;
+  gchar date_time_separator;
+  gchar frac_separator;
+  gboolean has_zone;
+
+  /* the set of characters a matching input may start with, if known */
+  gboolean first_chars_known;
+  guint32 first_chars[256 / 32];
+} DateFormat;
+
+void date_format_compile(DateFormat *self, const gchar *format);
+gboolean date_format_parse(const DateFormat *self, WallClockTime *wct, const gchar *input);
+gboolean date_format_is_exclusive_with(const DateFormat *self, const DateFormat *other);
+
+#endif
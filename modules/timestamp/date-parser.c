@@ -22,6 +22,7 @@
  */
 
 #include "date-parser.h"
+#include "date-format.h"
 #include "str-utils.h"
 #include "string-list.h"
 #include "timeutils/wallclocktime.h"
@@ -35,10 +36,22 @@ enum
   DPF_GUESS_TIMEZONE = 0x0001,
 };
 
+typedef struct _DateParserFormat
+{
+  DateFormat format;
+  gboolean can_be_tried_first;
+} DateParserFormat;
+
 typedef struct _DateParser
 {
   LogParser super;
   GList *date_formats;
+  DateParserFormat *compiled_formats;
+  gint num_compiled_formats;
+
+  /* the format that matched the last time, it is tried first if that
+   * cannot change the result, see _can_be_tried_first() */
+  gint last_matching_format;
   gchar *date_tz;
   LogMessageTimeStamp time_stamp;
   TimeZoneInfo *date_tz_info;
@@ -46,6 +59,36 @@ typedef struct _DateParser
   NVHandle value_handle;
 } DateParser;
 
+/* Trying the last matching format first is only allowed if none of the
+ * formats preceding it could match the same input, otherwise the first
+ * matching format in the list might not win. */
+static gboolean
+_can_be_tried_first(DateParser *self, gint index)
+{
+  for (gint i = 0; i < index; i++)
+    {
+      if (!date_format_is_exclusive_with(&self->compiled_formats[i].format, &self->compiled_formats[index].format))
+        return FALSE;
+    }
+  return TRUE;
+}
+
+static void
+_compile_formats(DateParser *self)
+{
+  g_free(self->compiled_formats);
+  self->num_compiled_formats = g_list_length(self->date_formats);
+  self->compiled_formats = g_new(DateParserFormat, self->num_compiled_formats);
+  self->last_matching_format = 0;
+
+  gint i = 0;
+  for (GList *item = self->date_formats; item; item = item->next, i++)
+    {
+      date_format_compile(&self->compiled_formats[i].format, item->data);
+      self->compiled_formats[i].can_be_tried_first = _can_be_tried_first(self, i);
+    }
+}
+
 void
 date_parser_set_formats(LogParser *s, GList *formats)
 {
@@ -53,6 +96,7 @@ date_parser_set_formats(LogParser *s, GList *formats)
 
   string_list_free(self->date_formats);
   self->date_formats = formats;
+  _compile_formats(self);
 }
 
 void
@@ -91,20 +135,15 @@ date_parser_init(LogPipe *s)
   return log_parser_init_method(s);
 }
 
-/* NOTE: tm is initialized with the current time and date */
 static gboolean
 _parse_timestamp_and_deduce_missing_parts(DateParser *self, WallClockTime *wct, const gchar *input,
-                                          const gchar *date_format)
+                                          const DateParserFormat *date_format)
 {
-  const gchar *remainder;
-
   msg_trace("date-parser message processing for",
             evt_tag_str("input", input),
-            evt_tag_str("date_format", date_format));
-
-  remainder = wall_clock_time_strptime(wct, date_format, input);
+            evt_tag_str("date_format", date_format->format.format));
 
-  if (!remainder || remainder[0])
+  if (!date_format_parse(&date_format->format, wct, input))
     return FALSE;
 
   /* hopefully _parse_timestamp will fill all necessary information, if
@@ -117,10 +156,23 @@ _parse_timestamp_and_deduce_missing_parts(DateParser *self, WallClockTime *wct,
 static gboolean
 _parse_timestamp_against_date_format_list(DateParser *self, WallClockTime *wct, const gchar *input)
 {
-  for (GList *item = self->date_formats; item; item = item->next)
+  gint last_matching_format = g_atomic_int_get(&self->last_matching_format);
+
+  if (last_matching_format > 0 &&
+      _parse_timestamp_and_deduce_missing_parts(self, wct, input, &self->compiled_formats[last_matching_format]))
+    return TRUE;
+
+  for (gint i = 0; i < self->num_compiled_formats; i++)
     {
-      if (_parse_timestamp_and_deduce_missing_parts(self, wct, input, item->data))
-        return TRUE;
+      if (i == last_matching_format && i > 0)
+        continue;
+
+      if (_parse_timestamp_and_deduce_missing_parts(self, wct, input, &self->compiled_formats[i]))
+        {
+          if (i != last_matching_format)
+            g_atomic_int_set(&self->last_matching_format, self->compiled_formats[i].can_be_tried_first ? i : 0);
+          return TRUE;
+        }
     }
 
   return FALSE;
@@ -211,6 +263,7 @@ date_parser_free(LogPipe *s)
   DateParser *self = (DateParser *)s;
 
   string_list_free(self->date_formats);
+  g_free(self->compiled_formats);
   g_free(self->date_tz);
   if (self->date_tz_info)
     time_zone_info_free(self->date_tz_info);
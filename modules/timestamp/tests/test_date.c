@@ -117,6 +117,13 @@ ParameterizedTestParameters(date, test_date_parser)
     { "2015-01-26T16:14:49O", NULL, NULL, LM_TS_STAMP, "2015-01-26T16:14:49+02:00" },
     { "2015-01-26T16:14:49GMT", NULL, NULL, LM_TS_STAMP, "2015-01-26T16:14:49+00:00" },
     { "2015-01-26T16:14:49PDT", NULL, NULL, LM_TS_STAMP, "2015-01-26T16:14:49-07:00" },
+    { "2015-01-26T16:14:49+03", NULL, NULL, LM_TS_STAMP, "2015-01-26T16:14:49+03:00" },
+    { "2015-01-26T16:14:49-00:30", NULL, NULL, LM_TS_STAMP, "2015-01-26T16:14:49-00:30" },
+    { "2015-01-26T16:14:49 +03:00", NULL, NULL, LM_TS_STAMP, "2015-01-26T16:14:49+03:00" },
+    { "2015-1-26T16:14:49+03:00", NULL, NULL, LM_TS_STAMP, "2015-01-26T16:14:49+03:00" },
+    { "2015-01-26T16:14:49.123456789+03:00", NULL, "%FT%T.%f%z", LM_TS_STAMP, "2015-01-26T16:14:49+03:00" },
+    { "2015-01-26 16:14:49", NULL, "%Y-%m-%d %H:%M:%S", LM_TS_STAMP, "2015-01-26T16:14:49+01:00" },
+    { "2015-01-26  16:14:49", NULL, "%Y-%m-%d %H:%M:%S", LM_TS_STAMP, "2015-01-26T16:14:49+01:00" },
 
     /* RFC 2822 */
     { "Tue, 27 Jan 2015 11:48:46 +0200", NULL, "%a, %d %b %Y %T %z", LM_TS_STAMP, "2015-01-27T11:48:46+02:00" },
@@ -232,6 +239,8 @@ ParameterizedTestParameters(date, test_date_with_multiple_formats)
     { "2017-02-02 00:29:16",                0 },
     { "2017-02-02 00:29:16,706",       706000 },
     { "2019-05-04T21:55:46.989+02:00", 989000 },
+    { "2019-05-04T21:55:46.9+02:00",   900000 },
+    { "2019-05-04T21:55:46.123456789Z", 123456 },
   };
 
   return cr_make_param_array(struct date_with_multiple_formats_params, params,
@@ -250,16 +259,67 @@ ParameterizedTest(struct date_with_multiple_formats_params *params, date, test_d
   date_parser_set_formats(parser, formats);
   date_parser_set_time_stamp(parser, LM_TS_STAMP);
 
-  LogMessage *logmsg = _construct_logmsg(params->msg);
+  /* repeat to exercise the format that matched the last time */
+  for (gint i = 0; i < 2; i++)
+    {
+      LogMessage *logmsg = _construct_logmsg(params->msg);
 
+      gboolean success = log_parser_process(parser, &logmsg, NULL, log_msg_get_value(logmsg, LM_V_MESSAGE, NULL), -1);
+
+      cr_assert(success, "unable to parse msg=%s with a list of formats", params->msg);
+
+      cr_assert(logmsg->timestamps[LM_TS_STAMP].ut_usec == params->expected_usec, "expected %d us, got %d",
+                params->expected_usec,
+                logmsg->timestamps[LM_TS_STAMP].ut_usec);
+      log_msg_unref(logmsg);
+    }
+
+  log_pipe_unref(&parser->super);
+}
+
+static void
+_assert_parsed_date(LogParser *parser, const gchar *msg, const gchar *expected)
+{
+  GString *res = g_string_sized_new(128);
+  LogMessage *logmsg = _construct_logmsg(msg);
   gboolean success = log_parser_process(parser, &logmsg, NULL, log_msg_get_value(logmsg, LM_V_MESSAGE, NULL), -1);
 
-  cr_assert(success, "unable to parse msg=%s with a list of formats", params->msg);
+  cr_assert(success, "failed to parse timestamp, msg=%s", msg);
+  append_format_unix_time(&logmsg->timestamps[LM_TS_STAMP], res, TS_FMT_ISO, -1, 0);
+  cr_assert_str_eq(res->str, expected, "incorrect date parsed msg=%s result=%s", msg, res->str);
 
-  cr_assert(logmsg->timestamps[LM_TS_STAMP].ut_usec == params->expected_usec, "expected %d us, got %d",
-            params->expected_usec,
-            logmsg->timestamps[LM_TS_STAMP].ut_usec);
   log_msg_unref(logmsg);
+  g_string_free(res, TRUE);
+}
+
+Test(date, test_date_with_ambiguous_formats_prefers_the_first_matching_one)
+{
+  LogParser *parser = date_parser_new(configuration);
+  GList *formats = g_list_append(NULL, g_strdup("%d/%m/%Y %T"));
+  formats = g_list_append(formats, g_strdup("%m/%d/%Y %T"));
+  date_parser_set_formats(parser, formats);
+  date_parser_set_time_stamp(parser, LM_TS_STAMP);
+
+  _assert_parsed_date(parser, "02/13/2015 10:00:00", "2015-02-13T10:00:00+01:00");
+  _assert_parsed_date(parser, "01/02/2015 10:00:00", "2015-02-01T10:00:00+01:00");
+
+  log_pipe_unref(&parser->super);
+}
+
+Test(date, test_date_with_exclusive_formats_in_any_order)
+{
+  LogParser *parser = date_parser_new(configuration);
+  GList *formats = g_list_append(NULL, g_strdup("%b %d %Y %T"));
+  formats = g_list_append(formats, g_strdup("%FT%T%z"));
+  formats = g_list_append(formats, g_strdup("%s"));
+  date_parser_set_formats(parser, formats);
+  date_parser_set_time_stamp(parser, LM_TS_STAMP);
+
+  _assert_parsed_date(parser, "2015-01-26T16:14:49+03:00", "2015-01-26T16:14:49+03:00");
+  _assert_parsed_date(parser, "Jan 27 2015 11:48:46", "2015-01-27T11:48:46+01:00");
+  _assert_parsed_date(parser, "2015-01-26T16:14:49+03:00", "2015-01-26T16:14:49+03:00");
+  _assert_parsed_date(parser, "2015-01-26T16:14:49+03:00", "2015-01-26T16:14:49+03:00");
+  _assert_parsed_date(parser, "1446128356", "2015-10-29T15:19:16+01:00");
 
   log_pipe_unref(&parser->super);
 }
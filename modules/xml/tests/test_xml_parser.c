@@ -49,6 +49,7 @@ typedef struct
   gboolean strip_whitespaces;
   gboolean *create_lists;
   GList *exclude_tags;
+  GList *extract;
   const gchar *prefix;
 } XMLParserTestOptions;
 
@@ -63,6 +64,8 @@ _construct_xml_parser(XMLParserTestOptions options)
     xml_scanner_options_set_strip_whitespaces(xml_parser_get_scanner_options(xml_parser), options.strip_whitespaces);
   if (options.exclude_tags)
     xml_scanner_options_set_and_compile_exclude_tags(xml_parser_get_scanner_options(xml_parser), options.exclude_tags);
+  if (options.extract)
+    xml_scanner_options_set_and_compile_extract(xml_parser_get_scanner_options(xml_parser), options.extract);
   if (options.prefix)
     xml_parser_set_prefix(xml_parser, options.prefix);
 
@@ -380,6 +383,53 @@ Test(xmlparser, test_multiple_exclude_tags)
   g_list_free(exclude_tags);
 }
 
+Test(xmlparser, test_extract)
+{
+  GList *extract = NULL;
+  extract = g_list_append(extract, "Event.System.EventID");
+  extract = g_list_append(extract, "Event.System.Provider._Name");
+  extract = g_list_append(extract, "Event.EventData");
+
+  LogParser *xml_parser = _construct_xml_parser((XMLParserTestOptions)
+  {
+    .extract = extract
+  });
+
+  LogMessage *msg = log_msg_new_empty();
+  log_msg_set_value(msg, LM_V_MESSAGE,
+                    "<Event xmlns='ns'>"
+                    "<System>"
+                    "<Provider Name='prov' Guid='guid'>provtext</Provider>"
+                    "<EventID Qualifiers='0'>4624</EventID>"
+                    "<Level>0</Level>"
+                    "</System>"
+                    "<EventData><Data Name='a'>A<Inner>I</Inner></Data></EventData>"
+                    "<RenderingInfo><Message>skipped</Message></RenderingInfo>"
+                    "</Event>", -1);
+
+  LogPathOptions path_options = LOG_PATH_OPTIONS_INIT;
+  cr_assert(log_parser_process_message(xml_parser, &msg, &path_options));
+
+  cr_assert_str_eq(log_msg_get_value_by_name(msg, ".xml.Event.System.EventID", NULL), "4624");
+  cr_assert_str_eq(log_msg_get_value_by_name(msg, ".xml.Event.System.EventID._Qualifiers", NULL), "0");
+  cr_assert_str_eq(log_msg_get_value_by_name(msg, ".xml.Event.System.Provider._Name", NULL), "prov");
+  cr_assert_str_eq(log_msg_get_value_by_name(msg, ".xml.Event.EventData.Data", NULL), "A");
+  cr_assert_str_eq(log_msg_get_value_by_name(msg, ".xml.Event.EventData.Data._Name", NULL), "a");
+  cr_assert_str_eq(log_msg_get_value_by_name(msg, ".xml.Event.EventData.Data.Inner", NULL), "I");
+
+  cr_assert_str_eq(log_msg_get_value_by_name(msg, ".xml.Event._xmlns", NULL), "");
+  cr_assert_str_eq(log_msg_get_value_by_name(msg, ".xml.Event.System.Provider", NULL), "");
+  cr_assert_str_eq(log_msg_get_value_by_name(msg, ".xml.Event.System.Provider._Guid", NULL), "");
+  cr_assert_str_eq(log_msg_get_value_by_name(msg, ".xml.Event.System.Level", NULL), "");
+  cr_assert_str_eq(log_msg_get_value_by_name(msg, ".xml.Event.RenderingInfo.Message", NULL), "");
+
+  log_pipe_deinit((LogPipe *)xml_parser);
+  log_pipe_unref((LogPipe *)xml_parser);
+  log_msg_unref(msg);
+
+  g_list_free(extract);
+}
+
 Test(xmlparser, test_strip_whitespaces)
 {
   LogParser *xml_parser = _construct_xml_parser((XMLParserTestOptions)
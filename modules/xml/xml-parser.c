@@ -34,6 +34,7 @@ static CfgLexerKeyword xml_keywords[] =
   { "prefix",       KW_PREFIX },
   { "drop_invalid", KW_DROP_INVALID },
   { "exclude_tags", KW_EXCLUDE_TAGS },
+  { "extract",      KW_EXTRACT },
   { "strip_whitespaces", KW_STRIP_WHITESPACES },
   { "create_lists", KW_CREATE_LISTS },
   { NULL }
@@ -0,0 +1,107 @@
+/*
+ * Copyright (c) 2024 One Identity LLC.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#include "profile.h"
+#include "syslog-ng.h"
+
+static gboolean profile_options_enable = FALSE;
+static gboolean profile_options_disable = FALSE;
+static gboolean profile_options_reset = FALSE;
+static gint profile_options_sample_rate = 1;
+static gint profile_options_frequency = 99;
+static gchar **profile_commands = NULL;
+
+GOptionEntry profile_options[] =
+{
+  { "enable", 'e', 0, G_OPTION_ARG_NONE, &profile_options_enable, "start profiling filters and parsers", NULL },
+  { "disable", 'd', 0, G_OPTION_ARG_NONE, &profile_options_disable, "stop profiling, keeping the results", NULL },
+  { "reset", 'r', 0, G_OPTION_ARG_NONE, &profile_options_reset, "reset the profiling results", NULL },
+  {
+    "sample-rate", 's', 0, G_OPTION_ARG_INT, &profile_options_sample_rate,
+    "measure the time of every N-th call only (default: 1)", "<N>"
+  },
+  {
+    "frequency", 'f', 0, G_OPTION_ARG_INT, &profile_options_frequency,
+    "sample the call stacks N times per second of CPU time with \"profile start\" (default: 99)", "<N>"
+  },
+  { G_OPTION_REMAINING, 0, 0, G_OPTION_ARG_STRING_ARRAY, &profile_commands, NULL, NULL },
+  { NULL, 0, 0, G_OPTION_ARG_NONE, NULL, NULL, NULL }
+};
+
+/* "profile start" and "profile stop" drive the stack sampler, the output
+ * of the latter is in the collapsed format, ready for flamegraph.pl */
+static gint
+_dispatch_stack_sampler_command(const gchar *command)
+{
+  if (g_str_equal(command, "stop"))
+    return dispatch_command("PROFILE STOP");
+
+  if (g_str_equal(command, "start"))
+    {
+      gchar *start_command = g_strdup_printf("PROFILE START %d", profile_options_frequency);
+      gint ret = dispatch_command(start_command);
+
+      g_free(start_command);
+      return ret;
+    }
+
+  fprintf(stderr, "Unknown profile command: %s, possible commands: start, stop\n", command);
+  return 1;
+}
+
+gint
+slng_profile(int argc, char *argv[], const gchar *mode, GOptionContext *ctx)
+{
+  if (profile_commands && profile_commands[0])
+    {
+      if (profile_options_enable || profile_options_disable || profile_options_reset)
+        {
+          fprintf(stderr, "--enable, --disable and --reset cannot be combined with start or stop\n");
+          return 1;
+        }
+      return _dispatch_stack_sampler_command(profile_commands[0]);
+    }
+
+  if (profile_options_enable + profile_options_disable + profile_options_reset > 1)
+    {
+      fprintf(stderr, "Only one of --enable, --disable and --reset can be used at a time\n");
+      return 1;
+    }
+
+  if (profile_options_reset)
+    return dispatch_command("PROFILE RESET");
+
+  if (profile_options_disable)
+    return dispatch_command("PROFILE DISABLE");
+
+  if (profile_options_enable)
+    {
+      gchar *command = g_strdup_printf("PROFILE ENABLE %d", profile_options_sample_rate);
+      gint ret = dispatch_command(command);
+
+      g_free(command);
+      return ret;
+    }
+
+  return dispatch_command("PROFILE");
+}
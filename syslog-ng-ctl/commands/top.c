@@ -0,0 +1,300 @@
+/*
+ * Copyright (c) 2024 One Identity LLC.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#include "top.h"
+#include "syslog-ng.h"
+
+#include <string.h>
+#include <unistd.h>
+
+static gint top_options_interval = 1;
+static gint top_options_iterations = 0;
+
+GOptionEntry top_options[] =
+{
+  {
+    "interval", 'i', 0, G_OPTION_ARG_INT, &top_options_interval,
+    "seconds between two samples (default: 1)", "<N>"
+  },
+  {
+    "iterations", 'n', 0, G_OPTION_ARG_INT, &top_options_iterations,
+    "exit after N updates, 0 means run until interrupted (default: 0)", "<N>"
+  },
+  { NULL, 0, 0, G_OPTION_ARG_NONE, NULL, NULL, NULL }
+};
+
+typedef enum
+{
+  TOP_INPUT_RATE,
+  TOP_OUTPUT_RATE,
+  TOP_DROPPED_RATE,
+  TOP_QUEUED,
+  TOP_MEMORY,
+  TOP_UNREACHABLE,
+  TOP_FLUSH_SUM,
+  TOP_FLUSH_COUNT,
+  TOP_FREE_WINDOW,
+  TOP_FULL_WINDOW,
+  TOP_CPU,
+  TOP_COLUMNS
+} TopColumn;
+
+/* the metrics of a pipe (or a thread), merged by their labels without result="..." */
+typedef struct _TopRow
+{
+  gdouble values[TOP_COLUMNS];
+  guint32 present;
+} TopRow;
+
+static gint
+_collect_sample(GString *reply, gpointer user_data)
+{
+  GHashTable *sample = (GHashTable *) user_data;
+
+  /* older servers answer with CSV, those lines are skipped */
+  if (!g_str_has_prefix(reply->str, "syslogng_"))
+    return 0;
+
+  g_strchomp(reply->str);
+  gchar *value = strrchr(reply->str, ' ');
+  if (!value)
+    return 0;
+
+  gdouble *parsed_value = g_new(gdouble, 1);
+  *parsed_value = g_ascii_strtod(value + 1, NULL);
+  g_hash_table_insert(sample, g_strndup(reply->str, value - reply->str), parsed_value);
+  return 0;
+}
+
+static gint
+_fetch_sample(GHashTable *sample)
+{
+  return slng_run_command("STATS TOP\n", _collect_sample, sample);
+}
+
+/* splits name{labels} into the name, and the labels without the result label */
+static gchar *
+_split_series(const gchar *series, gchar **result)
+{
+  gchar **labels = NULL;
+  GPtrArray *base_labels = g_ptr_array_new();
+  const gchar *open_brace = strchr(series, '{');
+
+  *result = NULL;
+  if (open_brace)
+    {
+      gchar *label_list = g_strndup(open_brace + 1, strlen(open_brace + 1) - 1);
+      labels = g_strsplit(label_list, ",", -1);
+      g_free(label_list);
+
+      for (gint i = 0; labels[i]; i++)
+        {
+          if (g_str_has_prefix(labels[i], "result="))
+            *result = g_strdup(labels[i] + strlen("result="));
+          else
+            g_ptr_array_add(base_labels, labels[i]);
+        }
+    }
+  g_ptr_array_add(base_labels, NULL);
+
+  gchar *key = g_strjoinv(",", (gchar **) base_labels->pdata);
+  g_ptr_array_free(base_labels, TRUE);
+  g_strfreev(labels);
+  return key;
+}
+
+static void
+_add_value(GHashTable *rows, const gchar *key, TopColumn column, gdouble value)
+{
+  TopRow *row = g_hash_table_lookup(rows, key);
+
+  if (!row)
+    {
+      row = g_new0(TopRow, 1);
+      g_hash_table_insert(rows, g_strdup(key), row);
+    }
+  row->values[column] += value;
+  row->present |= 1 << column;
+}
+
+static void
+_add_series(GHashTable *rows, const gchar *series, gdouble value, gdouble *previous, gdouble elapsed)
+{
+  gchar *result;
+  gchar *key = _split_series(series, &result);
+  gsize name_len = strcspn(series, "{");
+  gchar *name = g_strndup(series, name_len);
+  gdouble rate = previous ? (value - *previous) / elapsed : 0;
+  gdouble delta = previous ? value - *previous : 0;
+
+  if (strcmp(name, "syslogng_input_events_total") == 0)
+    _add_value(rows, key, TOP_INPUT_RATE, rate);
+  else if (strcmp(name, "syslogng_output_events_total") == 0)
+    {
+      if (g_strcmp0(result, "\"delivered\"") == 0)
+        _add_value(rows, key, TOP_OUTPUT_RATE, rate);
+      else if (g_strcmp0(result, "\"dropped\"") == 0)
+        _add_value(rows, key, TOP_DROPPED_RATE, rate);
+      else if (g_strcmp0(result, "\"queued\"") == 0)
+        _add_value(rows, key, TOP_QUEUED, value);
+    }
+  else if (strcmp(name, "syslogng_memory_usage_bytes") == 0)
+    _add_value(rows, key, TOP_MEMORY, value);
+  else if (strcmp(name, "syslogng_output_unreachable_workers") == 0)
+    _add_value(rows, key, TOP_UNREACHABLE, value);
+  else if (strcmp(name, "syslogng_output_flush_duration_seconds_sum") == 0)
+    _add_value(rows, key, TOP_FLUSH_SUM, delta);
+  else if (strcmp(name, "syslogng_output_flush_duration_seconds_count") == 0)
+    _add_value(rows, key, TOP_FLUSH_COUNT, delta);
+  else if (g_str_has_suffix(name, "_free_window"))
+    _add_value(rows, key, TOP_FREE_WINDOW, value);
+  else if (g_str_has_suffix(name, "_full_window"))
+    _add_value(rows, key, TOP_FULL_WINDOW, value);
+  else if (strcmp(name, "syslogng_worker_cpu_seconds") == 0)
+    _add_value(rows, key, TOP_CPU, rate * 100);
+
+  g_free(name);
+  g_free(result);
+  g_free(key);
+}
+
+static gboolean
+_is_present(TopRow *row, TopColumn column)
+{
+  return row->present & (1 << column);
+}
+
+static void
+_print_column(TopRow *row, TopColumn column, const gchar *format, gdouble value)
+{
+  if (_is_present(row, column))
+    printf(format, value);
+  else
+    printf(" %10s", "-");
+}
+
+static void
+_print_pipe(const gchar *key, TopRow *row)
+{
+  printf("%-50.50s", key);
+  _print_column(row, TOP_INPUT_RATE, " %10.0f", row->values[TOP_INPUT_RATE]);
+  _print_column(row, TOP_OUTPUT_RATE, " %10.0f", row->values[TOP_OUTPUT_RATE]);
+  _print_column(row, TOP_DROPPED_RATE, " %10.0f", row->values[TOP_DROPPED_RATE]);
+  _print_column(row, TOP_QUEUED, " %10.0f", row->values[TOP_QUEUED]);
+  _print_column(row, TOP_MEMORY, " %10.0f", row->values[TOP_MEMORY]);
+
+  if (_is_present(row, TOP_FLUSH_COUNT) && row->values[TOP_FLUSH_COUNT] > 0)
+    printf(" %10.3f", row->values[TOP_FLUSH_SUM] / row->values[TOP_FLUSH_COUNT] * 1000);
+  else
+    printf(" %10s", "-");
+
+  _print_column(row, TOP_UNREACHABLE, " %10.0f", row->values[TOP_UNREACHABLE]);
+
+  if (_is_present(row, TOP_FULL_WINDOW) && row->values[TOP_FULL_WINDOW] > 0)
+    printf(" %10.1f", (1 - row->values[TOP_FREE_WINDOW] / row->values[TOP_FULL_WINDOW]) * 100);
+  else
+    printf(" %10s", "-");
+  printf("\n");
+}
+
+static void
+_print_top(GHashTable *rows, gdouble elapsed)
+{
+  GList *keys = g_list_sort(g_hash_table_get_keys(rows), (GCompareFunc) strcmp);
+
+  if (isatty(STDOUT_FILENO))
+    printf("\033[H\033[2J");
+
+  printf("syslog-ng top, sampled over %.1fs\n\n", elapsed);
+  printf("%-50s %10s %10s %10s %10s %10s %10s %10s %10s\n",
+         "PIPE", "IN/s", "OUT/s", "DROP/s", "QUEUED", "MEM_BYTES", "FLUSH_MS", "UNREACH", "WINDOW%");
+  for (GList *l = keys; l; l = l->next)
+    {
+      TopRow *row = g_hash_table_lookup(rows, l->data);
+      if (!_is_present(row, TOP_CPU))
+        _print_pipe(l->data, row);
+    }
+
+  printf("\n%-50s %10s %10s\n", "THREAD", "CPU%", "IDLE%");
+  for (GList *l = keys; l; l = l->next)
+    {
+      TopRow *row = g_hash_table_lookup(rows, l->data);
+      if (_is_present(row, TOP_CPU))
+        printf("%-50.50s %10.1f %10.1f\n", (gchar *) l->data, row->values[TOP_CPU],
+               MAX(100 - row->values[TOP_CPU], 0));
+    }
+
+  fflush(stdout);
+  g_list_free(keys);
+}
+
+static void
+_report(GHashTable *previous, GHashTable *current, gdouble elapsed)
+{
+  GHashTable *rows = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
+  GHashTableIter iter;
+  gpointer series, value;
+
+  g_hash_table_iter_init(&iter, current);
+  while (g_hash_table_iter_next(&iter, &series, &value))
+    _add_series(rows, series, *(gdouble *) value, g_hash_table_lookup(previous, series), elapsed);
+
+  _print_top(rows, elapsed);
+  g_hash_table_destroy(rows);
+}
+
+/*
+ * The rates are computed from two consecutive samples of STATS TOP, so the
+ * first update is shown after the first interval.
+ */
+gint
+slng_top(int argc, char *argv[], const gchar *mode, GOptionContext *ctx)
+{
+  if (top_options_interval <= 0 || top_options_iterations < 0)
+    {
+      fprintf(stderr, "--interval must be positive and --iterations must not be negative\n");
+      return 1;
+    }
+
+  GHashTable *previous = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
+  gint64 previous_time = g_get_monotonic_time();
+  gint ret = _fetch_sample(previous);
+
+  for (gint i = 0; ret == 0 && (top_options_iterations == 0 || i < top_options_iterations); i++)
+    {
+      sleep(top_options_interval);
+
+      GHashTable *current = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
+      gint64 current_time = g_get_monotonic_time();
+      ret = _fetch_sample(current);
+      if (ret == 0)
+        _report(previous, current, (gdouble) (current_time - previous_time) / G_USEC_PER_SEC);
+
+      g_hash_table_destroy(previous);
+      previous = current;
+      previous_time = current_time;
+    }
+
+  g_hash_table_destroy(previous);
+  return ret;
+}
@@ -37,6 +37,8 @@
 #include "commands/query.h"
 #include "commands/license.h"
 #include "commands/healthcheck.h"
+#include "commands/profile.h"
+#include "commands/top.h"
 
 #include <stdio.h>
 #include <string.h>
@@ -75,6 +77,12 @@ slng_listfiles(int argc, char *argv[], const gchar *mode, GOptionContext *ctx)
   return dispatch_command("LISTFILES");
 }
 
+static gint
+slng_startup_timeline(int argc, char *argv[], const gchar *mode, GOptionContext *ctx)
+{
+  return dispatch_command("STARTUP_TIMELINE");
+}
+
 const gchar *
 get_mode(int *argc, char **argv[])
 {
@@ -125,7 +133,10 @@ static CommandDescriptor modes[] =
   { "config", config_options, "Print current config", slng_config, NULL },
   { "list-files", no_options, "Print files present in config", slng_listfiles, NULL },
   { "export-config-graph", no_options, "export configuration graph", slng_export_config_graph, NULL },
+  { "startup-timeline", no_options, "Show the time spent in the phases of the startup", slng_startup_timeline, NULL },
   { "healthcheck", healthcheck_options, "Health check", slng_healthcheck, NULL },
+  { "profile", profile_options, "Profile filters and parsers, or sample call stacks (start, stop)", slng_profile, NULL },
+  { "top", top_options, "Show the throughput, queues and thread utilization continuously", slng_top, NULL },
   { NULL, NULL },
 };
 
@@ -0,0 +1,437 @@
+/*
+ * Copyright (c) 2024 One Identity LLC.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#include "libtest/bench.h"
+
+#include "apphook.h"
+#include "cfg.h"
+#include "plugin.h"
+#include "logmsg/logmsg.h"
+#include "logmsg/logmsg-serialize.h"
+#include "logmsg/nvtable.h"
+#include "template/templates.h"
+#include "logqueue-fifo.h"
+#include "filter/filter-expr.h"
+#include "filter/filter-re.h"
+#include "scanner/csv-scanner/csv-scanner.h"
+#include "scanner/kv-scanner/kv-scanner.h"
+#include "serialize.h"
+#include "radix.h"
+
+#include <string.h>
+
+/*
+ * Microbenchmarks of the hot paths of message processing.  See
+ * libtest/bench.h for how the measurements are done, use --help for the
+ * available options.  Benchmarks are named <subsystem>/<operation>, names
+ * are stable so the results of different releases can be compared.
+ */
+
+#define NV_PAIRS 16
+
+static const gchar *sample_message =
+  "Accepted publickey for deploy from 198.51.100.22 port 52344 ssh2: RSA SHA256:4f1b9c2e12345";
+
+static const gchar *sample_csv =
+  "1,2024/01/15 10:23:45,012801012345,TRAFFIC,end,2561,2024/01/15 10:23:45,10.1.2.3,172.217.16.14,"
+  "203.0.113.10,172.217.16.14,allow-web,corp\\jdoe,,ssl,vsys1,trust,untrust,ethernet1/1,ethernet1/2,"
+  "log-forwarding,2024/01/15 10:23:45,123456,1,52344,443,41234,443,0x400053,tcp,allow,5832,1418,4414,"
+  "\"www.example.com/index.html?q=a,b,c\",(9999),shopping,informational,client-to-server";
+
+static const gchar *sample_kv =
+  "date=2024-01-15 time=10:23:45 devname=\"FGT60F-HQ\" devid=\"FGT60FTK20012345\" "
+  "eventtime=1705314225123456789 tz=\"+0100\" logid=\"0000000013\" type=\"traffic\" subtype=\"forward\" "
+  "level=\"notice\" vd=\"root\" srcip=10.1.2.3 srcport=52344 srcintf=\"internal\" srcintfrole=\"lan\" "
+  "dstip=172.217.16.14 dstport=443 dstintf=\"wan1\" dstintfrole=\"wan\" action=\"close\" policyid=12";
+
+static NVHandle nv_handles[NV_PAIRS];
+
+static LogMessage *
+_create_sample_message(void)
+{
+  LogMessage *msg = log_msg_new_empty();
+
+  log_msg_set_value(msg, LM_V_HOST, "bench-host.example.com", -1);
+  log_msg_set_value(msg, LM_V_PROGRAM, "sshd", -1);
+  log_msg_set_value(msg, LM_V_PID, "4242", -1);
+  log_msg_set_value(msg, LM_V_MESSAGE, sample_message, -1);
+  for (gint i = 0; i < NV_PAIRS; i++)
+    log_msg_set_value(msg, nv_handles[i], "value", -1);
+  return msg;
+}
+
+/* NVTable */
+
+static void
+bench_nvtable_set_get(gpointer user_data, guint64 iterations)
+{
+  for (guint64 i = 0; i < iterations; i++)
+    {
+      NVTable *nvtable = nv_table_new(LM_V_MAX, NV_PAIRS, 256);
+      gssize len;
+
+      for (gint j = 0; j < NV_PAIRS; j++)
+        {
+          const gchar *name = log_msg_get_value_name(nv_handles[j], NULL);
+          nv_table_add_value(nvtable, nv_handles[j], name, strlen(name), "value", 5, LM_VT_STRING, NULL);
+        }
+      for (gint j = 0; j < NV_PAIRS; j++)
+        g_assert(nv_table_get_value(nvtable, nv_handles[j], &len, NULL));
+      nv_table_unref(nvtable);
+    }
+}
+
+/* LogMessage */
+
+static void
+bench_logmsg_clone_cow(gpointer user_data, guint64 iterations)
+{
+  LogMessage *msg = (LogMessage *) user_data;
+  LogPathOptions path_options = LOG_PATH_OPTIONS_INIT;
+
+  for (guint64 i = 0; i < iterations; i++)
+    log_msg_unref(log_msg_clone_cow(msg, &path_options));
+}
+
+static void
+bench_logmsg_serialize(gpointer user_data, guint64 iterations)
+{
+  LogMessage *msg = (LogMessage *) user_data;
+  GString *stream = g_string_sized_new(4096);
+
+  for (guint64 i = 0; i < iterations; i++)
+    {
+      SerializeArchive *sa = serialize_string_archive_new(stream);
+
+      log_msg_serialize(msg, sa, 0);
+      serialize_archive_free(sa);
+      g_string_truncate(stream, 0);
+    }
+  g_string_free(stream, TRUE);
+}
+
+/* templates */
+
+typedef struct _TemplateBench
+{
+  LogTemplate *template;
+  LogMessage *msg;
+} TemplateBench;
+
+static gboolean
+_template_bench_init(TemplateBench *self, const gchar *template, LogMessage *msg)
+{
+  GError *error = NULL;
+
+  self->template = log_template_new(configuration, NULL);
+  self->msg = msg;
+  if (!log_template_compile(self->template, template, &error))
+    {
+      g_clear_error(&error);
+      log_template_unref(self->template);
+      return FALSE;
+    }
+  return TRUE;
+}
+
+static void
+bench_template_format(gpointer user_data, guint64 iterations)
+{
+  TemplateBench *self = (TemplateBench *) user_data;
+  GString *result = g_string_sized_new(1024);
+
+  for (guint64 i = 0; i < iterations; i++)
+    {
+      g_string_truncate(result, 0);
+      log_template_format(self->template, self->msg, &DEFAULT_TEMPLATE_EVAL_OPTIONS, result);
+    }
+  g_string_free(result, TRUE);
+}
+
+static void
+_run_template_bench(const gchar *name, const gchar *template, LogMessage *msg)
+{
+  TemplateBench bench;
+
+  if (!bench_is_enabled(name))
+    return;
+
+  if (!_template_bench_init(&bench, template, msg))
+    {
+      bench_skip(name, "template cannot be compiled");
+      return;
+    }
+  bench_run(name, bench_template_format, &bench);
+  log_template_unref(bench.template);
+}
+
+/* scanners */
+
+static void
+bench_csv_scanner(gpointer user_data, guint64 iterations)
+{
+  CSVScannerOptions *options = (CSVScannerOptions *) user_data;
+  CSVScanner scanner;
+
+  for (guint64 i = 0; i < iterations; i++)
+    {
+      csv_scanner_init(&scanner, options, sample_csv);
+      while (csv_scanner_scan_next(&scanner))
+        ;
+      g_assert(csv_scanner_is_scan_complete(&scanner));
+      csv_scanner_deinit(&scanner);
+    }
+}
+
+static void
+_run_csv_scanner_bench(void)
+{
+  CSVScannerOptions options;
+  CSVScanner scanner;
+  GList *columns = NULL;
+
+  memset(&options, 0, sizeof(options));
+  csv_scanner_options_set_delimiters(&options, ",");
+  csv_scanner_options_set_quote_pairs(&options, "\"\"");
+  csv_scanner_options_set_dialect(&options, CSV_SCANNER_ESCAPE_DOUBLE_CHAR);
+
+  /* without columns the scanner returns every field it finds */
+  csv_scanner_init(&scanner, &options, sample_csv);
+  while (csv_scanner_scan_next(&scanner))
+    columns = g_list_append(columns, g_strdup_printf("column%d", g_list_length(columns)));
+  csv_scanner_deinit(&scanner);
+  csv_scanner_options_set_columns(&options, columns);
+
+  bench_run("scanner/csv", bench_csv_scanner, &options);
+  csv_scanner_options_clean(&options);
+}
+
+static void
+bench_kv_scanner(gpointer user_data, guint64 iterations)
+{
+  KVScanner scanner;
+
+  for (guint64 i = 0; i < iterations; i++)
+    {
+      kv_scanner_init(&scanner, '=', NULL, FALSE);
+      kv_scanner_input(&scanner, sample_kv);
+      while (kv_scanner_scan_next(&scanner))
+        ;
+      kv_scanner_deinit(&scanner);
+    }
+}
+
+/* queues */
+
+#define QUEUE_BATCH 100
+
+static void
+bench_logqueue_fifo(gpointer user_data, guint64 iterations)
+{
+  LogMessage *msg = (LogMessage *) user_data;
+  LogQueue *q = log_queue_fifo_new(QUEUE_BATCH, NULL, STATS_LEVEL0, NULL, NULL);
+  LogPathOptions path_options = LOG_PATH_OPTIONS_INIT;
+
+  for (guint64 i = 0; i < iterations; i += QUEUE_BATCH)
+    {
+      gint batch = MIN(QUEUE_BATCH, iterations - i);
+
+      for (gint j = 0; j < batch; j++)
+        log_queue_push_tail(q, log_msg_ref(msg), &path_options);
+      for (gint j = 0; j < batch; j++)
+        log_msg_unref(log_queue_pop_head(q, &path_options));
+      log_queue_ack_backlog(q, batch);
+    }
+  log_queue_unref(q);
+}
+
+/* patterndb */
+
+typedef struct _RadixBench
+{
+  RNode *root;
+  const gchar *input;
+} RadixBench;
+
+static const gchar *radix_patterns[] =
+{
+  "Accepted publickey for @ESTRING:usracct.username: @from @IPvANY:usracct.device@ port @NUMBER:port@ ssh2@ANYSTRING@",
+  "Accepted password for @ESTRING:usracct.username: @from @IPvANY:usracct.device@ port @NUMBER:port@ ssh2",
+  "Failed password for invalid user @ESTRING:usracct.username: @from @IPvANY:usracct.device@ port @NUMBER@ ssh2",
+  "Failed password for @ESTRING:usracct.username: @from @IPvANY:usracct.device@ port @NUMBER@ ssh2",
+  "Connection closed by @IPvANY:usracct.device@ port @NUMBER@ [preauth]",
+  "Disconnected from user @ESTRING:usracct.username: @@IPvANY:usracct.device@ port @NUMBER@",
+  "pam_unix(sshd:session): session opened for user @ESTRING:usracct.username: @by @ANYSTRING@",
+  "pam_unix(sshd:session): session closed for user @ANYSTRING:usracct.username@",
+  "Received disconnect from @IPvANY:usracct.device@ port @NUMBER@:@NUMBER@: @ANYSTRING@",
+  "Invalid user @ESTRING:usracct.username: @from @IPvANY:usracct.device@ port @NUMBER@",
+  NULL
+};
+
+static gboolean
+_radix_bench_matches(RadixBench *self)
+{
+  GArray *matches = g_array_new(FALSE, TRUE, sizeof(RParserMatch));
+  g_array_set_size(matches, 1);
+
+  RNode *node = r_find_node(self->root, (gchar *) self->input, strlen(self->input), matches);
+
+  for (gint j = 0; j < matches->len; j++)
+    g_free(g_array_index(matches, RParserMatch, j).match);
+  g_array_free(matches, TRUE);
+  return node != NULL;
+}
+
+static void
+_radix_bench_init(RadixBench *self)
+{
+  self->root = r_new_node("", NULL);
+  for (gint i = 0; radix_patterns[i]; i++)
+    {
+      /* r_insert_node() modifies its input */
+      gchar *key = g_strdup(radix_patterns[i]);
+      r_insert_node(self->root, key, (gpointer) radix_patterns[i], NULL, NULL, NULL);
+      g_free(key);
+    }
+  self->input = sample_message;
+}
+
+static void
+bench_radix_lookup(gpointer user_data, guint64 iterations)
+{
+  RadixBench *self = (RadixBench *) user_data;
+
+  for (guint64 i = 0; i < iterations; i++)
+    _radix_bench_matches(self);
+}
+
+/* filters */
+
+typedef struct _FilterBench
+{
+  FilterExprNode *filter;
+  LogMessage *msg;
+} FilterBench;
+
+static gboolean
+_filter_bench_init(FilterBench *self, const gchar *regexp, LogMessage *msg)
+{
+  self->filter = filter_re_new(LM_V_MESSAGE);
+  self->msg = msg;
+
+  LogMatcherOptions *matcher_options = filter_re_get_matcher_options(self->filter);
+  log_matcher_options_defaults(matcher_options);
+  log_matcher_options_set_type(matcher_options, "pcre");
+
+  if (!filter_re_compile_pattern(self->filter, regexp, NULL) || !filter_expr_init(self->filter, configuration))
+    {
+      filter_expr_unref(self->filter);
+      return FALSE;
+    }
+  return TRUE;
+}
+
+static void
+bench_filter_re(gpointer user_data, guint64 iterations)
+{
+  FilterBench *self = (FilterBench *) user_data;
+
+  for (guint64 i = 0; i < iterations; i++)
+    filter_expr_eval(self->filter, self->msg);
+}
+
+static void
+_run_benchmarks(void)
+{
+  LogMessage *msg = _create_sample_message();
+
+  bench_run("nvtable/set-get", bench_nvtable_set_get, NULL);
+  bench_run("logmsg/clone-cow", bench_logmsg_clone_cow, msg);
+  bench_run("logmsg/serialize", bench_logmsg_serialize, msg);
+
+  _run_template_bench("template/eval", "$ISODATE $HOST $PROGRAM[$PID]: $MSG", msg);
+  if (bench_is_enabled("template/format-json") && !cfg_load_module(configuration, "json-plugin"))
+    bench_skip("template/format-json", "json-plugin module is not available");
+  else
+    _run_template_bench("template/format-json", "$(format-json --scope rfc5424 --scope nv-pairs)", msg);
+
+  if (bench_is_enabled("scanner/csv"))
+    _run_csv_scanner_bench();
+  bench_run("scanner/kv", bench_kv_scanner, NULL);
+
+  bench_run("logqueue/fifo-push-pop", bench_logqueue_fifo, msg);
+
+  if (bench_is_enabled("patterndb/radix-lookup"))
+    {
+      RadixBench radix;
+
+      _radix_bench_init(&radix);
+      if (_radix_bench_matches(&radix))
+        bench_run("patterndb/radix-lookup", bench_radix_lookup, &radix);
+      else
+        bench_skip("patterndb/radix-lookup", "sample message does not match any of the patterns");
+      r_free_node(radix.root, NULL);
+    }
+
+  if (bench_is_enabled("filter/re"))
+    {
+      FilterBench filter;
+
+      if (_filter_bench_init(&filter, "^Accepted (publickey|password) for \\S+ from", msg))
+        {
+          bench_run("filter/re", bench_filter_re, &filter);
+          filter_expr_unref(filter.filter);
+        }
+      else
+        {
+          bench_skip("filter/re", "regexp cannot be compiled");
+        }
+    }
+
+  log_msg_unref(msg);
+}
+
+int
+main(int argc, char *argv[])
+{
+  if (!bench_init(&argc, &argv))
+    return 1;
+
+  app_startup();
+  configuration = cfg_new_snippet();
+
+  for (gint i = 0; i < NV_PAIRS; i++)
+    {
+      gchar name[32];
+
+      g_snprintf(name, sizeof(name), "bench.value%d", i);
+      nv_handles[i] = log_msg_get_value_handle(name);
+    }
+
+  _run_benchmarks();
+
+  cfg_free(configuration);
+  configuration = NULL;
+  app_shutdown();
+
+  return bench_finish();
+}
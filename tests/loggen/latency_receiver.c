@@ -0,0 +1,520 @@
+/*
+ * Copyright (c) 2024 One Identity LLC.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+
+#include "latency_receiver.h"
+#include "loggen_helper.h"
+
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <netdb.h>
+
+/*
+ * Latencies are collected in a log-linear histogram: values below 16
+ * microseconds have their own buckets, larger ones are split into 16
+ * buckets per power of two, which keeps the error of the reported
+ * percentiles below 6.25% using a fixed amount of memory.
+ */
+#define LATENCY_SUB_BUCKET_BITS 4
+#define LATENCY_SUB_BUCKETS (1 << LATENCY_SUB_BUCKET_BITS)
+#define LATENCY_BUCKETS ((64 - LATENCY_SUB_BUCKET_BITS + 1) * LATENCY_SUB_BUCKETS)
+
+#define RECEIVER_BUFFER_SIZE 65536
+#define RECEIVER_MAX_CONNECTIONS 1024
+#define RECEIVER_POLL_TIMEOUT_MSEC 500
+
+typedef struct _LatencyStats
+{
+  guint64 histogram[LATENCY_BUCKETS];
+  guint64 received;
+  guint64 unrecognized;
+  guint64 without_stamp;
+  guint64 min_usec;
+  guint64 max_usec;
+  guint64 sum_usec;
+  gint64 lost;
+  guint64 reordered;
+  /* (runid, thread id) -> next expected sequence number */
+  GHashTable *streams;
+} LatencyStats;
+
+typedef struct _ReceiverConnection
+{
+  int fd;
+  gboolean framed;
+  GString *buffer;
+} ReceiverConnection;
+
+static volatile sig_atomic_t receiver_stop_requested;
+
+static gint
+_latency_bucket(guint64 value)
+{
+  if (value < LATENCY_SUB_BUCKETS)
+    return value;
+
+  gint exponent = 63 - __builtin_clzll(value);
+  return (exponent - LATENCY_SUB_BUCKET_BITS + 1) * LATENCY_SUB_BUCKETS
+         + ((value >> (exponent - LATENCY_SUB_BUCKET_BITS)) & (LATENCY_SUB_BUCKETS - 1));
+}
+
+/* lower bound of the values in the bucket */
+static guint64
+_latency_bucket_value(gint bucket)
+{
+  if (bucket < LATENCY_SUB_BUCKETS)
+    return bucket;
+
+  gint exponent = bucket / LATENCY_SUB_BUCKETS + LATENCY_SUB_BUCKET_BITS - 1;
+  guint64 sub_bucket = bucket % LATENCY_SUB_BUCKETS;
+  return (LATENCY_SUB_BUCKETS + sub_bucket) << (exponent - LATENCY_SUB_BUCKET_BITS);
+}
+
+static guint64
+_latency_percentile(LatencyStats *stats, gdouble percentile)
+{
+  guint64 measured = stats->received - stats->without_stamp;
+  guint64 rank = (guint64) (measured * percentile / 100.0 + 0.5);
+  guint64 seen = 0;
+
+  if (rank == 0)
+    rank = 1;
+
+  for (gint i = 0; i < LATENCY_BUCKETS; i++)
+    {
+      seen += stats->histogram[i];
+      if (seen >= rank)
+        return MIN(MAX(_latency_bucket_value(i), stats->min_usec), stats->max_usec);
+    }
+  return stats->max_usec;
+}
+
+static gint64
+_monotonic_nsec(void)
+{
+  struct timespec now;
+
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (gint64) now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+static gboolean
+_parse_field(const gchar *line, gsize line_len, const gchar *name, guint64 *value)
+{
+  const gchar *field = g_strstr_len(line, line_len, name);
+
+  if (!field)
+    return FALSE;
+
+  const gchar *p = field + strlen(name);
+  const gchar *end = line + line_len;
+  *value = 0;
+
+  if (p >= end || !g_ascii_isdigit(*p))
+    return FALSE;
+
+  while (p < end && g_ascii_isdigit(*p))
+    *value = *value * 10 + (*p++ - '0');
+  return TRUE;
+}
+
+static void
+_track_sequence(LatencyStats *stats, guint64 run_id, guint64 thread_id, guint64 seq)
+{
+  guint64 key = (run_id << 16) | (thread_id & 0xFFFF);
+  guint64 *next_seq = g_hash_table_lookup(stats->streams, &key);
+
+  if (!next_seq)
+    {
+      gint64 *new_key = g_new(gint64, 1);
+
+      *new_key = key;
+      next_seq = g_new0(guint64, 1);
+      g_hash_table_insert(stats->streams, new_key, next_seq);
+    }
+
+  if (seq >= *next_seq)
+    {
+      /* anything skipped is missing until it arrives late */
+      stats->lost += seq - *next_seq;
+      *next_seq = seq + 1;
+    }
+  else
+    {
+      stats->reordered++;
+      stats->lost--;
+    }
+}
+
+static void
+_process_message(LatencyStats *stats, const gchar *line, gsize line_len, gint64 received_at)
+{
+  guint64 seq, thread_id, run_id, stamp;
+
+  if (!_parse_field(line, line_len, "seq: ", &seq) ||
+      !_parse_field(line, line_len, "thread: ", &thread_id) ||
+      !_parse_field(line, line_len, "runid: ", &run_id))
+    {
+      stats->unrecognized++;
+      return;
+    }
+
+  stats->received++;
+  _track_sequence(stats, run_id, thread_id, seq);
+
+  /* without --latency the stamp holds a date, which does not parse as a full number */
+  if (!_parse_field(line, line_len, "stamp: ", &stamp) || stamp < 1000000000)
+    {
+      stats->without_stamp++;
+      return;
+    }
+
+  guint64 latency_usec = received_at > (gint64) stamp ? (received_at - stamp) / 1000 : 0;
+
+  stats->histogram[_latency_bucket(latency_usec)]++;
+  stats->sum_usec += latency_usec;
+  if (stats->received - stats->without_stamp == 1 || latency_usec < stats->min_usec)
+    stats->min_usec = latency_usec;
+  if (latency_usec > stats->max_usec)
+    stats->max_usec = latency_usec;
+}
+
+/* process complete messages in the buffer and keep the remaining partial one */
+static void
+_process_stream_buffer(LatencyStats *stats, ReceiverConnection *conn, gint64 received_at)
+{
+  GString *buffer = conn->buffer;
+  gsize pos = 0;
+
+  while (pos < buffer->len)
+    {
+      const gchar *start = buffer->str + pos;
+      gsize left = buffer->len - pos;
+
+      if (conn->framed)
+        {
+          /* octet counting: "<length> <message>" */
+          gsize frame_len = 0, digits = 0;
+
+          while (digits < left && g_ascii_isdigit(start[digits]))
+            frame_len = frame_len * 10 + (start[digits++] - '0');
+          if (digits == left)
+            break;
+          if (digits == 0 || start[digits] != ' ')
+            {
+              ERROR("invalid frame header, falling back to newline separated messages\n");
+              conn->framed = FALSE;
+              continue;
+            }
+          if (left < digits + 1 + frame_len)
+            break;
+          _process_message(stats, start + digits + 1, frame_len, received_at);
+          pos += digits + 1 + frame_len;
+        }
+      else
+        {
+          const gchar *eol = memchr(start, '\n', left);
+
+          if (!eol)
+            break;
+          if (eol > start)
+            _process_message(stats, start, eol - start, received_at);
+          pos += eol - start + 1;
+        }
+    }
+
+  g_string_erase(buffer, 0, pos);
+  if (buffer->len > MAX_MESSAGE_LENGTH * 4)
+    {
+      ERROR("message too long, dropping %" G_GSIZE_FORMAT " bytes\n", buffer->len);
+      g_string_truncate(buffer, 0);
+    }
+}
+
+/* returns FALSE if the connection was closed */
+static gboolean
+_read_stream(LatencyStats *stats, ReceiverConnection *conn)
+{
+  gchar buf[RECEIVER_BUFFER_SIZE];
+  ssize_t len = recv(conn->fd, buf, sizeof(buf), 0);
+
+  if (len < 0 && (errno == EINTR || errno == EAGAIN))
+    return TRUE;
+  if (len <= 0)
+    return FALSE;
+
+  if (conn->buffer->len == 0 && !conn->framed)
+    conn->framed = g_ascii_isdigit(buf[0]);
+
+  g_string_append_len(conn->buffer, buf, len);
+  _process_stream_buffer(stats, conn, _monotonic_nsec());
+  return TRUE;
+}
+
+static void
+_read_datagram(LatencyStats *stats, int fd)
+{
+  gchar buf[RECEIVER_BUFFER_SIZE];
+  ssize_t len = recv(fd, buf, sizeof(buf), 0);
+
+  if (len <= 0)
+    return;
+
+  gint64 received_at = _monotonic_nsec();
+  while (len > 0 && (buf[len - 1] == '\n' || buf[len - 1] == 0))
+    len--;
+  _process_message(stats, buf, len, received_at);
+}
+
+static int
+_open_listener(PluginOption *option, gboolean dgram)
+{
+  struct addrinfo hints = { 0 };
+  struct addrinfo *res;
+
+  hints.ai_family = option->use_ipv6 ? AF_INET6 : AF_INET;
+  hints.ai_socktype = dgram ? SOCK_DGRAM : SOCK_STREAM;
+  hints.ai_flags = AI_PASSIVE;
+
+  int rc = getaddrinfo(option->target, option->port, &hints, &res);
+  if (rc != 0)
+    {
+      ERROR("name lookup failed (%s:%s): %s\n", option->target ? : "*", option->port, gai_strerror(rc));
+      return -1;
+    }
+
+  int fd = socket(res->ai_family, res->ai_socktype, 0);
+  if (fd < 0)
+    {
+      ERROR("error creating socket: %s\n", g_strerror(errno));
+      freeaddrinfo(res);
+      return -1;
+    }
+
+  int on = 1;
+  setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+
+  if (bind(fd, res->ai_addr, res->ai_addrlen) < 0 || (!dgram && listen(fd, SOMAXCONN) < 0))
+    {
+      ERROR("error binding to %s:%s: %s\n", option->target ? : "*", option->port, g_strerror(errno));
+      freeaddrinfo(res);
+      close(fd);
+      return -1;
+    }
+
+  freeaddrinfo(res);
+  return fd;
+}
+
+static void
+_print_progress(LatencyStats *stats, guint64 *last_count, gint64 *last_print)
+{
+  gint64 now = _monotonic_nsec();
+  gint64 elapsed = now - *last_print;
+
+  if (elapsed < 1000000000)
+    return;
+
+  if (stats->received > *last_count)
+    {
+      fprintf(stderr, "received=%" G_GUINT64_FORMAT ", rate = %.2lf msg/sec", stats->received,
+              (double) (stats->received - *last_count) * 1e9 / elapsed);
+      if (stats->received > stats->without_stamp)
+        fprintf(stderr, ", latency p50=%" G_GUINT64_FORMAT " p99=%" G_GUINT64_FORMAT " usec",
+                _latency_percentile(stats, 50), _latency_percentile(stats, 99));
+      fprintf(stderr, "\n");
+    }
+  *last_count = stats->received;
+  *last_print = now;
+}
+
+static void
+_print_report(LatencyStats *stats, gdouble runtime_sec)
+{
+  guint64 measured = stats->received - stats->without_stamp;
+
+  fprintf(stderr, "received=%" G_GUINT64_FORMAT ", lost=%" G_GINT64_FORMAT ", reordered=%" G_GUINT64_FORMAT
+          ", unrecognized=%" G_GUINT64_FORMAT ", streams=%u, time=%g, average rate = %.2lf msg/sec\n",
+          stats->received, MAX(stats->lost, 0), stats->reordered, stats->unrecognized,
+          g_hash_table_size(stats->streams), runtime_sec, runtime_sec > 0 ? stats->received / runtime_sec : 0);
+
+  if (measured == 0)
+    {
+      fprintf(stderr, "no latency data, start the sender with --latency\n");
+      return;
+    }
+
+  fprintf(stderr, "latency (usec): min=%" G_GUINT64_FORMAT ", avg=%" G_GUINT64_FORMAT ", p50=%" G_GUINT64_FORMAT
+          ", p90=%" G_GUINT64_FORMAT ", p99=%" G_GUINT64_FORMAT ", p99.9=%" G_GUINT64_FORMAT ", max=%" G_GUINT64_FORMAT
+          "\n",
+          stats->min_usec, stats->sum_usec / measured, _latency_percentile(stats, 50), _latency_percentile(stats, 90),
+          _latency_percentile(stats, 99), _latency_percentile(stats, 99.9), stats->max_usec);
+}
+
+static void
+_stop_handler(int signum)
+{
+  receiver_stop_requested = 1;
+}
+
+static void
+_setup_stop_signals(void)
+{
+  struct sigaction sa;
+
+  sa.sa_handler = _stop_handler;
+  sigemptyset(&sa.sa_mask);
+  /* no SA_RESTART, poll() should return upon a signal */
+  sa.sa_flags = 0;
+  sigaction(SIGINT, &sa, NULL);
+  sigaction(SIGTERM, &sa, NULL);
+}
+
+static gboolean
+_should_stop(PluginOption *option, LatencyStats *stats, gint64 first_message_at)
+{
+  if (receiver_stop_requested)
+    return TRUE;
+  if (option->number_of_messages > 0 && stats->received >= option->number_of_messages)
+    return TRUE;
+  /* the interval is measured from the first message, so the receiver can be started before the sender */
+  if (!option->permanent && first_message_at &&
+      _monotonic_nsec() - first_message_at >= (gint64) option->interval * 1000000000)
+    return TRUE;
+  return FALSE;
+}
+
+static void
+_close_connection(GPtrArray *connections, guint index)
+{
+  ReceiverConnection *conn = g_ptr_array_index(connections, index);
+
+  close(conn->fd);
+  g_string_free(conn->buffer, TRUE);
+  g_free(conn);
+  g_ptr_array_remove_index_fast(connections, index);
+}
+
+int
+run_latency_receiver(PluginOption *option, gboolean dgram, gboolean quiet)
+{
+  if (!option->port)
+    {
+      ERROR("a port is needed to listen on, use: loggen --listen [address] port\n");
+      return 1;
+    }
+
+  int listen_fd = _open_listener(option, dgram);
+  if (listen_fd < 0)
+    return 1;
+
+  LatencyStats *stats = g_new0(LatencyStats, 1);
+  stats->streams = g_hash_table_new_full(g_int64_hash, g_int64_equal, g_free, g_free);
+
+  GPtrArray *connections = g_ptr_array_new();
+  struct pollfd *pfds = g_new(struct pollfd, RECEIVER_MAX_CONNECTIONS + 1);
+  gint64 first_message_at = 0, last_print = _monotonic_nsec();
+  guint64 last_count = 0;
+
+  _setup_stop_signals();
+  fprintf(stderr, "listening on %s:%s (%s)\n", option->target ? : "*", option->port, dgram ? "udp" : "tcp");
+
+  while (!_should_stop(option, stats, first_message_at))
+    {
+      pfds[0].fd = listen_fd;
+      pfds[0].events = POLLIN;
+      for (guint i = 0; i < connections->len; i++)
+        {
+          pfds[i + 1].fd = ((ReceiverConnection *) g_ptr_array_index(connections, i))->fd;
+          pfds[i + 1].events = POLLIN;
+        }
+
+      int rc = poll(pfds, connections->len + 1, RECEIVER_POLL_TIMEOUT_MSEC);
+      if (rc < 0 && errno != EINTR)
+        {
+          ERROR("poll() failed: %s\n", g_strerror(errno));
+          break;
+        }
+
+      if (rc > 0)
+        {
+          /* iterate backwards, as closing a connection moves the last one into its place */
+          for (gint i = connections->len - 1; i >= 0; i--)
+            {
+              if (pfds[i + 1].revents && !_read_stream(stats, g_ptr_array_index(connections, i)))
+                _close_connection(connections, i);
+            }
+
+          if (pfds[0].revents & POLLIN)
+            {
+              if (dgram)
+                {
+                  _read_datagram(stats, listen_fd);
+                }
+              else
+                {
+                  int fd = accept(listen_fd, NULL, NULL);
+
+                  if (fd >= 0 && connections->len >= RECEIVER_MAX_CONNECTIONS)
+                    {
+                      ERROR("too many connections, rejecting a new one\n");
+                      close(fd);
+                    }
+                  else if (fd >= 0)
+                    {
+                      ReceiverConnection *conn = g_new0(ReceiverConnection, 1);
+
+                      conn->fd = fd;
+                      conn->buffer = g_string_sized_new(RECEIVER_BUFFER_SIZE);
+                      g_ptr_array_add(connections, conn);
+                      DEBUG("new connection accepted, fd=%d\n", fd);
+                    }
+                }
+            }
+        }
+
+      if (!first_message_at && stats->received > 0)
+        first_message_at = _monotonic_nsec();
+
+      if (!quiet)
+        _print_progress(stats, &last_count, &last_print);
+    }
+
+  _print_report(stats, first_message_at ? (_monotonic_nsec() - first_message_at) / 1e9 : 0);
+
+  while (connections->len > 0)
+    _close_connection(connections, connections->len - 1);
+  g_ptr_array_free(connections, TRUE);
+  g_free(pfds);
+  close(listen_fd);
+  g_hash_table_destroy(stats->streams);
+  g_free(stats);
+  return 0;
+}
@@ -0,0 +1,42 @@
+/*
+ * Copyright (c) 2024 One Identity LLC.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+
+#ifndef LATENCY_RECEIVER_H_INCLUDED
+#define LATENCY_RECEIVER_H_INCLUDED
+
+#include "loggen_plugin.h"
+
+/*
+ * Receiving side of loggen's latency mode: accepts the messages sent by
+ * "loggen --latency" (possibly through a chain of syslog-ng relays) and
+ * reports the end-to-end latency percentiles, message loss and
+ * reordering based on the sequence number, thread id and monotonic send
+ * timestamp embedded in each message.
+ *
+ * As CLOCK_MONOTONIC is used, the sender and the receiver need to run on
+ * the same host.
+ */
+int run_latency_receiver(PluginOption *option, gboolean dgram, gboolean quiet);
+
+#endif
@@ -27,7 +27,9 @@
 #include "loggen_helper.h"
 #include "file_reader.h"
 #include "logline_generator.h"
+#include "latency_receiver.h"
 #include "reloc.h"
+#include "atomic-gssize.h"
 
 #include <stdio.h>
 #include <sys/time.h>
@@ -64,21 +66,41 @@ static PluginOption global_plugin_option =
   .proxy_dst_ip = NULL,
   .proxy_src_port = NULL,
   .proxy_dst_port = NULL,
+  .pin_threads = 0,
 };
 
+/* pre-generated messages of a single sender thread, replayed in a loop */
+typedef struct _MessagePool
+{
+  GString *messages;
+  GArray *offsets;
+  guint next;
+  gboolean filled;
+} MessagePool;
+
+/* updated by the owning sender thread only, padded to avoid false sharing
+ * between the threads */
+typedef struct _ThreadStat
+{
+  atomic_gssize count;
+  atomic_gssize bytes;
+  gchar padding[64 - 2 * sizeof(atomic_gssize)];
+} ThreadStat;
+
 static char *sdata_value = NULL;
 static int noframing = 0;
 static int syslog_proto = 0;
 static int quiet = 0;
 static int csv = 0;
 static int debug = 0;
-static unsigned long sent_messages_num = 0;
+static int latency = 0;
+static int listen_mode = 0;
+static int listen_dgram = 0;
+static int pool_size = 0;
 static int read_from_file = 0;
-static gint64 raw_message_length = 0;
-static gint64 *thread_stat_count = NULL;
+static ThreadStat *thread_stats = NULL;
 static gint64 *thread_stat_count_last = NULL;
-
-static GMutex message_counter_lock;
+static MessagePool *message_pools = NULL;
 
 static gboolean
 _process_proxied_arg(const gchar *option_name,
@@ -113,9 +135,88 @@ static GOptionEntry loggen_options[] =
   { "quiet", 'Q', 0, G_OPTION_ARG_NONE, &quiet, "Don't print the msg/sec data", NULL },
   { "debug", 0, 0, G_OPTION_ARG_NONE, &debug, "Enable loggen debug messages", NULL },
   { "reconnect", 0, 0, G_OPTION_ARG_NONE, &global_plugin_option.reconnect, "Attempt to reconnect when destination connections are lost", NULL},
+  { "latency", 0, 0, G_OPTION_ARG_NONE, &latency, "Embed a monotonic send timestamp in the messages, to be measured by loggen --listen", NULL },
+  { "listen", 0, 0, G_OPTION_ARG_NONE, &listen_mode, "Receive messages on TCP and report latency, loss and reordering instead of sending", NULL },
+  { "listen-dgram", 0, 0, G_OPTION_ARG_NONE, &listen_dgram, "Receive messages on UDP in --listen mode", NULL },
+  { "pool-size", 0, 0, G_OPTION_ARG_INT, &pool_size, "Pre-generate this number of messages per connection and send them in a loop", "<number>" },
+  { "pin-threads", 0, 0, G_OPTION_ARG_NONE, &global_plugin_option.pin_threads, "Pin the sender threads to separate CPUs", NULL },
   { NULL }
 };
 
+static int
+_generate_new_message(char *buffer, int buffer_size, int thread_index, unsigned long seq)
+{
+  if (read_from_file)
+    return read_next_message_from_file(buffer, buffer_size, syslog_proto, thread_index);
+
+  return generate_log_line(buffer, buffer_size, syslog_proto, thread_index, seq);
+}
+
+/* the pool is filled by the sender thread itself on first use, so that its
+ * memory is allocated local to the CPU the thread runs on */
+static void
+_fill_message_pool(MessagePool *pool, int thread_index)
+{
+  char *buffer = g_malloc0(MAX_MESSAGE_LENGTH + 1);
+
+  pool->messages = g_string_sized_new((gsize) pool_size * global_plugin_option.message_length);
+  pool->offsets = g_array_sized_new(FALSE, FALSE, sizeof(gsize), pool_size + 1);
+
+  for (int i = 0; i < pool_size; i++)
+    {
+      int str_len = _generate_new_message(buffer, MAX_MESSAGE_LENGTH, thread_index, i);
+      if (str_len < 0)
+        break;
+
+      g_array_append_val(pool->offsets, pool->messages->len);
+      g_string_append_len(pool->messages, buffer, str_len);
+    }
+  g_array_append_val(pool->offsets, pool->messages->len);
+
+  DEBUG("(thread %d) message pool filled with %u messages\n", thread_index, pool->offsets->len - 1);
+  pool->filled = TRUE;
+  g_free(buffer);
+}
+
+static int
+_next_message_from_pool(char *buffer, int buffer_size, int thread_index)
+{
+  MessagePool *pool = &message_pools[thread_index];
+
+  if (!pool->filled)
+    _fill_message_pool(pool, thread_index);
+
+  guint pooled_messages = pool->offsets->len - 1;
+  if (pooled_messages == 0)
+    return -1;
+
+  gsize start = g_array_index(pool->offsets, gsize, pool->next);
+  gsize end = g_array_index(pool->offsets, gsize, pool->next + 1);
+  int str_len = MIN(end - start, (gsize) buffer_size);
+
+  memcpy(buffer, pool->messages->str + start, str_len);
+  pool->next = (pool->next + 1) % pooled_messages;
+  return str_len;
+}
+
+static void
+free_message_pools(void)
+{
+  if (!message_pools)
+    return;
+
+  for (int i = 0; i < global_plugin_option.active_connections; i++)
+    {
+      if (!message_pools[i].filled)
+        continue;
+
+      g_string_free(message_pools[i].messages, TRUE);
+      g_array_free(message_pools[i].offsets, TRUE);
+    }
+  g_free(message_pools);
+  message_pools = NULL;
+}
+
 /* This is the callback function called by plugins when
  * they need a new log line */
 int
@@ -134,22 +235,17 @@ generate_message(char *buffer, int buffer_size, ThreadData *thread_context, unsi
       return str_len;
     }
 
-  if (read_from_file)
-    str_len = read_next_message_from_file(buffer, buffer_size, syslog_proto, thread_context->index);
+  if (message_pools)
+    str_len = _next_message_from_pool(buffer, buffer_size, thread_context->index);
   else
-    str_len = generate_log_line(buffer, buffer_size, syslog_proto, thread_context->index, seq);
+    str_len = _generate_new_message(buffer, buffer_size, thread_context->index, seq);
 
   if (str_len < 0)
     return -1;
 
-  g_mutex_lock(&message_counter_lock);
-  sent_messages_num++;
-  raw_message_length += str_len;
-
-  if (thread_stat_count && csv)
-    thread_stat_count[thread_context->index]+=1;
-
-  g_mutex_unlock(&message_counter_lock);
+  ThreadStat *stat = &thread_stats[thread_context->index];
+  atomic_gssize_inc(&stat->count);
+  atomic_gssize_add(&stat->bytes, str_len);
 
   return str_len;
 }
@@ -325,14 +421,35 @@ init_logline_generator(GPtrArray *plugin_array)
     syslog_proto,
     framing,
     global_plugin_option.message_length,
-    sdata_value);
+    sdata_value,
+    latency);
+}
+
+static gint64
+get_sent_messages_count(void)
+{
+  gint64 count = 0;
+
+  for (int j = 0; j < global_plugin_option.active_connections; j++)
+    count += atomic_gssize_get(&thread_stats[j].count);
+  return count;
+}
+
+static gint64
+get_sent_bytes(void)
+{
+  gint64 bytes = 0;
+
+  for (int j = 0; j < global_plugin_option.active_connections; j++)
+    bytes += atomic_gssize_get(&thread_stats[j].bytes);
+  return bytes;
 }
 
 static void
 init_csv_statistics(void)
 {
-  /* message counter for csv output */
-  thread_stat_count = (gint64 *) g_malloc0(global_plugin_option.active_connections * sizeof(gint64));
+  /* per thread message counters, the csv output is printed from these too */
+  thread_stats = g_new0(ThreadStat, global_plugin_option.active_connections);
   thread_stat_count_last = (gint64 *) g_malloc0(global_plugin_option.active_connections * sizeof(gint64));
   if (csv)
     {
@@ -406,9 +523,7 @@ print_statistic(struct timeval *start_time)
       guint64 diff_usec = time_val_diff_in_usec(&now, &last_ts_format);
       if (diff_usec > 0)
         {
-          g_mutex_lock(&message_counter_lock);
-          count = sent_messages_num;
-          g_mutex_unlock(&message_counter_lock);
+          count = get_sent_messages_count();
 
           if (count > last_count && last_count > 0)
             {
@@ -420,7 +535,7 @@ print_statistic(struct timeval *start_time)
         }
     }
 
-  if (thread_stat_count && thread_stat_count_last && csv)
+  if (thread_stats && thread_stat_count_last && csv)
     {
       struct timeval diff_tv;
       time_val_diff_in_timeval(&diff_tv, &now, start_time);
@@ -428,11 +543,9 @@ print_statistic(struct timeval *start_time)
 
       for (int j=0; j < global_plugin_option.active_connections; j++)
         {
-          g_mutex_lock(&message_counter_lock);
-          double msg_count_diff = ((double) (thread_stat_count[j]-thread_stat_count_last[j]) * USEC_PER_SEC) / diff_usec;
-          thread_stat_count_last[j] = thread_stat_count[j];
-          count = thread_stat_count[j];
-          g_mutex_unlock(&message_counter_lock);
+          count = atomic_gssize_get(&thread_stats[j].count);
+          double msg_count_diff = ((double) (count - thread_stat_count_last[j]) * USEC_PER_SEC) / diff_usec;
+          thread_stat_count_last[j] = count;
 
           fprintf(stderr, "%d;%lu.%06lu;%.2lf;%"G_GINT64_FORMAT"\n",
                   j,
@@ -469,7 +582,8 @@ void wait_all_plugin_to_finish(GPtrArray *plugin_array)
 
   /* print final statistic: */
   print_statistic(&start_time);
-  unsigned long count = sent_messages_num;
+  unsigned long count = get_sent_messages_count();
+  gint64 raw_message_length = get_sent_bytes();
   struct timeval now;
   gettimeofday(&now, NULL);
   double total_runtime_sec = time_val_diff_in_sec(&now, &start_time);
@@ -573,6 +687,17 @@ main(int argc, char *argv[])
 
   DEBUG("target=%s port=%s\n", global_plugin_option.target, global_plugin_option.port);
 
+  if (listen_mode || listen_dgram)
+    {
+      int rc = run_latency_receiver(&global_plugin_option, listen_dgram, quiet);
+
+      g_free((gpointer)global_plugin_option.target);
+      g_free((gpointer)global_plugin_option.port);
+      g_option_context_free(ctx);
+      g_ptr_array_free(plugin_array, TRUE);
+      return rc;
+    }
+
   if (global_plugin_option.message_length > MAX_MESSAGE_LENGTH)
     {
       ERROR("warning: defined message length (%d) is too big. truncated to (%d)\n", global_plugin_option.message_length,
@@ -587,7 +712,20 @@ main(int argc, char *argv[])
       return 1;
     }
 
-  g_mutex_init(&message_counter_lock);
+  if (read_from_file && latency)
+    {
+      ERROR("--latency needs generated messages, it cannot be used with --read-file\n");
+      return 1;
+    }
+
+  if (pool_size < 0 || (pool_size && latency))
+    {
+      ERROR("--pool-size must be a positive number and it cannot be used together with --latency\n");
+      return 1;
+    }
+
+  if (pool_size)
+    message_pools = g_new0(MessagePool, global_plugin_option.active_connections);
 
   init_logline_generator(plugin_array);
   init_csv_statistics();
@@ -599,13 +737,13 @@ main(int argc, char *argv[])
     }
 
   close_file_reader(global_plugin_option.active_connections);
+  free_message_pools();
 
-  g_mutex_clear(&message_counter_lock);
   g_free((gpointer)global_plugin_option.target);
   g_free((gpointer)global_plugin_option.port);
   g_option_context_free(ctx);
   g_ptr_array_free(plugin_array, TRUE);
   g_free(thread_stat_count_last);
-  g_free(thread_stat_count);
+  g_free(thread_stats);
   return 0;
 }
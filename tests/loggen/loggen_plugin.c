@@ -31,6 +31,11 @@
 #include "loggen_plugin.h"
 #include "loggen_helper.h"
 
+#if SYSLOG_NG_HAVE_PTHREAD_SETAFFINITY_NP
+#include <pthread.h>
+#include <sched.h>
+#endif
+
 gboolean
 thread_check_exit_criteria(ThreadData *thread_context)
 {
@@ -55,37 +60,129 @@ thread_check_exit_criteria(ThreadData *thread_context)
   return FALSE;
 }
 
-gboolean
-thread_check_time_bucket(ThreadData *thread_context)
+/* Refill the token bucket according to the elapsed time.  The last check
+ * timestamp is only advanced by the time the new tokens correspond to, so
+ * the fractions are not lost, which would make the actual rate fall behind
+ * the requested one when the bucket is checked often (high rates, or short
+ * sleeps). */
+static void
+_refill_time_bucket(ThreadData *thread_context)
 {
   struct timeval now;
   gettimeofday(&now, NULL);
 
-  double diff_usec = time_val_diff_in_usec(&now, &thread_context->last_throttle_check);
-  if (thread_context->buckets == 0 || diff_usec > 1e5)
+  long rate = thread_context->option->rate;
+  guint64 diff_usec = time_val_diff_in_usec(&now, &thread_context->last_throttle_check);
+
+  /* check rate every 0.1sec */
+  if (thread_context->buckets != 0 && diff_usec <= 1e5)
+    return;
+
+  long new_buckets = (long)((rate * diff_usec) / USEC_PER_SEC);
+  if (!new_buckets)
+    return;
+
+  if (thread_context->buckets + new_buckets >= rate)
     {
-      /* check rate every 0.1sec */
-      long new_buckets = (long)((thread_context->option->rate * diff_usec) / USEC_PER_SEC);
-      if (new_buckets)
-        {
-          thread_context->buckets = (thread_context->option->rate < thread_context->buckets + new_buckets) ?
-                                    thread_context->option->rate : thread_context->buckets + new_buckets;
-          thread_context->last_throttle_check = now;
-        }
+      thread_context->buckets = rate;
+      thread_context->last_throttle_check = now;
+      return;
     }
 
-  if (thread_context->buckets == 0)
+  guint64 consumed_usec = thread_context->last_throttle_check.tv_usec + (new_buckets * USEC_PER_SEC) / rate;
+
+  thread_context->buckets += new_buckets;
+  thread_context->last_throttle_check.tv_sec += consumed_usec / USEC_PER_SEC;
+  thread_context->last_throttle_check.tv_usec = consumed_usec % USEC_PER_SEC;
+}
+
+static void
+_wait_for_time_bucket(ThreadData *thread_context, int max_messages)
+{
+  /* sleep until the messages we would like to send are allowed, but not
+   * longer than the rate check period, and at least for one message */
+  long rate = thread_context->option->rate;
+  guint64 usec = MIN(((guint64) MAX(max_messages, 1) * USEC_PER_SEC) / rate, 100000);
+
+  struct timespec tspec;
+  tspec.tv_sec = 0;
+  tspec.tv_nsec = MAX(usec, USEC_PER_SEC / rate) * 1000;
+  if (tspec.tv_nsec >= 1000000000)
     {
-      struct timespec tspec;
-      long msec = (1000 / thread_context->option->rate) + 1;
+      tspec.tv_sec = tspec.tv_nsec / 1000000000;
+      tspec.tv_nsec %= 1000000000;
+    }
+  while (nanosleep(&tspec, &tspec) < 0 && errno == EINTR)
+    ;
+}
+
+gboolean
+thread_check_time_bucket(ThreadData *thread_context)
+{
+  _refill_time_bucket(thread_context);
 
-      tspec.tv_sec = msec / 1000;
-      tspec.tv_nsec = (msec % 1000) * 1000000;
-      while (nanosleep(&tspec, &tspec) < 0 && errno == EINTR)
-        ;
+  if (thread_context->buckets == 0)
+    {
+      _wait_for_time_bucket(thread_context, 1);
       return TRUE;
     }
 
   return FALSE;
 }
 
+/* Returns the number of messages (at most max_messages) that can be sent
+ * right now, the caller is expected to decrement buckets by the number of
+ * messages it actually sent.  Sleeps and returns 0 if the rate limit does
+ * not allow sending anything. */
+int
+thread_acquire_time_bucket(ThreadData *thread_context, int max_messages)
+{
+  _refill_time_bucket(thread_context);
+
+  if (thread_context->buckets == 0)
+    {
+      _wait_for_time_bucket(thread_context, max_messages);
+      return 0;
+    }
+
+  return MIN(thread_context->buckets, max_messages);
+}
+
+void
+thread_pin_to_cpu(ThreadData *thread_context)
+{
+  if (!thread_context->option->pin_threads)
+    return;
+
+#if SYSLOG_NG_HAVE_PTHREAD_SETAFFINITY_NP
+  /* use the CPUs we are allowed to run on (e.g. by taskset), thread N is
+   * pinned to the Nth of them */
+  cpu_set_t allowed;
+  if (sched_getaffinity(0, sizeof(allowed), &allowed) < 0 || CPU_COUNT(&allowed) == 0)
+    {
+      ERROR("(thread %d) unable to query CPU affinity: %s\n", thread_context->index, g_strerror(errno));
+      return;
+    }
+
+  int nth = thread_context->index % CPU_COUNT(&allowed);
+  int cpu = 0;
+  for (; cpu < CPU_SETSIZE; cpu++)
+    {
+      if (CPU_ISSET(cpu, &allowed) && nth-- == 0)
+        break;
+    }
+
+  cpu_set_t cpu_set;
+  CPU_ZERO(&cpu_set);
+  CPU_SET(cpu, &cpu_set);
+  int rc = pthread_setaffinity_np(pthread_self(), sizeof(cpu_set), &cpu_set);
+  if (rc != 0)
+    {
+      ERROR("(thread %d) unable to pin thread to CPU %d: %s\n", thread_context->index, cpu, g_strerror(rc));
+      return;
+    }
+  DEBUG("(thread %d) pinned to CPU %d\n", thread_context->index, cpu);
+#else
+  ERROR("pinning threads to CPUs is not supported on this platform\n");
+#endif
+}
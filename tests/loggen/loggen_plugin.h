@@ -51,6 +51,7 @@ typedef struct _plugin_option
   char *proxy_dst_ip;
   char *proxy_src_port;
   char *proxy_dst_port;
+  int pin_threads;
 } PluginOption;
 
 typedef struct _thread_data
@@ -86,5 +87,7 @@ typedef struct _plugin_info
 
 gboolean thread_check_exit_criteria(ThreadData *thread_context);
 gboolean thread_check_time_bucket(ThreadData *thread_context);
+int thread_acquire_time_bucket(ThreadData *thread_context, int max_messages);
+void thread_pin_to_cpu(ThreadData *thread_context);
 
 #endif
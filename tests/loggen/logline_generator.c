@@ -37,9 +37,12 @@ static int pos_timestamp1 = 0;
 static int pos_timestamp2 = 0;
 static int pos_seq = 0;
 static int pos_thread_id = 0;
+/* replace the "stamp" field with CLOCK_MONOTONIC in nanoseconds, used by loggen --listen to measure latency */
+static int use_monotonic_stamp = 0;
 
 int
-prepare_log_line_template(int syslog_proto, int framing, int message_length, char *sdata_value)
+prepare_log_line_template(int syslog_proto, int framing, int message_length, char *sdata_value,
+                          int monotonic_stamp)
 {
   int linelen = 0;
   char padding[] = "PADD";
@@ -50,6 +53,8 @@ prepare_log_line_template(int syslog_proto, int framing, int message_length, cha
 
   int buffer_length = sizeof(line_buf_template);
 
+  use_monotonic_stamp = monotonic_stamp;
+
   if (framing)
     hdr_len = snprintf(line_buf_template, buffer_length, "%d ", message_length);
   else
@@ -115,7 +120,21 @@ generate_log_line(char *buffer, int buffer_length, int syslog_proto, int thread_
   char stamp[32];
   localtime_r(&now.tv_sec, &tm);
   int len = strftime(stamp, sizeof(stamp), "%Y-%m-%dT%H:%M:%S", &tm);
-  memcpy(&buffer[pos_timestamp2], stamp, len);
+
+  if (use_monotonic_stamp)
+    {
+      char mono_stamp[32];
+      struct timespec mono;
+
+      clock_gettime(CLOCK_MONOTONIC, &mono);
+      snprintf(mono_stamp, sizeof(mono_stamp), "%019" G_GINT64_FORMAT,
+               (gint64) mono.tv_sec * 1000000000 + mono.tv_nsec);
+      memcpy(&buffer[pos_timestamp2], mono_stamp, 19);
+    }
+  else
+    {
+      memcpy(&buffer[pos_timestamp2], stamp, len);
+    }
 
   if (syslog_proto)
     format_timezone_offset_with_colon(stamp, sizeof(stamp), &tm);
@@ -46,6 +46,8 @@ static void           stop(PluginOption *option);
 static gpointer       active_thread_func(gpointer user_data);
 static gpointer       idle_thread_func(gpointer user_data);
 static gboolean       send_msg(int fd, char *msg, size_t msg_len);
+static gboolean       send_batch(int fd, int sock_type, char *buffer, int *msg_lens, int count);
+static gboolean       send_dgram_batch(int fd, char *buffer, int *msg_lens, int count);
 static ssize_t        send_plain(int fd, void *buf, size_t length);
 static gint           get_thread_count(void);
 static void           set_generate_message(generate_message_func gen_message);
@@ -66,6 +68,7 @@ static int inet_socket_i = 0;
 static int unix_socket_x = 0;
 static int sock_type_s = 0;
 static int sock_type_d = 0;
+static int batch_size = 1;
 
 static GOptionEntry loggen_options[] =
 {
@@ -73,6 +76,7 @@ static GOptionEntry loggen_options[] =
   { "unix", 'x', 0,   G_OPTION_ARG_NONE, &unix_socket_x, "Use UNIX domain socket transport", NULL },
   { "stream", 'S', 0, G_OPTION_ARG_NONE, &sock_type_s,   "Use stream socket (TCP and unix-stream)", NULL },
   { "dgram", 'D', 0,  G_OPTION_ARG_NONE, &sock_type_d,   "Use datagram socket (UDP and unix-dgram)", NULL },
+  { "batch-size", 0, 0, G_OPTION_ARG_INT, &batch_size, "Number of messages to send with a single syscall (default = 1)", "<number>" },
   { NULL }
 };
 
@@ -147,6 +151,12 @@ start(PluginOption *option)
       return FALSE;
     }
 
+  if (batch_size < 1)
+    {
+      ERROR("batch-size must be a positive number\n");
+      return FALSE;
+    }
+
   DEBUG("plugin (%d,%d,%d,%d)start\n",
         option->message_length,
         option->interval,
@@ -319,7 +329,10 @@ active_thread_func(gpointer user_data)
   if (sock_type_s)
     sock_type = SOCK_STREAM;
 
-  char *message = g_malloc0(MAX_MESSAGE_LENGTH+1);
+  char *message = g_malloc0((gsize) batch_size * MAX_MESSAGE_LENGTH + 1);
+  int *msg_lens = g_new0(int, batch_size);
+
+  thread_pin_to_cpu(thread_context);
 
   int fd;
   if (unix_socket_x)
@@ -362,13 +375,19 @@ active_thread_func(gpointer user_data)
   gettimeofday(&thread_context->start_time, NULL);
 
   gboolean connection_error = FALSE;
+  gboolean end_of_input = FALSE;
 
-  while (fd>0 && thread_run && !connection_error)
+  while (fd>0 && thread_run && !connection_error && !end_of_input)
     {
       if (thread_check_exit_criteria(thread_context))
         break;
 
-      if (thread_check_time_bucket(thread_context))
+      int batch_limit = batch_size;
+      if (option->number_of_messages != 0)
+        batch_limit = MIN(batch_limit, option->number_of_messages - thread_context->sent_messages);
+
+      int batch_count = thread_acquire_time_bucket(thread_context, batch_limit);
+      if (batch_count == 0)
         continue;
 
       if (!generate_message)
@@ -377,20 +396,32 @@ active_thread_func(gpointer user_data)
           break;
         }
 
-      int str_len = generate_message(message, MAX_MESSAGE_LENGTH, thread_context, count++);
-
-      if (str_len < 0)
+      char *batch_end = message;
+      for (int i = 0; i < batch_count; i++)
         {
-          ERROR("can't generate more log lines. end of input file?\n");
-          break;
+          int str_len = generate_message(batch_end, MAX_MESSAGE_LENGTH, thread_context, count++);
+
+          if (str_len < 0)
+            {
+              ERROR("can't generate more log lines. end of input file?\n");
+              end_of_input = TRUE;
+              batch_count = i;
+              break;
+            }
+
+          msg_lens[i] = str_len;
+          batch_end += str_len;
         }
 
-      connection_error = send_msg(fd, message, str_len);
+      if (batch_count == 0)
+        break;
+
+      connection_error = send_batch(fd, sock_type, message, msg_lens, batch_count);
 
       if(!connection_error)
         {
-          thread_context->sent_messages++;
-          thread_context->buckets--;
+          thread_context->sent_messages += batch_count;
+          thread_context->buckets -= batch_count;
         }
 
       if(connection_error && option->reconnect && thread_run)
@@ -425,6 +456,7 @@ active_thread_func(gpointer user_data)
   DEBUG("thread (%s,%p) finished\n", socket_loggen_plugin_info.name, g_thread_self());
 
   g_free((gpointer)message);
+  g_free(msg_lens);
   g_mutex_lock(&thread_lock);
   active_thread_count--;
   g_mutex_unlock(&thread_lock);
@@ -437,6 +469,90 @@ active_thread_func(gpointer user_data)
   return NULL;
 }
 
+/* in case of stream sockets the batch is sent with a single write(), as
+ * the messages are generated next to each other, datagram sockets need one
+ * datagram per message, those are sent using sendmmsg() if available */
+static gboolean
+send_batch(int fd, int sock_type, char *buffer, int *msg_lens, int count)
+{
+  if (sock_type == SOCK_DGRAM)
+    return send_dgram_batch(fd, buffer, msg_lens, count);
+
+  size_t batch_len = 0;
+  for (int i = 0; i < count; i++)
+    batch_len += msg_lens[i];
+
+  return send_msg(fd, buffer, batch_len);
+}
+
+#if SYSLOG_NG_HAVE_SENDMMSG
+
+#define MAX_MSGS_PER_SENDMMSG 1024
+
+static gboolean
+send_dgram_batch(int fd, char *buffer, int *msg_lens, int count)
+{
+  struct mmsghdr msgs[MAX_MSGS_PER_SENDMMSG];
+  struct iovec iov[MAX_MSGS_PER_SENDMMSG];
+  char *msg = buffer;
+
+  while (count > 0)
+    {
+      int chunk = MIN(count, MAX_MSGS_PER_SENDMMSG);
+
+      memset(msgs, 0, chunk * sizeof(msgs[0]));
+      for (int i = 0; i < chunk; i++)
+        {
+          iov[i].iov_base = msg;
+          iov[i].iov_len = msg_lens[i];
+          msgs[i].msg_hdr.msg_iov = &iov[i];
+          msgs[i].msg_hdr.msg_iovlen = 1;
+          msg += msg_lens[i];
+        }
+
+      int sent = 0;
+      while (sent < chunk)
+        {
+          int rc = sendmmsg(fd, &msgs[sent], chunk - sent, 0);
+          if (rc < 0 && errno == ENOBUFS)
+            {
+              /* see send_plain() */
+              struct timespec tspec = { .tv_sec = 0, .tv_nsec = 1e6 };
+              while (nanosleep(&tspec, &tspec) < 0 && errno == EINTR)
+                ;
+              continue;
+            }
+          if (rc <= 0)
+            {
+              ERROR("error sending datagrams on %d (rc=%d)\n", fd, rc);
+              errno = ECONNABORTED;
+              return TRUE;
+            }
+          sent += rc;
+        }
+
+      msg_lens += chunk;
+      count -= chunk;
+    }
+  return FALSE;
+}
+
+#else
+
+static gboolean
+send_dgram_batch(int fd, char *buffer, int *msg_lens, int count)
+{
+  for (int i = 0; i < count; i++)
+    {
+      if (send_msg(fd, buffer, msg_lens[i]))
+        return TRUE;
+      buffer += msg_lens[i];
+    }
+  return FALSE;
+}
+
+#endif
+
 static gboolean
 send_msg(int fd, char *msg, size_t msg_len)
 {
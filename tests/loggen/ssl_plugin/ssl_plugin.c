@@ -326,6 +326,8 @@ active_thread_func(gpointer user_data)
 
   char *message = g_malloc0(MAX_MESSAGE_LENGTH+1);
 
+  thread_pin_to_cpu(thread_context);
+
   int sock_fd = connect_ip_socket(SOCK_STREAM, option->target, option->port, option->use_ipv6);
 
   if(proxied_tls_passthrough)